@@ -153,6 +153,10 @@ typedef portBASE_TYPE (*pdTASK_HOOK_CODE)( void * );
 	#define INCLUDE_xTimerGetTimerDaemonTaskHandle 0
 #endif
 
+#ifndef INCLUDE_xTimerPendFunctionCall
+	#define INCLUDE_xTimerPendFunctionCall 0
+#endif
+
 #ifndef INCLUDE_xQueueGetMutexHolder
 	#define INCLUDE_xQueueGetMutexHolder 0
 #endif
@@ -241,6 +245,10 @@ typedef portBASE_TYPE (*pdTASK_HOOK_CODE)( void * );
 
 #endif /* configUSE_TIMERS */
 
+#if ( INCLUDE_xTimerPendFunctionCall == 1 ) && ( configUSE_TIMERS == 0 )
+	#error configUSE_TIMERS must be set to 1 to make the xTimerPendFunctionCall() function available.
+#endif
+
 #ifndef INCLUDE_xTaskGetSchedulerState
 	#define INCLUDE_xTaskGetSchedulerState 0
 #endif
@@ -581,6 +589,14 @@ typedef portBASE_TYPE (*pdTASK_HOOK_CODE)( void * );
 	#define configUSE_QUEUE_SETS 0
 #endif
 
+#ifndef configUSE_EVENT_GROUPS
+	#define configUSE_EVENT_GROUPS 0
+#endif
+
+#ifndef configUSE_TASK_NOTIFICATIONS
+	#define configUSE_TASK_NOTIFICATIONS 1
+#endif
+
 #ifndef portTASK_USES_FLOATING_POINT
 	#define portTASK_USES_FLOATING_POINT()
 #endif
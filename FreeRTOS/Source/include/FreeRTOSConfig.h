@@ -36,6 +36,8 @@
 #ifndef configCPU_CLOCK_HZ
 #define configCPU_CLOCK_HZ			( ( unsigned long ) 80000000 )
 #endif
+/* Up to 1000. The port drives the tick from CCOMPARE0 itself, the SDK's
+   own timer interrupt only ever ran at 100Hz. */
 #ifndef configTICK_RATE_HZ
 #define configTICK_RATE_HZ			( ( portTickType ) 100 )
 #endif
@@ -57,6 +59,41 @@
 #ifndef configUSE_STATS_FORMATTING_FUNCTIONS
 #define configUSE_STATS_FORMATTING_FUNCTIONS 0
 #endif
+/* When enabled the idle task stops the tick and halts the CPU (waiti)
+   until the next task is due to unblock, or another interrupt arrives. */
+#ifndef configUSE_TICKLESS_IDLE
+#define configUSE_TICKLESS_IDLE		0
+#endif
+/* Run time stats are counted in CPU cycles >> configRUN_TIME_COUNTER_SHIFT
+   (also requires configUSE_TRACE_FACILITY for uxTaskGetSystemState.) */
+#ifndef configGENERATE_RUN_TIME_STATS
+#define configGENERATE_RUN_TIME_STATS 0
+#endif
+#ifndef configRUN_TIME_COUNTER_SHIFT
+#define configRUN_TIME_COUNTER_SHIFT 6
+#endif
+/* xTaskNotify() and friends, costs 8 bytes per task */
+#ifndef configUSE_TASK_NOTIFICATIONS
+#define configUSE_TASK_NOTIFICATIONS 1
+#endif
+/* xQueueCreateSet() and friends, to block on several queues and
+   semaphores at once. Costs 4 bytes per queue. */
+#ifndef configUSE_QUEUE_SETS
+#define configUSE_QUEUE_SETS 1
+#endif
+/* event_groups.h. Setting bits from an ISR also needs
+   INCLUDE_xTimerPendFunctionCall, below. */
+#ifndef configUSE_EVENT_GROUPS
+#define configUSE_EVENT_GROUPS 1
+#endif
+/* newlib context (errno, stdio streams, strtok state...) per task.
+   0: every task shares one. 1: each TCB holds a struct _reent (240
+   bytes, libc is built _REENT_SMALL). 2: a task gets its own, from the
+   heap, the first time it uses errno or calls pxTaskClaimNewlibReent(),
+   and shares the global one until then, costing 4 bytes per task. */
+#ifndef configUSE_NEWLIB_REENTRANT
+#define configUSE_NEWLIB_REENTRANT 0
+#endif
 #ifndef configUSE_16_BIT_TICKS
 #define configUSE_16_BIT_TICKS		0
 #endif
@@ -92,6 +129,11 @@
 #ifndef configTIMER_TASK_STACK_DEPTH
 #define configTIMER_TASK_STACK_DEPTH  ( ( unsigned short ) 512 )
 #endif
+/* xTimerPendFunctionCall(FromISR), and the esp/hrtimer.h timers whose
+   callbacks run in the timer task */
+#ifndef INCLUDE_xTimerPendFunctionCall
+#define INCLUDE_xTimerPendFunctionCall 1
+#endif
 #endif
 
 /* Co-routine definitions. */
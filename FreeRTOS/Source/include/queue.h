@@ -70,6 +70,8 @@
 	#error "include FreeRTOS.h" must appear in source files before "include queue.h"
 #endif
 
+#include "list.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -96,6 +98,31 @@ typedef void * xQueueSetHandle;
  */
 typedef void * xQueueSetMemberHandle;
 
+/**
+ * Caller supplied memory for a queue, semaphore or mutex, see
+ * xQueueCreateStatic().  The members mirror the private xQUEUE structure in
+ * queue.c so it has the same size, and must not be accessed.
+ */
+typedef struct xSTATIC_QUEUE
+{
+	void *pvDummy1[ 3 ];
+	union
+	{
+		void *pvDummy2;
+		unsigned portBASE_TYPE uxDummy2;
+	} u;
+	xList xDummy3[ 2 ];
+	unsigned portBASE_TYPE uxDummy4[ 3 ];
+	signed portBASE_TYPE xDummy5[ 2 ];
+	#if ( configUSE_TRACE_FACILITY == 1 )
+		unsigned char ucDummy6[ 2 ];
+	#endif
+	#if ( configUSE_QUEUE_SETS == 1 )
+		void *pvDummy7;
+	#endif
+	unsigned char ucDummy8;
+} StaticQueue_t;
+
 /* For internal use only. */
 #define	queueSEND_TO_BACK		( ( portBASE_TYPE ) 0 )
 #define	queueSEND_TO_FRONT		( ( portBASE_TYPE ) 1 )
@@ -167,6 +194,40 @@ typedef void * xQueueSetMemberHandle;
  */
 #define xQueueCreate( uxQueueLength, uxItemSize ) xQueueGenericCreate( uxQueueLength, uxItemSize, queueQUEUE_TYPE_BASE )
 
+/**
+ * queue. h
+ * <pre>
+ xQueueHandle xQueueCreateStatic(
+							  unsigned portBASE_TYPE uxQueueLength,
+							  unsigned portBASE_TYPE uxItemSize,
+							  unsigned char *pucQueueStorage,
+							  StaticQueue_t *pxQueueBuffer
+						  );
+ * </pre>
+ *
+ * Create a new queue like xQueueCreate(), but in memory supplied by the
+ * caller instead of the FreeRTOS heap.  vQueueDelete() doesn't free it.
+ *
+ * @param pucQueueStorage At least uxQueueLength * uxItemSize bytes, to hold
+ * the items.  May be NULL if uxItemSize is 0.
+ *
+ * @param pxQueueBuffer Memory for the queue structure.
+ *
+ * @return A handle to the created queue, or NULL if a buffer is missing.
+ *
+ * Example usage:
+   <pre>
+ #define QUEUE_LENGTH 10
+ static unsigned char ucQueueStorage[ QUEUE_LENGTH * sizeof( unsigned long ) ];
+ static StaticQueue_t xQueueBuffer;
+
+ xQueue = xQueueCreateStatic( QUEUE_LENGTH, sizeof( unsigned long ), ucQueueStorage, &xQueueBuffer );
+ </pre>
+ * \defgroup xQueueCreateStatic xQueueCreateStatic
+ * \ingroup QueueManagement
+ */
+#define xQueueCreateStatic( uxQueueLength, uxItemSize, pucQueueStorage, pxQueueBuffer ) xQueueGenericCreateStatic( ( uxQueueLength ), ( uxItemSize ), ( pucQueueStorage ), ( pxQueueBuffer ), queueQUEUE_TYPE_BASE )
+
 /**
  * queue. h
  * <pre>
@@ -1455,7 +1516,9 @@ signed portBASE_TYPE xQueueCRReceive( xQueueHandle xQueue, void *pvBuffer, portT
  * these functions directly.
  */
 xQueueHandle xQueueCreateMutex( unsigned char ucQueueType ) PRIVILEGED_FUNCTION;
+xQueueHandle xQueueCreateMutexStatic( unsigned char ucQueueType, StaticQueue_t *pxStaticQueue ) PRIVILEGED_FUNCTION;
 xQueueHandle xQueueCreateCountingSemaphore( unsigned portBASE_TYPE uxCountValue, unsigned portBASE_TYPE uxInitialCount ) PRIVILEGED_FUNCTION;
+xQueueHandle xQueueCreateCountingSemaphoreStatic( unsigned portBASE_TYPE uxCountValue, unsigned portBASE_TYPE uxInitialCount, StaticQueue_t *pxStaticQueue ) PRIVILEGED_FUNCTION;
 void* xQueueGetMutexHolder( xQueueHandle xSemaphore ) PRIVILEGED_FUNCTION;
 
 /*
@@ -1517,6 +1580,11 @@ portBASE_TYPE xQueueGiveMutexRecursive( xQueueHandle pxMutex ) PRIVILEGED_FUNCTI
  */
 xQueueHandle xQueueGenericCreate( unsigned portBASE_TYPE uxQueueLength, unsigned portBASE_TYPE uxItemSize, unsigned char ucQueueType ) PRIVILEGED_FUNCTION;
 
+/*
+ * As xQueueGenericCreate(), in caller supplied memory.
+ */
+xQueueHandle xQueueGenericCreateStatic( unsigned portBASE_TYPE uxQueueLength, unsigned portBASE_TYPE uxItemSize, unsigned char *pucQueueStorage, StaticQueue_t *pxStaticQueue, unsigned char ucQueueType ) PRIVILEGED_FUNCTION;
+
 /*
  * Queue sets provide a mechanism to allow a task to block (pend) on a read
  * operation from multiple queues or semaphores simultaneously.
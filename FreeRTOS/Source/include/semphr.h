@@ -751,6 +751,42 @@ typedef xQueueHandle xSemaphoreHandle;
  */
 #define xSemaphoreCreateCounting( uxMaxCount, uxInitialCount ) xQueueCreateCountingSemaphore( ( uxMaxCount ), ( uxInitialCount ) )
 
+/**
+ * Caller supplied memory for a semaphore or mutex.
+ */
+typedef StaticQueue_t StaticSemaphore_t;
+
+/**
+ * semphr. h
+ * <pre>xSemaphoreHandle xSemaphoreCreateBinaryStatic( StaticSemaphore_t *pxSemaphoreBuffer )</pre>
+ * <pre>xSemaphoreHandle xSemaphoreCreateMutexStatic( StaticSemaphore_t *pxMutexBuffer )</pre>
+ * <pre>xSemaphoreHandle xSemaphoreCreateRecursiveMutexStatic( StaticSemaphore_t *pxMutexBuffer )</pre>
+ * <pre>xSemaphoreHandle xSemaphoreCreateCountingStatic( unsigned portBASE_TYPE uxMaxCount, unsigned portBASE_TYPE uxInitialCount, StaticSemaphore_t *pxSemaphoreBuffer )</pre>
+ *
+ * Create a semaphore or mutex like vSemaphoreCreateBinary(),
+ * xSemaphoreCreateMutex(), xSemaphoreCreateRecursiveMutex() and
+ * xSemaphoreCreateCounting(), but in memory supplied by the caller instead of
+ * the FreeRTOS heap.  vSemaphoreDelete() doesn't free it.
+ *
+ * Unlike vSemaphoreCreateBinary(), xSemaphoreCreateBinaryStatic() creates the
+ * semaphore empty, so the first xSemaphoreTake() blocks until it is given.
+ *
+ * @return The semaphore handle, or NULL if the buffer is NULL.
+ *
+ * Example usage:
+ <pre>
+ static StaticSemaphore_t xSemaphoreBuffer;
+
+ xSemaphore = xSemaphoreCreateBinaryStatic( &xSemaphoreBuffer );
+ </pre>
+ * \defgroup xSemaphoreCreateBinaryStatic xSemaphoreCreateBinaryStatic
+ * \ingroup Semaphores
+ */
+#define xSemaphoreCreateBinaryStatic( pxSemaphoreBuffer ) xQueueGenericCreateStatic( ( unsigned portBASE_TYPE ) 1, semSEMAPHORE_QUEUE_ITEM_LENGTH, NULL, ( pxSemaphoreBuffer ), queueQUEUE_TYPE_BINARY_SEMAPHORE )
+#define xSemaphoreCreateMutexStatic( pxMutexBuffer ) xQueueCreateMutexStatic( queueQUEUE_TYPE_MUTEX, ( pxMutexBuffer ) )
+#define xSemaphoreCreateRecursiveMutexStatic( pxMutexBuffer ) xQueueCreateMutexStatic( queueQUEUE_TYPE_RECURSIVE_MUTEX, ( pxMutexBuffer ) )
+#define xSemaphoreCreateCountingStatic( uxMaxCount, uxInitialCount, pxSemaphoreBuffer ) xQueueCreateCountingSemaphoreStatic( ( uxMaxCount ), ( uxInitialCount ), ( pxSemaphoreBuffer ) )
+
 /**
  * semphr. h
  * <pre>void vSemaphoreDelete( xSemaphoreHandle xSemaphore );</pre>
@@ -104,6 +104,16 @@ typedef enum
 	eDeleted		/* The task being queried has been deleted, but its TCB has not yet been freed. */
 } eTaskState;
 
+/* Actions that can be performed when xTaskNotify() is called. */
+typedef enum
+{
+	eNoAction = 0,				/* Notify the task without updating its notify value. */
+	eSetBits,					/* Set bits in the task's notification value. */
+	eIncrement,					/* Increment the task's notification value. */
+	eSetValueWithOverwrite,		/* Set the task's notification value to a specific value even if the previous value has not yet been read by the task. */
+	eSetValueWithoutOverwrite	/* Set the task's notification value if the previous value has been read by the task. */
+} eNotifyAction;
+
 /*
  * Used internally only.
  */
@@ -137,6 +147,51 @@ typedef struct xTASK_PARAMTERS
 	xMemoryRegion xRegions[ portNUM_CONFIGURABLE_REGIONS ];
 } xTaskParameters;
 
+/*
+ * Caller supplied memory for a task's TCB, see xTaskCreateStatic().  The
+ * members mirror the private tskTCB structure in tasks.c so it has the same
+ * size, and must not be accessed.
+ */
+typedef struct xSTATIC_TCB
+{
+	void *pxDummy1;
+	#if ( portUSING_MPU_WRAPPERS == 1 )
+		xMPU_SETTINGS xDummy2;
+	#endif
+	xListItem xDummy3[ 2 ];
+	unsigned portBASE_TYPE uxDummy4;
+	void *pxDummy5;
+	signed char ucDummy6[ configMAX_TASK_NAME_LEN ];
+	#if ( portSTACK_GROWTH > 0 )
+		void *pxDummy7;
+	#endif
+	#if ( portCRITICAL_NESTING_IN_TCB == 1 )
+		unsigned portBASE_TYPE uxDummy8;
+	#endif
+	#if ( configUSE_TRACE_FACILITY == 1 )
+		unsigned portBASE_TYPE uxDummy9[ 2 ];
+	#endif
+	#if ( configUSE_MUTEXES == 1 )
+		unsigned portBASE_TYPE uxDummy10;
+	#endif
+	#if ( configUSE_APPLICATION_TASK_TAG == 1 )
+		void *pxDummy11;
+	#endif
+	#if ( configGENERATE_RUN_TIME_STATS == 1 )
+		unsigned long ulDummy12;
+	#endif
+	#if ( configUSE_NEWLIB_REENTRANT == 1 )
+		struct _reent xDummy13;
+	#elif ( configUSE_NEWLIB_REENTRANT == 2 )
+		void *pxDummy13;
+	#endif
+	#if ( configUSE_TASK_NOTIFICATIONS == 1 )
+		unsigned long ulDummy15;
+		unsigned char ucDummy16;
+	#endif
+	unsigned char ucDummy14;
+} StaticTask_t;
+
 /* Used with the uxTaskGetSystemState() function to return the state of each task
 in the system. */
 typedef struct xTASK_STATUS
@@ -312,6 +367,49 @@ typedef enum
  */
 #define xTaskCreate( pvTaskCode, pcName, usStackDepth, pvParameters, uxPriority, pxCreatedTask ) xTaskGenericCreate( ( pvTaskCode ), ( pcName ), ( usStackDepth ), ( pvParameters ), ( uxPriority ), ( pxCreatedTask ), ( NULL ), ( NULL ) )
 
+/**
+ * task. h
+ *<pre>
+ xTaskHandle xTaskCreateStatic(
+							  pdTASK_CODE pvTaskCode,
+							  const signed char * const pcName,
+							  unsigned short usStackDepth,
+							  void *pvParameters,
+							  unsigned portBASE_TYPE uxPriority,
+							  portSTACK_TYPE *puxStackBuffer,
+							  StaticTask_t *pxTaskBuffer
+						  );</pre>
+ *
+ * Create a new task like xTaskCreate(), but with its stack and TCB in memory
+ * supplied by the caller instead of the FreeRTOS heap, so it can't fail for
+ * lack of memory.  Typically both are static variables.
+ *
+ * If the task is deleted the memory is not freed, and it must not be reused
+ * until the idle task has cleaned the task up.
+ *
+ * @param puxStackBuffer At least usStackDepth words of stack.
+ *
+ * @param pxTaskBuffer Memory for the task's TCB.
+ *
+ * The other parameters are as for xTaskCreate().
+ *
+ * @return A handle to the created task, or NULL if either buffer is NULL.
+ *
+ * Example usage:
+   <pre>
+ static portSTACK_TYPE xStack[ STACK_SIZE ];
+ static StaticTask_t xTaskBuffer;
+
+ void vOtherFunction( void )
+ {
+	xTaskCreateStatic( vTaskCode, "NAME", STACK_SIZE, NULL, tskIDLE_PRIORITY, xStack, &xTaskBuffer );
+ }
+   </pre>
+ * \defgroup xTaskCreateStatic xTaskCreateStatic
+ * \ingroup Tasks
+ */
+xTaskHandle xTaskCreateStatic( pdTASK_CODE pxTaskCode, const signed char * const pcName, unsigned short usStackDepth, void *pvParameters, unsigned portBASE_TYPE uxPriority, portSTACK_TYPE *puxStackBuffer, StaticTask_t *pxTaskBuffer ) PRIVILEGED_FUNCTION;
+
 /**
  * task. h
  *<pre>
@@ -1143,6 +1241,18 @@ portBASE_TYPE xTaskCallApplicationTaskHook( xTaskHandle xTask, void *pvParameter
  */
 xTaskHandle xTaskGetIdleTaskHandle( void );
 
+/**
+ * ulTaskGetIdleRunTimeCounter() is only available if
+ * configGENERATE_RUN_TIME_STATS is set to 1 in FreeRTOSConfig.h.
+ *
+ * Returns the idle task's run time counter, the time spent idle in units of
+ * portGET_RUN_TIME_COUNTER_VALUE(), without the cost of
+ * uxTaskGetSystemState().  Comparing its change over an interval to that of
+ * portGET_RUN_TIME_COUNTER_VALUE() gives the CPU load.  Not valid before the
+ * scheduler has been started.
+ */
+unsigned long ulTaskGetIdleRunTimeCounter( void );
+
 /**
  * configUSE_TRACE_FACILITY must bet defined as 1 in FreeRTOSConfig.h for
  * uxTaskGetSystemState() to be available.
@@ -1419,6 +1529,41 @@ void vTaskPlaceOnEventListRestricted( xList * const pxEventList, portTickType xT
  */
 signed portBASE_TYPE xTaskRemoveFromEventList( const xList * const pxEventList ) PRIVILEGED_FUNCTION;
 
+/*
+ * THIS FUNCTION MUST NOT BE USED FROM APPLICATION CODE.  IT IS AN
+ * INTERFACE WHICH IS FOR THE EXCLUSIVE USE OF THE EVENT GROUPS.
+ *
+ * THIS FUNCTION MUST BE CALLED WITH THE SCHEDULER SUSPENDED.
+ *
+ * As vTaskPlaceOnEventList(), but the task is added to the end of
+ * pxEventList rather than in priority order, and xItemValue (the bits
+ * and options it waits for) is stored in its event list item.
+ */
+void vTaskPlaceOnUnorderedEventList( xList * pxEventList, const portTickType xItemValue, const portTickType xTicksToWait ) PRIVILEGED_FUNCTION;
+
+/*
+ * THIS FUNCTION MUST NOT BE USED FROM APPLICATION CODE.  IT IS AN
+ * INTERFACE WHICH IS FOR THE EXCLUSIVE USE OF THE EVENT GROUPS.
+ *
+ * THIS FUNCTION MUST BE CALLED WITH THE SCHEDULER SUSPENDED.
+ *
+ * Moves the task owning pxEventListItem to a ready list, storing
+ * xItemValue (the bits that woke it) in the item.
+ *
+ * @return pdTRUE if the task being removed has a higher priority than the task
+ * making the call, otherwise pdFALSE.
+ */
+signed portBASE_TYPE xTaskRemoveFromUnorderedEventList( xListItem * pxEventListItem, const portTickType xItemValue ) PRIVILEGED_FUNCTION;
+
+/*
+ * THIS FUNCTION MUST NOT BE USED FROM APPLICATION CODE.  IT IS AN
+ * INTERFACE WHICH IS FOR THE EXCLUSIVE USE OF THE EVENT GROUPS.
+ *
+ * Returns the value stored in the calling task's event list item by the
+ * functions above, and sets it back to the task's priority.
+ */
+portTickType uxTaskResetEventItemValue( void ) PRIVILEGED_FUNCTION;
+
 /*
  * THIS FUNCTION MUST NOT BE USED FROM APPLICATION CODE.  IT IS ONLY
  * INTENDED FOR USE WHEN IMPLEMENTING A PORT OF THE SCHEDULER AND IS
@@ -1434,6 +1579,16 @@ void vTaskSwitchContext( void ) PRIVILEGED_FUNCTION;
  */
 xTaskHandle xTaskGetCurrentTaskHandle( void ) PRIVILEGED_FUNCTION;
 
+#if ( configUSE_NEWLIB_REENTRANT == 2 )
+/*
+ * Give the calling task its own newlib reent, if it doesn't have one yet,
+ * and return it.  Callers must be able to allocate: not from an interrupt
+ * or a critical section.  Before the scheduler starts, or if the heap is
+ * exhausted, returns the shared _global_impure_ptr.
+ */
+struct _reent *pxTaskClaimNewlibReent( void ) PRIVILEGED_FUNCTION;
+#endif
+
 /*
  * Capture the current time status for future reference.
  */
@@ -1469,6 +1624,101 @@ void vTaskPriorityInherit( xTaskHandle const pxMutexHolder ) PRIVILEGED_FUNCTION
  */
 void vTaskPriorityDisinherit( xTaskHandle const pxMutexHolder ) PRIVILEGED_FUNCTION;
 
+/*-----------------------------------------------------------
+ * TASK NOTIFICATIONS
+ *----------------------------------------------------------*/
+
+/**
+ * task. h
+ * <pre>portBASE_TYPE xTaskNotify( xTaskHandle xTaskToNotify, unsigned long ulValue, eNotifyAction eAction );</pre>
+ *
+ * configUSE_TASK_NOTIFICATIONS must be 1 (the default) for the notification
+ * functions to be available.
+ *
+ * Each task has a 32 bit notification value, and sending a task a
+ * notification unblocks it if it is waiting in xTaskNotifyWait() or
+ * ulTaskNotifyTake().  Notifications need no separate object and are much
+ * faster than a queue or semaphore, so are the cheapest way to signal one
+ * particular task from another task or from an interrupt handler.  Only the
+ * task that owns the notification value can wait on it.
+ *
+ * eAction updates the notification value:
+ *
+ * eNoAction - only notify.
+ * eSetBits - OR in ulValue, like an event group.
+ * eIncrement - add one, like giving a counting semaphore (xTaskNotifyGive()).
+ * eSetValueWithOverwrite - set to ulValue, like a one item queue that is
+ * overwritten.
+ * eSetValueWithoutOverwrite - set to ulValue unless the task has a
+ * notification pending, in which case pdFAIL is returned.
+ *
+ * @return pdPASS, unless eSetValueWithoutOverwrite failed.
+ *
+ * xTaskNotifyFromISR() is the version for interrupt handlers, and sets
+ * *pxHigherPriorityTaskWoken to pdTRUE if the notified task should run when
+ * the interrupt returns (call portYIELD() from the handler if so).
+ *
+ * \defgroup xTaskNotify xTaskNotify
+ * \ingroup TaskNotifications
+ */
+portBASE_TYPE xTaskGenericNotify( xTaskHandle xTaskToNotify, unsigned long ulValue, eNotifyAction eAction, unsigned long *pulPreviousNotificationValue ) PRIVILEGED_FUNCTION;
+#define xTaskNotify( xTaskToNotify, ulValue, eAction ) xTaskGenericNotify( ( xTaskToNotify ), ( ulValue ), ( eAction ), NULL )
+#define xTaskNotifyAndQuery( xTaskToNotify, ulValue, eAction, pulPreviousNotifyValue ) xTaskGenericNotify( ( xTaskToNotify ), ( ulValue ), ( eAction ), ( pulPreviousNotifyValue ) )
+
+portBASE_TYPE xTaskGenericNotifyFromISR( xTaskHandle xTaskToNotify, unsigned long ulValue, eNotifyAction eAction, unsigned long *pulPreviousNotificationValue, portBASE_TYPE *pxHigherPriorityTaskWoken ) PRIVILEGED_FUNCTION;
+#define xTaskNotifyFromISR( xTaskToNotify, ulValue, eAction, pxHigherPriorityTaskWoken ) xTaskGenericNotifyFromISR( ( xTaskToNotify ), ( ulValue ), ( eAction ), NULL, ( pxHigherPriorityTaskWoken ) )
+
+/**
+ * task. h
+ * <pre>portBASE_TYPE xTaskNotifyWait( unsigned long ulBitsToClearOnEntry, unsigned long ulBitsToClearOnExit, unsigned long *pulNotificationValue, portTickType xTicksToWait );</pre>
+ *
+ * Wait up to xTicksToWait for a notification to the calling task (returning
+ * at once if one is already pending).  Bits in ulBitsToClearOnEntry are
+ * cleared from the notification value if no notification is pending on
+ * entry, and bits in ulBitsToClearOnExit once one has been received.  The
+ * value (before the exit clearing) is stored in *pulNotificationValue.
+ *
+ * @return pdTRUE if a notification was received, pdFALSE on timeout.
+ *
+ * \defgroup xTaskNotifyWait xTaskNotifyWait
+ * \ingroup TaskNotifications
+ */
+portBASE_TYPE xTaskNotifyWait( unsigned long ulBitsToClearOnEntry, unsigned long ulBitsToClearOnExit, unsigned long *pulNotificationValue, portTickType xTicksToWait ) PRIVILEGED_FUNCTION;
+
+/**
+ * task. h
+ * <pre>portBASE_TYPE xTaskNotifyGive( xTaskHandle xTaskToNotify );</pre>
+ * <pre>void vTaskNotifyGiveFromISR( xTaskHandle xTaskToNotify, portBASE_TYPE *pxHigherPriorityTaskWoken );</pre>
+ * <pre>unsigned long ulTaskNotifyTake( portBASE_TYPE xClearCountOnExit, portTickType xTicksToWait );</pre>
+ *
+ * Use the notification value as a binary or counting semaphore, in place of
+ * xSemaphoreGive()/xSemaphoreGiveFromISR()/xSemaphoreTake() where only one
+ * known task ever takes it.
+ *
+ * ulTaskNotifyTake() waits up to xTicksToWait for the value to be non-zero,
+ * then zeroes it (xClearCountOnExit = pdTRUE, a binary semaphore) or
+ * decrements it (pdFALSE, a counting semaphore).  It returns the value before
+ * it was cleared or decremented, so 0 means the wait timed out.
+ *
+ * \defgroup ulTaskNotifyTake ulTaskNotifyTake
+ * \ingroup TaskNotifications
+ */
+#define xTaskNotifyGive( xTaskToNotify ) xTaskGenericNotify( ( xTaskToNotify ), 0UL, eIncrement, NULL )
+void vTaskNotifyGiveFromISR( xTaskHandle xTaskToNotify, portBASE_TYPE *pxHigherPriorityTaskWoken ) PRIVILEGED_FUNCTION;
+unsigned long ulTaskNotifyTake( portBASE_TYPE xClearCountOnExit, portTickType xTicksToWait ) PRIVILEGED_FUNCTION;
+
+/**
+ * task. h
+ * <pre>portBASE_TYPE xTaskNotifyStateClear( xTaskHandle xTask );</pre>
+ *
+ * Discard a pending notification of xTask (NULL for the calling task),
+ * without changing its notification value.  Returns pdPASS if there was one.
+ *
+ * \defgroup xTaskNotifyStateClear xTaskNotifyStateClear
+ * \ingroup TaskNotifications
+ */
+portBASE_TYPE xTaskNotifyStateClear( xTaskHandle xTask ) PRIVILEGED_FUNCTION;
+
 /*
  * Generic version of the task creation function which is in turn called by the
  * xTaskCreate() and xTaskCreateRestricted() macros.
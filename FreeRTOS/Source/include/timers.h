@@ -87,6 +87,9 @@ as defined below. */
 #define tmrCOMMAND_CHANGE_PERIOD			( ( portBASE_TYPE ) 2 )
 #define tmrCOMMAND_DELETE					( ( portBASE_TYPE ) 3 )
 
+/* Commands below zero aren't about a timer, see xTimerPendFunctionCall(). */
+#define tmrCOMMAND_EXECUTE_CALLBACK			( ( portBASE_TYPE ) -1 )
+
 /*-----------------------------------------------------------
  * MACROS AND DEFINITIONS
  *----------------------------------------------------------*/
@@ -102,6 +105,10 @@ typedef void * xTimerHandle;
 /* Define the prototype to which timer callback functions must conform. */
 typedef void (*tmrTIMER_CALLBACK)( xTimerHandle xTimer );
 
+/* Define the prototype to which functions used with the
+xTimerPendFunctionCallFromISR() function must conform. */
+typedef void (*PendedFunction_t)( void *, unsigned long );
+
 /**
  * xTimerHandle xTimerCreate( 	const signed char *pcTimerName,
  * 								portTickType xTimerPeriodInTicks,
@@ -943,6 +950,130 @@ xTaskHandle xTimerGetTimerDaemonTaskHandle( void );
  */
 #define xTimerResetFromISR( xTimer, pxHigherPriorityTaskWoken ) xTimerGenericCommand( ( xTimer ), tmrCOMMAND_START, ( xTaskGetTickCountFromISR() ), ( pxHigherPriorityTaskWoken ), 0U )
 
+/**
+ * portBASE_TYPE xTimerPendFunctionCallFromISR( PendedFunction_t xFunctionToPend,
+ *                                              void *pvParameter1,
+ *                                              unsigned long ulParameter2,
+ *                                              portBASE_TYPE *pxHigherPriorityTaskWoken );
+ *
+ * Used from application interrupt service routines to defer the execution of a
+ * function to the RTOS daemon task (the timer service task, hence this function
+ * is implemented in timers.c and is prefixed with 'Timer').
+ *
+ * Ideally an interrupt service routine (ISR) is kept as short as possible, but
+ * sometimes an ISR either has a lot of processing to do, or needs to perform
+ * processing that is not deterministic.  In these cases
+ * xTimerPendFunctionCallFromISR() can be used to defer processing of a function
+ * to the RTOS daemon task.  The daemon task runs it as soon as it is the
+ * highest priority ready task, without waiting for a tick, so giving the
+ * daemon a high configTIMER_TASK_PRIORITY bounds the latency.
+ *
+ * A mechanism is provided that allows the interrupt to return directly to the
+ * task that will subsequently execute the pended callback function.  This
+ * allows the callback function to execute contiguously in time with the
+ * interrupt - just as if the callback had executed in the interrupt itself.
+ *
+ * The pended calls share the timer command queue (configTIMER_QUEUE_LENGTH
+ * entries) with the timer commands.
+ *
+ * @param xFunctionToPend The function to execute from the timer service/
+ * daemon task.  The function must conform to the PendedFunction_t
+ * prototype.
+ *
+ * @param pvParameter1 The value of the callback function's first parameter.
+ * The parameter has a void * type to allow it to be used to pass any type.
+ * For example, unsigned longs can be cast to a void *, or the void * can be
+ * used to point to a structure.
+ *
+ * @param ulParameter2 The value of the callback function's second parameter.
+ *
+ * @param pxHigherPriorityTaskWoken As mentioned above, calling this function
+ * will result in a message being sent to the timer daemon task.  If the
+ * priority of the timer daemon task (which is set using
+ * configTIMER_TASK_PRIORITY in FreeRTOSConfig.h) is higher than the priority
+ * of the currently running task (the task the interrupt interrupted) then
+ * *pxHigherPriorityTaskWoken will be set to pdTRUE within
+ * xTimerPendFunctionCallFromISR(), indicating that a context switch should be
+ * requested before the interrupt exits.  For that reason
+ * *pxHigherPriorityTaskWoken must be initialised to pdFALSE.  See the
+ * example application code below.
+ *
+ * @return pdPASS is returned if the message was successfully sent to the
+ * timer daemon task, otherwise pdFALSE is returned.
+ *
+ * Example usage:
+ * @verbatim
+ *
+ *	// The callback function that will execute in the context of the daemon task.
+ *  // Note callback functions must all use this same prototype.
+ *  void vProcessInterface( void *pvParameter1, unsigned long ulParameter2 )
+ *	{
+ *		portBASE_TYPE xInterfaceToService;
+ *
+ *		// The interface that requires servicing is passed in the second
+ *      // parameter.  The first parameter is not used in this case.
+ *		xInterfaceToService = ( portBASE_TYPE ) ulParameter2;
+ *
+ *		// ...Perform the processing here...
+ *	}
+ *
+ *	// An ISR that receives data packets from multiple interfaces
+ *  void vAnISR( void )
+ *	{
+ *		portBASE_TYPE xInterfaceToService, xHigherPriorityTaskWoken;
+ *
+ *		// Query the hardware to determine which interface needs processing.
+ *		xInterfaceToService = prvCheckInterfaces();
+ *
+ *      // The actual processing is to be deferred to a task.  Request the
+ *      // vProcessInterface() callback function is executed, passing in the
+ *		// number of the interface that needs processing.  The interface to
+ *		// service is passed in the second parameter.  The first parameter is
+ *		// not used in this case.
+ *		xHigherPriorityTaskWoken = pdFALSE;
+ *		xTimerPendFunctionCallFromISR( vProcessInterface, NULL, ( unsigned long ) xInterfaceToService, &xHigherPriorityTaskWoken );
+ *
+ *		// If xHigherPriorityTaskWoken is now set to pdTRUE then a context
+ *		// switch should be requested.
+ *		if( xHigherPriorityTaskWoken )
+ *			portYIELD();
+ *	}
+ * @endverbatim
+ */
+portBASE_TYPE xTimerPendFunctionCallFromISR( PendedFunction_t xFunctionToPend, void *pvParameter1, unsigned long ulParameter2, portBASE_TYPE *pxHigherPriorityTaskWoken ) PRIVILEGED_FUNCTION;
+
+/**
+ * portBASE_TYPE xTimerPendFunctionCall( PendedFunction_t xFunctionToPend,
+ *                                       void *pvParameter1,
+ *                                       unsigned long ulParameter2,
+ *                                       portTickType xTicksToWait );
+ *
+ * Used to defer the execution of a function to the RTOS daemon task (the timer
+ * service task, hence this function is implemented in timers.c and is prefixed
+ * with 'Timer').
+ *
+ * @param xFunctionToPend The function to execute from the timer service/
+ * daemon task.  The function must conform to the PendedFunction_t
+ * prototype.
+ *
+ * @param pvParameter1 The value of the callback function's first parameter.
+ *
+ * @param ulParameter2 The value of the callback function's second parameter.
+ *
+ * @param xTicksToWait Calling this function will result in a message being
+ * sent to the timer daemon task on a queue.  xTicksToWait is the amount of
+ * time the calling task should remain in the Blocked state (so not using any
+ * processing time) for space to become available on the timer queue if the
+ * queue is found to be full.
+ *
+ * @return pdPASS is returned if the message was successfully sent to the
+ * timer daemon task, otherwise pdFALSE is returned.
+ *
+ * Only available if INCLUDE_xTimerPendFunctionCall is 1, as are
+ * xTimerPendFunctionCallFromISR() and the esp/hrtimer.h daemon timers.
+ */
+portBASE_TYPE xTimerPendFunctionCall( PendedFunction_t xFunctionToPend, void *pvParameter1, unsigned long ulParameter2, portTickType xTicksToWait ) PRIVILEGED_FUNCTION;
+
 /*
  * Functions beyond this part are not part of the public API and are intended
  * for use by the kernel only.
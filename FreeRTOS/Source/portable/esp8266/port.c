@@ -77,6 +77,8 @@
 #include "FreeRTOS.h"
 #include "task.h"
 #include "xtensa_rtos.h"
+#include "esp/dport_regs.h"
+#include "sbrk.h"
 
 unsigned cpu_sr;
 char level1_int_disabled;
@@ -86,8 +88,10 @@ char level1_int_disabled;
 
    After tasks start, task stacks are all allocated from the heap and
    FreeRTOS checks for stack overflow.
+
+   Also used by _sbrk_r as the ceiling for heap growth.
 */
-static uint32_t xPortSupervisorStackPointer;
+uint32_t xPortSupervisorStackPointer;
 
 /*
  * Stack initialization
@@ -161,11 +165,15 @@ void IRAM SV_ISR(void)
 	}
 	if( xHigherPriorityTaskWoken || pending_soft_sv)
 	{
-	    sdk__xt_timer_int1();
+	    /* Interrupts are already masked here, so this skips the critical
+	       section the SDK's _xt_timer_int1 wraps around the same call */
+	    vTaskSwitchContext();
 	    pending_soft_sv = 0;
 	}
 }
 
+/* Called by the SDK's _xt_timer_int, which the port no longer uses for
+   the tick (see prvTickISR) */
 void xPortSysTickHandle (void)
 {
 	//CloseNMI();
@@ -178,6 +186,193 @@ void xPortSysTickHandle (void)
 	//OpenNMI();
 }
 
+static inline uint32_t prvGetCCount(void)
+{
+    uint32_t ccount;
+    __asm__ volatile ("rsr %0, ccount" : "=a" (ccount));
+    return ccount;
+}
+
+#if configGENERATE_RUN_TIME_STATS == 1
+
+/* Run time stats counter, derived from the CPU cycle counter.
+
+   CCOUNT wraps every ~53 seconds at 80MHz, so it is extended to 64 bits
+   in software. The counter is read on every context switch, which is
+   far more often than that. The value handed to FreeRTOS is shifted
+   right by configRUN_TIME_COUNTER_SHIFT so the 32-bit per-task totals
+   last a useful amount of time (~57 minutes at the default shift.)
+*/
+static uint64_t xRunTimeCycles;
+static uint32_t xRunTimeLastCCount;
+
+void vPortConfigureRunTimeStats(void)
+{
+    xRunTimeCycles = 0;
+    xRunTimeLastCCount = prvGetCCount();
+}
+
+unsigned long IRAM ulPortGetRunTimeCounterValue(void)
+{
+    uint32_t ps = _xt_disable_interrupts();
+    uint32_t ccount = prvGetCCount();
+    xRunTimeCycles += ccount - xRunTimeLastCCount;
+    xRunTimeLastCCount = ccount;
+    uint64_t cycles = xRunTimeCycles;
+    _xt_restore_interrupts(ps);
+    return (unsigned long)(cycles >> configRUN_TIME_COUNTER_SHIFT);
+}
+
+#endif /* configGENERATE_RUN_TIME_STATS */
+
+/* The port drives the tick from CCOMPARE0 itself. The SDK's
+   _xt_timer_int is built for a 100Hz tick whatever configTICK_RATE_HZ
+   says, and calls xPortSysTickHandle from flash; prvTickISR and all it
+   calls are in IRAM, so even at 1000Hz a tick never waits on the flash
+   cache. With tickless idle the compare is also pushed out across idle
+   periods.
+
+   xNextTickCycle is the CCOUNT value of the next tick boundary. It's
+   kept separately from CCOMPARE0 so tick phase is preserved when the
+   compare is temporarily moved elsewhere.
+*/
+_Static_assert(configTICK_RATE_HZ <= 1000, "configTICK_RATE_HZ above 1000 makes portTICK_RATE_MS zero");
+
+static uint32_t xTickCycles;
+static uint32_t xNextTickCycle;
+
+/* A compare less than this many cycles away may be missed, so is taken
+   as passed. Also, don't bother sleeping if we'd wake up within it. */
+#define portMIN_SLEEP_CYCLES 2000
+
+#if configUSE_TICKLESS_IDLE != 0
+static volatile bool xTicklessSleeping;
+#endif
+
+static inline void prvSetCCompare(uint32_t value)
+{
+    __asm__ volatile ("wsr %0, ccompare0; esync" :: "a" (value));
+}
+
+static void IRAM prvTickISR(void)
+{
+    portBASE_TYPE xSwitchRequired = pdFALSE;
+    uint32_t ticks = 1;
+    int32_t behind;
+
+#if configUSE_TICKLESS_IDLE != 0
+    if(xTicklessSleeping) {
+        /* Woke from suppressed-tick sleep. Writing CCOMPARE0 clears the
+           interrupt, vPortSuppressTicksAndSleep does the accounting. */
+        prvSetCCompare(xNextTickCycle);
+        xTicklessSleeping = false;
+        return;
+    }
+#endif
+
+    xNextTickCycle += xTickCycles;
+    behind = (int32_t)(prvGetCCount() - xNextTickCycle) + portMIN_SLEEP_CYCLES;
+    if(behind > 0) {
+        /* Interrupts were held off for more than a tick (a flash erase, a
+           long critical section.) Count every boundary that passed, so
+           the tick count keeps time, and stay in phase. */
+        uint32_t missed = (uint32_t)behind / xTickCycles + 1;
+        xNextTickCycle += missed * xTickCycles;
+        ticks += missed;
+    }
+    prvSetCCompare(xNextTickCycle);
+
+    /* xTaskIncrementTick only walks the delayed list when a task is due,
+       and the switch is only made if it found one to run */
+    while(ticks--) {
+        if(xTaskIncrementTick() != pdFALSE)
+            xSwitchRequired = pdTRUE;
+    }
+    if(xSwitchRequired)
+        vTaskSwitchContext();
+}
+
+static void prvTickTimerInit(void)
+{
+    xTickCycles = configCPU_CLOCK_HZ / configTICK_RATE_HZ;
+    if(DPORT.CPU_CLOCK & DPORT_CPU_CLOCK_X2)
+        xTickCycles *= 2;
+    xNextTickCycle = prvGetCCount() + xTickCycles;
+    prvSetCCompare(xNextTickCycle);
+}
+
+void vPortCpuFreqChanged(void)
+{
+    uint32_t ps = _xt_disable_interrupts();
+    prvTickTimerInit();
+    _xt_restore_interrupts(ps);
+}
+
+#if configUSE_TICKLESS_IDLE != 0
+
+void IRAM vPortSuppressTicksAndSleep(portTickType xExpectedIdleTime)
+{
+    const portTickType xMaxIdleTime = 0x7fffffff / xTickCycles;
+    uint32_t ps, ccount, wake, elapsed;
+    portTickType xCompleteTicks;
+
+    if(xExpectedIdleTime > xMaxIdleTime)
+        xExpectedIdleTime = xMaxIdleTime;
+
+    ps = _xt_disable_interrupts();
+
+    if(eTaskConfirmSleepModeStatus() == eAbortSleep) {
+        _xt_restore_interrupts(ps);
+        return;
+    }
+
+    /* xNextTickCycle is the boundary of the first tick we are skipping,
+       so the wake up point is (xExpectedIdleTime - 1) ticks after it. */
+    wake = xNextTickCycle + (xExpectedIdleTime - 1) * xTickCycles;
+    if((int32_t)(wake - prvGetCCount()) < portMIN_SLEEP_CYCLES) {
+        _xt_restore_interrupts(ps);
+        return;
+    }
+
+    xTicklessSleeping = true;
+    prvSetCCompare(wake);
+
+    /* waiti lowers the interrupt level to 0 and halts the core until an
+       interrupt arrives, which will be serviced before we continue. */
+    __asm__ volatile ("waiti 0");
+    _xt_disable_interrupts();
+
+    ccount = prvGetCCount();
+    xTicklessSleeping = false;
+
+    /* Count the tick boundaries that passed while asleep. The last one
+       is left for a real tick interrupt, so tasks unblocked by it are
+       released through xTaskIncrementTick as usual. */
+    elapsed = ccount - xNextTickCycle;
+    if((int32_t)elapsed < 0) {
+        xCompleteTicks = 0;
+    } else {
+        xCompleteTicks = elapsed / xTickCycles + 1;
+        if(xCompleteTicks > xExpectedIdleTime)
+            xCompleteTicks = xExpectedIdleTime;
+    }
+
+    if(xCompleteTicks > 1)
+        vTaskStepTick(xCompleteTicks - 1);
+
+    if(xCompleteTicks > 0) {
+        xNextTickCycle += (xCompleteTicks - 1) * xTickCycles;
+        /* That boundary has already passed, fire the tick straight away */
+        prvSetCCompare(ccount + portMIN_SLEEP_CYCLES);
+    } else {
+        prvSetCCompare(xNextTickCycle);
+    }
+
+    _xt_restore_interrupts(ps);
+}
+
+#endif /* configUSE_TICKLESS_IDLE */
+
 static bool sdk_compat_initialised;
 void sdk_compat_initialise(void);
 
@@ -198,9 +393,9 @@ portBASE_TYPE xPortStartScheduler( void )
     }
 
     /* Initialize system tick timer interrupt and schedule the first tick. */
-    _xt_isr_attach(INUM_TICK, sdk__xt_timer_int);
+    _xt_isr_attach(INUM_TICK, prvTickISR);
     _xt_isr_unmask(BIT(INUM_TICK));
-    sdk__xt_tick_timer_init();
+    prvTickTimerInit();
 
     vTaskSwitchContext();
 
@@ -232,7 +427,10 @@ size_t xPortGetFreeHeapSize( void )
     uint32_t sp = xPortSupervisorStackPointer;
     if(sp == 0) /* scheduler not started */
         __asm__ __volatile__ ("mov %0, a1\n" : "=a"(sp));
-    return sp - brk_val + mi.fordblks;
+    /* _sbrk_r won't hand out the last SBRK_STACK_RESERVE bytes */
+    if(sp - brk_val < SBRK_STACK_RESERVE)
+        return mi.fordblks;
+    return sp - SBRK_STACK_RESERVE - brk_val + mi.fordblks;
 }
 
 void vPortEndScheduler( void )
@@ -242,12 +440,12 @@ void vPortEndScheduler( void )
 
 /*-----------------------------------------------------------*/
 
-/* Each task maintains its own interrupt status in the critical nesting
-variable. */
-static unsigned portBASE_TYPE uxCriticalNesting = 0;
+/* Critical section nesting count, see portmacro.h */
+unsigned portBASE_TYPE uxPortCriticalNesting = 0;
 
-/* These nested vPortEnter/ExitCritical macros are called by SDK
- * libraries in libmain, libnet80211, libpp
+/* These nested vPortEnter/ExitCritical functions are called by SDK
+ * libraries in libmain, libnet80211, libpp. Everything else inlines
+ * them via portENTER_CRITICAL/portEXIT_CRITICAL.
  *
  * It may be possible to replace the global nesting count variable
  * with a save/restore of interrupt level, although it's difficult as
@@ -255,15 +453,12 @@ static unsigned portBASE_TYPE uxCriticalNesting = 0;
  */
 void IRAM vPortEnterCritical( void )
 {
-    portDISABLE_INTERRUPTS();
-    uxCriticalNesting++;
+    vPortEnterCriticalInline();
 }
 /*-----------------------------------------------------------*/
 
 void IRAM vPortExitCritical( void )
 {
-    uxCriticalNesting--;
-    if( uxCriticalNesting == 0 )
-	portENABLE_INTERRUPTS();
+    vPortExitCriticalInline();
 }
 
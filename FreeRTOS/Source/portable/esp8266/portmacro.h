@@ -75,6 +75,8 @@ extern "C" {
 #include <stdint.h>
 #include "xtensa_rtos.h"
 #include <esp/interrupts.h>
+#include <esp/trace.h>
+#include <esp/stackmon.h>
 
 /*-----------------------------------------------------------
  * Port specific definitions for ESP8266
@@ -168,12 +170,98 @@ inline static __attribute__((always_inline)) void portENABLE_INTERRUPTS(void)
     }
 }
 
-/* Critical section management. */
+/* Critical section management.
+
+   vPortEnterCritical/vPortExitCritical are called from the SDK
+   libraries, the kernel and our own code use the inline versions
+   below. They share the nesting count and the saved PS (cpu_sr) so
+   all of them nest with each other.
+
+   A single count is enough, where ports on other CPUs keep one per
+   task: a yield inside a critical section only pends the soft
+   interrupt, so no context switch happens until the outermost exit.
+*/
 void vPortEnterCritical( void );
 void vPortExitCritical( void );
 
-#define portENTER_CRITICAL()                vPortEnterCritical()
-#define portEXIT_CRITICAL()                 vPortExitCritical()
+extern unsigned portBASE_TYPE uxPortCriticalNesting;
+
+inline static __attribute__((always_inline)) void vPortEnterCriticalInline(void)
+{
+    portDISABLE_INTERRUPTS();
+    uxPortCriticalNesting++;
+}
+
+inline static __attribute__((always_inline)) void vPortExitCriticalInline(void)
+{
+    if(--uxPortCriticalNesting == 0)
+        portENABLE_INTERRUPTS();
+}
+
+/* Lowest supervisor stack pointer before the scheduler started, 0 until then */
+extern uint32_t xPortSupervisorStackPointer;
+
+#define portENTER_CRITICAL()                vPortEnterCriticalInline()
+#define portEXIT_CRITICAL()                 vPortExitCriticalInline()
+
+/* Task level exclusion that leaves interrupts enabled: no other task
+   runs until the matching unlock, but interrupt handlers still do, so
+   interrupt latency isn't affected. Nests. Don't block while holding
+   it, and use a critical section for data shared with interrupt
+   handlers. Needs task.h. */
+#define portSCHEDULER_LOCK()                vTaskSuspendAll()
+#define portSCHEDULER_UNLOCK()              ( ( void ) xTaskResumeAll() )
+
+/* Run time stats counter, see ulPortGetRunTimeCounterValue in port.c */
+#if configGENERATE_RUN_TIME_STATS == 1
+void vPortConfigureRunTimeStats(void);
+unsigned long ulPortGetRunTimeCounterValue(void);
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS() vPortConfigureRunTimeStats()
+#define portGET_RUN_TIME_COUNTER_VALUE() ulPortGetRunTimeCounterValue()
+#endif
+
+/* Tickless idle support, see vPortSuppressTicksAndSleep in port.c */
+#if configUSE_TICKLESS_IDLE != 0
+void vPortSuppressTicksAndSleep(portTickType xExpectedIdleTime);
+#define portSUPPRESS_TICKS_AND_SLEEP( xExpectedIdleTime ) vPortSuppressTicksAndSleep( xExpectedIdleTime )
+#endif
+
+/* Called by cpu_set_freq() after the CPU clock changed, to rescale the
+   tick when the port drives it from CCOUNT */
+void vPortCpuFreqChanged(void);
+
+/* Kernel trace hooks, recording into the esp/trace.h ring buffer */
+#if ESP_TRACE
+#define traceTASK_SWITCHED_IN() trace_record(TRACE_TASK_SWITCH, (uint32_t)pxCurrentTCB)
+#define portTRACE_TASK_CREATE(pxNewTCB) trace_task_created(pxNewTCB, (const char *)(pxNewTCB)->pcTaskName)
+#define portTRACE_TASK_DELETE(pxTCB) trace_record(TRACE_TASK_DELETE, (uint32_t)(pxTCB))
+#define traceQUEUE_SEND(pxQueue) trace_record(TRACE_QUEUE_SEND, (uint32_t)(pxQueue))
+#define traceQUEUE_SEND_FROM_ISR(pxQueue) trace_record(TRACE_QUEUE_SEND_FROM_ISR, (uint32_t)(pxQueue))
+#define traceQUEUE_RECEIVE(pxQueue) trace_record(TRACE_QUEUE_RECEIVE, (uint32_t)(pxQueue))
+#define traceQUEUE_RECEIVE_FROM_ISR(pxQueue) trace_record(TRACE_QUEUE_RECEIVE_FROM_ISR, (uint32_t)(pxQueue))
+#define traceBLOCKING_ON_QUEUE_SEND(pxQueue) trace_record(TRACE_QUEUE_BLOCK_SEND, (uint32_t)(pxQueue))
+#define traceBLOCKING_ON_QUEUE_RECEIVE(pxQueue) trace_record(TRACE_QUEUE_BLOCK_RECEIVE, (uint32_t)(pxQueue))
+#endif
+
+/* Task stack sizes, for esp/stackmon.h. traceTASK_CREATE is expanded in
+   xTaskGenericCreate(), where usStackDepth is the stack size. */
+#if ESP_STACKMON
+#define portSTACKMON_TASK_CREATE(pxNewTCB) stackmon_task_created(pxNewTCB, (const char *)(pxNewTCB)->pcTaskName, usStackDepth)
+#define portSTACKMON_TASK_DELETE(pxTCB) stackmon_task_deleted(pxTCB)
+#endif
+
+#if ESP_TRACE || ESP_STACKMON
+#ifndef portTRACE_TASK_CREATE
+#define portTRACE_TASK_CREATE(pxNewTCB)
+#define portTRACE_TASK_DELETE(pxTCB)
+#endif
+#ifndef portSTACKMON_TASK_CREATE
+#define portSTACKMON_TASK_CREATE(pxNewTCB)
+#define portSTACKMON_TASK_DELETE(pxTCB)
+#endif
+#define traceTASK_CREATE(pxNewTCB) do { portTRACE_TASK_CREATE(pxNewTCB); portSTACKMON_TASK_CREATE(pxNewTCB); } while (0)
+#define traceTASK_DELETE(pxTCB) do { portTRACE_TASK_DELETE(pxTCB); portSTACKMON_TASK_DELETE(pxTCB); } while (0)
+#endif
 
 /* Task function macros as described on the FreeRTOS.org WEB site.  These are
 not necessary for to use this port.  They are defined so the common demo files
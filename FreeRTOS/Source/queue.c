@@ -146,7 +146,12 @@ typedef struct QueueDefinition
 		struct QueueDefinition *pxQueueSetContainer;
 	#endif
 
+	unsigned char ucStaticallyAllocated;	/*< pdTRUE if the structure and storage were supplied by the caller, and so aren't freed by vQueueDelete(). */
+
 } xQUEUE;
+
+/* StaticQueue_t in queue.h must be laid out to be the same size. */
+_Static_assert( sizeof( StaticQueue_t ) == sizeof( xQUEUE ), "StaticQueue_t doesn't match xQUEUE" );
 /*-----------------------------------------------------------*/
 
 /*
@@ -279,16 +284,40 @@ xQUEUE * const pxQueue = ( xQUEUE * ) xQueue;
 }
 /*-----------------------------------------------------------*/
 
+static void prvInitialiseNewQueue( xQUEUE *pxNewQueue, unsigned portBASE_TYPE uxQueueLength, unsigned portBASE_TYPE uxItemSize, unsigned char ucQueueType )
+{
+	/* Remove compiler warnings about unused parameters should
+	configUSE_TRACE_FACILITY not be set to 1. */
+	( void ) ucQueueType;
+
+	/* Initialise the queue members as described above where the
+	queue type is defined.  pcHead has already been set. */
+	pxNewQueue->uxLength = uxQueueLength;
+	pxNewQueue->uxItemSize = uxItemSize;
+	( void ) xQueueGenericReset( pxNewQueue, pdTRUE );
+
+	#if ( configUSE_TRACE_FACILITY == 1 )
+	{
+		pxNewQueue->ucQueueType = ucQueueType;
+	}
+	#endif /* configUSE_TRACE_FACILITY */
+
+	#if( configUSE_QUEUE_SETS == 1 )
+	{
+		pxNewQueue->pxQueueSetContainer = NULL;
+	}
+	#endif /* configUSE_QUEUE_SETS */
+
+	traceQUEUE_CREATE( pxNewQueue );
+}
+/*-----------------------------------------------------------*/
+
 xQueueHandle xQueueGenericCreate( unsigned portBASE_TYPE uxQueueLength, unsigned portBASE_TYPE uxItemSize, unsigned char ucQueueType )
 {
 xQUEUE *pxNewQueue;
 size_t xQueueSizeInBytes;
 xQueueHandle xReturn = NULL;
 
-	/* Remove compiler warnings about unused parameters should
-	configUSE_TRACE_FACILITY not be set to 1. */
-	( void ) ucQueueType;
-
 	/* Allocate the new queue structure. */
 	if( uxQueueLength > ( unsigned portBASE_TYPE ) 0 )
 	{
@@ -302,25 +331,8 @@ xQueueHandle xReturn = NULL;
 			pxNewQueue->pcHead = ( signed char * ) pvPortMalloc( xQueueSizeInBytes );
 			if( pxNewQueue->pcHead != NULL )
 			{
-				/* Initialise the queue members as described above where the
-				queue type is defined. */
-				pxNewQueue->uxLength = uxQueueLength;
-				pxNewQueue->uxItemSize = uxItemSize;
-				( void ) xQueueGenericReset( pxNewQueue, pdTRUE );
-
-				#if ( configUSE_TRACE_FACILITY == 1 )
-				{
-					pxNewQueue->ucQueueType = ucQueueType;
-				}
-				#endif /* configUSE_TRACE_FACILITY */
-
-				#if( configUSE_QUEUE_SETS == 1 )
-				{
-					pxNewQueue->pxQueueSetContainer = NULL;
-				}
-				#endif /* configUSE_QUEUE_SETS */
-
-				traceQUEUE_CREATE( pxNewQueue );
+				pxNewQueue->ucStaticallyAllocated = pdFALSE;
+				prvInitialiseNewQueue( pxNewQueue, uxQueueLength, uxItemSize, ucQueueType );
 				xReturn = pxNewQueue;
 			}
 			else
@@ -337,67 +349,129 @@ xQueueHandle xReturn = NULL;
 }
 /*-----------------------------------------------------------*/
 
+xQueueHandle xQueueGenericCreateStatic( unsigned portBASE_TYPE uxQueueLength, unsigned portBASE_TYPE uxItemSize, unsigned char *pucQueueStorage, StaticQueue_t *pxStaticQueue, unsigned char ucQueueType )
+{
+xQUEUE *pxNewQueue = ( xQUEUE * ) pxStaticQueue;
+
+	configASSERT( pxStaticQueue );
+	configASSERT( uxQueueLength > ( unsigned portBASE_TYPE ) 0 );
+	configASSERT( ( pucQueueStorage != NULL ) || ( uxItemSize == ( unsigned portBASE_TYPE ) 0 ) );
+
+	if( ( pxNewQueue == NULL ) || ( uxQueueLength == ( unsigned portBASE_TYPE ) 0 ) ||
+		( ( pucQueueStorage == NULL ) && ( uxItemSize != ( unsigned portBASE_TYPE ) 0 ) ) )
+	{
+		traceQUEUE_CREATE_FAILED( ucQueueType );
+		return NULL;
+	}
+
+	/* The tail marker byte is never accessed, so the storage only needs to
+	hold the items.  Semaphores have no storage, but pcHead must not be NULL
+	(queueQUEUE_IS_MUTEX) so it points at the structure itself. */
+	if( uxItemSize == ( unsigned portBASE_TYPE ) 0 )
+	{
+		pxNewQueue->pcHead = ( signed char * ) pxNewQueue;
+	}
+	else
+	{
+		pxNewQueue->pcHead = ( signed char * ) pucQueueStorage;
+	}
+
+	pxNewQueue->ucStaticallyAllocated = pdTRUE;
+	prvInitialiseNewQueue( pxNewQueue, uxQueueLength, uxItemSize, ucQueueType );
+
+	return pxNewQueue;
+}
+/*-----------------------------------------------------------*/
+
 #if ( configUSE_MUTEXES == 1 )
+
+	static void prvInitialiseMutex( xQUEUE *pxNewQueue, unsigned char ucQueueType );
+
 	xQueueHandle xQueueCreateMutex( unsigned char ucQueueType )
 	{
 	xQUEUE *pxNewQueue;
 
-		/* Prevent compiler warnings about unused parameters if
-		configUSE_TRACE_FACILITY does not equal 1. */
-		( void ) ucQueueType;
-
 		/* Allocate the new queue structure. */
 		pxNewQueue = ( xQUEUE * ) pvPortMalloc( sizeof( xQUEUE ) );
 		if( pxNewQueue != NULL )
 		{
-			/* Information required for priority inheritance. */
-			pxNewQueue->pxMutexHolder = NULL;
-			pxNewQueue->uxQueueType = queueQUEUE_IS_MUTEX;
-
-			/* Queues used as a mutex no data is actually copied into or out
-			of the queue. */
-			pxNewQueue->pcWriteTo = NULL;
-			pxNewQueue->u.pcReadFrom = NULL;
-
-			/* Each mutex has a length of 1 (like a binary semaphore) and
-			an item size of 0 as nothing is actually copied into or out
-			of the mutex. */
-			pxNewQueue->uxMessagesWaiting = ( unsigned portBASE_TYPE ) 0U;
-			pxNewQueue->uxLength = ( unsigned portBASE_TYPE ) 1U;
-			pxNewQueue->uxItemSize = ( unsigned portBASE_TYPE ) 0U;
-			pxNewQueue->xRxLock = queueUNLOCKED;
-			pxNewQueue->xTxLock = queueUNLOCKED;
-
-			#if ( configUSE_TRACE_FACILITY == 1 )
-			{
-				pxNewQueue->ucQueueType = ucQueueType;
-			}
-			#endif
+			pxNewQueue->ucStaticallyAllocated = pdFALSE;
+			prvInitialiseMutex( pxNewQueue, ucQueueType );
+		}
+		else
+		{
+			traceCREATE_MUTEX_FAILED();
+		}
 
-			#if ( configUSE_QUEUE_SETS == 1 )
-			{
-				pxNewQueue->pxQueueSetContainer = NULL;
-			}
-			#endif
+		configASSERT( pxNewQueue );
+		return pxNewQueue;
+	}
 
-			/* Ensure the event queues start with the correct state. */
-			vListInitialise( &( pxNewQueue->xTasksWaitingToSend ) );
-			vListInitialise( &( pxNewQueue->xTasksWaitingToReceive ) );
+	xQueueHandle xQueueCreateMutexStatic( unsigned char ucQueueType, StaticQueue_t *pxStaticQueue )
+	{
+	xQUEUE *pxNewQueue = ( xQUEUE * ) pxStaticQueue;
 
-			traceCREATE_MUTEX( pxNewQueue );
+		configASSERT( pxNewQueue );
 
-			/* Start with the semaphore in the expected state. */
-			( void ) xQueueGenericSend( pxNewQueue, NULL, ( portTickType ) 0U, queueSEND_TO_BACK );
+		if( pxNewQueue != NULL )
+		{
+			pxNewQueue->ucStaticallyAllocated = pdTRUE;
+			prvInitialiseMutex( pxNewQueue, ucQueueType );
 		}
 		else
 		{
 			traceCREATE_MUTEX_FAILED();
 		}
 
-		configASSERT( pxNewQueue );
 		return pxNewQueue;
 	}
 
+	static void prvInitialiseMutex( xQUEUE *pxNewQueue, unsigned char ucQueueType )
+	{
+		/* Prevent compiler warnings about unused parameters if
+		configUSE_TRACE_FACILITY does not equal 1. */
+		( void ) ucQueueType;
+
+		/* Information required for priority inheritance. */
+		pxNewQueue->pxMutexHolder = NULL;
+		pxNewQueue->uxQueueType = queueQUEUE_IS_MUTEX;
+
+		/* Queues used as a mutex no data is actually copied into or out
+		of the queue. */
+		pxNewQueue->pcWriteTo = NULL;
+		pxNewQueue->u.pcReadFrom = NULL;
+
+		/* Each mutex has a length of 1 (like a binary semaphore) and
+		an item size of 0 as nothing is actually copied into or out
+		of the mutex. */
+		pxNewQueue->uxMessagesWaiting = ( unsigned portBASE_TYPE ) 0U;
+		pxNewQueue->uxLength = ( unsigned portBASE_TYPE ) 1U;
+		pxNewQueue->uxItemSize = ( unsigned portBASE_TYPE ) 0U;
+		pxNewQueue->xRxLock = queueUNLOCKED;
+		pxNewQueue->xTxLock = queueUNLOCKED;
+
+		#if ( configUSE_TRACE_FACILITY == 1 )
+		{
+			pxNewQueue->ucQueueType = ucQueueType;
+		}
+		#endif
+
+		#if ( configUSE_QUEUE_SETS == 1 )
+		{
+			pxNewQueue->pxQueueSetContainer = NULL;
+		}
+		#endif
+
+		/* Ensure the event queues start with the correct state. */
+		vListInitialise( &( pxNewQueue->xTasksWaitingToSend ) );
+		vListInitialise( &( pxNewQueue->xTasksWaitingToReceive ) );
+
+		traceCREATE_MUTEX( pxNewQueue );
+
+		/* Start with the semaphore in the expected state. */
+		( void ) xQueueGenericSend( pxNewQueue, NULL, ( portTickType ) 0U, queueSEND_TO_BACK );
+	}
+
 #endif /* configUSE_MUTEXES */
 /*-----------------------------------------------------------*/
 
@@ -541,6 +615,26 @@ xQueueHandle xReturn = NULL;
 		return xHandle;
 	}
 
+	xQueueHandle xQueueCreateCountingSemaphoreStatic( unsigned portBASE_TYPE uxCountValue, unsigned portBASE_TYPE uxInitialCount, StaticQueue_t *pxStaticQueue )
+	{
+	xQueueHandle xHandle;
+
+		xHandle = xQueueGenericCreateStatic( uxCountValue, queueSEMAPHORE_QUEUE_ITEM_LENGTH, NULL, pxStaticQueue, queueQUEUE_TYPE_COUNTING_SEMAPHORE );
+
+		if( xHandle != NULL )
+		{
+			( ( xQUEUE * ) xHandle )->uxMessagesWaiting = uxInitialCount;
+
+			traceCREATE_COUNTING_SEMAPHORE();
+		}
+		else
+		{
+			traceCREATE_COUNTING_SEMAPHORE_FAILED();
+		}
+
+		return xHandle;
+	}
+
 #endif /* configUSE_COUNTING_SEMAPHORES */
 /*-----------------------------------------------------------*/
 signed portBASE_TYPE IRAM xQueueGenericSend( xQueueHandle xQueue, const void * const pvItemToQueue, portTickType xTicksToWait, portBASE_TYPE xCopyPosition )
@@ -1340,8 +1434,11 @@ xQUEUE * const pxQueue = ( xQUEUE * ) xQueue;
 		vQueueUnregisterQueue( pxQueue );
 	}
 	#endif
-	vPortFree( pxQueue->pcHead );
-	vPortFree( pxQueue );
+	if( pxQueue->ucStaticallyAllocated == pdFALSE )
+	{
+		vPortFree( pxQueue->pcHead );
+		vPortFree( pxQueue );
+	}
 }
 /*-----------------------------------------------------------*/
 
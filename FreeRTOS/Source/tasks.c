@@ -156,10 +156,40 @@ typedef struct tskTaskControlBlock
 		stubs. Be warned that (at the time of writing) the current newlib design
 		implements a system-wide malloc() that must be provided with locks. */
 		struct _reent xNewLib_reent;
+	#elif ( configUSE_NEWLIB_REENTRANT == 2 )
+		struct _reent *pxNewLib_reent;	/*< NULL until pxTaskClaimNewlibReent(), the task uses _global_impure_ptr till then. */
 	#endif
 
+	#if ( configUSE_TASK_NOTIFICATIONS == 1 )
+		volatile unsigned long ulNotifiedValue;	/*< Value sent by the xTaskNotify() family. */
+		volatile unsigned char ucNotifyState;	/*< taskNOT_WAITING_NOTIFICATION etc. */
+	#endif
+
+	unsigned char			ucStaticallyAllocated; /*< tskSTATIC_STACK and/or tskSTATIC_TCB, for memory that isn't freed when the task is deleted. */
+
 } tskTCB;
 
+/* Values of ucNotifyState */
+#define taskNOT_WAITING_NOTIFICATION	( ( unsigned char ) 0 )
+#define taskWAITING_NOTIFICATION		( ( unsigned char ) 1 )
+#define taskNOTIFICATION_RECEIVED		( ( unsigned char ) 2 )
+
+/* Bits of ucStaticallyAllocated */
+#define tskSTATIC_STACK		( ( unsigned char ) 1 )
+#define tskSTATIC_TCB		( ( unsigned char ) 2 )
+
+/* While a task waits on an event group its xEventListItem value holds the
+bits it waits for, not its priority, and this bit is set so that priority
+changes leave the value alone. */
+#if ( configUSE_16_BIT_TICKS == 1 )
+	#define taskEVENT_LIST_ITEM_VALUE_IN_USE	0x8000U
+#else
+	#define taskEVENT_LIST_ITEM_VALUE_IN_USE	0x80000000UL
+#endif
+
+/* StaticTask_t in task.h must be laid out to be the same size. */
+_Static_assert( sizeof( StaticTask_t ) == sizeof( tskTCB ), "StaticTask_t doesn't match tskTCB" );
+
 
 /*
  * Some kernel aware debuggers require the data the debugger needs access to to
@@ -433,7 +463,12 @@ static void IRAM prvAddCurrentTaskToDelayedList( portTickType xTimeToWake ) PRIV
  * Allocates memory from the heap for a TCB and associated stack.  Checks the
  * allocation was successful.
  */
-static tskTCB *prvAllocateTCBAndStack( unsigned short usStackDepth, portSTACK_TYPE *puxStackBuffer ) PRIVILEGED_FUNCTION;
+static tskTCB *prvAllocateTCBAndStack( unsigned short usStackDepth, portSTACK_TYPE *puxStackBuffer, tskTCB *pxTCBBuffer ) PRIVILEGED_FUNCTION;
+
+/*
+ * xTaskGenericCreate(), with the TCB optionally in caller supplied memory.
+ */
+static signed portBASE_TYPE prvTaskCreate( pdTASK_CODE pxTaskCode, const signed char * const pcName, unsigned short usStackDepth, void *pvParameters, unsigned portBASE_TYPE uxPriority, xTaskHandle *pxCreatedTask, portSTACK_TYPE *puxStackBuffer, const xMemoryRegion * const xRegions, tskTCB *pxTCBBuffer ) PRIVILEGED_FUNCTION;
 
 /*
  * Fills an xTaskStatusType structure with information on each task that is
@@ -476,6 +511,29 @@ static tskTCB *prvAllocateTCBAndStack( unsigned short usStackDepth, portSTACK_TY
 #endif
 
 signed portBASE_TYPE xTaskGenericCreate( pdTASK_CODE pxTaskCode, const signed char * const pcName, unsigned short usStackDepth, void *pvParameters, unsigned portBASE_TYPE uxPriority, xTaskHandle *pxCreatedTask, portSTACK_TYPE *puxStackBuffer, const xMemoryRegion * const xRegions )
+{
+	return prvTaskCreate( pxTaskCode, pcName, usStackDepth, pvParameters, uxPriority, pxCreatedTask, puxStackBuffer, xRegions, NULL );
+}
+/*-----------------------------------------------------------*/
+
+xTaskHandle xTaskCreateStatic( pdTASK_CODE pxTaskCode, const signed char * const pcName, unsigned short usStackDepth, void *pvParameters, unsigned portBASE_TYPE uxPriority, portSTACK_TYPE *puxStackBuffer, StaticTask_t *pxTaskBuffer )
+{
+xTaskHandle xCreatedTask = NULL;
+
+	configASSERT( puxStackBuffer );
+	configASSERT( pxTaskBuffer );
+
+	if( ( puxStackBuffer == NULL ) || ( pxTaskBuffer == NULL ) )
+	{
+		return NULL;
+	}
+
+	( void ) prvTaskCreate( pxTaskCode, pcName, usStackDepth, pvParameters, uxPriority, &xCreatedTask, puxStackBuffer, NULL, ( tskTCB * ) pxTaskBuffer );
+	return xCreatedTask;
+}
+/*-----------------------------------------------------------*/
+
+static signed portBASE_TYPE prvTaskCreate( pdTASK_CODE pxTaskCode, const signed char * const pcName, unsigned short usStackDepth, void *pvParameters, unsigned portBASE_TYPE uxPriority, xTaskHandle *pxCreatedTask, portSTACK_TYPE *puxStackBuffer, const xMemoryRegion * const xRegions, tskTCB *pxTCBBuffer )
 {
 signed portBASE_TYPE xReturn;
 tskTCB * pxNewTCB;
@@ -485,7 +543,7 @@ tskTCB * pxNewTCB;
 
 	/* Allocate the memory required by the TCB and stack for the new task,
 	checking that the allocation was successful. */
-	pxNewTCB = prvAllocateTCBAndStack( usStackDepth, puxStackBuffer );
+	pxNewTCB = prvAllocateTCBAndStack( usStackDepth, puxStackBuffer, pxTCBBuffer );
 
 	if( pxNewTCB != NULL )
 	{
@@ -987,7 +1045,10 @@ tskTCB * pxNewTCB;
 				}
 				#endif
 
-				listSET_LIST_ITEM_VALUE( &( pxTCB->xEventListItem ), ( ( portTickType ) configMAX_PRIORITIES - ( portTickType ) uxNewPriority ) ); /*lint !e961 MISRA exception as the casts are only redundant for some ports. */
+				if( ( listGET_LIST_ITEM_VALUE( &( pxTCB->xEventListItem ) ) & taskEVENT_LIST_ITEM_VALUE_IN_USE ) == 0 )
+				{
+					listSET_LIST_ITEM_VALUE( &( pxTCB->xEventListItem ), ( ( portTickType ) configMAX_PRIORITIES - ( portTickType ) uxNewPriority ) ); /*lint !e961 MISRA exception as the casts are only redundant for some ports. */
+				}
 
 				/* If the task is in the blocked or suspended list we need do
 				nothing more than change it's priority variable. However, if
@@ -1343,6 +1404,14 @@ portBASE_TYPE xYieldRequired = pdFALSE;
 	previous call to vTaskSuspendAll(). */
 	configASSERT( uxSchedulerSuspended );
 
+	/* A nested resume only needs the count decremented.  Interrupts only
+	read uxSchedulerSuspended, and see it non-zero either way. */
+	if( uxSchedulerSuspended > ( unsigned portBASE_TYPE ) 1U )
+	{
+		--uxSchedulerSuspended;
+		return xAlreadyYielded;
+	}
+
 	/* It is possible that an ISR caused a task to be removed from an event
 	list while the scheduler was suspended.  If this was the case then the
 	removed task will have been added to the xPendingReadyList.  Once the
@@ -1549,6 +1618,19 @@ unsigned portBASE_TYPE uxTaskGetNumberOfTasks( void )
 #endif /* INCLUDE_xTaskGetIdleTaskHandle */
 /*----------------------------------------------------------*/
 
+#if ( configGENERATE_RUN_TIME_STATS == 1 )
+
+	unsigned long ulTaskGetIdleRunTimeCounter( void )
+	{
+		/* Brought up to date whenever the idle task is switched out, which it
+		always has been by the time another task can call this. */
+		configASSERT( ( xIdleTaskHandle != NULL ) );
+		return ( ( tskTCB * ) xIdleTaskHandle )->ulRunTimeCounter;
+	}
+
+#endif /* configGENERATE_RUN_TIME_STATS */
+/*----------------------------------------------------------*/
+
 /* This conditional compilation should use inequality to 0, not equality to 1.
 This is to ensure vTaskStepTick() is available when user defined low power mode
 implementations require configUSE_TICKLESS_IDLE to be set to a value other than
@@ -1838,6 +1920,10 @@ void vTaskSwitchContext( void )
 			structure specific to this task. */
 			_impure_ptr = &( pxCurrentTCB->xNewLib_reent );
 		}
+		#elif ( configUSE_NEWLIB_REENTRANT == 2 )
+		{
+			_impure_ptr = ( pxCurrentTCB->pxNewLib_reent != NULL ) ? pxCurrentTCB->pxNewLib_reent : _global_impure_ptr;
+		}
 		#endif /* configUSE_NEWLIB_REENTRANT */
 	}
 }
@@ -1987,6 +2073,119 @@ portBASE_TYPE xReturn;
 }
 /*-----------------------------------------------------------*/
 
+#if ( configUSE_EVENT_GROUPS == 1 )
+
+	void vTaskPlaceOnUnorderedEventList( xList * pxEventList, const portTickType xItemValue, const portTickType xTicksToWait )
+	{
+	portTickType xTimeToWake;
+
+		configASSERT( pxEventList );
+
+		/* THIS FUNCTION MUST BE CALLED WITH THE SCHEDULER SUSPENDED.  It is
+		used by the event groups implementation. */
+		configASSERT( uxSchedulerSuspended != 0 );
+
+		/* Store the item value in the event list item.  It is safe to access
+		the event list item here as interrupts won't access the event list
+		item of a task that is not in the Blocked state. */
+		listSET_LIST_ITEM_VALUE( &( pxCurrentTCB->xEventListItem ), xItemValue | taskEVENT_LIST_ITEM_VALUE_IN_USE );
+
+		/* Place the event list item of the TCB at the end of the appropriate
+		event list.  Event groups wake every task whose bits are set, so the
+		list needn't be kept in priority order. */
+		vListInsertEnd( pxEventList, &( pxCurrentTCB->xEventListItem ) );
+
+		/* The task must be removed from the ready list before it is added to
+		the blocked list.  Exclusive access can be assured to the ready list
+		as the scheduler is locked. */
+		if( uxListRemove( &( pxCurrentTCB->xGenericListItem ) ) == ( unsigned portBASE_TYPE ) 0 )
+		{
+			portRESET_READY_PRIORITY( pxCurrentTCB->uxPriority, uxTopReadyPriority );
+		}
+
+		#if ( INCLUDE_vTaskSuspend == 1 )
+		{
+			if( xTicksToWait == portMAX_DELAY )
+			{
+				vListInsertEnd( &xSuspendedTaskList, &( pxCurrentTCB->xGenericListItem ) );
+			}
+			else
+			{
+				xTimeToWake = xTickCount + xTicksToWait;
+				prvAddCurrentTaskToDelayedList( xTimeToWake );
+			}
+		}
+		#else /* INCLUDE_vTaskSuspend */
+		{
+			xTimeToWake = xTickCount + xTicksToWait;
+			prvAddCurrentTaskToDelayedList( xTimeToWake );
+		}
+		#endif /* INCLUDE_vTaskSuspend */
+	}
+
+#endif /* configUSE_EVENT_GROUPS */
+/*-----------------------------------------------------------*/
+
+#if ( configUSE_EVENT_GROUPS == 1 )
+
+	signed portBASE_TYPE xTaskRemoveFromUnorderedEventList( xListItem * pxEventListItem, const portTickType xItemValue )
+	{
+	tskTCB *pxUnblockedTCB;
+	portBASE_TYPE xReturn;
+
+		/* THIS FUNCTION MUST BE CALLED WITH THE SCHEDULER SUSPENDED.  It is
+		used by the event groups implementation. */
+		configASSERT( uxSchedulerSuspended != pdFALSE );
+
+		/* Store the new item value in the event list. */
+		listSET_LIST_ITEM_VALUE( pxEventListItem, xItemValue | taskEVENT_LIST_ITEM_VALUE_IN_USE );
+
+		/* Remove the TCB from the delayed list, and add it to the ready list.
+		Interrupts don't touch the ready lists while the scheduler is
+		suspended, they use xPendingReadyList. */
+		pxUnblockedTCB = ( tskTCB * ) listGET_LIST_ITEM_OWNER( pxEventListItem );
+		configASSERT( pxUnblockedTCB );
+		( void ) uxListRemove( pxEventListItem );
+
+		( void ) uxListRemove( &( pxUnblockedTCB->xGenericListItem ) );
+		prvAddTaskToReadyList( pxUnblockedTCB );
+
+		if( pxUnblockedTCB->uxPriority > pxCurrentTCB->uxPriority )
+		{
+			/* The unblocked task has a priority above the calling task, so
+			xTaskResumeAll() is to switch to it. */
+			xReturn = pdTRUE;
+			xYieldPending = pdTRUE;
+		}
+		else
+		{
+			xReturn = pdFALSE;
+		}
+
+		return xReturn;
+	}
+
+#endif /* configUSE_EVENT_GROUPS */
+/*-----------------------------------------------------------*/
+
+#if ( configUSE_EVENT_GROUPS == 1 )
+
+	portTickType uxTaskResetEventItemValue( void )
+	{
+	portTickType uxReturn;
+
+		uxReturn = listGET_LIST_ITEM_VALUE( &( pxCurrentTCB->xEventListItem ) );
+
+		/* Reset the event list item to its normal value - so it can be used
+		with queues and semaphores. */
+		listSET_LIST_ITEM_VALUE( &( pxCurrentTCB->xEventListItem ), ( ( portTickType ) configMAX_PRIORITIES - ( portTickType ) pxCurrentTCB->uxPriority ) ); /*lint !e961 MISRA exception as the casts are only redundant for some ports. */
+
+		return uxReturn;
+	}
+
+#endif /* configUSE_EVENT_GROUPS */
+/*-----------------------------------------------------------*/
+
 void IRAM vTaskSetTimeOutState( xTimeOutType * const pxTimeOut )
 {
 	configASSERT( pxTimeOut );
@@ -2311,7 +2510,18 @@ unsigned portBASE_TYPE x;
 		/* Initialise this task's Newlib reent structure. */
 		_REENT_INIT_PTR( ( &( pxTCB->xNewLib_reent ) ) );
 	}
+	#elif ( configUSE_NEWLIB_REENTRANT == 2 )
+	{
+		pxTCB->pxNewLib_reent = NULL;
+	}
 	#endif /* configUSE_NEWLIB_REENTRANT */
+
+	#if ( configUSE_TASK_NOTIFICATIONS == 1 )
+	{
+		pxTCB->ulNotifiedValue = 0UL;
+		pxTCB->ucNotifyState = taskNOT_WAITING_NOTIFICATION;
+	}
+	#endif /* configUSE_TASK_NOTIFICATIONS */
 }
 /*-----------------------------------------------------------*/
 
@@ -2423,16 +2633,30 @@ static void IRAM prvAddCurrentTaskToDelayedList( portTickType xTimeToWake )
 }
 /*-----------------------------------------------------------*/
 
-static tskTCB *prvAllocateTCBAndStack( unsigned short usStackDepth, portSTACK_TYPE *puxStackBuffer )
+static tskTCB *prvAllocateTCBAndStack( unsigned short usStackDepth, portSTACK_TYPE *puxStackBuffer, tskTCB *pxTCBBuffer )
 {
 tskTCB *pxNewTCB;
 
-	/* Allocate space for the TCB.  Where the memory comes from depends on
-	the implementation of the port malloc function. */
-	pxNewTCB = ( tskTCB * ) pvPortMalloc( sizeof( tskTCB ) );
+	/* Allocate space for the TCB, unless the caller supplied it.  Where the
+	memory comes from depends on the implementation of the port malloc
+	function. */
+	if( pxTCBBuffer != NULL )
+	{
+		pxNewTCB = pxTCBBuffer;
+	}
+	else
+	{
+		pxNewTCB = ( tskTCB * ) pvPortMalloc( sizeof( tskTCB ) );
+	}
 
 	if( pxNewTCB != NULL )
 	{
+		pxNewTCB->ucStaticallyAllocated = ( pxTCBBuffer != NULL ) ? tskSTATIC_TCB : 0;
+		if( puxStackBuffer != NULL )
+		{
+			pxNewTCB->ucStaticallyAllocated |= tskSTATIC_STACK;
+		}
+
 		/* Allocate space for the stack used by the task being created.
 		The base of the stack memory stored in the TCB so the task can
 		be deleted later if required. */
@@ -2441,7 +2665,10 @@ tskTCB *pxNewTCB;
 		if( pxNewTCB->pxStack == NULL )
 		{
 			/* Could not allocate the stack.  Delete the allocated TCB. */
-			vPortFree( pxNewTCB );
+			if( pxTCBBuffer == NULL )
+			{
+				vPortFree( pxNewTCB );
+			}
 			pxNewTCB = NULL;
 		}
 		else
@@ -2578,10 +2805,27 @@ tskTCB *pxNewTCB;
 		want to allocate and clean RAM statically. */
 		portCLEAN_UP_TCB( pxTCB );
 
+		#if ( configUSE_NEWLIB_REENTRANT == 2 )
+		{
+			if( pxTCB->pxNewLib_reent != NULL )
+			{
+				_reclaim_reent( pxTCB->pxNewLib_reent );
+				vPortFree( pxTCB->pxNewLib_reent );
+			}
+		}
+		#endif
+
 		/* Free up the memory allocated by the scheduler for the task.  It is up to
-		the task to free any memory allocated at the application level. */
-		vPortFreeAligned( pxTCB->pxStack );
-		vPortFree( pxTCB );
+		the task to free any memory allocated at the application level, and
+		any stack or TCB memory it supplied. */
+		if( ( pxTCB->ucStaticallyAllocated & tskSTATIC_STACK ) == 0 )
+		{
+			vPortFreeAligned( pxTCB->pxStack );
+		}
+		if( ( pxTCB->ucStaticallyAllocated & tskSTATIC_TCB ) == 0 )
+		{
+			vPortFree( pxTCB );
+		}
 	}
 
 #endif /* INCLUDE_vTaskDelete */
@@ -2604,6 +2848,45 @@ tskTCB *pxNewTCB;
 #endif /* ( ( INCLUDE_xTaskGetCurrentTaskHandle == 1 ) || ( configUSE_MUTEXES == 1 ) ) */
 /*-----------------------------------------------------------*/
 
+#if ( configUSE_NEWLIB_REENTRANT == 2 )
+
+	struct _reent *pxTaskClaimNewlibReent( void )
+	{
+	struct _reent *pxReent;
+
+		if( xSchedulerRunning == pdFALSE )
+		{
+			return _global_impure_ptr;
+		}
+
+		/* Only the task itself sets its pointer, so no need to lock to
+		read it. */
+		pxReent = pxCurrentTCB->pxNewLib_reent;
+		if( pxReent == NULL )
+		{
+			pxReent = ( struct _reent * ) pvPortMalloc( sizeof( struct _reent ) );
+			if( pxReent == NULL )
+			{
+				return _global_impure_ptr;
+			}
+			_REENT_INIT_PTR( pxReent );
+
+			/* The call that is about to have its errno read may have set it
+			in the shared context. */
+			pxReent->_errno = _global_impure_ptr->_errno;
+
+			taskENTER_CRITICAL();
+			pxCurrentTCB->pxNewLib_reent = pxReent;
+			_impure_ptr = pxReent;
+			taskEXIT_CRITICAL();
+		}
+
+		return pxReent;
+	}
+
+#endif /* configUSE_NEWLIB_REENTRANT */
+/*-----------------------------------------------------------*/
+
 #if ( ( INCLUDE_xTaskGetSchedulerState == 1 ) || ( configUSE_TIMERS == 1 ) )
 
 	portBASE_TYPE xTaskGetSchedulerState( void )
@@ -2645,7 +2928,10 @@ tskTCB *pxNewTCB;
 			if( pxTCB->uxPriority < pxCurrentTCB->uxPriority )
 			{
 				/* Adjust the mutex holder state to account for its new priority. */
-				listSET_LIST_ITEM_VALUE( &( pxTCB->xEventListItem ), ( portTickType ) configMAX_PRIORITIES - ( portTickType ) pxCurrentTCB->uxPriority ); /*lint !e961 MISRA exception as the casts are only redundant for some ports. */
+				if( ( listGET_LIST_ITEM_VALUE( &( pxTCB->xEventListItem ) ) & taskEVENT_LIST_ITEM_VALUE_IN_USE ) == 0 )
+				{
+					listSET_LIST_ITEM_VALUE( &( pxTCB->xEventListItem ), ( portTickType ) configMAX_PRIORITIES - ( portTickType ) pxCurrentTCB->uxPriority ); /*lint !e961 MISRA exception as the casts are only redundant for some ports. */
+				}
 
 				/* If the task being modified is in the ready state it will need to
 				be moved into a new list. */
@@ -2695,7 +2981,10 @@ tskTCB *pxNewTCB;
 				ready list. */
 				traceTASK_PRIORITY_DISINHERIT( pxTCB, pxTCB->uxBasePriority );
 				pxTCB->uxPriority = pxTCB->uxBasePriority;
-				listSET_LIST_ITEM_VALUE( &( pxTCB->xEventListItem ), ( portTickType ) configMAX_PRIORITIES - ( portTickType ) pxTCB->uxPriority ); /*lint !e961 MISRA exception as the casts are only redundant for some ports. */
+				if( ( listGET_LIST_ITEM_VALUE( &( pxTCB->xEventListItem ) ) & taskEVENT_LIST_ITEM_VALUE_IN_USE ) == 0 )
+				{
+					listSET_LIST_ITEM_VALUE( &( pxTCB->xEventListItem ), ( portTickType ) configMAX_PRIORITIES - ( portTickType ) pxTCB->uxPriority ); /*lint !e961 MISRA exception as the casts are only redundant for some ports. */
+				}
 				prvAddTaskToReadyList( pxTCB );
 			}
 		}
@@ -2926,6 +3215,276 @@ tskTCB *pxNewTCB;
 	}
 
 #endif /* configGENERATE_RUN_TIME_STATS */
+/*-----------------------------------------------------------*/
+
+#if ( configUSE_TASK_NOTIFICATIONS == 1 )
+
+	/* Move the current task from the ready list to the delayed (or, to wait
+	forever, suspended) list without placing it on an event list.  Called in
+	a critical section. */
+	static void prvBlockCurrentTaskForNotification( portTickType xTicksToWait )
+	{
+	portTickType xTimeToWake;
 
+		if( uxListRemove( &( pxCurrentTCB->xGenericListItem ) ) == ( unsigned portBASE_TYPE ) 0 )
+		{
+			portRESET_READY_PRIORITY( pxCurrentTCB->uxPriority, uxTopReadyPriority );
+		}
 
+		#if ( INCLUDE_vTaskSuspend == 1 )
+		{
+			if( xTicksToWait == portMAX_DELAY )
+			{
+				vListInsertEnd( &xSuspendedTaskList, &( pxCurrentTCB->xGenericListItem ) );
+				return;
+			}
+		}
+		#endif /* INCLUDE_vTaskSuspend */
+
+		xTimeToWake = xTickCount + xTicksToWait;
+		prvAddCurrentTaskToDelayedList( xTimeToWake );
+	}
+	/*-----------------------------------------------------------*/
+
+	/* Update the notification value of pxTCB for eAction.  Returns pdFAIL if
+	eSetValueWithoutOverwrite found a value already pending.  Called in a
+	critical section or an ISR. */
+	static portBASE_TYPE IRAM prvNotify( tskTCB *pxTCB, unsigned long ulValue, eNotifyAction eAction, unsigned long *pulPreviousNotificationValue, unsigned char *pucOriginalNotifyState )
+	{
+	portBASE_TYPE xReturn = pdPASS;
+
+		if( pulPreviousNotificationValue != NULL )
+		{
+			*pulPreviousNotificationValue = pxTCB->ulNotifiedValue;
+		}
+
+		*pucOriginalNotifyState = pxTCB->ucNotifyState;
+		pxTCB->ucNotifyState = taskNOTIFICATION_RECEIVED;
+
+		switch( eAction )
+		{
+			case eSetBits:
+				pxTCB->ulNotifiedValue |= ulValue;
+				break;
+
+			case eIncrement:
+				( pxTCB->ulNotifiedValue )++;
+				break;
+
+			case eSetValueWithOverwrite:
+				pxTCB->ulNotifiedValue = ulValue;
+				break;
+
+			case eSetValueWithoutOverwrite:
+				if( *pucOriginalNotifyState != taskNOTIFICATION_RECEIVED )
+				{
+					pxTCB->ulNotifiedValue = ulValue;
+				}
+				else
+				{
+					xReturn = pdFAIL;
+				}
+				break;
+
+			case eNoAction:
+			default:
+				break;
+		}
+
+		return xReturn;
+	}
+	/*-----------------------------------------------------------*/
+
+	unsigned long ulTaskNotifyTake( portBASE_TYPE xClearCountOnExit, portTickType xTicksToWait )
+	{
+	unsigned long ulReturn;
+
+		taskENTER_CRITICAL();
+		{
+			if( pxCurrentTCB->ulNotifiedValue == 0UL )
+			{
+				pxCurrentTCB->ucNotifyState = taskWAITING_NOTIFICATION;
+
+				if( xTicksToWait > ( portTickType ) 0 )
+				{
+					prvBlockCurrentTaskForNotification( xTicksToWait );
+
+					/* The yield only pends the soft interrupt, the switch
+					happens when the critical section is left. */
+					portYIELD_WITHIN_API();
+				}
+			}
+		}
+		taskEXIT_CRITICAL();
+
+		taskENTER_CRITICAL();
+		{
+			ulReturn = pxCurrentTCB->ulNotifiedValue;
+
+			if( ulReturn != 0UL )
+			{
+				if( xClearCountOnExit != pdFALSE )
+				{
+					pxCurrentTCB->ulNotifiedValue = 0UL;
+				}
+				else
+				{
+					pxCurrentTCB->ulNotifiedValue = ulReturn - 1UL;
+				}
+			}
+
+			pxCurrentTCB->ucNotifyState = taskNOT_WAITING_NOTIFICATION;
+		}
+		taskEXIT_CRITICAL();
+
+		return ulReturn;
+	}
+	/*-----------------------------------------------------------*/
+
+	portBASE_TYPE xTaskNotifyWait( unsigned long ulBitsToClearOnEntry, unsigned long ulBitsToClearOnExit, unsigned long *pulNotificationValue, portTickType xTicksToWait )
+	{
+	portBASE_TYPE xReturn;
+
+		taskENTER_CRITICAL();
+		{
+			if( pxCurrentTCB->ucNotifyState != taskNOTIFICATION_RECEIVED )
+			{
+				pxCurrentTCB->ulNotifiedValue &= ~ulBitsToClearOnEntry;
+				pxCurrentTCB->ucNotifyState = taskWAITING_NOTIFICATION;
+
+				if( xTicksToWait > ( portTickType ) 0 )
+				{
+					prvBlockCurrentTaskForNotification( xTicksToWait );
+					portYIELD_WITHIN_API();
+				}
+			}
+		}
+		taskEXIT_CRITICAL();
+
+		taskENTER_CRITICAL();
+		{
+			if( pulNotificationValue != NULL )
+			{
+				*pulNotificationValue = pxCurrentTCB->ulNotifiedValue;
+			}
+
+			if( pxCurrentTCB->ucNotifyState != taskNOTIFICATION_RECEIVED )
+			{
+				/* Timed out, or didn't wait. */
+				xReturn = pdFALSE;
+			}
+			else
+			{
+				pxCurrentTCB->ulNotifiedValue &= ~ulBitsToClearOnExit;
+				xReturn = pdTRUE;
+			}
+
+			pxCurrentTCB->ucNotifyState = taskNOT_WAITING_NOTIFICATION;
+		}
+		taskEXIT_CRITICAL();
+
+		return xReturn;
+	}
+	/*-----------------------------------------------------------*/
+
+	portBASE_TYPE xTaskGenericNotify( xTaskHandle xTaskToNotify, unsigned long ulValue, eNotifyAction eAction, unsigned long *pulPreviousNotificationValue )
+	{
+	tskTCB * const pxTCB = ( tskTCB * ) xTaskToNotify;
+	unsigned char ucOriginalNotifyState;
+	portBASE_TYPE xReturn;
+
+		configASSERT( xTaskToNotify );
+
+		taskENTER_CRITICAL();
+		{
+			xReturn = prvNotify( pxTCB, ulValue, eAction, pulPreviousNotificationValue, &ucOriginalNotifyState );
+
+			if( ucOriginalNotifyState == taskWAITING_NOTIFICATION )
+			{
+				/* The task is on the delayed or suspended list, or still in
+				a ready list if it didn't block. */
+				( void ) uxListRemove( &( pxTCB->xGenericListItem ) );
+				prvAddTaskToReadyList( pxTCB );
+
+				if( pxTCB->uxPriority > pxCurrentTCB->uxPriority )
+				{
+					portYIELD_WITHIN_API();
+				}
+			}
+		}
+		taskEXIT_CRITICAL();
+
+		return xReturn;
+	}
+	/*-----------------------------------------------------------*/
+
+	portBASE_TYPE IRAM xTaskGenericNotifyFromISR( xTaskHandle xTaskToNotify, unsigned long ulValue, eNotifyAction eAction, unsigned long *pulPreviousNotificationValue, portBASE_TYPE *pxHigherPriorityTaskWoken )
+	{
+	tskTCB * const pxTCB = ( tskTCB * ) xTaskToNotify;
+	unsigned char ucOriginalNotifyState;
+	unsigned portBASE_TYPE uxSavedInterruptStatus;
+	portBASE_TYPE xReturn;
+
+		configASSERT( xTaskToNotify );
+
+		uxSavedInterruptStatus = portSET_INTERRUPT_MASK_FROM_ISR();
+		{
+			xReturn = prvNotify( pxTCB, ulValue, eAction, pulPreviousNotificationValue, &ucOriginalNotifyState );
+
+			if( ucOriginalNotifyState == taskWAITING_NOTIFICATION )
+			{
+				if( uxSchedulerSuspended == ( unsigned portBASE_TYPE ) pdFALSE )
+				{
+					( void ) uxListRemove( &( pxTCB->xGenericListItem ) );
+					prvAddTaskToReadyList( pxTCB );
+				}
+				else
+				{
+					/* The delayed and ready lists can't be touched until the
+					scheduler is resumed, which moves the task on. */
+					vListInsertEnd( &( xPendingReadyList ), &( pxTCB->xEventListItem ) );
+				}
+
+				if( ( pxTCB->uxPriority > pxCurrentTCB->uxPriority ) && ( pxHigherPriorityTaskWoken != NULL ) )
+				{
+					*pxHigherPriorityTaskWoken = pdTRUE;
+				}
+			}
+		}
+		portCLEAR_INTERRUPT_MASK_FROM_ISR( uxSavedInterruptStatus );
+
+		return xReturn;
+	}
+	/*-----------------------------------------------------------*/
+
+	void IRAM vTaskNotifyGiveFromISR( xTaskHandle xTaskToNotify, portBASE_TYPE *pxHigherPriorityTaskWoken )
+	{
+		( void ) xTaskGenericNotifyFromISR( xTaskToNotify, 0UL, eIncrement, NULL, pxHigherPriorityTaskWoken );
+	}
+	/*-----------------------------------------------------------*/
+
+	portBASE_TYPE xTaskNotifyStateClear( xTaskHandle xTask )
+	{
+	tskTCB *pxTCB;
+	portBASE_TYPE xReturn;
+
+		pxTCB = prvGetTCBFromHandle( xTask );
+
+		taskENTER_CRITICAL();
+		{
+			if( pxTCB->ucNotifyState == taskNOTIFICATION_RECEIVED )
+			{
+				pxTCB->ucNotifyState = taskNOT_WAITING_NOTIFICATION;
+				xReturn = pdPASS;
+			}
+			else
+			{
+				xReturn = pdFAIL;
+			}
+		}
+		taskEXIT_CRITICAL();
+
+		return xReturn;
+	}
 
+#endif /* configUSE_TASK_NOTIFICATIONS */
@@ -102,13 +102,39 @@ typedef struct tmrTimerControl
 	tmrTIMER_CALLBACK		pxCallbackFunction;	/*<< The function that will be called when the timer expires. */
 } xTIMER;
 
-/* The definition of messages that can be sent and received on the timer
-queue. */
-typedef struct tmrTimerQueueMessage
+/* The definition of messages that can be sent and received on the timer queue.
+Two types of message can be queued - messages that manipulate a software timer,
+and messages that request the execution of a non-timer related callback.  The
+two message types are defined in two separate structures, xTIMER_PARAMETERS
+and xCALLBACK_PARAMETERS respectively. */
+typedef struct tmrTimerParameters
 {
-	portBASE_TYPE			xMessageID;			/*<< The command being sent to the timer service task. */
 	portTickType			xMessageValue;		/*<< An optional value used by a subset of commands, for example, when changing the period of a timer. */
 	xTIMER *				pxTimer;			/*<< The timer to which the command will be applied. */
+} xTIMER_PARAMETERS;
+
+typedef struct tmrCallbackParameters
+{
+	PendedFunction_t		pxCallbackFunction;	/*<< The callback function to execute. */
+	void *					pvParameter1;		/*<< The value that will be used as the callback functions first parameter. */
+	unsigned long			ulParameter2;		/*<< The value that will be used as the callback functions second parameter. */
+} xCALLBACK_PARAMETERS;
+
+/* The structure that contains the two message types, along with an identifier
+that is used to determine which message type is valid. */
+typedef struct tmrTimerQueueMessage
+{
+	portBASE_TYPE			xMessageID;			/*<< The command being sent to the timer service task. */
+	union
+	{
+		xTIMER_PARAMETERS xTimerParameters;
+
+		/* Don't include xCallbackParameters if it is not going to be used as
+		it makes the structure (and therefore the timer queue) larger. */
+		#if ( INCLUDE_xTimerPendFunctionCall == 1 )
+			xCALLBACK_PARAMETERS xCallbackParameters;
+		#endif /* INCLUDE_xTimerPendFunctionCall */
+	} u;
 } xTIMER_MESSAGE;
 
 /*lint -e956 A manual analysis and inspection has been used to determine which
@@ -275,8 +301,8 @@ xTIMER_MESSAGE xMessage;
 	{
 		/* Send a command to the timer service task to start the xTimer timer. */
 		xMessage.xMessageID = xCommandID;
-		xMessage.xMessageValue = xOptionalValue;
-		xMessage.pxTimer = ( xTIMER * ) xTimer;
+		xMessage.u.xTimerParameters.xMessageValue = xOptionalValue;
+		xMessage.u.xTimerParameters.pxTimer = ( xTIMER * ) xTimer;
 
 		if( pxHigherPriorityTaskWoken == NULL )
 		{
@@ -522,7 +548,26 @@ portTickType xTimeNow;
 
 	while( xQueueReceive( xTimerQueue, &xMessage, tmrNO_DELAY ) != pdFAIL ) /*lint !e603 xMessage does not have to be initialised as it is passed out, not in, and it is not used unless xQueueReceive() returns pdTRUE. */
 	{
-		pxTimer = xMessage.pxTimer;
+		#if ( INCLUDE_xTimerPendFunctionCall == 1 )
+		{
+			/* Negative commands are pended function calls rather than timer
+			commands. */
+			if( xMessage.xMessageID < ( portBASE_TYPE ) 0 )
+			{
+				const xCALLBACK_PARAMETERS * const pxCallback = &( xMessage.u.xCallbackParameters );
+
+				/* The timer uses the xCallbackParameters member to request a
+				callback be executed.  Check the callback is not NULL. */
+				configASSERT( pxCallback->pxCallbackFunction );
+
+				/* Call the function. */
+				pxCallback->pxCallbackFunction( pxCallback->pvParameter1, pxCallback->ulParameter2 );
+				continue;
+			}
+		}
+		#endif /* INCLUDE_xTimerPendFunctionCall */
+
+		pxTimer = xMessage.u.xTimerParameters.pxTimer;
 
 		if( listIS_CONTAINED_WITHIN( NULL, &( pxTimer->xTimerListItem ) ) == pdFALSE )
 		{
@@ -530,7 +575,7 @@ portTickType xTimeNow;
 			( void ) uxListRemove( &( pxTimer->xTimerListItem ) );
 		}
 
-		traceTIMER_COMMAND_RECEIVED( pxTimer, xMessage.xMessageID, xMessage.xMessageValue );
+		traceTIMER_COMMAND_RECEIVED( pxTimer, xMessage.xMessageID, xMessage.u.xTimerParameters.xMessageValue );
 
 		/* In this case the xTimerListsWereSwitched parameter is not used, but 
 		it must be present in the function call.  prvSampleTimeNow() must be 
@@ -544,7 +589,7 @@ portTickType xTimeNow;
 		{
 			case tmrCOMMAND_START :
 				/* Start or restart a timer. */
-				if( prvInsertTimerInActiveList( pxTimer,  xMessage.xMessageValue + pxTimer->xTimerPeriodInTicks, xTimeNow, xMessage.xMessageValue ) == pdTRUE )
+				if( prvInsertTimerInActiveList( pxTimer,  xMessage.u.xTimerParameters.xMessageValue + pxTimer->xTimerPeriodInTicks, xTimeNow, xMessage.u.xTimerParameters.xMessageValue ) == pdTRUE )
 				{
 					/* The timer expired before it was added to the active timer
 					list.  Process it now. */
@@ -552,7 +597,7 @@ portTickType xTimeNow;
 
 					if( pxTimer->uxAutoReload == ( unsigned portBASE_TYPE ) pdTRUE )
 					{
-						xResult = xTimerGenericCommand( pxTimer, tmrCOMMAND_START, xMessage.xMessageValue + pxTimer->xTimerPeriodInTicks, NULL, tmrNO_DELAY );
+						xResult = xTimerGenericCommand( pxTimer, tmrCOMMAND_START, xMessage.u.xTimerParameters.xMessageValue + pxTimer->xTimerPeriodInTicks, NULL, tmrNO_DELAY );
 						configASSERT( xResult );
 						( void ) xResult;
 					}
@@ -565,7 +610,7 @@ portTickType xTimeNow;
 				break;
 
 			case tmrCOMMAND_CHANGE_PERIOD :
-				pxTimer->xTimerPeriodInTicks = xMessage.xMessageValue;
+				pxTimer->xTimerPeriodInTicks = xMessage.u.xTimerParameters.xMessageValue;
 				configASSERT( ( pxTimer->xTimerPeriodInTicks > 0 ) );
 				( void ) prvInsertTimerInActiveList( pxTimer, ( xTimeNow + pxTimer->xTimerPeriodInTicks ), xTimeNow, xTimeNow );
 				break;
@@ -688,6 +733,63 @@ xTIMER *pxTimer = ( xTIMER * ) xTimer;
 }
 /*-----------------------------------------------------------*/
 
+#if( INCLUDE_xTimerPendFunctionCall == 1 )
+
+	portBASE_TYPE xTimerPendFunctionCallFromISR( PendedFunction_t xFunctionToPend, void *pvParameter1, unsigned long ulParameter2, portBASE_TYPE *pxHigherPriorityTaskWoken )
+	{
+	xTIMER_MESSAGE xMessage;
+	portBASE_TYPE xReturn;
+
+		/* Complete the message with the function parameters and post it to the
+		daemon task. */
+		xMessage.xMessageID = tmrCOMMAND_EXECUTE_CALLBACK;
+		xMessage.u.xCallbackParameters.pxCallbackFunction = xFunctionToPend;
+		xMessage.u.xCallbackParameters.pvParameter1 = pvParameter1;
+		xMessage.u.xCallbackParameters.ulParameter2 = ulParameter2;
+
+		if( xTimerQueue == NULL )
+		{
+			return pdFAIL;
+		}
+		xReturn = xQueueSendFromISR( xTimerQueue, &xMessage, pxHigherPriorityTaskWoken );
+
+		return xReturn;
+	}
+
+#endif /* INCLUDE_xTimerPendFunctionCall */
+/*-----------------------------------------------------------*/
+
+#if( INCLUDE_xTimerPendFunctionCall == 1 )
+
+	portBASE_TYPE xTimerPendFunctionCall( PendedFunction_t xFunctionToPend, void *pvParameter1, unsigned long ulParameter2, portTickType xTicksToWait )
+	{
+	xTIMER_MESSAGE xMessage;
+	portBASE_TYPE xReturn;
+
+		/* This function can only be called after a timer has been created or
+		after the scheduler has been started because, until then, the timer
+		queue does not exist. */
+		configASSERT( xTimerQueue );
+
+		/* Complete the message with the function parameters and post it to the
+		daemon task. */
+		xMessage.xMessageID = tmrCOMMAND_EXECUTE_CALLBACK;
+		xMessage.u.xCallbackParameters.pxCallbackFunction = xFunctionToPend;
+		xMessage.u.xCallbackParameters.pvParameter1 = pvParameter1;
+		xMessage.u.xCallbackParameters.ulParameter2 = ulParameter2;
+
+		if( xTaskGetSchedulerState() != taskSCHEDULER_RUNNING )
+		{
+			xTicksToWait = tmrNO_DELAY;
+		}
+		xReturn = xQueueSendToBack( xTimerQueue, &xMessage, xTicksToWait );
+
+		return xReturn;
+	}
+
+#endif /* INCLUDE_xTimerPendFunctionCall */
+/*-----------------------------------------------------------*/
+
 /* This entire source file will be skipped if the application is not configured
 to include software timer functionality.  If you want to include software timer
 functionality then ensure configUSE_TIMERS is set to 1 in FreeRTOSConfig.h. */
@@ -37,6 +37,12 @@ FLASH_MODE ?= qio
 # Flash speed in MHz, valid values are same as for esptool.py - 80, 40, 26, 20
 FLASH_SPEED ?= 40
 
+# Set to 1 to have the firmware apply FLASH_MODE and FLASH_SPEED itself at
+# startup, instead of relying on the bootloader's image header (for rboot,
+# the header written when the bootloader was flashed). A setting the flash
+# can't be read back with is ignored, see core/include/esp/flashmode.h
+FLASH_BOOT_CONFIG ?= 0
+
 # Output directories to store intermediate compiled files
 # relative to the program directory
 BUILD_DIR ?= $(PROGRAM_DIR)build/
@@ -48,6 +54,9 @@ ESPTOOL ?= esptool.py
 ESPPORT ?= /dev/ttyUSB0
 ESPBAUD ?= 115200
 
+# interpreter for the build scripts in utils/
+PYTHON ?= python3
+
 # set this to 0 if you don't need floating point support in printf/scanf
 # this will save approx 14.5KB flash space and 448 bytes of statically allocated
 # data RAM
@@ -70,12 +79,36 @@ IMGTOOL ?= esptool2
 CPPFLAGS = -DOTA
 endif
 
-FLAVOR ?= release # or debug
+FLAVOR ?= release # or debug, or size (-Os)
+
+# Set to 1 for link time optimisation of the open source components (the
+# SDK libraries are binaries, so are linked as they are). For release
+# builds. Components in LTO_EXCLUDE are compiled normally: ld/common.ld
+# places parts of these by archive and object name, which LTO's merged
+# objects don't keep. With SPLIT_SECTIONS unused code is dropped either
+# way; 'make size-report' shows what each component takes.
+LTO ?= 0
+LTO_EXCLUDE ?= mbedtls mbedtls_fast
+
+# 'make host-bench' builds the portable components (crc, fmt, the lwIP
+# checksum, rboot image parsing, the JSON parser) with the host compiler
+# against the stand-in headers in host/, and replays HOST_BENCH_ARGS (pcap
+# captures, firmware images, other data) through them, checking and timing
+# the results without flashing anything. See host/host_bench.c. By default
+# it replays HOST_CAPTURES and this program's firmware image, if built.
+HOST_CC ?= cc
+HOST_CFLAGS ?= -O2 -std=gnu99 -Wall -Werror $(HOST_EXTRA_CFLAGS)
+HOST_CAPTURES ?=
+HOST_BENCH_ARGS ?= $(HOST_CAPTURES) $(wildcard $(FW_FILE_1) $(FW_FILE))
 
 # Compiler names, etc. assume gdb
 CROSS ?= xtensa-lx106-elf-
 
+ifeq ($(LTO),1)
+AR = $(CROSS)gcc-ar
+else
 AR = $(CROSS)ar
+endif
 CC = $(CROSS)gcc
 CPP = $(CROSS)cpp
 LD = $(CROSS)gcc
@@ -101,6 +134,38 @@ OWN_LIBC ?= 1
 # Note: you will need a recent esp
 ENTRY_SYMBOL ?= call_user_start
 
+# Profile guided IRAM placement: set IRAM_HOT_FUNCS to a file listing hot
+# functions (one per line, "count function" or just "function") and up to
+# IRAM_HOT_BUDGET bytes of them are linked into IRAM instead of IROM,
+# highest count per byte first. See utils/iram_hot.py.
+IRAM_HOT_FUNCS ?=
+IRAM_HOT_BUDGET ?= 4096
+
+# Set to 1 to link the string functions, memcmp, bzero and the integer
+# division helpers from the mask ROM instead of libc and libgcc, which
+# takes them out of IROM and IRAM. See ld/rom_libc.ld, and
+# utils/rom_libc_report.py for what it saves in a given program.
+ROM_LIBC ?= 0
+
+# Set to 1 to link the SDK objects whose code doesn't need to be in IRAM
+# (never interrupt handlers or callbacks, never running with the flash
+# cache off, never called from IRAM code) into IROM instead, freeing
+# the IRAM for our own code. Decided per build from the relocations of
+# the SDK libraries and the program's components: see utils/sdk_iram.py,
+# which writes what moved and why the rest stayed to build/sdk_iram.txt.
+SDK_IRAM_PRUNE ?= 0
+
+# Optimisation overrides, added after all other compiler flags so they
+# win over the FLAVOR's level and any -O in EXTRA_CFLAGS:
+#
+#   <component>_OPT          every C and C++ file of the component
+#   <component>_OPT_<file>   one source file, by name, e.g. lwip_OPT_pbuf.c
+#
+# lwip, mbedtls and core set some in their component.mk, so their hot
+# paths stay at -O2 in FLAVOR=size builds. Set OPT_OVERRIDES=0 to ignore
+# all of them (debug builds do, so everything there is -O0).
+OPT_OVERRIDES ?= $(if $(filter debug,$(FLAVOR)),0,1)
+
 # Set this to zero if you don't want individual function & data sections
 # (some code may be slightly slower, linking will be slighty slower,
 # but compiled code size will come down a small amount.)
@@ -126,6 +191,9 @@ endif
 ifeq ($(FLAVOR),debug)
     C_CXX_FLAGS += -g -O0
     LDFLAGS += -g -O0
+else ifeq ($(FLAVOR),size)
+    C_CXX_FLAGS += -g -Os
+    LDFLAGS += -g -Os
 else ifeq ($(FLAVOR),sdklike)
     # These are flags intended to produce object code as similar as possible to
     # the output of the compiler used to build the SDK libs (for comparison of
@@ -138,18 +206,36 @@ else
     LDFLAGS += -g -O2
 endif
 
+# Objects are "fat", holding normal code as well as LTO bytecode, so
+# utils/iram_hot.py can still read function sizes from the archives
+ifeq ($(LTO),1)
+  LTO_CFLAGS = -flto -ffat-lto-objects
+  LDFLAGS += -flto -mlongcalls -mtext-section-literals $(filter -ffunction-sections -fdata-sections,$(C_CXX_FLAGS))
+endif
+
 GITSHORTREV=\"$(shell cd $(ROOT); git rev-parse --short -q HEAD 2> /dev/null)\"
 ifeq ($(GITSHORTREV),\"\")
   GITSHORTREV="\"(nogit)\"" # (same length as a short git hash)
 endif
 CPPFLAGS += -DGITSHORTREV=$(GITSHORTREV)
 
+ifeq ($(FLASH_BOOT_CONFIG),1)
+FLASH_MODE_ID_qio=0
+FLASH_MODE_ID_qout=1
+FLASH_MODE_ID_dio=2
+FLASH_MODE_ID_dout=3
+CPPFLAGS += -DFLASH_BOOT_MODE=$(FLASH_MODE_ID_$(FLASH_MODE)) -DFLASH_BOOT_SPEED=$(FLASH_SPEED)
+endif
+
 ifeq ($(OTA),0)
 LINKER_SCRIPTS  = $(ROOT)ld/nonota.ld
 else
 LINKER_SCRIPTS = $(ROOT)ld/ota.ld
 endif
 LINKER_SCRIPTS += $(ROOT)ld/common.ld $(ROOT)ld/rom.ld
+ifeq ($(ROM_LIBC),1)
+LINKER_SCRIPTS += $(ROOT)ld/rom_libc.ld
+endif
 
 ####
 #### no user configurable options below here
@@ -175,6 +261,10 @@ LIB_ARGS      = $(addprefix -l,$(LIBS))
 PROGRAM_OUT   = $(BUILD_DIR)$(PROGRAM).out
 LDFLAGS      += $(addprefix -T,$(LINKER_SCRIPTS))
 
+# ld/common.ld INCLUDEs this from the build directory
+IRAM_HOT_LD   = $(BUILD_DIR)iram_hot.ld
+LDFLAGS      += -L$(BUILD_DIR)
+
 ifeq ($(OTA),0)
 # for non-OTA, we create two different files for uploading into the flash
 # these are the names and options to generate them
@@ -245,6 +335,10 @@ all: $(PROGRAM_OUT) $(FW_FILE_1) $(FW_FILE_2) $(FW_FILE)
 #
 # Each call appends to COMPONENT_ARS which is a list of archive files for compiled components
 COMPONENT_ARS =
+
+# optimisation overrides for component $(1) source file $(2), see OPT_OVERRIDES
+opt_flags = $(if $(filter 1,$(OPT_OVERRIDES)),$($(1)_OPT) $($(1)_OPT_$(notdir $(2))))
+
 define component_compile_rules
 $(1)_DEFAULT_ROOT := $(dir $(lastword $(MAKEFILE_LIST)))
 $(1)_ROOT ?= $$($(1)_DEFAULT_ROOT)
@@ -267,19 +361,20 @@ $(1)_MAKEFILE ?= $(lastword $(MAKEFILE_LIST))
 $(1)_CPPFLAGS ?= $(CPPFLAGS)
 $(1)_CFLAGS ?= $(CFLAGS)
 $(1)_CXXFLAGS ?= $(CXXFLAGS)
+$(1)_LTO_CFLAGS = $(if $(filter $(1),$(LTO_EXCLUDE)),,$(LTO_CFLAGS))
 $(1)_CC_BASE = $(Q) $(CC) $$(addprefix -I,$$(INC_DIRS)) $$(addprefix -I,$$($(1)_INC_DIR)) $$($(1)_CPPFLAGS)
 $(1)_AR = $(call lc,$(BUILD_DIR)$(1).a)
 
 $$($(1)_OBJ_DIR)%.o: $$($(1)_REAL_ROOT)%.c $$($(1)_MAKEFILE) $(wildcard $(ROOT)*.mk) | $$($(1)_SRC_DIR)
 	$(vecho) "CC $$<"
 	$(Q) mkdir -p $$(dir $$@)
-	$$($(1)_CC_BASE) $$($(1)_CFLAGS) -c $$< -o $$@
+	$$($(1)_CC_BASE) $$($(1)_CFLAGS) $$($(1)_LTO_CFLAGS) $$(call opt_flags,$(1),$$<) -c $$< -o $$@
 	$$($(1)_CC_BASE) $$($(1)_CFLAGS) -MM -MT $$@ -MF $$(@:.o=.d) $$<
 
 $$($(1)_OBJ_DIR)%.o: $$($(1)_REAL_ROOT)%.cpp $$($(1)_MAKEFILE) $(wildcard $(ROOT)*.mk) | $$($(1)_SRC_DIR)
 	$(vecho) "C++ $$<"
 	$(Q) mkdir -p $$(dir $$@)
-	$$($(1)_CC_BASE) $$($(1)_CXXFLAGS) -c $$< -o $$@
+	$$($(1)_CC_BASE) $$($(1)_CXXFLAGS) $$($(1)_LTO_CFLAGS) $$(call opt_flags,$(1),$$<) -c $$< -o $$@
 	$$($(1)_CC_BASE) $$($(1)_CXXFLAGS) -MM -MT $$@ -MF $$(@:.o=.d) $$<
 
 $$($(1)_OBJ_DIR)%.o: $$($(1)_REAL_ROOT)%.S $$($(1)_MAKEFILE) $(wildcard $(ROOT)*.mk) | $$($(1)_SRC_DIR)
@@ -326,7 +421,12 @@ $(BUILD_DIR)sdklib/%_stage1.a: $(ROOT)lib/%.a $(BUILD_DIR)sdklib/%.remove | $(BU
 	$(Q) $(AR) d $@ @$(word 2,$^)
 
 # Stage 2: Redefine all SDK symbols as sdk_, weaken all symbols.
-$(BUILD_DIR)sdklib/%.a: $(BUILD_DIR)sdklib/%_stage1.a $(ROOT)lib/allsymbols.rename
+# With SDK_IRAM_PRUNE=1, utils/sdk_iram.py then writes the final library
+# from this, once the program's components are built (see below).
+ifeq ($(SDK_IRAM_PRUNE),1)
+SDK_STAGE2 = _stage2
+endif
+$(BUILD_DIR)sdklib/%$(SDK_STAGE2).a: $(BUILD_DIR)sdklib/%_stage1.a $(ROOT)lib/allsymbols.rename
 	@echo "SDK processing stage 2: Renaming symbols in SDK library $< -> $@"
 	$(Q) $(OBJCOPY) --redefine-syms $(word 2,$^) --weaken $< $@
 
@@ -347,8 +447,40 @@ $(foreach component,$(COMPONENTS), 					\
 	)								\
 )
 
+# linker fragment with the hot functions to place in IRAM (empty if
+# IRAM_HOT_FUNCS isn't set), regenerated when the list or budget change
+$(BUILD_DIR)iram_hot.cfg: FORCE | $(BUILD_DIR)
+	$(Q) echo "$(IRAM_HOT_FUNCS) $(IRAM_HOT_BUDGET)" | cmp -s - $@ || echo "$(IRAM_HOT_FUNCS) $(IRAM_HOT_BUDGET)" > $@
+
+ifneq ($(IRAM_HOT_FUNCS),)
+$(IRAM_HOT_LD): $(BUILD_DIR)iram_hot.cfg $(IRAM_HOT_FUNCS) $(COMPONENT_ARS) $(ROOT)utils/iram_hot.py
+	$(vecho) "GEN $@"
+	$(Q) $(PYTHON) $(ROOT)utils/iram_hot.py --objdump $(OBJDUMP) --budget $(IRAM_HOT_BUDGET) --out $@ \
+		--hot $(IRAM_HOT_FUNCS) $(COMPONENT_ARS)
+else
+$(IRAM_HOT_LD): $(BUILD_DIR)iram_hot.cfg
+	$(Q) echo "/* IRAM_HOT_FUNCS not set */" > $@
+endif
+
+# SDK libraries with the code that doesn't need IRAM moved to IROM, and
+# the report saying which
+ifeq ($(SDK_IRAM_PRUNE),1)
+SDK_IRAM_REPORT = $(BUILD_DIR)sdk_iram.txt
+
+$(SDK_IRAM_REPORT): $(SDK_PROCESSED_LIBS:.a=_stage2.a) $(COMPONENT_ARS) $(IRAM_HOT_LD) $(ROOT)utils/sdk_iram.py
+	$(vecho) "SDK IRAM $@"
+	$(Q) $(PYTHON) $(ROOT)utils/sdk_iram.py --objdump $(OBJDUMP) --objcopy $(OBJCOPY) --ar $(AR) \
+		--iram-ld $(IRAM_HOT_LD) --report $@ $(SDK_PROCESSED_LIBS:.a=_stage2.a) \
+		--components $(COMPONENT_ARS)
+
+$(SDK_PROCESSED_LIBS): $(SDK_IRAM_REPORT) ;
+endif
+
+.PHONY: FORCE
+FORCE:
+
 # final linking step to produce .elf
-$(PROGRAM_OUT): $(COMPONENT_ARS) $(SDK_PROCESSED_LIBS) $(LINKER_SCRIPTS)
+$(PROGRAM_OUT): $(COMPONENT_ARS) $(SDK_PROCESSED_LIBS) $(LINKER_SCRIPTS) $(IRAM_HOT_LD)
 	$(vecho) "LD $@"
 	$(Q) $(LD) $(LDFLAGS) -Wl,--start-group $(COMPONENT_ARS) $(LIB_ARGS) $(SDK_LIB_ARGS) -Wl,--end-group -o $@
 
@@ -371,9 +503,30 @@ flash: $(FW_FILE)
 	$(ESPTOOL) -p $(ESPPORT) --baud $(ESPBAUD) write_flash $(ESPTOOL_ARGS) 0x2000 $(FW_FILE)
 endif
 
+# host build for 'make host-bench'
+HOST_SRC_FILES ?= $(ROOT)core/crc.c $(ROOT)core/fmt.c $(ROOT)lwip/esp_chksum.c \
+	$(ROOT)extras/rboot-ota/rboot-ota.c $(ROOT)extras/json/json_parser.c \
+	$(ROOT)host/host_stubs.c $(ROOT)host/host_bench.c
+HOST_INC_DIRS = $(ROOT)host/include $(ROOT)host $(PROGRAM_DIR)include $(ROOT)core/include \
+	$(ROOT)include $(ROOT)lwip/include $(ROOT)extras/rboot-ota $(ROOT)extras
+HOST_BENCH = $(BUILD_DIR)host/bench
+
+$(HOST_BENCH): $(HOST_SRC_FILES) $(wildcard $(ROOT)host/*.h $(ROOT)host/include/*.h $(ROOT)host/include/*/*.h)
+	$(vecho) "HOST CC $@"
+	$(Q) mkdir -p $(dir $@)
+	$(Q) $(HOST_CC) $(HOST_CFLAGS) $(addprefix -I,$(HOST_INC_DIRS)) $(HOST_SRC_FILES) -o $@
+
+host-bench: $(HOST_BENCH)
+	$(Q) $(HOST_BENCH) $(HOST_BENCH_ARGS)
+
+.PHONY: host-bench
+
 size: $(PROGRAM_OUT)
 	$(Q) $(CROSS)size --format=sysv $(PROGRAM_OUT)
 
+size-report: $(PROGRAM_OUT)
+	$(Q) $(PYTHON) $(ROOT)utils/size_report.py --nm $(NM) --elf $(PROGRAM_OUT) $(BUILD_DIR)$(PROGRAM).map $(COMPONENT_ARS)
+
 test: flash
 	screen $(ESPPORT) 115200
 
@@ -414,6 +567,12 @@ help:
 	@echo "size"
 	@echo "Build, then print a summary of built firmware size."
 	@echo ""
+	@echo "size-report"
+	@echo "Build, then print the IRAM, IROM and DRAM used by each component and library."
+	@echo ""
+	@echo "host-bench"
+	@echo "Build the portable components for the host, then check and time them against HOST_BENCH_ARGS (captures, firmware images)."
+	@echo ""
 	@echo "TIPS:"
 	@echo "* You can use -jN for parallel builds. Much faster! Use 'make rebuild' instead of 'make clean all' for parallel builds."
 	@echo "* You can create a local.mk file to create local overrides of variables like ESPPORT & ESPBAUD."
@@ -21,6 +21,8 @@
 #include "esp/spi_regs.h"
 #include "esp/dport_regs.h"
 #include "esp/wdev_regs.h"
+#include "esp/flashmode.h"
+#include "esp/boot.h"
 #include "os_version.h"
 
 #include "espressif/esp_common.h"
@@ -77,12 +79,24 @@ xTaskHandle sdk_xUserTaskHandle;
 // xWatchDogTaskHandle -- .bss+0x2c
 xTaskHandle sdk_xWatchDogTaskHandle;
 
+// Set once init_wifi() has run
+static bool networking_started;
+// Set once start_wifi_mode() has run
+static bool wifi_mode_started;
+
+#ifdef FLASH_BOOT_MODE
+// Result of applying the build time FLASH_BOOT_MODE/FLASH_BOOT_SPEED
+static bool flash_boot_config_ok;
+#endif
+
 /* Static function prototypes */
 
 static void IRAM get_otp_mac_address(uint8_t *buf);
 static void IRAM set_spi0_divisor(uint32_t divisor);
 static void zero_bss(void);
 static void init_networking(uint8_t *phy_info, uint8_t *mac_addr);
+static void init_wifi(uint8_t *mac_addr);
+static void start_wifi_mode(void);
 static void init_g_ic(void);
 static void dump_excinfo(void);
 static void user_start_phase2(void);
@@ -180,7 +194,11 @@ void IRAM sdk_user_start(void) {
     uint32_t cksum_len;
     uint32_t cksum_value;
     uint32_t ic_flash_addr;
+#ifdef FLASH_BOOT_MODE
+    bool flash_config_ok;
+#endif
 
+    boot_mark("user_start");
     SPI(0).USER0 |= SPI_USER0_CS_SETUP;
     sdk_SPIRead(0, buf32, 4);
 
@@ -223,6 +241,11 @@ void IRAM sdk_user_start(void) {
     flash_size = flash_sectors * 4096;
     sdk_flashchip.chip_size = flash_size;
     set_spi0_divisor(flash_speed_divisor);
+#ifdef FLASH_BOOT_MODE
+    // Build time override of the header settings, keeps the header
+    // settings if the flash can't be read back correctly with it.
+    flash_config_ok = flashmode_configure(FLASH_BOOT_MODE, FLASH_BOOT_SPEED);
+#endif
     sdk_SPIRead(flash_size - 4096, buf32, BOOT_INFO_SIZE);
     boot_slot = buf8[0] ? 1 : 0;
     cksum_magic = buf32[1];
@@ -231,7 +254,11 @@ void IRAM sdk_user_start(void) {
     ic_flash_addr = (flash_sectors - 3 + boot_slot) * sdk_flashchip.sector_size;
     sdk_SPIRead(ic_flash_addr, buf32, sizeof(struct sdk_g_ic_saved_st));
     Cache_Read_Enable(0, 0, 1);
+    boot_mark("flash_config");
     zero_bss();
+#ifdef FLASH_BOOT_MODE
+    flash_boot_config_ok = flash_config_ok;
+#endif
     sdk_os_install_putc1(default_putc);
     if (cksum_magic == 0xffffffff) {
         // No checksum required
@@ -280,6 +307,15 @@ static void init_networking(uint8_t *phy_info, uint8_t *mac_addr) {
     }
     uart_set_baud(0, 74906);
     uart_set_baud(1, 74906);
+    boot_mark("phy_init");
+    if (!BOOT_DEFER_NETWORKING) {
+        init_wifi(mac_addr);
+    }
+}
+
+// Second half of init_networking(), can be deferred until
+// boot_start_networking() is called
+static void init_wifi(uint8_t *mac_addr) {
     sdk_phy_disable_agc();
     sdk_ieee80211_phy_init(sdk_g_ic.s.phy_mode);
     sdk_lmacInit();
@@ -292,6 +328,48 @@ static void init_networking(uint8_t *phy_info, uint8_t *mac_addr) {
     sdk_phy_enable_agc();
     sdk_cnx_attach(&sdk_g_ic);
     sdk_wDevEnableRx();
+    networking_started = true;
+    boot_mark("wifi_init");
+}
+
+static void start_wifi_mode(void) {
+    if (wifi_mode_started) {
+        return;
+    }
+    wifi_mode_started = true;
+    sdk_wifi_mode_set(sdk_g_ic.s.wifi_mode);
+    if (sdk_g_ic.s.wifi_mode == 1) {
+        sdk_wifi_station_start();
+        netif_set_default(sdk_g_ic.v.station_netif_info->netif);
+    }
+    if (sdk_g_ic.s.wifi_mode == 2) {
+        sdk_wifi_softap_start();
+        netif_set_default(sdk_g_ic.v.softap_netif_info->netif);
+    }
+    if (sdk_g_ic.s.wifi_mode == 3) {
+        sdk_wifi_station_start();
+        sdk_wifi_softap_start();
+        netif_set_default(sdk_g_ic.v.softap_netif_info->netif);
+    }
+    if (sdk_wifi_station_get_auto_connect()) {
+        sdk_wifi_station_connect();
+    }
+    boot_mark("wifi_start");
+}
+
+void boot_start_networking(void) {
+    if (!networking_started) {
+        init_wifi(sdk_info.sta_mac_addr);
+    }
+    // From user_init(), sdk_user_init_task starts the mode once it
+    // returns, as it does at boot
+    if (sdk_user_init_flag) {
+        start_wifi_mode();
+    }
+}
+
+bool boot_networking_started(void) {
+    return networking_started;
 }
 
 // .Lfunc007 -- .irom0.text+0x148
@@ -379,30 +457,25 @@ void sdk_wdt_init(void) {
 void sdk_user_init_task(void *params) {
     int phy_ver, pp_ver;
 
+    boot_mark("scheduler");
     sdk_ets_timer_init();
     printf("\nESP-Open-SDK ver: %s compiled @ %s %s\n", OS_VERSION_STR, __DATE__, __TIME__);
     phy_ver = RTCMEM_BACKUP[RTCMEM_BACKUP_PHY_VER] >> 16;
     printf("phy ver: %d, ", phy_ver);
     pp_ver = RTCMEM_SYSTEM[RTCMEM_SYSTEM_PP_VER];
     printf("pp ver: %d.%d\n\n", (pp_ver >> 8) & 0xff, pp_ver & 0xff);
+#ifdef FLASH_BOOT_MODE
+    if (!flash_boot_config_ok) {
+        printf("flash: %s %dMHz failed, using %s %dMHz\n\n",
+               flashmode_name(FLASH_BOOT_MODE), FLASH_BOOT_SPEED,
+               flashmode_name(flashmode_get_mode()), (int)flashmode_get_speed());
+    }
+#endif
     user_init();
+    boot_mark("user_init");
     sdk_user_init_flag = 1;
-    sdk_wifi_mode_set(sdk_g_ic.s.wifi_mode);
-    if (sdk_g_ic.s.wifi_mode == 1) {
-        sdk_wifi_station_start();
-        netif_set_default(sdk_g_ic.v.station_netif_info->netif);
-    }
-    if (sdk_g_ic.s.wifi_mode == 2) {
-        sdk_wifi_softap_start();
-        netif_set_default(sdk_g_ic.v.softap_netif_info->netif);
-    }
-    if (sdk_g_ic.s.wifi_mode == 3) {
-        sdk_wifi_station_start();
-        sdk_wifi_softap_start();
-        netif_set_default(sdk_g_ic.v.softap_netif_info->netif);
-    }
-    if (sdk_wifi_station_get_auto_connect()) {
-        sdk_wifi_station_connect();
+    if (networking_started) {
+        start_wifi_mode();
     }
     vTaskDelete(NULL);
 }
@@ -445,6 +518,7 @@ static void user_start_phase2(void) {
     init_networking(phy_info, sdk_info.sta_mac_addr);
     free(phy_info);
     tcpip_init(NULL, NULL);
+    boot_mark("tcpip_init");
     sdk_wdt_init();
     xTaskCreate(sdk_user_init_task, (signed char *)"uiT", 1024, 0, 14, &sdk_xUserTaskHandle);
     vTaskStartScheduler();
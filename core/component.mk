@@ -3,4 +3,14 @@ INC_DIRS += $(core_ROOT)include
 # args for passing into compile rule generation
 core_SRC_DIR = $(core_ROOT)
 
+# Interrupt handlers and the kernels drivers call per byte stay at -O2
+# whatever the FLAVOR, see OPT_OVERRIDES in common.mk
+core_OPT_esp_interrupts.c ?= -O2
+core_OPT_esp_gpio_interrupts.c ?= -O2
+core_OPT_esp_uart.c ?= -O2
+core_OPT_esp_spi.c ?= -O2
+core_OPT_esp_hrtimer.c ?= -O2
+core_OPT_crc.c ?= -O2 -funroll-loops
+core_OPT_memmove.c ?= -O2
+
 $(eval $(call component_compile_rules,core))
@@ -0,0 +1,457 @@
+/* Table driven CRC8, CRC16 and CRC32, see crc.h
+ *
+ * All three are reflected CRCs, so they share one structure: the byte
+ * kernel looks up (crc ^ byte) & 0xff, and the slice-by-4 kernel xors
+ * a little endian word into the CRC and looks up each of its bytes in
+ * the table for its distance from the end of the word.
+ *
+ * The tables were generated by a script and hold 4, 2 or 1 entries per
+ * word, so only word loads are made from IROM.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <crc.h>
+#include <common_macros.h>
+
+#if CRC_KERNEL != 0 && CRC_KERNEL != 1 && CRC_KERNEL != 4
+#error "CRC_KERNEL must be 0, 1 or 4"
+#endif
+
+#if CRC_KERNEL == 0
+
+static inline uint32_t crc_bits(uint32_t crc, const uint8_t *p, size_t len, uint32_t poly)
+{
+    while (len--) {
+        crc ^= *p++;
+        for (int i = 0; i < 8; i++)
+            crc = (crc >> 1) ^ (poly & -(crc & 1));
+    }
+    return crc;
+}
+
+uint8_t crc8_maxim(uint8_t crc, const void *data, size_t len)
+{
+    return crc_bits(crc, data, len, 0x8c);
+}
+
+uint16_t crc16_ibm(uint16_t crc, const void *data, size_t len)
+{
+    return crc_bits(crc, data, len, 0xa001);
+}
+
+uint32_t crc32_ieee(uint32_t crc, const void *data, size_t len)
+{
+    return ~crc_bits(~crc, data, len, 0xedb88320);
+}
+
+#else /* CRC_KERNEL != 0 */
+
+#define CRC_TABLES CRC_KERNEL
+
+static const uint32_t IROM crc8_table[CRC_TABLES][64] = {
+    {
+        0xe2bc5e00, 0x83dd3f61, 0x207e9cc2, 0x411ffda3, 0x7f21c39d, 0x1e40a2fc,
+        0xbde3015f, 0xdc82603e, 0xc19f7d23, 0xa0fe1c42, 0x035dbfe1, 0x623cde80,
+        0x5c02e0be, 0x3d6381df, 0x9ec0227c, 0xffa1431d, 0xa4fa1846, 0xc59b7927,
+        0x6638da84, 0x0759bbe5, 0x396785db, 0x5806e4ba, 0xfba54719, 0x9ac42678,
+        0x87d93b65, 0xe6b85a04, 0x451bf9a7, 0x247a98c6, 0x1a44a6f8, 0x7b25c799,
+        0xd886643a, 0xb9e7055b, 0x6e30d28c, 0x0f51b3ed, 0xacf2104e, 0xcd93712f,
+        0xf3ad4f11, 0x92cc2e70, 0x316f8dd3, 0x500eecb2, 0x4d13f1af, 0x2c7290ce,
+        0x8fd1336d, 0xeeb0520c, 0xd08e6c32, 0xb1ef0d53, 0x124caef0, 0x732dcf91,
+        0x287694ca, 0x4917f5ab, 0xeab45608, 0x8bd53769, 0xb5eb0957, 0xd48a6836,
+        0x7729cb95, 0x1648aaf4, 0x0b55b7e9, 0x6a34d688, 0xc997752b, 0xa8f6144a,
+        0x96c82a74, 0xf7a94b15, 0x540ae8b6, 0x356b89d7,
+    },
+#if CRC_TABLES > 1
+    {
+        0x5591c400, 0x6eaaff3b, 0x23e7b276, 0x18dc894d, 0xb97d28ec, 0x824613d7,
+        0xcf0b5e9a, 0xf43065a1, 0x945005c1, 0xaf6b3efa, 0xe22673b7, 0xd91d488c,
+        0x78bce92d, 0x4387d216, 0x0eca9f5b, 0x35f1a460, 0xce0a5f9b, 0xf53164a0,
+        0xb87c29ed, 0x834712d6, 0x22e6b377, 0x19dd884c, 0x5490c501, 0x6fabfe3a,
+        0x0fcb9e5a, 0x34f0a561, 0x79bde82c, 0x4286d317, 0xe32772b6, 0xd81c498d,
+        0x955104c0, 0xae6a3ffb, 0x7abeeb2f, 0x4185d014, 0x0cc89d59, 0x37f3a662,
+        0x965207c3, 0xad693cf8, 0xe02471b5, 0xdb1f4a8e, 0xbb7f2aee, 0x804411d5,
+        0xcd095c98, 0xf63267a3, 0x5793c602, 0x6ca8fd39, 0x21e5b074, 0x1ade8b4f,
+        0xe12570b4, 0xda1e4b8f, 0x975306c2, 0xac683df9, 0x0dc99c58, 0x36f2a763,
+        0x7bbfea2e, 0x4084d115, 0x20e4b175, 0x1bdf8a4e, 0x5692c703, 0x6da9fc38,
+        0xcc085d99, 0xf73366a2, 0xba7e2bef, 0x814510d4,
+    },
+    {
+        0xe44fab00, 0x7ad1359e, 0xc16a8e25, 0x5ff410bb, 0xae05e14a, 0x309b7fd4,
+        0x8b20c46f, 0x15be5af1, 0x70db3f94, 0xee45a10a, 0x55fe1ab1, 0xcb60842f,
+        0x3a9175de, 0xa40feb40, 0x1fb450fb, 0x812ace65, 0xd57e9a31, 0x4be004af,
+        0xf05bbf14, 0x6ec5218a, 0x9f34d07b, 0x01aa4ee5, 0xba11f55e, 0x248f6bc0,
+        0x41ea0ea5, 0xdf74903b, 0x64cf2b80, 0xfa51b51e, 0x0ba044ef, 0x953eda71,
+        0x2e8561ca, 0xb01bff54, 0x862dc962, 0x18b357fc, 0xa308ec47, 0x3d9672d9,
+        0xcc678328, 0x52f91db6, 0xe942a60d, 0x77dc3893, 0x12b95df6, 0x8c27c368,
+        0x379c78d3, 0xa902e64d, 0x58f317bc, 0xc66d8922, 0x7dd63299, 0xe348ac07,
+        0xb71cf853, 0x298266cd, 0x9239dd76, 0x0ca743e8, 0xfd56b219, 0x63c82c87,
+        0xd873973c, 0x46ed09a2, 0x23886cc7, 0xbd16f259, 0x06ad49e2, 0x9833d77c,
+        0x69c2268d, 0xf75cb813, 0x4ce703a8, 0xd2799d36,
+    },
+    {
+        0x88078f00, 0x8609810e, 0x941b931c, 0x9a159d12, 0xb03fb738, 0xbe31b936,
+        0xac23ab24, 0xa22da52a, 0xf877ff70, 0xf679f17e, 0xe46be36c, 0xea65ed62,
+        0xc04fc748, 0xce41c946, 0xdc53db54, 0xd25dd55a, 0x68e76fe0, 0x66e961ee,
+        0x74fb73fc, 0x7af57df2, 0x50df57d8, 0x5ed159d6, 0x4cc34bc4, 0x42cd45ca,
+        0x18971f90, 0x1699119e, 0x048b038c, 0x0a850d82, 0x20af27a8, 0x2ea129a6,
+        0x3cb33bb4, 0x32bd35ba, 0x51de56d9, 0x5fd058d7, 0x4dc24ac5, 0x43cc44cb,
+        0x69e66ee1, 0x67e860ef, 0x75fa72fd, 0x7bf47cf3, 0x21ae26a9, 0x2fa028a7,
+        0x3db23ab5, 0x33bc34bb, 0x19961e91, 0x1798109f, 0x058a028d, 0x0b840c83,
+        0xb13eb639, 0xbf30b837, 0xad22aa25, 0xa32ca42b, 0x89068e01, 0x8708800f,
+        0x951a921d, 0x9b149c13, 0xc14ec649, 0xcf40c847, 0xdd52da55, 0xd35cd45b,
+        0xf976fe71, 0xf778f07f, 0xe56ae26d, 0xeb64ec63,
+    },
+#endif
+};
+
+static const uint32_t IROM crc16_table[CRC_TABLES][128] = {
+    {
+        0xc0c10000, 0x0140c181, 0x03c0c301, 0xc2410280, 0x06c0c601, 0xc7410780,
+        0xc5c10500, 0x0440c481, 0x0cc0cc01, 0xcd410d80, 0xcfc10f00, 0x0e40ce81,
+        0xcac10a00, 0x0b40cb81, 0x09c0c901, 0xc8410880, 0x18c0d801, 0xd9411980,
+        0xdbc11b00, 0x1a40da81, 0xdec11e00, 0x1f40df81, 0x1dc0dd01, 0xdc411c80,
+        0xd4c11400, 0x1540d581, 0x17c0d701, 0xd6411680, 0x12c0d201, 0xd3411380,
+        0xd1c11100, 0x1040d081, 0x30c0f001, 0xf1413180, 0xf3c13300, 0x3240f281,
+        0xf6c13600, 0x3740f781, 0x35c0f501, 0xf4413480, 0xfcc13c00, 0x3d40fd81,
+        0x3fc0ff01, 0xfe413e80, 0x3ac0fa01, 0xfb413b80, 0xf9c13900, 0x3840f881,
+        0xe8c12800, 0x2940e981, 0x2bc0eb01, 0xea412a80, 0x2ec0ee01, 0xef412f80,
+        0xedc12d00, 0x2c40ec81, 0x24c0e401, 0xe5412580, 0xe7c12700, 0x2640e681,
+        0xe2c12200, 0x2340e381, 0x21c0e101, 0xe0412080, 0x60c0a001, 0xa1416180,
+        0xa3c16300, 0x6240a281, 0xa6c16600, 0x6740a781, 0x65c0a501, 0xa4416480,
+        0xacc16c00, 0x6d40ad81, 0x6fc0af01, 0xae416e80, 0x6ac0aa01, 0xab416b80,
+        0xa9c16900, 0x6840a881, 0xb8c17800, 0x7940b981, 0x7bc0bb01, 0xba417a80,
+        0x7ec0be01, 0xbf417f80, 0xbdc17d00, 0x7c40bc81, 0x74c0b401, 0xb5417580,
+        0xb7c17700, 0x7640b681, 0xb2c17200, 0x7340b381, 0x71c0b101, 0xb0417080,
+        0x90c15000, 0x51409181, 0x53c09301, 0x92415280, 0x56c09601, 0x97415780,
+        0x95c15500, 0x54409481, 0x5cc09c01, 0x9d415d80, 0x9fc15f00, 0x5e409e81,
+        0x9ac15a00, 0x5b409b81, 0x59c09901, 0x98415880, 0x48c08801, 0x89414980,
+        0x8bc14b00, 0x4a408a81, 0x8ec14e00, 0x4f408f81, 0x4dc08d01, 0x8c414c80,
+        0x84c14400, 0x45408581, 0x47c08701, 0x86414680, 0x42c08201, 0x83414380,
+        0x81c14100, 0x40408081,
+    },
+#if CRC_TABLES > 1
+    {
+        0x90010000, 0xf0006001, 0x5003c002, 0x3002a003, 0x5006c007, 0x3007a006,
+        0x90040005, 0xf0056004, 0x500cc00d, 0x300da00c, 0x900e000f, 0xf00f600e,
+        0x900b000a, 0xf00a600b, 0x5009c008, 0x3008a009, 0x5018c019, 0x3019a018,
+        0x901a001b, 0xf01b601a, 0x901f001e, 0xf01e601f, 0x501dc01c, 0x301ca01d,
+        0x90150014, 0xf0146015, 0x5017c016, 0x3016a017, 0x5012c013, 0x3013a012,
+        0x90100011, 0xf0116010, 0x5030c031, 0x3031a030, 0x90320033, 0xf0336032,
+        0x90370036, 0xf0366037, 0x5035c034, 0x3034a035, 0x903d003c, 0xf03c603d,
+        0x503fc03e, 0x303ea03f, 0x503ac03b, 0x303ba03a, 0x90380039, 0xf0396038,
+        0x90290028, 0xf0286029, 0x502bc02a, 0x302aa02b, 0x502ec02f, 0x302fa02e,
+        0x902c002d, 0xf02d602c, 0x5024c025, 0x3025a024, 0x90260027, 0xf0276026,
+        0x90230022, 0xf0226023, 0x5021c020, 0x3020a021, 0x5060c061, 0x3061a060,
+        0x90620063, 0xf0636062, 0x90670066, 0xf0666067, 0x5065c064, 0x3064a065,
+        0x906d006c, 0xf06c606d, 0x506fc06e, 0x306ea06f, 0x506ac06b, 0x306ba06a,
+        0x90680069, 0xf0696068, 0x90790078, 0xf0786079, 0x507bc07a, 0x307aa07b,
+        0x507ec07f, 0x307fa07e, 0x907c007d, 0xf07d607c, 0x5074c075, 0x3075a074,
+        0x90760077, 0xf0776076, 0x90730072, 0xf0726073, 0x5071c070, 0x3070a071,
+        0x90510050, 0xf0506051, 0x5053c052, 0x3052a053, 0x5056c057, 0x3057a056,
+        0x90540055, 0xf0556054, 0x505cc05d, 0x305da05c, 0x905e005f, 0xf05f605e,
+        0x905b005a, 0xf05a605b, 0x5059c058, 0x3058a059, 0x5048c049, 0x3049a048,
+        0x904a004b, 0xf04b604a, 0x904f004e, 0xf04e604f, 0x504dc04c, 0x304ca04d,
+        0x90450044, 0xf0446045, 0x5047c046, 0x3046a047, 0x5042c043, 0x3043a042,
+        0x90400041, 0xf0416040,
+    },
+    {
+        0xc0510000, 0x00f0c0a1, 0x0110c141, 0xc1b101e0, 0x02d0c281, 0xc2710220,
+        0xc39103c0, 0x0330c361, 0x0550c501, 0xc5f105a0, 0xc4110440, 0x04b0c4e1,
+        0xc7d10780, 0x0770c721, 0x0690c6c1, 0xc6310660, 0x0a50ca01, 0xcaf10aa0,
+        0xcb110b40, 0x0bb0cbe1, 0xc8d10880, 0x0870c821, 0x0990c9c1, 0xc9310960,
+        0xcf510f00, 0x0ff0cfa1, 0x0e10ce41, 0xceb10ee0, 0x0dd0cd81, 0xcd710d20,
+        0xcc910cc0, 0x0c30cc61, 0x1450d401, 0xd4f114a0, 0xd5111540, 0x15b0d5e1,
+        0xd6d11680, 0x1670d621, 0x1790d7c1, 0xd7311760, 0xd1511100, 0x11f0d1a1,
+        0x1010d041, 0xd0b110e0, 0x13d0d381, 0xd3711320, 0xd29112c0, 0x1230d261,
+        0xde511e00, 0x1ef0dea1, 0x1f10df41, 0xdfb11fe0, 0x1cd0dc81, 0xdc711c20,
+        0xdd911dc0, 0x1d30dd61, 0x1b50db01, 0xdbf11ba0, 0xda111a40, 0x1ab0dae1,
+        0xd9d11980, 0x1970d921, 0x1890d8c1, 0xd8311860, 0x2850e801, 0xe8f128a0,
+        0xe9112940, 0x29b0e9e1, 0xead12a80, 0x2a70ea21, 0x2b90ebc1, 0xeb312b60,
+        0xed512d00, 0x2df0eda1, 0x2c10ec41, 0xecb12ce0, 0x2fd0ef81, 0xef712f20,
+        0xee912ec0, 0x2e30ee61, 0xe2512200, 0x22f0e2a1, 0x2310e341, 0xe3b123e0,
+        0x20d0e081, 0xe0712020, 0xe19121c0, 0x2130e161, 0x2750e701, 0xe7f127a0,
+        0xe6112640, 0x26b0e6e1, 0xe5d12580, 0x2570e521, 0x2490e4c1, 0xe4312460,
+        0xfc513c00, 0x3cf0fca1, 0x3d10fd41, 0xfdb13de0, 0x3ed0fe81, 0xfe713e20,
+        0xff913fc0, 0x3f30ff61, 0x3950f901, 0xf9f139a0, 0xf8113840, 0x38b0f8e1,
+        0xfbd13b80, 0x3b70fb21, 0x3a90fac1, 0xfa313a60, 0x3650f601, 0xf6f136a0,
+        0xf7113740, 0x37b0f7e1, 0xf4d13480, 0x3470f421, 0x3590f5c1, 0xf5313560,
+        0xf3513300, 0x33f0f3a1, 0x3210f241, 0xf2b132e0, 0x31d0f181, 0xf1713120,
+        0xf09130c0, 0x3030f061,
+    },
+    {
+        0xfc010000, 0x4400b801, 0xcc003001, 0x74018800, 0x9c036002, 0x2402d803,
+        0xac025003, 0x1403e802, 0x3c05c004, 0x84047805, 0x0c04f005, 0xb4054804,
+        0x5c07a006, 0xe4061807, 0x6c069007, 0xd4072806, 0x3c0ac00b, 0x840b780a,
+        0x0c0bf00a, 0xb40a480b, 0x5c08a009, 0xe4091808, 0x6c099008, 0xd4082809,
+        0xfc0e000f, 0x440fb80e, 0xcc0f300e, 0x740e880f, 0x9c0c600d, 0x240dd80c,
+        0xac0d500c, 0x140ce80d, 0x3c14c015, 0x84157814, 0x0c15f014, 0xb4144815,
+        0x5c16a017, 0xe4171816, 0x6c179016, 0xd4162817, 0xfc100011, 0x4411b810,
+        0xcc113010, 0x74108811, 0x9c126013, 0x2413d812, 0xac135012, 0x1412e813,
+        0xfc1f001e, 0x441eb81f, 0xcc1e301f, 0x741f881e, 0x9c1d601c, 0x241cd81d,
+        0xac1c501d, 0x141de81c, 0x3c1bc01a, 0x841a781b, 0x0c1af01b, 0xb41b481a,
+        0x5c19a018, 0xe4181819, 0x6c189019, 0xd4192818, 0x3c28c029, 0x84297828,
+        0x0c29f028, 0xb4284829, 0x5c2aa02b, 0xe42b182a, 0x6c2b902a, 0xd42a282b,
+        0xfc2c002d, 0x442db82c, 0xcc2d302c, 0x742c882d, 0x9c2e602f, 0x242fd82e,
+        0xac2f502e, 0x142ee82f, 0xfc230022, 0x4422b823, 0xcc223023, 0x74238822,
+        0x9c216020, 0x2420d821, 0xac205021, 0x1421e820, 0x3c27c026, 0x84267827,
+        0x0c26f027, 0xb4274826, 0x5c25a024, 0xe4241825, 0x6c249025, 0xd4252824,
+        0xfc3d003c, 0x443cb83d, 0xcc3c303d, 0x743d883c, 0x9c3f603e, 0x243ed83f,
+        0xac3e503f, 0x143fe83e, 0x3c39c038, 0x84387839, 0x0c38f039, 0xb4394838,
+        0x5c3ba03a, 0xe43a183b, 0x6c3a903b, 0xd43b283a, 0x3c36c037, 0x84377836,
+        0x0c37f036, 0xb4364837, 0x5c34a035, 0xe4351834, 0x6c359034, 0xd4342835,
+        0xfc320033, 0x4433b832, 0xcc333032, 0x74328833, 0x9c306031, 0x2431d830,
+        0xac315030, 0x1430e831,
+    },
+#endif
+};
+
+static const uint32_t IROM crc32_table[CRC_TABLES][256] = {
+    {
+        0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f,
+        0xe963a535, 0x9e6495a3, 0x0edb8832, 0x79dcb8a4, 0xe0d5e91e, 0x97d2d988,
+        0x09b64c2b, 0x7eb17cbd, 0xe7b82d07, 0x90bf1d91, 0x1db71064, 0x6ab020f2,
+        0xf3b97148, 0x84be41de, 0x1adad47d, 0x6ddde4eb, 0xf4d4b551, 0x83d385c7,
+        0x136c9856, 0x646ba8c0, 0xfd62f97a, 0x8a65c9ec, 0x14015c4f, 0x63066cd9,
+        0xfa0f3d63, 0x8d080df5, 0x3b6e20c8, 0x4c69105e, 0xd56041e4, 0xa2677172,
+        0x3c03e4d1, 0x4b04d447, 0xd20d85fd, 0xa50ab56b, 0x35b5a8fa, 0x42b2986c,
+        0xdbbbc9d6, 0xacbcf940, 0x32d86ce3, 0x45df5c75, 0xdcd60dcf, 0xabd13d59,
+        0x26d930ac, 0x51de003a, 0xc8d75180, 0xbfd06116, 0x21b4f4b5, 0x56b3c423,
+        0xcfba9599, 0xb8bda50f, 0x2802b89e, 0x5f058808, 0xc60cd9b2, 0xb10be924,
+        0x2f6f7c87, 0x58684c11, 0xc1611dab, 0xb6662d3d, 0x76dc4190, 0x01db7106,
+        0x98d220bc, 0xefd5102a, 0x71b18589, 0x06b6b51f, 0x9fbfe4a5, 0xe8b8d433,
+        0x7807c9a2, 0x0f00f934, 0x9609a88e, 0xe10e9818, 0x7f6a0dbb, 0x086d3d2d,
+        0x91646c97, 0xe6635c01, 0x6b6b51f4, 0x1c6c6162, 0x856530d8, 0xf262004e,
+        0x6c0695ed, 0x1b01a57b, 0x8208f4c1, 0xf50fc457, 0x65b0d9c6, 0x12b7e950,
+        0x8bbeb8ea, 0xfcb9887c, 0x62dd1ddf, 0x15da2d49, 0x8cd37cf3, 0xfbd44c65,
+        0x4db26158, 0x3ab551ce, 0xa3bc0074, 0xd4bb30e2, 0x4adfa541, 0x3dd895d7,
+        0xa4d1c46d, 0xd3d6f4fb, 0x4369e96a, 0x346ed9fc, 0xad678846, 0xda60b8d0,
+        0x44042d73, 0x33031de5, 0xaa0a4c5f, 0xdd0d7cc9, 0x5005713c, 0x270241aa,
+        0xbe0b1010, 0xc90c2086, 0x5768b525, 0x206f85b3, 0xb966d409, 0xce61e49f,
+        0x5edef90e, 0x29d9c998, 0xb0d09822, 0xc7d7a8b4, 0x59b33d17, 0x2eb40d81,
+        0xb7bd5c3b, 0xc0ba6cad, 0xedb88320, 0x9abfb3b6, 0x03b6e20c, 0x74b1d29a,
+        0xead54739, 0x9dd277af, 0x04db2615, 0x73dc1683, 0xe3630b12, 0x94643b84,
+        0x0d6d6a3e, 0x7a6a5aa8, 0xe40ecf0b, 0x9309ff9d, 0x0a00ae27, 0x7d079eb1,
+        0xf00f9344, 0x8708a3d2, 0x1e01f268, 0x6906c2fe, 0xf762575d, 0x806567cb,
+        0x196c3671, 0x6e6b06e7, 0xfed41b76, 0x89d32be0, 0x10da7a5a, 0x67dd4acc,
+        0xf9b9df6f, 0x8ebeeff9, 0x17b7be43, 0x60b08ed5, 0xd6d6a3e8, 0xa1d1937e,
+        0x38d8c2c4, 0x4fdff252, 0xd1bb67f1, 0xa6bc5767, 0x3fb506dd, 0x48b2364b,
+        0xd80d2bda, 0xaf0a1b4c, 0x36034af6, 0x41047a60, 0xdf60efc3, 0xa867df55,
+        0x316e8eef, 0x4669be79, 0xcb61b38c, 0xbc66831a, 0x256fd2a0, 0x5268e236,
+        0xcc0c7795, 0xbb0b4703, 0x220216b9, 0x5505262f, 0xc5ba3bbe, 0xb2bd0b28,
+        0x2bb45a92, 0x5cb36a04, 0xc2d7ffa7, 0xb5d0cf31, 0x2cd99e8b, 0x5bdeae1d,
+        0x9b64c2b0, 0xec63f226, 0x756aa39c, 0x026d930a, 0x9c0906a9, 0xeb0e363f,
+        0x72076785, 0x05005713, 0x95bf4a82, 0xe2b87a14, 0x7bb12bae, 0x0cb61b38,
+        0x92d28e9b, 0xe5d5be0d, 0x7cdcefb7, 0x0bdbdf21, 0x86d3d2d4, 0xf1d4e242,
+        0x68ddb3f8, 0x1fda836e, 0x81be16cd, 0xf6b9265b, 0x6fb077e1, 0x18b74777,
+        0x88085ae6, 0xff0f6a70, 0x66063bca, 0x11010b5c, 0x8f659eff, 0xf862ae69,
+        0x616bffd3, 0x166ccf45, 0xa00ae278, 0xd70dd2ee, 0x4e048354, 0x3903b3c2,
+        0xa7672661, 0xd06016f7, 0x4969474d, 0x3e6e77db, 0xaed16a4a, 0xd9d65adc,
+        0x40df0b66, 0x37d83bf0, 0xa9bcae53, 0xdebb9ec5, 0x47b2cf7f, 0x30b5ffe9,
+        0xbdbdf21c, 0xcabac28a, 0x53b39330, 0x24b4a3a6, 0xbad03605, 0xcdd70693,
+        0x54de5729, 0x23d967bf, 0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94,
+        0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d,
+    },
+#if CRC_TABLES > 1
+    {
+        0x00000000, 0x191b3141, 0x32366282, 0x2b2d53c3, 0x646cc504, 0x7d77f445,
+        0x565aa786, 0x4f4196c7, 0xc8d98a08, 0xd1c2bb49, 0xfaefe88a, 0xe3f4d9cb,
+        0xacb54f0c, 0xb5ae7e4d, 0x9e832d8e, 0x87981ccf, 0x4ac21251, 0x53d92310,
+        0x78f470d3, 0x61ef4192, 0x2eaed755, 0x37b5e614, 0x1c98b5d7, 0x05838496,
+        0x821b9859, 0x9b00a918, 0xb02dfadb, 0xa936cb9a, 0xe6775d5d, 0xff6c6c1c,
+        0xd4413fdf, 0xcd5a0e9e, 0x958424a2, 0x8c9f15e3, 0xa7b24620, 0xbea97761,
+        0xf1e8e1a6, 0xe8f3d0e7, 0xc3de8324, 0xdac5b265, 0x5d5daeaa, 0x44469feb,
+        0x6f6bcc28, 0x7670fd69, 0x39316bae, 0x202a5aef, 0x0b07092c, 0x121c386d,
+        0xdf4636f3, 0xc65d07b2, 0xed705471, 0xf46b6530, 0xbb2af3f7, 0xa231c2b6,
+        0x891c9175, 0x9007a034, 0x179fbcfb, 0x0e848dba, 0x25a9de79, 0x3cb2ef38,
+        0x73f379ff, 0x6ae848be, 0x41c51b7d, 0x58de2a3c, 0xf0794f05, 0xe9627e44,
+        0xc24f2d87, 0xdb541cc6, 0x94158a01, 0x8d0ebb40, 0xa623e883, 0xbf38d9c2,
+        0x38a0c50d, 0x21bbf44c, 0x0a96a78f, 0x138d96ce, 0x5ccc0009, 0x45d73148,
+        0x6efa628b, 0x77e153ca, 0xbabb5d54, 0xa3a06c15, 0x888d3fd6, 0x91960e97,
+        0xded79850, 0xc7cca911, 0xece1fad2, 0xf5facb93, 0x7262d75c, 0x6b79e61d,
+        0x4054b5de, 0x594f849f, 0x160e1258, 0x0f152319, 0x243870da, 0x3d23419b,
+        0x65fd6ba7, 0x7ce65ae6, 0x57cb0925, 0x4ed03864, 0x0191aea3, 0x188a9fe2,
+        0x33a7cc21, 0x2abcfd60, 0xad24e1af, 0xb43fd0ee, 0x9f12832d, 0x8609b26c,
+        0xc94824ab, 0xd05315ea, 0xfb7e4629, 0xe2657768, 0x2f3f79f6, 0x362448b7,
+        0x1d091b74, 0x04122a35, 0x4b53bcf2, 0x52488db3, 0x7965de70, 0x607eef31,
+        0xe7e6f3fe, 0xfefdc2bf, 0xd5d0917c, 0xcccba03d, 0x838a36fa, 0x9a9107bb,
+        0xb1bc5478, 0xa8a76539, 0x3b83984b, 0x2298a90a, 0x09b5fac9, 0x10aecb88,
+        0x5fef5d4f, 0x46f46c0e, 0x6dd93fcd, 0x74c20e8c, 0xf35a1243, 0xea412302,
+        0xc16c70c1, 0xd8774180, 0x9736d747, 0x8e2de606, 0xa500b5c5, 0xbc1b8484,
+        0x71418a1a, 0x685abb5b, 0x4377e898, 0x5a6cd9d9, 0x152d4f1e, 0x0c367e5f,
+        0x271b2d9c, 0x3e001cdd, 0xb9980012, 0xa0833153, 0x8bae6290, 0x92b553d1,
+        0xddf4c516, 0xc4eff457, 0xefc2a794, 0xf6d996d5, 0xae07bce9, 0xb71c8da8,
+        0x9c31de6b, 0x852aef2a, 0xca6b79ed, 0xd37048ac, 0xf85d1b6f, 0xe1462a2e,
+        0x66de36e1, 0x7fc507a0, 0x54e85463, 0x4df36522, 0x02b2f3e5, 0x1ba9c2a4,
+        0x30849167, 0x299fa026, 0xe4c5aeb8, 0xfdde9ff9, 0xd6f3cc3a, 0xcfe8fd7b,
+        0x80a96bbc, 0x99b25afd, 0xb29f093e, 0xab84387f, 0x2c1c24b0, 0x350715f1,
+        0x1e2a4632, 0x07317773, 0x4870e1b4, 0x516bd0f5, 0x7a468336, 0x635db277,
+        0xcbfad74e, 0xd2e1e60f, 0xf9ccb5cc, 0xe0d7848d, 0xaf96124a, 0xb68d230b,
+        0x9da070c8, 0x84bb4189, 0x03235d46, 0x1a386c07, 0x31153fc4, 0x280e0e85,
+        0x674f9842, 0x7e54a903, 0x5579fac0, 0x4c62cb81, 0x8138c51f, 0x9823f45e,
+        0xb30ea79d, 0xaa1596dc, 0xe554001b, 0xfc4f315a, 0xd7626299, 0xce7953d8,
+        0x49e14f17, 0x50fa7e56, 0x7bd72d95, 0x62cc1cd4, 0x2d8d8a13, 0x3496bb52,
+        0x1fbbe891, 0x06a0d9d0, 0x5e7ef3ec, 0x4765c2ad, 0x6c48916e, 0x7553a02f,
+        0x3a1236e8, 0x230907a9, 0x0824546a, 0x113f652b, 0x96a779e4, 0x8fbc48a5,
+        0xa4911b66, 0xbd8a2a27, 0xf2cbbce0, 0xebd08da1, 0xc0fdde62, 0xd9e6ef23,
+        0x14bce1bd, 0x0da7d0fc, 0x268a833f, 0x3f91b27e, 0x70d024b9, 0x69cb15f8,
+        0x42e6463b, 0x5bfd777a, 0xdc656bb5, 0xc57e5af4, 0xee530937, 0xf7483876,
+        0xb809aeb1, 0xa1129ff0, 0x8a3fcc33, 0x9324fd72,
+    },
+    {
+        0x00000000, 0x01c26a37, 0x0384d46e, 0x0246be59, 0x0709a8dc, 0x06cbc2eb,
+        0x048d7cb2, 0x054f1685, 0x0e1351b8, 0x0fd13b8f, 0x0d9785d6, 0x0c55efe1,
+        0x091af964, 0x08d89353, 0x0a9e2d0a, 0x0b5c473d, 0x1c26a370, 0x1de4c947,
+        0x1fa2771e, 0x1e601d29, 0x1b2f0bac, 0x1aed619b, 0x18abdfc2, 0x1969b5f5,
+        0x1235f2c8, 0x13f798ff, 0x11b126a6, 0x10734c91, 0x153c5a14, 0x14fe3023,
+        0x16b88e7a, 0x177ae44d, 0x384d46e0, 0x398f2cd7, 0x3bc9928e, 0x3a0bf8b9,
+        0x3f44ee3c, 0x3e86840b, 0x3cc03a52, 0x3d025065, 0x365e1758, 0x379c7d6f,
+        0x35dac336, 0x3418a901, 0x3157bf84, 0x3095d5b3, 0x32d36bea, 0x331101dd,
+        0x246be590, 0x25a98fa7, 0x27ef31fe, 0x262d5bc9, 0x23624d4c, 0x22a0277b,
+        0x20e69922, 0x2124f315, 0x2a78b428, 0x2bbade1f, 0x29fc6046, 0x283e0a71,
+        0x2d711cf4, 0x2cb376c3, 0x2ef5c89a, 0x2f37a2ad, 0x709a8dc0, 0x7158e7f7,
+        0x731e59ae, 0x72dc3399, 0x7793251c, 0x76514f2b, 0x7417f172, 0x75d59b45,
+        0x7e89dc78, 0x7f4bb64f, 0x7d0d0816, 0x7ccf6221, 0x798074a4, 0x78421e93,
+        0x7a04a0ca, 0x7bc6cafd, 0x6cbc2eb0, 0x6d7e4487, 0x6f38fade, 0x6efa90e9,
+        0x6bb5866c, 0x6a77ec5b, 0x68315202, 0x69f33835, 0x62af7f08, 0x636d153f,
+        0x612bab66, 0x60e9c151, 0x65a6d7d4, 0x6464bde3, 0x662203ba, 0x67e0698d,
+        0x48d7cb20, 0x4915a117, 0x4b531f4e, 0x4a917579, 0x4fde63fc, 0x4e1c09cb,
+        0x4c5ab792, 0x4d98dda5, 0x46c49a98, 0x4706f0af, 0x45404ef6, 0x448224c1,
+        0x41cd3244, 0x400f5873, 0x4249e62a, 0x438b8c1d, 0x54f16850, 0x55330267,
+        0x5775bc3e, 0x56b7d609, 0x53f8c08c, 0x523aaabb, 0x507c14e2, 0x51be7ed5,
+        0x5ae239e8, 0x5b2053df, 0x5966ed86, 0x58a487b1, 0x5deb9134, 0x5c29fb03,
+        0x5e6f455a, 0x5fad2f6d, 0xe1351b80, 0xe0f771b7, 0xe2b1cfee, 0xe373a5d9,
+        0xe63cb35c, 0xe7fed96b, 0xe5b86732, 0xe47a0d05, 0xef264a38, 0xeee4200f,
+        0xeca29e56, 0xed60f461, 0xe82fe2e4, 0xe9ed88d3, 0xebab368a, 0xea695cbd,
+        0xfd13b8f0, 0xfcd1d2c7, 0xfe976c9e, 0xff5506a9, 0xfa1a102c, 0xfbd87a1b,
+        0xf99ec442, 0xf85cae75, 0xf300e948, 0xf2c2837f, 0xf0843d26, 0xf1465711,
+        0xf4094194, 0xf5cb2ba3, 0xf78d95fa, 0xf64fffcd, 0xd9785d60, 0xd8ba3757,
+        0xdafc890e, 0xdb3ee339, 0xde71f5bc, 0xdfb39f8b, 0xddf521d2, 0xdc374be5,
+        0xd76b0cd8, 0xd6a966ef, 0xd4efd8b6, 0xd52db281, 0xd062a404, 0xd1a0ce33,
+        0xd3e6706a, 0xd2241a5d, 0xc55efe10, 0xc49c9427, 0xc6da2a7e, 0xc7184049,
+        0xc25756cc, 0xc3953cfb, 0xc1d382a2, 0xc011e895, 0xcb4dafa8, 0xca8fc59f,
+        0xc8c97bc6, 0xc90b11f1, 0xcc440774, 0xcd866d43, 0xcfc0d31a, 0xce02b92d,
+        0x91af9640, 0x906dfc77, 0x922b422e, 0x93e92819, 0x96a63e9c, 0x976454ab,
+        0x9522eaf2, 0x94e080c5, 0x9fbcc7f8, 0x9e7eadcf, 0x9c381396, 0x9dfa79a1,
+        0x98b56f24, 0x99770513, 0x9b31bb4a, 0x9af3d17d, 0x8d893530, 0x8c4b5f07,
+        0x8e0de15e, 0x8fcf8b69, 0x8a809dec, 0x8b42f7db, 0x89044982, 0x88c623b5,
+        0x839a6488, 0x82580ebf, 0x801eb0e6, 0x81dcdad1, 0x8493cc54, 0x8551a663,
+        0x8717183a, 0x86d5720d, 0xa9e2d0a0, 0xa820ba97, 0xaa6604ce, 0xaba46ef9,
+        0xaeeb787c, 0xaf29124b, 0xad6fac12, 0xacadc625, 0xa7f18118, 0xa633eb2f,
+        0xa4755576, 0xa5b73f41, 0xa0f829c4, 0xa13a43f3, 0xa37cfdaa, 0xa2be979d,
+        0xb5c473d0, 0xb40619e7, 0xb640a7be, 0xb782cd89, 0xb2cddb0c, 0xb30fb13b,
+        0xb1490f62, 0xb08b6555, 0xbbd72268, 0xba15485f, 0xb853f606, 0xb9919c31,
+        0xbcde8ab4, 0xbd1ce083, 0xbf5a5eda, 0xbe9834ed,
+    },
+    {
+        0x00000000, 0xb8bc6765, 0xaa09c88b, 0x12b5afee, 0x8f629757, 0x37def032,
+        0x256b5fdc, 0x9dd738b9, 0xc5b428ef, 0x7d084f8a, 0x6fbde064, 0xd7018701,
+        0x4ad6bfb8, 0xf26ad8dd, 0xe0df7733, 0x58631056, 0x5019579f, 0xe8a530fa,
+        0xfa109f14, 0x42acf871, 0xdf7bc0c8, 0x67c7a7ad, 0x75720843, 0xcdce6f26,
+        0x95ad7f70, 0x2d111815, 0x3fa4b7fb, 0x8718d09e, 0x1acfe827, 0xa2738f42,
+        0xb0c620ac, 0x087a47c9, 0xa032af3e, 0x188ec85b, 0x0a3b67b5, 0xb28700d0,
+        0x2f503869, 0x97ec5f0c, 0x8559f0e2, 0x3de59787, 0x658687d1, 0xdd3ae0b4,
+        0xcf8f4f5a, 0x7733283f, 0xeae41086, 0x525877e3, 0x40edd80d, 0xf851bf68,
+        0xf02bf8a1, 0x48979fc4, 0x5a22302a, 0xe29e574f, 0x7f496ff6, 0xc7f50893,
+        0xd540a77d, 0x6dfcc018, 0x359fd04e, 0x8d23b72b, 0x9f9618c5, 0x272a7fa0,
+        0xbafd4719, 0x0241207c, 0x10f48f92, 0xa848e8f7, 0x9b14583d, 0x23a83f58,
+        0x311d90b6, 0x89a1f7d3, 0x1476cf6a, 0xaccaa80f, 0xbe7f07e1, 0x06c36084,
+        0x5ea070d2, 0xe61c17b7, 0xf4a9b859, 0x4c15df3c, 0xd1c2e785, 0x697e80e0,
+        0x7bcb2f0e, 0xc377486b, 0xcb0d0fa2, 0x73b168c7, 0x6104c729, 0xd9b8a04c,
+        0x446f98f5, 0xfcd3ff90, 0xee66507e, 0x56da371b, 0x0eb9274d, 0xb6054028,
+        0xa4b0efc6, 0x1c0c88a3, 0x81dbb01a, 0x3967d77f, 0x2bd27891, 0x936e1ff4,
+        0x3b26f703, 0x839a9066, 0x912f3f88, 0x299358ed, 0xb4446054, 0x0cf80731,
+        0x1e4da8df, 0xa6f1cfba, 0xfe92dfec, 0x462eb889, 0x549b1767, 0xec277002,
+        0x71f048bb, 0xc94c2fde, 0xdbf98030, 0x6345e755, 0x6b3fa09c, 0xd383c7f9,
+        0xc1366817, 0x798a0f72, 0xe45d37cb, 0x5ce150ae, 0x4e54ff40, 0xf6e89825,
+        0xae8b8873, 0x1637ef16, 0x048240f8, 0xbc3e279d, 0x21e91f24, 0x99557841,
+        0x8be0d7af, 0x335cb0ca, 0xed59b63b, 0x55e5d15e, 0x47507eb0, 0xffec19d5,
+        0x623b216c, 0xda874609, 0xc832e9e7, 0x708e8e82, 0x28ed9ed4, 0x9051f9b1,
+        0x82e4565f, 0x3a58313a, 0xa78f0983, 0x1f336ee6, 0x0d86c108, 0xb53aa66d,
+        0xbd40e1a4, 0x05fc86c1, 0x1749292f, 0xaff54e4a, 0x322276f3, 0x8a9e1196,
+        0x982bbe78, 0x2097d91d, 0x78f4c94b, 0xc048ae2e, 0xd2fd01c0, 0x6a4166a5,
+        0xf7965e1c, 0x4f2a3979, 0x5d9f9697, 0xe523f1f2, 0x4d6b1905, 0xf5d77e60,
+        0xe762d18e, 0x5fdeb6eb, 0xc2098e52, 0x7ab5e937, 0x680046d9, 0xd0bc21bc,
+        0x88df31ea, 0x3063568f, 0x22d6f961, 0x9a6a9e04, 0x07bda6bd, 0xbf01c1d8,
+        0xadb46e36, 0x15080953, 0x1d724e9a, 0xa5ce29ff, 0xb77b8611, 0x0fc7e174,
+        0x9210d9cd, 0x2aacbea8, 0x38191146, 0x80a57623, 0xd8c66675, 0x607a0110,
+        0x72cfaefe, 0xca73c99b, 0x57a4f122, 0xef189647, 0xfdad39a9, 0x45115ecc,
+        0x764dee06, 0xcef18963, 0xdc44268d, 0x64f841e8, 0xf92f7951, 0x41931e34,
+        0x5326b1da, 0xeb9ad6bf, 0xb3f9c6e9, 0x0b45a18c, 0x19f00e62, 0xa14c6907,
+        0x3c9b51be, 0x842736db, 0x96929935, 0x2e2efe50, 0x2654b999, 0x9ee8defc,
+        0x8c5d7112, 0x34e11677, 0xa9362ece, 0x118a49ab, 0x033fe645, 0xbb838120,
+        0xe3e09176, 0x5b5cf613, 0x49e959fd, 0xf1553e98, 0x6c820621, 0xd43e6144,
+        0xc68bceaa, 0x7e37a9cf, 0xd67f4138, 0x6ec3265d, 0x7c7689b3, 0xc4caeed6,
+        0x591dd66f, 0xe1a1b10a, 0xf3141ee4, 0x4ba87981, 0x13cb69d7, 0xab770eb2,
+        0xb9c2a15c, 0x017ec639, 0x9ca9fe80, 0x241599e5, 0x36a0360b, 0x8e1c516e,
+        0x866616a7, 0x3eda71c2, 0x2c6fde2c, 0x94d3b949, 0x090481f0, 0xb1b8e695,
+        0xa30d497b, 0x1bb12e1e, 0x43d23e48, 0xfb6e592d, 0xe9dbf6c3, 0x516791a6,
+        0xccb0a91f, 0x740cce7a, 0x66b96194, 0xde0506f1,
+    },
+#endif
+};
+
+/* Entry i of a table packed 32/width entries per word */
+static inline uint32_t entry8(const uint32_t *t, uint32_t i)
+{
+    return (t[i >> 2] >> ((i & 3) * 8)) & 0xff;
+}
+
+static inline uint32_t entry16(const uint32_t *t, uint32_t i)
+{
+    return (t[i >> 1] >> ((i & 1) * 16)) & 0xffff;
+}
+
+static inline uint32_t entry32(const uint32_t *t, uint32_t i)
+{
+    return t[i];
+}
+
+/* Expands to the body of a CRC function, with 'entry' the accessor for
+   the width's packed tables. 'crc' is the width's register, already
+   including any pre-inversion. */
+#if CRC_KERNEL == 4
+#define CRC_BODY(table, entry)                                          \
+    const uint8_t *p = data;                                            \
+    uint32_t c = crc;                                                   \
+    while (len && ((uintptr_t)p & 3)) {                                 \
+        c = entry(table[0], (c ^ *p++) & 0xff) ^ (c >> 8);              \
+        len--;                                                          \
+    }                                                                   \
+    for (; len >= 4; len -= 4, p += 4) {                                \
+        c ^= *(const uint32_t *)p;                                      \
+        c = entry(table[3], c & 0xff) ^ entry(table[2], (c >> 8) & 0xff) \
+          ^ entry(table[1], (c >> 16) & 0xff) ^ entry(table[0], c >> 24); \
+    }                                                                   \
+    while (len--)                                                       \
+        c = entry(table[0], (c ^ *p++) & 0xff) ^ (c >> 8);
+#else
+#define CRC_BODY(table, entry)                                          \
+    const uint8_t *p = data;                                            \
+    uint32_t c = crc;                                                   \
+    while (len--)                                                       \
+        c = entry(table[0], (c ^ *p++) & 0xff) ^ (c >> 8);
+#endif
+
+uint8_t crc8_maxim(uint8_t crc, const void *data, size_t len)
+{
+    CRC_BODY(crc8_table, entry8)
+    return c;
+}
+
+uint16_t crc16_ibm(uint16_t crc, const void *data, size_t len)
+{
+    CRC_BODY(crc16_table, entry16)
+    return c;
+}
+
+uint32_t crc32_ieee(uint32_t crc, const void *data, size_t len)
+{
+    crc = ~crc;
+    CRC_BODY(crc32_table, entry32)
+    return ~c;
+}
+
+#endif /* CRC_KERNEL */
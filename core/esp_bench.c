@@ -0,0 +1,133 @@
+/* On-device micro-benchmarks, see esp/bench.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <esp/bench.h>
+#include <esp/perf.h>
+#include <esp/interrupts.h>
+#include <esp/rom.h>
+#include <common_macros.h>
+#include <string.h>
+#include <stdio.h>
+
+static bench_t *_benches;
+static bench_t **_benches_tail = &_benches;
+
+void bench_register(bench_t *bench)
+{
+    bench->next = NULL;
+    *_benches_tail = bench;
+    _benches_tail = &bench->next;
+}
+
+bench_t *bench_list(void)
+{
+    return _benches;
+}
+
+void IRAM bench_flush_cache(void)
+{
+    /* Nothing may run from flash while the cache is off */
+    uint32_t old_level = _xt_disable_interrupts();
+    Cache_Read_Disable();
+    Cache_Read_Enable(0, 0, 1);
+    _xt_restore_interrupts(old_level);
+}
+
+static void IRAM __attribute__((noinline)) _null(void *arg)
+{
+}
+
+/* In IRAM so the timing loop itself doesn't depend on the flash cache,
+   and never inlined, so the empty runs cost exactly what real ones do */
+static uint32_t IRAM __attribute__((noinline)) _sample(bench_fn_t fn, void *arg, uint16_t iterations, uint16_t flags)
+{
+    uint32_t old_level = 0;
+
+    if (flags & BENCH_FLUSH_CACHE)
+        bench_flush_cache();
+    if (flags & BENCH_NO_IRQ)
+        old_level = _xt_disable_interrupts();
+
+    uint32_t start = perf_ccount();
+    for (uint16_t i = 0; i < iterations; i++)
+        fn(arg);
+    uint32_t cycles = perf_ccount() - start;
+
+    if (flags & BENCH_NO_IRQ)
+        _xt_restore_interrupts(old_level);
+    return cycles;
+}
+
+void bench_measure(const bench_t *bench, uint16_t samples, bench_result_t *result)
+{
+    uint32_t cycles[BENCH_MAX_SAMPLES];
+    uint32_t overhead = UINT32_MAX;
+    uint16_t iterations = bench->iterations ? bench->iterations : 1;
+
+    if (bench->flags & BENCH_FLUSH_CACHE)
+        iterations = 1;
+    if (!samples)
+        samples = BENCH_SAMPLES;
+    if (samples > BENCH_MAX_SAMPLES)
+        samples = BENCH_MAX_SAMPLES;
+
+    /* The loop and call overhead, from the fastest of the empty runs */
+    for (uint16_t i = 0; i < samples; i++) {
+        uint32_t c = _sample(_null, NULL, iterations, bench->flags & ~BENCH_FLUSH_CACHE);
+        if (c < overhead)
+            overhead = c;
+    }
+
+    for (int i = 0; i < BENCH_WARMUP; i++)
+        bench->fn(bench->arg);
+
+    for (uint16_t i = 0; i < samples; i++) {
+        uint32_t c = _sample(bench->fn, bench->arg, iterations, bench->flags);
+        c = c > overhead ? (c - overhead) / iterations : 0;
+        /* insertion sort, for the median */
+        uint16_t j = i;
+        for (; j > 0 && cycles[j - 1] > c; j--)
+            cycles[j] = cycles[j - 1];
+        cycles[j] = c;
+    }
+
+    result->min = cycles[0];
+    result->median = cycles[samples / 2];
+    result->max = cycles[samples - 1];
+    result->samples = samples;
+    result->iterations = iterations;
+}
+
+void bench_print(const char *name, const bench_result_t *result, bench_format_t format)
+{
+    if (format == BENCH_JSON) {
+        printf("{\"bench\":\"%s\",\"samples\":%u,\"iterations\":%u,"
+               "\"min\":%u,\"median\":%u,\"max\":%u}\n", name,
+               result->samples, result->iterations,
+               result->min, result->median, result->max);
+    } else {
+        printf("BENCH,%s,%u,%u,%u,%u,%u\n", name,
+               result->samples, result->iterations,
+               result->min, result->median, result->max);
+    }
+}
+
+int bench_run(const char *prefix, bench_format_t format)
+{
+    int count = 0;
+
+    if (format == BENCH_CSV)
+        printf("# BENCH,name,samples,iterations,min,median,max\n");
+    for (bench_t *bench = _benches; bench; bench = bench->next) {
+        if (prefix && strncmp(bench->name, prefix, strlen(prefix)))
+            continue;
+        bench_result_t result;
+        bench_measure(bench, 0, &result);
+        bench_print(bench->name, &result, format);
+        count++;
+    }
+    return count;
+}
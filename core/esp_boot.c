@@ -0,0 +1,52 @@
+/* Boot time profiling, see esp/boot.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <esp/boot.h>
+#include <stdio.h>
+
+#include "common_macros.h"
+#include "esp/perf.h"
+
+/* The first marks are made before .bss is zeroed, so keep these in .data */
+static boot_mark_t marks[BOOT_MARKS_MAX] __attribute__((section(".data")));
+static int mark_count __attribute__((section(".data")));
+
+void IRAM boot_mark(const char *name)
+{
+    uint32_t ccount = perf_ccount();
+
+    if (mark_count >= BOOT_MARKS_MAX)
+        return;
+    marks[mark_count].name = name;
+    marks[mark_count].ccount = ccount;
+    mark_count++;
+}
+
+int boot_marks_get(const boot_mark_t **result)
+{
+    *result = marks;
+    return mark_count;
+}
+
+static void print_ms(uint32_t cycles)
+{
+    uint32_t us = cycles / 80;
+    printf(" %6u.%03u", us / 1000, us % 1000);
+}
+
+void boot_report(void)
+{
+    uint32_t prev = 0;
+
+    printf("boot: %-16s %10s %10s\n", "mark", "ms", "+ms");
+    for (int i = 0; i < mark_count; i++) {
+        printf("boot: %-16s", marks[i].name);
+        print_ms(marks[i].ccount);
+        print_ms(marks[i].ccount - prev);
+        printf("\n");
+        prev = marks[i].ccount;
+    }
+}
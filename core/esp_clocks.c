@@ -0,0 +1,53 @@
+/* Runtime CPU clock switching, see esp/clocks.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <esp/clocks.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "espressif/esp_system.h"
+
+static cpu_freq_notifier_t *notifiers;
+
+void cpu_freq_register(cpu_freq_notifier_t *notifier)
+{
+    vTaskSuspendAll();
+    notifier->next = notifiers;
+    notifiers = notifier;
+    xTaskResumeAll();
+}
+
+void cpu_freq_unregister(cpu_freq_notifier_t *notifier)
+{
+    vTaskSuspendAll();
+    for (cpu_freq_notifier_t **p = &notifiers; *p; p = &(*p)->next) {
+        if (*p == notifier) {
+            *p = notifier->next;
+            break;
+        }
+    }
+    xTaskResumeAll();
+}
+
+bool cpu_set_freq(uint32_t mhz)
+{
+    if (mhz != 80 && mhz != 160)
+        return false;
+    if (cpu_clk_freq() == mhz * 1000000)
+        return true;
+
+    vTaskSuspendAll();
+    vPortEnterCritical();
+    sdk_system_update_cpu_freq(mhz);
+    vPortCpuFreqChanged();
+    vPortExitCritical();
+
+    uint32_t freq_hz = cpu_clk_freq();
+    for (cpu_freq_notifier_t *n = notifiers; n; n = n->next)
+        n->changed(freq_hz, n->arg);
+    xTaskResumeAll();
+    return true;
+}
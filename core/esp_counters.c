@@ -0,0 +1,138 @@
+/* Performance counter registry for esp/counters.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <esp/counters.h>
+#include <esp/interrupts.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+static counter_t *_head;
+static counter_t **_tail = &_head;
+
+void counter_register(counter_t *counter)
+{
+    /* Constructors run before the scheduler, so no lock */
+    counter->next = NULL;
+    *_tail = counter;
+    _tail = &counter->next;
+}
+
+void counter_add_safe(counter_t *counter, uint32_t n)
+{
+    uint32_t old_level = _xt_disable_interrupts();
+    counter->value += n;
+    _xt_restore_interrupts(old_level);
+}
+
+counter_t *counters_list(void)
+{
+    return _head;
+}
+
+counter_t *counter_find(const char *name)
+{
+    for (counter_t *c = _head; c; c = c->next) {
+        if (!strcmp(c->name, name))
+            return c;
+    }
+    return NULL;
+}
+
+static uint32_t _value(const counter_t *c)
+{
+    return c->read ? c->read() : c->value;
+}
+
+static int _slots(const counter_t *c)
+{
+    return c->type == COUNTER_TYPE_HISTOGRAM ? 1 + COUNTER_HISTOGRAM_BUCKETS : 1;
+}
+
+void counters_snapshot(counters_snapshot_t *snap)
+{
+    int n = 0;
+
+    for (counter_t *c = _head; c && n + _slots(c) <= COUNTERS_MAX_VALUES; c = c->next) {
+        snap->values[n++] = _value(c);
+        if (c->type == COUNTER_TYPE_HISTOGRAM) {
+            for (int i = 0; i < COUNTER_HISTOGRAM_BUCKETS; i++)
+                snap->values[n++] = c->buckets[i];
+        }
+    }
+    snap->n = n;
+}
+
+void counters_reset(void)
+{
+    for (counter_t *c = _head; c; c = c->next) {
+        if (c->read || c->type == COUNTER_TYPE_GAUGE)
+            continue;
+        uint32_t old_level = _xt_disable_interrupts();
+        c->value = 0;
+        if (c->type == COUNTER_TYPE_HISTOGRAM)
+            memset((void *)c->buckets, 0, COUNTER_HISTOGRAM_BUCKETS * sizeof(c->buckets[0]));
+        _xt_restore_interrupts(old_level);
+    }
+}
+
+int counters_format(char *buf, size_t len, const counters_snapshot_t *since)
+{
+    int total = 0;
+    int slot = 0;
+    int r;
+
+/* Keep going once truncated, so the result is the length needed */
+#define APPEND(...) do {                                        \
+        size_t off = (size_t)total < len ? (size_t)total : len; \
+        r = snprintf(buf + off, len - off, __VA_ARGS__);        \
+        if (r > 0)                                              \
+            total += r;                                         \
+    } while (0)
+
+    if (len)
+        buf[0] = 0;
+    for (counter_t *c = _head; c; c = c->next) {
+        /* The snapshot's value for this counter, if it has one */
+        bool have = since && slot + _slots(c) <= since->n;
+        const uint32_t *old = have ? &since->values[slot] : NULL;
+        uint32_t value = _value(c);
+        slot += _slots(c);
+
+        if (c->type != COUNTER_TYPE_HISTOGRAM) {
+            if (old && c->type == COUNTER_TYPE_COUNTER)
+                APPEND("%s %u +%u\n", c->name, value, value - old[0]);
+            else
+                APPEND("%s %u\n", c->name, value);
+            continue;
+        }
+        /* Histograms: count, sum and buckets, all since the snapshot
+           if there's one */
+        uint32_t buckets[COUNTER_HISTOGRAM_BUCKETS], count = 0;
+        for (int i = 0; i < COUNTER_HISTOGRAM_BUCKETS; i++) {
+            buckets[i] = c->buckets[i] - (old ? old[1 + i] : 0);
+            count += buckets[i];
+        }
+        APPEND("%s count %u sum %u buckets", c->name, count, value - (old ? old[0] : 0));
+        for (int i = 0; i < COUNTER_HISTOGRAM_BUCKETS; i++)
+            APPEND(" %u", buckets[i]);
+        APPEND("\n");
+    }
+
+#undef APPEND
+    return total;
+}
+
+void counters_dump(const counters_snapshot_t *since)
+{
+    int len = counters_format(NULL, 0, since);
+    char *buf = malloc(len + 1);
+    if (!buf)
+        return;
+    counters_format(buf, len + 1, since);
+    fwrite(buf, 1, len, stdout);
+    free(buf);
+}
@@ -0,0 +1,124 @@
+/* Deferred interrupt work for esp/deferred.h
+ *
+ * Pending calls live in a ring of (fn, arg) records. Level 1 interrupts
+ * don't nest, so posts from ISRs are already serialised; posts from
+ * tasks briefly disable interrupts. The worker task is the only
+ * consumer, so taking records needs no lock.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <esp/deferred.h>
+#include <esp/interrupts.h>
+#include <stdlib.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+typedef struct {
+    deferred_fn_t fn;
+    void *arg;
+} _deferred_call_t;
+
+static _deferred_call_t *_queue;
+static uint32_t _mask;
+static volatile uint32_t _head;
+static volatile uint32_t _tail;
+static volatile uint32_t _dropped;
+
+/* Worker is (about to be) blocked on its task notification */
+static volatile bool _waiting;
+static xTaskHandle _task;
+
+static void _deferred_task(void *pvParameters)
+{
+    for (;;) {
+        while (_tail != _head) {
+            _deferred_call_t call = _queue[_tail & _mask];
+            _tail++;
+            call.fn(call.arg);
+        }
+
+        _waiting = true;
+        /* A post after the check above sees _waiting and wakes us */
+        if (_tail == _head)
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        _waiting = false;
+    }
+}
+
+bool deferred_init(uint32_t priority, size_t queue_len)
+{
+    size_t len = 1;
+
+    if (_queue)
+        return false;
+    while (len < queue_len)
+        len <<= 1;
+
+    _deferred_call_t *queue = malloc(len * sizeof(_deferred_call_t));
+    if (!queue)
+        return false;
+
+    _mask = len - 1;
+    _head = _tail = 0;
+    _queue = queue;
+
+    if (xTaskCreate(_deferred_task, (signed char *)"deferred", DEFERRED_TASK_STACK_SIZE,
+                    NULL, priority, &_task) != pdPASS) {
+        _queue = NULL;
+        free(queue);
+        return false;
+    }
+    return true;
+}
+
+/* Must be called with interrupts disabled (or from an ISR) */
+static bool IRAM _deferred_post(deferred_fn_t fn, void *arg, portBASE_TYPE *woken)
+{
+    uint32_t head = _head;
+
+    if (!_queue || head - _tail > _mask) {
+        _dropped++;
+        return false;
+    }
+    _queue[head & _mask].fn = fn;
+    _queue[head & _mask].arg = arg;
+    _head = head + 1;
+
+    if (_waiting) {
+        _waiting = false;
+        vTaskNotifyGiveFromISR(_task, woken);
+    }
+    return true;
+}
+
+bool IRAM deferred_call_from_isr(deferred_fn_t fn, void *arg)
+{
+    portBASE_TYPE woken = pdFALSE;
+    bool ok = _deferred_post(fn, arg, &woken);
+
+    /* Only switches once the interrupt returns, so several posts from
+       one burst of ISRs still end up as a single switch */
+    if (woken)
+        portYIELD();
+    return ok;
+}
+
+bool deferred_call(deferred_fn_t fn, void *arg)
+{
+    portBASE_TYPE woken = pdFALSE;
+
+    uint32_t old_level = _xt_disable_interrupts();
+    bool ok = _deferred_post(fn, arg, &woken);
+    _xt_restore_interrupts(old_level);
+
+    if (woken)
+        taskYIELD();
+    return ok;
+}
+
+uint32_t deferred_dropped(void)
+{
+    return _dropped;
+}
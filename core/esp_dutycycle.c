@@ -0,0 +1,202 @@
+/* Deep sleep duty cycle scheduler for esp/dutycycle.h
+ *
+ * The state lives in RAM while awake, and is written back to RTC memory
+ * (word by word, it can't take anything smaller) just before sleeping.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <esp/dutycycle.h>
+#include <esp/rtcmem_regs.h>
+#include <esp/uart.h>
+#include <string.h>
+#include <stdio.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <crc.h>
+
+#include "espressif/esp_system.h"
+
+#define _MAGIC 0x44555459   /* "DUTY" */
+
+/* sdk_system_deep_sleep_set_option(), for the next wake */
+#define _WAKE_RF_ON 1
+#define _WAKE_RF_OFF 4
+
+#define _FLAG_RADIO 1       /* this wake has the radio on */
+
+/* Longest sleep sdk_system_deep_sleep() can take, in a uint32_t of us */
+#define _SLEEP_LIMIT_S 4294
+
+typedef struct {
+    uint32_t magic;
+    uint32_t crc;           /* of everything after it */
+    uint32_t now_s;
+    uint16_t now_ms;
+    uint8_t n_jobs;
+    uint8_t flags;
+    uint32_t wakes;
+    uint32_t radio_wakes;
+    uint32_t connects;
+    uint32_t failures;
+    struct {
+        uint32_t next_s;
+        uint16_t runs;
+        uint16_t failures;
+    } job[DUTYCYCLE_MAX_JOBS];
+} _state_t;
+
+_Static_assert(sizeof(_state_t) == DUTYCYCLE_RTC_WORDS * sizeof(uint32_t),
+               "_state_t doesn't match DUTYCYCLE_RTC_WORDS");
+
+static _state_t _state;
+
+static uint32_t _crc(const _state_t *s)
+{
+    return crc32_ieee(0, &s->now_s, sizeof(*s) - offsetof(_state_t, now_s));
+}
+
+static void _load(size_t offset, int n_jobs)
+{
+    uint32_t *words = (uint32_t *)&_state;
+
+    if (offset + DUTYCYCLE_RTC_WORDS <= sizeof(RTCMEM_USER) / sizeof(uint32_t)) {
+        for (int i = 0; i < DUTYCYCLE_RTC_WORDS; i++)
+            words[i] = RTCMEM_USER[offset + i];
+        if (_state.magic == _MAGIC && _state.crc == _crc(&_state) && _state.n_jobs == n_jobs)
+            return;
+    }
+    /* First power up, or a different job table: all due now. Power up
+       always has the radio on. */
+    memset(&_state, 0, sizeof(_state));
+    _state.magic = _MAGIC;
+    _state.n_jobs = n_jobs;
+    _state.flags = _FLAG_RADIO;
+}
+
+static void _save(size_t offset)
+{
+    const uint32_t *words = (const uint32_t *)&_state;
+
+    if (offset + DUTYCYCLE_RTC_WORDS > sizeof(RTCMEM_USER) / sizeof(uint32_t))
+        return;
+    _state.crc = _crc(&_state);
+    for (int i = 0; i < DUTYCYCLE_RTC_WORDS; i++)
+        RTCMEM_USER[offset + i] = words[i];
+}
+
+static bool _due(int i)
+{
+    return (int32_t)(_state.job[i].next_s - _state.now_s) <= 0;
+}
+
+static void _run_job(const dutycycle_config_t *config, const dutycycle_job_t *job, int i)
+{
+    bool ok = job->fn(job->arg);
+
+    _state.job[i].runs++;
+    if (!ok) {
+        _state.job[i].failures++;
+        _state.failures++;
+    }
+    /* A job may have rescheduled itself with dutycycle_set_next() */
+    if (!_due(i))
+        return;
+    uint32_t after = ok ? job->period_s : config->retry_s;
+    if (after > job->period_s)
+        after = job->period_s;
+    _state.job[i].next_s = _state.now_s + (after ? after : 1);
+}
+
+void dutycycle_run(const dutycycle_config_t *config, const dutycycle_job_t *jobs, int n_jobs)
+{
+    if (n_jobs > DUTYCYCLE_MAX_JOBS)
+        n_jobs = DUTYCYCLE_MAX_JOBS;
+    _load(config->rtc_offset, n_jobs);
+
+    bool radio = _state.flags & _FLAG_RADIO;
+    _state.wakes++;
+    if (radio)
+        _state.radio_wakes++;
+
+    /* Jobs without the network first, so their results are there for
+       the ones that send them */
+    for (int i = 0; i < n_jobs; i++) {
+        if (!jobs[i].needs_wifi && _due(i))
+            _run_job(config, &jobs[i], i);
+    }
+
+    bool tried = false, connected = false;
+    for (int i = 0; i < n_jobs; i++) {
+        if (!jobs[i].needs_wifi || !_due(i))
+            continue;
+        if (!radio) {
+            /* Due a little early, or late, for the wake planned for it:
+               it goes at the next wake, which will have the radio on */
+            continue;
+        }
+        if (!tried) {
+            tried = true;
+            connected = config->wifi_connect && config->wifi_connect();
+            if (connected)
+                _state.connects++;
+            else
+                _state.failures++;
+        }
+        if (connected) {
+            _run_job(config, &jobs[i], i);
+        } else {
+            _state.job[i].failures++;
+            _state.job[i].next_s = _state.now_s + (config->retry_s ? config->retry_s : 1);
+        }
+    }
+    /* Sleep until the first job due, and only have the radio if one of
+       the jobs due by then needs it */
+    uint32_t sleep_s = config->max_sleep_s;
+    if (sleep_s > _SLEEP_LIMIT_S)
+        sleep_s = _SLEEP_LIMIT_S;
+    for (int i = 0; i < n_jobs; i++) {
+        int32_t left = _state.job[i].next_s - _state.now_s;
+        if (left < (int32_t)sleep_s)
+            sleep_s = left > 0 ? left : 1;
+    }
+
+    uint32_t awake_ms = xTaskGetTickCount() * portTICK_RATE_MS;
+    uint32_t ms = _state.now_ms + awake_ms;
+    _state.now_s += sleep_s + ms / 1000;
+    _state.now_ms = ms % 1000;
+
+    bool radio_next = false;
+    for (int i = 0; i < n_jobs; i++) {
+        if (jobs[i].needs_wifi && _due(i))
+            radio_next = true;
+    }
+    _state.flags = radio_next ? _FLAG_RADIO : 0;
+    if (tried && config->wifi_done)
+        config->wifi_done(connected, sleep_s * 1000);
+    _save(config->rtc_offset);
+
+    printf("dutycycle: awake %u ms, sleeping %u s, radio %s\n", awake_ms, sleep_s, radio_next ? "on" : "off");
+    uart_flush_txfifo(0);
+    sdk_system_deep_sleep_set_option(radio_next ? _WAKE_RF_ON : _WAKE_RF_OFF);
+    sdk_system_deep_sleep(sleep_s * 1000000);
+    while (1) {
+        vTaskDelay(1000 / portTICK_RATE_MS);
+    }
+}
+
+void dutycycle_get_stats(dutycycle_stats_t *stats)
+{
+    stats->now_s = _state.now_s;
+    stats->wakes = _state.wakes;
+    stats->radio_wakes = _state.radio_wakes;
+    stats->connects = _state.connects;
+    stats->failures = _state.failures;
+}
+
+void dutycycle_set_next(int index, uint32_t due_s)
+{
+    if (index >= 0 && index < _state.n_jobs)
+        _state.job[index].next_s = due_s;
+}
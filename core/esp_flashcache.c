@@ -0,0 +1,218 @@
+/* Flash read cache for esp/flashcache.h
+ *
+ * Lines are looked up by linear search, with a use stamp for LRU
+ * replacement: caches are a handful of lines, so that beats keeping
+ * a list in order.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <esp/flashcache.h>
+#include <esp/perf.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+
+#define NO_LINE 0xffffffff
+#define LINE_MASK (~(FLASHCACHE_LINE_SIZE - 1))
+
+typedef struct {
+    uint32_t addr;      /* flash address of the line, NO_LINE if empty */
+    uint32_t used;      /* use stamp, higher is more recent */
+    uint32_t data[FLASHCACHE_LINE_SIZE / 4];
+} _flashcache_line_t;
+
+static _flashcache_line_t *_lines;
+static size_t _line_count;
+static uint32_t _stamp;
+static xSemaphoreHandle _lock;
+static flashcache_stats_t _stats;
+
+bool flashcache_init(size_t lines)
+{
+    if (_lines || !lines)
+        return false;
+    _flashcache_line_t *l = malloc(lines * sizeof(_flashcache_line_t));
+    if (!l)
+        return false;
+    _lock = xSemaphoreCreateMutex();
+    if (!_lock) {
+        free(l);
+        return false;
+    }
+    for (size_t i = 0; i < lines; i++)
+        l[i].addr = NO_LINE;
+    _line_count = lines;
+    _lines = l;
+    return true;
+}
+
+/* Uncached read of any alignment, through a word buffer */
+static sdk_SpiFlashOpResult _read_direct(uint32_t addr, uint8_t *buf, uint32_t len)
+{
+    uint32_t words[16];
+
+    if (!((addr | (uint32_t)buf | len) & 3))
+        return sdk_spi_flash_read(addr, buf, len);
+    while (len) {
+        uint32_t skip = addr & 3;
+        uint32_t n = sizeof(words) - skip;
+        if (n > len)
+            n = len;
+        sdk_SpiFlashOpResult r = sdk_spi_flash_read(addr - skip, words, (skip + n + 3) & ~3);
+        if (r != SPI_FLASH_RESULT_OK)
+            return r;
+        memcpy(buf, (uint8_t *)words + skip, n);
+        buf += n;
+        addr += n;
+        len -= n;
+    }
+    return SPI_FLASH_RESULT_OK;
+}
+
+/* Find the line holding 'addr', reading it in if needed. Sets *miss
+   if it had to go to flash. */
+static _flashcache_line_t *_get_line(uint32_t addr, bool *miss)
+{
+    _flashcache_line_t *victim = &_lines[0];
+
+    for (size_t i = 0; i < _line_count; i++) {
+        _flashcache_line_t *l = &_lines[i];
+        if (l->addr == addr) {
+            l->used = ++_stamp;
+            _stats.hits++;
+            return l;
+        }
+        if (l->addr == NO_LINE || (victim->addr != NO_LINE && l->used < victim->used))
+            victim = l;
+    }
+
+    *miss = true;
+    _stats.misses++;
+    victim->addr = NO_LINE;
+    if (sdk_spi_flash_read(addr, victim->data, FLASHCACHE_LINE_SIZE) != SPI_FLASH_RESULT_OK)
+        return NULL;
+    victim->addr = addr;
+    victim->used = ++_stamp;
+    return victim;
+}
+
+sdk_SpiFlashOpResult flashcache_read(uint32_t addr, void *buf, uint32_t len)
+{
+    if (!_lines)
+        return _read_direct(addr, buf, len);
+    if (len > FLASHCACHE_BYPASS_LEN) {
+        _stats.bypassed++;
+        return _read_direct(addr, buf, len);
+    }
+
+    sdk_SpiFlashOpResult result = SPI_FLASH_RESULT_OK;
+    bool miss = false;
+    uint8_t *out = buf;
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    uint32_t start = perf_ccount();
+    while (len) {
+        uint32_t line_addr = addr & LINE_MASK;
+        uint32_t offs = addr - line_addr;
+        uint32_t n = FLASHCACHE_LINE_SIZE - offs;
+        if (n > len)
+            n = len;
+        _flashcache_line_t *l = _get_line(line_addr, &miss);
+        if (!l) {
+            result = SPI_FLASH_RESULT_ERR;
+            break;
+        }
+        memcpy(out, (uint8_t *)l->data + offs, n);
+        out += n;
+        addr += n;
+        len -= n;
+    }
+    uint32_t cycles = perf_ccount() - start;
+    if (miss) {
+        _stats.miss_reads++;
+        _stats.miss_cycles += cycles;
+    } else {
+        _stats.hit_reads++;
+        _stats.hit_cycles += cycles;
+    }
+    xSemaphoreGive(_lock);
+    return result;
+}
+
+static void _invalidate_range(uint32_t addr, uint32_t len)
+{
+    for (size_t i = 0; i < _line_count; i++) {
+        _flashcache_line_t *l = &_lines[i];
+        if (l->addr != NO_LINE && l->addr < addr + len && addr < l->addr + FLASHCACHE_LINE_SIZE) {
+            l->addr = NO_LINE;
+            _stats.invalidated++;
+        }
+    }
+}
+
+sdk_SpiFlashOpResult flashcache_write(uint32_t addr, const void *buf, uint32_t len)
+{
+    if (!_lines)
+        return sdk_spi_flash_write(addr, buf, len);
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    /* invalidate even on failure, a partial write may have happened */
+    sdk_SpiFlashOpResult result = sdk_spi_flash_write(addr, buf, len);
+    _invalidate_range(addr, len);
+    xSemaphoreGive(_lock);
+    return result;
+}
+
+sdk_SpiFlashOpResult flashcache_erase_sector(uint16_t sector)
+{
+    if (!_lines)
+        return sdk_spi_flash_erase_sector(sector);
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    sdk_SpiFlashOpResult result = sdk_spi_flash_erase_sector(sector);
+    _invalidate_range(sector * SPI_FLASH_SEC_SIZE, SPI_FLASH_SEC_SIZE);
+    xSemaphoreGive(_lock);
+    return result;
+}
+
+void flashcache_invalidate(void)
+{
+    if (!_lines)
+        return;
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    _invalidate_range(0, UINT32_MAX);
+    xSemaphoreGive(_lock);
+}
+
+void flashcache_stats_get(flashcache_stats_t *stats)
+{
+    taskENTER_CRITICAL();
+    *stats = _stats;
+    taskEXIT_CRITICAL();
+}
+
+void flashcache_stats_reset(void)
+{
+    taskENTER_CRITICAL();
+    memset(&_stats, 0, sizeof(_stats));
+    taskEXIT_CRITICAL();
+}
+
+void flashcache_stats_dump(void)
+{
+    flashcache_stats_t s;
+
+    flashcache_stats_get(&s);
+    uint32_t lines = s.hits + s.misses;
+    printf("flashcache: %u lines, %u hits, %u misses (%u%% hit rate), %u bypassed, %u invalidated\n",
+           (uint32_t)_line_count, s.hits, s.misses, lines ? (uint32_t)((uint64_t)s.hits * 100 / lines) : 0,
+           s.bypassed, s.invalidated);
+    printf("flashcache: average read %u cycles on hit, %u cycles on miss\n",
+           s.hit_reads ? s.hit_cycles / s.hit_reads : 0,
+           s.miss_reads ? s.miss_cycles / s.miss_reads : 0);
+}
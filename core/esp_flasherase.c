@@ -0,0 +1,312 @@
+/* Yielding flash erase service, see esp/flasherase.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <esp/flasherase.h>
+#include <esp/flashcache.h>
+#include <esp/clocks.h>
+#include <esp/perf.h>
+#include <string.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <queue.h>
+
+#include "common_macros.h"
+#include "esp/rom.h"
+#include "esp/spi_regs.h"
+#include "espressif/spi_flash.h"
+
+#define SECTOR_SIZE 4096
+
+#ifndef FLASHERASE_TASK_STACK_SIZE
+#define FLASHERASE_TASK_STACK_SIZE 256
+#endif
+
+/* Status register bits */
+#define STATUS_BUSY 0x01
+#define STATUS_BP   0x7c    /* block protect (and SRP0) */
+
+/* Erase suspend/resume, the same on Winbond and GigaDevice parts */
+#define CMD_SUSPEND 0x75
+#define CMD_RESUME  0x7a
+
+#define VENDOR_WINBOND    0xef
+#define VENDOR_GIGADEVICE 0xc8
+
+typedef struct {
+    uint32_t addr, len;
+    flasherase_cb_t cb;
+    void *arg;
+} _request_t;
+
+typedef enum {
+    SLICE_DONE,
+    SLICE_SUSPENDED,
+    SLICE_LOCKED,       /* protected, leave it to the SDK */
+} _slice_result_t;
+
+static xQueueHandle _queue;
+static xTaskHandle _task;
+
+/* _sector_busy: a sector's erase is under way, maybe suspended.
+   _slice_busy: it's running. Both only change in critical sections. */
+static volatile uint32_t _holds;
+static volatile bool _sector_busy, _slice_busy;
+
+static flasherase_stats_t _stats;
+
+static void _note_off_time(uint32_t cycles)
+{
+    uint32_t us = cycles / (cpu_clk_freq() / 1000000);
+    taskENTER_CRITICAL();
+    if (us > _stats.max_off_us)
+        _stats.max_off_us = us;
+    taskEXIT_CRITICAL();
+}
+
+#if FLASHERASE_SUSPEND
+
+static void IRAM _spi_cmd(uint32_t cmd)
+{
+    SPI(0).CMD = cmd;
+    while (SPI(0).CMD)
+        ;
+}
+
+static uint32_t IRAM _read_status(void)
+{
+    SPI(0).RSTATUS = 0;
+    _spi_cmd(SPI_CMD_RDSR);
+    return SPI(0).RSTATUS;
+}
+
+/* Send an 8 bit command with no address or data */
+static void IRAM _user_cmd(uint8_t cmd)
+{
+    uint32_t user0 = SPI(0).USER0;
+    uint32_t user2 = SPI(0).USER2;
+
+    SPI(0).USER0 = (user0 & (SPI_USER0_CS_SETUP | SPI_USER0_CS_HOLD)) | SPI_USER0_COMMAND;
+    SPI(0).USER2 = VAL2FIELD(SPI_USER2_COMMAND_BITLEN, 7) | cmd;
+    _spi_cmd(SPI_CMD_USR);
+
+    SPI(0).USER0 = user0;
+    SPI(0).USER2 = user2;
+}
+
+/* Start (or resume) the erase of the sector at 'addr' and let it run
+   for up to 'cycles', then suspend it. Called with interrupts off; the
+   cache is off but for the time it takes to check the result. */
+static _slice_result_t IRAM _erase_slice(uint32_t addr, bool resume, uint32_t cycles,
+                                         uint32_t *off_cycles)
+{
+    uint32_t start = perf_ccount();
+    _slice_result_t result = SLICE_DONE;
+
+    Cache_Read_Disable();
+    if (resume) {
+        _user_cmd(CMD_RESUME);
+    } else if (_read_status() & STATUS_BP) {
+        result = SLICE_LOCKED;
+        goto out;
+    } else {
+        _spi_cmd(SPI_CMD_WREN);
+        SPI(0).ADDR = addr & 0xffffff;
+        _spi_cmd(SPI_CMD_SE);
+    }
+
+    bool busy;
+    while ((busy = _read_status() & STATUS_BUSY) && perf_ccount() - start < cycles)
+        ;
+    if (busy) {
+        /* If the erase finished just before this the chip ignores it,
+           and the resume next time is ignored too */
+        _user_cmd(CMD_SUSPEND);
+        while (_read_status() & STATUS_BUSY)
+            ;
+        result = SLICE_SUSPENDED;
+    }
+out:
+    Cache_Read_Enable(0, 0, 1);
+    *off_cycles = perf_ccount() - start;
+    return result;
+}
+
+static bool _suspend_supported(void)
+{
+    uint32_t vendor = sdk_spi_flash_get_id() & 0xff;
+    return vendor == VENDOR_WINBOND || vendor == VENDOR_GIGADEVICE;
+}
+
+#endif /* FLASHERASE_SUSPEND */
+
+/* Wait until nothing holds erases off, then mark a slice running */
+static void _begin_slice(bool new_sector)
+{
+    while (1) {
+        taskENTER_CRITICAL();
+        if (!_holds && !_slice_busy && (!new_sector || !_sector_busy)) {
+            _slice_busy = true;
+            _sector_busy = true;
+            taskEXIT_CRITICAL();
+            return;
+        }
+        taskEXIT_CRITICAL();
+        vTaskDelay(1);
+    }
+}
+
+static void _end_slice(bool sector_done)
+{
+    taskENTER_CRITICAL();
+    _slice_busy = false;
+    if (sector_done)
+        _sector_busy = false;
+    taskEXIT_CRITICAL();
+    taskYIELD();
+}
+
+static bool _erase_sector_sdk(uint32_t addr)
+{
+    uint32_t start = perf_ccount();
+    bool ok = sdk_spi_flash_erase_sector(addr / SECTOR_SIZE) == SPI_FLASH_RESULT_OK;
+    _note_off_time(perf_ccount() - start);
+    return ok;
+}
+
+static bool _erase_sector(uint32_t addr)
+{
+#if FLASHERASE_SUSPEND
+    static int8_t supported = -1;
+
+    if (supported < 0)
+        supported = _suspend_supported();
+    if (supported) {
+        uint32_t cycles = FLASHERASE_SLICE_US * (cpu_clk_freq() / 1000000);
+        uint32_t off_cycles;
+        bool resume = false;
+
+        _begin_slice(true);
+        while (1) {
+            vPortEnterCritical();
+            _slice_result_t result = _erase_slice(addr, resume, cycles, &off_cycles);
+            vPortExitCritical();
+            _note_off_time(off_cycles);
+
+            if (result == SLICE_LOCKED) {
+                bool ok = _erase_sector_sdk(addr);
+                _end_slice(true);
+                return ok;
+            }
+            if (result == SLICE_DONE)
+                break;
+            _stats.suspends++;
+            resume = true;
+            /* The sector stays ours while suspended */
+            _end_slice(false);
+            _begin_slice(false);
+        }
+        _end_slice(true);
+
+        /* Our commands have no result to check, so check the start of
+           the sector reads as erased */
+        uint32_t check[4];
+        if (sdk_spi_flash_read(addr, check, sizeof(check)) != SPI_FLASH_RESULT_OK)
+            return false;
+        for (int i = 0; i < 4; i++) {
+            if (check[i] != 0xffffffff)
+                return false;
+        }
+        return true;
+    }
+#endif
+    _begin_slice(true);
+    bool ok = _erase_sector_sdk(addr);
+    _end_slice(true);
+    return ok;
+}
+
+bool flasherase_erase(uint32_t addr, uint32_t len)
+{
+    bool ok = true;
+
+    if (addr % SECTOR_SIZE || addr + len > sdk_flashchip.chip_size || addr + len < addr)
+        return false;
+
+    for (uint32_t a = addr; a < addr + len; a += SECTOR_SIZE) {
+        if (_erase_sector(a)) {
+            _stats.sectors++;
+        } else {
+            _stats.failures++;
+            ok = false;
+            break;
+        }
+    }
+    flashcache_invalidate();
+    return ok;
+}
+
+static void _flasherase_task(void *param)
+{
+    _request_t req;
+
+    while (1) {
+        if (xQueueReceive(_queue, &req, portMAX_DELAY) != pdTRUE)
+            continue;
+        bool ok = flasherase_erase(req.addr, req.len);
+        if (req.cb)
+            req.cb(req.addr, req.len, ok, req.arg);
+    }
+}
+
+bool flasherase_start(uint32_t priority)
+{
+    if (_queue)
+        return false;
+    _queue = xQueueCreate(FLASHERASE_QUEUE_LEN, sizeof(_request_t));
+    if (!_queue)
+        return false;
+    if (xTaskCreate(_flasherase_task, (signed char *)"flasherase", FLASHERASE_TASK_STACK_SIZE,
+                    NULL, priority, &_task) != pdPASS) {
+        vQueueDelete(_queue);
+        _queue = NULL;
+        return false;
+    }
+    return true;
+}
+
+bool flasherase_queue(uint32_t addr, uint32_t len, flasherase_cb_t cb, void *arg)
+{
+    _request_t req = { .addr = addr, .len = len, .cb = cb, .arg = arg };
+
+    if (!_queue)
+        return false;
+    return xQueueSend(_queue, &req, 0) == pdTRUE;
+}
+
+void flasherase_hold(void)
+{
+    taskENTER_CRITICAL();
+    _holds++;
+    taskEXIT_CRITICAL();
+
+    while (_slice_busy)
+        vTaskDelay(1);
+}
+
+void flasherase_release(void)
+{
+    taskENTER_CRITICAL();
+    if (_holds)
+        _holds--;
+    taskEXIT_CRITICAL();
+}
+
+void flasherase_get_stats(flasherase_stats_t *stats)
+{
+    taskENTER_CRITICAL();
+    *stats = _stats;
+    taskEXIT_CRITICAL();
+}
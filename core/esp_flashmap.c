@@ -0,0 +1,171 @@
+/* Reading flash through the cache window, see esp/flashmap.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <esp/flashmap.h>
+#include <string.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "common_macros.h"
+#include "esp/rom.h"
+#include "espressif/spi_flash.h"
+
+/* Set up by the OTA Cache_Read_Enable wrapper (extras/rboot-ota) to the
+   megabyte it mapped, not linked at all in non-OTA builds. */
+extern uint8_t rboot_megabyte __attribute__((weak));
+
+static uint32_t mapped_base(void)
+{
+    if (&rboot_megabyte == NULL)
+        return 0;
+    return (uint32_t)rboot_megabyte * FLASHMAP_SIZE;
+}
+
+const uint32_t *flashmap_ptr(uint32_t flash_addr, size_t len)
+{
+    uint32_t base = mapped_base();
+
+    if (flash_addr & 3)
+        return NULL;
+    if (flash_addr < base || len > FLASHMAP_SIZE || flash_addr - base > FLASHMAP_SIZE - len)
+        return NULL;
+    return (const uint32_t *)(FLASHMAP_BASE + (flash_addr - base));
+}
+
+uint32_t flashmap_flash_addr(const void *ptr)
+{
+    uint32_t addr = (uint32_t)ptr;
+
+    if (addr < FLASHMAP_BASE || addr >= FLASHMAP_BASE + FLASHMAP_SIZE)
+        return UINT32_MAX;
+    return mapped_base() + (addr - FLASHMAP_BASE);
+}
+
+void flashmap_memcpy(void *dest, const void *src, size_t len)
+{
+    uint8_t *d = dest;
+    const uint8_t *s = src;
+
+    while (len && ((uint32_t)s & 3)) {
+        *d++ = flashmap_read8(s++);
+        len--;
+    }
+
+    const volatile uint32_t *w = (const volatile uint32_t *)s;
+    if (((uint32_t)d & 3) == 0) {
+        for (; len >= 4; len -= 4, d += 4)
+            *(uint32_t *)d = *w++;
+    } else {
+        for (; len >= 4; len -= 4, d += 4) {
+            uint32_t word = *w++;
+            memcpy(d, &word, 4);
+        }
+    }
+
+    if (len) {
+        uint32_t word = *w;
+        memcpy(d, &word, len);
+    }
+}
+
+uint32_t flashmap_bank_current(void)
+{
+    return mapped_base() / FLASHMAP_SIZE;
+}
+
+/* Disabling the cache drops its lines, so nothing of the previous bank
+   is read after a remap (rboot-cache.S relies on this too) */
+static void IRAM _map_bank(uint32_t bank)
+{
+    Cache_Read_Disable();
+    rom_Cache_Read_Enable(bank & 1, bank >> 1, 1);
+}
+
+static void IRAM _map_current(void)
+{
+    Cache_Read_Disable();
+    /* Through the OTA wrapper if there is one, which maps the ROM's bank */
+    Cache_Read_Enable(0, 0, 1);
+}
+
+bool IRAM flashmap_bank_call(uint32_t bank, flashmap_bank_fn_t fn, void *arg)
+{
+    if (bank >= sdk_flashchip.chip_size / FLASHMAP_SIZE)
+        return false;
+
+    vPortEnterCritical();
+    _map_bank(bank);
+    fn((const uint32_t *)FLASHMAP_BASE, arg);
+    _map_current();
+    vPortExitCritical();
+    return true;
+}
+
+typedef struct {
+    uint8_t *dest;
+    uint32_t offset;
+    size_t len;
+} _bank_copy_t;
+
+/* flashmap_memcpy(), but in IRAM */
+static void IRAM _bank_copy(const uint32_t *window, void *arg)
+{
+    _bank_copy_t *copy = arg;
+    uint8_t *d = copy->dest;
+    size_t len = copy->len;
+    uint32_t src = (uint32_t)window + copy->offset;
+    const volatile uint32_t *w = (const volatile uint32_t *)(src & ~3);
+
+    if (((src | (uint32_t)d) & 3) == 0) {
+        for (; len >= 4; len -= 4, d += 4)
+            *(uint32_t *)d = *w++;
+        src = (uint32_t)w;
+    }
+    if (!len)
+        return;
+
+    uint32_t left = 4 - (src & 3);
+    uint32_t word = *w++ >> ((src & 3) * 8);
+    while (len--) {
+        if (!left) {
+            word = *w++;
+            left = 4;
+        }
+        *d++ = word;
+        word >>= 8;
+        left--;
+    }
+}
+
+bool flashmap_bank_read(uint32_t flash_addr, void *dest, size_t len)
+{
+    uint32_t current = flashmap_bank_current();
+    uint8_t *d = dest;
+
+    if (flash_addr > sdk_flashchip.chip_size || len > sdk_flashchip.chip_size - flash_addr)
+        return false;
+
+    while (len) {
+        uint32_t bank = flash_addr / FLASHMAP_SIZE;
+        uint32_t offset = flash_addr % FLASHMAP_SIZE;
+        size_t n = FLASHMAP_SIZE - offset;
+        if (n > len)
+            n = len;
+
+        if (bank == current) {
+            flashmap_memcpy(d, (const uint8_t *)FLASHMAP_BASE + offset, n);
+        } else {
+            if (n > FLASHMAP_BANK_CHUNK)
+                n = FLASHMAP_BANK_CHUNK;
+            _bank_copy_t copy = { .dest = d, .offset = offset, .len = n };
+            flashmap_bank_call(bank, _bank_copy, &copy);
+        }
+        d += n;
+        flash_addr += n;
+        len -= n;
+    }
+    return true;
+}
@@ -0,0 +1,137 @@
+/* SPI flash read mode and clock selection, see esp/flashmode.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <esp/flashmode.h>
+#include <string.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "common_macros.h"
+#include "esp/rom.h"
+#include "esp/spi_regs.h"
+#include "esp/iomux_regs.h"
+#include "sdk_internal.h"
+
+#define MODE_BITS (SPI_CTRL0_QIO_MODE | SPI_CTRL0_QOUT_MODE | SPI_CTRL0_DIO_MODE \
+                   | SPI_CTRL0_DOUT_MODE | SPI_CTRL0_FASTRD_MODE)
+
+/* Bytes read back to check a new setting. The start of flash holds the
+   image (or bootloader) header, so it's never blank. */
+#define VERIFY_WORDS 16
+
+static uint32_t IRAM mode_bits(flashmode_t mode)
+{
+    switch (mode) {
+    case FLASHMODE_QIO:
+        return SPI_CTRL0_QIO_MODE | SPI_CTRL0_FASTRD_MODE;
+    case FLASHMODE_QOUT:
+        return SPI_CTRL0_QOUT_MODE | SPI_CTRL0_FASTRD_MODE;
+    case FLASHMODE_DIO:
+        return SPI_CTRL0_DIO_MODE | SPI_CTRL0_FASTRD_MODE;
+    default:
+        return SPI_CTRL0_DOUT_MODE | SPI_CTRL0_FASTRD_MODE;
+    }
+}
+
+static uint32_t IRAM clock_bits(uint32_t divisor)
+{
+    if (divisor < 2)
+        return SPI_CTRL0_CLOCK_EQU_SYS_CLOCK;
+    return VAL2FIELD(SPI_CTRL0_CLOCK_NUM, divisor - 1)
+         | VAL2FIELD(SPI_CTRL0_CLOCK_HIGH, divisor / 2 - 1)
+         | VAL2FIELD(SPI_CTRL0_CLOCK_LOW, divisor - 1);
+}
+
+static void IRAM apply(uint32_t ctrl0, uint32_t iomux_conf)
+{
+    /* Clock sources first, so the SPI clock never runs faster than
+       either the old or the new setting */
+    if (ctrl0 & SPI_CTRL0_CLOCK_EQU_SYS_CLOCK) {
+        SPI(0).CTRL0 = ctrl0;
+        IOMUX.CONF = iomux_conf;
+    } else {
+        IOMUX.CONF = iomux_conf;
+        SPI(0).CTRL0 = ctrl0;
+    }
+}
+
+bool IRAM flashmode_configure(flashmode_t mode, uint32_t mhz)
+{
+    uint32_t ref[VERIFY_WORDS], check[VERIFY_WORDS];
+    uint32_t divisor;
+
+    switch (mhz) {
+    case 80: divisor = 1; break;
+    case 40: divisor = 2; break;
+    case 26: divisor = 3; break;
+    case 20: divisor = 4; break;
+    default: return false;
+    }
+    if (mode > FLASHMODE_DOUT)
+        return false;
+
+    uint32_t old_ctrl0 = SPI(0).CTRL0;
+    uint32_t old_iomux = IOMUX.CONF;
+
+    if (sdk_SPIRead(0, ref, sizeof(ref)) != SPI_FLASH_RESULT_OK)
+        return false;
+
+    uint32_t ctrl0 = old_ctrl0 & ~(MODE_BITS | SPI_CTRL0_CLOCK_EQU_SYS_CLOCK | SPI_CTRL0_CLOCK_M);
+    ctrl0 |= mode_bits(mode) | clock_bits(divisor);
+    uint32_t iomux = old_iomux & ~IOMUX_CONF_SPI0_CLOCK_EQU_SYS_CLOCK;
+    if (divisor < 2)
+        iomux |= IOMUX_CONF_SPI0_CLOCK_EQU_SYS_CLOCK;
+    apply(ctrl0, iomux);
+
+    memset(check, 0, sizeof(check));
+    if (sdk_SPIRead(0, check, sizeof(check)) != SPI_FLASH_RESULT_OK
+        || memcmp(ref, check, sizeof(ref))) {
+        apply(old_ctrl0, old_iomux);
+        return false;
+    }
+    return true;
+}
+
+bool IRAM flashmode_set(flashmode_t mode, uint32_t mhz)
+{
+    vPortEnterCritical();
+    Cache_Read_Disable();
+    bool ok = flashmode_configure(mode, mhz);
+    Cache_Read_Enable(0, 0, 1);
+    vPortExitCritical();
+    return ok;
+}
+
+flashmode_t flashmode_get_mode(void)
+{
+    uint32_t ctrl0 = SPI(0).CTRL0;
+
+    if (ctrl0 & SPI_CTRL0_QIO_MODE)
+        return FLASHMODE_QIO;
+    if (ctrl0 & SPI_CTRL0_QOUT_MODE)
+        return FLASHMODE_QOUT;
+    if (ctrl0 & SPI_CTRL0_DIO_MODE)
+        return FLASHMODE_DIO;
+    return FLASHMODE_DOUT;
+}
+
+uint32_t flashmode_get_speed(void)
+{
+    uint32_t ctrl0 = SPI(0).CTRL0;
+
+    if (ctrl0 & SPI_CTRL0_CLOCK_EQU_SYS_CLOCK)
+        return 80;
+    return 80 / (FIELD2VAL(SPI_CTRL0_CLOCK_NUM, ctrl0) + 1);
+}
+
+const char *flashmode_name(flashmode_t mode)
+{
+    static const char *names[] = { "qio", "qout", "dio", "dout" };
+
+    if (mode > FLASHMODE_DOUT)
+        return "?";
+    return names[mode];
+}
@@ -8,7 +8,19 @@
 
    Look in examples/button/ for a simple GPIO interrupt example.
 
-   You can implement GPIO interrupt handlers in either of two ways:
+   You can implement GPIO interrupt handlers in any of three ways:
+
+   - Register a gpio_interrupt_handler_t for each pin at runtime, with
+     gpio_set_interrupt_handler(). The handler gets the pin number and a context
+     pointer, and several drivers can each register their own pins.
+
+   void button_handler(uint8_t gpio_num, void *arg) {
+       // Do something when the pin changes, arg is the context pointer
+   }
+
+   gpio_set_interrupt_handler(0, GPIO_INTTYPE_EDGE_NEG, button_handler, &button);
+
+   OR
 
    - Implement gpXX_interrupt_handler() for each GPIO pin number that
      you want to use interrupt with. This is simple but it may not
@@ -22,12 +34,14 @@
        // Do something when GPIO 12 changes
    }
 
+   (and enable them with gpio_set_interrupt())
+
    OR
 
    - Implement a single function named gpio_interrupt_handler(). This
      will need to manually check GPIO.STATUS and clear any status
      bits after handling interrupts. This gives you full control, but
-     you can't combine it with the first approach.
+     you can't combine it with the other approaches.
 
 
   Part of esp-open-rtos
@@ -55,9 +69,9 @@ void gpio13_interrupt_handler(void) __attribute__((weak, alias("gpio_noop_interr
 void gpio14_interrupt_handler(void) __attribute__((weak, alias("gpio_noop_interrupt_handler")));
 void gpio15_interrupt_handler(void) __attribute__((weak, alias("gpio_noop_interrupt_handler")));
 
-typedef void (* gpio_interrupt_handler_t)(void);
+typedef void (* gpio_static_handler_t)(void);
 
-const gpio_interrupt_handler_t gpio_interrupt_handlers[16] = {
+const gpio_static_handler_t gpio_interrupt_handlers[16] = {
     gpio00_interrupt_handler, gpio01_interrupt_handler, gpio02_interrupt_handler,
     gpio03_interrupt_handler, gpio04_interrupt_handler, gpio05_interrupt_handler,
     gpio06_interrupt_handler, gpio07_interrupt_handler, gpio08_interrupt_handler,
@@ -65,6 +79,14 @@ const gpio_interrupt_handler_t gpio_interrupt_handlers[16] = {
     gpio12_interrupt_handler, gpio13_interrupt_handler, gpio14_interrupt_handler,
     gpio15_interrupt_handler };
 
+/* Handlers registered with gpio_set_interrupt_handler(), indexed by pin */
+typedef struct {
+    gpio_interrupt_handler_t handler;
+    void *arg;
+} gpio_handler_entry_t;
+
+static gpio_handler_entry_t gpio_handler_table[16];
+
 void __attribute__((weak)) IRAM gpio_interrupt_handler(void)
 {
     uint32_t status_reg = GPIO.STATUS;
@@ -74,7 +96,27 @@ void __attribute__((weak)) IRAM gpio_interrupt_handler(void)
     {
         gpio_idx--;
         status_reg &= ~BIT(gpio_idx);
-        if(FIELD2VAL(GPIO_CONF_INTTYPE, GPIO.CONF[gpio_idx]))
-            gpio_interrupt_handlers[gpio_idx]();
+        if(FIELD2VAL(GPIO_CONF_INTTYPE, GPIO.CONF[gpio_idx])) {
+            const gpio_handler_entry_t *entry = &gpio_handler_table[gpio_idx];
+            if(entry->handler)
+                entry->handler(gpio_idx, entry->arg);
+            else
+                gpio_interrupt_handlers[gpio_idx]();
+        }
+    }
+}
+
+void gpio_set_interrupt_handler(const uint8_t gpio_num, const gpio_inttype_t int_type, gpio_interrupt_handler_t handler, void *arg)
+{
+    /* Handler and arg must change together as seen by the interrupt */
+    uint32_t old_level = _xt_disable_interrupts();
+    gpio_handler_table[gpio_num].handler = handler;
+    gpio_handler_table[gpio_num].arg = arg;
+    GPIO.CONF[gpio_num] = SET_FIELD(GPIO.CONF[gpio_num], GPIO_CONF_INTTYPE, int_type);
+    _xt_restore_interrupts(old_level);
+
+    if(int_type != GPIO_INTTYPE_NONE) {
+        _xt_isr_attach(INUM_GPIO, gpio_interrupt_handler);
+        _xt_isr_unmask(1<<INUM_GPIO);
     }
 }
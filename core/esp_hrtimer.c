@@ -0,0 +1,408 @@
+/* Microsecond software timer service for esp/hrtimer.h
+ *
+ * All pending timers live in a binary min-heap of pointers ordered by
+ * FRC2 expiry count. Expiry comparisons are done with signed 32-bit
+ * differences so the free-running FRC2 counter can wrap freely, which
+ * limits timeouts to half the FRC2 wrap period.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <esp/hrtimer.h>
+#include <esp/timer.h>
+#include <esp/interrupts.h>
+#include <esp/dport_regs.h>
+#include <common_macros.h>
+#include <stddef.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+
+/* Don't arm the compare closer than this many ticks from now, the
+   match could be missed otherwise and then only caught on wrap. */
+#define _MIN_DELTA 4
+
+/* Always take an interrupt at least this often, so the microsecond
+   clock can't miss a counter wrap. */
+#define _MAX_SLEEP 0x40000000
+
+/* Longest timeout/period (in ticks) that still compares correctly */
+#define _MAX_TICKS 0x3fffffff
+
+/* Interrupt handler table, from esp_interrupts.c */
+extern _xt_isr isr[16];
+
+static hrtimer_t *_heap[HRTIMER_MAX];
+static uint8_t _heap_len;
+
+static bool _inited;
+static uint8_t _div_shift;   /* log2 of FRC2 clock divider */
+static _xt_isr _sdk_handler; /* FRC2 handler installed by sdk_ets_timer_init */
+static bool _sdk_pending;
+static uint32_t _sdk_alarm;
+static uint32_t _alarm;      /* Last value we wrote to FRC2 ALARM */
+
+/* Microsecond clock state, extended from FRC2 count */
+static uint32_t _clock_count;
+static uint64_t _clock_us;
+static uint32_t _clock_rem;  /* Sub-microsecond leftover, in ticks << _div_shift */
+
+static inline bool _before(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) < 0;
+}
+
+static inline void IRAM _heap_set(uint8_t i, hrtimer_t *timer)
+{
+    _heap[i] = timer;
+    timer->_index = i;
+}
+
+static void IRAM _heap_sift_up(uint8_t i)
+{
+    hrtimer_t *timer = _heap[i];
+    while (i > 0) {
+        uint8_t parent = (i - 1) / 2;
+        if (!_before(timer->expires, _heap[parent]->expires))
+            break;
+        _heap_set(i, _heap[parent]);
+        i = parent;
+    }
+    _heap_set(i, timer);
+}
+
+static void IRAM _heap_sift_down(uint8_t i)
+{
+    hrtimer_t *timer = _heap[i];
+    for (;;) {
+        uint8_t child = 2 * i + 1;
+        if (child >= _heap_len)
+            break;
+        if (child + 1 < _heap_len && _before(_heap[child + 1]->expires, _heap[child]->expires))
+            child++;
+        if (!_before(_heap[child]->expires, timer->expires))
+            break;
+        _heap_set(i, _heap[child]);
+        i = child;
+    }
+    _heap_set(i, timer);
+}
+
+static void IRAM _heap_remove(hrtimer_t *timer)
+{
+    uint8_t i = timer->_index;
+    hrtimer_t *last = _heap[--_heap_len];
+    timer->_index = -1;
+    if (last == timer)
+        return;
+    _heap_set(i, last);
+    if (i > 0 && _before(last->expires, _heap[(i - 1) / 2]->expires))
+        _heap_sift_up(i);
+    else
+        _heap_sift_down(i);
+}
+
+static void IRAM _clock_update(void)
+{
+    uint32_t count = TIMER_FRC2.COUNT;
+    uint32_t delta = count - _clock_count;
+    uint64_t scaled = ((uint64_t)delta << _div_shift) + _clock_rem;
+    uint32_t us = scaled / 80;
+    _clock_count = count;
+    _clock_us += us;
+    _clock_rem = scaled - (uint64_t)us * 80;
+}
+
+/* Write the earliest of our head, the SDK's alarm and the housekeeping
+   deadline to FRC2 ALARM. Returns false if that deadline has already
+   (or very nearly) passed, in which case the caller should dispatch
+   again instead of waiting for the interrupt. */
+static bool IRAM _program_alarm(void)
+{
+    uint32_t now = TIMER_FRC2.COUNT;
+    uint32_t next = now + _MAX_SLEEP;
+
+    if (_heap_len && _before(_heap[0]->expires, next))
+        next = _heap[0]->expires;
+    if (_sdk_pending && _before(_sdk_alarm, next))
+        next = _sdk_alarm;
+
+    if ((int32_t)(next - now) < _MIN_DELTA)
+        return false;
+
+    _alarm = next;
+    TIMER_FRC2.ALARM = next;
+    return true;
+}
+
+/* Pick up an alarm written by the SDK's timer code behind our back */
+static inline void IRAM _check_sdk_alarm(void)
+{
+    uint32_t alarm = TIMER_FRC2.ALARM;
+    if (alarm != _alarm) {
+        _sdk_alarm = alarm;
+        _sdk_pending = true;
+    }
+}
+
+static void IRAM _hrtimer_isr(void)
+{
+    _check_sdk_alarm();
+
+    do {
+        uint32_t now = TIMER_FRC2.COUNT;
+
+        if (_sdk_pending && !_before(now, _sdk_alarm)) {
+            _sdk_pending = false;
+            _alarm = TIMER_FRC2.ALARM;
+            if (_sdk_handler)
+                _sdk_handler();
+            /* The SDK handler re-arms ALARM if it still has timers queued */
+            uint32_t alarm = TIMER_FRC2.ALARM;
+            if (alarm != _alarm && _before(TIMER_FRC2.COUNT, alarm)) {
+                _sdk_alarm = alarm;
+                _sdk_pending = true;
+            }
+        }
+
+        while (_heap_len && !_before(now, _heap[0]->expires)) {
+            hrtimer_t *timer = _heap[0];
+            if (timer->period) {
+                timer->expires += timer->period;
+                /* Badly overrun, skip the missed periods */
+                if (_before(timer->expires, now))
+                    timer->expires = now + timer->period;
+                _heap_sift_down(0);
+            } else {
+                _heap_remove(timer);
+            }
+            timer->callback(timer, timer->arg);
+            now = TIMER_FRC2.COUNT;
+        }
+
+        _clock_update();
+    } while (!_program_alarm());
+}
+
+static void _hrtimer_init_service(void)
+{
+    uint32_t ctrl = TIMER_FRC2.CTRL;
+
+    if (!(ctrl & TIMER_CTRL_RUN)) {
+        /* Normally sdk_ets_timer_init has already started FRC2 free-running */
+        timer_set_divider(FRC2, TIMER_CLKDIV_16);
+        timer_set_reload(FRC2, false);
+        timer_set_run(FRC2, true);
+        ctrl = TIMER_FRC2.CTRL;
+    }
+    _div_shift = FIELD2VAL(TIMER_CTRL_CLKDIV, ctrl) * 4;
+
+    _xt_isr_mask(BIT(INUM_TIMER_FRC2));
+    _sdk_handler = isr[INUM_TIMER_FRC2];
+    _alarm = TIMER_FRC2.ALARM;
+    _sdk_alarm = _alarm;
+    _sdk_pending = _sdk_handler && _before(TIMER_FRC2.COUNT, _alarm);
+    _clock_count = TIMER_FRC2.COUNT;
+    _xt_isr_attach(INUM_TIMER_FRC2, _hrtimer_isr);
+    _program_alarm();
+    _inited = true;
+    timer_set_interrupts(FRC2, true);
+}
+
+void hrtimer_init(hrtimer_t *timer, hrtimer_callback_t callback, void *arg)
+{
+    timer->callback = callback;
+    timer->arg = arg;
+    timer->expires = 0;
+    timer->period = 0;
+    timer->_index = -1;
+}
+
+uint32_t IRAM hrtimer_us_to_ticks(uint32_t us)
+{
+    uint64_t ticks = ((uint64_t)us * 80) >> _div_shift;
+    return ticks > _MAX_TICKS ? _MAX_TICKS : ticks;
+}
+
+uint32_t IRAM hrtimer_ticks_to_us(uint32_t ticks)
+{
+    return ((uint64_t)ticks << _div_shift) / 80;
+}
+
+/* Put a timer with 'expires' and 'period' set on the heap, and move the
+   alarm up if it's now first. Called with interrupts disabled. */
+static void IRAM _heap_insert(hrtimer_t *timer)
+{
+    _heap_len++;
+    _heap_set(_heap_len - 1, timer);
+    _heap_sift_up(_heap_len - 1);
+
+    if (_heap[0] == timer) {
+        _check_sdk_alarm();
+        if (!_program_alarm()) {
+            /* Already due, make the FRC2 interrupt run right away */
+            _alarm = TIMER_FRC2.COUNT + _MIN_DELTA;
+            TIMER_FRC2.ALARM = _alarm;
+        }
+    }
+}
+
+bool IRAM hrtimer_start(hrtimer_t *timer, uint32_t timeout_us, uint32_t period_us)
+{
+    uint32_t old_level = _xt_disable_interrupts();
+
+    if (!_inited)
+        _hrtimer_init_service();
+
+    if (hrtimer_active(timer))
+        _heap_remove(timer);
+
+    if (_heap_len == HRTIMER_MAX) {
+        _xt_restore_interrupts(old_level);
+        return false;
+    }
+
+    timer->period = period_us ? hrtimer_us_to_ticks(period_us) : 0;
+    if (period_us && !timer->period)
+        timer->period = 1;
+    timer->expires = TIMER_FRC2.COUNT + hrtimer_us_to_ticks(timeout_us);
+    _heap_insert(timer);
+
+    _xt_restore_interrupts(old_level);
+    return true;
+}
+
+bool IRAM hrtimer_start_from_expiry(hrtimer_t *timer, uint32_t ticks)
+{
+    uint32_t old_level = _xt_disable_interrupts();
+
+    if (!_inited)
+        _hrtimer_init_service();
+
+    if (hrtimer_active(timer))
+        _heap_remove(timer);
+
+    if (_heap_len == HRTIMER_MAX) {
+        _xt_restore_interrupts(old_level);
+        return false;
+    }
+
+    timer->period = 0;
+    timer->expires += ticks > _MAX_TICKS ? _MAX_TICKS : ticks;
+    _heap_insert(timer);
+
+    _xt_restore_interrupts(old_level);
+    return true;
+}
+
+void IRAM hrtimer_stop(hrtimer_t *timer)
+{
+    uint32_t old_level = _xt_disable_interrupts();
+    if (hrtimer_active(timer))
+        _heap_remove(timer);
+    /* A stale ALARM is harmless, the interrupt just re-arms */
+    _xt_restore_interrupts(old_level);
+}
+
+uint32_t IRAM hrtimer_now_us(void)
+{
+    uint32_t old_level = _xt_disable_interrupts();
+
+    if (!_inited)
+        _hrtimer_init_service();
+    _clock_update();
+    uint32_t now = _clock_us;
+    _xt_restore_interrupts(old_level);
+    return now;
+}
+
+uint64_t IRAM hrtimer_now_us64(void)
+{
+    uint32_t old_level = _xt_disable_interrupts();
+
+    if (!_inited)
+        _hrtimer_init_service();
+    _clock_update();
+    uint64_t now = _clock_us;
+    _xt_restore_interrupts(old_level);
+    return now;
+}
+
+static void IRAM _sleep_wake(hrtimer_t *timer, void *arg)
+{
+    portBASE_TYPE woken = pdFALSE;
+
+    vTaskNotifyGiveFromISR((xTaskHandle)arg, &woken);
+    if (woken)
+        portYIELD();
+}
+
+void hrtimer_sleep_us(uint32_t us)
+{
+    hrtimer_t timer;
+
+    if (!us)
+        return;
+    if (xTaskGetSchedulerState() != taskSCHEDULER_RUNNING) {
+        uint64_t end = hrtimer_now_us64() + us;
+        while ((int64_t)(hrtimer_now_us64() - end) < 0)
+            ;
+        return;
+    }
+
+    hrtimer_init(&timer, _sleep_wake, xTaskGetCurrentTaskHandle());
+    if (!hrtimer_start(&timer, us, 0)) {
+        /* No free timer, round up to whole ticks instead */
+        vTaskDelay((us + 1000 * portTICK_RATE_MS - 1) / (1000 * portTICK_RATE_MS) + 1);
+        return;
+    }
+    /* Other notifications may wake us first */
+    while (hrtimer_active(&timer))
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+}
+
+#if INCLUDE_xTimerPendFunctionCall
+
+/* Runs in the timer task */
+static void _daemon_run(void *param, unsigned long unused)
+{
+    hrtimer_daemon_t *timer = param;
+
+    uint32_t old_level = _xt_disable_interrupts();
+    uint32_t missed = timer->_missed;
+    timer->_missed = 0;
+    timer->_queued = false;
+    _xt_restore_interrupts(old_level);
+
+    timer->callback(timer->arg, missed);
+}
+
+/* Only one call per timer is queued at a time, so a timer faster than
+   the timer task can keep up with doesn't fill the queue */
+static void IRAM _daemon_expired(hrtimer_t *hrtimer, void *arg)
+{
+    hrtimer_daemon_t *timer = arg;
+    portBASE_TYPE woken = pdFALSE;
+
+    if (timer->_queued
+        || xTimerPendFunctionCallFromISR(_daemon_run, timer, 0, &woken) != pdPASS) {
+        timer->_missed++;
+        return;
+    }
+    timer->_queued = true;
+    if (woken)
+        portYIELD();
+}
+
+void hrtimer_daemon_init(hrtimer_daemon_t *timer, hrtimer_daemon_callback_t callback, void *arg)
+{
+    hrtimer_init(&timer->timer, _daemon_expired, timer);
+    timer->callback = callback;
+    timer->arg = arg;
+    timer->_queued = false;
+    timer->_missed = 0;
+}
+
+#endif /* INCLUDE_xTimerPendFunctionCall */
@@ -9,6 +9,18 @@
 #include <esp/hwrand.h>
 #include <esp/wdev_regs.h>
 #include <string.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+
+/* Number of pool words refilled between sleeps */
+#define REFILL_BATCH 8
+
+static uint32_t _pool[HWRAND_POOL_WORDS];
+static volatile size_t _pool_fill;  /* valid bytes, taken from the top */
+static uint32_t _last_sample;
+static volatile uint32_t _health_failures;
+static xSemaphoreHandle _refill_sem;
 
 /* Return a random 32-bit number */
 uint32_t hwrand(void)
@@ -16,11 +28,107 @@ uint32_t hwrand(void)
     return WDEV.HWRNG;
 }
 
+/* Give up re-reading a stuck RNG after this many repeated samples */
+#define HEALTH_MAX_RETRIES 8
+
+/* Raw sample that passed the repetition count test. The first sample
+   is compared against 0, which costs at worst one discarded read. */
+static uint32_t _health_sample(void)
+{
+    uint32_t sample = WDEV.HWRNG;
+    for (int i = 0; i < HEALTH_MAX_RETRIES && sample == _last_sample; i++) {
+        _health_failures++;
+        sample = WDEV.HWRNG;
+    }
+    _last_sample = sample;
+    return sample;
+}
+
+/* Fold 'count' raw samples into one word. Rotate-xor-multiply keeps
+   every input bit influencing the result, so a few stuck or biased
+   bits in the raw samples don't survive into the output. */
+static uint32_t _mixed_word(size_t count)
+{
+    uint32_t acc = 0;
+    for (size_t i = 0; i < count; i++) {
+        acc = (acc << 7 | acc >> 25) ^ _health_sample();
+        acc *= 0x9e3779b1;
+    }
+    return acc ^ (acc >> 16);
+}
+
+static void _refill_task(void *pvParameters)
+{
+    for (;;) {
+        while (_pool_fill < sizeof(_pool)) {
+            for (int i = 0; i < REFILL_BATCH && _pool_fill < sizeof(_pool); i++) {
+                uint32_t word = _mixed_word(HWRAND_POOL_SAMPLES);
+                taskENTER_CRITICAL();
+                /* round down, a partly drained word is simply replaced */
+                size_t w = _pool_fill / 4;
+                _pool[w] = word;
+                _pool_fill = (w + 1) * 4;
+                taskEXIT_CRITICAL();
+            }
+            /* spread the raw reads out over time */
+            vTaskDelay(1);
+        }
+        xSemaphoreTake(_refill_sem, portMAX_DELAY);
+    }
+}
+
+bool hwrand_pool_start(uint32_t priority)
+{
+    if (_refill_sem)
+        return false;
+    vSemaphoreCreateBinary(_refill_sem);
+    if (!_refill_sem)
+        return false;
+    xSemaphoreTake(_refill_sem, 0);
+
+    if (xTaskCreate(_refill_task, (signed char *)"hwrand", HWRAND_POOL_STACK_SIZE,
+                    NULL, priority, NULL) != pdPASS) {
+        vSemaphoreDelete(_refill_sem);
+        _refill_sem = NULL;
+        return false;
+    }
+    return true;
+}
+
+size_t hwrand_pool_read(uint8_t *buf, size_t len)
+{
+    if (!_refill_sem)
+        return 0;
+
+    taskENTER_CRITICAL();
+    if (len > _pool_fill)
+        len = _pool_fill;
+    _pool_fill -= len;
+    memcpy(buf, (uint8_t *)_pool + _pool_fill, len);
+    /* wipe what was handed out, so it can't be read back from the pool */
+    memset((uint8_t *)_pool + _pool_fill, 0, len);
+    bool low = _pool_fill < sizeof(_pool) / 2;
+    taskEXIT_CRITICAL();
+
+    if (low)
+        xSemaphoreGive(_refill_sem);
+    return len;
+}
+
+uint32_t hwrand_health_failures(void)
+{
+    return _health_failures;
+}
+
 /* Fill a variable size buffer with data from the Hardware RNG */
 void hwrand_fill(uint8_t *buf, size_t len)
 {
+    size_t got = hwrand_pool_read(buf, len);
+    buf += got;
+    len -= got;
+
     for(size_t i = 0; i < len; i+=4) {
-        uint32_t random = WDEV.HWRNG;
+        uint32_t random = _mixed_word(1);
         /* using memcpy here in case 'buf' is unaligned */
         memcpy(buf + i, &random, (i+4 <= len) ? 4 : (len % 4));
     }
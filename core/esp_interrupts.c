@@ -6,32 +6,113 @@
  * BSD Licensed as described in the file LICENSE
  */
 #include <esp/interrupts.h>
+#include <esp/trace.h>
 
 _xt_isr isr[16];
 
+/* Set by UserExceptionHandler in exception_vectors.S */
+uint32_t *_xt_isr_frame;
+
+/* Service order for pending interrupts, highest priority first */
+static uint8_t isr_order[16] = {
+    INUM_WDT, 0, 1, 2, 3, 4, 5, 6, 7, 9, 10, 11, 12, 13, 14, 15
+};
+
+#if XT_ISR_PROFILE
+static _xt_isr_stats_t isr_stats[16];
+
+static inline uint32_t _xt_get_ccount(void)
+{
+    uint32_t ccount;
+    __asm__ volatile ("rsr %0, ccount" : "=a" (ccount));
+    return ccount;
+}
+#endif
+
 void IRAM _xt_isr_attach(uint8_t i, _xt_isr func)
 {
     isr[i] = func;
 }
 
+void _xt_isr_set_priority_order(const uint8_t *order, uint8_t count)
+{
+    uint8_t new_order[16];
+    uint16_t used = BIT(INUM_WDT);
+    uint8_t n = 0;
+
+    /* WDT has highest priority (occasional WDT resets otherwise) */
+    new_order[n++] = INUM_WDT;
+    for(uint8_t i = 0; i < count; i++) {
+        if(order[i] < 16 && !(used & BIT(order[i]))) {
+            new_order[n++] = order[i];
+            used |= BIT(order[i]);
+        }
+    }
+    for(uint8_t i = 0; i < 16; i++) {
+        if(!(used & BIT(i)))
+            new_order[n++] = i;
+    }
+
+    uint32_t old_level = _xt_disable_interrupts();
+    for(uint8_t i = 0; i < 16; i++)
+        isr_order[i] = new_order[i];
+    _xt_restore_interrupts(old_level);
+}
+
+#if XT_ISR_PROFILE
+void _xt_isr_get_stats(uint8_t i, _xt_isr_stats_t *stats)
+{
+    uint32_t old_level = _xt_disable_interrupts();
+    *stats = isr_stats[i];
+    _xt_restore_interrupts(old_level);
+}
+
+void _xt_isr_reset_stats(void)
+{
+    uint32_t old_level = _xt_disable_interrupts();
+    for(uint8_t i = 0; i < 16; i++) {
+        isr_stats[i] = (_xt_isr_stats_t){ 0 };
+    }
+    _xt_restore_interrupts(old_level);
+}
+#endif
+
 /* Generic ISR handler.
 
-   Handles all flags set for interrupts in 'intset'.
+   Handles all flags set for interrupts in 'intset', in isr_order.
 */
 uint16_t IRAM _xt_isr_handler(uint16_t intset)
 {
-    /* WDT has highest priority (occasional WDT resets otherwise) */
-    if(intset & BIT(INUM_WDT)) {
-        _xt_clear_ints(BIT(INUM_WDT));
-        isr[INUM_WDT]();
-        intset -= BIT(INUM_WDT);
-    }
+#if XT_ISR_PROFILE
+    uint32_t entry = _xt_get_ccount();
+#endif
 
-    while(intset) {
-        uint8_t index = __builtin_ffs(intset) - 1;
+    for(const uint8_t *next = isr_order; intset; next++) {
+        uint8_t index = *next;
         uint16_t mask = BIT(index);
+        if(!(intset & mask))
+            continue;
         _xt_clear_ints(mask);
+#if ESP_TRACE
+        trace_record(TRACE_ISR_ENTER, index);
+#endif
+#if XT_ISR_PROFILE
+        uint32_t start = _xt_get_ccount();
+        isr[index]();
+        uint32_t cycles = _xt_get_ccount() - start;
+        _xt_isr_stats_t *stats = &isr_stats[index];
+        stats->count++;
+        stats->total_cycles += cycles;
+        if(cycles > stats->max_cycles)
+            stats->max_cycles = cycles;
+        if(start - entry > stats->max_latency)
+            stats->max_latency = start - entry;
+#else
         isr[index]();
+#endif
+#if ESP_TRACE
+        trace_record(TRACE_ISR_EXIT, index);
+#endif
         intset -= mask;
     }
 
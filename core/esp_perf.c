@@ -0,0 +1,56 @@
+/* Cycle count profiling for esp/perf.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <esp/perf.h>
+#include <esp/interrupts.h>
+#include <common_macros.h>
+#include <stdio.h>
+
+static perf_site_t *_sites;
+
+void IRAM perf_record(perf_site_t *site, uint32_t cycles)
+{
+    uint32_t old_level = _xt_disable_interrupts();
+
+    if (!site->registered) {
+        site->registered = 1;
+        site->next = _sites;
+        _sites = site;
+    }
+    site->count++;
+    site->total_cycles += cycles;
+    if (cycles > site->max_cycles)
+        site->max_cycles = cycles;
+
+    _xt_restore_interrupts(old_level);
+}
+
+perf_site_t *perf_sites(void)
+{
+    return _sites;
+}
+
+void perf_reset(void)
+{
+    for (perf_site_t *site = _sites; site; site = site->next) {
+        uint32_t old_level = _xt_disable_interrupts();
+        site->count = 0;
+        site->total_cycles = 0;
+        site->max_cycles = 0;
+        _xt_restore_interrupts(old_level);
+    }
+}
+
+void perf_dump(void)
+{
+    printf("%-24s %10s %10s %8s %8s\n", "site", "count", "cycles", "avg", "max");
+    for (perf_site_t *site = _sites; site; site = site->next) {
+        uint32_t count = site->count;
+        uint32_t total = site->total_cycles;
+        printf("%-24s %10u %10u %8u %8u\n", site->name, count, total,
+               count ? total / count : 0, site->max_cycles);
+    }
+}
@@ -0,0 +1,126 @@
+/* Sampling CPU profiler, see esp/profiler.h
+ *
+ * The histogram is an open addressing hash table of PCs, filled from the
+ * FRC1 interrupt and only read once sampling has stopped.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <esp/profiler.h>
+#include <esp/interrupts.h>
+#include <esp/timer.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xtensa_context.h"
+
+/* Probes before a sample is dropped, keeps the interrupt short */
+#define MAX_PROBES 8
+
+static uint32_t *pcs;
+static uint32_t *counts;
+static uint32_t mask;
+static uint32_t max_entries;
+static profiler_stats_t stats;
+static bool running;
+
+static void IRAM profiler_isr(void)
+{
+    uint32_t pc = _xt_isr_frame[XT_STK_PC / 4];
+    uint32_t i = (pc >> 2) * 2654435761u;
+
+    for (int probe = 0; probe < MAX_PROBES; probe++, i++) {
+        i &= mask;
+        if (pcs[i] == pc) {
+            counts[i]++;
+            stats.samples++;
+            return;
+        }
+        if (!pcs[i]) {
+            if (stats.entries >= max_entries)
+                break;
+            pcs[i] = pc;
+            counts[i] = 1;
+            stats.entries++;
+            stats.samples++;
+            return;
+        }
+    }
+    stats.dropped++;
+}
+
+bool profiler_start(uint32_t rate_hz, size_t max_pcs)
+{
+    uint32_t size = 16;
+
+    profiler_stop();
+    while (size < max_pcs * 2)
+        size <<= 1;
+
+    free(pcs);
+    free(counts);
+    pcs = calloc(size, sizeof(uint32_t));
+    counts = calloc(size, sizeof(uint32_t));
+    if (!pcs || !counts) {
+        free(pcs);
+        free(counts);
+        pcs = counts = NULL;
+        return false;
+    }
+    mask = size - 1;
+    max_entries = max_pcs;
+    memset(&stats, 0, sizeof(stats));
+    stats.rate_hz = rate_hz;
+
+    _xt_isr_attach(INUM_TIMER_FRC1, profiler_isr);
+    if (timer_set_frequency(FRC1, rate_hz))
+        return false;
+    timer_set_interrupts(FRC1, true);
+    timer_set_run(FRC1, true);
+    running = true;
+    return true;
+}
+
+void profiler_stop(void)
+{
+    if (!running)
+        return;
+    timer_set_run(FRC1, false);
+    timer_set_interrupts(FRC1, false);
+    running = false;
+}
+
+void profiler_get_stats(profiler_stats_t *result)
+{
+    uint32_t ps = _xt_disable_interrupts();
+    *result = stats;
+    _xt_restore_interrupts(ps);
+}
+
+static void print_line(const char *line, void *arg)
+{
+    printf("%s\n", line);
+}
+
+void profiler_dump(void (*emit)(const char *line, void *arg), void *arg)
+{
+    char line[40];
+
+    profiler_stop();
+    if (!emit)
+        emit = print_line;
+
+    snprintf(line, sizeof(line), "# %u samples %u dropped %u Hz",
+             stats.samples, stats.dropped, stats.rate_hz);
+    emit(line, arg);
+    if (!pcs)
+        return;
+    for (uint32_t i = 0; i <= mask; i++) {
+        if (!pcs[i])
+            continue;
+        snprintf(line, sizeof(line), "PROF,0x%08x,%u", pcs[i], counts[i]);
+        emit(line, arg);
+    }
+}
@@ -9,6 +9,8 @@
 
 #include "esp/iomux.h"
 #include "esp/gpio.h"
+#include "esp/interrupts.h"
+#include "esp/dport_regs.h"
 #include <string.h>
 
 #define _SPI0_SCK_GPIO  6
@@ -27,6 +29,7 @@
 #define _SPI1_FUNC 2
 
 #define _SPI_BUF_SIZE 64
+#define _SPI_BUF_HALF (_SPI_BUF_SIZE / 2)
 
 static bool _minimal_pins[2] = {false, false};
 
@@ -173,12 +176,11 @@ inline static uint32_t _swap_words(uint32_t value)
     return (value << 16) | (value >> 16);
 }
 
-static void _spi_buf_prepare(uint8_t bus, size_t len, spi_endianness_t e, spi_word_size_t word_size)
+static void IRAM _spi_words_prepare(volatile uint32_t *data, size_t len, spi_endianness_t e, spi_word_size_t word_size)
 {
     if (e == SPI_LITTLE_ENDIAN || word_size == SPI_32BIT) return;
 
     size_t count = word_size == SPI_16BIT ? (len + 1) / 2 : (len + 3) / 4;
-    uint32_t *data = (uint32_t *)&SPI(bus).W0;
     for (size_t i = 0; i < count; i ++)
     {
         data[i] = word_size == SPI_16BIT
@@ -187,9 +189,15 @@ static void _spi_buf_prepare(uint8_t bus, size_t len, spi_endianness_t e, spi_wo
     }
 }
 
+inline static void _spi_buf_prepare(uint8_t bus, size_t len, spi_endianness_t e, spi_word_size_t word_size)
+{
+    _spi_words_prepare(&SPI(bus).W0, len, e, word_size);
+}
+
 static void _spi_buf_transfer(uint8_t bus, const void *out_data, void *in_data,
     size_t len, spi_endianness_t e, spi_word_size_t word_size)
 {
+    spi_async_wait(bus);
     _wait(bus);
     size_t bytes = len * (uint8_t)word_size;
     _set_size(bus, bytes);
@@ -225,27 +233,350 @@ uint32_t spi_transfer_32(uint8_t bus, uint32_t data)
     return res;
 }
 
+/* Disable MISO phase so received data doesn't overwrite the buffer.
+ * Returns previous USER0 value for _mosi_only_end() */
+inline static uint32_t _mosi_only_begin(uint8_t bus)
+{
+    uint32_t user0 = SPI(bus).USER0;
+    SPI(bus).USER0 = (user0 & ~(SPI_USER0_DUPLEX | SPI_USER0_MISO)) | SPI_USER0_MOSI;
+    return user0;
+}
+
+inline static void _mosi_only_end(uint8_t bus, uint32_t user0)
+{
+    SPI(bus).USER0 = user0;
+}
+
+/* Write-only stream: W0..W7 and W8..W15 are used as ping-pong buffers,
+ * next half is filled while the other one is being shifted out */
+static void _spi_write_pipelined(uint8_t bus, const uint8_t *out_data, size_t bytes,
+    spi_endianness_t e, spi_word_size_t word_size)
+{
+    volatile uint32_t *half[2] = { &SPI(bus).W0, &SPI(bus).W8 };
+    uint8_t cur = 0;
+    uint32_t user0 = _mosi_only_begin(bus);
+    size_t n = bytes > _SPI_BUF_HALF ? _SPI_BUF_HALF : bytes;
+
+    memcpy((void *)half[cur], out_data, n);
+    _spi_words_prepare(half[cur], n / (uint8_t)word_size, e, word_size);
+
+    for (;;)
+    {
+        _set_size(bus, n);
+        if (cur)
+            SPI(bus).USER0 |= SPI_USER0_MOSI_HIGHPART;
+        else
+            SPI(bus).USER0 &= ~SPI_USER0_MOSI_HIGHPART;
+        _start(bus);
+
+        out_data += n;
+        bytes -= n;
+        if (!bytes) break;
+
+        cur ^= 1;
+        n = bytes > _SPI_BUF_HALF ? _SPI_BUF_HALF : bytes;
+        memcpy((void *)half[cur], out_data, n);
+        _spi_words_prepare(half[cur], n / (uint8_t)word_size, e, word_size);
+        _wait(bus);
+    }
+    _wait(bus);
+    _mosi_only_end(bus, user0);
+}
+
+/* Full duplex stream: next block is copied and swapped into the staging
+ * buffer while the current one is being shifted, so only the word store
+ * into W0..W15 and the readout remain between blocks */
+static void _spi_duplex_pipelined(uint8_t bus, const uint8_t *out_data, uint8_t *in_data,
+    size_t bytes, spi_endianness_t e, spi_word_size_t word_size)
+{
+    uint32_t stage[_SPI_BUF_SIZE / 4];
+    volatile uint32_t *w = &SPI(bus).W0;
+    size_t n = bytes > _SPI_BUF_SIZE ? _SPI_BUF_SIZE : bytes;
+
+    memcpy(stage, out_data, n);
+    _spi_words_prepare(stage, n / (uint8_t)word_size, e, word_size);
+
+    while (bytes)
+    {
+        for (size_t i = 0; i < (n + 3) / 4; i++)
+            w[i] = stage[i];
+        _set_size(bus, n);
+        _start(bus);
+
+        size_t cur = n;
+        out_data += cur;
+        bytes -= cur;
+        if (bytes)
+        {
+            n = bytes > _SPI_BUF_SIZE ? _SPI_BUF_SIZE : bytes;
+            memcpy(stage, out_data, n);
+            _spi_words_prepare(stage, n / (uint8_t)word_size, e, word_size);
+        }
+
+        _wait(bus);
+        _spi_words_prepare(w, cur / (uint8_t)word_size, e, word_size);
+        memcpy(in_data, (void *)w, cur);
+        in_data += cur;
+    }
+}
+
 size_t spi_transfer(uint8_t bus, const void *out_data, void *in_data, size_t len, spi_word_size_t word_size)
 {
     if (!out_data || !len) return 0;
 
     spi_endianness_t e = spi_get_endianness(bus);
-    uint8_t buf_size = _SPI_BUF_SIZE / (uint8_t)word_size;
+    size_t bytes = len * (uint8_t)word_size;
 
-    size_t blocks = len / buf_size;
-    for (size_t i = 0; i < blocks; i++)
+    if (bytes <= _SPI_BUF_SIZE)
     {
-        size_t offset = i * _SPI_BUF_SIZE;
-        _spi_buf_transfer(bus, (const uint8_t *)out_data + offset,
-            in_data ? (uint8_t *)in_data + offset : NULL, buf_size, e, word_size);
+        _spi_buf_transfer(bus, out_data, in_data, len, e, word_size);
+        return len;
     }
 
-    uint8_t tail = len % buf_size;
-    if (tail)
+    spi_async_wait(bus);
+    _wait(bus);
+    if (in_data)
+        _spi_duplex_pipelined(bus, out_data, in_data, bytes, e, word_size);
+    else
+        _spi_write_pipelined(bus, out_data, bytes, e, word_size);
+
+    return len;
+}
+
+size_t spi_repeat(uint8_t bus, uint32_t pattern, size_t count, spi_word_size_t word_size)
+{
+    if (!count) return 0;
+
+    spi_async_wait(bus);
+    _wait(bus);
+
+    uint32_t value;
+    switch (word_size)
     {
-        _spi_buf_transfer(bus, (const uint8_t *)out_data + blocks * _SPI_BUF_SIZE,
-            in_data ? (uint8_t *)in_data + blocks * _SPI_BUF_SIZE : NULL, tail, e, word_size);
+        case SPI_8BIT:
+            value = (pattern & 0xff) * 0x01010101;
+            break;
+        case SPI_16BIT:
+            value = (pattern & 0xffff) * 0x00010001;
+            break;
+        default:
+            value = pattern;
     }
+    volatile uint32_t *w = &SPI(bus).W0;
+    for (size_t i = 0; i < _SPI_BUF_SIZE / 4; i++)
+        w[i] = value;
+    _spi_words_prepare(w, _SPI_BUF_SIZE / (uint8_t)word_size, spi_get_endianness(bus), word_size);
 
-    return len;
+    uint32_t user0 = _mosi_only_begin(bus);
+    size_t bytes = count * (uint8_t)word_size;
+
+    if (bytes >= _SPI_BUF_SIZE)
+    {
+        _set_size(bus, _SPI_BUF_SIZE);
+        for (; bytes >= _SPI_BUF_SIZE; bytes -= _SPI_BUF_SIZE)
+        {
+            _start(bus);
+            _wait(bus);
+        }
+    }
+    if (bytes)
+    {
+        _set_size(bus, bytes);
+        _start(bus);
+        _wait(bus);
+    }
+
+    _mosi_only_end(bus, user0);
+
+    return count;
+}
+
+/* Transactions with command, address and dummy phases */
+
+#define _SPI_USER0_PHASES (SPI_USER0_COMMAND | SPI_USER0_ADDR | SPI_USER0_DUMMY | \
+    SPI_USER0_MOSI | SPI_USER0_MISO | SPI_USER0_MOSI_HIGHPART | SPI_USER0_MISO_HIGHPART | \
+    SPI_USER0_DUPLEX)
+
+bool spi_transaction(uint8_t bus, const spi_transaction_t *t)
+{
+    if (t->command_bits > 16 || t->address_bits > 32)
+        return false;
+
+    size_t out_left = t->out_data ? t->out_len : 0;
+    size_t in_left = t->in_data ? t->in_len : 0;
+    /* when both data phases are present MISO goes into the upper half */
+    size_t chunk = out_left && in_left ? _SPI_BUF_HALF : _SPI_BUF_SIZE;
+    if (!t->address_bits && (out_left > chunk || in_left > chunk))
+        return false; /* can't split without an address to advance */
+
+    spi_async_wait(bus);
+    _wait(bus);
+
+    uint32_t user0 = SPI(bus).USER0;
+    uint32_t phases = 0;
+
+    if (t->command_bits)
+    {
+        /* command is sent starting from the high bits of the low byte */
+        uint16_t command = t->command << (16 - t->command_bits);
+        command = (command >> 8) | (command << 8);
+        SPI(bus).USER2 = VAL2FIELD_M(SPI_USER2_COMMAND_BITLEN, t->command_bits - 1) |
+                         VAL2FIELD_M(SPI_USER2_COMMAND_VALUE, command);
+        phases |= SPI_USER0_COMMAND;
+    }
+    if (t->address_bits)
+    {
+        SPI(bus).USER1 = SET_FIELD(SPI(bus).USER1, SPI_USER1_ADDR_BITLEN, t->address_bits - 1);
+        phases |= SPI_USER0_ADDR;
+    }
+    if (t->dummy_bits)
+    {
+        SPI(bus).USER1 = SET_FIELD(SPI(bus).USER1, SPI_USER1_DUMMY_CYCLELEN, t->dummy_bits - 1);
+        phases |= SPI_USER0_DUMMY;
+    }
+    if (out_left && in_left)
+        phases |= SPI_USER0_MISO_HIGHPART;
+
+    const uint8_t *out = t->out_data;
+    uint8_t *in = t->in_data;
+    uint32_t address = t->address;
+
+    do
+    {
+        size_t out_n = out_left > chunk ? chunk : out_left;
+        size_t in_n = in_left > chunk ? chunk : in_left;
+
+        SPI(bus).USER0 = (user0 & ~_SPI_USER0_PHASES) | phases |
+            (out_n ? SPI_USER0_MOSI : 0) | (in_n ? SPI_USER0_MISO : 0);
+        if (out_n)
+        {
+            SPI(bus).USER1 = SET_FIELD(SPI(bus).USER1, SPI_USER1_MOSI_BITLEN, out_n * 8 - 1);
+            memcpy((void *)&SPI(bus).W0, out, out_n);
+        }
+        if (in_n)
+            SPI(bus).USER1 = SET_FIELD(SPI(bus).USER1, SPI_USER1_MISO_BITLEN, in_n * 8 - 1);
+        if (t->address_bits)
+            SPI(bus).ADDR = address << (32 - t->address_bits);
+
+        _start(bus);
+        _wait(bus);
+
+        if (in_n)
+        {
+            memcpy(in, (void *)(out_n ? &SPI(bus).W8 : &SPI(bus).W0), in_n);
+            in += in_n;
+            in_left -= in_n;
+        }
+        out += out_n;
+        out_left -= out_n;
+        address += out_n + in_n;
+    } while (out_left || in_left);
+
+    SPI(bus).USER0 = user0;
+
+    return true;
+}
+
+/* Asynchronous (interrupt driven) transfers */
+
+static spi_async_transfer_t * volatile _async_head = NULL;
+static spi_async_transfer_t * volatile _async_tail = NULL;
+static bool _async_inited = false;
+
+inline static size_t _async_block_bytes(const spi_async_transfer_t *t)
+{
+    size_t left = t->len * (uint8_t)t->word_size - t->_pos;
+    return left > _SPI_BUF_SIZE ? _SPI_BUF_SIZE : left;
+}
+
+static void IRAM _async_load_block(spi_async_transfer_t *t)
+{
+    size_t bytes = _async_block_bytes(t);
+    _set_size(1, bytes);
+    memcpy((void *)&SPI(1).W0, (const uint8_t *)t->out_data + t->_pos, bytes);
+    _spi_buf_prepare(1, bytes / (uint8_t)t->word_size, spi_get_endianness(1), t->word_size);
+    _start(1);
+}
+
+static void IRAM _async_isr(void)
+{
+    if (!(DPORT.SPI_INT_STATUS & DPORT_SPI_INT_STATUS_SPI1))
+        return;
+    if (!(SPI(1).SLAVE0 & SPI_SLAVE0_TRANS_DONE))
+        return;
+    SPI(1).SLAVE0 &= ~SPI_SLAVE0_TRANS_DONE;
+
+    spi_async_transfer_t *t = _async_head;
+    if (!t)
+        return;
+
+    size_t bytes = _async_block_bytes(t);
+    if (t->in_data)
+    {
+        _spi_buf_prepare(1, bytes / (uint8_t)t->word_size, spi_get_endianness(1), t->word_size);
+        memcpy((uint8_t *)t->in_data + t->_pos, (void *)&SPI(1).W0, bytes);
+    }
+    t->_pos += bytes;
+
+    if (t->_pos < t->len * (uint8_t)t->word_size)
+    {
+        _async_load_block(t);
+        return;
+    }
+
+    /* Transfer is complete, start the next one before running the callback
+       so the bus doesn't sit idle while the callback runs */
+    _async_head = t->_next;
+    if (!_async_head)
+        _async_tail = NULL;
+    else
+        _async_load_block(_async_head);
+
+    t->_next = NULL;
+    if (t->callback)
+        t->callback(t, t->arg);
+}
+
+bool spi_async_submit(uint8_t bus, spi_async_transfer_t *t)
+{
+    if (bus != 1 || !t || !t->out_data || !t->len)
+        return false;
+
+    if (!_async_inited)
+    {
+        _wait(bus);
+        SPI(bus).SLAVE0 = (SPI(bus).SLAVE0 & ~SPI_SLAVE0_TRANS_DONE) | SPI_SLAVE0_TRANS_DONE_EN;
+        _xt_isr_attach(INUM_SPI, _async_isr);
+        _xt_isr_unmask(BIT(INUM_SPI));
+        _async_inited = true;
+    }
+
+    t->_pos = 0;
+    t->_next = NULL;
+
+    uint32_t ps = _xt_disable_interrupts();
+    if (_async_tail)
+    {
+        _async_tail->_next = t;
+        _async_tail = t;
+    }
+    else
+    {
+        _async_head = _async_tail = t;
+        _async_load_block(t);
+    }
+    _xt_restore_interrupts(ps);
+
+    return true;
+}
+
+bool spi_async_busy(uint8_t bus)
+{
+    return bus == 1 && _async_head != NULL;
+}
+
+void spi_async_wait(uint8_t bus)
+{
+    while (spi_async_busy(bus))
+        ;
 }
@@ -0,0 +1,186 @@
+/* Task stack usage monitor, see esp/stackmon.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <esp/stackmon.h>
+
+#if ESP_STACKMON
+
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+typedef struct {
+    void *task;
+    const char *name;           /* in the TCB, so valid while the task is */
+    uint16_t size;
+    uint16_t free;              /* at the last sample */
+    uint16_t warned;            /* free when last warned about, or 0xffff */
+} stackmon_task_t;
+
+static stackmon_task_t tasks[STACKMON_MAX_TASKS];
+static uint32_t untracked;
+
+static uint32_t sample_ms, report_ms;
+static unsigned margin_percent;
+
+/* These two run in xTaskGenericCreate() and vTaskDelete(), in critical
+   sections. A deleted task's TCB (and its name) is freed later, by the
+   idle task. */
+void stackmon_task_created(void *task, const char *name, unsigned short size)
+{
+    for (int i = 0; i < STACKMON_MAX_TASKS; i++) {
+        if (!tasks[i].task) {
+            tasks[i].task = task;
+            tasks[i].name = name;
+            tasks[i].size = size;
+            tasks[i].free = size;
+            tasks[i].warned = 0xffff;
+            return;
+        }
+    }
+    untracked++;
+}
+
+void stackmon_task_deleted(void *task)
+{
+    for (int i = 0; i < STACKMON_MAX_TASKS; i++) {
+        if (tasks[i].task == task) {
+            tasks[i].task = NULL;
+            break;
+        }
+    }
+}
+
+static uint16_t recommend(uint16_t used)
+{
+    uint32_t headroom = used * STACKMON_HEADROOM_PERCENT / 100;
+
+    if (headroom < STACKMON_MIN_HEADROOM)
+        headroom = STACKMON_MIN_HEADROOM;
+    return (used + headroom + 15) & ~15;
+}
+
+/* With the scheduler suspended, so the idle task can't free a TCB
+   while its stack is being scanned */
+static void sample_all(void)
+{
+    vTaskSuspendAll();
+    for (int i = 0; i < STACKMON_MAX_TASKS; i++) {
+        if (tasks[i].task)
+            tasks[i].free = uxTaskGetStackHighWaterMark(tasks[i].task);
+    }
+    xTaskResumeAll();
+}
+
+/* Copy slot 'i' out, if it's in use. With the scheduler suspended, as
+   the task may be deleted meanwhile. */
+static bool get_info(int i, stackmon_info_t *info)
+{
+    const stackmon_task_t *t = &tasks[i];
+    bool used;
+
+    vTaskSuspendAll();
+    used = t->task != NULL;
+    if (used) {
+        info->task = t->task;
+        strncpy(info->name, t->name, sizeof(info->name) - 1);
+        info->name[sizeof(info->name) - 1] = 0;
+        info->size = t->size;
+        info->free = t->free;
+        info->recommended = recommend(t->size - t->free);
+    }
+    xTaskResumeAll();
+    return used;
+}
+
+size_t stackmon_sample(stackmon_info_t *info, size_t max)
+{
+    stackmon_info_t spare;
+    size_t n = 0;
+
+    sample_all();
+    for (int i = 0; i < STACKMON_MAX_TASKS; i++) {
+        if (get_info(i, n < max ? &info[n] : &spare))
+            n++;
+    }
+    return n;
+}
+
+void stackmon_report(void)
+{
+    stackmon_info_t info;
+    uint32_t size = 0, peak = 0, rec = 0;
+
+    sample_all();
+    printf("stackmon: %-16s %5s %5s %5s %5s\n", "task", "size", "peak", "free", "rec");
+    for (int i = 0; i < STACKMON_MAX_TASKS; i++) {
+        if (!get_info(i, &info))
+            continue;
+        uint32_t used = info.size - info.free;
+        printf("stackmon: %-16s %5u %5u %5u %5u\n", info.name, info.size, used,
+               info.free, info.recommended);
+        size += info.size;
+        peak += used;
+        rec += info.recommended;
+    }
+    printf("stackmon: %-16s %5u %5u %5s %5u", "total", size, peak, "", rec);
+    if (rec < size)
+        printf("  (saves %u bytes)", (size - rec) * 4);
+    printf("\n");
+    if (untracked)
+        printf("stackmon: %u tasks not tracked, raise STACKMON_MAX_TASKS\n", untracked);
+}
+
+uint32_t stackmon_untracked(void)
+{
+    return untracked;
+}
+
+static void check_margins(void)
+{
+    stackmon_info_t info;
+
+    for (int i = 0; i < STACKMON_MAX_TASKS; i++) {
+        if (!get_info(i, &info) || info.free >= info.size * margin_percent / 100)
+            continue;
+        /* Once per new low */
+        if (info.free >= tasks[i].warned)
+            continue;
+        tasks[i].warned = info.free;
+        printf("stackmon: WARNING task '%s' has %u of %u words of stack left\n",
+               info.name, info.free, info.size);
+    }
+}
+
+static void stackmon_task(void *pvParameters)
+{
+    portTickType last = xTaskGetTickCount();
+    uint32_t since_report = 0;
+
+    while (1) {
+        vTaskDelayUntil(&last, sample_ms / portTICK_RATE_MS);
+        sample_all();
+        check_margins();
+        since_report += sample_ms;
+        if (report_ms && since_report >= report_ms) {
+            stackmon_report();
+            since_report = 0;
+        }
+    }
+}
+
+bool stackmon_start(unsigned priority, uint32_t sample, uint32_t report, unsigned margin)
+{
+    sample_ms = sample;
+    report_ms = report;
+    margin_percent = margin;
+    return xTaskCreate(stackmon_task, (signed char *)"stackmon", 384, NULL, priority,
+                       NULL) == pdPASS;
+}
+
+#endif /* ESP_STACKMON */
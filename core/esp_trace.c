@@ -0,0 +1,137 @@
+/* Context switch and event tracing, see esp/trace.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <esp/trace.h>
+
+#if ESP_TRACE
+
+#include <esp/interrupts.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "espressif/esp_common.h"
+
+typedef struct {
+    uint32_t ccount;
+    uint32_t info;      /* event << 24 | id */
+} trace_record_t;
+
+typedef struct {
+    uint32_t id;
+    char name[configMAX_TASK_NAME_LEN];
+} trace_task_t;
+
+static trace_record_t records[TRACE_BUFFER_RECORDS];
+static uint32_t head;           /* next record written */
+static uint32_t total;          /* recorded since trace_start() */
+static bool running;
+
+/* Names of all tasks created since boot, recording or not */
+static trace_task_t tasks[TRACE_MAX_TASKS];
+
+static inline uint32_t get_ccount(void)
+{
+    uint32_t ccount;
+    __asm__ volatile ("rsr %0, ccount" : "=a" (ccount));
+    return ccount;
+}
+
+/* Runs in the kernel and interrupt handlers. The NMI can't be masked,
+   so an NMI that sends to a queue can overwrite the record it
+   interrupted. */
+void IRAM trace_record(trace_event_t event, uint32_t id)
+{
+    if (!running)
+        return;
+
+    uint32_t ps = _xt_disable_interrupts();
+    trace_record_t *r = &records[head];
+    if (++head == TRACE_BUFFER_RECORDS)
+        head = 0;
+    total++;
+    r->ccount = get_ccount();
+    r->info = (uint32_t)event << 24 | (id & 0xffffff);
+    _xt_restore_interrupts(ps);
+}
+
+void trace_task_created(void *task, const char *name)
+{
+    uint32_t id = (uint32_t)task & 0xffffff;
+    trace_task_t *slot = NULL;
+
+    for (int i = 0; i < TRACE_MAX_TASKS; i++) {
+        if (tasks[i].id == id || (!slot && !tasks[i].id))
+            slot = &tasks[i];
+        if (tasks[i].id == id)
+            break;
+    }
+    if (slot) {
+        slot->id = id;
+        strncpy(slot->name, name, sizeof(slot->name) - 1);
+    }
+    trace_record(TRACE_TASK_CREATE, id);
+}
+
+void trace_start(void)
+{
+    uint32_t ps = _xt_disable_interrupts();
+    head = 0;
+    total = 0;
+    running = true;
+    _xt_restore_interrupts(ps);
+    /* So the decoder knows who is running until the first switch */
+    trace_record(TRACE_TASK_SWITCH, (uint32_t)xTaskGetCurrentTaskHandle());
+}
+
+void trace_stop(void)
+{
+    running = false;
+}
+
+void trace_mark(uint32_t value)
+{
+    trace_record(TRACE_MARK, value);
+}
+
+static void print_line(const char *line, void *arg)
+{
+    printf("%s\n", line);
+}
+
+void trace_dump(void (*emit)(const char *line, void *arg), void *arg)
+{
+    char line[48];
+
+    trace_stop();
+    if (!emit)
+        emit = print_line;
+
+    uint32_t count = total < TRACE_BUFFER_RECORDS ? total : TRACE_BUFFER_RECORDS;
+    snprintf(line, sizeof(line), "# trace %u records, %u overwritten, %u MHz",
+             count, total - count, sdk_system_get_cpu_freq());
+    emit(line, arg);
+
+    for (int i = 0; i < TRACE_MAX_TASKS; i++) {
+        if (!tasks[i].id)
+            continue;
+        snprintf(line, sizeof(line), "TASK,%06x,%s", tasks[i].id, tasks[i].name);
+        emit(line, arg);
+    }
+
+    uint32_t index = (head + TRACE_BUFFER_RECORDS - count) % TRACE_BUFFER_RECORDS;
+    for (uint32_t i = 0; i < count; i++) {
+        const trace_record_t *r = &records[index];
+        snprintf(line, sizeof(line), "TRACE,%08x,%u,%06x",
+                 r->ccount, r->info >> 24, r->info & 0xffffff);
+        emit(line, arg);
+        if (++index == TRACE_BUFFER_RECORDS)
+            index = 0;
+    }
+}
+
+#endif /* ESP_TRACE */
@@ -0,0 +1,426 @@
+/* Interrupt driven UART0/UART1 driver for esp/uart.h
+ *
+ * Each UART can have a TX ring, drained into the hardware FIFO by the
+ * TXFIFO-empty interrupt, and an RX ring, filled from the hardware FIFO
+ * on RXFIFO-full and RX-timeout interrupts.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <esp/uart.h>
+#include <esp/interrupts.h>
+#include <esp/iomux.h>
+#include <stdlib.h>
+#include <string.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+#define _RX_INTS (UART_INT_ENABLE_RXFIFO_FULL | UART_INT_ENABLE_RXFIFO_TIMEOUT | UART_INT_ENABLE_RXFIFO_OVERFLOW)
+
+typedef struct {
+    /* TX ring. head is written by uart_write (under critical section),
+       tail by the ISR or by a writer blocked on a full ring. */
+    uint8_t *tx_buf;
+    uint32_t tx_mask;
+    volatile uint32_t tx_head;
+    volatile uint32_t tx_tail;
+    uart_tx_mode_t tx_mode;
+    volatile uint32_t tx_dropped;
+
+    /* RX ring. Single producer (ISR writes rx_head), single consumer
+       (uart_read writes rx_tail), so no critical section is needed. */
+    uint8_t *rx_buf;
+    uint32_t rx_mask;
+    volatile uint32_t rx_head;
+    volatile uint32_t rx_tail;
+    volatile uint32_t rx_overflows;
+    /* Task blocked in uart_read, woken with a task notification */
+    volatile xTaskHandle rx_reader;
+    uart_rx_callback_t rx_callback;
+    void *rx_callback_arg;
+
+    /* Thresholds have been set explicitly, don't apply defaults */
+    bool tx_threshold_set;
+    bool rx_thresholds_set;
+} _uart_port_t;
+
+static _uart_port_t _port[2];
+
+/* Whatever handled INUM_UART before the driver was first enabled */
+extern _xt_isr isr[16];
+static _xt_isr _prev_uart_isr;
+static bool _uart_isr_attached;
+
+/* Move as much as fits from the TX ring to the hardware FIFO. Must be
+   called with interrupts disabled. Returns number of bytes moved. */
+static uint32_t IRAM _tx_ring_drain(int uart_num)
+{
+    _uart_port_t *port = &_port[uart_num];
+    uint32_t tail = port->tx_tail;
+    uint32_t count = port->tx_head - tail;
+    uint32_t space = UART_FIFO_MAX - FIELD2VAL(UART_STATUS_TXFIFO_COUNT, UART(uart_num).STATUS);
+
+    if (count > space)
+        count = space;
+    for (uint32_t i = 0; i < count; i++) {
+        UART(uart_num).FIFO = port->tx_buf[tail++ & port->tx_mask];
+    }
+    port->tx_tail = tail;
+    return count;
+}
+
+/* Move as much as fits from the hardware FIFO to the RX ring. Returns
+   true if a waiting reader was woken and needs a context switch. */
+static bool IRAM _rx_ring_fill(int uart_num)
+{
+    _uart_port_t *port = &_port[uart_num];
+    uint32_t head = port->rx_head;
+    uint32_t space = port->rx_mask + 1 - (head - port->rx_tail);
+    uint32_t count = FIELD2VAL(UART_STATUS_RXFIFO_COUNT, UART(uart_num).STATUS);
+    portBASE_TYPE woken = pdFALSE;
+
+    if (count > space)
+        count = space;
+    for (uint32_t i = 0; i < count; i++) {
+        port->rx_buf[head++ & port->rx_mask] = UART(uart_num).FIFO;
+    }
+    port->rx_head = head;
+
+    if (head - port->rx_tail == port->rx_mask + 1) {
+        /* Ring is full. Leave the rest in the hardware FIFO and stop
+           interrupting until the reader has made some room. */
+        UART(uart_num).INT_ENABLE &= ~_RX_INTS;
+    }
+
+    if (count && port->rx_reader) {
+        xTaskHandle reader = port->rx_reader;
+        port->rx_reader = NULL;
+        vTaskNotifyGiveFromISR(reader, &woken);
+    }
+    return woken;
+}
+
+static void IRAM _uart_isr(void)
+{
+    bool woken = false;
+
+    for (int uart_num = 0; uart_num < 2; uart_num++) {
+        _uart_port_t *port = &_port[uart_num];
+        uint32_t status = UART(uart_num).INT_STATUS;
+
+        if (port->tx_buf && (status & UART_INT_STATUS_TXFIFO_EMPTY)) {
+            _tx_ring_drain(uart_num);
+            if (port->tx_head == port->tx_tail)
+                UART(uart_num).INT_ENABLE &= ~UART_INT_ENABLE_TXFIFO_EMPTY;
+            UART(uart_num).INT_CLEAR = UART_INT_CLEAR_TXFIFO_EMPTY;
+        }
+        if (port->rx_buf && (status & _RX_INTS)) {
+            if (status & UART_INT_STATUS_RXFIFO_OVERFLOW)
+                port->rx_overflows++;
+            woken |= _rx_ring_fill(uart_num);
+            UART(uart_num).INT_CLEAR = _RX_INTS;
+            if (port->rx_callback)
+                woken |= port->rx_callback(uart_num, port->rx_head,
+                                           status & UART_INT_STATUS_RXFIFO_TIMEOUT,
+                                           port->rx_callback_arg);
+        }
+    }
+    if (_prev_uart_isr)
+        _prev_uart_isr();
+    if (woken)
+        portYIELD();
+}
+
+static void _uart_isr_attach(void)
+{
+    uint32_t old_level = _xt_disable_interrupts();
+    if (!_uart_isr_attached) {
+        _prev_uart_isr = isr[INUM_UART];
+        _xt_isr_attach(INUM_UART, _uart_isr);
+        _uart_isr_attached = true;
+    }
+    _xt_restore_interrupts(old_level);
+    _xt_isr_unmask(BIT(INUM_UART));
+}
+
+static size_t _ring_size(size_t size)
+{
+    size_t ring_size = 1;
+    while (ring_size < size)
+        ring_size <<= 1;
+    return ring_size;
+}
+
+bool uart_tx_buffer_enable(int uart_num, size_t size, uart_tx_mode_t mode)
+{
+    _uart_port_t *port = &_port[uart_num];
+    size_t ring_size = _ring_size(size);
+
+    if (port->tx_buf)
+        return false;
+    uint8_t *buf = malloc(ring_size);
+    if (!buf)
+        return false;
+
+    if (uart_num == 1) {
+        /* GPIO2 is the only usable UART1 pin, as its RX is wired to flash */
+        IOMUX_GPIO2 = (IOMUX_GPIO2 & ~IOMUX_PIN_FUNC_MASK) | IOMUX_GPIO2_FUNC_UART1_TXD;
+    }
+    if (!port->tx_threshold_set)
+        uart_set_tx_threshold(uart_num, UART_DEFAULT_TX_EMPTY_THRESHOLD);
+    UART(uart_num).INT_CLEAR = UART_INT_CLEAR_TXFIFO_EMPTY;
+
+    uint32_t old_level = _xt_disable_interrupts();
+    port->tx_mask = ring_size - 1;
+    port->tx_head = port->tx_tail = 0;
+    port->tx_mode = mode;
+    port->tx_dropped = 0;
+    port->tx_buf = buf;
+    _xt_restore_interrupts(old_level);
+
+    _uart_isr_attach();
+    return true;
+}
+
+bool uart_rx_buffer_enable(int uart_num, size_t size)
+{
+    _uart_port_t *port = &_port[uart_num];
+    size_t ring_size = _ring_size(size);
+
+    if (port->rx_buf)
+        return false;
+    uint8_t *buf = malloc(ring_size);
+    if (!buf)
+        return false;
+    uart_clear_rxfifo(uart_num);
+    if (!port->rx_thresholds_set)
+        uart_set_rx_thresholds(uart_num, UART_DEFAULT_RX_FULL_THRESHOLD, UART_DEFAULT_RX_TIMEOUT);
+
+    port->rx_mask = ring_size - 1;
+    port->rx_head = port->rx_tail = 0;
+    port->rx_overflows = 0;
+    port->rx_buf = buf;
+
+    UART(uart_num).INT_CLEAR = _RX_INTS;
+    UART(uart_num).INT_ENABLE |= _RX_INTS;
+    _uart_isr_attach();
+    return true;
+}
+
+void uart_set_rx_thresholds(int uart_num, uint8_t full_threshold, uint8_t timeout)
+{
+    uint32_t conf = UART(uart_num).CONF1;
+    conf = SET_FIELD_M(conf, UART_CONF1_RXFIFO_FULL_THRESHOLD, full_threshold);
+    conf = SET_FIELD_M(conf, UART_CONF1_RX_TIMEOUT_THRESHOLD, timeout);
+    if (timeout)
+        conf |= UART_CONF1_RX_TIMEOUT_ENABLE;
+    else
+        conf &= ~UART_CONF1_RX_TIMEOUT_ENABLE;
+    UART(uart_num).CONF1 = conf;
+    _port[uart_num].rx_thresholds_set = true;
+}
+
+void uart_set_rx_callback(int uart_num, uart_rx_callback_t callback, void *arg)
+{
+    uint32_t old_level = _xt_disable_interrupts();
+    _port[uart_num].rx_callback = callback;
+    _port[uart_num].rx_callback_arg = arg;
+    _xt_restore_interrupts(old_level);
+}
+
+void uart_set_tx_threshold(int uart_num, uint8_t empty_threshold)
+{
+    UART(uart_num).CONF1 = SET_FIELD_M(UART(uart_num).CONF1, UART_CONF1_TXFIFO_EMPTY_THRESHOLD, empty_threshold);
+    _port[uart_num].tx_threshold_set = true;
+}
+
+bool uart_tx_buffered(int uart_num)
+{
+    return _port[uart_num].tx_buf != NULL;
+}
+
+uint32_t uart_tx_dropped(int uart_num)
+{
+    return _port[uart_num].tx_dropped;
+}
+
+uint32_t uart_rx_overflows(int uart_num)
+{
+    return _port[uart_num].rx_overflows;
+}
+
+size_t IRAM uart_write(int uart_num, const void *data, size_t len)
+{
+    _uart_port_t *port = &_port[uart_num];
+    const uint8_t *bytes = data;
+    size_t written = 0;
+
+    if (!port->tx_buf) {
+        for (; written < len; written++)
+            uart_putc(uart_num, bytes[written]);
+        return len;
+    }
+
+    while (written < len) {
+        uint32_t old_level = _xt_disable_interrupts();
+        uint32_t head = port->tx_head;
+        uint32_t space = port->tx_mask + 1 - (head - port->tx_tail);
+        uint32_t count = len - written;
+
+        if (count > space)
+            count = space;
+        for (uint32_t i = 0; i < count; i++) {
+            port->tx_buf[head++ & port->tx_mask] = bytes[written++];
+        }
+        port->tx_head = head;
+        if (count)
+            UART(uart_num).INT_ENABLE |= UART_INT_ENABLE_TXFIFO_EMPTY;
+
+        if (written < len) {
+            if (port->tx_mode == UART_TX_DROP) {
+                port->tx_dropped += len - written;
+                _xt_restore_interrupts(old_level);
+                break;
+            }
+            /* Ring is full. Drain it ourselves rather than relying on the
+               interrupt, which may be masked in the caller's context. */
+            bool moved = _tx_ring_drain(uart_num) != 0;
+            _xt_restore_interrupts(old_level);
+            if (!moved)
+                uart_txfifo_wait(uart_num, 1);
+            continue;
+        }
+        _xt_restore_interrupts(old_level);
+    }
+    return written;
+}
+
+void uart_tx_flush(int uart_num)
+{
+    _uart_port_t *port = &_port[uart_num];
+    while (port->tx_buf && port->tx_head != port->tx_tail) {
+        uint32_t old_level = _xt_disable_interrupts();
+        _tx_ring_drain(uart_num);
+        _xt_restore_interrupts(old_level);
+    }
+    uart_flush_txfifo(uart_num);
+}
+
+size_t uart_rx_available(int uart_num)
+{
+    _uart_port_t *port = &_port[uart_num];
+    size_t count = FIELD2VAL(UART_STATUS_RXFIFO_COUNT, UART(uart_num).STATUS);
+    if (port->rx_buf)
+        count += port->rx_head - port->rx_tail;
+    return count;
+}
+
+/* Wait up to 'timeout_ticks' for the RX ring to have something in it.
+   Returns false on timeout. */
+static bool _rx_wait(_uart_port_t *port, uint32_t timeout_ticks)
+{
+    while (port->rx_head == port->rx_tail) {
+        port->rx_reader = xTaskGetCurrentTaskHandle();
+        /* Data may have arrived after the check above, in which case
+           the ISR has already sent (or will send) the notification. */
+        if (port->rx_head == port->rx_tail && !ulTaskNotifyTake(pdTRUE, timeout_ticks)) {
+            port->rx_reader = NULL;
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Mark 'count' bytes at the tail of the RX ring read */
+static void _rx_consume(int uart_num, uint32_t count)
+{
+    _uart_port_t *port = &_port[uart_num];
+    uint32_t tail = port->rx_tail + count;
+
+    port->rx_tail = tail;
+    if (!(UART(uart_num).INT_ENABLE & UART_INT_ENABLE_RXFIFO_FULL)
+        && port->rx_head - tail <= (port->rx_mask + 1) / 2) {
+        /* ISR backed off while the ring was full, let it refill */
+        uint32_t old_level = _xt_disable_interrupts();
+        UART(uart_num).INT_ENABLE |= _RX_INTS;
+        _xt_restore_interrupts(old_level);
+    }
+}
+
+size_t uart_read(int uart_num, void *data, size_t len, uint32_t timeout_ticks)
+{
+    _uart_port_t *port = &_port[uart_num];
+    uint8_t *bytes = data;
+    size_t count;
+
+    if (!port->rx_buf) {
+        /* No RX ring, poll the hardware FIFO */
+        for (count = 0; count < len; count++) {
+            int ch = uart_getc_nowait(uart_num);
+            if (ch < 0)
+                break;
+            bytes[count] = ch;
+        }
+        return count;
+    }
+
+    if (!_rx_wait(port, timeout_ticks))
+        return 0;
+
+    uint32_t tail = port->rx_tail;
+    count = port->rx_head - tail;
+    if (count > len)
+        count = len;
+    for (size_t i = 0; i < count; i++) {
+        bytes[i] = port->rx_buf[tail++ & port->rx_mask];
+    }
+    _rx_consume(uart_num, count);
+    return count;
+}
+
+size_t uart_rx_peek(int uart_num, const uint8_t **data, uint32_t timeout_ticks)
+{
+    _uart_port_t *port = &_port[uart_num];
+
+    if (!port->rx_buf || !_rx_wait(port, timeout_ticks))
+        return 0;
+
+    uint32_t tail = port->rx_tail;
+    uint32_t count = port->rx_head - tail;
+    uint32_t to_end = port->rx_mask + 1 - (tail & port->rx_mask);
+    *data = port->rx_buf + (tail & port->rx_mask);
+    return count < to_end ? count : to_end;
+}
+
+void uart_rx_consume(int uart_num, size_t len)
+{
+    _uart_port_t *port = &_port[uart_num];
+    uint32_t count = port->rx_head - port->rx_tail;
+
+    if (port->rx_buf)
+        _rx_consume(uart_num, len < count ? len : count);
+}
+
+void uart_set_flow_control(int uart_num, bool rts, bool cts, uint8_t rts_threshold)
+{
+    if (uart_num == 0) {
+        if (rts)
+            IOMUX_GPIO15 = (IOMUX_GPIO15 & ~IOMUX_PIN_FUNC_MASK) | IOMUX_GPIO15_FUNC_UART0_RTS;
+        if (cts)
+            IOMUX_GPIO13 = (IOMUX_GPIO13 & ~IOMUX_PIN_FUNC_MASK) | IOMUX_GPIO13_FUNC_UART0_CTS;
+    }
+
+    uint32_t conf = UART(uart_num).CONF1;
+    conf = SET_FIELD_M(conf, UART_CONF1_RX_FLOWCTRL_THRESHOLD, rts_threshold);
+    if (rts)
+        conf |= UART_CONF1_RX_FLOWCTRL_ENABLE;
+    else
+        conf &= ~UART_CONF1_RX_FLOWCTRL_ENABLE;
+    UART(uart_num).CONF1 = conf;
+
+    if (cts)
+        UART(uart_num).CONF0 |= UART_CONF0_TX_FLOW_ENABLE;
+    else
+        UART(uart_num).CONF0 &= ~UART_CONF0_TX_FLOW_ENABLE;
+}
@@ -0,0 +1,581 @@
+/* Compact printf formatting, see fmt.h
+ *
+ * Output goes through an out_t, either into the caller's buffer
+ * directly (snprintf, with no sink) or into a chunk on the stack that's
+ * passed to the sink when full and at the end. Each conversion is
+ * turned into a prefix (sign, "0x"), leading zeros and a body, which
+ * emit() pads out to the field width.
+ *
+ * Integers up to 32 bits are converted with 32 bit division, only
+ * 64 bit arguments pay for the libgcc 64 bit helpers.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <fmt.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+#include <esp/uart.h>
+
+#define LEFT  0x01
+#define PLUS  0x02
+#define SPACE 0x04
+#define ALT   0x08
+#define ZERO  0x10
+
+#define MAX_PRECISION 9
+
+typedef struct {
+    fmt_sink_t sink;
+    void *arg;
+    char *buf;
+    size_t room;        /* without a sink: bytes left in buf, less the NUL */
+    size_t used;        /* with a sink: bytes in chunk */
+    int count;
+    char chunk[FMT_CHUNK];
+} out_t;
+
+typedef struct {
+    uint8_t flags;
+    int width;
+    int precision;      /* -1 if none given */
+} spec_t;
+
+static void flush(out_t *o)
+{
+    if (o->used) {
+        o->sink(o->arg, o->chunk, o->used);
+        o->used = 0;
+    }
+}
+
+static void put(out_t *o, const char *s, size_t n)
+{
+    o->count += n;
+    if (!o->sink) {
+        size_t len = n < o->room ? n : o->room;
+        memcpy(o->buf, s, len);
+        o->buf += len;
+        o->room -= len;
+        return;
+    }
+    while (n) {
+        size_t len = FMT_CHUNK - o->used;
+        if (len > n)
+            len = n;
+        memcpy(o->chunk + o->used, s, len);
+        o->used += len;
+        s += len;
+        n -= len;
+        if (o->used == FMT_CHUNK)
+            flush(o);
+    }
+}
+
+static void fill(out_t *o, char c, int n)
+{
+    static const char spaces[8] = "        ", zeros[8] = "00000000";
+    const char *run = c == ' ' ? spaces : zeros;
+
+    for (; n > 0; n -= 8)
+        put(o, run, n < 8 ? n : 8);
+}
+
+static void emit(out_t *o, const spec_t *sp, const char *prefix, int prefix_len,
+                 int zeros, const char *body, int len)
+{
+    int pad = sp->width - prefix_len - zeros - len;
+
+    if (!(sp->flags & LEFT)) {
+        if (sp->flags & ZERO) {
+            if (pad > 0)
+                zeros += pad;
+        } else {
+            fill(o, ' ', pad);
+        }
+        pad = 0;
+    }
+    put(o, prefix, prefix_len);
+    fill(o, '0', zeros);
+    put(o, body, len);
+    fill(o, ' ', pad);
+}
+
+/* Digits of 'v' ending at 'end', returns the first */
+static char *utoa_rev(char *end, uint64_t v, unsigned base, bool upper)
+{
+    const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    uint32_t v32;
+
+    while (v >> 32) {
+        *--end = digits[v % base];
+        v /= base;
+    }
+    for (v32 = v; v32; v32 /= base)
+        *--end = digits[v32 % base];
+    return end;
+}
+
+static void emit_int(out_t *o, spec_t *sp, uint64_t v, bool negative, unsigned base, bool upper)
+{
+    char tmp[24], *end = tmp + sizeof(tmp);
+    char *digits = utoa_rev(end, v, base, upper);
+    char prefix[2];
+    int prefix_len = 0;
+    int len = end - digits;
+    int zeros = 0;
+
+    if (negative)
+        prefix[prefix_len++] = '-';
+    else if (sp->flags & PLUS)
+        prefix[prefix_len++] = '+';
+    else if (sp->flags & SPACE)
+        prefix[prefix_len++] = ' ';
+
+    if ((sp->flags & ALT) && v) {
+        if (base == 16) {
+            prefix[prefix_len++] = '0';
+            prefix[prefix_len++] = upper ? 'X' : 'x';
+        } else if (base == 8) {
+            *--digits = '0';
+            len++;
+        }
+    }
+
+    /* Zero has no digits at precision 0, unless it's the octal prefix */
+    if (!v && (sp->precision < 0 || (base == 8 && (sp->flags & ALT)))) {
+        *--digits = '0';
+        len = 1;
+    }
+    if (sp->precision >= 0) {
+        sp->flags &= ~ZERO;
+        if (sp->precision > len)
+            zeros = sp->precision - len;
+    }
+    emit(o, sp, prefix, prefix_len, zeros, digits, len);
+}
+
+#if FMT_FLOAT
+
+static const uint32_t powers[MAX_PRECISION + 1] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000,
+    1000000000,
+};
+
+/* Decimal digits of v < 10^19, 'precision' of them after the point */
+static int format_fixed(char *buf, double v, int precision, bool point)
+{
+    uint64_t ip = v;
+    uint32_t scale = powers[precision];
+    double x = (v - ip) * scale;
+    uint32_t frac = x;
+    char tmp[20], *end = tmp + sizeof(tmp);
+    char *digits;
+    int len;
+
+    /* Ties to even, as newlib does */
+    if (x - frac > 0.5 || (x - frac == 0.5 && ((precision ? frac : ip) & 1)))
+        frac++;
+    if (frac >= scale) {
+        frac -= scale;
+        ip++;
+    }
+    digits = ip ? utoa_rev(end, ip, 10, false) : end - 1;
+    if (!ip)
+        *digits = '0';
+    len = end - digits;
+    memcpy(buf, digits, len);
+    if (precision || point)
+        buf[len++] = '.';
+    for (int i = precision - 1; i >= 0; i--) {
+        buf[len + i] = '0' + frac % 10;
+        frac /= 10;
+    }
+    return len + precision;
+}
+
+/* v = m * 10^exp with 1 <= m < 10, m rounded to 'precision' decimals */
+static int decimal_exponent(double *v, int precision)
+{
+    int exp = 0;
+    double m = *v;
+
+    if (m == 0)
+        return 0;
+    while (m >= 1e8) {
+        m /= 1e8;
+        exp += 8;
+    }
+    while (m >= 10) {
+        m /= 10;
+        exp++;
+    }
+    while (m < 1e-8) {
+        m *= 1e8;
+        exp -= 8;
+    }
+    while (m < 1) {
+        m *= 10;
+        exp--;
+    }
+    if (m + 0.5 / powers[precision] >= 10) {
+        m /= 10;
+        exp++;
+    }
+    *v = m;
+    return exp;
+}
+
+static int format_exp(char *buf, double v, int precision, bool point, bool upper)
+{
+    int exp = decimal_exponent(&v, precision);
+    int len = format_fixed(buf, v, precision, point);
+
+    buf[len++] = upper ? 'E' : 'e';
+    buf[len++] = exp < 0 ? '-' : '+';
+    if (exp < 0)
+        exp = -exp;
+    if (exp >= 100)
+        buf[len++] = '0' + exp / 100;
+    buf[len++] = '0' + exp / 10 % 10;
+    buf[len++] = '0' + exp % 10;
+    return len;
+}
+
+static void emit_float(out_t *o, spec_t *sp, double v, char conv)
+{
+    bool upper = conv == 'F' || conv == 'E' || conv == 'G';
+    bool alt = sp->flags & ALT;
+    int precision = sp->precision < 0 ? 6 : sp->precision;
+    char prefix[1];
+    int prefix_len = 0;
+    char buf[40];
+    int len;
+
+    if (precision > MAX_PRECISION)
+        precision = MAX_PRECISION;
+    if (v < 0 || (v == 0 && 1 / v < 0)) {
+        prefix[prefix_len++] = '-';
+        v = -v;
+    } else if (sp->flags & PLUS) {
+        prefix[prefix_len++] = '+';
+    } else if (sp->flags & SPACE) {
+        prefix[prefix_len++] = ' ';
+    }
+
+    if (v != v || v > 1.7976931348623157e308) {
+        memcpy(buf, v != v ? (upper ? "NAN" : "nan") : (upper ? "INF" : "inf"), 3);
+        sp->flags &= ~ZERO;
+        emit(o, sp, prefix, prefix_len, 0, buf, 3);
+        return;
+    }
+
+    if (conv == 'g' || conv == 'G') {
+        double m = v;
+        int exp;
+
+        if (!precision)
+            precision = 1;
+        exp = decimal_exponent(&m, precision - 1);
+        if (exp < -4 || exp >= precision) {
+            len = format_exp(buf, v, precision - 1, alt, upper);
+        } else {
+            int decimals = precision - 1 - exp;
+            if (decimals > MAX_PRECISION)
+                decimals = MAX_PRECISION;
+            len = format_fixed(buf, v, decimals, alt);
+        }
+        if (!alt && memchr(buf, '.', len)) {
+            /* Trailing zeros go, from the digits before any exponent */
+            char *e = memchr(buf, upper ? 'E' : 'e', len);
+            int end = e ? e - buf : len, cut = end;
+            while (buf[cut - 1] == '0')
+                cut--;
+            if (buf[cut - 1] == '.')
+                cut--;
+            memmove(buf + cut, buf + end, len - end);
+            len -= end - cut;
+        }
+    } else if (conv == 'e' || conv == 'E' || v >= 1e19) {
+        len = format_exp(buf, v, precision, alt, upper);
+    } else {
+        len = format_fixed(buf, v, precision, alt);
+    }
+    emit(o, sp, prefix, prefix_len, 0, buf, len);
+}
+
+#endif /* FMT_FLOAT */
+
+static int format(out_t *o, const char *f, va_list ap)
+{
+    while (*f) {
+        const char *start = f;
+        while (*f && *f != '%')
+            f++;
+        put(o, start, f - start);
+        if (!*f)
+            break;
+        start = f++;
+
+        spec_t sp = { 0, 0, -1 };
+        for (;; f++) {
+            if (*f == '-')
+                sp.flags |= LEFT;
+            else if (*f == '+')
+                sp.flags |= PLUS;
+            else if (*f == ' ')
+                sp.flags |= SPACE;
+            else if (*f == '#')
+                sp.flags |= ALT;
+            else if (*f == '0')
+                sp.flags |= ZERO;
+            else
+                break;
+        }
+        if (*f == '*') {
+            sp.width = va_arg(ap, int);
+            if (sp.width < 0) {
+                sp.flags |= LEFT;
+                sp.width = -sp.width;
+            }
+            f++;
+        } else {
+            while (*f >= '0' && *f <= '9')
+                sp.width = sp.width * 10 + *f++ - '0';
+        }
+        if (*f == '.') {
+            f++;
+            if (*f == '*') {
+                sp.precision = va_arg(ap, int);
+                f++;
+            } else {
+                sp.precision = 0;
+                while (*f >= '0' && *f <= '9')
+                    sp.precision = sp.precision * 10 + *f++ - '0';
+            }
+            if (sp.precision < 0)
+                sp.precision = -1;
+        }
+        if (sp.flags & LEFT)
+            sp.flags &= ~ZERO;
+
+        /* Length in 'long's: -2 char, -1 short, 0 int, 1 long, 2 long long */
+        int size = 0;
+        for (;; f++) {
+            if (*f == 'h')
+                size--;
+            else if (*f == 'l')
+                size++;
+            else if (*f == 'j' || *f == 'L' || *f == 'q')
+                size = 2;
+            else if (*f == 'z' || *f == 't')
+                size = sizeof(size_t) > sizeof(int) ? 2 : 0;
+            else
+                break;
+        }
+
+        char conv = *f++;
+        switch (conv) {
+        case 'd':
+        case 'i': {
+            int64_t v = size >= 2 ? va_arg(ap, long long) :
+                        size == 1 ? va_arg(ap, long) : va_arg(ap, int);
+            if (size == -1)
+                v = (short)v;
+            else if (size <= -2)
+                v = (signed char)v;
+            emit_int(o, &sp, v < 0 ? -(uint64_t)v : v, v < 0, 10, false);
+            break;
+        }
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X': {
+            uint64_t v = size >= 2 ? va_arg(ap, unsigned long long) :
+                         size == 1 ? va_arg(ap, unsigned long) : va_arg(ap, unsigned);
+            if (size == -1)
+                v = (unsigned short)v;
+            else if (size <= -2)
+                v = (unsigned char)v;
+            sp.flags &= ~(PLUS | SPACE);
+            emit_int(o, &sp, v, false, conv == 'u' ? 10 : conv == 'o' ? 8 : 16, conv == 'X');
+            break;
+        }
+        case 'p':
+            sp.flags = (sp.flags & LEFT) | ALT;
+            emit_int(o, &sp, (uintptr_t)va_arg(ap, void *), false, 16, false);
+            break;
+        case 'c': {
+            char c = va_arg(ap, int);
+            sp.flags &= ~ZERO;
+            emit(o, &sp, "", 0, 0, &c, 1);
+            break;
+        }
+        case 's': {
+            const char *s = va_arg(ap, const char *);
+            int len = 0;
+            if (!s)
+                s = "(null)";
+            while (s[len] && (sp.precision < 0 || len < sp.precision))
+                len++;
+            sp.flags &= ~ZERO;
+            emit(o, &sp, "", 0, 0, s, len);
+            break;
+        }
+        case 'n':
+            *va_arg(ap, int *) = o->count;
+            break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+#if FMT_FLOAT
+            emit_float(o, &sp, va_arg(ap, double), conv);
+#else
+            (void)va_arg(ap, double);
+            sp.flags &= ~ZERO;
+            emit(o, &sp, "", 0, 0, "?", 1);
+#endif
+            break;
+        case '%':
+            put(o, "%", 1);
+            break;
+        default:
+            /* Not a conversion, print it as it was */
+            if (!conv)
+                f--;
+            put(o, start, f - start);
+            break;
+        }
+    }
+    return o->count;
+}
+
+int fmt_vprintf(fmt_sink_t sink, void *arg, const char *format_str, va_list ap)
+{
+    out_t o;
+
+    o.sink = sink;
+    o.arg = arg;
+    o.used = 0;
+    o.count = 0;
+    format(&o, format_str, ap);
+    flush(&o);
+    return o.count;
+}
+
+int fmt_printf(fmt_sink_t sink, void *arg, const char *format_str, ...)
+{
+    va_list ap;
+    va_start(ap, format_str);
+    int n = fmt_vprintf(sink, arg, format_str, ap);
+    va_end(ap);
+    return n;
+}
+
+int fmt_vsnprintf(char *buf, size_t size, const char *format_str, va_list ap)
+{
+    out_t o;
+
+    o.sink = NULL;
+    o.buf = buf;
+    o.room = size ? size - 1 : 0;
+    o.count = 0;
+    format(&o, format_str, ap);
+    if (size)
+        *o.buf = 0;
+    return o.count;
+}
+
+int fmt_snprintf(char *buf, size_t size, const char *format_str, ...)
+{
+    va_list ap;
+    va_start(ap, format_str);
+    int n = fmt_vsnprintf(buf, size, format_str, ap);
+    va_end(ap);
+    return n;
+}
+
+void fmt_uart_sink(void *arg, const char *data, size_t len)
+{
+    int uart_num = (intptr_t)arg;
+    size_t start = 0;
+
+    /* Same line ending treatment as _write_r */
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] != '\r' && data[i] != '\n')
+            continue;
+        uart_write(uart_num, data + start, i - start);
+        if (data[i] == '\n')
+            uart_write(uart_num, "\r\n", 2);
+        start = i + 1;
+    }
+    uart_write(uart_num, data + start, len - start);
+}
+
+#if FMT_PRINTF
+
+int vprintf(const char *format_str, va_list ap)
+{
+    return fmt_vprintf(fmt_uart_sink, (void *)0, format_str, ap);
+}
+
+int printf(const char *format_str, ...)
+{
+    va_list ap;
+    va_start(ap, format_str);
+    int n = fmt_vprintf(fmt_uart_sink, (void *)0, format_str, ap);
+    va_end(ap);
+    return n;
+}
+
+int puts(const char *s)
+{
+    size_t len = strlen(s);
+    fmt_uart_sink((void *)0, s, len);
+    fmt_uart_sink((void *)0, "\n", 1);
+    return len + 1;
+}
+
+#undef putchar
+int putchar(int c)
+{
+    char ch = c;
+    fmt_uart_sink((void *)0, &ch, 1);
+    return (unsigned char)c;
+}
+
+int vsnprintf(char *buf, size_t size, const char *format_str, va_list ap)
+{
+    return fmt_vsnprintf(buf, size, format_str, ap);
+}
+
+int snprintf(char *buf, size_t size, const char *format_str, ...)
+{
+    va_list ap;
+    va_start(ap, format_str);
+    int n = fmt_vsnprintf(buf, size, format_str, ap);
+    va_end(ap);
+    return n;
+}
+
+int vsprintf(char *buf, const char *format_str, va_list ap)
+{
+    return fmt_vsnprintf(buf, SIZE_MAX, format_str, ap);
+}
+
+int sprintf(char *buf, const char *format_str, ...)
+{
+    va_list ap;
+    va_start(ap, format_str);
+    int n = fmt_vsnprintf(buf, SIZE_MAX, format_str, ap);
+    va_end(ap);
+    return n;
+}
+
+#endif /* FMT_PRINTF */
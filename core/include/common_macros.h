@@ -45,7 +45,12 @@
    variables need them.
 
    Important to note: IROM flash can only be accessed via 32-bit word
-   aligned reads. It's up to the user of this attribute to ensure this.
+   aligned reads in hardware. 8 and 16-bit loads (l8ui, l16ui, l16si)
+   raise a LoadStoreError exception, which the handler in
+   core/exception_vectors.S completes transparently, so byte access to
+   strings and tables works but costs an exception per load (see
+   examples/experiments/unaligned_load for the cycle counts.) Use word
+   reads, or the esp/flashmap.h accessors, in hot loops.
 */
 #ifdef	__cplusplus
     #define IROM __attribute__((section(".irom0.literal")))
@@ -70,8 +75,8 @@
 
    This may be useful to free up data RAM. However all data read from
    the instruction space must be 32-bit aligned word reads
-   (non-aligned reads will use an interrupt routine to "fix" them and
-   still work, but are very slow..
+   (8 and 16-bit reads will use an exception handler to "fix" them and
+   still work, but are very slow.)
 */
 #ifdef	__cplusplus
     #define IRAM_DATA __attribute__((section(".iram1.rodata")))
@@ -0,0 +1,46 @@
+/* Table driven CRC8, CRC16 and CRC32
+ *
+ * One implementation of the CRCs drivers keep needing, so they don't
+ * each carry their own bit loop:
+ *
+ * - crc8_maxim():  Dallas/Maxim 1-Wire CRC8 (ROM codes, scratchpads)
+ * - crc16_ibm():   CRC16/ARC, as used by 1-Wire and Modbus
+ * - crc32_ieee():  IEEE 802.3 CRC32, as zlib's crc32()
+ *
+ * All three take the CRC so far as the first argument (0 to start),
+ * so data can be checksummed in pieces.
+ *
+ * CRC_KERNEL selects the implementation, for all three: 0 for a bit
+ * loop (no tables), 1 for one 256 entry table (the default), or 4 for
+ * slice-by-4, which takes four tables and processes a word per step.
+ * The tables are in IROM flash (1 KB, 512 bytes and 256 bytes each),
+ * packed into words and only read with word loads. See
+ * examples/tests/crc_bench for the speed of each.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _CRC_H
+#define _CRC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifndef CRC_KERNEL
+#define CRC_KERNEL 1
+#endif
+
+uint8_t crc8_maxim(uint8_t crc, const void *data, size_t len);
+uint16_t crc16_ibm(uint16_t crc, const void *data, size_t len);
+uint32_t crc32_ieee(uint32_t crc, const void *data, size_t len);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _CRC_H */
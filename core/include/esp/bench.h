@@ -0,0 +1,163 @@
+/** esp/bench.h
+ *
+ * On-device micro-benchmarks, timed in CPU cycles.
+ *
+ * A benchmark is a function called for a number of samples, each
+ * sample timing 'iterations' back to back calls with CCOUNT. A few
+ * untimed warmup calls come first, so the code and data are in the
+ * flash cache (unless BENCH_FLUSH_CACHE asks for them not to be). The
+ * cost of the harness itself, measured the same way with an empty
+ * function, is subtracted, and the minimum, median and maximum cycles
+ * per call are reported.
+ *
+ * Benchmarks register themselves from anywhere in the program, so
+ * driver and library benchmarks can live next to the code they measure
+ * and a test program just calls bench_run():
+ *
+ *     BENCH(memcpy_64, 0, 10)
+ *     {
+ *         memcpy(dst, src, 64);
+ *     }
+ *
+ * BENCH_IRAM() places the benchmark function in IRAM, and BENCH_PLACED()
+ * builds the same body twice, registered as "<name>.iram" and
+ * "<name>.irom", to compare running it from IRAM and from the flash
+ * cache. Either way the code the body calls stays wherever it is linked.
+ *
+ * Programs measuring many variants of one function (different inputs,
+ * buffers in different memories) can fill in a bench_t of their own and
+ * call bench_measure() and bench_print() directly, see
+ * examples/experiments/unaligned_load.
+ *
+ * Results are printed as one line each, CSV by default:
+ *
+ *     BENCH,<name>,<samples>,<iterations>,<min>,<median>,<max>
+ *
+ * or with BENCH_JSON, a JSON object per line:
+ *
+ *     {"bench":"<name>","samples":15,"iterations":10,"min":..,"median":..,"max":..}
+ *
+ * Any other output is prefixed with '#' in CSV mode, so a script can
+ * keep only the result lines of a serial log.
+ *
+ * Unless BENCH_NO_IRQ is set, interrupts taken during a sample are
+ * counted in it; the minimum is then the figure to compare, and the
+ * maximum shows the jitter. The NMI (used by the WiFi stack) can't be
+ * masked.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _ESP_BENCH_H
+#define _ESP_BENCH_H
+
+#include <stdint.h>
+#include <common_macros.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/* Timed samples per benchmark, at most BENCH_MAX_SAMPLES */
+#ifndef BENCH_SAMPLES
+#define BENCH_SAMPLES 15
+#endif
+
+/* Untimed calls before the first sample */
+#ifndef BENCH_WARMUP
+#define BENCH_WARMUP 2
+#endif
+
+#define BENCH_MAX_SAMPLES 63
+
+/* bench_t flags */
+#define BENCH_NO_IRQ        0x01 /* mask interrupts while timing each sample */
+#define BENCH_FLUSH_CACHE   0x02 /* flush the flash cache before each call;
+                                    each sample is then a single call */
+
+typedef void (*bench_fn_t)(void *arg);
+
+typedef struct bench {
+    const char *name;
+    bench_fn_t fn;
+    void *arg;              /* passed to each call of fn */
+    uint16_t flags;
+    uint16_t iterations;    /* calls timed per sample, 0 for 1 */
+    struct bench *next;     /* registration list */
+} bench_t;
+
+typedef struct {
+    uint32_t min;           /* cycles per call, harness overhead removed */
+    uint32_t median;
+    uint32_t max;
+    uint16_t samples;
+    uint16_t iterations;
+} bench_result_t;
+
+typedef enum {
+    BENCH_CSV = 0,
+    BENCH_JSON,
+} bench_format_t;
+
+/* Add 'bench' to the list bench_run() runs. The BENCH() macros do this
+   from a constructor, before user_init(). */
+void bench_register(bench_t *bench);
+
+/* Head of the registration list */
+bench_t *bench_list(void);
+
+/* Drop everything in the flash cache, so the next code or data read
+   from flash misses. Must be called from IRAM code. */
+void bench_flush_cache(void);
+
+/* Run one benchmark for 'samples' samples (BENCH_SAMPLES if 0) */
+void bench_measure(const bench_t *bench, uint16_t samples, bench_result_t *result);
+
+/* Print a result line for 'name' */
+void bench_print(const char *name, const bench_result_t *result, bench_format_t format);
+
+/* Measure and print each registered benchmark whose name starts with
+   'prefix' (all of them if NULL). Returns the number run. */
+int bench_run(const char *prefix, bench_format_t format);
+
+#define _BENCH_REGISTER(id, label, fn, flags, iterations)                      \
+    static bench_t _bench_##id = { (label), (fn), NULL, (flags), (iterations) }; \
+    static void __attribute__((constructor)) _bench_register_##id(void)        \
+    {                                                                          \
+        bench_register(&_bench_##id);                                          \
+    }
+
+/* Define and register benchmark 'id', the function body follows. The
+   body is passed 'void *arg', NULL for these. */
+#define BENCH(id, flags, iterations)                                           \
+    static void id(void *arg);                                                 \
+    _BENCH_REGISTER(id, #id, id, flags, iterations)                            \
+    static void id(void *arg)
+
+/* As BENCH(), with the benchmark function in IRAM */
+#define BENCH_IRAM(id, flags, iterations)                                      \
+    static void IRAM id(void *arg);                                            \
+    _BENCH_REGISTER(id, #id, id, flags, iterations)                            \
+    static void IRAM id(void *arg)
+
+/* As BENCH(), registered twice to run the body from IRAM and from IROM */
+#define BENCH_PLACED(id, flags, iterations)                                    \
+    static inline __attribute__((always_inline)) void id(void *arg);           \
+    static void IRAM __attribute__((noinline)) id##_iram(void *arg)            \
+    {                                                                          \
+        id(arg);                                                               \
+    }                                                                          \
+    static void __attribute__((noinline)) id##_irom(void *arg)                 \
+    {                                                                          \
+        id(arg);                                                               \
+    }                                                                          \
+    _BENCH_REGISTER(id##_iram, #id ".iram", id##_iram, flags, iterations)      \
+    _BENCH_REGISTER(id##_irom, #id ".irom", id##_irom, flags, iterations)      \
+    static inline void id(void *arg)
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _ESP_BENCH_H */
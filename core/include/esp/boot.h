@@ -0,0 +1,87 @@
+/** esp/boot.h
+ *
+ * Boot time profiling, and deferred networking startup.
+ *
+ * The startup code records the CCOUNT cycle counter at each phase of
+ * booting (sdk_user_start, flash setup, PHY calibration, Wi-Fi init,
+ * TCP/IP init, user_init, Wi-Fi start), and boot_report() prints
+ * where the time went. Applications can add their own points (first
+ * sensor read, Wi-Fi connected, ...) with boot_mark().
+ *
+ * CCOUNT counts CPU cycles since reset. The times printed assume
+ * 80MHz, which the CPU is running at until user_init() changes it,
+ * so later times are only cycle counts if it does.
+ *
+ * Building with EXTRA_CFLAGS=-DBOOT_DEFER_NETWORKING=1 skips Wi-Fi
+ * initialisation and starting the saved Wi-Fi mode (scanning and
+ * association, with auto connect) at boot, so wake-ups that only read
+ * a sensor and go back to sleep don't pay for them. Call
+ * boot_start_networking() before the first sdk_wifi_* call (or before
+ * using the network at all) to do it then.
+ *
+ * PHY registration still runs at boot, as it also sets up the clocks.
+ * Its RF calibration can be skipped on the next deep sleep wake with
+ * sdk_system_deep_sleep_set_option(2), or the radio left off altogether
+ * with option 4.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _ESP_BOOT_H
+#define _ESP_BOOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifndef BOOT_DEFER_NETWORKING
+#define BOOT_DEFER_NETWORKING 0
+#endif
+
+/* Most boot marks kept, later marks are dropped */
+#define BOOT_MARKS_MAX 16
+
+typedef struct {
+    const char *name;
+    uint32_t ccount;
+} boot_mark_t;
+
+/* Record the cycle count at a named point. 'name' must be a string
+   constant (it isn't copied).
+
+   Callable from IRAM code running before the flash cache is enabled.
+*/
+void boot_mark(const char *name);
+
+/* Array of the recorded marks, in the order they were made. Returns
+   the number of marks. */
+int boot_marks_get(const boot_mark_t **marks);
+
+/* Print each mark with its time since reset and since the previous
+   mark. */
+void boot_report(void);
+
+/* Initialise Wi-Fi and start the saved Wi-Fi mode
+   (and connection, if auto connect is set), if that was deferred at
+   boot with BOOT_DEFER_NETWORKING. Does nothing if it's already been
+   done.
+
+   Call from a task. Takes as long as the boot time steps it replaces.
+   Called from user_init(), only Wi-Fi is initialised, and the mode is
+   started after user_init() returns like it is without deferring.
+*/
+void boot_start_networking(void);
+
+/* true once Wi-Fi has been initialised, at boot or by
+   boot_start_networking(). */
+bool boot_networking_started(void);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _ESP_BOOT_H */
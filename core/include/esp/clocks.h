@@ -13,6 +13,10 @@
 #ifndef _ESP_CLOCKS_H
 #define _ESP_CLOCKS_H
 
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp/dport_regs.h"
+
 /* CPU clock, can be overclocked to 160MHz via a dport register setting */
 #define CPU_CLK_FREQ 80*1000000
 
@@ -23,4 +27,39 @@
  */
 #define APB_CLK_FREQ CPU_CLK_FREQ
 
+/* Return the current CPU clock frequency in Hz, taking into account
+   whether the CPU clock has been doubled (sdk_system_update_cpu_freq). */
+static inline uint32_t cpu_clk_freq(void)
+{
+    return (DPORT.CPU_CLOCK & DPORT_CPU_CLOCK_X2) ? 2 * CPU_CLK_FREQ : CPU_CLK_FREQ;
+}
+
+/* Notification of CPU clock changes made by cpu_set_freq().
+
+   Drivers that keep timing constants in CPU cycles register one of
+   these (usually a static variable; it's linked into a list, not
+   copied) to recompute them. 'changed' is called with the new
+   frequency in Hz, after the switch, with the scheduler suspended,
+   so it mustn't block.
+*/
+typedef struct cpu_freq_notifier {
+    void (*changed)(uint32_t freq_hz, void *arg);
+    void *arg;
+    struct cpu_freq_notifier *next;
+} cpu_freq_notifier_t;
+
+void cpu_freq_register(cpu_freq_notifier_t *notifier);
+void cpu_freq_unregister(cpu_freq_notifier_t *notifier);
+
+/* Switch the CPU clock to 80 or 160 MHz at runtime.
+
+   Updates sdk_os_delay_us() (like sdk_system_update_cpu_freq), the
+   FreeRTOS tick when the port drives it (configUSE_TICKLESS_IDLE), and
+   then calls the registered notifiers. Peripheral clocks (APB_CLK_FREQ,
+   the UARTs and timers) don't change.
+
+   Returns false if 'mhz' isn't 80 or 160.
+*/
+bool cpu_set_freq(uint32_t mhz);
+
 #endif
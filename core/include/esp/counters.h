@@ -0,0 +1,154 @@
+/** esp/counters.h
+ *
+ * One registry for every performance counter on the device, so a fleet
+ * can be scraped the same way whatever each module counts.
+ *
+ * Counters are defined statically, and register themselves before
+ * user_init() (from a constructor), so they're listed from boot even if
+ * they're never touched:
+ *
+ *     COUNTER_DEFINE(rx_frames, "uart.rx_frames");
+ *     HISTOGRAM_DEFINE(rx_latency, "uart.rx_latency_us");
+ *     ...
+ *     COUNTER_INC(rx_frames);                    // a load, add and store
+ *     HISTOGRAM_RECORD(rx_latency, us);          // log2 buckets
+ *
+ * Values other modules already keep (lwIP's stats, the free heap...)
+ * are exported with COUNTER_DEFINE_FN, which reads them when the
+ * counters are dumped, at no cost in between.
+ *
+ * Components are linked from archives, so counters defined in a
+ * component's file are in the registry when something else in that
+ * file is used: a module's counters come with the module.
+ *
+ * Updates aren't atomic: a counter updated from both tasks and an
+ * interrupt can lose a count, unless the task side uses COUNTER_ADD_SAFE.
+ *
+ * counters_format() writes "name value" lines, with the change since an
+ * earlier counters_snapshot() if given one (histograms are then counted
+ * from the snapshot). counters_dump() prints them, and
+ * netcounters_udp_start() (lwip/include/netcounters.h) answers them
+ * over UDP.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _ESP_COUNTERS_H
+#define _ESP_COUNTERS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/* Most values a counters_snapshot_t holds: a value per counter, and
+   COUNTER_HISTOGRAM_BUCKETS + 1 per histogram */
+#ifndef COUNTERS_MAX_VALUES
+#define COUNTERS_MAX_VALUES 128
+#endif
+
+/* Bucket 0 counts zeroes, bucket i values from 2^(i-1) to 2^i - 1, and
+   the last everything from 2^(BUCKETS-2) up */
+#define COUNTER_HISTOGRAM_BUCKETS 16
+
+typedef enum {
+    COUNTER_TYPE_COUNTER,       /* only goes up, diffs meaningful */
+    COUNTER_TYPE_GAUGE,         /* a level, set as it changes */
+    COUNTER_TYPE_HISTOGRAM,
+} counter_type_t;
+
+typedef struct counter {
+    const char *name;
+    uint8_t type;               /* counter_type_t */
+    volatile uint32_t value;    /* histograms: the sum of the values */
+    uint32_t (*read)(void);     /* COUNTER_DEFINE_FN: read at dump time */
+    volatile uint32_t *buckets; /* histograms */
+    struct counter *next;
+} counter_t;
+
+/* Add a counter to the registry. The _DEFINE macros call this. */
+void counter_register(counter_t *counter);
+
+#define _COUNTER_DEFINE(ident, label, type_, read_, buckets_)                 \
+    counter_t ident = { .name = (label), .type = (type_), .read = (read_),    \
+                        .buckets = (buckets_) };                              \
+    static void __attribute__((constructor)) _counter_register_##ident(void) \
+    {                                                                         \
+        counter_register(&ident);                                             \
+    }
+
+/* Define a counter (or gauge) 'ident', listed as "label" */
+#define COUNTER_DEFINE(ident, label) \
+    _COUNTER_DEFINE(ident, label, COUNTER_TYPE_COUNTER, NULL, NULL)
+#define GAUGE_DEFINE(ident, label) \
+    _COUNTER_DEFINE(ident, label, COUNTER_TYPE_GAUGE, NULL, NULL)
+
+/* A value read by fn() when the counters are dumped or snapshotted.
+   'type' is COUNTER_TYPE_COUNTER or COUNTER_TYPE_GAUGE. */
+#define COUNTER_DEFINE_FN(ident, label, type, fn) \
+    _COUNTER_DEFINE(ident, label, type, fn, NULL)
+
+#define HISTOGRAM_DEFINE(ident, label)                                      \
+    static volatile uint32_t _counter_buckets_##ident[COUNTER_HISTOGRAM_BUCKETS]; \
+    _COUNTER_DEFINE(ident, label, COUNTER_TYPE_HISTOGRAM, NULL, _counter_buckets_##ident)
+
+/* For counters defined in another file */
+#define COUNTER_DECLARE(ident) extern counter_t ident
+
+#define COUNTER_INC(ident) ((ident).value++)
+#define COUNTER_ADD(ident, n) ((ident).value += (n))
+#define COUNTER_SET(ident, v) ((ident).value = (v))
+
+/* COUNTER_ADD with interrupts off, for a counter an ISR updates too */
+#define COUNTER_ADD_SAFE(ident, n) counter_add_safe(&(ident), (n))
+void counter_add_safe(counter_t *counter, uint32_t n);
+
+static inline uint32_t _counter_bucket(uint32_t v)
+{
+    uint32_t b = v ? 32 - __builtin_clz(v) : 0;
+    return b < COUNTER_HISTOGRAM_BUCKETS ? b : COUNTER_HISTOGRAM_BUCKETS - 1;
+}
+
+#define HISTOGRAM_RECORD(ident, v) do {               \
+        uint32_t _v = (v);                            \
+        (ident).buckets[_counter_bucket(_v)]++;       \
+        (ident).value += _v;                          \
+    } while (0)
+
+/* Head of the registry, in registration order */
+counter_t *counters_list(void);
+
+/* Look a counter up by name, NULL if there's none */
+counter_t *counter_find(const char *name);
+
+typedef struct {
+    uint16_t n;
+    uint32_t values[COUNTERS_MAX_VALUES];
+} counters_snapshot_t;
+
+/* Take the current values of every counter (as many as fit) */
+void counters_snapshot(counters_snapshot_t *snap);
+
+/* Zero every counter and histogram (gauges and COUNTER_DEFINE_FN
+   values are left alone) */
+void counters_reset(void);
+
+/* Write every counter as a "name value" line; a histogram's line has
+   the count of values, their sum, then the buckets. After 'since', also
+   the change of counters since that snapshot. Returns the length
+   written (excluding the terminator), truncated to fit len like
+   snprintf. */
+int counters_format(char *buf, size_t len, const counters_snapshot_t *since);
+
+/* Print the counters to stdout */
+void counters_dump(const counters_snapshot_t *since);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _ESP_COUNTERS_H */
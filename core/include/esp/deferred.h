@@ -0,0 +1,63 @@
+/** esp/deferred.h
+ *
+ * Deferred interrupt work ("bottom halves").
+ *
+ * Interrupt handlers post a function and argument with
+ * deferred_call_from_isr(), and a single worker task runs them in the
+ * order they were posted. Drivers that only need to hand work from an
+ * ISR to task context can share this one task (and its stack) instead
+ * of each creating their own task and semaphore.
+ *
+ * The worker is only woken by the first post after it goes idle, so a
+ * burst of interrupts costs one wakeup and one context switch.
+ *
+ * Deferred functions run in task context and may block, but they hold
+ * up every other deferred function while they do.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _ESP_DEFERRED_H
+#define _ESP_DEFERRED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/* Stack size of the worker task, in words */
+#ifndef DEFERRED_TASK_STACK_SIZE
+#define DEFERRED_TASK_STACK_SIZE 256
+#endif
+
+typedef void (*deferred_fn_t)(void *arg);
+
+/* Start the worker task at 'priority', with room for 'queue_len'
+   pending calls (rounded up to a power of two).
+
+   Must be called before anything is posted. Returns false if out of
+   memory or already started.
+*/
+bool deferred_init(uint32_t priority, size_t queue_len);
+
+/* Queue fn(arg) to run in the worker task. Call from interrupt context.
+
+   Returns false (and counts a drop) if the queue is full.
+*/
+bool deferred_call_from_isr(deferred_fn_t fn, void *arg);
+
+/* Queue fn(arg) to run in the worker task, from task context. */
+bool deferred_call(deferred_fn_t fn, void *arg);
+
+/* Number of calls dropped because the queue was full */
+uint32_t deferred_dropped(void);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _ESP_DEFERRED_H */
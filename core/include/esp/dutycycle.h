@@ -0,0 +1,105 @@
+/** esp/dutycycle.h
+ *
+ * Deep sleep duty cycle scheduler for battery powered nodes.
+ *
+ * Instead of "wake, read the sensors, connect, send, sleep" written out
+ * by hand in each application, the application lists its jobs, each
+ * with a period and whether it needs Wi-Fi, and calls dutycycle_run()
+ * from a task on every wake. It runs the jobs that are due, connects
+ * (through the application's wifi_connect callback) only if one of
+ * them needs the network, and then deep sleeps until the next job is
+ * due. When none of the jobs due at that next wake need Wi-Fi, the wake
+ * is made with the radio off, which is most of the current saved.
+ *
+ *   static const dutycycle_job_t jobs[] = {
+ *       { "sample", 60, false, read_sensor, NULL },
+ *       { "upload", 900, true, upload, NULL },
+ *   };
+ *   dutycycle_config_t config = DUTYCYCLE_DEFAULT_CONFIG;
+ *   config.wifi_connect = connect;
+ *   dutycycle_run(&config, jobs, 2);    // doesn't return
+ *
+ * A clock (seconds since the first power up), the job table's next due
+ * times and some counters are kept across sleeps in DUTYCYCLE_RTC_WORDS
+ * words of RTCMEM_USER, at 'rtc_offset'. They're checked with a CRC, and
+ * start again (every job due straight away) after power loss or when
+ * the number of jobs changes. The clock is only as good as the sleep
+ * timer, a few percent.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _ESP_DUTYCYCLE_H
+#define _ESP_DUTYCYCLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifndef DUTYCYCLE_MAX_JOBS
+#define DUTYCYCLE_MAX_JOBS 8
+#endif
+
+/* Words of RTCMEM_USER the scheduler's state takes */
+#define DUTYCYCLE_RTC_WORDS (8 + 2 * DUTYCYCLE_MAX_JOBS)
+
+/* A job. Return true when it's done its work, false to have it retried
+   after the config's retry_s. */
+typedef bool (*dutycycle_fn_t)(void *arg);
+
+typedef struct {
+    const char *name;
+    uint32_t period_s;
+    bool needs_wifi;
+    dutycycle_fn_t fn;
+    void *arg;
+} dutycycle_job_t;
+
+typedef struct {
+    /* Bring the station up, and return true once it has an address.
+       Called at most once per wake, before the first job that needs
+       Wi-Fi. If it fails, those jobs count as failed. */
+    bool (*wifi_connect)(void);
+    /* Called just before a sleep of 'sleep_ms', if wifi_connect was on
+       this wake (for fastconnect_save(), say) */
+    void (*wifi_done)(bool connected, uint32_t sleep_ms);
+    uint32_t retry_s;       /* a failed job is tried again after this */
+    uint32_t max_sleep_s;   /* longest single sleep */
+    size_t rtc_offset;      /* words into RTCMEM_USER */
+} dutycycle_config_t;
+
+/* Up to about 71 minutes, the longest sdk_system_deep_sleep() takes */
+#define DUTYCYCLE_DEFAULT_CONFIG { \
+        .retry_s = 60, .max_sleep_s = 3600, .rtc_offset = 0, \
+    }
+
+typedef struct {
+    uint32_t now_s;         /* seconds since the state was reset */
+    uint32_t wakes;
+    uint32_t radio_wakes;   /* wakes with the radio on */
+    uint32_t connects;      /* successful wifi_connect() calls */
+    uint32_t failures;      /* jobs (and connects) that failed */
+} dutycycle_stats_t;
+
+/* Run the jobs due on this wake, then deep sleep until the next one is
+   due. Call from a task, once per wake: it doesn't return. */
+void dutycycle_run(const dutycycle_config_t *config, const dutycycle_job_t *jobs, int n_jobs)
+    __attribute__((noreturn));
+
+/* The counters and clock, from a job (to report them, say) */
+void dutycycle_get_stats(dutycycle_stats_t *stats);
+
+/* Next due time of job 'index' in seconds on the dutycycle clock, for
+   a job to bring itself forward (0 is now) or push itself back */
+void dutycycle_set_next(int index, uint32_t due_s);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _ESP_DUTYCYCLE_H */
@@ -0,0 +1,84 @@
+/** esp/flashcache.h
+ *
+ * Small LRU cache in DRAM in front of sdk_spi_flash_read().
+ *
+ * Each sdk_spi_flash_read() call pays for a flash command and address
+ * phase, and disables the instruction cache while it runs, however few
+ * bytes it reads. Code that keeps re-reading small pieces of the same
+ * flash (configuration records, headers, directory entries) can read
+ * through flashcache_read() instead, which keeps recently used
+ * FLASHCACHE_LINE_SIZE byte lines of flash in RAM.
+ *
+ * Writes and erases done through flashcache_write() and
+ * flashcache_erase_sector() go straight to flash and invalidate any
+ * cached lines they touch. Flash changed any other way (directly with
+ * the sdk_spi_flash functions, or OTA updates) needs a
+ * flashcache_invalidate().
+ *
+ * Reads of more than FLASHCACHE_BYPASS_LEN bytes skip the cache, as
+ * they'd only evict the small lines it's for.
+ *
+ * Without flashcache_init() (or with 0 lines) everything passes straight
+ * through to flash.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _ESP_FLASHCACHE_H
+#define _ESP_FLASHCACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "espressif/spi_flash.h"
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#define FLASHCACHE_LINE_SIZE 256
+
+#ifndef FLASHCACHE_BYPASS_LEN
+#define FLASHCACHE_BYPASS_LEN (2 * FLASHCACHE_LINE_SIZE)
+#endif
+
+typedef struct {
+    uint32_t hits;          /* lines found in the cache */
+    uint32_t misses;        /* lines read from flash */
+    uint32_t bypassed;      /* reads too large to cache */
+    uint32_t invalidated;   /* lines dropped by writes and erases */
+    uint32_t hit_cycles;    /* CPU cycles spent in reads served entirely from RAM */
+    uint32_t miss_cycles;   /* ...and in reads that went to flash */
+    uint32_t hit_reads;     /* number of reads in each of those */
+    uint32_t miss_reads;
+} flashcache_stats_t;
+
+/* Allocate a cache of 'lines' lines (FLASHCACHE_LINE_SIZE bytes each).
+   Returns false if out of memory or already initialised. */
+bool flashcache_init(size_t lines);
+
+/* Read any number of bytes from any flash address into any buffer */
+sdk_SpiFlashOpResult flashcache_read(uint32_t addr, void *buf, uint32_t len);
+
+/* Write through to flash, with the sdk_spi_flash_write() alignment
+   rules, and invalidate the cached lines written to */
+sdk_SpiFlashOpResult flashcache_write(uint32_t addr, const void *buf, uint32_t len);
+
+/* Erase a sector and invalidate its cached lines */
+sdk_SpiFlashOpResult flashcache_erase_sector(uint16_t sector);
+
+/* Drop all cached lines */
+void flashcache_invalidate(void);
+
+void flashcache_stats_get(flashcache_stats_t *stats);
+void flashcache_stats_reset(void);
+
+/* Print the stats, with hit rate and average latencies, to stdout */
+void flashcache_stats_dump(void);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _ESP_FLASHCACHE_H */
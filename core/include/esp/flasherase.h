@@ -0,0 +1,93 @@
+/** esp/flasherase.h
+ *
+ * Flash erases that don't stall the rest of the system.
+ *
+ * sdk_spi_flash_erase_sector() keeps the flash cache and interrupts off
+ * for the whole erase, typically 45ms a sector, and several hundred ms
+ * at worst. Erasing a range in one go (an OTA slot, a log area) is that
+ * times the number of sectors.
+ *
+ * The service erases a range one sector at a time, yielding between
+ * sectors, so a higher priority task waits for at most one sector and
+ * not for the whole range. Erases can be queued to a low priority
+ * worker task (flasherase_start()), which then only runs when nothing
+ * else needs the CPU, and held off altogether while a latency critical
+ * phase runs (flasherase_hold()/flasherase_release()).
+ *
+ * Built with FLASHERASE_SUSPEND=1, each sector's erase is also split
+ * into slices of FLASHERASE_SLICE_US on chips that support erase
+ * suspend (Winbond and GigaDevice, the usual on ESP8266 modules). The
+ * erase runs for a slice from an IRAM state machine, and is then
+ * suspended so the cache can be turned back on. That bounds the time
+ * with interrupts and flash off to about a slice. Other chips erase
+ * whole sectors as above. While an erase is suspended the chip ignores
+ * other erases, so with this option every erase on the device (the
+ * SDK's saves of its Wi-Fi settings included) must not overlap
+ * flasherase's. Hence it's off by default.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _ESP_FLASHERASE_H
+#define _ESP_FLASHERASE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifndef FLASHERASE_SUSPEND
+#define FLASHERASE_SUSPEND 0
+#endif
+
+/* Longest time to let one erase run before suspending it */
+#ifndef FLASHERASE_SLICE_US
+#define FLASHERASE_SLICE_US 2000
+#endif
+
+/* Erases queued for the worker task */
+#ifndef FLASHERASE_QUEUE_LEN
+#define FLASHERASE_QUEUE_LEN 4
+#endif
+
+/* Called in the worker task when a queued erase is done */
+typedef void (*flasherase_cb_t)(uint32_t addr, uint32_t len, bool ok, void *arg);
+
+/* Erase the sectors covering 'len' bytes from 'addr' (a sector
+   boundary) in the calling task, yielding between sectors (and slices).
+   Returns false if a sector couldn't be erased. */
+bool flasherase_erase(uint32_t addr, uint32_t len);
+
+/* Start the worker task at 'priority' (1, just above idle, is usual).
+   Returns false if out of memory or already started. */
+bool flasherase_start(uint32_t priority);
+
+/* Queue an erase for the worker, with 'cb' (may be NULL) called when
+   it's done. Returns false if the queue is full or there's no worker. */
+bool flasherase_queue(uint32_t addr, uint32_t len, flasherase_cb_t cb, void *arg);
+
+/* Keep erases from starting (on any sector) until the matching
+   flasherase_release(). Nests. A slice of an erase already under way
+   is finished first (flasherase_hold() waits for it): that's the whole
+   sector, unless it's being erased in suspendable slices, in which case
+   it stays suspended until the release. */
+void flasherase_hold(void);
+void flasherase_release(void);
+
+typedef struct {
+    uint32_t sectors;       /* erased */
+    uint32_t failures;
+    uint32_t suspends;      /* erases suspended to turn the cache back on */
+    uint32_t max_off_us;    /* longest time with the cache off */
+} flasherase_stats_t;
+
+void flasherase_get_stats(flasherase_stats_t *stats);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _ESP_FLASHERASE_H */
@@ -0,0 +1,123 @@
+/** esp/flashmap.h
+ *
+ * Reading flash through the memory mapped cache window.
+ *
+ * The flash cache maps one megabyte of flash at FLASHMAP_BASE, which is
+ * how code and IROM constants are run from and read out of flash. Any
+ * other data in that megabyte (fonts, web assets, lookup tables stored
+ * after the firmware) can be read the same way, with no DRAM buffer and
+ * no sdk_spi_flash_read() call.
+ *
+ * The mapped megabyte is the first one, or with rboot OTA the megabyte
+ * holding the running ROM.
+ *
+ * The window (like all instruction memory) only supports 32-bit word
+ * aligned loads. Byte or halfword loads, or unaligned word loads, raise
+ * a LoadStoreError exception. Either read aligned words through the
+ * pointer directly, or use the accessors below, which also work for
+ * IROM and IRAM_DATA constants (and ordinary DRAM.)
+ *
+ * The cache isn't kept coherent with sdk_spi_flash_erase_sector/write,
+ * so don't hold mapped pointers to a region while rewriting it.
+ *
+ * Data in other megabytes (the rest of a 4MB module) can be read at
+ * cache speed by mapping their bank into the window for a moment. The
+ * window then no longer holds the firmware, so this is done with
+ * interrupts off, and only code in IRAM, using data in DRAM, can run
+ * until it's mapped back: flashmap_bank_call() runs such a function,
+ * and flashmap_bank_read() copies from any flash address that way, a
+ * FLASHMAP_BANK_CHUNK at a time.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _ESP_FLASHMAP_H
+#define _ESP_FLASHMAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#define FLASHMAP_BASE 0x40200000
+#define FLASHMAP_SIZE 0x100000
+
+/* Return a pointer to 'len' bytes of flash at 'flash_addr', read
+   through the cache window.
+
+   Returns NULL if flash_addr isn't word aligned, or the region isn't
+   entirely inside the mapped megabyte.
+*/
+const uint32_t *flashmap_ptr(uint32_t flash_addr, size_t len);
+
+/* Return the flash address that a pointer into the cache window maps,
+   or UINT32_MAX if 'ptr' isn't in the window. */
+uint32_t flashmap_flash_addr(const void *ptr);
+
+/* Read a byte, halfword or word at any alignment, from the cache
+   window (or any other memory) using aligned word loads. */
+static inline uint8_t flashmap_read8(const void *ptr)
+{
+    uintptr_t addr = (uintptr_t)ptr;
+    uint32_t word = *(const volatile uint32_t *)(addr & ~3);
+    return word >> ((addr & 3) * 8);
+}
+
+static inline uint32_t flashmap_read32(const void *ptr)
+{
+    uintptr_t addr = (uintptr_t)ptr;
+    const volatile uint32_t *p = (const volatile uint32_t *)(addr & ~3);
+    uint32_t shift = (addr & 3) * 8;
+    if (!shift)
+        return p[0];
+    return (p[0] >> shift) | (p[1] << (32 - shift));
+}
+
+static inline uint16_t flashmap_read16(const void *ptr)
+{
+    uintptr_t addr = (uintptr_t)ptr;
+    if ((addr & 3) == 3)
+        return flashmap_read32(ptr);
+    uint32_t word = *(const volatile uint32_t *)(addr & ~3);
+    return word >> ((addr & 3) * 8);
+}
+
+/* memcpy() from the cache window (or any other memory) into DRAM,
+   using aligned word loads. 'dest' can have any alignment. */
+void flashmap_memcpy(void *dest, const void *src, size_t len);
+
+/* Most bytes flashmap_bank_read() copies with interrupts off */
+#ifndef FLASHMAP_BANK_CHUNK
+#define FLASHMAP_BANK_CHUNK 1024
+#endif
+
+/* The megabyte of flash normally mapped into the window */
+uint32_t flashmap_bank_current(void);
+
+/* Called with 'window' (FLASHMAP_BASE) mapping another megabyte. It
+   must be an IRAM function and touch nothing in flash: no IROM code or
+   constants, no printf, no SDK or FreeRTOS calls. */
+typedef void (*flashmap_bank_fn_t)(const uint32_t *window, void *arg);
+
+/* Map megabyte 'bank' of flash into the window, call fn(), and map the
+   usual megabyte back, all with interrupts off, so keep fn() short.
+   Flash offset 'x' in the bank is at window[x / 4]. Returns false if
+   the bank is past the end of the flash chip. */
+bool flashmap_bank_call(uint32_t bank, flashmap_bank_fn_t fn, void *arg);
+
+/* Copy 'len' bytes of flash from any 'flash_addr' (in any bank, at any
+   alignment) into DRAM at 'dest'. Reads from the mapped megabyte are
+   plain copies through the window; from other banks they're bank
+   switched for each FLASHMAP_BANK_CHUNK. Returns false if the range is
+   past the end of the chip. */
+bool flashmap_bank_read(uint32_t flash_addr, void *dest, size_t len);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _ESP_FLASHMAP_H */
@@ -0,0 +1,66 @@
+/** esp/flashmode.h
+ *
+ * SPI flash read mode (QIO/QOUT/DIO/DOUT) and clock selection.
+ *
+ * The ROM bootloader sets the SPI0 read mode from the header of the
+ * image it boots (the bootloader's own header, when using rboot), and
+ * sdk_user_start() sets the clock from the header at flash address 0.
+ * The mode and clock can also be chosen at build time: build with
+ * FLASH_BOOT_CONFIG=1 and the FLASH_MODE/FLASH_SPEED make variables are
+ * applied at startup, overriding the header.
+ *
+ * Not every board can run every mode. QIO and QOUT need the flash chip's
+ * quad enable bit set, and the WP/HOLD pins free (not used as GPIO9/10);
+ * 80MHz needs a fast enough chip and clean wiring. So a new setting is
+ * checked by reading back the start of flash and comparing it with what
+ * the previous (known good) setting read. If they differ, the previous
+ * setting is restored.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _ESP_FLASHMODE_H
+#define _ESP_FLASHMODE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/* Same values as the flash mode byte of the image header */
+typedef enum {
+    FLASHMODE_QIO = 0,
+    FLASHMODE_QOUT = 1,
+    FLASHMODE_DIO = 2,
+    FLASHMODE_DOUT = 3,
+} flashmode_t;
+
+/* Switch the flash read mode and clock (80, 40, 26 or 20 MHz).
+
+   Must be called with the flash cache disabled, and so from IRAM code.
+   Returns false, with the previous setting restored, if the flash
+   couldn't be read correctly with the new setting or 'mhz' isn't one
+   of the supported clocks.
+*/
+bool flashmode_configure(flashmode_t mode, uint32_t mhz);
+
+/* As flashmode_configure(), but can be called from anywhere. The cache
+   is disabled around the switch, interrupts are disabled meanwhile.
+*/
+bool flashmode_set(flashmode_t mode, uint32_t mhz);
+
+/* Current SPI0 read mode and clock, as read back from the registers. */
+flashmode_t flashmode_get_mode(void);
+uint32_t flashmode_get_speed(void);
+
+/* Short name of a mode ("qio", "dio", ...) */
+const char *flashmode_name(flashmode_t mode);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _ESP_FLASHMODE_H */
@@ -86,6 +86,37 @@ static inline void gpio_write(const uint8_t gpio_num, const bool set)
         GPIO.OUT_CLEAR = BIT(gpio_num);
 }
 
+/* Set the outputs of all pins in a bitmask (BIT(gpio_num) for each pin)
+ * high, in a single register write.
+ *
+ * Like gpio_write(), only works on pins set to GPIO_OUTPUT or
+ * GPIO_OUT_OPEN_DRAIN. Only covers GPIO0-15, GPIO16 is not part of the
+ * GPIO register block.
+ */
+static inline void gpio_set_mask(const uint32_t mask)
+{
+    GPIO.OUT_SET = mask;
+}
+
+/* Set the outputs of all pins in a bitmask low, in a single register write.
+ */
+static inline void gpio_clear_mask(const uint32_t mask)
+{
+    GPIO.OUT_CLEAR = mask;
+}
+
+/* Set the outputs of all pins in 'mask' to the corresponding bits of
+ * 'value'. Pins outside the mask are unaffected.
+ *
+ * The high bits are set first, then the low bits are cleared, so the
+ * pins don't all change on exactly the same cycle.
+ */
+static inline void gpio_write_mask(const uint32_t mask, const uint32_t value)
+{
+    GPIO.OUT_SET = mask & value;
+    GPIO.OUT_CLEAR = mask & ~value;
+}
+
 /* Toggle output of a pin
  *
  * Only works if pin has been set to GPIO_OUTPUT or GPIO_OUT_OPEN_DRAIN via
@@ -121,6 +152,15 @@ static inline bool gpio_read(const uint8_t gpio_num)
     return GPIO.IN & BIT(gpio_num);
 }
 
+/* Read the input values of all pins in a bitmask at once.
+ *
+ * Returns the levels as a bitmask, see gpio_read() for how each pin reads.
+ */
+static inline uint32_t gpio_read_mask(const uint32_t mask)
+{
+    return GPIO.IN & mask;
+}
+
 extern void gpio_interrupt_handler(void);
 
 /* Set the interrupt type for a given pin
@@ -137,6 +177,22 @@ static inline void gpio_set_interrupt(const uint8_t gpio_num, const gpio_inttype
     }
 }
 
+/* Per-pin GPIO interrupt handler, called from the GPIO interrupt with the
+ * pin number and the 'arg' given to gpio_set_interrupt_handler(). Runs in
+ * interrupt context, so should be IRAM and must not block.
+ */
+typedef void (*gpio_interrupt_handler_t)(uint8_t gpio_num, void *arg);
+
+/* Set the interrupt type and a handler for a given pin
+ *
+ * As gpio_set_interrupt(), but 'handler' is called with 'arg' whenever the
+ * pin interrupt fires, instead of the pin's gpioNN_interrupt_handler() (see
+ * esp_gpio_interrupts.c). Each pin has its own handler, so independent
+ * drivers can register handlers on different pins at runtime. Pass a NULL
+ * handler to go back to gpioNN_interrupt_handler().
+ */
+void gpio_set_interrupt_handler(const uint8_t gpio_num, const gpio_inttype_t int_type, gpio_interrupt_handler_t handler, void *arg);
+
 /* Return the interrupt type set for a pin */
 static inline gpio_inttype_t gpio_get_interrupt(const uint8_t gpio_num)
 {
@@ -0,0 +1,157 @@
+/** esp/hrtimer.h
+ *
+ * Microsecond software timer service multiplexed on the FRC2 compare.
+ *
+ * Any number of one-shot or periodic timers (up to HRTIMER_MAX) share
+ * the single FRC2 ALARM register. Pending timers are kept in a binary
+ * min-heap ordered by expiry so start/stop are O(log n), and the
+ * FRC2 interrupt only ever looks at the head of the heap.
+ *
+ * Callbacks run in interrupt context from IRAM: they must be short,
+ * must not block and must themselves be IRAM (or only touch IRAM
+ * code.) A callback may restart or stop any timer, including its own.
+ *
+ * FRC2 is also used by the timers in the SDK's libmain (sdk_ets_timer_*),
+ * which stay functional: the service takes over the FRC2 vector and
+ * chains to the SDK handler whenever the SDK's own alarm is due. (The
+ * SDK only arms its timers in SoftAP mode. If it re-arms ALARM from a
+ * task while one of our timers is due sooner, that timer can fire late
+ * by up to the SDK's own deadline.)
+ *
+ * Work that can't run in an interrupt can use an hrtimer_daemon_t
+ * instead: it expires at the same microsecond resolution, then has its
+ * callback run in the FreeRTOS timer task with xTimerPendFunctionCall-
+ * FromISR(), as soon as that is the highest priority ready task rather
+ * than at the next tick. The latency is then bounded by the tasks with
+ * a priority above configTIMER_TASK_PRIORITY.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _ESP_HRTIMER_H
+#define _ESP_HRTIMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/* Maximum number of simultaneously pending timers */
+#ifndef HRTIMER_MAX
+#define HRTIMER_MAX 16
+#endif
+
+struct hrtimer;
+
+typedef void (*hrtimer_callback_t)(struct hrtimer *timer, void *arg);
+
+typedef struct hrtimer {
+    hrtimer_callback_t callback;
+    void *arg;
+    uint32_t expires;  /* FRC2 count at which the timer fires */
+    uint32_t period;   /* Reload period in FRC2 ticks, 0 for one-shot */
+    int16_t _index;    /* Position in the pending heap, -1 when idle */
+} hrtimer_t;
+
+/* Prepare a timer for use. Must be called once before the timer is
+   started, and can be called again whenever the timer is idle. */
+void hrtimer_init(hrtimer_t *timer, hrtimer_callback_t callback, void *arg);
+
+/* Start (or restart) a timer to fire 'timeout_us' from now, then every
+   'period_us' after that. Pass period_us=0 for a one-shot timer.
+
+   Periodic timers are re-armed relative to their previous expiry, so
+   they don't accumulate drift from interrupt latency.
+
+   Returns false if HRTIMER_MAX timers are already pending.
+
+   Safe to call from interrupt context.
+*/
+bool hrtimer_start(hrtimer_t *timer, uint32_t timeout_us, uint32_t period_us);
+
+/* Start a one-shot timer 'ticks' FRC2 ticks after it last expired,
+   rather than after now. Called from the timer's own callback, this
+   builds an irregular schedule (the bit edges of a software UART, say)
+   that neither drifts with interrupt latency nor rounds to whole
+   microseconds. If that time has already gone by, the timer fires as
+   soon as the callback returns.
+
+   Returns false if HRTIMER_MAX timers are already pending.
+
+   Safe to call from interrupt context.
+*/
+bool hrtimer_start_from_expiry(hrtimer_t *timer, uint32_t ticks);
+
+/* Stop a pending timer. Does nothing if the timer is idle.
+
+   Safe to call from interrupt context.
+*/
+void hrtimer_stop(hrtimer_t *timer);
+
+/* Return true if the timer is pending */
+static inline bool hrtimer_active(const hrtimer_t *timer)
+{
+    return timer->_index >= 0;
+}
+
+/* Return the current time in microseconds since the service started.
+   Wraps after 2^32 us (about 71 minutes.)
+*/
+uint32_t hrtimer_now_us(void);
+
+/* The same clock, extended to 64 bits so it never wraps in practice. */
+uint64_t hrtimer_now_us64(void);
+
+/* Block the calling task for 'us' microseconds, woken by a one-shot
+   timer rather than at a tick, so sub-tick sleeps are exact to within
+   interrupt latency. Uses the task's notification (see
+   ulTaskNotifyTake()), and busy waits if called before the scheduler
+   has started.
+*/
+void hrtimer_sleep_us(uint32_t us);
+
+/* Convert between microseconds and FRC2 ticks at the configured FRC2
+   clock divider.
+*/
+uint32_t hrtimer_us_to_ticks(uint32_t us);
+uint32_t hrtimer_ticks_to_us(uint32_t ticks);
+
+/* Callback of an hrtimer_daemon_t, run in the timer task. 'missed' is
+   the number of expiries since the previous call that didn't get a call
+   of their own, because the timer task hadn't caught up with the last
+   one yet (or the timer queue was full). */
+typedef void (*hrtimer_daemon_callback_t)(void *arg, uint32_t missed);
+
+typedef struct {
+    hrtimer_t timer;
+    hrtimer_daemon_callback_t callback;
+    void *arg;
+    volatile bool _queued;      /* A call is in the timer queue */
+    volatile uint32_t _missed;
+} hrtimer_daemon_t;
+
+/* Prepare a timer whose callback runs in the FreeRTOS timer task.
+   Needs INCLUDE_xTimerPendFunctionCall (on by default). The callback
+   may block, but holds up every FreeRTOS software timer while it does. */
+void hrtimer_daemon_init(hrtimer_daemon_t *timer, hrtimer_daemon_callback_t callback, void *arg);
+
+/* As hrtimer_start() and hrtimer_stop(). A call already queued for the
+   timer task when the timer is stopped still runs. */
+static inline bool hrtimer_daemon_start(hrtimer_daemon_t *timer, uint32_t timeout_us, uint32_t period_us)
+{
+    return hrtimer_start(&timer->timer, timeout_us, period_us);
+}
+
+static inline void hrtimer_daemon_stop(hrtimer_daemon_t *timer)
+{
+    hrtimer_stop(&timer->timer);
+}
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _ESP_HRTIMER_H */
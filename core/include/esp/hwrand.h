@@ -11,6 +11,7 @@
 #ifndef _ESP_RNG_H
 #define _ESP_RNG_H
 #include <stdint.h>
+#include <stdbool.h>
 #include <sys/types.h>
 
 #ifdef	__cplusplus
@@ -20,9 +21,55 @@ extern "C" {
 /* Return a random 32-bit number */
 uint32_t hwrand(void);
 
-/* Fill a variable size buffer with data from the Hardware RNG */
+/* Fill a variable size buffer with data from the Hardware RNG
+
+   Once hwrand_pool_start() has been called this is served from the
+   entropy pool, falling back to reading the RNG directly for whatever
+   the pool can't cover.
+*/
 void hwrand_fill(uint8_t *buf, size_t len);
 
+/* Entropy pool
+ *
+ * A low priority task keeps a pool of HWRAND_POOL_WORDS words topped
+ * up in the background, so bulk consumers (mbedTLS handshakes) copy
+ * out of RAM instead of sampling the RNG register on the spot.
+ *
+ * Each pool word mixes HWRAND_POOL_SAMPLES raw RNG reads, taken a
+ * scheduler tick apart in batches. Raw reads go through a repetition
+ * count health test: a 32-bit sample repeating its predecessor is
+ * (for a working source) a 1 in 2^32 event, so it's counted as a
+ * failure and the sample is discarded.
+ */
+#ifndef HWRAND_POOL_WORDS
+#define HWRAND_POOL_WORDS 64
+#endif
+
+#ifndef HWRAND_POOL_SAMPLES
+#define HWRAND_POOL_SAMPLES 4
+#endif
+
+/* Stack size of the refill task, in words */
+#ifndef HWRAND_POOL_STACK_SIZE
+#define HWRAND_POOL_STACK_SIZE 128
+#endif
+
+/* Start the refill task at 'priority' (normally tskIDLE_PRIORITY+1).
+
+   Returns false if out of memory or already started.
+*/
+bool hwrand_pool_start(uint32_t priority);
+
+/* Copy up to 'len' bytes out of the pool, without blocking.
+
+   Returns the number of bytes copied, which is less than 'len' if the
+   pool is running low (or not started.)
+*/
+size_t hwrand_pool_read(uint8_t *buf, size_t len);
+
+/* Number of raw samples rejected by the health test since boot */
+uint32_t hwrand_health_failures(void);
+
 #ifdef	__cplusplus
 }
 #endif
@@ -39,6 +39,10 @@ void sdk__xt_tick_timer_init (void);
 void sdk__xt_timer_int(void);
 void sdk__xt_timer_int1(void);
 
+/* Exception frame of the code interrupted by the level 1 interrupt
+   being handled. Word 1 (XT_STK_PC) is the interrupted PC, word 2 PS. */
+extern uint32_t *_xt_isr_frame;
+
 static inline uint32_t _xt_get_intlevel(void)
 {
     uint32_t level;
@@ -101,4 +105,35 @@ typedef void (* _xt_isr)(void);
    should be moved or converted to an inline */
 void        _xt_isr_attach (uint8_t i, _xt_isr func);
 
+/* Set the order in which simultaneously pending interrupts are
+   serviced. 'order' lists interrupt numbers, highest priority first.
+   Any not listed are serviced afterwards in numeric order.
+
+   INUM_WDT is always serviced first, regardless of 'order'. The
+   default order is numeric (lowest interrupt number first.)
+*/
+void _xt_isr_set_priority_order(const uint8_t *order, uint8_t count);
+
+/* Optional per-vector dispatch statistics, build with
+   EXTRA_CFLAGS=-DXT_ISR_PROFILE=1 to enable. All times are in CPU
+   cycles (CCOUNT). */
+#ifndef XT_ISR_PROFILE
+#define XT_ISR_PROFILE 0
+#endif
+
+#if XT_ISR_PROFILE
+typedef struct {
+    uint32_t count;        /* Number of times the handler ran */
+    uint32_t max_latency;  /* Longest wait from dispatch entry to handler start */
+    uint32_t max_cycles;   /* Longest handler run time */
+    uint64_t total_cycles; /* Total handler run time */
+} _xt_isr_stats_t;
+
+/* Copy out the statistics of one interrupt number */
+void _xt_isr_get_stats(uint8_t i, _xt_isr_stats_t *stats);
+
+/* Zero the statistics of all interrupts */
+void _xt_isr_reset_stats(void);
+#endif
+
 #endif
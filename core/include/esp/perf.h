@@ -0,0 +1,101 @@
+/** esp/perf.h
+ *
+ * Cycle count profiling of code sections, without external tools.
+ *
+ * Each measured site accumulates the number of times it ran and the
+ * total and maximum CCOUNT cycles spent in it. A site is added to the
+ * registration list the first time it records, so sites can be
+ * declared anywhere (drivers, lwIP, mbedTLS) with no setup code:
+ *
+ *     void foo(void)
+ *     {
+ *         PERF_SCOPE("foo");
+ *         ...
+ *     }   <- the time is recorded when the scope ends
+ *
+ * lwIP's own PERF_START/PERF_STOP(name) points (lwip/include/arch/perf.h)
+ * use the same sites.
+ *
+ * Profiling is compiled out unless built with EXTRA_CFLAGS=-DPERF_ENABLE=1.
+ * Cycle counts include time spent in any interrupts taken inside the
+ * measured section, and are at the CPU clock (80 or 160MHz).
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _ESP_PERF_H
+#define _ESP_PERF_H
+
+#include <stdint.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifndef PERF_ENABLE
+#define PERF_ENABLE 0
+#endif
+
+typedef struct perf_site {
+    const char *name;
+    uint32_t count;
+    uint32_t total_cycles;  /* wraps after 2^32 cycles (27s at 160MHz) */
+    uint32_t max_cycles;
+    struct perf_site *next; /* registration list, NULL until first record */
+    uint8_t registered;
+} perf_site_t;
+
+static inline uint32_t perf_ccount(void)
+{
+    uint32_t ccount;
+    __asm__ volatile ("rsr %0, ccount" : "=a" (ccount));
+    return ccount;
+}
+
+/* Add one measurement of 'cycles' to 'site', registering it if needed.
+   Safe to call from interrupt context. */
+void perf_record(perf_site_t *site, uint32_t cycles);
+
+/* Head of the list of sites that have recorded at least once */
+perf_site_t *perf_sites(void);
+
+/* Zero the counters of all registered sites */
+void perf_reset(void);
+
+/* Print all registered sites to stdout */
+void perf_dump(void);
+
+#if PERF_ENABLE
+
+typedef struct {
+    perf_site_t *site;
+    uint32_t start;
+} perf_scope_t;
+
+static inline void perf_scope_end(perf_scope_t *scope)
+{
+    perf_record(scope->site, perf_ccount() - scope->start);
+}
+
+#define _PERF_CAT2(a, b) a##b
+#define _PERF_CAT(a, b) _PERF_CAT2(a, b)
+
+/* Measure from here to the end of the enclosing block */
+#define PERF_SCOPE(label)                                                      \
+    static perf_site_t _PERF_CAT(_perf_site_, __LINE__) = { .name = (label) }; \
+    perf_scope_t _PERF_CAT(_perf_scope_, __LINE__)                             \
+        __attribute__((cleanup(perf_scope_end))) =                             \
+        { &_PERF_CAT(_perf_site_, __LINE__), perf_ccount() }
+
+#else
+
+#define PERF_SCOPE(label) do {} while (0)
+
+#endif /* PERF_ENABLE */
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _ESP_PERF_H */
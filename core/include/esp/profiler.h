@@ -0,0 +1,68 @@
+/** esp/profiler.h
+ *
+ * Sampling CPU profiler, driven by the FRC1 timer interrupt.
+ *
+ * At each timer interrupt the PC of the interrupted code is read from
+ * its exception frame and counted in a histogram. After a run,
+ * profiler_dump() prints the histogram as lines of
+ *
+ *     PROF,<pc>,<count>
+ *
+ * which utils/prof_symbolize.py turns into a flat per-function profile
+ * (with addr2line), in a format utils/iram_hot.py takes as its hot
+ * function list.
+ *
+ * Samples are only taken where level 1 interrupts are enabled. Time
+ * spent in interrupt handlers and critical sections is counted against
+ * the first instruction after interrupts are enabled again, and code
+ * running from the NMI (the Wi-Fi MAC) isn't seen at all.
+ *
+ * Uses FRC1, so can't be used at the same time as extras/pwm.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _ESP_PROFILER_H
+#define _ESP_PROFILER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t samples;   /* counted in the histogram */
+    uint32_t dropped;   /* PCs that didn't fit in the histogram */
+    uint32_t entries;   /* distinct PCs */
+    uint32_t rate_hz;
+} profiler_stats_t;
+
+/* Start sampling at rate_hz (typically 1000-10000), into a histogram of
+   up to max_pcs distinct PCs. Any previous histogram is freed.
+
+   Returns false if out of memory or the rate can't be set.
+*/
+bool profiler_start(uint32_t rate_hz, size_t max_pcs);
+
+/* Stop sampling. The histogram is kept for profiler_dump(). */
+void profiler_stop(void);
+
+void profiler_get_stats(profiler_stats_t *stats);
+
+/* Emit the histogram, one "PROF,<pc>,<count>" line per PC after a
+   '#' comment line with the totals. Each line (without newline) is
+   passed to 'emit', or printed on stdout if 'emit' is NULL.
+
+   Stops sampling first, if running.
+*/
+void profiler_dump(void (*emit)(const char *line, void *arg), void *arg);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _ESP_PROFILER_H */
@@ -21,6 +21,10 @@ void Cache_Read_Disable(void);
  */
 void Cache_Read_Enable(uint32_t odd_even, uint32_t mb_count, uint32_t no_idea);
 
+/* The ROM function itself, which maps megabyte (mb_count * 2 + odd_even)
+   of flash, whether or not Cache_Read_Enable is the OTA wrapper. */
+void rom_Cache_Read_Enable(uint32_t odd_even, uint32_t mb_count, uint32_t no_idea);
+
 #ifdef	__cplusplus
 }
 #endif
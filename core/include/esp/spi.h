@@ -11,6 +11,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stddef.h>
 #include "esp/spi_regs.h"
 #include "esp/clocks.h"
 
@@ -249,6 +250,9 @@ uint32_t spi_transfer_32(uint8_t bus, uint32_t data);
 /**
  * \brief Transfer buffer of words over SPI
  * Please note that the buffer size is in words, not in bytes!
+ * Transfers longer than 64 bytes are pipelined: next block is prepared
+ * while the current one is being shifted. When in_data is NULL the two
+ * halves of the hardware buffer are used as ping-pong buffers.
  * Example:
  *
  *    const uint16_t out_buf[] = { 0xa0b0, 0xa1b1, 0xa2b2, 0xa3b3 };
@@ -265,6 +269,143 @@ uint32_t spi_transfer_32(uint8_t bus, uint32_t data);
  */
 size_t spi_transfer(uint8_t bus, const void *out_data, void *in_data, size_t len, spi_word_size_t word_size);
 
+/**
+ * \brief Send the same word many times
+ * Hardware buffer is filled with the pattern once and the transfer is
+ * retriggered until all words are sent, so no RAM buffer is needed.
+ * Useful for clearing displays, filling memories, etc. Received data
+ * is discarded.
+ * Example:
+ *
+ *     spi_repeat(1, 0xf800, 320 * 240, SPI_16BIT); // fill display with red
+ *
+ * \param bus Bus ID: 0 - system, 1 - user
+ * \param pattern Word to send
+ * \param count Number of words to send
+ * \param word_size Size of the word
+ * \return Transmitted words count
+ */
+size_t spi_repeat(uint8_t bus, uint32_t pattern, size_t count, spi_word_size_t word_size);
+
+/**
+ * SPI transaction with optional command, address and dummy phases,
+ * see spi_transaction()
+ */
+typedef struct
+{
+    uint16_t command;      ///< Command value
+    uint8_t command_bits;  ///< Command length in bits, 0..16, 0 - no command phase
+    uint32_t address;      ///< Address value
+    uint8_t address_bits;  ///< Address length in bits, 0..32, 0 - no address phase
+    uint8_t dummy_bits;    ///< Dummy cycles between address and data phases, 0 - none
+    const void *out_data;  ///< Data to send after address/dummy, can be NULL
+    size_t out_len;        ///< Size of out_data in bytes
+    void *in_data;         ///< Receive buffer, can be NULL
+    size_t in_len;         ///< Size of in_data in bytes
+} spi_transaction_t;
+
+/**
+ * \brief Perform SPI transaction using hardware command/address/dummy phases
+ * All phases are performed in one hardware transaction without CPU gaps,
+ * data phase is half-duplex: out_data is sent first, then in_data is
+ * received. Byte order of the data phase is not changed.
+ * Each data buffer can be up to 64 bytes long (32 bytes when both are
+ * used). Longer transactions are split in several hardware transactions,
+ * address is advanced by the number of transferred data bytes, so this
+ * is possible only when address phase is used.
+ * Example (read 256 bytes from SPI flash using FAST_READ command):
+ *
+ *     uint8_t buf[256];
+ *     const spi_transaction_t t = {
+ *         .command = 0x0b,
+ *         .command_bits = 8,
+ *         .address = 0x1000,
+ *         .address_bits = 24,
+ *         .dummy_bits = 8,
+ *         .in_data = buf,
+ *         .in_len = sizeof(buf)
+ *     };
+ *     spi_transaction(1, &t);
+ *
+ * \param bus Bus ID: 0 - system, 1 - user
+ * \param t Transaction description
+ * \return false when error
+ */
+bool spi_transaction(uint8_t bus, const spi_transaction_t *t);
+
+/**
+ * Asynchronous transfer descriptor, see spi_async_submit().
+ * Descriptor must stay valid until the transfer is complete.
+ */
+typedef struct spi_async_transfer spi_async_transfer_t;
+
+/**
+ * Completion callback of the asynchronous transfer.
+ * Called from the SPI interrupt handler, so it must be short and
+ * should be placed into IRAM.
+ */
+typedef void (*spi_async_callback_t)(spi_async_transfer_t *t, void *arg);
+
+struct spi_async_transfer
+{
+    const void *out_data;           ///< Data to send
+    void *in_data;                  ///< Receive buffer, NULL if received data isn't needed
+    size_t len;                     ///< Buffer size in words
+    spi_word_size_t word_size;      ///< Size of the word
+    spi_async_callback_t callback;  ///< Completion callback, can be NULL
+    void *arg;                      ///< Argument passed to the callback
+
+    /* Private, used by the driver */
+    size_t _pos;
+    spi_async_transfer_t *_next;
+};
+
+/**
+ * \brief Queue a transfer to be performed in background
+ * Transfer is driven by "trans done" interrupt of the SPI controller: next
+ * 64-byte block is loaded right from the ISR, so calling task can do other
+ * work while the bus is busy. Queued transfers are performed in order.
+ * Only bus 1 (HSPI) is supported, bus 0 is used by system flash.
+ * Example:
+ *
+ *     static xSemaphoreHandle done;
+ *
+ *     static void IRAM on_done(spi_async_transfer_t *t, void *arg)
+ *     {
+ *         signed portBASE_TYPE woken = pdFALSE;
+ *         xSemaphoreGiveFromISR(done, &woken);
+ *         portEND_SWITCHING_ISR(woken);
+ *     }
+ *     ...
+ *     spi_async_transfer_t t = {
+ *         .out_data = framebuf,
+ *         .len = sizeof(framebuf) / 2,
+ *         .word_size = SPI_16BIT,
+ *         .callback = on_done
+ *     };
+ *     spi_async_submit(1, &t);
+ *     // do something useful here
+ *     xSemaphoreTake(done, portMAX_DELAY);
+ *
+ * Synchronous transfer functions wait for the queue to drain before
+ * accessing the bus.
+ * \param bus Bus ID: 1 - user
+ * \param t Transfer descriptor
+ * \return false when error
+ */
+bool spi_async_submit(uint8_t bus, spi_async_transfer_t *t);
+/**
+ * \brief Check if there are pending asynchronous transfers
+ * \param bus Bus ID: 0 - system, 1 - user
+ * \return true if some transfers are still queued or in progress
+ */
+bool spi_async_busy(uint8_t bus);
+/**
+ * \brief Busy-wait until all queued asynchronous transfers are complete
+ * \param bus Bus ID: 0 - system, 1 - user
+ */
+void spi_async_wait(uint8_t bus);
+
 #ifdef __cplusplus
 }
 #endif
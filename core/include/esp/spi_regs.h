@@ -73,6 +73,21 @@ _Static_assert(sizeof(struct SPI_REGS) == 0x100, "SPI_REGS is the wrong size");
 
 /* Details for CMD register */
 
+/* SPI(0)'s flash commands: setting one of these sends it to the flash
+   chip, and the bit clears when it's done */
+#define SPI_CMD_READ                       BIT(31)
+#define SPI_CMD_WREN                       BIT(30)
+#define SPI_CMD_WRDI                       BIT(29)
+#define SPI_CMD_RDID                       BIT(28)
+#define SPI_CMD_RDSR                       BIT(27)
+#define SPI_CMD_WRSR                       BIT(26)
+#define SPI_CMD_PP                         BIT(25)
+#define SPI_CMD_SE                         BIT(24)
+#define SPI_CMD_BE                         BIT(23)
+#define SPI_CMD_CE                         BIT(22)
+#define SPI_CMD_DP                         BIT(21)
+#define SPI_CMD_RES                        BIT(20)
+#define SPI_CMD_HPM                        BIT(19)
 #define SPI_CMD_USR                        BIT(18)
 
 /* Details for CTRL0 register */
@@ -0,0 +1,103 @@
+/** esp/stackmon.h
+ *
+ * Stack usage of every task, and how big their stacks need to be.
+ *
+ * Build with EXTRA_CFLAGS=-DESP_STACKMON=1 to enable. The FreeRTOS task
+ * creation and deletion hooks (see portmacro.h) then record each task's
+ * stack size, the SDK's tasks, tcpip_thread and the timer daemon
+ * included, without needing configUSE_TRACE_FACILITY.
+ *
+ * stackmon_start() runs a task that samples every task's stack high
+ * water mark (the least free stack it has had, from
+ * uxTaskGetStackHighWaterMark()) and warns when one gets within a
+ * margin of overflowing, before vApplicationStackOverflowHook() would
+ * fire. stackmon_report() prints each task's size, peak use and a
+ * recommended size:
+ *
+ *     stackmon: task               size  peak  free   rec
+ *     stackmon: tcpip_thread        512   291   221   368
+ *     stackmon: Tmr Svc             512    97   415   176
+ *     ...
+ *     stackmon: total              3840  1364        2112  (saves 6912 bytes)
+ *
+ * The recommendation is the peak plus STACKMON_HEADROOM_PERCENT of it
+ * (and at least STACKMON_MIN_HEADROOM words, interrupts run on task
+ * stacks), rounded up to 16 words. It's only as good as the run it was
+ * measured over, so exercise the application's worst paths first.
+ *
+ * All sizes are in words (4 bytes), as xTaskCreate() takes them.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _ESP_STACKMON_H
+#define _ESP_STACKMON_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifndef ESP_STACKMON
+#define ESP_STACKMON 0
+#endif
+
+/* Most tasks tracked at once */
+#ifndef STACKMON_MAX_TASKS
+#define STACKMON_MAX_TASKS 24
+#endif
+
+#ifndef STACKMON_HEADROOM_PERCENT
+#define STACKMON_HEADROOM_PERCENT 25
+#endif
+
+#ifndef STACKMON_MIN_HEADROOM
+#define STACKMON_MIN_HEADROOM 64
+#endif
+
+#if ESP_STACKMON
+
+/* Task names are copied, cut short at this */
+#define STACKMON_NAME_LEN 16
+
+typedef struct {
+    void *task;                 /* its xTaskHandle */
+    char name[STACKMON_NAME_LEN];
+    uint16_t size;              /* words */
+    uint16_t free;              /* least free since it was created */
+    uint16_t recommended;
+} stackmon_info_t;
+
+/* Start a task at 'priority' (tskIDLE_PRIORITY + 1, say) sampling every
+   'sample_ms', warning on stdout when a task has less than
+   'margin_percent' of its stack left (once each time its free stack
+   reaches a new low) and calling stackmon_report() every 'report_ms'
+   (0 for never). Returns false if the task couldn't be created. */
+bool stackmon_start(unsigned priority, uint32_t sample_ms, uint32_t report_ms,
+                    unsigned margin_percent);
+
+/* Sample every task now and fill 'info' with up to 'max' of them.
+   Returns how many there are, which may be more than 'max'. */
+size_t stackmon_sample(stackmon_info_t *info, size_t max);
+
+/* Sample every task and print the table above */
+void stackmon_report(void);
+
+/* Tasks created while the table was full, so not tracked */
+uint32_t stackmon_untracked(void);
+
+/* Called from the task hooks */
+void stackmon_task_created(void *task, const char *name, unsigned short size);
+void stackmon_task_deleted(void *task);
+
+#endif /* ESP_STACKMON */
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _ESP_STACKMON_H */
@@ -0,0 +1,99 @@
+/** esp/trace.h
+ *
+ * Context switch and event tracing, into a RAM ring buffer.
+ *
+ * Build with EXTRA_CFLAGS=-DESP_TRACE=1 to enable. The FreeRTOS trace
+ * hooks (see portmacro.h) then record task switches, task creation and
+ * deletion, queue and semaphore sends and receives (including blocking
+ * on a full or empty queue) and the interrupt dispatcher records each
+ * handler's entry and exit. Each record is 8 bytes: the CCOUNT cycle
+ * counter and an event with a 24 bit object ID (the low bits of a task
+ * or queue's address, an interrupt number, or a trace_mark() value).
+ *
+ * Once the buffer is full the oldest records are overwritten, so
+ * stopping the trace right after a latency spike keeps what led up to
+ * it. trace_dump() emits the buffer as
+ *
+ *     TASK,<id>,<name>
+ *     TRACE,<ccount>,<event>,<id>
+ *
+ * lines (hex, except event and name), which utils/trace_decode.py turns
+ * into a timeline, per task and per interrupt time totals, or a
+ * chrome://tracing / Perfetto JSON file.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _ESP_TRACE_H
+#define _ESP_TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifndef ESP_TRACE
+#define ESP_TRACE 0
+#endif
+
+/* Records kept in the ring buffer, 8 bytes each */
+#ifndef TRACE_BUFFER_RECORDS
+#define TRACE_BUFFER_RECORDS 512
+#endif
+
+/* Most task names kept for trace_dump() */
+#ifndef TRACE_MAX_TASKS
+#define TRACE_MAX_TASKS 24
+#endif
+
+/* Event numbers, as written by trace_dump() */
+typedef enum {
+    TRACE_TASK_SWITCH = 1,      /* id = task now running */
+    TRACE_TASK_CREATE,
+    TRACE_TASK_DELETE,
+    TRACE_QUEUE_SEND,           /* id = queue or semaphore */
+    TRACE_QUEUE_SEND_FROM_ISR,
+    TRACE_QUEUE_RECEIVE,
+    TRACE_QUEUE_RECEIVE_FROM_ISR,
+    TRACE_QUEUE_BLOCK_SEND,     /* the running task blocks on a full queue */
+    TRACE_QUEUE_BLOCK_RECEIVE,  /* ... or on an empty one */
+    TRACE_ISR_ENTER,            /* id = interrupt number */
+    TRACE_ISR_EXIT,
+    TRACE_MARK,                 /* id = trace_mark() value */
+} trace_event_t;
+
+#if ESP_TRACE
+
+/* Clear the buffer and start recording. */
+void trace_start(void);
+
+/* Stop recording, keeping the buffer for trace_dump(). */
+void trace_stop(void);
+
+/* Record an application event, with a 24 bit value. Callable from
+   interrupt handlers. */
+void trace_mark(uint32_t value);
+
+/* Emit the known task names and then the buffer, oldest record first,
+   after a '#' comment line with the totals and the CPU clock. Each
+   line (without newline) is passed to 'emit', or printed on stdout if
+   'emit' is NULL.
+
+   Stops recording first, if running.
+*/
+void trace_dump(void (*emit)(const char *line, void *arg), void *arg);
+
+/* Called from the trace hooks */
+void trace_record(trace_event_t event, uint32_t id);
+void trace_task_created(void *task, const char *name);
+
+#endif /* ESP_TRACE */
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _ESP_TRACE_H */
@@ -9,6 +9,8 @@
 #ifndef _ESP_UART_H
 #define _ESP_UART_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include "esp/types.h"
 #include "esp/uart_regs.h"
 #include "esp/clocks.h"
@@ -124,4 +126,129 @@ static inline int uart_get_baud(int uart_num)
     return APB_CLK_FREQ / FIELD2VAL(UART_CLOCK_DIVIDER_VALUE, UART(uart_num).CLOCK_DIVIDER);
 }
 
+/* Interrupt driven UART driver (see core/esp_uart.c)
+ *
+ * Once enabled for a UART, uart_write() (and so printf, for UART0)
+ * copies data into a RAM ring buffer and returns immediately. The
+ * TXFIFO-empty interrupt moves it into the hardware FIFO.
+ *
+ * Likewise with an RX ring the RXFIFO-full and RX timeout interrupts
+ * move received data into RAM, where uart_read() picks it up.
+ *
+ * UART1 is transmit-only on ESP8266 (its RX pin is used by the
+ * flash), and enabling UART1 TX buffering routes it to GPIO2.
+ */
+
+/* Thresholds used if none have been set when buffering is enabled */
+#define UART_DEFAULT_TX_EMPTY_THRESHOLD 16
+#define UART_DEFAULT_RX_FULL_THRESHOLD 32
+#define UART_DEFAULT_RX_TIMEOUT 2
+
+typedef enum {
+    UART_TX_BLOCK = 0, /* When the ring is full, wait for space */
+    UART_TX_DROP = 1,  /* When the ring is full, discard and count the overflow */
+} uart_tx_mode_t;
+
+/* Allocate a TX ring of at least 'size' bytes (rounded up to a power
+ * of two) for the UART and start interrupt driven transmit.
+ *
+ * Returns false if the ring couldn't be allocated, or buffering was
+ * already enabled.
+ */
+bool uart_tx_buffer_enable(int uart_num, size_t size, uart_tx_mode_t mode);
+
+/* Returns true if buffered transmit is enabled for the UART */
+bool uart_tx_buffered(int uart_num);
+
+/* Write data to the UART, via the TX ring if buffered transmit is
+ * enabled (otherwise by polling the FIFO, like uart_putc.)
+ *
+ * Returns the number of bytes accepted, which is less than 'len' only
+ * in UART_TX_DROP mode.
+ */
+size_t uart_write(int uart_num, const void *data, size_t len);
+
+/* Number of bytes discarded in UART_TX_DROP mode since enabled */
+uint32_t uart_tx_dropped(int uart_num);
+
+/* Wait until everything in the TX ring and FIFO has been sent */
+void uart_tx_flush(int uart_num);
+
+/* Allocate an RX ring of at least 'size' bytes (rounded up to a power
+ * of two) for the UART and start interrupt driven receive.
+ *
+ * If the ring fills, RX interrupts are held off (so data backs up in
+ * the hardware FIFO) until uart_read() has emptied half of it.
+ *
+ * Returns false if the ring couldn't be allocated, or buffering was
+ * already enabled.
+ */
+bool uart_rx_buffer_enable(int uart_num, size_t size);
+
+/* Set the RX FIFO fill level that raises an interrupt, and the idle
+ * time (in byte times, 0 to disable) after which any remaining bytes
+ * raise an interrupt.
+ */
+void uart_set_rx_thresholds(int uart_num, uint8_t full_threshold, uint8_t timeout);
+
+/* Called from the UART interrupt (so it must be IRAM, and short) each
+ * time received data has been moved into the RX ring. 'rx_count' is the
+ * number of bytes put in the ring since it was enabled (wrapping), and
+ * 'idle' is set when the line has been idle for the RX timeout: with
+ * the timeout set to a protocol's inter-frame gap, rx_count is then the
+ * end of a frame. The timeout only comes while bytes are left in the
+ * hardware FIFO, so a frame whose last byte raised an RXFIFO-full
+ * interrupt (which empties it) gets no idle call: a protocol that must
+ * catch every gap times it after non-idle calls too (extras/modbus does,
+ * with an hrtimer). Returns true if it woke a task (with a ...FromISR()
+ * call) that needs a context switch.
+ */
+typedef bool (*uart_rx_callback_t)(int uart_num, uint32_t rx_count, bool idle, void *arg);
+
+/* Set (or, with NULL, clear) the RX callback */
+void uart_set_rx_callback(int uart_num, uart_rx_callback_t callback, void *arg);
+
+/* Set the TX FIFO level below which the FIFO is refilled from the ring */
+void uart_set_tx_threshold(int uart_num, uint8_t empty_threshold);
+
+/* Read up to 'len' received bytes, waiting up to 'timeout_ticks'
+ * RTOS ticks for the first one to arrive.
+ *
+ * Returns the number of bytes read, 0 on timeout. Without an RX ring,
+ * only returns what is already in the hardware FIFO.
+ *
+ * Waits on the calling task's notification (ulTaskNotifyTake), so a
+ * task blocking here shouldn't also wait on notifications for
+ * something else.
+ */
+size_t uart_read(int uart_num, void *data, size_t len, uint32_t timeout_ticks);
+
+/* Read received data where it is in the RX ring, without a copy:
+ * waits up to 'timeout_ticks' like uart_read(), then points 'data' at
+ * the oldest received bytes and returns how many there are in one
+ * piece (data waiting past the end of the ring comes in the next
+ * piece). They stay in the ring until uart_rx_consume().
+ *
+ * Needs an RX ring, returns 0 without one or on timeout.
+ */
+size_t uart_rx_peek(int uart_num, const uint8_t **data, uint32_t timeout_ticks);
+
+/* Discard the oldest 'len' bytes of the RX ring, after uart_rx_peek() */
+void uart_rx_consume(int uart_num, size_t len);
+
+/* Number of received bytes waiting to be read */
+size_t uart_rx_available(int uart_num);
+
+/* Hardware flow control. With 'rts', RTS is deasserted while the RX
+ * FIFO holds 'rts_threshold' bytes or more (as it does when the RX
+ * ring is full and the FIFO isn't being emptied). With 'cts', data is
+ * only sent while CTS is asserted. For UART0 the pins are switched to
+ * RTS (GPIO15) and CTS (GPIO13).
+ */
+void uart_set_flow_control(int uart_num, bool rts, bool cts, uint8_t rts_threshold);
+
+/* Number of hardware RX FIFO overflows (lost data) since RX buffering
+ * was enabled */
+uint32_t uart_rx_overflows(int uart_num);
+
 #endif /* _ESP_UART_H */
@@ -25,7 +25,7 @@
 
 struct WDEV_REGS {
     uint32_t volatile _unknown0[768];  // 0x0000 - 0x0bfc
-    uint32_t volatile SYS_TIME;        // 0x0c00
+    uint32_t volatile SYS_TIME;        // 0x0c00 Free-running 1MHz counter (sdk_system_get_time)
     uint32_t volatile _unknown1[144];  // 0x0c04 - 0x0e40
     uint32_t volatile HWRNG;           // 0xe44 HW RNG, see http://esp8266-re.foogod.com/wiki/Random_Number_Generator
 } __attribute__ (( packed ));
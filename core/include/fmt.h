@@ -0,0 +1,84 @@
+/* Compact printf formatting, without the heap
+ *
+ * fmt_vprintf() formats into a small buffer on the caller's stack and
+ * hands it to a sink callback each time it fills:
+ *
+ *     static void to_socket(void *arg, const char *data, size_t len)
+ *     {
+ *         netconn_write(arg, data, len, NETCONN_COPY);
+ *     }
+ *     ...
+ *     fmt_printf(to_socket, conn, "%u clients, up %u s\n", n, uptime);
+ *
+ * Nothing is allocated and nothing is kept between calls, so it can be
+ * used from any task at once, and doesn't touch the task's struct
+ * _reent. It needs a couple of hundred bytes of stack, where newlib's
+ * vfprintf needs over a kilobyte plus the buffers stdio allocates
+ * (examples/tests/fmt_bench measures both).
+ *
+ * When built with EXTRA_CFLAGS=-DFMT_PRINTF=1, printf(), vprintf(),
+ * puts() and putchar() (the function, as gcc calls for printf("x\n")
+ * and printf("%c")) format straight to UART0, through the TX ring if
+ * uart_tx_buffer_enable() was called, and sprintf(), snprintf(),
+ * vsprintf() and vsnprintf() are replaced too. That includes every
+ * caller in the SDK, lwIP and the extras (binlog_format(), for one).
+ * fprintf(), fputs() and the putchar() macro still go through newlib's
+ * stdio.
+ *
+ * Supported: flags "-+ #0", width and precision (also as *), the
+ * length modifiers hh h l ll j z t, and %d %i %u %o %x %X %c %s %p %n
+ * %%. Floating point (%f %F %e %E %g %G) only with FMT_FLOAT=1 as
+ * well, otherwise the argument is skipped and "?" printed; precision
+ * is at most 9 digits.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _FMT_H
+#define _FMT_H
+
+#include <stdarg.h>
+#include <stddef.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifndef FMT_PRINTF
+#define FMT_PRINTF 0
+#endif
+
+#ifndef FMT_FLOAT
+#define FMT_FLOAT 0
+#endif
+
+/* Bytes formatted on the stack before each call to the sink */
+#ifndef FMT_CHUNK
+#define FMT_CHUNK 32
+#endif
+
+typedef void (*fmt_sink_t)(void *arg, const char *data, size_t len);
+
+/* Format to 'sink', returning the number of characters written */
+int fmt_vprintf(fmt_sink_t sink, void *arg, const char *format, va_list ap);
+
+int fmt_printf(fmt_sink_t sink, void *arg, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+/* Like vsnprintf(): at most size - 1 characters and a terminating NUL,
+   returning the length the whole output would have had */
+int fmt_vsnprintf(char *buf, size_t size, const char *format, va_list ap);
+
+int fmt_snprintf(char *buf, size_t size, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+/* A sink writing to the UART number in 'arg' with uart_write(), "\n"
+   becoming "\r\n" as for stdout */
+void fmt_uart_sink(void *arg, const char *data, size_t len);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _FMT_H */
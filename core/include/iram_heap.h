@@ -0,0 +1,48 @@
+/* Secondary heap in spare IRAM
+ *
+ * The IRAM left over after the linked code (from _text_end to the end
+ * of the 32KB IRAM segment) is managed as a separate heap, so buffers
+ * that only need 32-bit access can be kept out of the scarce DRAM heap.
+ *
+ * IRAM only supports aligned 32-bit loads and stores. 8 and 16 bit
+ * loads are emulated by the LoadStoreError handler (slowly), 8 and 16
+ * bit stores are not supported at all and crash. So only use this for
+ * data that is always accessed as whole words (uint32_t buffers, DMA
+ * descriptors, word-wise ring buffers, ...), and don't use memset(),
+ * memcpy() or string functions on it.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _IRAM_HEAP_H
+#define _IRAM_HEAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/* Allocate 'size' bytes (rounded up to a multiple of 4) of IRAM, word
+   aligned. Returns NULL if there isn't enough spare IRAM. */
+void *malloc_iram(size_t size);
+
+/* As malloc_iram, zeroing the block with word stores */
+void *calloc_iram(size_t nmemb, size_t size);
+
+/* Free a block from malloc_iram/calloc_iram (NULL is ignored) */
+void free_iram(void *ptr);
+
+/* Total spare IRAM given to the heap */
+size_t iram_heap_size(void);
+
+/* IRAM heap bytes currently free (not necessarily contiguous) */
+size_t iram_heap_free(void);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _IRAM_HEAP_H */
@@ -0,0 +1,75 @@
+/* Size-class pools under malloc()
+ *
+ * When built with EXTRA_CFLAGS=-DMALLOC_POOLS=1, small allocations are
+ * served from fixed-size block pools instead of the newlib heap. Each
+ * size class is a free list of equal blocks carved from one arena, so
+ * alloc and free are O(1) and short-lived small objects (pbufs, mbox
+ * entries, PCBs, ...) can't fragment the main heap.
+ *
+ * Requests too big for any class, or for a class that is exhausted,
+ * fall through to the newlib heap as before. free() and realloc() tell
+ * pool blocks apart by address, so pointers from either source can be
+ * passed to them freely.
+ *
+ * The classes are set with MALLOC_POOL_SIZES (block sizes in bytes,
+ * ascending, multiples of 8 to keep malloc's alignment) and MALLOC_POOL_COUNTS (blocks per class).
+ * The arena is taken from the heap in one piece by the first malloc()
+ * and never returned, so the pools cost sum(size * count) bytes of
+ * DRAM whether used or not.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _MALLOC_POOL_H
+#define _MALLOC_POOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifndef MALLOC_POOLS
+#define MALLOC_POOLS 0
+#endif
+
+#ifndef MALLOC_POOL_SIZES
+#define MALLOC_POOL_SIZES  { 16, 32, 64, 128 }
+#endif
+
+#ifndef MALLOC_POOL_COUNTS
+#define MALLOC_POOL_COUNTS { 32, 32, 16, 8 }
+#endif
+
+#if MALLOC_POOLS
+
+typedef struct {
+    uint16_t size;      /* Block size */
+    uint16_t count;     /* Blocks in the class */
+    uint16_t used;      /* Blocks currently allocated */
+    uint16_t max_used;  /* Most blocks ever allocated at once */
+    uint32_t fallbacks; /* Requests passed to the heap as the class was full */
+} malloc_pool_stats_t;
+
+/* Number of size classes */
+size_t malloc_pool_classes(void);
+
+/* Copy out the statistics of size class 'i'. Returns false if out of range. */
+bool malloc_pool_get_stats(size_t i, malloc_pool_stats_t *stats);
+
+/* The pool backed allocator itself, behind malloc() etc. */
+void *pool_malloc(size_t size);
+void pool_free(void *ptr);
+void *pool_calloc(size_t nmemb, size_t size);
+void *pool_realloc(void *ptr, size_t size);
+
+#endif /* MALLOC_POOLS */
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _MALLOC_POOL_H */
@@ -0,0 +1,78 @@
+/* Instrumented malloc()
+ *
+ * When built with EXTRA_CFLAGS=-DMALLOC_STATS=1, malloc/free/calloc/
+ * realloc keep track of:
+ *
+ * - bytes currently allocated, and the peak,
+ * - the lowest free heap seen (sampled whenever a new peak is reached),
+ * - bytes, peak bytes and allocation count per call site (the return
+ *   address of the malloc call, look it up with xtensa-lx106-elf-addr2line).
+ *
+ * malloc_stats_dump() prints all of it, plus the current free heap and
+ * the largest block that can currently be allocated, to stdout.
+ *
+ * Each allocation carries an 8 byte header while this is enabled, so
+ * it is meant for debug builds only. Works on top of MALLOC_POOLS.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _MALLOC_STATS_H
+#define _MALLOC_STATS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifndef MALLOC_STATS
+#define MALLOC_STATS 0
+#endif
+
+/* Number of call sites tracked individually, the rest are lumped
+   together under a NULL caller */
+#ifndef MALLOC_STATS_SITES
+#define MALLOC_STATS_SITES 32
+#endif
+
+#if MALLOC_STATS
+
+typedef struct {
+    uint32_t in_use;    /* Bytes currently allocated through malloc() */
+    uint32_t peak;      /* Most bytes allocated at once */
+    uint32_t min_free;  /* Lowest free heap seen (xPortGetFreeHeapSize) */
+    uint32_t allocs;    /* Total allocations */
+    uint32_t failures;  /* Allocations that returned NULL */
+} malloc_stats_t;
+
+typedef struct {
+    void *caller;
+    uint32_t in_use;
+    uint32_t peak;
+    uint32_t allocs;
+} malloc_site_stats_t;
+
+void malloc_stats_get(malloc_stats_t *stats);
+
+/* Copy out call site 'i' (0 to MALLOC_STATS_SITES). Returns false once
+   past the last site in use. */
+bool malloc_stats_get_site(size_t i, malloc_site_stats_t *site);
+
+/* Largest block malloc() could return right now. Found by trial
+   allocation, so takes a moment. */
+size_t malloc_stats_largest_free(void);
+
+/* Print everything above to stdout */
+void malloc_stats_dump(void);
+
+#endif /* MALLOC_STATS */
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _MALLOC_STATS_H */
@@ -0,0 +1,41 @@
+/* Heap ceiling for _sbrk_r (core/newlib_syscalls.c)
+ *
+ * The heap grows up from the end of .bss towards the supervisor stack
+ * at the top of DRAM. _sbrk_r refuses to grow it to within
+ * SBRK_STACK_RESERVE bytes of that stack (the lowest point it reached
+ * before the scheduler started, or the current stack pointer before
+ * then), so malloc() fails cleanly with ENOMEM instead of the heap
+ * silently overwriting the stack.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _SBRK_H
+#define _SBRK_H
+
+#include <stddef.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/* Bytes kept free below the supervisor stack */
+#ifndef SBRK_STACK_RESERVE
+#define SBRK_STACK_RESERVE 512
+#endif
+
+/* Called when _sbrk_r refuses to grow the heap by 'incr' bytes.
+
+   The default does nothing (malloc returns NULL), define your own to
+   log or to abort() so that the system resets rather than running on
+   out of memory. Called with newlib's malloc lock held, so it must not
+   allocate or block.
+*/
+void sbrk_failed_hook(ptrdiff_t incr);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _SBRK_H */
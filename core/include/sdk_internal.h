@@ -218,6 +218,7 @@ void sdk_pm_attach(void);
 void sdk_pp_attach(void);
 void sdk_pp_soft_wdt_init(void);
 int sdk_register_chipv6_phy(uint8_t *);
+void sdk_rom_i2c_writeReg_Mask(uint32_t block, uint32_t host_id, uint32_t reg_add, uint32_t msb, uint32_t lsb, uint32_t indata);
 void sdk_sleep_reset_analog_rtcreg_8266(void);
 uint32_t sdk_system_get_checksum(uint8_t *, uint32_t);
 void sdk_system_restart_in_nmi(void);
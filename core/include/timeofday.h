@@ -0,0 +1,72 @@
+/* Time of day over the 64-bit microsecond uptime
+ *
+ * A software clock of microseconds since the Unix epoch, running off
+ * sys_uptime_us(). It's what gettimeofday(), time() and
+ * clock_gettime(CLOCK_REALTIME) return, and can be disciplined (by
+ * extras/sntp, or anything else with a reference) without jumps:
+ *
+ * - timeofday_set_us() steps it, for the first setting.
+ * - timeofday_adjust() slews it: the offset is worked off by running
+ *   the clock ~488ppm (1/2048) fast or slow until it's gone, as BSD's
+ *   adjtime() does, so the clock never goes backwards and timestamps
+ *   stay in order.
+ * - timeofday_set_freq() corrects the rate of the crystal, within
+ *   +-TIMEOFDAY_MAX_FREQ_PPB.
+ *
+ * Reading it is cheap (a critical section, some 64-bit adds and
+ * multiplies, no division) and safe from interrupt context.
+ * clock_gettime(CLOCK_MONOTONIC) gives the undisciplined uptime.
+ *
+ * Until it's set the clock counts from 0 at boot.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _TIMEOFDAY_H
+#define _TIMEOFDAY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/* Largest frequency correction, parts per billion */
+#define TIMEOFDAY_MAX_FREQ_PPB 500000
+
+/* newlib only declares these for some targets */
+#ifndef CLOCK_MONOTONIC
+#define CLOCK_MONOTONIC (clockid_t)4
+#endif
+int clock_gettime(clockid_t clock_id, struct timespec *tp);
+
+/* Microseconds since the epoch (or since boot, if never set) */
+int64_t timeofday_us(void);
+
+/* True once the clock has been set */
+bool timeofday_is_set(void);
+
+/* Set the clock to 'unix_us', at once. Cancels any slew in progress. */
+void timeofday_set_us(int64_t unix_us);
+
+/* Add 'offset_us' to the clock gradually, replacing any slew still in
+   progress. Takes 2048us per us of offset. */
+void timeofday_adjust(int64_t offset_us);
+
+/* Slew still to be applied, us */
+int64_t timeofday_adjust_remaining(void);
+
+/* Run the clock faster (positive) or slower by 'ppb' parts per billion
+   than the uptime counter, clamped to +-TIMEOFDAY_MAX_FREQ_PPB */
+void timeofday_set_freq(int32_t ppb);
+
+int32_t timeofday_get_freq(void);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _TIMEOFDAY_H */
@@ -0,0 +1,148 @@
+/* Secondary heap in spare IRAM, see iram_heap.h
+ *
+ * A first-fit allocator with an address ordered free list, merging
+ * neighbouring free blocks on free. Every block starts with a one word
+ * header holding its total size, free blocks also keep the next free
+ * block in their second word. All metadata is whole words, as IRAM
+ * requires.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <iram_heap.h>
+#include <stdbool.h>
+#include <common_macros.h>
+#include <esp/interrupts.h>
+
+/* linker script defined */
+extern uint32_t _iram_heap_start;
+extern uint32_t _iram_heap_end;
+
+typedef struct iram_block {
+    uint32_t size;              /* Whole block in bytes, header included */
+    struct iram_block *next;    /* Next free block, only while free */
+} iram_block_t;
+
+#define HDR_SIZE  sizeof(uint32_t)
+#define MIN_BLOCK sizeof(iram_block_t)
+
+static iram_block_t *free_list;
+static size_t heap_size;
+static size_t free_bytes;
+static bool inited;
+
+static void iram_heap_init(void)
+{
+    uint8_t *start = (uint8_t *)&_iram_heap_start;
+    uint8_t *end = (uint8_t *)&_iram_heap_end;
+
+    inited = true;
+    if (end - start < (int)MIN_BLOCK)
+        return;
+    heap_size = (end - start) & ~3;
+    free_bytes = heap_size;
+    free_list = (iram_block_t *)start;
+    free_list->size = heap_size;
+    free_list->next = NULL;
+}
+
+void *malloc_iram(size_t size)
+{
+    void *ptr = NULL;
+    size_t need = (size + HDR_SIZE + 3) & ~3;
+
+    if (need < MIN_BLOCK)
+        need = MIN_BLOCK;
+
+    uint32_t old_level = _xt_disable_interrupts();
+    if (!inited)
+        iram_heap_init();
+
+    for (iram_block_t **link = &free_list; *link; link = &(*link)->next) {
+        iram_block_t *block = *link;
+        if (block->size < need)
+            continue;
+        if (block->size - need >= MIN_BLOCK) {
+            /* Split, the tail stays on the free list */
+            iram_block_t *rest = (iram_block_t *)((uint8_t *)block + need);
+            rest->size = block->size - need;
+            rest->next = block->next;
+            *link = rest;
+            block->size = need;
+        } else {
+            *link = block->next;
+        }
+        free_bytes -= block->size;
+        ptr = (uint8_t *)block + HDR_SIZE;
+        break;
+    }
+
+    _xt_restore_interrupts(old_level);
+    return ptr;
+}
+
+void *calloc_iram(size_t nmemb, size_t size)
+{
+    size_t total = nmemb * size;
+
+    if (size && total / size != nmemb)
+        return NULL;
+    uint32_t *ptr = malloc_iram(total);
+    if (ptr) {
+        for (size_t i = 0; i < (total + 3) / 4; i++)
+            ptr[i] = 0;
+    }
+    return ptr;
+}
+
+void free_iram(void *ptr)
+{
+    if (!ptr)
+        return;
+
+    iram_block_t *block = (iram_block_t *)((uint8_t *)ptr - HDR_SIZE);
+
+    uint32_t old_level = _xt_disable_interrupts();
+    free_bytes += block->size;
+
+    iram_block_t *prev = NULL;
+    iram_block_t *next = free_list;
+    while (next && next < block) {
+        prev = next;
+        next = next->next;
+    }
+
+    block->next = next;
+    if (next && (uint8_t *)block + block->size == (uint8_t *)next) {
+        block->size += next->size;
+        block->next = next->next;
+    }
+    if (prev && (uint8_t *)prev + prev->size == (uint8_t *)block) {
+        prev->size += block->size;
+        prev->next = block->next;
+    } else if (prev) {
+        prev->next = block;
+    } else {
+        free_list = block;
+    }
+
+    _xt_restore_interrupts(old_level);
+}
+
+size_t iram_heap_size(void)
+{
+    if (!inited) {
+        uint32_t old_level = _xt_disable_interrupts();
+        if (!inited)
+            iram_heap_init();
+        _xt_restore_interrupts(old_level);
+    }
+    return heap_size;
+}
+
+size_t iram_heap_free(void)
+{
+    iram_heap_size();
+    return free_bytes;
+}
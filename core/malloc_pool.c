@@ -0,0 +1,217 @@
+/* Size-class pools under malloc(), see malloc_pool.h
+ *
+ * Replaces newlib's malloc/free/calloc/realloc (the binary SDK
+ * libraries reach these through pvPortMalloc/vPortFree as well, see
+ * ld/common.ld). newlib internals that call _malloc_r directly still
+ * use the heap.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <malloc_pool.h>
+
+#if MALLOC_POOLS
+
+#include <stdlib.h>
+#include <string.h>
+#include <reent.h>
+#include <common_macros.h>
+#include <esp/interrupts.h>
+
+static const uint16_t pool_sizes[] = MALLOC_POOL_SIZES;
+static const uint16_t pool_counts[] = MALLOC_POOL_COUNTS;
+
+#define NUM_CLASSES (sizeof(pool_sizes) / sizeof(pool_sizes[0]))
+
+_Static_assert(sizeof(pool_counts) == sizeof(pool_sizes), "MALLOC_POOL_SIZES and MALLOC_POOL_COUNTS differ in length");
+
+typedef struct free_block {
+    struct free_block *next;
+} free_block_t;
+
+typedef struct {
+    free_block_t *free;
+    uint8_t *start;      /* First block of the class */
+    uint8_t *end;        /* End of the class's blocks */
+    uint16_t used;
+    uint16_t max_used;
+    uint32_t fallbacks;
+} pool_t;
+
+static pool_t pools[NUM_CLASSES];
+static uint8_t *arena_start;
+static uint8_t *arena_end;
+static bool pools_inited;
+
+/* Carve the arena into the size classes. The first malloc() happens
+   during startup before the scheduler runs, so this doesn't race. */
+static void IRAM pools_init(void)
+{
+    size_t total = 0;
+
+    pools_inited = true;
+    for (size_t i = 0; i < NUM_CLASSES; i++)
+        total += (size_t)pool_sizes[i] * pool_counts[i];
+
+    uint8_t *p = _malloc_r(_REENT, total);
+    if (!p)
+        return;
+    arena_start = p;
+    arena_end = p + total;
+
+    for (size_t i = 0; i < NUM_CLASSES; i++) {
+        pool_t *pool = &pools[i];
+        pool->start = p;
+        for (uint16_t j = 0; j < pool_counts[i]; j++) {
+            free_block_t *block = (free_block_t *)p;
+            block->next = pool->free;
+            pool->free = block;
+            p += pool_sizes[i];
+        }
+        pool->end = p;
+    }
+}
+
+/* Return the class a pointer belongs to, or -1 if it's from the heap */
+static inline int pool_of(const void *ptr)
+{
+    const uint8_t *p = ptr;
+
+    if (p < arena_start || p >= arena_end)
+        return -1;
+    for (size_t i = 0; i < NUM_CLASSES; i++) {
+        if (p < pools[i].end)
+            return i;
+    }
+    return -1;
+}
+
+static void * IRAM pool_alloc(size_t size)
+{
+    void *ptr = NULL;
+
+    if (!pools_inited)
+        pools_init();
+
+    uint32_t old_level = _xt_disable_interrupts();
+
+    for (size_t i = 0; i < NUM_CLASSES; i++) {
+        if (size > pool_sizes[i])
+            continue;
+        pool_t *pool = &pools[i];
+        if (!pool->free) {
+            /* Don't spill into bigger classes, they are sized for
+               their own users */
+            pool->fallbacks++;
+            break;
+        }
+        ptr = pool->free;
+        pool->free = pool->free->next;
+        if (++pool->used > pool->max_used)
+            pool->max_used = pool->used;
+        break;
+    }
+
+    _xt_restore_interrupts(old_level);
+    return ptr;
+}
+
+void * IRAM pool_malloc(size_t size)
+{
+    void *ptr = pool_alloc(size);
+    return ptr ? ptr : _malloc_r(_REENT, size);
+}
+
+void IRAM pool_free(void *ptr)
+{
+    int i = pool_of(ptr);
+
+    if (i < 0) {
+        _free_r(_REENT, ptr);
+        return;
+    }
+
+    uint32_t old_level = _xt_disable_interrupts();
+    free_block_t *block = ptr;
+    block->next = pools[i].free;
+    pools[i].free = block;
+    pools[i].used--;
+    _xt_restore_interrupts(old_level);
+}
+
+void * IRAM pool_calloc(size_t nmemb, size_t size)
+{
+    size_t total = nmemb * size;
+
+    if (size && total / size != nmemb)
+        return NULL;
+    void *ptr = pool_alloc(total);
+    if (!ptr)
+        return _calloc_r(_REENT, nmemb, size);
+    memset(ptr, 0, total);
+    return ptr;
+}
+
+void * IRAM pool_realloc(void *ptr, size_t size)
+{
+    int i = pool_of(ptr);
+
+    if (i < 0)
+        return _realloc_r(_REENT, ptr, size);
+    if (size <= pool_sizes[i])
+        return ptr;
+
+    void *new_ptr = pool_malloc(size);
+    if (new_ptr) {
+        memcpy(new_ptr, ptr, pool_sizes[i]);
+        pool_free(ptr);
+    }
+    return new_ptr;
+}
+
+#if !MALLOC_STATS
+/* With MALLOC_STATS the instrumented versions in malloc_stats.c sit on
+   top of the pools instead */
+void * IRAM malloc(size_t size)
+{
+    return pool_malloc(size);
+}
+
+void IRAM free(void *ptr)
+{
+    pool_free(ptr);
+}
+
+void * IRAM calloc(size_t nmemb, size_t size)
+{
+    return pool_calloc(nmemb, size);
+}
+
+void * IRAM realloc(void *ptr, size_t size)
+{
+    return pool_realloc(ptr, size);
+}
+#endif
+
+size_t malloc_pool_classes(void)
+{
+    return NUM_CLASSES;
+}
+
+bool malloc_pool_get_stats(size_t i, malloc_pool_stats_t *stats)
+{
+    if (i >= NUM_CLASSES)
+        return false;
+
+    uint32_t old_level = _xt_disable_interrupts();
+    stats->size = pool_sizes[i];
+    stats->count = pool_counts[i];
+    stats->used = pools[i].used;
+    stats->max_used = pools[i].max_used;
+    stats->fallbacks = pools[i].fallbacks;
+    _xt_restore_interrupts(old_level);
+    return true;
+}
+
+#endif /* MALLOC_POOLS */
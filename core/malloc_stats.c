@@ -0,0 +1,235 @@
+/* Instrumented malloc(), see malloc_stats.h
+ *
+ * Each block gets a header recording the caller and the requested size,
+ * with a magic value in the size's top byte. Pointers that newlib
+ * allocated internally (strdup() etc.) have no header, their word
+ * before the pointer is newlib's own chunk size, which can never carry
+ * the magic, so free() can pass them through untouched.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <malloc_stats.h>
+
+#if MALLOC_STATS
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <reent.h>
+#include <common_macros.h>
+#include <esp/interrupts.h>
+#include <malloc_pool.h>
+#include <FreeRTOS.h>
+
+#if MALLOC_POOLS
+#define base_malloc(size)        pool_malloc(size)
+#define base_free(ptr)           pool_free(ptr)
+#define base_realloc(ptr, size)  pool_realloc(ptr, size)
+#else
+#define base_malloc(size)        _malloc_r(_REENT, size)
+#define base_free(ptr)           _free_r(_REENT, ptr)
+#define base_realloc(ptr, size)  _realloc_r(_REENT, ptr, size)
+#endif
+
+#define HDR_MAGIC      0xa5000000
+#define HDR_MAGIC_MASK 0xff000000
+
+typedef struct {
+    malloc_site_stats_t *site;
+    uint32_t size;       /* Requested size | HDR_MAGIC */
+} alloc_hdr_t;
+
+_Static_assert(sizeof(alloc_hdr_t) == 8, "alloc_hdr_t must keep 8 byte alignment");
+
+static malloc_stats_t stats = { .min_free = UINT32_MAX };
+static malloc_site_stats_t sites[MALLOC_STATS_SITES + 1];
+static size_t num_sites;
+
+/* Called with interrupts disabled */
+static malloc_site_stats_t * IRAM find_site(void *caller)
+{
+    for (size_t i = 0; i < num_sites; i++) {
+        if (sites[i].caller == caller)
+            return &sites[i];
+    }
+    if (num_sites < MALLOC_STATS_SITES) {
+        sites[num_sites].caller = caller;
+        return &sites[num_sites++];
+    }
+    /* Overflow entry, caller stays NULL */
+    return &sites[MALLOC_STATS_SITES];
+}
+
+static inline alloc_hdr_t *get_hdr(void *ptr)
+{
+    alloc_hdr_t *hdr = (alloc_hdr_t *)ptr - 1;
+    if ((hdr->size & HDR_MAGIC_MASK) != HDR_MAGIC)
+        return NULL;
+    return hdr;
+}
+
+/* Record a new block, returns the pointer to hand out */
+static void * IRAM track(alloc_hdr_t *hdr, size_t size, void *caller)
+{
+    bool new_peak;
+
+    if (!hdr) {
+        stats.failures++;
+        return NULL;
+    }
+
+    uint32_t old_level = _xt_disable_interrupts();
+    malloc_site_stats_t *site = find_site(caller);
+    hdr->site = site;
+    hdr->size = size | HDR_MAGIC;
+    site->in_use += size;
+    site->allocs++;
+    if (site->in_use > site->peak)
+        site->peak = site->in_use;
+    stats.allocs++;
+    stats.in_use += size;
+    new_peak = stats.in_use > stats.peak;
+    if (new_peak)
+        stats.peak = stats.in_use;
+    _xt_restore_interrupts(old_level);
+
+    /* mallinfo() is slow, so only sample the free heap on a new peak */
+    if (new_peak) {
+        uint32_t free_now = xPortGetFreeHeapSize();
+        if (free_now < stats.min_free)
+            stats.min_free = free_now;
+    }
+    return hdr + 1;
+}
+
+static void IRAM untrack(alloc_hdr_t *hdr)
+{
+    uint32_t size = hdr->size & ~HDR_MAGIC_MASK;
+
+    uint32_t old_level = _xt_disable_interrupts();
+    hdr->site->in_use -= size;
+    stats.in_use -= size;
+    hdr->size = 0;
+    _xt_restore_interrupts(old_level);
+}
+
+void * IRAM malloc(size_t size)
+{
+    if (size & HDR_MAGIC_MASK)
+        return NULL;
+    return track(base_malloc(size + sizeof(alloc_hdr_t)), size, __builtin_return_address(0));
+}
+
+void IRAM free(void *ptr)
+{
+    if (!ptr)
+        return;
+    alloc_hdr_t *hdr = get_hdr(ptr);
+    if (!hdr) {
+        base_free(ptr);
+        return;
+    }
+    untrack(hdr);
+    base_free(hdr);
+}
+
+void * IRAM calloc(size_t nmemb, size_t size)
+{
+    size_t total = nmemb * size;
+
+    if ((size && total / size != nmemb) || (total & HDR_MAGIC_MASK))
+        return NULL;
+    void *ptr = track(base_malloc(total + sizeof(alloc_hdr_t)), total, __builtin_return_address(0));
+    if (ptr)
+        memset(ptr, 0, total);
+    return ptr;
+}
+
+void * IRAM realloc(void *ptr, size_t size)
+{
+    void *caller = __builtin_return_address(0);
+
+    if (size & HDR_MAGIC_MASK)
+        return NULL;
+    if (!ptr)
+        return track(base_malloc(size + sizeof(alloc_hdr_t)), size, caller);
+
+    alloc_hdr_t *hdr = get_hdr(ptr);
+    if (!hdr)
+        return base_realloc(ptr, size);
+
+    /* Untrack first, the header may move */
+    malloc_site_stats_t *old_site = hdr->site;
+    uint32_t old_size = hdr->size & ~HDR_MAGIC_MASK;
+    untrack(hdr);
+    alloc_hdr_t *new_hdr = base_realloc(hdr, size + sizeof(alloc_hdr_t));
+    if (!new_hdr) {
+        /* Old block is still valid, put it back as it was */
+        uint32_t old_level = _xt_disable_interrupts();
+        hdr->site = old_site;
+        hdr->size = old_size | HDR_MAGIC;
+        old_site->in_use += old_size;
+        stats.in_use += old_size;
+        stats.failures++;
+        _xt_restore_interrupts(old_level);
+        return NULL;
+    }
+    return track(new_hdr, size, caller);
+}
+
+void malloc_stats_get(malloc_stats_t *out)
+{
+    uint32_t old_level = _xt_disable_interrupts();
+    *out = stats;
+    _xt_restore_interrupts(old_level);
+}
+
+bool malloc_stats_get_site(size_t i, malloc_site_stats_t *site)
+{
+    if (i < num_sites) {
+        *site = sites[i];
+        return true;
+    }
+    if (i == num_sites && sites[MALLOC_STATS_SITES].allocs) {
+        *site = sites[MALLOC_STATS_SITES];
+        return true;
+    }
+    return false;
+}
+
+size_t malloc_stats_largest_free(void)
+{
+    size_t lo = 0, hi = xPortGetFreeHeapSize();
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo + 1) / 2;
+        void *p = _malloc_r(_REENT, mid);
+        if (p) {
+            _free_r(_REENT, p);
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return lo;
+}
+
+void malloc_stats_dump(void)
+{
+    malloc_stats_t s;
+    malloc_site_stats_t site;
+
+    malloc_stats_get(&s);
+    printf("heap: %u in use, %u peak, %u allocs, %u failed\n",
+           s.in_use, s.peak, s.allocs, s.failures);
+    printf("heap: %u free, %u min free, %u largest block\n",
+           (uint32_t)xPortGetFreeHeapSize(), s.min_free, (uint32_t)malloc_stats_largest_free());
+    printf("heap: caller       in use     peak   allocs\n");
+    for (size_t i = 0; malloc_stats_get_site(i, &site); i++) {
+        printf("heap: %p %8u %8u %8u\n", site.caller, site.in_use, site.peak, site.allocs);
+    }
+}
+
+#endif /* MALLOC_STATS */
@@ -0,0 +1,122 @@
+/* memmove() in IRAM, a word at a time
+ *
+ * Replaces newlib's, which for this target is the generic C version: it
+ * falls back to byte copies whenever either pointer is unaligned, and
+ * lwIP and the drivers do most of their overlapping moves (shifting
+ * partly consumed buffers down) at odd offsets. newlib's memcpy and
+ * memset are already the Xtensa assembly versions, linked into IRAM by
+ * ld/common.ld, so those are left as they are.
+ *
+ * Buffers that don't overlap go to memcpy. Overlapping ones are copied
+ * towards the destination end that is safe: the destination is brought
+ * to word alignment with byte copies, then whole words are stored, each
+ * one either loaded directly or (source misaligned relative to the
+ * destination) built from two aligned loads. Every word is loaded before
+ * any store could reach it. Aligned loads may touch up to three bytes
+ * outside the source, but never outside the words holding it, which is
+ * harmless in RAM.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <string.h>
+#include <stdint.h>
+#include <common_macros.h>
+
+static void IRAM move_down(uint8_t *d, const uint8_t *s, size_t n)
+{
+    while (n && ((uintptr_t)d & 3)) {
+        *d++ = *s++;
+        n--;
+    }
+
+    unsigned shift = ((uintptr_t)s & 3) * 8;
+    uint32_t *dw = (uint32_t *)d;
+    size_t words = n / 4;
+
+    if (!shift) {
+        const uint32_t *sw = (const uint32_t *)s;
+        for (; words >= 4; words -= 4) {
+            uint32_t w0 = sw[0], w1 = sw[1], w2 = sw[2], w3 = sw[3];
+            dw[0] = w0;
+            dw[1] = w1;
+            dw[2] = w2;
+            dw[3] = w3;
+            dw += 4;
+            sw += 4;
+        }
+        while (words--)
+            *dw++ = *sw++;
+    } else if (words) {
+        const uint32_t *sw = (const uint32_t *)((uintptr_t)s & ~3);
+        uint32_t lo = *sw++;
+        while (words--) {
+            uint32_t hi = *sw++;
+            *dw++ = (lo >> shift) | (hi << (32 - shift));
+            lo = hi;
+        }
+    }
+
+    s += (uint8_t *)dw - d;
+    d = (uint8_t *)dw;
+    n &= 3;
+    while (n--)
+        *d++ = *s++;
+}
+
+static void IRAM move_up(uint8_t *d, const uint8_t *s, size_t n)
+{
+    d += n;
+    s += n;
+    while (n && ((uintptr_t)d & 3)) {
+        *--d = *--s;
+        n--;
+    }
+
+    unsigned shift = ((uintptr_t)s & 3) * 8;
+    uint32_t *dw = (uint32_t *)d;
+    size_t words = n / 4;
+
+    if (!shift) {
+        const uint32_t *sw = (const uint32_t *)s;
+        for (; words >= 4; words -= 4) {
+            dw -= 4;
+            sw -= 4;
+            uint32_t w0 = sw[0], w1 = sw[1], w2 = sw[2], w3 = sw[3];
+            dw[3] = w3;
+            dw[2] = w2;
+            dw[1] = w1;
+            dw[0] = w0;
+        }
+        while (words--)
+            *--dw = *--sw;
+    } else if (words) {
+        const uint32_t *sw = (const uint32_t *)((uintptr_t)s & ~3);
+        uint32_t hi = *sw;
+        while (words--) {
+            uint32_t lo = *--sw;
+            *--dw = (lo >> shift) | (hi << (32 - shift));
+            hi = lo;
+        }
+    }
+
+    s -= d - (uint8_t *)dw;
+    d = (uint8_t *)dw;
+    n &= 3;
+    while (n--)
+        *--d = *--s;
+}
+
+void * IRAM memmove(void *dst, const void *src, size_t n)
+{
+    uintptr_t d = (uintptr_t)dst, s = (uintptr_t)src;
+
+    if (d - s >= n && s - d >= n)
+        return memcpy(dst, src, n);
+    if (d < s)
+        move_down(dst, src, n);
+    else if (d > s)
+        move_up(dst, src, n);
+    return dst;
+}
@@ -11,28 +11,56 @@
 #include <common_macros.h>
 #include <esp/uart.h>
 #include <stdlib.h>
+#include <sbrk.h>
+#include <FreeRTOS.h>
+#include <sys/time.h>
+#include <timeofday.h>
+#include <lwip/sys.h>
+#include <task.h>
+#include <xtensa_ops.h>
+
+void __attribute__((weak)) sbrk_failed_hook(ptrdiff_t incr)
+{
+}
 
 IRAM caddr_t _sbrk_r (struct _reent *r, int incr)
 {
     extern char   _heap_start; /* linker script defined */
     static char * heap_end;
     char *        prev_heap_end;
+    uint32_t      stack_ptr = xPortSupervisorStackPointer;
 
     if (heap_end == NULL)
 	heap_end = &_heap_start;
     prev_heap_end = heap_end;
-    /* TODO: Check stack collision
-       if (heap_end + incr > stack_ptr)
-       {
-       _write (1, "_sbrk: Heap collided with stack\n", 32);
-       while(1) {}
-       }
-    */
+
+    if (stack_ptr == 0) /* scheduler not started */
+        __asm__ __volatile__ ("mov %0, a1\n" : "=a"(stack_ptr));
+    if (incr > 0 && (uint32_t)heap_end + incr > stack_ptr - SBRK_STACK_RESERVE)
+    {
+        r->_errno = ENOMEM;
+        sbrk_failed_hook(incr);
+        return (caddr_t) -1;
+    }
     heap_end += incr;
 
     return (caddr_t) prev_heap_end;
 }
 
+#if configUSE_NEWLIB_REENTRANT == 2
+/* errno is where a task first needs its own reent (see
+   FreeRTOSConfig.h). An interrupt keeps to whichever reent is current,
+   it can't allocate. */
+int *__errno(void)
+{
+    uint32_t ps;
+    RSR(ps, ps);
+    if (ps & 0xf)
+        return &_impure_ptr->_errno;
+    return &pxTaskClaimNewlibReent()->_errno;
+}
+#endif
+
 /* syscall implementation for stdio write to UART */
 long _write_r(struct _reent *r, int fd, const char *ptr, int len )
 {
@@ -40,6 +68,20 @@ long _write_r(struct _reent *r, int fd, const char *ptr, int len )
         r->_errno = EBADF;
         return -1;
     }
+    if(uart_tx_buffered(0)) {
+        /* Hand the ring whole runs of characters between line endings */
+        int start = 0;
+        for(int i = 0; i < len; i++) {
+            if(ptr[i] != '\r' && ptr[i] != '\n')
+                continue;
+            uart_write(0, ptr + start, i - start);
+            if(ptr[i] == '\n')
+                uart_write(0, "\r\n", 2);
+            start = i + 1;
+        }
+        uart_write(0, ptr + start, len - start);
+        return len;
+    }
     for(int i = 0; i < len; i++) {
         /* Auto convert CR to CRLF, ignore other LFs (compatible with Espressif SDK behaviour) */
         if(ptr[i] == '\r')
@@ -51,15 +93,11 @@ long _write_r(struct _reent *r, int fd, const char *ptr, int len )
     return len;
 }
 
-/* syscall implementation for stdio read from UART */
-__attribute__((weak)) long _read_r( struct _reent *r, int fd, char *ptr, int len )
+/* stdio read from UART, can be overridden (see extras/stdin_uart_interrupt) */
+__attribute__((weak)) long _read_stdin_r( struct _reent *r, int fd, char *ptr, int len )
 {
     int ch, i;
 
-    if(fd != r->_stdin->_file) {
-        r->_errno = EBADF;
-        return -1;
-    }
     uart_rxfifo_wait(0, 1);
     for(i = 0; i < len; i++) {
         ch = uart_getc_nowait(0);
@@ -69,13 +107,54 @@ __attribute__((weak)) long _read_r( struct _reent *r, int fd, char *ptr, int len
     return i;
 }
 
+/* Reads from any other descriptor go to a filesystem component
+   (see extras/romfs), if one is linked in */
+__attribute__((weak, alias("syscall_returns_enosys"))) long _read_file_r(struct _reent *r, int fd, char *ptr, int len);
+
+/* syscall implementation for stdio read */
+long _read_r( struct _reent *r, int fd, char *ptr, int len )
+{
+    if(fd == r->_stdin->_file)
+        return _read_stdin_r(r, fd, ptr, len);
+    return _read_file_r(r, fd, ptr, len);
+}
+
+/* newlib's gettimeofday() and time() come here */
+int _gettimeofday_r(struct _reent *r, struct timeval *tv, void *tz)
+{
+    if (tv) {
+        int64_t now = timeofday_us();
+        tv->tv_sec = now / 1000000;
+        tv->tv_usec = now % 1000000;
+    }
+    return 0;
+}
+
+int clock_gettime(clockid_t clock_id, struct timespec *tp)
+{
+    int64_t now;
+
+    if (clock_id == CLOCK_REALTIME)
+        now = timeofday_us();
+    else if (clock_id == CLOCK_MONOTONIC)
+        now = sys_uptime_us();
+    else {
+        errno = EINVAL;
+        return -1;
+    }
+    tp->tv_sec = now / 1000000;
+    tp->tv_nsec = (now % 1000000) * 1000;
+    return 0;
+}
+
 /* Stub syscall implementations follow, to allow compiling newlib functions that
-   pull these in via various codepaths
+   pull these in via various codepaths. They're weak so that a filesystem
+   component can provide real ones.
 */
-__attribute__((alias("syscall_returns_enosys"))) int _open_r(struct _reent *r, const char *pathname, int flags, int mode);
-__attribute__((alias("syscall_returns_enosys"))) int _fstat_r(struct _reent *r, int fd, void *buf);
-__attribute__((alias("syscall_returns_enosys"))) int _close_r(struct _reent *r, int fd);
-__attribute__((alias("syscall_returns_enosys"))) off_t _lseek_r(struct _reent *r, int fd, off_t offset, int whence);
+__attribute__((weak, alias("syscall_returns_enosys"))) int _open_r(struct _reent *r, const char *pathname, int flags, int mode);
+__attribute__((weak, alias("syscall_returns_enosys"))) int _fstat_r(struct _reent *r, int fd, void *buf);
+__attribute__((weak, alias("syscall_returns_enosys"))) int _close_r(struct _reent *r, int fd);
+__attribute__((weak, alias("syscall_returns_enosys"))) off_t _lseek_r(struct _reent *r, int fd, off_t offset, int whence);
 
 /* Generic stub for any newlib syscall that fails with errno ENOSYS
    ("Function not implemented") and a return value equivalent to
@@ -0,0 +1,127 @@
+/* Implementation of libmain/timers.o from the Espressif SDK.
+ *
+ * The os_timer functions, which the WiFi libraries use for their
+ * timeouts, on top of FreeRTOS software timers. The SDK's version
+ * converts milliseconds to ticks by dividing by 10, which is only right
+ * at the default 100Hz tick; this one uses portTICK_RATE_MS, so the
+ * SDK's timers keep time at any configTICK_RATE_HZ.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <timers.h>
+
+#include "espressif/esp_common.h"
+
+/* Block time for the timer task's command queue, as the SDK uses */
+#define TIMER_CMD_TICKS 50
+
+/* Timer structures are often on the stack or in uninitialised memory,
+   so their freerots_handle is only trusted once sdk_os_timer_setfn()
+   has seen them. As in the SDK, these are never freed. A separate list,
+   because timer_next belongs to the ets_timer functions. */
+struct timer_entry {
+    struct timer_entry *next;
+    sdk_os_timer_t *timer;
+};
+
+static struct timer_entry *timer_list;
+
+static void timer_callback(xTimerHandle handle)
+{
+    sdk_os_timer_t *timer = pvTimerGetTimerID(handle);
+
+    timer->timer_func(timer->timer_arg);
+}
+
+static portTickType ms_to_ticks(uint32_t ms)
+{
+    portTickType ticks = (ms + portTICK_RATE_MS - 1) / portTICK_RATE_MS;
+
+    /* FreeRTOS timers can't have a zero period */
+    return ticks ? ticks : 1;
+}
+
+static void delete_timer(sdk_os_timer_t *timer)
+{
+    if (xTimerDelete(timer->freerots_handle, TIMER_CMD_TICKS) != pdPASS) {
+        printf("Timer Delete Failed\n");
+    }
+    timer->freerots_handle = NULL;
+}
+
+void sdk_os_timer_setfn(sdk_os_timer_t *timer, sdk_os_timer_func_t *func, void *arg)
+{
+    struct timer_entry *entry, *new_entry = NULL;
+
+    vTaskSuspendAll();
+    for (entry = timer_list; entry; entry = entry->next) {
+        if (entry->timer == timer) {
+            break;
+        }
+    }
+    xTaskResumeAll();
+
+    if (entry) {
+        if (timer->freerots_handle) {
+            delete_timer(timer);
+        }
+    } else {
+        new_entry = malloc(sizeof(struct timer_entry));
+    }
+
+    timer->freerots_handle = NULL;
+    timer->timer_period = 0;
+    timer->timer_repeat_flag = false;
+    timer->timer_func = func;
+    timer->timer_arg = arg;
+
+    if (new_entry) {
+        new_entry->timer = timer;
+        vTaskSuspendAll();
+        new_entry->next = timer_list;
+        timer_list = new_entry;
+        xTaskResumeAll();
+    }
+}
+
+void sdk_os_timer_arm(sdk_os_timer_t *timer, uint32_t ms, bool repeat)
+{
+    portTickType ticks = ms_to_ticks(ms);
+
+    /* Auto reload is fixed when a FreeRTOS timer is created */
+    if (timer->freerots_handle && timer->timer_repeat_flag != repeat) {
+        delete_timer(timer);
+    }
+
+    if (!timer->freerots_handle) {
+        timer->freerots_handle = xTimerCreate((signed char *)"os_timer", ticks,
+                                              repeat, timer, timer_callback);
+        if (!timer->freerots_handle) {
+            printf("Timer Create Failed\n");
+            return;
+        }
+    } else if (timer->timer_period != ms) {
+        /* Also starts it, the xTimerStart() below then restarts it as the
+           SDK's version does */
+        xTimerChangePeriod(timer->freerots_handle, ticks, TIMER_CMD_TICKS);
+    }
+    timer->timer_period = ms;
+    timer->timer_repeat_flag = repeat;
+
+    if (xTimerStart(timer->freerots_handle, TIMER_CMD_TICKS) != pdPASS) {
+        printf("Timer Start Failed\n");
+    }
+}
+
+void sdk_os_timer_disarm(sdk_os_timer_t *timer)
+{
+    if (timer->freerots_handle && xTimerStop(timer->freerots_handle, TIMER_CMD_TICKS) != pdPASS) {
+        printf("Timer Stop Failed\n");
+    }
+}
@@ -0,0 +1,118 @@
+/* Disciplined time of day, see timeofday.h
+ *
+ * The clock is kept as a segment anchored at an uptime: at uptime
+ * base_up it read base_t, and it has since moved on by the elapsed
+ * uptime d, plus the frequency correction d*rate/2^32, plus the part of
+ * the pending slew worked off so far (d/2048, up to the whole slew).
+ * Every change re-anchors the segment at the present first, so the
+ * clock is continuous across adjustments and its rate never drops below
+ * 1 - 500ppm - 488ppm of the uptime: it can't run backwards.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <timeofday.h>
+
+#include <esp/interrupts.h>
+#include <lwip/sys.h>
+
+/* Slew rate, 2^-SLEW_SHIFT (~488ppm) */
+#define SLEW_SHIFT 11
+
+/* Re-anchor at least this often (in us, ~19h) so d*rate can't overflow */
+#define MAX_SEGMENT (1ULL << 36)
+
+static uint64_t base_up;
+static int64_t base_t;
+static int64_t slew;        /* still to apply at base_up */
+static int32_t rate;        /* frequency correction, 2^-32 units */
+static int32_t freq_ppb;
+static bool is_set;
+
+/* Clock reading at uptime 'up', and the slew still left then */
+static int64_t segment_at(uint64_t up, int64_t *slew_left)
+{
+    uint64_t d = up - base_up;
+    int64_t done = d >> SLEW_SHIFT;
+    if (slew >= 0 ? done > slew : done > -slew)
+        done = slew >= 0 ? slew : -slew;
+    if (slew < 0)
+        done = -done;
+    if (slew_left)
+        *slew_left = slew - done;
+    return base_t + (int64_t)d + (((int64_t)d * rate) >> 32) + done;
+}
+
+/* Start a new segment now, with interrupts disabled */
+static void reanchor(void)
+{
+    uint64_t up = sys_uptime_us();
+    int64_t left;
+    base_t = segment_at(up, &left);
+    base_up = up;
+    slew = left;
+}
+
+int64_t timeofday_us(void)
+{
+    uint32_t old_level = _xt_disable_interrupts();
+    uint64_t up = sys_uptime_us();
+    if (up - base_up >= MAX_SEGMENT)
+        reanchor();
+    int64_t now = segment_at(up, NULL);
+    _xt_restore_interrupts(old_level);
+    return now;
+}
+
+bool timeofday_is_set(void)
+{
+    return is_set;
+}
+
+void timeofday_set_us(int64_t unix_us)
+{
+    uint32_t old_level = _xt_disable_interrupts();
+    base_up = sys_uptime_us();
+    base_t = unix_us;
+    slew = 0;
+    is_set = true;
+    _xt_restore_interrupts(old_level);
+}
+
+void timeofday_adjust(int64_t offset_us)
+{
+    uint32_t old_level = _xt_disable_interrupts();
+    reanchor();
+    slew = offset_us;
+    _xt_restore_interrupts(old_level);
+}
+
+int64_t timeofday_adjust_remaining(void)
+{
+    int64_t left;
+    uint32_t old_level = _xt_disable_interrupts();
+    segment_at(sys_uptime_us(), &left);
+    _xt_restore_interrupts(old_level);
+    return left;
+}
+
+void timeofday_set_freq(int32_t ppb)
+{
+    if (ppb > TIMEOFDAY_MAX_FREQ_PPB)
+        ppb = TIMEOFDAY_MAX_FREQ_PPB;
+    else if (ppb < -TIMEOFDAY_MAX_FREQ_PPB)
+        ppb = -TIMEOFDAY_MAX_FREQ_PPB;
+    int32_t new_rate = (int64_t)ppb * 4294967296LL / 1000000000;
+
+    uint32_t old_level = _xt_disable_interrupts();
+    reanchor();
+    rate = new_rate;
+    freq_ppb = ppb;
+    _xt_restore_interrupts(old_level);
+}
+
+int32_t timeofday_get_freq(void)
+{
+    return freq_ppb;
+}
@@ -0,0 +1,87 @@
+/* Steady rate ADC sampling with extras/adc_stream
+ *
+ * Samples the ADC pin 2000 times a second, each sample the average of
+ * 4 readings, and once a second prints the mean, RMS of the AC part and
+ * peak to peak of the last block, as for a vibration or current sensor
+ * (with a CT clamp on half the ADC range, say).
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include <stdio.h>
+
+#include "adc_stream/adc_stream.h"
+
+#define RATE_HZ 2000
+#define AVERAGE 4
+
+/* No libm in the default link, and integers will do */
+static uint32_t isqrt(uint32_t x)
+{
+    uint32_t r = 0;
+
+    for (uint32_t bit = 1 << 30; bit; bit >>= 2) {
+        if (x >= r + bit) {
+            x -= r + bit;
+            r = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+    }
+    return r;
+}
+
+static void sample_task(void *pvParameters)
+{
+    uint32_t blocks = 0;
+
+    if (!adc_stream_start(RATE_HZ, AVERAGE)) {
+        printf("Can't sample at %u Hz\n", RATE_HZ * AVERAGE);
+        vTaskDelete(NULL);
+    }
+
+    while (1) {
+        const uint16_t *block = adc_stream_read(1000 / portTICK_RATE_MS);
+        if (!block) {
+            printf("No samples?\n");
+            continue;
+        }
+
+        /* A block is 128ms at this rate, print about once a second */
+        if (++blocks % 8)
+            continue;
+
+        uint32_t sum = 0;
+        uint16_t min = 0xffff, max = 0;
+        for (int i = 0; i < ADC_STREAM_BLOCK; i++) {
+            sum += block[i];
+            if (block[i] < min)
+                min = block[i];
+            if (block[i] > max)
+                max = block[i];
+        }
+        int mean = sum / ADC_STREAM_BLOCK;
+        uint32_t sq = 0;
+        for (int i = 0; i < ADC_STREAM_BLOCK; i++) {
+            int ac = block[i] - mean;
+            sq += ac * ac;
+        }
+
+        adc_stream_stats_t stats;
+        adc_stream_stats(&stats);
+        printf("mean %4d rms %4u p-p %4u | %u blocks, %u dropped, isr max %u cycles\n",
+               mean, isqrt(sq / ADC_STREAM_BLOCK), max - min,
+               stats.blocks, stats.dropped, stats.isr_cycles_max);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    xTaskCreate(sample_task, (signed char *)"sample", 256, NULL, 3, NULL);
+}
@@ -0,0 +1,49 @@
+/* apcache_reconnect - Reconnect quickly when the AP goes away.
+ *
+ * Uses extras/apcache to reconnect to the last BSSID and channel the
+ * station used before scanning every channel. Prints how long each
+ * connect took: power cycle the AP to see the difference between the
+ * first connect and the following ones.
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+
+#include <stdio.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "ssid_config.h"
+#include "apcache/apcache.h"
+
+#define CONNECT_TIMEOUT_MS 15000
+
+static void wifi_task(void *pvParameters)
+{
+    portTickType start = xTaskGetTickCount();
+    bool ok = apcache_connect(WIFI_SSID, WIFI_PASS, CONNECT_TIMEOUT_MS);
+
+    for (;;) {
+        printf("%s after %u ms\n", ok ? "connected" : "not connected",
+               (xTaskGetTickCount() - start) * portTICK_RATE_MS);
+
+        if (ok) {
+            while (sdk_wifi_station_get_connect_status() == STATION_GOT_IP)
+                vTaskDelay(100 / portTICK_RATE_MS);
+            printf("connection lost\n");
+        }
+
+        start = xTaskGetTickCount();
+        ok = apcache_reconnect(CONNECT_TIMEOUT_MS);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    xTaskCreate(wifi_task, (signed char *)"wifi", 512, NULL, 2, NULL);
+}
@@ -0,0 +1,102 @@
+/* Logging from a 1 kHz timer interrupt with extras/binlog
+ *
+ * The FRC1 handler logs a record every 100 interrupts and the task
+ * below logs how long a BINLOG_INFO() takes, in CPU cycles; the records
+ * come out (as text, or raw with make BINLOG_HOST=1 for
+ * utils/binlog_decode.py) from binlog's low priority task, or go to a
+ * syslog server in batches with make SYSLOG_SERVER=<address>. The
+ * BINLOG_DEBUG() calls are compiled out at the default level.
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "esp8266.h"
+#include "esp/perf.h"
+
+#include "binlog/binlog.h"
+#include "binlog/binlog_syslog.h"
+
+#ifdef SYSLOG_SERVER
+#include "ssid_config.h"
+#include "lwip/ip_addr.h"
+#endif
+
+static const int freq_frc1 = 1000;
+
+static volatile uint32_t frc1_count;
+
+static const char *phase_names[] = { "rising", "falling" };
+
+void frc1_interrupt_handler(void)
+{
+    uint32_t n = ++frc1_count;
+
+    if (n % 100 == 0)
+        BINLOG_INFO("frc1 tick %u, phase %s", n, phase_names[n / 100 % 2]);
+    BINLOG_DEBUG("frc1 tick %u", n);
+}
+
+static void log_task(void *pvParameters)
+{
+    uint32_t round = 0;
+
+#ifdef SYSLOG_SERVER
+    /* Records logged until it's up wait in the ring */
+    while (sdk_wifi_station_get_connect_status() != STATION_GOT_IP)
+        vTaskDelay(100 / portTICK_RATE_MS);
+    ip_addr_t server;
+    server.addr = ipaddr_addr(SYSLOG_SERVER);
+    binlog_syslog_start(&server, BINLOG_SYSLOG_PORT, "binlog_demo", tskIDLE_PRIORITY + 1);
+#endif
+
+    while (1) {
+        uint32_t start = perf_ccount();
+        BINLOG_INFO("round %u", round);
+        uint32_t end = perf_ccount();
+
+        BINLOG_WARN("BINLOG_INFO took %u cycles, %u records dropped so far",
+                    end - start, binlog_dropped());
+        if (round % 10 == 0) {
+            BINLOG_ERROR("a made up error, errno %d", -(int)round);
+#ifdef SYSLOG_SERVER
+            binlog_syslog_stats_t stats;
+            binlog_syslog_stats(&stats);
+            BINLOG_INFO("syslog: %u records in %u datagrams, %u rate limited, %u errors",
+                        stats.records, stats.datagrams, stats.rate_limited, stats.send_errors);
+#endif
+        }
+        round++;
+        vTaskDelay(1000 / portTICK_RATE_MS);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+
+#ifdef SYSLOG_SERVER
+    struct sdk_station_config config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+    };
+
+    /* required to call wifi_set_opmode before station_set_config */
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_station_set_config(&config);
+#elif defined(BINLOG_HOST)
+    binlog_start(tskIDLE_PRIORITY + 1, BINLOG_OUTPUT_HOST);
+#else
+    binlog_start(tskIDLE_PRIORITY + 1, BINLOG_OUTPUT_TEXT);
+#endif
+    xTaskCreate(log_task, (signed char *)"log", 256, NULL, 2, NULL);
+
+    timer_set_interrupts(FRC1, false);
+    timer_set_run(FRC1, false);
+    _xt_isr_attach(INUM_TIMER_FRC1, frc1_interrupt_handler);
+    timer_set_frequency(FRC1, freq_frc1);
+    timer_set_interrupts(FRC1, true);
+    timer_set_run(FRC1, true);
+}
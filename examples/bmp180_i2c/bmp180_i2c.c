@@ -74,7 +74,7 @@ void bmp180_task(void *pvParameters)
             break;
         case MY_EVT_BMP180:
             printf("%s: Received BMP180 Event temp:=%d.%d°C press=%d.%02dhPa\n", __FUNCTION__, \
-                       (int32_t)ev.bmp180_data.temperature, abs((int32_t)(ev.bmp180_data.temperature*10)%10), \
+                       BMP180_TEMP_TENTHS(ev.bmp180_data.temperature) / 10, abs(BMP180_TEMP_TENTHS(ev.bmp180_data.temperature) % 10), \
                        ev.bmp180_data.pressure/100, ev.bmp180_data.pressure%100 );
             break;
         default:
@@ -0,0 +1,69 @@
+/* boot_time - Report where the time goes from reset to a Wi-Fi connection.
+ *
+ * Prints the boot marks recorded by the startup code (see esp/boot.h),
+ * plus a "sensor" mark standing in for the work a sensor node does
+ * right after waking, and a "got_ip" mark once the station has its
+ * address.
+ *
+ * Build with
+ *
+ *     make flash EXTRA_CFLAGS=-DBOOT_DEFER_NETWORKING=1
+ *
+ * to see the sensor reading happen before Wi-Fi is initialised.
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "esp/boot.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "ssid_config.h"
+
+static void set_station_config(void)
+{
+    struct sdk_station_config config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+    };
+
+    /* required to call wifi_set_opmode before station_set_config */
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_station_set_config(&config);
+}
+
+static void boot_time_task(void *pvParameters)
+{
+    /* Pretend to read a sensor */
+    vTaskDelay(1);
+    boot_mark("sensor");
+
+    if (!boot_networking_started()) {
+        boot_start_networking();
+        set_station_config();
+    }
+
+    while (sdk_wifi_station_get_connect_status() != STATION_GOT_IP) {
+        vTaskDelay(10 / portTICK_RATE_MS);
+    }
+    boot_mark("got_ip");
+
+    boot_report();
+
+    while (1) {
+        vTaskDelay(10000 / portTICK_RATE_MS);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+
+    if (boot_networking_started()) {
+        set_station_config();
+    }
+
+    xTaskCreate(boot_time_task, (signed char *)"boot_time", 384, NULL, 2, NULL);
+}
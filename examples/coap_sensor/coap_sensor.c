@@ -0,0 +1,128 @@
+/* coap_sensor - A CoAP server with an observable sensor, and a client.
+ *
+ * Serves, on the standard CoAP port:
+ *
+ *   sensors/status  JSON uptime and free heap, observable, and pushed
+ *                   to observers every 5 seconds
+ *   led             GET or PUT "0"/"1", the LED on GPIO2
+ *
+ * Try it with libcoap's client, e.g.
+ *   coap-client -m get -s 60 coap://<address>/sensors/status
+ *   coap-client -m put -e 1 coap://<address>/led
+ *
+ * Built with COAP_PEER set to another node's address, it also polls
+ * that node's sensors/status every 10 seconds, each a single request
+ * and response datagram.
+ *
+ * This sample code is in the public domain.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include <espressif/esp_common.h>
+#include <esp/uart.h>
+#include <esp/gpio.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <lwip/ip_addr.h>
+
+#include "ssid_config.h"
+#include "coap/coap.h"
+
+static const int led_gpio = 2;
+static bool led_on;
+
+static uint8_t status_handler(const coap_request_t *req, uint8_t *buf, size_t *len)
+{
+    if (req->method != COAP_GET)
+        return COAP_METHOD_NOT_ALLOWED;
+    *len = snprintf((char *)buf, *len, "{\"uptime\":%u,\"heap\":%u}",
+                    xTaskGetTickCount() / configTICK_RATE_HZ,
+                    sdk_system_get_free_heap_size());
+    return COAP_CONTENT;
+}
+
+static uint8_t led_handler(const coap_request_t *req, uint8_t *buf, size_t *len)
+{
+    switch (req->method) {
+    case COAP_GET:
+        *len = snprintf((char *)buf, *len, "%d", led_on);
+        return COAP_CONTENT;
+    case COAP_PUT:
+        if (req->len != 1 || (req->payload[0] != '0' && req->payload[0] != '1'))
+            return COAP_BAD_REQUEST;
+        led_on = req->payload[0] == '1';
+        gpio_write(led_gpio, !led_on);  /* active low */
+        return COAP_CHANGED;
+    default:
+        return COAP_METHOD_NOT_ALLOWED;
+    }
+}
+
+static const coap_resource_t resources[] = {
+    { "sensors/status", COAP_FORMAT_JSON, true, status_handler },
+    { "led", COAP_FORMAT_TEXT, false, led_handler },
+};
+
+static void coap_task(void *pvParameters)
+{
+    while (sdk_wifi_station_get_connect_status() != STATION_GOT_IP)
+        vTaskDelay(100 / portTICK_RATE_MS);
+
+    if (!coap_start(COAP_PORT, resources, sizeof(resources) / sizeof(resources[0]))) {
+        printf("coap_start failed\n");
+        vTaskDelete(NULL);
+    }
+    struct ip_info info;
+    sdk_wifi_get_ip_info(STATION_IF, &info);
+    printf("Serving coap://" IPSTR "/\n", IP2STR(&info.ip));
+
+#ifdef COAP_PEER
+    ip_addr_t peer;
+    peer.addr = ipaddr_addr(COAP_PEER);
+#endif
+    for (int n = 0;; n++) {
+        vTaskDelay(5000 / portTICK_RATE_MS);
+        int observers = coap_notify(&resources[0]);
+        if (observers)
+            printf("notified %d observers\n", observers);
+#ifdef COAP_PEER
+        if (n & 1) {
+            coap_client_request_t req = {
+                .method = COAP_GET,
+                .path = "sensors/status",
+                .content_format = COAP_FORMAT_NONE,
+            };
+            char body[64];
+            size_t len = sizeof(body) - 1;
+            uint8_t code;
+            if (coap_call(&peer, COAP_PORT, &req, &code, body, &len) != ERR_OK) {
+                printf("peer: no response\n");
+            } else {
+                body[len] = 0;
+                printf("peer: %d.%02d %s\n", COAP_CODE_CLASS(code), code & 31, body);
+            }
+        }
+#endif
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    gpio_enable(led_gpio, GPIO_OUTPUT);
+    gpio_write(led_gpio, 1);
+
+    struct sdk_station_config config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+    };
+
+    /* required to call wifi_set_opmode before station_set_config */
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_station_set_config(&config);
+
+    xTaskCreate(coap_task, (signed char *)"coap", 384, NULL, 2, NULL);
+}
@@ -0,0 +1,94 @@
+/* counters_report - The counter registry, over UDP and the UART.
+ *
+ * Counts a worker task's loops and the scheduling delay of each, as a
+ * histogram, next to the network counters netcounters.h registers.
+ * They can be read with
+ *
+ *     echo | nc -u -w1 <esp8266 address> 8009        (all counters)
+ *     echo delta | nc -u -w1 <esp8266 address> 8009  (since last delta)
+ *
+ * or by typing "counters" (or "delta") and return on the UART.
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "esp/counters.h"
+#include "esp/hrtimer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "netcounters.h"
+
+#include "ssid_config.h"
+
+#define COUNTERS_PORT 8009
+#define WORK_PERIOD_MS 20
+
+COUNTER_DEFINE(work_loops, "app.work.loops");
+HISTOGRAM_DEFINE(work_late, "app.work.late_us");
+
+static void work_task(void *pvParameters)
+{
+    portTickType last = xTaskGetTickCount();
+    uint32_t due = hrtimer_now_us() + WORK_PERIOD_MS * 1000;
+
+    while (1) {
+        vTaskDelayUntil(&last, WORK_PERIOD_MS / portTICK_RATE_MS);
+        uint32_t now = hrtimer_now_us();
+        int32_t late = now - due;
+        HISTOGRAM_RECORD(work_late, late > 0 ? late : 0);
+        COUNTER_INC(work_loops);
+        due += WORK_PERIOD_MS * 1000;
+    }
+}
+
+static void console_task(void *pvParameters)
+{
+    static counters_snapshot_t since;
+    bool have_since = false;
+    char line[16];
+    int len = 0;
+
+    while (1) {
+        int c = getchar();
+        if (c != '\r' && c != '\n') {
+            if (c >= 0 && len < sizeof(line) - 1)
+                line[len++] = c;
+            continue;
+        }
+        line[len] = 0;
+        len = 0;
+        if (!strcmp(line, "counters")) {
+            counters_dump(NULL);
+        } else if (!strcmp(line, "delta")) {
+            counters_dump(have_since ? &since : NULL);
+            counters_snapshot(&since);
+            have_since = true;
+        }
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    struct sdk_station_config config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+    };
+
+    /* required to call wifi_set_opmode before station_set_config */
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_station_set_config(&config);
+
+    if (!netcounters_udp_start(COUNTERS_PORT))
+        printf("Can't start the counters endpoint\n");
+    xTaskCreate(work_task, (signed char *)"work", 256, NULL, 3, NULL);
+    xTaskCreate(console_task, (signed char *)"console", 384, NULL, 2, NULL);
+}
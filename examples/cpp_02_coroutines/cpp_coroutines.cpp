@@ -0,0 +1,110 @@
+/* Many stackless coroutines sharing one task, see coroutine.hpp
+ *
+ * A producer coroutine posts a count to a queue every second, a consumer
+ * receives it and signals a group of workers, each sleeping for its own
+ * period after being signalled. All run on one FreeRTOS task.
+ *
+ * This sample code is in the public domain.
+ */
+#include "coroutine.hpp"
+
+#include "espressif/esp_common.h"
+
+#include "esp/uart.h"
+
+#include <stdio.h>
+
+using namespace esp_open_rtos::thread;
+
+#define WORKERS 16
+
+executor_t executor;
+co_event_t tick(executor);
+xQueueHandle counts;
+
+/******************************************************************************************************************
+ * producer_t
+ *
+ */
+class producer_t : public coroutine_t
+{
+    uint32_t count;
+
+    bool run()
+    {
+        CO_BEGIN();
+        for(count = 0;; count++) {
+            CO_SLEEP(1000);
+            xQueueSend(counts, &count, 0);
+            executor.wake();
+        }
+        CO_END();
+    }
+};
+/******************************************************************************************************************
+ * consumer_t
+ *
+ */
+class consumer_t : public coroutine_t
+{
+    uint32_t count;
+
+    bool run()
+    {
+        CO_BEGIN();
+        for(;;) {
+            CO_RECEIVE(counts, count);
+            printf("consumer: got %u at %lu ms\n", count, millis());
+            for(int i = 0; i < WORKERS; i++) {
+                tick.signal();
+            }
+        }
+        CO_END();
+    }
+};
+/******************************************************************************************************************
+ * worker_t
+ *
+ */
+class worker_t : public coroutine_t
+{
+public:
+    int id;
+
+private:
+    bool run()
+    {
+        CO_BEGIN();
+        for(;;) {
+            CO_WAIT(tick);
+            CO_SLEEP(10 * id);
+            printf("worker %d: done at %lu ms\n", id, millis());
+        }
+        CO_END();
+    }
+};
+/******************************************************************************************************************
+ * globals
+ *
+ */
+producer_t producer;
+consumer_t consumer;
+worker_t workers[WORKERS];
+
+/**
+ * 
+ */
+extern "C" void user_init(void)
+{
+    uart_set_baud(0, 115200);
+
+    counts = xQueueCreate(4, sizeof(uint32_t));
+
+    executor.spawn(producer);
+    executor.spawn(consumer);
+    for(int i = 0; i < WORKERS; i++) {
+        workers[i].id = i;
+        executor.spawn(workers[i]);
+    }
+    executor.task_create("coro", 512);
+}
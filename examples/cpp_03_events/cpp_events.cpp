@@ -0,0 +1,149 @@
+/*
+ * One task serving several sources, with a queue set and an event group
+ *
+ * The hub task blocks on a queue set holding two queues, fed by a fast
+ * and a slow producer, and handles whichever has data. Each time it has
+ * seen both since the last report it sets bits in an event group, which
+ * a FreeRTOS timer also sets once a second; the report task waits for
+ * all three.
+ *
+ * Without queue sets the hub would need a task per queue, or to poll
+ * them in turn with timeouts.
+ *
+ * This sample code is in the public domain.
+ */
+#include "task.hpp"
+#include "queue.hpp"
+#include "queue_set.hpp"
+#include "event_group.hpp"
+
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "timers.h"
+
+#include <stdio.h>
+
+using namespace esp_open_rtos::thread;
+
+enum {
+    FAST_SEEN   = 1 << 0,
+    SLOW_SEEN   = 1 << 1,
+    SECOND      = 1 << 2,
+};
+
+#define FAST_LENGTH 8
+#define SLOW_LENGTH 2
+
+static queue_t<uint32_t> fast_queue;
+static queue_t<uint32_t> slow_queue;
+static queue_set_t queue_set;
+static static_event_group_t events;
+
+/******************************************************************************************************************
+ * producer_t
+ *
+ */
+class producer_t: public task_t
+{
+public:
+    queue_t<uint32_t>* queue;
+    unsigned long period_ms;
+
+private:
+    void task()
+    {
+        for(uint32_t count = 0; ; count++) {
+            queue->post(count, 100);
+            sleep(period_ms);
+        }
+    }
+};
+
+/******************************************************************************************************************
+ * hub_t
+ *
+ */
+class hub_t: public task_t
+{
+private:
+    void task()
+    {
+        uint32_t fast_total = 0;
+
+        while(true) {
+            xQueueSetMemberHandle ready = queue_set.select(2000);
+            uint32_t value;
+
+            if(ready == fast_queue.handle()) {
+                fast_queue.receive(value);
+                fast_total += value;
+                events.set(FAST_SEEN);
+            }
+            else if(ready == slow_queue.handle()) {
+                slow_queue.receive(value);
+                printf("hub: slow %u, fast total %u\n", value, fast_total);
+                events.set(SLOW_SEEN);
+            }
+            else {
+                printf("hub: nothing for 2s\n");
+            }
+        }
+    }
+};
+
+/******************************************************************************************************************
+ * report_t
+ *
+ */
+class report_t: public task_t
+{
+private:
+    void task()
+    {
+        while(true) {
+            xEventBits bits = events.wait_all(FAST_SEEN | SLOW_SEEN | SECOND, 5000);
+
+            if((bits & (FAST_SEEN | SLOW_SEEN | SECOND)) == (FAST_SEEN | SLOW_SEEN | SECOND)) {
+                printf("report: both queues active in the last second\n");
+            }
+            else {
+                printf("report: timed out, bits 0x%x\n", bits);
+            }
+        }
+    }
+};
+
+static producer_t fast;
+static producer_t slow;
+static hub_t hub;
+static report_t report;
+
+static void second_timer(xTimerHandle timer)
+{
+    events.set(SECOND);
+}
+
+extern "C" void user_init(void)
+{
+    uart_set_baud(0, 115200);
+
+    fast_queue.queue_create(FAST_LENGTH);
+    slow_queue.queue_create(SLOW_LENGTH);
+    queue_set.queue_set_create(FAST_LENGTH + SLOW_LENGTH);
+    queue_set.add(fast_queue);
+    queue_set.add(slow_queue);
+    events.event_group_create();
+
+    fast.queue = &fast_queue;
+    fast.period_ms = 50;
+    slow.queue = &slow_queue;
+    slow.period_ms = 700;
+
+    fast.task_create("fast");
+    slow.task_create("slow");
+    hub.task_create("hub", 256, 3);
+    report.task_create("report");
+
+    xTimerHandle timer = xTimerCreate((signed char *)"second", 1000 / portTICK_RATE_MS, pdTRUE, NULL, second_timer);
+    xTimerStart(timer, 0);
+}
@@ -0,0 +1,9 @@
+/* cpufreq_governor FreeRTOSConfig overrides.
+
+   Turn on the CCOUNT-based run time stats counter, which extras/cpufreq
+   measures the load with.
+*/
+#define configGENERATE_RUN_TIME_STATS 1
+
+/* Use the defaults for everything else */
+#include_next<FreeRTOSConfig.h>
@@ -0,0 +1,67 @@
+/* cpufreq_governor - extras/cpufreq following a bursty load.
+ *
+ * The work task spends a few seconds crunching, then a few seconds
+ * mostly asleep. Once a second the load, the CPU clock and the
+ * governor's counters are printed: the clock goes to 160MHz soon after
+ * a burst starts, when the iterations per second double, and back to
+ * 80MHz a second or so after it ends.
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "esp/clocks.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "cpufreq/cpufreq.h"
+
+#include <stdio.h>
+
+#define BURST_MS 3000
+#define QUIET_MS 4000
+
+static volatile uint32_t iterations, sink;
+
+static void work_task(void *pvParameters)
+{
+    while (1) {
+        portTickType start = xTaskGetTickCount();
+        while ((xTaskGetTickCount() - start) * portTICK_RATE_MS < BURST_MS) {
+            /* Something for the CPU to do, as a TLS handshake would */
+            uint32_t x = sink;
+            for (int i = 0; i < 1000; i++)
+                x = x * 1103515245 + 12345;
+            sink = x;
+            iterations++;
+        }
+        vTaskDelay(QUIET_MS / portTICK_RATE_MS);
+    }
+}
+
+static void report_task(void *pvParameters)
+{
+    uint32_t last = 0;
+
+    while (1) {
+        vTaskDelay(1000 / portTICK_RATE_MS);
+        cpufreq_stats_t s;
+        cpufreq_stats(&s);
+        uint32_t n = iterations;
+        printf("load %3u%% at %uMHz, %5u iterations/s, up %u down %u, %u ms at 160MHz\n",
+               s.load, cpu_clk_freq() / 1000000, n - last, s.raises, s.lowers, s.ms_at_160);
+        last = n;
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+
+    if (!cpufreq_start(NULL, 4)) {
+        printf("cpufreq_start failed\n");
+        return;
+    }
+    xTaskCreate(work_task, (signed char *)"work", 256, NULL, 2, NULL);
+    xTaskCreate(report_task, (signed char *)"report", 256, NULL, 3, NULL);
+}
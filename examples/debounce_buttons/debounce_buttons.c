@@ -0,0 +1,51 @@
+/* debounce_buttons - several buttons, one task, no delay loops
+ *
+ * Buttons from GPIO0, GPIO4, GPIO5 and GPIO12 to ground (GPIO0 is the
+ * flash button on most boards), debounced by extras/debounce. A single
+ * task prints each press and release with how long the button was
+ * held.
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include <stdio.h>
+
+#include "debounce/debounce.h"
+
+#define SETTLE_US 20000
+
+static const uint8_t buttons[] = { 0, 4, 5, 12 };
+
+static void button_task(void *pvParameters)
+{
+    xQueueHandle events = xQueueCreate(8, sizeof(debounce_event_t));
+    uint32_t pressed_at[16] = { 0 };
+
+    debounce_init(events);
+    for (int i = 0; i < sizeof(buttons); i++)
+        debounce_add(buttons[i], SETTLE_US, true);
+
+    while (1) {
+        debounce_event_t ev;
+        xQueueReceive(events, &ev, portMAX_DELAY);
+        if (!ev.level) {
+            pressed_at[ev.gpio_num] = ev.time_us;
+            printf("GPIO%d pressed\n", ev.gpio_num);
+        } else {
+            printf("GPIO%d released after %u ms\n", ev.gpio_num,
+                   (ev.time_us - pressed_at[ev.gpio_num]) / 1000);
+        }
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    xTaskCreate(button_task, (signed char *)"buttons", 256, NULL, 2, NULL);
+}
@@ -0,0 +1,119 @@
+/* ds18b20_batch_sleep - Batched DS18B20 readings from deep sleep.
+ *
+ * Wakes every SAMPLE_S seconds to read the sensors on GPIO 13, and adds
+ * the readings (in tenths of a degree, a channel per sensor) to a
+ * samplebatch kept in RTC memory. The radio stays off on those wakes.
+ * Once the batch is due, every BATCH_SAMPLES wakes or BATCH_AGE_S
+ * seconds, the wake has the radio on, connects (with fastconnect) and
+ * broadcasts the batch as one UDP packet to port 8005. Receive it with
+ * python extras/samplebatch/samplebatch_decode.py --listen 8005
+ *
+ * GPIO16 needs to be connected to RST to wake up from deep sleep.
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "esp/rtcmem_regs.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "lwip/api.h"
+
+#include "ssid_config.h"
+#include "ds18b20/ds18b20.h"
+#include "fastconnect/fastconnect.h"
+#include "samplebatch/samplebatch.h"
+
+#define SENSOR_GPIO 13
+#define SAMPLE_S 60
+#define BATCH_SAMPLES 15
+#define BATCH_AGE_S 1800
+#define CONNECT_TIMEOUT_MS 10000
+#define REPORT_PORT 8005
+
+/* Seconds since power up, counted across sleeps, then the batch, in the
+   application's part of the user RTC memory. RTC memory is garbage
+   after power up, hence the magic number. */
+#define CLOCK_MAGIC RTCMEM_USER[0]
+#define CLOCK_SECONDS RTCMEM_USER[1]
+#define MAGIC 0x434c4b31
+#define BATCH_RTC_OFFSET 2
+
+_Static_assert(BATCH_RTC_OFFSET + SAMPLEBATCH_RTC_WORDS + FASTCONNECT_RTC_WORDS <= 128,
+               "Batch and fastconnect state don't fit in RTCMEM_USER");
+
+/* deep sleep option for the next wake: with or without the radio */
+#define WAKE_RF_ON 1
+#define WAKE_RF_OFF 4
+
+static samplebatch_t batch;
+
+static void send_batch(void)
+{
+    const void *data;
+    size_t len = samplebatch_packet(&batch, &data);
+    struct netconn *conn = netconn_new(NETCONN_UDP);
+
+    if (!conn)
+        return;
+    if (netconn_connect(conn, IP_ADDR_BROADCAST, REPORT_PORT) == ERR_OK) {
+        struct netbuf *buf = netbuf_new();
+        if (buf && netbuf_ref(buf, data, len) == ERR_OK && netconn_send(conn, buf) == ERR_OK) {
+            printf("sent %u samples in %u bytes\n", batch.count, len);
+            samplebatch_clear(&batch);
+        }
+        netbuf_delete(buf);
+    }
+    netconn_delete(conn);
+}
+
+static void sensor_task(void *pvParameters)
+{
+    if (CLOCK_MAGIC != MAGIC || !samplebatch_load_rtc(&batch, BATCH_RTC_OFFSET)) {
+        CLOCK_MAGIC = MAGIC;
+        CLOCK_SECONDS = 0;
+        samplebatch_init(&batch, BATCH_SAMPLES, 0, BATCH_AGE_S);
+    }
+    uint32_t now = CLOCK_SECONDS;
+
+    ds_sensor_t t[DS18B20_MAX_PER_BUS];
+    int n = ds18b20_read_all(SENSOR_GPIO, t);
+    for (int i = 0; i < n && i < SAMPLEBATCH_CHANNELS; i++)
+        samplebatch_add(&batch, i, now, (int32_t)(t[i].value * 10 + (t[i].value < 0 ? -0.5f : 0.5f)));
+
+    if (samplebatch_due(&batch, now)) {
+        fastconnect_start(WIFI_SSID, WIFI_PASS);
+        if (fastconnect_wait(CONNECT_TIMEOUT_MS)) {
+            send_batch();
+            fastconnect_save(SAMPLE_S * 1000);
+        } else {
+            printf("couldn't connect, keeping %u samples\n", batch.count);
+            fastconnect_invalidate();
+        }
+    } else {
+        printf("%u samples waiting\n", batch.count);
+    }
+    samplebatch_save_rtc(&batch, BATCH_RTC_OFFSET);
+
+    /* The radio is only needed next time if the batch is due by then */
+    CLOCK_SECONDS = now + SAMPLE_S;
+    bool due_next = batch.count + n >= BATCH_SAMPLES || samplebatch_due(&batch, now + SAMPLE_S);
+    sdk_system_deep_sleep_set_option(due_next ? WAKE_RF_ON : WAKE_RF_OFF);
+
+    printf("awake for %u ms\n", xTaskGetTickCount() * portTICK_RATE_MS);
+    uart_flush_txfifo(0);
+    sdk_system_deep_sleep(SAMPLE_S * 1000000);
+    while (1) {
+        vTaskDelay(1000 / portTICK_RATE_MS);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    xTaskCreate(sensor_task, (signed char *)"sensor", 512, NULL, 2, NULL);
+}
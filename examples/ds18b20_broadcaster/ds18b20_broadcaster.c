@@ -17,10 +17,30 @@
 #include "lwip/api.h"
 #include "ssid_config.h"
 
+// Sends all of a round's readings in one call into the stack
+#include "udpbatch/udpbatch.h"
+
 // DS18B20 driver
 #include "ds18b20/ds18b20.h"
 // Onewire init
 #include "onewire/onewire.h"
+#include "onewire/onewire_cache.h"
+
+#define DS18B20_FAMILY 0x28
+
+// Where the device cache is kept across resets, in RTCMEM_USER words
+#define CACHE_RTC_OFFSET 0
+
+static onewire_cache_t cache;
+static ds18b20_bus_t bus;
+
+// Measure the sensors in the cache, without searching the bus
+static void use_cache(void)
+{
+    bus.count = cache.count < DS18B20_MAX_PER_BUS ? cache.count : DS18B20_MAX_PER_BUS;
+    memcpy(bus.rom, cache.rom, bus.count * 8);
+    onewire_cache_save_rtc(&cache, CACHE_RTC_OFFSET);
+}
 
 void broadcast_temperature(void *pvParameters)
 {
@@ -32,13 +52,22 @@ void broadcast_temperature(void *pvParameters)
     // Use GPIO 13 as one wire pin. 
     uint8_t GPIO_FOR_ONE_WIRE = 13;
 
-    char msg[100];
+    char msg[sensors][100];
+    udp_batch_entry_t batch[sensors];
 
     // Broadcaster part
     err_t err;
     // Initialize one wire bus.
     onewire_init(GPIO_FOR_ONE_WIRE);
 
+    // The device list from before the reset, or a full search
+    if (!onewire_cache_load_rtc(&cache, CACHE_RTC_OFFSET) || cache.pin != GPIO_FOR_ONE_WIRE) {
+        onewire_cache_init(&cache, GPIO_FOR_ONE_WIRE, DS18B20_FAMILY);
+        onewire_cache_scan(&cache);
+    }
+    bus.pin = GPIO_FOR_ONE_WIRE;
+    use_cache();
+
     while(1) {
 
         // Send out some UDP data
@@ -65,8 +94,15 @@ void broadcast_temperature(void *pvParameters)
         }
 
         for(;;) {
-            // Search all DS18B20, return its amount and feed 't' structure with result data.
-            amount = ds18b20_read_all(GPIO_FOR_ONE_WIRE, t);
+            // Look for one sensor per loop, to notice ones plugged in or removed
+            int changes = onewire_cache_poll(&cache);
+            if (changes & (ONEWIRE_CACHE_ADDED | ONEWIRE_CACHE_REMOVED)) {
+                printf("Sensors changed, %d now\n", cache.count);
+                use_cache();
+            }
+
+            // Convert on all cached DS18B20s at once, return their amount and feed 't' structure with result data.
+            amount = ds18b20_measure_all(&bus, 1, t, sensors);
 
             if (amount < sensors){
                 printf("Something is wrong, I expect to see %d sensors \nbut just %d was detected!\n", sensors, amount);
@@ -77,20 +113,20 @@ void broadcast_temperature(void *pvParameters)
                 int intpart = (int)t[i].value;
                 int fraction = (int)((t[i].value - intpart) * 100);
                 // Multiple "" here is just to satisfy compiler and don`t raise 'hex escape sequence out of range' warning.
-                sprintf(msg, "Sensor %d report: %d.%02d ""\xC2""\xB0""C\n",t[i].id, intpart, fraction);
-                printf("%s", msg);
-
-                struct netbuf* buf = netbuf_new();
-                void* data = netbuf_alloc(buf, strlen(msg));
+                sprintf(msg[i], "Sensor %d report: %d.%02d ""\xC2""\xB0""C\n",t[i].id, intpart, fraction);
+                printf("%s", msg[i]);
 
-                memcpy (data, msg, strlen(msg));
-                err = netconn_send(conn, buf);
+                // One datagram per sensor, to the connected broadcast address
+                batch[i].addr = NULL;
+                batch[i].data = msg[i];
+                batch[i].len = strlen(msg[i]);
+            }
 
+            if (amount) {
+                err = udp_send_batch(conn, batch, amount, NULL);
                 if (err != ERR_OK) {
                     printf("%s : Could not send data!!! (%s)\n", __FUNCTION__, lwip_strerr(err));
-                    continue;
                 }
-                netbuf_delete(buf); // De-allocate packet buffer
             }
             vTaskDelay(1000/portTICK_RATE_MS);
         }
@@ -0,0 +1,116 @@
+/* dutycycle_sensor - A battery node on the esp/dutycycle.h scheduler.
+ *
+ * Reads the ADC every SAMPLE_S seconds, keeping the readings in RTC
+ * memory, and broadcasts them with the scheduler's counters as one UDP
+ * packet to port 8006 every UPLOAD_S seconds. Only the upload wakes
+ * have the radio on. Watch with: nc -ul 8006
+ *
+ * GPIO16 needs to be connected to RST to wake up from deep sleep.
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "esp/rtcmem_regs.h"
+#include "esp/dutycycle.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "lwip/api.h"
+
+#include "ssid_config.h"
+#include "fastconnect/fastconnect.h"
+
+#define SAMPLE_S 60
+#define UPLOAD_S 900
+#define CONNECT_TIMEOUT_MS 10000
+#define REPORT_PORT 8006
+
+/* The readings go at the start of the user RTC memory, the scheduler's
+   state after them and fastconnect's at the end */
+#define MAX_READINGS (UPLOAD_S / SAMPLE_S + 1)
+#define READINGS_COUNT RTCMEM_USER[0]
+#define READINGS_OFFSET 1
+#define DUTYCYCLE_OFFSET (READINGS_OFFSET + MAX_READINGS)
+
+_Static_assert(DUTYCYCLE_OFFSET + DUTYCYCLE_RTC_WORDS + FASTCONNECT_RTC_WORDS <= 128,
+               "Readings, scheduler and fastconnect state don't fit in RTCMEM_USER");
+
+static bool sample(void *arg)
+{
+    uint32_t n = READINGS_COUNT;
+
+    /* RTC memory is garbage after power up */
+    if (n > MAX_READINGS)
+        n = 0;
+    if (n < MAX_READINGS)
+        RTCMEM_USER[READINGS_OFFSET + n++] = sdk_system_adc_read();
+    READINGS_COUNT = n;
+    return true;
+}
+
+static bool upload(void *arg)
+{
+    dutycycle_stats_t stats;
+    char msg[32 + MAX_READINGS * 5];
+    uint32_t n = READINGS_COUNT > MAX_READINGS ? 0 : READINGS_COUNT;
+
+    dutycycle_get_stats(&stats);
+    int len = snprintf(msg, sizeof(msg), "t=%u wakes=%u radio=%u adc=", stats.now_s, stats.wakes, stats.radio_wakes);
+    for (int i = 0; i < n && len < sizeof(msg); i++)
+        len += snprintf(msg + len, sizeof(msg) - len, "%s%u", i ? "," : "", RTCMEM_USER[READINGS_OFFSET + i]);
+    if (len >= sizeof(msg))
+        len = sizeof(msg) - 1;
+
+    bool sent = false;
+    struct netconn *conn = netconn_new(NETCONN_UDP);
+    if (!conn)
+        return false;
+    if (netconn_connect(conn, IP_ADDR_BROADCAST, REPORT_PORT) == ERR_OK) {
+        struct netbuf *buf = netbuf_new();
+        sent = buf && netbuf_ref(buf, msg, len) == ERR_OK && netconn_send(conn, buf) == ERR_OK;
+        netbuf_delete(buf);
+    }
+    netconn_delete(conn);
+    if (sent)
+        READINGS_COUNT = 0;
+    return sent;
+}
+
+static bool connect(void)
+{
+    fastconnect_start(WIFI_SSID, WIFI_PASS);
+    return fastconnect_wait(CONNECT_TIMEOUT_MS);
+}
+
+static void connect_done(bool connected, uint32_t sleep_ms)
+{
+    if (connected)
+        fastconnect_save(sleep_ms);
+    else
+        fastconnect_invalidate();
+}
+
+static const dutycycle_job_t jobs[] = {
+    { "sample", SAMPLE_S, false, sample, NULL },
+    { "upload", UPLOAD_S, true, upload, NULL },
+};
+
+static void dutycycle_task(void *pvParameters)
+{
+    dutycycle_config_t config = DUTYCYCLE_DEFAULT_CONFIG;
+
+    config.wifi_connect = connect;
+    config.wifi_done = connect_done;
+    config.rtc_offset = DUTYCYCLE_OFFSET;
+    dutycycle_run(&config, jobs, sizeof(jobs) / sizeof(jobs[0]));
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    xTaskCreate(dutycycle_task, (signed char *)"duty", 512, NULL, 2, NULL);
+}
@@ -0,0 +1,47 @@
+/* encoder_speed - motor position and speed from a quadrature encoder
+ *
+ * Channel A on GPIO4 and B on GPIO5, decoded at 4 counts per line with
+ * extras/encoder. Prints position, speed in RPM for an encoder of
+ * LINES lines per revolution, and any transitions it couldn't decode,
+ * five times a second.
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include <stdio.h>
+
+#include "encoder/encoder.h"
+
+#define PIN_A 4
+#define PIN_B 5
+#define LINES 500
+#define COUNTS_PER_REV (4 * LINES)
+
+static encoder_t encoder;
+
+static void report_task(void *pvParameters)
+{
+    if (!encoder_init(&encoder, PIN_A, PIN_B, ENCODER_X4)) {
+        printf("Couldn't start the encoder\n");
+        vTaskDelete(NULL);
+    }
+
+    while (1) {
+        encoder_state_t s;
+        encoder_read(&encoder, &s);
+        printf("position %d  %d rpm  (%u errors)\n",
+               s.position, s.velocity * 60 / COUNTS_PER_REV, s.errors);
+        vTaskDelay(200 / portTICK_RATE_MS);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    xTaskCreate(report_task, (signed char *)"report", 256, NULL, 2, NULL);
+}
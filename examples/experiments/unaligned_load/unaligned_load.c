@@ -4,12 +4,14 @@
 #include "esp/timer.h"
 #include "espressif/esp_common.h"
 #include "esp/uart.h"
+#include "esp/bench.h"
 #include "FreeRTOS.h"
 #include "task.h"
 #include "queue.h"
 
 #include "string.h"
 #include "strings.h"
+#include <stdio.h>
 
 #define TESTSTRING "O hai there! %d %d %d"
 
@@ -17,56 +19,55 @@ const char *dramtest = TESTSTRING;
 const __attribute__((section(".iram1.notrodata"))) char iramtest[] = TESTSTRING;
 const __attribute__((section(".text.notrodata"))) char iromtest[] = TESTSTRING;
 
-static inline uint32_t get_ccount (void)
-{
-    uint32_t ccount;
-    asm volatile ("rsr.ccount %0" : "=a" (ccount));
-    return ccount;
-}
-
-typedef void (* test_with_fn_t)(const char *string);
-
 char buf[64];
 
-void test_memcpy_aligned(const char *string)
+void test_memcpy_aligned(void *arg)
 {
+    const char *string = arg;
     memcpy(buf, string, 16);
 }
 
-void test_memcpy_unaligned(const char *string)
+void test_memcpy_unaligned(void *arg)
 {
+    const char *string = arg;
     memcpy(buf, string, 15);
 }
 
-void test_memcpy_unaligned2(const char *string)
+void test_memcpy_unaligned2(void *arg)
 {
+    const char *string = arg;
     memcpy(buf, string+1, 15);
 }
 
-void test_strcpy(const char *string)
+void test_strcpy(void *arg)
 {
+    const char *string = arg;
     strcpy(buf, string);
 }
 
-void test_sprintf(const char *string)
+void test_sprintf(void *arg)
 {
+    const char *string = arg;
     sprintf(buf, string, 1, 2, 3);
 }
 
-void test_sprintf_arg(const char *string)
+void test_sprintf_arg(void *arg)
 {
+    const char *string = arg;
     sprintf(buf, "%s", string);
 }
 
-void test_naive_strcpy(const char *string)
+void test_naive_strcpy(void *arg)
 {
+    const char *string = arg;
     char *to = buf;
     while((*to++ = *string++))
         ;
 }
 
-void test_naive_strcpy_a0(const char *string)
+void test_naive_strcpy_a0(void *arg)
 {
+    const char *string = arg;
     asm volatile (
 "            mov          a8, %0    \n"
 "            mov          a9, %1    \n"
@@ -78,8 +79,9 @@ void test_naive_strcpy_a0(const char *string)
         : : "r" (buf), "r" (string) : "a0", "a8", "a9");
 }
 
-void test_naive_strcpy_a2(const char *string)
+void test_naive_strcpy_a2(void *arg)
 {
+    const char *string = arg;
     asm volatile (
 "            mov          a8, %0    \n"
 "            mov          a9, %1    \n"
@@ -91,8 +93,9 @@ void test_naive_strcpy_a2(const char *string)
         : : "r" (buf), "r" (string) : "a2", "a8", "a9");
 }
 
-void test_naive_strcpy_a3(const char *string)
+void test_naive_strcpy_a3(void *arg)
 {
+    const char *string = arg;
     asm volatile (
 "            mov          a8, %0    \n"
 "            mov          a9, %1    \n"
@@ -104,8 +107,9 @@ void test_naive_strcpy_a3(const char *string)
         : : "r" (buf), "r" (string) : "a3", "a8", "a9");
 }
 
-void test_naive_strcpy_a4(const char *string)
+void test_naive_strcpy_a4(void *arg)
 {
+    const char *string = arg;
     asm volatile (
 "            mov          a8, %0    \n"
 "            mov          a9, %1    \n"
@@ -117,8 +121,9 @@ void test_naive_strcpy_a4(const char *string)
         : : "r" (buf), "r" (string) : "a4", "a8", "a9");
 }
 
-void test_naive_strcpy_a5(const char *string)
+void test_naive_strcpy_a5(void *arg)
 {
+    const char *string = arg;
     asm volatile (
 "            mov          a8, %0    \n"
 "            mov          a9, %1    \n"
@@ -130,8 +135,9 @@ void test_naive_strcpy_a5(const char *string)
         : : "r" (buf), "r" (string) : "a5", "a8", "a9");
 }
 
-void test_naive_strcpy_a6(const char *string)
+void test_naive_strcpy_a6(void *arg)
 {
+    const char *string = arg;
     asm volatile (
 "            mov          a8, %0    \n"
 "            mov          a9, %1    \n"
@@ -143,8 +149,9 @@ void test_naive_strcpy_a6(const char *string)
         : : "r" (buf), "r" (string) : "a6", "a8", "a9");
 }
 
-void test_l16si(const char *string)
+void test_l16si(void *arg)
 {
+    const char *string = arg;
     /* This follows most of the l16si path, but as the
      values in the string are all 7 bit none of them get sign extended.
 
@@ -158,53 +165,49 @@ void test_l16si(const char *string)
     dst_int32[2] = src_int16[2];
 }
 
-#define TEST_REPEATS 1000
+#define TEST_REPEATS 100
 
-void test_noop(const char *string)
+uint32_t run_test(const char *string, bench_fn_t testfn, const char *label, const char *testfn_label, bool evict_cache)
 {
-
-}
-
-uint32_t IRAM run_test(const char *string, test_with_fn_t testfn, const char *testfn_label, uint32_t nullvalue, bool evict_cache)
-{
-    printf(" .. against %30s: ", testfn_label);
-    vPortEnterCritical();
-    uint32_t before = get_ccount();
-    for(int i = 0; i < TEST_REPEATS; i++) {
-        testfn(string);
-        if(evict_cache) {
-            Cache_Read_Disable();
-            Cache_Read_Enable(0,0,1);
-        }
-    }
-    uint32_t after = get_ccount();
-    vPortExitCritical();
-    uint32_t instructions = (after-before)/TEST_REPEATS - nullvalue;
-    printf("%5d instructions\r\n", instructions);
-    return instructions;
+    char name[64];
+    bench_t bench = {
+        .fn = testfn,
+        .arg = (void *)string,
+        .flags = BENCH_NO_IRQ | (evict_cache ? BENCH_FLUSH_CACHE : 0),
+        .iterations = TEST_REPEATS,
+    };
+    bench_result_t result;
+
+    snprintf(name, sizeof(name), "%s/%s", label, testfn_label);
+    bench_measure(&bench, 0, &result);
+    bench_print(name, &result, BENCH_CSV);
+    return result.min;
 }
 
 void test_string(const char *string, char *label, bool evict_cache)
 {
-    printf("Testing %s (%p) '%s'\r\n", label, string, string);
-    printf("Formats as: '");
+    printf("# Testing %s (%p) '%s'\r\n", label, string, string);
+    printf("# Formats as: '");
     printf(string, 1, 2, 3);
     printf("'\r\n");
-    uint32_t nullvalue = run_test(string, test_noop, "null op", 0, evict_cache);
-    run_test(string, test_memcpy_aligned, "memcpy - aligned len", nullvalue, evict_cache);
-    run_test(string, test_memcpy_unaligned, "memcpy - unaligned len", nullvalue, evict_cache);
-    run_test(string, test_memcpy_unaligned2, "memcpy - unaligned start&len", nullvalue, evict_cache);
-    run_test(string, test_strcpy, "strcpy", nullvalue, evict_cache);
-    run_test(string, test_naive_strcpy, "naive strcpy", nullvalue, evict_cache);
-    run_test(string, test_naive_strcpy_a0, "naive strcpy (a0)", nullvalue, evict_cache);
-    run_test(string, test_naive_strcpy_a2, "naive strcpy (a2)", nullvalue, evict_cache);
-    run_test(string, test_naive_strcpy_a3, "naive strcpy (a3)", nullvalue, evict_cache);
-    run_test(string, test_naive_strcpy_a4, "naive strcpy (a4)", nullvalue, evict_cache);
-    run_test(string, test_naive_strcpy_a5, "naive strcpy (a5)", nullvalue, evict_cache);
-    run_test(string, test_naive_strcpy_a6, "naive strcpy (a6)", nullvalue, evict_cache);
-    run_test(string, test_sprintf, "sprintf", nullvalue, evict_cache);
-    run_test(string, test_sprintf_arg, "sprintf format arg", nullvalue, evict_cache);
-    run_test(string, test_l16si, "load as l16si", nullvalue, evict_cache);
+    run_test(string, test_memcpy_aligned, label, "memcpy - aligned len", evict_cache);
+    run_test(string, test_memcpy_unaligned, label, "memcpy - unaligned len", evict_cache);
+    run_test(string, test_memcpy_unaligned2, label, "memcpy - unaligned start&len", evict_cache);
+    run_test(string, test_strcpy, label, "strcpy", evict_cache);
+    uint32_t naive = run_test(string, test_naive_strcpy, label, "naive strcpy", evict_cache);
+    /* one l8ui per byte including the terminator, each one trapping for
+       IRAM/IROM strings. Compare against the DRAM figure for the cost of
+       the LoadStoreError handler. */
+    printf("# .. %d cycles per byte loaded\r\n", naive / (strlen(string) + 1));
+    run_test(string, test_naive_strcpy_a0, label, "naive strcpy (a0)", evict_cache);
+    run_test(string, test_naive_strcpy_a2, label, "naive strcpy (a2)", evict_cache);
+    run_test(string, test_naive_strcpy_a3, label, "naive strcpy (a3)", evict_cache);
+    run_test(string, test_naive_strcpy_a4, label, "naive strcpy (a4)", evict_cache);
+    run_test(string, test_naive_strcpy_a5, label, "naive strcpy (a5)", evict_cache);
+    run_test(string, test_naive_strcpy_a6, label, "naive strcpy (a6)", evict_cache);
+    run_test(string, test_sprintf, label, "sprintf", evict_cache);
+    run_test(string, test_sprintf_arg, label, "sprintf format arg", evict_cache);
+    run_test(string, test_l16si, label, "load as l16si", evict_cache);
 }
 
 static void test_isr();
@@ -219,8 +222,9 @@ void user_init(void)
     gpio_enable(2, GPIO_OUTPUT); /* used for LED debug */
     gpio_write(2, 1); /* active low */
 
-    printf("\r\n\r\nSDK version:%s\r\n", sdk_system_get_sdk_version());
+    printf("\r\n\r\n# SDK version:%s\r\n", sdk_system_get_sdk_version());
     sanity_tests();
+    printf("# BENCH,name,samples,iterations,min,median,max (cycles per call)\r\n");
     test_string(dramtest, "DRAM", 0);
     test_string(iramtest, "IRAM", 0);
     test_string(iromtest, "Cached flash", 0);
@@ -290,12 +294,12 @@ static void test_system_interaction()
     uint32_t start = xTaskGetTickCount();
     printf("Starting system/timer interaction test (takes approx 30 seconds)...\n");
     for(int i = 0; i < 200*1000; i++) {
-        test_naive_strcpy_a0(iromtest);
-        test_naive_strcpy_a2(iromtest);
-        test_naive_strcpy_a3(iromtest);
-        test_naive_strcpy_a4(iromtest);
-        test_naive_strcpy_a5(iromtest);
-        test_naive_strcpy_a6(iromtest);
+        test_naive_strcpy_a0((void *)iromtest);
+        test_naive_strcpy_a2((void *)iromtest);
+        test_naive_strcpy_a3((void *)iromtest);
+        test_naive_strcpy_a4((void *)iromtest);
+        test_naive_strcpy_a5((void *)iromtest);
+        test_naive_strcpy_a6((void *)iromtest);
         /*
         const volatile char *string = iromtest;
         volatile char *to = dest;
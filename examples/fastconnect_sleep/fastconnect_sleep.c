@@ -0,0 +1,87 @@
+/* fastconnect_sleep - Wake from deep sleep, send a reading, sleep again.
+ *
+ * Uses extras/fastconnect to reconnect with the previous wake's BSSID,
+ * channel, address and gateway MAC, so after the first wake there's
+ * no scan, DHCP or ARP before the UDP broadcast goes out. Prints how
+ * long each wake took to connect, and how long it was awake in total.
+ *
+ * GPIO16 needs to be connected to RST to wake up from deep sleep.
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "esp/rtcmem_regs.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "lwip/api.h"
+
+#include "ssid_config.h"
+#include "fastconnect/fastconnect.h"
+
+#define SLEEP_MS 30000
+#define CONNECT_TIMEOUT_MS 10000
+#define REPORT_PORT 8005
+
+/* Wake counter, in the application's part of the user RTC memory. RTC
+   memory is garbage after power up, hence the magic number. */
+#define WAKE_MAGIC RTCMEM_USER[0]
+#define WAKE_COUNT RTCMEM_USER[1]
+#define MAGIC 0x57414b45
+
+static void send_report(uint32_t wakes)
+{
+    char msg[32];
+    struct netconn *conn = netconn_new(NETCONN_UDP);
+
+    if (!conn) {
+        return;
+    }
+    if (netconn_connect(conn, IP_ADDR_BROADCAST, REPORT_PORT) == ERR_OK) {
+        struct netbuf *buf = netbuf_new();
+        int len = snprintf(msg, sizeof(msg), "wake %u\n", wakes);
+        if (buf && netbuf_ref(buf, msg, len) == ERR_OK) {
+            netconn_send(conn, buf);
+        }
+        netbuf_delete(buf);
+    }
+    netconn_delete(conn);
+}
+
+static void sensor_task(void *pvParameters)
+{
+    if (WAKE_MAGIC != MAGIC) {
+        WAKE_MAGIC = MAGIC;
+        WAKE_COUNT = 0;
+    }
+    uint32_t wakes = ++WAKE_COUNT;
+
+    portTickType start = xTaskGetTickCount();
+    bool fast = fastconnect_start(WIFI_SSID, WIFI_PASS);
+    if (fastconnect_wait(CONNECT_TIMEOUT_MS)) {
+        printf("wake %u: connected in %u ms (%s)\n", wakes,
+               (xTaskGetTickCount() - start) * portTICK_RATE_MS, fast ? "fast" : "normal");
+        send_report(wakes);
+        fastconnect_save(SLEEP_MS);
+    } else {
+        printf("wake %u: couldn't connect\n", wakes);
+        fastconnect_invalidate();
+    }
+
+    printf("awake for %u ms\n", xTaskGetTickCount() * portTICK_RATE_MS);
+    uart_flush_txfifo(0);
+    sdk_system_deep_sleep(SLEEP_MS * 1000);
+    while (1) {
+        vTaskDelay(1000 / portTICK_RATE_MS);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    xTaskCreate(sensor_task, (signed char *)"sensor", 384, NULL, 2, NULL);
+}
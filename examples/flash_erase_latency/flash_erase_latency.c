@@ -0,0 +1,88 @@
+/* Control loop latency while flash is erased
+ *
+ * A high priority task runs every tick and records how late it woke.
+ * Every few seconds 64KB of flash is erased, alternately all at once
+ * with sdk_spi_flash_erase_sector() in a loop, and through the
+ * flasherase worker. Each run prints the worst lateness seen.
+ *
+ * The erased area is below the SDK's parameter sectors at the end of
+ * flash, so don't keep anything there.
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "esp/flasherase.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include <stdio.h>
+
+#define ERASE_SECTORS 16
+#define ERASE_ADDR (sdk_flashchip.chip_size - (4 + ERASE_SECTORS) * SPI_FLASH_SEC_SIZE)
+
+static volatile uint32_t max_late_us;
+static xSemaphoreHandle erased;
+
+static void control_task(void *pvParameters)
+{
+    portTickType wake = xTaskGetTickCount();
+    uint32_t period_us = portTICK_RATE_MS * 1000;
+    uint32_t last = sdk_system_get_time();
+
+    while (1) {
+        vTaskDelayUntil(&wake, 1);
+        uint32_t now = sdk_system_get_time();
+        uint32_t late = now - last > period_us ? now - last - period_us : 0;
+        if (late > max_late_us)
+            max_late_us = late;
+        last = now;
+    }
+}
+
+static void erase_done(uint32_t addr, uint32_t len, bool ok, void *arg)
+{
+    if (!ok)
+        printf("erase at 0x%08x failed\n", addr);
+    xSemaphoreGive(erased);
+}
+
+static void erase_task(void *pvParameters)
+{
+    bool direct = true;
+
+    while (1) {
+        vTaskDelay(3000 / portTICK_RATE_MS);
+        max_late_us = 0;
+        uint32_t start = sdk_system_get_time();
+
+        if (direct) {
+            for (int i = 0; i < ERASE_SECTORS; i++)
+                sdk_spi_flash_erase_sector(ERASE_ADDR / SPI_FLASH_SEC_SIZE + i);
+        } else {
+            flasherase_queue(ERASE_ADDR, ERASE_SECTORS * SPI_FLASH_SEC_SIZE, erase_done, NULL);
+            xSemaphoreTake(erased, portMAX_DELAY);
+        }
+
+        uint32_t took = sdk_system_get_time() - start;
+        flasherase_stats_t stats;
+        flasherase_get_stats(&stats);
+        printf("%-10s erase took %ums, control loop up to %uus late (suspends %u, cache off up to %uus)\n",
+               direct ? "sdk" : "flasherase", took / 1000, max_late_us,
+               stats.suspends, stats.max_off_us);
+        direct = !direct;
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    vSemaphoreCreateBinary(erased);
+    xSemaphoreTake(erased, 0);
+    flasherase_start(1);
+
+    xTaskCreate(control_task, (signed char *)"control", 256, NULL, 10, NULL);
+    xTaskCreate(erase_task, (signed char *)"erase", 384, NULL, 2, NULL);
+}
@@ -0,0 +1,72 @@
+/* flashkv_counter - keep a boot counter and a tick counter in flash.
+ *
+ * The counters live in an extras/flashkv store in the sectors below
+ * the SDK's own parameter area at the top of the flash. The tick
+ * counter is updated every second, which costs one small flash write
+ * each time rather than a sector erase.
+ *
+ * Flash reads go through a small esp/flashcache.h read cache, whose
+ * stats are printed every 10 updates.
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "esp/flashcache.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "flashkv/flashkv.h"
+
+#include <stdio.h>
+
+#define KV_SECTORS 8
+/* the SDK keeps its parameters in the last 4 sectors */
+#define KV_ADDR (sdk_flashchip.chip_size - (4 + KV_SECTORS) * SPI_FLASH_SEC_SIZE)
+
+static flashkv_t kv;
+
+static uint32_t get_counter(const char *key)
+{
+    uint32_t value = 0;
+    if (flashkv_get(&kv, key, &value, sizeof(value)) != sizeof(value)) {
+        value = 0;
+    }
+    return value;
+}
+
+static void counter_task(void *pvParameters)
+{
+    uint32_t ticks = get_counter("ticks");
+
+    while (1) {
+        vTaskDelay(1000 / portTICK_RATE_MS);
+        ticks++;
+        uint32_t start = sdk_system_get_time();
+        bool ok = flashkv_set(&kv, "ticks", &ticks, sizeof(ticks));
+        uint32_t elapsed = sdk_system_get_time() - start;
+        printf("ticks %u, update %s in %u us\n", ticks, ok ? "done" : "FAILED", elapsed);
+        /* reclaim space here rather than inside a later update */
+        flashkv_gc(&kv);
+        if (ticks % 10 == 0) {
+            flashcache_stats_dump();
+        }
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+
+    flashcache_init(4);
+    if (!flashkv_init(&kv, KV_ADDR, KV_SECTORS, 16)) {
+        printf("flashkv_init failed\n");
+        return;
+    }
+
+    uint32_t boots = get_counter("boots") + 1;
+    flashkv_set(&kv, "boots", &boots, sizeof(boots));
+    printf("Boot number %u, %u keys stored\n", boots, flashkv_count(&kv));
+
+    xTaskCreate(counter_task, (signed char *)"counter", 256, NULL, 2, NULL);
+}
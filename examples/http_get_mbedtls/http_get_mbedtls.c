@@ -4,6 +4,14 @@
  *
  * Validates the server's certificate using the root CA loaded (in PEM format) in cert.c.
  *
+ * Built with the pre-shared key profile (make MBEDTLS_PSK_PROFILE=1 PSK_SERVER=<address>,
+ * see extras/mbedtls/include/mbedtls_psk_profile.h) it instead fetches the status page of
+ * an openssl server sharing PSK_IDENTITY and psk below, with no certificates at all:
+ *
+ * openssl s_server -accept 4433 -nocert -www -psk_identity esp8266 -psk 000102030405060708090a0b0c0d0e0f
+ *
+ * The handshake time is printed for each connection, to compare the two.
+ *
  * Adapted from the ssl_client1 example in mbedtls.
  *
  * Original Copyright (C) 2006-2015, ARM Limited, All Rights Reserved, Apache 2.0 License.
@@ -11,6 +19,8 @@
  */
 #include "espressif/esp_common.h"
 #include "esp/uart.h"
+#include "esp/hwrand.h"
+#include "esp/clocks.h"
 
 #include <string.h>
 
@@ -41,14 +51,41 @@
 #include "mbedtls/error.h"
 #include "mbedtls/certs.h"
 
+#include "ssl_session_cache.h"
+#include "ssl_arena.h"
+
+#ifndef MBEDTLS_PSK_PROFILE
 #define WEB_SERVER "howsmyssl.com"
 #define WEB_PORT "443"
 #define WEB_URL "https://www.howsmyssl.com/a/check"
 
-#define GET_REQUEST "GET "WEB_URL" HTTP/1.1\n\n"
-
 /* Root cert for howsmyssl.com, stored in cert.c */
 extern const char *server_root_cert;
+#else
+#ifndef PSK_SERVER
+#error "Build with PSK_SERVER=<address of the openssl s_server>"
+#endif
+#define WEB_SERVER PSK_SERVER
+#define WEB_PORT "4433"
+#define WEB_URL "/"
+
+/* Shared with the server. Use your own random key for anything real! */
+#define PSK_IDENTITY "esp8266"
+static const unsigned char psk[16] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+};
+#endif
+
+/* Heap reserved for each connection's mbedtls allocations, size it from
+   the peak printed after a few connections */
+#ifndef MBEDTLS_PSK_PROFILE
+#define CONNECTION_ARENA_SIZE (20 * 1024)
+#else
+#define CONNECTION_ARENA_SIZE (8 * 1024)
+#endif
+
+#define GET_REQUEST "GET "WEB_URL" HTTP/1.1\n\n"
 
 /* MBEDTLS_DEBUG_C disabled by default to save substantial bloating of
  * firmware, define it in
@@ -88,26 +125,32 @@ void http_get_task(void *pvParameters)
     int successes = 0, failures = 0, ret;
     printf("HTTP get task starting...\n");
 
-    uint32_t flags;
     unsigned char buf[1024];
     const char *pers = "ssl_client1";
 
     mbedtls_entropy_context entropy;
     mbedtls_ctr_drbg_context ctr_drbg;
     mbedtls_ssl_context ssl;
+#ifndef MBEDTLS_PSK_PROFILE
     mbedtls_x509_crt cacert;
+#endif
     mbedtls_ssl_config conf;
     mbedtls_net_context server_fd;
+    ssl_saved_session_t saved_session;
 
     /*
      * 0. Initialize the RNG and the session data
      */
+    ssl_arena_install();
     mbedtls_ssl_init(&ssl);
+#ifndef MBEDTLS_PSK_PROFILE
     mbedtls_x509_crt_init(&cacert);
+#endif
     mbedtls_ctr_drbg_init(&ctr_drbg);
     printf("\n  . Seeding the random number generator...");
 
     mbedtls_ssl_config_init(&conf);
+    ssl_saved_session_init(&saved_session);
 
     mbedtls_entropy_init(&entropy);
     if((ret = mbedtls_ctr_drbg_seed(&ctr_drbg, mbedtls_entropy_func, &entropy,
@@ -120,6 +163,7 @@ void http_get_task(void *pvParameters)
 
     printf(" ok\n");
 
+#ifndef MBEDTLS_PSK_PROFILE
     /*
      * 0. Initialize certificates
      */
@@ -140,6 +184,7 @@ void http_get_task(void *pvParameters)
         printf(" failed\n  ! mbedtls_ssl_set_hostname returned %d\n\n", ret);
         while(1) {} /* todo: replace with abort() */
     }
+#endif
 
     /*
      * 2. Setup stuff
@@ -160,19 +205,34 @@ void http_get_task(void *pvParameters)
     /* OPTIONAL is not optimal for security, in this example it will print
        a warning if CA verification fails but it will continue to connect.
     */
+#ifndef MBEDTLS_PSK_PROFILE
     mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_OPTIONAL);
     mbedtls_ssl_conf_ca_chain(&conf, &cacert, NULL);
+#else
+    if((ret = mbedtls_ssl_conf_psk(&conf, psk, sizeof(psk),
+                                   (const unsigned char *)PSK_IDENTITY, strlen(PSK_IDENTITY))) != 0)
+    {
+        printf(" failed\n  ! mbedtls_ssl_conf_psk returned %d\n\n", ret);
+        goto exit;
+    }
+#endif
     mbedtls_ssl_conf_rng(&conf, mbedtls_ctr_drbg_random, &ctr_drbg);
+#ifdef MBEDTLS_LOW_RAM_PROFILE
+    /* Ask the server to keep its records within our smaller buffers */
+    mbedtls_ssl_conf_max_frag_len(&conf, MBEDTLS_LOW_RAM_MAX_FRAG_LEN);
+#endif
 #ifdef MBEDTLS_DEBUG_C
     mbedtls_debug_set_threshold(DEBUG_LEVEL);
     mbedtls_ssl_conf_dbg(&conf, my_debug, stdout);
 #endif
 
+    size_t heap_before_setup = xPortGetFreeHeapSize();
     if((ret = mbedtls_ssl_setup(&ssl, &conf)) != 0)
     {
         printf(" failed\n  ! mbedtls_ssl_setup returned %d\n\n", ret);
         goto exit;
     }
+    printf("  . SSL context record buffers use %u bytes of heap\n", heap_before_setup - xPortGetFreeHeapSize());
 
     /* Wait until we can resolve the DNS for the server, as an indication
        our network is probably working...
@@ -187,6 +247,10 @@ void http_get_task(void *pvParameters)
     printf("done.\n");
 
     while(1) {
+        /* Everything mbedtls allocates for this connection comes from one
+           block, so the handshake doesn't fragment the heap */
+        if(ssl_arena_reserve(CONNECTION_ARENA_SIZE) != 0)
+            printf("Couldn't reserve the TLS arena, using the heap\n");
         mbedtls_net_init(&server_fd);
         printf("top of loop, free heap = %u\n", xPortGetFreeHeapSize());
         /*
@@ -205,28 +269,46 @@ void http_get_task(void *pvParameters)
 
         mbedtls_ssl_set_bio(&ssl, &server_fd, mbedtls_net_send, mbedtls_net_recv, NULL);
 
+        /* Offer the previous connection's session, so the server can
+           resume it and skip the slow public key operations */
+        ssl_saved_session_restore(&saved_session, &ssl);
+
         /*
          * 4. Handshake
          */
         printf("  . Performing the SSL/TLS handshake...");
 
+        /* The public key operations are CPU bound, so run them at 160MHz
+           and drop back to 80MHz for the rest of the connection */
+        cpu_set_freq(160);
+        uint32_t handshake_start = xTaskGetTickCount();
         while((ret = mbedtls_ssl_handshake(&ssl)) != 0)
         {
             if(ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE)
             {
+                cpu_set_freq(80);
                 printf(" failed\n  ! mbedtls_ssl_handshake returned -0x%x\n\n", -ret);
+                ssl_saved_session_free(&saved_session);
                 goto exit;
             }
         }
+        cpu_set_freq(80);
 
-        printf(" ok\n");
+        printf(" ok (%u ms, %s)\n", (xTaskGetTickCount() - handshake_start) * portTICK_RATE_MS,
+               mbedtls_ssl_get_ciphersuite(&ssl));
+        /* The saved session outlives the arena */
+        ssl_arena_bypass(true);
+        ssl_saved_session_save(&saved_session, &ssl);
+        ssl_arena_bypass(false);
 
+#ifndef MBEDTLS_PSK_PROFILE
         /*
          * 5. Verify the server certificate
          */
         printf("  . Verifying peer X.509 certificate...");
 
         /* In real life, we probably want to bail out when ret != 0 */
+        uint32_t flags;
         if((flags = mbedtls_ssl_get_verify_result(&ssl)) != 0)
         {
             char vrfy_buf[512];
@@ -239,6 +321,7 @@ void http_get_task(void *pvParameters)
         }
         else
             printf(" ok\n");
+#endif
 
         /*
          * 3. Write the GET request
@@ -297,9 +380,17 @@ void http_get_task(void *pvParameters)
         mbedtls_ssl_close_notify(&ssl);
 
     exit:
+        /* Released first, so what the reset frees goes back to the arena
+           and what it sets up for the next connection comes from the heap */
+        ssl_arena_release();
         mbedtls_ssl_session_reset(&ssl);
         mbedtls_net_free(&server_fd);
 
+        ssl_arena_stats_t arena_stats;
+        ssl_arena_get_stats(&arena_stats);
+        printf("TLS arena: peak %u of %u bytes, %u allocations failed\n",
+               arena_stats.peak, arena_stats.size, arena_stats.failures);
+
         if(ret != 0)
         {
             char error_buf[100];
@@ -333,5 +424,8 @@ void user_init(void)
     sdk_wifi_set_opmode(STATION_MODE);
     sdk_wifi_station_set_config(&config);
 
+    /* keep hardware entropy ready for the handshake */
+    hwrand_pool_start(tskIDLE_PRIORITY + 1);
+
     xTaskCreate(&http_get_task, (signed char *)"get_task", 2048, NULL, 2, NULL);
 }
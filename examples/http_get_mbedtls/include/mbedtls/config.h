@@ -19,7 +19,10 @@
 /* include_next picks up default config from extras/mbedtls/include/mbedtls/config.h */
 #include_next<mbedtls/config.h>
 
+/* (the pre-shared key profile has its own list) */
+#ifndef MBEDTLS_PSK_PROFILE
 #define MBEDTLS_SSL_CIPHERSUITES MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_256_CBC_SHA,MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_CBC_SHA,MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA,MBEDTLS_TLS_ECDHE_RSA_WITH_AES_256_CBC_SHA
+#endif
 
 /* uncomment next line to include debug output from example */
 //#define MBEDTLS_DEBUG_C
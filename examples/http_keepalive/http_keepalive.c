@@ -0,0 +1,84 @@
+/* http_keepalive - Post readings over one kept-alive HTTP connection.
+ *
+ * Every 10 seconds, sends a batch of readings to TELEMETRY_HOST as
+ * pipelined POSTs on the same connection (reconnecting only when the
+ * server has closed it) and then reads the responses, printing how
+ * long the batch took.
+ *
+ * This sample code is in the public domain.
+ */
+#include <stdio.h>
+
+#include <espressif/esp_common.h>
+#include <esp/uart.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "ssid_config.h"
+#include "httpclient/httpclient.h"
+
+#define TELEMETRY_HOST "example.com"
+#define TELEMETRY_PORT 80
+#define TELEMETRY_PATH "/telemetry"
+
+#define BATCH HTTPCLIENT_PIPELINE
+
+static httpclient_t client;
+
+static int print_body(void *arg, const httpclient_response_t *resp, const void *data, size_t len)
+{
+    printf("%.*s", (int)len, (const char *)data);
+    return 0;
+}
+
+static void telemetry_task(void *pvParameters)
+{
+    while (sdk_wifi_station_get_connect_status() != STATION_GOT_IP)
+        vTaskDelay(100 / portTICK_RATE_MS);
+
+    httpclient_init(&client);
+    if (httpclient_connect(&client, TELEMETRY_HOST, TELEMETRY_PORT) != HTTPCLIENT_OK)
+        printf("Initial connection failed, will retry\n");
+
+    for (int seq = 0; ; ) {
+        portTickType start = xTaskGetTickCount();
+        int sent = 0;
+        for (; sent < BATCH; sent++) {
+            char json[64];
+            int len = snprintf(json, sizeof(json), "{\"seq\":%d,\"heap\":%u}",
+                               seq + sent, sdk_system_get_free_heap_size());
+            int r = httpclient_send(&client, "POST", TELEMETRY_PATH,
+                                    "Content-Type: application/json\r\n", json, len);
+            if (r != HTTPCLIENT_OK) {
+                printf("send failed: %d\n", r);
+                break;
+            }
+        }
+        for (int i = 0; i < sent; i++) {
+            httpclient_response_t resp;
+            int status = httpclient_read_response(&client, &resp, print_body, NULL);
+            printf("\nreading %d: %d\n", seq + i, status);
+        }
+        seq += sent;
+        printf("batch of %d took %u ms\n", sent,
+               (xTaskGetTickCount() - start) * portTICK_RATE_MS);
+        vTaskDelay(10000 / portTICK_RATE_MS);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    struct sdk_station_config config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+    };
+
+    /* required to call wifi_set_opmode before station_set_config */
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_station_set_config(&config);
+
+    xTaskCreate(telemetry_task, (signed char *)"telemetry", 512, NULL, 2, NULL);
+}
@@ -0,0 +1,11 @@
+function poll() {
+    var r = new XMLHttpRequest();
+    r.onload = function() {
+        document.getElementById('s').textContent = r.responseText;
+    };
+    r.open('GET', '/status.json');
+    r.send();
+}
+
+setInterval(poll, 1000);
+poll();
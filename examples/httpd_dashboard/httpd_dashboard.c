@@ -0,0 +1,89 @@
+/* httpd_dashboard - A status page served by extras/httpd.
+ *
+ * Serves the page in files/ from a romfs image in IROM, which polls
+ * /status.json, generated on each request, once a second. Point a
+ * browser at the address printed once the station has connected to the
+ * network in ssid_config.h.
+ *
+ * The files are gzip compressed at build time (ROMFS_GZIP in the
+ * Makefile) and sent as they are from flash. Reloading the page gets
+ * 304 Not Modified answers for them, by ETag, without any body.
+ *
+ * This sample code is in the public domain.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include <espressif/esp_common.h>
+#include <esp/uart.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "ssid_config.h"
+#include "httpd/httpd.h"
+#include "romfs/romfs.h"
+
+static bool romfs_file(const char *path, httpd_file_t *file)
+{
+    romfs_file_t f;
+
+    if (!strcmp(path, "/"))
+        path = "/index.html";
+    if (!romfs_find(path, &f))
+        return false;
+    file->data = f.data;
+    file->len = f.size;
+    file->gzip = f.flags & ROMFS_GZIP;
+    file->etag = f.etag;
+    return true;
+}
+
+static int status_json(const char *path, const char *query, char *buf, size_t size)
+{
+    return snprintf(buf, size,
+                    "{\"uptime\":%u,\"heap\":%u,\"connections\":%d}",
+                    xTaskGetTickCount() / configTICK_RATE_HZ,
+                    sdk_system_get_free_heap_size(),
+                    httpd_connections());
+}
+
+static const httpd_route_t routes[] = {
+    { "/status.json", "application/json", "Cache-Control: no-cache\r\n", NULL, 0, status_json },
+};
+
+static void server_task(void *pvParameters)
+{
+    while (sdk_wifi_station_get_connect_status() != STATION_GOT_IP)
+        vTaskDelay(100 / portTICK_RATE_MS);
+
+    struct ip_info info;
+    sdk_wifi_get_ip_info(STATION_IF, &info);
+    if (!httpd_start(80, routes, sizeof(routes) / sizeof(routes[0]), romfs_file)) {
+        printf("httpd_start failed\n");
+    } else {
+        printf("Serving on http://" IPSTR "/\n", IP2STR(&info.ip));
+    }
+    vTaskDelete(NULL);
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    if (!romfs_mount(romfs_image)) {
+        printf("romfs_mount failed\n");
+        return;
+    }
+
+    struct sdk_station_config config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+    };
+
+    /* required to call wifi_set_opmode before station_set_config */
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_station_set_config(&config);
+
+    xTaskCreate(server_task, (signed char *)"server", 256, NULL, 2, NULL);
+}
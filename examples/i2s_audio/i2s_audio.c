@@ -0,0 +1,78 @@
+/* Play a tone through an I2S DAC (a PCM5102 or MAX98357A, say) with
+ * extras/i2s_dma
+ *
+ * A 441 Hz sine on the left channel and 882 Hz on the right, at 44.1 kHz
+ * 16 bit. Connect DIN to GPIO3, BCK to GPIO15 and LRCK/WS to GPIO2
+ * (GPIO3 is UART0 RX, so this takes over the serial input). Every 5
+ * seconds it prints how many blocks have played and how many of them
+ * came too late.
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include <stdio.h>
+
+#include "i2s_dma/i2s_dma.h"
+
+#define SAMPLE_RATE 44100
+#define TABLE_LEN 100           /* 441 Hz at 44.1 kHz */
+
+/* A period of sine, a quarter of full scale */
+static int16_t sine[TABLE_LEN];
+
+static void make_table(void)
+{
+    /* Rotating a vector by 2pi/100 at a time, no libm */
+    const int32_t c = 32703, s = 2057;  /* cos and sin of 2pi/100, Q15 */
+    int32_t x = 8192 << 8, y = 0;       /* Q8 extra precision */
+
+    for (int i = 0; i < TABLE_LEN; i++) {
+        sine[i] = y >> 8;
+        int32_t nx = ((int64_t)x * c - (int64_t)y * s) >> 15;
+        int32_t ny = ((int64_t)x * s + (int64_t)y * c) >> 15;
+        x = nx;
+        y = ny;
+    }
+}
+
+static void audio_task(void *pvParameters)
+{
+    int16_t frames[2 * 64];
+    uint32_t phase = 0;
+    portTickType last_report = xTaskGetTickCount();
+
+    make_table();
+    uint32_t rate = i2s_tx_start(SAMPLE_RATE, 16, 8, 1024);
+    if (!rate) {
+        printf("Couldn't start I2S\n");
+        vTaskDelete(NULL);
+    }
+    printf("Playing at %u Hz\n", rate);
+
+    while (1) {
+        for (int i = 0; i < 64; i++) {
+            frames[2 * i] = sine[phase % TABLE_LEN];
+            frames[2 * i + 1] = sine[(2 * phase) % TABLE_LEN];
+            phase++;
+        }
+        i2s_tx_write(frames, sizeof(frames), portMAX_DELAY);
+
+        if (xTaskGetTickCount() - last_report >= 5000 / portTICK_RATE_MS) {
+            i2s_tx_stats_t stats;
+            i2s_tx_stats(&stats);
+            printf("%u blocks played, %u underruns\n", stats.blocks, stats.underruns);
+            last_report = xTaskGetTickCount();
+        }
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    xTaskCreate(audio_task, (signed char *)"audio", 384, NULL, 3, NULL);
+}
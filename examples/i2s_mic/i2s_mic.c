@@ -0,0 +1,66 @@
+/* Read an I2S microphone (an INMP441, say) with extras/i2s_dma
+ *
+ * Receives 24 bit stereo at 16 kHz and once a second prints the peak
+ * and mean level of the left channel (the mic with L/R tied low), with
+ * how many blocks have come in and how many were lost. Connect SD to
+ * GPIO12, SCK to GPIO13 and WS to GPIO14.
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include <stdio.h>
+
+#include "i2s_dma/i2s_dma.h"
+
+#define SAMPLE_RATE 16000
+#define BLOCK_BYTES 1024
+#define FRAMES_PER_BLOCK (BLOCK_BYTES / (2 * sizeof(int32_t)))
+
+static void mic_task(void *pvParameters)
+{
+    uint32_t rate = i2s_rx_start(SAMPLE_RATE, 24, 4, BLOCK_BYTES);
+    if (!rate) {
+        printf("Couldn't start I2S\n");
+        vTaskDelete(NULL);
+    }
+    printf("Receiving at %u Hz\n", rate);
+
+    uint32_t peak = 0, frames = 0;
+    uint64_t sum = 0;
+
+    while (1) {
+        const int32_t *s = i2s_rx_read(1000 / portTICK_RATE_MS);
+        if (!s) {
+            printf("No data\n");
+            continue;
+        }
+        for (int i = 0; i < FRAMES_PER_BLOCK; i++) {
+            int32_t v = s[2 * i] >> 8;      /* the sample's in the top 24 bits */
+            uint32_t a = v < 0 ? -v : v;
+            if (a > peak)
+                peak = a;
+            sum += a;
+        }
+        frames += FRAMES_PER_BLOCK;
+
+        if (frames >= rate) {
+            i2s_rx_stats_t stats;
+            i2s_rx_stats(&stats);
+            printf("peak %7u mean %7u  (%u blocks, %u overruns)\n",
+                   peak, (uint32_t)(sum / frames), stats.blocks, stats.overruns);
+            peak = frames = 0;
+            sum = 0;
+        }
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    xTaskCreate(mic_task, (signed char *)"mic", 384, NULL, 3, NULL);
+}
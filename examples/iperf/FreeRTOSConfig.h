@@ -0,0 +1,10 @@
+/* iperf FreeRTOSConfig overrides.
+
+   Turn on the trace facility and CCOUNT-based run time stats counter,
+   for the CPU use reports.
+*/
+#define configUSE_TRACE_FACILITY 1
+#define configGENERATE_RUN_TIME_STATS 1
+
+/* Use the defaults for everything else */
+#include_next<FreeRTOSConfig.h>
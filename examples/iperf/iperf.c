@@ -0,0 +1,526 @@
+/* iperf - TCP and UDP throughput, against a desktop iperf (version 2)
+ *
+ * By default runs TCP and UDP servers on port 5001, so from a PC:
+ *
+ *     iperf -c <esp8266 address> -t 10            (TCP, PC -> ESP)
+ *     iperf -c <esp8266 address> -u -b 5M -t 10   (UDP, PC -> ESP)
+ *
+ * Or as a client, sending to "iperf -s" (or "iperf -s -u") on a PC:
+ *
+ *     make flash IPERF_CLIENT=192.168.1.10
+ *     make flash IPERF_CLIENT=192.168.1.10 IPERF_UDP=1 IPERF_BW=5000
+ *
+ * Every second the rate so far is printed, and at the end of each test
+ * a summary with what it cost: the lowest free heap seen during the
+ * test, and the CPU used, from the FreeRTOS run time stats (the share
+ * of the time the idle task didn't get, and tcpip_thread's part of it).
+ * The UDP client also prints the server's report of lost datagrams and
+ * jitter. Build with EXTRA_CFLAGS=-DMALLOC_STATS=1 for an exact heap
+ * low water mark rather than one sampled every 100ms.
+ *
+ * To see what a change costs or gains, run the same test before and
+ * after: lwipopts.h settings (EXTRA_CFLAGS=-DLWIP_THROUGHPUT_PROFILE=1),
+ * CPU frequency, or TLS, ... .
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "lwip/err.h"
+#include "lwip/sockets.h"
+#include "lwip/sys.h"
+#include "malloc_stats.h"
+
+#include "ssid_config.h"
+
+#define IPERF_PORT 5001
+
+/* Client test length, seconds */
+#ifndef IPERF_TIME
+#define IPERF_TIME 10
+#endif
+
+/* UDP client rate, kbit/s */
+#ifndef IPERF_BW
+#define IPERF_BW 1000
+#endif
+
+#ifndef IPERF_UDP
+#define IPERF_UDP 0
+#endif
+
+#define TCP_BUF_LEN 1460
+#define UDP_LEN 1470    /* iperf's default datagram length */
+#define MAX_TASKS 16
+
+/* The iperf 2 wire format: UDP datagrams start with this, and the
+   server's reply to the client's final datagram adds a server_hdr */
+struct udp_datagram {
+    int32_t id;         /* negative in the final datagram */
+    uint32_t tv_sec;
+    uint32_t tv_usec;
+};
+
+struct server_hdr {
+    int32_t flags;
+    int32_t total_len1;
+    int32_t total_len2;
+    int32_t stop_sec;
+    int32_t stop_usec;
+    int32_t error_cnt;
+    int32_t outorder_cnt;
+    int32_t datagrams;
+    int32_t jitter1;
+    int32_t jitter2;
+};
+
+#define HEADER_VERSION1 0x80000000
+
+/* What a test cost, between cost_start() and cost_report() */
+typedef struct {
+    uint32_t heap_min;
+    uint32_t heap_sampled_ms;
+    unsigned long total;
+    unsigned long idle;
+    unsigned long tcpip;
+} cost_t;
+
+static void cpu_counters(unsigned long *total, unsigned long *idle, unsigned long *tcpip)
+{
+    static xTaskStatusType tasks[MAX_TASKS];
+    unsigned portBASE_TYPE count = uxTaskGetSystemState(tasks, MAX_TASKS, total);
+
+    *idle = *tcpip = 0;
+    for (int i = 0; i < count; i++) {
+        if (!strcmp((char *)tasks[i].pcTaskName, "IDLE"))
+            *idle = tasks[i].ulRunTimeCounter;
+        else if (!strcmp((char *)tasks[i].pcTaskName, "tcpip_thread"))
+            *tcpip = tasks[i].ulRunTimeCounter;
+    }
+}
+
+static void cost_sample_heap(cost_t *c)
+{
+#if !MALLOC_STATS
+    uint32_t now = sys_now();
+    if (now - c->heap_sampled_ms < 100)
+        return;
+    c->heap_sampled_ms = now;
+    uint32_t heap = xPortGetFreeHeapSize();
+    if (heap < c->heap_min)
+        c->heap_min = heap;
+#endif
+}
+
+static void cost_start(cost_t *c)
+{
+    c->heap_min = xPortGetFreeHeapSize();
+    c->heap_sampled_ms = sys_now();
+    cpu_counters(&c->total, &c->idle, &c->tcpip);
+}
+
+static unsigned pct10(unsigned long part, unsigned long whole)
+{
+    return whole ? (uint64_t)part * 1000 / whole : 0;
+}
+
+static void cost_report(cost_t *c)
+{
+    unsigned long total, idle, tcpip;
+    cpu_counters(&total, &idle, &tcpip);
+    total -= c->total;
+
+    unsigned busy = 1000 - pct10(idle - c->idle, total);
+    unsigned stack = pct10(tcpip - c->tcpip, total);
+    uint32_t heap_min = c->heap_min;
+#if MALLOC_STATS
+    malloc_stats_t ms;
+    malloc_stats_get(&ms);
+    heap_min = ms.min_free;
+#endif
+    printf("cpu %u.%u%% (tcpip_thread %u.%u%%), heap low water %u, free now %u\r\n",
+           busy / 10, busy % 10, stack / 10, stack % 10, heap_min,
+           (uint32_t)xPortGetFreeHeapSize());
+}
+
+static void report(const char *what, uint32_t from_us, uint32_t to_us, uint64_t bytes)
+{
+    uint32_t us = to_us - from_us;
+    uint32_t kbps = us ? bytes * 8000 / us : 0;
+    printf("[%s] %u.%u-%u.%u sec %u KBytes %u Kbits/sec\r\n", what,
+           from_us / 1000000, from_us / 100000 % 10, to_us / 1000000, to_us / 100000 % 10,
+           (uint32_t)(bytes / 1024), kbps);
+}
+
+/* Throughput reports each second, and the summary */
+typedef struct {
+    const char *what;
+    uint32_t start, last;
+    uint64_t total;
+    uint64_t at_last;
+} meter_t;
+
+static void meter_start(meter_t *m, const char *what)
+{
+    m->what = what;
+    m->start = m->last = sys_now_us();
+    m->total = m->at_last = 0;
+}
+
+static void meter_add(meter_t *m, uint32_t bytes)
+{
+    m->total += bytes;
+    uint32_t now = sys_now_us();
+    if (now - m->last >= 1000000) {
+        report(m->what, m->last - m->start, now - m->start, m->total - m->at_last);
+        m->last = now;
+        m->at_last = m->total;
+    }
+}
+
+static void meter_end(meter_t *m)
+{
+    report(m->what, 0, sys_now_us() - m->start, m->total);
+}
+
+#ifndef IPERF_CLIENT
+static void tcp_receive(int s)
+{
+    static uint8_t buf[TCP_BUF_LEN];
+    meter_t m;
+    cost_t cost;
+
+    cost_start(&cost);
+    meter_start(&m, "TCP rx");
+    while (1) {
+        int r = lwip_recv(s, buf, TCP_BUF_LEN, 0);
+        if (r <= 0)
+            break;
+        meter_add(&m, r);
+        cost_sample_heap(&cost);
+    }
+    meter_end(&m);
+    cost_report(&cost);
+}
+
+static void tcp_server_task(void *pvParameters)
+{
+    int ls = lwip_socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(IPERF_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if (ls < 0 || lwip_bind(ls, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        lwip_listen(ls, 1) < 0) {
+        printf("Failed to set up TCP server\r\n");
+        vTaskDelete(NULL);
+        return;
+    }
+
+    while (1) {
+        struct sockaddr_in peer;
+        socklen_t len = sizeof(peer);
+        int s = lwip_accept(ls, (struct sockaddr *)&peer, &len);
+        if (s < 0) {
+            vTaskDelay(100 / portTICK_RATE_MS);
+            continue;
+        }
+        printf("TCP connection from %s\r\n", inet_ntoa(peer.sin_addr));
+        tcp_receive(s);
+        lwip_close(s);
+    }
+}
+
+/* UDP server: count, order and time the datagrams of one client until
+   its final datagram, then reply with the report iperf expects */
+typedef struct {
+    bool active;
+    struct sockaddr_in peer;
+    int32_t next_id;
+    int32_t lost;
+    int32_t out_of_order;
+    int32_t last_transit;   /* us */
+    uint32_t jitter;        /* us, x16 */
+    uint32_t duration_us;
+    meter_t meter;
+    cost_t cost;
+} udp_session_t;
+
+static void udp_session_packet(udp_session_t *u, const struct udp_datagram *d, int len)
+{
+    int32_t id = ntohl(d->id);
+    uint32_t now = sys_now_us();
+
+    if (id > u->next_id) {
+        u->lost += id - u->next_id;
+    } else if (id < u->next_id) {
+        u->out_of_order++;
+        if (u->lost)
+            u->lost--;
+    }
+    if (id >= u->next_id)
+        u->next_id = id + 1;
+
+    /* RFC 1889 jitter. The clocks aren't synchronised, only the
+       difference of transit times matters. */
+    int32_t transit = (int32_t)(now - (ntohl(d->tv_sec) * 1000000 + ntohl(d->tv_usec)));
+    if (u->meter.total) {
+        int32_t diff = transit - u->last_transit;
+        if (diff < 0)
+            diff = -diff;
+        u->jitter += diff - ((u->jitter + 8) >> 4);
+    }
+    u->last_transit = transit;
+    meter_add(&u->meter, len);
+    cost_sample_heap(&u->cost);
+}
+
+static void udp_session_ack(int s, udp_session_t *u, const struct udp_datagram *fin)
+{
+    struct {
+        struct udp_datagram d;
+        struct server_hdr h;
+    } ack;
+    uint32_t us = u->duration_us;
+    uint32_t jitter = u->jitter >> 4;
+
+    memset(&ack, 0, sizeof(ack));
+    ack.d = *fin;
+    ack.h.flags = htonl(HEADER_VERSION1);
+    ack.h.total_len1 = htonl((uint32_t)(u->meter.total >> 32));
+    ack.h.total_len2 = htonl((uint32_t)u->meter.total);
+    ack.h.stop_sec = htonl(us / 1000000);
+    ack.h.stop_usec = htonl(us % 1000000);
+    ack.h.error_cnt = htonl(u->lost);
+    ack.h.outorder_cnt = htonl(u->out_of_order);
+    ack.h.datagrams = htonl(u->next_id);
+    ack.h.jitter1 = htonl(jitter / 1000000);
+    ack.h.jitter2 = htonl(jitter % 1000000);
+    lwip_sendto(s, &ack, sizeof(ack), 0, (struct sockaddr *)&u->peer, sizeof(u->peer));
+}
+
+static void udp_server_task(void *pvParameters)
+{
+    static udp_session_t u;
+    static uint8_t buf[UDP_LEN];
+    int s = lwip_socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(IPERF_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if (s < 0 || lwip_bind(s, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        printf("Failed to set up UDP server\r\n");
+        vTaskDelete(NULL);
+        return;
+    }
+
+    while (1) {
+        struct sockaddr_in peer;
+        socklen_t plen = sizeof(peer);
+        int r = lwip_recvfrom(s, buf, sizeof(buf), 0, (struct sockaddr *)&peer, &plen);
+        if (r < (int)sizeof(struct udp_datagram))
+            continue;
+        const struct udp_datagram *d = (const struct udp_datagram *)buf;
+        bool same_peer = u.peer.sin_addr.s_addr == peer.sin_addr.s_addr &&
+                         u.peer.sin_port == peer.sin_port;
+
+        if (!u.active || !same_peer) {
+            if ((int32_t)ntohl(d->id) < 0) {
+                /* The client resending its final datagram, we lost the
+                   ack. Send it again if nothing else happened since. */
+                if (same_peer)
+                    udp_session_ack(s, &u, d);
+                continue;
+            }
+            memset(&u, 0, sizeof(u));
+            u.active = true;
+            u.peer = peer;
+            printf("UDP test from %s\r\n", inet_ntoa(peer.sin_addr));
+            cost_start(&u.cost);
+            meter_start(&u.meter, "UDP rx");
+        }
+
+        if ((int32_t)ntohl(d->id) >= 0) {
+            udp_session_packet(&u, d, r);
+        } else {
+            u.duration_us = sys_now_us() - u.meter.start;
+            meter_end(&u.meter);
+            printf("%d lost of %d datagrams, %d out of order, jitter %u us\r\n",
+                   u.lost, u.next_id, u.out_of_order, u.jitter >> 4);
+            cost_report(&u.cost);
+            udp_session_ack(s, &u, d);
+            u.active = false;
+        }
+    }
+}
+
+#else /* IPERF_CLIENT */
+static uint8_t buf[UDP_LEN];
+
+static int client_socket(int type, struct sockaddr_in *addr)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(IPERF_PORT);
+    if (!inet_aton(IPERF_CLIENT, &addr->sin_addr)) {
+        printf("Bad IPERF_CLIENT address %s\r\n", IPERF_CLIENT);
+        return -1;
+    }
+    int s = lwip_socket(AF_INET, type, 0);
+    if (s >= 0 && lwip_connect(s, (struct sockaddr *)addr, sizeof(*addr)) < 0) {
+        printf("Can't connect to %s\r\n", IPERF_CLIENT);
+        lwip_close(s);
+        return -1;
+    }
+    return s;
+}
+
+static void tcp_client(void)
+{
+    struct sockaddr_in addr;
+    meter_t m;
+    cost_t cost;
+    int s = client_socket(SOCK_STREAM, &addr);
+    if (s < 0)
+        return;
+
+    /* The start of the stream is iperf's client header, all zeros asks
+       for nothing more than a plain test */
+    for (int i = 0; i < TCP_BUF_LEN; i++)
+        buf[i] = i < 24 ? 0 : '0' + i % 10;
+
+    printf("TCP test to %s, %d seconds\r\n", IPERF_CLIENT, IPERF_TIME);
+    cost_start(&cost);
+    meter_start(&m, "TCP tx");
+    while (sys_now_us() - m.start < IPERF_TIME * 1000000) {
+        int r = lwip_send(s, buf, TCP_BUF_LEN, 0);
+        if (r <= 0) {
+            printf("Send failed\r\n");
+            break;
+        }
+        meter_add(&m, r);
+        cost_sample_heap(&cost);
+        /* The header only goes at the very start */
+        memset(buf, '0', 24);
+    }
+    lwip_close(s);
+    meter_end(&m);
+    cost_report(&cost);
+}
+
+static void udp_client(void)
+{
+    struct sockaddr_in addr;
+    meter_t m;
+    cost_t cost;
+    struct udp_datagram *d = (struct udp_datagram *)buf;
+    int s = client_socket(SOCK_DGRAM, &addr);
+    if (s < 0)
+        return;
+
+    memset(buf, 0, sizeof(buf));
+    /* Microseconds between datagrams for the rate */
+    uint32_t gap = (uint64_t)UDP_LEN * 8 * 1000 / IPERF_BW;
+    int32_t id = 0;
+
+    printf("UDP test to %s, %d kbit/s for %d seconds\r\n", IPERF_CLIENT, IPERF_BW, IPERF_TIME);
+    cost_start(&cost);
+    meter_start(&m, "UDP tx");
+    uint32_t due = m.start;
+    while (1) {
+        uint32_t now = sys_now_us();
+        if (now - m.start >= IPERF_TIME * 1000000)
+            break;
+        /* Ahead by a tick or more, sleep it off */
+        int32_t ahead = (int32_t)(due - now);
+        if (ahead >= portTICK_RATE_MS * 1000) {
+            vTaskDelay(ahead / 1000 / portTICK_RATE_MS);
+            continue;
+        }
+        d->id = htonl(id);
+        d->tv_sec = htonl(now / 1000000);
+        d->tv_usec = htonl(now % 1000000);
+        if (lwip_send(s, buf, UDP_LEN, 0) == UDP_LEN) {
+            id++;
+            meter_add(&m, UDP_LEN);
+        }
+        cost_sample_heap(&cost);
+        due += gap;
+    }
+    meter_end(&m);
+    cost_report(&cost);
+
+    /* Final datagram, resent until the server replies with its report */
+    int timeout = 250;
+    lwip_setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    for (int tries = 0; tries < 10; tries++) {
+        uint32_t now = sys_now_us();
+        d->id = htonl(-id);
+        d->tv_sec = htonl(now / 1000000);
+        d->tv_usec = htonl(now % 1000000);
+        lwip_send(s, buf, UDP_LEN, 0);
+
+        static uint8_t reply[sizeof(struct udp_datagram) + sizeof(struct server_hdr)];
+        int r = lwip_recv(s, reply, sizeof(reply), 0);
+        if (r < (int)sizeof(reply))
+            continue;
+        struct server_hdr *h = (struct server_hdr *)(reply + sizeof(struct udp_datagram));
+        uint32_t us = ntohl(h->stop_sec) * 1000000 + ntohl(h->stop_usec);
+        uint64_t bytes = ((uint64_t)ntohl(h->total_len1) << 32) | ntohl(h->total_len2);
+        report("server", 0, us, bytes);
+        printf("server: %d lost of %d datagrams, %d out of order, jitter %u.%03u ms\r\n",
+               (int)ntohl(h->error_cnt), (int)ntohl(h->datagrams), (int)ntohl(h->outorder_cnt),
+               (unsigned)(ntohl(h->jitter1) * 1000 + ntohl(h->jitter2) / 1000),
+               (unsigned)(ntohl(h->jitter2) % 1000));
+        break;
+    }
+    lwip_close(s);
+}
+
+static void client_task(void *pvParameters)
+{
+    while (sdk_wifi_station_get_connect_status() != STATION_GOT_IP) {
+        vTaskDelay(100 / portTICK_RATE_MS);
+    }
+    if (IPERF_UDP)
+        udp_client();
+    else
+        tcp_client();
+    vTaskDelete(NULL);
+}
+#endif /* IPERF_CLIENT */
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    struct sdk_station_config config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+    };
+
+    /* required to call wifi_set_opmode before station_set_config */
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_station_set_config(&config);
+
+#ifdef IPERF_CLIENT
+    xTaskCreate(client_task, (signed char *)"iperf", 512, NULL, 2, NULL);
+#else
+    printf("iperf server on port %d, TCP and UDP\r\n", IPERF_PORT);
+    xTaskCreate(tcp_server_task, (signed char *)"iperf_tcp", 512, NULL, 2, NULL);
+    xTaskCreate(udp_server_task, (signed char *)"iperf_udp", 512, NULL, 2, NULL);
+#endif
+}
@@ -0,0 +1,136 @@
+/* json_api - Settings and status as JSON over TCP, on port 8000.
+ *
+ * Each connection takes a stream of JSON objects, e.g.
+ *   {"blink_ms": 250, "led": true}
+ * and answers each one with the current status:
+ *   {"uptime":12,"free_heap":31208,"blink_ms":250,"led":true}
+ *
+ * Requests are parsed as the segments arrive, and answers written
+ * through a netcork, so neither takes any memory per message. Try
+ * it with e.g. "nc <address> 8000".
+ *
+ * This sample code is in the public domain.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <espressif/esp_common.h>
+#include <esp/uart.h>
+#include <esp/gpio.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include <lwip/api.h>
+
+#include "ssid_config.h"
+#include "json/json_parser.h"
+#include "json/json_writer.h"
+
+#define API_PORT 8000
+#define LED_GPIO 2
+
+static volatile uint32_t blink_ms = 500;
+static volatile bool led_on = true;
+
+static void send_status(netcork_t *cork)
+{
+    json_writer_t jw;
+
+    json_writer_init_cork(&jw, cork);
+    json_write_object_start(&jw);
+    json_write_key(&jw, "uptime");
+    json_write_uint(&jw, xTaskGetTickCount() * portTICK_RATE_MS / 1000);
+    json_write_key(&jw, "free_heap");
+    json_write_uint(&jw, xPortGetFreeHeapSize());
+    json_write_key(&jw, "blink_ms");
+    json_write_uint(&jw, blink_ms);
+    json_write_key(&jw, "led");
+    json_write_bool(&jw, led_on);
+    json_write_object_end(&jw);
+    json_write_raw(&jw, "\n", 1);
+    netcork_flush(cork);
+}
+
+/* Settings come from the members of each top level object */
+static bool on_event(json_parser_t *jp, json_event_t event, const char *value, size_t len)
+{
+    netcork_t *cork = jp->arg;
+
+    if (jp->depth == 1 && event == JSON_NUMBER && !strcmp(jp->key, "blink_ms")) {
+        int ms = atoi(value);
+        if (ms > 0)
+            blink_ms = ms;
+    } else if (jp->depth == 1 && (event == JSON_TRUE || event == JSON_FALSE) && !strcmp(jp->key, "led")) {
+        led_on = (event == JSON_TRUE);
+    } else if (jp->depth == 0 && event == JSON_OBJECT_END) {
+        send_status(cork);
+    }
+    return true;
+}
+
+static void api_task(void *pvParameters)
+{
+    while (sdk_wifi_station_get_connect_status() != STATION_GOT_IP)
+        vTaskDelay(100 / portTICK_RATE_MS);
+
+    struct netconn *listener = netconn_new(NETCONN_TCP);
+    netconn_bind(listener, IP_ADDR_ANY, API_PORT);
+    netconn_listen(listener);
+
+    while (1) {
+        struct netconn *conn;
+        netcork_t cork;
+        json_parser_t jp;
+
+        if (netconn_accept(listener, &conn) != ERR_OK)
+            continue;
+        if (netcork_init(&cork, conn, 0) != ERR_OK) {
+            netconn_delete(conn);
+            continue;
+        }
+        json_parser_init(&jp, on_event, &cork);
+
+        struct netbuf *nb;
+        while (netconn_recv(conn, &nb) == ERR_OK) {
+            int err = json_parser_feed_netbuf(&jp, nb);
+            netbuf_delete(nb);
+            if (err != JSON_PARSER_OK) {
+                printf("Bad request, error %d at byte %u\n", err, jp.offset);
+                break;
+            }
+        }
+        netcork_free(&cork);
+        netconn_close(conn);
+        netconn_delete(conn);
+    }
+}
+
+static void blink_task(void *pvParameters)
+{
+    gpio_enable(LED_GPIO, GPIO_OUTPUT);
+    while (1) {
+        gpio_toggle(LED_GPIO);
+        if (!led_on)
+            gpio_write(LED_GPIO, 1);
+        vTaskDelay(blink_ms / portTICK_RATE_MS);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    struct sdk_station_config config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+    };
+
+    /* required to call wifi_set_opmode before station_set_config */
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_station_set_config(&config);
+
+    xTaskCreate(api_task, (signed char *)"api", 512, NULL, 2, NULL);
+    xTaskCreate(blink_task, (signed char *)"blink", 256, NULL, 2, NULL);
+}
@@ -0,0 +1,131 @@
+/* mbedtls_bignum_bench - time the public key operations of a TLS handshake.
+ *
+ * Runs modular exponentiation at RSA sizes (public and private key
+ * operations) and a P-256 scalar multiplication (one ECDHE half), and
+ * prints the time each takes.
+ *
+ * To compare the LX106 MULADDC (extras/mbedtls/include/bn_mul_lx106.h)
+ * with mbedtls' generic C version, build and run it both ways:
+ *
+ *     make flash
+ *     make clean && make flash EXTRA_CFLAGS=-DMBEDTLS_BN_MUL_GENERIC
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "esp/hwrand.h"
+
+#include <stdio.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "mbedtls/config.h"
+#include "mbedtls/bignum.h"
+#include "mbedtls/ecp.h"
+
+#define RUNS 3
+
+static int hw_rng(void *ctx, unsigned char *buf, size_t len)
+{
+    hwrand_fill(buf, len);
+    return 0;
+}
+
+/* X = A^E mod N, for random A and an odd random N of 'bits', with an
+   exponent of 'exp_bits' bits (17 bits is the usual 65537 public exponent) */
+static void bench_exp_mod(const char *name, int bits, int exp_bits)
+{
+    mbedtls_mpi A, E, N, X, RR;
+    mbedtls_mpi_init(&A);
+    mbedtls_mpi_init(&E);
+    mbedtls_mpi_init(&N);
+    mbedtls_mpi_init(&X);
+    mbedtls_mpi_init(&RR);
+
+    mbedtls_mpi_fill_random(&N, bits / 8, hw_rng, NULL);
+    mbedtls_mpi_set_bit(&N, bits - 1, 1);
+    mbedtls_mpi_set_bit(&N, 0, 1);
+    mbedtls_mpi_fill_random(&A, bits / 8 - 1, hw_rng, NULL);
+    if (exp_bits == 17) {
+        mbedtls_mpi_lset(&E, 65537);
+    } else {
+        mbedtls_mpi_fill_random(&E, exp_bits / 8, hw_rng, NULL);
+    }
+
+    uint32_t total = 0;
+    for (int i = 0; i < RUNS; i++) {
+        uint32_t start = sdk_system_get_time();
+        /* RR caches R^2 mod N between runs, as RSA keys do */
+        int ret = mbedtls_mpi_exp_mod(&X, &A, &E, &N, &RR);
+        uint32_t elapsed = sdk_system_get_time() - start;
+        if (ret) {
+            printf("%s: mbedtls_mpi_exp_mod returned -0x%x\n", name, -ret);
+            break;
+        }
+        total += elapsed;
+    }
+    printf("%-24s %8u us\n", name, total / RUNS);
+
+    mbedtls_mpi_free(&A);
+    mbedtls_mpi_free(&E);
+    mbedtls_mpi_free(&N);
+    mbedtls_mpi_free(&X);
+    mbedtls_mpi_free(&RR);
+}
+
+static void bench_ecp_mul(const char *name, mbedtls_ecp_group_id id)
+{
+    mbedtls_ecp_group grp;
+    mbedtls_ecp_point R;
+    mbedtls_mpi d;
+    mbedtls_ecp_group_init(&grp);
+    mbedtls_ecp_point_init(&R);
+    mbedtls_mpi_init(&d);
+
+    mbedtls_ecp_group_load(&grp, id);
+    mbedtls_ecp_gen_keypair(&grp, &d, &R, hw_rng, NULL);
+
+    uint32_t total = 0;
+    for (int i = 0; i < RUNS; i++) {
+        uint32_t start = sdk_system_get_time();
+        int ret = mbedtls_ecp_mul(&grp, &R, &d, &grp.G, hw_rng, NULL);
+        uint32_t elapsed = sdk_system_get_time() - start;
+        if (ret) {
+            printf("%s: mbedtls_ecp_mul returned -0x%x\n", name, -ret);
+            break;
+        }
+        total += elapsed;
+    }
+    printf("%-24s %8u us\n", name, total / RUNS);
+
+    mbedtls_ecp_group_free(&grp);
+    mbedtls_ecp_point_free(&R);
+    mbedtls_mpi_free(&d);
+}
+
+static void bench_task(void *pvParameters)
+{
+    while (1) {
+#ifdef MBEDTLS_BN_MUL_GENERIC
+        printf("\nbignum benchmark, generic C MULADDC, average of %d runs\n", RUNS);
+#else
+        printf("\nbignum benchmark, LX106 MULADDC, average of %d runs\n", RUNS);
+#endif
+        bench_exp_mod("RSA-1024 public", 1024, 17);
+        bench_exp_mod("RSA-2048 public", 2048, 17);
+        /* a CRT private key operation is two of these */
+        bench_exp_mod("RSA-1024 private, half", 512, 512);
+        bench_exp_mod("RSA-2048 private, half", 1024, 1024);
+        bench_ecp_mul("ECDHE P-256", MBEDTLS_ECP_DP_SECP256R1);
+        vTaskDelay(10000 / portTICK_RATE_MS);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    /* bignum operations need a deep stack */
+    xTaskCreate(bench_task, (signed char *)"bench", 2048, NULL, 2, NULL);
+}
@@ -0,0 +1,66 @@
+/* mdns_responder - answer "esp-open-rtos.local" and advertise a service
+ *
+ * Once connected, try
+ *   ping esp-open-rtos.local
+ *   avahi-browse -r _example._tcp     (or dns-sd -B _example._tcp)
+ *
+ * The responder runs in tcpip_thread; after starting it this task only
+ * re-announces when the station reconnects.
+ *
+ * This sample code is in the public domain.
+ */
+#include <stdio.h>
+
+#include <espressif/esp_common.h>
+#include <esp/uart.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "ssid_config.h"
+#include "mdns/mdns.h"
+
+static const char *example_txt[] = { "board=esp8266", "version=1", NULL };
+
+static const mdns_service_t services[] = {
+    { .instance = "esp-open-rtos example", .service = "_example", .proto = "_tcp",
+      .port = 1234, .txt = example_txt },
+};
+
+static void mdns_task(void *pvParameters)
+{
+    while (sdk_wifi_station_get_connect_status() != STATION_GOT_IP)
+        vTaskDelay(100 / portTICK_RATE_MS);
+
+    if (!mdns_start("esp-open-rtos", services, sizeof(services) / sizeof(services[0]))) {
+        printf("mdns_start failed\n");
+        vTaskDelete(NULL);
+        return;
+    }
+    printf("mDNS responder started\n");
+
+    bool connected = true;
+    while (1) {
+        vTaskDelay(1000 / portTICK_RATE_MS);
+        bool now = sdk_wifi_station_get_connect_status() == STATION_GOT_IP;
+        if (now && !connected)
+            mdns_announce();
+        connected = now;
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    struct sdk_station_config config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+    };
+
+    /* required to call wifi_set_opmode before station_set_config */
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_station_set_config(&config);
+
+    xTaskCreate(mdns_task, (signed char *)"mdns", 256, NULL, 2, NULL);
+}
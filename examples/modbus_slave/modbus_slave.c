@@ -0,0 +1,131 @@
+/* modbus_slave - a Modbus RTU slave on UART0 that's also a Modbus TCP server
+ *
+ * Unit 1 at 19200 8E1, with an RS-485 transceiver's DE (and /RE) on
+ * GPIO4. The same map is served on TCP port 502:
+ *
+ *   coils 0-7            coil 0 is the LED on GPIO2 (on when set)
+ *   holding registers    0-15, kept in RAM
+ *   input registers      0: uptime in seconds, 1: free heap in bytes
+ *
+ * Try it with "mbpoll -m tcp -r 1 -c 4 <address>", or on the bus with
+ * "mbpoll -m rtu -b 19200 -P even -a 1 -t 3 -r 1 -c 4 /dev/ttyUSB0".
+ *
+ * UART0 is the bus once the server has started, so there's no printf
+ * output after that.
+ *
+ * This sample code is in the public domain.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include <espressif/esp_common.h>
+#include <esp/uart.h>
+#include <esp/gpio.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "ssid_config.h"
+#include "modbus/modbus.h"
+
+#define LED_GPIO 2
+#define DE_GPIO 4
+
+static uint8_t coils;
+static uint16_t holding[16];
+
+static uint8_t read_bits(modbus_table_t table, uint16_t addr, uint16_t count,
+                         uint8_t *bits, void *arg)
+{
+    if (table != MODBUS_COILS)
+        return MODBUS_EX_ILLEGAL_FUNCTION;
+    if (addr + count > 8)
+        return MODBUS_EX_ILLEGAL_ADDRESS;
+    bits[0] = (coils >> addr) & ((1 << count) - 1);
+    return 0;
+}
+
+static uint8_t write_coils(uint16_t addr, uint16_t count, const uint8_t *bits, void *arg)
+{
+    if (addr + count > 8)
+        return MODBUS_EX_ILLEGAL_ADDRESS;
+    for (int i = 0; i < count; i++) {
+        uint8_t mask = 1 << (addr + i);
+        if (bits[i / 8] & (1 << (i % 8)))
+            coils |= mask;
+        else
+            coils &= ~mask;
+    }
+    /* The LED is active low */
+    gpio_write(LED_GPIO, !(coils & 1));
+    return 0;
+}
+
+static uint8_t read_registers(modbus_table_t table, uint16_t addr, uint16_t count,
+                              uint16_t *regs, void *arg)
+{
+    if (table == MODBUS_HOLDING_REGISTERS) {
+        if (addr + count > 16)
+            return MODBUS_EX_ILLEGAL_ADDRESS;
+        memcpy(regs, holding + addr, count * sizeof(uint16_t));
+        return 0;
+    }
+    if (addr + count > 2)
+        return MODBUS_EX_ILLEGAL_ADDRESS;
+    for (int i = 0; i < count; i++) {
+        if (addr + i == 0)
+            regs[i] = xTaskGetTickCount() / configTICK_RATE_HZ;
+        else
+            regs[i] = xPortGetFreeHeapSize();
+    }
+    return 0;
+}
+
+static uint8_t write_registers(uint16_t addr, uint16_t count, const uint16_t *regs, void *arg)
+{
+    if (addr + count > 16)
+        return MODBUS_EX_ILLEGAL_ADDRESS;
+    memcpy(holding + addr, regs, count * sizeof(uint16_t));
+    return 0;
+}
+
+static const modbus_map_t map = {
+    .read_bits = read_bits,
+    .write_coils = write_coils,
+    .read_registers = read_registers,
+    .write_registers = write_registers,
+};
+
+static void modbus_start_task(void *pvParameters)
+{
+    /* The TCP listener needs the network up */
+    while (sdk_wifi_station_get_connect_status() != STATION_GOT_IP)
+        vTaskDelay(100 / portTICK_RATE_MS);
+
+    modbus_config_t config = MODBUS_DEFAULT_CONFIG;
+    config.de_gpio = DE_GPIO;
+    printf("starting Modbus unit %d\n", config.unit);
+    uart_flush_txfifo(0);
+    if (!modbus_start(&config, &map))
+        printf("modbus_start failed\n");
+    vTaskDelete(NULL);
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    gpio_enable(LED_GPIO, GPIO_OUTPUT);
+    gpio_write(LED_GPIO, 1);
+
+    struct sdk_station_config config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+    };
+
+    /* required to call wifi_set_opmode before station_set_config */
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_station_set_config(&config);
+
+    xTaskCreate(modbus_start_task, (signed char *)"modbus_start", 256, NULL, 2, NULL);
+}
@@ -0,0 +1,90 @@
+/* mqtt_sensor - Publish readings to an MQTT broker in batches.
+ *
+ * Publishes a reading (the free heap here) every 100ms at QoS 1 to
+ * MQTT_BROKER. With batch_ms set, each second's worth goes out in one
+ * or two segments and their acknowledgements come back as few, rather
+ * than a round trip per message. Messages on "esp/cmd" are printed.
+ * Statistics are printed every 10 seconds.
+ *
+ * This sample code is in the public domain.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include <espressif/esp_common.h>
+#include <esp/uart.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include <lwip/api.h>
+
+#include "ssid_config.h"
+#include "mqtt/mqtt.h"
+
+#define MQTT_BROKER "test.mosquitto.org"
+
+static mqtt_client_t client;
+
+static void connected(mqtt_client_t *c)
+{
+    printf("Connected to broker\n");
+    mqtt_subscribe(c, "esp/cmd", 1);
+}
+
+static void message(mqtt_client_t *c, const char *topic, size_t topic_len,
+                    const void *data, size_t len)
+{
+    printf("%.*s: %.*s\n", (int)topic_len, topic, (int)len, (const char *)data);
+}
+
+static void sensor_task(void *pvParameters)
+{
+    while (sdk_wifi_station_get_connect_status() != STATION_GOT_IP)
+        vTaskDelay(100 / portTICK_RATE_MS);
+
+    mqtt_config_t config = {
+        .client_id = "esp-open-rtos-sensor",
+        .keepalive_s = 60,
+        .clean_session = false,
+        .batch_ms = 1000,
+        .connected = connected,
+        .message = message,
+    };
+    while (netconn_gethostbyname(MQTT_BROKER, &config.broker) != ERR_OK) {
+        printf("DNS lookup of %s failed\n", MQTT_BROKER);
+        vTaskDelay(5000 / portTICK_RATE_MS);
+    }
+    mqtt_start(&client, &config);
+
+    for (int i = 0; ; i++) {
+        char reading[32];
+        int len = snprintf(reading, sizeof(reading), "%u", sdk_system_get_free_heap_size());
+        if (mqtt_publish(&client, "esp/heap", reading, len, 1, false) != MQTT_OK)
+            printf("Queue full, reading dropped\n");
+
+        if (i % 100 == 0) {
+            mqtt_stats_t stats;
+            mqtt_get_stats(&client, &stats);
+            printf("published %u acked %u in %u writes, %u reconnects\n",
+                   stats.published, stats.acked, stats.writes, stats.reconnects);
+        }
+        vTaskDelay(100 / portTICK_RATE_MS);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    struct sdk_station_config config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+    };
+
+    /* required to call wifi_set_opmode before station_set_config */
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_station_set_config(&config);
+
+    xTaskCreate(sensor_task, (signed char *)"sensor", 512, NULL, 2, NULL);
+}
@@ -0,0 +1,90 @@
+/* napt_repeater - Extend a Wi-Fi network through the softAP.
+ *
+ * Connects to the network in ssid_config.h as a station, then runs a
+ * softAP (with a DHCP server) whose clients reach that network, and
+ * the internet behind it, through extras/napt. The softAP's subnet
+ * must differ from the station's. Prints translation statistics every
+ * 10 seconds.
+ *
+ * This sample code is in the public domain.
+ */
+#include <string.h>
+#include <stdio.h>
+
+#include <espressif/esp_common.h>
+#include <esp/uart.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <dhcpserver.h>
+
+#include <lwip/dns.h>
+
+#include "ssid_config.h"
+#include "napt/napt.h"
+
+#define AP_SSID "esp-open-rtos repeater"
+#define AP_PSK "esp-open-rtos"
+
+static void repeater_task(void *pvParameters)
+{
+    while (sdk_wifi_station_get_connect_status() != STATION_GOT_IP)
+        vTaskDelay(100 / portTICK_RATE_MS);
+
+    /* Clients use the station side's DNS server, through the NAPT */
+    ip_addr_t dns = dns_getserver(0);
+    struct ip_info ap_ip;
+    sdk_wifi_get_ip_info(SOFTAP_IF, &ap_ip);
+    dhcpserver_set_router(&ap_ip.ip);
+    dhcpserver_set_dns(&dns);
+
+    ip_addr_t first_client_ip;
+    IP4_ADDR(&first_client_ip, 172, 16, 0, 2);
+    dhcpserver_start(&first_client_ip, 8);
+
+    if (!napt_enable()) {
+        printf("napt_enable failed\n");
+        vTaskDelete(NULL);
+    }
+
+    for (;;) {
+        napt_stats_t stats;
+        vTaskDelay(10000 / portTICK_RATE_MS);
+        napt_get_stats(&stats);
+        printf("out %u in %u dropped %u full %u active %u\n", stats.outbound, stats.inbound,
+               stats.dropped, stats.table_full, stats.active);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    sdk_wifi_set_opmode(STATIONAP_MODE);
+
+    struct sdk_station_config config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+    };
+    sdk_wifi_station_set_config(&config);
+
+    struct ip_info ap_ip;
+    IP4_ADDR(&ap_ip.ip, 172, 16, 0, 1);
+    IP4_ADDR(&ap_ip.gw, 0, 0, 0, 0);
+    IP4_ADDR(&ap_ip.netmask, 255, 255, 255, 0);
+    sdk_wifi_set_ip_info(SOFTAP_IF, &ap_ip);
+
+    struct sdk_softap_config ap_config = {
+        .ssid = AP_SSID,
+        .ssid_hidden = 0,
+        .channel = 1,
+        .ssid_len = strlen(AP_SSID),
+        .authmode = AUTH_WPA_WPA2_PSK,
+        .password = AP_PSK,
+        .max_connection = 4,
+        .beacon_interval = 100,
+    };
+    sdk_wifi_softap_set_config(&ap_config);
+
+    xTaskCreate(repeater_task, (signed char *)"repeater", 512, NULL, 2, NULL);
+}
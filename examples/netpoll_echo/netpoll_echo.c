@@ -0,0 +1,94 @@
+/* netpoll_echo - a TCP echo server for many clients, in one task
+ *
+ * Every connection, and the listener, is on one netpoll (netpoll.h),
+ * and the task only touches the ones that are ready. Try it with a few
+ * of "nc <address> 7" at once.
+ *
+ * This sample code is in the public domain.
+ */
+#include <stdio.h>
+
+#include <espressif/esp_common.h>
+#include <esp/uart.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <lwip/api.h>
+
+#include "ssid_config.h"
+#include "netpoll.h"
+
+#define ECHO_PORT 7
+
+static void close_client(struct netconn *conn)
+{
+    netpoll_remove(conn);
+    netconn_close(conn);
+    netconn_delete(conn);
+}
+
+static void echo_task(void *pvParameters)
+{
+    netpoll_t *poll = netpoll_create();
+    struct netconn *listener = netpoll_netconn_new(NETCONN_TCP);
+
+    if (!poll || !listener) {
+        printf("out of memory\n");
+        vTaskDelete(NULL);
+        return;
+    }
+    netconn_bind(listener, IP_ADDR_ANY, ECHO_PORT);
+    netconn_listen(listener);
+    netpoll_add(poll, listener, NETPOLL_IN, NULL);
+
+    while (1) {
+        netpoll_event_t ev[8];
+        int n = netpoll_wait(poll, ev, 8, 0);
+
+        for (int i = 0; i < n; i++) {
+            struct netconn *conn = ev[i].conn;
+
+            if (conn == listener) {
+                struct netconn *client;
+                if (netconn_accept(listener, &client) != ERR_OK)
+                    continue;
+                if (!netpoll_add(poll, client, NETPOLL_IN, NULL)) {
+                    printf("too many clients\n");
+                    netconn_close(client);
+                    netconn_delete(client);
+                }
+                continue;
+            }
+
+            struct netbuf *buf;
+            if (ev[i].events & NETPOLL_ERR || netconn_recv(conn, &buf) != ERR_OK) {
+                close_client(conn);
+                continue;
+            }
+            void *data;
+            u16_t len;
+            netbuf_first(buf);
+            do {
+                netbuf_data(buf, &data, &len);
+                netconn_write(conn, data, len, NETCONN_COPY);
+            } while (netbuf_next(buf) >= 0);
+            netbuf_delete(buf);
+        }
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    struct sdk_station_config config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+    };
+
+    /* required to call wifi_set_opmode before station_set_config */
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_station_set_config(&config);
+
+    xTaskCreate(echo_task, (signed char *)"echo", 512, NULL, 2, NULL);
+}
@@ -14,6 +14,7 @@
 #include "ssid_config.h"
 
 #include "ota-tftp.h"
+#include "ota-mcast.h"
 #include "rboot-ota.h"
 
 void user_init(void)
@@ -37,4 +38,9 @@ void user_init(void)
     sdk_wifi_station_set_config(&config);
 
     ota_tftp_init_server(TFTP_PORT);
+
+    /* Also take images broadcast to the whole network, with
+       python extras/rboot-ota/ota_mcast_send.py firmware/ota_basic.bin <broadcast address>
+       (Don't send one both ways at once, they write the same slot.) */
+    ota_mcast_init_receiver(NULL, OTA_MCAST_PORT);
 }
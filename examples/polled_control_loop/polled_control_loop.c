@@ -0,0 +1,111 @@
+/* polled_control_loop - One task for a control loop and its network.
+ *
+ * Built with LWIP_POLLED_INPUT, so received frames wait for the control
+ * task instead of going through tcpip_thread. The task runs a step
+ * every CONTROL_PERIOD_MS, and in between handles any frames as they
+ * arrive: "set <n>" datagrams to port 8008 change the setpoint and are
+ * answered with the current state, straight from the loop.
+ *
+ *     echo "set 42" | nc -u -w1 <esp8266 address> 8008
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "lwip/udp.h"
+#include "lwip/tcpip.h"
+#include "ethernetif_poll.h"
+
+#include "ssid_config.h"
+
+#define CONTROL_PORT 8008
+#define CONTROL_PERIOD_MS 10
+
+static int32_t setpoint, output;
+static uint32_t steps;
+
+static void control_step(void)
+{
+    /* Stand-in for the real controller: move a step towards the setpoint */
+    if (output < setpoint)
+        output++;
+    else if (output > setpoint)
+        output--;
+    steps++;
+}
+
+/* Runs in control_task, from ethernetif_poll() */
+static void control_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *addr, u16_t port)
+{
+    char cmd[16];
+    char reply[48];
+
+    u16_t len = pbuf_copy_partial(p, cmd, sizeof(cmd) - 1, 0);
+    cmd[len] = 0;
+    pbuf_free(p);
+    if (!strncmp(cmd, "set ", 4))
+        setpoint = atoi(cmd + 4);
+
+    len = snprintf(reply, sizeof(reply), "setpoint %d output %d steps %u\n", setpoint, output, steps);
+    struct pbuf *r = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+    if (r == NULL)
+        return;
+    memcpy(r->payload, reply, len);
+    udp_sendto(pcb, r, addr, port);
+    pbuf_free(r);
+}
+
+static void control_task(void *pvParameters)
+{
+    /* Raw API calls outside ethernetif_poll() need the core lock */
+    LOCK_TCPIP_CORE();
+    struct udp_pcb *pcb = udp_new();
+    bool ok = pcb && udp_bind(pcb, IP_ADDR_ANY, CONTROL_PORT) == ERR_OK;
+    if (ok)
+        udp_recv(pcb, control_recv, NULL);
+    UNLOCK_TCPIP_CORE();
+    if (!ok) {
+        printf("Can't bind port %d\n", CONTROL_PORT);
+        vTaskDelete(NULL);
+        return;
+    }
+
+    ethernetif_poll_set_task(xTaskGetCurrentTaskHandle());
+    portTickType next = xTaskGetTickCount();
+    while (1) {
+        portTickType now = xTaskGetTickCount();
+        if ((int32_t)(next - now) <= 0) {
+            control_step();
+            next += CONTROL_PERIOD_MS / portTICK_RATE_MS;
+            continue;
+        }
+        /* Woken by a frame, or at the next step */
+        ulTaskNotifyTake(pdTRUE, next - now);
+        ethernetif_poll(0);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    struct sdk_station_config config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+    };
+
+    /* required to call wifi_set_opmode before station_set_config */
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_station_set_config(&config);
+
+    xTaskCreate(control_task, (signed char *)"control", 512, NULL, 4, NULL);
+}
@@ -0,0 +1,142 @@
+/* profiler - Sample where a workload spends its time.
+ *
+ * Runs a CPU bound workload (CRC and sorting, standing in for an
+ * application's own work) for a few seconds under the sampling profiler
+ * in esp/profiler.h, then dumps the histogram over the UART. Turn it
+ * into a per-function profile with
+ *
+ *     python ../../utils/prof_symbolize.py build/profiler.out serial.log
+ *
+ * and feed that to the IRAM placement with
+ *
+ *     make flash IRAM_HOT_FUNCS=hot.txt
+ *
+ * to see the effect on the workload's run time.
+ *
+ * Building with EXTRA_CFLAGS='-DPROFILE_UDP_HOST=\"192.168.1.10\"' also
+ * sends the dump as UDP datagrams to that host, port 5555 (nc -ul 5555),
+ * for boards whose UART is in use.
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "esp/profiler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#ifdef PROFILE_UDP_HOST
+#include "lwip/sockets.h"
+#include "ssid_config.h"
+
+#define PROFILE_UDP_PORT 5555
+#endif
+
+#define SAMPLE_RATE_HZ 2000
+#define MAX_PCS 512
+#define RUN_MS 5000
+
+static uint8_t data[2048];
+
+static uint32_t crc32(const uint8_t *p, size_t len)
+{
+    uint32_t crc = 0xffffffff;
+
+    while (len--) {
+        crc ^= *p++;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+static int compare(const void *a, const void *b)
+{
+    return *(const uint8_t *)a - *(const uint8_t *)b;
+}
+
+static uint32_t workload(void)
+{
+    for (int i = 0; i < sizeof(data); i++) {
+        data[i] = rand();
+    }
+    qsort(data, sizeof(data), 1, compare);
+    return crc32(data, sizeof(data));
+}
+
+#ifdef PROFILE_UDP_HOST
+static void udp_emit(const char *line, void *arg)
+{
+    int s = *(int *)arg;
+    struct sockaddr_in addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(PROFILE_UDP_PORT);
+    addr.sin_addr.s_addr = inet_addr(PROFILE_UDP_HOST);
+    lwip_sendto(s, line, strlen(line), 0, (struct sockaddr *)&addr, sizeof(addr));
+    /* Don't run the Wi-Fi transmit queue out of buffers */
+    vTaskDelay(1);
+}
+
+static void udp_dump(void)
+{
+    while (sdk_wifi_station_get_connect_status() != STATION_GOT_IP) {
+        vTaskDelay(100 / portTICK_RATE_MS);
+    }
+    int s = lwip_socket(AF_INET, SOCK_DGRAM, 0);
+    if (s < 0) {
+        printf("# socket failed\n");
+        return;
+    }
+    profiler_dump(udp_emit, &s);
+    lwip_close(s);
+}
+#endif
+
+static void profile_task(void *pvParameters)
+{
+    profiler_stats_t stats;
+    uint32_t runs = 0;
+
+    if (!profiler_start(SAMPLE_RATE_HZ, MAX_PCS)) {
+        printf("# profiler_start failed\n");
+        vTaskDelete(NULL);
+    }
+    portTickType start = xTaskGetTickCount();
+    while (xTaskGetTickCount() - start < RUN_MS / portTICK_RATE_MS) {
+        workload();
+        runs++;
+    }
+    profiler_stop();
+
+    profiler_get_stats(&stats);
+    printf("# %u runs in %u ms, %u distinct PCs\n", runs, RUN_MS, stats.entries);
+    profiler_dump(NULL, NULL);
+#ifdef PROFILE_UDP_HOST
+    udp_dump();
+#endif
+    vTaskDelete(NULL);
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+
+#ifdef PROFILE_UDP_HOST
+    struct sdk_station_config config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+    };
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_station_set_config(&config);
+#endif
+
+    xTaskCreate(profile_task, (signed char *)"profile", 512, NULL, 2, NULL);
+}
@@ -0,0 +1,67 @@
+/* romfs_files - read files from a romfs image linked into flash.
+ *
+ * The files/ directory is packed into an image at build time (ROMFS_DIR
+ * in the Makefile) and linked into IROM. This reads them back with stdio,
+ * and with romfs_find(), which gives a pointer straight to the file in
+ * the flash cache window, e.g. to hand to netconn_write() for a web
+ * server without a DRAM copy of the asset.
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "esp/flashmap.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "romfs/romfs.h"
+
+#include <stdio.h>
+
+static void cat_file(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        printf("%s: can't open\n", path);
+        return;
+    }
+    printf("--- %s ---\n", path);
+    char line[64];
+    while (fgets(line, sizeof(line), f)) {
+        printf("%s", line);
+    }
+    fclose(f);
+}
+
+static void romfs_task(void *pvParameters)
+{
+    cat_file("/hello.txt");
+    cat_file("/css/style.css");
+
+    romfs_file_t file;
+    if (romfs_find("/index.html", &file)) {
+        /* the data is word aligned, so a word checksum can read it directly */
+        const uint32_t *words = file.data;
+        uint32_t sum = 0;
+        for (int i = 0; i < file.size / 4; i++) {
+            sum += words[i];
+        }
+        printf("index.html: %u bytes at %p (flash 0x%08x), word sum 0x%08x\n",
+               file.size, file.data, flashmap_flash_addr(file.data), sum);
+    }
+
+    while (1) {
+        vTaskDelay(10000 / portTICK_RATE_MS);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+
+    if (!romfs_mount(romfs_image)) {
+        printf("romfs_mount failed\n");
+        return;
+    }
+    xTaskCreate(romfs_task, (signed char *)"romfs", 512, NULL, 2, NULL);
+}
@@ -0,0 +1,105 @@
+/* sdio_wifi_nic - the ESP8266 as a Wi-Fi network interface for an SDIO host
+ *
+ * The host is SDIO master and talks to extras/sdio_slave (see
+ * sdio_slave.h for the protocol). Every frame the station receives is
+ * passed up to the host as a CMD_ETH frame, the 802.3 frame as it came
+ * from the WLAN, and CMD_ETH frames from the host are sent out of the
+ * station as they are. The host's network stack does the rest (DHCP,
+ * ARP, ...) using the station's MAC address, which CMD_INFO returns
+ * followed by the station's connect status (STATION_* in esp_sta.h).
+ * lwIP on the ESP8266 sees none of the traffic.
+ *
+ * The station joins the network in ssid_config.h.
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "lwip/netif.h"
+#include "lwip/tcpip.h"
+#include "ethernetif_filter.h"
+#include "sdio_slave/sdio_slave.h"
+
+#include "ssid_config.h"
+
+#define CMD_ETH  0x20
+#define CMD_INFO 0x21
+
+/* In tcpip_thread, where the WLAN output normally runs */
+static void wifi_output(void *arg)
+{
+    struct pbuf *p = arg;
+
+    if (netif_default)
+        netif_default->linkoutput(netif_default, p);
+    pbuf_free(p);
+}
+
+static void host_frame(uint8_t cmd, uint8_t seq, struct pbuf *p)
+{
+    switch (cmd) {
+    case CMD_ETH:
+        if (tcpip_callback(wifi_output, p) != ERR_OK)
+            pbuf_free(p);
+        return;
+    case CMD_INFO: {
+        uint8_t info[7];
+        sdk_wifi_get_macaddr(STATION_IF, info);
+        info[6] = sdk_wifi_station_get_connect_status();
+        sdio_slave_send_data(CMD_INFO, seq, info, sizeof(info));
+        break;
+    }
+    default:
+        break;
+    }
+    pbuf_free(p);
+}
+
+/* Every received frame goes to the host, none to lwIP */
+static int wifi_input(struct netif *netif, struct pbuf *p)
+{
+    sdio_slave_send(CMD_ETH, 0, p);
+    return 0;
+}
+
+static void stats_task(void *pvParameters)
+{
+    while (1) {
+        vTaskDelay(10000 / portTICK_RATE_MS);
+        sdio_slave_stats_t s;
+        sdio_slave_stats(&s);
+        printf("rx %u tx %u, rx errors %u, rx no pbuf %u, tx full %u\n",
+               s.rx_frames, s.tx_frames, s.rx_errors, s.rx_nomem, s.tx_full);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    struct sdk_station_config config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+    };
+
+    /* required to call wifi_set_opmode before station_set_config */
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_station_set_config(&config);
+    /* The host runs DHCP itself */
+    sdk_wifi_station_dhcpc_stop();
+
+    ethernetif_filter_set_hook(wifi_input);
+    if (!sdio_slave_init(host_frame, 4)) {
+        printf("sdio_slave_init failed\n");
+        return;
+    }
+    xTaskCreate(stats_task, (signed char *)"stats", 256, NULL, 2, NULL);
+}
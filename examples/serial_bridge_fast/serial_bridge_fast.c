@@ -0,0 +1,47 @@
+/* serial_bridge_fast - UART0 at 921600 baud bridged to TCP port 23.
+ *
+ * Uses extras/serialbridge, which sends from the UART's RX ring
+ * without an intermediate copy and coalesces writes to full segments,
+ * with RTS/CTS flow control on GPIO15/GPIO13. For an RS-485 adapter
+ * without flow control set .rts and .cts false, and size the RX ring
+ * for the longest network stall to ride out.
+ *
+ * The bridge owns UART0, so nothing here prints after startup. Connect
+ * with e.g. "nc <address> 23".
+ *
+ * This sample code is in the public domain.
+ */
+#include <stdio.h>
+
+#include <espressif/esp_common.h>
+#include <esp/uart.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "ssid_config.h"
+#include "serialbridge/serialbridge.h"
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+    printf("Switching to 921600 baud, bridge on port 23\n");
+    uart_flush_txfifo(0);
+
+    struct sdk_station_config config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+    };
+
+    /* required to call wifi_set_opmode before station_set_config */
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_station_set_config(&config);
+
+    serialbridge_config_t bridge = SERIALBRIDGE_DEFAULT_CONFIG;
+    bridge.baud = 921600;
+    bridge.rx_ring = 4096;
+    bridge.latency_ms = 10;
+    bridge.rts = true;
+    bridge.cts = true;
+    serialbridge_start(&bridge);
+}
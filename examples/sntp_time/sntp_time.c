@@ -0,0 +1,85 @@
+/* sntp_time - keep the time of day with extras/sntp
+ *
+ * Once the station is up, disciplines the clock against SNTP_SERVER
+ * (pool.ntp.org unless given on the make command line) and every ten
+ * seconds prints the UTC time from gettimeofday() along with the last
+ * measured offset and round trip, the frequency correction and the
+ * poll interval. The offsets should settle to around a millisecond,
+ * and the poll interval grow to 1024s, within the first hour.
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "timeofday.h"
+#include "sntp/sntp.h"
+
+#include "ssid_config.h"
+
+#ifndef SNTP_SERVER
+#define SNTP_SERVER "pool.ntp.org"
+#endif
+
+void time_task(void *pvParameters)
+{
+    while (sdk_wifi_station_get_connect_status() != STATION_GOT_IP)
+        vTaskDelay(100 / portTICK_RATE_MS);
+
+    printf("Polling %s\r\n", SNTP_SERVER);
+    sntp_start(SNTP_SERVER);
+
+    while (1) {
+        vTaskDelay(10000 / portTICK_RATE_MS);
+
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        if (!timeofday_is_set()) {
+            printf("Not set yet, up %lds\r\n", (long)tv.tv_sec);
+            continue;
+        }
+        struct tm tm;
+        char buf[32];
+        time_t secs = tv.tv_sec;
+        gmtime_r(&secs, &tm);
+        strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+
+        sntp_stats_t stats;
+        sntp_get_stats(&stats);
+        /* the first offset is the whole step, from 1970 */
+        long offset = stats.offset_us;
+        const char *unit = "us";
+        if (stats.offset_us > 1000000000 || stats.offset_us < -1000000000) {
+            offset = stats.offset_us / 1000000;
+            unit = "s";
+        }
+        printf("%s.%06ld UTC offset %ld%s delay %uus freq %dppb poll %us "
+               "(%u requests, %u replies, %u rejected)\r\n",
+               buf, (long)tv.tv_usec, offset, unit, stats.delay_us,
+               stats.freq_ppb, stats.poll_s, stats.requests, stats.replies, stats.rejected);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    struct sdk_station_config config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+    };
+
+    /* required to call wifi_set_opmode before station_set_config */
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_station_set_config(&config);
+
+    xTaskCreate(time_task, (signed char *)"time", 384, NULL, 2, NULL);
+}
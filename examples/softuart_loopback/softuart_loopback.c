@@ -0,0 +1,61 @@
+/* softuart_loopback - a software UART talking to itself
+ *
+ * Wire GPIO4 (TX) to GPIO5 (RX). A line is sent every second at 38400
+ * baud and whatever comes back is printed on UART0, with the error
+ * counts.
+ *
+ * This sample code is in the public domain.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include <espressif/esp_common.h>
+#include <esp/uart.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "softuart/softuart.h"
+
+#define PORT 0
+#define RX_GPIO 5
+#define TX_GPIO 4
+#define BAUD 38400
+
+static void send_task(void *pvParameters)
+{
+    char line[48];
+
+    for (uint32_t n = 0; ; n++) {
+        /* 'U' is 0x55, an edge every bit */
+        snprintf(line, sizeof(line), "line %u UUUU\r\n", n);
+        softuart_write(PORT, line, strlen(line));
+        vTaskDelay(1000 / portTICK_RATE_MS);
+    }
+}
+
+static void receive_task(void *pvParameters)
+{
+    char buf[64];
+    softuart_stats_t stats;
+
+    while (1) {
+        size_t n = softuart_read(PORT, buf, sizeof(buf) - 1, 2000 / portTICK_RATE_MS);
+        buf[n] = 0;
+        softuart_get_stats(PORT, &stats);
+        printf("got %u: %s (framing errors %u, overflows %u)\n", n, buf,
+               stats.framing_errors, stats.rx_overflows);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    if (!softuart_open(PORT, BAUD, RX_GPIO, TX_GPIO)) {
+        printf("softuart_open failed\n");
+        return;
+    }
+    xTaskCreate(send_task, (signed char *)"send", 256, NULL, 2, NULL);
+    xTaskCreate(receive_task, (signed char *)"receive", 256, NULL, 3, NULL);
+}
@@ -0,0 +1,110 @@
+/* spi_coprocessor - a UDP socket for a host MCU over HSPI
+ *
+ * The host is SPI master and talks to extras/spi_slave (see
+ * spi_slave.h for the wire format). Datagrams arriving on UDP port 7000
+ * are passed up to the host as CMD_UDP_RECV frames straight from lwIP's
+ * pbufs, and CMD_UDP_SEND frames from the host are sent from their own
+ * pbuf to whoever sent the last datagram, neither copied on the way.
+ * CMD_PING is answered with the same payload and CMD_STATS with the
+ * link counters. Wire MISO/MOSI/SCLK/CS to GPIO12-15 and the host's
+ * interrupt input to GPIO5; mode 0.
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "lwip/api.h"
+#include "spi_slave/spi_slave.h"
+
+#include "ssid_config.h"
+
+#define UDP_PORT 7000
+#define READY_GPIO 5
+
+#define CMD_PING     0x01
+#define CMD_STATS    0x02
+#define CMD_UDP_SEND 0x10
+#define CMD_UDP_RECV 0x11
+
+static struct netconn *conn;
+static ip_addr_t peer_addr;
+static u16_t peer_port;
+static bool have_peer;
+
+/* In spi_slave's task */
+static void handle(uint8_t cmd, uint8_t seq, struct pbuf *p)
+{
+    switch (cmd) {
+    case CMD_PING:
+        spi_slave_send(cmd, seq, p);
+        break;
+    case CMD_STATS: {
+        spi_slave_stats_t stats;
+        spi_slave_stats(&stats);
+        spi_slave_send_data(cmd, seq, &stats, sizeof(stats));
+        break;
+    }
+    case CMD_UDP_SEND:
+        if (conn && have_peer) {
+            struct netbuf *nb = netbuf_new();
+            if (nb) {
+                /* The netbuf takes our pbuf, netbuf_delete() frees it */
+                nb->p = nb->ptr = p;
+                netconn_sendto(conn, nb, &peer_addr, peer_port);
+                netbuf_delete(nb);
+                return;
+            }
+        }
+        break;
+    }
+    pbuf_free(p);
+}
+
+static void udp_task(void *pvParameters)
+{
+    conn = netconn_new(NETCONN_UDP);
+    if (!conn || netconn_bind(conn, IP_ADDR_ANY, UDP_PORT) != ERR_OK) {
+        printf("Can't bind port %d\r\n", UDP_PORT);
+        vTaskDelete(NULL);
+        return;
+    }
+
+    while (1) {
+        struct netbuf *nb;
+        if (netconn_recv(conn, &nb) != ERR_OK)
+            continue;
+        ip_addr_copy(peer_addr, *netbuf_fromaddr(nb));
+        peer_port = netbuf_fromport(nb);
+        have_peer = true;
+        /* spi_slave keeps its own reference until it's been read */
+        if (!spi_slave_send(CMD_UDP_RECV, 0, nb->p))
+            printf("Host isn't keeping up, dropped a datagram\r\n");
+        netbuf_delete(nb);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    struct sdk_station_config config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+    };
+
+    /* required to call wifi_set_opmode before station_set_config */
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_station_set_config(&config);
+
+    if (!spi_slave_init(SPI_MODE0, handle, 4, READY_GPIO))
+        printf("Couldn't start the SPI slave\r\n");
+    xTaskCreate(udp_task, (signed char *)"udp", 384, NULL, 3, NULL);
+}
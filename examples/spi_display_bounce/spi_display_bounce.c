@@ -0,0 +1,83 @@
+/* spi_display_bounce - partial refresh with extras/spi_display
+ *
+ * A square bounces over a gradient on a 320x240 ILI9341. Each frame
+ * only the square's old and new positions are invalidated, and every
+ * couple of seconds it prints how many pixels a frame took against the
+ * 76800 of a full refresh. Wire SDI/MOSI to GPIO13, SCK to GPIO14, CS
+ * to GPIO15, D/C to GPIO5 and RESET to GPIO4.
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "esp/spi.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include <stdio.h>
+
+#include "spi_display/spi_display.h"
+
+#define WIDTH 320
+#define HEIGHT 240
+#define SIZE 24
+
+#define RGB565(r, g, b) ((((r) & 0xf8) << 8) | (((g) & 0xfc) << 3) | ((b) >> 3))
+
+static int box_x, box_y;
+
+static void render(const display_rect_t *r, uint16_t *px, void *arg)
+{
+    for (int y = r->y; y < r->y + r->h; y++) {
+        for (int x = r->x; x < r->x + r->w; x++) {
+            bool in_box = x >= box_x && x < box_x + SIZE && y >= box_y && y < box_y + SIZE;
+            *px++ = in_box ? RGB565(255, 255, 255) : RGB565(x * 255 / WIDTH, 0, y * 255 / HEIGHT);
+        }
+    }
+}
+
+static void display_task(void *pvParameters)
+{
+    const display_config_t config = {
+        .width = WIDTH,
+        .height = HEIGHT,
+        .madctl = 0x28,         /* landscape, BGR */
+        .dc_gpio = 5,
+        .reset_gpio = 4,
+        .freq_divider = SPI_FREQ_DIV_20M,
+        .render = render,
+    };
+    if (!display_init(&config)) {
+        printf("Couldn't start the display\n");
+        vTaskDelete(NULL);
+    }
+    printf("Full screen: %u pixels\n", display_flush());
+
+    int dx = 3, dy = 2, frames = 0;
+    size_t pixels = 0;
+    while (1) {
+        display_invalidate(box_x, box_y, SIZE, SIZE);
+        box_x += dx;
+        box_y += dy;
+        if (box_x <= 0 || box_x >= WIDTH - SIZE)
+            dx = -dx;
+        if (box_y <= 0 || box_y >= HEIGHT - SIZE)
+            dy = -dy;
+        display_invalidate(box_x, box_y, SIZE, SIZE);
+        pixels += display_flush();
+
+        if (++frames == 100) {
+            printf("%u pixels a frame\n", pixels / frames);
+            frames = 0;
+            pixels = 0;
+        }
+        vTaskDelay(20 / portTICK_RATE_MS);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    xTaskCreate(display_task, (signed char *)"display", 384, NULL, 2, NULL);
+}
@@ -0,0 +1,63 @@
+/* Stack usage of every task, with esp/stackmon.h
+ *
+ * Two tasks with generous stacks use little of them, and a third
+ * recurses a little deeper every second, until the monitor warns that
+ * it's within 20% of overflowing and it stops 64 words short. Every 10 seconds the
+ * table of all tasks (the SDK's and lwIP's too) is printed, with the
+ * stack size each could get by with.
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "esp/stackmon.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include <stdio.h>
+
+#define DEEP_STACK 512
+
+static void light_task(void *pvParameters)
+{
+    while (1) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%u", xTaskGetTickCount());
+        vTaskDelay(500 / portTICK_RATE_MS);
+    }
+}
+
+/* Uses some 32 words of stack per level */
+static uint32_t recurse(int depth)
+{
+    volatile uint32_t frame[24];
+
+    frame[0] = depth;
+    if (depth > 0)
+        frame[1] = recurse(depth - 1);
+    return frame[0] + frame[1];
+}
+
+static void deep_task(void *pvParameters)
+{
+    int depth = 1;
+
+    while (1) {
+        recurse(depth);
+        /* Deeper each time, stopping well short of overflowing */
+        if (uxTaskGetStackHighWaterMark(NULL) > 64)
+            depth++;
+        vTaskDelay(1000 / portTICK_RATE_MS);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    xTaskCreate(light_task, (signed char *)"light1", 512, NULL, 2, NULL);
+    xTaskCreate(light_task, (signed char *)"light2", 1024, NULL, 2, NULL);
+    xTaskCreate(deep_task, (signed char *)"deep", DEEP_STACK, NULL, 2, NULL);
+
+    stackmon_start(tskIDLE_PRIORITY + 1, 1000, 10000, 20);
+}
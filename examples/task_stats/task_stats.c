@@ -0,0 +1,76 @@
+/* Example of per-task CPU usage statistics.
+ *
+ * Every few seconds the stats task prints how much of the CPU each task
+ * (including the SDK's and lwIP's) used during the last interval. The
+ * run time counter is the CPU cycle counter, see FreeRTOSConfig.h.
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include <stdio.h>
+#include <string.h>
+
+#define STATS_INTERVAL_MS 5000
+#define MAX_TASKS 16
+
+/* Burns some CPU, then sleeps */
+void busy_task(void *pvParameters)
+{
+    uint32_t busy_ms = (uint32_t)pvParameters;
+    while(1) {
+        portTickType start = xTaskGetTickCount();
+        while((xTaskGetTickCount() - start) * portTICK_RATE_MS < busy_ms) {
+            __asm__ volatile ("nop");
+        }
+        vTaskDelay(100 / portTICK_RATE_MS);
+    }
+}
+
+static xTaskStatusType prev[MAX_TASKS];
+static unsigned portBASE_TYPE prev_count;
+static unsigned long prev_total;
+
+static unsigned long prev_runtime(xTaskHandle handle)
+{
+    for(int i = 0; i < prev_count; i++) {
+        if(prev[i].xHandle == handle)
+            return prev[i].ulRunTimeCounter;
+    }
+    return 0;
+}
+
+void stats_task(void *pvParameters)
+{
+    static xTaskStatusType now[MAX_TASKS];
+    while(1) {
+        vTaskDelay(STATS_INTERVAL_MS / portTICK_RATE_MS);
+
+        unsigned long total;
+        unsigned portBASE_TYPE count = uxTaskGetSystemState(now, MAX_TASKS, &total);
+        unsigned long elapsed = total - prev_total;
+
+        printf("\n%-16s %10s %6s %6s\n", "task", "cycles/64", "cpu%", "stack");
+        for(int i = 0; i < count; i++) {
+            unsigned long used = now[i].ulRunTimeCounter - prev_runtime(now[i].xHandle);
+            unsigned pct10 = elapsed ? (uint64_t)used * 1000 / elapsed : 0;
+            printf("%-16s %10lu %4u.%u %6u\n", (char *)now[i].pcTaskName, used,
+                   pct10 / 10, pct10 % 10, now[i].usStackHighWaterMark);
+        }
+
+        memcpy(prev, now, sizeof(xTaskStatusType) * count);
+        prev_count = count;
+        prev_total = total;
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+    xTaskCreate(busy_task, (signed char *)"busy10", 256, (void *)10, 2, NULL);
+    xTaskCreate(busy_task, (signed char *)"busy50", 256, (void *)50, 2, NULL);
+    xTaskCreate(stats_task, (signed char *)"stats", 512, NULL, 3, NULL);
+}
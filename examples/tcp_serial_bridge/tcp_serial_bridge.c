@@ -0,0 +1,105 @@
+/* tcp_serial_bridge - Bridge UART0 to a TCP connection on port 23.
+ *
+ * Bytes from the UART arrive in small reads, often one at a time. They
+ * go to the connection through a netcork, which sends them in full
+ * segments, or after 20ms at most, rather than a segment per read.
+ * Data from the connection is written to the UART. Connect with e.g.
+ * "nc <address> 23"; the cork statistics are printed on disconnect.
+ *
+ * This sample code is in the public domain.
+ */
+#include <stdio.h>
+
+#include <espressif/esp_common.h>
+#include <esp/uart.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+
+#include <lwip/api.h>
+
+#include "ssid_config.h"
+#include "netcork/netcork.h"
+
+#define BRIDGE_PORT 23
+#define FLUSH_MS 20
+
+/* held while using the cork, so it isn't freed under the UART task */
+static xSemaphoreHandle cork_lock;
+static bool corked;
+static netcork_t cork;
+
+/* UART to TCP */
+static void uart_task(void *pvParameters)
+{
+    uint8_t buf[64];
+
+    while (1) {
+        size_t len = uart_read(0, buf, sizeof(buf), portMAX_DELAY);
+        xSemaphoreTake(cork_lock, portMAX_DELAY);
+        if (corked)
+            netcork_write(&cork, buf, len);
+        xSemaphoreGive(cork_lock);
+    }
+}
+
+/* TCP to UART */
+static void tcp_task(void *pvParameters)
+{
+    while (sdk_wifi_station_get_connect_status() != STATION_GOT_IP)
+        vTaskDelay(100 / portTICK_RATE_MS);
+
+    struct netconn *listener = netconn_new(NETCONN_TCP);
+    netconn_bind(listener, IP_ADDR_ANY, BRIDGE_PORT);
+    netconn_listen(listener);
+
+    while (1) {
+        struct netconn *conn;
+        if (netconn_accept(listener, &conn) != ERR_OK)
+            continue;
+        if (netcork_init(&cork, conn, FLUSH_MS) != ERR_OK) {
+            netconn_delete(conn);
+            continue;
+        }
+        corked = true;
+
+        struct netbuf *nb;
+        while (netconn_recv(conn, &nb) == ERR_OK) {
+            void *data;
+            u16_t len;
+            do {
+                netbuf_data(nb, &data, &len);
+                uart_write(0, data, len);
+            } while (netbuf_next(nb) >= 0);
+            netbuf_delete(nb);
+        }
+
+        xSemaphoreTake(cork_lock, portMAX_DELAY);
+        corked = false;
+        printf("\n%u writes went out in %u netconn writes\n", cork.writes, cork.flushes);
+        netcork_free(&cork);
+        xSemaphoreGive(cork_lock);
+        netconn_close(conn);
+        netconn_delete(conn);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    uart_rx_buffer_enable(0, 256);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    struct sdk_station_config config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+    };
+
+    /* required to call wifi_set_opmode before station_set_config */
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_station_set_config(&config);
+
+    cork_lock = xSemaphoreCreateMutex();
+    xTaskCreate(tcp_task, (signed char *)"tcp", 512, NULL, 2, NULL);
+    xTaskCreate(uart_task, (signed char *)"uart", 256, NULL, 3, NULL);
+}
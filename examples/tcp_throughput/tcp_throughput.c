@@ -0,0 +1,117 @@
+/* tcp_throughput - TCP receive throughput test.
+ *
+ * Listens on port 5001 and discards everything it receives, printing
+ * the receive rate once a second and a summary when the sender
+ * disconnects. Compatible with an iperf (version 2) client:
+ *
+ *     iperf -c <esp8266 address> -t 30
+ *
+ * To compare the default lwIP configuration with the throughput profile
+ * (out-of-order queueing, IP reassembly, larger window), build and run
+ * the test both ways, ideally a few metres from the access point and
+ * with some other Wi-Fi traffic around so that segments do get lost:
+ *
+ *     make flash
+ *     make clean && make flash EXTRA_CFLAGS=-DLWIP_THROUGHPUT_PROFILE=1
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "lwip/err.h"
+#include "lwip/sockets.h"
+#include "lwip/sys.h"
+
+#include "ssid_config.h"
+
+#define LISTEN_PORT 5001
+#define RECV_BUF_SIZE 1460
+
+static void report(const char *what, uint32_t bytes, uint32_t us)
+{
+    if (us == 0)
+        us = 1;
+    uint32_t kbps = (uint64_t)bytes * 8000 / us;
+    printf("%s: %u bytes in %u ms, %u kbit/s\r\n", what, bytes, us / 1000, kbps);
+}
+
+static void receive(int s)
+{
+    static char buf[RECV_BUF_SIZE];
+    uint32_t total = 0, interval = 0;
+    uint32_t start = sys_now_us(), last = start;
+
+    while (1) {
+        int r = lwip_recv(s, buf, sizeof(buf), 0);
+        if (r <= 0)
+            break;
+        total += r;
+        interval += r;
+
+        uint32_t now = sys_now_us();
+        if (now - last >= 1000000) {
+            report("interval", interval, now - last);
+            interval = 0;
+            last = now;
+        }
+    }
+    report("total", total, sys_now_us() - start);
+    printf("free heap %u\r\n", xPortGetFreeHeapSize());
+}
+
+void throughput_task(void *pvParameters)
+{
+    printf("TCP throughput test, throughput profile %s\r\n",
+           LWIP_THROUGHPUT_PROFILE ? "enabled" : "disabled");
+
+    int ls = lwip_socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(LISTEN_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if (ls < 0 || lwip_bind(ls, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        lwip_listen(ls, 1) < 0) {
+        printf("Failed to set up listening socket\r\n");
+        vTaskDelete(NULL);
+        return;
+    }
+    printf("Listening on port %d\r\n", LISTEN_PORT);
+
+    while (1) {
+        struct sockaddr_in peer;
+        socklen_t len = sizeof(peer);
+        int s = lwip_accept(ls, (struct sockaddr *)&peer, &len);
+        if (s < 0) {
+            vTaskDelay(100 / portTICK_RATE_MS);
+            continue;
+        }
+        printf("Connection from %s\r\n", inet_ntoa(peer.sin_addr));
+        receive(s);
+        lwip_close(s);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    struct sdk_station_config config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+    };
+
+    /* required to call wifi_set_opmode before station_set_config */
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_station_set_config(&config);
+
+    xTaskCreate(&throughput_task, (signed char *)"throughput", 512, NULL, 2, NULL);
+}
@@ -0,0 +1,144 @@
+/*
+ * Internet checksum speed, in CPU cycles, for lwIP's generic C routine
+ * against esp_chksum.h's, and for copying then checksumming a buffer
+ * against esp_chksum_copy().
+ *
+ * Results are printed as CSV lines for scripts to collect, everything
+ * else is prefixed with '#':
+ *
+ *   BENCH,<impl>,<bytes>,<offset>,<cycles>
+ *
+ * <impl> is "generic" (lwIP's LWIP_CHKSUM_ALGORITHM 2, copied here),
+ * "esp" (esp_chksum), "memcpy+esp" (MEMCPY, then esp_chksum of the
+ * copy) or "copy" (esp_chksum_copy). <offset> is the buffers' offset
+ * from word alignment; lwIP checksums headers and payloads at any of
+ * them.
+ *
+ * Each result is checked against the generic routine. The lowest of
+ * RUNS runs is reported, which discards runs that were interrupted.
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "esp/hwrand.h"
+#include "esp/perf.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "lwip/opt.h"
+#include "esp_chksum.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define RUNS 4
+#define MAX_LEN 1460
+
+static uint8_t src[MAX_LEN + 4] __attribute__((aligned(4)));
+static uint8_t dst[MAX_LEN + 4] __attribute__((aligned(4)));
+
+static const uint16_t sizes[] = { 20, 64, 536, 1460 };
+
+/* lwip_standard_chksum() as LWIP_CHKSUM_ALGORITHM 2 builds it */
+static uint16_t generic_chksum(const void *dataptr, int len)
+{
+    const uint8_t *pb = dataptr;
+    const uint16_t *ps;
+    uint16_t t = 0;
+    uint32_t sum = 0;
+    int odd = ((uintptr_t)pb & 1);
+
+    if (odd && len > 0) {
+        ((uint8_t *)&t)[1] = *pb++;
+        len--;
+    }
+    ps = (const uint16_t *)pb;
+    while (len > 1) {
+        sum += *ps++;
+        len -= 2;
+    }
+    if (len > 0) {
+        ((uint8_t *)&t)[0] = *(const uint8_t *)ps;
+    }
+    sum += t;
+    sum = (sum >> 16) + (sum & 0xffff);
+    sum = (sum >> 16) + (sum & 0xffff);
+    if (odd) {
+        sum = ((sum & 0xff) << 8) | ((sum >> 8) & 0xff);
+    }
+    return sum;
+}
+
+static uint16_t run_generic(int offset, uint16_t len)
+{
+    return generic_chksum(src + offset, len);
+}
+
+static uint16_t run_esp(int offset, uint16_t len)
+{
+    return esp_chksum(src + offset, len);
+}
+
+static uint16_t run_memcpy(int offset, uint16_t len)
+{
+    MEMCPY(dst + offset, src + offset, len);
+    return esp_chksum(dst + offset, len);
+}
+
+static uint16_t run_copy(int offset, uint16_t len)
+{
+    return esp_chksum_copy(dst + offset, src + offset, len);
+}
+
+static const struct {
+    const char *name;
+    uint16_t (*run)(int offset, uint16_t len);
+} impls[] = {
+    { "generic", run_generic },
+    { "esp", run_esp },
+    { "memcpy+esp", run_memcpy },
+    { "copy", run_copy },
+};
+
+static void bench_task(void *pvParameters)
+{
+    hwrand_fill(src, sizeof(src));
+
+    printf("# chksum_bench, lowest of %d runs\n", RUNS);
+    printf("# BENCH,impl,bytes,offset,cycles\n");
+    for (int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        for (int offset = 0; offset < 4; offset++) {
+            uint16_t expected = run_generic(offset, sizes[s]);
+            for (int i = 0; i < sizeof(impls) / sizeof(impls[0]); i++) {
+                uint32_t best = UINT32_MAX;
+                uint16_t sum = 0;
+                for (int r = 0; r < RUNS; r++) {
+                    uint32_t start = perf_ccount();
+                    sum = impls[i].run(offset, sizes[s]);
+                    uint32_t cycles = perf_ccount() - start;
+                    if (cycles < best) {
+                        best = cycles;
+                    }
+                }
+                printf("BENCH,%s,%u,%d,%u\n", impls[i].name, sizes[s], offset, best);
+                if (sum != expected) {
+                    printf("# %s: 0x%04x, expected 0x%04x\n", impls[i].name, sum, expected);
+                }
+                if (i >= 2 && memcmp(dst + offset, src + offset, sizes[s])) {
+                    printf("# %s: copy differs\n", impls[i].name);
+                }
+            }
+        }
+    }
+    printf("# done\n");
+
+    while (1) {
+        vTaskDelay(10000 / portTICK_RATE_MS);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    xTaskCreate(bench_task, (signed char *)"bench", 512, NULL, 2, NULL);
+}
@@ -0,0 +1,125 @@
+/*
+ * CRC speed, in CPU cycles per byte, for the crc.h kernel this was
+ * built with against a plain bit loop (the kind of CRC function the
+ * drivers each used to have).
+ *
+ * Results are printed as CSV lines for scripts to collect, everything
+ * else is prefixed with '#':
+ *
+ *   BENCH,<name>,<kernel>,<bytes>,<cycles>,<cycles per byte x100>
+ *
+ * <kernel> is "bits" for the reference loop here, or the CRC_KERNEL
+ * value crc.h was built with. To compare the kernels, build and run it
+ * each way:
+ *
+ *     make flash
+ *     make clean && make flash EXTRA_CFLAGS=-DCRC_KERNEL=4
+ *     make clean && make flash EXTRA_CFLAGS=-DCRC_KERNEL=0
+ *
+ * Each result is checked against the reference, and the standard check
+ * values (CRC of "123456789") are verified first. The lowest of RUNS
+ * runs is reported, which discards runs that were interrupted.
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "esp/hwrand.h"
+#include "esp/perf.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "crc.h"
+
+#include <stdio.h>
+
+#define RUNS 4
+#define BULK_LEN 1024
+
+static uint8_t data[BULK_LEN];
+
+static uint32_t crc_bits(uint32_t crc, const uint8_t *p, size_t len, uint32_t poly)
+{
+    while (len--) {
+        crc ^= *p++;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc >> 1) ^ (poly & -(crc & 1));
+        }
+    }
+    return crc;
+}
+
+static uint32_t ref_crc8(const uint8_t *p, size_t len) { return crc_bits(0, p, len, 0x8c); }
+static uint32_t ref_crc16(const uint8_t *p, size_t len) { return crc_bits(0, p, len, 0xa001); }
+static uint32_t ref_crc32(const uint8_t *p, size_t len) { return ~crc_bits(~0, p, len, 0xedb88320); }
+static uint32_t lib_crc8(const uint8_t *p, size_t len) { return crc8_maxim(0, p, len); }
+static uint32_t lib_crc16(const uint8_t *p, size_t len) { return crc16_ibm(0, p, len); }
+static uint32_t lib_crc32(const uint8_t *p, size_t len) { return crc32_ieee(0, p, len); }
+
+typedef uint32_t (*crc_fn_t)(const uint8_t *p, size_t len);
+
+static const struct {
+    const char *name;
+    crc_fn_t ref;
+    crc_fn_t lib;
+    uint32_t check;
+} crcs[] = {
+    { "crc8-maxim", ref_crc8, lib_crc8, 0xa1 },
+    { "crc16-ibm", ref_crc16, lib_crc16, 0xbb3d },
+    { "crc32-ieee", ref_crc32, lib_crc32, 0xcbf43926 },
+};
+
+static uint32_t bench(crc_fn_t fn, uint32_t *result)
+{
+    uint32_t best = UINT32_MAX;
+
+    for (int i = 0; i < RUNS; i++) {
+        uint32_t start = perf_ccount();
+        *result = fn(data, BULK_LEN);
+        uint32_t cycles = perf_ccount() - start;
+        if (cycles < best) {
+            best = cycles;
+        }
+    }
+    return best;
+}
+
+static void report(const char *name, const char *kernel, uint32_t cycles)
+{
+    printf("BENCH,%s,%s,%u,%u,%u\n", name, kernel, BULK_LEN, cycles,
+           (uint32_t)((uint64_t)cycles * 100 / BULK_LEN));
+}
+
+static void bench_task(void *pvParameters)
+{
+    static const uint8_t check_input[] = "123456789";
+    char kernel[8];
+
+    hwrand_fill(data, sizeof(data));
+    snprintf(kernel, sizeof(kernel), "%d", CRC_KERNEL);
+
+    printf("# crc_bench, CRC_KERNEL=%d, lowest of %d runs\n", CRC_KERNEL, RUNS);
+    printf("# BENCH,name,kernel,bytes,cycles,cycles_per_byte_x100\n");
+    for (int i = 0; i < sizeof(crcs) / sizeof(crcs[0]); i++) {
+        uint32_t ref, lib;
+
+        if (crcs[i].lib(check_input, 9) != crcs[i].check) {
+            printf("# %s: wrong check value 0x%x\n", crcs[i].name, crcs[i].lib(check_input, 9));
+        }
+        report(crcs[i].name, "bits", bench(crcs[i].ref, &ref));
+        report(crcs[i].name, kernel, bench(crcs[i].lib, &lib));
+        if (ref != lib) {
+            printf("# %s: 0x%x, expected 0x%x\n", crcs[i].name, lib, ref);
+        }
+    }
+    printf("# done\n");
+
+    while (1) {
+        vTaskDelay(10000 / portTICK_RATE_MS);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    xTaskCreate(bench_task, (signed char *)"bench", 512, NULL, 2, NULL);
+}
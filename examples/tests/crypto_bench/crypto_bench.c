@@ -0,0 +1,258 @@
+/*
+ * Crypto micro-benchmarks for the mbedTLS build, in CPU cycles.
+ *
+ * Times the bulk primitives of a TLS connection (SHA-1, SHA-256,
+ * HMAC-SHA256, AES-128-CBC, AES-128-GCM) in cycles per byte, and the
+ * public key operations of a handshake (ECDH P-256 key generation and
+ * exchange, ECDSA P-256 sign, RSA-2048 verify) in cycles per operation,
+ * once at 80MHz and once at 160MHz.
+ * (hmac_test_vectors checks correctness, this only measures speed.)
+ *
+ * Results are printed as CSV lines for scripts to collect, everything
+ * else is prefixed with '#':
+ *
+ *   BENCH,<name>,<MHz>,<placement>,<bytes>,<cycles>,<cycles per byte x100>
+ *
+ * <placement> is where the algorithm's inner loop was linked, "iram"
+ * or "irom" ("-" for the bignum operations, whose inner loops are
+ * always in IRAM.) To compare the two placements of the symmetric
+ * algorithms, build and run it both ways:
+ *
+ *     make flash
+ *     make clean && make flash MBEDTLS_FAST_CRYPTO=1
+ *
+ * and the P-256 base point operations with and without the precomputed
+ * table (ecdh-p256-keygen and ecdsa-p256-sign):
+ *
+ *     make clean && make flash MBEDTLS_P256_COMB=1
+ *
+ * The lowest of RUNS runs is reported, which discards runs that were
+ * interrupted. Cycle counts are at the CPU clock, so the same code
+ * costs more cycles at 160MHz whenever it waits on the flash cache.
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "esp/hwrand.h"
+#include "esp/perf.h"
+#include "esp/clocks.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "mbedtls/config.h"
+#include "mbedtls/sha1.h"
+#include "mbedtls/sha256.h"
+#include "mbedtls/md.h"
+#include "mbedtls/aes.h"
+#include "mbedtls/gcm.h"
+#include "mbedtls/ecdh.h"
+#include "mbedtls/ecdsa.h"
+#include "mbedtls/rsa.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#define RUNS 4
+#define BULK_LEN 1024
+
+static uint8_t data_in[BULK_LEN];
+static uint8_t data_out[BULK_LEN];
+static uint32_t cpu_mhz;
+
+static int hw_rng(void *ctx, unsigned char *buf, size_t len)
+{
+    hwrand_fill(buf, len);
+    return 0;
+}
+
+static const char *placement(const void *fn)
+{
+    uint32_t addr = (uint32_t)fn;
+    if (addr >= 0x40100000 && addr < 0x40108000) {
+        return "iram";
+    }
+    return addr >= 0x40200000 ? "irom" : "?";
+}
+
+static void report(const char *name, const char *where, uint32_t bytes, uint32_t cycles)
+{
+    uint32_t cpb = bytes ? (uint32_t)((uint64_t)cycles * 100 / bytes) : 0;
+    printf("BENCH,%s,%u,%s,%u,%u,%u\n", name, cpu_mhz, where, bytes, cycles, cpb);
+}
+
+/* Run 'op' RUNS times, return the lowest cycle count */
+#define BENCH_MIN(result, op) do {                  \
+        result = UINT32_MAX;                        \
+        for (int _i = 0; _i < RUNS; _i++) {         \
+            uint32_t _start = perf_ccount();        \
+            op;                                     \
+            uint32_t _cycles = perf_ccount() - _start; \
+            if (_cycles < result) {                 \
+                result = _cycles;                   \
+            }                                       \
+        }                                           \
+    } while (0)
+
+static void bench_sha(void)
+{
+    uint8_t digest[32];
+    uint32_t cycles;
+
+    BENCH_MIN(cycles, mbedtls_sha1(data_in, BULK_LEN, digest));
+    report("sha1", placement(mbedtls_sha1_process), BULK_LEN, cycles);
+
+    BENCH_MIN(cycles, mbedtls_sha256(data_in, BULK_LEN, digest, 0));
+    report("sha256", placement(mbedtls_sha256_process), BULK_LEN, cycles);
+
+    const mbedtls_md_info_t *md = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+    static const uint8_t key[32] = { 0x0b };
+    BENCH_MIN(cycles, mbedtls_md_hmac(md, key, sizeof(key), data_in, BULK_LEN, digest));
+    report("hmac-sha256", placement(mbedtls_sha256_process), BULK_LEN, cycles);
+}
+
+static void bench_aes(void)
+{
+    static const uint8_t key[16] = { 0x2b, 0x7e, 0x15, 0x16 };
+    uint8_t iv[16];
+    uint8_t tag[16];
+    uint32_t cycles;
+
+    mbedtls_aes_context aes;
+    mbedtls_aes_init(&aes);
+    mbedtls_aes_setkey_enc(&aes, key, 128);
+    memset(iv, 0, sizeof(iv));
+    BENCH_MIN(cycles, mbedtls_aes_crypt_cbc(&aes, MBEDTLS_AES_ENCRYPT, BULK_LEN, iv, data_in, data_out));
+    report("aes128-cbc", placement(mbedtls_aes_encrypt), BULK_LEN, cycles);
+    mbedtls_aes_free(&aes);
+
+    mbedtls_gcm_context gcm;
+    mbedtls_gcm_init(&gcm);
+    mbedtls_gcm_setkey(&gcm, MBEDTLS_CIPHER_ID_AES, key, 128);
+    memset(iv, 0, sizeof(iv));
+    BENCH_MIN(cycles, mbedtls_gcm_crypt_and_tag(&gcm, MBEDTLS_GCM_ENCRYPT, BULK_LEN, iv, 12,
+                                                NULL, 0, data_in, data_out, sizeof(tag), tag));
+    report("aes128-gcm", placement(mbedtls_gcm_update), BULK_LEN, cycles);
+    mbedtls_gcm_free(&gcm);
+}
+
+/* One side of an ECDHE exchange: generate our key pair, then compute
+   the shared secret from the peer's public key (our own, here) */
+static int ecdh_exchange(mbedtls_ecdh_context *ecdh)
+{
+    int ret = mbedtls_ecdh_gen_public(&ecdh->grp, &ecdh->d, &ecdh->Q, hw_rng, NULL);
+    if (ret) {
+        return ret;
+    }
+    return mbedtls_ecdh_compute_shared(&ecdh->grp, &ecdh->z, &ecdh->Q, &ecdh->d, hw_rng, NULL);
+}
+
+static void bench_ecdh(void)
+{
+    mbedtls_ecdh_context ecdh;
+    uint32_t cycles;
+    int ret = 0;
+
+    mbedtls_ecdh_init(&ecdh);
+    mbedtls_ecp_group_load(&ecdh.grp, MBEDTLS_ECP_DP_SECP256R1);
+    BENCH_MIN(cycles, ret = ret ? ret : mbedtls_ecdh_gen_public(&ecdh.grp, &ecdh.d, &ecdh.Q, hw_rng, NULL));
+    if (ret) {
+        printf("# ecdh-p256-keygen failed -0x%x\n", -ret);
+    } else {
+        report("ecdh-p256-keygen", "-", 0, cycles);
+    }
+    BENCH_MIN(cycles, ret = ret ? ret : ecdh_exchange(&ecdh));
+    if (ret) {
+        printf("# ecdh-p256 failed -0x%x\n", -ret);
+    } else {
+        report("ecdh-p256", "-", 0, cycles);
+    }
+    mbedtls_ecdh_free(&ecdh);
+}
+
+static void bench_ecdsa_sign(void)
+{
+    mbedtls_ecdsa_context ecdsa;
+    mbedtls_mpi r, s;
+    uint8_t hash[32];
+    uint32_t cycles;
+    int ret;
+
+    mbedtls_ecdsa_init(&ecdsa);
+    mbedtls_mpi_init(&r);
+    mbedtls_mpi_init(&s);
+    hw_rng(NULL, hash, sizeof(hash));
+    ret = mbedtls_ecdsa_genkey(&ecdsa, MBEDTLS_ECP_DP_SECP256R1, hw_rng, NULL);
+    BENCH_MIN(cycles, ret = ret ? ret : mbedtls_ecdsa_sign(&ecdsa.grp, &r, &s, &ecdsa.d,
+                                                           hash, sizeof(hash), hw_rng, NULL));
+    if (ret) {
+        printf("# ecdsa-p256-sign failed -0x%x\n", -ret);
+    } else {
+        report("ecdsa-p256-sign", "-", 0, cycles);
+    }
+    mbedtls_mpi_free(&r);
+    mbedtls_mpi_free(&s);
+    mbedtls_ecdsa_free(&ecdsa);
+}
+
+/* Signature verification is a public key operation (e = 65537) plus a
+   comparison, so time mbedtls_rsa_public on a random 2048 bit modulus */
+static void bench_rsa_verify(void)
+{
+    mbedtls_rsa_context rsa;
+    uint32_t cycles;
+    int ret = 0;
+
+    mbedtls_rsa_init(&rsa, MBEDTLS_RSA_PKCS_V15, 0);
+    mbedtls_mpi_fill_random(&rsa.N, 256, hw_rng, NULL);
+    mbedtls_mpi_set_bit(&rsa.N, 2047, 1);
+    mbedtls_mpi_set_bit(&rsa.N, 0, 1);
+    mbedtls_mpi_lset(&rsa.E, 65537);
+    rsa.len = 256;
+
+    /* input must be below N */
+    data_in[0] = 0;
+    BENCH_MIN(cycles, ret = ret ? ret : mbedtls_rsa_public(&rsa, data_in, data_out));
+    if (ret) {
+        printf("# rsa2048-verify failed -0x%x\n", -ret);
+    } else {
+        report("rsa2048-verify", "-", 0, cycles);
+    }
+    mbedtls_rsa_free(&rsa);
+}
+
+static void run_suite(uint8_t mhz)
+{
+    cpu_set_freq(mhz);
+    cpu_mhz = sdk_system_get_cpu_freq();
+    printf("# %u MHz\n", cpu_mhz);
+
+    bench_sha();
+    bench_aes();
+    bench_ecdh();
+    bench_ecdsa_sign();
+    bench_rsa_verify();
+}
+
+static void bench_task(void *pvParameters)
+{
+    hw_rng(NULL, data_in, sizeof(data_in));
+
+    printf("# crypto_bench, lowest of %d runs\n", RUNS);
+    printf("# BENCH,name,mhz,placement,bytes,cycles,cycles_per_byte_x100\n");
+    run_suite(80);
+    run_suite(160);
+    cpu_set_freq(80);
+    printf("# done\n");
+
+    while (1) {
+        vTaskDelay(10000 / portTICK_RATE_MS);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    /* bignum operations need a deep stack */
+    xTaskCreate(bench_task, (signed char *)"bench", 2048, NULL, 2, NULL);
+}
@@ -0,0 +1,113 @@
+/*
+ * Flash read throughput for each SPI flash mode and clock.
+ *
+ * Code and IROM constants are fetched from flash through the cache,
+ * and on a cache miss the fetch waits for the SPI0 controller to read
+ * the missing line in whatever mode and at whatever clock it is set
+ * to. This switches through every mode (QIO, QOUT, DIO, DOUT) at 80,
+ * 40 and 20MHz with flashmode_set(), and times reads through the cache
+ * window that always miss (a span much larger than the cache) and
+ * reads that always hit, for comparison.
+ *
+ * Data loads use the same cache and the same flash reads as
+ * instruction fetches, so the miss throughput is also the throughput
+ * of code running out of cache.
+ *
+ * Results are printed as CSV lines for scripts to collect, everything
+ * else is prefixed with '#':
+ *
+ *   BENCH,flash,<mode>,<flash MHz>,<miss|hit>,<bytes>,<cycles>,<KB/s>
+ *
+ * Modes the board's flash can't be read with (commonly QIO/QOUT when
+ * the chip's quad enable bit isn't set, or 80MHz) are reported as
+ * unsupported and skipped. The boot setting is restored at the end.
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "esp/flashmap.h"
+#include "esp/flashmode.h"
+#include "esp/perf.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdio.h>
+
+#define RUNS 4
+
+/* Reads over this span of the window always miss the 32KB cache */
+#define MISS_SPAN (128 * 1024)
+/* And reads over this much always hit, once loaded */
+#define HIT_SPAN (4 * 1024)
+
+static const uint32_t speeds[] = { 80, 40, 20 };
+
+static uint32_t read_span(uint32_t span)
+{
+    const volatile uint32_t *p = (const volatile uint32_t *)FLASHMAP_BASE;
+    uint32_t sum = 0;
+
+    for (uint32_t i = 0; i < span / 4; i++) {
+        sum += p[i];
+    }
+    return sum;
+}
+
+static uint32_t time_span(uint32_t span)
+{
+    uint32_t best = UINT32_MAX;
+
+    read_span(span);
+    for (int run = 0; run < RUNS; run++) {
+        uint32_t start = perf_ccount();
+        read_span(span);
+        uint32_t cycles = perf_ccount() - start;
+        if (cycles < best) {
+            best = cycles;
+        }
+    }
+    return best;
+}
+
+static void report(flashmode_t mode, uint32_t mhz, const char *what, uint32_t bytes, uint32_t cycles)
+{
+    uint32_t cpu_hz = sdk_system_get_cpu_freq() * 1000000;
+    uint32_t kb_per_s = (uint64_t)bytes * cpu_hz / cycles / 1024;
+
+    printf("BENCH,flash,%s,%u,%s,%u,%u,%u\n", flashmode_name(mode), mhz, what, bytes, cycles, kb_per_s);
+}
+
+static void bench_task(void *pvParameters)
+{
+    flashmode_t boot_mode = flashmode_get_mode();
+    uint32_t boot_speed = flashmode_get_speed();
+
+    printf("# flash_mode_bench, booted in %s %uMHz, CPU %uMHz, lowest of %d runs\n",
+           flashmode_name(boot_mode), boot_speed, sdk_system_get_cpu_freq(), RUNS);
+    printf("# BENCH,flash,mode,mhz,access,bytes,cycles,kb_per_s\n");
+
+    for (flashmode_t mode = FLASHMODE_QIO; mode <= FLASHMODE_DOUT; mode++) {
+        for (size_t i = 0; i < sizeof(speeds) / sizeof(speeds[0]); i++) {
+            if (!flashmode_set(mode, speeds[i])) {
+                printf("# %s %uMHz: unsupported\n", flashmode_name(mode), speeds[i]);
+                continue;
+            }
+            report(mode, speeds[i], "miss", MISS_SPAN, time_span(MISS_SPAN));
+            report(mode, speeds[i], "hit", HIT_SPAN, time_span(HIT_SPAN));
+        }
+    }
+
+    flashmode_set(boot_mode, boot_speed);
+    printf("# done\n");
+
+    while (1) {
+        vTaskDelay(10000 / portTICK_RATE_MS);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    xTaskCreate(bench_task, (signed char *)"bench", 512, NULL, 2, NULL);
+}
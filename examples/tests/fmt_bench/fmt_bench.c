@@ -0,0 +1,158 @@
+/*
+ * snprintf speed and stack use, newlib's against fmt.h's compact
+ * formatter.
+ *
+ * Results are printed as CSV lines for scripts to collect, everything
+ * else is prefixed with '#':
+ *
+ *   BENCH,<case>,<impl>,<cycles>
+ *   BENCH,stack,<impl>,<bytes>
+ *
+ * <impl> is "newlib" or "fmt". The stack line is the most stack a task
+ * used formatting every case once. Build with and without float
+ * support in fmt to compare the float cases too:
+ *
+ *     make flash
+ *     make clean && make flash EXTRA_CFLAGS=-DFMT_FLOAT=1
+ *
+ * Every fmt result is checked against newlib's. The lowest of RUNS
+ * runs is reported, which discards runs that were interrupted.
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "esp/perf.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "fmt.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if FMT_PRINTF
+#error "Build without FMT_PRINTF, so snprintf is still newlib's"
+#endif
+
+#define RUNS 4
+#define OUT_LEN 96
+#define STACK_WORDS 1024
+
+typedef int (*snprintf_fn_t)(char *buf, size_t size, const char *format, ...);
+
+static int case_text(snprintf_fn_t fn, char *buf)
+{
+    return fn(buf, OUT_LEN, "no conversions at all, just text");
+}
+
+static int case_int(snprintf_fn_t fn, char *buf)
+{
+    return fn(buf, OUT_LEN, "%d %u %x %5d|%-5d|", -12345, 40000u, 0xbeef, 42, 7);
+}
+
+static int case_log(snprintf_fn_t fn, char *buf)
+{
+    return fn(buf, OUT_LEN, "%6u.%06u %c %s: %08x", 1234u, 5678u, 'I', "dhcp", 0xc0a80001);
+}
+
+static int case_string(snprintf_fn_t fn, char *buf)
+{
+    return fn(buf, OUT_LEN, "%s=%-12s|%.3s", "ssid", "esp-open-rtos", "truncated");
+}
+
+static int case_int64(snprintf_fn_t fn, char *buf)
+{
+    return fn(buf, OUT_LEN, "%llu %lld", 18446744073709551615ULL, -1234567890123LL);
+}
+
+#if FMT_FLOAT
+static int case_float(snprintf_fn_t fn, char *buf)
+{
+    return fn(buf, OUT_LEN, "%.2f %e %g", 3.14159, 12345.678, 0.0001);
+}
+#endif
+
+static const struct {
+    const char *name;
+    int (*run)(snprintf_fn_t fn, char *buf);
+} cases[] = {
+    { "text", case_text },
+    { "int", case_int },
+    { "log", case_log },
+    { "string", case_string },
+    { "int64", case_int64 },
+#if FMT_FLOAT
+    { "float", case_float },
+#endif
+};
+
+#define NUM_CASES (sizeof(cases) / sizeof(cases[0]))
+
+static const struct {
+    const char *name;
+    snprintf_fn_t fn;
+} impls[] = {
+    { "newlib", snprintf },
+    { "fmt", fmt_snprintf },
+};
+
+static volatile uint32_t stack_used;
+
+/* Runs every case once in a fresh task, to measure its stack */
+static void stack_task(void *arg)
+{
+    char buf[OUT_LEN];
+    snprintf_fn_t fn = arg;
+
+    for (int i = 0; i < NUM_CASES; i++)
+        cases[i].run(fn, buf);
+    stack_used = (STACK_WORDS - uxTaskGetStackHighWaterMark(NULL)) * 4 - sizeof(buf);
+    vTaskDelete(NULL);
+}
+
+static void bench_task(void *pvParameters)
+{
+    char expected[OUT_LEN], got[OUT_LEN];
+
+    printf("# fmt_bench, FMT_FLOAT=%d, lowest of %d runs\n", FMT_FLOAT, RUNS);
+    printf("# BENCH,case,impl,cycles\n");
+    for (int c = 0; c < NUM_CASES; c++) {
+        for (int i = 0; i < sizeof(impls) / sizeof(impls[0]); i++) {
+            uint32_t best = UINT32_MAX;
+            for (int r = 0; r < RUNS; r++) {
+                uint32_t start = perf_ccount();
+                cases[c].run(impls[i].fn, got);
+                uint32_t cycles = perf_ccount() - start;
+                if (cycles < best) {
+                    best = cycles;
+                }
+            }
+            printf("BENCH,%s,%s,%u\n", cases[c].name, impls[i].name, best);
+        }
+        cases[c].run(snprintf, expected);
+        cases[c].run(fmt_snprintf, got);
+        if (strcmp(expected, got)) {
+            printf("# %s: \"%s\", expected \"%s\"\n", cases[c].name, got, expected);
+        }
+    }
+
+    for (int i = 0; i < sizeof(impls) / sizeof(impls[0]); i++) {
+        stack_used = 0;
+        xTaskCreate(stack_task, (signed char *)"stack", STACK_WORDS, impls[i].fn, 3, NULL);
+        while (!stack_used) {
+            vTaskDelay(1);
+        }
+        printf("BENCH,stack,%s,%u\n", impls[i].name, stack_used);
+    }
+    printf("# done\n");
+
+    while (1) {
+        vTaskDelay(10000 / portTICK_RATE_MS);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    xTaskCreate(bench_task, (signed char *)"bench", 512, NULL, 2, NULL);
+}
@@ -0,0 +1,415 @@
+/*
+ * Latency: interrupts, task wakeups, queues and UDP round trips.
+ *
+ * Each test takes SAMPLES measurements and prints their distribution:
+ *
+ *   BENCH,<test>,<unit>,<samples>,<min>,<p50>,<p90>,<p99>,<max>
+ *   HIST,<test>,<unit>,<bucket upper bound>,<count>
+ *
+ * HIST buckets are powers of two (a value v is counted in the bucket
+ * whose bound is the smallest power of two > v) and empty ones are
+ * left out. Other lines are prefixed with '#'. The tests:
+ *
+ * - gpio_isr: GPIO edge to the first instruction of the handler, in
+ *   cycles. Needs a wire from TRIGGER_PIN to EDGE_PIN; the handler also
+ *   toggles ACK_PIN, so a scope on TRIGGER_PIN and ACK_PIN shows the
+ *   end to end figure too.
+ * - gpio_task: the same edge to a task woken from the handler running.
+ * - sem_wake: xSemaphoreGive() to a higher priority task waiting in
+ *   xSemaphoreTake() running, in cycles.
+ * - notify_wake: the same with xTaskNotifyGive()/ulTaskNotifyTake().
+ * - queue_switch, queue_batch: queue throughput, cycles per item, with
+ *   the consumer at higher priority (a switch per item) and at lower
+ *   priority (the queue fills, then drains).
+ * - xtimer_jitter, hrtimer_daemon_jitter: how far apart consecutive
+ *   callbacks of a periodic timer land from its period, in
+ *   microseconds, for a one tick FreeRTOS software timer and for a
+ *   2.5ms esp/hrtimer.h daemon timer. Both callbacks run in the timer
+ *   task.
+ * - udp_rtt: round trips to the UDP echo service (port 7) of ECHO_HOST,
+ *   in microseconds, when built with ECHO_HOST=<address>.
+ *
+ * Cycles are at the CPU clock, printed in the header line. Compare runs
+ * of the same build across releases, or after changing something:
+ *
+ *     make flash ECHO_HOST=192.168.1.10
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "esp/gpio.h"
+#include "esp/perf.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "queue.h"
+#include "timers.h"
+#include "esp/hrtimer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "lwip/sockets.h"
+#include "lwip/sys.h"
+
+#include "ssid_config.h"
+
+#define SAMPLES 1000
+#define QUEUE_ITEMS 10000
+#define QUEUE_LEN 16
+
+#define TRIGGER_PIN 4
+#define EDGE_PIN 5
+#define ACK_PIN 12
+
+static uint32_t samples[SAMPLES];
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void summarize(const char *test, const char *unit, uint32_t *v, size_t n)
+{
+    if (!n) {
+        printf("# %s: no samples\n", test);
+        return;
+    }
+    qsort(v, n, sizeof(*v), compare_u32);
+    printf("BENCH,%s,%s,%u,%u,%u,%u,%u,%u\n", test, unit, n, v[0], v[n / 2],
+           v[n * 9 / 10], v[n * 99 / 100], v[n - 1]);
+
+    /* Sorted, so each bucket is a run */
+    size_t i = 0;
+    for (int b = 0; b < 32 && i < n; b++) {
+        uint32_t bound = 1u << b;
+        size_t count = 0;
+        while (i < n && (v[i] < bound || b == 31)) {
+            count++;
+            i++;
+        }
+        if (count)
+            printf("HIST,%s,%s,%u,%u\n", test, unit, bound, count);
+    }
+}
+
+/* gpio_isr and gpio_task */
+
+static volatile uint32_t edge_ccount;
+static volatile bool edge_seen;
+static xTaskHandle edge_task;
+
+static void IRAM edge_handler(uint8_t gpio_num, void *arg)
+{
+    uint32_t now = perf_ccount();
+
+    gpio_toggle(ACK_PIN);
+    edge_ccount = now;
+    edge_seen = true;
+    if (edge_task) {
+        portBASE_TYPE woken = pdFALSE;
+        vTaskNotifyGiveFromISR(edge_task, &woken);
+        if (woken)
+            portYIELD();
+    }
+}
+
+/* Raises TRIGGER_PIN SAMPLES times, each time the task woken by the
+   edge has gone back to waiting (it's higher priority, so as soon as
+   this runs again) */
+static volatile uint32_t trigger_ccount;
+
+static void trigger_task(void *pvParameters)
+{
+    for (int i = 0; i < SAMPLES; i++) {
+        gpio_write(TRIGGER_PIN, 0);
+        trigger_ccount = perf_ccount();
+        gpio_write(TRIGGER_PIN, 1);
+    }
+    gpio_write(TRIGGER_PIN, 0);
+    vTaskDelete(NULL);
+}
+
+static void bench_gpio(void)
+{
+    size_t n_isr = 0;
+
+    gpio_enable(TRIGGER_PIN, GPIO_OUTPUT);
+    gpio_enable(ACK_PIN, GPIO_OUTPUT);
+    gpio_enable(EDGE_PIN, GPIO_INPUT);
+    gpio_write(TRIGGER_PIN, 0);
+    gpio_set_interrupt_handler(EDGE_PIN, GPIO_INTTYPE_EDGE_POS, edge_handler, NULL);
+
+    for (int i = 0; i < SAMPLES; i++) {
+        edge_seen = false;
+        uint32_t start = perf_ccount();
+        gpio_write(TRIGGER_PIN, 1);
+        while (!edge_seen && perf_ccount() - start < 80000)
+            ;
+        gpio_write(TRIGGER_PIN, 0);
+        if (!edge_seen) {
+            printf("# gpio_isr: no edge on GPIO%d, connect it to GPIO%d\n", EDGE_PIN, TRIGGER_PIN);
+            break;
+        }
+        samples[n_isr++] = edge_ccount - start;
+    }
+    summarize("gpio_isr", "cycles", samples, n_isr);
+
+    if (n_isr == SAMPLES) {
+        size_t n = 0;
+
+        /* The edge has to come from another task, for this one to be
+           blocked waiting for it */
+        edge_task = xTaskGetCurrentTaskHandle();
+        ulTaskNotifyTake(pdTRUE, 0);
+        xTaskCreate(trigger_task, (signed char *)"trigger", 256, NULL, uxTaskPriorityGet(NULL) - 1, NULL);
+        while (n < SAMPLES && ulTaskNotifyTake(pdTRUE, 100 / portTICK_RATE_MS))
+            samples[n++] = perf_ccount() - trigger_ccount;
+        edge_task = NULL;
+        summarize("gpio_task", "cycles", samples, n);
+    }
+    gpio_set_interrupt_handler(EDGE_PIN, GPIO_INTTYPE_NONE, NULL, NULL);
+}
+
+/* sem_wake and notify_wake: a higher priority task takes the timestamp
+   the bench task left just before waking it */
+
+static xSemaphoreHandle wake_sem;
+static volatile uint32_t wake_start;
+static volatile size_t wake_n;
+static volatile bool wake_notify;
+
+static void waker_task(void *pvParameters)
+{
+    while (1) {
+        if (wake_notify)
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        else
+            xSemaphoreTake(wake_sem, portMAX_DELAY);
+        uint32_t now = perf_ccount();
+        if (wake_n < SAMPLES)
+            samples[wake_n++] = now - wake_start;
+    }
+}
+
+static void bench_wake(void)
+{
+    xTaskHandle waker;
+
+    vSemaphoreCreateBinary(wake_sem);
+    xSemaphoreTake(wake_sem, 0);
+    wake_notify = false;
+    wake_n = 0;
+    xTaskCreate(waker_task, (signed char *)"waker", 256, NULL, uxTaskPriorityGet(NULL) + 1, &waker);
+
+    for (int i = 0; i < SAMPLES; i++) {
+        wake_start = perf_ccount();
+        xSemaphoreGive(wake_sem);
+    }
+    summarize("sem_wake", "cycles", samples, wake_n);
+
+    /* The waker is blocked on the semaphore: one more give lets it move
+       to the notification */
+    wake_notify = true;
+    wake_n = SAMPLES;
+    xSemaphoreGive(wake_sem);
+    wake_n = 0;
+    for (int i = 0; i < SAMPLES; i++) {
+        wake_start = perf_ccount();
+        xTaskNotifyGive(waker);
+    }
+    summarize("notify_wake", "cycles", samples, wake_n);
+
+    vTaskDelete(waker);
+    vSemaphoreDelete(wake_sem);
+}
+
+/* queue_switch and queue_batch. Whenever a receive unblocks a sender
+   of the same or higher priority, FreeRTOS switches to it, so for
+   batches the producer doesn't block on the queue: it fills it, then
+   waits for the lower priority consumer to say it's empty. */
+
+static xQueueHandle queue;
+static xSemaphoreHandle queue_drained;
+static xSemaphoreHandle queue_done;
+
+static void consumer_task(void *pvParameters)
+{
+    uint32_t item;
+
+    for (int i = 0; i < QUEUE_ITEMS; i++) {
+        xQueueReceive(queue, &item, portMAX_DELAY);
+        if (!uxQueueMessagesWaiting(queue))
+            xSemaphoreGive(queue_drained);
+    }
+    xSemaphoreGive(queue_done);
+    vTaskDelete(NULL);
+}
+
+static void bench_queue(const char *test, bool batch)
+{
+    unsigned prio = uxTaskPriorityGet(NULL);
+
+    queue = xQueueCreate(QUEUE_LEN, sizeof(uint32_t));
+    vSemaphoreCreateBinary(queue_drained);
+    vSemaphoreCreateBinary(queue_done);
+    xSemaphoreTake(queue_drained, 0);
+    xSemaphoreTake(queue_done, 0);
+    xTaskCreate(consumer_task, (signed char *)"consumer", 256, NULL, batch ? prio - 1 : prio + 1, NULL);
+
+    uint32_t start = perf_ccount();
+    for (uint32_t i = 0; i < QUEUE_ITEMS; i++) {
+        if (!batch) {
+            xQueueSend(queue, &i, portMAX_DELAY);
+            continue;
+        }
+        while (xQueueSend(queue, &i, 0) != pdTRUE)
+            xSemaphoreTake(queue_drained, portMAX_DELAY);
+    }
+    xSemaphoreTake(queue_done, portMAX_DELAY);
+    uint32_t per_item = (perf_ccount() - start) / QUEUE_ITEMS;
+
+    /* One figure, as a distribution of one */
+    summarize(test, "cycles", &per_item, 1);
+    vTaskDelay(1);  /* let the idle task free the consumer */
+    vQueueDelete(queue);
+    vSemaphoreDelete(queue_drained);
+    vSemaphoreDelete(queue_done);
+}
+
+/* xtimer_jitter and hrtimer_daemon_jitter */
+
+#define TIMER_SAMPLES 200
+#define DAEMON_PERIOD_US 2500
+
+static volatile size_t timer_n;
+static uint32_t timer_last;
+static uint32_t timer_period;
+
+static void record_period(void)
+{
+    uint32_t now = hrtimer_now_us();
+
+    if (timer_last && timer_n < TIMER_SAMPLES) {
+        int32_t d = now - timer_last - timer_period;
+        samples[timer_n++] = d < 0 ? -d : d;
+    }
+    timer_last = now;
+}
+
+static void xtimer_callback(xTimerHandle timer)
+{
+    record_period();
+}
+
+static void daemon_callback(void *arg, uint32_t missed)
+{
+    record_period();
+}
+
+static void bench_timers(void)
+{
+    static hrtimer_daemon_t daemon_timer;
+
+    timer_n = 0;
+    timer_last = 0;
+    timer_period = portTICK_RATE_MS * 1000;
+    xTimerHandle timer = xTimerCreate((signed char *)"jitter", 1, pdTRUE, NULL, xtimer_callback);
+    xTimerStart(timer, portMAX_DELAY);
+    while (timer_n < TIMER_SAMPLES)
+        vTaskDelay(100 / portTICK_RATE_MS);
+    xTimerDelete(timer, portMAX_DELAY);
+    summarize("xtimer_jitter", "us", samples, timer_n);
+
+    timer_n = 0;
+    timer_last = 0;
+    timer_period = DAEMON_PERIOD_US;
+    hrtimer_daemon_init(&daemon_timer, daemon_callback, NULL);
+    hrtimer_daemon_start(&daemon_timer, DAEMON_PERIOD_US, DAEMON_PERIOD_US);
+    while (timer_n < TIMER_SAMPLES)
+        vTaskDelay(100 / portTICK_RATE_MS);
+    hrtimer_daemon_stop(&daemon_timer);
+    summarize("hrtimer_daemon_jitter", "us", samples, timer_n);
+}
+
+#ifdef ECHO_HOST
+static void bench_udp_rtt(void)
+{
+    static char payload[32];
+    struct sockaddr_in addr;
+    size_t n = 0;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(7);
+    int s = lwip_socket(AF_INET, SOCK_DGRAM, 0);
+    if (s < 0 || !inet_aton(ECHO_HOST, &addr.sin_addr) ||
+        lwip_connect(s, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        printf("# udp_rtt: can't set up for %s\n", ECHO_HOST);
+        if (s >= 0)
+            lwip_close(s);
+        return;
+    }
+    int timeout = 500;
+    lwip_setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    for (int i = 0; i < SAMPLES; i++) {
+        uint32_t start = sys_now_us();
+        if (lwip_send(s, payload, sizeof(payload), 0) != sizeof(payload) ||
+            lwip_recv(s, payload, sizeof(payload), 0) <= 0)
+            continue;
+        samples[n++] = sys_now_us() - start;
+    }
+    if (n < SAMPLES)
+        printf("# udp_rtt: %u of %u lost\n", SAMPLES - n, SAMPLES);
+    summarize("udp_rtt", "us", samples, n);
+    lwip_close(s);
+}
+#endif
+
+static void bench_task(void *pvParameters)
+{
+    printf("# latency_bench, %u MHz, %d samples per test\n", sdk_system_get_cpu_freq(), SAMPLES);
+    printf("# BENCH,test,unit,samples,min,p50,p90,p99,max\n");
+    printf("# HIST,test,unit,bucket_bound,count\n");
+
+    bench_gpio();
+    bench_wake();
+    bench_queue("queue_switch", false);
+    bench_queue("queue_batch", true);
+    bench_timers();
+
+#ifdef ECHO_HOST
+    while (sdk_wifi_station_get_connect_status() != STATION_GOT_IP) {
+        vTaskDelay(100 / portTICK_RATE_MS);
+    }
+    bench_udp_rtt();
+#else
+    printf("# udp_rtt: build with ECHO_HOST=<address> to run\n");
+#endif
+    printf("# done\n");
+
+    while (1) {
+        vTaskDelay(10000 / portTICK_RATE_MS);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+
+    struct sdk_station_config config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+    };
+
+    /* required to call wifi_set_opmode before station_set_config */
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_station_set_config(&config);
+
+    xTaskCreate(bench_task, (signed char *)"bench", 512, NULL, 3, NULL);
+}
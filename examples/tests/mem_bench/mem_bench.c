@@ -0,0 +1,215 @@
+/*
+ * memcpy, memset and memmove speed, in CPU cycles, for the versions
+ * linked into the firmware (newlib's assembly memcpy and memset, and
+ * the word-wise memmove in core/memmove.c, all in IRAM) against the
+ * mask ROM's and a plain byte loop.
+ *
+ * Results are printed as CSV lines for scripts to collect, everything
+ * else is prefixed with '#':
+ *
+ *   BENCH,<function>,<impl>,<case>,<bytes>,<cycles>,<cycles per byte x100>
+ *
+ * <impl> is "lib", "rom" or "bytes". <case> gives the destination and
+ * source offsets from word alignment ("d0s1"), or for memmove the
+ * overlap: "down3" moves a buffer 3 bytes towards lower addresses,
+ * "up5" 5 bytes towards higher ones.
+ *
+ * Every result is checked against the byte loop. The lowest of RUNS
+ * runs is reported, which discards runs that were interrupted.
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "esp/hwrand.h"
+#include "esp/perf.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define RUNS 4
+#define MAX_LEN 1460
+#define SLACK 32
+
+/* Entry points in the mask ROM, see ld/rom.ld */
+typedef void *(*copy_fn_t)(void *dst, const void *src, size_t n);
+typedef void *(*set_fn_t)(void *dst, int c, size_t n);
+
+#define ROM_MEMCPY  ((copy_fn_t)0x400018b4)
+#define ROM_MEMMOVE ((copy_fn_t)0x400018c4)
+#define ROM_MEMSET  ((set_fn_t)0x400018a4)
+
+static const size_t sizes[] = { 16, 64, 256, MAX_LEN };
+
+static const struct {
+    const char *name;
+    int dst, src;
+} copies[] = {
+    { "d0s0", 0, 0 },
+    { "d0s1", 0, 1 },
+    { "d2s1", 2, 1 },
+    { "d3s3", 3, 3 },
+};
+
+static const struct {
+    const char *name;
+    int shift;
+} moves[] = {
+    { "down3", -3 },
+    { "down4", -4 },
+    { "up5", 5 },
+    { "up8", 8 },
+};
+
+static uint8_t src_buf[MAX_LEN + SLACK] __attribute__((aligned(4)));
+static uint8_t dst_buf[MAX_LEN + SLACK] __attribute__((aligned(4)));
+static uint8_t ref_buf[MAX_LEN + SLACK] __attribute__((aligned(4)));
+
+/* Called through pointers so the compiler can't inline the library
+   ones */
+static void *lib_memcpy(void *d, const void *s, size_t n) { return memcpy(d, s, n); }
+static void *lib_memmove(void *d, const void *s, size_t n) { return memmove(d, s, n); }
+static void *lib_memset(void *d, int c, size_t n) { return memset(d, c, n); }
+
+static void *bytes_copy(void *dst, const void *src, size_t n)
+{
+    volatile uint8_t *d = dst;
+    const uint8_t *s = src;
+    if (d < s) {
+        while (n--)
+            *d++ = *s++;
+    } else {
+        while (n--)
+            d[n] = s[n];
+    }
+    return dst;
+}
+
+static void *bytes_set(void *dst, int c, size_t n)
+{
+    volatile uint8_t *d = dst;
+    while (n--)
+        *d++ = c;
+    return dst;
+}
+
+static void report(const char *fn, const char *impl, const char *name, size_t len, uint32_t cycles)
+{
+    printf("BENCH,%s,%s,%s,%u,%u,%u\n", fn, impl, name, len, cycles,
+           (uint32_t)((uint64_t)cycles * 100 / len));
+}
+
+static void check(const char *fn, const char *impl, const char *name, size_t len)
+{
+    if (memcmp(dst_buf, ref_buf, sizeof(dst_buf))) {
+        printf("# %s %s %s %u: wrong result\n", fn, impl, name, len);
+    }
+}
+
+static void bench_copy(const char *impl, copy_fn_t fn)
+{
+    for (int c = 0; c < sizeof(copies) / sizeof(copies[0]); c++) {
+        for (int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            size_t len = sizes[i];
+            uint8_t *d = dst_buf + copies[c].dst;
+            const uint8_t *s = src_buf + copies[c].src;
+            uint32_t best = UINT32_MAX;
+
+            memset(ref_buf, 0, sizeof(ref_buf));
+            bytes_copy(ref_buf + copies[c].dst, s, len);
+            for (int r = 0; r < RUNS; r++) {
+                memset(dst_buf, 0, sizeof(dst_buf));
+                uint32_t start = perf_ccount();
+                fn(d, s, len);
+                uint32_t cycles = perf_ccount() - start;
+                if (cycles < best) {
+                    best = cycles;
+                }
+            }
+            check("memcpy", impl, copies[c].name, len);
+            report("memcpy", impl, copies[c].name, len, best);
+        }
+    }
+}
+
+static void bench_set(const char *impl, set_fn_t fn)
+{
+    for (int c = 0; c < sizeof(copies) / sizeof(copies[0]); c++) {
+        for (int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            size_t len = sizes[i];
+            uint8_t *d = dst_buf + copies[c].dst;
+            uint32_t best = UINT32_MAX;
+
+            memset(ref_buf, 0, sizeof(ref_buf));
+            bytes_set(ref_buf + copies[c].dst, 0xa5, len);
+            for (int r = 0; r < RUNS; r++) {
+                memset(dst_buf, 0, sizeof(dst_buf));
+                uint32_t start = perf_ccount();
+                fn(d, 0xa5, len);
+                uint32_t cycles = perf_ccount() - start;
+                if (cycles < best) {
+                    best = cycles;
+                }
+            }
+            check("memset", impl, copies[c].name, len);
+            report("memset", impl, copies[c].name, len, best);
+        }
+    }
+}
+
+/* Overlapping moves within dst_buf, from the middle of the slack */
+static void bench_move(const char *impl, copy_fn_t fn)
+{
+    for (int c = 0; c < sizeof(moves) / sizeof(moves[0]); c++) {
+        for (int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            size_t len = sizes[i];
+            int from = SLACK / 2 + 1;
+            int to = from + moves[c].shift;
+            uint32_t best = UINT32_MAX;
+
+            memcpy(ref_buf, src_buf, sizeof(ref_buf));
+            bytes_copy(ref_buf + to, ref_buf + from, len);
+            for (int r = 0; r < RUNS; r++) {
+                memcpy(dst_buf, src_buf, sizeof(dst_buf));
+                uint32_t start = perf_ccount();
+                fn(dst_buf + to, dst_buf + from, len);
+                uint32_t cycles = perf_ccount() - start;
+                if (cycles < best) {
+                    best = cycles;
+                }
+            }
+            check("memmove", impl, moves[c].name, len);
+            report("memmove", impl, moves[c].name, len, best);
+        }
+    }
+}
+
+static void bench_task(void *pvParameters)
+{
+    hwrand_fill(src_buf, sizeof(src_buf));
+
+    printf("# mem_bench, lowest of %d runs\n", RUNS);
+    printf("# BENCH,function,impl,case,bytes,cycles,cycles_per_byte_x100\n");
+    bench_copy("lib", lib_memcpy);
+    bench_copy("rom", ROM_MEMCPY);
+    bench_copy("bytes", bytes_copy);
+    bench_set("lib", lib_memset);
+    bench_set("rom", ROM_MEMSET);
+    bench_set("bytes", bytes_set);
+    bench_move("lib", lib_memmove);
+    bench_move("rom", ROM_MEMMOVE);
+    bench_move("bytes", bytes_copy);
+    printf("# done\n");
+
+    while (1) {
+        vTaskDelay(10000 / portTICK_RATE_MS);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    xTaskCreate(bench_task, (signed char *)"bench", 512, NULL, 2, NULL);
+}
@@ -0,0 +1,143 @@
+/*
+ * Cost of a netconn API call, and UDP request/response rate, with and
+ * without LWIP_TCPIP_CORE_LOCKING.
+ *
+ * Without core locking each netconn call is a message to tcpip_thread
+ * and a wait for its reply; with it the calling task runs the stack
+ * code itself, holding the core lock. The "local" test times a call
+ * that involves no network at all (netconn_getaddr() on a bound UDP
+ * netconn), so shows the per-call overhead alone. The "udp_rr" test
+ * sends one datagram at a time to the UDP echo service (port 7) of
+ * ECHO_HOST, if set, and waits for it to come back.
+ *
+ * Results are printed as CSV lines for scripts to collect, everything
+ * else is prefixed with '#':
+ *
+ *   BENCH,<test>,<core_locking>,<calls>,<us>,<us per call x100>
+ *
+ * To compare, build and run it both ways:
+ *
+ *     make flash ECHO_HOST=192.168.1.10
+ *     make clean && make flash ECHO_HOST=192.168.1.10 EXTRA_CFLAGS=-DLWIP_TCPIP_CORE_LOCKING=1
+ *
+ * (Any UDP echo server will do, e.g. "socat UDP-RECVFROM:7,fork PIPE".)
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "lwip/api.h"
+#include "lwip/sys.h"
+
+#include "ssid_config.h"
+
+#define LOCAL_CALLS 5000
+#define RR_CALLS 500
+#define RR_LEN 32
+
+static void report(const char *test, uint32_t calls, uint32_t us)
+{
+    printf("BENCH,%s,%d,%u,%u,%u\n", test, LWIP_TCPIP_CORE_LOCKING, calls, us,
+           (uint32_t)((uint64_t)us * 100 / calls));
+}
+
+static void bench_local(void)
+{
+    struct netconn *conn = netconn_new(NETCONN_UDP);
+    if (!conn || netconn_bind(conn, IP_ADDR_ANY, 0) != ERR_OK) {
+        printf("# local: no netconn\n");
+        return;
+    }
+
+    ip_addr_t addr;
+    u16_t port;
+    uint32_t start = sys_now_us();
+    for (int i = 0; i < LOCAL_CALLS; i++) {
+        netconn_getaddr(conn, &addr, &port, 1);
+    }
+    report("local", LOCAL_CALLS, sys_now_us() - start);
+    netconn_delete(conn);
+}
+
+#ifdef ECHO_HOST
+static void bench_udp_rr(void)
+{
+    static uint8_t payload[RR_LEN];
+    ip_addr_t host;
+    struct netconn *conn = netconn_new(NETCONN_UDP);
+
+    if (!conn || !ipaddr_aton(ECHO_HOST, &host) || netconn_connect(conn, &host, 7) != ERR_OK) {
+        printf("# udp_rr: can't set up for %s\n", ECHO_HOST);
+        if (conn)
+            netconn_delete(conn);
+        return;
+    }
+    netconn_set_recvtimeout(conn, 1000);
+
+    struct netbuf *tx = netbuf_new();
+    uint32_t lost = 0;
+    uint32_t start = sys_now_us();
+    for (int i = 0; i < RR_CALLS; i++) {
+        struct netbuf *rx;
+
+        netbuf_ref(tx, payload, sizeof(payload));
+        if (netconn_send(conn, tx) != ERR_OK || netconn_recv(conn, &rx) != ERR_OK) {
+            lost++;
+            continue;
+        }
+        netbuf_delete(rx);
+    }
+    uint32_t us = sys_now_us() - start;
+    if (lost) {
+        printf("# udp_rr: %u of %u lost (each costs the 1s timeout)\n", lost, RR_CALLS);
+    }
+    report("udp_rr", RR_CALLS, us);
+    netbuf_delete(tx);
+    netconn_delete(conn);
+}
+#endif
+
+static void bench_task(void *pvParameters)
+{
+    printf("# netconn_rr_bench, LWIP_TCPIP_CORE_LOCKING=%d\n", LWIP_TCPIP_CORE_LOCKING);
+    printf("# BENCH,test,core_locking,calls,us,us_per_call_x100\n");
+    bench_local();
+
+#ifdef ECHO_HOST
+    while (sdk_wifi_station_get_connect_status() != STATION_GOT_IP) {
+        vTaskDelay(100 / portTICK_RATE_MS);
+    }
+    bench_udp_rr();
+#else
+    printf("# udp_rr: build with ECHO_HOST=<address> to run\n");
+#endif
+    printf("# done\n");
+
+    while (1) {
+        vTaskDelay(10000 / portTICK_RATE_MS);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+
+    struct sdk_station_config config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+    };
+
+    /* required to call wifi_set_opmode before station_set_config */
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_station_set_config(&config);
+
+    /* Stack code runs in this task with core locking, so it needs more */
+    xTaskCreate(bench_task, (signed char *)"bench", 768, NULL, 2, NULL);
+}
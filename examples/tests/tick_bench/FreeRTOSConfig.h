@@ -0,0 +1,8 @@
+/* tick_bench FreeRTOSConfig overrides.
+
+   The tick rate under test, e.g. rebuild with 100 to compare.
+*/
+#define configTICK_RATE_HZ ((portTickType)1000)
+
+/* Use the defaults for everything else */
+#include_next<FreeRTOSConfig.h>
@@ -0,0 +1,154 @@
+/*
+ * The cost and accuracy of the RTOS tick, at the configTICK_RATE_HZ in
+ * this directory's FreeRTOSConfig.h (1000Hz, rebuild with 100 to
+ * compare).
+ *
+ * Each test takes up to SAMPLES measurements and prints their
+ * distribution, other lines are prefixed with '#':
+ *
+ *   BENCH,<test>,<unit>,<samples>,<min>,<p50>,<p90>,<p99>,<max>
+ *
+ * - tick_isr: the highest priority task spins reading CCOUNT for
+ *   SPIN_MS, and each gap longer than GAP_CYCLES is an interrupt taken
+ *   (mostly the tick), in cycles. The share of the CPU they took is
+ *   printed after it.
+ * - delay_1, delay_10: how long vTaskDelay(1) and vTaskDelay(10) took,
+ *   in microseconds.
+ * - os_timer: the interval between calls of a 100ms periodic SDK
+ *   os_timer, in microseconds, which should stay at 100000 whatever the
+ *   tick rate.
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "esp/perf.h"
+#include "esp/hrtimer.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SAMPLES 500
+#define SPIN_MS 1000
+#define GAP_CYCLES 100
+#define OS_TIMER_MS 100
+
+static uint32_t samples[SAMPLES];
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void summarize(const char *test, const char *unit, uint32_t *v, size_t n)
+{
+    if (!n) {
+        printf("# %s: no samples\n", test);
+        return;
+    }
+    qsort(v, n, sizeof(*v), compare_u32);
+    printf("BENCH,%s,%s,%u,%u,%u,%u,%u,%u\n", test, unit, n, v[0], v[n / 2],
+           v[n * 9 / 10], v[n * 99 / 100], v[n - 1]);
+}
+
+/* tick_isr */
+
+static void IRAM __attribute__((noinline)) spin(uint32_t cycles, size_t *n, uint64_t *stolen)
+{
+    uint32_t start = perf_ccount();
+    uint32_t last = start;
+
+    while (last - start < cycles) {
+        uint32_t now = perf_ccount();
+        uint32_t gap = now - last;
+        if (gap > GAP_CYCLES) {
+            *stolen += gap;
+            if (*n < SAMPLES)
+                samples[(*n)++] = gap;
+        }
+        last = now;
+    }
+}
+
+static void test_tick_isr(void)
+{
+    uint32_t cycles = sdk_system_get_cpu_freq() * 1000 * SPIN_MS;
+    uint64_t stolen = 0;
+    size_t n = 0;
+
+    /* Start on a tick boundary, so the run is a whole number of ticks */
+    vTaskDelay(1);
+    spin(cycles, &n, &stolen);
+    summarize("tick_isr", "cycles", samples, n);
+    printf("# tick_isr: %u interrupts in %dms, %u.%02u%% of the CPU\n", n, SPIN_MS,
+           (uint32_t)(stolen * 100 / cycles), (uint32_t)(stolen * 10000 / cycles % 100));
+}
+
+/* delay_1, delay_10 */
+
+static void test_delay(const char *test, portTickType ticks)
+{
+    size_t n = SAMPLES / ticks;
+
+    vTaskDelay(1);
+    for (size_t i = 0; i < n; i++) {
+        uint32_t start = hrtimer_now_us();
+        vTaskDelay(ticks);
+        samples[i] = hrtimer_now_us() - start;
+    }
+    summarize(test, "us", samples, n);
+}
+
+/* os_timer */
+
+static sdk_os_timer_t os_timer;
+static volatile size_t os_timer_n;
+static uint32_t os_timer_last;
+
+static void os_timer_fn(void *arg)
+{
+    uint32_t now = hrtimer_now_us();
+
+    if (os_timer_last && os_timer_n < SAMPLES)
+        samples[os_timer_n++] = now - os_timer_last;
+    os_timer_last = now;
+}
+
+static void test_os_timer(void)
+{
+    const size_t n = 50;
+
+    os_timer_n = 0;
+    os_timer_last = 0;
+    sdk_os_timer_setfn(&os_timer, os_timer_fn, NULL);
+    sdk_os_timer_arm(&os_timer, OS_TIMER_MS, true);
+    vTaskDelay((n + 2) * OS_TIMER_MS / portTICK_RATE_MS);
+    sdk_os_timer_disarm(&os_timer);
+    summarize("os_timer", "us", samples, os_timer_n < n ? os_timer_n : n);
+}
+
+static void bench_task(void *pvParameters)
+{
+    printf("# tick_bench, %uHz tick, %uMHz CPU\n", (unsigned)configTICK_RATE_HZ,
+           sdk_system_get_cpu_freq());
+    printf("# BENCH,test,unit,samples,min,p50,p90,p99,max\n");
+
+    test_tick_isr();
+    test_delay("delay_1", 1);
+    test_delay("delay_10", 10);
+    test_os_timer();
+    printf("# done\n");
+
+    while (1) {
+        vTaskDelay(10000 / portTICK_RATE_MS);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    xTaskCreate(bench_task, (signed char *)"bench", 512, NULL, configMAX_PRIORITIES - 1, NULL);
+}
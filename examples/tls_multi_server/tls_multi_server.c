@@ -0,0 +1,274 @@
+/* tls_multi_server - TLS server serving several clients from one task.
+ *
+ * Same output as the tls_server example, but sockets are non-blocking
+ * and a single task waits on the listening socket and all client
+ * connections at once with mbedtls_net_poll() (extras/mbedtls/include/
+ * net_poll.h), stepping each connection along as it becomes ready.
+ * Compared to a task per connection, this saves a 2KB+ stack for each.
+ *
+ * Each connection's SSL context (and its record buffers) is only
+ * allocated while the client is connected. Build with
+ * EXTRA_CFLAGS=-DMBEDTLS_LOW_RAM_PROFILE to fit more clients in the heap.
+ *
+ * Note the public key operations of a handshake still run to completion
+ * in one go, so other connections wait while one is being set up.
+ *
+ * To test this program, connect several clients at once:
+ *
+ * for i in 1 2 3; do openssl s_client -connect 192.168.66.209:800 & done
+ *
+ * Original Copyright (C) 2006-2015, ARM Limited, All Rights Reserved, Apache 2.0 License.
+ * Additions Copyright (C) 2016 Angus Gratton, Apache 2.0 License.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+
+#include <string.h>
+#include <stdbool.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "lwip/sockets.h"
+
+#include "ssid_config.h"
+
+/* Server cert & key */
+extern const char *server_cert;
+extern const char *server_key;
+
+/* mbedtls/config.h MUST appear before all other mbedtls headers, or
+   you'll get the default config. */
+#include "mbedtls/config.h"
+
+#include "mbedtls/net.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/error.h"
+
+#include "net_poll.h"
+#include "ssl_session_cache.h"
+
+#define PORT "800"
+#define MAX_CLIENTS 3
+
+typedef enum {
+    CLIENT_FREE,
+    CLIENT_HANDSHAKE,
+    CLIENT_WRITE,
+} client_state_t;
+
+typedef struct {
+    client_state_t state;
+    uint8_t want;              /* MBEDTLS_NET_POLL_x the last call asked for */
+    mbedtls_net_context net;
+    mbedtls_ssl_context ssl;
+    char buf[128];
+    int len;
+    int sent;
+} client_t;
+
+static mbedtls_ssl_config conf;
+static client_t clients[MAX_CLIENTS];
+
+static void client_close(client_t *client, int ret)
+{
+    if (ret != 0) {
+        char error_buf[100];
+        mbedtls_strerror(ret, error_buf, sizeof(error_buf));
+        printf("client %d: error %d - %s\n", client - clients, ret, error_buf);
+    } else {
+        mbedtls_ssl_close_notify(&client->ssl);
+    }
+    mbedtls_ssl_free(&client->ssl);
+    mbedtls_net_free(&client->net);
+    client->state = CLIENT_FREE;
+}
+
+static void client_accept(mbedtls_net_context *listen_ctx)
+{
+    client_t *client = NULL;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (clients[i].state == CLIENT_FREE) {
+            client = &clients[i];
+            break;
+        }
+    }
+    if (!client) {
+        return;
+    }
+
+    mbedtls_net_init(&client->net);
+    int ret = mbedtls_net_accept(listen_ctx, &client->net, NULL, 0, NULL);
+    if (ret != 0) {
+        return; /* MBEDTLS_ERR_SSL_WANT_READ if the client went away again */
+    }
+    mbedtls_net_set_nonblock(&client->net);
+
+    mbedtls_ssl_init(&client->ssl);
+    ret = mbedtls_ssl_setup(&client->ssl, &conf);
+    if (ret != 0) {
+        printf("client %d: mbedtls_ssl_setup returned -0x%x, free heap %u\n",
+               client - clients, -ret, xPortGetFreeHeapSize());
+        mbedtls_ssl_free(&client->ssl);
+        mbedtls_net_free(&client->net);
+        return;
+    }
+    mbedtls_ssl_set_bio(&client->ssl, &client->net, mbedtls_net_send, mbedtls_net_recv, NULL);
+
+    client->state = CLIENT_HANDSHAKE;
+    client->want = MBEDTLS_NET_POLL_READ; /* for the ClientHello */
+    printf("client %d: connected, free heap %u\n", client - clients, xPortGetFreeHeapSize());
+}
+
+/* Map an mbedtls "try again" result to what to wait for, 0 otherwise */
+static uint8_t want_for(int ret)
+{
+    if (ret == MBEDTLS_ERR_SSL_WANT_READ) {
+        return MBEDTLS_NET_POLL_READ;
+    }
+    if (ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+        return MBEDTLS_NET_POLL_WRITE;
+    }
+    return 0;
+}
+
+/* Carry on with whatever the client is doing, as far as it can go
+   without blocking */
+static void client_step(client_t *client)
+{
+    int ret;
+
+    if (client->state == CLIENT_HANDSHAKE) {
+        ret = mbedtls_ssl_handshake(&client->ssl);
+        if ((client->want = want_for(ret))) {
+            return;
+        }
+        if (ret != 0) {
+            client_close(client, ret);
+            return;
+        }
+
+        struct sockaddr_in peer_addr;
+        socklen_t peer_addr_len = sizeof(struct sockaddr_in);
+        getpeername(client->net.fd, (struct sockaddr *)&peer_addr, &peer_addr_len);
+        client->len = snprintf(client->buf, sizeof(client->buf),
+                               "O hai, client %d.%d.%d.%d:%d\nFree heap size is %d bytes\n",
+                               ip4_addr1(&peer_addr.sin_addr), ip4_addr2(&peer_addr.sin_addr),
+                               ip4_addr3(&peer_addr.sin_addr), ip4_addr4(&peer_addr.sin_addr),
+                               peer_addr.sin_port, xPortGetFreeHeapSize());
+        client->sent = 0;
+        client->state = CLIENT_WRITE;
+    }
+
+    while (client->sent < client->len) {
+        ret = mbedtls_ssl_write(&client->ssl, (unsigned char *)client->buf + client->sent,
+                                client->len - client->sent);
+        if ((client->want = want_for(ret))) {
+            return;
+        }
+        if (ret < 0) {
+            client_close(client, ret);
+            return;
+        }
+        client->sent += ret;
+    }
+
+    printf("client %d: done\n", client - clients);
+    client_close(client, 0);
+}
+
+static void tls_multi_server_task(void *pvParameters)
+{
+    const char *pers = "tls_multi_server";
+    int ret;
+
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context ctr_drbg;
+    mbedtls_x509_crt srvcert;
+    mbedtls_pk_context pkey;
+    mbedtls_net_context listen_ctx;
+    static ssl_session_cache_t cache;
+
+    mbedtls_x509_crt_init(&srvcert);
+    mbedtls_pk_init(&pkey);
+    mbedtls_ctr_drbg_init(&ctr_drbg);
+    mbedtls_ssl_config_init(&conf);
+    mbedtls_entropy_init(&entropy);
+    mbedtls_net_init(&listen_ctx);
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        mbedtls_net_init(&clients[i].net);
+    }
+
+    if ((ret = mbedtls_ctr_drbg_seed(&ctr_drbg, mbedtls_entropy_func, &entropy,
+                                     (const unsigned char *)pers, strlen(pers))) != 0 ||
+        (ret = mbedtls_x509_crt_parse(&srvcert, (uint8_t *)server_cert, strlen(server_cert) + 1)) < 0 ||
+        (ret = mbedtls_pk_parse_key(&pkey, (uint8_t *)server_key, strlen(server_key) + 1, NULL, 0)) != 0 ||
+        (ret = mbedtls_ssl_config_defaults(&conf, MBEDTLS_SSL_IS_SERVER, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                           MBEDTLS_SSL_PRESET_DEFAULT)) != 0 ||
+        (ret = mbedtls_ssl_conf_own_cert(&conf, &srvcert, &pkey)) != 0) {
+        printf("TLS setup failed, -0x%x\n", -ret);
+        while (1) {} /* todo: replace with abort() */
+    }
+    mbedtls_ssl_conf_ca_chain(&conf, srvcert.next, NULL);
+    mbedtls_ssl_conf_rng(&conf, mbedtls_ctr_drbg_random, &ctr_drbg);
+    ssl_session_cache_init(&cache);
+    mbedtls_ssl_conf_session_cache(&conf, &cache, ssl_session_cache_get, ssl_session_cache_set);
+
+    while ((ret = mbedtls_net_bind(&listen_ctx, NULL, PORT, MBEDTLS_NET_PROTO_TCP)) != 0) {
+        printf("mbedtls_net_bind returned %d, retrying\n", ret);
+        vTaskDelay(1000 / portTICK_RATE_MS);
+    }
+    mbedtls_net_set_nonblock(&listen_ctx);
+    printf("Listening on port %s for up to %d clients\n", PORT, MAX_CLIENTS);
+
+    mbedtls_net_pollfd fds[MAX_CLIENTS + 1];
+    while (1) {
+        bool have_free = false;
+        for (int i = 0; i < MAX_CLIENTS; i++) {
+            client_t *client = &clients[i];
+            fds[i].net = &client->net;
+            fds[i].ssl = &client->ssl;
+            fds[i].events = (client->state == CLIENT_FREE) ? 0 : client->want;
+            have_free |= (client->state == CLIENT_FREE);
+        }
+        /* Only accept connections when there's room for them */
+        fds[MAX_CLIENTS].net = &listen_ctx;
+        fds[MAX_CLIENTS].ssl = NULL;
+        fds[MAX_CLIENTS].events = have_free ? MBEDTLS_NET_POLL_READ : 0;
+
+        ret = mbedtls_net_poll(fds, MAX_CLIENTS + 1, 0);
+        if (ret < 0) {
+            printf("mbedtls_net_poll returned -0x%x\n", -ret);
+            vTaskDelay(100 / portTICK_RATE_MS);
+            continue;
+        }
+
+        for (int i = 0; i < MAX_CLIENTS; i++) {
+            if (fds[i].revents) {
+                client_step(&clients[i]);
+            }
+        }
+        if (fds[MAX_CLIENTS].revents) {
+            client_accept(&listen_ctx);
+        }
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    struct sdk_station_config config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+    };
+
+    /* required to call wifi_set_opmode before station_set_config */
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_station_set_config(&config);
+
+    xTaskCreate(&tls_multi_server_task, (signed char *)"server_task", 2048, NULL, 2, NULL);
+}
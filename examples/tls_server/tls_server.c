@@ -10,8 +10,22 @@
  * The openssl command line client will print some information for the (self-signed) server certificate,
  * then after a couple of seconds (validation) there will be a few lines of text output sent from the ESP.
  *
+ * Sessions are cached, so a client reconnecting with the same session skips the slow
+ * public key operations. To see this, save and reuse the session with openssl:
+ *
+ * openssl s_client -connect 192.168.66.209:800 -sess_out sess.pem
+ * openssl s_client -connect 192.168.66.209:800 -sess_in sess.pem
+ *
  * See the cert.c file for private key & certificate (PEM format), plus information for generation.
  *
+ * Built with the pre-shared key profile (make MBEDTLS_PSK_PROFILE=1, see
+ * extras/mbedtls/include/mbedtls_psk_profile.h) the server has no certificate, and clients
+ * authenticate with the PSK_IDENTITY and psk below instead:
+ *
+ * openssl s_client -connect 192.168.66.209:800 -psk_identity esp8266 -psk 000102030405060708090a0b0c0d0e0f
+ *
+ * The handshake time is printed for each connection, to compare the two.
+ *
  * Original Copyright (C) 2006-2015, ARM Limited, All Rights Reserved, Apache 2.0 License.
  * Additions Copyright (C) 2016 Angus Gratton, Apache 2.0 License.
  */
@@ -32,9 +46,18 @@
 
 #include "ssid_config.h"
 
+#ifndef MBEDTLS_PSK_PROFILE
 /* Server cert & key */
 extern const char *server_cert;
 extern const char *server_key;
+#else
+/* Shared with the clients. Use your own random key for anything real! */
+#define PSK_IDENTITY "esp8266"
+static const unsigned char psk[16] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+};
+#endif
 
 /* mbedtls/config.h MUST appear before all other mbedtls headers, or
    you'll get the default config.
@@ -51,6 +74,8 @@ extern const char *server_key;
 #include "mbedtls/error.h"
 #include "mbedtls/certs.h"
 
+#include "ssl_session_cache.h"
+
 #define PORT "800"
 
 void tls_server_task(void *pvParameters)
@@ -63,17 +88,22 @@ void tls_server_task(void *pvParameters)
     mbedtls_entropy_context entropy;
     mbedtls_ctr_drbg_context ctr_drbg;
     mbedtls_ssl_context ssl;
+#ifndef MBEDTLS_PSK_PROFILE
     mbedtls_x509_crt srvcert;
     mbedtls_pk_context pkey;
+#endif
     mbedtls_ssl_config conf;
     mbedtls_net_context server_ctx;
+    static ssl_session_cache_t cache;
 
     /*
      * 0. Initialize the RNG and the session data
      */
     mbedtls_ssl_init(&ssl);
+#ifndef MBEDTLS_PSK_PROFILE
     mbedtls_x509_crt_init(&srvcert);
     mbedtls_pk_init( &pkey );
+#endif
     mbedtls_ctr_drbg_init(&ctr_drbg);
     printf("\n  . Seeding the random number generator...");
 
@@ -90,6 +120,7 @@ void tls_server_task(void *pvParameters)
 
     printf(" ok\n");
 
+#ifndef MBEDTLS_PSK_PROFILE
     /*
      * 0. Initialize certificates
      */
@@ -113,6 +144,7 @@ void tls_server_task(void *pvParameters)
     }
 
     printf(" ok\n");
+#endif
 
     /*
      * 2. Setup stuff
@@ -130,14 +162,28 @@ void tls_server_task(void *pvParameters)
 
     printf(" ok\n");
 
+#ifndef MBEDTLS_PSK_PROFILE
     mbedtls_ssl_conf_ca_chain(&conf, srvcert.next, NULL);
     if( ( ret = mbedtls_ssl_conf_own_cert( &conf, &srvcert, &pkey ) ) != 0 )
     {
         printf( " failed\n  ! mbedtls_ssl_conf_own_cert returned %d\n\n", ret );
         while(1) { }
     }
+#else
+    /* A server with many clients would look up each identity's key with
+       mbedtls_ssl_conf_psk_cb() instead */
+    if( ( ret = mbedtls_ssl_conf_psk( &conf, psk, sizeof(psk),
+                                      (const unsigned char *)PSK_IDENTITY, strlen(PSK_IDENTITY) ) ) != 0 )
+    {
+        printf( " failed\n  ! mbedtls_ssl_conf_psk returned %d\n\n", ret );
+        while(1) { }
+    }
+#endif
 
     mbedtls_ssl_conf_rng(&conf, mbedtls_ctr_drbg_random, &ctr_drbg);
+
+    ssl_session_cache_init(&cache);
+    mbedtls_ssl_conf_session_cache(&conf, &cache, ssl_session_cache_get, ssl_session_cache_set);
 #ifdef MBEDTLS_DEBUG_C
     mbedtls_debug_set_threshold(DEBUG_LEVEL);
     mbedtls_ssl_conf_dbg(&conf, my_debug, stdout);
@@ -181,6 +227,7 @@ void tls_server_task(void *pvParameters)
          */
         printf("  . Performing the SSL/TLS handshake...");
 
+        uint32_t handshake_start = xTaskGetTickCount();
         while((ret = mbedtls_ssl_handshake(&ssl)) != 0)
         {
             if(ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE)
@@ -190,7 +237,8 @@ void tls_server_task(void *pvParameters)
             }
         }
 
-        printf(" ok\n");
+        printf(" ok (%u ms, %s)\n", (xTaskGetTickCount() - handshake_start) * portTICK_RATE_MS,
+               mbedtls_ssl_get_ciphersuite(&ssl));
 
 
         /*
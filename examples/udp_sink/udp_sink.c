@@ -0,0 +1,100 @@
+/* udp_sink - collect UDP telemetry from many nodes
+ *
+ * Receives the datagrams ds18b20_broadcaster-style nodes send to port
+ * 8005 through extras/udpring, draining them in batches, and prints
+ * once a second how many arrived, from how many senders, how many the
+ * ring had to drop and the largest batch. To try it at rate from a PC:
+ *
+ *     while true; do echo reading | nc -u -w0 <esp8266 address> 8005; done
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "lwip/sys.h"
+#include "udpring/udpring.h"
+
+#include "ssid_config.h"
+
+#define SINK_PORT 8005
+#define MAX_SENDERS 64
+
+static udpring_t ring;
+
+static uint32_t senders[MAX_SENDERS];
+static int sender_count;
+
+static void count_sender(const ip_addr_t *addr)
+{
+    uint32_t a = ip4_addr_get_u32(addr);
+
+    for (int i = 0; i < sender_count; i++) {
+        if (senders[i] == a)
+            return;
+    }
+    if (sender_count < MAX_SENDERS)
+        senders[sender_count++] = a;
+}
+
+void sink_task(void *pvParameters)
+{
+    err_t err = udpring_open(&ring, IP_ADDR_ANY, SINK_PORT, NULL, NULL);
+    if (err != ERR_OK) {
+        printf("Can't bind port %d (%d)\r\n", SINK_PORT, err);
+        vTaskDelete(NULL);
+        return;
+    }
+    printf("Listening on UDP port %d\r\n", SINK_PORT);
+
+    uint32_t packets = 0, bytes = 0, largest = 0;
+    uint32_t last = sys_now();
+    while (1) {
+        udpring_packet_t *pkts;
+        size_t n = udpring_wait(&ring, &pkts, 1000);
+
+        for (size_t i = 0; i < n; i++) {
+            bytes += pkts[i].p->tot_len;
+            count_sender(&pkts[i].addr);
+        }
+        udpring_release(&ring, n);
+        packets += n;
+        if (n > largest)
+            largest = n;
+
+        uint32_t now = sys_now();
+        if (now - last >= 1000) {
+            udpring_stats_t stats;
+            udpring_get_stats(&ring, &stats);
+            printf("%u packets (%u bytes) from %d senders, largest batch %u, "
+                   "%u dropped, ring high water %u\r\n",
+                   packets, bytes, sender_count, largest, stats.dropped, stats.high_water);
+            packets = bytes = largest = 0;
+            sender_count = 0;
+            last = now;
+        }
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    struct sdk_station_config config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+    };
+
+    /* required to call wifi_set_opmode before station_set_config */
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_station_set_config(&config);
+
+    xTaskCreate(sink_task, (signed char *)"sink", 384, NULL, 3, NULL);
+}
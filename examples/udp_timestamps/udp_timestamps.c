@@ -0,0 +1,83 @@
+/* udp_timestamps - Driver level timestamps on a UDP echo.
+ *
+ * Answers each datagram to port 8007 with a line of times in
+ * microseconds: when the driver delivered the request, when the echo
+ * callback got to it, and when the previous answer was handed to the
+ * driver (which is only known once it's been sent, as in PTP's two
+ * step sync). The difference of the first two is the stack and
+ * tcpip_thread scheduling delay interface timestamps leave out.
+ *
+ *     while true; do echo ping | nc -u -w1 <esp8266 address> 8007; done
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "esp/hrtimer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "lwip/udp.h"
+#include "lwip/tcpip.h"
+#include "ethernetif_timestamp.h"
+
+#include "ssid_config.h"
+
+#define ECHO_PORT 8007
+
+static uint64_t last_tx_us;
+
+static void echo_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *addr, u16_t port)
+{
+    uint64_t now_us = hrtimer_now_us64();
+    uint64_t rx_us = 0;
+    char line[80];
+
+    ethernetif_rx_timestamp(p, &rx_us);
+    pbuf_free(p);
+
+    int len = snprintf(line, sizeof(line), "rx %llu app %llu (+%u) prev_tx %llu\n", rx_us, now_us,
+                       (uint32_t)(now_us - rx_us), last_tx_us);
+    struct pbuf *reply = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+    if (reply == NULL)
+        return;
+    memcpy(reply->payload, line, len);
+    if (udp_sendto(pcb, reply, addr, port) == ERR_OK)
+        ethernetif_tx_timestamp(reply, &last_tx_us);
+    pbuf_free(reply);
+    printf("%s", line);
+}
+
+static void echo_start(void *arg)
+{
+    struct udp_pcb *pcb = udp_new();
+
+    if (pcb == NULL || udp_bind(pcb, IP_ADDR_ANY, ECHO_PORT) != ERR_OK) {
+        printf("Can't bind port %d\n", ECHO_PORT);
+        return;
+    }
+    udp_recv(pcb, echo_recv, NULL);
+    printf("Echoing on UDP port %d\n", ECHO_PORT);
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    struct sdk_station_config config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+    };
+
+    /* required to call wifi_set_opmode before station_set_config */
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_station_set_config(&config);
+
+    ethernetif_timestamping(true);
+    tcpip_callback(echo_start, NULL);
+}
@@ -0,0 +1,110 @@
+/* websocket_dashboard - A live status page pushed over a WebSocket.
+ *
+ * Serves a page from IROM at / which opens a WebSocket to /live. Once
+ * a second a task formats the status once and broadcasts it to every
+ * open page. Text typed into the page is sent back and printed on the
+ * serial console. Point a browser at the address printed once the
+ * station has connected to the network in ssid_config.h.
+ *
+ * This sample code is in the public domain.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include <espressif/esp_common.h>
+#include <esp/uart.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "ssid_config.h"
+#include "httpd/httpd.h"
+#include "websocket/ws_server.h"
+
+static const char IROM index_html[] =
+    "<!DOCTYPE html><html><head><title>esp-open-rtos</title></head><body>"
+    "<h1>esp-open-rtos</h1><pre id=\"s\">connecting...</pre>"
+    "<input id=\"m\" placeholder=\"say something\"><script>"
+    "var ws=new WebSocket('ws://'+location.host+'/live');"
+    "ws.onmessage=function(e){document.getElementById('s').textContent=e.data;};"
+    "ws.onclose=function(){document.getElementById('s').textContent='closed';};"
+    "document.getElementById('m').onkeydown=function(e){"
+    "if(e.keyCode==13){ws.send(this.value);this.value='';}};"
+    "</script></body></html>";
+
+static void live_open(ws_conn_t *conn, const char *path, const char *query)
+{
+    printf("viewer connected, %d open\n", ws_connections());
+}
+
+static void live_data(ws_conn_t *conn, uint8_t opcode, uint8_t *data, size_t len,
+                      bool first, bool last)
+{
+    /* Messages arrive a piece at a time, straight out of the pbufs */
+    if (opcode != WS_OP_TEXT)
+        return;
+    if (first)
+        printf("viewer says: ");
+    printf("%.*s", (int)len, (const char *)data);
+    if (last)
+        printf("\n");
+}
+
+static void live_close(ws_conn_t *conn)
+{
+    printf("viewer gone\n");
+}
+
+static const ws_handler_t live = {
+    .on_open = live_open,
+    .on_data = live_data,
+    .on_close = live_close,
+};
+
+static const httpd_route_t routes[] = {
+    { "/", "text/html", NULL, index_html, sizeof(index_html) - 1, NULL },
+    { .path = "/live", .upgrade = ws_upgrade, .data = &live },
+};
+
+static void server_task(void *pvParameters)
+{
+    while (sdk_wifi_station_get_connect_status() != STATION_GOT_IP)
+        vTaskDelay(100 / portTICK_RATE_MS);
+
+    struct ip_info info;
+    sdk_wifi_get_ip_info(STATION_IF, &info);
+    if (!httpd_start(80, routes, sizeof(routes) / sizeof(routes[0]), NULL)) {
+        printf("httpd_start failed\n");
+        vTaskDelete(NULL);
+    }
+    printf("Serving on http://" IPSTR "/\n", IP2STR(&info.ip));
+
+    char status[96];
+    portTickType last_wake = xTaskGetTickCount();
+    while (1) {
+        vTaskDelayUntil(&last_wake, 1000 / portTICK_RATE_MS);
+        int n = snprintf(status, sizeof(status),
+                         "{\"uptime\":%u,\"heap\":%u,\"viewers\":%d}",
+                         xTaskGetTickCount() / configTICK_RATE_HZ,
+                         sdk_system_get_free_heap_size(),
+                         ws_connections());
+        if (ws_connections())
+            ws_broadcast(&live, WS_OP_TEXT, status, n);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    struct sdk_station_config config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+    };
+
+    /* required to call wifi_set_opmode before station_set_config */
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_station_set_config(&config);
+
+    xTaskCreate(server_task, (signed char *)"server", 384, NULL, 2, NULL);
+}
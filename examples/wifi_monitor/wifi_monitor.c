@@ -0,0 +1,63 @@
+/* Print the probe requests heard on channels 1, 6 and 11
+ *
+ * Phones and laptops looking for known networks send probe requests
+ * from time to time, which is what presence counting devices listen
+ * for. Only probe requests are kept in the ring (by the filter), and
+ * the ring is read in batches straight from where they landed.
+ *
+ * This sample code is in the public domain.
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "wifi_monitor/wifi_monitor.h"
+
+#include <stdio.h>
+
+/* 802.11 frame control byte of a probe request: management, subtype 4 */
+#define FC_PROBE_REQUEST 0x40
+
+static const uint8_t channels[] = { 1, 6, 11 };
+
+static bool probe_requests_only(const wifi_monitor_frame_t *frame)
+{
+    return frame->captured >= 24 && frame->data[0] == FC_PROBE_REQUEST;
+}
+
+static void monitor_task(void *pvParameters)
+{
+    wifi_monitor_stats_t stats;
+    uint32_t last_report = xTaskGetTickCount();
+
+    wifi_monitor_start(probe_requests_only, channels[0]);
+    wifi_monitor_hop(channels, sizeof(channels), 200);
+
+    for (;;) {
+        const wifi_monitor_frame_t *frames;
+        size_t n = wifi_monitor_wait(&frames, 1000);
+
+        for (size_t i = 0; i < n; i++) {
+            /* Transmitter address (addr2) follows frame control, duration and addr1 */
+            const uint8_t *sa = &frames[i].data[10];
+            printf("ch %2d %4d dBm %02x:%02x:%02x:%02x:%02x:%02x\n", frames[i].channel, frames[i].rssi,
+                   sa[0], sa[1], sa[2], sa[3], sa[4], sa[5]);
+        }
+        wifi_monitor_release(n);
+
+        if (xTaskGetTickCount() - last_report >= 10000 / portTICK_RATE_MS) {
+            last_report = xTaskGetTickCount();
+            wifi_monitor_get_stats(&stats);
+            printf("%u received, %u dropped\n", stats.received, stats.dropped);
+        }
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    xTaskCreate(monitor_task, (signed char *)"monitor", 512, NULL, 2, NULL);
+}
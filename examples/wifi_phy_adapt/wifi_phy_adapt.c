@@ -0,0 +1,62 @@
+/* wifi_phy_adapt - Cap the TX power and adapt the PHY mode to the link.
+ *
+ * Caps the TX power at TX_POWER_QDBM (from the next restart: the board
+ * restarts once if the cap had to be written), then connects to
+ * WIFI_SSID with the adaptive PHY mode policy running, and prints the
+ * delivery statistics every 30 seconds. Move the board out to the edge
+ * of the AP's range to see it step down to 802.11g and b, and back.
+ *
+ * This sample code is in the public domain.
+ */
+#include <stdio.h>
+
+#include <espressif/esp_common.h>
+#include <esp/uart.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "ssid_config.h"
+#include "wifi_phy/wifi_phy.h"
+
+/* 14 dBm, plenty for an AP in the same room */
+#define TX_POWER_QDBM 56
+
+static void report_task(void *pvParameters)
+{
+    wifi_phy_adapt_config_t config = WIFI_PHY_ADAPT_DEFAULT_CONFIG;
+    wifi_phy_adapt_start(&config);
+
+    while (1) {
+        vTaskDelay(30000 / portTICK_RATE_MS);
+
+        wifi_phy_stats_t stats;
+        wifi_phy_get_stats(&stats);
+        printf("802.11%c: %u frames, %u errors, %u drops, %u/%u TCP retransmits, "
+               "%u%% failed last interval, %u mode changes\n",
+               " bgn"[sdk_wifi_get_phy_mode()], stats.frames, stats.errors, stats.drops,
+               stats.tcp_retransmits, stats.tcp_segments, stats.fail_percent, stats.mode_changes);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    if (wifi_phy_get_max_tx_power() > TX_POWER_QDBM) {
+        printf("Capping TX power at %d.%02d dBm, restarting\n", TX_POWER_QDBM / 4, TX_POWER_QDBM % 4 * 25);
+        if (wifi_phy_set_max_tx_power(TX_POWER_QDBM))
+            sdk_system_restart();
+    }
+
+    struct sdk_station_config config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+    };
+
+    /* required to call wifi_set_opmode before station_set_config */
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_station_set_config(&config);
+
+    xTaskCreate(report_task, (signed char *)"report", 384, NULL, 2, NULL);
+}
@@ -0,0 +1,62 @@
+/* wifi_roaming - Stay on the best AP of a multi-AP network.
+ *
+ * Connects to WIFI_SSID and starts extras/roam, then prints the
+ * current AP and the candidates it has seen every 30 seconds. Walk
+ * the board from one AP to another and watch it move across before
+ * the first link gives out.
+ *
+ * This sample code is in the public domain.
+ */
+#include <stdio.h>
+
+#include <espressif/esp_common.h>
+#include <esp/uart.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "ssid_config.h"
+#include "roam/roam.h"
+
+#define MAC_FMT "%02x:%02x:%02x:%02x:%02x:%02x"
+#define MAC_ARGS(m) (m)[0], (m)[1], (m)[2], (m)[3], (m)[4], (m)[5]
+
+static void report_task(void *pvParameters)
+{
+    while (sdk_wifi_station_get_connect_status() != STATION_GOT_IP)
+        vTaskDelay(100 / portTICK_RATE_MS);
+    roam_start();
+
+    while (1) {
+        vTaskDelay(30000 / portTICK_RATE_MS);
+
+        roam_status_t status;
+        roam_candidate_t candidates[8];
+        roam_get_status(&status);
+        int n = roam_get_candidates(candidates, 8);
+
+        if (status.known)
+            printf("AP " MAC_FMT " channel %d, %d dBm\n", MAC_ARGS(status.bssid), status.channel, status.rssi);
+        printf("%u roams (%u failed), %u scans, %u sweeps, %u failures last check\n",
+               status.roams, status.failed_roams, status.scans, status.sweeps, status.tx_failures);
+        for (int i = 0; i < n; i++)
+            printf("  " MAC_FMT " channel %2d %4d dBm, %u s ago\n", MAC_ARGS(candidates[i].bssid),
+                   candidates[i].channel, candidates[i].rssi, candidates[i].age_ms / 1000);
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    printf("SDK version:%s\n", sdk_system_get_sdk_version());
+
+    struct sdk_station_config config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+    };
+
+    /* required to call wifi_set_opmode before station_set_config */
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_station_set_config(&config);
+
+    xTaskCreate(report_task, (signed char *)"report", 384, NULL, 2, NULL);
+}
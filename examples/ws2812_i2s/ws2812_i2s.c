@@ -0,0 +1,66 @@
+/**
+ * @file   ws2812_i2s.c
+ *
+ * @brief  Example of a rainbow effect with WS2812 connected to GPIO3
+ *         (UART0 RX), driven by I2S DMA.
+ *
+ * Frames are rendered while the previous one is still being sent, the
+ * CPU isn't involved in the output at all.
+ *
+ * This demo is in the public domain.
+ */
+
+#include "espressif/esp_common.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "esp/uart.h" // uart_set_baud
+#include <stdio.h> // printf
+#include <stdint.h>
+
+#include "ws2812_i2s.h"
+
+
+#define delay_ms(ms) vTaskDelay((ms) / portTICK_RATE_MS)
+
+#define PIXEL_COUNT 60
+
+
+/** Position on a 0..767 color wheel to 0x00RRGGBB */
+static uint32_t wheel(uint16_t pos)
+{
+    uint8_t x = pos & 0xff;
+
+    if (pos < 256) return ((uint32_t)(255 - x) << 16) | ((uint32_t)x << 8);
+    if (pos < 512) return ((uint32_t)(255 - x) << 8) | x;
+    return ((uint32_t)x << 16) | (255 - x);
+}
+
+
+void demo(void *pvParameters)
+{
+    static uint32_t pixels[PIXEL_COUNT];
+    uint16_t offset = 0;
+
+    if (!ws2812_i2s_init(PIXEL_COUNT)) {
+        printf("Not enough memory for %d pixels\n", PIXEL_COUNT);
+        vTaskDelete(NULL);
+    }
+
+    while (1) {
+        for (int i = 0; i < PIXEL_COUNT; i++) {
+            pixels[i] = wheel((offset + i * 768 / PIXEL_COUNT) % 768);
+        }
+        ws2812_i2s_update(pixels, PIXEL_COUNT);
+
+        offset = (offset + 8) % 768;
+        delay_ms(20);
+    }
+}
+
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+
+    xTaskCreate(&demo, (signed char *)"ws2812 i2s", 256, NULL, 2, NULL);
+}
@@ -0,0 +1,112 @@
+/* Continuous ADC sampling, see adc_stream.h
+ *
+ * The two blocks are filled strictly in turn, so block n of the stream
+ * is blocks[n & 1] and three counters say where everything is: the
+ * interrupt has filled 'filled' blocks, the reader has taken 'taken' of
+ * them and given 'released' back. The interrupt may only fill a block
+ * while fewer than two are out (filled - released < 2). Each counter
+ * has one writer, so neither side needs a critical section.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "adc_stream.h"
+
+#include <stddef.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <common_macros.h>
+#include <esp8266.h>
+#include <esp/perf.h>
+#include <espressif/esp_system.h>
+
+static uint16_t blocks[2][ADC_STREAM_BLOCK];
+static volatile uint32_t filled, taken, released;
+static size_t pos;
+
+static uint8_t average;
+static uint8_t readings;
+static uint32_t sum;
+
+static xTaskHandle reader;
+static adc_stream_stats_t stats;
+
+static void IRAM frc1_interrupt_handler(void)
+{
+    uint32_t start = perf_ccount();
+
+    sum += sdk_system_adc_read();
+    if (++readings == average) {
+        uint32_t f = filled;
+        if (f - released >= 2) {
+            stats.dropped++;
+        } else {
+            blocks[f & 1][pos] = sum / average;
+            if (++pos == ADC_STREAM_BLOCK) {
+                portBASE_TYPE woken = pdFALSE;
+                pos = 0;
+                filled = f + 1;
+                stats.blocks++;
+                vTaskNotifyGiveFromISR(reader, &woken);
+                if (woken)
+                    portYIELD();
+            }
+        }
+        sum = 0;
+        readings = 0;
+    }
+
+    uint32_t cycles = perf_ccount() - start;
+    if (cycles > stats.isr_cycles_max)
+        stats.isr_cycles_max = cycles;
+}
+
+bool adc_stream_start(uint32_t rate_hz, uint8_t avg)
+{
+    adc_stream_stop();
+
+    if (!avg)
+        avg = 1;
+    average = avg;
+    readings = 0;
+    sum = 0;
+    pos = 0;
+    filled = taken = released = 0;
+    stats = (adc_stream_stats_t){ 0 };
+    reader = xTaskGetCurrentTaskHandle();
+    /* Drop a notification left from before */
+    ulTaskNotifyTake(pdTRUE, 0);
+
+    _xt_isr_attach(INUM_TIMER_FRC1, frc1_interrupt_handler);
+    if (timer_set_frequency(FRC1, rate_hz * avg))
+        return false;
+    timer_set_interrupts(FRC1, true);
+    timer_set_run(FRC1, true);
+    return true;
+}
+
+void adc_stream_stop(void)
+{
+    timer_set_interrupts(FRC1, false);
+    timer_set_run(FRC1, false);
+}
+
+const uint16_t *adc_stream_read(uint32_t timeout_ticks)
+{
+    /* The block from the last call is done with */
+    released = taken;
+
+    /* A notification can be left over from a block already taken, so
+       this may go round once more */
+    while (filled == taken) {
+        if (!ulTaskNotifyTake(pdTRUE, timeout_ticks))
+            return NULL;
+    }
+    return blocks[taken++ & 1];
+}
+
+void adc_stream_stats(adc_stream_stats_t *out)
+{
+    *out = stats;
+}
@@ -0,0 +1,76 @@
+/* Continuous ADC sampling at a fixed rate, into double buffered blocks
+ *
+ * The FRC1 timer interrupt reads the ADC at 'rate_hz' times 'average',
+ * averages each 'average' readings into one sample, and writes the
+ * samples into one of two blocks of ADC_STREAM_BLOCK. A full block is
+ * handed to the reading task (its task notification wakes it) while the
+ * interrupt goes on filling the other, so the reader has a whole block
+ * time to deal with one:
+ *
+ *     adc_stream_start(4000, 4);
+ *     for (;;) {
+ *         const uint16_t *block = adc_stream_read(portMAX_DELAY);
+ *         for (int i = 0; i < ADC_STREAM_BLOCK; i++)
+ *             rms_add(block[i]);
+ *     }
+ *
+ * The sample clock is the timer, not the scheduler, so the interval
+ * between samples is steady whatever the tasks are doing (give or take
+ * the interrupt's latency, see latency_bench). If the reader still
+ * holds the other block when one fills, the samples that follow are
+ * dropped (and counted) until it's done with it.
+ *
+ * Each reading is the SDK's sdk_system_adc_read(), called from the
+ * interrupt, and it's the SDK's conversion and calibration rather than
+ * a quick register read, so the reading rate (rate_hz * average) is
+ * what costs CPU. adc_stream_stats() reports the longest the interrupt
+ * took: at 80 MHz a 10 kHz reading rate leaves 8000 cycles a reading
+ * for everything, interrupt included.
+ *
+ * FRC1 is also what extras/pwm uses, so they can't run together.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _ADC_STREAM_H
+#define _ADC_STREAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/* Samples per block */
+#ifndef ADC_STREAM_BLOCK
+#define ADC_STREAM_BLOCK 256
+#endif
+
+typedef struct {
+    uint32_t blocks;            /* filled and handed to the reader */
+    uint32_t dropped;           /* samples lost with both blocks held */
+    uint32_t isr_cycles_max;    /* longest interrupt, in CPU cycles */
+} adc_stream_stats_t;
+
+/* Start sampling: 'rate_hz' samples a second, each the average of
+   'average' readings (1 for none). The calling task becomes the reader.
+   Returns false if the rate can't be set. */
+bool adc_stream_start(uint32_t rate_hz, uint8_t average);
+
+/* Stop sampling. A partly filled block is thrown away. */
+void adc_stream_stop(void);
+
+/* In the reader: give back the last block read and wait up to
+   'timeout_ticks' for the next one. Returns its ADC_STREAM_BLOCK
+   samples (0-1023), valid until the next call, or NULL on timeout. */
+const uint16_t *adc_stream_read(uint32_t timeout_ticks);
+
+void adc_stream_stats(adc_stream_stats_t *stats);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _ADC_STREAM_H */
@@ -0,0 +1,9 @@
+# Component makefile for extras/adc_stream
+
+# expected anyone using adc_stream includes it as 'adc_stream/adc_stream.h'
+INC_DIRS += $(adc_stream_ROOT)..
+
+# args for passing into compile rule generation
+adc_stream_SRC_DIR =  $(adc_stream_ROOT)
+
+$(eval $(call component_compile_rules,adc_stream))
@@ -0,0 +1,257 @@
+/* Fast station reconnect from a cache of recently seen APs, see apcache.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "apcache.h"
+
+#include <string.h>
+#include <stddef.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+
+#include "espressif/esp_common.h"
+#include "esp/rtcmem_regs.h"
+#include "crc.h"
+
+#define CACHE_MAGIC 0x41504331 /* "APC1" */
+
+/* extras/fastconnect keeps its state in the last 12 words */
+#define FASTCONNECT_WORDS 12
+
+/* Start of the cache in RTCMEM_USER */
+#define RTC_OFFSET (sizeof(RTCMEM_USER) / sizeof(uint32_t) - FASTCONNECT_WORDS - APCACHE_RTC_WORDS)
+
+typedef struct {
+    uint32_t ssid_hash;
+    apcache_entry_t ap;     /* channel 0 for an unused slot */
+} slot_t;
+
+typedef struct {
+    uint32_t magic;
+    slot_t slots[APCACHE_ENTRIES];
+    uint32_t crc;
+} cache_t;
+
+_Static_assert(sizeof(cache_t) == APCACHE_RTC_WORDS * sizeof(uint32_t),
+               "cache_t doesn't match APCACHE_RTC_WORDS");
+
+static cache_t cache;
+static bool have_config;
+static struct sdk_station_config config;
+
+static uint32_t ssid_hash(const uint8_t *ssid)
+{
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < sizeof(config.ssid) && ssid[i]; i++) {
+        hash ^= ssid[i];
+        hash *= 16777619;
+    }
+    return hash;
+}
+
+static uint32_t ms_since(portTickType tick)
+{
+    return (xTaskGetTickCount() - tick) * portTICK_RATE_MS;
+}
+
+/* RTC memory only supports word accesses */
+static void load_cache(void)
+{
+    uint32_t *words = (uint32_t *)&cache;
+
+    for (int i = 0; i < APCACHE_RTC_WORDS; i++)
+        words[i] = RTCMEM_USER[RTC_OFFSET + i];
+    if (cache.magic != CACHE_MAGIC
+        || cache.crc != crc32_ieee(0, &cache, offsetof(cache_t, crc)))
+        memset(&cache, 0, sizeof(cache));
+}
+
+static void store_cache(void)
+{
+    const uint32_t *words = (const uint32_t *)&cache;
+
+    cache.magic = CACHE_MAGIC;
+    cache.crc = crc32_ieee(0, &cache, offsetof(cache_t, crc));
+    for (int i = 0; i < APCACHE_RTC_WORDS; i++)
+        RTCMEM_USER[RTC_OFFSET + i] = words[i];
+}
+
+void apcache_clear(void)
+{
+    memset(&cache, 0, sizeof(cache));
+    store_cache();
+}
+
+static void remove_slot(int i)
+{
+    memmove(&cache.slots[i], &cache.slots[i + 1], (APCACHE_ENTRIES - 1 - i) * sizeof(slot_t));
+    memset(&cache.slots[APCACHE_ENTRIES - 1], 0, sizeof(slot_t));
+}
+
+/* Put an AP first, replacing any slot for it and dropping the last one */
+static void insert_first(uint32_t hash, const uint8_t bssid[6], uint8_t channel, int8_t rssi)
+{
+    for (int i = 0; i < APCACHE_ENTRIES; i++) {
+        if (cache.slots[i].ap.channel && cache.slots[i].ssid_hash == hash
+            && !memcmp(cache.slots[i].ap.bssid, bssid, 6)) {
+            remove_slot(i);
+            break;
+        }
+    }
+    memmove(&cache.slots[1], &cache.slots[0], (APCACHE_ENTRIES - 1) * sizeof(slot_t));
+    cache.slots[0].ssid_hash = hash;
+    memcpy(cache.slots[0].ap.bssid, bssid, 6);
+    cache.slots[0].ap.channel = channel;
+    cache.slots[0].ap.rssi = rssi;
+}
+
+int apcache_get(const char *ssid, apcache_entry_t *entries, int max)
+{
+    uint32_t hash = ssid_hash((const uint8_t *)ssid);
+    int n = 0;
+
+    load_cache();
+    for (int i = 0; i < APCACHE_ENTRIES && n < max; i++) {
+        if (cache.slots[i].ap.channel && cache.slots[i].ssid_hash == hash)
+            entries[n++] = cache.slots[i].ap;
+    }
+    return n;
+}
+
+/* Wait for an address, giving up early if the SDK reports the attempt failed */
+static bool wait_got_ip(portTickType start, uint32_t timeout_ms)
+{
+    for (;;) {
+        switch (sdk_wifi_station_get_connect_status()) {
+        case STATION_GOT_IP:
+            return true;
+        case STATION_WRONG_PASSWORD:
+        case STATION_NO_AP_FOUND:
+        case STATION_CONNECT_FAIL:
+            return false;
+        default:
+            break;
+        }
+        if (ms_since(start) >= timeout_ms)
+            return false;
+        vTaskDelay(10 / portTICK_RATE_MS);
+    }
+}
+
+static xSemaphoreHandle scan_done;
+static apcache_entry_t scan_aps[APCACHE_ENTRIES];
+static int scan_count;
+
+/* Keep the strongest APCACHE_ENTRIES BSSIDs of the SSID, strongest first */
+static void scan_cb(void *arg, sdk_scan_status_t status)
+{
+    struct sdk_bss_info *bss;
+
+    scan_count = 0;
+    if (status == SCAN_OK) {
+        for (bss = arg; bss; bss = STAILQ_NEXT(bss, next)) {
+            if (memcmp(bss->ssid, config.ssid, sizeof(bss->ssid)))
+                continue;
+            int i = scan_count < APCACHE_ENTRIES ? scan_count++ : APCACHE_ENTRIES;
+            for (; i > 0 && scan_aps[i - 1].rssi < bss->rssi; i--) {
+                if (i < APCACHE_ENTRIES)
+                    scan_aps[i] = scan_aps[i - 1];
+            }
+            if (i < APCACHE_ENTRIES) {
+                memcpy(scan_aps[i].bssid, bss->bssid, 6);
+                scan_aps[i].channel = bss->channel;
+                scan_aps[i].rssi = bss->rssi;
+            }
+        }
+    }
+    xSemaphoreGive(scan_done);
+}
+
+/* After a normal connect, learn the network's BSSIDs on the current channel */
+static void learn_channel(uint32_t hash)
+{
+    struct sdk_scan_config scan = {
+        .ssid = config.ssid,
+        .channel = sdk_wifi_get_channel(),
+    };
+
+    if (!scan_done) {
+        vSemaphoreCreateBinary(scan_done);
+        if (!scan_done)
+            return;
+    }
+    xSemaphoreTake(scan_done, 0);
+    if (!sdk_wifi_station_scan(&scan, scan_cb))
+        return;
+    xSemaphoreTake(scan_done, portMAX_DELAY);
+
+    /* Weakest first, so the strongest ends up first */
+    for (int i = scan_count - 1; i >= 0; i--)
+        insert_first(hash, scan_aps[i].bssid, scan_aps[i].channel, scan_aps[i].rssi);
+    if (scan_count)
+        store_cache();
+}
+
+static bool connect(uint32_t timeout_ms)
+{
+    portTickType start = xTaskGetTickCount();
+    uint32_t hash = ssid_hash(config.ssid);
+
+    sdk_wifi_station_disconnect();
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_station_dhcpc_start();
+    load_cache();
+
+    /* The cache is reordered on success, so work from a copy */
+    slot_t slots[APCACHE_ENTRIES];
+    memcpy(slots, cache.slots, sizeof(slots));
+
+    for (int i = 0; i < APCACHE_ENTRIES && ms_since(start) < timeout_ms; i++) {
+        if (!slots[i].ap.channel || slots[i].ssid_hash != hash)
+            continue;
+
+        config.bssid_set = 1;
+        memcpy(config.bssid, slots[i].ap.bssid, sizeof(config.bssid));
+        sdk_wifi_station_set_config(&config);
+        sdk_wifi_set_channel(slots[i].ap.channel);
+        sdk_wifi_station_connect();
+
+        uint32_t left = timeout_ms - ms_since(start);
+        if (wait_got_ip(xTaskGetTickCount(),
+                        left < APCACHE_DIRECTED_TIMEOUT_MS ? left : APCACHE_DIRECTED_TIMEOUT_MS)) {
+            insert_first(hash, slots[i].ap.bssid, slots[i].ap.channel, slots[i].ap.rssi);
+            store_cache();
+            return true;
+        }
+        sdk_wifi_station_disconnect();
+    }
+
+    config.bssid_set = 0;
+    sdk_wifi_station_set_config(&config);
+    sdk_wifi_station_connect();
+    if (!wait_got_ip(start, timeout_ms))
+        return false;
+    learn_channel(hash);
+    return true;
+}
+
+bool apcache_connect(const char *ssid, const char *password, uint32_t timeout_ms)
+{
+    memset(&config, 0, sizeof(config));
+    strncpy((char *)config.ssid, ssid, sizeof(config.ssid));
+    strncpy((char *)config.password, password, sizeof(config.password));
+    have_config = true;
+    return connect(timeout_ms);
+}
+
+bool apcache_reconnect(uint32_t timeout_ms)
+{
+    if (!have_config)
+        return false;
+    return connect(timeout_ms);
+}
@@ -0,0 +1,80 @@
+/* Fast station reconnect from a cache of recently seen APs
+ *
+ * When the station loses its AP (say the AP reboots), the SDK's
+ * reconnect scans every channel before trying to associate again, which
+ * takes a few seconds. apcache keeps the last APCACHE_ENTRIES (SSID,
+ * BSSID, channel, RSSI) tuples the station connected to or saw for its
+ * network in RTC memory (which survives resets and deep sleep, but not
+ * a power cycle), and apcache_connect() first tries a directed connect
+ * to each of them on its channel, most recently used first, before
+ * falling back to a normal all channel connect.
+ *
+ * After a normal connect the current channel is scanned once for the
+ * network's SSID, which takes around 100 ms, so all of its BSSIDs on
+ * that channel (several for a mesh or an AP with multiple radios) are
+ * known for the next time.
+ *
+ * The cache takes APCACHE_RTC_WORDS words of RTCMEM_USER, just below
+ * the words used by extras/fastconnect, so both can be used together.
+ * It's protected by a CRC and is discarded if that doesn't match.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _APCACHE_H
+#define _APCACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/* Number of cached APs, 3 words of RTC memory each */
+#ifndef APCACHE_ENTRIES
+#define APCACHE_ENTRIES 4
+#endif
+
+/* Words of RTCMEM_USER used, below the last FASTCONNECT_RTC_WORDS (12) */
+#define APCACHE_RTC_WORDS (2 + 3 * APCACHE_ENTRIES)
+
+/* How long each directed connect gets, association and DHCP included */
+#ifndef APCACHE_DIRECTED_TIMEOUT_MS
+#define APCACHE_DIRECTED_TIMEOUT_MS 1500
+#endif
+
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t channel;
+    int8_t rssi;        /* when last seen, in dBm */
+} apcache_entry_t;
+
+/* Connect to an AP as a station, waiting up to timeout_ms for it to get
+   an address. Returns true once connected.
+
+   Tries the cached APs of this SSID first, then a normal connect in the
+   time remaining. Call instead of sdk_wifi_station_set_config()/connect().
+   Station mode is selected here.
+*/
+bool apcache_connect(const char *ssid, const char *password, uint32_t timeout_ms);
+
+/* Connect again to the network of the last apcache_connect(), for when
+   the station has lost its AP. Returns false if apcache_connect() was
+   never called.
+*/
+bool apcache_reconnect(uint32_t timeout_ms);
+
+/* Copy up to 'max' cached APs for the SSID into 'entries', most recently
+   used first. Returns how many were copied. */
+int apcache_get(const char *ssid, apcache_entry_t *entries, int max);
+
+/* Forget all cached APs */
+void apcache_clear(void);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _APCACHE_H */
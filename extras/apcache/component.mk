@@ -0,0 +1,9 @@
+# Component makefile for extras/apcache
+
+# expected anyone using apcache includes it as 'apcache/apcache.h'
+INC_DIRS += $(apcache_ROOT)..
+
+# args for passing into compile rule generation
+apcache_SRC_DIR =  $(apcache_ROOT)
+
+$(eval $(call component_compile_rules,apcache))
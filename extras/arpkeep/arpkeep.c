@@ -0,0 +1,166 @@
+/* Static ARP entries and a background gateway ARP refresh, see arpkeep.h
+ *
+ * lwIP's ARP table and netif list may only be touched from tcpip_thread,
+ * so the refresh timer runs there and the entry points hand their work
+ * over to it.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "arpkeep.h"
+
+#include <string.h>
+#include <stdbool.h>
+
+#include <lwip/netif.h>
+#include <lwip/tcpip.h>
+#include <lwip/timers.h>
+#include <lwip/sys.h>
+#include <netif/etharp.h>
+
+#include "sdk_internal.h"
+
+typedef struct {
+    sys_sem_t done;
+    ip_addr_t ip;
+    struct eth_addr mac;
+    err_t err;
+} tcpip_call_t;
+
+static bool running;
+
+/* Run fn(call) in tcpip_thread and wait for it to finish */
+static err_t run_in_tcpip(tcpip_callback_fn fn, tcpip_call_t *call)
+{
+    if (sys_sem_new(&call->done, 0) != ERR_OK)
+        return ERR_MEM;
+    err_t err = tcpip_callback(fn, call);
+    if (err == ERR_OK) {
+        sys_sem_wait(&call->done);
+        err = call->err;
+    }
+    sys_sem_free(&call->done);
+    return err;
+}
+
+/* The interface's gateway, if it has one that isn't the interface itself
+   (as on the softAP) */
+static bool has_gateway(struct netif *netif)
+{
+    return netif_is_up(netif) && (netif->flags & NETIF_FLAG_ETHARP) &&
+        !ip_addr_isany(&netif->gw) && !ip_addr_cmp(&netif->gw, &netif->ip_addr);
+}
+
+static void refresh_tick(void *arg)
+{
+    int gateways = 0, resolved = 0;
+
+    for (struct netif *netif = netif_list; netif; netif = netif->next) {
+        if (!has_gateway(netif))
+            continue;
+        struct eth_addr *mac;
+        ip_addr_t *ip;
+        gateways++;
+        if (etharp_find_addr(netif, &netif->gw, &mac, &ip) >= 0)
+            resolved++;
+        etharp_request(netif, &netif->gw);
+    }
+    /* Not connected yet counts as unresolved, to catch the gateway as
+       soon as there is one */
+    bool settled = gateways && resolved == gateways;
+    sys_timeout(settled ? ARPKEEP_REFRESH_S * 1000 : ARPKEEP_RETRY_MS, refresh_tick, NULL);
+}
+
+static void start_cb(void *arg)
+{
+    tcpip_call_t *call = arg;
+
+    if (running)
+        sys_untimeout(refresh_tick, NULL);
+    running = true;
+    refresh_tick(NULL);
+    call->err = ERR_OK;
+    sys_sem_signal(&call->done);
+}
+
+static void stop_cb(void *arg)
+{
+    tcpip_call_t *call = arg;
+
+    if (running)
+        sys_untimeout(refresh_tick, NULL);
+    running = false;
+    call->err = ERR_OK;
+    sys_sem_signal(&call->done);
+}
+
+void arpkeep_start(void)
+{
+    tcpip_call_t call;
+    run_in_tcpip(start_cb, &call);
+}
+
+void arpkeep_stop(void)
+{
+    tcpip_call_t call;
+    run_in_tcpip(stop_cb, &call);
+}
+
+static void add_static_cb(void *arg)
+{
+    tcpip_call_t *call = arg;
+
+    call->err = etharp_add_static_entry(&call->ip, &call->mac);
+    sys_sem_signal(&call->done);
+}
+
+static void remove_static_cb(void *arg)
+{
+    tcpip_call_t *call = arg;
+
+    call->err = etharp_remove_static_entry(&call->ip);
+    sys_sem_signal(&call->done);
+}
+
+static void pin_gateway_cb(void *arg)
+{
+    tcpip_call_t *call = arg;
+    struct netif *netif = sdk_g_ic.v.station_netif_info ? sdk_g_ic.v.station_netif_info->netif : NULL;
+    struct eth_addr *mac;
+    ip_addr_t *ip;
+
+    if (!netif || !has_gateway(netif)) {
+        call->err = ERR_IF;
+    } else if (etharp_find_addr(netif, &netif->gw, &mac, &ip) < 0) {
+        call->err = ERR_VAL;
+    } else {
+        call->mac = *mac;
+        ip_addr_copy(call->ip, netif->gw);
+        call->err = etharp_add_static_entry(&call->ip, &call->mac);
+    }
+    sys_sem_signal(&call->done);
+}
+
+err_t arpkeep_add_static(const ip_addr_t *ip, const uint8_t mac[6])
+{
+    tcpip_call_t call;
+
+    ip_addr_copy(call.ip, *ip);
+    memcpy(call.mac.addr, mac, sizeof(call.mac.addr));
+    return run_in_tcpip(add_static_cb, &call);
+}
+
+err_t arpkeep_remove_static(const ip_addr_t *ip)
+{
+    tcpip_call_t call;
+
+    ip_addr_copy(call.ip, *ip);
+    return run_in_tcpip(remove_static_cb, &call);
+}
+
+err_t arpkeep_pin_gateway(void)
+{
+    tcpip_call_t call;
+    return run_in_tcpip(pin_gateway_cb, &call);
+}
@@ -0,0 +1,73 @@
+/* Static ARP entries and a background gateway ARP refresh
+ *
+ * lwIP forgets an ARP entry 20 minutes after it was last confirmed, and
+ * only asks again before that if the entry is used in its last minute.
+ * A device sending a reading every few minutes is likely to find the
+ * gateway's entry gone, and that packet is then queued (ARP_QUEUEING)
+ * while the gateway is ARPed again, a round trip or more of latency.
+ *
+ * arpkeep_start() runs a timer in tcpip_thread that ARPs the gateway of
+ * every interface that's up every ARPKEEP_REFRESH_S seconds. The reply
+ * resets the entry's age, so it never expires. While a gateway isn't
+ * in the table yet (just after connecting, or if it didn't answer) it's
+ * asked again every ARPKEEP_RETRY_MS, so the entry is normally there
+ * before the first packet needs it.
+ *
+ * Static entries (lwIP's ETHARP_SUPPORT_STATIC_ENTRIES) never expire and
+ * aren't replaced when the table is full, for hosts whose MAC address
+ * is known and fixed. arpkeep_pin_gateway() makes the gateway's
+ * resolved address static. A static entry also means nobody on the
+ * network can redirect the traffic with forged ARP replies, and that if
+ * the host's MAC changes nothing reaches it until the entry is removed.
+ * Each static entry takes one of the ARP_TABLE_SIZE slots.
+ *
+ * The functions below block the calling task until tcpip_thread has
+ * done the work, and can't be called from tcpip_thread itself.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _ARPKEEP_H
+#define _ARPKEEP_H
+
+#include <stdint.h>
+#include <lwip/ip_addr.h>
+#include <lwip/err.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/* ARP the gateways this often. Well inside lwIP's 20 minute expiry, so
+   a lost request or two doesn't matter. */
+#ifndef ARPKEEP_REFRESH_S
+#define ARPKEEP_REFRESH_S 300
+#endif
+
+/* and this often while a gateway isn't resolved */
+#ifndef ARPKEEP_RETRY_MS
+#define ARPKEEP_RETRY_MS 2000
+#endif
+
+/* Start (or restart) the refresh, the first requests go out at once */
+void arpkeep_start(void);
+
+void arpkeep_stop(void);
+
+/* Add a permanent entry for 'ip', which has to be on the subnet of an
+   interface that's up. ERR_MEM if the table is full of static entries. */
+err_t arpkeep_add_static(const ip_addr_t *ip, const uint8_t mac[6]);
+
+/* Remove a static entry, ERR_VAL if there wasn't one */
+err_t arpkeep_remove_static(const ip_addr_t *ip);
+
+/* Make the station gateway's entry static, as it's resolved now.
+   ERR_IF if the station has no gateway, ERR_VAL if it isn't resolved. */
+err_t arpkeep_pin_gateway(void);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _ARPKEEP_H */
@@ -0,0 +1,9 @@
+# Component makefile for extras/arpkeep
+
+# expected anyone using arpkeep includes it as 'arpkeep/arpkeep.h'
+INC_DIRS += $(arpkeep_ROOT)..
+
+# args for passing into compile rule generation
+arpkeep_SRC_DIR =  $(arpkeep_ROOT)
+
+$(eval $(call component_compile_rules,arpkeep))
@@ -0,0 +1,150 @@
+/* Binary deferred logging, see binlog.h
+ *
+ * The ring is written with interrupts disabled, so by any number of
+ * tasks and interrupt handlers, and read by one task: a record is
+ * complete once 'head' has moved past it, and its words are free only
+ * once 'tail' has.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "binlog.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <esp/interrupts.h>
+#include <esp/wdev_regs.h>
+#include <lwip/sys.h>
+
+#if BINLOG_RING_WORDS & (BINLOG_RING_WORDS - 1)
+#error BINLOG_RING_WORDS must be a power of two
+#endif
+
+#define MASK (BINLOG_RING_WORDS - 1)
+#define NARGS_MASK 7
+
+static uint32_t ring[BINLOG_RING_WORDS];
+static volatile uint32_t head, tail;
+static volatile uint32_t dropped;
+
+static binlog_output_t output;
+
+void IRAM binlog_write(uint32_t site, const uint32_t *args)
+{
+    uint32_t n = site & NARGS_MASK;
+    uint32_t stamp = WDEV.SYS_TIME;
+    uint32_t level = _xt_disable_interrupts();
+    uint32_t h = head;
+
+    if (BINLOG_RING_WORDS - (h - tail) < n + 2) {
+        dropped++;
+    } else {
+        ring[h & MASK] = site;
+        ring[(h + 1) & MASK] = stamp;
+        for (uint32_t i = 0; i < n; i++)
+            ring[(h + 2 + i) & MASK] = args[i];
+        head = h + 2 + n;
+    }
+    _xt_restore_interrupts(level);
+}
+
+bool binlog_read(binlog_record_t *rec)
+{
+    uint32_t t = tail;
+
+    if (t == head)
+        return false;
+    uint32_t site = ring[t & MASK];
+    uint32_t stamp = ring[(t + 1) & MASK];
+    rec->nargs = site & NARGS_MASK;
+    rec->site = (const char *)(uintptr_t)(site & ~NARGS_MASK);
+    for (int i = 0; i < rec->nargs; i++)
+        rec->args[i] = ring[(t + 2 + i) & MASK];
+    /* Read before they're handed back to the writers */
+    __asm__ volatile ("" ::: "memory");
+    tail = t + 2 + rec->nargs;
+
+    /* IROM only takes word loads, the level digit is the first byte */
+    rec->level = (*(const uint32_t *)rec->site & 0xff) - '0';
+
+    /* Its age on the 32 bit clock, which wraps every ~71 minutes */
+    uint64_t now = sys_uptime_us();
+    rec->time_us = now - (uint32_t)((uint32_t)now - stamp);
+    return true;
+}
+
+int binlog_format(const binlog_record_t *rec, char *buf, size_t size)
+{
+    uint32_t fmt[BINLOG_FORMAT_MAX / 4];
+    const uint32_t *src = (const uint32_t *)rec->site;
+    const uint32_t *a = rec->args;
+
+    /* Copied out of IROM a word at a time, up to the word with the 0 */
+    for (size_t i = 0; i < sizeof(fmt) / 4; i++) {
+        uint32_t w = src[i];
+        fmt[i] = w;
+        if (!(w & 0xff) || !(w & 0xff00) || !(w & 0xff0000) || !(w & 0xff000000))
+            break;
+    }
+    ((char *)fmt)[sizeof(fmt) - 1] = 0;
+
+    /* Arguments past the format's are ignored */
+    return snprintf(buf, size, (const char *)fmt + 1, a[0], a[1], a[2], a[3], a[4], a[5]);
+}
+
+uint32_t binlog_dropped(void)
+{
+    return dropped;
+}
+
+char binlog_level_char(uint8_t level)
+{
+    static const char letters[] = "?EWIDV";
+
+    return level < sizeof(letters) - 1 ? letters[level] : '?';
+}
+
+static void print_record(const binlog_record_t *rec)
+{
+    uint32_t s = rec->time_us / 1000000;
+    uint32_t us = rec->time_us % 1000000;
+
+    if (output == BINLOG_OUTPUT_HOST) {
+        printf("BINLOG,%u.%06u,%08x", s, us, (uint32_t)(uintptr_t)rec->site);
+        for (int i = 0; i < rec->nargs; i++)
+            printf(",%x", rec->args[i]);
+        printf("\n");
+    } else {
+        char msg[160];
+        binlog_format(rec, msg, sizeof(msg));
+        printf("%6u.%06u %c %s\n", s, us, binlog_level_char(rec->level), msg);
+    }
+}
+
+static void binlog_task(void *pvParameters)
+{
+    uint32_t reported = 0;
+    binlog_record_t rec;
+
+    while (1) {
+        while (binlog_read(&rec))
+            print_record(&rec);
+        uint32_t d = dropped;
+        if (d != reported) {
+            printf(output == BINLOG_OUTPUT_HOST ? "BINLOG_DROPPED,%u\n"
+                                                : "binlog: %u records dropped\n", d - reported);
+            reported = d;
+        }
+        vTaskDelay(BINLOG_DRAIN_MS / portTICK_RATE_MS);
+    }
+}
+
+bool binlog_start(unsigned priority, binlog_output_t out)
+{
+    output = out;
+    return xTaskCreate(binlog_task, (signed char *)"binlog", 384, NULL, priority, NULL) == pdPASS;
+}
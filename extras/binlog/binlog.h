@@ -0,0 +1,182 @@
+/* Binary deferred logging
+ *
+ *   BINLOG_INFO("dhcp lease %08x for %u s", ip, lease_s);
+ *
+ * stores the address of its format string (kept in IROM) and its
+ * arguments as raw words in a RAM ring, and returns: no formatting and
+ * no UART on the spot, so it's cheap enough for lwIP callbacks and
+ * interrupt handlers (a few dozen cycles, interrupts disabled for a
+ * handful of them). The records are formatted later, by
+ * binlog_start()'s low priority task or another reader of the ring
+ * (see binlog_read()), or printed raw for utils/binlog_decode.py to
+ * format on the host from the program's ELF file.
+ *
+ * Levels above BINLOG_LEVEL, set per file before including this header
+ * or for the whole build with EXTRA_CFLAGS, compile to nothing, format
+ * string included. Arguments are checked against the format as
+ * printf's are either way.
+ *
+ * Arguments are stored as 32 bit words, so integers, chars and
+ * pointers of up to 32 bits only (a double or a 64 bit value is a
+ * compile error), at most BINLOG_MAX_ARGS of them. A %s argument is
+ * stored as its pointer, so must still be valid when it's formatted:
+ * string constants in RAM or IROM are fine (and the host decoder can
+ * only show those), buffers that change aren't.
+ *
+ * When the ring is full new records are dropped, and counted.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _BINLOG_H
+#define _BINLOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <common_macros.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#define BINLOG_LEVEL_NONE    0
+#define BINLOG_LEVEL_ERROR   1
+#define BINLOG_LEVEL_WARN    2
+#define BINLOG_LEVEL_INFO    3
+#define BINLOG_LEVEL_DEBUG   4
+#define BINLOG_LEVEL_VERBOSE 5
+
+/* The most verbose level compiled in */
+#ifndef BINLOG_LEVEL
+#define BINLOG_LEVEL BINLOG_LEVEL_INFO
+#endif
+
+/* Ring size in 32 bit words, a power of two. A record takes two words
+   plus one per argument. */
+#ifndef BINLOG_RING_WORDS
+#define BINLOG_RING_WORDS 1024
+#endif
+
+/* How often binlog_start()'s task drains the ring */
+#ifndef BINLOG_DRAIN_MS
+#define BINLOG_DRAIN_MS 50
+#endif
+
+/* Longest format string binlog_format() handles */
+#ifndef BINLOG_FORMAT_MAX
+#define BINLOG_FORMAT_MAX 128
+#endif
+
+#define BINLOG_MAX_ARGS 6
+
+typedef struct {
+    const char *site;           /* level digit then format, in IROM */
+    uint8_t level;
+    uint8_t nargs;
+    uint64_t time_us;           /* uptime when it was logged */
+    uint32_t args[BINLOG_MAX_ARGS];
+} binlog_record_t;
+
+typedef enum {
+    BINLOG_OUTPUT_TEXT,         /* formatted lines */
+    BINLOG_OUTPUT_HOST,         /* BINLOG,... lines for utils/binlog_decode.py */
+} binlog_output_t;
+
+/* Start a task at 'priority' (tskIDLE_PRIORITY + 1, say) printing
+   records on stdout every BINLOG_DRAIN_MS. Returns false if the task
+   couldn't be created. */
+bool binlog_start(unsigned priority, binlog_output_t output);
+
+/* Take the oldest record off the ring. Returns false if it's empty.
+   Only one task may read the ring, binlog_start()'s or your own. */
+bool binlog_read(binlog_record_t *rec);
+
+/* Format a record's message (without time or level) into 'buf', as
+   snprintf() does */
+int binlog_format(const binlog_record_t *rec, char *buf, size_t size);
+
+/* Records dropped because the ring was full, since boot */
+uint32_t binlog_dropped(void);
+
+/* One letter for a level: E, W, I, D or V */
+char binlog_level_char(uint8_t level);
+
+/* Called by the macros below: 'site' is the format's address with the
+   argument count in its low bits */
+void binlog_write(uint32_t site, const uint32_t *args);
+
+static inline void __attribute__((format(printf, 1, 2))) binlog_check(const char *fmt, ...)
+{
+}
+
+#define BINLOG__STR(x) #x
+#define BINLOG__XSTR(x) BINLOG__STR(x)
+#define BINLOG__CAT(a, b) BINLOG__CAT_(a, b)
+#define BINLOG__CAT_(a, b) a##b
+
+#define BINLOG__NARGS(...) BINLOG__NARGS_(0, ##__VA_ARGS__, 6, 5, 4, 3, 2, 1, 0)
+#define BINLOG__NARGS_(_0, _1, _2, _3, _4, _5, _6, n, ...) n
+
+/* An argument as a word, failing to compile if it doesn't fit one */
+#define BINLOG__ARG(x) ((uint32_t)(uintptr_t)(x) + 0 * sizeof(char[sizeof(0 ? (x) : (x)) <= 4 ? 1 : -1]))
+
+#define BINLOG__ARGS0()
+#define BINLOG__ARGS1(a) BINLOG__ARG(a)
+#define BINLOG__ARGS2(a, b) BINLOG__ARG(a), BINLOG__ARG(b)
+#define BINLOG__ARGS3(a, b, c) BINLOG__ARGS2(a, b), BINLOG__ARG(c)
+#define BINLOG__ARGS4(a, b, c, d) BINLOG__ARGS3(a, b, c), BINLOG__ARG(d)
+#define BINLOG__ARGS5(a, b, c, d, e) BINLOG__ARGS4(a, b, c, d), BINLOG__ARG(e)
+#define BINLOG__ARGS6(a, b, c, d, e, f) BINLOG__ARGS5(a, b, c, d, e), BINLOG__ARG(f)
+
+#define BINLOG__LOG(level, fmt, ...) do { \
+        static const char IROM __attribute__((aligned(8))) binlog_site_[] = \
+            BINLOG__XSTR(level) fmt; \
+        const uint32_t binlog_args_[BINLOG__NARGS(__VA_ARGS__) + 1] = { \
+            BINLOG__CAT(BINLOG__ARGS, BINLOG__NARGS(__VA_ARGS__))(__VA_ARGS__) }; \
+        if (0) \
+            binlog_check(fmt, ##__VA_ARGS__); \
+        binlog_write((uint32_t)(uintptr_t)binlog_site_ | BINLOG__NARGS(__VA_ARGS__), binlog_args_); \
+    } while (0)
+
+#define BINLOG__NOP(fmt, ...) do { \
+        if (0) \
+            binlog_check(fmt, ##__VA_ARGS__); \
+    } while (0)
+
+#if BINLOG_LEVEL >= BINLOG_LEVEL_ERROR
+#define BINLOG_ERROR(fmt, ...) BINLOG__LOG(1, fmt, ##__VA_ARGS__)
+#else
+#define BINLOG_ERROR(fmt, ...) BINLOG__NOP(fmt, ##__VA_ARGS__)
+#endif
+
+#if BINLOG_LEVEL >= BINLOG_LEVEL_WARN
+#define BINLOG_WARN(fmt, ...) BINLOG__LOG(2, fmt, ##__VA_ARGS__)
+#else
+#define BINLOG_WARN(fmt, ...) BINLOG__NOP(fmt, ##__VA_ARGS__)
+#endif
+
+#if BINLOG_LEVEL >= BINLOG_LEVEL_INFO
+#define BINLOG_INFO(fmt, ...) BINLOG__LOG(3, fmt, ##__VA_ARGS__)
+#else
+#define BINLOG_INFO(fmt, ...) BINLOG__NOP(fmt, ##__VA_ARGS__)
+#endif
+
+#if BINLOG_LEVEL >= BINLOG_LEVEL_DEBUG
+#define BINLOG_DEBUG(fmt, ...) BINLOG__LOG(4, fmt, ##__VA_ARGS__)
+#else
+#define BINLOG_DEBUG(fmt, ...) BINLOG__NOP(fmt, ##__VA_ARGS__)
+#endif
+
+#if BINLOG_LEVEL >= BINLOG_LEVEL_VERBOSE
+#define BINLOG_VERBOSE(fmt, ...) BINLOG__LOG(5, fmt, ##__VA_ARGS__)
+#else
+#define BINLOG_VERBOSE(fmt, ...) BINLOG__NOP(fmt, ##__VA_ARGS__)
+#endif
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _BINLOG_H */
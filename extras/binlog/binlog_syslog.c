@@ -0,0 +1,181 @@
+/* Remote syslog sink for binlog, see binlog_syslog.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "binlog_syslog.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <lwip/api.h>
+#include <lwip/sys.h>
+#include <timeofday.h>
+
+/* A datagram's worth of credit, in ms of refill */
+#define TOKEN_MS (1000 / BINLOG_SYSLOG_RATE)
+
+/* Syslog severities of the binlog levels */
+static const uint8_t severity[] = { 7, 3, 4, 6, 7, 7 };
+
+static ip_addr_t server;
+static uint16_t server_port;
+static const char *host;
+
+static char batch[BINLOG_SYSLOG_DATAGRAM];
+static size_t batch_len;
+static uint32_t batch_ms;       /* when its first line went in */
+
+static uint32_t credit_ms = TOKEN_MS * BINLOG_SYSLOG_BURST;
+static uint32_t credit_at;
+
+static binlog_syslog_stats_t stats;
+
+/* Add a message to the batch, the whole line or none of it unless the
+   batch is empty (when it's cut short). Returns false if it didn't go
+   in. */
+static bool append(uint8_t sev, uint64_t time_us, const binlog_record_t *rec,
+                   uint32_t dropped)
+{
+    char *p = batch + batch_len;
+    size_t room = sizeof(batch) - batch_len;
+    int n;
+
+    if (timeofday_is_set()) {
+        int64_t us = timeofday_us() - (int64_t)(sys_uptime_us() - time_us);
+        time_t s = us / 1000000;
+        struct tm tm;
+        gmtime_r(&s, &tm);
+        n = snprintf(p, room, "<%u>1 %04d-%02d-%02dT%02d:%02d:%02d.%06uZ %s binlog - - - ",
+                     BINLOG_SYSLOG_FACILITY * 8 + sev, tm.tm_year + 1900, tm.tm_mon + 1,
+                     tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec,
+                     (unsigned)(us % 1000000), host);
+    } else {
+        n = snprintf(p, room, "<%u>1 - %s binlog - - - %u.%06u ",
+                     BINLOG_SYSLOG_FACILITY * 8 + sev, host,
+                     (unsigned)(time_us / 1000000), (unsigned)(time_us % 1000000));
+    }
+    if (n >= 0 && (size_t)n < room) {
+        if (rec)
+            n += binlog_format(rec, p + n, room - n);
+        else
+            n += snprintf(p + n, room - n, "binlog: %u records dropped", dropped);
+    }
+    /* and the newline */
+    if (n < 0 || (size_t)n + 1 > room) {
+        if (batch_len)
+            return false;
+        n = room - 1;
+    }
+    p[n] = '\n';
+    if (!batch_len)
+        batch_ms = sys_now();
+    batch_len += n + 1;
+    return true;
+}
+
+/* Wait for the rate limit to allow a datagram */
+static void take_token(void)
+{
+    uint32_t now = sys_now();
+
+    credit_ms += now - credit_at;
+    credit_at = now;
+    if (credit_ms > TOKEN_MS * BINLOG_SYSLOG_BURST)
+        credit_ms = TOKEN_MS * BINLOG_SYSLOG_BURST;
+    if (credit_ms < TOKEN_MS) {
+        stats.rate_limited++;
+        vTaskDelay((TOKEN_MS - credit_ms) / portTICK_RATE_MS + 1);
+        now = sys_now();
+        credit_ms += now - credit_at;
+        credit_at = now;
+    }
+    credit_ms = credit_ms > TOKEN_MS ? credit_ms - TOKEN_MS : 0;
+}
+
+static bool send_batch(struct netconn *conn)
+{
+    struct netbuf *buf = netbuf_new();
+    err_t err = ERR_MEM;
+
+    /* Copied, as the MAC may still hold the frame when the batch is
+       reused */
+    if (buf && netbuf_alloc(buf, batch_len)) {
+        memcpy(buf->p->payload, batch, batch_len);
+        err = netconn_sendto(conn, buf, &server, server_port);
+    }
+    if (buf)
+        netbuf_delete(buf);
+    if (err != ERR_OK) {
+        stats.send_errors++;
+        return false;
+    }
+    stats.datagrams++;
+    batch_len = 0;
+    return true;
+}
+
+static void syslog_task(void *pvParameters)
+{
+    struct netconn *conn = pvParameters;
+    binlog_record_t rec;
+    uint32_t batch_records = 0;
+    uint32_t reported = 0;
+    bool held = false;          /* 'rec' read, but not in the batch yet */
+
+    while (1) {
+        uint32_t d = binlog_dropped();
+        if (d != reported && append(4, sys_uptime_us(), NULL, d - reported)) {
+            stats.dropped += d - reported;
+            reported = d;
+        }
+        while (held || binlog_read(&rec)) {
+            held = !append(severity[rec.level < sizeof(severity) ? rec.level : 0],
+                           rec.time_us, &rec, 0);
+            if (held)
+                break;
+            batch_records++;
+        }
+
+        if (batch_len && (held || sys_now() - batch_ms >= BINLOG_SYSLOG_FLUSH_MS)) {
+            take_token();
+            if (send_batch(conn)) {
+                stats.records += batch_records;
+                batch_records = 0;
+                continue;
+            }
+            /* Try it again after a while */
+            vTaskDelay(BINLOG_SYSLOG_FLUSH_MS / portTICK_RATE_MS);
+            continue;
+        }
+        vTaskDelay(BINLOG_DRAIN_MS / portTICK_RATE_MS);
+    }
+}
+
+bool binlog_syslog_start(const ip_addr_t *addr, uint16_t port, const char *hostname,
+                         unsigned priority)
+{
+    struct netconn *conn = netconn_new(NETCONN_UDP);
+
+    if (!conn)
+        return false;
+    ip_addr_copy(server, *addr);
+    server_port = port;
+    host = hostname ? hostname : "-";
+    credit_at = sys_now();
+    if (xTaskCreate(syslog_task, (signed char *)"binlog_syslog", 512, conn, priority,
+                    NULL) != pdPASS) {
+        netconn_delete(conn);
+        return false;
+    }
+    return true;
+}
+
+void binlog_syslog_stats(binlog_syslog_stats_t *out)
+{
+    *out = stats;
+}
@@ -0,0 +1,94 @@
+/* Ship binlog records to a remote syslog server over UDP
+ *
+ * For devices in the field, with no UART attached: a low priority task
+ * reads the binlog ring (in place of binlog_start()'s) and sends the
+ * records as RFC 5424 syslog messages, many to a datagram, one per
+ * line:
+ *
+ *   <134>1 2026-10-14T09:12:03.532113Z node-7 binlog - - - dhcp lease ...
+ *
+ * A datagram goes when it's full (BINLOG_SYSLOG_DATAGRAM bytes) or its
+ * oldest record has waited BINLOG_SYSLOG_FLUSH_MS, but no faster than
+ * BINLOG_SYSLOG_RATE a second on average (bursts of up to
+ * BINLOG_SYSLOG_BURST). Past that the records wait in the ring, so
+ * logging never blocks or sends anything itself; if the ring fills
+ * they're dropped there, and the count dropped is sent in a message of
+ * its own. A datagram that can't be sent (no route yet, out of
+ * buffers) is kept and tried again.
+ *
+ * A receiver that takes a datagram as one message will see a batch as
+ * one message of many lines, so split them at the newlines. Or just
+ * watch them with
+ *
+ *   nc -ulk 514
+ *
+ * Timestamps are the time of day (core/timeofday.h) once it's been set,
+ * by extras/sntp say. Before that they're "-", and the message starts
+ * with the uptime instead.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _BINLOG_SYSLOG_H
+#define _BINLOG_SYSLOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <lwip/ip_addr.h>
+
+#include "binlog.h"
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#define BINLOG_SYSLOG_PORT 514
+
+/* Largest datagram payload, bytes. Keep it under the MTU (1472 bytes
+   of UDP payload over Wi-Fi) so datagrams aren't fragmented. */
+#ifndef BINLOG_SYSLOG_DATAGRAM
+#define BINLOG_SYSLOG_DATAGRAM 1024
+#endif
+
+/* Longest a record waits for its datagram to fill, ms */
+#ifndef BINLOG_SYSLOG_FLUSH_MS
+#define BINLOG_SYSLOG_FLUSH_MS 2000
+#endif
+
+/* Datagrams a second, on average, and in a burst */
+#ifndef BINLOG_SYSLOG_RATE
+#define BINLOG_SYSLOG_RATE 4
+#endif
+
+#ifndef BINLOG_SYSLOG_BURST
+#define BINLOG_SYSLOG_BURST 8
+#endif
+
+/* Syslog facility, local0 */
+#ifndef BINLOG_SYSLOG_FACILITY
+#define BINLOG_SYSLOG_FACILITY 16
+#endif
+
+typedef struct {
+    uint32_t records;           /* sent */
+    uint32_t datagrams;         /* sent */
+    uint32_t send_errors;       /* tries that failed, and were retried */
+    uint32_t rate_limited;      /* datagrams held back by the rate limit */
+    uint32_t dropped;           /* records lost to a full ring (binlog_dropped()) */
+} binlog_syslog_stats_t;
+
+/* Start a task at 'priority' (tskIDLE_PRIORITY + 1, say) sending
+   records to 'server':'port' as 'hostname' (NULL for "-"), which must
+   stay valid. Use this or binlog_start(), not both: the ring has one
+   reader. Returns false if the task couldn't be created. */
+bool binlog_syslog_start(const ip_addr_t *server, uint16_t port, const char *hostname,
+                         unsigned priority);
+
+void binlog_syslog_stats(binlog_syslog_stats_t *stats);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _BINLOG_SYSLOG_H */
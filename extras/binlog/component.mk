@@ -0,0 +1,9 @@
+# Component makefile for extras/binlog
+
+# expected anyone using binlog includes it as 'binlog/binlog.h'
+INC_DIRS += $(binlog_ROOT)..
+
+# args for passing into compile rule generation
+binlog_SRC_DIR =  $(binlog_ROOT)
+
+$(eval $(call component_compile_rules,binlog))
@@ -1,8 +1,11 @@
 #include "bmp180.h"
 
+#include <stdio.h>
+#include <common_macros.h>
+
 #include "FreeRTOS.h"
 #include "queue.h"
-#include "task.h"
+#include "timers.h"
 
 #include "espressif/esp_common.h"
 #include "espressif/sdk_private.h"
@@ -10,7 +13,6 @@
 #include "i2c/i2c.h"
 
 #define BMP180_RX_QUEUE_SIZE      10
-#define BMP180_TASK_PRIORITY      9
 
 #define BMP180_DEVICE_ADDRESS     0x77
 
@@ -32,7 +34,12 @@
 #define BMP180_MEASURE_PRESS_OSS2 0xB4
 #define BMP180_MEASURE_PRESS_OSS3 0xF4
 
-#define BMP180_DEFAULT_CONV_TIME  5000
+// Start of conversion bit, cleared by the BMP180 once the result is ready
+#define BMP180_CONTROL_SCO        0x20
+
+// Conversion times from the datasheet, in us
+#define BMP180_TEMP_CONV_TIME     4500
+static const uint16_t bmp180_press_conv_time[] = { 4500, 7500, 13500, 25500 };
 
 //
 // CHIP ID stored in BMP180_VERSION_REG
@@ -52,9 +59,22 @@ typedef struct
     const xQueueHandle* resultQueue;
 } bmp180_command_t;
 
+// Sequencer states, only changed from the timer callback
+typedef enum
+{
+    BMP180_IDLE = 0,
+    BMP180_WAIT_TEMP,
+    BMP180_WAIT_PRESS,
+} bmp180_state_t;
+
 // Just works due to the fact that xQueueHandle is a "void *"
 static xQueueHandle bmp180_rx_queue = NULL;
-static xTaskHandle  bmp180_task_handle = NULL;
+static xTimerHandle bmp180_timer = NULL;
+
+static volatile bmp180_state_t bmp180_state = BMP180_IDLE;
+static bmp180_command_t bmp180_current;
+static int32_t bmp180_B5;
+static uint8_t bmp180_oss = BMP180_OVERSAMPLING_1X;
 
 // Calibration constants
 static int16_t  AC1;
@@ -71,49 +91,23 @@ static int16_t  MB;
 static int16_t  MC;
 static int16_t  MD;
 
+// Products of the constants that don't change between samples
+static int32_t  AC1_4;      // AC1 * 4
+static int32_t  MC_11;      // MC << 11
+
 //
 // Forward declarations
 //
-static void bmp180_meassure(const bmp180_command_t* command);
 static bool bmp180_informUser_Impl(const xQueueHandle* resultQueue, uint8_t cmd, bmp180_temp_t temperature, bmp180_press_t pressure);
 
 // Set default implementation .. User gets result as bmp180_result_t event
 bool (*bmp180_informUser)(const xQueueHandle* resultQueue, uint8_t cmd, bmp180_temp_t temperature, bmp180_press_t pressure) = bmp180_informUser_Impl;
 
-// I2C Driver Task
-static void bmp180_driver_task(void *pvParameters)
-{
-    // Data to be received from user
-    bmp180_command_t current_command;
-
-#ifdef BMP180_DEBUG
-    // Wait for commands from the outside
-    printf("%s: Started Task\n", __FUNCTION__);
-#endif
-
-    while(1)
-    {
-        // Wait for user to insert commands
-        if (xQueueReceive(bmp180_rx_queue, &current_command, portMAX_DELAY) == pdTRUE)
-        {
-#ifdef BMP180_DEBUG
-            printf("%s: Received user command %d 0x%p\n", __FUNCTION__, current_command.cmd, current_command.resultQueue);
-#endif
-            // use user provided queue
-            if (current_command.resultQueue != NULL)
-            {
-                // Work on it ...
-                bmp180_meassure(&current_command);
-            }
-        }
-    }
-}
-
 static uint8_t bmp180_readRegister8(uint8_t reg)
 {
     uint8_t r = 0;
 
-    if (!i2c_slave_read(BMP180_DEVICE_ADDRESS, reg, &r, 1))
+    if (!i2c_read_regs(BMP180_DEVICE_ADDRESS, reg, &r, 1))
     {
         r = 0;
     }
@@ -126,7 +120,7 @@ static int16_t bmp180_readRegister16(uint8_t reg)
     uint8_t d[] = { 0, 0 };
     int16_t r = 0;
 
-    if (i2c_slave_read(BMP180_DEVICE_ADDRESS, reg, d, 2))
+    if (i2c_read_regs(BMP180_DEVICE_ADDRESS, reg, d, 2))
     {
         r = ((int16_t)d[0]<<8) | (d[1]);
     }
@@ -140,32 +134,31 @@ static void bmp180_start_Messurement(uint8_t cmd)
     i2c_slave_write(BMP180_DEVICE_ADDRESS, d, 2);
 }
 
-static int16_t bmp180_getUncompensatedMessurement(uint8_t cmd)
+#define CALIBRATION_WORD(d, i) ((int16_t)((d)[(i)]<<8 | (d)[(i)+1]))
+
+static void bmp180_fillInternalConstants(void)
 {
-    // Write Start Code into reg 0xF4 (Currently without oversampling ...)
-    bmp180_start_Messurement((cmd==BMP180_TEMPERATURE)?BMP180_MEASURE_TEMP:BMP180_MEASURE_PRESS_OSS0);
+    // All 11 calibration words in one burst read
+    uint8_t d[22] = { 0 };
 
-    // Wait 5ms Datasheet states 4.5ms
-    sdk_os_delay_us(BMP180_DEFAULT_CONV_TIME);
+    i2c_read_regs(BMP180_DEVICE_ADDRESS, BMP180_CALIBRATION_REG, d, sizeof(d));
 
-    return (int16_t)bmp180_readRegister16(BMP180_OUT_MSB_REG);
-}
+    AC1 = CALIBRATION_WORD(d, 0);
+    AC2 = CALIBRATION_WORD(d, 2);
+    AC3 = CALIBRATION_WORD(d, 4);
+    AC4 = CALIBRATION_WORD(d, 6);
+    AC5 = CALIBRATION_WORD(d, 8);
+    AC6 = CALIBRATION_WORD(d, 10);
 
-static void bmp180_fillInternalConstants(void)
-{
-    AC1 = bmp180_readRegister16(BMP180_CALIBRATION_REG+0);
-    AC2 = bmp180_readRegister16(BMP180_CALIBRATION_REG+2);
-    AC3 = bmp180_readRegister16(BMP180_CALIBRATION_REG+4);
-    AC4 = bmp180_readRegister16(BMP180_CALIBRATION_REG+6);
-    AC5 = bmp180_readRegister16(BMP180_CALIBRATION_REG+8);
-    AC6 = bmp180_readRegister16(BMP180_CALIBRATION_REG+10);
+    B1 = CALIBRATION_WORD(d, 12);
+    B2 = CALIBRATION_WORD(d, 14);
 
-    B1 = bmp180_readRegister16(BMP180_CALIBRATION_REG+12);
-    B2 = bmp180_readRegister16(BMP180_CALIBRATION_REG+14);
+    MB = CALIBRATION_WORD(d, 16);
+    MC = CALIBRATION_WORD(d, 18);
+    MD = CALIBRATION_WORD(d, 20);
 
-    MB = bmp180_readRegister16(BMP180_CALIBRATION_REG+16);
-    MC = bmp180_readRegister16(BMP180_CALIBRATION_REG+18);
-    MD = bmp180_readRegister16(BMP180_CALIBRATION_REG+20);
+    AC1_4 = (int32_t)AC1 * 4;
+    MC_11 = (int32_t)MC << 11;
 
 #ifdef BMP180_DEBUG
     printf("%s: AC1:=%d AC2:=%d AC3:=%d AC4:=%u AC5:=%u AC6:=%u \n", __FUNCTION__, AC1, AC2, AC3, AC4, AC5, AC6);
@@ -174,15 +167,23 @@ static void bmp180_fillInternalConstants(void)
 #endif
 }
 
+static void bmp180_timer_cb(xTimerHandle xTimer);
+
 static bool bmp180_create_communication_queues()
 {
     // Just create them once
     if (bmp180_rx_queue==NULL)
     {
-        bmp180_rx_queue = xQueueCreate(BMP180_RX_QUEUE_SIZE, sizeof(bmp180_result_t));
+        bmp180_rx_queue = xQueueCreate(BMP180_RX_QUEUE_SIZE, sizeof(bmp180_command_t));
+    }
+
+    // One shot, re-armed by each step with the time the next one has to wait
+    if (bmp180_timer==NULL)
+    {
+        bmp180_timer = xTimerCreate((signed char *)"bmp180", 1, pdFALSE, NULL, bmp180_timer_cb);
     }
 
-    return (bmp180_rx_queue!=NULL);
+    return (bmp180_rx_queue!=NULL && bmp180_timer!=NULL);
 }
 
 static bool bmp180_is_avaialble()
@@ -190,94 +191,188 @@ static bool bmp180_is_avaialble()
     return (bmp180_readRegister8(BMP180_VERSION_REG)==BMP180_CHIP_ID);
 }
 
-static bool bmp180_createTask()
+// Run the next step in about 'us'. Rounded up to whole ticks, a step
+// that fires early just finds the conversion still running and waits
+// another tick.
+static void bmp180_wait(uint32_t us)
 {
-    // We already have a task
-    portBASE_TYPE x = pdPASS;
+    portTickType ticks = (us + 1000 * portTICK_RATE_MS - 1) / (1000 * portTICK_RATE_MS);
 
-    if (bmp180_task_handle==NULL)
-    {
-        x = xTaskCreate(bmp180_driver_task, (signed char *)"bmp180_driver_task", 256, NULL, BMP180_TASK_PRIORITY, &bmp180_task_handle);
-    }
-    return (x==pdPASS);
+    xTimerChangePeriod(bmp180_timer, ticks ? ticks : 1, 0);
 }
 
-static void bmp180_meassure(const bmp180_command_t* command)
+static bool bmp180_conversion_running(void)
 {
-    int32_t T, P;
+    return (bmp180_readRegister8(BMP180_CONTROL_REG) & BMP180_CONTROL_SCO) != 0;
+}
 
-    // Init result to 0
-    T = P = 0;
+static void bmp180_compensate_temperature(int32_t UT)
+{
+    int32_t X1, X2;
 
-    if (command->resultQueue != NULL)
-    {
-        int32_t UT, X1, X2, B5;
+    // Calculation taken from BMP180 Datasheet
+    X1 = (UT - (int32_t)AC6) * ((int32_t)AC5) >> 15;
+    X2 = MC_11 / (X1 + (int32_t)MD);
+    bmp180_B5 = X1 + X2;
+}
 
-        //
-        // Temperature is always needed ... Also required for pressure only
-        //
-        // Calculation taken from BMP180 Datasheet
-        UT = (int32_t)bmp180_getUncompensatedMessurement(BMP180_TEMPERATURE);
+static int32_t bmp180_compensate_pressure(uint32_t UP, uint8_t oss)
+{
+    int32_t X1, X2, X3, B3, B6, P;
+    uint32_t B4, B7;
+
+    // Calculation taken from BMP180 Datasheet
+    B6 = bmp180_B5 - 4000;
+    X1 = ((int32_t)B2 * ((B6 * B6) >> 12)) >> 11;
+    X2 = ((int32_t)AC2 * B6) >> 11;
+    X3 = X1 + X2;
+
+    B3 = (((AC1_4 + X3) << oss) + 2) >> 2;
+    X1 = ((int32_t)AC3 * B6) >> 13;
+    X2 = ((int32_t)B1 * ((B6 * B6) >> 12)) >> 16;
+    X3 = ((X1 + X2) + 2) >> 2;
+    B4 = ((uint32_t)AC4 * (uint32_t)(X3 + 32768)) >> 15;
+    B7 = (UP - B3) * (uint32_t)(50000UL >> oss);
+
+    if (B7 < 0x80000000)
+    {
+        P = (B7 * 2) / B4;
+    }
+    else
+    {
+        P = (B7 / B4) * 2;
+    }
 
-        X1 = (UT - (int32_t)AC6) * ((int32_t)AC5) >> 15;
-        X2 = ((int32_t)MC << 11) / (X1 + (int32_t)MD);
-        B5 = X1 + X2;
+    X1 = (P >> 8) * (P >> 8);
+    X1 = (X1 * 3038) >> 16;
+    X2 = (-7357 * P) >> 16;
+    return P + ((X1 + X2 + (int32_t)3791) >> 4);
+}
 
-        T = (B5 + 8) >> 4;
+static void bmp180_finish(int32_t P)
+{
+    int32_t T = (bmp180_B5 + 8) >> 4;
 
 #ifdef BMP180_DEBUG
-        printf("%s: T:= %ld.%d\n", __FUNCTION__, T/10, abs(T%10));
+    printf("%s: T:= %ld.%d P:= %ld\n", __FUNCTION__, T/10, abs(T%10), P);
+#endif
+
+#if BMP180_INTEGER_ONLY
+    bmp180_temp_t temperature = T;
+#else
+    bmp180_temp_t temperature = (bmp180_temp_t)T / 10;
 #endif
 
-        // Do we also need pressure?
-        if (command->cmd & BMP180_PRESSURE)
+    // Inform the user ...
+    if (!bmp180_informUser(bmp180_current.resultQueue, bmp180_current.cmd, temperature, (bmp180_press_t)P))
+    {
+        // Failed to send info to user
+        printf("%s: Unable to inform user bmp180_informUser returned \"false\"\n", __FUNCTION__);
+    }
+}
+
+// Start the next queued command, if any. Temperature is always
+// measured first, pressure compensation needs it too.
+static void bmp180_start_next(void)
+{
+    while (xQueueReceive(bmp180_rx_queue, &bmp180_current, 0) == pdTRUE)
+    {
+        if (bmp180_current.resultQueue != NULL)
         {
-            int32_t X3, B3, B6;
-            uint32_t B4, B7, UP;
-
-            UP = ((uint32_t)bmp180_getUncompensatedMessurement(BMP180_PRESSURE) & 0xFFFF);
-
-            // Calculation taken from BMP180 Datasheet
-            B6 = B5 - 4000;
-            X1 = ((int32_t)B2 * ((B6 * B6) >> 12)) >> 11;
-            X2 = ((int32_t)AC2 * B6) >> 11;
-            X3 = X1 + X2;
-
-            B3 = (((int32_t)AC1 * 4 + X3) + 2) >> 2;
-            X1 = ((int32_t)AC3 * B6) >> 13;
-            X2 = ((int32_t)B1 * ((B6 * B6) >> 12)) >> 16;
-            X3 = ((X1 + X2) + 2) >> 2;
-            B4 = ((uint32_t)AC4 * (uint32_t)(X3 + 32768)) >> 15;
-            B7 = (UP - B3) * (uint32_t)(50000UL);
-
-            if (B7 < 0x80000000)
-            {
-                P = (B7 * 2) / B4;
-            }
-            else
-            {
-                P = (B7 / B4) * 2;
-            }
-
-            X1 = (P >> 8) * (P >> 8);
-            X1 = (X1 * 3038) >> 16;
-            X2 = (-7357 * P) >> 16;
-            P = P + ((X1 + X2 + (int32_t)3791) >> 4);
+            bmp180_start_Messurement(BMP180_MEASURE_TEMP);
+            bmp180_state = BMP180_WAIT_TEMP;
+            bmp180_wait(BMP180_TEMP_CONV_TIME);
+            return;
+        }
+    }
+    bmp180_state = BMP180_IDLE;
+}
 
-#ifdef BMP180_DEBUG
-            printf("%s: P:= %ld\n", __FUNCTION__, P);
-#endif
+// The measurement sequencer, runs in the timer service task:
+//   start temperature -> wait -> read, start pressure -> wait -> read
+// so a measurement needs no stack of its own and never busy waits.
+static void bmp180_timer_cb(xTimerHandle xTimer)
+{
+    uint8_t d[3];
+
+    switch (bmp180_state)
+    {
+    case BMP180_IDLE:
+        bmp180_start_next();
+        break;
+
+    case BMP180_WAIT_TEMP:
+        if (bmp180_conversion_running())
+        {
+            bmp180_wait(0);
+            break;
+        }
+        bmp180_compensate_temperature(bmp180_readRegister16(BMP180_OUT_MSB_REG));
+
+        if (bmp180_current.cmd & BMP180_PRESSURE)
+        {
+            bmp180_start_Messurement(BMP180_MEASURE_PRESS_OSS0 | (bmp180_oss << 6));
+            bmp180_state = BMP180_WAIT_PRESS;
+            bmp180_wait(bmp180_press_conv_time[bmp180_oss]);
+            break;
         }
+        bmp180_finish(0);
+        bmp180_start_next();
+        break;
 
-        // Inform the user ...
-        if (!bmp180_informUser(command->resultQueue, command->cmd, ((bmp180_temp_t)T)/10.0, (bmp180_press_t)P))
+    case BMP180_WAIT_PRESS:
+        if (bmp180_conversion_running())
+        {
+            bmp180_wait(0);
+            break;
+        }
+        if (!i2c_read_regs(BMP180_DEVICE_ADDRESS, BMP180_OUT_MSB_REG, d, 3))
         {
-            // Failed to send info to user
-            printf("%s: Unable to inform user bmp180_informUser returned \"false\"\n", __FUNCTION__);
+            d[0] = d[1] = d[2] = 0;
         }
+        bmp180_finish(bmp180_compensate_pressure(((uint32_t)d[0] << 16 | (uint32_t)d[1] << 8 | d[2]) >> (8 - bmp180_oss),
+                                                 bmp180_oss));
+        bmp180_start_next();
+        break;
     }
 }
 
+// Altitude in cm at pressure ratios 0.25 to 1.25 of sea level, in
+// steps of 1/64: 4433000 * (1 - ratio^(1/5.255))
+static const int32_t IROM bmp180_altitude_table[65] = {
+    1027909, 988398, 950727, 914714, 880204, 847065, 815179, 784446,
+    754777, 726093, 698323, 671404, 645282, 619904, 595225, 571203,
+    547801, 524984, 502720, 480980, 459737, 438967, 418646, 398754,
+    379271, 360178, 341459, 323097, 305077, 287387, 270011, 252939,
+    236159, 219659, 203430, 187461, 171745, 156270, 141031, 126018,
+    111225, 96644, 82269, 68093, 54110, 40315, 26702, 13265,
+    0, -13098, -26034, -38813, -51438, -63913, -76243, -88431,
+    -100481, -112396, -124180, -135835, -147365, -158774, -170062, -181234,
+    -192293,
+};
+
+int32_t bmp180_altitude_cm(bmp180_press_t pressure, bmp180_press_t sea_level)
+{
+    // pressure / sea_level as Q15, less one quarter; pressure < 2^17 Pa
+    uint32_t ratio = ((pressure & 0x1ffff) << 15) / (sea_level ? sea_level : 1);
+
+    if (ratio < 8192)
+    {
+        ratio = 8192;
+    }
+    ratio -= 8192;
+    if (ratio >= 64 * 512)
+    {
+        ratio = 64 * 512 - 1;
+    }
+
+    uint32_t i = ratio >> 9;
+    int32_t a = bmp180_altitude_table[i];
+    int32_t b = bmp180_altitude_table[i + 1];
+
+    return a + (((b - a) * (int32_t)(ratio & 511)) >> 9);
+}
+
 // Default user inform implementation
 static bool bmp180_informUser_Impl(const xQueueHandle* resultQueue, uint8_t cmd, bmp180_temp_t temperature, bmp180_press_t pressure)
 {
@@ -293,7 +388,7 @@ static bool bmp180_informUser_Impl(const xQueueHandle* resultQueue, uint8_t cmd,
 // Just init all needed queues
 bool bmp180_init(uint8_t scl, uint8_t sda)
 {
-    // 1. Create required queues
+    // 1. Create required queues and the sequencer timer
     bool result = false;
 
     if (bmp180_create_communication_queues())
@@ -307,45 +402,50 @@ bool bmp180_init(uint8_t scl, uint8_t sda)
             // 4. Init all internal constants ...
             bmp180_fillInternalConstants();
 
-            // 5. Start driver task
-            if (bmp180_createTask())
-            {
-                // We are finished
-                result = true;
-            }
+            // We are finished
+            result = true;
         }
     }
 
     return result;
 }
 
-void bmp180_trigger_measurement(const xQueueHandle* resultQueue)
+void bmp180_set_oversampling(bmp180_oversampling_t oss)
+{
+    // Takes effect from the next pressure conversion started
+    bmp180_oss = oss & 3;
+}
+
+static void bmp180_trigger(uint8_t cmd, const xQueueHandle* resultQueue)
 {
     bmp180_command_t c;
 
-    c.cmd = BMP180_PRESSURE + BMP180_TEMPERATURE;
+    c.cmd = cmd;
     c.resultQueue = resultQueue;
 
     xQueueSend(bmp180_rx_queue, &c, 0);
-}
 
+    // Wakes the sequencer if it's idle. If it's just finishing it picks
+    // the command up itself, and a spurious wake only re-checks the
+    // running conversion.
+    if (bmp180_state == BMP180_IDLE)
+    {
+        xTimerChangePeriod(bmp180_timer, 1, 0);
+    }
+}
 
-void bmp180_trigger_pressure_measurement(const xQueueHandle* resultQueue)
+void bmp180_trigger_measurement(const xQueueHandle* resultQueue)
 {
-    bmp180_command_t c;
+    bmp180_trigger(BMP180_PRESSURE + BMP180_TEMPERATURE, resultQueue);
+}
 
-    c.cmd = BMP180_PRESSURE;
-    c.resultQueue = resultQueue;
 
-    xQueueSend(bmp180_rx_queue, &c, 0);
+void bmp180_trigger_pressure_measurement(const xQueueHandle* resultQueue)
+{
+    bmp180_trigger(BMP180_PRESSURE, resultQueue);
 }
 
 void bmp180_trigger_temperature_measurement(const xQueueHandle* resultQueue)
 {
-    bmp180_command_t c;
-
-    c.cmd = BMP180_TEMPERATURE;
-    c.resultQueue = resultQueue;
-
-    xQueueSend(bmp180_rx_queue, &c, 0);
+    bmp180_trigger(BMP180_TEMPERATURE, resultQueue);
 }
@@ -24,11 +24,28 @@
 // Create bmp180_types
 //
 
+// Build with EXTRA_CFLAGS=-DBMP180_INTEGER_ONLY=1 to keep float out of
+// the driver: temperatures are then given in 0.1°C.
+#ifndef BMP180_INTEGER_ONLY
+#define BMP180_INTEGER_ONLY 0
+#endif
+
+#if BMP180_INTEGER_ONLY
+// temperature in 0.1°C
+typedef int32_t bmp180_temp_t;
+#define BMP180_TEMP_TENTHS(t) (t)
+#else
 // temperature in °C
 typedef float bmp180_temp_t;
-// pressure in mPa (To get hPa divide by 100)
+#define BMP180_TEMP_TENTHS(t) ((int32_t)((t) * 10))
+#endif
+
+// pressure in Pa (To get hPa divide by 100)
 typedef uint32_t bmp180_press_t;
 
+// Standard sea level pressure for bmp180_altitude_cm()
+#define BMP180_SEA_LEVEL_PRESSURE 101325
+
 // BMP180_Event_Result
 typedef struct
 {
@@ -37,9 +54,27 @@ typedef struct
     bmp180_press_t pressure;
 } bmp180_result_t;
 
+// Pressure oversampling, more samples mean less noise and a longer
+// conversion (4.5, 7.5, 13.5 and 25.5ms)
+typedef enum
+{
+    BMP180_OVERSAMPLING_1X = 0,
+    BMP180_OVERSAMPLING_2X,
+    BMP180_OVERSAMPLING_4X,
+    BMP180_OVERSAMPLING_8X,
+} bmp180_oversampling_t;
+
 // Init bmp180 driver ...
 bool bmp180_init(uint8_t scl, uint8_t sda);
 
+// Set the pressure oversampling, default BMP180_OVERSAMPLING_1X
+void bmp180_set_oversampling(bmp180_oversampling_t oss);
+
+// Measurements are sequenced from the FreeRTOS timer service task, no
+// driver task is needed. Triggered measurements are queued and run back
+// to back, the result is given to "bmp180_informUser" from the timer
+// service task so it mustn't block.
+
 // Trigger a "complete" measurement (temperature and pressure will be valid when given to "bmp180_informUser)
 void bmp180_trigger_measurement(const xQueueHandle* resultQueue);
 
@@ -49,6 +84,12 @@ void bmp180_trigger_temperature_measurement(const xQueueHandle* resultQueue);
 // Trigger a "pressure only" measurement (only pressure will be valid when given to "bmp180_informUser)
 void bmp180_trigger_pressure_measurement(const xQueueHandle* resultQueue);
 
+// Altitude in cm above the level where the pressure is 'sea_level',
+// from the international barometric formula. Integer only, a table
+// lookup with linear interpolation, within about 3m from ~11km (a quarter of
+// sea level pressure) down to ~1.8km below sea level.
+int32_t bmp180_altitude_cm(bmp180_press_t pressure, bmp180_press_t sea_level);
+
 // Give the user the chance to create it's own handler
 extern bool (*bmp180_informUser)(const xQueueHandle* resultQueue, uint8_t cmd, bmp180_temp_t temperature, bmp180_press_t pressure);
 
@@ -0,0 +1,1253 @@
+/* CoAP server and client, see coap.h
+ *
+ * Based on RFC 7252 (CoAP), RFC 7959 (block-wise transfer) and
+ * RFC 7641 (observe).
+ *
+ * All state is only touched from tcpip_thread. Messages are built in
+ * one buffer and copied into a fresh pbuf for each send: lwIP 1.4.1
+ * prepends its headers into the pbuf it's given and doesn't take them
+ * off again, so a pbuf can't be sent twice. A confirmable message is
+ * kept in an exactly sized PBUF_RAW until it's acknowledged, and so is
+ * the response to a confirmable request, for duplicates.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "coap.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#include <lwip/udp.h>
+#include <lwip/tcpip.h>
+#include <lwip/timers.h>
+#include <lwip/sys.h>
+#include <esp/hwrand.h>
+
+#define COAP_VERSION 1
+
+#define TYPE_CON 0
+#define TYPE_NON 1
+#define TYPE_ACK 2
+#define TYPE_RST 3
+
+#define OPT_URI_HOST        3
+#define OPT_ETAG            4
+#define OPT_OBSERVE         6
+#define OPT_URI_PORT        7
+#define OPT_URI_PATH       11
+#define OPT_CONTENT_FORMAT 12
+#define OPT_MAX_AGE        14
+#define OPT_URI_QUERY      15
+#define OPT_ACCEPT         17
+#define OPT_BLOCK2         23
+#define OPT_BLOCK1         27
+#define OPT_SIZE2          28
+#define OPT_SIZE1          60
+
+#define BLOCK_SIZE(szx) (16u << (szx))
+
+/* Room for the header, token and options around a block */
+#define TX_MAX (BLOCK_SIZE(COAP_BLOCK_SZX) + 2 * COAP_PATH_MAX + 32)
+
+#define TICK_MS 100
+#define EXCHANGE_LIFETIME_MS 247000
+#define NOTIFY_FRESH_MS 128000
+#define TOKEN_LEN 4
+
+typedef struct {
+    uint8_t type;
+    uint8_t code;
+    uint16_t mid;
+    uint8_t tkl;
+    const uint8_t *token;
+    const uint8_t *opts;
+    size_t opts_len;
+    const uint8_t *payload;
+    size_t len;
+} msg_t;
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    uint16_t num;
+} opt_iter_t;
+
+typedef struct {
+    uint8_t *buf;
+    size_t size;
+    size_t len;
+    uint16_t last_opt;
+    bool overflow;
+} writer_t;
+
+typedef struct {
+    bool present;
+    bool more;
+    uint8_t szx;
+    uint32_t num;
+} block_t;
+
+typedef struct {
+    const coap_resource_t *res; /* NULL if free */
+    ip_addr_t addr;
+    u16_t port;
+    uint8_t token[8];
+    uint8_t tkl;
+    uint8_t szx;
+    uint8_t count;              /* non-confirmable notifications since a confirmable one */
+    uint16_t mid;               /* of the last notification, to match a RST to */
+} observer_t;
+
+typedef struct {
+    struct pbuf *msg;           /* NULL if free */
+    ip_addr_t addr;
+    u16_t port;
+    uint16_t mid;
+    uint8_t retries;
+    uint32_t timeout;
+    uint32_t sent;
+    coap_exchange_t *exchange;  /* a client request's, or */
+    observer_t *observer;       /* a notification's */
+} trans_t;
+
+typedef struct {
+    struct pbuf *resp;          /* NULL if free */
+    ip_addr_t addr;
+    u16_t port;
+    uint16_t mid;
+    uint32_t time;
+} dedup_t;
+
+struct coap_exchange {
+    bool used;
+    bool non;
+    bool observe;
+    bool registered;            /* the server has taken the observation */
+    bool have_seq;
+    uint8_t method;
+    uint8_t szx;
+    int16_t content_format;
+    uint8_t token[TOKEN_LEN];
+    ip_addr_t addr;
+    u16_t port;
+    const uint8_t *payload;
+    size_t len;
+    uint32_t block1;            /* block of the body to send next */
+    uint32_t block2;            /* block of the response to ask for */
+    uint32_t seq;               /* Observe of the latest notification */
+    uint32_t seq_time;
+    uint32_t expires;           /* sys_now() the response is due by, 0 if none */
+    coap_response_fn fn;
+    void *arg;
+    char uri[COAP_PATH_MAX];
+};
+
+static struct udp_pcb *pcb;
+static const coap_resource_t *resources;
+static size_t resource_count;
+
+static trans_t pending[COAP_MAX_PENDING];
+static coap_exchange_t exchanges[COAP_MAX_EXCHANGES];
+static observer_t observers[COAP_MAX_OBSERVERS];
+static dedup_t dedup[COAP_DEDUP];
+static uint8_t dedup_next;
+
+static uint16_t next_mid;
+static uint32_t obs_seq;
+static bool timer_running;
+
+static uint8_t tx[TX_MAX];
+static uint8_t resbuf[COAP_MAX_RESOURCE_LEN];
+
+static void tick(void *arg);
+
+/* Next option: 1, or 0 at the end of the options, or -1 if malformed */
+static int opt_next(opt_iter_t *it, uint16_t *num, const uint8_t **val, size_t *len)
+{
+    if (it->p >= it->end || *it->p == 0xff)
+        return 0;
+    uint8_t b = *it->p++;
+    uint32_t f[2] = { b >> 4, b & 15 };
+    for (int i = 0; i < 2; i++) {
+        if (f[i] == 13) {
+            if (it->p + 1 > it->end)
+                return -1;
+            f[i] = 13 + it->p[0];
+            it->p += 1;
+        } else if (f[i] == 14) {
+            if (it->p + 2 > it->end)
+                return -1;
+            f[i] = 269 + (it->p[0] << 8 | it->p[1]);
+            it->p += 2;
+        } else if (f[i] == 15) {
+            return -1;
+        }
+    }
+    if (it->p + f[1] > it->end || it->num + f[0] > 0xffff)
+        return -1;
+    it->num += f[0];
+    *num = it->num;
+    *val = it->p;
+    *len = f[1];
+    it->p += f[1];
+    return 1;
+}
+
+static void opt_begin(opt_iter_t *it, const msg_t *m)
+{
+    it->p = m->opts;
+    it->end = m->opts + m->opts_len;
+    it->num = 0;
+}
+
+static uint32_t opt_uint(const uint8_t *val, size_t len)
+{
+    uint32_t v = 0;
+
+    for (size_t i = 0; i < len && i < 4; i++)
+        v = v << 8 | val[i];
+    return v;
+}
+
+static bool opt_block(block_t *b, const uint8_t *val, size_t len)
+{
+    uint32_t v = opt_uint(val, len);
+
+    if (len > 3 || (v & 7) == 7)
+        return false;
+    b->present = true;
+    b->num = v >> 4;
+    b->more = v & 8;
+    b->szx = v & 7;
+    return true;
+}
+
+static bool parse(msg_t *m, const uint8_t *buf, size_t len)
+{
+    if (len < 4 || buf[0] >> 6 != COAP_VERSION)
+        return false;
+    m->type = (buf[0] >> 4) & 3;
+    m->tkl = buf[0] & 15;
+    m->code = buf[1];
+    m->mid = buf[2] << 8 | buf[3];
+    if (m->tkl > 8 || len < 4 + (size_t)m->tkl)
+        return false;
+    /* Classes 1, 6 and 7 are reserved */
+    uint8_t class = COAP_CODE_CLASS(m->code);
+    if (class == 1 || class >= 6)
+        return false;
+    m->token = buf + 4;
+    m->opts = m->token + m->tkl;
+    m->opts_len = len - 4 - m->tkl;
+    m->payload = NULL;
+    m->len = 0;
+
+    opt_iter_t it;
+    uint16_t num;
+    const uint8_t *val;
+    size_t vlen;
+    int r;
+    opt_begin(&it, m);
+    while ((r = opt_next(&it, &num, &val, &vlen)) > 0)
+        ;
+    if (r < 0)
+        return false;
+    m->opts_len = it.p - m->opts;
+    if (it.p < it.end) {
+        /* The payload marker, there must be a payload after it */
+        if (it.p + 1 == it.end)
+            return false;
+        m->payload = it.p + 1;
+        m->len = it.end - it.p - 1;
+    }
+    if (m->code == 0 && (m->tkl || m->opts_len || m->len))
+        return false;
+    return true;
+}
+
+static void put(writer_t *w, const void *data, size_t len)
+{
+    if (w->len + len > w->size) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, data, len);
+    w->len += len;
+}
+
+static void writer_init(writer_t *w, uint8_t type, uint8_t code, uint16_t mid,
+                        const uint8_t *token, uint8_t tkl)
+{
+    uint8_t hdr[4] = { COAP_VERSION << 6 | type << 4 | tkl, code, mid >> 8, mid };
+
+    w->buf = tx;
+    w->size = sizeof(tx);
+    w->len = 0;
+    w->last_opt = 0;
+    w->overflow = false;
+    put(w, hdr, sizeof(hdr));
+    put(w, token, tkl);
+}
+
+/* Options must be put in order of their number */
+static void put_option(writer_t *w, uint16_t num, const void *val, size_t len)
+{
+    uint8_t hdr[5];
+    size_t n = 1;
+    uint32_t f[2] = { num - w->last_opt, len };
+    uint8_t nib[2];
+
+    for (int i = 0; i < 2; i++) {
+        if (f[i] < 13) {
+            nib[i] = f[i];
+        } else if (f[i] < 269) {
+            nib[i] = 13;
+            hdr[n++] = f[i] - 13;
+        } else {
+            nib[i] = 14;
+            hdr[n++] = (f[i] - 269) >> 8;
+            hdr[n++] = f[i] - 269;
+        }
+    }
+    hdr[0] = nib[0] << 4 | nib[1];
+    put(w, hdr, n);
+    put(w, val, len);
+    w->last_opt = num;
+}
+
+static void put_option_uint(writer_t *w, uint16_t num, uint32_t v)
+{
+    uint8_t val[4] = { v >> 24, v >> 16, v >> 8, v };
+    size_t skip = 0;
+
+    while (skip < 4 && !val[skip])
+        skip++;
+    put_option(w, num, val + skip, 4 - skip);
+}
+
+static void put_payload(writer_t *w, const void *data, size_t len)
+{
+    static const uint8_t marker = 0xff;
+
+    if (len) {
+        put(w, &marker, 1);
+        put(w, data, len);
+    }
+}
+
+/* Content-Format, Block2 (if it's in blocks) and Block1 (if 'block1'
+   isn't -1) then block 'num' of 'body' */
+static void put_representation(writer_t *w, int16_t content_format, uint8_t szx, uint32_t num,
+                               bool blockwise, int32_t block1, const uint8_t *body, size_t len)
+{
+    size_t size = BLOCK_SIZE(szx);
+    size_t offset = num * size;
+
+    if (content_format != COAP_FORMAT_NONE)
+        put_option_uint(w, OPT_CONTENT_FORMAT, content_format);
+    if (blockwise || len > size)
+        put_option_uint(w, OPT_BLOCK2, num << 4 | (offset + size < len) << 3 | szx);
+    if (block1 >= 0)
+        put_option_uint(w, OPT_BLOCK1, block1);
+    if (offset < len)
+        put_payload(w, body + offset, len - offset < size ? len - offset : size);
+}
+
+static err_t send_raw(const ip_addr_t *addr, u16_t port, const void *data, size_t len)
+{
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+
+    if (!p)
+        return ERR_MEM;
+    memcpy(p->payload, data, len);
+    err_t err = udp_sendto(pcb, p, (ip_addr_t *)addr, port);
+    pbuf_free(p);
+    return err;
+}
+
+static struct pbuf *keep(const void *data, size_t len)
+{
+    struct pbuf *p = pbuf_alloc(PBUF_RAW, len, PBUF_RAM);
+
+    if (p)
+        memcpy(p->payload, data, len);
+    return p;
+}
+
+static void send_empty(const ip_addr_t *addr, u16_t port, uint8_t type, uint16_t mid)
+{
+    uint8_t msg[4] = { COAP_VERSION << 6 | type << 4, 0, mid >> 8, mid };
+
+    send_raw(addr, port, msg, sizeof(msg));
+}
+
+static void timer_start(void)
+{
+    if (!timer_running) {
+        timer_running = true;
+        sys_timeout(TICK_MS, tick, NULL);
+    }
+}
+
+/* Send the message in 'w' confirmably */
+static err_t send_con(const writer_t *w, const ip_addr_t *addr, u16_t port, uint16_t mid,
+                      coap_exchange_t *exchange, observer_t *observer)
+{
+    trans_t *t = NULL;
+
+    for (int i = 0; i < COAP_MAX_PENDING && !t; i++) {
+        if (!pending[i].msg)
+            t = &pending[i];
+    }
+    if (!t || !(t->msg = keep(w->buf, w->len)))
+        return ERR_MEM;
+    ip_addr_copy(t->addr, *addr);
+    t->port = port;
+    t->mid = mid;
+    t->retries = 0;
+    /* ACK_RANDOM_FACTOR 1.5 */
+    t->timeout = COAP_ACK_TIMEOUT_MS + hwrand() % (COAP_ACK_TIMEOUT_MS / 2 + 1);
+    t->sent = sys_now();
+    t->exchange = exchange;
+    t->observer = observer;
+    send_raw(addr, port, w->buf, w->len);
+    timer_start();
+    return ERR_OK;
+}
+
+static void trans_free(trans_t *t)
+{
+    pbuf_free(t->msg);
+    t->msg = NULL;
+}
+
+static trans_t *trans_find(const ip_addr_t *addr, u16_t port, uint16_t mid)
+{
+    for (int i = 0; i < COAP_MAX_PENDING; i++) {
+        trans_t *t = &pending[i];
+        if (t->msg && t->mid == mid && t->port == port && ip_addr_cmp(&t->addr, addr))
+            return t;
+    }
+    return NULL;
+}
+
+static void observer_remove(observer_t *o)
+{
+    o->res = NULL;
+    for (int i = 0; i < COAP_MAX_PENDING; i++) {
+        if (pending[i].observer == o)
+            pending[i].observer = NULL;
+    }
+}
+
+static void exchange_free(coap_exchange_t *e)
+{
+    e->used = false;
+    for (int i = 0; i < COAP_MAX_PENDING; i++) {
+        if (pending[i].msg && pending[i].exchange == e)
+            trans_free(&pending[i]);
+    }
+}
+
+/* No response, tell the application */
+static void exchange_fail(coap_exchange_t *e)
+{
+    coap_response_fn fn = e->fn;
+    void *arg = e->arg;
+
+    exchange_free(e);
+    fn(arg, 0, NULL, 0, 0, false);
+}
+
+static void exchange_expire(coap_exchange_t *e)
+{
+    e->expires = sys_now() + COAP_RESPONSE_TIMEOUT_MS;
+    if (!e->expires)
+        e->expires = 1;
+    timer_start();
+}
+
+/* Send the exchange's next request: the body (or its next block), or
+   a request for the next block of the response */
+static err_t send_request(coap_exchange_t *e)
+{
+    writer_t w;
+    uint16_t mid = next_mid++;
+
+    writer_init(&w, e->non ? TYPE_NON : TYPE_CON, e->method, mid, e->token, TOKEN_LEN);
+    if (e->observe && !e->block2)
+        put_option_uint(&w, OPT_OBSERVE, 0);
+
+    const char *p = e->uri;
+    if (*p == '/')
+        p++;
+    const char *query = strchr(p, '?');
+    const char *path_end = query ? query : p + strlen(p);
+    while (p < path_end) {
+        const char *seg = p;
+        while (p < path_end && *p != '/')
+            p++;
+        if (p > seg)
+            put_option(&w, OPT_URI_PATH, seg, p - seg);
+        if (p < path_end)
+            p++;
+    }
+
+    bool body = e->len && !e->block2;
+    if (body && e->content_format != COAP_FORMAT_NONE)
+        put_option_uint(&w, OPT_CONTENT_FORMAT, e->content_format);
+
+    while (query && *query) {
+        const char *seg = ++query;
+        while (*query && *query != '&')
+            query++;
+        if (query > seg)
+            put_option(&w, OPT_URI_QUERY, seg, query - seg);
+    }
+
+    if (e->block2)
+        put_option_uint(&w, OPT_BLOCK2, e->block2 << 4 | e->szx);
+    if (body) {
+        size_t size = BLOCK_SIZE(e->szx);
+        size_t offset = e->block1 * size;
+        size_t n = e->len - offset < size ? e->len - offset : size;
+        if (e->len > size)
+            put_option_uint(&w, OPT_BLOCK1, e->block1 << 4 | (offset + n < e->len) << 3 | e->szx);
+        put_payload(&w, e->payload + offset, n);
+    }
+    if (w.overflow)
+        return ERR_MEM;
+
+    /* Confirmable ones time out with their retransmissions, until an
+       empty ACK says the response comes separately */
+    e->expires = 0;
+    if (e->non) {
+        exchange_expire(e);
+        return send_raw(&e->addr, e->port, w.buf, w.len);
+    }
+    return send_con(&w, &e->addr, e->port, mid, e, NULL);
+}
+
+static void tick(void *arg)
+{
+    uint32_t now = sys_now();
+    bool busy = false;
+
+    for (int i = 0; i < COAP_MAX_PENDING; i++) {
+        trans_t *t = &pending[i];
+        if (!t->msg || now - t->sent < t->timeout)
+            continue;
+        if (t->retries < COAP_MAX_RETRANSMIT) {
+            t->retries++;
+            t->timeout *= 2;
+            t->sent = now;
+            send_raw(&t->addr, t->port, t->msg->payload, t->msg->len);
+            continue;
+        }
+        coap_exchange_t *e = t->exchange;
+        observer_t *o = t->observer;
+        trans_free(t);
+        if (o)
+            observer_remove(o);
+        if (e && e->used)
+            exchange_fail(e);
+    }
+    for (int i = 0; i < COAP_MAX_EXCHANGES; i++) {
+        coap_exchange_t *e = &exchanges[i];
+        if (e->used && e->expires && (int32_t)(now - e->expires) >= 0)
+            exchange_fail(e);
+    }
+
+    for (int i = 0; i < COAP_MAX_PENDING; i++)
+        busy |= pending[i].msg != NULL;
+    for (int i = 0; i < COAP_MAX_EXCHANGES; i++)
+        busy |= exchanges[i].used && exchanges[i].expires;
+    timer_running = busy;
+    if (busy)
+        sys_timeout(TICK_MS, tick, NULL);
+}
+
+static observer_t *observer_add(const coap_resource_t *res, const ip_addr_t *addr, u16_t port,
+                                const msg_t *m, uint8_t szx)
+{
+    observer_t *o = NULL;
+
+    /* A client observes a resource once, a new registration replaces
+       the old one */
+    for (int i = 0; i < COAP_MAX_OBSERVERS && !o; i++) {
+        observer_t *x = &observers[i];
+        if (x->res == res && x->port == port && ip_addr_cmp(&x->addr, addr))
+            o = x;
+    }
+    for (int i = 0; i < COAP_MAX_OBSERVERS && !o; i++) {
+        if (!observers[i].res)
+            o = &observers[i];
+    }
+    if (!o)
+        return NULL;
+    o->res = res;
+    ip_addr_copy(o->addr, *addr);
+    o->port = port;
+    memcpy(o->token, m->token, m->tkl);
+    o->tkl = m->tkl;
+    o->szx = szx;
+    o->count = 0;
+    return o;
+}
+
+static void observer_cancel(const ip_addr_t *addr, u16_t port, const msg_t *m)
+{
+    for (int i = 0; i < COAP_MAX_OBSERVERS; i++) {
+        observer_t *o = &observers[i];
+        if (o->res && o->port == port && ip_addr_cmp(&o->addr, addr)
+            && o->tkl == m->tkl && !memcmp(o->token, m->token, m->tkl))
+            observer_remove(o);
+    }
+}
+
+static bool dedup_resend(const ip_addr_t *addr, u16_t port, uint16_t mid)
+{
+    uint32_t now = sys_now();
+
+    for (int i = 0; i < COAP_DEDUP; i++) {
+        dedup_t *d = &dedup[i];
+        if (!d->resp || d->mid != mid || d->port != port || !ip_addr_cmp(&d->addr, addr))
+            continue;
+        if (now - d->time >= EXCHANGE_LIFETIME_MS)
+            return false;
+        send_raw(addr, port, d->resp->payload, d->resp->len);
+        return true;
+    }
+    return false;
+}
+
+static void dedup_store(const ip_addr_t *addr, u16_t port, uint16_t mid, const writer_t *w)
+{
+    dedup_t *d = &dedup[dedup_next];
+
+    dedup_next = (dedup_next + 1) % COAP_DEDUP;
+    if (d->resp)
+        pbuf_free(d->resp);
+    d->resp = keep(w->buf, w->len);
+    ip_addr_copy(d->addr, *addr);
+    d->port = port;
+    d->mid = mid;
+    d->time = sys_now();
+}
+
+/* The resource table in link format, for .well-known/core */
+static size_t link_format(void)
+{
+    size_t n = 0;
+
+    for (size_t i = 0; i < resource_count && n < sizeof(resbuf); i++) {
+        const coap_resource_t *r = &resources[i];
+        int len;
+        if (r->content_format != COAP_FORMAT_NONE)
+            len = snprintf((char *)resbuf + n, sizeof(resbuf) - n, "%s</%s>;ct=%d%s",
+                           i ? "," : "", r->path, r->content_format, r->observable ? ";obs" : "");
+        else
+            len = snprintf((char *)resbuf + n, sizeof(resbuf) - n, "%s</%s>%s",
+                           i ? "," : "", r->path, r->observable ? ";obs" : "");
+        n += len;
+    }
+    return n < sizeof(resbuf) ? n : sizeof(resbuf);
+}
+
+static bool append(char *buf, size_t *n, char sep, const uint8_t *val, size_t len)
+{
+    size_t need = (*n ? 1 : 0) + len;
+
+    if (*n + need >= COAP_PATH_MAX)
+        return false;
+    if (*n)
+        buf[(*n)++] = sep;
+    memcpy(buf + *n, val, len);
+    *n += len;
+    buf[*n] = 0;
+    return true;
+}
+
+static void handle_request(const msg_t *m, const ip_addr_t *addr, u16_t port)
+{
+    if (m->type == TYPE_CON && dedup_resend(addr, port, m->mid))
+        return;
+
+    char path[COAP_PATH_MAX] = "";
+    char query[COAP_PATH_MAX] = "";
+    size_t path_len = 0, query_len = 0;
+    int32_t observe = -1, accept = -1;
+    int16_t content_format = COAP_FORMAT_NONE;
+    block_t block1 = { 0 }, block2 = { 0 };
+    uint8_t code = 0;
+
+    opt_iter_t it;
+    uint16_t num;
+    const uint8_t *val;
+    size_t len;
+    opt_begin(&it, m);
+    while (!code && opt_next(&it, &num, &val, &len) > 0) {
+        switch (num) {
+        case OPT_URI_PATH:
+            if (!append(path, &path_len, '/', val, len))
+                code = COAP_BAD_REQUEST;
+            break;
+        case OPT_URI_QUERY:
+            if (!append(query, &query_len, '&', val, len))
+                code = COAP_BAD_REQUEST;
+            break;
+        case OPT_CONTENT_FORMAT:
+            content_format = opt_uint(val, len);
+            break;
+        case OPT_OBSERVE:
+            observe = opt_uint(val, len);
+            break;
+        case OPT_ACCEPT:
+            accept = opt_uint(val, len);
+            break;
+        case OPT_BLOCK1:
+            if (!opt_block(&block1, val, len))
+                code = COAP_BAD_OPTION;
+            break;
+        case OPT_BLOCK2:
+            if (!opt_block(&block2, val, len))
+                code = COAP_BAD_OPTION;
+            break;
+        case OPT_URI_HOST:
+        case OPT_URI_PORT:
+        case OPT_ETAG:
+        case OPT_MAX_AGE:
+        case OPT_SIZE1:
+        case OPT_SIZE2:
+            break;
+        default:
+            /* Unrecognised critical options must be refused */
+            if (num & 1)
+                code = COAP_BAD_OPTION;
+            break;
+        }
+    }
+
+    /* Our block size, or the client's if smaller, the number of the
+       block asked for scaled to it */
+    uint8_t szx = COAP_BLOCK_SZX;
+    uint32_t block = 0;
+    if (block2.present) {
+        if (block2.szx < szx)
+            szx = block2.szx;
+        block = (block2.num << (block2.szx + 4)) >> (szx + 4);
+    }
+
+    const coap_resource_t *res = NULL;
+    int16_t res_format = COAP_FORMAT_NONE;
+    size_t body_len = 0;
+    if (!code && !strcmp(path, ".well-known/core")) {
+        if (m->code == COAP_GET) {
+            body_len = link_format();
+            res_format = COAP_FORMAT_LINK;
+            code = COAP_CONTENT;
+        } else {
+            code = COAP_METHOD_NOT_ALLOWED;
+        }
+    } else if (!code) {
+        for (size_t i = 0; i < resource_count && !res; i++) {
+            if (!strcmp(resources[i].path, path))
+                res = &resources[i];
+        }
+        if (!res) {
+            code = COAP_NOT_FOUND;
+        } else if (accept >= 0 && res->content_format != COAP_FORMAT_NONE
+                   && accept != res->content_format) {
+            code = COAP_NOT_ACCEPTABLE;
+        } else {
+            coap_request_t req = {
+                .method = m->code,
+                .path = res->path,
+                .query = query,
+                .payload = m->payload,
+                .len = m->len,
+                .offset = block1.present ? block1.num << (block1.szx + 4) : 0,
+                .more = block1.present && block1.more,
+                .content_format = content_format,
+            };
+            body_len = sizeof(resbuf);
+            code = res->handler(&req, resbuf, &body_len);
+            if (body_len > sizeof(resbuf))
+                body_len = sizeof(resbuf);
+            if (COAP_CODE_CLASS(code) == 2)
+                res_format = res->content_format;
+        }
+    }
+    if (block2.present && body_len && block * BLOCK_SIZE(szx) >= body_len) {
+        code = COAP_BAD_OPTION;
+        body_len = 0;
+        res_format = COAP_FORMAT_NONE;
+    }
+
+    int32_t seq = -1;
+    if (res && res->observable && m->code == COAP_GET && COAP_CODE_CLASS(code) == 2) {
+        if (observe == 0 && !block && observer_add(res, addr, port, m, szx))
+            seq = obs_seq;
+        else if (observe == 1)
+            observer_cancel(addr, port, m);
+    }
+
+    writer_t w;
+    uint8_t type = m->type == TYPE_CON ? TYPE_ACK : TYPE_NON;
+    uint16_t mid = type == TYPE_ACK ? m->mid : next_mid++;
+    writer_init(&w, type, code, mid, m->token, m->tkl);
+    if (seq >= 0)
+        put_option_uint(&w, OPT_OBSERVE, seq);
+    int32_t block1_opt = -1;
+    if (block1.present)
+        block1_opt = block1.num << 4 | (code == COAP_CONTINUE) << 3 | block1.szx;
+    put_representation(&w, res_format, szx, block, block2.present, block1_opt, resbuf, body_len);
+    if (w.overflow)
+        return;
+    send_raw(addr, port, w.buf, w.len);
+    if (m->type == TYPE_CON)
+        dedup_store(addr, port, m->mid, &w);
+}
+
+static bool notification_fresh(coap_exchange_t *e, uint32_t seq)
+{
+    uint32_t now = sys_now();
+
+    /* RFC 7641 3.4, with 24 bit sequence numbers */
+    bool fresh = !e->have_seq
+        || (e->seq < seq && seq - e->seq < (1 << 23))
+        || (e->seq > seq && e->seq - seq > (1 << 23))
+        || now - e->seq_time > NOTIFY_FRESH_MS;
+    if (fresh) {
+        e->have_seq = true;
+        e->seq = seq;
+        e->seq_time = now;
+    }
+    return fresh;
+}
+
+static void handle_response(const msg_t *m, const ip_addr_t *addr, u16_t port)
+{
+    coap_exchange_t *e = NULL;
+
+    for (int i = 0; i < COAP_MAX_EXCHANGES && !e; i++) {
+        coap_exchange_t *x = &exchanges[i];
+        if (x->used && m->tkl == TOKEN_LEN && !memcmp(x->token, m->token, TOKEN_LEN)
+            && x->port == port && ip_addr_cmp(&x->addr, addr))
+            e = x;
+    }
+    if (!e) {
+        /* Notifications we no longer want are refused so the server
+           forgets us */
+        if (m->type != TYPE_ACK)
+            send_empty(addr, port, TYPE_RST, m->mid);
+        return;
+    }
+    if (m->type == TYPE_CON)
+        send_empty(addr, port, TYPE_ACK, m->mid);
+
+    int32_t observe = -1;
+    block_t block1 = { 0 }, block2 = { 0 };
+    opt_iter_t it;
+    uint16_t num;
+    const uint8_t *val;
+    size_t len;
+    opt_begin(&it, m);
+    while (opt_next(&it, &num, &val, &len) > 0) {
+        if (num == OPT_OBSERVE)
+            observe = opt_uint(val, len);
+        else if (num == OPT_BLOCK1)
+            opt_block(&block1, val, len);
+        else if (num == OPT_BLOCK2)
+            opt_block(&block2, val, len);
+    }
+
+    if (e->observe && observe >= 0) {
+        if (!notification_fresh(e, observe))
+            return;
+        e->registered = COAP_CODE_CLASS(m->code) == 2;
+    } else if (e->observe && !e->block2) {
+        /* The server didn't take the observation, or has ended it */
+        e->registered = false;
+    }
+
+    /* The server wants the next block of the body */
+    if (m->code == COAP_CONTINUE && block1.present && e->len && !e->block2) {
+        size_t offset = (block1.num + 1) << (block1.szx + 4);
+        if (block1.szx < e->szx)
+            e->szx = block1.szx;
+        if (offset < e->len) {
+            e->block1 = offset >> (e->szx + 4);
+            if (send_request(e) != ERR_OK)
+                exchange_fail(e);
+            return;
+        }
+    }
+
+    size_t offset = block2.present ? block2.num << (block2.szx + 4) : 0;
+    bool more = block2.present && block2.more;
+    uint8_t token[TOKEN_LEN];
+    memcpy(token, e->token, TOKEN_LEN);
+    e->expires = 0;
+    e->fn(e->arg, m->code, m->payload, m->len, offset, more);
+    /* The callback may have cancelled it, or reused it */
+    if (!e->used || memcmp(e->token, token, TOKEN_LEN))
+        return;
+
+    if (more) {
+        e->szx = block2.szx;
+        e->block2 = block2.num + 1;
+        if (send_request(e) != ERR_OK)
+            exchange_fail(e);
+    } else if (e->observe && e->registered) {
+        e->block2 = 0;
+    } else {
+        exchange_free(e);
+    }
+}
+
+/* An empty ACK or RST for a confirmable message of ours, or a RST for
+   a notification */
+static void handle_empty(const msg_t *m, const ip_addr_t *addr, u16_t port)
+{
+    trans_t *t = trans_find(addr, port, m->mid);
+
+    if (t) {
+        coap_exchange_t *e = t->exchange;
+        observer_t *o = t->observer;
+        trans_free(t);
+        if (m->type == TYPE_RST) {
+            if (o)
+                observer_remove(o);
+            if (e && e->used)
+                exchange_fail(e);
+        }
+        /* An empty ACK for a request: the response comes separately */
+        else if (e && e->used)
+            exchange_expire(e);
+        return;
+    }
+    if (m->type == TYPE_RST) {
+        for (int i = 0; i < COAP_MAX_OBSERVERS; i++) {
+            observer_t *o = &observers[i];
+            if (o->res && o->mid == m->mid && o->port == port && ip_addr_cmp(&o->addr, addr))
+                observer_remove(o);
+        }
+    }
+}
+
+static void coap_recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, ip_addr_t *addr, u16_t port)
+{
+    struct pbuf *flat = p;
+    msg_t m;
+
+    /* Parsed in place, which needs it in one piece */
+    if (p->len != p->tot_len) {
+        flat = pbuf_alloc(PBUF_RAW, p->tot_len, PBUF_RAM);
+        if (!flat) {
+            pbuf_free(p);
+            return;
+        }
+        pbuf_copy_partial(p, flat->payload, p->tot_len, 0);
+        pbuf_free(p);
+    }
+
+    if (!parse(&m, flat->payload, flat->len)) {
+        /* Malformed confirmable messages are rejected, others ignored */
+        const uint8_t *b = flat->payload;
+        if (flat->len >= 4 && b[0] >> 6 == COAP_VERSION && ((b[0] >> 4) & 3) == TYPE_CON)
+            send_empty(addr, port, TYPE_RST, b[2] << 8 | b[3]);
+    } else if (m.code == 0) {
+        if (m.type == TYPE_CON)
+            send_empty(addr, port, TYPE_RST, m.mid);  /* a ping */
+        else
+            handle_empty(&m, addr, port);
+    } else if (COAP_CODE_CLASS(m.code) == 0) {
+        if (m.type == TYPE_CON || m.type == TYPE_NON)
+            handle_request(&m, addr, port);
+    } else {
+        if (m.type == TYPE_ACK || m.type == TYPE_RST) {
+            trans_t *t = trans_find(addr, port, m.mid);
+            if (t)
+                trans_free(t);
+        }
+        if (m.type != TYPE_RST)
+            handle_response(&m, addr, port);
+    }
+    pbuf_free(flat);
+}
+
+coap_exchange_t *coap_request(const ip_addr_t *addr, uint16_t port,
+                              const coap_client_request_t *req,
+                              coap_response_fn fn, void *arg)
+{
+    coap_exchange_t *e = NULL;
+
+    if (!pcb || strlen(req->path) >= COAP_PATH_MAX)
+        return NULL;
+    for (int i = 0; i < COAP_MAX_EXCHANGES && !e; i++) {
+        if (!exchanges[i].used)
+            e = &exchanges[i];
+    }
+    if (!e)
+        return NULL;
+
+    memset(e, 0, sizeof(*e));
+    e->used = true;
+    e->non = req->non;
+    e->observe = req->observe && req->method == COAP_GET;
+    e->method = req->method;
+    e->szx = COAP_BLOCK_SZX;
+    e->content_format = req->content_format;
+    hwrand_fill(e->token, TOKEN_LEN);
+    ip_addr_copy(e->addr, *addr);
+    e->port = port;
+    e->payload = req->payload;
+    e->len = req->len;
+    e->fn = fn;
+    e->arg = arg;
+    strcpy(e->uri, req->path);
+    if (send_request(e) != ERR_OK) {
+        exchange_free(e);
+        return NULL;
+    }
+    return e;
+}
+
+void coap_cancel(coap_exchange_t *e)
+{
+    if (e->used)
+        exchange_free(e);
+}
+
+typedef struct {
+    sys_sem_t done;
+    uint16_t port;
+    const coap_resource_t *res;
+    int count;
+    bool ok;
+} start_call_t;
+
+static void stop_cb(void *arg)
+{
+    if (pcb) {
+        udp_remove(pcb);
+        pcb = NULL;
+    }
+    sys_untimeout(tick, NULL);
+    timer_running = false;
+    for (int i = 0; i < COAP_MAX_PENDING; i++) {
+        if (pending[i].msg)
+            trans_free(&pending[i]);
+    }
+    for (int i = 0; i < COAP_DEDUP; i++) {
+        if (dedup[i].resp)
+            pbuf_free(dedup[i].resp);
+        dedup[i].resp = NULL;
+    }
+    for (int i = 0; i < COAP_MAX_OBSERVERS; i++)
+        observers[i].res = NULL;
+    for (int i = 0; i < COAP_MAX_EXCHANGES; i++) {
+        if (exchanges[i].used)
+            exchange_fail(&exchanges[i]);
+    }
+    if (arg)
+        sys_sem_signal((sys_sem_t *)arg);
+}
+
+static void start_cb(void *arg)
+{
+    start_call_t *call = arg;
+
+    pcb = udp_new();
+    call->ok = pcb && udp_bind(pcb, IP_ADDR_ANY, call->port) == ERR_OK;
+    if (call->ok) {
+        udp_recv(pcb, coap_recv, NULL);
+        next_mid = hwrand();
+    } else if (pcb) {
+        udp_remove(pcb);
+        pcb = NULL;
+    }
+    sys_sem_signal(&call->done);
+}
+
+bool coap_start(uint16_t port, const coap_resource_t *res, size_t count)
+{
+    start_call_t call = { .port = port };
+
+    coap_stop();
+    resources = res;
+    resource_count = count;
+
+    if (sys_sem_new(&call.done, 0) != ERR_OK)
+        return false;
+    if (tcpip_callback(start_cb, &call) == ERR_OK)
+        sys_sem_wait(&call.done);
+    sys_sem_free(&call.done);
+    return call.ok;
+}
+
+void coap_stop(void)
+{
+    sys_sem_t done;
+
+    if (sys_sem_new(&done, 0) != ERR_OK) {
+        tcpip_callback(stop_cb, NULL);
+        return;
+    }
+    if (tcpip_callback(stop_cb, &done) == ERR_OK)
+        sys_sem_wait(&done);
+    sys_sem_free(&done);
+}
+
+static void notify_cb(void *arg)
+{
+    start_call_t *call = arg;
+    const coap_resource_t *res = call->res;
+    coap_request_t req = {
+        .method = COAP_GET,
+        .path = res->path,
+        .query = "",
+        .content_format = COAP_FORMAT_NONE,
+    };
+
+    call->count = 0;
+    if (!pcb)
+        goto done;
+
+    size_t len = sizeof(resbuf);
+    uint8_t code = res->handler(&req, resbuf, &len);
+    if (len > sizeof(resbuf))
+        len = sizeof(resbuf);
+    bool ok = COAP_CODE_CLASS(code) == 2;
+    obs_seq = (obs_seq + 1) & 0xffffff;
+
+    for (int i = 0; i < COAP_MAX_OBSERVERS; i++) {
+        observer_t *o = &observers[i];
+        if (o->res != res)
+            continue;
+
+        trans_t *t = NULL;
+        for (int j = 0; j < COAP_MAX_PENDING && !t; j++) {
+            if (pending[j].msg && pending[j].observer == o)
+                t = &pending[j];
+        }
+        bool con = t || !ok || ++o->count >= COAP_OBSERVE_CON_EVERY;
+        uint16_t mid = next_mid++;
+
+        writer_t w;
+        writer_init(&w, con ? TYPE_CON : TYPE_NON, code, mid, o->token, o->tkl);
+        if (ok)
+            put_option_uint(&w, OPT_OBSERVE, obs_seq);
+        put_representation(&w, ok ? res->content_format : COAP_FORMAT_NONE, o->szx, 0,
+                           false, -1, resbuf, len);
+        if (w.overflow)
+            continue;
+
+        if (t) {
+            /* Replaces the notification still waiting for its ACK,
+               going on with its retransmission count */
+            struct pbuf *msg = keep(w.buf, w.len);
+            if (msg) {
+                pbuf_free(t->msg);
+                t->msg = msg;
+                t->mid = mid;
+                send_raw(&o->addr, o->port, w.buf, w.len);
+            }
+        } else if (con && send_con(&w, &o->addr, o->port, mid, NULL, o) == ERR_OK) {
+            o->count = 0;
+        } else {
+            send_raw(&o->addr, o->port, w.buf, w.len);
+        }
+        o->mid = mid;
+        call->count++;
+        /* An error ends the observation */
+        if (!ok)
+            observer_remove(o);
+    }
+done:
+    sys_sem_signal(&call->done);
+}
+
+int coap_notify(const coap_resource_t *res)
+{
+    start_call_t call = { .res = res };
+
+    if (sys_sem_new(&call.done, 0) != ERR_OK)
+        return 0;
+    if (tcpip_callback(notify_cb, &call) == ERR_OK)
+        sys_sem_wait(&call.done);
+    sys_sem_free(&call.done);
+    return call.count;
+}
+
+typedef struct {
+    sys_sem_t done;
+    const ip_addr_t *addr;
+    uint16_t port;
+    coap_client_request_t req;
+    err_t err;
+    uint8_t code;
+    uint8_t *buf;
+    size_t size;
+    size_t len;
+} call_t;
+
+static void call_response(void *arg, uint8_t code, const uint8_t *data, size_t len,
+                          size_t offset, bool more)
+{
+    call_t *call = arg;
+
+    if (!code) {
+        call->err = ERR_TIMEOUT;
+    } else {
+        call->err = ERR_OK;
+        call->code = code;
+        if (offset < call->size) {
+            size_t n = len < call->size - offset ? len : call->size - offset;
+            if (n)
+                memcpy(call->buf + offset, data, n);
+            if (offset + n > call->len)
+                call->len = offset + n;
+        }
+    }
+    if (!more)
+        sys_sem_signal(&call->done);
+}
+
+static void call_cb(void *arg)
+{
+    call_t *call = arg;
+
+    if (!coap_request(call->addr, call->port, &call->req, call_response, call)) {
+        call->err = ERR_MEM;
+        sys_sem_signal(&call->done);
+    }
+}
+
+err_t coap_call(const ip_addr_t *addr, uint16_t port, const coap_client_request_t *req,
+                uint8_t *code, void *buf, size_t *len)
+{
+    call_t call = {
+        .addr = addr,
+        .port = port,
+        .req = *req,
+        .err = ERR_MEM,
+        .buf = buf,
+        .size = *len,
+    };
+
+    /* An observation would never end */
+    call.req.observe = false;
+    *len = 0;
+    if (sys_sem_new(&call.done, 0) != ERR_OK)
+        return ERR_MEM;
+    if (tcpip_callback(call_cb, &call) == ERR_OK)
+        sys_sem_wait(&call.done);
+    sys_sem_free(&call.done);
+    *code = call.code;
+    *len = call.len;
+    return call.err;
+}
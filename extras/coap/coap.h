@@ -0,0 +1,224 @@
+/* CoAP (RFC 7252) server and client on the lwIP raw UDP API
+ *
+ * For battery nodes and the like, where a TCP session per exchange
+ * costs too much: a sensor read is one small request datagram and one
+ * response, piggybacked on the ACK.
+ *
+ * One UDP endpoint (coap_start()) serves a table of resources and
+ * sends client requests. All of it runs in tcpip_thread, so there's no
+ * task of its own, and confirmable messages are retransmitted from
+ * lwIP's timers (sys_timeout()) with the exponential backoff of the
+ * RFC: ACK_TIMEOUT of COAP_ACK_TIMEOUT_MS, up to COAP_MAX_RETRANSMIT
+ * times. Duplicate confirmable requests get the first response again
+ * rather than running the handler twice.
+ *
+ * Block-wise transfer (RFC 7959): representations longer than a block
+ * (16 << COAP_BLOCK_SZX bytes, or less if the client asks) are sent a
+ * block at a time as the client asks for them, and request bodies come
+ * to handlers a block at a time. The client does both ends of this by
+ * itself, streaming responses to its callback a piece at a time.
+ *
+ * Observe (RFC 7641): a GET with Observe 0 on an observable resource
+ * registers the client, and coap_notify() then pushes the resource to
+ * every observer, generating it once. Every COAP_OBSERVE_CON_EVERY-th
+ * notification is confirmable, and an observer which doesn't ACK it
+ * (or answers any notification with RST) is dropped.
+ *
+ * .well-known/core is answered from the resource table (RFC 6690).
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _COAP_H
+#define _COAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <lwip/ip_addr.h>
+#include <lwip/err.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#define COAP_PORT 5683
+
+/* Block size of responses (and the client's request bodies) as an SZX,
+   16 << SZX bytes: 0 (16) to 6 (1024) */
+#ifndef COAP_BLOCK_SZX
+#define COAP_BLOCK_SZX 4
+#endif
+
+/* Longest representation a handler can generate. There's one buffer
+   for all requests, as handlers all run in tcpip_thread. */
+#ifndef COAP_MAX_RESOURCE_LEN
+#define COAP_MAX_RESOURCE_LEN 1024
+#endif
+
+/* Longest Uri-Path (and, separately, Uri-Query) of a request, joined */
+#ifndef COAP_PATH_MAX
+#define COAP_PATH_MAX 64
+#endif
+
+/* Confirmable messages sent and waiting for their ACK */
+#ifndef COAP_MAX_PENDING
+#define COAP_MAX_PENDING 4
+#endif
+
+/* Client exchanges in progress, observations included */
+#ifndef COAP_MAX_EXCHANGES
+#define COAP_MAX_EXCHANGES 4
+#endif
+
+#ifndef COAP_MAX_OBSERVERS
+#define COAP_MAX_OBSERVERS 4
+#endif
+
+/* Confirmable requests recently answered, kept with their response in
+   case the ACK got lost and the request comes again */
+#ifndef COAP_DEDUP
+#define COAP_DEDUP 4
+#endif
+
+#ifndef COAP_ACK_TIMEOUT_MS
+#define COAP_ACK_TIMEOUT_MS 2000
+#endif
+
+#ifndef COAP_MAX_RETRANSMIT
+#define COAP_MAX_RETRANSMIT 4
+#endif
+
+/* How long a client request waits for a separate response once it's
+   been acknowledged (or for any response, non-confirmable), ms.
+   Confirmable requests otherwise give up when their retransmissions
+   do, after about a minute. */
+#ifndef COAP_RESPONSE_TIMEOUT_MS
+#define COAP_RESPONSE_TIMEOUT_MS 30000
+#endif
+
+#ifndef COAP_OBSERVE_CON_EVERY
+#define COAP_OBSERVE_CON_EVERY 8
+#endif
+
+/* Methods, and response codes as class << 5 | detail */
+#define COAP_GET    1
+#define COAP_POST   2
+#define COAP_PUT    3
+#define COAP_DELETE 4
+
+#define COAP_CODE(class, detail) ((class) << 5 | (detail))
+#define COAP_CREATED               COAP_CODE(2, 1)
+#define COAP_DELETED               COAP_CODE(2, 2)
+#define COAP_VALID                 COAP_CODE(2, 3)
+#define COAP_CHANGED               COAP_CODE(2, 4)
+#define COAP_CONTENT               COAP_CODE(2, 5)
+#define COAP_CONTINUE              COAP_CODE(2, 31)
+#define COAP_BAD_REQUEST           COAP_CODE(4, 0)
+#define COAP_BAD_OPTION            COAP_CODE(4, 2)
+#define COAP_NOT_FOUND             COAP_CODE(4, 4)
+#define COAP_METHOD_NOT_ALLOWED    COAP_CODE(4, 5)
+#define COAP_NOT_ACCEPTABLE        COAP_CODE(4, 6)
+#define COAP_INCOMPLETE            COAP_CODE(4, 8)
+#define COAP_TOO_LARGE             COAP_CODE(4, 13)
+#define COAP_INTERNAL_ERROR        COAP_CODE(5, 0)
+#define COAP_SERVICE_UNAVAILABLE   COAP_CODE(5, 3)
+
+#define COAP_CODE_CLASS(code) ((code) >> 5)
+
+/* Content formats */
+#define COAP_FORMAT_NONE   -1
+#define COAP_FORMAT_TEXT    0
+#define COAP_FORMAT_LINK   40
+#define COAP_FORMAT_OCTETS 42
+#define COAP_FORMAT_JSON   50
+#define COAP_FORMAT_CBOR   60
+
+/* A request to a resource, valid during the handler's call */
+typedef struct {
+    uint8_t method;
+    const char *path;           /* as in the resource table */
+    const char *query;          /* Uri-Query options joined by '&', or "" */
+    const uint8_t *payload;     /* this block of the request body */
+    size_t len;
+    size_t offset;              /* where it is in the body */
+    bool more;                  /* and more blocks of the body follow */
+    int16_t content_format;     /* of the body, or COAP_FORMAT_NONE */
+} coap_request_t;
+
+/* Answer 'req': write a body of up to *len bytes to 'buf', set *len to
+   its length (0 to begin with) and return the response code. A body
+   sent in blocks comes a block at a time, return COAP_CONTINUE for all
+   but the last. Notifications are generated as GETs with no query.
+   Runs in tcpip_thread, so must be quick and not block. */
+typedef uint8_t (*coap_handler_t)(const coap_request_t *req, uint8_t *buf, size_t *len);
+
+typedef struct {
+    const char *path;           /* Uri-Path segments joined by '/', no leading '/' */
+    int16_t content_format;     /* of its responses, or COAP_FORMAT_NONE */
+    bool observable;
+    coap_handler_t handler;
+} coap_resource_t;
+
+/* The client's request */
+typedef struct {
+    uint8_t method;
+    const char *path;           /* with any query: "sensors/temp?unit=c" */
+    const void *payload;        /* must stay valid until the exchange ends */
+    size_t len;
+    int16_t content_format;     /* of the payload, or COAP_FORMAT_NONE */
+    bool non;                   /* send it non-confirmable */
+    bool observe;               /* register as an observer (GET) */
+} coap_client_request_t;
+
+/* The response to a client request, a piece at a time: 'data' is at
+   'offset' in the representation, and 'more' is set if more of it
+   follows. Code 0 means no response came (or the server reset the
+   exchange), and ends it.
+
+   A request's exchange ends with the call with 'more' false. An
+   observation goes on with a call (or calls) for each notification,
+   until it's cancelled or the server ends it: an error code, or a
+   response without Observe. Runs in tcpip_thread. */
+typedef void (*coap_response_fn)(void *arg, uint8_t code, const uint8_t *data, size_t len,
+                                 size_t offset, bool more);
+
+typedef struct coap_exchange coap_exchange_t;
+
+/* Serve 'resources' (which must stay valid) on 'port', COAP_PORT
+   normally, or 0 to only be a client from an ephemeral port. Returns
+   false if the port couldn't be bound. Must be called from a task
+   other than tcpip_thread. */
+bool coap_start(uint16_t port, const coap_resource_t *resources, size_t count);
+
+/* Stop, ending all client exchanges with code 0 */
+void coap_stop(void);
+
+/* From a task: send 'res', generated once, to all its observers.
+   Returns how many it was sent to. */
+int coap_notify(const coap_resource_t *res);
+
+/* In tcpip_thread: start a request to 'addr':'port'. Returns the
+   exchange, or NULL with nothing called if none is free (or the path
+   is COAP_PATH_MAX or longer). */
+coap_exchange_t *coap_request(const ip_addr_t *addr, uint16_t port,
+                              const coap_client_request_t *req,
+                              coap_response_fn fn, void *arg);
+
+/* In tcpip_thread: forget an exchange (an observation, say) without
+   calling its callback again */
+void coap_cancel(coap_exchange_t *exchange);
+
+/* From a task: make a request and wait for the response. The body is
+   copied to 'buf', and *len (its size on entry) set to its length, at
+   most the size. Returns ERR_OK with the response code in *code,
+   ERR_TIMEOUT if no response came, or ERR_MEM. */
+err_t coap_call(const ip_addr_t *addr, uint16_t port, const coap_client_request_t *req,
+                uint8_t *code, void *buf, size_t *len);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _COAP_H */
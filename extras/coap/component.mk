@@ -0,0 +1,9 @@
+# Component makefile for extras/coap
+
+# expected anyone using coap includes it as 'coap/coap.h'
+INC_DIRS += $(coap_ROOT)..
+
+# args for passing into compile rule generation
+coap_SRC_DIR =  $(coap_ROOT)
+
+$(eval $(call component_compile_rules,coap))
@@ -0,0 +1,218 @@
+/*
+ * Microsecond durations, time points and countdowns
+ *
+ * Like std::chrono, over the 64 bit microsecond clock of esp/hrtimer.h
+ * instead of FreeRTOS ticks, so timeouts aren't quantised to 10ms and a
+ * periodic loop using sleep_until() doesn't drift:
+ *
+ *     time_point_t next = time_point_t::now();
+ *     for(;;) {
+ *         sample();
+ *         next += milliseconds(2);
+ *         sleep_until(next);
+ *     }
+ *
+ * Sleeping uses the calling task's notification, see hrtimer_sleep_us().
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+
+#ifndef ESP_OPEN_RTOS_CHRONO_HPP
+#define	ESP_OPEN_RTOS_CHRONO_HPP
+
+#include <stdint.h>
+
+#include "esp/hrtimer.h"
+
+namespace esp_open_rtos {
+namespace timer {
+
+/******************************************************************************************************************
+ * class duration_t
+ *
+ * A signed number of microseconds.
+ */
+class duration_t
+{
+public:
+    inline explicit duration_t(int64_t us = 0) : us(us)
+    {}
+
+    inline int64_t count_us() const
+    {
+        return us;
+    }
+    inline int64_t count_ms() const
+    {
+        return us / 1000;
+    }
+
+    inline duration_t operator + (const duration_t& other) const
+    {
+        return duration_t(us + other.us);
+    }
+    inline duration_t operator - (const duration_t& other) const
+    {
+        return duration_t(us - other.us);
+    }
+    inline duration_t operator * (int64_t n) const
+    {
+        return duration_t(us * n);
+    }
+    inline duration_t& operator += (const duration_t& other)
+    {
+        us += other.us;
+        return *this;
+    }
+    inline duration_t& operator -= (const duration_t& other)
+    {
+        us -= other.us;
+        return *this;
+    }
+    inline bool operator == (const duration_t& other) const { return us == other.us; }
+    inline bool operator != (const duration_t& other) const { return us != other.us; }
+    inline bool operator <  (const duration_t& other) const { return us <  other.us; }
+    inline bool operator <= (const duration_t& other) const { return us <= other.us; }
+    inline bool operator >  (const duration_t& other) const { return us >  other.us; }
+    inline bool operator >= (const duration_t& other) const { return us >= other.us; }
+
+private:
+    int64_t us;
+};
+
+inline duration_t microseconds(int64_t n)
+{
+    return duration_t(n);
+}
+inline duration_t milliseconds(int64_t n)
+{
+    return duration_t(n * 1000);
+}
+inline duration_t seconds(int64_t n)
+{
+    return duration_t(n * 1000000);
+}
+
+/******************************************************************************************************************
+ * class time_point_t
+ *
+ * Microseconds since the hrtimer service started.
+ */
+class time_point_t
+{
+public:
+    inline explicit time_point_t(uint64_t us = 0) : us(us)
+    {}
+
+    static inline time_point_t now()
+    {
+        return time_point_t(hrtimer_now_us64());
+    }
+
+    inline uint64_t since_start_us() const
+    {
+        return us;
+    }
+
+    inline time_point_t operator + (const duration_t& d) const
+    {
+        return time_point_t(us + d.count_us());
+    }
+    inline time_point_t operator - (const duration_t& d) const
+    {
+        return time_point_t(us - d.count_us());
+    }
+    inline duration_t operator - (const time_point_t& other) const
+    {
+        return duration_t((int64_t)(us - other.us));
+    }
+    inline time_point_t& operator += (const duration_t& d)
+    {
+        us += d.count_us();
+        return *this;
+    }
+    inline time_point_t& operator -= (const duration_t& d)
+    {
+        us -= d.count_us();
+        return *this;
+    }
+    inline bool operator == (const time_point_t& other) const { return us == other.us; }
+    inline bool operator != (const time_point_t& other) const { return us != other.us; }
+    inline bool operator <  (const time_point_t& other) const { return us <  other.us; }
+    inline bool operator <= (const time_point_t& other) const { return us <= other.us; }
+    inline bool operator >  (const time_point_t& other) const { return us >  other.us; }
+    inline bool operator >= (const time_point_t& other) const { return us >= other.us; }
+
+private:
+    uint64_t us;
+};
+
+/**
+ * Block the calling task for 'd', from now
+ */
+inline void sleep_for(const duration_t& d)
+{
+    int64_t us = d.count_us();
+
+    // hrtimer_sleep_us() takes 32 bits, about 71 minutes at a time
+    while(us > 0) {
+        uint32_t part = us > 0x7fffffff ? 0x7fffffff : (uint32_t)us;
+        hrtimer_sleep_us(part);
+        us -= part;
+    }
+}
+
+/**
+ * Block the calling task until 't', returning straight away if it's
+ * already past. Sleeping to successive deadlines gives a loop period
+ * with no accumulated drift.
+ */
+inline void sleep_until(const time_point_t& t)
+{
+    sleep_for(t - time_point_t::now());
+}
+
+/******************************************************************************************************************
+ * class us_countdown_t
+ *
+ * countdown_t (countdown.hpp), with microsecond resolution.
+ */
+class us_countdown_t
+{
+public:
+    inline us_countdown_t()
+    {}
+    inline explicit us_countdown_t(const duration_t& d)
+    {
+        countdown(d);
+    }
+    inline void countdown(const duration_t& d)
+    {
+        end = time_point_t::now() + d;
+    }
+    inline bool expired() const
+    {
+        return time_point_t::now() >= end;
+    }
+    /**
+     * Time left, negative once expired
+     */
+    inline duration_t left() const
+    {
+        return end - time_point_t::now();
+    }
+    inline time_point_t deadline() const
+    {
+        return end;
+    }
+
+private:
+    time_point_t end;
+};
+
+} // namespace timer {
+} // namespace esp_open_rtos {
+
+#endif	/* ESP_OPEN_RTOS_CHRONO_HPP */
@@ -0,0 +1,327 @@
+/*
+ * Stackless coroutines, many of them run by one FreeRTOS task
+ *
+ * A coroutine_t is a state machine written as straight line code: run()
+ * is bracketed by CO_BEGIN and CO_END, and the CO_ macros in between
+ * save the point reached and return, to resume there on the next call
+ * (a "protothread"). It costs a few words instead of a task's stack, so
+ * an executor_t can host dozens of sessions:
+ *
+ *     class blink_t : public coroutine_t
+ *     {
+ *         bool run()
+ *         {
+ *             CO_BEGIN();
+ *             for(;;) {
+ *                 gpio_toggle(2);
+ *                 CO_SLEEP(500);
+ *             }
+ *             CO_END();
+ *         }
+ *     };
+ *
+ *     executor_t executor;                 // global, like task_t
+ *     blink_t blink;
+ *     executor.spawn(blink);
+ *     executor.task_create("coro", 512);
+ *
+ * Local variables of run() don't survive a CO_ macro, keep state in
+ * members. switch statements can't span one either, as the macros are
+ * case labels themselves, and each needs a line of its own (the label
+ * is __LINE__).
+ *
+ * Waiting:
+ *  - CO_SLEEP(ms) for a time,
+ *  - CO_RECEIVE(queue, item) for an item from a FreeRTOS queue,
+ *  - CO_WAIT(event) for a co_event_t to be signalled, from any task,
+ *    interrupt handler or callback, for instance a netconn callback on
+ *    NETCONN_EVT_RCVPLUS so the following netconn_recv() won't block,
+ *  - CO_AWAIT(condition) for anything else that can be polled.
+ *
+ * Sleeps and events wake the executor when due. Queue and other polled
+ * waits are checked every poll_ms (default one tick), or straight away
+ * if the producer calls executor.wake().
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+
+#ifndef ESP_OPEN_RTOS_COROUTINE_HPP
+#define	ESP_OPEN_RTOS_COROUTINE_HPP
+
+#include <stddef.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "task.hpp"
+
+namespace esp_open_rtos {
+namespace thread {
+
+class executor_t;
+
+#define CO_BEGIN()          switch(this->co_line) { case 0:
+#define CO_END()            } this->co_line = 0; return false
+
+// Let the other coroutines run, and come back as soon as possible
+#define CO_YIELD()          do { this->co_line = __LINE__; this->co_yielded = true; return true; \
+                                 case __LINE__:; } while(0)
+
+// Come back until 'condition' is true
+#define CO_AWAIT(condition) do { this->co_line = __LINE__; case __LINE__: \
+                                 if(!(condition)) return true; } while(0)
+
+#define CO_SLEEP(ms)        do { this->co_sleep(ms); CO_AWAIT(this->co_expired()); } while(0)
+#define CO_RECEIVE(queue, item) CO_AWAIT(xQueueReceive((queue), &(item), 0) == pdTRUE)
+#define CO_WAIT(event)      do { this->co_waiting = true; CO_AWAIT((event).take()); \
+                                 this->co_waiting = false; } while(0)
+
+// Finish, the coroutine can then be spawned again
+#define CO_EXIT()           do { this->co_line = 0; return false; } while(0)
+
+/******************************************************************************************************************
+ * class coroutine_t
+ *
+ */
+class coroutine_t
+{
+public:
+    coroutine_t()
+    {
+        co_line = 0;
+        co_yielded = false;
+        co_sleeping = false;
+        co_waiting = false;
+        co_wake = 0;
+        co_next = NULL;
+        co_executor = NULL;
+    }
+    virtual ~coroutine_t()
+    {}
+
+protected:
+    /**
+     * The coroutine body, CO_BEGIN() ... CO_END()
+     *
+     * @return false once finished
+     */
+    virtual bool run() = 0;
+
+    inline void co_sleep(unsigned long ms)
+    {
+        co_wake = xTaskGetTickCount() + (ms + portTICK_RATE_MS - 1) / portTICK_RATE_MS;
+        co_sleeping = true;
+    }
+    inline bool co_expired()
+    {
+        if((long)(xTaskGetTickCount() - co_wake) < 0) {
+            return false;
+        }
+        co_sleeping = false;
+        return true;
+    }
+    inline unsigned long millis()
+    {
+        return xTaskGetTickCount() * portTICK_RATE_MS;
+    }
+
+    // Used by the CO_ macros
+    int             co_line;        // resume point, 0 to start
+    bool            co_yielded;     // in CO_YIELD
+    bool            co_sleeping;    // in CO_SLEEP, until co_wake
+    bool            co_waiting;     // in CO_WAIT, woken by the event
+    portTickType    co_wake;
+
+private:
+    friend class executor_t;
+
+    coroutine_t*    co_next;
+    executor_t*     co_executor;
+
+    // no copy and no = operator
+    coroutine_t(const coroutine_t&);
+    coroutine_t &operator=(const coroutine_t&);
+};
+
+/******************************************************************************************************************
+ * class executor_t
+ *
+ * A task running coroutines round robin, create it with task_create().
+ */
+class executor_t : public task_t
+{
+public:
+    executor_t(unsigned long poll_ms = 1)
+    {
+        running = NULL;
+        spawned = NULL;
+        handle = NULL;
+        poll_ticks = poll_ms ? (poll_ms + portTICK_RATE_MS - 1) / portTICK_RATE_MS : 1;
+    }
+    /**
+     * Start running 'co' from the top, from any task
+     *
+     * @param co
+     * @return -1 if it's already running
+     */
+    int spawn(coroutine_t& co)
+    {
+        portENTER_CRITICAL();
+        bool busy = co.co_executor != NULL;
+        if(!busy) {
+            co.co_executor = this;
+            co.co_line = 0;
+            co.co_sleeping = false;
+            co.co_waiting = false;
+            co.co_next = spawned;
+            spawned = &co;
+        }
+        portEXIT_CRITICAL();
+
+        if(busy) {
+            return -1;
+        }
+        wake();
+        return 0;
+    }
+    /**
+     * Run the coroutines now instead of at the next poll
+     */
+    inline void wake()
+    {
+        if(handle) {
+            xTaskNotifyGive(handle);
+        }
+    }
+    inline void wake_from_isr(portBASE_TYPE* pxHigherPriorityTaskWoken)
+    {
+        if(handle) {
+            vTaskNotifyGiveFromISR(handle, pxHigherPriorityTaskWoken);
+        }
+    }
+
+private:
+    void task()
+    {
+        handle = xTaskGetCurrentTaskHandle();
+
+        for(;;) {
+            portENTER_CRITICAL();
+            while(spawned) {
+                coroutine_t* co = spawned;
+                spawned = co->co_next;
+                co->co_next = running;
+                running = co;
+            }
+            portEXIT_CRITICAL();
+
+            // Block until the next sleep is due, or the next poll if
+            // anything waits on a polled condition. Events wake us.
+            portTickType wait = portMAX_DELAY;
+            coroutine_t** link = &running;
+
+            while(*link) {
+                coroutine_t* co = *link;
+                portTickType now = xTaskGetTickCount();
+
+                if(co->co_sleeping && (long)(now - co->co_wake) < 0) {
+                    if(co->co_wake - now < wait) {
+                        wait = co->co_wake - now;
+                    }
+                    link = &co->co_next;
+                    continue;
+                }
+
+                co->co_yielded = false;
+                if(!co->run()) {
+                    *link = co->co_next;
+                    co->co_executor = NULL;
+                    continue;
+                }
+                if(co->co_yielded) {
+                    wait = 0;
+                }
+                else if(co->co_sleeping) {
+                    portTickType left = co->co_wake - xTaskGetTickCount();
+                    if((long)left <= 0) {
+                        wait = 0;
+                    }
+                    else if(left < wait) {
+                        wait = left;
+                    }
+                }
+                else if(!co->co_waiting && poll_ticks < wait) {
+                    wait = poll_ticks;
+                }
+                link = &co->co_next;
+            }
+
+            if(wait == 0) {
+                taskYIELD();
+                ulTaskNotifyTake(pdTRUE, 0);
+            }
+            else {
+                ulTaskNotifyTake(pdTRUE, wait);
+            }
+        }
+    }
+
+    coroutine_t*            running;        // only used by the executor task
+    coroutine_t* volatile   spawned;        // waiting to join 'running'
+    volatile xTaskHandle    handle;
+    portTickType            poll_ticks;
+};
+
+/******************************************************************************************************************
+ * class co_event_t
+ *
+ * Counts signals for CO_WAIT(), each wait takes one.
+ */
+class co_event_t
+{
+public:
+    co_event_t(executor_t& executor) : executor(executor)
+    {
+        count = 0;
+    }
+    inline void signal()
+    {
+        portENTER_CRITICAL();
+        count++;
+        portEXIT_CRITICAL();
+        executor.wake();
+    }
+    inline void signal_from_isr(portBASE_TYPE* pxHigherPriorityTaskWoken)
+    {
+        count++;
+        executor.wake_from_isr(pxHigherPriorityTaskWoken);
+    }
+    inline bool take()
+    {
+        bool taken = false;
+
+        portENTER_CRITICAL();
+        if(count) {
+            count--;
+            taken = true;
+        }
+        portEXIT_CRITICAL();
+
+        return taken;
+    }
+
+private:
+    executor_t&             executor;
+    volatile unsigned long  count;
+
+    // no copy and no = operator
+    co_event_t(const co_event_t&);
+    co_event_t &operator=(const co_event_t&);
+};
+
+} //namespace thread {
+} //namespace esp_open_rtos {
+
+#endif	/* ESP_OPEN_RTOS_COROUTINE_HPP */
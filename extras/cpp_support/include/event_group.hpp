@@ -0,0 +1,225 @@
+/*
+ * Event groups
+ *
+ * event_group_t wraps a FreeRTOS event group, 24 bits a task can block
+ * on until any or all of a set of them are set. One task can wait for
+ * several sources (a network event, a UART line, a timer) without a
+ * task per source:
+ *
+ *     enum { NET_UP = 1 << 0, RX_LINE = 1 << 1, TICK = 1 << 2 };
+ *
+ *     event_group_t events;                // events.event_group_create()
+ *
+ *     events.set(RX_LINE);                 // in a task
+ *     events.set_from_isr(TICK, woken);    // in an interrupt handler
+ *
+ *     xEventBits bits = events.wait_any(RX_LINE | TICK, 1000);
+ *     if(bits & RX_LINE) { ... }
+ *
+ * Setting bits from an interrupt is done by the timer task, see
+ * xEventGroupSetBitsFromISR() in event_groups.h.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+
+#ifndef ESP_OPEN_RTOS_EVENT_GROUP_HPP
+#define	ESP_OPEN_RTOS_EVENT_GROUP_HPP
+
+#include "FreeRTOS.h"
+#include "event_groups.h"
+
+namespace esp_open_rtos {
+namespace thread {
+
+/******************************************************************************************************************
+ * class event_group_t
+ *
+ */
+class event_group_t
+{
+public:
+    /**
+     *
+     */
+    inline event_group_t()
+    {
+        group = 0;
+    }
+    /**
+     *
+     * @return
+     */
+    inline int event_group_create()
+    {
+        group = xEventGroupCreate();
+
+        if(group == NULL) {
+            return -1;
+        }
+        else {
+            return 0;
+        }
+    }
+    /**
+     * Create the event group in caller supplied memory
+     *
+     * @param pxEventGroupBuffer
+     * @return
+     */
+    inline int event_group_create_static(StaticEventGroup_t* pxEventGroupBuffer)
+    {
+        group = xEventGroupCreateStatic(pxEventGroupBuffer);
+
+        if(group == NULL) {
+            return -1;
+        }
+        else {
+            return 0;
+        }
+    }
+    /**
+     * Tasks waiting on the group return with no bits set
+     */
+    inline void event_group_destroy()
+    {
+        vEventGroupDelete(group);
+        group = 0;
+    }
+    /**
+     * Set 'bits', waking the tasks waiting for them
+     *
+     * @param bits
+     * @return the bits set after any waiting tasks cleared theirs
+     */
+    inline xEventBits set(xEventBits bits)
+    {
+        return xEventGroupSetBits(group, bits);
+    }
+    /**
+     * set() from an interrupt handler, done later by the timer task
+     *
+     * @param bits
+     * @param woken     set true if the handler is to yield on return
+     * @return -1 if the timer queue is full
+     */
+    inline int set_from_isr(xEventBits bits, bool& woken)
+    {
+        portBASE_TYPE higher = pdFALSE;
+        int result = (xEventGroupSetBitsFromISR(group, bits, &higher) == pdPASS) ? 0 : -1;
+
+        if(higher) {
+            woken = true;
+        }
+        return result;
+    }
+    /**
+     *
+     * @param bits
+     * @return the bits set before clearing
+     */
+    inline xEventBits clear(xEventBits bits)
+    {
+        return xEventGroupClearBits(group, bits);
+    }
+    /**
+     *
+     * @return
+     */
+    inline xEventBits get() const
+    {
+        return xEventGroupGetBits(group);
+    }
+    /**
+     *
+     * @return
+     */
+    inline xEventBits get_from_isr() const
+    {
+        return xEventGroupGetBitsFromISR(group);
+    }
+    /**
+     * Wait up to 'ms' for any of 'bits', clearing those that are set
+     * unless 'clear' is false
+     *
+     * @param bits
+     * @param ms
+     * @param clear
+     * @return the group's bits when the wait ended, before clearing
+     */
+    inline xEventBits wait_any(xEventBits bits, unsigned long ms = 0, bool clear = true)
+    {
+        return xEventGroupWaitBits(group, bits, clear ? pdTRUE : pdFALSE, pdFALSE, ms / portTICK_RATE_MS);
+    }
+    /**
+     * As wait_any(), for all of 'bits'
+     *
+     * @param bits
+     * @param ms
+     * @param clear
+     * @return
+     */
+    inline xEventBits wait_all(xEventBits bits, unsigned long ms = 0, bool clear = true)
+    {
+        return xEventGroupWaitBits(group, bits, clear ? pdTRUE : pdFALSE, pdTRUE, ms / portTICK_RATE_MS);
+    }
+    /**
+     * Set 'bits', then wait for all of 'wait_bits', which are cleared:
+     * a rendezvous of the tasks that each set one of them
+     *
+     * @param bits
+     * @param wait_bits
+     * @param ms
+     * @return
+     */
+    inline xEventBits sync(xEventBits bits, xEventBits wait_bits, unsigned long ms = 0)
+    {
+        return xEventGroupSync(group, bits, wait_bits, ms / portTICK_RATE_MS);
+    }
+    /**
+     * Wait forever for any of 'bits'
+     *
+     * @param bits
+     * @param clear
+     * @return
+     */
+    inline xEventBits wait_any_forever(xEventBits bits, bool clear = true)
+    {
+        return xEventGroupWaitBits(group, bits, clear ? pdTRUE : pdFALSE, pdFALSE, portMAX_DELAY);
+    }
+
+private:
+    xEventGroupHandle   group;
+
+    // Disable copy construction and assignment.
+    event_group_t (const event_group_t&);
+    const event_group_t &operator = (const event_group_t&);
+};
+
+/******************************************************************************************************************
+ * class static_event_group_t
+ *
+ * An event_group_t carrying its own memory.
+ */
+class static_event_group_t : public event_group_t
+{
+public:
+    /**
+     *
+     * @return
+     */
+    inline int event_group_create()
+    {
+        return event_group_create_static(&buffer);
+    }
+
+private:
+    StaticEventGroup_t  buffer;
+};
+
+} //namespace thread {
+} //namespace esp_open_rtos {
+
+
+#endif	/* ESP_OPEN_RTOS_EVENT_GROUP_HPP */
@@ -0,0 +1,240 @@
+/*
+ * Compile time GPIO pins and ports
+ *
+ * gpio_pin<N> resolves the IOMUX register and the GPIO bit of GPIO N at
+ * compile time, so each operation is a single register access (or a
+ * read-modify-write of the pin's IOMUX register for enable()), with no
+ * gpio_to_iomux() lookup or branch on the pin number:
+ *
+ *     typedef gpio_pin<2> led;
+ *     led::enable(GPIO_OUTPUT);
+ *     led::write(true);
+ *
+ * gpio_port<P0, P1, ...> groups up to 8 pins, set, cleared or written
+ * together with one write per register:
+ *
+ *     typedef gpio_port<4, 5, 12, 13> bus;
+ *     bus::enable(GPIO_OUTPUT);
+ *     bus::write(0x5);                     // GPIO4 and GPIO12 high
+ *
+ * Only GPIO0-15, GPIO16 is not part of the GPIO register block.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+
+#ifndef ESP_OPEN_RTOS_GPIO_HPP
+#define	ESP_OPEN_RTOS_GPIO_HPP
+
+#include <stdint.h>
+
+#include "esp/gpio.h"
+
+namespace esp_open_rtos {
+namespace gpio {
+
+// Marks an unused gpio_port slot
+const uint8_t no_pin = 0xff;
+
+/******************************************************************************************************************
+ * class gpio_pin
+ *
+ */
+template<uint8_t Gpio>
+class gpio_pin
+{
+    // Fails to compile for GPIO16 and up
+    typedef char gpio_must_be_0_to_15[Gpio < 16 ? 1 : -1];
+
+public:
+    enum {
+        // The same mapping as gpio_to_iomux()
+        iomux = Gpio < 6 ? (Gpio == 0 ? 12 : Gpio == 1 ? 5 : Gpio == 2 ? 13 :
+                            Gpio == 3 ? 4 : Gpio == 4 ? 14 : 15)
+              : Gpio < 12 ? Gpio : Gpio - 12,
+        func = IOMUX_FUNC(iomux > 11 ? 0 : 3),
+    };
+    static const uint32_t mask = 1UL << Gpio;
+
+    /**
+     * Like gpio_enable()
+     */
+    static inline void enable(const gpio_direction_t direction)
+    {
+        const uint32_t keep = ~(IOMUX_PIN_FUNC_MASK | IOMUX_PIN_OUTPUT_ENABLE | IOMUX_PIN_OUTPUT_ENABLE_SLEEP);
+
+        if(direction == GPIO_INPUT) {
+            GPIO.ENABLE_OUT_CLEAR = mask;
+            IOMUX.PIN[iomux] = (IOMUX.PIN[iomux] & keep) | func;
+            return;
+        }
+        if(direction == GPIO_OUT_OPEN_DRAIN) {
+            GPIO.CONF[Gpio] |= GPIO_CONF_OPEN_DRAIN;
+        }
+        else {
+            GPIO.CONF[Gpio] &= ~GPIO_CONF_OPEN_DRAIN;
+        }
+        GPIO.ENABLE_OUT_SET = mask;
+        IOMUX.PIN[iomux] = (IOMUX.PIN[iomux] & keep) | func | IOMUX_PIN_OUTPUT_ENABLE;
+    }
+    static inline void disable()
+    {
+        GPIO.ENABLE_OUT_CLEAR = mask;
+        IOMUX.PIN[iomux] &= ~IOMUX_PIN_OUTPUT_ENABLE;
+    }
+    /**
+     * Like gpio_set_pullup()
+     */
+    static inline void set_pullup(bool enabled, bool enabled_during_sleep = false)
+    {
+        const uint32_t keep = ~(IOMUX_PIN_PULLUP | IOMUX_PIN_PULLDOWN | IOMUX_PIN_PULLUP_SLEEP | IOMUX_PIN_PULLDOWN_SLEEP);
+
+        IOMUX.PIN[iomux] = (IOMUX.PIN[iomux] & keep) |
+            (enabled ? IOMUX_PIN_PULLUP : 0) | (enabled_during_sleep ? IOMUX_PIN_PULLUP_SLEEP : 0);
+    }
+    static inline void set()
+    {
+        GPIO.OUT_SET = mask;
+    }
+    static inline void clear()
+    {
+        GPIO.OUT_CLEAR = mask;
+    }
+    static inline void write(bool value)
+    {
+        if(value) {
+            GPIO.OUT_SET = mask;
+        }
+        else {
+            GPIO.OUT_CLEAR = mask;
+        }
+    }
+    /**
+     * Like gpio_toggle(), only this pin can be clobbered by a concurrent
+     * write
+     */
+    static inline void toggle()
+    {
+        if(GPIO.OUT & mask) {
+            GPIO.OUT_CLEAR = mask;
+        }
+        else {
+            GPIO.OUT_SET = mask;
+        }
+    }
+    static inline bool read()
+    {
+        return (GPIO.IN & mask) != 0;
+    }
+};
+
+// An unused gpio_port slot, does nothing
+template<>
+class gpio_pin<no_pin>
+{
+public:
+    static const uint32_t mask = 0;
+
+    static inline void enable(const gpio_direction_t direction)
+    {}
+    static inline void disable()
+    {}
+    static inline void set_pullup(bool enabled, bool enabled_during_sleep = false)
+    {}
+};
+
+/******************************************************************************************************************
+ * class gpio_port
+ *
+ * Bit i of the values written and read is pin Pi.
+ */
+template<uint8_t P0, uint8_t P1 = no_pin, uint8_t P2 = no_pin, uint8_t P3 = no_pin,
+         uint8_t P4 = no_pin, uint8_t P5 = no_pin, uint8_t P6 = no_pin, uint8_t P7 = no_pin>
+class gpio_port
+{
+public:
+    static const uint32_t mask = gpio_pin<P0>::mask | gpio_pin<P1>::mask | gpio_pin<P2>::mask | gpio_pin<P3>::mask |
+                                 gpio_pin<P4>::mask | gpio_pin<P5>::mask | gpio_pin<P6>::mask | gpio_pin<P7>::mask;
+
+    static inline void enable(const gpio_direction_t direction)
+    {
+        gpio_pin<P0>::enable(direction);
+        gpio_pin<P1>::enable(direction);
+        gpio_pin<P2>::enable(direction);
+        gpio_pin<P3>::enable(direction);
+        gpio_pin<P4>::enable(direction);
+        gpio_pin<P5>::enable(direction);
+        gpio_pin<P6>::enable(direction);
+        gpio_pin<P7>::enable(direction);
+    }
+    static inline void set_pullup(bool enabled, bool enabled_during_sleep = false)
+    {
+        gpio_pin<P0>::set_pullup(enabled, enabled_during_sleep);
+        gpio_pin<P1>::set_pullup(enabled, enabled_during_sleep);
+        gpio_pin<P2>::set_pullup(enabled, enabled_during_sleep);
+        gpio_pin<P3>::set_pullup(enabled, enabled_during_sleep);
+        gpio_pin<P4>::set_pullup(enabled, enabled_during_sleep);
+        gpio_pin<P5>::set_pullup(enabled, enabled_during_sleep);
+        gpio_pin<P6>::set_pullup(enabled, enabled_during_sleep);
+        gpio_pin<P7>::set_pullup(enabled, enabled_during_sleep);
+    }
+    /**
+     * All pins high or low, one register write
+     */
+    static inline void set()
+    {
+        GPIO.OUT_SET = mask;
+    }
+    static inline void clear()
+    {
+        GPIO.OUT_CLEAR = mask;
+    }
+    /**
+     * Pins from the bits of 'value', highs set first, then lows cleared,
+     * like gpio_write_mask(). With P0-P7 consecutive and ascending this
+     * is a shift; otherwise one test per pin, folded away for constants.
+     */
+    static inline void write(uint32_t value)
+    {
+        uint32_t bits = to_gpio(value);
+
+        GPIO.OUT_SET = bits;
+        GPIO.OUT_CLEAR = mask & ~bits;
+    }
+    static inline uint32_t read()
+    {
+        uint32_t in = GPIO.IN;
+
+        if(consecutive) {
+            return (in & mask) >> P0;
+        }
+        return ((in & gpio_pin<P0>::mask) ? 0x01 : 0) | ((in & gpio_pin<P1>::mask) ? 0x02 : 0) |
+               ((in & gpio_pin<P2>::mask) ? 0x04 : 0) | ((in & gpio_pin<P3>::mask) ? 0x08 : 0) |
+               ((in & gpio_pin<P4>::mask) ? 0x10 : 0) | ((in & gpio_pin<P5>::mask) ? 0x20 : 0) |
+               ((in & gpio_pin<P6>::mask) ? 0x40 : 0) | ((in & gpio_pin<P7>::mask) ? 0x80 : 0);
+    }
+
+private:
+    // The pins are P0, P0 + 1, ... so bits map with a single shift
+    static const bool consecutive =
+        P1 == no_pin || (P1 == P0 + 1 && (P2 == no_pin || (P2 == P0 + 2 && (P3 == no_pin || (P3 == P0 + 3 &&
+        (P4 == no_pin || (P4 == P0 + 4 && (P5 == no_pin || (P5 == P0 + 5 && (P6 == no_pin || (P6 == P0 + 6 &&
+        (P7 == no_pin || P7 == P0 + 7))))))))))));
+
+    static inline uint32_t to_gpio(uint32_t value)
+    {
+        if(consecutive) {
+            return (value << P0) & mask;
+        }
+        return ((value & 0x01) ? gpio_pin<P0>::mask : 0) | ((value & 0x02) ? gpio_pin<P1>::mask : 0) |
+               ((value & 0x04) ? gpio_pin<P2>::mask : 0) | ((value & 0x08) ? gpio_pin<P3>::mask : 0) |
+               ((value & 0x10) ? gpio_pin<P4>::mask : 0) | ((value & 0x20) ? gpio_pin<P5>::mask : 0) |
+               ((value & 0x40) ? gpio_pin<P6>::mask : 0) | ((value & 0x80) ? gpio_pin<P7>::mask : 0);
+    }
+};
+
+} //namespace gpio {
+} //namespace esp_open_rtos {
+
+#endif	/* ESP_OPEN_RTOS_GPIO_HPP */
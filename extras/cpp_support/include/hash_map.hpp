@@ -0,0 +1,299 @@
+/*
+ * Fixed capacity hash map, open addressing with Robin Hood probing
+ *
+ * hash_map_t<Key, Value, Capacity> keeps every slot inside the object,
+ * so it never touches the heap, and lookups cost a hash and a short run
+ * of compares, not a pointer chase per node as with std::map:
+ *
+ *     static hash_map_t<uint32_t, lease_t, 32> leases;   // keyed by IP
+ *
+ *     lease_t* l = leases.insert(ip, lease);              // NULL if full
+ *     lease_t* found = leases.find(ip);
+ *     leases.erase(ip);
+ *
+ * Robin Hood insertion takes a slot from an entry closer to its home
+ * slot than the one being placed, which keeps every probe run short
+ * and lets a lookup stop as soon as it passes where its key would be.
+ * Erase shifts the run back a slot, so there are no tombstones and the
+ * map doesn't slow down with churn.
+ *
+ * The probe distances are a byte array of their own, apart from the
+ * keys and the values: a lookup walks a few bytes and compares only
+ * the keys whose distance could match, and never reads a value until
+ * it has found the key. The whole map, metadata included, is one block
+ * of data RAM in the object, with nothing per entry to allocate.
+ *
+ * Key and Value are copied by assignment and must have default
+ * constructors (plain structs and integers do). Hash is a functor
+ * returning a uint32_t; hash_t covers the integer types, and
+ * hash_bytes() is there for keys such as MAC addresses:
+ *
+ *     struct mac_hash { uint32_t operator()(const mac_t& m) const
+ *         { return hash_bytes(m.addr, 6); } };
+ *
+ * Capacity must be a power of two, and the map works best kept below
+ * about 80% full. Not thread safe, guard it with a mutex_t if shared.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+
+#ifndef ESP_OPEN_RTOS_HASH_MAP_HPP
+#define	ESP_OPEN_RTOS_HASH_MAP_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace esp_open_rtos {
+namespace container {
+
+/**
+ * FNV-1a, for keys that are a run of bytes
+ */
+inline uint32_t hash_bytes(const void* data, size_t len)
+{
+    const uint8_t* p = (const uint8_t*)data;
+    uint32_t h = 2166136261u;
+
+    while(len--) {
+        h = (h ^ *p++) * 16777619u;
+    }
+    return h;
+}
+
+/******************************************************************************************************************
+ * struct hash_t
+ *
+ * Integer keys: a multiplicative hash, so keys that differ only in their
+ * high bits (addresses, IPs in network order) still spread out.
+ */
+template<class Key>
+struct hash_t
+{
+    inline uint32_t operator()(const Key& key) const
+    {
+        uint32_t h = (uint32_t)key * 2654435761u;
+        return h ^ (h >> 16);
+    }
+};
+
+/******************************************************************************************************************
+ * class hash_map_t
+ *
+ */
+template<class Key, class Value, size_t Capacity, class Hash = hash_t<Key> >
+class hash_map_t
+{
+    // Fails to compile unless Capacity is a power of two, up to 128 (a
+    // probe distance has to fit the byte it's kept in)
+    typedef char capacity_must_be_a_power_of_two[(Capacity > 1 && Capacity <= 128 && (Capacity & (Capacity - 1)) == 0) ? 1 : -1];
+
+public:
+    /******************************************************************************************************************
+     * class iterator
+     *
+     * Visits the entries in slot order. Inserting or erasing invalidates it.
+     */
+    class iterator
+    {
+    public:
+        inline const Key& key() const
+        {
+            return map->keys[slot];
+        }
+        inline Value& value() const
+        {
+            return map->values[slot];
+        }
+        inline iterator& operator++()
+        {
+            slot = map->skip_empty(slot + 1);
+            return *this;
+        }
+        inline bool operator==(const iterator& other) const
+        {
+            return slot == other.slot;
+        }
+        inline bool operator!=(const iterator& other) const
+        {
+            return slot != other.slot;
+        }
+
+    private:
+        friend class hash_map_t;
+
+        inline iterator(hash_map_t* m, size_t s) : map(m), slot(s)
+        {
+        }
+
+        hash_map_t* map;
+        size_t      slot;
+    };
+
+    /**
+     *
+     */
+    inline hash_map_t()
+    {
+        clear();
+    }
+    /**
+     * Add 'key', or replace its value if it's there already
+     *
+     * @return where the value is, NULL if the map is full
+     */
+    inline Value* insert(const Key& key, const Value& value)
+    {
+        Value* v = find(key);
+        if(v) {
+            *v = value;
+            return v;
+        }
+        if(count == Capacity) {
+            return NULL;
+        }
+
+        Key k = key;
+        Value val = value;
+        Value* placed = NULL;
+        size_t slot = home(k);
+
+        for(uint8_t d = 1; ; d++, slot = (slot + 1) & (Capacity - 1)) {
+            if(!dist[slot]) {
+                dist[slot] = d;
+                keys[slot] = k;
+                values[slot] = val;
+                count++;
+                return placed ? placed : &values[slot];
+            }
+            if(dist[slot] < d) {
+                // Take the slot from the richer entry and go on placing it
+                swap(dist[slot], d);
+                swap(keys[slot], k);
+                swap(values[slot], val);
+                if(!placed) {
+                    placed = &values[slot];
+                }
+            }
+        }
+    }
+    /**
+     * @return the value for 'key', NULL if there isn't one
+     */
+    inline Value* find(const Key& key)
+    {
+        size_t slot = lookup(key);
+        return slot == Capacity ? NULL : &values[slot];
+    }
+    inline const Value* find(const Key& key) const
+    {
+        return const_cast<hash_map_t*>(this)->find(key);
+    }
+    inline bool contains(const Key& key) const
+    {
+        return find(key) != NULL;
+    }
+    /**
+     * @return false if 'key' wasn't there
+     */
+    inline bool erase(const Key& key)
+    {
+        size_t slot = lookup(key);
+        if(slot == Capacity) {
+            return false;
+        }
+
+        // Pull the rest of the run back a slot, closer to home
+        for(;;) {
+            size_t next = (slot + 1) & (Capacity - 1);
+            if(dist[next] <= 1) {
+                break;
+            }
+            dist[slot] = dist[next] - 1;
+            keys[slot] = keys[next];
+            values[slot] = values[next];
+            slot = next;
+        }
+        dist[slot] = 0;
+        keys[slot] = Key();
+        values[slot] = Value();
+        count--;
+        return true;
+    }
+    inline void clear()
+    {
+        for(size_t i = 0; i < Capacity; i++) {
+            dist[i] = 0;
+        }
+        count = 0;
+    }
+    inline size_t size() const
+    {
+        return count;
+    }
+    inline bool empty() const
+    {
+        return count == 0;
+    }
+    inline static size_t capacity()
+    {
+        return Capacity;
+    }
+    inline iterator begin()
+    {
+        return iterator(this, skip_empty(0));
+    }
+    inline iterator end()
+    {
+        return iterator(this, Capacity);
+    }
+
+private:
+    template<class T>
+    inline static void swap(T& a, T& b)
+    {
+        T t = a;
+        a = b;
+        b = t;
+    }
+    inline static size_t home(const Key& key)
+    {
+        return Hash()(key) & (Capacity - 1);
+    }
+    // The slot holding 'key', Capacity if none
+    inline size_t lookup(const Key& key) const
+    {
+        size_t slot = home(key);
+
+        for(uint8_t d = 1; d <= dist[slot]; d++, slot = (slot + 1) & (Capacity - 1)) {
+            // Only an entry as far from home as 'key' would be can be it
+            if(dist[slot] == d && keys[slot] == key) {
+                return slot;
+            }
+        }
+        return Capacity;
+    }
+    inline size_t skip_empty(size_t slot) const
+    {
+        while(slot < Capacity && !dist[slot]) {
+            slot++;
+        }
+        return slot;
+    }
+
+    // Probe distance + 1 of each slot, 0 if empty
+    uint8_t     dist[Capacity];
+    size_t      count;
+    Key         keys[Capacity];
+    Value       values[Capacity];
+
+    // Disable copying, values are handed out by address
+    hash_map_t (const hash_map_t&);
+    const hash_map_t &operator = (const hash_map_t&);
+};
+
+} //namespace container {
+} //namespace esp_open_rtos {
+
+#endif	/* ESP_OPEN_RTOS_HASH_MAP_HPP */
@@ -0,0 +1,282 @@
+/*
+ * Intrusive doubly linked list
+ *
+ * The links live in the objects themselves (a list_node_t base class),
+ * so adding to and removing from a list never allocates, and an object
+ * can take itself off whatever list it's on in O(1), with no search:
+ *
+ *     struct session_t : public list_node_t<> { ... };
+ *
+ *     intrusive_list_t<session_t> lru;
+ *     lru.push_front(s);           // most recently used first
+ *     s.unlink();                  // wherever it is
+ *     session_t* oldest = lru.back();
+ *
+ * An object on several lists at once has a node for each, told apart by
+ * a tag type:
+ *
+ *     struct by_age; struct by_host;
+ *     struct entry_t : public list_node_t<by_age>, public list_node_t<by_host> { ... };
+ *     intrusive_list_t<entry_t, by_age> ages;
+ *     intrusive_list_t<entry_t, by_host> hosts;
+ *
+ * The list is circular through a node in the list object, so there's no
+ * empty list special case on insert or remove. The list doesn't own its
+ * objects and never destroys them: unlink them before they go away (the
+ * node's destructor does, if it's still linked). Objects typically come
+ * from a pool_t. Not thread safe.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+
+#ifndef ESP_OPEN_RTOS_INTRUSIVE_LIST_HPP
+#define	ESP_OPEN_RTOS_INTRUSIVE_LIST_HPP
+
+#include <stddef.h>
+
+namespace esp_open_rtos {
+namespace container {
+
+template<class T, class Tag> class intrusive_list_t;
+
+/******************************************************************************************************************
+ * class list_node_t
+ *
+ */
+template<class Tag = void>
+class list_node_t
+{
+public:
+    inline list_node_t()
+    {
+        prev = next = this;
+    }
+    inline ~list_node_t()
+    {
+        unlink();
+    }
+    inline bool linked() const
+    {
+        return next != this;
+    }
+    /**
+     * Take it off its list, if it's on one
+     */
+    inline void unlink()
+    {
+        prev->next = next;
+        next->prev = prev;
+        prev = next = this;
+    }
+
+private:
+    template<class T, class L> friend class intrusive_list_t;
+
+    // Put this node before 'pos'
+    inline void link_before(list_node_t* pos)
+    {
+        next = pos;
+        prev = pos->prev;
+        prev->next = this;
+        pos->prev = this;
+    }
+
+    list_node_t*    prev;
+    list_node_t*    next;
+
+    // Disable copying, the neighbours point at this node
+    list_node_t (const list_node_t&);
+    const list_node_t &operator = (const list_node_t&);
+};
+
+/******************************************************************************************************************
+ * class intrusive_list_t
+ *
+ * T must derive from list_node_t<Tag>.
+ */
+template<class T, class Tag = void>
+class intrusive_list_t
+{
+    typedef list_node_t<Tag> node_t;
+
+public:
+    /******************************************************************************************************************
+     * class iterator
+     *
+     * Stays valid while other objects are added and removed, but not its own.
+     */
+    class iterator
+    {
+    public:
+        inline T& operator*() const
+        {
+            return *object(node);
+        }
+        inline T* operator->() const
+        {
+            return object(node);
+        }
+        inline iterator& operator++()
+        {
+            node = node->next;
+            return *this;
+        }
+        inline iterator& operator--()
+        {
+            node = node->prev;
+            return *this;
+        }
+        inline bool operator==(const iterator& other) const
+        {
+            return node == other.node;
+        }
+        inline bool operator!=(const iterator& other) const
+        {
+            return node != other.node;
+        }
+
+    private:
+        friend class intrusive_list_t;
+
+        inline explicit iterator(node_t* n) : node(n)
+        {
+        }
+
+        node_t* node;
+    };
+
+    /**
+     *
+     */
+    inline intrusive_list_t()
+    {
+    }
+    /**
+     * Leaves the objects unlinked
+     */
+    inline ~intrusive_list_t()
+    {
+        clear();
+    }
+    /**
+     * Add 'object' at the front (it's unlinked from any list it's on first)
+     */
+    inline void push_front(T& object)
+    {
+        insert(begin(), object);
+    }
+    inline void push_back(T& object)
+    {
+        insert(end(), object);
+    }
+    /**
+     * Add 'object' before 'pos'
+     */
+    inline void insert(iterator pos, T& object)
+    {
+        node_t* n = &object;
+        n->unlink();
+        n->link_before(pos.node);
+    }
+    /**
+     * @return the first object, NULL if the list is empty
+     */
+    inline T* front() const
+    {
+        return empty() ? NULL : object(head.next);
+    }
+    inline T* back() const
+    {
+        return empty() ? NULL : object(head.prev);
+    }
+    /**
+     * Remove and return the first object
+     *
+     * @return NULL if the list is empty
+     */
+    inline T* pop_front()
+    {
+        T* t = front();
+        if(t) {
+            static_cast<node_t*>(t)->unlink();
+        }
+        return t;
+    }
+    inline T* pop_back()
+    {
+        T* t = back();
+        if(t) {
+            static_cast<node_t*>(t)->unlink();
+        }
+        return t;
+    }
+    /**
+     * Take 'object' off the list, if it's on it
+     */
+    inline void remove(T& object)
+    {
+        static_cast<node_t&>(object).unlink();
+    }
+    /**
+     * Move 'object', which must be on the list, to the front (for LRU order)
+     */
+    inline void move_to_front(T& object)
+    {
+        push_front(object);
+    }
+    /**
+     * Unlink everything, O(n)
+     */
+    inline void clear()
+    {
+        while(linked()) {
+            head.next->unlink();
+        }
+    }
+    inline bool empty() const
+    {
+        return !linked();
+    }
+    /**
+     * O(n), walks the list
+     */
+    inline size_t size() const
+    {
+        size_t n = 0;
+        for(const node_t* p = head.next; p != &head; p = p->next) {
+            n++;
+        }
+        return n;
+    }
+    inline iterator begin()
+    {
+        return iterator(head.next);
+    }
+    inline iterator end()
+    {
+        return iterator(&head);
+    }
+
+private:
+    inline bool linked() const
+    {
+        return head.next != &head;
+    }
+    inline static T* object(node_t* n)
+    {
+        return static_cast<T*>(n);
+    }
+
+    mutable node_t  head;
+
+    // Disable copying, the objects' nodes point at 'head'
+    intrusive_list_t (const intrusive_list_t&);
+    const intrusive_list_t &operator = (const intrusive_list_t&);
+};
+
+} //namespace container {
+} //namespace esp_open_rtos {
+
+#endif	/* ESP_OPEN_RTOS_INTRUSIVE_LIST_HPP */
@@ -63,6 +63,23 @@ public:
             return 0;
         }
     }
+    /**
+     * Create the mutex in caller supplied memory
+     * 
+     * @param pxMutexBuffer
+     * @return 
+     */
+    inline int mutex_create_static(StaticSemaphore_t* pxMutexBuffer)
+    {
+        mutex = xSemaphoreCreateMutexStatic(pxMutexBuffer);
+        
+        if(mutex == NULL) {
+            return -1;
+        }
+        else {
+            return 0;
+        }
+    }
     /**
      * 
      */
@@ -105,6 +122,27 @@ private:
     const mutex_t &operator = (const mutex_t&);
 };
 
+/******************************************************************************************************************
+ * class static_mutex_t
+ *
+ * A mutex_t carrying its own memory.
+ */
+class static_mutex_t : public mutex_t
+{
+public:
+    /**
+     * 
+     * @return 
+     */
+    inline int mutex_create()
+    {
+        return mutex_create_static(&buffer);
+    }
+
+private:
+    StaticSemaphore_t   buffer;
+};
+
 } //namespace thread {
 } //namespace esp_open_rtos {
 
@@ -0,0 +1,236 @@
+/*
+ * Fixed-block memory pools
+ *
+ * pool_t<Data, Count> keeps Count blocks big enough for a Data inside the
+ * object, and hands them out from a free list in O(1), so messages and
+ * other short lived objects don't fragment the heap. A short critical
+ * section guards the free list, so blocks can be taken and given back
+ * from any task or interrupt handler.
+ *
+ * object_pool<Class, Count> gives a class its own pool_t for new and
+ * delete:
+ *
+ *     class message_t : public object_pool<message_t, 16> { ... };
+ *
+ *     message_t *m = new message_t(...);   // NULL if all 16 are in use
+ *     delete m;
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+
+#ifndef ESP_OPEN_RTOS_POOL_HPP
+#define	ESP_OPEN_RTOS_POOL_HPP
+
+#include <stddef.h>
+#include <new>
+
+#include "FreeRTOS.h"
+
+namespace esp_open_rtos {
+namespace thread {
+
+/******************************************************************************************************************
+ * struct pool_stats_t
+ *
+ */
+struct pool_stats_t
+{
+    size_t  in_use;     // blocks allocated now
+    size_t  peak;       // most blocks ever allocated at once
+    size_t  failures;   // allocations refused because the pool was empty
+};
+
+/******************************************************************************************************************
+ * class pool_t
+ *
+ * With Stats true, the pool also keeps a pool_stats_t.
+ */
+template<class Data, size_t Count, bool Stats = false>
+class pool_t
+{
+    // Fails to compile for an empty pool
+    typedef char count_must_not_be_zero[Count > 0 ? 1 : -1];
+
+    union block_t
+    {
+        block_t*    next;
+        char        data[sizeof(Data)];
+    };
+
+public:
+    /**
+     *
+     */
+    inline pool_t()
+    {
+        for(size_t i = 0; i < Count - 1; i++) {
+            blocks[i].next = &blocks[i + 1];
+        }
+        blocks[Count - 1].next = NULL;
+        free_list = &blocks[0];
+        stats.in_use = stats.peak = stats.failures = 0;
+    }
+    /**
+     * Take a block, uninitialised
+     *
+     * @return NULL if all blocks are in use
+     */
+    inline void* allocate()
+    {
+        portENTER_CRITICAL();
+        block_t* b = free_list;
+        if(b) {
+            free_list = b->next;
+        }
+        if(Stats) {
+            if(b) {
+                if(++stats.in_use > stats.peak) {
+                    stats.peak = stats.in_use;
+                }
+            }
+            else {
+                stats.failures++;
+            }
+        }
+        portEXIT_CRITICAL();
+
+        return b;
+    }
+    /**
+     * Give back a block from allocate(), NULL is ignored
+     *
+     * @param ptr
+     */
+    inline void deallocate(void* ptr)
+    {
+        if(!ptr) {
+            return;
+        }
+        block_t* b = (block_t*)ptr;
+
+        portENTER_CRITICAL();
+        b->next = free_list;
+        free_list = b;
+        if(Stats) {
+            stats.in_use--;
+        }
+        portEXIT_CRITICAL();
+    }
+    /**
+     * Allocate and construct a Data, with up to three constructor arguments
+     *
+     * @return NULL if all blocks are in use
+     */
+    inline Data* create()
+    {
+        void* p = allocate();
+        return p ? new (p) Data() : NULL;
+    }
+    template<class A1>
+    inline Data* create(const A1& a1)
+    {
+        void* p = allocate();
+        return p ? new (p) Data(a1) : NULL;
+    }
+    template<class A1, class A2>
+    inline Data* create(const A1& a1, const A2& a2)
+    {
+        void* p = allocate();
+        return p ? new (p) Data(a1, a2) : NULL;
+    }
+    template<class A1, class A2, class A3>
+    inline Data* create(const A1& a1, const A2& a2, const A3& a3)
+    {
+        void* p = allocate();
+        return p ? new (p) Data(a1, a2, a3) : NULL;
+    }
+    /**
+     * Destruct and give back a Data from create(), NULL is ignored
+     *
+     * @param data
+     */
+    inline void destroy(Data* data)
+    {
+        if(data) {
+            data->~Data();
+            deallocate(data);
+        }
+    }
+    /**
+     * True if 'ptr' is one of this pool's blocks
+     */
+    inline bool owns(const void* ptr) const
+    {
+        const char* p = (const char*)ptr;
+        return p >= (const char*)&blocks[0] && p < (const char*)&blocks[Count];
+    }
+    /**
+     * Statistics, all zero unless Stats is true
+     *
+     * @param result
+     */
+    inline void get_stats(pool_stats_t& result) const
+    {
+        portENTER_CRITICAL();
+        result = stats;
+        portEXIT_CRITICAL();
+    }
+    inline static size_t capacity()
+    {
+        return Count;
+    }
+
+private:
+    block_t*        free_list;
+    pool_stats_t    stats;
+    block_t         blocks[Count] __attribute__((aligned(__alignof__(Data))));
+
+    // Disable copying, blocks are handed out by address
+    pool_t (const pool_t&);
+    const pool_t &operator = (const pool_t&);
+};
+
+/******************************************************************************************************************
+ * class object_pool
+ *
+ * Base class routing new and delete of Class to a pool of Count blocks.
+ * new returns NULL once the pool is empty. Classes derived from Class
+ * must not be bigger than it.
+ */
+template<class Class, size_t Count, bool Stats = false>
+class object_pool
+{
+public:
+    // Marks Class as pool allocated, see ptr_queue_t
+    typedef object_pool pool_type;
+
+    inline static void* operator new(size_t size) throw()
+    {
+        return size <= sizeof(Class) ? storage::pool.allocate() : NULL;
+    }
+    inline static void operator delete(void* ptr)
+    {
+        storage::pool.deallocate(ptr);
+    }
+    inline static void get_stats(pool_stats_t& result)
+    {
+        storage::pool.get_stats(result);
+    }
+
+private:
+    // Only instantiated from the member functions, once Class is complete
+    struct storage
+    {
+        static pool_t<Class, Count, Stats> pool;
+    };
+};
+
+template<class Class, size_t Count, bool Stats>
+pool_t<Class, Count, Stats> object_pool<Class, Count, Stats>::storage::pool;
+
+} //namespace thread {
+} //namespace esp_open_rtos {
+
+#endif	/* ESP_OPEN_RTOS_POOL_HPP */
@@ -0,0 +1,199 @@
+/*
+ * Zero-copy queues of pool allocated objects
+ *
+ * ptr_queue_t<Class> carries pointers to objects of a class derived from
+ * object_pool (see pool.hpp), so however big the message only a pointer
+ * is copied through the FreeRTOS queue. Ownership travels with it in an
+ * owned_t handle, which deletes the object (giving it back to its pool)
+ * unless it was handed on:
+ *
+ *     ptr_queue_t<message_t> queue;        // queue.queue_create(8)
+ *
+ *     owned_t<message_t> m(new message_t(...));
+ *     if(m && queue.post(m) == 0) {
+ *         // m is now empty, the receiver owns the message
+ *     }
+ *
+ *     owned_t<message_t> r;
+ *     if(queue.receive(r, 100) == 0) {
+ *         r->...;                          // deleted when r goes
+ *     }
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+
+#ifndef ESP_OPEN_RTOS_PTR_QUEUE_HPP
+#define	ESP_OPEN_RTOS_PTR_QUEUE_HPP
+
+#include <stddef.h>
+
+#include "queue.hpp"
+#include "pool.hpp"
+
+namespace esp_open_rtos {
+namespace thread {
+
+/******************************************************************************************************************
+ * class owned_t
+ *
+ * Sole owner of a Class object, like std::unique_ptr. Copying transfers
+ * ownership, as with std::auto_ptr, since the tree builds as C++98.
+ */
+template<class Class>
+class owned_t
+{
+public:
+    inline explicit owned_t(Class* p = NULL)
+    {
+        ptr = p;
+    }
+    inline owned_t(owned_t& other)
+    {
+        ptr = other.release();
+    }
+    inline ~owned_t()
+    {
+        delete ptr;
+    }
+    inline owned_t &operator = (owned_t& other)
+    {
+        if(this != &other) {
+            reset(other.release());
+        }
+        return *this;
+    }
+    /**
+     * Delete the object owned, and own 'p' instead
+     *
+     * @param p
+     */
+    inline void reset(Class* p = NULL)
+    {
+        Class* old = ptr;
+        ptr = p;
+        delete old;
+    }
+    /**
+     * Give up ownership without deleting
+     *
+     * @return the object
+     */
+    inline Class* release()
+    {
+        Class* p = ptr;
+        ptr = NULL;
+        return p;
+    }
+    inline Class* get() const
+    {
+        return ptr;
+    }
+    inline Class* operator -> () const
+    {
+        return ptr;
+    }
+    inline Class& operator * () const
+    {
+        return *ptr;
+    }
+    inline operator bool () const
+    {
+        return ptr != NULL;
+    }
+
+private:
+    Class* ptr;
+};
+
+/******************************************************************************************************************
+ * class ptr_queue_t
+ *
+ */
+template<class Class>
+class ptr_queue_t
+{
+    // Fails to compile unless Class derives from object_pool, so a
+    // message dropped anywhere along the way goes back to its pool
+    typedef typename Class::pool_type class_must_derive_from_object_pool;
+    // ... and for an incomplete Class
+    typedef char class_must_be_complete[sizeof(Class) ? 1 : -1];
+
+public:
+    /**
+     *
+     * @param uxQueueLength
+     * @return
+     */
+    inline int queue_create(unsigned portBASE_TYPE uxQueueLength)
+    {
+        return queue.queue_create(uxQueueLength);
+    }
+    /**
+     * Delete the queue and any messages still in it
+     */
+    inline void queue_destroy()
+    {
+        Class* p;
+
+        while(queue.receive(p, 0) == 0) {
+            delete p;
+        }
+        queue.queue_destroy();
+    }
+    /**
+     * Send the object owned by 'data', which is left empty on success
+     * and still owns it on failure
+     *
+     * @param data
+     * @param ms
+     * @return
+     */
+    inline int post(owned_t<Class>& data, unsigned long ms = 0)
+    {
+        Class* p = data.get();
+
+        if(!p || queue.post(p, ms) != 0) {
+            return -1;
+        }
+        data.release();
+
+        return 0;
+    }
+    /**
+     * Receive into 'data', deleting what it owned before
+     *
+     * @param data
+     * @param ms
+     * @return
+     */
+    inline int receive(owned_t<Class>& data, unsigned long ms = 0)
+    {
+        Class* p;
+
+        if(queue.receive(p, ms) != 0) {
+            return -1;
+        }
+        data.reset(p);
+
+        return 0;
+    }
+    /**
+     * The FreeRTOS queue, to add it to a queue_set_t
+     *
+     * @return
+     */
+    inline xQueueHandle handle() const
+    {
+        return queue.handle();
+    }
+
+private:
+    queue_t<Class*> queue;
+};
+
+} //namespace thread {
+} //namespace esp_open_rtos {
+
+#endif	/* ESP_OPEN_RTOS_PTR_QUEUE_HPP */
@@ -67,6 +67,25 @@ public:
             return 0;
         }
     }
+    /**
+     * Create the queue in caller supplied memory
+     * 
+     * @param uxQueueLength
+     * @param pucQueueStorage   uxQueueLength * sizeof(Data) bytes
+     * @param pxQueueBuffer
+     * @return 
+     */
+    inline int queue_create_static(unsigned portBASE_TYPE uxQueueLength, unsigned char* pucQueueStorage, StaticQueue_t* pxQueueBuffer)
+    {
+        queue = xQueueCreateStatic(uxQueueLength, sizeof(Data), pucQueueStorage, pxQueueBuffer);
+        
+        if(queue == NULL) {
+            return -1;
+        }
+        else {
+            return 0;
+        }
+    }
     /**
      * 
      */
@@ -95,6 +114,15 @@ public:
     {
         return (xQueueReceive(queue, &data, ms / portTICK_RATE_MS) == pdTRUE) ? 0 : -1;
     }
+    /**
+     * The FreeRTOS queue, to add it to a queue_set_t
+     * 
+     * @return 
+     */
+    inline xQueueHandle handle() const
+    {
+        return queue;
+    }
     /**
      * 
      * @param other
@@ -116,6 +144,29 @@ private:
     queue_t (const queue_t&);
 };
 
+/******************************************************************************************************************
+ * class static_queue_t
+ *
+ * A queue_t of Length items carrying its own memory.
+ */
+template<class Data, unsigned portBASE_TYPE Length>
+class static_queue_t : public queue_t<Data>
+{
+public:
+    /**
+     * 
+     * @return 
+     */
+    inline int queue_create()
+    {
+        return this->queue_create_static(Length, storage, &buffer);
+    }
+
+private:
+    unsigned char   storage[Length * sizeof(Data)];
+    StaticQueue_t   buffer;
+};
+
 } //namespace thread {
 } //namespace esp_open_rtos {
 
@@ -0,0 +1,137 @@
+/*
+ * Queue sets
+ *
+ * queue_set_t blocks on several queues and semaphores at once, and says
+ * which one has something to read, so one task can serve them all:
+ *
+ *     queue_t<char> rx;                    // rx.queue_create(16)
+ *     ptr_queue_t<message_t> messages;     // messages.queue_create(4)
+ *     queue_set_t set;
+ *
+ *     set.queue_set_create(16 + 4);        // room for every member's items
+ *     set.add(rx);
+ *     set.add(messages);
+ *
+ *     xQueueSetMemberHandle ready = set.select(1000);
+ *     if(ready == rx.handle()) {
+ *         rx.receive(c);                   // doesn't block
+ *     }
+ *
+ * Only read a member after select() returned it, one item each time.
+ * Members must be empty when they are added, and can't be mutexes.
+ * configUSE_QUEUE_SETS in FreeRTOSConfig.h must be 1.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+
+#ifndef ESP_OPEN_RTOS_QUEUE_SET_HPP
+#define	ESP_OPEN_RTOS_QUEUE_SET_HPP
+
+#include "FreeRTOS.h"
+#include "queue.h"
+
+namespace esp_open_rtos {
+namespace thread {
+
+/******************************************************************************************************************
+ * class queue_set_t
+ *
+ */
+class queue_set_t
+{
+public:
+    /**
+     *
+     */
+    inline queue_set_t()
+    {
+        set = 0;
+    }
+    /**
+     *
+     * @param uxEventQueueLength    the sum of the lengths of the members
+     *                              (1 for a binary semaphore)
+     * @return
+     */
+    inline int queue_set_create(unsigned portBASE_TYPE uxEventQueueLength)
+    {
+        set = xQueueCreateSet(uxEventQueueLength);
+
+        if(set == NULL) {
+            return -1;
+        }
+        else {
+            return 0;
+        }
+    }
+    /**
+     * The members must be removed or deleted first
+     */
+    inline void queue_set_destroy()
+    {
+        vQueueDelete(set);
+        set = 0;
+    }
+    /**
+     * Add a queue_t, ptr_queue_t or anything else with a handle()
+     *
+     * @param member
+     * @return -1 if it's in a set already or isn't empty
+     */
+    template<class Member>
+    inline int add(Member& member)
+    {
+        return add(member.handle());
+    }
+    inline int add(xQueueSetMemberHandle member)
+    {
+        return (xQueueAddToSet(member, set) == pdPASS) ? 0 : -1;
+    }
+    /**
+     *
+     * @param member
+     * @return -1 if it isn't in this set or isn't empty
+     */
+    template<class Member>
+    inline int remove(Member& member)
+    {
+        return remove(member.handle());
+    }
+    inline int remove(xQueueSetMemberHandle member)
+    {
+        return (xQueueRemoveFromSet(member, set) == pdPASS) ? 0 : -1;
+    }
+    /**
+     * Wait up to 'ms' for a member to have something to read
+     *
+     * @param ms
+     * @return the member, NULL on timeout
+     */
+    inline xQueueSetMemberHandle select(unsigned long ms = 0)
+    {
+        return xQueueSelectFromSet(set, ms / portTICK_RATE_MS);
+    }
+    /**
+     *
+     * @return the member, NULL if none has anything to read
+     */
+    inline xQueueSetMemberHandle select_from_isr()
+    {
+        return xQueueSelectFromSetFromISR(set);
+    }
+
+private:
+    xQueueSetHandle set;
+
+    // Disable copy construction and assignment.
+    queue_set_t (const queue_set_t&);
+    const queue_set_t &operator = (const queue_set_t&);
+};
+
+} //namespace thread {
+} //namespace esp_open_rtos {
+
+
+#endif	/* ESP_OPEN_RTOS_QUEUE_SET_HPP */
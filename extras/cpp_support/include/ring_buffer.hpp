@@ -0,0 +1,148 @@
+/*
+ * Lock-free single producer / single consumer ring buffer
+ *
+ * One side (a task or an interrupt handler) only calls push(), the other
+ * only calls pop()/peek(), and neither needs a critical section: the
+ * producer only writes 'head' and the consumer only writes 'tail'. Each
+ * element is copied once in and once out, with no heap use.
+ *
+ * Relies on the ESP8266 being a single, in order core, so a compiler
+ * barrier is enough to order the element copy against the index update.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+
+#ifndef ESP_OPEN_RTOS_RING_BUFFER_HPP
+#define	ESP_OPEN_RTOS_RING_BUFFER_HPP
+
+#include <stddef.h>
+
+namespace esp_open_rtos {
+namespace thread {
+
+/******************************************************************************************************************
+ * class ring_buffer_t
+ *
+ * Holds up to Size items of Data, Size must be a power of two.
+ */
+template<class Data, size_t Size>
+class ring_buffer_t
+{
+    // Fails to compile unless Size is a power of two
+    typedef char size_must_be_a_power_of_two[(Size > 0 && (Size & (Size - 1)) == 0) ? 1 : -1];
+
+public:
+    /**
+     *
+     */
+    inline ring_buffer_t()
+    {
+        head = 0;
+        tail = 0;
+    }
+    /**
+     * Producer side, callable from an interrupt handler
+     *
+     * @param data
+     * @return false if full
+     */
+    inline bool push(const Data& data)
+    {
+        size_t h = head;
+
+        if(h - tail == Size) {
+            return false;
+        }
+        items[h & (Size - 1)] = data;
+        barrier();
+        head = h + 1;
+
+        return true;
+    }
+    /**
+     * Consumer side, callable from an interrupt handler
+     *
+     * @param data
+     * @return false if empty
+     */
+    inline bool pop(Data& data)
+    {
+        size_t t = tail;
+
+        if(head == t) {
+            return false;
+        }
+        barrier();
+        data = items[t & (Size - 1)];
+        barrier();
+        tail = t + 1;
+
+        return true;
+    }
+    /**
+     * Consumer side, the oldest item without removing it
+     *
+     * @return NULL if empty
+     */
+    inline const Data* peek() const
+    {
+        size_t t = tail;
+
+        if(head == t) {
+            return NULL;
+        }
+        barrier();
+        return (const Data*)&items[t & (Size - 1)];
+    }
+    /**
+     * Consumer side, drop everything pushed so far
+     */
+    inline void clear()
+    {
+        tail = head;
+    }
+    /**
+     * Exact from either side, a lower bound for the consumer and an upper
+     * bound for the producer while the other side runs
+     *
+     * @return
+     */
+    inline size_t count() const
+    {
+        return head - tail;
+    }
+    inline bool empty() const
+    {
+        return head == tail;
+    }
+    inline bool full() const
+    {
+        return head - tail == Size;
+    }
+    inline static size_t capacity()
+    {
+        return Size;
+    }
+
+private:
+    inline static void barrier()
+    {
+        __asm__ volatile ("" ::: "memory");
+    }
+
+    // Free running, wrap at the size_t range which Size divides
+    volatile size_t head;
+    volatile size_t tail;
+    Data            items[Size];
+
+    // Disable copying, the buffer is shared by address
+    ring_buffer_t (const ring_buffer_t&);
+    const ring_buffer_t &operator = (const ring_buffer_t&);
+};
+
+} //namespace thread {
+} //namespace esp_open_rtos {
+
+#endif	/* ESP_OPEN_RTOS_RING_BUFFER_HPP */
@@ -0,0 +1,211 @@
+/*
+ * Fixed capacity vector
+ *
+ * small_vector_t<T, Capacity> is a vector whose elements live inside
+ * the object, constructed and destroyed one at a time as it grows and
+ * shrinks, so T needn't have a default constructor and nothing is ever
+ * allocated. Where std::vector would reallocate, push_back() returns
+ * false instead:
+ *
+ *     small_vector_t<peer_t, 8> peers;
+ *     if(!peers.push_back(peer)) { ... all 8 in use }
+ *     for(peer_t* p = peers.begin(); p != peers.end(); p++) { ... }
+ *
+ * The elements are contiguous, so iterating is a plain pointer walk and
+ * a small_vector_t of PODs makes a compact table for linear search. Not
+ * thread safe.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+
+#ifndef ESP_OPEN_RTOS_SMALL_VECTOR_HPP
+#define	ESP_OPEN_RTOS_SMALL_VECTOR_HPP
+
+#include <stddef.h>
+#include <new>
+
+namespace esp_open_rtos {
+namespace container {
+
+/******************************************************************************************************************
+ * class small_vector_t
+ *
+ */
+template<class T, size_t Capacity>
+class small_vector_t
+{
+    // Fails to compile for an empty vector
+    typedef char capacity_must_not_be_zero[Capacity > 0 ? 1 : -1];
+
+public:
+    /**
+     *
+     */
+    inline small_vector_t()
+    {
+        count = 0;
+    }
+    inline ~small_vector_t()
+    {
+        clear();
+    }
+    inline small_vector_t(const small_vector_t& other)
+    {
+        count = 0;
+        for(size_t i = 0; i < other.count; i++) {
+            push_back(other[i]);
+        }
+    }
+    inline const small_vector_t& operator=(const small_vector_t& other)
+    {
+        if(this != &other) {
+            clear();
+            for(size_t i = 0; i < other.count; i++) {
+                push_back(other[i]);
+            }
+        }
+        return *this;
+    }
+    /**
+     * @return false if full
+     */
+    inline bool push_back(const T& value)
+    {
+        if(count == Capacity) {
+            return false;
+        }
+        new (&data()[count]) T(value);
+        count++;
+        return true;
+    }
+    /**
+     * Does nothing if empty
+     */
+    inline void pop_back()
+    {
+        if(count) {
+            data()[--count].~T();
+        }
+    }
+    /**
+     * Insert 'value' before element 'index', moving the rest up
+     *
+     * @return false if full, or 'index' is past the end
+     */
+    inline bool insert(size_t index, const T& value)
+    {
+        if(count == Capacity || index > count) {
+            return false;
+        }
+        if(index == count) {
+            return push_back(value);
+        }
+        T* d = data();
+        new (&d[count]) T(d[count - 1]);
+        for(size_t i = count - 1; i > index; i--) {
+            d[i] = d[i - 1];
+        }
+        d[index] = value;
+        count++;
+        return true;
+    }
+    /**
+     * Remove element 'index', moving the rest down
+     */
+    inline void erase(size_t index)
+    {
+        if(index >= count) {
+            return;
+        }
+        T* d = data();
+        for(size_t i = index; i + 1 < count; i++) {
+            d[i] = d[i + 1];
+        }
+        d[--count].~T();
+    }
+    /**
+     * Remove element 'index' by moving the last one into its place, O(1)
+     * where the order doesn't matter
+     */
+    inline void erase_unordered(size_t index)
+    {
+        if(index >= count) {
+            return;
+        }
+        T* d = data();
+        if(index != count - 1) {
+            d[index] = d[count - 1];
+        }
+        d[--count].~T();
+    }
+    inline void clear()
+    {
+        while(count) {
+            pop_back();
+        }
+    }
+    inline T& operator[](size_t index)
+    {
+        return data()[index];
+    }
+    inline const T& operator[](size_t index) const
+    {
+        return data()[index];
+    }
+    inline T& back()
+    {
+        return data()[count - 1];
+    }
+    inline T* begin()
+    {
+        return data();
+    }
+    inline T* end()
+    {
+        return data() + count;
+    }
+    inline const T* begin() const
+    {
+        return data();
+    }
+    inline const T* end() const
+    {
+        return data() + count;
+    }
+    inline size_t size() const
+    {
+        return count;
+    }
+    inline bool empty() const
+    {
+        return count == 0;
+    }
+    inline bool full() const
+    {
+        return count == Capacity;
+    }
+    inline static size_t capacity()
+    {
+        return Capacity;
+    }
+
+private:
+    inline T* data()
+    {
+        return (T*)storage;
+    }
+    inline const T* data() const
+    {
+        return (const T*)storage;
+    }
+
+    size_t  count;
+    char    storage[Capacity * sizeof(T)] __attribute__((aligned(__alignof__(T))));
+};
+
+} //namespace container {
+} //namespace esp_open_rtos {
+
+#endif	/* ESP_OPEN_RTOS_SMALL_VECTOR_HPP */
@@ -31,6 +31,7 @@
 
 #include "FreeRTOS.h"
 #include "task.h"
+#include "esp/hrtimer.h"
 
 namespace esp_open_rtos {
 namespace thread {
@@ -58,6 +59,21 @@ public:
     {
         return xTaskCreate(task_t::_task, (signed char *)pcName, usStackDepth, this, uxPriority, NULL);
     }
+    /**
+     * Create the task in caller supplied memory (see xTaskCreateStatic)
+     * 
+     * @param pcName
+     * @param puxStackBuffer    usStackDepth words of stack
+     * @param usStackDepth
+     * @param pxTaskBuffer
+     * @param uxPriority
+     * @return 
+     */
+    int task_create_static(const char* const pcName, portSTACK_TYPE* puxStackBuffer, unsigned short usStackDepth, StaticTask_t* pxTaskBuffer, unsigned portBASE_TYPE uxPriority = 2)
+    {
+        xTaskHandle handle = xTaskCreateStatic(task_t::_task, (signed char *)pcName, usStackDepth, this, uxPriority, puxStackBuffer, pxTaskBuffer);
+        return (handle != NULL) ? pdPASS : errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
+    }
     
 protected:
     /**
@@ -76,6 +92,15 @@ protected:
     {
         return xTaskGetTickCount() * portTICK_RATE_MS;
     }
+    /**
+     * Microseconds from the hrtimer clock, see chrono.hpp
+     * 
+     * @return 
+     */
+    inline uint64_t micros()
+    {
+        return hrtimer_now_us64();
+    }
     
 private:
     /**
@@ -98,6 +123,32 @@ private:
     task_t &operator=(const task_t&);    
 };
 
+/******************************************************************************************************************
+ * static_task_t
+ *
+ * A task_t carrying its own stack and TCB, for tasks that are global objects
+ * and so never use the heap.
+ */
+template<unsigned short StackDepth = 256>
+class static_task_t : public task_t
+{
+public:
+    /**
+     * 
+     * @param pcName
+     * @param uxPriority
+     * @return 
+     */
+    int task_create(const char* const pcName, unsigned portBASE_TYPE uxPriority = 2)
+    {
+        return task_create_static(pcName, stack, StackDepth, &tcb, uxPriority);
+    }
+
+private:
+    portSTACK_TYPE  stack[StackDepth];
+    StaticTask_t    tcb;
+};
+
 } //namespace thread {
 } //namespace esp_open_rtos {
 
@@ -0,0 +1,9 @@
+# Component makefile for extras/cpufreq
+
+# expected anyone using cpufreq includes it as 'cpufreq/cpufreq.h'
+INC_DIRS += $(cpufreq_ROOT)..
+
+# args for passing into compile rule generation
+cpufreq_SRC_DIR =  $(cpufreq_ROOT)
+
+$(eval $(call component_compile_rules,cpufreq))
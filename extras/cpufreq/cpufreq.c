@@ -0,0 +1,105 @@
+/* CPU frequency governor, see cpufreq.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "cpufreq.h"
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <esp/clocks.h>
+
+#if configGENERATE_RUN_TIME_STATS != 1
+#error "extras/cpufreq needs configGENERATE_RUN_TIME_STATS 1 in the program's FreeRTOSConfig.h"
+#endif
+
+static cpufreq_config_t config;
+static cpufreq_stats_t stats;
+static xTaskHandle task;
+
+/* Percent of the time since the last call not spent idle */
+static uint8_t sample_load(unsigned long *last_idle, unsigned long *last_total)
+{
+    unsigned long idle = ulTaskGetIdleRunTimeCounter();
+    unsigned long total = portGET_RUN_TIME_COUNTER_VALUE();
+    unsigned long idle_delta = idle - *last_idle;
+    unsigned long elapsed = total - *last_total;
+
+    *last_idle = idle;
+    *last_total = total;
+    if (!elapsed)
+        return 0;
+    if (idle_delta > elapsed)
+        idle_delta = elapsed;
+    return 100 - (uint32_t)((uint64_t)idle_delta * 100 / elapsed);
+}
+
+static void governor_task(void *pvParameters)
+{
+    unsigned long last_idle = ulTaskGetIdleRunTimeCounter();
+    unsigned long last_total = portGET_RUN_TIME_COUNTER_VALUE();
+    portTickType wake = xTaskGetTickCount();
+    uint8_t above = 0, below = 0;
+
+    while (1) {
+        vTaskDelayUntil(&wake, config.sample_ms / portTICK_RATE_MS);
+
+        uint8_t load = sample_load(&last_idle, &last_total);
+        stats.load = load;
+
+        if (cpu_clk_freq() == CPU_CLK_FREQ) {
+            below = 0;
+            above = load >= config.up_percent ? above + 1 : 0;
+            if (above >= config.up_samples) {
+                above = 0;
+                cpu_set_freq(160);
+                stats.raises++;
+            }
+        } else {
+            stats.ms_at_160 += config.sample_ms;
+            above = 0;
+            below = load <= config.down_percent ? below + 1 : 0;
+            if (below >= config.down_samples) {
+                below = 0;
+                cpu_set_freq(80);
+                stats.lowers++;
+            }
+        }
+    }
+}
+
+bool cpufreq_start(const cpufreq_config_t *c, unsigned priority)
+{
+    static const cpufreq_config_t defaults = CPUFREQ_DEFAULT_CONFIG;
+
+    if (!c)
+        c = &defaults;
+    if (c->up_percent > 100 || c->down_percent * 2 >= c->up_percent ||
+        !c->up_samples || !c->down_samples || c->sample_ms < portTICK_RATE_MS)
+        return false;
+
+    portSCHEDULER_LOCK();
+    config = *c;
+    portSCHEDULER_UNLOCK();
+
+    if (task) {
+        vTaskPrioritySet(task, priority);
+        return true;
+    }
+    return xTaskCreate(governor_task, (signed char *)"cpufreq", 256, NULL, priority, &task) == pdPASS;
+}
+
+void cpufreq_stop(void)
+{
+    if (task) {
+        vTaskDelete(task);
+        task = NULL;
+    }
+    cpu_set_freq(80);
+}
+
+void cpufreq_stats(cpufreq_stats_t *out)
+{
+    *out = stats;
+}
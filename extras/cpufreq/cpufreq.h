@@ -0,0 +1,78 @@
+/* CPU frequency governor: 160MHz under load, 80MHz otherwise
+ *
+ * A task samples the CPU load every sample_ms, from the idle task's
+ * share of the CCOUNT run time counter (ulTaskGetIdleRunTimeCounter()),
+ * and switches the clock with cpu_set_freq(), which tells the drivers
+ * registered with cpu_freq_register(). Bursts of work (TLS handshakes,
+ * bulk transfers) get the fast clock, and the rest of the time the CPU
+ * draws the 80MHz current, with no application changes.
+ *
+ * The clock goes up after up_samples samples in a row at or above
+ * up_percent, and back down after down_samples in a row at or below
+ * down_percent. Loads are as measured at the clock of the time, so the
+ * same work shows about half the load at 160MHz: down_percent must be
+ * below half of up_percent, or the governor would switch straight back
+ * down. Raising fast and lowering slowly (the defaults) favours
+ * latency; more up_samples saves more power on short bursts.
+ *
+ * Needs the run time counter: put
+ *
+ *     #define configGENERATE_RUN_TIME_STATS 1
+ *
+ * in the program's own FreeRTOSConfig.h, see examples/cpufreq_governor.
+ * Don't use it with wifi_power_set_profile(), which sets the clock
+ * itself, or by changing the clock elsewhere.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _CPUFREQ_H
+#define _CPUFREQ_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint8_t up_percent;
+    uint8_t down_percent;
+    uint8_t up_samples;
+    uint8_t down_samples;
+    uint16_t sample_ms;
+} cpufreq_config_t;
+
+#define CPUFREQ_DEFAULT_CONFIG { \
+    .up_percent = 70,            \
+    .down_percent = 25,          \
+    .up_samples = 2,             \
+    .down_samples = 10,          \
+    .sample_ms = 100,            \
+}
+
+typedef struct {
+    uint32_t raises;            /* switches to 160MHz */
+    uint32_t lowers;            /* switches to 80MHz */
+    uint32_t ms_at_160;         /* time spent at 160MHz */
+    uint8_t load;               /* of the last sample, percent */
+} cpufreq_stats_t;
+
+/* Start the governor task at 'priority' (above the tasks whose load it
+   measures, for prompt samples) with 'config', or the defaults if NULL.
+   Returns false if the thresholds are out of range (see above) or out
+   of memory. Starting it again changes the configuration. */
+bool cpufreq_start(const cpufreq_config_t *config, unsigned priority);
+
+/* Stop the governor, leaving the clock at 80MHz */
+void cpufreq_stop(void);
+
+void cpufreq_stats(cpufreq_stats_t *stats);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _CPUFREQ_H */
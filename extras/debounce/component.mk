@@ -0,0 +1,9 @@
+# Component makefile for extras/debounce
+
+# expected anyone using debounce includes it as 'debounce/debounce.h'
+INC_DIRS += $(debounce_ROOT)..
+
+# args for passing into compile rule generation
+debounce_SRC_DIR =  $(debounce_ROOT)
+
+$(eval $(call component_compile_rules,debounce))
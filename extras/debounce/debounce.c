@@ -0,0 +1,104 @@
+/* GPIO debouncing on the microsecond timer service, see debounce.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "debounce.h"
+
+#include <task.h>
+#include <esp/gpio.h>
+#include <esp/hrtimer.h>
+#include <common_macros.h>
+
+#define PINS 16
+
+typedef struct {
+    hrtimer_t timer;
+    uint32_t settle_us;
+    uint32_t first_us;          /* first edge since the pin was last quiet */
+    uint8_t gpio_num;
+    bool in_use;
+    volatile bool stable;
+} debounced_pin_t;
+
+static debounced_pin_t pins[PINS];
+static xQueueHandle queue;
+static volatile uint32_t dropped;
+
+/* Quiet for the settle time */
+static void IRAM settled(hrtimer_t *timer, void *arg)
+{
+    debounced_pin_t *p = arg;
+    bool level = gpio_read(p->gpio_num);
+
+    if (level == p->stable)
+        return;
+    p->stable = level;
+
+    debounce_event_t ev = {
+        .time_us = p->first_us,
+        .gpio_num = p->gpio_num,
+        .level = level,
+    };
+    portBASE_TYPE woken = pdFALSE;
+    if (xQueueSendToBackFromISR(queue, &ev, &woken) != pdTRUE)
+        dropped++;
+    if (woken)
+        portYIELD();
+}
+
+static void IRAM edge(uint8_t gpio_num, void *arg)
+{
+    debounced_pin_t *p = arg;
+
+    if (!hrtimer_active(&p->timer))
+        p->first_us = hrtimer_now_us();
+    /* Restarts it if it's already running */
+    if (!hrtimer_start(&p->timer, p->settle_us, 0))
+        dropped++;
+}
+
+void debounce_init(xQueueHandle events)
+{
+    queue = events;
+}
+
+void debounce_add(uint8_t gpio_num, uint32_t settle_us, bool pullup)
+{
+    debounced_pin_t *p = &pins[gpio_num];
+
+    debounce_remove(gpio_num);
+    gpio_enable(gpio_num, GPIO_INPUT);
+    gpio_set_pullup(gpio_num, pullup, pullup);
+
+    hrtimer_init(&p->timer, settled, p);
+    p->settle_us = settle_us;
+    p->gpio_num = gpio_num;
+    p->stable = gpio_read(gpio_num);
+    /* Starts the timer service, so the interrupt doesn't */
+    p->first_us = hrtimer_now_us();
+    p->in_use = true;
+    gpio_set_interrupt_handler(gpio_num, GPIO_INTTYPE_EDGE_ANY, edge, p);
+}
+
+void debounce_remove(uint8_t gpio_num)
+{
+    debounced_pin_t *p = &pins[gpio_num];
+
+    if (!p->in_use)
+        return;
+    gpio_set_interrupt_handler(gpio_num, GPIO_INTTYPE_NONE, NULL, NULL);
+    hrtimer_stop(&p->timer);
+    p->in_use = false;
+}
+
+bool debounce_level(uint8_t gpio_num)
+{
+    return pins[gpio_num].stable;
+}
+
+uint32_t debounce_dropped(void)
+{
+    return dropped;
+}
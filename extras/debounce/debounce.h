@@ -0,0 +1,70 @@
+/* GPIO debouncing on the microsecond timer service
+ *
+ * One service for any number of buttons and contacts: every edge on a
+ * pin restarts a one-shot esp/hrtimer for that pin, so the pin is only
+ * read once it has been quiet for its settle time, and an event goes to
+ * the queue only if that level differs from the last one reported. The
+ * bounce of a contact is absorbed in interrupts and never reaches a
+ * task, whichever task (one for all the pins) reads the queue:
+ *
+ *     xQueueHandle events = xQueueCreate(8, sizeof(debounce_event_t));
+ *     debounce_init(events);
+ *     debounce_add(0, 20000, true);       // GPIO0, 20 ms, pull-up
+ *     debounce_add(4, 20000, true);
+ *     for (;;) {
+ *         debounce_event_t ev;
+ *         xQueueReceive(events, &ev, portMAX_DELAY);
+ *         ...
+ *     }
+ *
+ * A press that bounces and settles back where it started sends
+ * nothing. The event's timestamp is the first edge of the change.
+ *
+ * Each pin bouncing takes one of the HRTIMER_MAX timer slots until it
+ * settles; if none are free the edge isn't debounced but the next one
+ * tries again. Events that don't fit in the queue are counted as
+ * dropped.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _DEBOUNCE_H
+#define _DEBOUNCE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <FreeRTOS.h>
+#include <queue.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t time_us;           /* hrtimer_now_us() at the first edge */
+    uint8_t gpio_num;
+    bool level;                 /* the new stable level */
+} debounce_event_t;
+
+/* Set the queue (of debounce_event_t) events go to */
+void debounce_init(xQueueHandle events);
+
+/* Start debouncing GPIO 'gpio_num' (0-15), as an input, optionally
+   pulled up. Its level now is taken as the stable one. */
+void debounce_add(uint8_t gpio_num, uint32_t settle_us, bool pullup);
+
+void debounce_remove(uint8_t gpio_num);
+
+/* The last stable level of a pin */
+bool debounce_level(uint8_t gpio_num);
+
+/* Events lost because the queue was full, or edges that found no free
+   timer */
+uint32_t debounce_dropped(void);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _DEBOUNCE_H */
@@ -3,69 +3,94 @@
  * Based on RFC2131 http://www.ietf.org/rfc/rfc2131.txt
  * ... although not fully RFC compliant yet.
  *
+ * The server runs entirely in tcpip_thread, as a raw API UDP receive
+ * callback, so it needs no task or stack of its own. Requests are
+ * parsed in place in the received pbuf.
+ *
+ * Leases are stored by address offset (lease N is first_client_addr +
+ * N), indexed by a MAC address hash, and expired by a timer wheel:
+ * bound leases sit on the wheel slot of their expiry tick, so each
+ * tick only looks at the leases due then. Free leases are kept on a
+ * list so finding one for a new client doesn't scan either.
+ *
  * TODO
  * * Allow binding on a single interface only (for mixed AP/client mode), lwip seems to make it hard to
- *   listen for or send broadcasts on a specific interface only.
- *
- * * Probably allocates more memory than it should, it should be possible to reuse netbufs in most cases.
+ *   listen for or send broadcasts on a specific interface only. Replies do go out on the interface the
+ *   request arrived on.
  *
  * Part of esp-open-rtos
  * Copyright (C) 2015 Superhouse Automation Pty Ltd
  * BSD Licensed as described in the file LICENSE
  */
 #include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
 
 #include <FreeRTOS.h>
-#include <task.h>
 #include <lwip/netif.h>
-#include <lwip/api.h>
-
-/* Grow the size of the lwip dhcp_msg struct's options field, as LWIP
-   defaults to a 68 octet options field for its DHCP client, and most
-   full-sized clients send us more than this. */
-#define DHCP_OPTIONS_LEN 312
-
+#include <lwip/udp.h>
+#include <lwip/ip.h>
+#include <lwip/tcpip.h>
+#include <lwip/timers.h>
 #include <lwip/dhcp.h>
 
-_Static_assert(sizeof(struct dhcp_msg) == offsetof(struct dhcp_msg, options) + 312, "dhcp_msg_t should have extended options size");
+#include "dhcpserver.h"
 
-#include <lwip/netbuf.h>
+/* Number of timer wheel slots. Every lease has the same duration, so
+   with one wheel revolution per lease time each slot only ever holds
+   leases that are due on that tick. */
+#define WHEEL_SLOTS 32
+#define WHEEL_TICK_MS ((DHCPSERVER_LEASE_TIME * 1000 + WHEEL_SLOTS - 1) / WHEEL_SLOTS)
 
-#include "dhcpserver.h"
+/* Options space reserved in replies, makes replies at least the 300
+   octet minimum BOOTP message size that some clients insist on */
+#define REPLY_OPTIONS_LEN 64
+#define REPLY_LEN (offsetof(struct dhcp_msg, options) + REPLY_OPTIONS_LEN)
+
+#define NO_LEASE 0xff
 
 typedef struct {
     uint8_t hwaddr[NETIF_MAX_HWADDR_LEN];
-    uint32_t expires;
+    uint8_t bound;
+    uint8_t hash_next;  /* next lease in the same hash bucket */
+    uint8_t prev, next; /* wheel slot list if bound, free list otherwise */
+    uint32_t expires;   /* wheel tick */
 } dhcp_lease_t;
 
 typedef struct {
-    struct netconn *nc;
+    struct udp_pcb *pcb;
     uint8_t max_leases;
+    uint8_t hash_mask;
+    uint8_t free_head;
     ip_addr_t first_client_addr;
-    struct netif *server_if;
+    uint32_t tick;
+    uint8_t wheel[WHEEL_SLOTS];
+    uint8_t *hash;        /* length hash_mask + 1 */
     dhcp_lease_t *leases; /* length max_leases */
 } server_state_t;
 
-/* Only one DHCP server task can run at once, so we have global state
-   for it.
+/* Only one DHCP server can run at once, so we have global state
+   for it. Only touched from tcpip_thread.
 */
-static xTaskHandle dhcpserver_task_handle;
 static server_state_t *state;
 
+/* Router and DNS server options for clients, not sent while zero */
+static ip_addr_t router_addr;
+static ip_addr_t dns_addr;
+
 /* Handlers for various kinds of incoming DHCP messages */
-static void handle_dhcp_discover(struct dhcp_msg *received);
-static void handle_dhcp_request(struct dhcp_msg *dhcpmsg);
+static void handle_dhcp_discover(struct netif *netif, struct dhcp_msg *received, u16_t len);
+static void handle_dhcp_request(struct netif *netif, struct dhcp_msg *dhcpmsg, u16_t len);
 static void handle_dhcp_release(struct dhcp_msg *dhcpmsg);
 
-static void send_dhcp_nak(struct dhcp_msg *dhcpmsg);
-
-static void dhcpserver_task(void *pxParameter);
+static void send_dhcp_reply(struct netif *netif, struct dhcp_msg *request, uint8_t type,
+                            const ip_addr_t *yiaddr);
 
 /* Utility functions */
-static uint8_t *find_dhcp_option(struct dhcp_msg *msg, uint8_t option_num, uint8_t min_length, uint8_t *length);
+static uint8_t *find_dhcp_option(struct dhcp_msg *msg, u16_t msg_len, uint8_t option_num, uint8_t min_length, uint8_t *length);
 static uint8_t *add_dhcp_option_byte(uint8_t *opt, uint8_t type, uint8_t value);
 static uint8_t *add_dhcp_option_bytes(uint8_t *opt, uint8_t type, void *value, uint8_t len);
-static dhcp_lease_t *find_lease_slot(uint8_t *hwaddr);
+static dhcp_lease_t *find_lease(const uint8_t *hwaddr);
 
 /* Copy IP address as dotted decimal to 'dest', must be at least 16 bytes long */
 inline static void sprintf_ipaddr(const ip_addr_t *addr, char *dest)
@@ -77,145 +102,271 @@ inline static void sprintf_ipaddr(const ip_addr_t *addr, char *dest)
                 ip4_addr2(addr), ip4_addr3(addr), ip4_addr4(addr));
 }
 
-void dhcpserver_start(const ip_addr_t *first_client_addr, uint8_t max_leases)
+static inline uint8_t lease_index(const dhcp_lease_t *lease)
 {
-    /* Stop any existing running dhcpserver */
-    if(dhcpserver_task_handle)
-        dhcpserver_stop();
+    return lease - state->leases;
+}
 
-    state = malloc(sizeof(server_state_t));
-    state->max_leases = max_leases;
-    state->leases = calloc(max_leases, sizeof(dhcp_lease_t));
-    // state->server_if is assigned once the task is running - see comment in dhcpserver_task()
-    ip_addr_copy(state->first_client_addr, *first_client_addr);
+static uint8_t hash_hwaddr(const uint8_t *hwaddr)
+{
+    uint32_t h = 2166136261u; /* FNV-1a */
+    for(int i = 0; i < 6; i++)
+        h = (h ^ hwaddr[i]) * 16777619u;
+    return h & state->hash_mask;
+}
 
-    xTaskCreate(dhcpserver_task, (signed char *)"DHCPServer", 768, NULL, 8, &dhcpserver_task_handle);
+/* Doubly linked lists of lease indexes, for the free list and the wheel */
+static void list_insert(uint8_t *head, uint8_t i)
+{
+    dhcp_lease_t *lease = &state->leases[i];
+    lease->prev = NO_LEASE;
+    lease->next = *head;
+    if(*head != NO_LEASE)
+        state->leases[*head].prev = i;
+    *head = i;
 }
 
-void dhcpserver_stop(void)
+static void list_remove(uint8_t *head, uint8_t i)
 {
-    if(dhcpserver_task_handle) {
-        vTaskDelete(dhcpserver_task_handle);
-        free(state);
-        dhcpserver_task_handle = NULL;
+    dhcp_lease_t *lease = &state->leases[i];
+    if(lease->prev != NO_LEASE)
+        state->leases[lease->prev].next = lease->next;
+    else
+        *head = lease->next;
+    if(lease->next != NO_LEASE)
+        state->leases[lease->next].prev = lease->prev;
+}
+
+static void hash_remove(dhcp_lease_t *lease)
+{
+    uint8_t i = lease_index(lease);
+    uint8_t *link = &state->hash[hash_hwaddr(lease->hwaddr)];
+    while(*link != NO_LEASE) {
+        if(*link == i) {
+            *link = lease->hash_next;
+            return;
+        }
+        link = &state->leases[*link].hash_next;
     }
 }
 
-static void dhcpserver_task(void *pxParameter)
+static void lease_bind(dhcp_lease_t *lease, const uint8_t *hwaddr, uint8_t hlen)
 {
-    /* netif_list isn't assigned until after user_init completes, which is why we do it inside the task */
-    state->server_if = netif_list; /* TODO: Make this configurable */
+    uint8_t i = lease_index(lease);
 
-    state->nc = netconn_new (NETCONN_UDP);
-    if(!state->nc) {
-        printf("OTA TFTP: Failed to allocate socket.\r\n");
-        return;
+    if(lease->bound) {
+        list_remove(&state->wheel[lease->expires % WHEEL_SLOTS], i);
+    } else {
+        list_remove(&state->free_head, i);
+        memset(lease->hwaddr, 0, sizeof(lease->hwaddr));
+        memcpy(lease->hwaddr, hwaddr, hlen);
+        uint8_t bucket = hash_hwaddr(lease->hwaddr);
+        lease->hash_next = state->hash[bucket];
+        state->hash[bucket] = i;
+        lease->bound = 1;
     }
+    lease->expires = state->tick + WHEEL_SLOTS;
+    list_insert(&state->wheel[lease->expires % WHEEL_SLOTS], i);
+}
 
-    netconn_bind(state->nc, IP_ADDR_ANY, DHCP_SERVER_PORT);
+static void lease_free(dhcp_lease_t *lease)
+{
+    uint8_t i = lease_index(lease);
 
-    while(1)
-    {
-        struct netbuf *netbuf;
-        struct dhcp_msg received = { 0 };
+    if(!lease->bound)
+        return;
+    list_remove(&state->wheel[lease->expires % WHEEL_SLOTS], i);
+    hash_remove(lease);
+    lease->bound = 0;
+    list_insert(&state->free_head, i);
+}
 
-        /* Receive a DHCP packet */
-        err_t err = netconn_recv(state->nc, &netbuf);
-        if(err != ERR_OK) {
-            printf("DHCP Server Error: Failed to receive DHCP packet. err=%d\r\n", err);
-            continue;
-        }
+static void wheel_tick(void *arg)
+{
+    state->tick++;
+    uint8_t i = state->wheel[state->tick % WHEEL_SLOTS];
+    while(i != NO_LEASE) {
+        dhcp_lease_t *lease = &state->leases[i];
+        i = lease->next;
+        if(lease->expires == state->tick)
+            lease_free(lease);
+    }
+    sys_timeout(WHEEL_TICK_MS, wheel_tick, NULL);
+}
 
-        /* expire any leases that have passed */
-        uint32_t now = xTaskGetTickCount();
-        for(int i = 0; i < state->max_leases; i++) {
-            uint32_t expires = state->leases[i].expires;
-            if(expires && expires < now)
-                state->leases[i].expires = 0;
+static void dhcpserver_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *addr, u16_t port)
+{
+    struct netif *netif = ip_current_netif();
+
+    if(p->len != p->tot_len) {
+        /* Options are parsed in place, so the message must be contiguous */
+        struct pbuf *q = pbuf_coalesce(p, PBUF_RAW);
+        if(q == p) {
+            pbuf_free(p);
+            return;
         }
+        p = q;
+    }
 
-        ip_addr_t received_ip;
-        u16_t port;
-        netconn_addr(state->nc, &received_ip, &port);
+    struct dhcp_msg *received = p->payload;
+    u16_t len = p->len;
 
-        if(netbuf_len(netbuf) < offsetof(struct dhcp_msg, options)) {
-            /* too short to be a valid DHCP client message */
-            netbuf_delete(netbuf);
-            continue;
-        }
-        if(netbuf_len(netbuf) >= sizeof(struct dhcp_msg)) {
-           printf("DHCP Server Warning: Client sent more options than we know how to parse. len=%d\r\n", netbuf_len(netbuf));
-        }
+    if(len < offsetof(struct dhcp_msg, options) || netif == NULL) {
+        /* too short to be a valid DHCP client message */
+        pbuf_free(p);
+        return;
+    }
 
-        netbuf_copy(netbuf, &received, sizeof(struct dhcp_msg));
-        netbuf_delete(netbuf);
+    uint8_t *message_type = find_dhcp_option(received, len, DHCP_OPTION_MESSAGE_TYPE,
+                                             DHCP_OPTION_MESSAGE_TYPE_LEN, NULL);
+    if(!message_type) {
+        printf("DHCP Server Error: No message type field found");
+        pbuf_free(p);
+        return;
+    }
 
-        uint8_t *message_type = find_dhcp_option(&received, DHCP_OPTION_MESSAGE_TYPE,
-                                                 DHCP_OPTION_MESSAGE_TYPE_LEN, NULL);
-        if(!message_type) {
-            printf("DHCP Server Error: No message type field found");
-            continue;
-        }
+    switch(*message_type) {
+    case DHCP_DISCOVER:
+        handle_dhcp_discover(netif, received, len);
+        break;
+    case DHCP_REQUEST:
+        handle_dhcp_request(netif, received, len);
+        break;
+    case DHCP_RELEASE:
+        handle_dhcp_release(received);
+        break;
+    default:
+        printf("DHCP Server Error: Unsupported message type %d\r\n", *message_type);
+        break;
+    }
+    pbuf_free(p);
+}
 
+static void dhcpserver_start_cb(void *arg)
+{
+    server_state_t *new_state = arg;
+
+    new_state->pcb = udp_new();
+    if(!new_state->pcb || udp_bind(new_state->pcb, IP_ADDR_ANY, DHCP_SERVER_PORT) != ERR_OK) {
+        printf("DHCP Server Error: Failed to bind UDP port.\r\n");
+        if(new_state->pcb)
+            udp_remove(new_state->pcb);
+        free(new_state->leases);
+        free(new_state->hash);
+        free(new_state);
+        return;
+    }
+    state = new_state;
+    udp_recv(state->pcb, dhcpserver_recv, NULL);
+    sys_timeout(WHEEL_TICK_MS, wheel_tick, NULL);
+}
 
-        printf("State dump. Message type %d\n", *message_type);
-        for(int i = 0; i < state->max_leases; i++) {
-            dhcp_lease_t *lease = &state->leases[i];
-            printf("lease slot %d expiry %d hwaddr %02x:%02x:%02x:%02x:%02x:%02x\r\n", i, lease->expires, lease->hwaddr[0],
-                   lease->hwaddr[1], lease->hwaddr[2], lease->hwaddr[3], lease->hwaddr[4],
-                   lease->hwaddr[5]);
-        }
+static void dhcpserver_stop_cb(void *arg)
+{
+    if(state) {
+        sys_untimeout(wheel_tick, NULL);
+        udp_remove(state->pcb);
+        free(state->leases);
+        free(state->hash);
+        free(state);
+        state = NULL;
+    }
+    if(arg)
+        sys_sem_signal((sys_sem_t *)arg);
+}
 
-        switch(*message_type) {
-        case DHCP_DISCOVER:
-            handle_dhcp_discover(&received);
-            break;
-        case DHCP_REQUEST:
-            handle_dhcp_request(&received);
-            break;
-        case DHCP_RELEASE:
-            handle_dhcp_release(&received);
-        default:
-            printf("DHCP Server Error: Unsupported message type %d\r\n", *message_type);
-            break;
-        }
+void dhcpserver_start(const ip_addr_t *first_client_addr, uint8_t max_leases)
+{
+    /* Stop any existing running dhcpserver */
+    dhcpserver_stop();
+
+    if(max_leases == 0 || max_leases == NO_LEASE)
+        return;
+
+    server_state_t *new_state = calloc(1, sizeof(server_state_t));
+    if(!new_state)
+        return;
+
+    uint8_t buckets = 1;
+    while(buckets < max_leases && buckets < 128)
+        buckets <<= 1;
+
+    new_state->max_leases = max_leases;
+    new_state->hash_mask = buckets - 1;
+    new_state->leases = calloc(max_leases, sizeof(dhcp_lease_t));
+    new_state->hash = malloc(buckets);
+    if(!new_state->leases || !new_state->hash) {
+        free(new_state->leases);
+        free(new_state->hash);
+        free(new_state);
+        return;
+    }
+    ip_addr_copy(new_state->first_client_addr, *first_client_addr);
+
+    memset(new_state->hash, NO_LEASE, buckets);
+    memset(new_state->wheel, NO_LEASE, sizeof(new_state->wheel));
+    /* Free list in address order, so the lowest addresses go out first */
+    for(int i = 0; i < max_leases; i++) {
+        new_state->leases[i].prev = i ? i - 1 : NO_LEASE;
+        new_state->leases[i].next = (i + 1 < max_leases) ? i + 1 : NO_LEASE;
+    }
+    new_state->free_head = 0;
+
+    if(tcpip_callback(dhcpserver_start_cb, new_state) != ERR_OK) {
+        free(new_state->leases);
+        free(new_state->hash);
+        free(new_state);
+    }
+}
+
+void dhcpserver_stop(void)
+{
+    sys_sem_t done;
+
+    if(sys_sem_new(&done, 0) != ERR_OK) {
+        tcpip_callback(dhcpserver_stop_cb, NULL);
+        return;
     }
+    if(tcpip_callback(dhcpserver_stop_cb, &done) == ERR_OK)
+        sys_sem_wait(&done);
+    sys_sem_free(&done);
+}
+
+void dhcpserver_set_router(const ip_addr_t *router)
+{
+    ip_addr_set(&router_addr, router);
+}
+
+void dhcpserver_set_dns(const ip_addr_t *dns)
+{
+    ip_addr_set(&dns_addr, dns);
 }
 
-static void handle_dhcp_discover(struct dhcp_msg *dhcpmsg)
+static void handle_dhcp_discover(struct netif *netif, struct dhcp_msg *dhcpmsg, u16_t len)
 {
     if(dhcpmsg->htype != DHCP_HTYPE_ETH)
         return;
     if(dhcpmsg->hlen > NETIF_MAX_HWADDR_LEN)
         return;
 
-    dhcp_lease_t *freelease = find_lease_slot(dhcpmsg->chaddr);
-    if(!freelease) {
+    /* Offer the client's existing lease, or the next free one. The
+       lease is only bound once the client requests it. */
+    dhcp_lease_t *lease = find_lease(dhcpmsg->chaddr);
+    if(!lease && state->free_head != NO_LEASE)
+        lease = &state->leases[state->free_head];
+    if(!lease) {
         printf("DHCP Server: All leases taken.\r\n");
         return; /* Nothing available, so do nothing */
     }
 
-    /* Reuse the DISCOVER buffer for the OFFER response */
-    dhcpmsg->op = DHCP_BOOTREPLY;
-    bzero(dhcpmsg->options, DHCP_OPTIONS_LEN);
+    ip_addr_t offer_ip;
+    ip_addr_copy(offer_ip, state->first_client_addr);
+    ip4_addr4(&offer_ip) += lease_index(lease);
 
-    ip_addr_copy(dhcpmsg->yiaddr, state->first_client_addr);
-    ip4_addr4(&(dhcpmsg->yiaddr)) += (freelease - state->leases);
-
-    uint8_t *opt = (uint8_t *)&dhcpmsg->options;
-    opt = add_dhcp_option_byte(opt, DHCP_OPTION_MESSAGE_TYPE, DHCP_OFFER);
-    opt = add_dhcp_option_bytes(opt, DHCP_OPTION_SERVER_ID, &state->server_if->ip_addr, 4);
-    opt = add_dhcp_option_bytes(opt, DHCP_OPTION_SUBNET_MASK, &state->server_if->netmask, 4);
-    opt = add_dhcp_option_bytes(opt, DHCP_OPTION_END, NULL, 0);
-
-    struct netbuf *netbuf = netbuf_new();
-    netbuf_alloc(netbuf, sizeof(struct dhcp_msg));
-    netbuf_take(netbuf, dhcpmsg, sizeof(struct dhcp_msg));
-    netconn_sendto(state->nc, netbuf, IP_ADDR_BROADCAST, 68);
-    netbuf_delete(netbuf);
+    send_dhcp_reply(netif, dhcpmsg, DHCP_OFFER, &offer_ip);
 }
 
-static void handle_dhcp_request(struct dhcp_msg *dhcpmsg)
+static void handle_dhcp_request(struct netif *netif, struct dhcp_msg *dhcpmsg, u16_t len)
 {
     static char ipbuf[16];
     if(dhcpmsg->htype != DHCP_HTYPE_ETH)
@@ -224,15 +375,16 @@ static void handle_dhcp_request(struct dhcp_msg *dhcpmsg)
         return;
 
     ip_addr_t requested_ip;
-    uint8_t *requested_ip_opt = find_dhcp_option(dhcpmsg, DHCP_OPTION_REQUESTED_IP, 4, NULL);
+    uint8_t *requested_ip_opt = find_dhcp_option(dhcpmsg, len, DHCP_OPTION_REQUESTED_IP, 4, NULL);
     if(requested_ip_opt) {
-            memcpy(&requested_ip.addr, requested_ip_opt, 4);
-    } else if(ip_addr_cmp(&requested_ip, IP_ADDR_ANY)) {
-        ip_addr_copy(requested_ip, dhcpmsg->ciaddr);
+        memcpy(&requested_ip.addr, requested_ip_opt, 4);
     } else {
-        printf("DHCP Server Error: No requested IP\r\n");
-        send_dhcp_nak(dhcpmsg);
-        return;
+        ip_addr_copy(requested_ip, dhcpmsg->ciaddr);
+        if(ip_addr_isany(&requested_ip)) {
+            printf("DHCP Server Error: No requested IP\r\n");
+            send_dhcp_reply(netif, dhcpmsg, DHCP_NAK, NULL);
+            return;
+        }
     }
 
     /* Test the first 4 octets match */
@@ -241,90 +393,97 @@ static void handle_dhcp_request(struct dhcp_msg *dhcpmsg)
        || ip4_addr3(&requested_ip) != ip4_addr3(&state->first_client_addr)) {
         sprintf_ipaddr(&requested_ip, ipbuf);
         printf("DHCP Server Error: %s not an allowed IP\r\n", ipbuf);
-        send_dhcp_nak(dhcpmsg);
+        send_dhcp_reply(netif, dhcpmsg, DHCP_NAK, NULL);
         return;
     }
     /* Test the last octet is in the MAXCLIENTS range */
     int16_t octet_offs = ip4_addr4(&requested_ip) - ip4_addr4(&state->first_client_addr);
     if(octet_offs < 0 || octet_offs >= state->max_leases) {
         printf("DHCP Server Error: Address out of range\r\n");
-        send_dhcp_nak(dhcpmsg);
+        send_dhcp_reply(netif, dhcpmsg, DHCP_NAK, NULL);
         return;
     }
 
     dhcp_lease_t *requested_lease = state->leases + octet_offs;
-    if(requested_lease->expires != 0 && memcmp(requested_lease->hwaddr, dhcpmsg->chaddr,dhcpmsg->hlen))
+    if(requested_lease->bound && memcmp(requested_lease->hwaddr, dhcpmsg->chaddr, dhcpmsg->hlen))
     {
         printf("DHCP Server Error: Lease for address already taken\r\n");
-        send_dhcp_nak(dhcpmsg);
+        send_dhcp_reply(netif, dhcpmsg, DHCP_NAK, NULL);
         return;
     }
 
-    memcpy(requested_lease->hwaddr, dhcpmsg->chaddr, dhcpmsg->hlen);
+    /* A client moving to a different address gives up its old one */
+    dhcp_lease_t *old_lease = find_lease(dhcpmsg->chaddr);
+    if(old_lease && old_lease != requested_lease)
+        lease_free(old_lease);
+
+    lease_bind(requested_lease, dhcpmsg->chaddr, dhcpmsg->hlen);
     sprintf_ipaddr(&requested_ip, ipbuf);
     printf("DHCP lease addr %s assigned to MAC %02x:%02x:%02x:%02x:%02x:%02x\r\n", ipbuf, requested_lease->hwaddr[0],
            requested_lease->hwaddr[1], requested_lease->hwaddr[2], requested_lease->hwaddr[3], requested_lease->hwaddr[4],
            requested_lease->hwaddr[5]);
-    requested_lease->expires = DHCPSERVER_LEASE_TIME * configTICK_RATE_HZ;
-
-    /* Reuse the REQUEST message as the ACK message */
-    dhcpmsg->op = DHCP_BOOTREPLY;
-    bzero(dhcpmsg->options, DHCP_OPTIONS_LEN);
-
-    ip_addr_copy(dhcpmsg->yiaddr, requested_ip);
-
-    uint8_t *opt = (uint8_t *)&dhcpmsg->options;
-    opt = add_dhcp_option_byte(opt, DHCP_OPTION_MESSAGE_TYPE, DHCP_ACK);
-    uint32_t expiry = htonl(DHCPSERVER_LEASE_TIME);
-    opt = add_dhcp_option_bytes(opt, DHCP_OPTION_LEASE_TIME, &expiry, 4);
-    opt = add_dhcp_option_bytes(opt, DHCP_OPTION_SERVER_ID, &state->server_if->ip_addr, 4);
-    opt = add_dhcp_option_bytes(opt, DHCP_OPTION_SUBNET_MASK, &state->server_if->netmask, 4);
-    opt = add_dhcp_option_bytes(opt, DHCP_OPTION_END, NULL, 0);
 
-    struct netbuf *netbuf = netbuf_new();
-    netbuf_alloc(netbuf, sizeof(struct dhcp_msg));
-    netbuf_take(netbuf, dhcpmsg, sizeof(struct dhcp_msg));
-    netconn_sendto(state->nc, netbuf, IP_ADDR_BROADCAST, 68);
-    netbuf_delete(netbuf);
+    send_dhcp_reply(netif, dhcpmsg, DHCP_ACK, &requested_ip);
 }
 
 static void handle_dhcp_release(struct dhcp_msg *dhcpmsg)
 {
-    dhcp_lease_t *lease = find_lease_slot(dhcpmsg->chaddr);
+    dhcp_lease_t *lease = find_lease(dhcpmsg->chaddr);
     if(lease) {
-        lease->expires = 0;
+        lease_free(lease);
     }
 }
 
-static void send_dhcp_nak(struct dhcp_msg *dhcpmsg)
+/* Build a reply to 'request' in a new pbuf and broadcast it on 'netif' */
+static void send_dhcp_reply(struct netif *netif, struct dhcp_msg *request, uint8_t type,
+                            const ip_addr_t *yiaddr)
 {
-    /* Reuse 'dhcpmsg' for the NAK */
-    dhcpmsg->op = DHCP_BOOTREPLY;
-    bzero(dhcpmsg->options, DHCP_OPTIONS_LEN);
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, REPLY_LEN, PBUF_RAM);
+    if(!p)
+        return;
+
+    struct dhcp_msg *reply = p->payload;
+    memcpy(reply, request, offsetof(struct dhcp_msg, options));
+    memset(reply->options, 0, REPLY_OPTIONS_LEN);
+    reply->op = DHCP_BOOTREPLY;
+    if(yiaddr)
+        ip_addr_copy(reply->yiaddr, *yiaddr);
+    else
+        ip_addr_set_zero(&reply->yiaddr);
 
-    uint8_t *opt = (uint8_t *)&dhcpmsg->options;
-    opt = add_dhcp_option_byte(opt, DHCP_OPTION_MESSAGE_TYPE, DHCP_NAK);
-    opt = add_dhcp_option_bytes(opt, DHCP_OPTION_SERVER_ID, &state->server_if->ip_addr, 4);
+    uint8_t *opt = (uint8_t *)&reply->options;
+    opt = add_dhcp_option_byte(opt, DHCP_OPTION_MESSAGE_TYPE, type);
+    if(type == DHCP_ACK) {
+        uint32_t expiry = htonl(DHCPSERVER_LEASE_TIME);
+        opt = add_dhcp_option_bytes(opt, DHCP_OPTION_LEASE_TIME, &expiry, 4);
+    }
+    opt = add_dhcp_option_bytes(opt, DHCP_OPTION_SERVER_ID, &netif->ip_addr, 4);
+    if(type != DHCP_NAK) {
+        opt = add_dhcp_option_bytes(opt, DHCP_OPTION_SUBNET_MASK, &netif->netmask, 4);
+        if(!ip_addr_isany(&router_addr))
+            opt = add_dhcp_option_bytes(opt, DHCP_OPTION_ROUTER, &router_addr, 4);
+        if(!ip_addr_isany(&dns_addr))
+            opt = add_dhcp_option_bytes(opt, DHCP_OPTION_DNS_SERVER, &dns_addr, 4);
+    }
     opt = add_dhcp_option_bytes(opt, DHCP_OPTION_END, NULL, 0);
 
-    struct netbuf *netbuf = netbuf_new();
-    netbuf_alloc(netbuf, sizeof(struct dhcp_msg));
-    netbuf_take(netbuf, dhcpmsg, sizeof(struct dhcp_msg));
-    netconn_sendto(state->nc, netbuf, IP_ADDR_BROADCAST, 68);
-    netbuf_delete(netbuf);
+    udp_sendto_if(state->pcb, p, IP_ADDR_BROADCAST, DHCP_CLIENT_PORT, netif);
+    pbuf_free(p);
 }
 
-static uint8_t *find_dhcp_option(struct dhcp_msg *msg, uint8_t option_num, uint8_t min_length, uint8_t *length)
+static uint8_t *find_dhcp_option(struct dhcp_msg *msg, u16_t msg_len, uint8_t option_num, uint8_t min_length, uint8_t *length)
 {
     uint8_t *start = (uint8_t *)&msg->options;
-    uint8_t *msg_end = (uint8_t *)msg + sizeof(struct dhcp_msg);
+    uint8_t *msg_end = (uint8_t *)msg + msg_len;
 
     for(uint8_t *p = start; p < msg_end-2;) {
         uint8_t type = *p++;
+        if(type == DHCP_OPTION_PAD)
+            continue;
         uint8_t len = *p++;
         if(type == DHCP_OPTION_END)
             return NULL;
-        if(p+len >= msg_end)
+        if(p+len > msg_end)
             break; /* We've overrun our valid DHCP message size, or this isn't a valid option */
         if(type == option_num) {
             if(len < min_length)
@@ -356,15 +515,15 @@ static uint8_t *add_dhcp_option_bytes(uint8_t *opt, uint8_t type, void *value, u
     return opt+len;
 }
 
-/* Find a free DHCP lease, or a lease already assigned to 'hwaddr' */
-static dhcp_lease_t *find_lease_slot(uint8_t *hwaddr)
+/* Find the lease bound to 'hwaddr', if any */
+static dhcp_lease_t *find_lease(const uint8_t *hwaddr)
 {
-    dhcp_lease_t *empty_lease = NULL;
-    for(int i = 0; i < state->max_leases; i++) {
-        if(state->leases[i].expires == 0 && !empty_lease)
-            empty_lease = &state->leases[i];
-        else if (memcmp(hwaddr, state->leases[i].hwaddr, 6) == 0)
-            return &state->leases[i];
+    uint8_t i = state->hash[hash_hwaddr(hwaddr)];
+    while(i != NO_LEASE) {
+        dhcp_lease_t *lease = &state->leases[i];
+        if(memcmp(hwaddr, lease->hwaddr, 6) == 0)
+            return lease;
+        i = lease->hash_next;
     }
-    return empty_lease;
+    return NULL;
 }
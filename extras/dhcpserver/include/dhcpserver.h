@@ -21,13 +21,25 @@
    first_client_addr is the IP address of the first lease to be handed
    to a client.  Subsequent lease addresses are calculated by
    incrementing the final octet of the IPv4 address, up to max_leases.
+
+   The server runs in tcpip_thread (no task of its own), and the
+   setup is queued to it, so this can be called from user_init().
 */
 void dhcpserver_start(const ip_addr_t *first_client_addr, uint8_t max_leases);
 
 void dhcpserver_get_lease(const ip_addr_t *first_client_addr, uint8_t max_leases);
 
-/* Stop DHCP server.
+/* Stop DHCP server. Waits for tcpip_thread to release the server's
+   resources, so must be called from a task other than tcpip_thread.
  */
 void dhcpserver_stop(void);
 
+/* Router (default gateway) and DNS server given to clients, for
+   instance the server's own address with extras/napt. NULL or
+   IP_ADDR_ANY (the default) leaves the option out. Takes effect from
+   the next reply, so can be called at any time.
+ */
+void dhcpserver_set_router(const ip_addr_t *router);
+void dhcpserver_set_dns(const ip_addr_t *dns);
+
 #endif
@@ -0,0 +1,9 @@
+# Component makefile for extras/dnscache
+
+# expected anyone using dnscache includes it as 'dnscache/dnscache.h'
+INC_DIRS += $(dnscache_ROOT)..
+
+# args for passing into compile rule generation
+dnscache_SRC_DIR =  $(dnscache_ROOT)
+
+$(eval $(call component_compile_rules,dnscache))
@@ -0,0 +1,467 @@
+/* Caching DNS resolver, see dnscache.h
+ *
+ * Everything but the entry points runs in tcpip_thread, so the cache
+ * needs no locking. Each entry is one name, from the first lookup
+ * until it's replaced: while a query for it is outstanding the tasks
+ * waiting for the answer are queued on it, so concurrent lookups of a
+ * name send one query between them.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "dnscache.h"
+
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include <lwip/udp.h>
+#include <lwip/dns.h>
+#include <lwip/tcpip.h>
+#include <lwip/timers.h>
+#include <lwip/sys.h>
+
+#include "esp/hwrand.h"
+
+#define DNS_PORT 53
+#define DNS_HEADER_LEN 12
+#define DNS_MSG_MAX 512
+
+#define DNS_FLAG_QR 0x80    /* first flags byte */
+#define DNS_FLAG_RD 0x01
+#define DNS_RCODE_MASK 0x0f /* second flags byte */
+#define DNS_RCODE_NXDOMAIN 3
+
+#define DNS_TYPE_A 1
+#define DNS_TYPE_CNAME 5
+#define DNS_CLASS_IN 1
+
+typedef enum {
+    ENTRY_FREE = 0,
+    ENTRY_PENDING,      /* no answer yet */
+    ENTRY_VALID,
+    ENTRY_NEGATIVE,     /* the name doesn't exist */
+} entry_state_t;
+
+typedef struct waiter {
+    struct waiter *next;
+    dnscache_found_fn found;
+    void *arg;
+    char name[DNSCACHE_NAME_LEN];
+} waiter_t;
+
+typedef struct {
+    char name[DNSCACHE_NAME_LEN];
+    ip_addr_t addr;
+    uint8_t state;
+    uint8_t tries;      /* queries sent, 0 if none outstanding */
+    uint16_t txid;
+    u32_t expires;      /* sys_now() times, in ms */
+    u32_t used;
+    u32_t sent;
+    waiter_t *waiters;
+} entry_t;
+
+static entry_t entries[DNSCACHE_ENTRIES];
+static struct udp_pcb *pcb;
+static bool timer_running;
+static uint8_t msg[DNS_MSG_MAX];
+
+static inline bool expired(const entry_t *e, u32_t now)
+{
+    return (int32_t)(now - e->expires) >= 0;
+}
+
+static inline bool has_answer(const entry_t *e, u32_t now)
+{
+    return (e->state == ENTRY_VALID || e->state == ENTRY_NEGATIVE) && !expired(e, now);
+}
+
+static entry_t *find_entry(const char *name)
+{
+    for (int i = 0; i < DNSCACHE_ENTRIES; i++) {
+        if (entries[i].state != ENTRY_FREE && !strcasecmp(entries[i].name, name))
+            return &entries[i];
+    }
+    return NULL;
+}
+
+/* A free entry, or the least recently used one without a query outstanding */
+static entry_t *new_entry(const char *name, u32_t now)
+{
+    entry_t *lru = NULL;
+
+    for (int i = 0; i < DNSCACHE_ENTRIES; i++) {
+        entry_t *e = &entries[i];
+        if (e->state == ENTRY_FREE) {
+            lru = e;
+            break;
+        }
+        if (!e->tries && (!lru || (int32_t)(e->used - lru->used) < 0))
+            lru = e;
+    }
+    if (!lru)
+        return NULL;
+    memset(lru, 0, sizeof(*lru));
+    strcpy(lru->name, name);
+    lru->state = ENTRY_PENDING;
+    lru->used = now;
+    return lru;
+}
+
+static void complete(entry_t *e, err_t err)
+{
+    waiter_t *w = e->waiters;
+
+    e->waiters = NULL;
+    e->tries = 0;
+    while (w) {
+        waiter_t *next = w->next;
+        w->found(w->name, err == ERR_OK ? &e->addr : NULL, err, w->arg);
+        free(w);
+        w = next;
+    }
+}
+
+/* Encode 'name' as a query at 'p', returning its length or 0 if invalid */
+static size_t encode_query(uint8_t *p, const char *name, uint16_t txid)
+{
+    uint8_t *out = p + DNS_HEADER_LEN;
+
+    memset(p, 0, DNS_HEADER_LEN);
+    p[0] = txid >> 8;
+    p[1] = txid;
+    p[2] = DNS_FLAG_RD;
+    p[5] = 1;                   /* one question */
+
+    while (*name) {
+        const char *dot = strchr(name, '.');
+        size_t len = dot ? (size_t)(dot - name) : strlen(name);
+        if (len == 0 || len > 63)
+            return 0;
+        *out++ = len;
+        memcpy(out, name, len);
+        out += len;
+        name += len;
+        if (*name)
+            name++;
+    }
+    *out++ = 0;
+    *out++ = 0;
+    *out++ = DNS_TYPE_A;
+    *out++ = 0;
+    *out++ = DNS_CLASS_IN;
+    return out - p;
+}
+
+static void timer_start(void);
+static void dnscache_recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, ip_addr_t *addr, u16_t port);
+
+static err_t send_query(entry_t *e)
+{
+    ip_addr_t server = dns_getserver(0);
+
+    if (ip_addr_isany(&server))
+        return ERR_CONN;
+    if (!pcb) {
+        pcb = udp_new();
+        if (!pcb)
+            return ERR_MEM;
+        udp_bind(pcb, IP_ADDR_ANY, 0);
+        udp_recv(pcb, dnscache_recv, NULL);
+    }
+
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, DNS_HEADER_LEN + DNSCACHE_NAME_LEN + 1 + 4, PBUF_RAM);
+    if (!p)
+        return ERR_MEM;
+    if (!e->tries)
+        e->txid = hwrand();
+    size_t len = encode_query(p->payload, e->name, e->txid);
+    if (!len) {
+        pbuf_free(p);
+        return ERR_ARG;
+    }
+    pbuf_realloc(p, len);
+    err_t err = udp_sendto(pcb, p, &server, DNS_PORT);
+    pbuf_free(p);
+    if (err != ERR_OK)
+        return err;
+    e->tries++;
+    e->sent = sys_now();
+    timer_start();
+    return ERR_OK;
+}
+
+/* Start (or, for a prefetch, restart) the query for an entry */
+static void start_query(entry_t *e)
+{
+    if (e->tries)
+        return;
+    err_t err = send_query(e);
+    if (err != ERR_OK && e->state == ENTRY_PENDING) {
+        complete(e, err);
+        e->state = ENTRY_FREE;
+    }
+}
+
+static void retry_tick(void *arg)
+{
+    u32_t now = sys_now();
+    bool outstanding = false;
+
+    for (int i = 0; i < DNSCACHE_ENTRIES; i++) {
+        entry_t *e = &entries[i];
+        if (!e->tries || now - e->sent < DNSCACHE_RETRY_MS)
+            continue;
+        if (e->tries < DNSCACHE_TRIES && send_query(e) == ERR_OK)
+            continue;
+        /* A failed prefetch leaves the old answer until it expires */
+        complete(e, ERR_TIMEOUT);
+        if (e->state == ENTRY_PENDING)
+            e->state = ENTRY_FREE;
+    }
+    for (int i = 0; i < DNSCACHE_ENTRIES; i++)
+        outstanding |= entries[i].tries != 0;
+    timer_running = outstanding;
+    if (outstanding)
+        sys_timeout(DNSCACHE_RETRY_MS / 4, retry_tick, NULL);
+}
+
+static void timer_start(void)
+{
+    if (!timer_running) {
+        timer_running = true;
+        sys_timeout(DNSCACHE_RETRY_MS / 4, retry_tick, NULL);
+    }
+}
+
+/* Offset after the name at 'off', or 0 if it runs off the message */
+static size_t skip_name(size_t len, size_t off)
+{
+    while (off < len) {
+        uint8_t b = msg[off];
+        if ((b & 0xc0) == 0xc0)
+            return off + 2 <= len ? off + 2 : 0;
+        if (b == 0)
+            return off + 1;
+        off += 1 + b;
+    }
+    return 0;
+}
+
+/* True if the question name at 'off' is 'name' */
+static bool question_is(size_t len, size_t off, const char *name)
+{
+    for (;;) {
+        if (off >= len)
+            return false;
+        uint8_t b = msg[off++];
+        if (b == 0)
+            return *name == 0;
+        if (b > 63 || off + b > len || strncasecmp((const char *)&msg[off], name, b))
+            return false;
+        name += b;
+        off += b;
+        if (*name == '.')
+            name++;
+        else if (*name || (off < len && msg[off]))
+            return false;
+    }
+}
+
+static inline uint16_t get16(size_t off)
+{
+    return msg[off] << 8 | msg[off + 1];
+}
+
+static inline u32_t get32(size_t off)
+{
+    return (u32_t)get16(off) << 16 | get16(off + 2);
+}
+
+static void dnscache_recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, ip_addr_t *addr, u16_t port)
+{
+    size_t len = pbuf_copy_partial(p, msg, sizeof(msg), 0);
+    pbuf_free(p);
+
+    if (port != DNS_PORT || len < DNS_HEADER_LEN || !(msg[2] & DNS_FLAG_QR) || get16(4) != 1)
+        return;
+
+    entry_t *e = NULL;
+    for (int i = 0; i < DNSCACHE_ENTRIES && !e; i++) {
+        if (entries[i].tries && entries[i].txid == get16(0))
+            e = &entries[i];
+    }
+    if (!e || !question_is(len, DNS_HEADER_LEN, e->name))
+        return;
+
+    size_t off = skip_name(len, DNS_HEADER_LEN);
+    if (!off || off + 4 > len)
+        return;
+    off += 4;
+
+    uint8_t rcode = msg[3] & DNS_RCODE_MASK;
+    u32_t ttl = DNSCACHE_MAX_TTL_S;
+    bool found = false;
+    for (uint16_t n = get16(6); rcode == 0 && n > 0 && !found; n--) {
+        off = skip_name(len, off);
+        if (!off || off + 10 > len)
+            break;
+        uint16_t type = get16(off);
+        uint16_t rdlen = get16(off + 8);
+        u32_t rr_ttl = get32(off + 4);
+        if (off + 10 + rdlen > len)
+            break;
+        if (get16(off + 2) == DNS_CLASS_IN && (type == DNS_TYPE_A || type == DNS_TYPE_CNAME)) {
+            /* A CNAME's answer lasts as long as the chain to it */
+            if (rr_ttl < ttl)
+                ttl = rr_ttl;
+            if (type == DNS_TYPE_A && rdlen == 4) {
+                IP4_ADDR(&e->addr, msg[off + 10], msg[off + 11], msg[off + 12], msg[off + 13]);
+                found = true;
+            }
+        }
+        off += 10 + rdlen;
+    }
+
+    u32_t now = sys_now();
+    if (found) {
+        if (ttl < DNSCACHE_MIN_TTL_S)
+            ttl = DNSCACHE_MIN_TTL_S;
+        e->state = ENTRY_VALID;
+        e->expires = now + ttl * 1000;
+        complete(e, ERR_OK);
+    } else if (rcode == 0 || rcode == DNS_RCODE_NXDOMAIN) {
+        e->state = ENTRY_NEGATIVE;
+        e->expires = now + DNSCACHE_NEGATIVE_TTL_S * 1000;
+        complete(e, ERR_VAL);
+    } else {
+        /* Server failure, not cached */
+        complete(e, ERR_VAL);
+        if (e->state == ENTRY_PENDING)
+            e->state = ENTRY_FREE;
+    }
+}
+
+static void answer(entry_t *e, waiter_t *w, u32_t now)
+{
+    e->used = now;
+    if (e->state == ENTRY_VALID && (int32_t)(e->expires - now) < DNSCACHE_PREFETCH_S * 1000)
+        start_query(e);
+    w->found(w->name, e->state == ENTRY_VALID ? &e->addr : NULL,
+             e->state == ENTRY_VALID ? ERR_OK : ERR_VAL, w->arg);
+    free(w);
+}
+
+static void resolve_cb(void *arg)
+{
+    waiter_t *w = arg;
+    u32_t now = sys_now();
+    ip_addr_t addr;
+
+    if (ipaddr_aton(w->name, &addr)) {
+        w->found(w->name, &addr, ERR_OK, w->arg);
+        free(w);
+        return;
+    }
+
+    entry_t *e = find_entry(w->name);
+    if (e && has_answer(e, now)) {
+        answer(e, w, now);
+        return;
+    }
+    if (e && !e->tries) {
+        /* Expired, ask again */
+        e->state = ENTRY_PENDING;
+    } else if (!e) {
+        e = new_entry(w->name, now);
+        if (!e) {
+            w->found(w->name, NULL, ERR_MEM, w->arg);
+            free(w);
+            return;
+        }
+    }
+    e->used = now;
+    w->next = e->waiters;
+    e->waiters = w;
+    start_query(e);
+}
+
+err_t dnscache_resolve(const char *name, dnscache_found_fn found, void *arg)
+{
+    if (strlen(name) >= DNSCACHE_NAME_LEN)
+        return ERR_ARG;
+
+    waiter_t *w = malloc(sizeof(waiter_t));
+    if (!w)
+        return ERR_MEM;
+    w->next = NULL;
+    w->found = found;
+    w->arg = arg;
+    strcpy(w->name, name);
+    if (tcpip_callback(resolve_cb, w) != ERR_OK) {
+        free(w);
+        return ERR_MEM;
+    }
+    return ERR_OK;
+}
+
+typedef struct {
+    sys_sem_t done;
+    ip_addr_t *addr;
+    err_t err;
+} blocking_call_t;
+
+static void blocking_found(const char *name, const ip_addr_t *addr, err_t err, void *arg)
+{
+    blocking_call_t *call = arg;
+
+    call->err = err;
+    if (err == ERR_OK)
+        ip_addr_copy(*call->addr, *addr);
+    sys_sem_signal(&call->done);
+}
+
+err_t dnscache_gethostbyname(const char *name, ip_addr_t *addr)
+{
+    blocking_call_t call = { .addr = addr };
+
+    if (sys_sem_new(&call.done, 0) != ERR_OK)
+        return ERR_MEM;
+    /* call.err is only set by blocking_found() once the lookup started */
+    err_t err = dnscache_resolve(name, blocking_found, &call);
+    if (err == ERR_OK)
+        sys_sem_wait(&call.done);
+    else
+        call.err = err;
+    sys_sem_free(&call.done);
+    return call.err;
+}
+
+static void flush_cb(void *arg)
+{
+    for (int i = 0; i < DNSCACHE_ENTRIES; i++) {
+        if (!entries[i].tries)
+            entries[i].state = ENTRY_FREE;
+    }
+}
+
+void dnscache_flush(void)
+{
+    tcpip_callback(flush_cb, NULL);
+}
+
+uint32_t dnscache_lookup(const char *name)
+{
+    u32_t now = sys_now();
+    entry_t *e = find_entry(name);
+
+    if (!e || e->state != ENTRY_VALID || expired(e, now))
+        return IPADDR_NONE;
+    e->used = now;
+    if ((int32_t)(e->expires - now) < DNSCACHE_PREFETCH_S * 1000)
+        start_query(e);
+    return ip4_addr_get_u32(&e->addr);
+}
@@ -0,0 +1,101 @@
+/* Caching DNS resolver
+ *
+ * Keeps the last DNSCACHE_ENTRIES names looked up, each for the TTL
+ * of its answer (clamped to DNSCACHE_MIN_TTL_S..DNSCACHE_MAX_TTL_S),
+ * so a client reconnecting to the same host skips the DNS round trip.
+ * Names that don't exist (or have no IPv4 address) are cached as well,
+ * for DNSCACHE_NEGATIVE_TTL_S, so they fail straight away instead of
+ * waiting on the server each time. A name looked up less than
+ * DNSCACHE_PREFETCH_S before it expires is answered from the cache and
+ * queried again in the background, so names in regular use don't
+ * expire from under their clients.
+ *
+ * The resolver runs in tcpip_thread on the raw UDP API, and asks
+ * lwIP's first DNS server (the one DHCP gave, or dns_setserver()).
+ * When an entry is needed for a new name the least recently used one
+ * is replaced.
+ *
+ * Build with EXTRA_CFLAGS=-DLWIP_DNSCACHE=1 to have lwIP's own
+ * resolver, and so netconn_gethostbyname() and getaddrinfo(), answer
+ * from this cache too. Names not in it are then resolved by lwIP as
+ * usual, without negative caching or prefetch, which need
+ * dnscache_gethostbyname().
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _DNSCACHE_H
+#define _DNSCACHE_H
+
+#include <stdint.h>
+#include <lwip/ip_addr.h>
+#include <lwip/err.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifndef DNSCACHE_ENTRIES
+#define DNSCACHE_ENTRIES 8
+#endif
+
+/* Longest name cached, including the terminating 0 */
+#ifndef DNSCACHE_NAME_LEN
+#define DNSCACHE_NAME_LEN 64
+#endif
+
+#ifndef DNSCACHE_MIN_TTL_S
+#define DNSCACHE_MIN_TTL_S 10
+#endif
+
+#ifndef DNSCACHE_MAX_TTL_S
+#define DNSCACHE_MAX_TTL_S 86400
+#endif
+
+#ifndef DNSCACHE_NEGATIVE_TTL_S
+#define DNSCACHE_NEGATIVE_TTL_S 60
+#endif
+
+#ifndef DNSCACHE_PREFETCH_S
+#define DNSCACHE_PREFETCH_S 30
+#endif
+
+/* A query is sent up to DNSCACHE_TRIES times, DNSCACHE_RETRY_MS apart */
+#ifndef DNSCACHE_TRIES
+#define DNSCACHE_TRIES 3
+#endif
+#ifndef DNSCACHE_RETRY_MS
+#define DNSCACHE_RETRY_MS 1000
+#endif
+
+/* Called in tcpip_thread with the result: ERR_OK and the address,
+   ERR_VAL if the name doesn't exist, ERR_TIMEOUT if the server didn't
+   answer or ERR_MEM. */
+typedef void (*dnscache_found_fn)(const char *name, const ip_addr_t *addr, err_t err, void *arg);
+
+/* Resolve 'name', blocking the calling task until the answer is known.
+   Returns as dnscache_found_fn gets, immediately for cached names.
+   Names of DNSCACHE_NAME_LEN or longer give ERR_ARG.
+
+   Must not be called from tcpip_thread.
+*/
+err_t dnscache_gethostbyname(const char *name, ip_addr_t *addr);
+
+/* Resolve 'name' in the background. 'found' is called once, from
+   tcpip_thread, possibly before this returns. Returns ERR_OK if the
+   lookup was started. */
+err_t dnscache_resolve(const char *name, dnscache_found_fn found, void *arg);
+
+/* Drop all cached names */
+void dnscache_flush(void);
+
+/* The cached address for 'name' as a u32_t, or IPADDR_NONE. For lwIP's
+   DNS_LOOKUP_LOCAL_EXTERN hook, so only for calling in tcpip_thread. */
+uint32_t dnscache_lookup(const char *name);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _DNSCACHE_H */
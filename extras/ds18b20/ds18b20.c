@@ -1,5 +1,8 @@
+#include <stdio.h>
+#include <string.h>
 #include "FreeRTOS.h"
 #include "task.h"
+#include "timers.h"
 
 #include "onewire/onewire.h"
 #include "ds18b20.h"
@@ -41,9 +44,7 @@ uint8_t ds18b20_read_all(uint8_t pin, ds_sensor_t *result) {
 
         uint8_t get[10];
 
-        for (int k=0;k<9;k++){
-            get[k]=onewire_read(pin);
-        }
+        onewire_read_bytes(pin, get, 9);
         
         //printf("\n ScratchPAD DATA = %X %X %X %X %X %X %X %X %X\n",get[8],get[7],get[6],get[5],get[4],get[3],get[2],get[1],get[0]);
         crc = onewire_crc8(get, 8);
@@ -83,9 +84,7 @@ float ds18b20_read_single(uint8_t pin) {
     
     uint8_t get[10];
 
-    for (int k=0;k<9;k++){
-        get[k]=onewire_read(pin);
-    }
+    onewire_read_bytes(pin, get, 9);
     
     //printf("\n ScratchPAD DATA = %X %X %X %X %X %X %X %X %X\n",get[8],get[7],get[6],get[5],get[4],get[3],get[2],get[1],get[0]);
     uint8_t crc = onewire_crc8(get, 8);
@@ -106,3 +105,117 @@ float ds18b20_read_single(uint8_t pin) {
     return temperature;
     //printf("Got a DS18B20 Reading: %d.%02d\n", (int)temperature, (int)(temperature - (int)temperature) * 100);
 }
+
+#define DS18B20_FAMILY_CODE 0x28
+
+static float ds18b20_decode(const uint8_t *scratchpad)
+{
+    int16_t temp = scratchpad[1] << 8 | scratchpad[0];
+    return temp / 16.0f;
+}
+
+uint8_t ds18b20_scan_bus(ds18b20_bus_t *bus)
+{
+    uint8_t addr[8];
+
+    bus->count = 0;
+    onewire_target_search(bus->pin, DS18B20_FAMILY_CODE);
+    while (bus->count < DS18B20_MAX_PER_BUS && onewire_search(bus->pin, addr)) {
+        // The search carries on into other families once ours are done
+        if (addr[0] != DS18B20_FAMILY_CODE)
+            break;
+        if (onewire_crc8(addr, 7) != addr[7])
+            continue;
+        memcpy(bus->rom[bus->count++], addr, 8);
+    }
+    return bus->count;
+}
+
+void ds18b20_convert_all(ds18b20_bus_t *buses, uint8_t nbuses)
+{
+    static const uint8_t cmd[] = { DS1820_SKIP_ROM, DS1820_CONVERT_T };
+
+    for (uint8_t i = 0; i < nbuses; i++) {
+        if (!buses[i].count)
+            continue;
+        if (onewire_reset(buses[i].pin))
+            onewire_write_bytes(buses[i].pin, cmd, sizeof(cmd), ONEWIRE_DEFAULT_POWER);
+    }
+}
+
+uint8_t ds18b20_read_buses(ds18b20_bus_t *buses, uint8_t nbuses, ds_sensor_t *result, uint8_t max)
+{
+    uint8_t count = 0;
+    uint8_t sensor_id = 0;
+    uint8_t get[9];
+
+    for (uint8_t i = 0; i < nbuses; i++) {
+        ds18b20_bus_t *bus = &buses[i];
+        for (uint8_t j = 0; j < bus->count && count < max; j++, sensor_id++) {
+            if (!onewire_reset(bus->pin))
+                continue;
+            onewire_select(bus->pin, bus->rom[j]);
+            onewire_write(bus->pin, DS1820_READ_SCRATCHPAD, ONEWIRE_DEFAULT_POWER);
+            onewire_read_bytes(bus->pin, get, sizeof(get));
+            if (onewire_crc8(get, 8) != get[8])
+                continue;
+            result[count].id = sensor_id;
+            result[count].value = ds18b20_decode(get);
+            count++;
+        }
+    }
+    return count;
+}
+
+uint8_t ds18b20_measure_all(ds18b20_bus_t *buses, uint8_t nbuses, ds_sensor_t *result, uint8_t max)
+{
+    ds18b20_convert_all(buses, nbuses);
+    vTaskDelay(DS18B20_CONVERSION_MS / portTICK_RATE_MS);
+    return ds18b20_read_buses(buses, nbuses, result, max);
+}
+
+static struct {
+    xTimerHandle timer;
+    ds18b20_bus_t *buses;
+    uint8_t nbuses;
+    ds_sensor_t *result;
+    uint8_t max;
+    ds18b20_done_cb_t done;
+    void *arg;
+    volatile bool busy;
+} pending;
+
+static void ds18b20_timer_cb(xTimerHandle timer)
+{
+    uint8_t count = ds18b20_read_buses(pending.buses, pending.nbuses, pending.result, pending.max);
+    pending.busy = false;
+    if (pending.done)
+        pending.done(pending.result, count, pending.arg);
+}
+
+bool ds18b20_measure_all_async(ds18b20_bus_t *buses, uint8_t nbuses, ds_sensor_t *result, uint8_t max,
+                               ds18b20_done_cb_t done, void *arg)
+{
+    if (pending.busy)
+        return false;
+    if (!pending.timer) {
+        pending.timer = xTimerCreate((signed char *)"ds18b20", DS18B20_CONVERSION_MS / portTICK_RATE_MS,
+                                     pdFALSE, NULL, ds18b20_timer_cb);
+        if (!pending.timer)
+            return false;
+    }
+    pending.busy = true;
+    pending.buses = buses;
+    pending.nbuses = nbuses;
+    pending.result = result;
+    pending.max = max;
+    pending.done = done;
+    pending.arg = arg;
+
+    ds18b20_convert_all(buses, nbuses);
+    if (xTimerStart(pending.timer, 0) != pdPASS) {
+        pending.busy = false;
+        return false;
+    }
+    return true;
+}
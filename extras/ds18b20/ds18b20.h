@@ -1,6 +1,17 @@
 #ifndef DRIVER_DS18B20_H_
 #define DRIVER_DS18B20_H_
 
+#include <stdint.h>
+#include <stdbool.h>
+
+// Most sensors cached per bus
+#ifndef DS18B20_MAX_PER_BUS
+#define DS18B20_MAX_PER_BUS 16
+#endif
+
+// Conversion time at 12 bit resolution
+#define DS18B20_CONVERSION_MS 750
+
 typedef struct {
     uint8_t id;
     float value;
@@ -14,4 +25,44 @@ uint8_t ds18b20_read_all(uint8_t pin, ds_sensor_t *result);
 // temperature from single dallas chip.
 float ds18b20_read_single(uint8_t pin);
 
+// A 1-Wire bus and the ROM codes of the sensors found on it by
+// ds18b20_scan_bus(). Set 'pin' (after onewire_init()) and scan once,
+// the ROM list is then reused by every measurement.
+typedef struct {
+    uint8_t pin;
+    uint8_t count;
+    uint8_t rom[DS18B20_MAX_PER_BUS][8];
+} ds18b20_bus_t;
+
+// Search the bus for DS18B20s and cache their ROM codes. Returns the
+// number found.
+uint8_t ds18b20_scan_bus(ds18b20_bus_t *bus);
+
+// Start a conversion on every sensor of every bus, with one skip ROM
+// command per bus. The bus is left powered for parasite powered sensors.
+void ds18b20_convert_all(ds18b20_bus_t *buses, uint8_t nbuses);
+
+// Read the result of the last conversion from each cached sensor, into
+// at most 'max' entries of 'result'. Sensors are numbered in bus order,
+// and ones that fail the CRC check are left out (their id is skipped).
+// Returns the number of entries filled.
+uint8_t ds18b20_read_buses(ds18b20_bus_t *buses, uint8_t nbuses, ds_sensor_t *result, uint8_t max);
+
+// Convert on all buses, wait one conversion period, and read everything.
+// However many sensors there are, this takes one conversion period plus
+// about 12 ms per sensor to read.
+uint8_t ds18b20_measure_all(ds18b20_bus_t *buses, uint8_t nbuses, ds_sensor_t *result, uint8_t max);
+
+typedef void (*ds18b20_done_cb_t)(ds_sensor_t *result, uint8_t count, void *arg);
+
+// The same without blocking: starts the conversions and returns, then
+// reads the sensors from a FreeRTOS timer once the conversion period has
+// passed and calls 'done' (in the timer service task). 'buses' and
+// 'result' must stay valid until then.
+//
+// Returns false if a previous measurement is still in progress, or the
+// timer can't be created.
+bool ds18b20_measure_all_async(ds18b20_bus_t *buses, uint8_t nbuses, ds_sensor_t *result, uint8_t max,
+                               ds18b20_done_cb_t done, void *arg);
+
 #endif
@@ -0,0 +1,9 @@
+# Component makefile for extras/encoder
+
+# expected anyone using encoder includes it as 'encoder/encoder.h'
+INC_DIRS += $(encoder_ROOT)..
+
+# args for passing into compile rule generation
+encoder_SRC_DIR =  $(encoder_ROOT)
+
+$(eval $(call component_compile_rules,encoder))
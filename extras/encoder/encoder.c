@@ -0,0 +1,199 @@
+/* Quadrature encoder decoding from GPIO interrupts, see encoder.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "encoder.h"
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <esp/gpio.h>
+#include <esp/clocks.h>
+#include <esp/interrupts.h>
+#include <common_macros.h>
+
+/* Longest time between reads that CPU cycle counts still measure, at
+   160 MHz they wrap in 26 seconds */
+#define STALE_MS 20000
+
+#define BAD 2
+
+/* Step for a move from state (A << 1 | B) 'prev' to 'cur', indexed by
+   prev << 2 | cur. Forward (A leading B) is 00, 10, 11, 01. */
+static const int8_t x4_step[16] = {
+     0, -1, +1, BAD,
+    +1,  0, BAD, -1,
+    -1, BAD,  0, +1,
+    BAD, +1, -1,  0,
+};
+
+static encoder_t *encoders[ENCODER_MAX];
+static volatile uint32_t encoder_pins;
+
+static inline uint32_t read_ccount(void)
+{
+    uint32_t ccount;
+    __asm__ volatile ("rsr %0, ccount" : "=a" (ccount));
+    return ccount;
+}
+
+static inline void IRAM step(encoder_t *e, uint32_t in, uint32_t now)
+{
+    uint8_t s = (((in >> e->a) & 1) << 1) | ((in >> e->b) & 1);
+
+    if (e->mode == ENCODER_X4) {
+        int8_t d = x4_step[(e->state << 2) | s];
+        if (d == BAD) {
+            e->errors++;
+        } else if (d) {
+            e->count += d;
+            e->edge_ccount = now;
+        }
+    } else if ((s ^ e->state) & 2) {
+        /* A changed: forward if it's now different from B */
+        e->count += (s == 1 || s == 2) ? 1 : -1;
+        e->edge_ccount = now;
+    } else {
+        /* Interrupted on A but it's back where it was */
+        e->errors++;
+    }
+    e->state = s;
+}
+
+/* The GPIO vector while encoders run */
+static void IRAM encoder_isr(void)
+{
+    uint32_t status = GPIO.STATUS;
+    uint32_t ours = status & encoder_pins;
+
+    /* Clear before sampling so an edge after the sample interrupts
+       again */
+    GPIO.STATUS_CLEAR = ours;
+    uint32_t in = GPIO.IN;
+    uint32_t now = read_ccount();
+
+    for (int i = 0; i < ENCODER_MAX; i++) {
+        encoder_t *e = encoders[i];
+        if (e && (ours & e->mask))
+            step(e, in, now);
+    }
+    if (status & ~ours)
+        gpio_interrupt_handler();
+}
+
+/* For when the generic vector is in place */
+static void IRAM pin_handler(uint8_t gpio_num, void *arg)
+{
+    step(arg, GPIO.IN, read_ccount());
+}
+
+bool encoder_init(encoder_t *enc, uint8_t a, uint8_t b, encoder_mode_t mode)
+{
+    int slot = -1;
+    for (int i = 0; i < ENCODER_MAX; i++) {
+        if (!encoders[i]) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0)
+        return false;
+
+    gpio_enable(a, GPIO_INPUT);
+    gpio_enable(b, GPIO_INPUT);
+    gpio_set_pullup(a, true, false);
+    gpio_set_pullup(b, true, false);
+
+    enc->a = a;
+    enc->b = b;
+    enc->mode = mode;
+    enc->mask = BIT(a) | (mode == ENCODER_X4 ? BIT(b) : 0);
+    enc->count = enc->read_count = 0;
+    enc->errors = 0;
+    enc->velocity = 0;
+    enc->state = (gpio_read(a) << 1) | gpio_read(b);
+    enc->edge_ccount = enc->read_edge = read_ccount();
+    enc->read_ticks = xTaskGetTickCount();
+
+    gpio_set_interrupt_handler(a, GPIO_INTTYPE_EDGE_ANY, pin_handler, enc);
+    if (mode == ENCODER_X4)
+        gpio_set_interrupt_handler(b, GPIO_INTTYPE_EDGE_ANY, pin_handler, enc);
+
+    taskENTER_CRITICAL();
+    encoders[slot] = enc;
+    encoder_pins |= enc->mask;
+    _xt_isr_attach(INUM_GPIO, encoder_isr);
+    taskEXIT_CRITICAL();
+    return true;
+}
+
+void encoder_deinit(encoder_t *enc)
+{
+    gpio_set_interrupt_handler(enc->a, GPIO_INTTYPE_NONE, NULL, NULL);
+    if (enc->mode == ENCODER_X4)
+        gpio_set_interrupt_handler(enc->b, GPIO_INTTYPE_NONE, NULL, NULL);
+
+    taskENTER_CRITICAL();
+    uint32_t pins = 0;
+    for (int i = 0; i < ENCODER_MAX; i++) {
+        if (encoders[i] == enc)
+            encoders[i] = NULL;
+        else if (encoders[i])
+            pins |= encoders[i]->mask;
+    }
+    encoder_pins = pins;
+    taskEXIT_CRITICAL();
+}
+
+void encoder_read(encoder_t *enc, encoder_state_t *state)
+{
+    taskENTER_CRITICAL();
+    int32_t count = enc->count;
+    uint32_t edge = enc->edge_ccount;
+    state->errors = enc->errors;
+    taskEXIT_CRITICAL();
+
+    uint32_t ticks = xTaskGetTickCount();
+    bool stale = (ticks - enc->read_ticks) * portTICK_RATE_MS > STALE_MS;
+    int32_t moved = count - enc->read_count;
+
+    if (moved) {
+        uint32_t cycles = edge - enc->read_edge;
+        if (stale) {
+            uint32_t ms = (ticks - enc->read_ticks) * portTICK_RATE_MS;
+            enc->velocity = (int64_t)moved * 1000 / ms;
+        } else if (cycles) {
+            /* Exactly 'moved' counts from one edge to the other */
+            enc->velocity = (int64_t)moved * cpu_clk_freq() / cycles;
+        }
+        enc->read_count = count;
+        enc->read_edge = edge;
+        enc->read_ticks = ticks;
+    } else if (stale) {
+        enc->velocity = 0;
+    } else {
+        /* No edge yet: it's at most one count in the time since the
+           last */
+        uint32_t since = read_ccount() - edge;
+        if (since) {
+            int32_t bound = cpu_clk_freq() / since;
+            if (enc->velocity > bound)
+                enc->velocity = bound;
+            else if (enc->velocity < -bound)
+                enc->velocity = -bound;
+        }
+    }
+
+    state->position = count;
+    state->velocity = enc->velocity;
+}
+
+void encoder_set_position(encoder_t *enc, int32_t position)
+{
+    taskENTER_CRITICAL();
+    int32_t shift = position - enc->count;
+    enc->count = position;
+    enc->read_count += shift;
+    taskEXIT_CRITICAL();
+}
@@ -0,0 +1,88 @@
+/* Quadrature encoder decoding from GPIO interrupts
+ *
+ * For motor feedback at tens of thousands of edges a second. The
+ * encoder takes the GPIO interrupt vector itself: its handler reads
+ * GPIO.STATUS and GPIO.IN once, steps every encoder whose pins changed
+ * through a 16 entry transition table, and only calls the generic
+ * gpio_interrupt_handler() when some other pin is also pending. So an
+ * edge costs a table lookup rather than the generic per-pin dispatch.
+ *
+ * ENCODER_X4 interrupts on both edges of both channels and counts four
+ * per cycle. ENCODER_X2 interrupts on channel A only, sampling B in the
+ * same interrupt, for half the interrupt rate at half the resolution.
+ * A transition where both channels changed at once (an edge missed, or
+ * the encoder too fast for the interrupt) can't be decoded and is
+ * counted as an error.
+ *
+ * encoder_read() gives position and velocity consistently. Velocity is
+ * timed between edges (CPU cycle stamps taken in the interrupt), so it
+ * stays accurate at low speeds without a long measuring window; with no
+ * edges since the last read it decays as 1 / time since the last one.
+ * Read at least every 20 seconds, as cycle counts wrap.
+ *
+ * Call encoder_init() after any gpio_set_interrupt() or
+ * gpio_set_interrupt_handler() for other pins:
+ * that puts the generic vector back, which still counts (the encoder
+ * registers per-pin handlers with it too), just less quickly.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _ENCODER_H
+#define _ENCODER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifndef ENCODER_MAX
+#define ENCODER_MAX 4
+#endif
+
+typedef enum {
+    ENCODER_X4,
+    ENCODER_X2,
+} encoder_mode_t;
+
+typedef struct {
+    int32_t position;           /* counts, up when A leads B */
+    int32_t velocity;           /* counts per second */
+    uint32_t errors;            /* undecodable transitions */
+} encoder_state_t;
+
+typedef struct {
+    /* Private, written by the interrupt */
+    volatile int32_t count;
+    volatile uint32_t errors;
+    volatile uint32_t edge_ccount;
+    uint8_t state;
+
+    /* Private */
+    uint8_t a, b;
+    encoder_mode_t mode;
+    uint32_t mask;
+    int32_t read_count;
+    uint32_t read_edge, read_ticks;
+    int32_t velocity;
+} encoder_t;
+
+/* Start decoding pins 'a' and 'b' (set as inputs with pull-ups) into
+   'enc', which must stay allocated. Returns false if ENCODER_MAX are
+   running already. */
+bool encoder_init(encoder_t *enc, uint8_t a, uint8_t b, encoder_mode_t mode);
+
+void encoder_deinit(encoder_t *enc);
+
+void encoder_read(encoder_t *enc, encoder_state_t *state);
+
+void encoder_set_position(encoder_t *enc, int32_t position);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _ENCODER_H */
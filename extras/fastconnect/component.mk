@@ -0,0 +1,9 @@
+# Component makefile for extras/fastconnect
+
+# expected anyone using fastconnect includes it as 'fastconnect/fastconnect.h'
+INC_DIRS += $(fastconnect_ROOT)..
+
+# args for passing into compile rule generation
+fastconnect_SRC_DIR =  $(fastconnect_ROOT)
+
+$(eval $(call component_compile_rules,fastconnect))
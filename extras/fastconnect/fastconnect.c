@@ -0,0 +1,326 @@
+/* Fast Wi-Fi reconnect after deep sleep, see fastconnect.h
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "fastconnect.h"
+
+#include <string.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+
+#include <lwip/netif.h>
+#include <lwip/tcpip.h>
+#include <lwip/dhcp.h>
+#include <lwip/dns.h>
+#include <netif/etharp.h>
+
+#include "espressif/esp_common.h"
+#include "esp/rtcmem_regs.h"
+#include "crc.h"
+#include "sdk_internal.h"
+
+#define STATE_MAGIC 0x46434e31 /* "FCN1" */
+
+/* Start of the state in RTCMEM_USER */
+#define RTC_OFFSET (sizeof(RTCMEM_USER) / sizeof(uint32_t) - FASTCONNECT_RTC_WORDS)
+
+/* Leases longer than this (or infinite) are counted as this long */
+#define LEASE_MAX_MS 0x7fffffff
+
+typedef struct {
+    uint32_t magic;
+    uint32_t net_hash;      /* of the ssid and password */
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t gw_mac_valid;
+    uint8_t gw_mac[6];
+    uint16_t reserved;
+    uint32_t ip;
+    uint32_t netmask;
+    uint32_t gw;
+    uint32_t dns;
+    uint32_t lease_ms;      /* left when the state was saved, after the sleep */
+    uint32_t crc;
+} fastconnect_state_t;
+
+_Static_assert(sizeof(fastconnect_state_t) == FASTCONNECT_RTC_WORDS * sizeof(uint32_t),
+               "fastconnect_state_t doesn't match FASTCONNECT_RTC_WORDS");
+
+static fastconnect_state_t state;
+static struct sdk_station_config config;
+static bool fast_path;
+static bool connected;
+static portTickType connect_tick;
+
+/* The lease had lease_ms left at lease_tick */
+static uint32_t lease_ms;
+static portTickType lease_tick;
+
+static uint32_t fnv1a(uint32_t hash, const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= 16777619;
+    }
+    return hash;
+}
+
+static uint32_t net_hash(void)
+{
+    uint32_t hash = fnv1a(2166136261u, config.ssid, sizeof(config.ssid));
+    return fnv1a(hash, config.password, sizeof(config.password));
+}
+
+static uint32_t ms_since(portTickType tick)
+{
+    return (xTaskGetTickCount() - tick) * portTICK_RATE_MS;
+}
+
+/* RTC memory only supports word accesses */
+static bool load_state(void)
+{
+    uint32_t *words = (uint32_t *)&state;
+
+    for (int i = 0; i < FASTCONNECT_RTC_WORDS; i++)
+        words[i] = RTCMEM_USER[RTC_OFFSET + i];
+    return state.magic == STATE_MAGIC
+        && state.crc == crc32_ieee(0, &state, offsetof(fastconnect_state_t, crc));
+}
+
+static void store_state(void)
+{
+    const uint32_t *words = (const uint32_t *)&state;
+
+    state.magic = STATE_MAGIC;
+    state.crc = crc32_ieee(0, &state, offsetof(fastconnect_state_t, crc));
+    for (int i = 0; i < FASTCONNECT_RTC_WORDS; i++)
+        RTCMEM_USER[RTC_OFFSET + i] = words[i];
+}
+
+void fastconnect_invalidate(void)
+{
+    RTCMEM_USER[RTC_OFFSET] = 0;
+    state.magic = 0;
+}
+
+/* Run fn(arg) in tcpip_thread and wait for it to finish, as lwIP's
+   netif, ARP and DHCP state may only be touched from there. */
+typedef struct {
+    sys_sem_t done;
+    err_t err;
+    uint32_t lease_s;
+    bool gw_mac_valid;
+    uint8_t gw_mac[6];
+} tcpip_call_t;
+
+static bool run_in_tcpip(tcpip_callback_fn fn, tcpip_call_t *call)
+{
+    if (sys_sem_new(&call->done, 0) != ERR_OK)
+        return false;
+    bool ok = tcpip_callback(fn, call) == ERR_OK;
+    if (ok)
+        sys_sem_wait(&call->done);
+    sys_sem_free(&call->done);
+    return ok;
+}
+
+static void add_gw_entry_cb(void *arg)
+{
+    tcpip_call_t *call = arg;
+    ip_addr_t gw = { state.gw };
+    struct eth_addr mac;
+
+    memcpy(mac.addr, state.gw_mac, sizeof(mac.addr));
+    call->err = etharp_add_static_entry(&gw, &mac);
+    sys_sem_signal(&call->done);
+}
+
+static void read_lease_cb(void *arg)
+{
+    tcpip_call_t *call = arg;
+    struct netif *netif = sdk_g_ic.v.station_netif_info->netif;
+
+    call->lease_s = netif->dhcp ? netif->dhcp->offered_t0_lease : 0;
+    sys_sem_signal(&call->done);
+}
+
+static void read_gw_mac_cb(void *arg)
+{
+    tcpip_call_t *call = arg;
+    struct netif *netif = sdk_g_ic.v.station_netif_info->netif;
+    struct eth_addr *mac;
+    ip_addr_t *ip;
+
+    call->gw_mac_valid = etharp_find_addr(netif, &netif->gw, &mac, &ip) >= 0;
+    if (call->gw_mac_valid)
+        memcpy(call->gw_mac, mac->addr, sizeof(call->gw_mac));
+    sys_sem_signal(&call->done);
+}
+
+static void connect_normal(void)
+{
+    config.bssid_set = 0;
+    sdk_wifi_station_set_config(&config);
+    sdk_wifi_station_dhcpc_start();
+    sdk_wifi_station_connect();
+}
+
+bool fastconnect_start(const char *ssid, const char *password)
+{
+    memset(&config, 0, sizeof(config));
+    strncpy((char *)config.ssid, ssid, sizeof(config.ssid));
+    strncpy((char *)config.password, password, sizeof(config.password));
+
+    connected = false;
+    connect_tick = xTaskGetTickCount();
+    fast_path = load_state() && state.net_hash == net_hash()
+        && state.lease_ms > FASTCONNECT_LEASE_MARGIN_MS;
+
+    sdk_wifi_set_opmode(STATION_MODE);
+    if (!fast_path) {
+        connect_normal();
+        return false;
+    }
+
+    lease_ms = state.lease_ms;
+    lease_tick = connect_tick;
+
+    struct ip_info info;
+    info.ip.addr = state.ip;
+    info.netmask.addr = state.netmask;
+    info.gw.addr = state.gw;
+    ip_addr_t dns = { state.dns };
+
+    sdk_wifi_station_dhcpc_stop();
+    sdk_wifi_set_ip_info(STATION_IF, &info);
+    dns_setserver(0, &dns);
+
+    config.bssid_set = 1;
+    memcpy(config.bssid, state.bssid, sizeof(config.bssid));
+    sdk_wifi_station_set_config(&config);
+    sdk_wifi_set_channel(state.channel);
+    sdk_wifi_station_connect();
+    return true;
+}
+
+bool fastconnect_wait(uint32_t timeout_ms)
+{
+    portTickType start = xTaskGetTickCount();
+
+    while (!connected) {
+        if (sdk_wifi_station_get_connect_status() == STATION_GOT_IP) {
+            tcpip_call_t call;
+            if (fast_path) {
+                if (state.gw_mac_valid)
+                    run_in_tcpip(add_gw_entry_cb, &call);
+            } else {
+                lease_tick = xTaskGetTickCount();
+                lease_ms = 0;
+                if (run_in_tcpip(read_lease_cb, &call))
+                    lease_ms = call.lease_s < LEASE_MAX_MS / 1000 ? call.lease_s * 1000 : LEASE_MAX_MS;
+            }
+            connected = true;
+            break;
+        }
+        if (fast_path && ms_since(connect_tick) >= FASTCONNECT_FAST_TIMEOUT_MS) {
+            printf("fastconnect: fast path failed, reconnecting\n");
+            fastconnect_invalidate();
+            fast_path = false;
+            sdk_wifi_station_disconnect();
+            connect_normal();
+        }
+        if (ms_since(start) >= timeout_ms)
+            break;
+        vTaskDelay(10 / portTICK_RATE_MS);
+    }
+    return connected;
+}
+
+static xSemaphoreHandle scan_done;
+static bool scan_found;
+
+static void scan_cb(void *arg, sdk_scan_status_t status)
+{
+    struct sdk_bss_info *bss;
+    int8_t best_rssi = -128;
+
+    scan_found = false;
+    if (status == SCAN_OK) {
+        for (bss = arg; bss; bss = STAILQ_NEXT(bss, next)) {
+            if (memcmp(bss->ssid, config.ssid, sizeof(bss->ssid)) || bss->rssi < best_rssi)
+                continue;
+            memcpy(state.bssid, bss->bssid, sizeof(state.bssid));
+            best_rssi = bss->rssi;
+            scan_found = true;
+        }
+    }
+    xSemaphoreGive(scan_done);
+}
+
+/* Find the AP's BSSID with a scan of the current channel */
+static bool find_bssid(void)
+{
+    struct sdk_scan_config scan = {
+        .ssid = config.ssid,
+        .channel = state.channel,
+    };
+
+    if (!scan_done) {
+        vSemaphoreCreateBinary(scan_done);
+        if (!scan_done)
+            return false;
+    }
+    xSemaphoreTake(scan_done, 0);
+    if (!sdk_wifi_station_scan(&scan, scan_cb))
+        return false;
+    xSemaphoreTake(scan_done, portMAX_DELAY);
+    return scan_found;
+}
+
+bool fastconnect_save(uint32_t sleep_ms)
+{
+    struct ip_info info;
+    tcpip_call_t call;
+
+    if (!connected || sdk_wifi_station_get_connect_status() != STATION_GOT_IP
+        || !sdk_wifi_get_ip_info(STATION_IF, &info)) {
+        fastconnect_invalidate();
+        return false;
+    }
+
+    uint32_t used_ms = ms_since(lease_tick) + sleep_ms;
+    if (lease_ms < used_ms + FASTCONNECT_LEASE_MARGIN_MS) {
+        fastconnect_invalidate();
+        return false;
+    }
+
+    state.channel = sdk_wifi_get_channel();
+    if (!fast_path && !find_bssid()) {
+        fastconnect_invalidate();
+        return false;
+    }
+
+    /* At this point the gateway is normally in the ARP table, from the
+       traffic of this wake */
+    state.gw_mac_valid = 0;
+    if (run_in_tcpip(read_gw_mac_cb, &call) && call.gw_mac_valid) {
+        memcpy(state.gw_mac, call.gw_mac, sizeof(state.gw_mac));
+        state.gw_mac_valid = 1;
+    }
+
+    ip_addr_t dns = dns_getserver(0);
+    state.net_hash = net_hash();
+    state.ip = info.ip.addr;
+    state.netmask = info.netmask.addr;
+    state.gw = info.gw.addr;
+    state.dns = dns.addr;
+    state.lease_ms = lease_ms - used_ms;
+    state.reserved = 0;
+    store_state();
+    return true;
+}
@@ -0,0 +1,88 @@
+/* Fast Wi-Fi reconnect after deep sleep, from state kept in RTC memory
+ *
+ * A normal station connect scans every channel for the AP, runs DHCP
+ * and then ARPs for the gateway before the first packet goes out.
+ * On a sensor that wakes from deep sleep to send one reading, that is
+ * most of the time it's awake.
+ *
+ * Before going to sleep, fastconnect_save() stores the AP's BSSID and
+ * channel, the DHCP assigned address, netmask, gateway and DNS server,
+ * and the gateway's MAC address in RTC memory (which survives deep
+ * sleep), protected by a CRC. On wake, fastconnect_start() connects
+ * straight to that BSSID, with the address configured statically and
+ * the gateway already in the ARP table.
+ *
+ * The saved address is only used while the DHCP lease it came from is
+ * still running (the time spent asleep is counted), so the DHCP server
+ * won't have given it to someone else. If the saved state is missing,
+ * stale, for another network, or the fast connect doesn't succeed in
+ * FASTCONNECT_FAST_TIMEOUT_MS, it falls back to a normal connect.
+ *
+ * The state takes FASTCONNECT_RTC_WORDS words at the end of the user
+ * RTC memory (RTCMEM_USER), the rest is free for the application.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _FASTCONNECT_H
+#define _FASTCONNECT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/* Words of RTCMEM_USER used, from the end */
+#define FASTCONNECT_RTC_WORDS 12
+
+/* How long the fast path gets before falling back to a normal connect */
+#ifndef FASTCONNECT_FAST_TIMEOUT_MS
+#define FASTCONNECT_FAST_TIMEOUT_MS 1500
+#endif
+
+/* Don't reuse an address with less than this much of its lease left */
+#ifndef FASTCONNECT_LEASE_MARGIN_MS
+#define FASTCONNECT_LEASE_MARGIN_MS 60000
+#endif
+
+/* Start connecting to an AP as a station.
+
+   Uses the saved state if it's valid for this ssid and password,
+   otherwise makes a normal connect (with DHCP). Returns true if the
+   fast path is being tried.
+
+   Call instead of sdk_wifi_station_set_config()/connect(). Station
+   mode is selected here.
+*/
+bool fastconnect_start(const char *ssid, const char *password);
+
+/* Wait up to timeout_ms for the station to get its address. Returns
+   true once connected.
+
+   A fast connect that hasn't succeeded after FASTCONNECT_FAST_TIMEOUT_MS
+   is abandoned, the saved state is discarded and a normal connect is
+   made in the time remaining.
+*/
+bool fastconnect_wait(uint32_t timeout_ms);
+
+/* Save the current connection, to be used when waking up from a deep
+   sleep of sleep_ms. Call just before sdk_system_deep_sleep().
+
+   The first save after a normal connect scans the current channel to
+   find the AP's BSSID, which takes around 100 ms.
+
+   Returns false (and invalidates any saved state) if the station isn't
+   connected, or the lease would run out during the sleep.
+*/
+bool fastconnect_save(uint32_t sleep_ms);
+
+/* Discard the saved state, so the next wake makes a normal connect. */
+void fastconnect_invalidate(void);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _FASTCONNECT_H */
@@ -0,0 +1,9 @@
+# Component makefile for extras/flashkv
+
+# expected anyone using flashkv includes it as 'flashkv/flashkv.h'
+INC_DIRS += $(flashkv_ROOT)..
+
+# args for passing into compile rule generation
+flashkv_SRC_DIR =  $(flashkv_ROOT)
+
+$(eval $(call component_compile_rules,flashkv))
@@ -0,0 +1,596 @@
+/* Log structured key-value store on SPI flash, see flashkv.h
+ *
+ * Each sector starts with an 8 byte header: a magic word and a sequence
+ * number, which is one more than the previous head's. Free sectors are
+ * fully erased. Records follow the header, word aligned:
+ *
+ *   uint32_t info;   flags (bits 0-7), key length (8-15), value length (16-31)
+ *   uint32_t check;  FNV-1a of info, key and value
+ *   key bytes, value bytes, 0xff padding to a word
+ *
+ * A record whose info word is still erased marks the end of a sector's
+ * log. One with a bad check is skipped, and one with an insane info
+ * word ends the log of that sector.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "flashkv.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <esp/flashcache.h>
+#include <FreeRTOS.h>
+#include <semphr.h>
+
+#define SECTOR_SIZE SPI_FLASH_SEC_SIZE
+#define SECTOR_MAGIC 0x31564b46 /* "FKV1" */
+#define SECTOR_HEADER 8
+#define RECORD_HEADER 8
+#define SECTOR_CAPACITY (SECTOR_SIZE - SECTOR_HEADER)
+
+#define FLAG_LIVE 0xa5
+#define FLAG_DELETED 0x5a
+
+#define ERASED 0xffffffff
+
+/* Bytes moved through the stack per flash access */
+#define CHUNK 64
+
+#define ALIGN4(x) (((x) + 3) & ~3)
+
+#define FNV_INIT 0x811c9dc5
+
+#define INFO(flags, key_len, value_len) ((flags) | ((key_len) << 8) | ((uint32_t)(value_len) << 16))
+#define INFO_FLAGS(info) ((info) & 0xff)
+#define INFO_KEY_LEN(info) (((info) >> 8) & 0xff)
+#define INFO_VALUE_LEN(info) ((info) >> 16)
+
+typedef struct {
+    uint32_t addr;
+    size_t fill;
+    uint32_t buf[CHUNK / 4];
+} kv_writer_t;
+
+static inline uint32_t record_size(uint32_t info)
+{
+    return RECORD_HEADER + ALIGN4(INFO_KEY_LEN(info) + INFO_VALUE_LEN(info));
+}
+
+static inline bool info_valid(uint32_t info)
+{
+    uint8_t flags = INFO_FLAGS(info);
+    return (flags == FLAG_LIVE || flags == FLAG_DELETED)
+        && INFO_KEY_LEN(info) > 0 && INFO_KEY_LEN(info) <= FLASHKV_MAX_KEY_LEN
+        && INFO_VALUE_LEN(info) <= FLASHKV_MAX_VALUE_LEN;
+}
+
+static inline uint32_t sector_addr(const flashkv_t *kv, uint16_t sector)
+{
+    return kv->start + sector * SECTOR_SIZE;
+}
+
+static inline uint16_t addr_sector(const flashkv_t *kv, uint32_t addr)
+{
+    return (addr - kv->start) / SECTOR_SIZE;
+}
+
+static uint32_t fnv1a(uint32_t hash, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    while (len--) {
+        hash ^= *p++;
+        hash *= 0x01000193;
+    }
+    return hash;
+}
+
+/* Read 'len' bytes from any flash address into any buffer. Goes
+   through the flash read cache (if the application set one up): index
+   lookups re-read the same record headers and keys a lot. */
+static bool kv_read(uint32_t addr, void *dest, size_t len)
+{
+    return flashcache_read(addr, dest, len) == SPI_FLASH_RESULT_OK;
+}
+
+/* FNV-1a over 'len' bytes of flash */
+static bool kv_hash(uint32_t addr, size_t len, uint32_t *hash)
+{
+    uint8_t buf[CHUNK];
+
+    while (len) {
+        size_t n = len < CHUNK ? len : CHUNK;
+        if (!kv_read(addr, buf, n))
+            return false;
+        *hash = fnv1a(*hash, buf, n);
+        addr += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool writer_flush(kv_writer_t *w)
+{
+    size_t len = ALIGN4(w->fill);
+
+    memset((uint8_t *)w->buf + w->fill, 0xff, len - w->fill);
+    if (len && flashcache_write(w->addr, w->buf, len) != SPI_FLASH_RESULT_OK)
+        return false;
+    w->addr += len;
+    w->fill = 0;
+    return true;
+}
+
+static bool writer_put(kv_writer_t *w, const void *data, size_t len)
+{
+    const uint8_t *s = data;
+
+    while (len) {
+        size_t n = CHUNK - w->fill;
+        if (n > len)
+            n = len;
+        memcpy((uint8_t *)w->buf + w->fill, s, n);
+        w->fill += n;
+        s += n;
+        len -= n;
+        if (w->fill == CHUNK && !writer_flush(w))
+            return false;
+    }
+    return true;
+}
+
+/* Index: open addressing with linear probing, keyed on the FNV-1a of
+   the key. Hashes can collide, so matches are confirmed by reading
+   the record's key back from flash. */
+
+static bool record_has_key(uint32_t addr, const char *key, size_t key_len)
+{
+    uint32_t info;
+    char stored[FLASHKV_MAX_KEY_LEN];
+
+    if (!kv_read(addr, &info, sizeof(info)) || INFO_KEY_LEN(info) != key_len)
+        return false;
+    if (!kv_read(addr + RECORD_HEADER, stored, key_len))
+        return false;
+    return memcmp(stored, key, key_len) == 0;
+}
+
+static flashkv_index_t *index_find(flashkv_t *kv, uint32_t hash, const char *key, size_t key_len)
+{
+    for (uint32_t i = hash & kv->index_mask; kv->index[i].addr; i = (i + 1) & kv->index_mask) {
+        if (kv->index[i].hash == hash && record_has_key(kv->index[i].addr, key, key_len))
+            return &kv->index[i];
+    }
+    return NULL;
+}
+
+static inline bool index_full(const flashkv_t *kv)
+{
+    /* keep the table at most half full */
+    return kv->count > kv->index_mask / 2;
+}
+
+static void index_insert(flashkv_t *kv, uint32_t hash, uint32_t addr)
+{
+    uint32_t i = hash & kv->index_mask;
+    while (kv->index[i].addr)
+        i = (i + 1) & kv->index_mask;
+    kv->index[i].hash = hash;
+    kv->index[i].addr = addr;
+    kv->count++;
+}
+
+/* Remove an entry, shifting back any later entries of its probe run */
+static void index_remove(flashkv_t *kv, flashkv_index_t *entry)
+{
+    uint32_t i = entry - kv->index;
+    uint32_t j = i;
+
+    kv->count--;
+    for (;;) {
+        kv->index[i].addr = 0;
+        for (;;) {
+            j = (j + 1) & kv->index_mask;
+            if (!kv->index[j].addr)
+                return;
+            uint32_t home = kv->index[j].hash & kv->index_mask;
+            /* entry j can stay unless its home slot is cyclically in (i, j] */
+            if ((i <= j) ? (i < home && home <= j) : (i < home || home <= j))
+                continue;
+            break;
+        }
+        kv->index[i] = kv->index[j];
+        i = j;
+    }
+}
+
+/* Make the index reflect a record just found or written at 'addr' */
+static bool apply_record(flashkv_t *kv, uint32_t addr, uint32_t info, const char *key)
+{
+    size_t key_len = INFO_KEY_LEN(info);
+    uint32_t hash = fnv1a(FNV_INIT, key, key_len);
+    flashkv_index_t *entry = index_find(kv, hash, key, key_len);
+
+    if (entry) {
+        uint32_t old_info;
+        if (!kv_read(entry->addr, &old_info, sizeof(old_info)))
+            return false;
+        kv->live[addr_sector(kv, entry->addr)] -= record_size(old_info);
+    }
+
+    if (INFO_FLAGS(info) == FLAG_LIVE) {
+        if (entry) {
+            entry->addr = addr;
+        } else {
+            if (index_full(kv))
+                return false;
+            index_insert(kv, hash, addr);
+        }
+        kv->live[addr_sector(kv, addr)] += record_size(info);
+    } else if (entry) {
+        index_remove(kv, entry);
+    }
+    return true;
+}
+
+/* Replay the records of a sector into the index. Sets *end to the
+   offset following the last record. */
+static bool scan_sector(flashkv_t *kv, uint16_t sector, uint32_t *end)
+{
+    uint32_t base = sector_addr(kv, sector);
+    uint32_t offs = SECTOR_HEADER;
+
+    while (offs + RECORD_HEADER <= SECTOR_SIZE) {
+        uint32_t header[2];
+        char key[FLASHKV_MAX_KEY_LEN];
+
+        if (!kv_read(base + offs, header, sizeof(header)))
+            return false;
+        if (header[0] == ERASED)
+            break;
+
+        uint32_t size = record_size(header[0]);
+        if (!info_valid(header[0]) || offs + size > SECTOR_SIZE) {
+            /* can't tell where the next record would be */
+            offs = SECTOR_SIZE;
+            break;
+        }
+
+        size_t key_len = INFO_KEY_LEN(header[0]);
+        uint32_t hash = fnv1a(FNV_INIT, &header[0], sizeof(header[0]));
+        if (!kv_read(base + offs + RECORD_HEADER, key, key_len))
+            return false;
+        hash = fnv1a(hash, key, key_len);
+        if (!kv_hash(base + offs + RECORD_HEADER + key_len, INFO_VALUE_LEN(header[0]), &hash))
+            return false;
+
+        /* a record torn by a power failure fails the check, skip it */
+        if (hash == header[1] && !apply_record(kv, base + offs, header[0], key))
+            return false;
+        offs += size;
+    }
+
+    *end = offs;
+    return true;
+}
+
+/* Check a word aligned range of flash is erased (not through the read
+   cache, which would only be flushed by it) */
+static bool flash_blank(uint32_t addr, uint32_t len)
+{
+    uint32_t buf[CHUNK / 4];
+
+    while (len) {
+        uint32_t n = len < CHUNK ? len : CHUNK;
+        if (sdk_spi_flash_read(addr, buf, n) != SPI_FLASH_RESULT_OK)
+            return false;
+        for (int i = 0; i < n / 4; i++) {
+            if (buf[i] != ERASED)
+                return false;
+        }
+        addr += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool erase_sector(flashkv_t *kv, uint16_t sector)
+{
+    return flashcache_erase_sector(sector_addr(kv, sector) / SECTOR_SIZE) == SPI_FLASH_RESULT_OK;
+}
+
+/* Start appending to the next sector in the ring */
+static bool advance_head(flashkv_t *kv)
+{
+    if (kv->used == kv->sectors)
+        return false;
+
+    uint16_t next = (kv->head + 1) % kv->sectors;
+    /* free sectors are erased already, unless power failed mid-erase */
+    if (!flash_blank(sector_addr(kv, next), SECTOR_SIZE) && !erase_sector(kv, next))
+        return false;
+
+    uint32_t header[2] = { SECTOR_MAGIC, kv->seq + 1 };
+    if (flashcache_write(sector_addr(kv, next), header, sizeof(header)) != SPI_FLASH_RESULT_OK)
+        return false;
+
+    kv->seq++;
+    kv->head = next;
+    kv->head_offs = SECTOR_HEADER;
+    kv->live[next] = 0;
+    kv->used++;
+    return true;
+}
+
+/* Copy a record to the head, as part of compacting its sector */
+static bool copy_record(flashkv_t *kv, uint32_t from, uint32_t size, uint32_t *to)
+{
+    uint8_t buf[CHUNK];
+    kv_writer_t w;
+
+    if (kv->head_offs + size > SECTOR_SIZE && !advance_head(kv))
+        return false;
+
+    w.addr = sector_addr(kv, kv->head) + kv->head_offs;
+    w.fill = 0;
+    *to = w.addr;
+    for (uint32_t offs = 0; offs < size; offs += CHUNK) {
+        size_t n = size - offs < CHUNK ? size - offs : CHUNK;
+        if (!kv_read(from + offs, buf, n) || !writer_put(&w, buf, n))
+            return false;
+    }
+    if (!writer_flush(&w))
+        return false;
+    kv->head_offs += size;
+    return true;
+}
+
+/* Move the live records out of the oldest sector, then erase it.
+
+   A power failure part way leaves both copies of some records, the
+   newer sector's win when the store is opened again. */
+static bool gc_sector(flashkv_t *kv)
+{
+    uint16_t victim = kv->oldest;
+    uint32_t base = sector_addr(kv, victim);
+    uint32_t offs = SECTOR_HEADER;
+
+    if (victim == kv->head)
+        return false;
+
+    while (kv->live[victim] && offs + RECORD_HEADER <= SECTOR_SIZE) {
+        uint32_t info;
+        char key[FLASHKV_MAX_KEY_LEN];
+
+        if (!kv_read(base + offs, &info, sizeof(info)))
+            return false;
+        if (info == ERASED || !info_valid(info))
+            break;
+
+        uint32_t size = record_size(info);
+        if (INFO_FLAGS(info) == FLAG_LIVE) {
+            size_t key_len = INFO_KEY_LEN(info);
+            if (!kv_read(base + offs + RECORD_HEADER, key, key_len))
+                return false;
+            flashkv_index_t *entry = index_find(kv, fnv1a(FNV_INIT, key, key_len), key, key_len);
+            /* only the key's latest record is live. Tombstones here can
+               be dropped, there's no older data left for them to hide. */
+            if (entry && entry->addr == base + offs) {
+                uint32_t to;
+                if (!copy_record(kv, entry->addr, size, &to))
+                    return false;
+                entry->addr = to;
+                kv->live[victim] -= size;
+                kv->live[kv->head] += size;
+            }
+        }
+        offs += size;
+    }
+
+    if (!erase_sector(kv, victim))
+        return false;
+    kv->live[victim] = 0;
+    kv->oldest = (victim + 1) % kv->sectors;
+    kv->used--;
+    return true;
+}
+
+static uint32_t total_live(const flashkv_t *kv)
+{
+    uint32_t total = 0;
+    for (int i = 0; i < kv->sectors; i++)
+        total += kv->live[i];
+    return total;
+}
+
+/* Make room for 'size' bytes at the head. Keeps one free sector in
+   reserve, so compaction always has somewhere to copy to. */
+static bool make_room(flashkv_t *kv, uint32_t size)
+{
+    if (kv->head_offs + size <= SECTOR_SIZE)
+        return true;
+    for (int i = 0; i < kv->sectors && kv->sectors - kv->used <= 1; i++) {
+        if (!gc_sector(kv))
+            return false;
+    }
+    if (kv->head_offs + size <= SECTOR_SIZE)
+        return true;
+    if (kv->sectors - kv->used <= 1)
+        return false;
+    return advance_head(kv);
+}
+
+static bool append_record(flashkv_t *kv, uint32_t info, const char *key, const void *value)
+{
+    size_t key_len = INFO_KEY_LEN(info);
+    size_t value_len = INFO_VALUE_LEN(info);
+    uint32_t size = record_size(info);
+    uint32_t header[2];
+    kv_writer_t w;
+
+    /* two sectors' worth of slack: the reserve, and the unused ends of
+       sectors that didn't fit the next record */
+    if (INFO_FLAGS(info) == FLAG_LIVE) {
+        if (total_live(kv) + size > (kv->sectors - 2) * SECTOR_CAPACITY)
+            return false;
+        if (index_full(kv) && !index_find(kv, fnv1a(FNV_INIT, key, key_len), key, key_len))
+            return false;
+    }
+    if (!make_room(kv, size))
+        return false;
+
+    header[0] = info;
+    header[1] = fnv1a(fnv1a(fnv1a(FNV_INIT, &info, sizeof(info)), key, key_len), value, value_len);
+
+    w.addr = sector_addr(kv, kv->head) + kv->head_offs;
+    w.fill = 0;
+    if (!writer_put(&w, header, sizeof(header)) || !writer_put(&w, key, key_len)
+        || !writer_put(&w, value, value_len) || !writer_flush(&w))
+        return false;
+
+    uint32_t addr = sector_addr(kv, kv->head) + kv->head_offs;
+    kv->head_offs += size;
+    return apply_record(kv, addr, info, key);
+}
+
+bool flashkv_init(flashkv_t *kv, uint32_t start_addr, uint16_t sectors, size_t max_keys)
+{
+    uint32_t index_size = 1;
+    int32_t oldest = -1;
+    int32_t head = -1;
+    uint32_t oldest_seq = 0;
+
+    if ((start_addr % SECTOR_SIZE) || sectors < 3)
+        return false;
+    while (index_size < max_keys * 2)
+        index_size <<= 1;
+
+    memset(kv, 0, sizeof(*kv));
+    kv->start = start_addr;
+    kv->sectors = sectors;
+    kv->index_mask = index_size - 1;
+    kv->index = calloc(index_size, sizeof(flashkv_index_t));
+    kv->live = calloc(sectors, sizeof(uint16_t));
+    kv->lock = xSemaphoreCreateMutex();
+    if (!kv->index || !kv->live || !kv->lock)
+        goto fail;
+
+    /* Sectors in use form a run around the ring, oldest to head */
+    for (int i = 0; i < sectors; i++) {
+        uint32_t header[2];
+        if (flashcache_read(sector_addr(kv, i), header, sizeof(header)) != SPI_FLASH_RESULT_OK)
+            goto fail;
+        if (header[0] == SECTOR_MAGIC && header[1] != ERASED) {
+            if (oldest < 0 || header[1] < oldest_seq) {
+                oldest = i;
+                oldest_seq = header[1];
+            }
+            if (head < 0 || header[1] > kv->seq) {
+                head = i;
+                kv->seq = header[1];
+            }
+        } else if (header[0] != ERASED || header[1] != ERASED) {
+            /* interrupted erase or header write */
+            if (!erase_sector(kv, i))
+                goto fail;
+        }
+    }
+
+    if (oldest < 0) {
+        /* empty store, head_offs at the end makes the first write
+           advance into sector 0 */
+        kv->head = sectors - 1;
+        kv->oldest = 0;
+        kv->used = 0;
+        kv->head_offs = SECTOR_SIZE;
+        return true;
+    }
+
+    kv->oldest = oldest;
+    kv->head = head;
+    kv->used = (head - oldest + sectors) % sectors + 1;
+    for (int i = 0; i < kv->used; i++) {
+        uint32_t end;
+        if (!scan_sector(kv, (oldest + i) % sectors, &end))
+            goto fail;
+        kv->head_offs = end;
+    }
+    /* don't append over the remains of a torn write */
+    if (!flash_blank(sector_addr(kv, head) + kv->head_offs, SECTOR_SIZE - kv->head_offs))
+        kv->head_offs = SECTOR_SIZE;
+    return true;
+
+fail:
+    flashkv_free(kv);
+    return false;
+}
+
+void flashkv_free(flashkv_t *kv)
+{
+    free(kv->index);
+    free(kv->live);
+    if (kv->lock)
+        vSemaphoreDelete(kv->lock);
+    memset(kv, 0, sizeof(*kv));
+}
+
+ssize_t flashkv_get(flashkv_t *kv, const char *key, void *buf, size_t len)
+{
+    size_t key_len = strlen(key);
+    ssize_t result = -1;
+
+    if (!key_len || key_len > FLASHKV_MAX_KEY_LEN)
+        return -1;
+
+    xSemaphoreTake(kv->lock, portMAX_DELAY);
+    flashkv_index_t *entry = index_find(kv, fnv1a(FNV_INIT, key, key_len), key, key_len);
+    uint32_t info;
+    if (entry && kv_read(entry->addr, &info, sizeof(info))) {
+        size_t value_len = INFO_VALUE_LEN(info);
+        if (kv_read(entry->addr + RECORD_HEADER + key_len, buf, len < value_len ? len : value_len))
+            result = value_len;
+    }
+    xSemaphoreGive(kv->lock);
+    return result;
+}
+
+bool flashkv_set(flashkv_t *kv, const char *key, const void *value, size_t len)
+{
+    size_t key_len = strlen(key);
+
+    if (!key_len || key_len > FLASHKV_MAX_KEY_LEN || len > FLASHKV_MAX_VALUE_LEN)
+        return false;
+
+    xSemaphoreTake(kv->lock, portMAX_DELAY);
+    bool ok = append_record(kv, INFO(FLAG_LIVE, key_len, len), key, value);
+    xSemaphoreGive(kv->lock);
+    return ok;
+}
+
+bool flashkv_delete(flashkv_t *kv, const char *key)
+{
+    size_t key_len = strlen(key);
+    bool ok = false;
+
+    if (!key_len || key_len > FLASHKV_MAX_KEY_LEN)
+        return false;
+
+    xSemaphoreTake(kv->lock, portMAX_DELAY);
+    if (index_find(kv, fnv1a(FNV_INIT, key, key_len), key, key_len))
+        ok = append_record(kv, INFO(FLAG_DELETED, key_len, 0), key, NULL);
+    xSemaphoreGive(kv->lock);
+    return ok;
+}
+
+bool flashkv_gc(flashkv_t *kv)
+{
+    bool ok = false;
+
+    xSemaphoreTake(kv->lock, portMAX_DELAY);
+    /* erasing a sector with nothing live in it is cheap, otherwise only
+       compact once the free sectors are down to the reserve and one spare */
+    if (kv->used > 1 && (kv->live[kv->oldest] == 0 || kv->sectors - kv->used <= 2))
+        ok = gc_sector(kv);
+    xSemaphoreGive(kv->lock);
+    return ok;
+}
@@ -0,0 +1,106 @@
+/* Log structured key-value store on SPI flash
+ *
+ * Keeps small named values (configuration, counters) in a reserved
+ * range of flash sectors without erasing a sector for every update.
+ *
+ * Every set or delete appends a record to the current "head" sector,
+ * so an update costs one flash write of a few dozen bytes. A RAM hash
+ * index built when the store is opened maps each key to its latest
+ * record. When the sectors fill up, the oldest sector's live records
+ * are copied to the head and it's erased. Sectors are used in turn as
+ * a ring, so erases are spread evenly over the whole range.
+ *
+ * Records carry a checksum. If power fails during a write, the torn
+ * record is ignored the next time the store is opened and the previous
+ * value is still there. Old records are only erased once their live
+ * copies have been written.
+ *
+ * Compaction normally happens inside flashkv_set() when it runs out of
+ * room. Calling flashkv_gc() from a low priority task moves that work
+ * off the callers of flashkv_set().
+ *
+ * All functions are thread safe.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _FLASHKV_H
+#define _FLASHKV_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#define FLASHKV_MAX_KEY_LEN 32
+
+/* Longest value, a record has to fit in one sector */
+#define FLASHKV_MAX_VALUE_LEN 1024
+
+typedef struct {
+    uint32_t hash;
+    uint32_t addr;      /* flash address of the key's latest record, 0 if unused */
+} flashkv_index_t;
+
+typedef struct {
+    uint32_t start;     /* flash address of the first sector */
+    uint16_t sectors;
+    uint16_t oldest;    /* sector index of the oldest data */
+    uint16_t head;      /* sector index records are appended to */
+    uint16_t used;      /* sectors from oldest to head */
+    uint32_t head_offs; /* first free byte in head */
+    uint32_t seq;       /* sequence number of head */
+    uint16_t *live;     /* bytes of live records in each sector */
+    flashkv_index_t *index;
+    uint32_t index_mask;
+    uint32_t count;     /* keys stored */
+    void *lock;
+} flashkv_t;
+
+/* Open the store in 'sectors' flash sectors from 'start_addr' (sector
+   aligned), with room in the index for 'max_keys' keys. Needs at
+   least 3 sectors. Blank flash is an empty store.
+
+   Returns false if out of memory or on a flash error.
+*/
+bool flashkv_init(flashkv_t *kv, uint32_t start_addr, uint16_t sectors, size_t max_keys);
+
+/* Close the store and free its memory */
+void flashkv_free(flashkv_t *kv);
+
+/* Copy the value of 'key' into 'buf', at most 'len' bytes.
+
+   Returns the length of the stored value (which may be more than
+   'len'), or -1 if the key doesn't exist.
+*/
+ssize_t flashkv_get(flashkv_t *kv, const char *key, void *buf, size_t len);
+
+/* Store 'len' bytes as the value of 'key'.
+
+   Returns false if key or value are too long, the index or the
+   flash range is full, or on a flash error.
+*/
+bool flashkv_set(flashkv_t *kv, const char *key, const void *value, size_t len);
+
+/* Remove 'key'. Returns false if it didn't exist, or on a flash error */
+bool flashkv_delete(flashkv_t *kv, const char *key);
+
+/* Do one step of compaction if free space is getting low. Returns
+   true if a sector was reclaimed. */
+bool flashkv_gc(flashkv_t *kv);
+
+/* Number of keys stored */
+static inline uint32_t flashkv_count(const flashkv_t *kv)
+{
+    return kv->count;
+}
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _FLASHKV_H */
@@ -0,0 +1,122 @@
+/* Timestamped GPIO edge capture, see gpio_capture.h
+ *
+ * The ring has a single producer (the GPIO interrupt, writes head) and a
+ * single consumer (gpio_capture_read, writes tail), so neither side needs
+ * a critical section.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "gpio_capture.h"
+
+#include <stdlib.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <common_macros.h>
+
+static gpio_capture_event_t *ring;
+static uint32_t ring_mask;
+static volatile uint32_t ring_head;
+static volatile uint32_t ring_tail;
+static volatile uint32_t overflows;
+
+/* Reader is blocked until this many events are waiting, 0 if not blocked */
+static volatile uint32_t wake_level;
+static xTaskHandle reader;
+
+static inline uint32_t read_ccount(void)
+{
+    uint32_t ccount;
+    __asm__ volatile ("rsr %0, ccount" : "=a" (ccount));
+    return ccount;
+}
+
+static void IRAM capture_handler(uint8_t gpio_num, void *arg)
+{
+    uint32_t now = read_ccount();
+    uint32_t head = ring_head;
+
+    if (head - ring_tail > ring_mask) {
+        overflows++;
+        return;
+    }
+
+    gpio_capture_event_t *event = &ring[head & ring_mask];
+    event->ccount = now;
+    event->gpio_num = gpio_num;
+    event->level = (GPIO.IN >> gpio_num) & 1;
+    ring_head = head + 1;
+
+    if (wake_level && head + 1 - ring_tail >= wake_level) {
+        portBASE_TYPE woken = pdFALSE;
+        wake_level = 0;
+        vTaskNotifyGiveFromISR(reader, &woken);
+        if (woken)
+            portYIELD();
+    }
+}
+
+bool gpio_capture_init(size_t size)
+{
+    size_t len = 1;
+    while (len < size)
+        len <<= 1;
+
+    ring = malloc(len * sizeof(gpio_capture_event_t));
+    if (!ring)
+        return false;
+    ring_mask = len - 1;
+    ring_head = ring_tail = 0;
+    overflows = 0;
+    return true;
+}
+
+void gpio_capture_enable(uint8_t gpio_num, gpio_inttype_t int_type)
+{
+    gpio_set_interrupt_handler(gpio_num, int_type, capture_handler, NULL);
+}
+
+void gpio_capture_disable(uint8_t gpio_num)
+{
+    gpio_set_interrupt_handler(gpio_num, GPIO_INTTYPE_NONE, NULL, NULL);
+}
+
+size_t gpio_capture_available(void)
+{
+    return ring_head - ring_tail;
+}
+
+uint32_t gpio_capture_overflows(void)
+{
+    return overflows;
+}
+
+size_t gpio_capture_read(gpio_capture_event_t *events, size_t max, size_t min, uint32_t timeout_ticks)
+{
+    if (min > max)
+        min = max;
+    if (min > ring_mask + 1)
+        min = ring_mask + 1;
+
+    if (ring_head - ring_tail < min && timeout_ticks) {
+        reader = xTaskGetCurrentTaskHandle();
+        wake_level = min;
+        /* Events may have arrived after the check, in which case the
+           interrupt has already sent (or will send) the notification. */
+        if (ring_head - ring_tail < min)
+            ulTaskNotifyTake(pdTRUE, timeout_ticks);
+        wake_level = 0;
+        /* Drop a notification that raced with the timeout */
+        ulTaskNotifyTake(pdTRUE, 0);
+    }
+
+    uint32_t tail = ring_tail;
+    size_t count = ring_head - tail;
+    if (count > max)
+        count = max;
+    for (size_t i = 0; i < count; i++) {
+        events[i] = ring[(tail + i) & ring_mask];
+    }
+    ring_tail = tail + count;
+    return count;
+}
@@ -0,0 +1,70 @@
+/* Timestamped GPIO edge capture
+ *
+ * Records a CCOUNT timestamp, pin and level for every interrupt on the
+ * enabled pins into a lock-free ring buffer, straight from the GPIO
+ * interrupt. Tasks drain the ring in batches with gpio_capture_read(),
+ * so edge rates of tens of kHz don't cost a context switch per edge
+ * (e.g. for IR remote decoding or pulse counting).
+ *
+ * Timestamps are raw CPU cycle counts, which wrap every 53 seconds at
+ * 80 MHz (26 seconds at 160 MHz).  Differences between consecutive
+ * events are what's usually wanted, take them with unsigned 32-bit
+ * subtraction.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _GPIO_CAPTURE_H
+#define _GPIO_CAPTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp/gpio.h"
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t ccount;   /* CPU cycle count when the interrupt ran */
+    uint8_t gpio_num;
+    uint8_t level;     /* Pin level read in the interrupt, 0 or 1 */
+} gpio_capture_event_t;
+
+/* Allocate the capture ring, 'size' events long (rounded up to a power
+   of two). Returns false if out of memory. */
+bool gpio_capture_init(size_t size);
+
+/* Start capturing edges of 'int_type' on a pin, which should already be
+   set up as an input. Registers the pin's GPIO interrupt handler. */
+void gpio_capture_enable(uint8_t gpio_num, gpio_inttype_t int_type);
+
+/* Stop capturing on a pin. Events already captured stay in the ring. */
+void gpio_capture_disable(uint8_t gpio_num);
+
+/* Read up to 'max' captured events, oldest first.
+
+   If fewer than 'min' events are waiting, blocks for up to
+   'timeout_ticks' for that many to arrive. The task is only woken once
+   'min' events are in the ring, so larger batches mean fewer wakeups.
+
+   Returns the number of events read, which is less than 'min' on timeout.
+
+   Waits on the calling task's notification (ulTaskNotifyTake), so
+   don't use it from a task that also waits on notifications for
+   something else.
+*/
+size_t gpio_capture_read(gpio_capture_event_t *events, size_t max, size_t min, uint32_t timeout_ticks);
+
+/* Number of events waiting in the ring */
+size_t gpio_capture_available(void);
+
+/* Number of events lost because the ring was full */
+uint32_t gpio_capture_overflows(void);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _GPIO_CAPTURE_H */
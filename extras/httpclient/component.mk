@@ -0,0 +1,9 @@
+# Component makefile for extras/httpclient
+
+# expected anyone using httpclient includes it as 'httpclient/httpclient.h'
+INC_DIRS += $(httpclient_ROOT)..
+
+# args for passing into compile rule generation
+httpclient_SRC_DIR =  $(httpclient_ROOT)
+
+$(eval $(call component_compile_rules,httpclient))
@@ -0,0 +1,585 @@
+/* Keep-alive HTTP/1.1 client, see httpclient.h
+ *
+ * Received data goes into the client's rx buffer, from which the
+ * response header is parsed a line at a time and the body handed to
+ * the callback in place. A response ends exactly where its body does,
+ * so whatever follows it in the buffer (the start of the next pipelined
+ * response) stays there for the next httpclient_read_response().
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "httpclient.h"
+
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "lwip/sockets.h"
+#include "lwip/netdb.h"
+
+#if HTTPCLIENT_MBEDTLS
+#include "mbedtls/net.h"
+#endif
+
+/* Longest chunk accepted, well beyond anything we could use */
+#define MAX_CHUNK_SIZE 0x7ffffff
+
+enum {
+    CHUNK_SIZE,         /* hex digits of the size */
+    CHUNK_EXT,          /* ";ext" after the size, ignored */
+    CHUNK_DATA,
+    CHUNK_DATA_END,     /* CRLF after the data */
+    CHUNK_TRAILER,      /* start of a trailer line, or the blank line ending the body */
+    CHUNK_TRAILER_LINE, /* rest of a trailer line, ignored */
+    CHUNK_DONE,
+};
+
+typedef struct {
+    uint8_t state;
+    uint32_t left;      /* size being parsed, or data left in the chunk */
+} chunked_t;
+
+void httpclient_init(httpclient_t *c)
+{
+    memset(c, 0, sizeof(*c));
+    c->sock = -1;
+#if HTTPCLIENT_MBEDTLS
+    mbedtls_ssl_init(&c->ssl);
+    mbedtls_netconn_init(&c->net);
+    ssl_saved_session_init(&c->session);
+#endif
+}
+
+static httpclient_err_t connect_plain(httpclient_t *c)
+{
+    const struct addrinfo hints = {
+        .ai_family = AF_INET,
+        .ai_socktype = SOCK_STREAM,
+    };
+    struct addrinfo *res;
+    char port_str[6];
+
+    sprintf(port_str, "%u", c->port);
+    if(getaddrinfo(c->host, port_str, &hints, &res) != 0 || res == NULL)
+        return HTTPCLIENT_ERR_CONNECT;
+
+    int s = lwip_socket(res->ai_family, res->ai_socktype, 0);
+    if(s < 0) {
+        freeaddrinfo(res);
+        return HTTPCLIENT_ERR_CONNECT;
+    }
+
+    int timeout = HTTPCLIENT_RECV_TIMEOUT;
+    lwip_setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    /* Pipelined requests go out as they're sent, not after the previous
+       one's ACK */
+    int nodelay = 1;
+    lwip_setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+    if(lwip_connect(s, res->ai_addr, res->ai_addrlen) != 0) {
+        lwip_close(s);
+        freeaddrinfo(res);
+        return HTTPCLIENT_ERR_CONNECT;
+    }
+    freeaddrinfo(res);
+    c->sock = s;
+    return HTTPCLIENT_OK;
+}
+
+#if HTTPCLIENT_MBEDTLS
+static httpclient_err_t connect_tls(httpclient_t *c)
+{
+    char port_str[6];
+    sprintf(port_str, "%u", c->port);
+
+    if(!c->ssl_ready) {
+        if(mbedtls_ssl_setup(&c->ssl, c->tls_conf) != 0)
+            return HTTPCLIENT_ERR_TLS;
+        c->ssl_ready = true;
+    } else if(mbedtls_ssl_session_reset(&c->ssl) != 0) {
+        return HTTPCLIENT_ERR_TLS;
+    }
+    if(mbedtls_ssl_set_hostname(&c->ssl, c->host) != 0)
+        return HTTPCLIENT_ERR_TLS;
+
+    if(mbedtls_netconn_connect(&c->net, c->host, port_str) != 0)
+        return HTTPCLIENT_ERR_CONNECT;
+    mbedtls_ssl_set_bio(&c->ssl, &c->net, mbedtls_netconn_send, mbedtls_netconn_recv,
+                        mbedtls_netconn_recv_timeout);
+
+    ssl_saved_session_restore(&c->session, &c->ssl);
+    int r;
+    while((r = mbedtls_ssl_handshake(&c->ssl)) != 0) {
+        if(r != MBEDTLS_ERR_SSL_WANT_READ && r != MBEDTLS_ERR_SSL_WANT_WRITE) {
+            /* don't offer a session the server just refused again */
+            ssl_saved_session_free(&c->session);
+            mbedtls_netconn_free(&c->net);
+            return HTTPCLIENT_ERR_TLS;
+        }
+    }
+    ssl_saved_session_save(&c->session, &c->ssl);
+    return HTTPCLIENT_OK;
+}
+#endif
+
+static httpclient_err_t reconnect(httpclient_t *c)
+{
+    httpclient_err_t err;
+#if HTTPCLIENT_MBEDTLS
+    if(c->tls_conf)
+        err = connect_tls(c);
+    else
+#endif
+        err = connect_plain(c);
+    if(err != HTTPCLIENT_OK)
+        return err;
+
+    c->connected = true;
+    c->served = 0;
+    c->rx_pos = c->rx_len = 0;
+    return HTTPCLIENT_OK;
+}
+
+static httpclient_err_t set_server(httpclient_t *c, const char *host, uint16_t port)
+{
+    if(strlen(host) >= sizeof(c->host))
+        return HTTPCLIENT_ERR_ARG;
+    httpclient_close(c);
+    strcpy(c->host, host);
+    c->port = port;
+    return HTTPCLIENT_OK;
+}
+
+httpclient_err_t httpclient_connect(httpclient_t *c, const char *host, uint16_t port)
+{
+    httpclient_err_t err = set_server(c, host, port);
+    if(err != HTTPCLIENT_OK)
+        return err;
+#if HTTPCLIENT_MBEDTLS
+    c->tls_conf = NULL;
+#endif
+    return reconnect(c);
+}
+
+#if HTTPCLIENT_MBEDTLS
+httpclient_err_t httpclient_connect_tls(httpclient_t *c, const char *host, uint16_t port,
+                                        const mbedtls_ssl_config *conf)
+{
+    httpclient_err_t err = set_server(c, host, port);
+    if(err != HTTPCLIENT_OK)
+        return err;
+    if(c->tls_conf != conf) {
+        /* a session from another configuration isn't worth offering */
+        mbedtls_ssl_free(&c->ssl);
+        mbedtls_ssl_init(&c->ssl);
+        c->ssl_ready = false;
+        ssl_saved_session_free(&c->session);
+        c->tls_conf = conf;
+    }
+    return reconnect(c);
+}
+#endif
+
+void httpclient_close(httpclient_t *c)
+{
+    if(c->connected) {
+#if HTTPCLIENT_MBEDTLS
+        if(c->tls_conf) {
+            mbedtls_ssl_close_notify(&c->ssl);
+            mbedtls_netconn_free(&c->net);
+        } else
+#endif
+        {
+            lwip_close(c->sock);
+            c->sock = -1;
+        }
+    }
+    c->connected = false;
+    c->pending = 0;
+    c->head_mask = 0;
+    c->rx_pos = c->rx_len = 0;
+}
+
+void httpclient_free(httpclient_t *c)
+{
+    httpclient_close(c);
+#if HTTPCLIENT_MBEDTLS
+    mbedtls_ssl_free(&c->ssl);
+    ssl_saved_session_free(&c->session);
+    c->ssl_ready = false;
+    c->tls_conf = NULL;
+#endif
+}
+
+/* Returns bytes read, 0 if the connection was closed or negative on error */
+static int transport_read(httpclient_t *c, void *buf, size_t len)
+{
+#if HTTPCLIENT_MBEDTLS
+    if(c->tls_conf) {
+        int r;
+        do {
+            r = mbedtls_ssl_read(&c->ssl, buf, len);
+        } while(r == MBEDTLS_ERR_SSL_WANT_READ || r == MBEDTLS_ERR_SSL_WANT_WRITE);
+        return r == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY ? 0 : r;
+    }
+#endif
+    return lwip_recv(c->sock, buf, len, 0);
+}
+
+static httpclient_err_t transport_write(httpclient_t *c, const void *buf, size_t len)
+{
+    while(len) {
+        int r;
+#if HTTPCLIENT_MBEDTLS
+        if(c->tls_conf) {
+            r = mbedtls_ssl_write(&c->ssl, buf, len);
+            if(r == MBEDTLS_ERR_SSL_WANT_READ || r == MBEDTLS_ERR_SSL_WANT_WRITE)
+                continue;
+        } else
+#endif
+            r = lwip_send(c->sock, buf, len, 0);
+        if(r <= 0)
+            return HTTPCLIENT_ERR_IO;
+        buf = (const uint8_t *)buf + r;
+        len -= r;
+    }
+    return HTTPCLIENT_OK;
+}
+
+/* Read more data into rx, making room at the end if there's none */
+static httpclient_err_t fill(httpclient_t *c)
+{
+    if(c->rx_pos == c->rx_len) {
+        c->rx_pos = c->rx_len = 0;
+    } else if(c->rx_len == sizeof(c->rx)) {
+        if(c->rx_pos == 0)
+            return HTTPCLIENT_ERR_RESPONSE; /* header line doesn't fit */
+        memmove(c->rx, c->rx + c->rx_pos, c->rx_len - c->rx_pos);
+        c->rx_len -= c->rx_pos;
+        c->rx_pos = 0;
+    }
+    int r = transport_read(c, c->rx + c->rx_len, sizeof(c->rx) - c->rx_len);
+    if(r < 0)
+        return HTTPCLIENT_ERR_IO;
+    if(r == 0)
+        return HTTPCLIENT_ERR_CLOSED;
+    c->rx_len += r;
+    return HTTPCLIENT_OK;
+}
+
+/* Take the next line from rx, without its CRLF, NUL terminated in place */
+static httpclient_err_t read_line(httpclient_t *c, char **line)
+{
+    size_t scanned = 0;
+    for(;;) {
+        char *start = c->rx + c->rx_pos;
+        char *nl = memchr(start + scanned, '\n', c->rx_len - c->rx_pos - scanned);
+        if(nl) {
+            if(nl > start && nl[-1] == '\r')
+                nl[-1] = 0;
+            *nl = 0;
+            c->rx_pos = nl + 1 - c->rx;
+            *line = start;
+            return HTTPCLIENT_OK;
+        }
+        scanned = c->rx_len - c->rx_pos;
+        httpclient_err_t err = fill(c);
+        if(err != HTTPCLIENT_OK)
+            return err;
+    }
+}
+
+/* Whether the comma separated header value 'value' has 'token' in it */
+static bool has_token(const char *value, const char *token)
+{
+    size_t len = strlen(token);
+    while(*value) {
+        while(*value == ' ' || *value == '\t' || *value == ',')
+            value++;
+        const char *end = value;
+        while(*end && *end != ',' && *end != ' ' && *end != '\t' && *end != ';')
+            end++;
+        if(end - value == len && !strncasecmp(value, token, len))
+            return true;
+        value = end;
+        while(*value && *value != ',')
+            value++;
+    }
+    return false;
+}
+
+static httpclient_err_t read_header(httpclient_t *c, httpclient_response_t *resp)
+{
+    char *line;
+    httpclient_err_t err = read_line(c, &line);
+    if(err != HTTPCLIENT_OK) {
+        /* Nothing at all received: a kept-alive connection the server
+           had already given up on */
+        if(c->rx_len == 0 && (err == HTTPCLIENT_ERR_IO || err == HTTPCLIENT_ERR_CLOSED))
+            return HTTPCLIENT_ERR_CLOSED;
+        return err == HTTPCLIENT_ERR_CLOSED ? HTTPCLIENT_ERR_IO : err;
+    }
+
+    int minor;
+    if(sscanf(line, "HTTP/1.%d %d", &minor, &resp->status) != 2 || resp->status < 100 || resp->status > 999)
+        return HTTPCLIENT_ERR_RESPONSE;
+    resp->content_length = -1;
+    resp->chunked = false;
+    resp->keep_alive = (minor >= 1);
+
+    for(;;) {
+        err = read_line(c, &line);
+        if(err != HTTPCLIENT_OK)
+            return err == HTTPCLIENT_ERR_CLOSED ? HTTPCLIENT_ERR_IO : err;
+        if(!*line)
+            return HTTPCLIENT_OK;
+
+        char *value = strchr(line, ':');
+        if(!value)
+            continue;
+        *value++ = 0;
+        while(*value == ' ' || *value == '\t')
+            value++;
+        if(!strcasecmp(line, "Content-Length")) {
+            resp->content_length = strtol(value, NULL, 10);
+            if(resp->content_length < 0)
+                return HTTPCLIENT_ERR_RESPONSE;
+        } else if(!strcasecmp(line, "Transfer-Encoding")) {
+            resp->chunked = has_token(value, "chunked");
+        } else if(!strcasecmp(line, "Connection")) {
+            if(has_token(value, "close"))
+                resp->keep_alive = false;
+            else if(has_token(value, "keep-alive"))
+                resp->keep_alive = true;
+        }
+    }
+}
+
+static httpclient_err_t deliver(const httpclient_response_t *resp, httpclient_body_fn body, void *arg,
+                                const void *data, size_t len)
+{
+    if(!body || !len)
+        return HTTPCLIENT_OK;
+    return body(arg, resp, data, len) ? HTTPCLIENT_ERR_ABORTED : HTTPCLIENT_OK;
+}
+
+/* Decode 'len' bytes of a chunked body, passing chunk data on as it's
+   found. Sets *used to the bytes consumed, which is less than 'len' only
+   once the body has ended. */
+static httpclient_err_t chunked_feed(chunked_t *d, const char *data, size_t len, size_t *used,
+                                     const httpclient_response_t *resp, httpclient_body_fn body, void *arg)
+{
+    const char *p = data, *end = data + len;
+
+    while(p < end && d->state != CHUNK_DONE) {
+        char ch = *p;
+        switch(d->state) {
+        case CHUNK_SIZE:
+        case CHUNK_EXT:
+            if(ch == '\n') {
+                d->state = d->left ? CHUNK_DATA : CHUNK_TRAILER;
+            } else if(d->state == CHUNK_EXT || ch == '\r' || ch == ' ' || ch == '\t') {
+                /* skipped */
+            } else if(ch == ';') {
+                d->state = CHUNK_EXT;
+            } else {
+                int digit;
+                if(ch >= '0' && ch <= '9')
+                    digit = ch - '0';
+                else if((ch | 0x20) >= 'a' && (ch | 0x20) <= 'f')
+                    digit = (ch | 0x20) - 'a' + 10;
+                else
+                    return HTTPCLIENT_ERR_RESPONSE;
+                if(d->left > MAX_CHUNK_SIZE >> 4)
+                    return HTTPCLIENT_ERR_RESPONSE;
+                d->left = (d->left << 4) | digit;
+            }
+            p++;
+            break;
+        case CHUNK_DATA: {
+            size_t n = end - p;
+            if(n > d->left)
+                n = d->left;
+            httpclient_err_t err = deliver(resp, body, arg, p, n);
+            if(err != HTTPCLIENT_OK)
+                return err;
+            p += n;
+            d->left -= n;
+            if(!d->left)
+                d->state = CHUNK_DATA_END;
+            break;
+        }
+        case CHUNK_DATA_END:
+            if(ch == '\n')
+                d->state = CHUNK_SIZE;
+            else if(ch != '\r')
+                return HTTPCLIENT_ERR_RESPONSE;
+            p++;
+            break;
+        case CHUNK_TRAILER:
+            if(ch == '\n')
+                d->state = CHUNK_DONE;
+            else if(ch != '\r')
+                d->state = CHUNK_TRAILER_LINE;
+            p++;
+            break;
+        case CHUNK_TRAILER_LINE:
+            if(ch == '\n')
+                d->state = CHUNK_TRAILER;
+            p++;
+            break;
+        }
+    }
+    *used = p - data;
+    return HTTPCLIENT_OK;
+}
+
+static httpclient_err_t read_body(httpclient_t *c, httpclient_response_t *resp,
+                                  httpclient_body_fn body, void *arg)
+{
+    httpclient_err_t err;
+
+    if(resp->chunked) {
+        chunked_t d = { .state = CHUNK_SIZE };
+        for(;;) {
+            size_t used;
+            err = chunked_feed(&d, c->rx + c->rx_pos, c->rx_len - c->rx_pos, &used, resp, body, arg);
+            if(err != HTTPCLIENT_OK)
+                return err;
+            c->rx_pos += used;
+            if(d.state == CHUNK_DONE)
+                return HTTPCLIENT_OK;
+            err = fill(c);
+            if(err != HTTPCLIENT_OK)
+                return HTTPCLIENT_ERR_IO;
+        }
+    }
+
+    if(resp->content_length >= 0) {
+        unsigned long left = resp->content_length;
+        while(left) {
+            if(c->rx_pos == c->rx_len && fill(c) != HTTPCLIENT_OK)
+                return HTTPCLIENT_ERR_IO;
+            size_t n = c->rx_len - c->rx_pos;
+            if(n > left)
+                n = left;
+            err = deliver(resp, body, arg, c->rx + c->rx_pos, n);
+            if(err != HTTPCLIENT_OK)
+                return err;
+            c->rx_pos += n;
+            left -= n;
+        }
+        return HTTPCLIENT_OK;
+    }
+
+    /* No length, the body runs until the server closes */
+    resp->keep_alive = false;
+    for(;;) {
+        err = deliver(resp, body, arg, c->rx + c->rx_pos, c->rx_len - c->rx_pos);
+        if(err != HTTPCLIENT_OK)
+            return err;
+        c->rx_pos = c->rx_len;
+        err = fill(c);
+        if(err == HTTPCLIENT_ERR_CLOSED)
+            return HTTPCLIENT_OK;
+        if(err != HTTPCLIENT_OK)
+            return err;
+    }
+}
+
+httpclient_err_t httpclient_send(httpclient_t *c, const char *method, const char *path,
+                                 const char *headers, const void *body, size_t body_len)
+{
+    if(c->pending >= HTTPCLIENT_PIPELINE || !c->host[0])
+        return HTTPCLIENT_ERR_ARG;
+    if(!c->connected) {
+        if(c->pending)
+            return HTTPCLIENT_ERR_CLOSED;
+        httpclient_err_t err = reconnect(c);
+        if(err != HTTPCLIENT_OK)
+            return err;
+    }
+
+    int len = snprintf(c->tx, sizeof(c->tx), "%s %s HTTP/1.1\r\nHost: %s\r\n%s",
+                       method, path, c->host, headers ? headers : "");
+    if(len >= 0 && len < sizeof(c->tx) && (body || body_len))
+        len += snprintf(c->tx + len, sizeof(c->tx) - len, "Content-Length: %u\r\n", body_len);
+    if(len >= 0 && len < sizeof(c->tx))
+        len += snprintf(c->tx + len, sizeof(c->tx) - len, "\r\n");
+    if(len < 0 || len >= sizeof(c->tx))
+        return HTTPCLIENT_ERR_ARG;
+
+    /* A small body goes out with the header, in the same segment */
+    if(body_len && body_len <= sizeof(c->tx) - len) {
+        memcpy(c->tx + len, body, body_len);
+        len += body_len;
+        body_len = 0;
+    }
+    httpclient_err_t err = transport_write(c, c->tx, len);
+    if(err == HTTPCLIENT_OK && body_len)
+        err = transport_write(c, body, body_len);
+    if(err != HTTPCLIENT_OK) {
+        /* The server may have closed the connection as we reused it */
+        bool stale = (c->served && !c->pending);
+        httpclient_close(c);
+        return stale ? HTTPCLIENT_ERR_CLOSED : err;
+    }
+
+    if(!strcmp(method, "HEAD"))
+        c->head_mask |= 1 << c->pending;
+    c->pending++;
+    return HTTPCLIENT_OK;
+}
+
+int httpclient_read_response(httpclient_t *c, httpclient_response_t *resp,
+                             httpclient_body_fn body, void *arg)
+{
+    if(!c->pending)
+        return HTTPCLIENT_ERR_ARG;
+
+    bool head = c->head_mask & 1;
+    httpclient_err_t err;
+    do {
+        err = read_header(c, resp);
+        if(err != HTTPCLIENT_OK)
+            goto fail;
+        /* 1xx responses (100 Continue) come ahead of the real one */
+    } while(resp->status < 200);
+
+    c->pending--;
+    c->head_mask >>= 1;
+    if(!head && resp->status != 204 && resp->status != 304) {
+        err = read_body(c, resp, body, arg);
+        if(err != HTTPCLIENT_OK)
+            goto fail;
+    }
+
+    c->served++;
+    if(!resp->keep_alive)
+        httpclient_close(c);
+    return resp->status;
+
+fail:
+    httpclient_close(c);
+    return err;
+}
+
+int httpclient_request(httpclient_t *c, const char *method, const char *path,
+                       const char *headers, const void *body, size_t body_len,
+                       httpclient_response_t *resp, httpclient_body_fn body_fn, void *arg)
+{
+    if(c->pending)
+        return HTTPCLIENT_ERR_ARG;
+
+    for(int attempt = 0; ; attempt++) {
+        bool reused = c->connected && c->served;
+        int r = httpclient_send(c, method, path, headers, body, body_len);
+        if(r == HTTPCLIENT_OK)
+            r = httpclient_read_response(c, resp, body_fn, arg);
+        if(r != HTTPCLIENT_ERR_CLOSED || !reused || attempt)
+            return r;
+    }
+}
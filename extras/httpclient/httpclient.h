@@ -0,0 +1,175 @@
+/* Keep-alive HTTP/1.1 client
+ *
+ * A client holds one connection to a server open across requests, so
+ * each request after the first costs a single round trip rather than a
+ * TCP (and TLS) handshake as well. Requests can be pipelined: send up
+ * to HTTPCLIENT_PIPELINE with httpclient_send(), then read the responses
+ * in order with httpclient_read_response().
+ *
+ * Response bodies are streamed to a callback as they arrive, whatever
+ * their length: fixed length, chunked (decoded incrementally, the
+ * callback only sees the data) or up to the server closing. Nothing is
+ * buffered beyond one receive buffer of HTTPCLIENT_RX_BUF bytes, which
+ * also bounds the length of a response header line.
+ *
+ *   httpclient_t client;
+ *   httpclient_init(&client);
+ *   httpclient_connect(&client, "example.com", 80);
+ *   int status = httpclient_request(&client, "POST", "/telemetry",
+ *                                   "Content-Type: application/json\r\n",
+ *                                   json, json_len, &resp, NULL, NULL);
+ *   ...
+ *   httpclient_free(&client);
+ *
+ * If the server closes the connection (or said it would, with
+ * "Connection: close") the next request reconnects. httpclient_request()
+ * also retries once when a connection that already served a response
+ * turns out to have been closed by the server before it answered, as
+ * happens when the server's keep-alive timeout is shorter than the time
+ * between requests. (So, rarely, a non-idempotent request can be sent
+ * twice if the server processed it but closed before responding.)
+ *
+ * Build with EXTRA_CFLAGS=-DHTTPCLIENT_MBEDTLS=1 (and extras/mbedtls in
+ * EXTRA_COMPONENTS) for httpclient_connect_tls(). Reconnects of a TLS
+ * client resume the previous TLS session where the server allows, so
+ * they skip the public key operations of a full handshake.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _HTTPCLIENT_H
+#define _HTTPCLIENT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef HTTPCLIENT_MBEDTLS
+#define HTTPCLIENT_MBEDTLS 0
+#endif
+
+#if HTTPCLIENT_MBEDTLS
+#include "mbedtls/ssl.h"
+#include "net_netconn.h"
+#include "ssl_session_cache.h"
+#endif
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/* Receive buffer, the longest response header line */
+#ifndef HTTPCLIENT_RX_BUF
+#define HTTPCLIENT_RX_BUF 1024
+#endif
+
+/* Request buffer. The request line and headers must fit, a body that
+   fits as well goes out in the same write (and usually segment). */
+#ifndef HTTPCLIENT_TX_BUF
+#define HTTPCLIENT_TX_BUF 512
+#endif
+
+/* Most requests sent and not yet answered */
+#ifndef HTTPCLIENT_PIPELINE
+#define HTTPCLIENT_PIPELINE 4
+#endif
+
+#ifndef HTTPCLIENT_HOST_LEN
+#define HTTPCLIENT_HOST_LEN 64
+#endif
+
+/* Receive timeout of plain HTTP connections, in ms. (For TLS it's the
+   read timeout of the mbedtls_ssl_config.) */
+#ifndef HTTPCLIENT_RECV_TIMEOUT
+#define HTTPCLIENT_RECV_TIMEOUT 10000
+#endif
+
+typedef enum {
+    HTTPCLIENT_OK = 0,
+    HTTPCLIENT_ERR_CONNECT = -1,  /* DNS lookup or connection failed */
+    HTTPCLIENT_ERR_IO = -2,       /* send or receive failed, or timed out */
+    HTTPCLIENT_ERR_RESPONSE = -3, /* malformed response */
+    HTTPCLIENT_ERR_CLOSED = -4,   /* closed by the server before responding */
+    HTTPCLIENT_ERR_ABORTED = -5,  /* the body callback stopped the response */
+    HTTPCLIENT_ERR_ARG = -6,      /* request too long, pipeline full or empty */
+    HTTPCLIENT_ERR_TLS = -7,      /* TLS setup or handshake failed */
+} httpclient_err_t;
+
+typedef struct {
+    int status;
+    long content_length;    /* -1 if not given */
+    bool chunked;
+    bool keep_alive;        /* the connection stays open after this response */
+} httpclient_response_t;
+
+/* Called with each piece of a response body as it arrives. Return 0 to
+   carry on, anything else stops the response (and closes the
+   connection, as the rest of the body is still on its way). */
+typedef int (*httpclient_body_fn)(void *arg, const httpclient_response_t *resp,
+                                  const void *data, size_t len);
+
+typedef struct {
+    char host[HTTPCLIENT_HOST_LEN];
+    uint16_t port;
+    bool connected;
+    int sock;
+    uint8_t pending;        /* requests sent and not yet answered */
+    uint8_t head_mask;      /* which pending requests were HEADs, oldest in bit 0 */
+    uint16_t served;        /* responses read on this connection */
+    uint16_t rx_pos;        /* unconsumed data in rx */
+    uint16_t rx_len;
+#if HTTPCLIENT_MBEDTLS
+    const mbedtls_ssl_config *tls_conf; /* NULL for plain HTTP */
+    bool ssl_ready;
+    mbedtls_ssl_context ssl;
+    mbedtls_netconn_context net;
+    ssl_saved_session_t session;
+#endif
+    char rx[HTTPCLIENT_RX_BUF];
+    char tx[HTTPCLIENT_TX_BUF];
+} httpclient_t;
+
+void httpclient_init(httpclient_t *c);
+
+/* Connect to host:port for plain HTTP. Returns HTTPCLIENT_OK or an error. */
+httpclient_err_t httpclient_connect(httpclient_t *c, const char *host, uint16_t port);
+
+#if HTTPCLIENT_MBEDTLS
+/* Connect to host:port for HTTPS, with 'conf' (which must stay valid)
+   set up by the caller: certificate verification, RNG and read timeout.
+   The host name is used for SNI and verification. */
+httpclient_err_t httpclient_connect_tls(httpclient_t *c, const char *host, uint16_t port,
+                                        const mbedtls_ssl_config *conf);
+#endif
+
+/* Send a request, without waiting for its response. 'headers' are extra
+   header lines each ending in "\r\n", or NULL. A Content-Length header
+   is added when there's a body. Reconnects if the connection has been
+   closed, unless responses to earlier requests are still pending. */
+httpclient_err_t httpclient_send(httpclient_t *c, const char *method, const char *path,
+                                 const char *headers, const void *body, size_t body_len);
+
+/* Read the response to the oldest pending request, passing its body to
+   'body' (NULL discards it). Returns the status code, or an error, after
+   which the connection is closed and any other pending requests lost. */
+int httpclient_read_response(httpclient_t *c, httpclient_response_t *resp,
+                             httpclient_body_fn body, void *arg);
+
+/* Send a request and read its response, as above, retrying once on a
+   stale kept-alive connection. Nothing may be pending. */
+int httpclient_request(httpclient_t *c, const char *method, const char *path,
+                       const char *headers, const void *body, size_t body_len,
+                       httpclient_response_t *resp, httpclient_body_fn body_fn, void *arg);
+
+/* Close the connection. The next request reconnects to the same server. */
+void httpclient_close(httpclient_t *c);
+
+/* Close the connection and free everything the client holds */
+void httpclient_free(httpclient_t *c);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _HTTPCLIENT_H */
@@ -0,0 +1,544 @@
+/* Event driven HTTP/1.1 server on the lwIP raw TCP API, see httpd.h
+ *
+ * Each connection reads requests into its buffer until the blank line
+ * ending the headers, then queues the response: the header is copied
+ * in with tcp_write(), the body is queued as the send buffer allows
+ * from the tcp_sent callback. While a body is still being queued,
+ * further (pipelined) requests wait in the buffer, and once the buffer
+ * is full lwIP holds back the rest (the recv callback refuses it), so
+ * a connection never needs more than its slot.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "httpd.h"
+
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+#include <stddef.h>
+
+#include <lwip/tcp.h>
+#include <lwip/tcpip.h>
+#include <lwip/sys.h>
+
+/* tcp_poll() interval, in units of TCP_SLOW_INTERVAL (500 ms) */
+#define POLL_INTERVAL 4
+#define POLL_MS (POLL_INTERVAL * 500)
+
+/* Room kept in the send buffer for a response header */
+#define HEADER_MAX 256
+
+typedef struct {
+    struct tcp_pcb *pcb;
+    const uint8_t *body;    /* left to queue */
+    uint32_t body_left;
+    uint16_t req_len;
+    uint8_t idle;           /* polls without traffic */
+    bool keep_alive;
+    bool closing;
+    char req[HTTPD_REQ_BUF];
+} conn_t;
+
+static conn_t conns[HTTPD_MAX_CONNS];
+static struct tcp_pcb *listen_pcb;
+static const httpd_route_t *routes;
+static size_t route_count;
+static httpd_file_fn file_lookup;
+static char dynamic_buf[HTTPD_DYNAMIC_MAX];
+
+static const struct {
+    const char *ext;
+    const char *type;
+} mime_types[] = {
+    { "html", "text/html" },
+    { "htm", "text/html" },
+    { "css", "text/css" },
+    { "js", "application/javascript" },
+    { "json", "application/json" },
+    { "txt", "text/plain" },
+    { "svg", "image/svg+xml" },
+    { "png", "image/png" },
+    { "jpg", "image/jpeg" },
+    { "gif", "image/gif" },
+    { "ico", "image/x-icon" },
+};
+
+static const char *guess_type(const char *path)
+{
+    const char *dot = strrchr(path, '.');
+
+    if (dot && !strchr(dot, '/')) {
+        for (size_t i = 0; i < sizeof(mime_types) / sizeof(mime_types[0]); i++) {
+            if (!strcasecmp(dot + 1, mime_types[i].ext))
+                return mime_types[i].type;
+        }
+    }
+    return "application/octet-stream";
+}
+
+static void conn_free(conn_t *c)
+{
+    if (c->pcb) {
+        tcp_arg(c->pcb, NULL);
+        tcp_recv(c->pcb, NULL);
+        tcp_sent(c->pcb, NULL);
+        tcp_err(c->pcb, NULL);
+        tcp_poll(c->pcb, NULL, 0);
+    }
+    c->pcb = NULL;
+}
+
+/* Close once everything queued has gone, retried from the poll
+   callback if lwIP has no memory for it right now */
+static void conn_close(conn_t *c)
+{
+    c->closing = true;
+    c->body_left = 0;
+    tcp_recv(c->pcb, NULL);
+    if (tcp_close(c->pcb) == ERR_OK)
+        conn_free(c);
+}
+
+static bool write_header(conn_t *c, int status, const char *reason, const char *type,
+                         const char *extra, uint32_t len)
+{
+    char header[HEADER_MAX];
+    int n = snprintf(header, sizeof(header), "HTTP/1.1 %d %s\r\n", status, reason);
+
+    /* No type for a response without a body (304) */
+    if (type && n < (int)sizeof(header))
+        n += snprintf(header + n, sizeof(header) - n,
+                      "Content-Type: %s\r\n"
+                      "Content-Length: %u\r\n",
+                      type, len);
+    if (n < (int)sizeof(header))
+        n += snprintf(header + n, sizeof(header) - n,
+                      "%s"
+                      "Connection: %s\r\n\r\n",
+                      extra ? extra : "",
+                      c->keep_alive ? "keep-alive" : "close");
+    if (n < 0 || n >= (int)sizeof(header))
+        return false;
+    return tcp_write(c->pcb, header, n, TCP_WRITE_FLAG_COPY | (len ? TCP_WRITE_FLAG_MORE : 0)) == ERR_OK;
+}
+
+static void send_error(conn_t *c, int status, const char *reason, bool head)
+{
+    char body[40];
+    int n = snprintf(body, sizeof(body), "%d %s\n", status, reason);
+
+    if (!write_header(c, status, reason, "text/plain", status == 405 ? "Allow: GET, HEAD\r\n" : NULL, n)
+        || (!head && tcp_write(c->pcb, body, n, TCP_WRITE_FLAG_COPY) != ERR_OK))
+        c->keep_alive = false;
+}
+
+/* Queue as much of the body as the send buffer takes */
+static void send_body(conn_t *c)
+{
+    while (c->body_left) {
+        uint32_t n = tcp_sndbuf(c->pcb);
+        if (n > c->body_left)
+            n = c->body_left;
+        if (n > 0xffff)
+            n = 0xffff;
+        if (n == 0)
+            break;
+        u8_t flags = n < c->body_left ? TCP_WRITE_FLAG_MORE : 0;
+        if (tcp_write(c->pcb, c->body, n, flags) != ERR_OK) {
+            /* Out of segments or memory, more once something is acked */
+            if (n > TCP_MSS && tcp_write(c->pcb, c->body, TCP_MSS, TCP_WRITE_FLAG_MORE) == ERR_OK)
+                n = TCP_MSS;
+            else
+                break;
+        }
+        c->body += n;
+        c->body_left -= n;
+    }
+    tcp_output(c->pcb);
+}
+
+static const httpd_route_t *find_route(const char *path, size_t len)
+{
+    for (size_t i = 0; i < route_count; i++) {
+        if (!strncmp(routes[i].path, path, len) && routes[i].path[len] == 0)
+            return &routes[i];
+    }
+    return NULL;
+}
+
+const char *httpd_header(const char *h, const char *name, size_t *len)
+{
+    size_t name_len = strlen(name);
+
+    for (; h && *h; h = strstr(h, "\r\n"), h = h ? h + 2 : NULL) {
+        if (strncasecmp(h, name, name_len) || h[name_len] != ':')
+            continue;
+        const char *v = h + name_len + 1;
+        while (*v == ' ')
+            v++;
+        const char *end = strstr(v, "\r\n");
+        *len = end ? (size_t)(end - v) : strlen(v);
+        return v;
+    }
+    return NULL;
+}
+
+/* Whether header 'name' in 'h' starts with 'value' */
+static bool header_has(const char *h, const char *name, const char *value)
+{
+    size_t len;
+    const char *v = httpd_header(h, name, &len);
+
+    return v && !strncasecmp(v, value, strlen(value));
+}
+
+/* Whether the value of header 'name' in 'h' contains 'token' anywhere */
+static bool header_contains(const char *h, const char *name, const char *token)
+{
+    size_t len, token_len = strlen(token);
+    const char *v = httpd_header(h, name, &len);
+
+    for (; v && len >= token_len; v++, len--) {
+        if (!strncasecmp(v, token, token_len))
+            return true;
+    }
+    return false;
+}
+
+/* Answer the request in c->req (NUL terminated after its headers).
+   Returns false, with the request untouched, if there isn't room in
+   the send buffer for the response yet. */
+static bool handle_request(conn_t *c)
+{
+    char *line_end = strstr(c->req, "\r\n");
+    char *method = c->req;
+    char *path = memchr(method, ' ', line_end - method);
+    char *version = path ? memchr(path + 1, ' ', line_end - path - 1) : NULL;
+    if (!version || path[1] != '/') {
+        c->keep_alive = false;
+        send_error(c, 400, "Bad Request", false);
+        return true;
+    }
+    path++;
+    char *query = memchr(path, '?', version - path);
+    const httpd_route_t *route = find_route(path, (query ? query : version) - path);
+
+    if (route && route->handler && tcp_sndbuf(c->pcb) < HEADER_MAX + HTTPD_DYNAMIC_MAX)
+        return false;
+
+    /* Split the request line in place */
+    *line_end = 0;
+    *version++ = 0;
+    path[-1] = 0;
+    if (query)
+        *query++ = 0;
+    else
+        query = version + strlen(version);
+
+    const char *headers = line_end + 2;
+    bool http10 = !strcmp(version, "HTTP/1.0");
+    c->keep_alive = http10 ? header_has(headers, "Connection", "keep-alive")
+                           : !header_has(headers, "Connection", "close");
+
+    bool head = !strcmp(method, "HEAD");
+    if (!head && strcmp(method, "GET")) {
+        send_error(c, 405, "Method Not Allowed", false);
+        return true;
+    }
+
+    size_t upgrade_len;
+    if (route && route->upgrade && httpd_header(headers, "Upgrade", &upgrade_len)) {
+        if (route->upgrade(c->pcb, route, path, query, headers)) {
+            /* The pcb and its callbacks are the route's now */
+            c->pcb = NULL;
+            return true;
+        }
+        send_error(c, 400, "Bad Request", false);
+        return true;
+    }
+
+    if (route && route->handler) {
+        int n = route->handler(path, query, dynamic_buf, sizeof(dynamic_buf));
+        if (n < 0 || n > (int)sizeof(dynamic_buf)) {
+            send_error(c, 500, "Internal Server Error", head);
+            return true;
+        }
+        if (!write_header(c, 200, "OK", route->content_type, route->headers, n)
+            || (!head && n && tcp_write(c->pcb, dynamic_buf, n, TCP_WRITE_FLAG_COPY) != ERR_OK))
+            c->keep_alive = false;
+        return true;
+    }
+
+    const void *data;
+    size_t len;
+    const char *type, *extra = NULL;
+    char file_headers[112];
+    httpd_file_t file = { 0 };
+    if (route) {
+        data = route->data;
+        len = route->len;
+        type = route->content_type;
+        extra = route->headers;
+    } else if (file_lookup && file_lookup(path, &file)) {
+        char etag[12] = "";
+        if (file.etag) {
+            snprintf(etag, sizeof(etag), "\"%08x\"", file.etag);
+            if (header_contains(headers, "If-None-Match", etag)
+                || header_contains(headers, "If-None-Match", "*")) {
+                /* The client's copy is current, which is all a 304 takes */
+                snprintf(file_headers, sizeof(file_headers), "ETag: %s\r\n", etag);
+                if (!write_header(c, 304, "Not Modified", NULL, file_headers, 0))
+                    c->keep_alive = false;
+                return true;
+            }
+        }
+        if (file.gzip && !header_contains(headers, "Accept-Encoding", "gzip")) {
+            send_error(c, 406, "Not Acceptable", head);
+            return true;
+        }
+        snprintf(file_headers, sizeof(file_headers), "%s%s%s%s%s",
+                 file.gzip ? "Content-Encoding: gzip\r\nVary: Accept-Encoding\r\n" : "",
+                 *etag ? "ETag: " : "", etag, *etag ? "\r\n" : "",
+                 *etag ? "Cache-Control: no-cache\r\n" : "");
+        data = file.data;
+        len = file.len;
+        type = guess_type(path);
+        extra = file_headers;
+    } else {
+        send_error(c, 404, "Not Found", head);
+        return true;
+    }
+
+    if (!write_header(c, 200, "OK", type, extra, len)) {
+        c->keep_alive = false;
+        return true;
+    }
+    if (!head) {
+        c->body = data;
+        c->body_left = len;
+    }
+    return true;
+}
+
+/* Answer the requests buffered, as far as the send buffer allows */
+static void process(conn_t *c)
+{
+    while (!c->closing && !c->body_left) {
+        c->req[c->req_len] = 0;
+        char *end = strstr(c->req, "\r\n\r\n");
+        if (!end) {
+            if (c->req_len >= HTTPD_REQ_BUF - 1) {
+                c->keep_alive = false;
+                send_error(c, 431, "Request Header Fields Too Large", false);
+                tcp_output(c->pcb);
+                conn_close(c);
+            }
+            return;
+        }
+        if (tcp_sndbuf(c->pcb) < HEADER_MAX)
+            return;
+
+        size_t len = end + 4 - c->req;
+        end[2] = 0;
+        if (!handle_request(c)) {
+            end[2] = '\r';
+            return;
+        }
+        if (!c->pcb)
+            return;  /* upgraded */
+        memmove(c->req, c->req + len, c->req_len - len);
+        c->req_len -= len;
+
+        send_body(c);
+        if (!c->body_left && !c->keep_alive) {
+            conn_close(c);
+            return;
+        }
+    }
+}
+
+static err_t recv_cb(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
+{
+    conn_t *c = arg;
+
+    if (!p) {
+        /* The client closed its side */
+        conn_close(c);
+        return ERR_OK;
+    }
+    if (c->req_len + p->tot_len > HTTPD_REQ_BUF - 1) {
+        /* With a whole request still waiting, refuse the data and lwIP
+           passes it again later. Otherwise take what fits, process()
+           rejects the request if that's not enough for its headers. */
+        c->req[c->req_len] = 0;
+        if (c->body_left || strstr(c->req, "\r\n\r\n"))
+            return ERR_MEM;
+    }
+
+    uint16_t n = p->tot_len;
+    if (n > HTTPD_REQ_BUF - 1 - c->req_len)
+        n = HTTPD_REQ_BUF - 1 - c->req_len;
+    pbuf_copy_partial(p, c->req + c->req_len, n, 0);
+    c->req_len += n;
+    tcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+    c->idle = 0;
+
+    process(c);
+    return ERR_OK;
+}
+
+static err_t sent_cb(void *arg, struct tcp_pcb *pcb, u16_t len)
+{
+    conn_t *c = arg;
+
+    c->idle = 0;
+    if (c->closing)
+        return ERR_OK;
+    send_body(c);
+    if (!c->body_left) {
+        if (!c->keep_alive)
+            conn_close(c);
+        else
+            process(c);
+    }
+    return ERR_OK;
+}
+
+static err_t poll_cb(void *arg, struct tcp_pcb *pcb)
+{
+    conn_t *c = arg;
+
+    if (c->closing) {
+        if (tcp_close(pcb) == ERR_OK) {
+            conn_free(c);
+        } else if (++c->idle * POLL_MS >= HTTPD_IDLE_TIMEOUT_S * 1000) {
+            conn_free(c);
+            tcp_abort(pcb);
+            return ERR_ABRT;
+        }
+        return ERR_OK;
+    }
+    if (c->body_left) {
+        sent_cb(c, pcb, 0);
+    } else if (++c->idle * POLL_MS >= HTTPD_IDLE_TIMEOUT_S * 1000) {
+        c->idle = 0;
+        conn_close(c);
+    }
+    return ERR_OK;
+}
+
+static void err_cb(void *arg, err_t err)
+{
+    conn_t *c = arg;
+
+    /* The pcb has already been freed */
+    c->pcb = NULL;
+}
+
+static err_t accept_cb(void *arg, struct tcp_pcb *pcb, err_t err)
+{
+    conn_t *c = NULL;
+
+    tcp_accepted(listen_pcb);
+    for (int i = 0; i < HTTPD_MAX_CONNS && !c; i++) {
+        if (!conns[i].pcb)
+            c = &conns[i];
+    }
+    if (!c) {
+        tcp_abort(pcb);
+        return ERR_ABRT;
+    }
+
+    memset(c, 0, offsetof(conn_t, req));
+    c->pcb = pcb;
+    tcp_setprio(pcb, TCP_PRIO_MIN);
+    tcp_arg(pcb, c);
+    tcp_recv(pcb, recv_cb);
+    tcp_sent(pcb, sent_cb);
+    tcp_err(pcb, err_cb);
+    tcp_poll(pcb, poll_cb, POLL_INTERVAL);
+    return ERR_OK;
+}
+
+typedef struct {
+    sys_sem_t done;
+    uint16_t port;
+    bool ok;
+} start_call_t;
+
+static void stop_cb(void *arg)
+{
+    if (listen_pcb) {
+        tcp_close(listen_pcb);
+        listen_pcb = NULL;
+    }
+    for (int i = 0; i < HTTPD_MAX_CONNS; i++) {
+        struct tcp_pcb *pcb = conns[i].pcb;
+        if (pcb) {
+            conn_free(&conns[i]);
+            tcp_abort(pcb);
+        }
+    }
+    if (arg)
+        sys_sem_signal((sys_sem_t *)arg);
+}
+
+static void start_cb(void *arg)
+{
+    start_call_t *call = arg;
+    struct tcp_pcb *pcb = tcp_new();
+
+    call->ok = false;
+    if (pcb && tcp_bind(pcb, IP_ADDR_ANY, call->port) == ERR_OK) {
+        listen_pcb = tcp_listen_with_backlog(pcb, HTTPD_MAX_CONNS);
+        if (listen_pcb) {
+            tcp_accept(listen_pcb, accept_cb);
+            call->ok = true;
+        }
+    }
+    if (!call->ok && pcb && !listen_pcb)
+        tcp_close(pcb);
+    sys_sem_signal(&call->done);
+}
+
+bool httpd_start(uint16_t port, const httpd_route_t *r, size_t count, httpd_file_fn files)
+{
+    start_call_t call = { .port = port };
+
+    httpd_stop();
+    routes = r;
+    route_count = count;
+    file_lookup = files;
+
+    if (sys_sem_new(&call.done, 0) != ERR_OK)
+        return false;
+    if (tcpip_callback(start_cb, &call) == ERR_OK)
+        sys_sem_wait(&call.done);
+    sys_sem_free(&call.done);
+    return call.ok;
+}
+
+void httpd_stop(void)
+{
+    sys_sem_t done;
+
+    if (sys_sem_new(&done, 0) != ERR_OK) {
+        tcpip_callback(stop_cb, NULL);
+        return;
+    }
+    if (tcpip_callback(stop_cb, &done) == ERR_OK)
+        sys_sem_wait(&done);
+    sys_sem_free(&done);
+}
+
+int httpd_connections(void)
+{
+    int n = 0;
+
+    for (int i = 0; i < HTTPD_MAX_CONNS; i++)
+        n += conns[i].pcb != NULL;
+    return n;
+}
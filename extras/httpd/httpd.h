@@ -0,0 +1,129 @@
+/* Event driven HTTP/1.1 server on the lwIP raw TCP API
+ *
+ * The server runs entirely in tcpip_thread as raw API callbacks, so
+ * it has no task (or stack) of its own and one node can keep many
+ * clients connected at once: each connection takes a fixed slot of
+ * about HTTPD_REQ_BUF bytes from a pool of HTTPD_MAX_CONNS, and the
+ * server allocates nothing while running.
+ *
+ * Requests are matched against a table of routes, each either a static
+ * body or a handler generating one. Static bodies are handed to
+ * tcp_write() straight from where they are (IROM constants, a romfs
+ * image in flash, ...) as the send window opens, without a staging
+ * buffer: lwIP copies each segment once into the outgoing pbuf, which
+ * LWIP_NETIF_TX_SINGLE_PBUF makes it do anyway, using word loads for
+ * the flash cache window (see MEMCPY in lwipopts.h). Paths in no route
+ * can be looked up by a file callback, e.g. in romfs, whose files can
+ * be stored gzip compressed and carry an ETag: they are sent compressed
+ * straight from flash, and a browser's revalidation gets a 304 without
+ * the body.
+ *
+ * Connections are kept alive (HTTP/1.1 by default, HTTP/1.0 when asked)
+ * and requests can be pipelined, each answered in order. Connections
+ * idle for HTTPD_IDLE_TIMEOUT_S are closed.
+ *
+ * Only GET and HEAD are supported, and paths are matched as they are
+ * sent (no %-decoding). A route can also take a connection over from
+ * the server when the client asks to upgrade it, see extras/websocket.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _HTTPD_H
+#define _HTTPD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifndef HTTPD_MAX_CONNS
+#define HTTPD_MAX_CONNS 8
+#endif
+
+/* Request buffer per connection, the longest request line and headers */
+#ifndef HTTPD_REQ_BUF
+#define HTTPD_REQ_BUF 512
+#endif
+
+#ifndef HTTPD_IDLE_TIMEOUT_S
+#define HTTPD_IDLE_TIMEOUT_S 10
+#endif
+
+/* Longest body a handler can generate. There's one buffer for all
+   connections, as handlers all run in tcpip_thread. */
+#ifndef HTTPD_DYNAMIC_MAX
+#define HTTPD_DYNAMIC_MAX 1024
+#endif
+
+/* Generate a response body into 'buf' (of 'size' bytes) for 'path',
+   'query' is what followed the '?' or "". Return its length, or -1 to
+   respond with a 500 error. Runs in tcpip_thread, so must be quick and
+   not block. */
+typedef int (*httpd_handler_t)(const char *path, const char *query, char *buf, size_t size);
+
+struct tcp_pcb;
+struct httpd_route;
+
+/* Take over 'pcb' for a request with an Upgrade header: answer it and
+   install your own raw API callbacks. 'headers' are the request's
+   header lines. Return false to leave the connection to the server,
+   which then responds 400 Bad Request. Runs in tcpip_thread. */
+typedef bool (*httpd_upgrade_fn)(struct tcp_pcb *pcb, const struct httpd_route *route,
+                                 const char *path, const char *query, const char *headers);
+
+typedef struct httpd_route {
+    const char *path;           /* matched exactly, without the query */
+    const char *content_type;
+    const char *headers;        /* extra header lines ending in "\r\n", or NULL */
+    const void *data;           /* static body, must stay valid */
+    size_t len;
+    httpd_handler_t handler;    /* if set, generates the body instead */
+    httpd_upgrade_fn upgrade;   /* if set, takes over upgrade requests, with 'data' its argument */
+} httpd_route_t;
+
+typedef struct {
+    const void *data;   /* body, must stay valid */
+    size_t len;
+    bool gzip;          /* body is gzip compressed */
+    uint32_t etag;      /* hash of the contents for the ETag, 0 for none */
+} httpd_file_t;
+
+/* Look up a path in no route. Return true with the file filled in if
+   there is one (romfs_find() gives everything it needs).
+
+   A gzip compressed body is sent as it is with "Content-Encoding: gzip"
+   (clients that don't accept that get 406 Not Acceptable). A file with
+   an ETag is sent with it and "Cache-Control: no-cache", so browsers
+   revalidate each time, and a request whose If-None-Match has the same
+   ETag is answered 304 Not Modified without the body. */
+typedef bool (*httpd_file_fn)(const char *path, httpd_file_t *file);
+
+/* Start serving 'routes' (which must stay valid) on 'port'. 'files' is
+   called for other paths, with the content type guessed from the file
+   extension; NULL gives 404s for them.
+
+   Returns false if the server couldn't listen. Must be called from a
+   task other than tcpip_thread.
+*/
+bool httpd_start(uint16_t port, const httpd_route_t *routes, size_t count, httpd_file_fn files);
+
+/* Stop listening and abort all connections */
+void httpd_stop(void);
+
+/* Find header 'name' in request header lines 'headers'. Returns its
+   value (leading spaces skipped), with its length in 'len', or NULL. */
+const char *httpd_header(const char *headers, const char *name, size_t *len);
+
+/* Connections currently open */
+int httpd_connections(void);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _HTTPD_H */
@@ -23,207 +23,451 @@
  */
 
 #include <esp8266.h>
-#include <espressif/esp_misc.h> // sdk_os_delay_us
+#include <stdio.h>
 #include "i2c.h"
 
 
 // I2C driver for ESP8266 written for use with esp-open-rtos
 // Based on https://en.wikipedia.org/wiki/I²C#Example_of_bit-banging_the_I.C2.B2C_Master_protocol
 
-// With calling overhead, we end up at ~100kbit/s
-#define CLK_HALF_PERIOD_US (1)
+// The output latch of both pins is kept low, and a line is driven low
+// by enabling its output and released (pulled high by the pullups) by
+// disabling it, writing the GPIO registers directly. Each half clock
+// period ends at a CCOUNT deadline counted from the previous one, so
+// the time spent in the code between edges doesn't add up and periods
+// stay even.
 
-#define CLK_STRETCH  (10)
+#define DEFAULT_CLK_STRETCH_US (1000)
 
-static bool started;
-static uint8_t g_scl_pin;
-static uint8_t g_sda_pin;
+i2c_bus_t i2c_default_bus;
 
-void i2c_init(uint8_t scl_pin, uint8_t sda_pin)
+static inline uint32_t get_ccount(void)
+{
+    uint32_t ccount;
+    __asm__ volatile ("rsr %0, ccount" : "=a" (ccount));
+    return ccount;
+}
+
+static void update_timing(uint32_t cpu_freq, void *arg)
+{
+    i2c_bus_t *bus = arg;
+    bus->half_cycles = cpu_freq / (2 * bus->frequency);
+    bus->stretch_cycles = cpu_freq / 1000000 * bus->stretch_us;
+}
+
+void i2c_bus_init(i2c_bus_t *bus, uint8_t scl_pin, uint8_t sda_pin, i2c_freq_t freq)
+{
+    bus->started = false;
+    bus->scl_mask = BIT(scl_pin);
+    bus->sda_mask = BIT(sda_pin);
+    bus->frequency = freq;
+    if (!bus->stretch_us)
+        bus->stretch_us = DEFAULT_CLK_STRETCH_US;
+
+    gpio_enable(scl_pin, GPIO_OUTPUT);
+    gpio_enable(sda_pin, GPIO_OUTPUT);
+    GPIO.OUT_CLEAR = bus->scl_mask | bus->sda_mask;
+    GPIO.ENABLE_OUT_CLEAR = bus->scl_mask | bus->sda_mask;
+
+    update_timing(cpu_clk_freq(), bus);
+    if (!bus->mutex) {
+        bus->mutex = xSemaphoreCreateMutexStatic(&bus->mutex_buffer);
+        bus->freq_notifier.changed = update_timing;
+        bus->freq_notifier.arg = bus;
+        cpu_freq_register(&bus->freq_notifier);
+    }
+}
+
+void i2c_bus_set_frequency(i2c_bus_t *bus, i2c_freq_t freq)
+{
+    bus->frequency = freq;
+    update_timing(cpu_clk_freq(), bus);
+}
+
+void i2c_bus_set_clock_stretch(i2c_bus_t *bus, uint32_t timeout_us)
+{
+    bus->stretch_us = timeout_us;
+    update_timing(cpu_clk_freq(), bus);
+}
+
+bool i2c_bus_timed_out(i2c_bus_t *bus)
+{
+    return bus->timed_out;
+}
+
+// True if the calling task already has the bus (always before the
+// scheduler starts, when there is nothing to lock against)
+static inline bool holds_bus(i2c_bus_t *bus)
+{
+    return xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED
+        || bus->owner == xTaskGetCurrentTaskHandle();
+}
+
+void i2c_bus_lock(i2c_bus_t *bus)
+{
+    if (xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED)
+        return;
+    if (bus->owner != xTaskGetCurrentTaskHandle()) {
+        xSemaphoreTake(bus->mutex, portMAX_DELAY);
+        bus->owner = xTaskGetCurrentTaskHandle();
+    }
+    bus->locks++;
+}
+
+void i2c_bus_unlock(i2c_bus_t *bus)
 {
-    started = false;
-    g_scl_pin = scl_pin;
-    g_sda_pin = sda_pin;
+    if (xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED)
+        return;
+    if (bus->owner != xTaskGetCurrentTaskHandle() || !bus->locks)
+        return;
+    if (--bus->locks == 0) {
+        bus->owner = NULL;
+        xSemaphoreGive(bus->mutex);
+    }
 }
 
-static void i2c_delay(void)
+// Wait until the end of the current half period
+static inline void i2c_delay(i2c_bus_t *bus)
 {
-    sdk_os_delay_us(CLK_HALF_PERIOD_US);
+    uint32_t now;
+    bus->edge += bus->half_cycles;
+    while ((int32_t)((now = get_ccount()) - bus->edge) < 0) ;
+    // Running late (interrupted, or a flash cache miss), so start the
+    // next half period from now rather than cutting it short
+    if (now - bus->edge > bus->half_cycles)
+        bus->edge = now;
 }
 
-// Set SCL as input and return current level of line, 0 or 1
-static bool read_scl(void)
+// Release SCL and wait for it to go high, for as long as the slave
+// stretches the clock. Returns false on timeout.
+static inline bool release_scl(i2c_bus_t *bus)
 {
-    gpio_enable(g_scl_pin, GPIO_INPUT);
-    return gpio_read(g_scl_pin); // Clock high, valid ACK
+    GPIO.ENABLE_OUT_CLEAR = bus->scl_mask;
+    if (GPIO.IN & bus->scl_mask)
+        return true;
+    uint32_t start = get_ccount();
+    while (!(GPIO.IN & bus->scl_mask)) {
+        if (get_ccount() - start > bus->stretch_cycles) {
+            bus->timed_out = true;
+            return false;
+        }
+    }
+    // The high half period starts when the slave lets go
+    bus->edge = get_ccount();
+    return true;
 }
 
-// Set SDA as input and return current level of line, 0 or 1
-static bool read_sda(void)
+// Release SDA and return current level of line, 0 or 1
+static inline bool read_sda(i2c_bus_t *bus)
 {
-    gpio_enable(g_sda_pin, GPIO_INPUT);
-    // TODO: Without this delay we get arbitration lost in i2c_stop
-    i2c_delay();
-    return gpio_read(g_sda_pin); // Clock high, valid ACK
+    GPIO.ENABLE_OUT_CLEAR = bus->sda_mask;
+    return GPIO.IN & bus->sda_mask;
 }
 
 // Actively drive SCL signal low
-static void clear_scl(void)
+static inline void clear_scl(i2c_bus_t *bus)
 {
-    gpio_enable(g_scl_pin, GPIO_OUTPUT);
-    gpio_write(g_scl_pin, 0);
+    GPIO.ENABLE_OUT_SET = bus->scl_mask;
 }
 
 // Actively drive SDA signal low
-static void clear_sda(void)
+static inline void clear_sda(i2c_bus_t *bus)
 {
-    gpio_enable(g_sda_pin, GPIO_OUTPUT);
-    gpio_write(g_sda_pin, 0);
+    GPIO.ENABLE_OUT_SET = bus->sda_mask;
 }
 
 // Output start condition
-void i2c_start(void)
+void i2c_bus_start(i2c_bus_t *bus)
 {
-    uint32_t clk_stretch = CLK_STRETCH;
-    if (started) { // if started, do a restart cond
+    if (bus->started && holds_bus(bus)) { // if started, do a restart cond
         // Set SDA to 1
-        (void) read_sda();
-        i2c_delay();
-        while (read_scl() == 0 && clk_stretch--) ;
-        // Repeated start setup time, minimum 4.7us
-        i2c_delay();
+        (void) read_sda(bus);
+        i2c_delay(bus);
+        release_scl(bus);
+        // Repeated start setup time
+        i2c_delay(bus);
+    } else {
+        i2c_bus_lock(bus);
+        bus->edge = get_ccount();
+        bus->timed_out = false;
     }
-    if (read_sda() == 0) {
+    if (read_sda(bus) == 0) {
         printf("I2C: arbitration lost in i2c_start\n");
     }
     // SCL is high, set SDA from 1 to 0.
-    clear_sda();
-    i2c_delay();
-    clear_scl();
-    started = true;
+    clear_sda(bus);
+    i2c_delay(bus);
+    clear_scl(bus);
+    bus->started = true;
 }
 
 // Output stop condition
-void i2c_stop(void)
+void i2c_bus_stop(i2c_bus_t *bus)
 {
-    uint32_t clk_stretch = CLK_STRETCH;
     // Set SDA to 0
-    clear_sda();
-    i2c_delay();
+    clear_sda(bus);
+    i2c_delay(bus);
     // Clock stretching
-    while (read_scl() == 0 && clk_stretch--) ;
-    // Stop bit setup time, minimum 4us
-    i2c_delay();
+    release_scl(bus);
+    // Stop bit setup time
+    i2c_delay(bus);
     // SCL is high, set SDA from 0 to 1
-    if (read_sda() == 0) {
+    if (read_sda(bus) == 0) {
         printf("I2C: arbitration lost in i2c_stop\n");
     }
-    i2c_delay();
-    started = false;
+    // Bus free time before the next start
+    i2c_delay(bus);
+    if (bus->started) {
+        bus->started = false;
+        i2c_bus_unlock(bus);
+    }
 }
 
 // Write a bit to I2C bus
-static void i2c_write_bit(bool bit)
+static void i2c_write_bit(i2c_bus_t *bus, bool bit)
 {
-    uint32_t clk_stretch = CLK_STRETCH;
     if (bit) {
-        (void) read_sda();
+        (void) read_sda(bus);
     } else {
-        clear_sda();
+        clear_sda(bus);
     }
-    i2c_delay();
+    i2c_delay(bus);
     // Clock stretching
-    while (read_scl() == 0 && clk_stretch--) ;
+    release_scl(bus);
     // SCL is high, now data is valid
     // If SDA is high, check that nobody else is driving SDA
-    if (bit && read_sda() == 0) {
+    if (bit && read_sda(bus) == 0) {
         printf("I2C: arbitration lost in i2c_write_bit\n");
     }
-    i2c_delay();
-    clear_scl();
+    i2c_delay(bus);
+    clear_scl(bus);
 }
 
 // Read a bit from I2C bus
-static bool i2c_read_bit(void)
+static bool i2c_read_bit(i2c_bus_t *bus)
 {
-    uint32_t clk_stretch = CLK_STRETCH;
     bool bit;
     // Let the slave drive data
-    (void) read_sda();
-    i2c_delay();
+    (void) read_sda(bus);
+    i2c_delay(bus);
     // Clock stretching
-    while (read_scl() == 0 && clk_stretch--) ;
+    release_scl(bus);
     // SCL is high, now data is valid
-    bit = read_sda();
-    i2c_delay();
-    clear_scl();
+    bit = read_sda(bus);
+    i2c_delay(bus);
+    clear_scl(bus);
     return bit;
 }
 
-bool i2c_write(uint8_t byte)
+bool i2c_bus_write(i2c_bus_t *bus, uint8_t byte)
 {
     bool nack;
     uint8_t bit;
     for (bit = 0; bit < 8; bit++) {
-        i2c_write_bit((byte & 0x80) != 0);
+        i2c_write_bit(bus, (byte & 0x80) != 0);
         byte <<= 1;
     }
-    nack = i2c_read_bit();
-    return !nack;
+    nack = i2c_read_bit(bus);
+    return !nack && !bus->timed_out;
 }
 
-uint8_t i2c_read(bool ack)
+uint8_t i2c_bus_read(i2c_bus_t *bus, bool ack)
 {
     uint8_t byte = 0;
     uint8_t bit;
     for (bit = 0; bit < 8; bit++) {
-        byte = (byte << 1) | i2c_read_bit();
+        byte = (byte << 1) | i2c_read_bit(bus);
     }
-    i2c_write_bit(ack);
+    i2c_write_bit(bus, ack);
     return byte;
 }
 
-bool i2c_slave_write(uint8_t slave_addr, uint8_t *data, uint8_t len)
+bool i2c_bus_slave_write(i2c_bus_t *bus, uint8_t slave_addr, uint8_t *data, uint8_t len)
 {
     bool success = false;
     do {
-        i2c_start();
-        if (!i2c_write(slave_addr << 1))
+        i2c_bus_start(bus);
+        if (!i2c_bus_write(bus, slave_addr << 1))
             break;
         while (len--) {
-            if (!i2c_write(*data++))
+            if (!i2c_bus_write(bus, *data++))
                 break;
         }
-        i2c_stop();
-        success = true;
+        success = !bus->timed_out;
     } while(0);
+    i2c_bus_stop(bus);
     return success;
 }
 
-bool i2c_slave_read(uint8_t slave_addr, uint8_t data, uint8_t *buf, uint32_t len)
+bool i2c_bus_slave_read(i2c_bus_t *bus, uint8_t slave_addr, uint8_t data, uint8_t *buf, uint32_t len)
 {
     bool success = false;
+    // Keep the bus across the stop between the write and the read
+    i2c_bus_lock(bus);
     do {
-        i2c_start();
-        if (!i2c_write(slave_addr << 1)) {
+        i2c_bus_start(bus);
+        if (!i2c_bus_write(bus, slave_addr << 1)) {
             break;
         }
-        i2c_write(data);
-        i2c_stop();
-        i2c_start();
-        if (!i2c_write(slave_addr << 1 | 1)) { // Slave address + read
+        i2c_bus_write(bus, data);
+        i2c_bus_stop(bus);
+        i2c_bus_start(bus);
+        if (!i2c_bus_write(bus, slave_addr << 1 | 1)) { // Slave address + read
             break;
         }
         while(len) {
-            *buf = i2c_read(len == 1);
+            *buf = i2c_bus_read(bus, len == 1);
             buf++;
             len--;
         }
-        success = true;
+        success = !bus->timed_out;
     } while(0);
-    i2c_stop();
+    i2c_bus_stop(bus);
+    i2c_bus_unlock(bus);
     if (!success) {
         printf("I2C: write error\n");
     }
     return success;
 }
+
+bool i2c_bus_transfer(i2c_bus_t *bus, i2c_transfer_t *xfer)
+{
+    bool success = false;
+    do {
+        i2c_bus_start(bus);
+        if (xfer->tx_len || !xfer->rx_len) {
+            if (!i2c_bus_write(bus, xfer->slave_addr << 1))
+                break;
+            const uint8_t *tx = xfer->tx;
+            uint16_t len;
+            for (len = xfer->tx_len; len; len--) {
+                if (!i2c_bus_write(bus, *tx++))
+                    break;
+            }
+            if (len)
+                break;
+            if (xfer->rx_len)
+                i2c_bus_start(bus); // Repeated start, keeps the bus
+        }
+        if (xfer->rx_len) {
+            if (!i2c_bus_write(bus, xfer->slave_addr << 1 | 1))
+                break;
+            uint8_t *rx = xfer->rx;
+            for (uint16_t len = xfer->rx_len; len; len--) {
+                *rx++ = i2c_bus_read(bus, len == 1);
+            }
+        }
+        success = !bus->timed_out;
+    } while(0);
+    i2c_bus_stop(bus);
+    xfer->success = success;
+    return success;
+}
+
+bool i2c_bus_read_regs(i2c_bus_t *bus, uint8_t slave_addr, uint8_t reg, uint8_t *buf, uint16_t len)
+{
+    i2c_transfer_t xfer = {
+        .slave_addr = slave_addr,
+        .tx = &reg,
+        .tx_len = 1,
+        .rx = buf,
+        .rx_len = len,
+    };
+    return i2c_bus_transfer(bus, &xfer);
+}
+
+static void i2c_async_task(void *arg)
+{
+    i2c_bus_t *bus = arg;
+    i2c_transfer_t *xfer;
+
+    for (;;) {
+        if (xQueueReceive(bus->async_queue, &xfer, portMAX_DELAY) != pdTRUE)
+            continue;
+        i2c_bus_transfer(bus, xfer);
+        if (xfer->done)
+            xfer->done(xfer);
+    }
+}
+
+bool i2c_bus_async_init(i2c_bus_t *bus, unsigned portBASE_TYPE priority, unsigned portBASE_TYPE queue_len)
+{
+    if (bus->async_queue)
+        return false;
+    bus->async_queue = xQueueCreate(queue_len, sizeof(i2c_transfer_t *));
+    if (!bus->async_queue)
+        return false;
+    if (xTaskCreate(i2c_async_task, (signed char *)"i2c", I2C_ASYNC_STACK_SIZE,
+                    bus, priority, NULL) != pdPASS) {
+        vQueueDelete(bus->async_queue);
+        bus->async_queue = NULL;
+        return false;
+    }
+    return true;
+}
+
+bool i2c_bus_transfer_async(i2c_bus_t *bus, i2c_transfer_t *xfer)
+{
+    return xQueueSend(bus->async_queue, &xfer, 0) == pdTRUE;
+}
+
+bool i2c_bus_transfer_async_from_isr(i2c_bus_t *bus, i2c_transfer_t *xfer, portBASE_TYPE *woken)
+{
+    return xQueueSendFromISR(bus->async_queue, &xfer, woken) == pdTRUE;
+}
+
+void i2c_init(uint8_t scl_pin, uint8_t sda_pin)
+{
+    i2c_freq_t freq = i2c_default_bus.frequency ? i2c_default_bus.frequency : I2C_FREQ_100K;
+    i2c_bus_init(&i2c_default_bus, scl_pin, sda_pin, freq);
+}
+
+void i2c_set_frequency(i2c_freq_t freq)
+{
+    i2c_bus_set_frequency(&i2c_default_bus, freq);
+}
+
+void i2c_set_clock_stretch(uint32_t timeout_us)
+{
+    i2c_bus_set_clock_stretch(&i2c_default_bus, timeout_us);
+}
+
+bool i2c_timed_out(void)
+{
+    return i2c_bus_timed_out(&i2c_default_bus);
+}
+
+bool i2c_write(uint8_t byte)
+{
+    return i2c_bus_write(&i2c_default_bus, byte);
+}
+
+uint8_t i2c_read(bool ack)
+{
+    return i2c_bus_read(&i2c_default_bus, ack);
+}
+
+bool i2c_slave_write(uint8_t slave_addr, uint8_t *buf, uint8_t len)
+{
+    return i2c_bus_slave_write(&i2c_default_bus, slave_addr, buf, len);
+}
+
+bool i2c_slave_read(uint8_t slave_addr, uint8_t data, uint8_t *buf, uint32_t len)
+{
+    return i2c_bus_slave_read(&i2c_default_bus, slave_addr, data, buf, len);
+}
+
+bool i2c_read_regs(uint8_t slave_addr, uint8_t reg, uint8_t *buf, uint16_t len)
+{
+    return i2c_bus_read_regs(&i2c_default_bus, slave_addr, reg, buf, len);
+}
+
+void i2c_start(void)
+{
+    i2c_bus_start(&i2c_default_bus);
+}
+
+void i2c_stop(void)
+{
+    i2c_bus_stop(&i2c_default_bus);
+}
@@ -24,28 +24,164 @@
 
 #ifndef __I2C_H__
 #define __I2C_H__
-#endif
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <esp/clocks.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
 
-// Init bitbanging I2C driver on given pins
-void i2c_init(uint8_t scl_pin, uint8_t sda_pin);
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// SCL clock frequencies. 1 MHz (fast mode plus) is only reached with
+// the CPU at 160 MHz, at 80 MHz the clock runs slower than nominal.
+typedef enum {
+    I2C_FREQ_100K = 100000,
+    I2C_FREQ_400K = 400000,
+    I2C_FREQ_1M = 1000000,
+} i2c_freq_t;
+
+// Stack size of a bus's transfer task (see i2c_bus_async_init), in words
+#ifndef I2C_ASYNC_STACK_SIZE
+#define I2C_ASYNC_STACK_SIZE 256
+#endif
+
+// A transaction: write 'tx_len' bytes from 'tx' (typically a register
+// address), then if 'rx_len' isn't 0 do a repeated start and read
+// 'rx_len' bytes into 'rx', then stop. Either part may be empty.
+//
+// For i2c_bus_transfer_async() the transfer and both buffers must stay
+// valid until 'done' is called.
+typedef struct i2c_transfer {
+    uint8_t slave_addr;
+    const uint8_t *tx;
+    uint16_t tx_len;
+    uint8_t *rx;
+    uint16_t rx_len;
+    // Called from the bus's transfer task when an asynchronous transfer
+    // has finished, with 'success' set. May be NULL.
+    void (*done)(struct i2c_transfer *xfer);
+    void *arg;
+    bool success;
+} i2c_transfer_t;
+
+// One bus, on its own pair of pins. The fields are private to the driver.
+//
+// Each bus has a mutex, held from a start condition to the matching stop
+// (repeated starts included), so tasks using the same bus get whole
+// transactions and tasks on different buses run in parallel.
+typedef struct {
+    uint32_t scl_mask;
+    uint32_t sda_mask;
+    uint32_t frequency;
+    uint32_t stretch_us;
+    uint32_t half_cycles;       // CPU cycles per half SCL period
+    uint32_t stretch_cycles;
+    uint32_t edge;              // CCOUNT at the end of the last half period
+    bool started;
+    bool timed_out;
+    uint8_t locks;
+    xTaskHandle owner;
+    xSemaphoreHandle mutex;
+    StaticSemaphore_t mutex_buffer;
+    xQueueHandle async_queue;
+    cpu_freq_notifier_t freq_notifier;
+} i2c_bus_t;
+
+// Init bitbanging I2C bus on given pins (GPIO0-15, not GPIO16). Both
+// lines need pullups.
+//
+// 'bus' must stay valid and be zeroed before the first call (a static
+// or global variable). Calling it again changes the pins and frequency.
+void i2c_bus_init(i2c_bus_t *bus, uint8_t scl_pin, uint8_t sda_pin, i2c_freq_t freq);
+
+// Set the SCL clock frequency.
+void i2c_bus_set_frequency(i2c_bus_t *bus, i2c_freq_t freq);
+
+// Set how long a slave may hold SCL low (clock stretching) before the
+// transfer is abandoned, 1 ms by default.
+void i2c_bus_set_clock_stretch(i2c_bus_t *bus, uint32_t timeout_us);
+
+// Return true if a slave stretched the clock for longer than the
+// timeout since the last start condition. i2c_bus_write() and the
+// i2c_bus_slave_[read|write] functions then return false.
+bool i2c_bus_timed_out(i2c_bus_t *bus);
+
+// Hold the bus mutex across several transactions, for devices that need
+// a sequence without other traffic in between. Nests, and
+// i2c_bus_start()/i2c_bus_stop() inside it don't release the bus.
+// Before the scheduler starts these do nothing.
+void i2c_bus_lock(i2c_bus_t *bus);
+void i2c_bus_unlock(i2c_bus_t *bus);
 
 // Write a byte to I2C bus. Return true if slave acked.
-bool i2c_write(uint8_t byte);
+bool i2c_bus_write(i2c_bus_t *bus, uint8_t byte);
 
-// Read a byte from I2C bus. Return true if slave acked.
-uint8_t i2c_read(bool ack);
+// Read a byte from I2C bus, sending an ACK if 'ack' is false (more
+// bytes to read) or a NACK if it's true (last byte).
+uint8_t i2c_bus_read(i2c_bus_t *bus, bool ack);
 
 // Write 'len' bytes from 'buf' to slave. Return true if slave acked.
-bool i2c_slave_write(uint8_t slave_addr, uint8_t *buf, uint8_t len);
+bool i2c_bus_slave_write(i2c_bus_t *bus, uint8_t slave_addr, uint8_t *buf, uint8_t len);
 
 // Issue a read operation and send 'data', followed by reading 'len' bytes
 // from slave into 'buf'. Return true if slave acked.
-bool i2c_slave_read(uint8_t slave_addr, uint8_t data, uint8_t *buf, uint32_t len);
+bool i2c_bus_slave_read(i2c_bus_t *bus, uint8_t slave_addr, uint8_t data, uint8_t *buf, uint32_t len);
+
+// Run 'xfer' as a single transaction and wait for it. Returns (and sets
+// xfer->success) true if the slave acked everything. 'done' isn't called.
+bool i2c_bus_transfer(i2c_bus_t *bus, i2c_transfer_t *xfer);
+
+// Burst read 'len' consecutive registers starting at 'reg', in one
+// transaction with a repeated start between the register address write
+// and the read. Return true if slave acked.
+bool i2c_bus_read_regs(i2c_bus_t *bus, uint8_t slave_addr, uint8_t reg, uint8_t *buf, uint16_t len);
+
+// Start a task at 'priority' that runs this bus's asynchronous transfers
+// in the order they're queued, with room for 'queue_len' pending ones.
+// Returns false if out of memory or already started.
+bool i2c_bus_async_init(i2c_bus_t *bus, unsigned portBASE_TYPE priority, unsigned portBASE_TYPE queue_len);
+
+// Queue 'xfer' to run on the bus's transfer task, which calls
+// xfer->done when it has finished. Returns false if the queue is full.
+// The transfers hold the bus mutex like any other, so they can be mixed
+// with synchronous use of the same bus.
+bool i2c_bus_transfer_async(i2c_bus_t *bus, i2c_transfer_t *xfer);
+
+// The same, from an interrupt handler (e.g. a timer that samples a
+// sensor). Sets *woken if a context switch is needed.
+bool i2c_bus_transfer_async_from_isr(i2c_bus_t *bus, i2c_transfer_t *xfer, portBASE_TYPE *woken);
 
 // Send start and stop conditions. Only needed when implementing protocols for
-// devices where the i2c_slave_[read|write] functions above are of no use.
+// devices where the i2c_bus_slave_[read|write] functions above are of no use.
+//
+// i2c_bus_start() takes the bus mutex (unless it's a repeated start by
+// the same task) and i2c_bus_stop() releases it.
+void i2c_bus_start(i2c_bus_t *bus);
+void i2c_bus_stop(i2c_bus_t *bus);
+
+// The same functions on a default bus, for drivers written for a single
+// bus. The clock is I2C_FREQ_100K unless set with i2c_set_frequency().
+void i2c_init(uint8_t scl_pin, uint8_t sda_pin);
+void i2c_set_frequency(i2c_freq_t freq);
+void i2c_set_clock_stretch(uint32_t timeout_us);
+bool i2c_timed_out(void);
+bool i2c_write(uint8_t byte);
+uint8_t i2c_read(bool ack);
+bool i2c_slave_write(uint8_t slave_addr, uint8_t *buf, uint8_t len);
+bool i2c_slave_read(uint8_t slave_addr, uint8_t data, uint8_t *buf, uint32_t len);
+bool i2c_read_regs(uint8_t slave_addr, uint8_t reg, uint8_t *buf, uint16_t len);
 void i2c_start(void);
 void i2c_stop(void);
+
+// The default bus, to pass to i2c_bus_*() or bus-aware drivers
+extern i2c_bus_t i2c_default_bus;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
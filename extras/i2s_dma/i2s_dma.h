@@ -0,0 +1,121 @@
+/* I2S audio output and input by SLC DMA
+ *
+ * Transmit streams from a ring of DMA blocks: the SLC walks a circular
+ * chain of descriptors, one per block, feeding the I2S transmitter
+ * without the CPU, and raises an interrupt as it finishes each one. The
+ * writing task copies samples in with i2s_tx_write(), which blocks while
+ * the ring is full, so it runs at the rate the DAC consumes them:
+ *
+ *     i2s_tx_start(44100, 16, 8, 1024);
+ *     for (;;) {
+ *         size_t n = decode(frame, sizeof(frame));
+ *         i2s_tx_write(frame, n, portMAX_DELAY);
+ *     }
+ *
+ * Samples are interleaved left then right: two int16_t per frame at 16
+ * bits, or two int32_t (the sample in the top 24 bits) at 24.
+ *
+ * Blocks that have been played are zeroed by the interrupt, so if the
+ * writer falls behind the DAC gets silence rather than stale audio;
+ * each block played that way counts as an underrun, and the writer
+ * picks up with the next block the DMA hasn't reached.
+ *
+ * The CPU cost is the copy into the ring plus one short interrupt per
+ * block: at 44.1 kHz stereo 16 bit with 1024 byte blocks, 172
+ * interrupts a second.
+ *
+ * Pins: data out on GPIO3 (so not UART0 RX), bit clock on GPIO15, word
+ * select on GPIO2. The I2S clock is 160 MHz divided by two dividers, so
+ * sample rates are approximate; i2s_tx_start() returns the nearest.
+ * The SLC and its interrupt can't be shared with extras/ws2812's I2S
+ * driver.
+ *
+ * Receive is the same ring the other way round: the SLC fills the
+ * blocks in turn from the I2S receiver, never stopping, and the reading
+ * task takes each as it's completed with i2s_rx_read():
+ *
+ *     i2s_rx_start(48000, 24, 6, 2048);
+ *     for (;;) {
+ *         const int32_t *s = i2s_rx_read(portMAX_DELAY);
+ *         process(s, 2048 / sizeof(int32_t));
+ *     }
+ *
+ * A block read stays the reader's until its next call, as long as it
+ * keeps up: with 'blocks' in the ring the DMA comes back round to it
+ * after blocks - 1 more are filled. A reader that falls further behind
+ * than that loses the oldest blocks, counted as overruns, and carries
+ * on from the oldest one still whole. Frames are the same layout as
+ * transmit.
+ *
+ * The rate is only the clock the ESP8266 drives as master, so receive
+ * also suits a raw synchronous bit stream rather than audio: 48000
+ * frames of 2 x 24 bits is 2.3 Mbit/s on I2SI_DATA with no work for the
+ * CPU but one interrupt per block.
+ *
+ * Receive pins: data in on GPIO12, bit clock out on GPIO13, word select
+ * out on GPIO14. Transmit and receive can run together, but share the
+ * clock dividers and sample size (the last started sets them).
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _I2S_DMA_H
+#define _I2S_DMA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/* Largest block an SLC descriptor takes, bytes */
+#define I2S_DMA_MAX_BLOCK 4092
+
+typedef struct {
+    uint32_t blocks;            /* played */
+    uint32_t underruns;         /* blocks played before they were written */
+} i2s_tx_stats_t;
+
+/* Start transmitting at 'sample_rate' with 'bits' (16 or 24) per
+   sample, stereo, through a ring of 'blocks' (at least 3) of
+   'block_bytes' each (a multiple of 4 up to I2S_DMA_MAX_BLOCK). Plays
+   silence until written to. Returns the sample rate the dividers give,
+   or 0 if the arguments are bad or there isn't the memory. */
+uint32_t i2s_tx_start(uint32_t sample_rate, uint8_t bits, size_t blocks, size_t block_bytes);
+
+/* Stop, freeing the ring */
+void i2s_tx_stop(void);
+
+/* Copy 'len' bytes of samples into the ring, waiting up to
+   'timeout_ticks' for room. Returns how many were copied. Only one task
+   may write. */
+size_t i2s_tx_write(const void *data, size_t len, uint32_t timeout_ticks);
+
+void i2s_tx_stats(i2s_tx_stats_t *stats);
+
+typedef struct {
+    uint32_t blocks;            /* filled */
+    uint32_t overruns;          /* blocks overwritten before they were read */
+} i2s_rx_stats_t;
+
+/* Start receiving, arguments and return as i2s_tx_start(). The task
+   calling this is the one that reads. */
+uint32_t i2s_rx_start(uint32_t sample_rate, uint8_t bits, size_t blocks, size_t block_bytes);
+
+/* Stop, freeing the ring (so the last block read too) */
+void i2s_rx_stop(void);
+
+/* Wait up to 'timeout_ticks' for the next filled block and return it,
+   'block_bytes' long, or NULL on timeout. Valid until the next call. */
+const void *i2s_rx_read(uint32_t timeout_ticks);
+
+void i2s_rx_stats(i2s_rx_stats_t *stats);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _I2S_DMA_H */
@@ -0,0 +1,160 @@
+/* SLC descriptor rings and shared I2S setup, see i2s_ring.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "i2s_ring.h"
+#include "i2s_dma.h"
+
+#include <stdlib.h>
+#include <esp/i2s_regs.h>
+#include <esp/interrupts.h>
+#include <common_macros.h>
+#include "sdk_internal.h"
+
+#define I2S_BASE_CLOCK 160000000
+
+static i2s_slc_handler_t out_handler, in_handler;
+static bool initialised;
+
+/* Given to a side of the SLC that isn't running */
+static uint32_t idle_word;
+static struct SLCDescriptor idle_desc;
+
+bool i2s_ring_config_ok(uint8_t bits, size_t count, size_t block)
+{
+    return (bits == 16 || bits == 24) && count >= 3 && block &&
+           block <= I2S_DMA_MAX_BLOCK && !(block % 4);
+}
+
+bool i2s_ring_alloc(i2s_ring_t *ring, size_t count, size_t block)
+{
+    ring->desc = calloc(count, sizeof(struct SLCDescriptor));
+    ring->buf = calloc(count, block);
+    if (!ring->desc || !ring->buf) {
+        i2s_ring_free(ring);
+        return false;
+    }
+    ring->count = count;
+    ring->block = block;
+    ring->last = count - 1;
+    for (size_t i = 0; i < count; i++) {
+        struct SLCDescriptor *d = &ring->desc[i];
+        d->flags = SLC_DESCRIPTOR_FLAGS(block, block, 0, 1, 1);
+        d->buf_ptr = (uint32_t)i2s_ring_block(ring, i);
+        d->next_link_ptr = (uint32_t)&ring->desc[(i + 1) % count];
+    }
+    return true;
+}
+
+void IRAM i2s_ring_rearm(i2s_ring_t *ring, size_t index)
+{
+    ring->desc[index].flags = SLC_DESCRIPTOR_FLAGS(ring->block, ring->block, 0, 1, 1);
+}
+
+void i2s_ring_free(i2s_ring_t *ring)
+{
+    free(ring->desc);
+    free(ring->buf);
+    ring->desc = NULL;
+    ring->buf = NULL;
+}
+
+size_t IRAM i2s_ring_finished(i2s_ring_t *ring, uint32_t eof_desc)
+{
+    size_t index = (eof_desc - (uint32_t)ring->desc) / sizeof(struct SLCDescriptor);
+
+    if (index >= ring->count)
+        return 0;
+    size_t n = (index + ring->count - ring->last) % ring->count;
+    ring->last = index;
+    return n;
+}
+
+uint32_t i2s_set_clock(uint32_t sample_rate, uint8_t bits)
+{
+    uint32_t bck = sample_rate * 2 * bits;
+    uint32_t best_clkm = 2, best_bck = 2, best_err = UINT32_MAX;
+
+    /* Dividers of 2 to 63 both, nearest bit clock */
+    for (uint32_t clkm = 2; clkm < 64; clkm++) {
+        for (uint32_t bckd = 2; bckd < 64; bckd++) {
+            uint32_t f = I2S_BASE_CLOCK / (clkm * bckd);
+            uint32_t err = f > bck ? f - bck : bck - f;
+            if (err < best_err) {
+                best_err = err;
+                best_clkm = clkm;
+                best_bck = bckd;
+            }
+        }
+    }
+
+    uint32_t conf = I2S.CONF;
+    conf &= ~(FIELD_MASK(I2S_CONF_BITS_MOD) | FIELD_MASK(I2S_CONF_BCK_DIV) | FIELD_MASK(I2S_CONF_CLKM_DIV));
+    conf |= VAL2FIELD_M(I2S_CONF_BITS_MOD, bits - 16) | VAL2FIELD_M(I2S_CONF_BCK_DIV, best_bck) |
+            VAL2FIELD_M(I2S_CONF_CLKM_DIV, best_clkm);
+    I2S.CONF = conf;
+
+    return I2S_BASE_CLOCK / (best_clkm * best_bck) / (2 * bits);
+}
+
+static void IRAM slc_isr(void)
+{
+    uint32_t status = SLC.INT_STATUS;
+    SLC.INT_CLEAR = status;
+
+    if ((status & SLC_INT_STATUS_RX_EOF) && out_handler)
+        out_handler();
+    if ((status & SLC_INT_STATUS_TX_EOF) && in_handler)
+        in_handler();
+}
+
+void i2s_dma_init(void)
+{
+    if (initialised)
+        return;
+    initialised = true;
+
+    /* Enable the I2S clock output from the BBPLL */
+    sdk_rom_i2c_writeReg_Mask(0x67, 4, 4, 7, 7, 1);
+
+    I2S.CONF |= I2S_CONF_RESET_MASK;
+    I2S.CONF &= ~I2S_CONF_RESET_MASK;
+    I2S.FIFO_CONF |= I2S_FIFO_CONF_DESCRIPTOR_ENABLE;
+
+    SLC.CONF0 |= SLC_CONF0_RX_LINK_RESET | SLC_CONF0_TX_LINK_RESET;
+    SLC.CONF0 &= ~(SLC_CONF0_RX_LINK_RESET | SLC_CONF0_TX_LINK_RESET);
+    SLC.INT_CLEAR = 0xffffffff;
+    SLC.CONF0 = SET_FIELD(SLC.CONF0, SLC_CONF0_MODE, 1);
+    SLC.RX_DESCRIPTOR_CONF |= SLC_RX_DESCRIPTOR_CONF_INFOR_NO_REPLACE | SLC_RX_DESCRIPTOR_CONF_TOKEN_NO_REPLACE;
+    SLC.RX_DESCRIPTOR_CONF &= ~(SLC_RX_DESCRIPTOR_CONF_RX_FILL_ENABLE | SLC_RX_DESCRIPTOR_CONF_RX_EOF_MODE | SLC_RX_DESCRIPTOR_CONF_RX_FILL_MODE);
+
+    idle_desc.flags = SLC_DESCRIPTOR_FLAGS(sizeof(idle_word), sizeof(idle_word), 0, 0, 1);
+    idle_desc.buf_ptr = (uint32_t)&idle_word;
+    idle_desc.next_link_ptr = (uint32_t)&idle_desc;
+    SLC.TX_LINK = SET_FIELD(SLC.TX_LINK, SLC_TX_LINK_DESCRIPTOR_ADDR, (uint32_t)&idle_desc & SLC_TX_LINK_DESCRIPTOR_ADDR_M);
+    SLC.RX_LINK = SET_FIELD(SLC.RX_LINK, SLC_RX_LINK_DESCRIPTOR_ADDR, (uint32_t)&idle_desc & SLC_RX_LINK_DESCRIPTOR_ADDR_M);
+
+    SLC.INT_ENABLE = 0;
+    _xt_isr_attach(INUM_SLC, slc_isr);
+    _xt_isr_unmask(BIT(INUM_SLC));
+}
+
+void i2s_set_out_handler(i2s_slc_handler_t handler)
+{
+    out_handler = handler;
+    if (handler)
+        SLC.INT_ENABLE |= SLC_INT_ENABLE_RX_EOF;
+    else
+        SLC.INT_ENABLE &= ~SLC_INT_ENABLE_RX_EOF;
+}
+
+void i2s_set_in_handler(i2s_slc_handler_t handler)
+{
+    in_handler = handler;
+    if (handler)
+        SLC.INT_ENABLE |= SLC_INT_ENABLE_TX_EOF;
+    else
+        SLC.INT_ENABLE &= ~SLC_INT_ENABLE_TX_EOF;
+}
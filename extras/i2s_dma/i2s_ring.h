@@ -0,0 +1,69 @@
+/* SLC descriptor rings and the I2S setup the transmit and receive
+ * drivers share. Internal to extras/i2s_dma.
+ *
+ * A ring is 'count' blocks of 'block' bytes, with a descriptor each,
+ * linked in a circle and all flagged EOF so the SLC interrupts as it
+ * finishes each one. Which one it finished comes from the SLC's EOF
+ * descriptor address register rather than counting interrupts, so a
+ * late interrupt that finds several blocks done still accounts for all
+ * of them.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _I2S_RING_H
+#define _I2S_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <esp/slc.h>
+
+typedef struct {
+    struct SLCDescriptor *desc;
+    uint8_t *buf;
+    size_t count;
+    size_t block;
+    size_t last;                /* index of the block finished last */
+} i2s_ring_t;
+
+/* Are these a ring and sample size both drivers take? */
+bool i2s_ring_config_ok(uint8_t bits, size_t count, size_t block);
+
+/* Allocate a zeroed ring. Returns false if out of memory. */
+bool i2s_ring_alloc(i2s_ring_t *ring, size_t count, size_t block);
+
+void i2s_ring_free(i2s_ring_t *ring);
+
+static inline uint8_t *i2s_ring_block(const i2s_ring_t *ring, size_t index)
+{
+    return ring->buf + index * ring->block;
+}
+
+/* How many blocks have been finished since the last call, 'eof_desc'
+   being the descriptor the SLC says it finished last. In the
+   interrupt. */
+size_t i2s_ring_finished(i2s_ring_t *ring, uint32_t eof_desc);
+
+/* Hand block 'index' back to the SLC, full length, once it's finished
+   with it. Receive only: the SLC shortens and disowns the descriptors
+   it writes. In the interrupt. */
+void i2s_ring_rearm(i2s_ring_t *ring, size_t index);
+
+/* Set the I2S clock for 'sample_rate' stereo frames of 'bits' (16 or
+   24) bit samples. Returns the rate the dividers give. */
+uint32_t i2s_set_clock(uint32_t sample_rate, uint8_t bits);
+
+/* Called from the shared SLC interrupt: 'out' when a transmit block is
+   done (the SLC's "RX" side, memory to I2S), 'in' when a receive one is
+   (its "TX" side) */
+typedef void (*i2s_slc_handler_t)(void);
+
+/* Power up the I2S clock and take the SLC interrupt, once */
+void i2s_dma_init(void);
+
+void i2s_set_out_handler(i2s_slc_handler_t handler);
+void i2s_set_in_handler(i2s_slc_handler_t handler);
+
+#endif /* _I2S_RING_H */
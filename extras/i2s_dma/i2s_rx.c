@@ -0,0 +1,120 @@
+/* I2S receive by SLC DMA, see i2s_dma.h
+ *
+ * The DMA fills the ring's blocks in turn, block n being ring index
+ * n % count, and doesn't wait for anyone. 'filled' is the number of the
+ * block it's filling (so blocks before it are complete), written only
+ * by the interrupt; 'taken' is the next block the reader will take,
+ * written only by the reader. The blocks the DMA hasn't come back round
+ * to are filled - count + 1 to filled - 1: a reader further behind than
+ * that has lost blocks, and it skips to the oldest still whole.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "i2s_dma.h"
+#include "i2s_ring.h"
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <esp/i2s_regs.h>
+#include <esp/iomux.h>
+#include <common_macros.h>
+
+static i2s_ring_t ring;
+static volatile uint32_t filled, taken;
+static uint32_t held;           /* the block the reader has, if 'holding' */
+static bool holding;
+static volatile xTaskHandle reader;
+static i2s_rx_stats_t stats;
+
+static void IRAM rx_done(void)
+{
+    size_t n = i2s_ring_finished(&ring, SLC.TX_EOF_DESCRIPTOR_ADDR);
+
+    for (size_t i = 0; i < n; i++)
+        i2s_ring_rearm(&ring, (filled + i) % ring.count);
+    filled += n;
+    stats.blocks += n;
+
+    if (n && reader) {
+        portBASE_TYPE woken = pdFALSE;
+        vTaskNotifyGiveFromISR(reader, &woken);
+        if (woken)
+            portYIELD();
+    }
+}
+
+uint32_t i2s_rx_start(uint32_t sample_rate, uint8_t bits, size_t blocks, size_t block_bytes)
+{
+    if (!i2s_ring_config_ok(bits, blocks, block_bytes))
+        return 0;
+
+    i2s_rx_stop();
+    if (!i2s_ring_alloc(&ring, blocks, block_bytes))
+        return 0;
+    filled = taken = 0;
+    holding = false;
+    stats = (i2s_rx_stats_t){ 0 };
+    reader = xTaskGetCurrentTaskHandle();
+    ulTaskNotifyTake(pdTRUE, 0);
+
+    i2s_dma_init();
+
+    iomux_set_function(gpio_to_iomux(12), IOMUX_GPIO12_FUNC_I2SI_DATA);
+    iomux_set_function(gpio_to_iomux(13), IOMUX_GPIO13_FUNC_I2SI_BCK);
+    iomux_set_function(gpio_to_iomux(14), IOMUX_GPIO14_FUNC_I2SI_WS);
+
+    I2S.FIFO_CONF = SET_FIELD(I2S.FIFO_CONF, I2S_FIFO_CONF_RX_FIFO_MOD, bits == 16 ? 0 : 2);
+    I2S.CONF_CHANNELS = SET_FIELD(I2S.CONF_CHANNELS, I2S_CONF_CHANNELS_RX_CHANNEL_MOD, 0);
+    I2S.CONF = (I2S.CONF & ~I2S_CONF_RX_SLAVE_MOD) | I2S_CONF_RX_MSB_SHIFT;
+    /* An EOF (and so a descriptor done) every block, in words */
+    I2S.RX_EOF_NUM = block_bytes / 4;
+    uint32_t rate = i2s_set_clock(sample_rate, bits);
+
+    i2s_set_in_handler(rx_done);
+    SLC.TX_LINK |= SLC_TX_LINK_STOP;
+    SLC.TX_LINK = SET_FIELD(SLC.TX_LINK & ~SLC_TX_LINK_STOP, SLC_TX_LINK_DESCRIPTOR_ADDR,
+                            (uint32_t)ring.desc & SLC_TX_LINK_DESCRIPTOR_ADDR_M);
+    SLC.TX_LINK |= SLC_TX_LINK_START;
+    I2S.CONF |= I2S_CONF_RX_START;
+    return rate;
+}
+
+void i2s_rx_stop(void)
+{
+    if (!ring.desc)
+        return;
+    I2S.CONF &= ~I2S_CONF_RX_START;
+    SLC.TX_LINK |= SLC_TX_LINK_STOP;
+    i2s_set_in_handler(NULL);
+    i2s_ring_free(&ring);
+}
+
+const void *i2s_rx_read(uint32_t timeout_ticks)
+{
+    /* Was the block given out last time overwritten while it was out? */
+    if (holding && filled - held >= ring.count)
+        stats.overruns++;
+    holding = false;
+
+    while (filled == taken) {
+        if (!ulTaskNotifyTake(pdTRUE, timeout_ticks))
+            return NULL;
+    }
+
+    uint32_t f = filled;
+    if (f - taken >= ring.count) {
+        /* Lapped: skip to the oldest block still whole */
+        stats.overruns += f - taken - (ring.count - 1);
+        taken = f - (ring.count - 1);
+    }
+    held = taken++;
+    holding = true;
+    return i2s_ring_block(&ring, held % ring.count);
+}
+
+void i2s_rx_stats(i2s_rx_stats_t *out)
+{
+    *out = stats;
+}
@@ -0,0 +1,134 @@
+/* I2S transmit by SLC DMA, see i2s_dma.h
+ *
+ * Blocks are numbered in the order they're played, block n being
+ * ring index n % count. 'done' is the number of the block the DMA is
+ * playing and 'written' the one the writer is filling; the writer may
+ * fill blocks done + 1 to done + count - 1, the ones the DMA has played
+ * (and the interrupt zeroed) and isn't back to yet. 'done' is only
+ * written by the interrupt and 'written' only by the writer.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "i2s_dma.h"
+#include "i2s_ring.h"
+
+#include <string.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <esp/i2s_regs.h>
+#include <esp/iomux.h>
+#include <common_macros.h>
+
+static i2s_ring_t ring;
+static volatile uint32_t done, written;
+static size_t wpos;             /* bytes into block 'written' */
+static volatile xTaskHandle writer;
+static i2s_tx_stats_t stats;
+
+static void IRAM tx_done(void)
+{
+    size_t n = i2s_ring_finished(&ring, SLC.RX_EOF_DESCRIPTOR_ADDR);
+    uint32_t d = done;
+
+    for (size_t i = 0; i < n; i++) {
+        /* Silence, until it's written again */
+        memset(i2s_ring_block(&ring, d % ring.count), 0, ring.block);
+        d++;
+        /* Block d has started, was it ready? (Not counted until the
+           first block is written) */
+        if (written <= d && written > 1)
+            stats.underruns++;
+    }
+    done = d;
+    stats.blocks += n;
+
+    if (n && writer) {
+        portBASE_TYPE woken = pdFALSE;
+        vTaskNotifyGiveFromISR(writer, &woken);
+        if (woken)
+            portYIELD();
+    }
+}
+
+uint32_t i2s_tx_start(uint32_t sample_rate, uint8_t bits, size_t blocks, size_t block_bytes)
+{
+    if (!i2s_ring_config_ok(bits, blocks, block_bytes))
+        return 0;
+
+    i2s_tx_stop();
+    if (!i2s_ring_alloc(&ring, blocks, block_bytes))
+        return 0;
+    done = 0;
+    written = 1;
+    wpos = 0;
+    stats = (i2s_tx_stats_t){ 0 };
+
+    i2s_dma_init();
+
+    iomux_set_function(gpio_to_iomux(3), IOMUX_GPIO3_FUNC_I2SO_DATA);
+    iomux_set_function(gpio_to_iomux(15), IOMUX_GPIO15_FUNC_I2SO_BCK);
+    iomux_set_function(gpio_to_iomux(2), IOMUX_GPIO2_FUNC_I2SO_WS);
+
+    /* Stereo: 16 bit samples two to a word, 24 bit ones a word each */
+    I2S.FIFO_CONF = SET_FIELD(I2S.FIFO_CONF, I2S_FIFO_CONF_TX_FIFO_MOD, bits == 16 ? 0 : 2);
+    I2S.CONF_CHANNELS = SET_FIELD(I2S.CONF_CHANNELS, I2S_CONF_CHANNELS_TX_CHANNEL_MOD, 0);
+    I2S.CONF = (I2S.CONF & ~I2S_CONF_TX_SLAVE_MOD) | I2S_CONF_TX_MSB_SHIFT;
+    uint32_t rate = i2s_set_clock(sample_rate, bits);
+
+    i2s_set_out_handler(tx_done);
+    SLC.RX_LINK |= SLC_RX_LINK_STOP;
+    SLC.RX_LINK = SET_FIELD(SLC.RX_LINK & ~SLC_RX_LINK_STOP, SLC_RX_LINK_DESCRIPTOR_ADDR,
+                            (uint32_t)ring.desc & SLC_RX_LINK_DESCRIPTOR_ADDR_M);
+    SLC.RX_LINK |= SLC_RX_LINK_START;
+    I2S.CONF |= I2S_CONF_TX_START;
+    return rate;
+}
+
+void i2s_tx_stop(void)
+{
+    if (!ring.desc)
+        return;
+    I2S.CONF &= ~I2S_CONF_TX_START;
+    SLC.RX_LINK |= SLC_RX_LINK_STOP;
+    i2s_set_out_handler(NULL);
+    i2s_ring_free(&ring);
+}
+
+size_t i2s_tx_write(const void *data, size_t len, uint32_t timeout_ticks)
+{
+    const uint8_t *src = data;
+    size_t copied = 0;
+
+    writer = xTaskGetCurrentTaskHandle();
+    while (copied < len) {
+        uint32_t d = done;
+        if (written <= d) {
+            /* Fell behind, this block has been played already */
+            written = d + 1;
+            wpos = 0;
+        }
+        if (written - d >= ring.count) {
+            if (!ulTaskNotifyTake(pdTRUE, timeout_ticks))
+                break;
+            continue;
+        }
+        size_t n = len - copied;
+        if (n > ring.block - wpos)
+            n = ring.block - wpos;
+        memcpy(i2s_ring_block(&ring, written % ring.count) + wpos, src + copied, n);
+        copied += n;
+        wpos += n;
+        if (wpos == ring.block) {
+            wpos = 0;
+            written++;
+        }
+    }
+    return copied;
+}
+
+void i2s_tx_stats(i2s_tx_stats_t *out)
+{
+    *out = stats;
+}
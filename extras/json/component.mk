@@ -0,0 +1,11 @@
+# Component makefile for extras/json
+#
+# json_writer_init_cork() also needs extras/netcork in EXTRA_COMPONENTS.
+
+# expected anyone using json includes it as 'json/json_parser.h'
+INC_DIRS += $(json_ROOT)..
+
+# args for passing into compile rule generation
+json_SRC_DIR =  $(json_ROOT)
+
+$(eval $(call component_compile_rules,json))
@@ -0,0 +1,461 @@
+/* Streaming JSON parser, see json_parser.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "json_parser.h"
+
+#include <string.h>
+
+#include <lwip/pbuf.h>
+#include <lwip/netbuf.h>
+
+enum {
+    S_VALUE,            /* a value, at the top level or after ':' or ',' */
+    S_VALUE_OR_END,     /* after '[' */
+    S_KEY_OR_END,       /* after '{' */
+    S_KEY,              /* after ',' in an object */
+    S_COLON,
+    S_NEXT,             /* ',' or the end of the object or array */
+    S_DONE,             /* after a top level value */
+    S_STRING,
+    S_ESCAPE,
+    S_UNICODE,
+    S_NUMBER,
+    S_LITERAL,
+    S_ERROR,
+};
+
+/* Number states, in jp->sub */
+enum {
+    N_MINUS,            /* needs a digit */
+    N_ZERO,             /* leading 0, no more digits */
+    N_INT,
+    N_DOT,              /* needs a digit */
+    N_FRAC,
+    N_E,                /* sign or digit */
+    N_E_SIGN,           /* needs a digit */
+    N_EXP,
+};
+
+static const char *const literals[] = { "true", "false", "null" };
+static const json_event_t literal_events[] = { JSON_TRUE, JSON_FALSE, JSON_NULL };
+
+#define IS_SPACE(c) ((c) == ' ' || (c) == '\t' || (c) == '\n' || (c) == '\r')
+#define IS_DIGIT(c) ((c) >= '0' && (c) <= '9')
+#define IN_OBJECT(jp) ((jp)->depth && ((jp)->objects & (1u << ((jp)->depth - 1))))
+
+void json_parser_init(json_parser_t *jp, json_parser_cb_t cb, void *arg)
+{
+    memset(jp, 0, sizeof(*jp));
+    jp->cb = cb;
+    jp->arg = arg;
+    jp->state = S_VALUE;
+}
+
+static int fail(json_parser_t *jp, int err)
+{
+    jp->state = S_ERROR;
+    jp->err = err;
+    return err;
+}
+
+static int emit(json_parser_t *jp, json_event_t event, const char *value, size_t len)
+{
+    bool ok = jp->cb(jp, event, value, len);
+    jp->truncated = false;
+    return ok ? JSON_PARSER_OK : fail(jp, JSON_PARSER_ERR_ABORTED);
+}
+
+static void value_done(json_parser_t *jp)
+{
+    jp->state = jp->depth ? S_NEXT : S_DONE;
+}
+
+/* Append 'n' bytes of one character to the string, if they all fit */
+static void put(json_parser_t *jp, const char *c, int n)
+{
+    char *buf = jp->in_key ? jp->key : jp->buf;
+    size_t size = jp->in_key ? sizeof(jp->key) : sizeof(jp->buf);
+
+    if (jp->len + n >= size) {
+        jp->truncated = true;
+        return;
+    }
+    memcpy(buf + jp->len, c, n);
+    jp->len += n;
+}
+
+static void put_utf8(json_parser_t *jp, uint32_t cp)
+{
+    char c[4];
+    int n;
+
+    if (cp < 0x80) {
+        c[0] = cp;
+        n = 1;
+    } else if (cp < 0x800) {
+        c[0] = 0xc0 | (cp >> 6);
+        c[1] = 0x80 | (cp & 0x3f);
+        n = 2;
+    } else if (cp < 0x10000) {
+        c[0] = 0xe0 | (cp >> 12);
+        c[1] = 0x80 | ((cp >> 6) & 0x3f);
+        c[2] = 0x80 | (cp & 0x3f);
+        n = 3;
+    } else {
+        c[0] = 0xf0 | (cp >> 18);
+        c[1] = 0x80 | ((cp >> 12) & 0x3f);
+        c[2] = 0x80 | ((cp >> 6) & 0x3f);
+        c[3] = 0x80 | (cp & 0x3f);
+        n = 4;
+    }
+    put(jp, c, n);
+}
+
+/* A high surrogate not followed by its low half becomes U+FFFD */
+static void lone_surrogate(json_parser_t *jp)
+{
+    if (jp->surrogate) {
+        put_utf8(jp, 0xfffd);
+        jp->surrogate = 0;
+    }
+}
+
+static void unicode_escape(json_parser_t *jp, uint16_t u)
+{
+    if (u >= 0xd800 && u < 0xdc00) {
+        lone_surrogate(jp);
+        jp->surrogate = u;
+    } else if (u >= 0xdc00 && u < 0xe000) {
+        if (jp->surrogate)
+            put_utf8(jp, 0x10000 + ((uint32_t)(jp->surrogate - 0xd800) << 10) + (u - 0xdc00));
+        else
+            put_utf8(jp, 0xfffd);
+        jp->surrogate = 0;
+    } else {
+        lone_surrogate(jp);
+        put_utf8(jp, u);
+    }
+}
+
+static int string_done(json_parser_t *jp)
+{
+    int err;
+
+    lone_surrogate(jp);
+    if (jp->in_key) {
+        jp->key[jp->len] = 0;
+        err = emit(jp, JSON_KEY, jp->key, jp->len);
+        jp->state = S_COLON;
+    } else {
+        jp->buf[jp->len] = 0;
+        err = emit(jp, JSON_STRING, jp->buf, jp->len);
+        value_done(jp);
+    }
+    return err;
+}
+
+static int open_container(json_parser_t *jp, bool object)
+{
+    if (jp->depth == JSON_PARSER_MAX_DEPTH)
+        return fail(jp, JSON_PARSER_ERR_DEPTH);
+    int err = emit(jp, object ? JSON_OBJECT_START : JSON_ARRAY_START, NULL, 0);
+    if (object)
+        jp->objects |= 1u << jp->depth;
+    else
+        jp->objects &= ~(1u << jp->depth);
+    jp->depth++;
+    if (err == JSON_PARSER_OK)
+        jp->state = object ? S_KEY_OR_END : S_VALUE_OR_END;
+    return err;
+}
+
+static int close_container(json_parser_t *jp, bool object)
+{
+    if (!jp->depth || IN_OBJECT(jp) != object)
+        return fail(jp, JSON_PARSER_ERR_SYNTAX);
+    jp->depth--;
+    int err = emit(jp, object ? JSON_OBJECT_END : JSON_ARRAY_END, NULL, 0);
+    if (err == JSON_PARSER_OK)
+        value_done(jp);
+    return err;
+}
+
+/* The start of a value */
+static int value(json_parser_t *jp, char c)
+{
+    switch (c) {
+    case '{':
+        return open_container(jp, true);
+    case '[':
+        return open_container(jp, false);
+    case '"':
+        jp->state = S_STRING;
+        jp->in_key = false;
+        jp->len = 0;
+        return JSON_PARSER_OK;
+    case 't':
+    case 'f':
+    case 'n':
+        jp->state = S_LITERAL;
+        jp->buf[0] = c == 't' ? 0 : c == 'f' ? 1 : 2;
+        jp->sub = 1;
+        return JSON_PARSER_OK;
+    }
+    if (c == '-' || IS_DIGIT(c)) {
+        jp->state = S_NUMBER;
+        jp->sub = c == '-' ? N_MINUS : c == '0' ? N_ZERO : N_INT;
+        jp->buf[0] = c;
+        jp->len = 1;
+        return JSON_PARSER_OK;
+    }
+    return fail(jp, JSON_PARSER_ERR_SYNTAX);
+}
+
+static int key(json_parser_t *jp, char c)
+{
+    if (c != '"')
+        return fail(jp, JSON_PARSER_ERR_SYNTAX);
+    jp->state = S_STRING;
+    jp->in_key = true;
+    jp->len = 0;
+    return JSON_PARSER_OK;
+}
+
+/* The next character of a number, or false if it doesn't continue it */
+static bool number_char(json_parser_t *jp, char c)
+{
+    uint8_t next;
+
+    switch (jp->sub) {
+    case N_MINUS:
+        if (!IS_DIGIT(c))
+            return false;
+        next = c == '0' ? N_ZERO : N_INT;
+        break;
+    case N_ZERO:
+    case N_INT:
+        if (IS_DIGIT(c) && jp->sub == N_INT)
+            next = N_INT;
+        else if (c == '.')
+            next = N_DOT;
+        else if (c == 'e' || c == 'E')
+            next = N_E;
+        else
+            return false;
+        break;
+    case N_DOT:
+    case N_FRAC:
+        if (IS_DIGIT(c))
+            next = N_FRAC;
+        else if ((c == 'e' || c == 'E') && jp->sub == N_FRAC)
+            next = N_E;
+        else
+            return false;
+        break;
+    case N_E:
+        if (c == '+' || c == '-') {
+            next = N_E_SIGN;
+            break;
+        }
+        /* fall through */
+    case N_E_SIGN:
+    case N_EXP:
+        if (!IS_DIGIT(c))
+            return false;
+        next = N_EXP;
+        break;
+    default:
+        return false;
+    }
+    jp->sub = next;
+    return true;
+}
+
+static int number_done(json_parser_t *jp)
+{
+    if (jp->sub != N_ZERO && jp->sub != N_INT && jp->sub != N_FRAC && jp->sub != N_EXP)
+        return fail(jp, JSON_PARSER_ERR_SYNTAX);
+    jp->buf[jp->len] = 0;
+    int err = emit(jp, JSON_NUMBER, jp->buf, jp->len);
+    if (err == JSON_PARSER_OK)
+        value_done(jp);
+    return err;
+}
+
+static int hex_digit(char c)
+{
+    if (IS_DIGIT(c))
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+int json_parser_feed(json_parser_t *jp, const void *data, size_t len)
+{
+    const char *p = data;
+    int err = JSON_PARSER_OK;
+
+    if (jp->state == S_ERROR)
+        return jp->err;
+
+    for (size_t i = 0; i < len && err == JSON_PARSER_OK; i++) {
+        char c = p[i];
+
+        switch (jp->state) {
+        case S_STRING:
+            if (c == '"') {
+                err = string_done(jp);
+            } else if (c == '\\') {
+                jp->state = S_ESCAPE;
+            } else if ((uint8_t)c < 0x20) {
+                err = fail(jp, JSON_PARSER_ERR_SYNTAX);
+            } else {
+                lone_surrogate(jp);
+                put(jp, &c, 1);
+            }
+            break;
+
+        case S_ESCAPE: {
+            static const char from[] = "\"\\/bfnrt", to[] = "\"\\/\b\f\n\r\t";
+            const char *e = c ? strchr(from, c) : NULL;
+            if (c == 'u') {
+                jp->state = S_UNICODE;
+                jp->sub = 0;
+                jp->ucs = 0;
+            } else if (e) {
+                lone_surrogate(jp);
+                put(jp, &to[e - from], 1);
+                jp->state = S_STRING;
+            } else {
+                err = fail(jp, JSON_PARSER_ERR_SYNTAX);
+            }
+            break;
+        }
+
+        case S_UNICODE: {
+            int h = hex_digit(c);
+            if (h < 0) {
+                err = fail(jp, JSON_PARSER_ERR_SYNTAX);
+                break;
+            }
+            jp->ucs = (jp->ucs << 4) | h;
+            if (++jp->sub == 4) {
+                unicode_escape(jp, jp->ucs);
+                jp->state = S_STRING;
+            }
+            break;
+        }
+
+        case S_NUMBER:
+            if (number_char(jp, c)) {
+                if (jp->len == sizeof(jp->buf) - 1)
+                    err = fail(jp, JSON_PARSER_ERR_NUMBER);
+                else
+                    jp->buf[jp->len++] = c;
+                break;
+            }
+            err = number_done(jp);
+            i--;    /* and look at 'c' again, whatever follows the number */
+            break;
+
+        case S_LITERAL: {
+            const char *lit = literals[(uint8_t)jp->buf[0]];
+            if (c != lit[jp->sub]) {
+                err = fail(jp, JSON_PARSER_ERR_SYNTAX);
+            } else if (!lit[++jp->sub]) {
+                err = emit(jp, literal_events[(uint8_t)jp->buf[0]], NULL, 0);
+                if (err == JSON_PARSER_OK)
+                    value_done(jp);
+            }
+            break;
+        }
+
+        default:
+            if (IS_SPACE(c))
+                break;
+            switch (jp->state) {
+            case S_VALUE:
+            case S_DONE:
+                err = value(jp, c);
+                break;
+            case S_VALUE_OR_END:
+                err = c == ']' ? close_container(jp, false) : value(jp, c);
+                break;
+            case S_KEY_OR_END:
+                err = c == '}' ? close_container(jp, true) : key(jp, c);
+                break;
+            case S_KEY:
+                err = key(jp, c);
+                break;
+            case S_COLON:
+                if (c == ':')
+                    jp->state = S_VALUE;
+                else
+                    err = fail(jp, JSON_PARSER_ERR_SYNTAX);
+                break;
+            case S_NEXT:
+                if (c == ',')
+                    jp->state = IN_OBJECT(jp) ? S_KEY : S_VALUE;
+                else if (c == '}' || c == ']')
+                    err = close_container(jp, c == '}');
+                else
+                    err = fail(jp, JSON_PARSER_ERR_SYNTAX);
+                break;
+            }
+            break;
+        }
+        if (err)
+            jp->offset += i;
+    }
+    if (err == JSON_PARSER_OK)
+        jp->offset += len;
+    return err;
+}
+
+int json_parser_feed_pbuf(json_parser_t *jp, const struct pbuf *p)
+{
+    int err = JSON_PARSER_OK;
+
+    for (; p && err == JSON_PARSER_OK; p = p->next)
+        err = json_parser_feed(jp, p->payload, p->len);
+    return err;
+}
+
+int json_parser_feed_netbuf(json_parser_t *jp, struct netbuf *nb)
+{
+    int err = JSON_PARSER_OK;
+    void *data;
+    u16_t len;
+
+    netbuf_first(nb);
+    do {
+        netbuf_data(nb, &data, &len);
+        err = json_parser_feed(jp, data, len);
+    } while (err == JSON_PARSER_OK && netbuf_next(nb) >= 0);
+    return err;
+}
+
+int json_parser_finish(json_parser_t *jp)
+{
+    if (jp->state == S_ERROR)
+        return jp->err;
+    if (jp->state == S_NUMBER && jp->depth == 0) {
+        int err = number_done(jp);
+        if (err != JSON_PARSER_OK)
+            return err;
+    }
+    if (jp->state != S_DONE)
+        return fail(jp, JSON_PARSER_ERR_INCOMPLETE);
+    return JSON_PARSER_OK;
+}
+
+bool json_parser_done(const json_parser_t *jp)
+{
+    return jp->state == S_DONE;
+}
@@ -0,0 +1,138 @@
+/* Streaming (SAX style) JSON parser
+ *
+ * Parses JSON as it arrives, a piece at a time, without building a tree
+ * or allocating anything: the whole state, a key and a value buffer
+ * included, is the json_parser_t. Each object and array start and end,
+ * key and value is passed to a callback as soon as it's complete, and
+ * the pieces of input can split anywhere, in the middle of a string or
+ * a number. json_parser_feed_pbuf() and json_parser_feed_netbuf() run
+ * straight over the segments of a pbuf chain or a netbuf, so a message
+ * received in several segments isn't reassembled first.
+ *
+ *   static bool on_event(json_parser_t *jp, json_event_t ev, const char *value, size_t len)
+ *   {
+ *       if (ev == JSON_NUMBER && jp->depth == 1 && !strcmp(jp->key, "interval"))
+ *           interval = atoi(value);
+ *       return true;
+ *   }
+ *
+ *   json_parser_t jp;
+ *   json_parser_init(&jp, on_event, NULL);
+ *   while (netconn_recv(conn, &nb) == ERR_OK && !json_parser_done(&jp)) {
+ *       json_parser_feed_netbuf(&jp, nb);
+ *       netbuf_delete(nb);
+ *   }
+ *
+ * Strings (keys and values) are unescaped, \u escapes included (as
+ * UTF-8), and NUL terminated. One longer than JSON_PARSER_MAX_STRING - 1
+ * bytes (JSON_PARSER_MAX_KEY - 1 for keys) is cut short, and the parser's
+ * 'truncated' flag set for that event. Numbers are passed as their text,
+ * for atoi() or strtod(), and one that doesn't fit is an error.
+ *
+ * After a complete top level value the parser accepts another, so a
+ * stream of values (newline delimited JSON, say) can go through one
+ * parser. A top level number has no end until something follows it, or
+ * json_parser_finish() is called at the end of input.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _JSON_PARSER_H
+#define _JSON_PARSER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifndef JSON_PARSER_MAX_KEY
+#define JSON_PARSER_MAX_KEY 32
+#endif
+
+/* Longest string or number value, NUL included */
+#ifndef JSON_PARSER_MAX_STRING
+#define JSON_PARSER_MAX_STRING 64
+#endif
+
+/* Deepest nesting of objects and arrays */
+#define JSON_PARSER_MAX_DEPTH 32
+
+typedef enum {
+    JSON_OBJECT_START,
+    JSON_OBJECT_END,
+    JSON_ARRAY_START,
+    JSON_ARRAY_END,
+    JSON_KEY,
+    JSON_STRING,
+    JSON_NUMBER,
+    JSON_TRUE,
+    JSON_FALSE,
+    JSON_NULL,
+} json_event_t;
+
+/* json_parser_feed() and json_parser_finish() results */
+#define JSON_PARSER_OK 0
+#define JSON_PARSER_ERR_SYNTAX -1
+#define JSON_PARSER_ERR_DEPTH -2     /* nested more than JSON_PARSER_MAX_DEPTH */
+#define JSON_PARSER_ERR_NUMBER -3    /* number longer than JSON_PARSER_MAX_STRING - 1 */
+#define JSON_PARSER_ERR_ABORTED -4   /* the callback returned false */
+#define JSON_PARSER_ERR_INCOMPLETE -5 /* json_parser_finish() inside a value */
+
+typedef struct json_parser json_parser_t;
+
+/* Called for each event. 'value' is the text of a key, string or number
+   (NUL terminated, 'len' bytes), NULL for the others. Inside an object
+   jp->key is the key of the current member, for the value and for the
+   start of an object or array member. jp->depth is the nesting of the
+   event: an object's members are one deeper than its start and end.
+   Return false to stop parsing. */
+typedef bool (*json_parser_cb_t)(json_parser_t *jp, json_event_t event, const char *value, size_t len);
+
+struct json_parser {
+    json_parser_cb_t cb;
+    void *arg;              /* for the callback's use */
+    uint8_t depth;
+    bool truncated;         /* the string of this event was cut short */
+    int8_t err;
+    uint8_t state;
+    uint8_t sub;            /* position in a literal, escape or number */
+    bool in_key;
+    uint16_t ucs;           /* \u escape so far */
+    uint16_t surrogate;     /* high surrogate waiting for its pair */
+    uint32_t objects;       /* bit n set if level n+1 is an object */
+    uint32_t offset;        /* bytes of input consumed */
+    uint16_t len;
+    char key[JSON_PARSER_MAX_KEY];
+    char buf[JSON_PARSER_MAX_STRING];
+};
+
+void json_parser_init(json_parser_t *jp, json_parser_cb_t cb, void *arg);
+
+/* Parse the next 'len' bytes of input. Returns JSON_PARSER_OK or an
+   error, after which the parser stays in error (jp->offset is where)
+   until json_parser_init() again. */
+int json_parser_feed(json_parser_t *jp, const void *data, size_t len);
+
+/* The same, for each segment of a pbuf chain or a netbuf in turn */
+struct pbuf;
+struct netbuf;
+int json_parser_feed_pbuf(json_parser_t *jp, const struct pbuf *p);
+int json_parser_feed_netbuf(json_parser_t *jp, struct netbuf *nb);
+
+/* End of input: finishes a top level number. Returns
+   JSON_PARSER_ERR_INCOMPLETE if input stopped inside a value. */
+int json_parser_finish(json_parser_t *jp);
+
+/* True once a complete top level value has been parsed, and nothing but
+   whitespace since */
+bool json_parser_done(const json_parser_t *jp);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _JSON_PARSER_H */
@@ -0,0 +1,236 @@
+/* Streaming JSON serializer, see json_writer.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "json_writer.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+void json_writer_init(json_writer_t *jw, json_write_fn_t write, void *ctx)
+{
+    memset(jw, 0, sizeof(*jw));
+    jw->write = write;
+    jw->ctx = ctx;
+}
+
+static void out(json_writer_t *jw, const void *data, size_t len)
+{
+    if (jw->err == ERR_OK && len)
+        jw->err = jw->write(jw->ctx, data, len);
+}
+
+/* The comma before a key or value, if it isn't the first in its object
+   or array */
+static void separate(json_writer_t *jw)
+{
+    if (jw->after_key) {
+        jw->after_key = false;
+        return;
+    }
+    if (!jw->depth)
+        return;
+    uint32_t bit = 1 << (jw->depth - 1);
+    if (jw->nonempty & bit)
+        out(jw, ",", 1);
+    jw->nonempty |= bit;
+}
+
+static void start(json_writer_t *jw, char c)
+{
+    separate(jw);
+    if (jw->depth == JSON_WRITER_MAX_DEPTH) {
+        if (jw->err == ERR_OK)
+            jw->err = ERR_VAL;
+        return;
+    }
+    out(jw, &c, 1);
+    jw->nonempty &= ~(1 << jw->depth);
+    jw->depth++;
+}
+
+static void end(json_writer_t *jw, char c)
+{
+    if (!jw->depth) {
+        if (jw->err == ERR_OK)
+            jw->err = ERR_VAL;
+        return;
+    }
+    jw->depth--;
+    jw->after_key = false;
+    out(jw, &c, 1);
+}
+
+void json_write_object_start(json_writer_t *jw)
+{
+    start(jw, '{');
+}
+
+void json_write_object_end(json_writer_t *jw)
+{
+    end(jw, '}');
+}
+
+void json_write_array_start(json_writer_t *jw)
+{
+    start(jw, '[');
+}
+
+void json_write_array_end(json_writer_t *jw)
+{
+    end(jw, ']');
+}
+
+/* Quoted and escaped, unescaped runs written in one piece */
+static void quoted(json_writer_t *jw, const char *s, size_t len)
+{
+    static const char hex[] = "0123456789abcdef";
+    size_t run = 0;
+
+    out(jw, "\"", 1);
+    for (size_t i = 0; i < len; i++) {
+        uint8_t c = s[i];
+        char esc[6] = { '\\', 0 };
+        int n = 2;
+
+        switch (c) {
+        case '"':  esc[1] = '"';  break;
+        case '\\': esc[1] = '\\'; break;
+        case '\n': esc[1] = 'n';  break;
+        case '\r': esc[1] = 'r';  break;
+        case '\t': esc[1] = 't';  break;
+        case '\b': esc[1] = 'b';  break;
+        case '\f': esc[1] = 'f';  break;
+        default:
+            if (c >= 0x20)
+                continue;
+            memcpy(esc + 1, "u00", 3);
+            esc[4] = hex[c >> 4];
+            esc[5] = hex[c & 15];
+            n = 6;
+        }
+        out(jw, s + run, i - run);
+        out(jw, esc, n);
+        run = i + 1;
+    }
+    out(jw, s + run, len - run);
+    out(jw, "\"", 1);
+}
+
+void json_write_key(json_writer_t *jw, const char *key)
+{
+    separate(jw);
+    quoted(jw, key, strlen(key));
+    out(jw, ":", 1);
+    jw->after_key = true;
+}
+
+void json_write_string_len(json_writer_t *jw, const char *s, size_t len)
+{
+    separate(jw);
+    quoted(jw, s, len);
+}
+
+void json_write_string(json_writer_t *jw, const char *s)
+{
+    json_write_string_len(jw, s, strlen(s));
+}
+
+/* The digits of 'value', at least 'min_digits' of them, ending at 'end' */
+static char *digits(char *end, uint64_t value, int min_digits)
+{
+    char *p = end;
+    do {
+        *--p = '0' + value % 10;
+        value /= 10;
+    } while (value || end - p < min_digits);
+    return p;
+}
+
+static void fixed(json_writer_t *jw, bool negative, uint64_t magnitude, int decimals)
+{
+    char buf[24];
+    char *end = buf + sizeof(buf);
+    char *p;
+
+    if (decimals > 0) {
+        uint64_t scale = 1;
+        for (int i = 0; i < decimals; i++)
+            scale *= 10;
+        p = digits(end, magnitude % scale, decimals);
+        *--p = '.';
+        p = digits(p, magnitude / scale, 1);
+    } else {
+        p = digits(end, magnitude, 1);
+    }
+    if (negative)
+        *--p = '-';
+    separate(jw);
+    out(jw, p, end - p);
+}
+
+void json_write_int(json_writer_t *jw, int32_t value)
+{
+    json_write_fixed(jw, value, 0);
+}
+
+void json_write_uint(json_writer_t *jw, uint32_t value)
+{
+    fixed(jw, false, value, 0);
+}
+
+void json_write_fixed(json_writer_t *jw, int32_t value, int decimals)
+{
+    if (decimals > 9)
+        decimals = 9;
+    fixed(jw, value < 0, value < 0 ? -(int64_t)value : value, decimals);
+}
+
+void json_write_float(json_writer_t *jw, float value, int decimals)
+{
+    if (isnan(value) || isinf(value)) {
+        json_write_null(jw);
+        return;
+    }
+    if (decimals < 0)
+        decimals = 0;
+    if (decimals > 9)
+        decimals = 9;
+    double scaled = fabs((double)value);
+    for (int i = 0; i < decimals; i++)
+        scaled *= 10;
+    if (scaled < 1e18) {
+        uint64_t magnitude = scaled + 0.5;
+        fixed(jw, value < 0 && magnitude, magnitude, decimals);
+    } else {
+        /* too big for the integer digits, rare enough for printf */
+        char buf[24];
+        int n = snprintf(buf, sizeof(buf), "%.*e", decimals, (double)value);
+        separate(jw);
+        out(jw, buf, n < sizeof(buf) ? n : sizeof(buf) - 1);
+    }
+}
+
+void json_write_bool(json_writer_t *jw, bool value)
+{
+    separate(jw);
+    if (value)
+        out(jw, "true", 4);
+    else
+        out(jw, "false", 5);
+}
+
+void json_write_null(json_writer_t *jw)
+{
+    separate(jw);
+    out(jw, "null", 4);
+}
+
+void json_write_raw(json_writer_t *jw, const char *json, size_t len)
+{
+    separate(jw);
+    out(jw, json, len);
+}
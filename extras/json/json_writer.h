@@ -0,0 +1,100 @@
+/* Streaming JSON serializer
+ *
+ * Writes JSON straight to an output as it's generated, with no buffer
+ * or tree of its own: each call writes its piece (with the comma and
+ * escaping it needs) through a write function, which can be a netcork
+ * (json_writer_init_cork()) so a message of many small pieces goes out
+ * in full TCP segments with no copy in between.
+ *
+ *   json_writer_t jw;
+ *   json_writer_init_cork(&jw, &cork);
+ *   json_write_object_start(&jw);
+ *   json_write_key(&jw, "uptime");
+ *   json_write_uint(&jw, xTaskGetTickCount() / configTICK_RATE_HZ);
+ *   json_write_key(&jw, "temp");
+ *   json_write_fixed(&jw, temp_tenths, 1);   // 21.5
+ *   json_write_object_end(&jw);
+ *   err = json_writer_error(&jw);
+ *
+ * The first error from the write function sticks: later calls do
+ * nothing, and json_writer_error() returns it. Only the balance of
+ * starts and ends is checked (ERR_VAL), not that keys and values
+ * alternate.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _JSON_WRITER_H
+#define _JSON_WRITER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <lwip/err.h>
+
+#include "netcork/netcork.h"
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#define JSON_WRITER_MAX_DEPTH 32
+
+typedef err_t (*json_write_fn_t)(void *ctx, const void *data, size_t len);
+
+typedef struct {
+    json_write_fn_t write;
+    void *ctx;
+    err_t err;
+    uint8_t depth;
+    bool after_key;         /* the next value follows a key, no comma */
+    uint32_t nonempty;      /* bit n set if level n+1 has something in it */
+} json_writer_t;
+
+void json_writer_init(json_writer_t *jw, json_write_fn_t write, void *ctx);
+
+/* Write through netcork_write() (extras/netcork) */
+void json_writer_init_cork(json_writer_t *jw, netcork_t *cork);
+
+/* ERR_OK, or the first error writing */
+static inline err_t json_writer_error(const json_writer_t *jw)
+{
+    return jw->err;
+}
+
+void json_write_object_start(json_writer_t *jw);
+void json_write_object_end(json_writer_t *jw);
+void json_write_array_start(json_writer_t *jw);
+void json_write_array_end(json_writer_t *jw);
+
+/* A member's key, in an object. It's escaped like a string. */
+void json_write_key(json_writer_t *jw, const char *key);
+
+/* A string, escaped as needed. Bytes above 0x7f are written as they
+   are, so it should be UTF-8. */
+void json_write_string(json_writer_t *jw, const char *s);
+void json_write_string_len(json_writer_t *jw, const char *s, size_t len);
+
+void json_write_int(json_writer_t *jw, int32_t value);
+void json_write_uint(json_writer_t *jw, uint32_t value);
+
+/* value / 10^decimals, without floating point: (215, 1) is 21.5 */
+void json_write_fixed(json_writer_t *jw, int32_t value, int decimals);
+
+/* Rounded to 'decimals' places (up to 9). NaN and infinities, which
+   JSON doesn't have, are written as null. */
+void json_write_float(json_writer_t *jw, float value, int decimals);
+
+void json_write_bool(json_writer_t *jw, bool value);
+void json_write_null(json_writer_t *jw);
+
+/* Text that's already JSON, written as a value as it is */
+void json_write_raw(json_writer_t *jw, const char *json, size_t len);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _JSON_WRITER_H */
@@ -0,0 +1,19 @@
+/* json_writer_t output to a netcork, see json_writer.h
+ *
+ * On its own so extras/netcork is only linked in when it's used.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "json_writer.h"
+
+static err_t cork_write(void *ctx, const void *data, size_t len)
+{
+    return netcork_write(ctx, data, len);
+}
+
+void json_writer_init_cork(json_writer_t *jw, netcork_t *cork)
+{
+    json_writer_init(jw, cork_write, cork);
+}
@@ -41,6 +41,40 @@ OBJS_TLS=	debug.o				ssl_cache.o	\
 		ssl_cookie.o	ssl_srv.o	ssl_ticket.o	\
 		ssl_tls.o
 
+# Set MBEDTLS_FAST_CRYPTO = 1 in a program Makefile to build AES, GCM and
+# SHA-256 into a separate mbedtls_fast archive. ld/common.ld links the inner
+# loops from that archive into IRAM, and leaves its AES tables in DRAM
+# rather than moving them to IROM with the other mbedtls rodata. This costs
+# ~4KB of IRAM (taken from the IRAM heap) and ~9KB of DRAM, in exchange
+# for bulk TLS transfers that don't thrash the flash cache.
+MBEDTLS_FAST_CRYPTO ?= 0
+OBJS_FAST = aes.o gcm.o sha256.o
+ifeq ($(MBEDTLS_FAST_CRYPTO),1)
+OBJS_CRYPTO := $(filter-out $(OBJS_FAST),$(OBJS_CRYPTO))
+endif
+
+# Set MBEDTLS_P256_COMB = 1 in a program Makefile to load every P-256 group
+# with a precomputed table of base point multiples (see p256_comb.c), for
+# faster ECDHE key generation and ECDSA signing. Each P-256 group then
+# holds ~1.6KB of heap. The hook is a linker --wrap, which LTO=1 builds
+# don't honour.
+MBEDTLS_P256_COMB ?= 0
+ifeq ($(MBEDTLS_P256_COMB),1)
+ifeq ($(LTO),1)
+$(error MBEDTLS_P256_COMB=1 doesn't work with LTO=1)
+endif
+EXTRA_CFLAGS += -DMBEDTLS_P256_COMB
+EXTRA_LDFLAGS += -Wl,--wrap=mbedtls_ecp_group_load
+endif
+
+# Set MBEDTLS_PSK_PROFILE = 1 in a program Makefile for TLS with pre-shared
+# keys and no certificates, see include/mbedtls_psk_profile.h
+MBEDTLS_PSK_PROFILE ?= 0
+ifeq ($(MBEDTLS_PSK_PROFILE),1)
+EXTRA_CFLAGS += -DMBEDTLS_PSK_PROFILE
+OBJS_X509 =
+endif
+
 # args for passing into compile rule generation
 mbedtls_INC_DIR =
 mbedtls_SRC_DIR = $(mbedtls_ROOT)
@@ -49,8 +83,28 @@ mbedtls_EXTRA_SRC_FILES = $(patsubst %.o,$(MBEDTLS_DIR)library/%.c,$(OBJS_CRYPTO
 # depending on cipher configuration, some mbedTLS variables are unused
 mbedtls_CFLAGS = -Wno-error=unused-but-set-variable -Wno-error=unused-variable $(CFLAGS) 
 
+# The cipher, hash and bignum inner loops stay at -O2, unrolled, whatever
+# the FLAVOR (see OPT_OVERRIDES in common.mk). The rest of the handshake
+# code is run rarely enough to be built for size.
+MBEDTLS_HOT_OPT ?= -O2 -funroll-loops
+mbedtls_OPT_aes.c ?= $(MBEDTLS_HOT_OPT)
+mbedtls_OPT_gcm.c ?= $(MBEDTLS_HOT_OPT)
+mbedtls_OPT_sha1.c ?= $(MBEDTLS_HOT_OPT)
+mbedtls_OPT_sha256.c ?= $(MBEDTLS_HOT_OPT)
+mbedtls_OPT_md5.c ?= $(MBEDTLS_HOT_OPT)
+mbedtls_OPT_bignum.c ?= $(MBEDTLS_HOT_OPT)
+
 $(eval $(call component_compile_rules,mbedtls))
 
+ifeq ($(MBEDTLS_FAST_CRYPTO),1)
+mbedtls_fast_ROOT = $(mbedtls_ROOT)
+mbedtls_fast_SRC_DIR = $(MBEDTLS_DIR)library
+mbedtls_fast_SRC_FILES = $(patsubst %.o,$(MBEDTLS_DIR)library/%.c,$(OBJS_FAST))
+mbedtls_fast_CFLAGS = $(mbedtls_CFLAGS)
+mbedtls_fast_OPT ?= $(MBEDTLS_HOT_OPT)
+$(eval $(call component_compile_rules,mbedtls_fast))
+endif
+
 # Helpful error if git submodule not initialised
 $(MBEDTLS_DIR):
 	$(error "mbedtls git submodule not installed. Please run 'git submodule update --init'")
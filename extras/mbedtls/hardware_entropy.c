@@ -4,10 +4,14 @@
  *
  * Please don't rely on this too much as an entropy source, quite yet...
  *
+ * Data comes from the hwrand entropy pool if the application has
+ * started it (hwrand_pool_start()), otherwise straight from the RNG.
+ *
  * Part of esp-open-rtos
  * Copyright (C) 2015 Angus Gratton
  * BSD Licensed as described in the file LICENSE
  */
+#include <mbedtls/entropy.h>
 #include <mbedtls/entropy_poll.h>
 #include <esp/hwrand.h>
 
@@ -15,7 +19,12 @@ int mbedtls_hardware_poll( void *data,
                            unsigned char *output, size_t len, size_t *olen )
 {
     (void)(data);
+    uint32_t failures = hwrand_health_failures();
     hwrand_fill(output, len);
+    /* Repeated raw samples while filling this request, treat the
+       output as suspect (mbedtls then tries its other sources) */
+    if(hwrand_health_failures() != failures)
+        return MBEDTLS_ERR_ENTROPY_SOURCE_FAILED;
     if(olen)
         *olen = len;
     return 0;
@@ -0,0 +1,81 @@
+/* Multiply-accumulate (MULADDC) for mbedtls bignum on the ESP8266 LX106
+ *
+ * Included from our mbedtls/config.h. mbedtls/bn_mul.h only falls back to
+ * its generic C MULADDC when MULADDC_CORE isn't defined yet, so these
+ * replace it.
+ *
+ * The generic version does a 32x32->64 bit multiply, which the LX106 has
+ * no instruction for (it has MUL32 for the low half, but no MUL32_HIGH),
+ * so each limb costs a call to libgcc's __umulsidi3. Here the high half
+ * is built from four 16x16 multiplies, arranged so that none of the
+ * partial sums can carry:
+ *
+ *   mid = (al*bl >> 16) + lo16(al*bh) + lo16(ah*bl)     (< 2^18)
+ *   hi  = ah*bh + (al*bh >> 16) + (ah*bl >> 16) + (mid >> 16)
+ *   lo  = a*b                                           (mull)
+ *
+ * then c and *d are added to lo, carrying into hi. (a*b + c + d always
+ * fits in 64 bits, so hi can't overflow.)
+ *
+ * The hot bignum loops are linked into IRAM, see ld/common.ld.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Angus Gratton
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _BN_MUL_LX106_H
+#define _BN_MUL_LX106_H
+
+/* mpi_mul_hlp() has s (source), d (destination), c (carry) and b
+   (multiplier) in scope */
+#define MULADDC_INIT                                        \
+    {                                                       \
+        mbedtls_mpi_uint a_, ah_, p0_, p1_, p2_, t_;        \
+        mbedtls_mpi_uint bh_ = b >> 16;                     \
+        asm volatile (
+
+#define MULADDC_CORE                                        \
+            "l32i   %[a], %[s], 0          \n\t"            \
+            "addi   %[s], %[s], 4          \n\t"            \
+            "srli   %[ah], %[a], 16        \n\t"            \
+            "mul16u %[p1], %[a], %[bh]     \n\t"            \
+            "mul16u %[p2], %[ah], %[b]     \n\t"            \
+            "mul16u %[p0], %[a], %[b]      \n\t"            \
+            "mull   %[a], %[a], %[b]       \n\t"            \
+            "mul16u %[ah], %[ah], %[bh]    \n\t"            \
+            "srli   %[p0], %[p0], 16       \n\t"            \
+            "extui  %[t], %[p1], 0, 16     \n\t"            \
+            "add    %[p0], %[p0], %[t]     \n\t"            \
+            "extui  %[t], %[p2], 0, 16     \n\t"            \
+            "add    %[p0], %[p0], %[t]     \n\t"            \
+            "srli   %[p0], %[p0], 16       \n\t"            \
+            "add    %[ah], %[ah], %[p0]    \n\t"            \
+            "srli   %[p1], %[p1], 16       \n\t"            \
+            "add    %[ah], %[ah], %[p1]    \n\t"            \
+            "srli   %[p2], %[p2], 16       \n\t"            \
+            "add    %[ah], %[ah], %[p2]    \n\t"            \
+            "add    %[a], %[a], %[c]       \n\t"            \
+            "bgeu   %[a], %[c], 1f         \n\t"            \
+            "addi   %[ah], %[ah], 1        \n"              \
+            "1:                            \n\t"            \
+            "l32i   %[t], %[d], 0          \n\t"            \
+            "add    %[a], %[a], %[t]       \n\t"            \
+            "bgeu   %[a], %[t], 2f         \n\t"            \
+            "addi   %[ah], %[ah], 1        \n"              \
+            "2:                            \n\t"            \
+            "s32i   %[a], %[d], 0          \n\t"            \
+            "addi   %[d], %[d], 4          \n\t"            \
+            "mov    %[c], %[ah]            \n\t"
+
+#define MULADDC_STOP                                        \
+            : [s] "+r" (s), [d] "+r" (d), [c] "+r" (c),     \
+              [a] "=&r" (a_), [ah] "=&r" (ah_),             \
+              [p0] "=&r" (p0_), [p1] "=&r" (p1_),           \
+              [p2] "=&r" (p2_), [t] "=&r" (t_)              \
+            : [b] "r" (b), [bh] "r" (bh_)                   \
+            : "memory");                                    \
+        (void)a_; (void)ah_; (void)p0_;                     \
+        (void)p1_; (void)p2_; (void)t_;                     \
+    }
+
+#endif
@@ -109,8 +109,11 @@
  * Requires: MBEDTLS_PLATFORM_C
  *
  * Enable this layer to allow use of alternative memory allocators.
+ *
+ * esp-open-rtos: enabled for ssl_arena.h. Until ssl_arena_install() is
+ * called these are still calloc() and free().
  */
-//#define MBEDTLS_PLATFORM_MEMORY
+#define MBEDTLS_PLATFORM_MEMORY
 
 /**
  * \def MBEDTLS_PLATFORM_NO_STD_FUNCTIONS
@@ -2428,6 +2431,33 @@
 #include "mbedtls/target_config.h"
 #endif
 
+/* esp-open-rtos: LX106 bignum multiply-accumulate, see bn_mul_lx106.h
+   (define MBEDTLS_BN_MUL_GENERIC to compare against mbedtls' C version) */
+#if defined(MBEDTLS_HAVE_ASM) && defined(__XTENSA__) && !defined(MBEDTLS_BN_MUL_GENERIC)
+#include "bn_mul_lx106.h"
+#endif
+
+/* esp-open-rtos: precomputed P-256 base point table, see p256_comb.c
+   (set MBEDTLS_P256_COMB=1 in the program Makefile). w = 5 also speeds
+   up multiplying other points, for ~1KB more heap while it runs. */
+#if defined(MBEDTLS_P256_COMB)
+#undef MBEDTLS_ECP_WINDOW_SIZE
+#define MBEDTLS_ECP_WINDOW_SIZE 5
+#undef MBEDTLS_ECP_FIXED_POINT_OPTIM
+#define MBEDTLS_ECP_FIXED_POINT_OPTIM 1
+#endif
+
+/* esp-open-rtos: reduced RAM profile, see mbedtls_low_ram.h */
+#if defined(MBEDTLS_LOW_RAM_PROFILE)
+#include "mbedtls_low_ram.h"
+#endif
+
+/* esp-open-rtos: pre-shared key profile, see mbedtls_psk_profile.h
+   (after the low RAM profile, which it can be combined with) */
+#if defined(MBEDTLS_PSK_PROFILE)
+#include "mbedtls_psk_profile.h"
+#endif
+
 /*
  * Allow user to override any previous default.
  *
@@ -0,0 +1,105 @@
+/* Reduced RAM mbedTLS profile for esp-open-rtos
+ *
+ * Included at the end of our mbedtls/config.h when MBEDTLS_LOW_RAM_PROFILE
+ * is defined, for example in a program Makefile:
+ *
+ *   EXTRA_CFLAGS += -DMBEDTLS_LOW_RAM_PROFILE
+ *
+ * (the define has to be seen by the mbedtls component as well as the
+ * program, so use EXTRA_CFLAGS rather than PROGRAM_CFLAGS.)
+ *
+ * Each SSL context allocates an input and an output record buffer of
+ * MBEDTLS_SSL_MAX_CONTENT_LEN plus ~350 bytes of overhead, at
+ * mbedtls_ssl_setup(). This profile halves them to 2KB, for ~4.8KB per
+ * context in place of ~8.8KB, and trims the protocol versions, ciphers,
+ * key exchanges and curves down to what current TLS servers use.
+ *
+ * The mbedTLS version we use only has the one content length for both
+ * directions. Sending is always split to fit. Receiving only works if the
+ * peer keeps its records within the buffer, so clients should negotiate
+ * it with the max_fragment_length extension (RFC 6066):
+ *
+ *   mbedtls_ssl_conf_max_frag_len(&conf, MBEDTLS_LOW_RAM_MAX_FRAG_LEN);
+ *
+ * Servers which ignore the extension and send larger records will fail
+ * the connection with MBEDTLS_ERR_SSL_INVALID_RECORD. Servers built with
+ * this profile honour the extension when clients offer it.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Angus Gratton
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef MBEDTLS_LOW_RAM_H
+#define MBEDTLS_LOW_RAM_H
+
+#undef MBEDTLS_SSL_MAX_CONTENT_LEN
+#define MBEDTLS_SSL_MAX_CONTENT_LEN 2048
+/* matching max_fragment_length code, from mbedtls/ssl.h */
+#define MBEDTLS_LOW_RAM_MAX_FRAG_LEN MBEDTLS_SSL_MAX_FRAG_LEN_2048
+
+#ifndef MBEDTLS_SSL_MAX_FRAGMENT_LENGTH
+#define MBEDTLS_SSL_MAX_FRAGMENT_LENGTH
+#endif
+
+/* TLS 1.2 only, no DTLS */
+#undef MBEDTLS_SSL_PROTO_SSL3
+#undef MBEDTLS_SSL_PROTO_TLS1
+#undef MBEDTLS_SSL_PROTO_TLS1_1
+#undef MBEDTLS_SSL_PROTO_DTLS
+#undef MBEDTLS_SSL_DTLS_ANTI_REPLAY
+#undef MBEDTLS_SSL_DTLS_HELLO_VERIFY
+#undef MBEDTLS_SSL_DTLS_BADMAC_LIMIT
+#undef MBEDTLS_SSL_COOKIE_C
+/* only needed for TLS 1.0 and SSL 3 */
+#undef MBEDTLS_SSL_CBC_RECORD_SPLITTING
+#undef MBEDTLS_SSL_FALLBACK_SCSV
+#undef MBEDTLS_SSL_RENEGOTIATION
+
+/* AES only */
+#undef MBEDTLS_ARC4_C
+#undef MBEDTLS_BLOWFISH_C
+#undef MBEDTLS_CAMELLIA_C
+#undef MBEDTLS_DES_C
+#undef MBEDTLS_XTEA_C
+#undef MBEDTLS_CCM_C
+#undef MBEDTLS_CIPHER_MODE_CFB
+#undef MBEDTLS_RIPEMD160_C
+
+/* RSA, ECDHE_RSA and ECDHE_ECDSA key exchange. Finite field DHE needs
+   2KB+ bignums for no benefit over ECDHE, the PSK and static ECDH ones
+   are rarely offered. */
+#undef MBEDTLS_KEY_EXCHANGE_PSK_ENABLED
+#undef MBEDTLS_KEY_EXCHANGE_DHE_PSK_ENABLED
+#undef MBEDTLS_KEY_EXCHANGE_ECDHE_PSK_ENABLED
+#undef MBEDTLS_KEY_EXCHANGE_RSA_PSK_ENABLED
+#undef MBEDTLS_KEY_EXCHANGE_DHE_RSA_ENABLED
+#undef MBEDTLS_KEY_EXCHANGE_ECDH_ECDSA_ENABLED
+#undef MBEDTLS_KEY_EXCHANGE_ECDH_RSA_ENABLED
+#undef MBEDTLS_DHM_C
+
+/* P-256, P-384 and Curve25519 */
+#undef MBEDTLS_ECP_DP_SECP192R1_ENABLED
+#undef MBEDTLS_ECP_DP_SECP224R1_ENABLED
+#undef MBEDTLS_ECP_DP_SECP521R1_ENABLED
+#undef MBEDTLS_ECP_DP_SECP192K1_ENABLED
+#undef MBEDTLS_ECP_DP_SECP224K1_ENABLED
+#undef MBEDTLS_ECP_DP_SECP256K1_ENABLED
+#undef MBEDTLS_ECP_DP_BP256R1_ENABLED
+#undef MBEDTLS_ECP_DP_BP384R1_ENABLED
+#undef MBEDTLS_ECP_DP_BP512R1_ENABLED
+
+/* Certificate writing and requests aren't needed on-device */
+#undef MBEDTLS_X509_CRT_WRITE_C
+#undef MBEDTLS_X509_CSR_WRITE_C
+#undef MBEDTLS_X509_CSR_PARSE_C
+#undef MBEDTLS_X509_CREATE_C
+#undef MBEDTLS_PEM_WRITE_C
+
+/* Sessions are cached with ssl_session_cache.h, not the malloc based
+   ssl_cache */
+#undef MBEDTLS_SSL_CACHE_C
+
+#undef MBEDTLS_SELF_TEST
+#undef MBEDTLS_VERSION_FEATURES
+
+#endif
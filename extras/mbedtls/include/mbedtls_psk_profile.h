@@ -0,0 +1,127 @@
+/* Pre-shared key mbedTLS profile for esp-open-rtos
+ *
+ * Included at the end of our mbedtls/config.h when MBEDTLS_PSK_PROFILE
+ * is defined, which setting MBEDTLS_PSK_PROFILE=1 in a program Makefile
+ * does (see extras/mbedtls/component.mk).
+ *
+ * For devices talking to a backend that is configured alongside them,
+ * so both ends can share a key instead of authenticating with
+ * certificates. The handshake then does no RSA or ECDSA at all, and
+ * X.509, PEM, RSA and the PK layer are left out of the build. Two key
+ * exchanges are kept:
+ *
+ * - PSK: no public key operations, the handshake is a few hashes. With
+ *   AES-128-CCM or AES-128-GCM.
+ * - ECDHE-PSK: one P-256 ECDH on each side, for forward secrecy. TLS 1.2
+ *   only defines CBC suites for it (RFC 5489), so it is AES-128-CBC with
+ *   HMAC-SHA256.
+ *
+ * MBEDTLS_SSL_CIPHERSUITES prefers them in that order. A program wanting
+ * forward secrecy first can reorder them with mbedtls_ssl_conf_ciphersuites().
+ *
+ * Set the key with mbedtls_ssl_conf_psk() on a client, and with that or
+ * mbedtls_ssl_conf_psk_cb() (to look up the key for an identity) on a
+ * server, see examples/tls_server and examples/http_get_mbedtls. The
+ * profile can be combined with MBEDTLS_LOW_RAM_PROFILE.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Angus Gratton
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef MBEDTLS_PSK_PROFILE_H
+#define MBEDTLS_PSK_PROFILE_H
+
+/* PSK and ECDHE-PSK key exchange only */
+#define MBEDTLS_KEY_EXCHANGE_PSK_ENABLED
+#define MBEDTLS_KEY_EXCHANGE_ECDHE_PSK_ENABLED
+#undef MBEDTLS_KEY_EXCHANGE_DHE_PSK_ENABLED
+#undef MBEDTLS_KEY_EXCHANGE_RSA_PSK_ENABLED
+#undef MBEDTLS_KEY_EXCHANGE_RSA_ENABLED
+#undef MBEDTLS_KEY_EXCHANGE_DHE_RSA_ENABLED
+#undef MBEDTLS_KEY_EXCHANGE_ECDHE_RSA_ENABLED
+#undef MBEDTLS_KEY_EXCHANGE_ECDHE_ECDSA_ENABLED
+#undef MBEDTLS_KEY_EXCHANGE_ECDH_ECDSA_ENABLED
+#undef MBEDTLS_KEY_EXCHANGE_ECDH_RSA_ENABLED
+
+#undef MBEDTLS_SSL_CIPHERSUITES
+#define MBEDTLS_SSL_CIPHERSUITES                        \
+    MBEDTLS_TLS_PSK_WITH_AES_128_CCM,                   \
+    MBEDTLS_TLS_PSK_WITH_AES_128_GCM_SHA256,            \
+    MBEDTLS_TLS_ECDHE_PSK_WITH_AES_128_CBC_SHA256
+
+/* TLS 1.2 only, no DTLS */
+#undef MBEDTLS_SSL_PROTO_SSL3
+#undef MBEDTLS_SSL_PROTO_TLS1
+#undef MBEDTLS_SSL_PROTO_TLS1_1
+#undef MBEDTLS_SSL_PROTO_DTLS
+#undef MBEDTLS_SSL_DTLS_ANTI_REPLAY
+#undef MBEDTLS_SSL_DTLS_HELLO_VERIFY
+#undef MBEDTLS_SSL_DTLS_BADMAC_LIMIT
+#undef MBEDTLS_SSL_COOKIE_C
+#undef MBEDTLS_SSL_CBC_RECORD_SPLITTING
+#undef MBEDTLS_SSL_FALLBACK_SCSV
+#undef MBEDTLS_SSL_RENEGOTIATION
+/* needs certificates */
+#undef MBEDTLS_SSL_SERVER_NAME_INDICATION
+
+/* No certificates, so no X.509, PEM, RSA, ECDSA or PK */
+#undef MBEDTLS_X509_USE_C
+#undef MBEDTLS_X509_CRT_PARSE_C
+#undef MBEDTLS_X509_CRL_PARSE_C
+#undef MBEDTLS_X509_CSR_PARSE_C
+#undef MBEDTLS_X509_CREATE_C
+#undef MBEDTLS_X509_CRT_WRITE_C
+#undef MBEDTLS_X509_CSR_WRITE_C
+#undef MBEDTLS_X509_RSASSA_PSS_SUPPORT
+#undef MBEDTLS_X509_CHECK_KEY_USAGE
+#undef MBEDTLS_X509_CHECK_EXTENDED_KEY_USAGE
+#undef MBEDTLS_CERTS_C
+#undef MBEDTLS_PEM_PARSE_C
+#undef MBEDTLS_PEM_WRITE_C
+#undef MBEDTLS_BASE64_C
+#undef MBEDTLS_PK_C
+#undef MBEDTLS_PK_PARSE_C
+#undef MBEDTLS_PK_WRITE_C
+#undef MBEDTLS_PK_PARSE_EC_EXTENDED
+#undef MBEDTLS_PK_RSA_ALT_SUPPORT
+#undef MBEDTLS_PKCS5_C
+#undef MBEDTLS_PKCS12_C
+#undef MBEDTLS_OID_C
+#undef MBEDTLS_RSA_C
+#undef MBEDTLS_PKCS1_V15
+#undef MBEDTLS_PKCS1_V21
+#undef MBEDTLS_GENPRIME
+#undef MBEDTLS_ECDSA_C
+#undef MBEDTLS_ECDSA_DETERMINISTIC
+#undef MBEDTLS_DHM_C
+
+/* P-256 for ECDHE-PSK */
+#undef MBEDTLS_ECP_DP_SECP192R1_ENABLED
+#undef MBEDTLS_ECP_DP_SECP224R1_ENABLED
+#undef MBEDTLS_ECP_DP_SECP384R1_ENABLED
+#undef MBEDTLS_ECP_DP_SECP521R1_ENABLED
+#undef MBEDTLS_ECP_DP_SECP192K1_ENABLED
+#undef MBEDTLS_ECP_DP_SECP224K1_ENABLED
+#undef MBEDTLS_ECP_DP_SECP256K1_ENABLED
+#undef MBEDTLS_ECP_DP_BP256R1_ENABLED
+#undef MBEDTLS_ECP_DP_BP384R1_ENABLED
+#undef MBEDTLS_ECP_DP_BP512R1_ENABLED
+#undef MBEDTLS_ECP_DP_CURVE25519_ENABLED
+
+/* AES (CCM, GCM and CBC) and SHA-256 */
+#define MBEDTLS_CCM_C
+#undef MBEDTLS_ARC4_C
+#undef MBEDTLS_BLOWFISH_C
+#undef MBEDTLS_CAMELLIA_C
+#undef MBEDTLS_DES_C
+#undef MBEDTLS_XTEA_C
+#undef MBEDTLS_CIPHER_MODE_CFB
+#undef MBEDTLS_RIPEMD160_C
+#undef MBEDTLS_MD5_C
+#undef MBEDTLS_SHA512_C
+
+#undef MBEDTLS_SSL_CACHE_C
+#undef MBEDTLS_SELF_TEST
+#undef MBEDTLS_VERSION_FEATURES
+
+#endif
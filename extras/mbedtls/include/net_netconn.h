@@ -0,0 +1,55 @@
+/* mbedtls BIO callbacks on the lwIP netconn API
+ *
+ * An alternative to mbedtls_net_send/mbedtls_net_recv that skips the
+ * lwIP sockets layer. Received netbufs are held on to between calls and
+ * their pbuf payloads copied straight into the buffer mbedtls passes in
+ * (its record buffer), so a large TLS download costs one copy per byte
+ * and no per-call socket lookup, locking or select bookkeeping.
+ *
+ *   mbedtls_netconn_context conn;
+ *   mbedtls_netconn_init(&conn);
+ *   mbedtls_netconn_connect(&conn, "example.com", "443");
+ *   mbedtls_ssl_set_bio(&ssl, &conn, mbedtls_netconn_send, mbedtls_netconn_recv,
+ *                       mbedtls_netconn_recv_timeout);
+ *   ...
+ *   mbedtls_netconn_free(&conn);
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Angus Gratton
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _NET_NETCONN_H
+#define _NET_NETCONN_H
+
+#include "mbedtls/config.h"
+#include "mbedtls/net.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct netconn;
+struct netbuf;
+
+typedef struct {
+    struct netconn *conn;
+    struct netbuf *rx;      /* partly consumed received data, or NULL */
+    uint16_t rx_offs;       /* bytes of rx already consumed */
+} mbedtls_netconn_context;
+
+void mbedtls_netconn_init( mbedtls_netconn_context *ctx );
+
+/* Open a TCP connection, returns 0 or MBEDTLS_ERR_NET_x */
+int mbedtls_netconn_connect( mbedtls_netconn_context *ctx, const char *host, const char *port );
+
+/* Adopt an already connected TCP netconn (e.g. from netconn_accept) */
+void mbedtls_netconn_set( mbedtls_netconn_context *ctx, struct netconn *conn );
+
+int mbedtls_netconn_send( void *ctx, const unsigned char *buf, size_t len );
+int mbedtls_netconn_recv( void *ctx, unsigned char *buf, size_t len );
+/* As mbedtls_netconn_recv, waiting at most 'timeout' ms (0 waits forever) */
+int mbedtls_netconn_recv_timeout( void *ctx, unsigned char *buf, size_t len, uint32_t timeout );
+
+/* Close the connection and drop any unread data */
+void mbedtls_netconn_free( mbedtls_netconn_context *ctx );
+
+#endif
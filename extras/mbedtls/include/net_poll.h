@@ -0,0 +1,54 @@
+/* Wait on several mbedtls network contexts at once
+ *
+ * Lets a single task serve several TLS connections with non-blocking
+ * sockets (mbedtls_net_set_nonblock), instead of a task and stack per
+ * connection. The usual loop is:
+ *
+ *   - for each connection set 'events' to what its last mbedtls call
+ *     asked for: MBEDTLS_NET_POLL_READ after MBEDTLS_ERR_SSL_WANT_READ,
+ *     MBEDTLS_NET_POLL_WRITE after MBEDTLS_ERR_SSL_WANT_WRITE
+ *   - call mbedtls_net_poll()
+ *   - retry the mbedtls call on each connection with 'revents' set
+ *
+ * Give the SSL context as well as the net context to have data mbedtls
+ * already decrypted (but the application hasn't read yet) count as
+ * readable, as the socket itself may have nothing more to come.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Angus Gratton
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _NET_POLL_H
+#define _NET_POLL_H
+
+#include "mbedtls/config.h"
+#include "mbedtls/net.h"
+#include "mbedtls/ssl.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define MBEDTLS_NET_POLL_READ  1
+#define MBEDTLS_NET_POLL_WRITE 2
+
+#ifndef MBEDTLS_ERR_NET_POLL_FAILED
+#define MBEDTLS_ERR_NET_POLL_FAILED -0x0047 /**< Reading information from the socket failed. */
+#endif
+
+typedef struct {
+    mbedtls_net_context *net;
+    mbedtls_ssl_context *ssl;   /* optional, may be NULL */
+    uint8_t events;             /* MBEDTLS_NET_POLL_x to wait for */
+    uint8_t revents;            /* MBEDTLS_NET_POLL_x that are ready */
+} mbedtls_net_pollfd;
+
+/* Wait up to 'timeout' ms (0 waits forever) until at least one of the
+   'count' entries is ready. Entries with a closed context (fd < 0) or
+   no events are skipped.
+
+   Returns the number of ready entries, 0 on timeout or
+   MBEDTLS_ERR_NET_POLL_FAILED.
+*/
+int mbedtls_net_poll( mbedtls_net_pollfd *fds, size_t count, uint32_t timeout );
+
+#endif
@@ -0,0 +1,83 @@
+/* A dedicated heap arena for mbedTLS
+ *
+ * A handshake allocates and frees dozens of variably sized blocks
+ * (bignums, parsed certificates, the record buffers) through malloc.
+ * Interleaved with lwIP's pbufs and everything else, that fragments the
+ * shared heap until a later allocation fails with plenty of memory free.
+ *
+ * ssl_arena_reserve() takes one block from the heap, and mbedtls'
+ * allocations are then served from inside it until ssl_arena_release()
+ * gives it back. TLS then uses at most the arena's size, and whatever
+ * churn happens inside it leaves the rest of the heap alone:
+ *
+ *   ssl_arena_install();               // once, before any mbedtls call
+ *   ...
+ *   ssl_arena_reserve(24 * 1024);      // connection start
+ *   mbedtls_ssl_setup(), the handshake, reads and writes...
+ *   mbedtls_ssl_free() etc.
+ *   ssl_arena_release();               // connection closed
+ *
+ * Size the arena from the peak reported by ssl_arena_get_stats() (or
+ * printed by ssl_arena_release() with SSL_ARENA_REPORT) over a few
+ * connections to the real server.
+ *
+ * Allocations made while no arena is reserved (say, parsing the CA
+ * certificates at startup) come from the heap as usual, and frees are
+ * told apart by address, so long-lived objects can span arenas. If
+ * anything allocated in the arena is still in use when it's released,
+ * the block is given back when that last allocation is freed, but it
+ * can't be reserved again until then. So anything meant to outlive the
+ * connection, like a session kept for resumption, should be allocated
+ * with ssl_arena_bypass() on.
+ *
+ * When the arena is full mbedtls calls fail with their ALLOC_FAILED
+ * errors, the heap isn't used as a fallback.
+ *
+ * There is one arena, shared by all the mbedtls contexts that are live
+ * while it's reserved. Allocations and frees are O(blocks in the arena),
+ * first fit, with neighbouring free blocks merged.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Angus Gratton
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _SSL_ARENA_H
+#define _SSL_ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Print the arena's peak use when it's released */
+#ifndef SSL_ARENA_REPORT
+#define SSL_ARENA_REPORT 0
+#endif
+
+typedef struct {
+    size_t size;        /* Arena size, 0 if none is reserved */
+    size_t used;        /* Bytes allocated now, including block headers */
+    size_t peak;        /* Most bytes allocated at once since reserved */
+    uint32_t allocs;    /* Allocations served since reserved */
+    uint32_t failures;  /* Allocations that didn't fit */
+} ssl_arena_stats_t;
+
+/* Point mbedtls_calloc/mbedtls_free at the arena allocator */
+void ssl_arena_install(void);
+
+/* Take a 'size' byte arena from the heap. Returns 0, or -1 if the heap
+   has no block that big or an arena is already reserved. */
+int ssl_arena_reserve(size_t size);
+
+/* Give the arena back to the heap (once nothing in it is in use).
+   Later mbedtls allocations come from the heap again. */
+void ssl_arena_release(void);
+
+/* While enabled, mbedtls allocations come from the heap even with an
+   arena reserved (frees still go wherever the block came from) */
+void ssl_arena_bypass(bool enable);
+
+/* Statistics of the reserved arena, or if none is reserved of the last
+   one released */
+void ssl_arena_get_stats(ssl_arena_stats_t *stats);
+
+#endif
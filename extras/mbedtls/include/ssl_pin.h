@@ -0,0 +1,120 @@
+/* Certificate pinning for mbedTLS clients
+ *
+ * Verifying the server's certificate chain costs an RSA or ECDSA
+ * signature check per certificate, at every handshake, on top of the
+ * heap for the CA certificates. A device that only ever talks to its
+ * own backend can instead pin the server: accept it when the SHA-256 of
+ * its leaf certificate, or of the leaf's public key (SubjectPublicKeyInfo,
+ * as HPKP pins it), matches one of a few stored values. Pinning the key
+ * keeps working when the certificate is renewed with the same key.
+ *
+ * Optionally, a server that matches no pin is verified against a CA
+ * chain as usual, and the fingerprints of leaf certificates that passed
+ * are cached, so the next handshakes with the same certificate skip the
+ * chain. Cached entries expire after SSL_PIN_CACHE_TIMEOUT seconds.
+ *
+ * mbedtls' own verification has to be off, the handshake then runs
+ * through ssl_pin_handshake(), which checks the certificate as soon as
+ * it arrives, before the client sends anything keyed to it:
+ *
+ *   static ssl_pin_t pin;
+ *   ssl_pin_init(&pin);
+ *   ssl_pin_add(&pin, SSL_PIN_PUBKEY, server_key_sha256);
+ *   ssl_pin_set_ca_chain(&pin, &cacert, "example.com");    // optional
+ *
+ *   mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_NONE);
+ *   ...
+ *   while((ret = ssl_pin_handshake(&ssl, &pin)) != 0) {
+ *       if(ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE)
+ *           ...   // MBEDTLS_ERR_X509_CERT_VERIFY_FAILED if not pinned
+ *   }
+ *
+ * The pin of a server's key can be found with:
+ *
+ *   openssl s_client -connect example.com:443 < /dev/null | openssl x509 -pubkey -noout |
+ *       openssl pkey -pubin -outform der | openssl dgst -sha256
+ *
+ * and of its certificate with:
+ *
+ *   openssl s_client -connect example.com:443 < /dev/null | openssl x509 -outform der |
+ *       openssl dgst -sha256
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Angus Gratton
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _SSL_PIN_H
+#define _SSL_PIN_H
+
+#include "mbedtls/config.h"
+#include "mbedtls/ssl.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Pins held, e.g. the current key and a backup */
+#ifndef SSL_PIN_MAX_PINS
+#define SSL_PIN_MAX_PINS 2
+#endif
+
+/* Chain-verified certificates remembered, the least recently used is
+   evicted when full. Each entry is 44 bytes. */
+#ifndef SSL_PIN_CACHE_ENTRIES
+#define SSL_PIN_CACHE_ENTRIES 4
+#endif
+
+/* Cached verifications older than this (in seconds) are redone */
+#ifndef SSL_PIN_CACHE_TIMEOUT
+#define SSL_PIN_CACHE_TIMEOUT 86400
+#endif
+
+typedef enum {
+    SSL_PIN_CERT,       /* SHA-256 of the leaf certificate (DER) */
+    SSL_PIN_PUBKEY,     /* SHA-256 of its SubjectPublicKeyInfo (DER) */
+} ssl_pin_type_t;
+
+typedef struct {
+    uint8_t sha256[32];
+    ssl_pin_type_t type;
+} ssl_pin_entry_t;
+
+typedef struct {
+    uint8_t fingerprint[32];    /* SHA-256 of the leaf certificate */
+    uint32_t stored;            /* tick count when verified */
+    uint32_t used;              /* LRU clock */
+    bool valid;
+} ssl_pin_cache_entry_t;
+
+typedef struct {
+    ssl_pin_entry_t pins[SSL_PIN_MAX_PINS];
+    int n_pins;
+    mbedtls_x509_crt *ca_chain;
+    const char *hostname;
+    ssl_pin_cache_entry_t cache[SSL_PIN_CACHE_ENTRIES];
+    uint32_t clock;
+} ssl_pin_t;
+
+void ssl_pin_init(ssl_pin_t *pin);
+
+/* Add a pin, returns -1 if SSL_PIN_MAX_PINS are already set */
+int ssl_pin_add(ssl_pin_t *pin, ssl_pin_type_t type, const uint8_t sha256[32]);
+
+/* Verify servers matching no pin against 'ca_chain' (and, unless
+   'hostname' is NULL, check that it's the certificate's CN or a subject
+   alternative name), and cache the ones that pass. Both must stay valid
+   while 'pin' is used. Without a CA chain only pinned servers are
+   accepted. */
+void ssl_pin_set_ca_chain(ssl_pin_t *pin, mbedtls_x509_crt *ca_chain, const char *hostname);
+
+/* Forget all cached verifications */
+void ssl_pin_cache_clear(ssl_pin_t *pin);
+
+/* Use in place of mbedtls_ssl_handshake(), with the same return values.
+   A server certificate matching no pin, and failing or not given a
+   chain verification, fails the handshake with
+   MBEDTLS_ERR_X509_CERT_VERIFY_FAILED. On success
+   mbedtls_ssl_get_verify_result() returns 0. Resumed sessions were
+   checked when first established. */
+int ssl_pin_handshake(mbedtls_ssl_context *ssl, ssl_pin_t *pin);
+
+#endif
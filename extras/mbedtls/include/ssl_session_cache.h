@@ -0,0 +1,86 @@
+/* TLS session resumption helpers for mbedTLS
+ *
+ * Resuming a session skips the public key operations of a full
+ * handshake, which take seconds at 80MHz, so a reconnect (after a WiFi
+ * drop for example) only costs a couple of round trips and some hashing.
+ *
+ * Server side: a small fixed-size session cache, with no heap use per
+ * entry, to pass to mbedtls_ssl_conf_session_cache():
+ *
+ *   static ssl_session_cache_t cache;
+ *   ssl_session_cache_init(&cache);
+ *   mbedtls_ssl_conf_session_cache(&conf, &cache, ssl_session_cache_get, ssl_session_cache_set);
+ *
+ * Client side: keep the session of the last connection and offer it on
+ * the next (by session ID, or session ticket if the server sent one):
+ *
+ *   ssl_saved_session_t saved;
+ *   ssl_saved_session_init(&saved);
+ *   ...
+ *   ssl_saved_session_restore(&saved, &ssl);   // before mbedtls_ssl_handshake
+ *   mbedtls_ssl_handshake(&ssl) ...
+ *   ssl_saved_session_save(&saved, &ssl);      // after a successful handshake
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Angus Gratton
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _SSL_SESSION_CACHE_H
+#define _SSL_SESSION_CACHE_H
+
+#include "mbedtls/config.h"
+#include "mbedtls/ssl.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Number of sessions the server cache holds, the least recently used
+   is evicted when full. Each entry is ~150 bytes. */
+#ifndef SSL_SESSION_CACHE_ENTRIES
+#define SSL_SESSION_CACHE_ENTRIES 4
+#endif
+
+/* Sessions older than this (in seconds) aren't resumed */
+#ifndef SSL_SESSION_CACHE_TIMEOUT
+#define SSL_SESSION_CACHE_TIMEOUT 3600
+#endif
+
+typedef struct {
+    mbedtls_ssl_session session; /* peer certificate is not kept */
+    uint32_t stored;             /* tick count when stored */
+    uint32_t used;               /* LRU clock */
+    bool valid;
+} ssl_session_cache_entry_t;
+
+typedef struct {
+    ssl_session_cache_entry_t entries[SSL_SESSION_CACHE_ENTRIES];
+    uint32_t clock;
+} ssl_session_cache_t;
+
+void ssl_session_cache_init(ssl_session_cache_t *cache);
+
+/* mbedtls f_get_cache/f_set_cache callbacks, 'data' is the cache */
+int ssl_session_cache_get(void *data, mbedtls_ssl_session *session);
+int ssl_session_cache_set(void *data, const mbedtls_ssl_session *session);
+
+/* Forget all cached sessions */
+void ssl_session_cache_clear(ssl_session_cache_t *cache);
+
+typedef struct {
+    mbedtls_ssl_session session;
+    bool valid;
+} ssl_saved_session_t;
+
+void ssl_saved_session_init(ssl_saved_session_t *saved);
+
+/* Keep the session of a completed handshake, returns 0 or an mbedtls error */
+int ssl_saved_session_save(ssl_saved_session_t *saved, const mbedtls_ssl_context *ssl);
+
+/* Offer the saved session (if any) in the next handshake on 'ssl'. Call
+   after mbedtls_ssl_setup/mbedtls_ssl_session_reset, before the handshake. */
+int ssl_saved_session_restore(const ssl_saved_session_t *saved, mbedtls_ssl_context *ssl);
+
+/* Drop the saved session, e.g. if the handshake using it failed */
+void ssl_saved_session_free(ssl_saved_session_t *saved);
+
+#endif
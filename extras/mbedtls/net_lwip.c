@@ -30,6 +30,8 @@
 #if defined(MBEDTLS_NET_C)
 
 #include "mbedtls/net.h"
+#include "net_poll.h"
+#include "net_netconn.h"
 
 #include <string.h>
 
@@ -47,6 +49,8 @@
 
 #include <stdint.h>
 
+#include "lwip/api.h"
+
 /*
  * Prepare for using the sockets interface
  */
@@ -517,6 +521,76 @@ int mbedtls_net_send( void *ctx, const unsigned char *buf, size_t len )
     return( ret );
 }
 
+/*
+ * Wait until any of several contexts is ready, see net_poll.h
+ */
+int mbedtls_net_poll( mbedtls_net_pollfd *fds, size_t count, uint32_t timeout )
+{
+    int ret, max_fd = -1, ready = 0;
+    size_t i;
+    struct timeval tv;
+    fd_set read_fds, write_fds;
+
+    FD_ZERO( &read_fds );
+    FD_ZERO( &write_fds );
+
+    for( i = 0; i < count; i++ )
+    {
+        int fd = fds[i].net->fd;
+        fds[i].revents = 0;
+        if( fd < 0 )
+            continue;
+
+        /* Already decrypted data is read without touching the socket */
+        if( ( fds[i].events & MBEDTLS_NET_POLL_READ ) && fds[i].ssl != NULL &&
+            mbedtls_ssl_get_bytes_avail( fds[i].ssl ) > 0 )
+        {
+            fds[i].revents = MBEDTLS_NET_POLL_READ;
+            ready++;
+        }
+
+        if( fds[i].events & MBEDTLS_NET_POLL_READ )
+            FD_SET( fd, &read_fds );
+        if( fds[i].events & MBEDTLS_NET_POLL_WRITE )
+            FD_SET( fd, &write_fds );
+        if( fds[i].events && fd > max_fd )
+            max_fd = fd;
+    }
+
+    if( max_fd < 0 )
+        return( ready );
+
+    /* Don't wait if some of the entries are ready already */
+    tv.tv_sec  = ready ? 0 : timeout / 1000;
+    tv.tv_usec = ready ? 0 : ( timeout % 1000 ) * 1000;
+
+    ret = select( max_fd + 1, &read_fds, &write_fds, NULL,
+                  ( timeout == 0 && !ready ) ? NULL : &tv );
+
+    if( ret < 0 )
+    {
+        if( errno == EINTR )
+            return( ready );
+        return( MBEDTLS_ERR_NET_POLL_FAILED );
+    }
+
+    ready = 0;
+    for( i = 0; i < count; i++ )
+    {
+        int fd = fds[i].net->fd;
+        if( fd < 0 )
+            continue;
+        if( ( fds[i].events & MBEDTLS_NET_POLL_READ ) && FD_ISSET( fd, &read_fds ) )
+            fds[i].revents |= MBEDTLS_NET_POLL_READ;
+        if( ( fds[i].events & MBEDTLS_NET_POLL_WRITE ) && FD_ISSET( fd, &write_fds ) )
+            fds[i].revents |= MBEDTLS_NET_POLL_WRITE;
+        if( fds[i].revents )
+            ready++;
+    }
+
+    return( ready );
+}
+
 /*
  * Gracefully close the connection
  */
@@ -531,4 +605,114 @@ void mbedtls_net_free( mbedtls_net_context *ctx )
     ctx->fd = -1;
 }
 
+/*
+ * netconn based BIO, see net_netconn.h
+ */
+void mbedtls_netconn_init( mbedtls_netconn_context *ctx )
+{
+    ctx->conn = NULL;
+    ctx->rx = NULL;
+    ctx->rx_offs = 0;
+}
+
+void mbedtls_netconn_set( mbedtls_netconn_context *ctx, struct netconn *conn )
+{
+    mbedtls_netconn_init( ctx );
+    ctx->conn = conn;
+}
+
+int mbedtls_netconn_connect( mbedtls_netconn_context *ctx, const char *host, const char *port )
+{
+    ip_addr_t addr;
+
+    if( netconn_gethostbyname( host, &addr ) != ERR_OK )
+        return( MBEDTLS_ERR_NET_UNKNOWN_HOST );
+
+    ctx->conn = netconn_new( NETCONN_TCP );
+    if( ctx->conn == NULL )
+        return( MBEDTLS_ERR_NET_SOCKET_FAILED );
+
+    if( netconn_connect( ctx->conn, &addr, atoi( port ) ) != ERR_OK )
+    {
+        netconn_delete( ctx->conn );
+        ctx->conn = NULL;
+        return( MBEDTLS_ERR_NET_CONNECT_FAILED );
+    }
+
+    return( 0 );
+}
+
+int mbedtls_netconn_send( void *ctx, const unsigned char *buf, size_t len )
+{
+    mbedtls_netconn_context *nc = (mbedtls_netconn_context *) ctx;
+    err_t err;
+
+    if( nc->conn == NULL )
+        return( MBEDTLS_ERR_NET_INVALID_CONTEXT );
+
+    /* NETCONN_COPY, as mbedtls reuses its output buffer straight away */
+    err = netconn_write( nc->conn, buf, len, NETCONN_COPY );
+    if( err == ERR_RST || err == ERR_CLSD || err == ERR_ABRT )
+        return( MBEDTLS_ERR_NET_CONN_RESET );
+    if( err != ERR_OK )
+        return( MBEDTLS_ERR_NET_SEND_FAILED );
+
+    return( (int) len );
+}
+
+int mbedtls_netconn_recv_timeout( void *ctx, unsigned char *buf, size_t len, uint32_t timeout )
+{
+    mbedtls_netconn_context *nc = (mbedtls_netconn_context *) ctx;
+    u16_t n, rx_len;
+
+    if( nc->conn == NULL )
+        return( MBEDTLS_ERR_NET_INVALID_CONTEXT );
+
+    if( nc->rx == NULL )
+    {
+        err_t err;
+
+        netconn_set_recvtimeout( nc->conn, timeout );
+        err = netconn_recv( nc->conn, &nc->rx );
+        if( err == ERR_TIMEOUT )
+            return( MBEDTLS_ERR_SSL_TIMEOUT );
+        if( err == ERR_CLSD )
+            return( 0 ); /* peer closed */
+        if( err == ERR_RST || err == ERR_ABRT )
+            return( MBEDTLS_ERR_NET_CONN_RESET );
+        if( err != ERR_OK )
+            return( MBEDTLS_ERR_NET_RECV_FAILED );
+        nc->rx_offs = 0;
+    }
+
+    /* Straight from the pbuf chain into the caller's (record) buffer */
+    rx_len = netbuf_len( nc->rx );
+    n = netbuf_copy_partial( nc->rx, buf, len < 0xffff ? len : 0xffff, nc->rx_offs );
+    nc->rx_offs += n;
+    if( nc->rx_offs >= rx_len )
+    {
+        netbuf_delete( nc->rx );
+        nc->rx = NULL;
+    }
+
+    return( n );
+}
+
+int mbedtls_netconn_recv( void *ctx, unsigned char *buf, size_t len )
+{
+    return( mbedtls_netconn_recv_timeout( ctx, buf, len, 0 ) );
+}
+
+void mbedtls_netconn_free( mbedtls_netconn_context *ctx )
+{
+    if( ctx->rx != NULL )
+        netbuf_delete( ctx->rx );
+    if( ctx->conn != NULL )
+    {
+        netconn_close( ctx->conn );
+        netconn_delete( ctx->conn );
+    }
+    mbedtls_netconn_init( ctx );
+}
+
 #endif /* MBEDTLS_NET_C */
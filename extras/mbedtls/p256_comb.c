@@ -0,0 +1,89 @@
+/* Precomputed P-256 fixed-base comb table for mbedTLS
+ *
+ * Built with MBEDTLS_P256_COMB=1, see component.mk.
+ *
+ * Every ECDHE key generation and ECDSA signature multiplies the curve's
+ * base point G. mbedtls' comb method first builds a table of multiples
+ * of G, which for P-256 costs about as much as the multiplication that
+ * follows. With MBEDTLS_ECP_FIXED_POINT_OPTIM it keeps that table in the
+ * group, but a group lives only as long as its ECDH or PK context, so
+ * a TLS handshake still builds it every time.
+ *
+ * The link wraps mbedtls_ecp_group_load(), so each P-256 group is loaded
+ * with the table already in place, copied from the one generated by
+ * utils/gen_p256_comb.py and stored in IROM. mbedtls frees the table
+ * with the group, so it has to be in heap. The copy is read a 32-bit
+ * word at a time, as IROM requires.
+ *
+ * The table is only used for w = 5 (MBEDTLS_ECP_WINDOW_SIZE 5, as the
+ * profile in our config.h sets it); for any other window mbedtls would
+ * read it in the wrong layout, hence the check below.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Angus Gratton
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "mbedtls/config.h"
+
+#if defined(MBEDTLS_P256_COMB) && defined(MBEDTLS_ECP_DP_SECP256R1_ENABLED)
+
+#include <stdint.h>
+#include <common_macros.h>
+
+#include "mbedtls/ecp.h"
+#include "mbedtls/platform.h"
+
+#include "p256_comb_table.h"
+
+#if MBEDTLS_ECP_WINDOW_SIZE != P256_COMB_W || MBEDTLS_ECP_FIXED_POINT_OPTIM != 1
+#error "MBEDTLS_P256_COMB needs MBEDTLS_ECP_WINDOW_SIZE 5 and MBEDTLS_ECP_FIXED_POINT_OPTIM 1"
+#endif
+
+int __real_mbedtls_ecp_group_load(mbedtls_ecp_group *grp, mbedtls_ecp_group_id id);
+
+static int load_mpi(mbedtls_mpi *X, const uint32_t *limbs)
+{
+    int ret = mbedtls_mpi_grow(X, P256_COMB_LIMBS);
+    if (ret == 0) {
+        for (int i = 0; i < P256_COMB_LIMBS; i++) {
+            X->p[i] = limbs[i];
+        }
+        X->s = 1;
+    }
+    return ret;
+}
+
+static int load_comb(mbedtls_ecp_group *grp)
+{
+    mbedtls_ecp_point *T = mbedtls_calloc(P256_COMB_POINTS, sizeof(mbedtls_ecp_point));
+    int ret = 0;
+
+    if (T == NULL) {
+        return MBEDTLS_ERR_ECP_ALLOC_FAILED;
+    }
+    for (int i = 0; i < P256_COMB_POINTS; i++) {
+        mbedtls_ecp_point_init(&T[i]);
+        if (ret == 0) ret = load_mpi(&T[i].X, p256_comb_table[i][0]);
+        if (ret == 0) ret = load_mpi(&T[i].Y, p256_comb_table[i][1]);
+        if (ret == 0) ret = mbedtls_mpi_lset(&T[i].Z, 1);
+    }
+    /* mbedtls_ecp_group_free() frees it from here, even on failure */
+    grp->T = T;
+    grp->T_size = P256_COMB_POINTS;
+    return ret;
+}
+
+int __wrap_mbedtls_ecp_group_load(mbedtls_ecp_group *grp, mbedtls_ecp_group_id id)
+{
+    int ret = __real_mbedtls_ecp_group_load(grp, id);
+
+    if (ret == 0 && id == MBEDTLS_ECP_DP_SECP256R1) {
+        ret = load_comb(grp);
+        if (ret != 0) {
+            mbedtls_ecp_group_free(grp);
+        }
+    }
+    return ret;
+}
+
+#endif
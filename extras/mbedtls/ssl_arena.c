@@ -0,0 +1,225 @@
+/* A dedicated heap arena for mbedTLS
+ *
+ * For details of use see ssl_arena.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Angus Gratton
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "mbedtls/config.h"
+
+#if defined(MBEDTLS_PLATFORM_MEMORY)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "mbedtls/platform.h"
+#include "ssl_arena.h"
+
+/* Each block starts with its size (header included, a multiple of 8,
+   low bit set while free) and the size of the block before it, so a
+   freed block can be merged with both its neighbours */
+typedef struct {
+    uint32_t size;
+    uint32_t prev_size;
+} block_t;
+
+#define BLOCK_FREE 1
+#define BLOCK_ALIGN 8
+#define MIN_BLOCK (sizeof(block_t) + BLOCK_ALIGN)
+
+/* An arena keeps its own header at the start of its heap block. Retired
+   arenas stay on the list until their last allocation is freed. */
+typedef struct arena {
+    struct arena *next;
+    uint8_t *end;
+    bool retired;
+    ssl_arena_stats_t stats;
+} arena_t;
+
+#define ARENA_HEADER ((sizeof(arena_t) + BLOCK_ALIGN - 1) & ~(BLOCK_ALIGN - 1))
+#define FIRST_BLOCK(a) ((block_t *)((uint8_t *)(a) + ARENA_HEADER))
+#define NEXT_BLOCK(b) ((block_t *)((uint8_t *)(b) + ((b)->size & ~BLOCK_FREE)))
+#define PREV_BLOCK(b) ((block_t *)((uint8_t *)(b) - (b)->prev_size))
+
+static arena_t *arenas;
+static ssl_arena_stats_t last_stats;  /* of the last arena released */
+static bool bypass;
+
+static void *arena_alloc(arena_t *a, size_t len)
+{
+    size_t need = sizeof(block_t) + ((len + BLOCK_ALIGN - 1) & ~(BLOCK_ALIGN - 1));
+
+    for(block_t *b = FIRST_BLOCK(a); (uint8_t *)b < a->end; b = NEXT_BLOCK(b)) {
+        if(!(b->size & BLOCK_FREE) || b->size - BLOCK_FREE < need)
+            continue;
+        size_t size = b->size - BLOCK_FREE;
+        if(size - need >= MIN_BLOCK) {
+            block_t *rest = (block_t *)((uint8_t *)b + need);
+            rest->size = (size - need) | BLOCK_FREE;
+            rest->prev_size = need;
+            block_t *next = NEXT_BLOCK(rest);
+            if((uint8_t *)next < a->end)
+                next->prev_size = size - need;
+            size = need;
+        }
+        b->size = size;
+        a->stats.used += size;
+        if(a->stats.used > a->stats.peak)
+            a->stats.peak = a->stats.used;
+        a->stats.allocs++;
+        return b + 1;
+    }
+    a->stats.failures++;
+    return NULL;
+}
+
+static void arena_free(arena_t *a, void *ptr)
+{
+    block_t *b = (block_t *)ptr - 1;
+    block_t *next = NEXT_BLOCK(b);
+
+    a->stats.used -= b->size;
+    b->size |= BLOCK_FREE;
+    if((uint8_t *)next < a->end && (next->size & BLOCK_FREE)) {
+        b->size += next->size - BLOCK_FREE;
+        next = NEXT_BLOCK(b);
+    }
+    if(b->prev_size && (PREV_BLOCK(b)->size & BLOCK_FREE)) {
+        block_t *prev = PREV_BLOCK(b);
+        prev->size += b->size - BLOCK_FREE;
+        b = prev;
+    }
+    if((uint8_t *)next < a->end)
+        next->prev_size = b->size - BLOCK_FREE;
+}
+
+static void *ssl_arena_calloc(size_t nmemb, size_t size)
+{
+    size_t len = nmemb * size;
+    void *ptr;
+
+    if(size && len / size != nmemb)
+        return NULL;
+
+    vTaskSuspendAll();
+    if(arenas == NULL || arenas->retired || bypass) {
+        xTaskResumeAll();
+        return calloc(nmemb, size);
+    }
+    ptr = arena_alloc(arenas, len);
+    xTaskResumeAll();
+
+    if(ptr)
+        memset(ptr, 0, len);
+    return ptr;
+}
+
+static void ssl_arena_free(void *ptr)
+{
+    arena_t *done = NULL;
+    bool found = false;
+
+    if(ptr == NULL)
+        return;
+
+    vTaskSuspendAll();
+    for(arena_t **link = &arenas; *link; link = &(*link)->next) {
+        arena_t *a = *link;
+        if((uint8_t *)ptr > (uint8_t *)a && (uint8_t *)ptr < a->end) {
+            arena_free(a, ptr);
+            if(a->retired && a->stats.used == 0) {
+                *link = a->next;
+                done = a;
+            }
+            found = true;
+            break;
+        }
+    }
+    xTaskResumeAll();
+
+    if(!found)
+        free(ptr);
+    else if(done)
+        free(done);
+}
+
+void ssl_arena_install(void)
+{
+    mbedtls_platform_set_calloc_free(ssl_arena_calloc, ssl_arena_free);
+}
+
+void ssl_arena_bypass(bool enable)
+{
+    bypass = enable;
+}
+
+int ssl_arena_reserve(size_t size)
+{
+    size &= ~(BLOCK_ALIGN - 1);
+    if(size < ARENA_HEADER + MIN_BLOCK)
+        return -1;
+    if(arenas && !arenas->retired)
+        return -1;
+
+    arena_t *a = malloc(size);
+    if(a == NULL)
+        return -1;
+    memset(a, 0, sizeof(arena_t));
+    a->end = (uint8_t *)a + size;
+    a->stats.size = size;
+
+    block_t *b = FIRST_BLOCK(a);
+    b->size = (a->end - (uint8_t *)b) | BLOCK_FREE;
+    b->prev_size = 0;
+
+    vTaskSuspendAll();
+    a->next = arenas;
+    arenas = a;
+    xTaskResumeAll();
+    return 0;
+}
+
+void ssl_arena_release(void)
+{
+    arena_t *a, *done = NULL;
+
+    vTaskSuspendAll();
+    a = arenas;
+    if(a == NULL || a->retired) {
+        xTaskResumeAll();
+        return;
+    }
+    last_stats = a->stats;
+    if(a->stats.used == 0) {
+        arenas = a->next;
+        done = a;
+    } else {
+        /* A retired arena may be freed by another task from here on */
+        a->retired = true;
+    }
+    xTaskResumeAll();
+
+#if SSL_ARENA_REPORT
+    printf("ssl_arena: peak %u of %u bytes, %u allocations, %u failed%s\n",
+           last_stats.peak, last_stats.size, last_stats.allocs, last_stats.failures,
+           done ? "" : ", blocks still in use");
+#endif
+    free(done);
+}
+
+void ssl_arena_get_stats(ssl_arena_stats_t *stats)
+{
+    vTaskSuspendAll();
+    if(arenas && !arenas->retired)
+        *stats = arenas->stats;
+    else
+        *stats = last_stats;
+    xTaskResumeAll();
+}
+
+#endif
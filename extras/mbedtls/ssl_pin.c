@@ -0,0 +1,181 @@
+/* Certificate pinning for mbedTLS clients
+ *
+ * For details of use see ssl_pin.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Angus Gratton
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "mbedtls/config.h"
+
+#if defined(MBEDTLS_SSL_CLI_C) && defined(MBEDTLS_X509_CRT_PARSE_C) && \
+    defined(MBEDTLS_PK_WRITE_C) && defined(MBEDTLS_SHA256_C)
+
+#include <string.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "mbedtls/sha256.h"
+#include "mbedtls/pk.h"
+#include "ssl_pin.h"
+
+#define TIMEOUT_TICKS ((uint32_t)SSL_PIN_CACHE_TIMEOUT * configTICK_RATE_HZ)
+
+/* Largest SubjectPublicKeyInfo hashed: an RSA modulus of
+   MBEDTLS_MPI_MAX_SIZE bytes plus the DER around it */
+#define PUBKEY_DER_MAX (MBEDTLS_MPI_MAX_SIZE + 64)
+
+void ssl_pin_init(ssl_pin_t *pin)
+{
+    memset(pin, 0, sizeof(ssl_pin_t));
+}
+
+int ssl_pin_add(ssl_pin_t *pin, ssl_pin_type_t type, const uint8_t sha256[32])
+{
+    if(pin->n_pins == SSL_PIN_MAX_PINS)
+        return -1;
+    memcpy(pin->pins[pin->n_pins].sha256, sha256, 32);
+    pin->pins[pin->n_pins].type = type;
+    pin->n_pins++;
+    return 0;
+}
+
+void ssl_pin_set_ca_chain(ssl_pin_t *pin, mbedtls_x509_crt *ca_chain, const char *hostname)
+{
+    pin->ca_chain = ca_chain;
+    pin->hostname = hostname;
+}
+
+void ssl_pin_cache_clear(ssl_pin_t *pin)
+{
+    memset(pin->cache, 0, sizeof(pin->cache));
+    pin->clock = 0;
+}
+
+static bool match_pins(const ssl_pin_t *pin, mbedtls_x509_crt *crt, const uint8_t fingerprint[32])
+{
+    uint8_t pubkey_hash[32];
+    bool have_pubkey_hash = false;
+
+    for(int i = 0; i < pin->n_pins; i++) {
+        const ssl_pin_entry_t *entry = &pin->pins[i];
+        if(entry->type == SSL_PIN_CERT) {
+            if(!memcmp(entry->sha256, fingerprint, 32))
+                return true;
+            continue;
+        }
+        if(!have_pubkey_hash) {
+            unsigned char der[PUBKEY_DER_MAX];
+            /* written at the end of the buffer */
+            int len = mbedtls_pk_write_pubkey_der(&crt->pk, der, sizeof(der));
+            if(len <= 0)
+                return false;
+            mbedtls_sha256(der + sizeof(der) - len, len, pubkey_hash, 0);
+            have_pubkey_hash = true;
+        }
+        if(!memcmp(entry->sha256, pubkey_hash, 32))
+            return true;
+    }
+    return false;
+}
+
+static ssl_pin_cache_entry_t *cache_find(ssl_pin_t *pin, const uint8_t fingerprint[32])
+{
+    for(int i = 0; i < SSL_PIN_CACHE_ENTRIES; i++) {
+        ssl_pin_cache_entry_t *entry = &pin->cache[i];
+        if(!entry->valid)
+            continue;
+        if((uint32_t)xTaskGetTickCount() - entry->stored > TIMEOUT_TICKS) {
+            entry->valid = false;
+            continue;
+        }
+        if(!memcmp(entry->fingerprint, fingerprint, 32))
+            return entry;
+    }
+    return NULL;
+}
+
+static void cache_add(ssl_pin_t *pin, const uint8_t fingerprint[32])
+{
+    ssl_pin_cache_entry_t *slot = NULL;
+
+    /* cache_find() has just expired the stale entries; a free slot, else LRU */
+    for(int i = 0; i < SSL_PIN_CACHE_ENTRIES; i++) {
+        ssl_pin_cache_entry_t *entry = &pin->cache[i];
+        if(!entry->valid) {
+            slot = entry;
+            break;
+        }
+        if(!slot || entry->used < slot->used)
+            slot = entry;
+    }
+    memcpy(slot->fingerprint, fingerprint, 32);
+    slot->stored = xTaskGetTickCount();
+    slot->used = ++pin->clock;
+    slot->valid = true;
+}
+
+/* The server's certificate chain has just been parsed (but, with
+   MBEDTLS_SSL_VERIFY_NONE, not verified) */
+static int check_peer(mbedtls_ssl_context *ssl, ssl_pin_t *pin)
+{
+    mbedtls_x509_crt *crt = ssl->session_negotiate->peer_cert;
+    uint8_t fingerprint[32];
+    uint32_t flags;
+
+    /* Not a certificate key exchange (PSK) */
+    if(crt == NULL)
+        return 0;
+
+    mbedtls_sha256(crt->raw.p, crt->raw.len, fingerprint, 0);
+    if(match_pins(pin, crt, fingerprint)) {
+        ssl->session_negotiate->verify_result = 0;
+        return 0;
+    }
+
+    ssl_pin_cache_entry_t *cached = cache_find(pin, fingerprint);
+    if(cached) {
+        cached->used = ++pin->clock;
+        ssl->session_negotiate->verify_result = 0;
+        return 0;
+    }
+
+    if(pin->ca_chain == NULL) {
+        ssl->session_negotiate->verify_result = MBEDTLS_X509_BADCERT_NOT_TRUSTED;
+        return MBEDTLS_ERR_X509_CERT_VERIFY_FAILED;
+    }
+
+    /* The rest of the peer's chain hangs off crt->next */
+    if(mbedtls_x509_crt_verify(crt, pin->ca_chain, NULL, pin->hostname, &flags, NULL, NULL) != 0) {
+        ssl->session_negotiate->verify_result = flags;
+        return MBEDTLS_ERR_X509_CERT_VERIFY_FAILED;
+    }
+    cache_add(pin, fingerprint);
+    ssl->session_negotiate->verify_result = 0;
+    return 0;
+}
+
+int ssl_pin_handshake(mbedtls_ssl_context *ssl, ssl_pin_t *pin)
+{
+    while(ssl->state != MBEDTLS_SSL_HANDSHAKE_OVER) {
+        int state = ssl->state;
+        int ret = mbedtls_ssl_handshake_step(ssl);
+        if(ret != 0)
+            return ret;
+        /* The state only moves on once the whole certificate message is
+           in, so this runs once per handshake whatever WANT_READs came
+           in between */
+        if(state == MBEDTLS_SSL_SERVER_CERTIFICATE && ssl->state != state) {
+            ret = check_peer(ssl, pin);
+            if(ret != 0) {
+                mbedtls_ssl_send_alert_message(ssl, MBEDTLS_SSL_ALERT_LEVEL_FATAL,
+                                               MBEDTLS_SSL_ALERT_MSG_BAD_CERT);
+                return ret;
+            }
+        }
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,131 @@
+/* TLS session resumption helpers for mbedTLS
+ *
+ * For details of use see ssl_session_cache.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Angus Gratton
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <string.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "ssl_session_cache.h"
+
+#if defined(MBEDTLS_SSL_SRV_C) || defined(MBEDTLS_SSL_CLI_C)
+
+#define TIMEOUT_TICKS ((uint32_t)SSL_SESSION_CACHE_TIMEOUT * configTICK_RATE_HZ)
+
+void ssl_session_cache_init(ssl_session_cache_t *cache)
+{
+    memset(cache, 0, sizeof(ssl_session_cache_t));
+}
+
+static bool entry_expired(const ssl_session_cache_entry_t *entry)
+{
+    return (uint32_t)xTaskGetTickCount() - entry->stored > TIMEOUT_TICKS;
+}
+
+int ssl_session_cache_get(void *data, mbedtls_ssl_session *session)
+{
+    ssl_session_cache_t *cache = data;
+
+    for(int i = 0; i < SSL_SESSION_CACHE_ENTRIES; i++) {
+        ssl_session_cache_entry_t *entry = &cache->entries[i];
+        if(!entry->valid)
+            continue;
+        if(entry_expired(entry)) {
+            entry->valid = false;
+            continue;
+        }
+        if(session->ciphersuite != entry->session.ciphersuite ||
+           session->compression != entry->session.compression ||
+           session->id_len != entry->session.id_len ||
+           memcmp(session->id, entry->session.id, entry->session.id_len))
+            continue;
+
+        /* Same as mbedtls' own ssl_cache: hand back the secrets only */
+        memcpy(session->master, entry->session.master, sizeof(session->master));
+        session->verify_result = entry->session.verify_result;
+        entry->used = ++cache->clock;
+        return 0;
+    }
+    return 1;
+}
+
+int ssl_session_cache_set(void *data, const mbedtls_ssl_session *session)
+{
+    ssl_session_cache_t *cache = data;
+    ssl_session_cache_entry_t *slot = NULL;
+
+    /* Replace the same session ID, else a free or expired slot, else LRU */
+    for(int i = 0; i < SSL_SESSION_CACHE_ENTRIES; i++) {
+        ssl_session_cache_entry_t *entry = &cache->entries[i];
+        if(entry->valid && entry_expired(entry))
+            entry->valid = false;
+        if(entry->valid && entry->session.id_len == session->id_len &&
+           !memcmp(entry->session.id, session->id, session->id_len)) {
+            slot = entry;
+            break;
+        }
+        if(!entry->valid) {
+            if(!slot || slot->valid)
+                slot = entry;
+        }
+        else if(!slot || (slot->valid && entry->used < slot->used)) {
+            slot = entry;
+        }
+    }
+
+    memcpy(&slot->session, session, sizeof(mbedtls_ssl_session));
+    /* Pointers into the live session aren't ours to keep */
+#if defined(MBEDTLS_X509_CRT_PARSE_C)
+    slot->session.peer_cert = NULL;
+#endif
+#if defined(MBEDTLS_SSL_SESSION_TICKETS) && defined(MBEDTLS_SSL_CLI_C)
+    slot->session.ticket = NULL;
+    slot->session.ticket_len = 0;
+#endif
+    slot->stored = xTaskGetTickCount();
+    slot->used = ++cache->clock;
+    slot->valid = true;
+    return 0;
+}
+
+void ssl_session_cache_clear(ssl_session_cache_t *cache)
+{
+    /* entries hold no allocations, so wiping them is enough (and also
+       clears the master secrets from RAM) */
+    ssl_session_cache_init(cache);
+}
+
+void ssl_saved_session_init(ssl_saved_session_t *saved)
+{
+    mbedtls_ssl_session_init(&saved->session);
+    saved->valid = false;
+}
+
+int ssl_saved_session_save(ssl_saved_session_t *saved, const mbedtls_ssl_context *ssl)
+{
+    ssl_saved_session_free(saved);
+    int ret = mbedtls_ssl_get_session(ssl, &saved->session);
+    saved->valid = (ret == 0);
+    return ret;
+}
+
+int ssl_saved_session_restore(const ssl_saved_session_t *saved, mbedtls_ssl_context *ssl)
+{
+    if(!saved->valid)
+        return 0;
+    return mbedtls_ssl_set_session(ssl, &saved->session);
+}
+
+void ssl_saved_session_free(ssl_saved_session_t *saved)
+{
+    /* also frees any copied peer certificate and session ticket */
+    mbedtls_ssl_session_free(&saved->session);
+    saved->valid = false;
+}
+
+#endif
@@ -0,0 +1,9 @@
+# Component makefile for extras/mdns
+
+# expected anyone using mdns includes it as 'mdns/mdns.h'
+INC_DIRS += $(mdns_ROOT)..
+
+# args for passing into compile rule generation
+mdns_SRC_DIR =  $(mdns_ROOT)
+
+$(eval $(call component_compile_rules,mdns))
@@ -0,0 +1,662 @@
+/* mDNS/DNS-SD responder, see mdns.h
+ *
+ * Based on RFC 6762 (mDNS), RFC 6763 (DNS-SD) and RFC 1035 for the
+ * message format.
+ *
+ * All state is only touched from tcpip_thread. Each record is kept
+ * encoded as it goes on the wire, with its names uncompressed, and
+ * names in queries are expanded into the same form to be compared.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "mdns.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include <lwip/udp.h>
+#include <lwip/igmp.h>
+#include <lwip/tcpip.h>
+#include <lwip/timers.h>
+#include <lwip/sys.h>
+#include <lwip/netif.h>
+#include <esp/hwrand.h>
+
+#if !LWIP_IGMP
+#error "extras/mdns needs LWIP_IGMP=1, to join the mDNS group"
+#endif
+
+#define TYPE_A      1
+#define TYPE_PTR   12
+#define TYPE_TXT   16
+#define TYPE_SRV   33
+#define TYPE_ANY  255
+
+#define CLASS_IN    1
+#define CLASS_ANY 255
+/* In responses the cache flush bit, in questions "unicast response" */
+#define CLASS_TOP 0x8000
+
+#define FLAG_QR     0x8000
+#define FLAG_OPCODE 0x7800
+#define FLAG_AA     0x0400
+
+#define HEADER_LEN 12
+#define NAME_MAX 256
+#define TX_MAX 1400
+
+#define LEGACY_TTL 10
+#define RATE_LIMIT_MS 1000
+#define ANNOUNCE_MS 1000
+
+#define MAX_RECORDS (1 + 4 * MDNS_MAX_SERVICES)
+#define HOST 0xff
+
+#define WANT_ANSWER     1
+#define WANT_ADDITIONAL 2
+
+typedef struct {
+    uint8_t *data;          /* name, type, class, TTL, rdlength, rdata */
+    uint16_t len;
+    uint16_t name_len;
+    uint16_t type;
+    uint8_t service;        /* index, or HOST */
+    bool shared;
+    uint8_t pending;        /* WANT_ bits, for the next multicast */
+    uint32_t multicast_ms;  /* when last sent to the group */
+} record_t;
+
+typedef struct {
+    uint8_t *buf;
+    size_t len, size;
+    size_t name_len;
+    bool overflow;
+} writer_t;
+
+static struct udp_pcb *pcb;
+static ip_addr_t group;
+static const char *hostname;
+static const mdns_service_t *services;
+static size_t service_count;
+
+static record_t records[MAX_RECORDS];
+static int record_count;
+static ip_addr_t records_addr;
+
+static int announcements;   /* still to send */
+static uint32_t announce_ms;
+static bool flush_scheduled;
+
+/* Scratch space for queries and names, all used in tcpip_thread only */
+static uint8_t rx[MDNS_RX_MAX];
+static uint8_t name[NAME_MAX], rdata_name[NAME_MAX];
+
+static void announce_tick(void *arg);
+
+static uint16_t rd16(const uint8_t *p)
+{
+    return p[0] << 8 | p[1];
+}
+
+static uint32_t rd32(const uint8_t *p)
+{
+    return (uint32_t)rd16(p) << 16 | rd16(p + 2);
+}
+
+static void wr16(uint8_t *p, uint16_t v)
+{
+    p[0] = v >> 8;
+    p[1] = v;
+}
+
+static void wr32(uint8_t *p, uint32_t v)
+{
+    wr16(p, v >> 16);
+    wr16(p + 2, v);
+}
+
+/* Records */
+
+static void put(writer_t *w, const void *data, size_t n)
+{
+    if (w->len + n > w->size) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, data, n);
+    w->len += n;
+}
+
+static void put_u16(writer_t *w, uint16_t v)
+{
+    uint8_t b[2];
+    wr16(b, v);
+    put(w, b, 2);
+}
+
+static void put_string(writer_t *w, const char *s, size_t max)
+{
+    size_t n = strlen(s);
+    uint8_t l = n;
+
+    if (n > max) {
+        w->overflow = true;
+        return;
+    }
+    put(w, &l, 1);
+    put(w, s, n);
+}
+
+/* A name from its labels, NULL terminated */
+static void put_name(writer_t *w, const char *const *labels)
+{
+    size_t start = w->len;
+
+    for (; *labels; labels++) {
+        if (!**labels)
+            w->overflow = true;
+        put_string(w, *labels, 63);
+    }
+    put(w, "", 1);
+    if (w->len - start > NAME_MAX - 1)
+        w->overflow = true;
+}
+
+static void begin_record(writer_t *w, const char *const *labels, uint16_t type, bool shared,
+                         uint32_t ttl)
+{
+    uint8_t b[8];
+
+    w->len = 0;
+    put_name(w, labels);
+    w->name_len = w->len;
+    wr16(b, type);
+    wr16(b + 2, CLASS_IN | (shared ? 0 : CLASS_TOP));
+    wr32(b + 4, ttl);
+    put(w, b, 8);
+    put_u16(w, 0);  /* rdlength, set by end_record() */
+}
+
+static bool end_record(writer_t *w, uint16_t type, uint8_t service, bool shared)
+{
+    if (w->overflow || record_count == MAX_RECORDS)
+        return false;
+    wr16(w->buf + w->name_len + 8, w->len - w->name_len - 10);
+
+    record_t *r = &records[record_count];
+    r->data = malloc(w->len);
+    if (!r->data)
+        return false;
+    memcpy(r->data, w->buf, w->len);
+    r->len = w->len;
+    r->name_len = w->name_len;
+    r->type = type;
+    r->service = service;
+    r->shared = shared;
+    r->pending = 0;
+    r->multicast_ms = sys_now() - RATE_LIMIT_MS;
+    record_count++;
+    return true;
+}
+
+static void free_records(void)
+{
+    for (int i = 0; i < record_count; i++)
+        free(records[i].data);
+    record_count = 0;
+}
+
+static bool build_records(void)
+{
+    writer_t w = { .size = 2 * NAME_MAX + 64 };
+    bool ok = true;
+
+    free_records();
+    records_addr.addr = netif_default ? netif_default->ip_addr.addr : 0;
+    w.buf = malloc(w.size);
+    if (!w.buf)
+        return false;
+
+    const char *host[] = { hostname, "local", NULL };
+    begin_record(&w, host, TYPE_A, false, MDNS_HOST_TTL);
+    put(&w, &records_addr.addr, 4);
+    ok = end_record(&w, TYPE_A, HOST, false);
+
+    for (size_t i = 0; ok && i < service_count; i++) {
+        const mdns_service_t *s = &services[i];
+        const char *type[] = { s->service, s->proto, "local", NULL };
+        const char *instance[] = { s->instance ? s->instance : hostname,
+                                   s->service, s->proto, "local", NULL };
+        const char *enumeration[] = { "_services", "_dns-sd", "_udp", "local", NULL };
+
+        begin_record(&w, type, TYPE_PTR, true, MDNS_SERVICE_TTL);
+        put_name(&w, instance);
+        ok = end_record(&w, TYPE_PTR, i, true);
+
+        begin_record(&w, instance, TYPE_SRV, false, MDNS_HOST_TTL);
+        put_u16(&w, 0);     /* priority */
+        put_u16(&w, 0);     /* weight */
+        put_u16(&w, s->port);
+        put_name(&w, host);
+        ok = ok && end_record(&w, TYPE_SRV, i, false);
+
+        begin_record(&w, instance, TYPE_TXT, false, MDNS_SERVICE_TTL);
+        if (s->txt && s->txt[0]) {
+            for (const char **t = s->txt; *t; t++)
+                put_string(&w, *t, 255);
+        } else {
+            put(&w, "", 1);     /* no TXT is one empty string */
+        }
+        ok = ok && end_record(&w, TYPE_TXT, i, false);
+
+        begin_record(&w, enumeration, TYPE_PTR, true, MDNS_SERVICE_TTL);
+        put_name(&w, type);
+        ok = ok && end_record(&w, TYPE_PTR, i, true);
+    }
+
+    free(w.buf);
+    if (!ok)
+        free_records();
+    return ok;
+}
+
+static uint32_t record_ttl(const record_t *r)
+{
+    return rd32(r->data + r->name_len + 4);
+}
+
+static const uint8_t *record_rdata(const record_t *r, size_t *len)
+{
+    *len = r->len - r->name_len - 10;
+    return r->data + r->name_len + 10;
+}
+
+/* Messages */
+
+/* Expand the name at *offset in 'msg' into 'out', following
+   compression pointers, and move *offset past it. Returns the length,
+   or -1 if it's malformed. */
+static int read_name(const uint8_t *msg, size_t len, size_t *offset, uint8_t *out)
+{
+    size_t off = *offset;
+    int n = 0, jumps = 0;
+    bool jumped = false;
+
+    while (1) {
+        if (off >= len)
+            return -1;
+        uint8_t l = msg[off];
+        if ((l & 0xc0) == 0xc0) {
+            if (off + 1 >= len || ++jumps > 16)
+                return -1;
+            if (!jumped)
+                *offset = off + 2;
+            jumped = true;
+            off = (l & 0x3f) << 8 | msg[off + 1];
+            continue;
+        }
+        if (l & 0xc0 || off + 1 + l > len || n + 1 + l > NAME_MAX)
+            return -1;
+        memcpy(out + n, msg + off, 1 + l);
+        n += 1 + l;
+        off += 1 + l;
+        if (!l)
+            break;
+    }
+    if (!jumped)
+        *offset = off;
+    return n;
+}
+
+/* Names are compared ignoring ASCII case. The length bytes are under
+   'A', so they can go through tolower() too. */
+static bool name_eq(const uint8_t *a, size_t alen, const uint8_t *b, size_t blen)
+{
+    if (alen != blen)
+        return false;
+    for (size_t i = 0; i < alen; i++) {
+        if (tolower(a[i]) != tolower(b[i]))
+            return false;
+    }
+    return true;
+}
+
+static void want_record(uint8_t *want, int i)
+{
+    const record_t *r = &records[i];
+
+    want[i] |= WANT_ANSWER;
+    /* What the querier will look up next: a service PTR's SRV, TXT and
+       the host's address; an SRV's address. (build_records() puts each
+       service's PTR first, its enumeration PTR last.) */
+    bool service_ptr = r->type == TYPE_PTR && i == 1 + 4 * r->service;
+    if (!service_ptr && r->type != TYPE_SRV)
+        return;
+    for (int j = 0; j < record_count; j++) {
+        const record_t *o = &records[j];
+        bool related = o->type == TYPE_A
+            || (service_ptr && o->service == r->service
+                && (o->type == TYPE_SRV || o->type == TYPE_TXT));
+        if (related)
+            want[j] |= WANT_ADDITIONAL;
+    }
+}
+
+/* Does the known answer at 'rdata' match record 'r'? */
+static bool rdata_eq(const record_t *r, size_t off, size_t rdlen, size_t len)
+{
+    size_t our_len;
+    const uint8_t *ours = record_rdata(r, &our_len);
+
+    if (r->type == TYPE_PTR) {
+        size_t o = off;
+        int n = read_name(rx, len, &o, rdata_name);
+        return n >= 0 && name_eq(rdata_name, n, ours, our_len);
+    }
+    return rdlen == our_len && !memcmp(rx + off, ours, our_len);
+}
+
+/* Send the wanted records (and 'question', for legacy replies). Those
+   sent are left set in 'want', the others cleared. Returns false if
+   there were no answers to send. */
+static bool send_records(uint8_t *want, const ip_addr_t *addr, u16_t port, uint16_t id,
+                         const uint8_t *question, size_t question_len, bool legacy, bool goodbye)
+{
+    size_t len = HEADER_LEN + question_len;
+    uint16_t answers = 0, additionals = 0;
+
+    for (int i = 0; i < record_count; i++) {
+        if (!want[i])
+            continue;
+        if ((records[i].type == TYPE_A && ip_addr_isany(&records_addr))
+            || len + records[i].len > TX_MAX) {
+            want[i] = 0;
+            continue;
+        }
+        len += records[i].len;
+        want[i] = want[i] & WANT_ANSWER ? WANT_ANSWER : WANT_ADDITIONAL;
+        if (want[i] == WANT_ANSWER)
+            answers++;
+        else
+            additionals++;
+    }
+    if (!answers)
+        return false;
+
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+    if (!p)
+        return false;
+    uint8_t *out = p->payload;
+    wr16(out, id);
+    wr16(out + 2, FLAG_QR | FLAG_AA);
+    wr16(out + 4, question_len ? 1 : 0);
+    wr16(out + 6, answers);
+    wr16(out + 8, 0);
+    wr16(out + 10, additionals);
+    if (question_len)
+        memcpy(out + HEADER_LEN, question, question_len);
+    out += HEADER_LEN + question_len;
+
+    /* Answers, then additionals */
+    for (int pass = WANT_ANSWER; pass <= WANT_ADDITIONAL; pass++) {
+        for (int i = 0; i < record_count; i++) {
+            const record_t *r = &records[i];
+            if (want[i] != pass)
+                continue;
+            memcpy(out, r->data, r->len);
+            if (legacy) {
+                wr16(out + r->name_len + 2, CLASS_IN);
+                wr32(out + r->name_len + 4, LEGACY_TTL);
+            } else if (goodbye) {
+                wr32(out + r->name_len + 4, 0);
+            }
+            out += r->len;
+        }
+    }
+    udp_sendto(pcb, p, (ip_addr_t *)addr, port);
+    pbuf_free(p);
+    return true;
+}
+
+static void send_multicast(uint8_t *want, bool force, bool goodbye)
+{
+    uint32_t now = sys_now();
+
+    for (int i = 0; i < record_count; i++) {
+        if (!force && now - records[i].multicast_ms < RATE_LIMIT_MS)
+            want[i] = 0;
+    }
+    if (!send_records(want, &group, MDNS_PORT, 0, NULL, 0, false, goodbye))
+        return;
+    for (int i = 0; i < record_count; i++) {
+        if (want[i])
+            records[i].multicast_ms = now;
+    }
+}
+
+static void flush_pending(void *arg)
+{
+    uint8_t want[MAX_RECORDS];
+
+    flush_scheduled = false;
+    for (int i = 0; i < record_count; i++) {
+        want[i] = records[i].pending;
+        records[i].pending = 0;
+    }
+    send_multicast(want, false, false);
+}
+
+static void start_announcing(void)
+{
+    sys_untimeout(announce_tick, NULL);
+    announcements = MDNS_ANNOUNCE_COUNT;
+    announce_ms = ANNOUNCE_MS;
+    announce_tick(NULL);
+}
+
+/* Rebuild and announce the records if the address has changed */
+static bool check_address(void)
+{
+    uint32_t addr = netif_default ? netif_default->ip_addr.addr : 0;
+
+    if (addr == records_addr.addr || !build_records())
+        return false;
+    start_announcing();
+    return true;
+}
+
+static void announce_tick(void *arg)
+{
+    uint8_t want[MAX_RECORDS];
+
+    if (check_address())
+        return;
+    if (ip_addr_isany(&records_addr)) {
+        /* Nothing to announce until there's an address */
+        sys_timeout(ANNOUNCE_MS, announce_tick, NULL);
+        return;
+    }
+    memset(want, WANT_ANSWER, sizeof(want));
+    send_multicast(want, true, false);
+    if (--announcements > 0) {
+        sys_timeout(announce_ms, announce_tick, NULL);
+        announce_ms *= 2;
+    }
+}
+
+static void mdns_recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, ip_addr_t *addr, u16_t port)
+{
+    size_t len = pbuf_copy_partial(p, rx, sizeof(rx), 0);
+    uint8_t want[MAX_RECORDS];
+    size_t off = HEADER_LEN;
+    size_t question_off = 0, question_len = 0;
+    bool legacy = port != MDNS_PORT, unicast = legacy, shared = false;
+
+    pbuf_free(p);
+    if (len < HEADER_LEN || rd16(rx + 2) & (FLAG_QR | FLAG_OPCODE))
+        return;
+    check_address();
+    memset(want, 0, sizeof(want));
+
+    uint16_t questions = rd16(rx + 4), known = rd16(rx + 6);
+    for (int q = 0; q < questions; q++) {
+        size_t start = off;
+        int n = read_name(rx, len, &off, name);
+        if (n < 0 || off + 4 > len)
+            return;
+        uint16_t qtype = rd16(rx + off), qclass = rd16(rx + off + 2);
+        off += 4;
+        if (q == 0 && off - start == n + 4u) {
+            /* Echoed in legacy replies, if it isn't compressed */
+            question_off = start;
+            question_len = off - start;
+        }
+        if ((qclass & ~CLASS_TOP) != CLASS_IN && (qclass & ~CLASS_TOP) != CLASS_ANY)
+            continue;
+        if (qclass & CLASS_TOP)
+            unicast = true;
+        for (int i = 0; i < record_count; i++) {
+            const record_t *r = &records[i];
+            if ((qtype == r->type || qtype == TYPE_ANY)
+                && name_eq(name, n, r->data, r->name_len))
+                want_record(want, i);
+        }
+    }
+
+    /* Known answers */
+    for (int a = 0; a < known; a++) {
+        int n = read_name(rx, len, &off, name);
+        if (n < 0 || off + 10 > len)
+            break;
+        uint16_t type = rd16(rx + off);
+        uint32_t ttl = rd32(rx + off + 4);
+        size_t rdlen = rd16(rx + off + 8);
+        off += 10;
+        if (off + rdlen > len)
+            break;
+        for (int i = 0; i < record_count; i++) {
+            const record_t *r = &records[i];
+            if (want[i] && r->type == type && ttl >= record_ttl(r) / 2
+                && name_eq(name, n, r->data, r->name_len) && rdata_eq(r, off, rdlen, len))
+                want[i] = 0;
+        }
+        off += rdlen;
+    }
+
+    if (unicast) {
+        send_records(want, addr, port, legacy ? rd16(rx) : 0, legacy ? rx + question_off : NULL,
+                     legacy ? question_len : 0, legacy, false);
+        return;
+    }
+    for (int i = 0; i < record_count; i++) {
+        records[i].pending |= want[i];
+        if (want[i] & WANT_ANSWER && records[i].shared)
+            shared = true;
+    }
+    if (flush_scheduled)
+        return;
+    if (shared) {
+        /* Shared answers go out after 20-120ms, as other responders
+           may be answering too */
+        flush_scheduled = true;
+        sys_timeout(20 + hwrand() % 101, flush_pending, NULL);
+    } else {
+        flush_pending(NULL);
+    }
+}
+
+/* Starting and stopping, in tcpip_thread */
+
+typedef struct {
+    sys_sem_t done;
+    bool ok;
+} call_t;
+
+static void stop_cb(void *arg)
+{
+    if (pcb) {
+        if (!ip_addr_isany(&records_addr)) {
+            uint8_t want[MAX_RECORDS];
+
+            memset(want, WANT_ANSWER, sizeof(want));
+            send_multicast(want, true, true);
+        }
+        igmp_leavegroup(IP_ADDR_ANY, &group);
+        udp_remove(pcb);
+        pcb = NULL;
+    }
+    sys_untimeout(announce_tick, NULL);
+    sys_untimeout(flush_pending, NULL);
+    flush_scheduled = false;
+    free_records();
+    records_addr.addr = 0;
+    if (arg)
+        sys_sem_signal((sys_sem_t *)arg);
+}
+
+static void start_cb(void *arg)
+{
+    call_t *call = arg;
+
+    IP4_ADDR(&group, 224, 0, 0, 251);
+    pcb = udp_new();
+    call->ok = pcb && udp_bind(pcb, IP_ADDR_ANY, MDNS_PORT) == ERR_OK && build_records();
+    if (call->ok) {
+        /* RFC 6762 section 11: sent with an IP TTL of 255 */
+        pcb->ttl = 255;
+        igmp_joingroup(IP_ADDR_ANY, &group);
+        udp_recv(pcb, mdns_recv, NULL);
+        start_announcing();
+    } else if (pcb) {
+        udp_remove(pcb);
+        pcb = NULL;
+    }
+    sys_sem_signal(&call->done);
+}
+
+static void announce_cb(void *arg)
+{
+    if (pcb)
+        start_announcing();
+}
+
+bool mdns_start(const char *host, const mdns_service_t *s, size_t count)
+{
+    call_t call;
+
+    if (count > MDNS_MAX_SERVICES)
+        return false;
+    mdns_stop();
+    hostname = host;
+    services = s;
+    service_count = count;
+
+    if (sys_sem_new(&call.done, 0) != ERR_OK)
+        return false;
+    call.ok = false;
+    if (tcpip_callback(start_cb, &call) == ERR_OK)
+        sys_sem_wait(&call.done);
+    sys_sem_free(&call.done);
+    return call.ok;
+}
+
+void mdns_stop(void)
+{
+    sys_sem_t done;
+
+    if (sys_sem_new(&done, 0) != ERR_OK) {
+        tcpip_callback(stop_cb, NULL);
+        return;
+    }
+    if (tcpip_callback(stop_cb, &done) == ERR_OK)
+        sys_sem_wait(&done);
+    sys_sem_free(&done);
+}
+
+void mdns_announce(void)
+{
+    tcpip_callback(announce_cb, NULL);
+}
@@ -0,0 +1,101 @@
+/* mDNS (RFC 6762) and DNS-SD (RFC 6763) responder on the lwIP raw UDP API
+ *
+ * Answers "<hostname>.local" with the address of the default interface,
+ * and advertises a table of services, so the device can be found by
+ * name, or browsed for (avahi-browse, dns-sd -B, a phone's service
+ * browser), with no discovery broadcasts of its own:
+ *
+ *   static const char *http_txt[] = { "path=/", NULL };
+ *   static const mdns_service_t services[] = {
+ *       { .service = "_http", .proto = "_tcp", .port = 80, .txt = http_txt },
+ *   };
+ *   ...
+ *   mdns_start("kitchen", services, 1);
+ *
+ * It all runs in tcpip_thread, from the UDP receive callback and lwIP's
+ * timers, so there's no task or stack of its own. The records are
+ * encoded once (again when the address changes), and a response is the
+ * records a query asks for copied into a pbuf.
+ *
+ * Answers the querier already has with at least half their TTL left
+ * (known answers, RFC 6762 section 7.1) are left out, as are records
+ * multicast in the last second. Answers to shared records (the PTRs
+ * browsers ask for) are delayed by 20-120ms and sent together, as the
+ * RFC asks. On start and on mdns_announce() all the records are
+ * announced MDNS_ANNOUNCE_COUNT times, a second apart and then doubling.
+ *
+ * Queries asking for a unicast reply (QU) get one, and queries from a
+ * port other than 5353 (simple resolvers, RFC 6762 section 6.7) get a
+ * unicast reply with the query's ID and short TTLs.
+ *
+ * Not done: probing for name conflicts (the hostname and service
+ * instance names are taken as given), IPv6, and known answer lists
+ * continued in another packet (the TC bit).
+ *
+ * Needs LWIP_IGMP=1 (EXTRA_CFLAGS = -DLWIP_IGMP=1) to receive the mDNS
+ * multicast group. The group is joined on the interfaces there are at
+ * mdns_start(), so start it once the station has connected.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _MDNS_H
+#define _MDNS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#define MDNS_PORT 5353
+
+#ifndef MDNS_MAX_SERVICES
+#define MDNS_MAX_SERVICES 4
+#endif
+
+/* TTLs of the host's address and the services' SRV records, and of
+   the other service records (PTR, TXT), as RFC 6762 section 10 has */
+#ifndef MDNS_HOST_TTL
+#define MDNS_HOST_TTL 120
+#endif
+#ifndef MDNS_SERVICE_TTL
+#define MDNS_SERVICE_TTL 4500
+#endif
+
+#ifndef MDNS_ANNOUNCE_COUNT
+#define MDNS_ANNOUNCE_COUNT 3
+#endif
+
+/* Longest query looked at; known answers past this are ignored */
+#ifndef MDNS_RX_MAX
+#define MDNS_RX_MAX 512
+#endif
+
+typedef struct {
+    const char *instance;   /* "Kitchen sensor", NULL for the hostname */
+    const char *service;    /* "_http" */
+    const char *proto;      /* "_tcp" or "_udp" */
+    uint16_t port;
+    const char **txt;       /* "key=value" strings, NULL terminated, or NULL */
+} mdns_service_t;
+
+/* Start answering for "<hostname>.local" and 'services' (which, like
+   the strings they point to, must stay valid until mdns_stop()), and
+   announce them. Returns false if out of memory, or a name is too long. */
+bool mdns_start(const char *hostname, const mdns_service_t *services, size_t count);
+
+void mdns_stop(void);
+
+/* Announce the records again, after reconnecting for instance. A new
+   address is noticed by itself, on the next query. */
+void mdns_announce(void);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _MDNS_H */
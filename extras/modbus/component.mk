@@ -0,0 +1,9 @@
+# Component makefile for extras/modbus
+
+# expected anyone using modbus includes it as 'modbus/modbus.h'
+INC_DIRS += $(modbus_ROOT)..
+
+# args for passing into compile rule generation
+modbus_SRC_DIR =  $(modbus_ROOT)
+
+$(eval $(call component_compile_rules,modbus))
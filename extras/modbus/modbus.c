@@ -0,0 +1,411 @@
+/* Modbus request handling and the RTU server, see modbus.h
+ *
+ * The UART's RX callback hands frame ends (its count of bytes received)
+ * to the RTU task through a queue: on the RX timeout, set to the
+ * inter-frame gap, or when an hrtimer started after an RXFIFO-full
+ * interrupt sees the gap go by with the FIFO still empty. Everything
+ * between the previous end and this one is a frame.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <string.h>
+#include <stdio.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <queue.h>
+#include <semphr.h>
+
+#include <esp/uart.h>
+#include <esp/gpio.h>
+#include <esp/hrtimer.h>
+#include "common_macros.h"
+#include "espressif/esp_misc.h"
+
+#include "modbus.h"
+
+#define RTU_MAX 256       /* unit, PDU, CRC */
+#define RTU_MIN 4
+#define FRAME_QUEUE_LEN 4
+
+static xSemaphoreHandle lock;
+/* modbus_tcp.c counts its own */
+modbus_stats_t _modbus_stats;
+
+static struct {
+    modbus_config_t config;
+    const modbus_map_t *map;
+    xQueueHandle frames;
+    hrtimer_t gap_timer;
+    uint32_t gap_us;
+    uint32_t byte_us;
+    volatile uint32_t last_count;   /* at the last RX callback */
+    volatile uint32_t last_end;     /* last frame end queued */
+    uint32_t consumed;              /* from the RX ring, in its count */
+    uint8_t buf[RTU_MAX];
+} rtu;
+
+uint16_t modbus_crc16(const uint8_t *data, size_t len, uint16_t crc)
+{
+    while (len--) {
+        crc ^= *data++;
+        for (int i = 0; i < 8; i++)
+            crc = (crc & 1) ? (crc >> 1) ^ 0xa001 : crc >> 1;
+    }
+    return crc;
+}
+
+static inline uint16_t get16(const uint8_t *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+static inline void put16(uint8_t *p, uint16_t v)
+{
+    p[0] = v >> 8;
+    p[1] = v;
+}
+
+/* Check a request's address range against the protocol's count limit */
+static uint8_t check_range(uint16_t addr, uint16_t count, uint16_t max)
+{
+    if (count < 1 || count > max)
+        return MODBUS_EX_ILLEGAL_VALUE;
+    if ((uint32_t)addr + count > 0x10000)
+        return MODBUS_EX_ILLEGAL_ADDRESS;
+    return 0;
+}
+
+/* Handle 'req', leaving the response's data in 'resp' after the
+   function code. Returns an exception code, or 0 with *resp_len set. */
+static uint8_t process(const modbus_map_t *map, const uint8_t *req, size_t len,
+                       uint8_t *resp, size_t *resp_len)
+{
+    uint8_t fc = req[0];
+    uint16_t addr, count;
+    uint8_t ex;
+
+    switch (fc) {
+    case 0x01:  /* read coils */
+    case 0x02:  /* read discrete inputs */
+        if (len != 5)
+            return MODBUS_EX_ILLEGAL_VALUE;
+        if (!map->read_bits)
+            return MODBUS_EX_ILLEGAL_FUNCTION;
+        addr = get16(req + 1);
+        count = get16(req + 3);
+        if ((ex = check_range(addr, count, 2000)))
+            return ex;
+        resp[1] = (count + 7) / 8;
+        memset(resp + 2, 0, resp[1]);
+        ex = map->read_bits(fc == 0x01 ? MODBUS_COILS : MODBUS_DISCRETE_INPUTS,
+                            addr, count, resp + 2, map->arg);
+        *resp_len = 2 + resp[1];
+        return ex;
+
+    case 0x03:  /* read holding registers */
+    case 0x04:  /* read input registers */
+        if (len != 5)
+            return MODBUS_EX_ILLEGAL_VALUE;
+        if (!map->read_registers)
+            return MODBUS_EX_ILLEGAL_FUNCTION;
+        addr = get16(req + 1);
+        count = get16(req + 3);
+        if ((ex = check_range(addr, count, 125)))
+            return ex;
+        {
+            uint16_t regs[125];
+            ex = map->read_registers(fc == 0x03 ? MODBUS_HOLDING_REGISTERS : MODBUS_INPUT_REGISTERS,
+                                     addr, count, regs, map->arg);
+            if (ex)
+                return ex;
+            resp[1] = count * 2;
+            for (int i = 0; i < count; i++)
+                put16(resp + 2 + i * 2, regs[i]);
+        }
+        *resp_len = 2 + count * 2;
+        return 0;
+
+    case 0x05:  /* write single coil */
+        if (len != 5)
+            return MODBUS_EX_ILLEGAL_VALUE;
+        if (!map->write_coils)
+            return MODBUS_EX_ILLEGAL_FUNCTION;
+        {
+            uint16_t value = get16(req + 3);
+            uint8_t bit = value == 0xff00;
+            if (value != 0xff00 && value != 0x0000)
+                return MODBUS_EX_ILLEGAL_VALUE;
+            if ((ex = map->write_coils(get16(req + 1), 1, &bit, map->arg)))
+                return ex;
+        }
+        memcpy(resp + 1, req + 1, 4);   /* echoed */
+        *resp_len = 5;
+        return 0;
+
+    case 0x06:  /* write single register */
+        if (len != 5)
+            return MODBUS_EX_ILLEGAL_VALUE;
+        if (!map->write_registers)
+            return MODBUS_EX_ILLEGAL_FUNCTION;
+        {
+            uint16_t value = get16(req + 3);
+            if ((ex = map->write_registers(get16(req + 1), 1, &value, map->arg)))
+                return ex;
+        }
+        memcpy(resp + 1, req + 1, 4);
+        *resp_len = 5;
+        return 0;
+
+    case 0x0f:  /* write multiple coils */
+        if (len < 6)
+            return MODBUS_EX_ILLEGAL_VALUE;
+        if (!map->write_coils)
+            return MODBUS_EX_ILLEGAL_FUNCTION;
+        addr = get16(req + 1);
+        count = get16(req + 3);
+        if ((ex = check_range(addr, count, 1968)))
+            return ex;
+        if (req[5] != (count + 7) / 8 || len != 6 + req[5])
+            return MODBUS_EX_ILLEGAL_VALUE;
+        if ((ex = map->write_coils(addr, count, req + 6, map->arg)))
+            return ex;
+        memcpy(resp + 1, req + 1, 4);
+        *resp_len = 5;
+        return 0;
+
+    case 0x10:  /* write multiple registers */
+        if (len < 6)
+            return MODBUS_EX_ILLEGAL_VALUE;
+        if (!map->write_registers)
+            return MODBUS_EX_ILLEGAL_FUNCTION;
+        addr = get16(req + 1);
+        count = get16(req + 3);
+        if ((ex = check_range(addr, count, 123)))
+            return ex;
+        if (req[5] != count * 2 || len != 6 + req[5])
+            return MODBUS_EX_ILLEGAL_VALUE;
+        {
+            uint16_t regs[123];
+            for (int i = 0; i < count; i++)
+                regs[i] = get16(req + 6 + i * 2);
+            if ((ex = map->write_registers(addr, count, regs, map->arg)))
+                return ex;
+        }
+        memcpy(resp + 1, req + 1, 4);
+        *resp_len = 5;
+        return 0;
+
+    default:
+        return MODBUS_EX_ILLEGAL_FUNCTION;
+    }
+}
+
+size_t modbus_process(const modbus_map_t *map, const uint8_t *req, size_t len, uint8_t *resp)
+{
+    size_t resp_len = 0;
+    uint8_t ex;
+
+    if (lock)
+        xSemaphoreTake(lock, portMAX_DELAY);
+    if (len < 1 || len > MODBUS_PDU_MAX)
+        ex = MODBUS_EX_ILLEGAL_VALUE;
+    else
+        ex = process(map, req, len, resp, &resp_len);
+    resp[0] = len ? req[0] : 0;
+    if (ex) {
+        resp[0] |= 0x80;
+        resp[1] = ex;
+        resp_len = 2;
+        _modbus_stats.exceptions++;
+    }
+    if (lock)
+        xSemaphoreGive(lock);
+    return resp_len;
+}
+
+void modbus_get_stats(modbus_stats_t *out)
+{
+    *out = _modbus_stats;
+}
+
+/* RTU */
+
+static bool IRAM queue_end(uint32_t count)
+{
+    portBASE_TYPE woken = pdFALSE;
+
+    if (count == rtu.last_end)
+        return false;
+    rtu.last_end = count;
+    xQueueSendToBackFromISR(rtu.frames, &count, &woken);
+    return woken;
+}
+
+/* The gap went by after an RXFIFO-full interrupt: if nothing has come
+   since (which would be in the FIFO, or have called rx_callback()), the
+   frame ended with the bytes that interrupt took. */
+static void IRAM gap_expired(hrtimer_t *timer, void *arg)
+{
+    if (FIELD2VAL(UART_STATUS_RXFIFO_COUNT, UART(rtu.config.uart).STATUS))
+        return;
+    if (queue_end(rtu.last_count))
+        portYIELD();
+}
+
+static bool IRAM rx_callback(int uart_num, uint32_t rx_count, bool idle, void *arg)
+{
+    rtu.last_count = rx_count;
+    if (idle) {
+        hrtimer_stop(&rtu.gap_timer);
+        return queue_end(rx_count);
+    }
+    /* A byte may be on its way in already */
+    hrtimer_start(&rtu.gap_timer, rtu.gap_us + rtu.byte_us, 0);
+    return false;
+}
+
+static void consume(size_t len)
+{
+    uart_rx_consume(rtu.config.uart, len);
+    rtu.consumed += len;
+}
+
+/* Return where the 'len' byte frame at the start of the RX ring is:
+   in the ring, or if it wraps round the ring's end, copied out into
+   rtu.buf (and consumed). */
+static const uint8_t *frame_get(size_t len)
+{
+    const uint8_t *p;
+    size_t n = uart_rx_peek(rtu.config.uart, &p, 0);
+
+    if (n >= len)
+        return p;
+    memcpy(rtu.buf, p, n);
+    consume(n);
+    for (size_t got = n; got < len; got += n) {
+        n = uart_rx_peek(rtu.config.uart, &p, 0);
+        if (!n)
+            return NULL;
+        if (n > len - got)
+            n = len - got;
+        memcpy(rtu.buf + got, p, n);
+        consume(n);
+    }
+    return rtu.buf;
+}
+
+static void rtu_reply(const uint8_t *frame, size_t len)
+{
+    int uart = rtu.config.uart;
+
+    if (rtu.config.de_gpio >= 0)
+        gpio_write(rtu.config.de_gpio, 1);
+    uart_write(uart, frame, len);
+    uart_tx_flush(uart);
+    /* The FIFO is empty, the last byte still in the shift register */
+    sdk_os_delay_us(rtu.byte_us);
+    if (rtu.config.de_gpio >= 0)
+        gpio_write(rtu.config.de_gpio, 0);
+}
+
+static void rtu_task(void *pvParameters)
+{
+    uint8_t resp[RTU_MAX];
+
+    while (1) {
+        uint32_t end;
+        xQueueReceive(rtu.frames, &end, portMAX_DELAY);
+
+        size_t len = end - rtu.consumed;
+        const uint8_t *frame = NULL;
+        if (len < RTU_MIN || len > RTU_MAX)
+            _modbus_stats.rtu_bad_frames++;
+        else if (!(frame = frame_get(len)))
+            _modbus_stats.rtu_bad_frames++;
+        else if (modbus_crc16(frame, len, 0xffff) != 0) {
+            /* Taken over the CRC as well, a good frame's comes to 0 */
+            _modbus_stats.rtu_crc_errors++;
+            frame = NULL;
+        } else if (frame[0] != rtu.config.unit && frame[0] != 0) {
+            _modbus_stats.rtu_other_units++;
+            frame = NULL;
+        }
+        if (!frame) {
+            consume(end - rtu.consumed);
+            continue;
+        }
+
+        _modbus_stats.rtu_frames++;
+        size_t n = modbus_process(rtu.map, frame + 1, len - 3, resp + 1);
+        bool broadcast = frame[0] == 0;
+        /* Finished with 'frame', if it's in the ring */
+        consume(end - rtu.consumed);
+        if (broadcast)
+            continue;
+        resp[0] = rtu.config.unit;
+        uint16_t crc = modbus_crc16(resp, n + 1, 0xffff);
+        resp[n + 1] = crc;
+        resp[n + 2] = crc >> 8;
+        rtu_reply(resp, n + 3);
+    }
+}
+
+static bool rtu_start(const modbus_config_t *config, const modbus_map_t *map)
+{
+    int uart = config->uart;
+    uint32_t conf;
+
+    rtu.config = *config;
+    rtu.map = map;
+    rtu.byte_us = ((config->parity == 'N' ? 10 : 11) + config->stop_bits - 1) * 1000000 / config->baud + 1;
+    /* 3.5 characters, or a fixed 1750us above 19200 baud */
+    rtu.gap_us = config->baud > 19200 ? 1750 : rtu.byte_us * 7 / 2;
+
+    rtu.frames = xQueueCreate(FRAME_QUEUE_LEN, sizeof(uint32_t));
+    if (!rtu.frames)
+        return false;
+    hrtimer_init(&rtu.gap_timer, gap_expired, NULL);
+
+    uart_set_baud(uart, config->baud);
+    conf = UART(uart).CONF0 & ~(UART_CONF0_PARITY_ENABLE | UART_CONF0_PARITY);
+    if (config->parity != 'N')
+        conf |= UART_CONF0_PARITY_ENABLE | (config->parity == 'O' ? UART_CONF0_PARITY : 0);
+    conf = SET_FIELD_M(conf, UART_CONF0_STOP_BITS, config->stop_bits == 2 ? 3 : 1);
+    conf = SET_FIELD_M(conf, UART_CONF0_BYTE_LEN, 3);
+    UART(uart).CONF0 = conf;
+
+    if (config->de_gpio >= 0) {
+        gpio_enable(config->de_gpio, GPIO_OUTPUT);
+        gpio_write(config->de_gpio, 0);
+    }
+
+    /* The RX timeout counts byte times */
+    uint32_t timeout = (rtu.gap_us + rtu.byte_us - 1) / rtu.byte_us;
+    if (timeout < 4)
+        timeout = 4;
+    if (timeout > UART_CONF1_RX_TIMEOUT_THRESHOLD_M)
+        timeout = UART_CONF1_RX_TIMEOUT_THRESHOLD_M;
+    uart_set_rx_thresholds(uart, UART_DEFAULT_RX_FULL_THRESHOLD, timeout);
+    uart_set_rx_callback(uart, rx_callback, NULL);
+    if (!uart_rx_buffer_enable(uart, config->rx_ring))
+        return false;
+    if (!uart_tx_buffered(uart) && !uart_tx_buffer_enable(uart, RTU_MAX, UART_TX_BLOCK))
+        return false;
+
+    return xTaskCreate(rtu_task, (signed char *)"modbus_rtu", 384, NULL,
+                       config->priority, NULL) == pdPASS;
+}
+
+bool modbus_start(const modbus_config_t *config, const modbus_map_t *map)
+{
+    if (!lock && !(lock = xSemaphoreCreateMutex()))
+        return false;
+    if (config->uart >= 0 && !rtu_start(config, map))
+        return false;
+    if (config->tcp_port && !modbus_tcp_start(config->tcp_port, config->priority, map))
+        return false;
+    return true;
+}
@@ -0,0 +1,132 @@
+/* Modbus RTU and Modbus TCP server
+ *
+ * Serves one register map (coils, discrete inputs, holding and input
+ * registers, through the callbacks in a modbus_map_t) as a Modbus RTU
+ * slave on a UART, and to Modbus TCP clients, so a device on an RS-485
+ * bus can be read over the network the same way.
+ *
+ * RTU frames end on 3.5 characters of silence (1750us above 19200
+ * baud), far below the 10ms tick. The UART's RX timeout, set to that
+ * gap, marks the end of a frame from the receive interrupt (see
+ * uart_set_rx_callback()), and when the last byte emptied the FIFO
+ * (so no timeout comes) an hrtimer times the gap instead. Frames are
+ * checked and parsed where they are in the UART's RX ring, unless they
+ * wrap around its end.
+ *
+ * Requests from either side are handled one at a time (the callbacks
+ * are never called concurrently), in the RTU task or in the TCP task.
+ * Function codes 1-6, 15 and 16 are served; others get an ILLEGAL
+ * FUNCTION exception, as do tables with no callback.
+ *
+ * Modbus TCP takes up to MODBUS_TCP_MAX_CLIENTS connections at once in
+ * one task (netpoll.h). Requests are answered whatever their unit id:
+ * TCP requests aren't forwarded onto the RTU bus, where this device is
+ * a slave.
+ *
+ * The UART's buffered RX and TX are turned on (and owned) by the
+ * server. On UART0 that means printf output goes down the bus too.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _MODBUS_H
+#define _MODBUS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#define MODBUS_TCP_PORT 502
+
+/* Longest PDU (function code and data) */
+#define MODBUS_PDU_MAX 253
+
+#ifndef MODBUS_TCP_MAX_CLIENTS
+#define MODBUS_TCP_MAX_CLIENTS 4
+#endif
+
+/* Exception codes, returned by the map's callbacks (0 for success) */
+#define MODBUS_EX_ILLEGAL_FUNCTION 0x01
+#define MODBUS_EX_ILLEGAL_ADDRESS  0x02
+#define MODBUS_EX_ILLEGAL_VALUE    0x03
+#define MODBUS_EX_DEVICE_FAILURE   0x04
+
+typedef enum {
+    MODBUS_COILS,
+    MODBUS_DISCRETE_INPUTS,
+    MODBUS_HOLDING_REGISTERS,
+    MODBUS_INPUT_REGISTERS,
+} modbus_table_t;
+
+typedef struct {
+    /* Coils or discrete inputs 'addr' to 'addr + count - 1' into 'bits',
+       packed as on the wire: the first in bit 0 of bits[0]. The bytes
+       are zeroed first. */
+    uint8_t (*read_bits)(modbus_table_t table, uint16_t addr, uint16_t count,
+                         uint8_t *bits, void *arg);
+    /* Coils, packed the same way */
+    uint8_t (*write_coils)(uint16_t addr, uint16_t count, const uint8_t *bits, void *arg);
+    /* Holding or input registers */
+    uint8_t (*read_registers)(modbus_table_t table, uint16_t addr, uint16_t count,
+                              uint16_t *regs, void *arg);
+    uint8_t (*write_registers)(uint16_t addr, uint16_t count, const uint16_t *regs, void *arg);
+    void *arg;
+} modbus_map_t;
+
+typedef struct {
+    int uart;               /* -1 for TCP only */
+    uint32_t baud;
+    char parity;            /* 'N', 'E' (the Modbus default) or 'O' */
+    uint8_t stop_bits;      /* 1 or 2 */
+    uint8_t unit;           /* RTU slave address, 1-247 */
+    int8_t de_gpio;         /* RS-485 driver enable, high to send, or -1 */
+    uint16_t rx_ring;       /* UART RX ring, bytes (a power of two) */
+    uint16_t tcp_port;      /* 0 for RTU only */
+    uint8_t priority;       /* of the server's tasks */
+} modbus_config_t;
+
+#define MODBUS_DEFAULT_CONFIG { \
+        .uart = 0, .baud = 19200, .parity = 'E', .stop_bits = 1, \
+        .unit = 1, .de_gpio = -1, .rx_ring = 512, \
+        .tcp_port = MODBUS_TCP_PORT, .priority = 4, \
+    }
+
+typedef struct {
+    uint32_t rtu_frames;        /* for this unit (or broadcast), CRC good */
+    uint32_t rtu_crc_errors;
+    uint32_t rtu_other_units;   /* frames for other slaves */
+    uint32_t rtu_bad_frames;    /* too short or too long */
+    uint32_t tcp_requests;
+    uint32_t tcp_connections;
+    uint32_t exceptions;        /* sent, either side */
+} modbus_stats_t;
+
+/* Start serving 'map' (which must stay valid). Returns false if the
+   UART, the tasks or the TCP listener couldn't be set up. */
+bool modbus_start(const modbus_config_t *config, const modbus_map_t *map);
+
+/* Serve Modbus TCP on 'port' alone, as modbus_start() does when the
+   config has a tcp_port */
+bool modbus_tcp_start(uint16_t port, uint8_t priority, const modbus_map_t *map);
+
+void modbus_get_stats(modbus_stats_t *stats);
+
+/* Handle the request PDU 'req' of 'len' bytes and write the response
+   PDU (an exception response if it failed) to 'resp', which has room
+   for MODBUS_PDU_MAX bytes. Returns its length. Serialised with the
+   server's own requests, for other transports. */
+size_t modbus_process(const modbus_map_t *map, const uint8_t *req, size_t len, uint8_t *resp);
+
+/* The Modbus CRC-16 of 'len' bytes, sent low byte first */
+uint16_t modbus_crc16(const uint8_t *data, size_t len, uint16_t crc);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _MODBUS_H */
@@ -0,0 +1,170 @@
+/* Modbus TCP server, see modbus.h
+ *
+ * Requests are a 7 byte MBAP header (transaction id, protocol id 0, the
+ * length of what follows, unit id) and a PDU, and may come split over
+ * segments or several to a segment, so each client collects them in a
+ * buffer of its own. Responses echo the header.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <string.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <lwip/api.h>
+
+#include "netpoll.h"
+#include "modbus.h"
+
+#define MBAP_LEN 7
+#define ADU_MAX (MBAP_LEN + MODBUS_PDU_MAX)
+
+typedef struct {
+    struct netconn *conn;   /* NULL if free */
+    uint16_t len;
+    uint8_t buf[ADU_MAX];
+} client_t;
+
+static struct {
+    const modbus_map_t *map;
+    netpoll_t *poll;
+    struct netconn *listener;
+    client_t clients[MODBUS_TCP_MAX_CLIENTS];
+    uint8_t resp[ADU_MAX];
+} tcp;
+
+extern modbus_stats_t _modbus_stats;
+
+static void close_client(client_t *client)
+{
+    netpoll_remove(client->conn);
+    netconn_close(client->conn);
+    netconn_delete(client->conn);
+    client->conn = NULL;
+}
+
+static void accept_client(void)
+{
+    struct netconn *conn;
+    client_t *client = NULL;
+
+    if (netconn_accept(tcp.listener, &conn) != ERR_OK)
+        return;
+    for (int i = 0; i < MODBUS_TCP_MAX_CLIENTS; i++) {
+        if (!tcp.clients[i].conn) {
+            client = &tcp.clients[i];
+            break;
+        }
+    }
+    if (!client || !netpoll_add(tcp.poll, conn, NETPOLL_IN, client)) {
+        netconn_close(conn);
+        netconn_delete(conn);
+        return;
+    }
+    client->conn = conn;
+    client->len = 0;
+    _modbus_stats.tcp_connections++;
+}
+
+/* Answer the complete requests in the client's buffer. Returns false if
+   the client should be dropped. */
+static bool serve(client_t *client)
+{
+    uint8_t *p = client->buf;
+
+    while (client->len - (p - client->buf) >= MBAP_LEN) {
+        uint16_t protocol = (p[2] << 8) | p[3];
+        uint16_t len = (p[4] << 8) | p[5];   /* unit and PDU */
+
+        if (protocol != 0 || len < 2 || len > MODBUS_PDU_MAX + 1)
+            return false;
+        if (client->len - (p - client->buf) < MBAP_LEN - 1 + len)
+            break;
+
+        _modbus_stats.tcp_requests++;
+        size_t n = modbus_process(tcp.map, p + MBAP_LEN, len - 1, tcp.resp + MBAP_LEN);
+        memcpy(tcp.resp, p, MBAP_LEN);
+        tcp.resp[4] = (n + 1) >> 8;
+        tcp.resp[5] = n + 1;
+        if (netconn_write(client->conn, tcp.resp, MBAP_LEN + n, NETCONN_COPY) != ERR_OK)
+            return false;
+        p += MBAP_LEN - 1 + len;
+    }
+    client->len -= p - client->buf;
+    memmove(client->buf, p, client->len);
+    return true;
+}
+
+static bool receive(client_t *client)
+{
+    struct netbuf *buf;
+    void *data;
+    u16_t len;
+
+    if (netconn_recv(client->conn, &buf) != ERR_OK)
+        return false;
+    netbuf_first(buf);
+    do {
+        netbuf_data(buf, &data, &len);
+        while (len) {
+            u16_t n = sizeof(client->buf) - client->len;
+            if (n > len)
+                n = len;
+            memcpy(client->buf + client->len, data, n);
+            client->len += n;
+            data = (uint8_t *)data + n;
+            len -= n;
+            /* A full buffer always holds a whole request */
+            if (!serve(client)) {
+                netbuf_delete(buf);
+                return false;
+            }
+        }
+    } while (netbuf_next(buf) >= 0);
+    netbuf_delete(buf);
+    return true;
+}
+
+static void tcp_task(void *pvParameters)
+{
+    while (1) {
+        netpoll_event_t ev[MODBUS_TCP_MAX_CLIENTS + 1];
+        int n = netpoll_wait(tcp.poll, ev, MODBUS_TCP_MAX_CLIENTS + 1, 0);
+
+        for (int i = 0; i < n; i++) {
+            client_t *client = ev[i].arg;
+
+            if (!client)
+                accept_client();
+            else if (ev[i].events & NETPOLL_ERR || !receive(client))
+                close_client(client);
+        }
+    }
+}
+
+bool modbus_tcp_start(uint16_t port, uint8_t priority, const modbus_map_t *map)
+{
+    tcp.map = map;
+    tcp.poll = netpoll_create();
+    tcp.listener = netpoll_netconn_new(NETCONN_TCP);
+    if (!tcp.poll || !tcp.listener)
+        goto fail;
+    if (netconn_bind(tcp.listener, IP_ADDR_ANY, port) != ERR_OK
+        || netconn_listen(tcp.listener) != ERR_OK
+        || !netpoll_add(tcp.poll, tcp.listener, NETPOLL_IN, NULL))
+        goto fail;
+    if (xTaskCreate(tcp_task, (signed char *)"modbus_tcp", 512, NULL, priority, NULL) == pdPASS)
+        return true;
+
+    netpoll_remove(tcp.listener);
+fail:
+    if (tcp.listener)
+        netconn_delete(tcp.listener);
+    if (tcp.poll)
+        netpoll_destroy(tcp.poll);
+    tcp.listener = NULL;
+    tcp.poll = NULL;
+    return false;
+}
@@ -0,0 +1,9 @@
+# Component makefile for extras/mqtt
+
+# expected anyone using mqtt includes it as 'mqtt/mqtt.h'
+INC_DIRS += $(mqtt_ROOT)..
+
+# args for passing into compile rule generation
+mqtt_SRC_DIR =  $(mqtt_ROOT)
+
+$(eval $(call component_compile_rules,mqtt))
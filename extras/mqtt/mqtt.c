@@ -0,0 +1,711 @@
+/* MQTT 3.1.1 client on the lwIP raw TCP API, see mqtt.h
+ *
+ * The queue of encoded packets is appended to by any task and consumed
+ * by tcpip_thread, so it (and the buffer pool) is guarded with
+ * SYS_ARCH_PROTECT. Everything else about a client, including the list
+ * of QoS 1 messages in flight, is only touched in tcpip_thread.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "mqtt.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#include <lwip/tcp.h>
+#include <lwip/tcpip.h>
+#include <lwip/sys.h>
+#include <lwip/timers.h>
+
+/* Housekeeping interval: reconnects, keepalive and connect timeouts */
+#define TICK_MS 1000
+
+/* Longest a connection may take to be accepted, TCP and CONNACK */
+#define CONNECT_TIMEOUT_MS 10000
+
+/* Room for CONNECT: client id, username and password plus 22 bytes */
+#define CONNECT_MAX 160
+
+enum {
+    CONNECT = 1,
+    CONNACK = 2,
+    PUBLISH = 3,
+    PUBACK = 4,
+    SUBSCRIBE = 8,
+    SUBACK = 9,
+    UNSUBACK = 11,
+    PINGREQ = 12,
+    PINGRESP = 13,
+    DISCONNECT = 14,
+};
+
+#define DUP_FLAG 0x08
+
+typedef struct mqtt_msg {
+    struct mqtt_msg *next;
+    uint16_t len;
+    uint16_t id;        /* of a QoS 1 PUBLISH, otherwise 0 */
+    uint8_t data[MQTT_BUF_SIZE];
+} mqtt_msg_t;
+
+static mqtt_msg_t pool[MQTT_POOL_SIZE];
+static mqtt_msg_t *free_msgs;
+static bool pool_ready;
+
+static void write_queue(mqtt_client_t *c);
+static void tick(void *arg);
+
+static void pool_init(void)
+{
+    SYS_ARCH_DECL_PROTECT(lev);
+    SYS_ARCH_PROTECT(lev);
+    if (!pool_ready) {
+        for (int i = 0; i < MQTT_POOL_SIZE; i++) {
+            pool[i].next = free_msgs;
+            free_msgs = &pool[i];
+        }
+        pool_ready = true;
+    }
+    SYS_ARCH_UNPROTECT(lev);
+}
+
+static mqtt_msg_t *msg_alloc(void)
+{
+    SYS_ARCH_DECL_PROTECT(lev);
+    SYS_ARCH_PROTECT(lev);
+    mqtt_msg_t *msg = free_msgs;
+    if (msg)
+        free_msgs = msg->next;
+    SYS_ARCH_UNPROTECT(lev);
+    if (msg) {
+        msg->next = NULL;
+        msg->id = 0;
+    }
+    return msg;
+}
+
+static void msg_free(mqtt_msg_t *msg)
+{
+    SYS_ARCH_DECL_PROTECT(lev);
+    SYS_ARCH_PROTECT(lev);
+    msg->next = free_msgs;
+    free_msgs = msg;
+    SYS_ARCH_UNPROTECT(lev);
+}
+
+static void msg_free_list(mqtt_msg_t *msg)
+{
+    while (msg) {
+        mqtt_msg_t *next = msg->next;
+        msg_free(msg);
+        msg = next;
+    }
+}
+
+static uint8_t *put_length(uint8_t *p, uint32_t len)
+{
+    do {
+        uint8_t b = len & 0x7f;
+        len >>= 7;
+        *p++ = b | (len ? 0x80 : 0);
+    } while (len);
+    return p;
+}
+
+static size_t length_size(uint32_t len)
+{
+    return len < 128 ? 1 : len < 16384 ? 2 : len < 2097152 ? 3 : 4;
+}
+
+static uint8_t *put16(uint8_t *p, uint16_t v)
+{
+    *p++ = v >> 8;
+    *p++ = v;
+    return p;
+}
+
+static uint8_t *put_string(uint8_t *p, const char *s, size_t len)
+{
+    p = put16(p, len);
+    memcpy(p, s, len);
+    return p + len;
+}
+
+/*
+ * Queueing, from any task
+ */
+
+static void flush(void *arg);
+
+static void enqueue(mqtt_client_t *c, mqtt_msg_t *msg)
+{
+    SYS_ARCH_DECL_PROTECT(lev);
+    SYS_ARCH_PROTECT(lev);
+    if (c->queue_tail)
+        c->queue_tail->next = msg;
+    else
+        c->queue = msg;
+    c->queue_tail = msg;
+    c->queued_bytes += msg->len;
+    bool post = !c->flush_pending;
+    c->flush_pending = true;
+    SYS_ARCH_UNPROTECT(lev);
+
+    /* Not blocking, as this may be called in tcpip_thread itself. If the
+       mailbox is full the next tick writes the queue out. */
+    if (post && tcpip_callback_with_block(flush, c, 0) != ERR_OK)
+        c->flush_pending = false;
+}
+
+static uint16_t take_id(mqtt_client_t *c)
+{
+    SYS_ARCH_DECL_PROTECT(lev);
+    SYS_ARCH_PROTECT(lev);
+    if (++c->next_id == 0)
+        c->next_id = 1;
+    uint16_t id = c->next_id;
+    SYS_ARCH_UNPROTECT(lev);
+    return id;
+}
+
+mqtt_err_t mqtt_publish(mqtt_client_t *c, const char *topic, const void *data, size_t len,
+                        int qos, bool retain)
+{
+    if (!c->started || qos < 0 || qos > 1)
+        return MQTT_ERR_ARG;
+
+    size_t topic_len = strlen(topic);
+    size_t rem = 2 + topic_len + (qos ? 2 : 0) + len;
+    if (1 + length_size(rem) + rem > MQTT_BUF_SIZE)
+        return MQTT_ERR_SIZE;
+    mqtt_msg_t *msg = msg_alloc();
+    if (!msg)
+        return MQTT_ERR_MEM;
+
+    uint8_t *p = msg->data;
+    *p++ = (PUBLISH << 4) | (qos << 1) | (retain ? 1 : 0);
+    p = put_length(p, rem);
+    p = put_string(p, topic, topic_len);
+    if (qos) {
+        msg->id = take_id(c);
+        p = put16(p, msg->id);
+    }
+    memcpy(p, data, len);
+    msg->len = p + len - msg->data;
+
+    enqueue(c, msg);
+    return MQTT_OK;
+}
+
+mqtt_err_t mqtt_subscribe(mqtt_client_t *c, const char *filter, int qos)
+{
+    if (!c->started || qos < 0 || qos > 1)
+        return MQTT_ERR_ARG;
+
+    size_t filter_len = strlen(filter);
+    size_t rem = 2 + 2 + filter_len + 1;
+    if (1 + length_size(rem) + rem > MQTT_BUF_SIZE)
+        return MQTT_ERR_SIZE;
+    mqtt_msg_t *msg = msg_alloc();
+    if (!msg)
+        return MQTT_ERR_MEM;
+
+    uint8_t *p = msg->data;
+    *p++ = (SUBSCRIBE << 4) | 0x02;
+    p = put_length(p, rem);
+    p = put16(p, take_id(c));
+    p = put_string(p, filter, filter_len);
+    *p++ = qos;
+    msg->len = p - msg->data;
+
+    enqueue(c, msg);
+    return MQTT_OK;
+}
+
+/*
+ * Connection handling, in tcpip_thread
+ */
+
+static void set_state(mqtt_client_t *c, mqtt_state_t state)
+{
+    c->state = state;
+    c->state_since = sys_now();
+}
+
+static void batch_done(void *arg)
+{
+    mqtt_client_t *c = arg;
+    c->batch_pending = false;
+    write_queue(c);
+}
+
+static void flush(void *arg)
+{
+    mqtt_client_t *c = arg;
+    c->flush_pending = false;
+    if (!c->started)
+        return;
+    if (c->config.batch_ms && c->queued_bytes < TCP_MSS) {
+        if (!c->batch_pending) {
+            c->batch_pending = true;
+            sys_timeout(c->config.batch_ms, batch_done, c);
+        }
+        return;
+    }
+    if (c->batch_pending) {
+        sys_untimeout(batch_done, c);
+        c->batch_pending = false;
+    }
+    write_queue(c);
+}
+
+/* Write as much of the queue as the send buffer and the in-flight
+   window allow, then send it all at once */
+static void write_queue(mqtt_client_t *c)
+{
+    SYS_ARCH_DECL_PROTECT(lev);
+    bool wrote = false;
+
+    if (c->state != MQTT_CONNECTED)
+        return;
+    for (;;) {
+        SYS_ARCH_PROTECT(lev);
+        mqtt_msg_t *msg = c->queue;
+        SYS_ARCH_UNPROTECT(lev);
+        if (!msg)
+            break;
+        if (msg->id && c->inflight_count >= MQTT_INFLIGHT)
+            break;
+        if (tcp_sndbuf(c->pcb) < msg->len)
+            break;
+        if (tcp_write(c->pcb, msg->data, msg->len, TCP_WRITE_FLAG_COPY | TCP_WRITE_FLAG_MORE) != ERR_OK)
+            break;
+
+        SYS_ARCH_PROTECT(lev);
+        c->queue = msg->next;
+        if (!c->queue)
+            c->queue_tail = NULL;
+        c->queued_bytes -= msg->len;
+        SYS_ARCH_UNPROTECT(lev);
+
+        msg->next = NULL;
+        if ((msg->data[0] >> 4) == PUBLISH)
+            c->stats.published++;
+        if (msg->id) {
+            if (c->inflight_tail)
+                c->inflight_tail->next = msg;
+            else
+                c->inflight = msg;
+            c->inflight_tail = msg;
+            c->inflight_count++;
+        } else {
+            msg_free(msg);
+        }
+        wrote = true;
+    }
+    if (wrote) {
+        tcp_output(c->pcb);
+        c->stats.writes++;
+        c->last_tx = sys_now();
+    }
+}
+
+/* The connection is gone (c->pcb already freed or detached): put the
+   unacknowledged messages back at the front of the queue, marked as
+   duplicates, for the next connection */
+static void disconnected(mqtt_client_t *c)
+{
+    SYS_ARCH_DECL_PROTECT(lev);
+
+    c->pcb = NULL;
+    set_state(c, MQTT_DISCONNECTED);
+    c->ping_outstanding = false;
+    c->rx_len = 0;
+    c->rx_skip = 0;
+    if (c->batch_pending) {
+        sys_untimeout(batch_done, c);
+        c->batch_pending = false;
+    }
+
+    if (c->inflight) {
+        uint16_t bytes = 0;
+        for (mqtt_msg_t *msg = c->inflight; msg; msg = msg->next) {
+            msg->data[0] |= DUP_FLAG;
+            bytes += msg->len;
+        }
+        SYS_ARCH_PROTECT(lev);
+        c->inflight_tail->next = c->queue;
+        if (!c->queue)
+            c->queue_tail = c->inflight_tail;
+        c->queue = c->inflight;
+        c->queued_bytes += bytes;
+        SYS_ARCH_UNPROTECT(lev);
+        c->inflight = c->inflight_tail = NULL;
+        c->inflight_count = 0;
+    }
+}
+
+static void drop(mqtt_client_t *c)
+{
+    if (c->pcb) {
+        tcp_arg(c->pcb, NULL);
+        tcp_recv(c->pcb, NULL);
+        tcp_sent(c->pcb, NULL);
+        tcp_err(c->pcb, NULL);
+        tcp_abort(c->pcb);
+    }
+    disconnected(c);
+}
+
+static bool send_small(mqtt_client_t *c, const uint8_t *data, size_t len)
+{
+    if (tcp_write(c->pcb, data, len, TCP_WRITE_FLAG_COPY) != ERR_OK)
+        return false;
+    tcp_output(c->pcb);
+    c->last_tx = sys_now();
+    return true;
+}
+
+static err_t connected_cb(void *arg, struct tcp_pcb *pcb, err_t err)
+{
+    mqtt_client_t *c = arg;
+    const mqtt_config_t *cfg = &c->config;
+    size_t id_len = strlen(cfg->client_id);
+    size_t user_len = cfg->username ? strlen(cfg->username) : 0;
+    size_t pass_len = cfg->password ? strlen(cfg->password) : 0;
+    size_t rem = 10 + 2 + id_len + (cfg->username ? 2 + user_len : 0) + (cfg->password ? 2 + pass_len : 0);
+    uint8_t buf[CONNECT_MAX];
+
+    if (1 + length_size(rem) + rem > sizeof(buf)) {
+        printf("mqtt: client id and credentials too long\n");
+        drop(c);
+        return ERR_ABRT;
+    }
+
+    uint8_t *p = buf;
+    *p++ = CONNECT << 4;
+    p = put_length(p, rem);
+    p = put_string(p, "MQTT", 4);
+    *p++ = 4; /* protocol level, 3.1.1 */
+    *p++ = (cfg->username ? 0x80 : 0) | (cfg->password ? 0x40 : 0) | (cfg->clean_session ? 0x02 : 0);
+    p = put16(p, cfg->keepalive_s);
+    p = put_string(p, cfg->client_id, id_len);
+    if (cfg->username)
+        p = put_string(p, cfg->username, user_len);
+    if (cfg->password)
+        p = put_string(p, cfg->password, pass_len);
+
+    if (!send_small(c, buf, p - buf)) {
+        drop(c);
+        return ERR_ABRT;
+    }
+    return ERR_OK;
+}
+
+static void puback_received(mqtt_client_t *c, uint16_t id)
+{
+    mqtt_msg_t *prev = NULL;
+    for (mqtt_msg_t *msg = c->inflight; msg; prev = msg, msg = msg->next) {
+        if (msg->id != id)
+            continue;
+        if (prev)
+            prev->next = msg->next;
+        else
+            c->inflight = msg->next;
+        if (c->inflight_tail == msg)
+            c->inflight_tail = prev;
+        c->inflight_count--;
+        c->stats.acked++;
+        msg_free(msg);
+        return;
+    }
+}
+
+/* Handle one whole packet, returns false if the connection was dropped */
+static bool handle_packet(mqtt_client_t *c, uint8_t type, const uint8_t *body, size_t len)
+{
+    if (c->state != MQTT_CONNECTED && (type >> 4) != CONNACK)
+        goto bad;
+
+    switch (type >> 4) {
+    case CONNACK:
+        if (c->state != MQTT_CONNECTING || len < 2)
+            goto bad;
+        if (body[1] != 0) {
+            printf("mqtt: connection refused, code %d\n", body[1]);
+            goto bad;
+        }
+        set_state(c, MQTT_CONNECTED);
+        c->reconnect_ms = MQTT_RECONNECT_MIN_MS;
+        if (c->was_connected)
+            c->stats.reconnects++;
+        c->was_connected = true;
+        if (c->config.connected)
+            c->config.connected(c);
+        write_queue(c);
+        return true;
+
+    case PUBLISH: {
+        int qos = (type >> 1) & 3;
+        if (qos > 1 || len < 2)
+            goto bad;
+        size_t topic_len = (body[0] << 8) | body[1];
+        size_t offs = 2 + topic_len + (qos ? 2 : 0);
+        if (offs > len)
+            goto bad;
+        c->stats.received++;
+        if (c->config.message)
+            c->config.message(c, (const char *)body + 2, topic_len, body + offs, len - offs);
+        if (qos && c->pcb) {
+            uint8_t ack[4] = { PUBACK << 4, 2, body[2 + topic_len], body[3 + topic_len] };
+            send_small(c, ack, sizeof(ack));
+        }
+        return true;
+    }
+
+    case PUBACK:
+        if (len < 2)
+            goto bad;
+        puback_received(c, (body[0] << 8) | body[1]);
+        return true;
+
+    case PINGRESP:
+        c->ping_outstanding = false;
+        return true;
+
+    case SUBACK:
+    case UNSUBACK:
+        return true;
+    }
+
+bad:
+    drop(c);
+    return false;
+}
+
+/* Parse whole packets out of received data, returns false if the
+   connection was dropped */
+static bool feed(mqtt_client_t *c, const uint8_t *data, size_t len)
+{
+    while (len) {
+        if (c->rx_skip) {
+            size_t n = len < c->rx_skip ? len : c->rx_skip;
+            c->rx_skip -= n;
+            data += n;
+            len -= n;
+            continue;
+        }
+        size_t n = sizeof(c->rx) - c->rx_len;
+        if (n > len)
+            n = len;
+        memcpy(c->rx + c->rx_len, data, n);
+        c->rx_len += n;
+        data += n;
+        len -= n;
+
+        size_t offs = 0;
+        for (;;) {
+            size_t avail = c->rx_len - offs;
+            const uint8_t *p = c->rx + offs;
+            uint32_t rem = 0;
+            size_t hdr = 0;
+            for (size_t i = 1; i < avail; i++) {
+                rem |= (uint32_t)(p[i] & 0x7f) << (7 * (i - 1));
+                if (!(p[i] & 0x80)) {
+                    hdr = i + 1;
+                    break;
+                }
+                if (i == 4) {
+                    drop(c);
+                    return false;
+                }
+            }
+            if (!hdr)
+                break;
+            if (hdr + rem > sizeof(c->rx)) {
+                c->stats.rx_dropped++;
+                c->rx_skip = hdr + rem - avail;
+                offs = c->rx_len;
+                break;
+            }
+            if (hdr + rem > avail)
+                break;
+            if (!handle_packet(c, p[0], p + hdr, rem))
+                return false;
+            offs += hdr + rem;
+        }
+        memmove(c->rx, c->rx + offs, c->rx_len - offs);
+        c->rx_len -= offs;
+    }
+    return true;
+}
+
+static err_t recv_cb(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
+{
+    mqtt_client_t *c = arg;
+
+    if (!p) {
+        drop(c);
+        return ERR_ABRT;
+    }
+    for (struct pbuf *q = p; q; q = q->next) {
+        if (!feed(c, q->payload, q->len)) {
+            pbuf_free(p);
+            return ERR_ABRT;
+        }
+    }
+    tcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+    /* once for all the acknowledgements in this segment */
+    write_queue(c);
+    return ERR_OK;
+}
+
+static err_t sent_cb(void *arg, struct tcp_pcb *pcb, u16_t len)
+{
+    write_queue(arg);
+    return ERR_OK;
+}
+
+static void err_cb(void *arg, err_t err)
+{
+    mqtt_client_t *c = arg;
+    if (c) {
+        c->pcb = NULL;
+        disconnected(c);
+    }
+}
+
+static void connect_now(mqtt_client_t *c)
+{
+    struct tcp_pcb *pcb = tcp_new();
+    if (!pcb)
+        return;
+
+    tcp_arg(pcb, c);
+    tcp_recv(pcb, recv_cb);
+    tcp_sent(pcb, sent_cb);
+    tcp_err(pcb, err_cb);
+    /* send small packets as they are written, not after the next ACK */
+    tcp_nagle_disable(pcb);
+    c->pcb = pcb;
+    set_state(c, MQTT_CONNECTING);
+    if (tcp_connect(pcb, &c->config.broker, c->config.port, connected_cb) != ERR_OK)
+        drop(c);
+
+    /* the next attempt, if this one fails, waits longer */
+    c->reconnect_ms *= 2;
+    if (c->reconnect_ms > MQTT_RECONNECT_MAX_MS)
+        c->reconnect_ms = MQTT_RECONNECT_MAX_MS;
+}
+
+static void tick(void *arg)
+{
+    mqtt_client_t *c = arg;
+    uint32_t now = sys_now();
+    uint32_t keepalive_ms = c->config.keepalive_s * 1000;
+
+    switch (c->state) {
+    case MQTT_DISCONNECTED:
+        if (now - c->state_since >= c->reconnect_ms)
+            connect_now(c);
+        break;
+    case MQTT_CONNECTING:
+        if (now - c->state_since >= CONNECT_TIMEOUT_MS)
+            drop(c);
+        break;
+    case MQTT_CONNECTED:
+        if (c->ping_outstanding && now - c->ping_sent >= keepalive_ms / 2) {
+            printf("mqtt: no ping response, reconnecting\n");
+            drop(c);
+            break;
+        }
+        /* catch up on a flush that didn't make it into the mailbox */
+        write_queue(c);
+        if (keepalive_ms && !c->ping_outstanding && now - c->last_tx >= keepalive_ms * 3 / 4) {
+            static const uint8_t pingreq[2] = { PINGREQ << 4, 0 };
+            if (send_small(c, pingreq, sizeof(pingreq))) {
+                c->ping_outstanding = true;
+                c->ping_sent = now;
+            }
+        }
+        break;
+    }
+    sys_timeout(TICK_MS, tick, c);
+}
+
+typedef struct {
+    sys_sem_t done;
+    mqtt_client_t *c;
+} call_t;
+
+static void start_cb(void *arg)
+{
+    call_t *call = arg;
+    mqtt_client_t *c = call->c;
+
+    c->started = true;
+    connect_now(c);
+    sys_timeout(TICK_MS, tick, c);
+    sys_sem_signal(&call->done);
+}
+
+static void stop_cb(void *arg)
+{
+    call_t *call = arg;
+    mqtt_client_t *c = call->c;
+
+    if (c->started) {
+        sys_untimeout(tick, c);
+        if (c->pcb && c->state == MQTT_CONNECTED) {
+            static const uint8_t disconnect[2] = { DISCONNECT << 4, 0 };
+            send_small(c, disconnect, sizeof(disconnect));
+            tcp_arg(c->pcb, NULL);
+            tcp_recv(c->pcb, NULL);
+            tcp_sent(c->pcb, NULL);
+            tcp_err(c->pcb, NULL);
+            if (tcp_close(c->pcb) == ERR_OK)
+                c->pcb = NULL;
+        }
+        drop(c);
+        c->started = false;
+        msg_free_list(c->queue);
+        c->queue = c->queue_tail = NULL;
+        c->queued_bytes = 0;
+    }
+    sys_sem_signal(&call->done);
+}
+
+static void call(mqtt_client_t *c, tcpip_callback_fn fn)
+{
+    call_t call = { .c = c };
+
+    if (sys_sem_new(&call.done, 0) != ERR_OK)
+        return;
+    if (tcpip_callback(fn, &call) == ERR_OK)
+        sys_sem_wait(&call.done);
+    sys_sem_free(&call.done);
+}
+
+void mqtt_start(mqtt_client_t *c, const mqtt_config_t *config)
+{
+    pool_init();
+    memset(c, 0, sizeof(*c));
+    c->config = *config;
+    if (!c->config.port)
+        c->config.port = 1883;
+    c->reconnect_ms = MQTT_RECONNECT_MIN_MS;
+    call(c, start_cb);
+}
+
+void mqtt_stop(mqtt_client_t *c)
+{
+    call(c, stop_cb);
+}
+
+void mqtt_get_stats(const mqtt_client_t *c, mqtt_stats_t *stats)
+{
+    *stats = c->stats;
+}
@@ -0,0 +1,172 @@
+/* MQTT 3.1.1 client on the lwIP raw TCP API
+ *
+ * Made for publishing many small messages. mqtt_publish() only encodes
+ * the message into a buffer from a static pool (MQTT_POOL_SIZE buffers
+ * of MQTT_BUF_SIZE bytes, shared by all clients) and queues it; the
+ * queue is written out from tcpip_thread, as many packets as the send
+ * buffer takes in one go with a single tcp_output(), so a burst of
+ * publishes goes out in as few segments as it fits. Setting batch_ms
+ * holds the queue back for that long after the first message (or until
+ * a segment's worth is waiting), to gather more of them.
+ *
+ * QoS 1 messages stay in their buffer until the broker acknowledges
+ * them, up to MQTT_INFLIGHT at once; more wait in the queue, so
+ * acknowledgements don't cost a round trip per message. Unacknowledged
+ * messages are sent again (with DUP set) after a reconnect; use
+ * clean_session = false so the broker keeps its side of them too.
+ * Messages are sent in the order they were published, at any QoS.
+ * QoS 2 isn't supported.
+ *
+ * There's no task: the client runs in tcpip_thread, and its keepalive
+ * and reconnect timers are lwIP timeouts there. After the connection
+ * drops it reconnects by itself, waiting MQTT_RECONNECT_MIN_MS at first
+ * and twice as long each time it fails, up to MQTT_RECONNECT_MAX_MS.
+ * Messages published meanwhile are queued, until the pool runs out.
+ *
+ * Callbacks (connected, message) run in tcpip_thread, so must be quick
+ * and not block. They may publish and subscribe.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _MQTT_H
+#define _MQTT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <lwip/ip_addr.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/* Buffers for outgoing packets, shared by all clients */
+#ifndef MQTT_POOL_SIZE
+#define MQTT_POOL_SIZE 16
+#endif
+
+/* Longest outgoing packet, i.e. topic and payload plus ~8 bytes */
+#ifndef MQTT_BUF_SIZE
+#define MQTT_BUF_SIZE 128
+#endif
+
+/* Most QoS 1 messages awaiting acknowledgement, per client */
+#ifndef MQTT_INFLIGHT
+#define MQTT_INFLIGHT 8
+#endif
+
+/* Longest incoming packet; longer ones are dropped */
+#ifndef MQTT_RX_BUF
+#define MQTT_RX_BUF 256
+#endif
+
+#ifndef MQTT_RECONNECT_MIN_MS
+#define MQTT_RECONNECT_MIN_MS 1000
+#endif
+
+#ifndef MQTT_RECONNECT_MAX_MS
+#define MQTT_RECONNECT_MAX_MS 60000
+#endif
+
+typedef enum {
+    MQTT_OK = 0,
+    MQTT_ERR_MEM = -1,      /* no free buffer in the pool */
+    MQTT_ERR_SIZE = -2,     /* packet longer than MQTT_BUF_SIZE */
+    MQTT_ERR_ARG = -3,      /* bad QoS, or client not started */
+} mqtt_err_t;
+
+typedef enum {
+    MQTT_DISCONNECTED,
+    MQTT_CONNECTING,        /* TCP connecting, or waiting for CONNACK */
+    MQTT_CONNECTED,
+} mqtt_state_t;
+
+struct mqtt_client;
+
+/* A message on a subscribed topic. 'topic' isn't NUL terminated. */
+typedef void (*mqtt_message_fn)(struct mqtt_client *c, const char *topic, size_t topic_len,
+                                const void *data, size_t len);
+
+/* The broker accepted the connection: time to (re)subscribe */
+typedef void (*mqtt_connected_fn)(struct mqtt_client *c);
+
+typedef struct {
+    ip_addr_t broker;
+    uint16_t port;              /* 0 for 1883 */
+    const char *client_id;
+    const char *username;       /* or NULL */
+    const char *password;       /* or NULL */
+    uint16_t keepalive_s;       /* 0 for none */
+    bool clean_session;
+    uint16_t batch_ms;          /* hold queued messages back this long, 0 not to */
+    mqtt_connected_fn connected;
+    mqtt_message_fn message;
+    void *arg;                  /* for the callbacks, as c->config.arg */
+} mqtt_config_t;
+
+typedef struct {
+    uint32_t published;         /* messages written to the connection */
+    uint32_t acked;             /* QoS 1 messages acknowledged */
+    uint32_t writes;            /* tcp_output()s of queued messages */
+    uint32_t received;
+    uint32_t rx_dropped;        /* incoming packets too long for MQTT_RX_BUF */
+    uint32_t reconnects;        /* connections accepted after the first */
+} mqtt_stats_t;
+
+struct mqtt_msg;
+
+typedef struct mqtt_client {
+    mqtt_config_t config;       /* strings must stay valid */
+    struct tcp_pcb *pcb;
+    mqtt_state_t state;
+    bool started;
+    bool flush_pending;         /* a flush is on its way to tcpip_thread */
+    bool batch_pending;         /* the batch timeout is running */
+    bool ping_outstanding;
+    bool was_connected;
+    struct mqtt_msg *queue, *queue_tail;
+    struct mqtt_msg *inflight, *inflight_tail;
+    uint8_t inflight_count;
+    uint16_t queued_bytes;
+    uint16_t next_id;
+    uint32_t last_tx;           /* sys_now() of the last write */
+    uint32_t ping_sent;
+    uint32_t state_since;       /* sys_now() of the last state change */
+    uint32_t reconnect_ms;
+    uint32_t rx_skip;           /* bytes left of an oversized packet */
+    uint16_t rx_len;
+    uint8_t rx[MQTT_RX_BUF];
+    mqtt_stats_t stats;
+} mqtt_client_t;
+
+/* Start connecting (and keep connected) to the broker in 'config',
+   which is copied. May be called from any task but tcpip_thread. */
+void mqtt_start(mqtt_client_t *c, const mqtt_config_t *config);
+
+/* Disconnect and drop everything queued. From any task but tcpip_thread. */
+void mqtt_stop(mqtt_client_t *c);
+
+/* Queue a message for 'topic' at QoS 0 or 1. Returns MQTT_OK once
+   queued, not sent. Callable from any task, or a callback. */
+mqtt_err_t mqtt_publish(mqtt_client_t *c, const char *topic, const void *data, size_t len,
+                        int qos, bool retain);
+
+/* Queue a subscription to 'filter' at QoS 0 or 1 (brokers don't keep
+   subscriptions of clean sessions, so this is best done from the
+   connected callback). */
+mqtt_err_t mqtt_subscribe(mqtt_client_t *c, const char *filter, int qos);
+
+static inline mqtt_state_t mqtt_state(const mqtt_client_t *c)
+{
+    return c->state;
+}
+
+void mqtt_get_stats(const mqtt_client_t *c, mqtt_stats_t *stats);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _MQTT_H */
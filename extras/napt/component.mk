@@ -0,0 +1,9 @@
+# Component makefile for extras/napt
+
+# expected anyone using napt includes it as 'napt/napt.h'
+INC_DIRS += $(napt_ROOT)..
+
+# args for passing into compile rule generation
+napt_SRC_DIR =  $(napt_ROOT)
+
+$(eval $(call component_compile_rules,napt))
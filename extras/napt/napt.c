@@ -0,0 +1,449 @@
+/* NAPT between the softAP and the station interface, see napt.h
+ *
+ * The table is only touched from the WLAN receive path (both
+ * interfaces receive in the same SDK task), and by napt_enable() and
+ * napt_disable() while the hook isn't installed, so it takes no locks.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "napt.h"
+
+#include <string.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include <lwip/opt.h>
+#include <lwip/netif.h>
+#include <lwip/ip.h>
+#include <netif/etharp.h>
+#include "ethernetif_filter.h"
+
+#include "sdk_internal.h"
+
+#if !IP_FORWARD
+#error "extras/napt needs lwIP IP forwarding, build with EXTRA_CFLAGS=-DIP_FORWARD=1"
+#endif
+
+_Static_assert((NAPT_HASH_SIZE & (NAPT_HASH_SIZE - 1)) == 0, "NAPT_HASH_SIZE must be a power of 2");
+_Static_assert(NAPT_PORT_MAX - NAPT_PORT_MIN + 1 >= NAPT_MAX_ENTRIES, "NAPT port range smaller than the table");
+
+#define NO_ENTRY 0xffff
+
+/* Offsets in the IPv4 header */
+#define IP_OFS_FRAG     6
+#define IP_OFS_PROTO    9
+#define IP_OFS_CHKSUM   10
+#define IP_OFS_SRC      12
+#define IP_OFS_DST      16
+
+/* Offsets in the transport headers. TCP and UDP have the source and
+   destination ports at 0 and 2, ICMP echo the id at 4. */
+#define TCP_OFS_FLAGS   13
+#define TCP_OFS_CHKSUM  16
+#define UDP_OFS_CHKSUM  6
+#define ICMP_OFS_CHKSUM 2
+#define ICMP_OFS_ID     4
+
+#define TCP_FIN 0x01
+#define TCP_RST 0x04
+
+#define ICMP_ECHO_REPLY   0
+#define ICMP_ECHO_REQUEST 8
+
+/* Entry state bits */
+#define FIN_OUT 0x01
+#define FIN_IN  0x02
+#define CLOSED  0x04
+
+typedef struct {
+    uint32_t src;       /* client address, as in the header */
+    uint32_t dst;       /* remote address */
+    uint16_t sport;     /* client port or ICMP id, as in the header */
+    uint16_t dport;     /* remote port, 0 for ICMP */
+    uint16_t nport;     /* mapped port, host order */
+    uint8_t proto;      /* 0 for a free entry */
+    uint8_t state;
+    uint16_t out_next;  /* next entry in the same bucket, each way */
+    uint16_t in_next;
+    portTickType last;  /* tick of the last packet */
+} napt_entry_t;
+
+static napt_entry_t entries[NAPT_MAX_ENTRIES];
+static uint16_t out_hash[NAPT_HASH_SIZE];
+static uint16_t in_hash[NAPT_HASH_SIZE];
+static uint16_t free_head;
+static uint16_t next_port;
+
+static struct netif *ap_netif;
+static struct netif *sta_netif;
+static napt_stats_t stats;
+
+static inline uint16_t get16(const uint8_t *p)
+{
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t get32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void put16(uint8_t *p, uint16_t v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline void put32(uint8_t *p, uint32_t v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+/* Incremental checksum update (RFC 1624) for a 16 bit word going from
+   'from' to 'to'. The one's complement sum doesn't depend on byte
+   order, so fields can be used as they are in the header. */
+static uint16_t csum_update16(uint16_t csum, uint16_t from, uint16_t to)
+{
+    uint32_t sum = (uint16_t)~csum + (uint16_t)~from + to;
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    return ~sum;
+}
+
+static uint16_t csum_update32(uint16_t csum, uint32_t from, uint32_t to)
+{
+    csum = csum_update16(csum, from, to);
+    return csum_update16(csum, from >> 16, to >> 16);
+}
+
+static inline uint32_t out_bucket(uint8_t proto, uint32_t src, uint16_t sport, uint32_t dst, uint16_t dport)
+{
+    uint32_t h = (src ^ (dst * 2654435761u)) + ((uint32_t)sport << 16 | dport) + proto;
+    h ^= h >> 16;
+    h *= 0x45d9f3b;
+    h ^= h >> 16;
+    return h & (NAPT_HASH_SIZE - 1);
+}
+
+static inline uint32_t in_bucket(uint16_t nport)
+{
+    return (nport * 2654435761u) >> 16 & (NAPT_HASH_SIZE - 1);
+}
+
+static uint32_t timeout_ticks(const napt_entry_t *e)
+{
+    uint32_t s;
+
+    if (e->proto == IP_PROTO_TCP)
+        s = (e->state & CLOSED) ? NAPT_TCP_CLOSED_TIMEOUT_S : NAPT_TCP_TIMEOUT_S;
+    else if (e->proto == IP_PROTO_UDP)
+        s = NAPT_UDP_TIMEOUT_S;
+    else
+        s = NAPT_ICMP_TIMEOUT_S;
+    return s * configTICK_RATE_HZ;
+}
+
+static void table_reset(void)
+{
+    memset(entries, 0, sizeof(entries));
+    memset(out_hash, 0xff, sizeof(out_hash));
+    memset(in_hash, 0xff, sizeof(in_hash));
+    for (int i = 0; i < NAPT_MAX_ENTRIES; i++)
+        entries[i].out_next = i + 1 < NAPT_MAX_ENTRIES ? i + 1 : NO_ENTRY;
+    free_head = 0;
+    next_port = NAPT_PORT_MIN;
+    stats.active = 0;
+}
+
+static void list_unlink(uint16_t *link, uint16_t i, bool out)
+{
+    while (*link != NO_ENTRY) {
+        if (*link == i) {
+            *link = out ? entries[i].out_next : entries[i].in_next;
+            return;
+        }
+        link = out ? &entries[*link].out_next : &entries[*link].in_next;
+    }
+}
+
+static void entry_free(uint16_t i)
+{
+    napt_entry_t *e = &entries[i];
+
+    list_unlink(&out_hash[out_bucket(e->proto, e->src, e->sport, e->dst, e->dport)], i, true);
+    list_unlink(&in_hash[in_bucket(e->nport)], i, false);
+    e->proto = 0;
+    e->out_next = free_head;
+    free_head = i;
+    stats.active--;
+}
+
+/* Free every expired entry */
+static void expire_all(portTickType now)
+{
+    for (int i = 0; i < NAPT_MAX_ENTRIES; i++) {
+        if (entries[i].proto && now - entries[i].last >= timeout_ticks(&entries[i]))
+            entry_free(i);
+    }
+}
+
+static napt_entry_t *find_in(uint8_t proto, uint16_t nport)
+{
+    for (uint16_t i = in_hash[in_bucket(nport)]; i != NO_ENTRY; i = entries[i].in_next) {
+        if (entries[i].nport == nport && entries[i].proto == proto)
+            return &entries[i];
+    }
+    return NULL;
+}
+
+static napt_entry_t *find_out(uint8_t proto, uint32_t src, uint16_t sport, uint32_t dst, uint16_t dport)
+{
+    uint32_t b = out_bucket(proto, src, sport, dst, dport);
+
+    for (uint16_t i = out_hash[b]; i != NO_ENTRY; i = entries[i].out_next) {
+        napt_entry_t *e = &entries[i];
+        if (e->src == src && e->sport == sport && e->dst == dst && e->dport == dport && e->proto == proto)
+            return e;
+    }
+    return NULL;
+}
+
+/* Next mapped port not in use for 'proto' */
+static uint16_t alloc_port(uint8_t proto)
+{
+    for (;;) {
+        uint16_t port = next_port;
+        next_port = port < NAPT_PORT_MAX ? port + 1 : NAPT_PORT_MIN;
+        if (!find_in(proto, port))
+            return port;
+    }
+}
+
+static napt_entry_t *entry_new(uint8_t proto, uint32_t src, uint16_t sport, uint32_t dst, uint16_t dport,
+                               portTickType now)
+{
+    if (free_head == NO_ENTRY)
+        expire_all(now);
+    if (free_head == NO_ENTRY) {
+        stats.table_full++;
+        return NULL;
+    }
+
+    uint16_t i = free_head;
+    napt_entry_t *e = &entries[i];
+    free_head = e->out_next;
+
+    e->proto = proto;
+    e->src = src;
+    e->sport = sport;
+    e->dst = dst;
+    e->dport = dport;
+    e->state = 0;
+    e->nport = alloc_port(proto);
+
+    uint32_t b = out_bucket(proto, src, sport, dst, dport);
+    e->out_next = out_hash[b];
+    out_hash[b] = i;
+    b = in_bucket(e->nport);
+    e->in_next = in_hash[b];
+    in_hash[b] = i;
+    stats.active++;
+    return e;
+}
+
+static void track_tcp(napt_entry_t *e, uint8_t flags, uint8_t fin_bit)
+{
+    if (flags & TCP_RST)
+        e->state |= CLOSED;
+    if (flags & TCP_FIN) {
+        e->state |= fin_bit;
+        if ((e->state & (FIN_OUT | FIN_IN)) == (FIN_OUT | FIN_IN))
+            e->state |= CLOSED;
+    }
+}
+
+/* Length of the transport header fields we touch */
+static uint16_t l4_min_len(uint8_t proto)
+{
+    switch (proto) {
+    case IP_PROTO_TCP:
+        return TCP_OFS_CHKSUM + 2;
+    case IP_PROTO_UDP:
+        return UDP_OFS_CHKSUM + 2;
+    case IP_PROTO_ICMP:
+        return ICMP_OFS_ID + 2;
+    default:
+        return 0;
+    }
+}
+
+/* A client's packet going out: map its source to the station's address */
+static int napt_outbound(uint8_t *ip, uint8_t *l4, uint8_t proto, portTickType now)
+{
+    uint32_t src = get32(ip + IP_OFS_SRC);
+    uint32_t dst = get32(ip + IP_OFS_DST);
+    uint32_t ext = ip4_addr_get_u32(&sta_netif->ip_addr);
+    uint16_t sport, dport, csum_ofs;
+
+    if (ext == 0) {
+        stats.dropped++;
+        return 0;
+    }
+
+    if (proto == IP_PROTO_ICMP) {
+        if (l4[0] != ICMP_ECHO_REQUEST)
+            return 1;   /* not translated, lwIP forwards it as is */
+        sport = get16(l4 + ICMP_OFS_ID);
+        dport = 0;
+        csum_ofs = ICMP_OFS_CHKSUM;
+    } else {
+        sport = get16(l4);
+        dport = get16(l4 + 2);
+        csum_ofs = proto == IP_PROTO_TCP ? TCP_OFS_CHKSUM : UDP_OFS_CHKSUM;
+    }
+
+    napt_entry_t *e = find_out(proto, src, sport, dst, dport);
+    if (!e) {
+        e = entry_new(proto, src, sport, dst, dport, now);
+        if (!e)
+            return 0;
+    }
+    e->last = now;
+    if (proto == IP_PROTO_TCP)
+        track_tcp(e, l4[TCP_OFS_FLAGS], FIN_OUT);
+
+    uint16_t nport = htons(e->nport);
+    uint16_t csum = get16(l4 + csum_ofs);
+    if (proto != IP_PROTO_UDP || csum != 0) {
+        if (proto != IP_PROTO_ICMP)
+            csum = csum_update32(csum, src, ext);   /* pseudo header */
+        csum = csum_update16(csum, sport, nport);
+        if (proto == IP_PROTO_UDP && csum == 0)
+            csum = 0xffff;
+        put16(l4 + csum_ofs, csum);
+    }
+    put16(l4 + (proto == IP_PROTO_ICMP ? ICMP_OFS_ID : 0), nport);
+    put16(ip + IP_OFS_CHKSUM, csum_update32(get16(ip + IP_OFS_CHKSUM), src, ext));
+    put32(ip + IP_OFS_SRC, ext);
+    stats.outbound++;
+    return 1;
+}
+
+/* A packet to the station's address: map it back if it's for a client */
+static void napt_inbound(uint8_t *ip, uint8_t *l4, uint8_t proto, portTickType now)
+{
+    uint32_t src = get32(ip + IP_OFS_SRC);
+    uint32_t dst = get32(ip + IP_OFS_DST);
+    uint16_t sport, dport, csum_ofs;
+
+    if (proto == IP_PROTO_ICMP) {
+        if (l4[0] != ICMP_ECHO_REPLY)
+            return;
+        sport = 0;
+        dport = get16(l4 + ICMP_OFS_ID);
+        csum_ofs = ICMP_OFS_CHKSUM;
+    } else {
+        sport = get16(l4);
+        dport = get16(l4 + 2);
+        csum_ofs = proto == IP_PROTO_TCP ? TCP_OFS_CHKSUM : UDP_OFS_CHKSUM;
+    }
+
+    uint16_t nport = ntohs(dport);
+    if (nport < NAPT_PORT_MIN || nport > NAPT_PORT_MAX)
+        return;
+    napt_entry_t *e = find_in(proto, nport);
+    /* Only the remote end the client talked to gets through */
+    if (!e || e->dst != src || e->dport != sport)
+        return;
+    if (now - e->last >= timeout_ticks(e))
+        return;     /* expired, left for the next expire_all() */
+    e->last = now;
+    if (proto == IP_PROTO_TCP)
+        track_tcp(e, l4[TCP_OFS_FLAGS], FIN_IN);
+
+    uint16_t csum = get16(l4 + csum_ofs);
+    if (proto != IP_PROTO_UDP || csum != 0) {
+        if (proto != IP_PROTO_ICMP)
+            csum = csum_update32(csum, dst, e->src);
+        csum = csum_update16(csum, dport, e->sport);
+        if (proto == IP_PROTO_UDP && csum == 0)
+            csum = 0xffff;
+        put16(l4 + csum_ofs, csum);
+    }
+    put16(l4 + (proto == IP_PROTO_ICMP ? ICMP_OFS_ID : 2), e->sport);
+    put16(ip + IP_OFS_CHKSUM, csum_update32(get16(ip + IP_OFS_CHKSUM), dst, e->src));
+    put32(ip + IP_OFS_DST, e->src);
+    stats.inbound++;
+}
+
+static int napt_hook(struct netif *netif, struct pbuf *p)
+{
+    struct eth_hdr *ethhdr = p->payload;
+
+    if (ethhdr->type != PP_HTONS(ETHTYPE_IP) || p->len < SIZEOF_ETH_HDR + IP_HLEN)
+        return 1;
+
+    uint8_t *ip = (uint8_t *)p->payload + SIZEOF_ETH_HDR;
+    uint16_t hlen = (ip[0] & 0x0f) * 4;
+    uint8_t proto = ip[IP_OFS_PROTO];
+    uint16_t l4_len = l4_min_len(proto);
+    bool fragment = (get16(ip + IP_OFS_FRAG) & PP_HTONS(IP_OFFMASK | IP_MF)) != 0;
+    portTickType now = xTaskGetTickCount();
+
+    if (netif == ap_netif) {
+        uint32_t src = get32(ip + IP_OFS_SRC);
+        uint32_t dst = get32(ip + IP_OFS_DST);
+        uint32_t mask = ip4_addr_get_u32(&netif->netmask);
+        uint32_t net = ip4_addr_get_u32(&netif->ip_addr) & mask;
+
+        /* Only from a client, to somewhere beyond the softAP's subnet */
+        if ((src & mask) != net || (dst & mask) == net || ip_addr_ismulticast((ip_addr_t *)&dst)
+            || dst == IPADDR_BROADCAST)
+            return 1;
+        if (fragment || !l4_len || p->len < SIZEOF_ETH_HDR + hlen + l4_len) {
+            stats.dropped++;
+            return 0;
+        }
+        return napt_outbound(ip, ip + hlen, proto, now);
+    }
+
+    if (netif == sta_netif && !fragment && l4_len && p->len >= SIZEOF_ETH_HDR + hlen + l4_len
+        && get32(ip + IP_OFS_DST) == ip4_addr_get_u32(&netif->ip_addr))
+        napt_inbound(ip, ip + hlen, proto, now);
+    return 1;
+}
+
+bool napt_enable(void)
+{
+    if (!sdk_g_ic.v.station_netif_info || !sdk_g_ic.v.softap_netif_info)
+        return false;
+
+    ethernetif_filter_set_hook(NULL);
+    ap_netif = sdk_g_ic.v.softap_netif_info->netif;
+    sta_netif = sdk_g_ic.v.station_netif_info->netif;
+    if (!ap_netif || !sta_netif)
+        return false;
+
+    table_reset();
+    memset(&stats, 0, sizeof(stats));
+    netif_set_default(sta_netif);
+    ethernetif_filter_set_hook(napt_hook);
+    return true;
+}
+
+void napt_disable(void)
+{
+    ethernetif_filter_set_hook(NULL);
+    table_reset();
+}
+
+void napt_get_stats(napt_stats_t *out)
+{
+    *out = stats;
+}
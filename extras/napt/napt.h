@@ -0,0 +1,103 @@
+/* NAPT between the softAP and the station interface, for repeaters
+ *
+ * With the ESP in STATIONAP_MODE, clients of the softAP reach the
+ * station side's network (and whatever is beyond it) through the
+ * station's address: TCP and UDP source ports, and ICMP echo ids, are
+ * mapped to ports of our own, and replies mapped back.
+ *
+ * Translation happens on the WLAN receive path (as an ethernetif
+ * filter hook, see ethernetif_filter.h), before frames are queued to
+ * tcpip_thread: the IP and transport headers are rewritten in place,
+ * with incremental checksum updates, and lwIP's IP forwarding then
+ * resolves the next hop and sends the frame out of the other interface.
+ * No sockets or copies are involved.
+ *
+ * The connection table has NAPT_MAX_ENTRIES entries, each found by a
+ * hash of the client side addresses and ports going out and by the
+ * mapped port coming in. Entries expire after NAPT_*_TIMEOUT_S seconds
+ * without traffic. A new connection when the table is full and nothing
+ * has expired is dropped.
+ *
+ * Needs lwIP built with IP forwarding: build with EXTRA_CFLAGS=
+ * -DIP_FORWARD=1. The softAP's DHCP clients also need a router and DNS
+ * server, see dhcpserver_set_router()/dhcpserver_set_dns().
+ *
+ * Limitations: IP fragments from softAP clients are dropped, and ICMP
+ * errors (port unreachable, ...) aren't passed back to them.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _NAPT_H
+#define _NAPT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifndef NAPT_MAX_ENTRIES
+#define NAPT_MAX_ENTRIES 128
+#endif
+
+/* Hash buckets for each direction, a power of 2 */
+#ifndef NAPT_HASH_SIZE
+#define NAPT_HASH_SIZE 64
+#endif
+
+/* Mapped ports, kept clear of lwIP's own local ports (from 0xc000) */
+#ifndef NAPT_PORT_MIN
+#define NAPT_PORT_MIN 40000
+#endif
+#ifndef NAPT_PORT_MAX
+#define NAPT_PORT_MAX 48999
+#endif
+
+#ifndef NAPT_TCP_TIMEOUT_S
+#define NAPT_TCP_TIMEOUT_S 1800
+#endif
+/* TCP connections after a RST, or a FIN each way */
+#ifndef NAPT_TCP_CLOSED_TIMEOUT_S
+#define NAPT_TCP_CLOSED_TIMEOUT_S 10
+#endif
+#ifndef NAPT_UDP_TIMEOUT_S
+#define NAPT_UDP_TIMEOUT_S 60
+#endif
+#ifndef NAPT_ICMP_TIMEOUT_S
+#define NAPT_ICMP_TIMEOUT_S 10
+#endif
+
+typedef struct {
+    uint32_t outbound;      /* packets translated, client to station side */
+    uint32_t inbound;       /* and back */
+    uint32_t dropped;       /* fragments, and packets while unconnected */
+    uint32_t table_full;    /* new connections dropped */
+    uint16_t active;        /* entries in use */
+} napt_stats_t;
+
+/* Start translating. Call in STATIONAP_MODE, once the softAP's address
+   is set. The station's address is read for every packet, so it may
+   come and go (DHCP, reconnects) while enabled.
+
+   Makes the station the default interface, and installs the ethernetif
+   filter hook, so there can't be another hook at the same time.
+   Filter rules still run first: frames a rule accepts or drops aren't
+   translated.
+
+   Returns false if either interface isn't there.
+*/
+bool napt_enable(void);
+
+/* Stop translating, and forget all connections */
+void napt_disable(void);
+
+void napt_get_stats(napt_stats_t *stats);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _NAPT_H */
@@ -0,0 +1,9 @@
+# Component makefile for extras/netcork
+
+# expected anyone using netcork includes it as 'netcork/netcork.h'
+INC_DIRS += $(netcork_ROOT)..
+
+# args for passing into compile rule generation
+netcork_SRC_DIR =  $(netcork_ROOT)
+
+$(eval $(call component_compile_rules,netcork))
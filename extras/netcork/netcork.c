@@ -0,0 +1,147 @@
+/* Write coalescing for netconn TCP connections, see netcork.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "netcork.h"
+
+#include <string.h>
+#include <stdbool.h>
+
+#include <task.h>
+
+/* Write out the buffer, with ck->lock held. If 'block' is false only
+   what fits in the send buffer now is written, and the rest moved to
+   the front of the buffer. */
+static err_t flush_locked(netcork_t *ck, bool block)
+{
+    if (!ck->len)
+        return ERR_OK;
+
+    size_t written = 0;
+    err_t err = netconn_write_partly(ck->conn, ck->buf, ck->len,
+                                     NETCONN_COPY | (block ? 0 : NETCONN_DONTBLOCK), &written);
+    if (block && err == ERR_OK)
+        written = ck->len;
+    if (written)
+        ck->flushes++;
+    if (err != ERR_OK && err != ERR_WOULDBLOCK) {
+        ck->len = 0;
+        return err;
+    }
+    ck->len -= written;
+    memmove(ck->buf, ck->buf + written, ck->len);
+    return ck->len ? ERR_WOULDBLOCK : ERR_OK;
+}
+
+static void timer_cb(xTimerHandle timer)
+{
+    netcork_t *ck = pvTimerGetTimerID(timer);
+
+    /* A writer holding the lock restarts the timer if it leaves data */
+    if (xSemaphoreTake(ck->lock, 0) != pdTRUE)
+        return;
+    err_t err = flush_locked(ck, false);
+    if (err == ERR_WOULDBLOCK)
+        xTimerStart(ck->timer, 0);
+    else if (err != ERR_OK)
+        ck->err = err;
+    xSemaphoreGive(ck->lock);
+}
+
+err_t netcork_init(netcork_t *ck, struct netconn *conn, uint32_t flush_ms)
+{
+    memset(ck, 0, sizeof(*ck));
+    ck->conn = conn;
+    ck->lock = xSemaphoreCreateMutex();
+    if (!ck->lock)
+        return ERR_MEM;
+    if (flush_ms) {
+        portTickType ticks = flush_ms / portTICK_RATE_MS;
+        ck->timer = xTimerCreate((signed char *)"cork", ticks ? ticks : 1, pdFALSE, ck, timer_cb);
+        if (!ck->timer) {
+            vSemaphoreDelete(ck->lock);
+            return ERR_MEM;
+        }
+    }
+    return ERR_OK;
+}
+
+err_t netcork_write(netcork_t *ck, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    err_t err = ERR_OK;
+
+    xSemaphoreTake(ck->lock, portMAX_DELAY);
+    ck->writes++;
+    if (ck->err != ERR_OK) {
+        err = ck->err;
+        ck->err = ERR_OK;
+        goto out;
+    }
+    bool was_empty = (ck->len == 0);
+
+    while (len) {
+        if (!ck->len && len >= sizeof(ck->buf)) {
+            /* Whole buffers' worth, straight from the caller */
+            size_t n = len - len % sizeof(ck->buf);
+            err = netconn_write(ck->conn, p, n, NETCONN_COPY);
+            if (err != ERR_OK)
+                goto out;
+            ck->flushes++;
+            p += n;
+            len -= n;
+            continue;
+        }
+        size_t n = sizeof(ck->buf) - ck->len;
+        if (n > len)
+            n = len;
+        memcpy(ck->buf + ck->len, p, n);
+        ck->len += n;
+        p += n;
+        len -= n;
+        if (ck->len == sizeof(ck->buf)) {
+            err = flush_locked(ck, true);
+            if (err != ERR_OK)
+                goto out;
+        }
+    }
+
+    /* The timer runs from the first byte waiting, not the last, so a
+       steady trickle of writes still goes out every flush_ms */
+    if (ck->timer && ck->len && (was_empty || !xTimerIsTimerActive(ck->timer)))
+        xTimerStart(ck->timer, 0);
+
+out:
+    xSemaphoreGive(ck->lock);
+    return err;
+}
+
+err_t netcork_flush(netcork_t *ck)
+{
+    xSemaphoreTake(ck->lock, portMAX_DELAY);
+    err_t err = ck->err;
+    ck->err = ERR_OK;
+    if (err == ERR_OK)
+        err = flush_locked(ck, true);
+    if (ck->timer)
+        xTimerStop(ck->timer, 0);
+    xSemaphoreGive(ck->lock);
+    return err;
+}
+
+err_t netcork_free(netcork_t *ck)
+{
+    err_t err = netcork_flush(ck);
+    if (ck->timer) {
+        xTimerDelete(ck->timer, portMAX_DELAY);
+        ck->timer = NULL;
+        /* let the timer task process the delete, and finish a callback
+           it may have started, before the lock goes away */
+        vTaskDelay(1);
+    }
+    vSemaphoreDelete(ck->lock);
+    ck->lock = NULL;
+    return err;
+}
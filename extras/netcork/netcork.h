@@ -0,0 +1,80 @@
+/* Write coalescing ("cork") for netconn TCP connections
+ *
+ * Every netconn_write() is a message to tcpip_thread and a round trip
+ * back, and usually its own TCP segment, so a connection written a
+ * few bytes at a time (a terminal, a serial bridge) costs a segment's
+ * worth of airtime and two context switches per write. A netcork_t
+ * gathers writes into a buffer of NETCORK_SIZE bytes, by default one
+ * full segment, and hands it to netconn_write() once it fills, when
+ * the writer calls netcork_flush(), or at most 'flush_ms' after the
+ * first byte waiting went in, whichever comes first.
+ *
+ * Writes of a whole buffer or more when nothing is waiting go straight
+ * to netconn_write(), in whole buffers, without a copy here.
+ *
+ *   netcork_t cork;
+ *   netcork_init(&cork, conn, 20);
+ *   netcork_write(&cork, &c, 1);   // many times
+ *   ...
+ *   netcork_free(&cork);           // flushes, conn stays open
+ *
+ * The flush timer is a FreeRTOS software timer. It never blocks the
+ * timer task: it doesn't wait for a writer to finish, or for send
+ * buffer space, and tries again one interval later instead.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _NETCORK_H
+#define _NETCORK_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <FreeRTOS.h>
+#include <semphr.h>
+#include <timers.h>
+
+#include <lwip/api.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifndef NETCORK_SIZE
+#define NETCORK_SIZE TCP_MSS
+#endif
+
+typedef struct {
+    struct netconn *conn;
+    xSemaphoreHandle lock;
+    xTimerHandle timer;
+    err_t err;              /* of the last flush from the timer */
+    uint16_t len;
+    uint32_t writes;        /* netcork_write() calls */
+    uint32_t flushes;       /* netconn writes they turned into */
+    uint8_t buf[NETCORK_SIZE];
+} netcork_t;
+
+/* Cork 'conn', flushing at most 'flush_ms' after a write (0 waits for
+   the buffer to fill or an explicit flush). Returns ERR_MEM if the lock
+   or timer couldn't be created. */
+err_t netcork_init(netcork_t *ck, struct netconn *conn, uint32_t flush_ms);
+
+/* Write 'len' bytes, blocking only if a flush has to wait for send
+   buffer space. Returns ERR_OK, or the netconn error of a failed flush
+   (including one from the timer, which has dropped its data). */
+err_t netcork_write(netcork_t *ck, const void *data, size_t len);
+
+/* Write out anything waiting, blocking until it's queued for sending */
+err_t netcork_flush(netcork_t *ck);
+
+/* Flush and release the cork. Doesn't close the connection. */
+err_t netcork_free(netcork_t *ck);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _NETCORK_H */
@@ -1,4 +1,10 @@
 #include "onewire.h"
+#include <string.h>
+#include <crc.h>
+#include <esp/hrtimer.h>
+#include <esp/clocks.h>
+#include "task.h"
+#include "semphr.h"
 
 // global search state
 static unsigned char ROM_NO[ONEWIRE_NUM][8];
@@ -6,9 +12,181 @@ static uint8_t LastDiscrepancy[ONEWIRE_NUM];
 static uint8_t LastFamilyDiscrepancy[ONEWIRE_NUM];
 static uint8_t LastDeviceFlag[ONEWIRE_NUM];
 
+// Bit engine
+//
+// A reset, or a run of bits to write or read, is a sequence of hrtimer
+// events. Each event does the part of a slot that needs microsecond
+// accuracy (at most 13us of busy waiting, for a read) and arms the
+// timer for the slot's remaining time, during which the CPU is free.
+// Slots may be stretched by interrupt latency, the 1-Wire timing only
+// limits how short the recovery times can be.
+
+typedef enum {
+	OW_RESET,
+	OW_WRITE,
+	OW_READ,
+} onewire_op_t;
+
+static struct {
+	hrtimer_t timer;
+	uint32_t mask;
+	onewire_op_t op;
+	uint8_t *buf;
+	uint32_t nbits;
+	uint32_t bit;
+	uint8_t phase;
+	uint8_t result;
+	volatile bool done;
+	xTaskHandle waiter;
+} engine;
+
+static xSemaphoreHandle engine_mutex;
+static StaticSemaphore_t engine_mutex_buffer;
+
+static inline void IRAM delay_us(uint32_t us)
+{
+	uint32_t start, now;
+	uint32_t cycles = us * (cpu_clk_freq() / 1000000);
+	__asm__ volatile ("rsr %0, ccount" : "=a" (start));
+	do {
+		__asm__ volatile ("rsr %0, ccount" : "=a" (now));
+	} while (now - start < cycles);
+}
+
+static void IRAM engine_done(void)
+{
+	portBASE_TYPE woken = pdFALSE;
+
+	engine.done = true;
+	if (engine.waiter) {
+		vTaskNotifyGiveFromISR(engine.waiter, &woken);
+		if (woken)
+			portYIELD();
+	}
+}
+
+static void IRAM engine_event(hrtimer_t *timer, void *arg)
+{
+	const uint32_t mask = engine.mask;
+	uint32_t next = 0;
+
+	switch (engine.op) {
+	case OW_RESET:
+		switch (engine.phase++) {
+		case 0:		// drive output low
+			GPIO.OUT_CLEAR = mask;
+			GPIO.ENABLE_OUT_SET = mask;
+			next = 480;
+			break;
+		case 1:		// allow it to float
+			GPIO.ENABLE_OUT_CLEAR = mask;
+			next = 70;
+			break;
+		case 2:
+			engine.result = !(GPIO.IN & mask);
+			next = 410;
+			break;
+		default:
+			engine_done();
+			return;
+		}
+		break;
+	case OW_WRITE:
+		if (engine.phase) {
+			// end of the low pulse of a 0
+			GPIO.OUT_SET = mask;	// drive output high
+			engine.phase = 0;
+			engine.bit++;
+			next = 5;
+			break;
+		}
+		if (engine.bit == engine.nbits) {
+			engine_done();
+			return;
+		}
+		GPIO.OUT_CLEAR = mask;
+		GPIO.ENABLE_OUT_SET = mask;	// drive output low
+		if (engine.buf[engine.bit >> 3] & BIT(engine.bit & 7)) {
+			delay_us(10);
+			GPIO.OUT_SET = mask;	// drive output high
+			engine.bit++;
+			next = 55;
+		} else {
+			engine.phase = 1;
+			next = 65;
+		}
+		break;
+	case OW_READ:
+		if (engine.bit == engine.nbits) {
+			engine_done();
+			return;
+		}
+		GPIO.OUT_CLEAR = mask;
+		GPIO.ENABLE_OUT_SET = mask;
+		delay_us(3);
+		GPIO.ENABLE_OUT_CLEAR = mask;	// let pin float, pull up will raise
+		delay_us(10);
+		if (GPIO.IN & mask)
+			engine.buf[engine.bit >> 3] |= BIT(engine.bit & 7);
+		engine.bit++;
+		next = 53;
+		break;
+	}
+
+	if (!hrtimer_start(&engine.timer, next, 0)) {
+		// No timer free, give up rather than leave the caller blocked
+		engine.result = 0;
+		engine_done();
+	}
+}
+
+// Run one operation on 'pin' and wait for it to finish. Returns the
+// presence result for OW_RESET.
+static uint8_t engine_run(uint8_t pin, onewire_op_t op, uint8_t *buf, uint32_t nbits)
+{
+	bool scheduler = xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED;
+
+	if (scheduler && engine_mutex)
+		xSemaphoreTake(engine_mutex, portMAX_DELAY);
+
+	engine.mask = BIT(pin);
+	engine.op = op;
+	engine.buf = buf;
+	engine.nbits = nbits;
+	engine.bit = 0;
+	engine.phase = 0;
+	engine.result = 0;
+	engine.done = false;
+	engine.waiter = scheduler ? xTaskGetCurrentTaskHandle() : NULL;
+	if (scheduler)
+		ulTaskNotifyTake(pdTRUE, 0);
+
+	// The first event runs here, the rest from the timer interrupt
+	portENTER_CRITICAL();
+	engine_event(&engine.timer, NULL);
+	portEXIT_CRITICAL();
+
+	while (!engine.done) {
+		if (scheduler)
+			ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+	}
+	engine.waiter = NULL;
+
+	if (scheduler && engine_mutex)
+		xSemaphoreGive(engine_mutex);
+	return engine.result;
+}
+
 void onewire_init(uint8_t pin)
 {
-  gpio_enable(pin, GPIO_INPUT);  
+  if (!engine_mutex) {
+    engine_mutex = xSemaphoreCreateMutexStatic(&engine_mutex_buffer);
+    hrtimer_init(&engine.timer, engine_event, NULL);
+  }
+  // GPIO function with the output buffer connected, but not driving
+  gpio_enable(pin, GPIO_INPUT);
+  DIRECT_WRITE_LOW(pin);
+  iomux_set_gpio_function(pin, true);
   onewire_reset_search(pin);
 }
 
@@ -20,72 +198,32 @@ void onewire_init(uint8_t pin)
 //
 uint8_t onewire_reset(uint8_t pin)
 {
-	uint8_t r;
 	uint8_t retries = 125;
 
-	noInterrupts();
 	DIRECT_MODE_INPUT(pin);
-	interrupts();
 	// wait until the wire is high... just in case
 	do {
 		if (--retries == 0) return 0;
 		delayMicroseconds(2);
 	} while ( !DIRECT_READ(pin));
 
-	noInterrupts();
-	DIRECT_WRITE_LOW(pin);
-	DIRECT_MODE_OUTPUT(pin);	// drive output low
-	interrupts();
-	delayMicroseconds(480);
-	noInterrupts();
-	DIRECT_MODE_INPUT(pin);	// allow it to float
-	delayMicroseconds(70);
-	r = !DIRECT_READ(pin);
-	interrupts();
-	delayMicroseconds(410);
-	return r;
+	return engine_run(pin, OW_RESET, NULL, 0);
 }
 
-// Write a bit. Port and bit is used to cut lookup time and provide
-// more certain timing.
+// Write a bit. The bus is left driven high at the end.
 //
 static void onewire_write_bit(uint8_t pin, uint8_t v)
 {
-	if (v & 1) {
-		noInterrupts();
-		DIRECT_WRITE_LOW(pin);
-		DIRECT_MODE_OUTPUT(pin);	// drive output low
-		delayMicroseconds(10);
-		DIRECT_WRITE_HIGH(pin);	// drive output high
-		interrupts();
-		delayMicroseconds(55);
-	} else {
-		noInterrupts();
-		DIRECT_WRITE_LOW(pin);
-		DIRECT_MODE_OUTPUT(pin);	// drive output low
-		delayMicroseconds(65);
-		DIRECT_WRITE_HIGH(pin);	// drive output high
-		interrupts();
-		delayMicroseconds(5);
-	}
+	engine_run(pin, OW_WRITE, &v, 1);
 }
 
-// Read a bit. Port and bit is used to cut lookup time and provide
-// more certain timing.
+// Read a bit.
 //
 static uint8_t onewire_read_bit(uint8_t pin)
 {
-	uint8_t r;
-
-	noInterrupts();
-	DIRECT_MODE_OUTPUT(pin);
-	DIRECT_WRITE_LOW(pin);
-	delayMicroseconds(3);
-	DIRECT_MODE_INPUT(pin);	// let pin float, pull up will raise
-	delayMicroseconds(10);
-	r = DIRECT_READ(pin);
-	interrupts();
-	delayMicroseconds(53);
+	uint8_t r = 0;
+
+	engine_run(pin, OW_READ, &r, 1);
 	return r;
 }
 
@@ -96,58 +234,44 @@ static uint8_t onewire_read_bit(uint8_t pin)
 // other mishap.
 //
 void onewire_write(uint8_t pin, uint8_t v, uint8_t power /* = 0 */) {
-  uint8_t bitMask;
-
-  for (bitMask = 0x01; bitMask; bitMask <<= 1) {
-	  onewire_write_bit(pin, (bitMask & v)?1:0);
-  }
+  engine_run(pin, OW_WRITE, &v, 8);
   if ( !power) {
-  	noInterrupts();
   	DIRECT_MODE_INPUT(pin);
   	DIRECT_WRITE_LOW(pin);
-  	interrupts();
   }
 }
 
 void onewire_write_bytes(uint8_t pin, const uint8_t *buf, uint16_t count, bool power /* = 0 */) {
-  uint16_t i;
-  for (i = 0 ; i < count ; i++)
-    onewire_write(pin, buf[i], ONEWIRE_DEFAULT_POWER);
+  engine_run(pin, OW_WRITE, (uint8_t *)buf, (uint32_t)count * 8);
   if (!power) {
-    noInterrupts();
     DIRECT_MODE_INPUT(pin);
     DIRECT_WRITE_LOW(pin);
-    interrupts();
   }
 }
 
 // Read a byte
 //
 uint8_t onewire_read(uint8_t pin) {
-  uint8_t bitMask;
   uint8_t r = 0;
 
-  for (bitMask = 0x01; bitMask; bitMask <<= 1) {
-  	if (onewire_read_bit(pin)) r |= bitMask;
-  }
+  engine_run(pin, OW_READ, &r, 8);
   return r;
 }
 
 void onewire_read_bytes(uint8_t pin, uint8_t *buf, uint16_t count) {
-  uint16_t i;
-  for (i = 0 ; i < count ; i++)
-    buf[i] = onewire_read(pin);
+  memset(buf, 0, count);
+  engine_run(pin, OW_READ, buf, (uint32_t)count * 8);
 }
 
 // Do a ROM select
 //
 void onewire_select(uint8_t pin, const uint8_t rom[8])
 {
-    uint8_t i;
-
-    onewire_write(pin, 0x55, ONEWIRE_DEFAULT_POWER);           // Choose ROM
+    uint8_t buf[9];
 
-    for (i = 0; i < 8; i++) onewire_write(pin, rom[i], ONEWIRE_DEFAULT_POWER);
+    buf[0] = 0x55;           // Choose ROM
+    memcpy(buf + 1, rom, 8);
+    onewire_write_bytes(pin, buf, sizeof(buf), ONEWIRE_DEFAULT_POWER);
 }
 
 // Do a ROM skip
@@ -159,9 +283,7 @@ void onewire_skip(uint8_t pin)
 
 void onewire_depower(uint8_t pin)
 {
-	noInterrupts();
 	DIRECT_MODE_INPUT(pin);
-	interrupts();
 }
 
 // You need to use this function to start a search again from the beginning.
@@ -339,69 +461,14 @@ uint8_t onewire_search(uint8_t pin, uint8_t *newAddr)
 // "Understanding and Using Cyclic Redundancy Checks with Maxim iButton Products"
 //
 
-#if ONEWIRE_CRC8_TABLE
-// This table comes from Dallas sample code where it is freely reusable,
-// though Copyright (C) 2000 Dallas Semiconductor Corporation
-static const uint8_t dscrc_table[] = {
-      0, 94,188,226, 97, 63,221,131,194,156,126, 32,163,253, 31, 65,
-    157,195, 33,127,252,162, 64, 30, 95,  1,227,189, 62, 96,130,220,
-     35,125,159,193, 66, 28,254,160,225,191, 93,  3,128,222, 60, 98,
-    190,224,  2, 92,223,129, 99, 61,124, 34,192,158, 29, 67,161,255,
-     70, 24,250,164, 39,121,155,197,132,218, 56,102,229,187, 89,  7,
-    219,133,103, 57,186,228,  6, 88, 25, 71,165,251,120, 38,196,154,
-    101, 59,217,135,  4, 90,184,230,167,249, 27, 69,198,152,122, 36,
-    248,166, 68, 26,153,199, 37,123, 58,100,134,216, 91,  5,231,185,
-    140,210, 48,110,237,179, 81, 15, 78, 16,242,172, 47,113,147,205,
-     17, 79,173,243,112, 46,204,146,211,141,111, 49,178,236, 14, 80,
-    175,241, 19, 77,206,144,114, 44,109, 51,209,143, 12, 82,176,238,
-     50,108,142,208, 83, 13,239,177,240,174, 76, 18,145,207, 45,115,
-    202,148,118, 40,171,245, 23, 73,  8, 86,180,234,105, 55,213,139,
-     87,  9,235,181, 54,104,138,212,149,203, 41,119,244,170, 72, 22,
-    233,183, 85, 11,136,214, 52,106, 43,117,151,201, 74, 20,246,168,
-    116, 42,200,150, 21, 75,169,247,182,232, 10, 84,215,137,107, 53};
-
-#ifndef pgm_read_byte
-#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
-#endif
-
-//
 // Compute a Dallas Semiconductor 8 bit CRC. These show up in the ROM
-// and the registers.  (note: this might better be done without to
-// table, it would probably be smaller and certainly fast enough
-// compared to all those delayMicrosecond() calls.  But I got
-// confused, so I use this table from the examples.)
+// and the registers. The table or bit loop is picked by CRC_KERNEL, see
+// crc.h.
 //
 uint8_t onewire_crc8(const uint8_t *addr, uint8_t len)
 {
-	uint8_t crc = 0;
-
-	while (len--) {
-		crc = pgm_read_byte(dscrc_table + (crc ^ *addr++));
-	}
-	return crc;
+	return crc8_maxim(0, addr, len);
 }
-#else
-//
-// Compute a Dallas Semiconductor 8 bit CRC directly.
-// this is much slower, but much smaller, than the lookup table.
-//
-uint8_t onewire_crc8(const uint8_t *addr, uint8_t len)
-{
-	uint8_t crc = 0;
-	
-	while (len--) {
-		uint8_t inbyte = *addr++;
-    uint8_t i;
-		for (i = 8; i; i--) {
-			uint8_t mix = (crc ^ inbyte) & 0x01;
-			crc >>= 1;
-			if (mix) crc ^= 0x8C;
-			inbyte >>= 1;
-		}
-	}
-	return crc;
-}
-#endif
 
 // Compute the 1-Wire CRC16 and compare it against the received CRC.
 // Example usage (reading a DS2408):
@@ -443,24 +510,5 @@ bool onewire_check_crc16(const uint8_t* input, uint16_t len, const uint8_t* inve
 // @return The CRC16, as defined by Dallas Semiconductor.
 uint16_t onewire_crc16(const uint8_t* input, uint16_t len, uint16_t crc)
 {
-    static const uint8_t oddparity[16] =
-        { 0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 1, 1, 0 };
-
-    uint16_t i;
-    for (i = 0 ; i < len ; i++) {
-      // Even though we're just copying a byte from the input,
-      // we'll be doing 16-bit computation with it.
-      uint16_t cdata = input[i];
-      cdata = (cdata ^ crc) & 0xff;
-      crc >>= 8;
-
-      if (oddparity[cdata & 0x0F] ^ oddparity[cdata >> 4])
-          crc ^= 0xC001;
-
-      cdata <<= 6;
-      crc ^= cdata;
-      cdata <<= 1;
-      crc ^= cdata;
-    }
-    return crc;
-}
\ No newline at end of file
+    return crc16_ibm(crc, input, len);
+}
@@ -10,36 +10,32 @@
 // Maximum number of devices.
 #define ONEWIRE_NUM 20
 
-// You can exclude certain features from OneWire.  In theory, this
-// might save some space.  In practice, the compiler automatically
-// removes unused code (technically, the linker, using -fdata-sections
-// and -ffunction-sections when compiling, and Wl,--gc-sections
-// when linking), so most of these will not result in any code size
-// reduction.  Well, unless you try to use the missing features
-// and redesign your program to not need them!  ONEWIRE_CRC8_TABLE
-// is the exception, because it selects a fast but large algorithm
-// or a small but slow algorithm.
-
-// Select the table-lookup method of computing the 8-bit CRC
-// by setting this to 1.  The lookup table enlarges code size by
-// about 250 bytes.  It does NOT consume RAM (but did in very
-// old versions of OneWire).  If you disable this, a slower
-// but very compact algorithm is used.
-#ifndef ONEWIRE_CRC8_TABLE
-#define ONEWIRE_CRC8_TABLE 0
-#endif
+// The CRC functions below use the shared implementation in crc.h,
+// whose CRC_KERNEL setting selects a table or a bit loop (the old
+// ONEWIRE_CRC8_TABLE setting is no longer used).
 
 // Platform specific I/O definitions
 #define noInterrupts portDISABLE_INTERRUPTS
 #define interrupts portENABLE_INTERRUPTS
 #define delayMicroseconds sdk_os_delay_us
 
-#define DIRECT_READ(pin)         gpio_read(pin)
-#define DIRECT_MODE_INPUT(pin)   gpio_enable(pin, GPIO_INPUT)
-#define DIRECT_MODE_OUTPUT(pin)  gpio_enable(pin, GPIO_OUTPUT)
-#define DIRECT_WRITE_LOW(pin)    gpio_write(pin, 0)
-#define DIRECT_WRITE_HIGH(pin)   gpio_write(pin, 1)
-
+// Direct GPIO register access, usable from the bit engine's timer
+// interrupt. The pin is switched between input and output with the
+// output enable, after onewire_init() has set it up.
+#define DIRECT_READ(pin)         ((GPIO.IN >> (pin)) & 1)
+#define DIRECT_MODE_INPUT(pin)   (GPIO.ENABLE_OUT_CLEAR = BIT(pin))
+#define DIRECT_MODE_OUTPUT(pin)  (GPIO.ENABLE_OUT_SET = BIT(pin))
+#define DIRECT_WRITE_LOW(pin)    (GPIO.OUT_CLEAR = BIT(pin))
+#define DIRECT_WRITE_HIGH(pin)   (GPIO.OUT_SET = BIT(pin))
+
+// Set up a pin (GPIO0-15) for 1-Wire.
+//
+// The bit timing is done from esp/hrtimer.h timer interrupts: only the
+// few microseconds of each slot that need exact timing (the low pulse
+// of a 1 or a read, up to the read sample) are spent with interrupts
+// disabled, and the calling task is blocked until a whole reset, byte
+// or buffer has been sent or received. One transfer runs at a time,
+// tasks using other pins wait for it.
 void onewire_init(uint8_t pin);
 
 // Perform a 1-Wire reset cycle. Returns 1 if a device responds
@@ -0,0 +1,187 @@
+#include "onewire.h"
+#include "onewire_cache.h"
+
+#include <string.h>
+#include "esp/rtcmem_regs.h"
+
+#define CACHE_MAGIC 0x3143574f  // "OWC1"
+
+_Static_assert(ONEWIRE_CACHE_MAX <= 32, "ONEWIRE_CACHE_MAX is limited by onewire_cache_t.seen");
+
+void onewire_cache_init(onewire_cache_t *cache, uint8_t pin, uint8_t family)
+{
+    memset(cache, 0, sizeof(*cache));
+    cache->pin = pin;
+    cache->family = family;
+}
+
+int onewire_cache_find(const onewire_cache_t *cache, const uint8_t rom[8])
+{
+    for (int i = 0; i < cache->count; i++) {
+        if (!memcmp(cache->rom[i], rom, 8))
+            return i;
+    }
+    return -1;
+}
+
+static void start_pass(onewire_cache_t *cache)
+{
+    if (cache->family)
+        onewire_target_search(cache->pin, cache->family);
+    else
+        onewire_reset_search(cache->pin);
+}
+
+// Find the next device of the pass, false at the end of it. ROMs with a
+// bad CRC are skipped.
+static bool next_device(onewire_cache_t *cache, uint8_t *addr)
+{
+    while (onewire_search(cache->pin, addr)) {
+        // A targeted search carries on into other families once ours are done
+        if (cache->family && addr[0] != cache->family) {
+            onewire_reset_search(cache->pin);
+            return false;
+        }
+        if (onewire_crc8(addr, 7) == addr[7])
+            return true;
+    }
+    return false;
+}
+
+uint8_t onewire_cache_scan(onewire_cache_t *cache)
+{
+    uint8_t addr[8];
+
+    cache->count = 0;
+    cache->polling = false;
+    start_pass(cache);
+    while (cache->count < ONEWIRE_CACHE_MAX && next_device(cache, addr)) {
+        if (onewire_cache_find(cache, addr) < 0) {
+            cache->misses[cache->count] = 0;
+            memcpy(cache->rom[cache->count++], addr, 8);
+        }
+    }
+    if (cache->count == ONEWIRE_CACHE_MAX)
+        onewire_reset_search(cache->pin);
+    return cache->count;
+}
+
+int onewire_cache_poll(onewire_cache_t *cache)
+{
+    uint8_t addr[8];
+    int changes = 0;
+
+    if (!cache->polling) {
+        start_pass(cache);
+        cache->polling = true;
+        cache->seen = 0;
+    }
+
+    if (next_device(cache, addr)) {
+        int i = onewire_cache_find(cache, addr);
+        if (i < 0 && cache->count < ONEWIRE_CACHE_MAX) {
+            i = cache->count++;
+            memcpy(cache->rom[i], addr, 8);
+            changes |= ONEWIRE_CACHE_ADDED;
+        }
+        if (i >= 0) {
+            cache->seen |= 1u << i;
+            cache->misses[i] = 0;
+        }
+        return changes;
+    }
+
+    // End of the pass, count misses from the top so removing an entry
+    // only moves ones already handled
+    cache->polling = false;
+    for (int i = cache->count - 1; i >= 0; i--) {
+        if (cache->seen & (1u << i))
+            continue;
+        if (++cache->misses[i] < ONEWIRE_CACHE_MISSES)
+            continue;
+        cache->count--;
+        memmove(cache->rom[i], cache->rom[i + 1], (cache->count - i) * 8);
+        memmove(&cache->misses[i], &cache->misses[i + 1], cache->count - i);
+        changes |= ONEWIRE_CACHE_REMOVED;
+    }
+    return changes | ONEWIRE_CACHE_PASS_DONE;
+}
+
+// Image: magic, pin, family, count, 0, the ROMs, then the CRC16 of all
+// of that and two bytes of padding.
+
+size_t onewire_cache_save(const onewire_cache_t *cache, void *buf, size_t len)
+{
+    uint8_t *p = buf;
+    size_t size = ONEWIRE_CACHE_IMAGE_SIZE(cache->count);
+    uint32_t magic = CACHE_MAGIC;
+    uint16_t crc;
+
+    if (len < size)
+        return 0;
+    memcpy(p, &magic, 4);
+    p[4] = cache->pin;
+    p[5] = cache->family;
+    p[6] = cache->count;
+    p[7] = 0;
+    memcpy(p + 8, cache->rom, 8 * cache->count);
+    crc = onewire_crc16(p, size - 4, 0);
+    p[size - 4] = crc & 0xff;
+    p[size - 3] = crc >> 8;
+    p[size - 2] = 0;
+    p[size - 1] = 0;
+    return size;
+}
+
+bool onewire_cache_load(onewire_cache_t *cache, const void *buf, size_t len)
+{
+    const uint8_t *p = buf;
+    uint32_t magic;
+    size_t size;
+    uint16_t crc;
+
+    if (len < ONEWIRE_CACHE_IMAGE_SIZE(0))
+        return false;
+    memcpy(&magic, p, 4);
+    if (magic != CACHE_MAGIC || p[6] > ONEWIRE_CACHE_MAX)
+        return false;
+    size = ONEWIRE_CACHE_IMAGE_SIZE(p[6]);
+    if (len < size)
+        return false;
+    crc = onewire_crc16(p, size - 4, 0);
+    if (p[size - 4] != (crc & 0xff) || p[size - 3] != (crc >> 8))
+        return false;
+
+    onewire_cache_init(cache, p[4], p[5]);
+    cache->count = p[6];
+    memcpy(cache->rom, p + 8, 8 * cache->count);
+    return true;
+}
+
+// RTC memory only supports word accesses
+
+bool onewire_cache_save_rtc(const onewire_cache_t *cache, unsigned word_offset)
+{
+    uint32_t words[ONEWIRE_CACHE_IMAGE_SIZE(ONEWIRE_CACHE_MAX) / 4];
+    size_t size = onewire_cache_save(cache, words, sizeof(words));
+
+    if (word_offset + size / 4 > sizeof(RTCMEM_USER) / sizeof(uint32_t))
+        return false;
+    for (int i = 0; i < size / 4; i++)
+        RTCMEM_USER[word_offset + i] = words[i];
+    return true;
+}
+
+bool onewire_cache_load_rtc(onewire_cache_t *cache, unsigned word_offset)
+{
+    uint32_t words[ONEWIRE_CACHE_IMAGE_SIZE(ONEWIRE_CACHE_MAX) / 4];
+    size_t max = sizeof(RTCMEM_USER) / sizeof(uint32_t) - word_offset;
+
+    if (word_offset >= sizeof(RTCMEM_USER) / sizeof(uint32_t))
+        return false;
+    if (max > sizeof(words) / 4)
+        max = sizeof(words) / 4;
+    for (int i = 0; i < max; i++)
+        words[i] = RTCMEM_USER[word_offset + i];
+    return onewire_cache_load(cache, words, max * 4);
+}
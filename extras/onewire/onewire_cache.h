@@ -0,0 +1,79 @@
+#ifndef __ONEWIRE_CACHE_H__
+#define __ONEWIRE_CACHE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Cache of the ROM codes of the devices on a bus, so they don't have to
+// be found with a full ROM search every time they're addressed.
+//
+// onewire_cache_scan() fills the cache with one full search. After that,
+// calling onewire_cache_poll() periodically (e.g. once a second) runs
+// the search one device per call in the background, adding devices that
+// have been plugged in and dropping ones that have been missing for
+// ONEWIRE_CACHE_MISSES passes over the bus. The cache can be kept across
+// deep sleep in RTC memory, or as a blob (e.g. in extras/flashkv) across
+// power cycles, with a CRC.
+//
+// The cache uses the pin's search state (onewire_search()), so don't
+// search the same pin elsewhere while polling.
+
+// Most devices cached per bus (at most 32)
+#ifndef ONEWIRE_CACHE_MAX
+#define ONEWIRE_CACHE_MAX 16
+#endif
+
+// Passes a device has to be missing from before it's dropped
+#ifndef ONEWIRE_CACHE_MISSES
+#define ONEWIRE_CACHE_MISSES 2
+#endif
+
+// Size of a saved cache with 'count' devices, in bytes. A multiple of 4.
+#define ONEWIRE_CACHE_IMAGE_SIZE(count) (12 + 8 * (count))
+
+// onewire_cache_poll() results, or'ed together
+#define ONEWIRE_CACHE_ADDED     1   // a device was added
+#define ONEWIRE_CACHE_REMOVED   2   // one or more devices were dropped
+#define ONEWIRE_CACHE_PASS_DONE 4   // a pass over the whole bus finished
+
+typedef struct {
+    uint8_t pin;
+    uint8_t family;     // only cache devices of this family, 0 for all
+    uint8_t count;
+    bool polling;       // a background pass is in progress
+    uint32_t seen;      // devices found in the current pass, one bit each
+    uint8_t misses[ONEWIRE_CACHE_MAX];
+    uint8_t rom[ONEWIRE_CACHE_MAX][8];
+} onewire_cache_t;
+
+// Set up an empty cache for 'pin' (already set up with onewire_init()),
+// for devices of 'family' or for all devices if it's 0.
+void onewire_cache_init(onewire_cache_t *cache, uint8_t pin, uint8_t family);
+
+// Replace the contents with a full search of the bus. Returns the number
+// of devices found.
+uint8_t onewire_cache_scan(onewire_cache_t *cache);
+
+// Run one step of the background search. Returns ONEWIRE_CACHE_* flags
+// for what changed, 0 if nothing did.
+int onewire_cache_poll(onewire_cache_t *cache);
+
+// Index of 'rom' in the cache, or -1 if it's not there.
+int onewire_cache_find(const onewire_cache_t *cache, const uint8_t rom[8]);
+
+// Write the cache to 'buf' as ONEWIRE_CACHE_IMAGE_SIZE(count) bytes.
+// Returns the size, or 0 if 'len' is too small.
+size_t onewire_cache_save(const onewire_cache_t *cache, void *buf, size_t len);
+
+// Restore a cache saved with onewire_cache_save(). Returns false (and
+// leaves the cache alone) if the image is truncated or fails its CRC.
+bool onewire_cache_load(onewire_cache_t *cache, const void *buf, size_t len);
+
+// The same, in RTCMEM_USER starting 'word_offset' words in, taking
+// ONEWIRE_CACHE_IMAGE_SIZE(count) / 4 words. Survives deep sleep and
+// resets, but not power loss.
+bool onewire_cache_save_rtc(const onewire_cache_t *cache, unsigned word_offset);
+bool onewire_cache_load_rtc(onewire_cache_t *cache, unsigned word_offset);
+
+#endif
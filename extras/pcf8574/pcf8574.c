@@ -1,5 +1,6 @@
 #include "pcf8574.h"
 #include <i2c/i2c.h>
+#include <esp/gpio.h>
 
 uint8_t pcf8574_port_read(uint8_t addr)
 {
@@ -15,7 +16,11 @@ size_t pcf8574_port_read_buf(uint8_t addr, void *buf, size_t len)
     uint8_t *_buf = (uint8_t *)buf;
 
     i2c_start();
-    if (!i2c_write((addr << 1) | 1)) return 0;
+    if (!i2c_write((addr << 1) | 1))
+    {
+        i2c_stop();
+        return 0;
+    }
     for (size_t i = 0; i < len; i++)
         *_buf++ = i2c_read(i == len - 1);
     i2c_stop();
@@ -28,9 +33,14 @@ size_t pcf8574_port_write_buf(uint8_t addr, void *buf, size_t len)
     uint8_t *_buf = (uint8_t *)buf;
 
     i2c_start();
-    if (!i2c_write(addr << 1)) return 0;
+    if (!i2c_write(addr << 1))
+    {
+        i2c_stop();
+        return 0;
+    }
     for (size_t i = 0; i < len; i++)
         i2c_write(*_buf++);
+    i2c_stop();
     return len;
 }
 
@@ -52,3 +62,69 @@ void pcf8574_gpio_write(uint8_t addr, uint8_t num, bool value)
     uint8_t mask = ~(1 << num);
     pcf8574_port_write (addr, (pcf8574_port_read(addr) & mask) | bit);
 }
+
+static bool write_shadow(pcf8574_t *dev)
+{
+    i2c_transfer_t xfer = {
+        .slave_addr = dev->addr,
+        .tx = &dev->shadow,
+        .tx_len = 1,
+    };
+    return i2c_bus_transfer(dev->bus, &xfer);
+}
+
+bool pcf8574_init(pcf8574_t *dev, i2c_bus_t *bus, uint8_t addr, uint8_t value)
+{
+    dev->bus = bus;
+    dev->addr = addr;
+    dev->shadow = value;
+    dev->input = value;
+    dev->int_pin = 0xff;
+    dev->input_stale = true;
+    return write_shadow(dev);
+}
+
+bool pcf8574_write_pins(pcf8574_t *dev, uint8_t mask, uint8_t value)
+{
+    uint8_t shadow = (dev->shadow & ~mask) | (value & mask);
+    if (shadow == dev->shadow)
+        return true;
+    dev->shadow = shadow;
+    return write_shadow(dev);
+}
+
+bool pcf8574_set_pin(pcf8574_t *dev, uint8_t num, bool value)
+{
+    return pcf8574_write_pins(dev, 1 << num, value ? 0xff : 0);
+}
+
+uint8_t pcf8574_read_pins(pcf8574_t *dev)
+{
+    if (dev->int_pin != 0xff && !dev->input_stale)
+        return dev->input;
+
+    // Cleared before the read, so a change during it is caught next time
+    dev->input_stale = false;
+    i2c_transfer_t xfer = {
+        .slave_addr = dev->addr,
+        .rx = &dev->input,
+        .rx_len = 1,
+    };
+    if (!i2c_bus_transfer(dev->bus, &xfer))
+        dev->input_stale = true;
+    return dev->input;
+}
+
+static void IRAM pcf8574_int_handler(uint8_t gpio_num, void *arg)
+{
+    ((pcf8574_t *)arg)->input_stale = true;
+}
+
+void pcf8574_set_interrupt_pin(pcf8574_t *dev, uint8_t gpio)
+{
+    dev->input_stale = true;
+    dev->int_pin = gpio;
+    gpio_enable(gpio, GPIO_INPUT);
+    gpio_set_pullup(gpio, true, false);
+    gpio_set_interrupt_handler(gpio, GPIO_INTTYPE_EDGE_NEG, pcf8574_int_handler, dev);
+}
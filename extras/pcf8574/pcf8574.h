@@ -8,12 +8,95 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <i2c/i2c.h>
 
 #ifdef __cplusplus
 extern "C"
 {
 #endif
 
+/**
+ * Expander with a shadow of its output latch.
+ *
+ * Pin writes update the shadow and send it in one bus transaction,
+ * without reading the port first. A pin used as an input must be
+ * written high (its shadow bit 1). Fields are private to the driver.
+ */
+typedef struct {
+    i2c_bus_t *bus;
+    uint8_t addr;
+    uint8_t shadow;             //!< Last value written to the port
+    uint8_t input;              //!< Last value read from the port
+    uint8_t int_pin;            //!< ESP8266 GPIO on the /INT line, 0xff if none
+    volatile bool input_stale;  //!< The port has to be read again
+} pcf8574_t;
+
+/**
+ * \brief Set up an expander and write its initial output value
+ * \param dev Device descriptor, kept by the caller
+ * \param bus I2C bus (i2c_default_bus for the single bus functions)
+ * \param addr I2C register address (0b0100<A2><A1><A0> for PCF8574)
+ * \param value Initial port value, 1 bits for inputs and high outputs
+ * \return false if the expander didn't ack
+ */
+bool pcf8574_init(pcf8574_t *dev, i2c_bus_t *bus, uint8_t addr, uint8_t value);
+
+/**
+ * \brief Set several output pins in one write
+ * \param dev Device descriptor
+ * \param mask Pins to change
+ * \param value New levels of the pins in 'mask'
+ * \return false if the expander didn't ack
+ */
+bool pcf8574_write_pins(pcf8574_t *dev, uint8_t mask, uint8_t value);
+
+/**
+ * \brief Set one output pin, from the shadow (no read)
+ * \param dev Device descriptor
+ * \param num pin number (0..7)
+ * \param value true for high level
+ * \return false if the expander didn't ack
+ */
+bool pcf8574_set_pin(pcf8574_t *dev, uint8_t num, bool value);
+
+/**
+ * \brief Current output shadow, as last written
+ */
+static inline uint8_t pcf8574_get_shadow(const pcf8574_t *dev)
+{
+    return dev->shadow;
+}
+
+/**
+ * \brief Read the port levels
+ * With an interrupt pin set, only reads over the bus after the /INT line
+ * has signalled a change, otherwise returns the cached value.
+ * \param dev Device descriptor
+ * \return 8-bit GPIO port value
+ */
+uint8_t pcf8574_read_pins(pcf8574_t *dev);
+
+/**
+ * \brief Use the expander's /INT output to refresh the inputs
+ * The expander pulls /INT low when an input changes, so
+ * pcf8574_read_pins() can skip the bus read until it does. The pin gets a
+ * falling edge interrupt handler (and the internal pullup, /INT is open
+ * drain). A pin has only one handler, so for expanders sharing an /INT
+ * line, install your own handler that calls pcf8574_inputs_changed() on
+ * each of them instead.
+ * \param dev Device descriptor
+ * \param gpio ESP8266 GPIO connected to /INT
+ */
+void pcf8574_set_interrupt_pin(pcf8574_t *dev, uint8_t gpio);
+
+/**
+ * \brief Mark the cached inputs stale, e.g. from a shared /INT handler
+ */
+static inline void pcf8574_inputs_changed(pcf8574_t *dev)
+{
+    dev->input_stale = true;
+}
+
 /**
  * \brief Read GPIO port value
  * \param addr I2C register address (0b0100<A2><A1><A0> for PCF8574)
@@ -57,7 +140,7 @@ bool pcf8574_gpio_read(uint8_t addr, uint8_t num);
 /**
  * \brief Set GPIO pin output
  * Note this is READ - MODIFY - WRITE operation! Please read PCF8574
- * datasheet first.
+ * datasheet first. pcf8574_set_pin() avoids the read.
  * \param addr I2C register address (0b0100<A2><A1><A0> for PCF8574)
  * \param num pin number (0..7)
  * \param value true for high level
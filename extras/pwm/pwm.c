@@ -1,4 +1,23 @@
 /* Implementation of PWM support for the Espressif SDK.
+ *
+ * All channels are driven from the FRC1 interrupt. At the start of
+ * each period every channel with a non-zero duty is set, then the
+ * channels are cleared in order of increasing duty. The edges are
+ * precomputed into an event table sorted by time, so each interrupt
+ * only writes a ready-made GPIO set/clear mask and the load value for
+ * the next event. Channels with the same (or nearly the same) duty
+ * share one event, so there are at most MAX_PWM_PINS + 1 interrupts
+ * per period.
+ *
+ * Duty changes are built into a second (shadow) table while the first
+ * keeps running, and the interrupt switches tables at the start of the
+ * next period. The timer keeps running throughout, so fades don't
+ * flicker or drop periods, and the caller never has to block the
+ * interrupt: the shadow table is only handed over (_pending) once it
+ * is complete, and the interrupt only switches when it is.
+ *
+ * In PWM_MODE_SIGMA_DELTA the pins are instead connected to the
+ * hardware sigma-delta generator, which needs no interrupts at all.
  *
  * Part of esp-open-rtos
  * Copyright (C) 2015 Guillem Pascual Ginovart (https://github.com/gpascualg)
@@ -11,59 +30,195 @@
 #include <espressif/sdk_private.h>
 #include <FreeRTOS.h>
 #include <esp8266.h>
+#include <stdio.h>
+
+/* Edges closer together than this are merged into one event, as the
+   interrupt can't reliably be serviced any faster. */
+#define PWM_MIN_GAP_US  4
 
 typedef struct PWMPinDefinition
 {
     uint8_t pin;
-    uint8_t divider;
+    uint16_t duty;
 } PWMPin;
 
-typedef enum {
-    PERIOD_ON   = 0,
-    PERIOD_OFF  = 1
-} pwm_step_t;
-
+typedef struct PWMEventDefinition
+{
+    uint32_t set;       /* GPIO mask to set */
+    uint32_t clear;     /* GPIO mask to clear */
+    uint32_t load;      /* FRC1 ticks until the next event */
+} PWMEvent;
 
 typedef struct pwmInfoDefinition
 {
     uint8_t running;
+    pwm_mode_t mode;
 
     uint16_t freq;
-    uint16_t dutyCicle;
 
     /* private */
     uint32_t _maxLoad;
-    uint32_t _onLoad;
-    uint32_t _offLoad;
-    pwm_step_t _step;
+    uint8_t _step;
+    volatile uint8_t _active;   /* Table used by the interrupt */
+    volatile uint8_t _pending;  /* Shadow table is ready to swap in */
+    uint8_t _numEvents[2];
+    PWMEvent _events[2][MAX_PWM_PINS + 1];
 
     uint16_t usedPins;
-    PWMPin pins[8];
+    PWMPin pins[MAX_PWM_PINS];
 } PWMInfo;
 
 static PWMInfo pwmInfo;
 
-static void frc1_interrupt_handler(void)
+static void IRAM frc1_interrupt_handler(void)
 {
-    uint8_t i = 0;
-    bool out = true;
-    uint32_t load = pwmInfo._onLoad;
-    pwm_step_t step = PERIOD_ON;
+    uint8_t table = pwmInfo._active;
+
+    /* New duties only take effect at a period boundary */
+    if (pwmInfo._step == 0 && pwmInfo._pending)
+    {
+        table ^= 1;
+        pwmInfo._active = table;
+        pwmInfo._pending = 0;
+    }
+
+    const PWMEvent *event = &pwmInfo._events[table][pwmInfo._step];
+
+    timer_set_load(FRC1, event->load);
+    gpio_set_mask(event->set);
+    gpio_clear_mask(event->clear);
+
+    if (++pwmInfo._step == pwmInfo._numEvents[table])
+    {
+        pwmInfo._step = 0;
+    }
+}
+
+/* Minimum gap between events in FRC1 ticks, at the current divider */
+static uint32_t pwm_min_gap(void)
+{
+    uint32_t shift = FIELD2VAL(TIMER_CTRL_CLKDIV, TIMER(FRC1).CTRL) * 4;
+    uint32_t ticks = (PWM_MIN_GAP_US * 80) >> shift;
+    return ticks ? ticks : 1;
+}
+
+/* Build an event table from the channel duties */
+static void pwm_build_events(uint8_t table)
+{
+    uint32_t maxLoad = pwmInfo._maxLoad;
+    uint32_t minGap = pwm_min_gap();
+    uint32_t onLoad[MAX_PWM_PINS];
+    uint8_t order[MAX_PWM_PINS];
+    uint8_t n = 0;
+
+    PWMEvent *start = &pwmInfo._events[table][0];
+    start->set = 0;
+    start->clear = 0;
+
+    /* Constant channels only need the period start event, the others
+       are sorted by the time of their falling edge */
+    for (uint8_t i = 0; i < pwmInfo.usedPins; ++i)
+    {
+        uint32_t mask = BIT(pwmInfo.pins[i].pin);
+        uint32_t load = (uint32_t)pwmInfo.pins[i].duty * maxLoad / UINT16_MAX;
+
+        if (load == 0)
+        {
+            start->clear |= mask;
+            continue;
+        }
+        start->set |= mask;
+        if (load >= maxLoad)
+        {
+            continue;
+        }
+
+        /* Keep the edge a serviceable distance from the period ends */
+        if (load < minGap)
+            load = minGap;
+        if (load > maxLoad - minGap)
+            load = maxLoad - minGap;
+
+        uint8_t j = n++;
+        for (; j > 0 && onLoad[order[j - 1]] > load; --j)
+        {
+            order[j] = order[j - 1];
+        }
+        order[j] = i;
+        onLoad[i] = load;
+    }
+
+    uint8_t numEvents = 1;
+    uint32_t lastEdge = 0;
+    PWMEvent *event = start;
+
+    for (uint8_t k = 0; k < n; ++k)
+    {
+        uint8_t i = order[k];
+        uint32_t edge = onLoad[i];
+
+        if (numEvents == 1 || edge - lastEdge >= minGap)
+        {
+            event->load = edge - lastEdge;
+            event = &pwmInfo._events[table][numEvents++];
+            event->set = 0;
+            event->clear = 0;
+            lastEdge = edge;
+        }
+        event->clear |= BIT(pwmInfo.pins[i].pin);
+    }
+    event->load = maxLoad - lastEdge;
+
+    pwmInfo._numEvents[table] = numEvents;
+}
+
+/* Sigma-delta pulse density for a duty, the generator is shared so
+   all channels follow the same duty */
+static void sigma_delta_update(uint16_t duty)
+{
+    uint32_t mask = 0;
+    for (uint8_t i = 0; i < pwmInfo.usedPins; ++i)
+    {
+        mask |= BIT(pwmInfo.pins[i].pin);
+    }
+
+    /* Even the highest target leaves gaps, so drive fully on directly */
+    bool full = (duty == UINT16_MAX);
+    for (uint8_t i = 0; i < pwmInfo.usedPins; ++i)
+    {
+        if (full)
+            GPIO.CONF[pwmInfo.pins[i].pin] &= ~GPIO_CONF_SOURCE_PWM;
+        else
+            GPIO.CONF[pwmInfo.pins[i].pin] |= GPIO_CONF_SOURCE_PWM;
+    }
+    if (full)
+        gpio_set_mask(mask);
+    else
+        gpio_clear_mask(mask);
+
+    GPIO.PWM = SET_FIELD(GPIO.PWM, GPIO_PWM_TARGET, duty >> 8);
+}
 
-    if (pwmInfo._step == PERIOD_ON)
+/* Hand new duties to the running interrupt */
+static void pwm_update(uint16_t duty)
+{
+    if (!pwmInfo.running)
     {
-        out = false;
-        load = pwmInfo._offLoad;
-        step = PERIOD_OFF;
+        return;
     }
 
-    for (; i < pwmInfo.usedPins; ++i)
+    if (pwmInfo.mode == PWM_MODE_SIGMA_DELTA)
     {
-        gpio_write(pwmInfo.pins[i].pin, out);
+        sigma_delta_update(duty);
+        return;
     }
 
-    timer_set_load(FRC1, load);
-    pwmInfo._step = step;
+    /* Once _pending is clear the interrupt won't switch tables, so the
+       inactive one is ours until we set it again */
+    pwmInfo._pending = 0;
+    pwm_build_events(pwmInfo._active ^ 1);
+    __asm__ volatile ("" ::: "memory");
+    pwmInfo._pending = 1;
 }
 
 void pwm_init(uint8_t npins, uint8_t* pins)
@@ -77,9 +232,9 @@ void pwm_init(uint8_t npins, uint8_t* pins)
 
     /* Initialize */
     pwmInfo._maxLoad = 0;
-    pwmInfo._onLoad = 0;
-    pwmInfo._offLoad = 0;
-    pwmInfo._step = PERIOD_ON;
+    pwmInfo._step = 0;
+    pwmInfo._active = 0;
+    pwmInfo._pending = 0;
 
     /* Save pins information */
     pwmInfo.usedPins = npins;
@@ -87,7 +242,14 @@ void pwm_init(uint8_t npins, uint8_t* pins)
     uint8_t i = 0;
     for (; i < npins; ++i)
     {
+        if (pins[i] >= 16)
+        {
+            printf("Unsupported PWM pin (%d)\n", pins[i]);
+            pwmInfo.usedPins = i;
+            break;
+        }
         pwmInfo.pins[i].pin = pins[i];
+        pwmInfo.pins[i].duty = 0;
 
         /* configure GPIOs */
         gpio_enable(pins[i], GPIO_OUTPUT);
@@ -103,6 +265,21 @@ void pwm_init(uint8_t npins, uint8_t* pins)
     pwmInfo.running = 0;
 }
 
+void pwm_set_mode(pwm_mode_t mode)
+{
+    bool running = pwmInfo.running;
+
+    if (running)
+    {
+        pwm_stop();
+    }
+    pwmInfo.mode = mode;
+    if (running)
+    {
+        pwm_start();
+    }
+}
+
 void pwm_set_freq(uint16_t freq)
 {
     pwmInfo.freq = freq;
@@ -114,8 +291,20 @@ void pwm_set_freq(uint16_t freq)
         pwmInfo.running = 1;
     }
 
-    timer_set_frequency(FRC1, freq);
-    pwmInfo._maxLoad = timer_get_load(FRC1);
+    if (pwmInfo.mode == PWM_MODE_SIGMA_DELTA)
+    {
+        /* Treat freq as the rate of 256-step output cycles */
+        uint32_t prescaler = freq ? APB_CLK_FREQ / 256 / freq : 256;
+        prescaler = prescaler ? prescaler - 1 : 0;
+        if (prescaler > GPIO_PWM_PRESCALER_M)
+            prescaler = GPIO_PWM_PRESCALER_M;
+        GPIO.PWM = SET_FIELD(GPIO.PWM, GPIO_PWM_PRESCALER, prescaler);
+    }
+    else
+    {
+        timer_set_frequency(FRC1, freq);
+        pwmInfo._maxLoad = timer_get_load(FRC1);
+    }
 
     if (pwmInfo.running)
     {
@@ -125,22 +314,30 @@ void pwm_set_freq(uint16_t freq)
 
 void pwm_set_duty(uint16_t duty)
 {
-    bool output;
+    for (uint8_t i = 0; i < pwmInfo.usedPins; ++i)
+    {
+        pwmInfo.pins[i].duty = duty;
+    }
+    pwm_update(duty);
+}
 
-    pwmInfo.dutyCicle = duty;
-    if (duty > 0 && duty < UINT16_MAX) {
-        pwm_restart();
-	return;
+void pwm_set_channel_duty(uint8_t channel, uint16_t duty)
+{
+    if (channel >= pwmInfo.usedPins)
+    {
+        return;
     }
+    pwmInfo.pins[channel].duty = duty;
+    pwm_update(duty);
+}
 
-    // 0% and 100% duty cycle are special cases: constant output.
-    pwm_stop();
-    pwmInfo.running = 1;
-    output = (duty == UINT16_MAX);
-    for (uint8_t i = 0; i < pwmInfo.usedPins; ++i)
+uint16_t pwm_get_channel_duty(uint8_t channel)
+{
+    if (channel >= pwmInfo.usedPins)
     {
-	gpio_write(pwmInfo.pins[i].pin, output);
+        return 0;
     }
+    return pwmInfo.pins[channel].duty;
 }
 
 void pwm_restart()
@@ -154,19 +351,22 @@ void pwm_restart()
 
 void pwm_start()
 {
-    pwmInfo._onLoad = pwmInfo.dutyCicle * pwmInfo._maxLoad / UINT16_MAX;
-    pwmInfo._offLoad = pwmInfo._maxLoad - pwmInfo._onLoad;
-    pwmInfo._step = PERIOD_ON;
-
-    // Trigger ON
-    uint8_t i = 0;
-    for (; i < pwmInfo.usedPins; ++i)
+    if (pwmInfo.mode == PWM_MODE_SIGMA_DELTA)
     {
-        gpio_write(pwmInfo.pins[i].pin, true);
+        pwmInfo.running = 1;
+        GPIO.PWM |= GPIO_PWM_ENABLE;
+        sigma_delta_update(pwmInfo.usedPins ? pwmInfo.pins[0].duty : 0);
+        return;
     }
 
-    timer_set_load(FRC1, pwmInfo._onLoad);
+    pwmInfo._pending = 0;
+    pwm_build_events(pwmInfo._active);
+
+    /* Run the period start event now, and time the rest from here */
+    pwmInfo._step = 0;
     timer_set_reload(FRC1, false);
+    frc1_interrupt_handler();
+
     timer_set_interrupts(FRC1, true);
     timer_set_run(FRC1, true);
 
@@ -175,6 +375,18 @@ void pwm_start()
 
 void pwm_stop()
 {
+    if (pwmInfo.mode == PWM_MODE_SIGMA_DELTA)
+    {
+        for (uint8_t i = 0; i < pwmInfo.usedPins; ++i)
+        {
+            GPIO.CONF[pwmInfo.pins[i].pin] &= ~GPIO_CONF_SOURCE_PWM;
+            gpio_write(pwmInfo.pins[i].pin, false);
+        }
+        GPIO.PWM &= ~GPIO_PWM_ENABLE;
+        pwmInfo.running = 0;
+        return;
+    }
+
     timer_set_interrupts(FRC1, false);
     timer_set_run(FRC1, false);
     pwmInfo.running = 0;
@@ -1,4 +1,10 @@
 /* Implementation of PWM support for the Espressif SDK.
+ *
+ * Each pin is a channel with its own duty cycle, all channels share
+ * the frequency set with pwm_set_freq(). Channels are numbered in the
+ * order of the pins passed to pwm_init().
+ *
+ * Only GPIO0-15 can be used for PWM output.
  *
  * Part of esp-open-rtos
  * Copyright (C) 2015 Guillem Pascual Ginovart (https://github.com/gpascualg)
@@ -9,10 +15,34 @@
 
 #define MAX_PWM_PINS    8
 
+typedef enum {
+    /* FRC1 interrupt driven, independent duty per channel */
+    PWM_MODE_TIMER = 0,
+    /* Hardware sigma-delta generator, no interrupts. There is only one
+       generator, so all channels share the most recently set duty, at
+       8 bit resolution. */
+    PWM_MODE_SIGMA_DELTA = 1,
+} pwm_mode_t;
+
 void pwm_init(uint8_t npins, uint8_t* pins);
+
+/* Select the output backend, PWM_MODE_TIMER by default. Call before
+   pwm_set_freq(), as freq means output cycles of 256 steps in
+   PWM_MODE_SIGMA_DELTA. */
+void pwm_set_mode(pwm_mode_t mode);
 void pwm_set_freq(uint16_t freq);
+
+/* Duty changes while running take effect at the start of the next
+   period, without restarting the timer. They must not be made from
+   more than one task at a time. */
+
+/* Set the duty cycle of all channels, 0 (off) to UINT16_MAX (on) */
 void pwm_set_duty(uint16_t duty);
 
+/* Set the duty cycle of one channel, 0 (off) to UINT16_MAX (on) */
+void pwm_set_channel_duty(uint8_t channel, uint16_t duty);
+uint16_t pwm_get_channel_duty(uint8_t channel);
+
 void pwm_restart();
 void pwm_start();
 void pwm_stop();
@@ -0,0 +1,9 @@
+# Component makefile for extras/rawmsg
+
+# expected anyone using rawmsg includes it as 'rawmsg/rawmsg.h'
+INC_DIRS += $(rawmsg_ROOT)..
+
+# args for passing into compile rule generation
+rawmsg_SRC_DIR =  $(rawmsg_ROOT)
+
+$(eval $(call component_compile_rules,rawmsg))
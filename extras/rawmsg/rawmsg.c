@@ -0,0 +1,321 @@
+/* Connectionless node to node messages, see rawmsg.h
+ *
+ * A message is an 802.11 action frame (to the peer or broadcast, from
+ * our station MAC, BSSID broadcast) with a vendor specific body:
+ *
+ *   category 127, OUI 18:fe:34, type, flags, 48 bit packet number
+ *   (big endian), data length, data, then an 8 byte MIC if encrypted
+ *
+ * Encryption is AES-CCM with the CCMP nonce layout (a zero priority
+ * byte, the transmitter address and the packet number) and the
+ * addresses plus our header as additional authenticated data.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "rawmsg.h"
+
+#include <string.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "espressif/esp_common.h"
+
+#if RAWMSG_ENCRYPTION
+#include "mbedtls/ccm.h"
+#endif
+
+#define FC_ACTION           0xd0
+#define CATEGORY_VENDOR     127
+#define RAWMSG_TYPE         0x52
+
+#define FLAG_ENCRYPTED      0x01
+
+#define MAC_HEADER_LEN      24
+#define BODY_HEADER_LEN     13
+#define MIC_LEN             8
+
+/* Offsets in the frame */
+#define OFS_ADDR1           4
+#define OFS_ADDR2           10
+#define OFS_BODY            MAC_HEADER_LEN
+#define OFS_FLAGS           (OFS_BODY + 5)
+#define OFS_PN              (OFS_BODY + 6)
+#define OFS_LEN             (OFS_BODY + 12)
+#define OFS_DATA            (OFS_BODY + BODY_HEADER_LEN)
+
+#define FRAME_MAX           (OFS_DATA + RAWMSG_MAX_DATA + MIC_LEN)
+
+/* What the SDK passes the promiscuous callback for management frames */
+#define RX_CTRL_LEN         12
+#define RX_MGMT_LEN         128
+#define RX_MGMT_CAPTURE     112
+
+typedef struct {
+    bool in_use;
+    bool encrypted;
+    uint8_t mac[6];
+    uint8_t key[RAWMSG_KEY_LEN];
+    uint64_t last_pn;   /* last packet number accepted, 0 for none */
+} peer_t;
+
+static const uint8_t broadcast[6] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+static const uint8_t vendor_header[4] = { CATEGORY_VENDOR, 0x18, 0xfe, 0x34 };
+
+static peer_t peers[RAWMSG_MAX_PEERS];
+static rawmsg_recv_cb_t recv_cb;
+static uint8_t own_mac[6];
+static uint64_t tx_pn = 1;
+
+#if RAWMSG_SDK_FREEDOM
+int sdk_wifi_send_pkt_freedom(uint8_t *buf, int len, bool sys_seq);
+
+static bool sdk_transmit(uint8_t *frame, uint16_t len)
+{
+    return sdk_wifi_send_pkt_freedom(frame, len, true) == 0;
+}
+
+static rawmsg_transmit_t transmit = sdk_transmit;
+#else
+static rawmsg_transmit_t transmit;
+#endif
+
+static peer_t *find_peer(const uint8_t mac[6])
+{
+    for (int i = 0; i < RAWMSG_MAX_PEERS; i++) {
+        if (peers[i].in_use && !memcmp(peers[i].mac, mac, 6))
+            return &peers[i];
+    }
+    return NULL;
+}
+
+static void put_pn(uint8_t *p, uint64_t pn)
+{
+    for (int i = 5; i >= 0; i--, pn >>= 8)
+        p[i] = pn;
+}
+
+static uint64_t get_pn(const uint8_t *p)
+{
+    uint64_t pn = 0;
+    for (int i = 0; i < 6; i++)
+        pn = pn << 8 | p[i];
+    return pn;
+}
+
+#if RAWMSG_ENCRYPTION
+static void make_nonce(uint8_t nonce[13], const uint8_t *frame)
+{
+    nonce[0] = 0;
+    memcpy(&nonce[1], &frame[OFS_ADDR2], 6);
+    memcpy(&nonce[7], &frame[OFS_PN], 6);
+}
+
+/* Additional data: addr1, addr2 and our header */
+static void make_aad(uint8_t aad[12 + BODY_HEADER_LEN], const uint8_t *frame)
+{
+    memcpy(aad, &frame[OFS_ADDR1], 12);
+    memcpy(&aad[12], &frame[OFS_BODY], BODY_HEADER_LEN);
+}
+
+static bool ccm(bool encrypt, const uint8_t *key, uint8_t *frame, size_t len)
+{
+    mbedtls_ccm_context ctx;
+    uint8_t nonce[13];
+    uint8_t aad[12 + BODY_HEADER_LEN];
+    uint8_t *data = &frame[OFS_DATA];
+    int r;
+
+    make_nonce(nonce, frame);
+    make_aad(aad, frame);
+    mbedtls_ccm_init(&ctx);
+    r = mbedtls_ccm_setkey(&ctx, MBEDTLS_CIPHER_ID_AES, key, RAWMSG_KEY_LEN * 8);
+    if (!r && encrypt)
+        r = mbedtls_ccm_encrypt_and_tag(&ctx, len, nonce, sizeof(nonce), aad, sizeof(aad),
+                                        data, data, data + len, MIC_LEN);
+    else if (!r)
+        r = mbedtls_ccm_auth_decrypt(&ctx, len, nonce, sizeof(nonce), aad, sizeof(aad),
+                                     data, data, data + len, MIC_LEN);
+    mbedtls_ccm_free(&ctx);
+    return r == 0;
+}
+#endif
+
+void rawmsg_input(uint8_t *buf, uint16_t len)
+{
+    if (len != RX_MGMT_LEN || !recv_cb)
+        return;
+
+    int8_t rssi = (int8_t)buf[0];
+    uint8_t *frame = buf + RX_CTRL_LEN;
+
+    if (frame[0] != FC_ACTION || memcmp(&frame[OFS_BODY], vendor_header, sizeof(vendor_header)) ||
+        frame[OFS_BODY + 4] != RAWMSG_TYPE)
+        return;
+    if (memcmp(&frame[OFS_ADDR1], own_mac, 6) && memcmp(&frame[OFS_ADDR1], broadcast, 6))
+        return;
+
+    size_t data_len = frame[OFS_LEN];
+    bool encrypted = frame[OFS_FLAGS] & FLAG_ENCRYPTED;
+    if (data_len > RAWMSG_MAX_DATA || OFS_DATA + data_len + (encrypted ? MIC_LEN : 0) > RX_MGMT_CAPTURE)
+        return;
+
+    /* Snapshot the peer so the table can change while we decrypt */
+    peer_t peer;
+    taskENTER_CRITICAL();
+    peer_t *p = find_peer(&frame[OFS_ADDR2]);
+    if (p)
+        peer = *p;
+    taskEXIT_CRITICAL();
+    if (!p || encrypted != peer.encrypted)
+        return;
+
+    uint64_t pn = get_pn(&frame[OFS_PN]);
+    if (encrypted ? pn <= peer.last_pn : pn == peer.last_pn)
+        return;     /* a replay, or the radio retransmitting */
+
+#if RAWMSG_ENCRYPTION
+    if (encrypted && !ccm(false, peer.key, frame, data_len))
+        return;
+#endif
+
+    taskENTER_CRITICAL();
+    bool fresh = p->in_use && !memcmp(p->mac, peer.mac, 6) && (!encrypted || pn > p->last_pn);
+    if (fresh)
+        p->last_pn = pn;
+    taskEXIT_CRITICAL();
+
+    if (fresh)
+        recv_cb(&frame[OFS_ADDR2], &frame[OFS_DATA], data_len, rssi);
+}
+
+bool rawmsg_init(uint8_t channel, rawmsg_recv_cb_t cb)
+{
+    if (sdk_wifi_get_opmode() == NULL_MODE)
+        sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_get_macaddr(STATION_IF, own_mac);
+    recv_cb = cb;
+
+    sdk_wifi_promiscuous_enable(0);
+    sdk_wifi_set_promiscuous_rx_cb(rawmsg_input);
+    sdk_wifi_promiscuous_enable(1);
+    return sdk_wifi_set_channel(channel);
+}
+
+void rawmsg_deinit(void)
+{
+    sdk_wifi_promiscuous_enable(0);
+    recv_cb = NULL;
+}
+
+bool rawmsg_add_peer(const uint8_t mac[6], const uint8_t *key)
+{
+#if !RAWMSG_ENCRYPTION
+    if (key)
+        return false;
+#endif
+    bool added = false;
+
+    taskENTER_CRITICAL();
+    peer_t *p = find_peer(mac);
+    for (int i = 0; !p && i < RAWMSG_MAX_PEERS; i++) {
+        if (!peers[i].in_use)
+            p = &peers[i];
+    }
+    if (p) {
+        p->in_use = true;
+        memcpy(p->mac, mac, 6);
+        p->encrypted = key != NULL;
+        if (key)
+            memcpy(p->key, key, RAWMSG_KEY_LEN);
+        p->last_pn = 0;
+        added = true;
+    }
+    taskEXIT_CRITICAL();
+    return added;
+}
+
+bool rawmsg_remove_peer(const uint8_t mac[6])
+{
+    taskENTER_CRITICAL();
+    peer_t *p = find_peer(mac);
+    if (p)
+        memset(p, 0, sizeof(*p));
+    taskEXIT_CRITICAL();
+    return p != NULL;
+}
+
+static bool send_to(const peer_t *peer, const void *data, size_t len)
+{
+    uint8_t frame[FRAME_MAX];
+    size_t frame_len = OFS_DATA + len;
+
+    memset(frame, 0, MAC_HEADER_LEN);
+    frame[0] = FC_ACTION;
+    memcpy(&frame[OFS_ADDR1], peer->mac, 6);
+    memcpy(&frame[OFS_ADDR2], own_mac, 6);
+    memcpy(&frame[OFS_ADDR2 + 6], broadcast, 6);
+    memcpy(&frame[OFS_BODY], vendor_header, sizeof(vendor_header));
+    frame[OFS_BODY + 4] = RAWMSG_TYPE;
+    frame[OFS_FLAGS] = peer->encrypted ? FLAG_ENCRYPTED : 0;
+    frame[OFS_LEN] = len;
+    memcpy(&frame[OFS_DATA], data, len);
+
+    taskENTER_CRITICAL();
+    put_pn(&frame[OFS_PN], tx_pn++);
+    taskEXIT_CRITICAL();
+
+#if RAWMSG_ENCRYPTION
+    if (peer->encrypted) {
+        if (!ccm(true, peer->key, frame, len))
+            return false;
+        frame_len += MIC_LEN;
+    }
+#endif
+    return transmit(frame, frame_len);
+}
+
+bool rawmsg_send(const uint8_t *mac, const void *data, size_t len)
+{
+    bool ok = true;
+    bool sent = false;
+    peer_t peer;
+
+    if (len > RAWMSG_MAX_DATA || !transmit)
+        return false;
+
+    for (int i = 0; i < RAWMSG_MAX_PEERS; i++) {
+        taskENTER_CRITICAL();
+        bool match = peers[i].in_use && (!mac || !memcmp(peers[i].mac, mac, 6));
+        if (match)
+            peer = peers[i];
+        taskEXIT_CRITICAL();
+        if (!match)
+            continue;
+        ok = send_to(&peer, data, len) && ok;
+        sent = true;
+    }
+    return sent && ok;
+}
+
+uint64_t rawmsg_get_counter(void)
+{
+    taskENTER_CRITICAL();
+    uint64_t pn = tx_pn;
+    taskEXIT_CRITICAL();
+    return pn;
+}
+
+void rawmsg_set_counter(uint64_t counter)
+{
+    taskENTER_CRITICAL();
+    tx_pn = counter ? counter : 1;
+    taskEXIT_CRITICAL();
+}
+
+void rawmsg_set_transmit(rawmsg_transmit_t fn)
+{
+    transmit = fn;
+}
@@ -0,0 +1,106 @@
+/* Connectionless node to node messages in raw 802.11 action frames
+ *
+ * Like ESP-NOW: messages go straight from one node to another in
+ * vendor specific action frames, without association, DHCP or an AP
+ * relaying them, so a sensor waking from deep sleep can hand a reading
+ * to its gateway as soon as the radio is up.
+ *
+ * Each node keeps a table of peers by MAC address. A peer added with a
+ * key exchanges AES-CCM encrypted and authenticated messages (as CCMP
+ * does, with a 48 bit packet number in the nonce and an 8 byte MIC),
+ * other peers exchange plain ones. Build with EXTRA_CFLAGS=
+ * -DRAWMSG_ENCRYPTION=1 and extras/mbedtls for keyed peers.
+ *
+ * Frames are received through the SDK's promiscuous mode callback,
+ * which only gives the first 112 bytes of a management frame, so a
+ * message carries at most RAWMSG_MAX_DATA bytes. Promiscuous mode means
+ * the station can't be associated at the same time.
+ *
+ * The SDK libraries in this tree don't export a raw frame transmit
+ * function (wifi_send_pkt_freedom() only appeared in later SDKs). Build
+ * with -DRAWMSG_SDK_FREEDOM=1 against an SDK that has it, or give
+ * rawmsg_set_transmit() another one.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _RAWMSG_H
+#define _RAWMSG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifndef RAWMSG_ENCRYPTION
+#define RAWMSG_ENCRYPTION 0
+#endif
+
+#ifndef RAWMSG_SDK_FREEDOM
+#define RAWMSG_SDK_FREEDOM 0
+#endif
+
+#ifndef RAWMSG_MAX_PEERS
+#define RAWMSG_MAX_PEERS 8
+#endif
+
+/* Payload bytes per message, what fits the SDK's 112 byte receive
+   capture after the 802.11 header, our header and the MIC */
+#define RAWMSG_MAX_DATA 64
+
+#define RAWMSG_KEY_LEN 16
+
+/* Called from the SDK's receive path (the pp task) for each new message
+   from a peer, must be short and not block. */
+typedef void (*rawmsg_recv_cb_t)(const uint8_t mac[6], const uint8_t *data, size_t len, int8_t rssi);
+
+/* Transmits a complete 802.11 frame, returning true if it was queued */
+typedef bool (*rawmsg_transmit_t)(uint8_t *frame, uint16_t len);
+
+/* Start receiving on 'channel' (1-13), all nodes talking to each other
+   must be on the same one. Puts the radio in promiscuous mode. */
+bool rawmsg_init(uint8_t channel, rawmsg_recv_cb_t recv_cb);
+
+/* Stop receiving. The peer table is kept. */
+void rawmsg_deinit(void);
+
+/* Add (or update) a peer. 'key' is RAWMSG_KEY_LEN bytes for an
+   encrypted peer, or NULL. Adding resets its replay counter, so this
+   is also how to accept a peer again after it restarted.
+
+   Returns false if the table is full, or a key is given without
+   RAWMSG_ENCRYPTION.
+*/
+bool rawmsg_add_peer(const uint8_t mac[6], const uint8_t *key);
+
+bool rawmsg_remove_peer(const uint8_t mac[6]);
+
+/* Send 'len' (up to RAWMSG_MAX_DATA) bytes to a peer, or to every peer
+   if 'mac' is NULL. Frames aren't acknowledged, so true only means the
+   frame(s) were handed to the radio.
+*/
+bool rawmsg_send(const uint8_t *mac, const void *data, size_t len);
+
+/* The packet number of the next message sent. Keyed peers only accept
+   increasing numbers, so a sender that restarts (say from deep sleep)
+   must carry it across, for instance in RTC memory, or its messages are
+   dropped as replays until the receivers add it again. */
+uint64_t rawmsg_get_counter(void);
+void rawmsg_set_counter(uint64_t counter);
+
+/* Set the raw transmit function, see the top of this file */
+void rawmsg_set_transmit(rawmsg_transmit_t transmit);
+
+/* The promiscuous callback, for applications that install their own
+   (say to capture as well) and pass frames on */
+void rawmsg_input(uint8_t *buf, uint16_t len);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _RAWMSG_H */
@@ -0,0 +1,73 @@
+#!/usr/bin/env python
+#
+# Make a delta OTA patch (see ota-delta.h) that turns old.bin into new.bin
+#
+# Usage: python mkdelta.py old.bin new.bin out.delta
+#
+# Part of esp-open-rtos
+# Copyright (C) 2015 Superhouse Automation Pty Ltd
+# BSD Licensed as described in the file LICENSE
+import struct
+import sys
+
+BLOCK = 16          # granularity of the source index
+MIN_COPY = 24       # shorter matches are cheaper as inserted data
+
+OP_COPY = 1
+OP_INSERT = 2
+
+def fnv1a(data):
+    h = 0x811c9dc5
+    for b in bytearray(data):
+        h = ((h ^ b) * 0x01000193) & 0xffffffff
+    return h
+
+def match_len(old, o, new, n):
+    l = 0
+    while o + l < len(old) and n + l < len(new) and old[o + l] == new[n + l]:
+        l += 1
+    return l
+
+def make_delta(old, new):
+    index = {}
+    for o in range(0, len(old) - BLOCK + 1, BLOCK):
+        index.setdefault(old[o:o + BLOCK], o)
+
+    out = [b"RBD1", struct.pack("<II", len(old), fnv1a(old))]
+    pending = bytearray()
+
+    def flush_insert():
+        if pending:
+            out.append(struct.pack("<BI", OP_INSERT, len(pending)) + bytes(pending))
+            del pending[:]
+
+    n = 0
+    while n < len(new):
+        # try the same offset first (unchanged code that didn't move), then the index
+        candidates = [n]
+        o = index.get(new[n:n + BLOCK])
+        if o is not None:
+            candidates.append(o)
+        best, best_len = None, 0
+        for o in candidates:
+            l = match_len(old, o, new, n)
+            if l > best_len:
+                best, best_len = o, l
+        if best_len >= MIN_COPY:
+            flush_insert()
+            out.append(struct.pack("<BII", OP_COPY, best, best_len))
+            n += best_len
+        else:
+            pending += new[n:n + 1]
+            n += 1
+    flush_insert()
+    return b"".join(out)
+
+if __name__ == "__main__":
+    if len(sys.argv) != 4:
+        sys.exit("Usage: %s old.bin new.bin out.delta" % sys.argv[0])
+    old = open(sys.argv[1], "rb").read()
+    new = open(sys.argv[2], "rb").read()
+    delta = make_delta(old, new)
+    open(sys.argv[3], "wb").write(delta)
+    print("%s: %d bytes, %.1f%% of %s" % (sys.argv[3], len(delta), 100.0 * len(delta) / len(new), sys.argv[2]))
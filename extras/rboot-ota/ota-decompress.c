@@ -0,0 +1,96 @@
+/* Streaming decompression of OTA images
+ *
+ * For details of use see ota-decompress.h
+ *
+ * The heatshrink bit stream is a sequence of tagged, MSB first, fields:
+ * a 1 bit is followed by an 8 bit literal, a 0 bit by a back-reference
+ * of (WINDOW bits distance-1, LOOKAHEAD bits length-1) into the output.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdlib.h>
+
+#include "ota-decompress.h"
+
+#define WINDOW_SIZE (1 << OTA_HEATSHRINK_WINDOW)
+#define WINDOW_MASK (WINDOW_SIZE - 1)
+
+#define LITERAL_BITS (1 + 8)
+#define BACKREF_BITS (1 + OTA_HEATSHRINK_WINDOW + OTA_HEATSHRINK_LOOKAHEAD)
+
+bool ota_decompress_init(ota_decompress_t *d, rboot_write_status *out)
+{
+    d->out = out;
+    d->head = 0;
+    d->bits = 0;
+    d->bit_count = 0;
+    /* heatshrink's encoder assumes a zero filled initial window */
+    d->window = calloc(1, WINDOW_SIZE);
+    return d->window != NULL;
+}
+
+static inline uint32_t take_bits(ota_decompress_t *d, int count)
+{
+    d->bit_count -= count;
+    return (d->bits >> d->bit_count) & ((1 << count) - 1);
+}
+
+/* Emit 'count' bytes copied from 'distance' bytes back in the output
+   (distance 0 means a single literal byte, in 'literal') */
+static bool emit(ota_decompress_t *d, uint16_t distance, uint16_t count, uint8_t literal)
+{
+    while(count) {
+        uint32_t space;
+        uint8_t *dest = rboot_write_space(d->out, &space);
+        uint16_t n = count < space ? count : space;
+        for(uint16_t i = 0; i < n; i++) {
+            uint8_t c = distance ? d->window[(d->head - distance) & WINDOW_MASK] : literal;
+            d->window[d->head++ & WINDOW_MASK] = c;
+            dest[i] = c;
+        }
+        if(!rboot_write_commit(d->out, n))
+            return false;
+        count -= n;
+    }
+    return true;
+}
+
+bool ota_decompress_write(ota_decompress_t *d, const uint8_t *data, size_t len)
+{
+    while(1) {
+        /* Top up the bit buffer, a back-reference needs at most 1+15+8 bits */
+        while(len && d->bit_count <= 24) {
+            d->bits = (d->bits << 8) | *data++;
+            d->bit_count += 8;
+            len--;
+        }
+        if(d->bit_count == 0)
+            return true;
+
+        bool literal = (d->bits >> (d->bit_count - 1)) & 1;
+        if(literal) {
+            if(d->bit_count < LITERAL_BITS)
+                return true;
+            take_bits(d, 1);
+            if(!emit(d, 0, 1, take_bits(d, 8)))
+                return false;
+        }
+        else {
+            if(d->bit_count < BACKREF_BITS)
+                return true;
+            take_bits(d, 1);
+            uint16_t distance = take_bits(d, OTA_HEATSHRINK_WINDOW) + 1;
+            uint16_t count = take_bits(d, OTA_HEATSHRINK_LOOKAHEAD) + 1;
+            if(!emit(d, distance, count, 0))
+                return false;
+        }
+    }
+}
+
+void ota_decompress_end(ota_decompress_t *d)
+{
+    free(d->window);
+    d->window = NULL;
+}
@@ -0,0 +1,53 @@
+#ifndef _OTA_DECOMPRESS_H
+#define _OTA_DECOMPRESS_H
+/* Streaming decompression of OTA images
+ *
+ * Decodes a heatshrink compressed image on the fly and passes the output
+ * to an rboot_write_status image writer, so compressed images can be sent
+ * to the flash slot without ever holding the whole image in RAM. Only the
+ * heatshrink window (2^OTA_HEATSHRINK_WINDOW bytes) is allocated.
+ *
+ * Images must be compressed with matching window and lookahead sizes,
+ * for example with the reference heatshrink tool:
+ * heatshrink -e -w 10 -l 5 firmware/myprogram.bin myprogram.bin.hs
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "rboot-ota.h"
+
+/* log2 of the window size, heatshrink's -w */
+#ifndef OTA_HEATSHRINK_WINDOW
+#define OTA_HEATSHRINK_WINDOW 10
+#endif
+
+/* log2 of the longest back-reference, heatshrink's -l */
+#ifndef OTA_HEATSHRINK_LOOKAHEAD
+#define OTA_HEATSHRINK_LOOKAHEAD 5
+#endif
+
+typedef struct {
+    rboot_write_status *out;
+    uint8_t *window;   /* last 2^OTA_HEATSHRINK_WINDOW output bytes */
+    uint16_t head;     /* window position of the next output byte */
+    uint32_t bits;     /* unread input bits, MSB first */
+    uint8_t bit_count;
+} ota_decompress_t;
+
+/* Allocate the window and start decoding into 'out'.
+   Returns false if out of memory. */
+bool ota_decompress_init(ota_decompress_t *d, rboot_write_status *out);
+
+/* Decode the next 'len' bytes of compressed data. Returns false if the
+   output doesn't fit in the image writer's space. */
+bool ota_decompress_write(ota_decompress_t *d, const uint8_t *data, size_t len);
+
+/* Free the window. Any trailing padding bits are discarded. */
+void ota_decompress_end(ota_decompress_t *d);
+
+#endif
@@ -0,0 +1,154 @@
+/* Delta OTA updates
+ *
+ * For details of use see ota-delta.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include <espressif/spi_flash.h>
+
+#include "ota-delta.h"
+
+#define HEADER_LEN 12
+
+#define FNV_OFFSET_BASIS 0x811c9dc5
+#define FNV_PRIME 0x01000193
+
+/* Flash is read in words, through this many of them at a time */
+#define COPY_CHUNK_WORDS 64
+
+static inline uint32_t get_u32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t hash_flash(uint32_t addr, uint32_t len)
+{
+    uint32_t chunk[COPY_CHUNK_WORDS];
+    uint32_t hash = FNV_OFFSET_BASIS;
+    while(len) {
+        uint32_t n = len < sizeof(chunk) ? len : sizeof(chunk);
+        sdk_spi_flash_read(addr, chunk, sizeof(chunk));
+        for(uint32_t i = 0; i < n; i++)
+            hash = (hash ^ ((uint8_t *)chunk)[i]) * FNV_PRIME;
+        addr += n;
+        len -= n;
+    }
+    return hash;
+}
+
+/* Copy 'len' bytes of the running image at 'offs' to the output. Both
+   sides can be unaligned, so go through an aligned bounce buffer. */
+static bool copy_flash(ota_delta_t *d, uint32_t offs, uint32_t len)
+{
+    uint32_t chunk[COPY_CHUNK_WORDS];
+    uint32_t addr = d->src_addr + offs;
+    while(len) {
+        uint32_t skip = addr & 3;
+        uint32_t n = sizeof(chunk) - skip;
+        if(n > len)
+            n = len;
+        sdk_spi_flash_read(addr - skip, chunk, sizeof(chunk));
+        if(!rboot_write_flash(d->out, (uint8_t *)chunk + skip, n))
+            return false;
+        addr += n;
+        len -= n;
+    }
+    return true;
+}
+
+void ota_delta_init(ota_delta_t *d, rboot_write_status *out, uint32_t src_addr, uint32_t src_max)
+{
+    d->out = out;
+    d->src_addr = src_addr;
+    d->src_max = src_max;
+    d->op = 0;
+    d->field_len = 0;
+    d->remaining = 0;
+}
+
+/* Act on a complete header or set of op arguments in d->field */
+static bool delta_field(ota_delta_t *d, const char **error)
+{
+    if(d->op == 0) {
+        uint32_t src_len = get_u32(d->field + 4);
+        if(memcmp(d->field, OTA_DELTA_MAGIC, 4)) {
+            *error = "Not a delta image";
+            return false;
+        }
+        if(src_len > d->src_max || hash_flash(d->src_addr, src_len) != get_u32(d->field + 8)) {
+            *error = "Delta doesn't match running image";
+            return false;
+        }
+    }
+    else if(d->op == OTA_DELTA_OP_COPY) {
+        uint32_t offs = get_u32(d->field + 1);
+        uint32_t len = get_u32(d->field + 5);
+        if(offs > d->src_max || len > d->src_max - offs) {
+            *error = "Delta copy out of range";
+            return false;
+        }
+        if(!copy_flash(d, offs, len)) {
+            *error = "Image too large";
+            return false;
+        }
+    }
+    else {
+        d->remaining = get_u32(d->field + 1);
+    }
+    d->op = OTA_DELTA_OP_COPY; /* header done, from here on any op is non-zero */
+    d->field_len = 0;
+    return true;
+}
+
+bool ota_delta_write(ota_delta_t *d, const uint8_t *data, size_t len, const char **error_message)
+{
+    const char *error = NULL;
+    while(len) {
+        if(d->remaining) {
+            uint32_t n = len < d->remaining ? len : d->remaining;
+            if(!rboot_write_flash(d->out, data, n)) {
+                error = "Image too large";
+                goto fail;
+            }
+            data += n;
+            len -= n;
+            d->remaining -= n;
+            continue;
+        }
+
+        if(d->op && d->field_len == 0) {
+            d->op = *data;
+            if(d->op != OTA_DELTA_OP_COPY && d->op != OTA_DELTA_OP_INSERT) {
+                error = "Bad delta op";
+                goto fail;
+            }
+        }
+        d->field[d->field_len++] = *data++;
+        len--;
+
+        uint8_t need = d->op == 0 ? HEADER_LEN : d->op == OTA_DELTA_OP_COPY ? 9 : 5;
+        if(d->field_len == need && !delta_field(d, &error))
+            goto fail;
+    }
+    return true;
+
+ fail:
+    if(error_message)
+        *error_message = error;
+    return false;
+}
+
+bool ota_delta_end(ota_delta_t *d, const char **error_message)
+{
+    if(d->op == 0 || d->remaining || d->field_len) {
+        if(error_message)
+            *error_message = "Delta truncated";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,61 @@
+#ifndef _OTA_DELTA_H
+#define _OTA_DELTA_H
+/* Delta OTA updates
+ *
+ * Rebuilds a new image in the inactive slot from the image in the
+ * running slot plus a patch, so only the changed parts of the firmware
+ * have to be sent. The patch is applied as it streams in, through an
+ * rboot_write_status image writer.
+ *
+ * Patches are made with mkdelta.py (in this directory):
+ * python mkdelta.py old.bin new.bin new.delta
+ * where old.bin must be exactly the image in the running slot.
+ *
+ * Patch format, all integers little endian:
+ *
+ * header: "RBD1", u32 source length, u32 FNV-1a hash of the source
+ * then any number of:
+ *   OTA_DELTA_OP_COPY   u32 source offset, u32 length
+ *   OTA_DELTA_OP_INSERT u32 length, followed by length bytes of data
+ *
+ * The source hash is checked before anything is written, so a patch made
+ * against a different base image is rejected up front.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "rboot-ota.h"
+
+#define OTA_DELTA_MAGIC "RBD1"
+
+#define OTA_DELTA_OP_COPY   1
+#define OTA_DELTA_OP_INSERT 2
+
+typedef struct {
+    rboot_write_status *out;
+    uint32_t src_addr;   /* flash offset of the running image */
+    uint32_t src_max;    /* size of the running slot */
+    uint8_t op;          /* current op, 0 while reading the header */
+    uint8_t field[12];   /* header or op arguments being collected */
+    uint8_t field_len;
+    uint32_t remaining;  /* INSERT bytes still to come */
+} ota_delta_t;
+
+/* Start applying a patch against the image at flash offset 'src_addr' (in
+   a slot of 'src_max' bytes), writing the result to 'out'. */
+void ota_delta_init(ota_delta_t *d, rboot_write_status *out, uint32_t src_addr, uint32_t src_max);
+
+/* Apply the next 'len' bytes of the patch. Returns false (and sets
+   *error_message) if the patch is invalid, doesn't match the running
+   image or the output doesn't fit. */
+bool ota_delta_write(ota_delta_t *d, const uint8_t *data, size_t len, const char **error_message);
+
+/* Check the patch ended on an op boundary. */
+bool ota_delta_end(ota_delta_t *d, const char **error_message);
+
+#endif
@@ -0,0 +1,254 @@
+/* Streaming HTTP(S) OTA client
+ *
+ * For details of use see ota-http.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <FreeRTOS.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "lwip/sockets.h"
+#include "lwip/netdb.h"
+
+#include <espressif/spi_flash.h>
+#include <espressif/esp_system.h>
+
+#include "ota-http.h"
+#include "rboot-ota.h"
+
+/* Longest response header we accept, must be below SECTOR_SIZE as the
+   header is read into the sector buffer */
+#define MAX_HEADER_LEN 1024
+
+typedef struct {
+    uint32_t *sector;  /* SECTOR_SIZE bytes, word aligned */
+    size_t fill;       /* bytes in sector */
+    uint32_t start;    /* flash offset of the slot */
+    uint32_t offs;     /* flash offset of sector */
+    uint32_t limit;
+} image_writer_t;
+
+/* Write out the sector buffer (padded to whole words if it's the final,
+   partial, sector), then erase the next sector ahead of its data */
+static void writer_flush(image_writer_t *w)
+{
+    size_t len = (w->fill + 3) & ~3;
+    memset((uint8_t *)w->sector + w->fill, 0xff, len - w->fill);
+    sdk_spi_flash_write(w->offs, w->sector, len);
+
+    w->offs += SECTOR_SIZE;
+    w->fill = 0;
+    if(w->offs < w->limit)
+        sdk_spi_flash_erase_sector(w->offs / SECTOR_SIZE);
+}
+
+static int write_all(const ota_http_transport_t *t, const char *buf, size_t len)
+{
+    while(len) {
+        int r = t->write(t->ctx, buf, len);
+        if(r <= 0)
+            return -1;
+        buf += r;
+        len -= r;
+    }
+    return 0;
+}
+
+/* Find a header line "name: value" in the NUL terminated header block */
+static const char *find_header(const char *headers, const char *name)
+{
+    size_t name_len = strlen(name);
+    for(const char *line = strstr(headers, "\r\n"); line; line = strstr(line, "\r\n")) {
+        line += 2;
+        if(!strncasecmp(line, name, name_len) && line[name_len] == ':') {
+            const char *value = line + name_len + 1;
+            while(*value == ' ')
+                value++;
+            return value;
+        }
+    }
+    return NULL;
+}
+
+/* Read the response header into buf. On success, moves any body bytes
+   that came with it to the start of buf and sets *body_len to their
+   count, and *content_len to the Content-Length (or -1 if none). */
+static ota_http_err_t read_header(const ota_http_transport_t *t, char *buf,
+                                  size_t *body_len, long *content_len)
+{
+    size_t len = 0;
+    char *end = NULL;
+
+    while(!end) {
+        if(len >= MAX_HEADER_LEN)
+            return OTA_HTTP_ERR_RESPONSE;
+        int r = t->read(t->ctx, buf + len, MAX_HEADER_LEN - len);
+        if(r <= 0)
+            return r < 0 ? OTA_HTTP_ERR_IO : OTA_HTTP_ERR_RESPONSE;
+        len += r;
+        buf[len] = 0;
+        end = strstr(buf, "\r\n\r\n");
+    }
+    end[2] = 0; /* keep the last header's CRLF for find_header */
+
+    int status = 0;
+    if(sscanf(buf, "HTTP/%*d.%*d %d", &status) != 1 || status != 200) {
+        printf("OTA HTTP: bad response status %d\r\n", status);
+        return OTA_HTTP_ERR_RESPONSE;
+    }
+
+    const char *cl = find_header(buf, "Content-Length");
+    *content_len = cl ? strtol(cl, NULL, 10) : -1;
+
+    char *body = end + 4;
+    *body_len = len - (body - buf);
+    memmove(buf, body, *body_len);
+    return OTA_HTTP_OK;
+}
+
+ota_http_err_t ota_http_stream(const ota_http_transport_t *transport, const char *host,
+                               const char *path, size_t *image_len)
+{
+    rboot_config_t conf = rboot_get_config();
+    int slot = (conf.current_rom + 1) % conf.count;
+    if(slot == conf.current_rom)
+        return OTA_HTTP_ERR_SLOT;
+
+    image_writer_t w = {
+        .start = conf.roms[slot],
+        .offs = conf.roms[slot],
+        .limit = conf.roms[slot] + OTA_HTTP_MAX_IMAGE_SIZE,
+    };
+    /* SECTOR_SIZE plus room for the header's terminating NUL */
+    w.sector = malloc(SECTOR_SIZE + 4);
+    if(!w.sector)
+        return OTA_HTTP_ERR_MEM;
+
+    /* The first sector's erase overlaps the request round trip */
+    sdk_spi_flash_erase_sector(w.offs / SECTOR_SIZE);
+
+    ota_http_err_t err = OTA_HTTP_ERR_IO;
+    char *request = malloc(strlen(host) + strlen(path) + 64);
+    if(!request) {
+        err = OTA_HTTP_ERR_MEM;
+        goto out;
+    }
+    int request_len = sprintf(request, "GET %s HTTP/1.0\r\nHost: %s\r\nConnection: close\r\n\r\n", path, host);
+    int r = write_all(transport, request, request_len);
+    free(request);
+    if(r < 0)
+        goto out;
+
+    size_t body_len;
+    long content_len;
+    err = read_header(transport, (char *)w.sector, &body_len, &content_len);
+    if(err != OTA_HTTP_OK)
+        goto out;
+    if(content_len > OTA_HTTP_MAX_IMAGE_SIZE) {
+        err = OTA_HTTP_ERR_TOO_LARGE;
+        goto out;
+    }
+
+    /* The body bytes that came with the header are already in place */
+    w.fill = body_len;
+    size_t received = body_len;
+    if(w.fill == SECTOR_SIZE)
+        writer_flush(&w);
+
+    while(content_len < 0 || received < content_len) {
+        size_t space = SECTOR_SIZE - w.fill;
+        r = transport->read(transport->ctx, (uint8_t *)w.sector + w.fill, space);
+        if(r < 0) {
+            err = OTA_HTTP_ERR_IO;
+            goto out;
+        }
+        if(r == 0)
+            break;
+        if(w.offs + w.fill + r > w.limit) {
+            err = OTA_HTTP_ERR_TOO_LARGE;
+            goto out;
+        }
+        received += r;
+        w.fill += r;
+        if(w.fill == SECTOR_SIZE)
+            writer_flush(&w);
+    }
+    if(content_len >= 0 && received != content_len) {
+        printf("OTA HTTP: short body, %u of %ld bytes\r\n", received, content_len);
+        err = OTA_HTTP_ERR_IO;
+        goto out;
+    }
+    if(w.fill)
+        writer_flush(&w);
+
+    if(image_len)
+        *image_len = received;
+
+    const char *verify_err = "Unknown validation error";
+    if(!rboot_verify_image(w.start, received, &verify_err)) {
+        printf("OTA HTTP: %s\r\n", verify_err);
+        err = OTA_HTTP_ERR_VERIFY;
+        goto out;
+    }
+
+    printf("OTA HTTP: received %u bytes, changing slot to %d\r\n", received, slot);
+    err = rboot_set_current_rom(slot) ? OTA_HTTP_OK : OTA_HTTP_ERR_SLOT;
+
+out:
+    free(w.sector);
+    return err;
+}
+
+static int socket_read(void *ctx, void *buf, size_t len)
+{
+    return lwip_recv((int)ctx, buf, len, 0);
+}
+
+static int socket_write(void *ctx, const void *buf, size_t len)
+{
+    return lwip_send((int)ctx, buf, len, 0);
+}
+
+ota_http_err_t ota_http_update(const char *host, uint16_t port, const char *path)
+{
+    const struct addrinfo hints = {
+        .ai_family = AF_INET,
+        .ai_socktype = SOCK_STREAM,
+    };
+    struct addrinfo *res;
+    char port_str[6];
+
+    sprintf(port_str, "%u", port);
+    if(getaddrinfo(host, port_str, &hints, &res) != 0 || res == NULL)
+        return OTA_HTTP_ERR_CONNECT;
+
+    int s = lwip_socket(res->ai_family, res->ai_socktype, 0);
+    if(s < 0) {
+        freeaddrinfo(res);
+        return OTA_HTTP_ERR_CONNECT;
+    }
+
+    int timeout = OTA_HTTP_RECV_TIMEOUT;
+    lwip_setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    if(lwip_connect(s, res->ai_addr, res->ai_addrlen) != 0) {
+        lwip_close(s);
+        freeaddrinfo(res);
+        return OTA_HTTP_ERR_CONNECT;
+    }
+    freeaddrinfo(res);
+
+    ota_http_transport_t transport = {
+        .read = socket_read,
+        .write = socket_write,
+        .ctx = (void *)s,
+    };
+    ota_http_err_t err = ota_http_stream(&transport, host, path, NULL);
+    lwip_close(s);
+    return err;
+}
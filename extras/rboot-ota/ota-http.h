@@ -0,0 +1,68 @@
+#ifndef _OTA_HTTP_H
+#define _OTA_HTTP_H
+/* Streaming HTTP(S) OTA client
+ *
+ * Downloads a firmware image with an HTTP/1.0 GET and writes it into the
+ * next rboot slot as it arrives, without buffering the whole image.
+ *
+ * The image is written one whole, aligned flash sector at a time. Each
+ * sector is erased ahead of time, as soon as the previous one has been
+ * written (the first one before the request is even sent), so the erase
+ * happens while the server is still sending: the data that arrives
+ * meanwhile waits in the TCP window rather than the erase adding a
+ * round trip of idle link per sector. (The SDK's flash erase stalls the
+ * CPU, so it can't run at the same time as our own receive code.)
+ *
+ * ota_http_update() fetches over plain HTTP with an lwIP socket. For
+ * HTTPS, set up an mbedTLS session and pass ota_http_stream() a transport
+ * wrapping mbedtls_ssl_read/mbedtls_ssl_write.
+ *
+ * On success the new slot is selected in the rboot config but the
+ * caller decides when to reboot into it (sdk_system_restart()).
+ *
+ * Note that, like ota-tftp, this will flash any image that passes
+ * rboot_verify_image(), even one which doesn't itself support OTA.
+ */
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef OTA_HTTP_MAX_IMAGE_SIZE
+#define OTA_HTTP_MAX_IMAGE_SIZE 0x100000
+#endif
+
+/* Receive timeout for plain HTTP downloads, in ms */
+#ifndef OTA_HTTP_RECV_TIMEOUT
+#define OTA_HTTP_RECV_TIMEOUT 10000
+#endif
+
+typedef enum {
+    OTA_HTTP_OK = 0,
+    OTA_HTTP_ERR_SLOT = -1,     /* no other rboot slot to write to */
+    OTA_HTTP_ERR_CONNECT = -2,  /* DNS lookup or connection failed */
+    OTA_HTTP_ERR_IO = -3,       /* transport read/write failed */
+    OTA_HTTP_ERR_RESPONSE = -4, /* malformed response, or not 200 OK */
+    OTA_HTTP_ERR_TOO_LARGE = -5,
+    OTA_HTTP_ERR_MEM = -6,
+    OTA_HTTP_ERR_VERIFY = -7,   /* image failed rboot_verify_image */
+} ota_http_err_t;
+
+/* Transport for ota_http_stream(). read returns the number of bytes
+   read, 0 at end of stream or negative on error; write returns the number
+   of bytes written or negative on error. */
+typedef struct {
+    int (*read)(void *ctx, void *buf, size_t len);
+    int (*write)(void *ctx, const void *buf, size_t len);
+    void *ctx;
+} ota_http_transport_t;
+
+/* Send a GET for 'path' on 'host' over an already connected transport,
+   and stream the response body into the next rboot slot. On success,
+   switch rboot to that slot and return OTA_HTTP_OK. If image_len is not
+   NULL it's set to the number of image bytes received. */
+ota_http_err_t ota_http_stream(const ota_http_transport_t *transport, const char *host,
+                               const char *path, size_t *image_len);
+
+/* Download http://host:port/path into the next rboot slot, as above. */
+ota_http_err_t ota_http_update(const char *host, uint16_t port, const char *path);
+
+#endif
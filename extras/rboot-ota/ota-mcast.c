@@ -0,0 +1,278 @@
+/* Multicast OTA receiver
+ *
+ * For details of use see ota-mcast.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <FreeRTOS.h>
+#include <task.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "lwip/err.h"
+#include "lwip/api.h"
+#include "lwip/sys.h"
+
+#include <espressif/spi_flash.h>
+#include <espressif/esp_system.h>
+
+#include "ota-mcast.h"
+#include "rboot-ota.h"
+
+/* Reception state for one session */
+typedef struct {
+    uint32_t session;
+    uint32_t image_len;
+    uint16_t block_size;
+    uint32_t n_blocks;
+    uint32_t n_have;
+    uint32_t start;       /* flash offset of the slot being written */
+    uint8_t *have;        /* bitmap of blocks written to flash */
+    uint8_t *erased;      /* bitmap of sectors erased */
+    uint32_t *block;      /* symbol being decoded */
+    uint32_t *tmp;        /* blocks read back from flash */
+} mcast_rx_t;
+
+typedef struct {
+    ip_addr_t group;
+    bool join;
+    uint16_t port;
+} mcast_args_t;
+
+#define BIT_TEST(map, n) ((map)[(n) / 8] & (1 << ((n) % 8)))
+#define BIT_SET(map, n) ((map)[(n) / 8] |= (1 << ((n) % 8)))
+
+static void mcast_task(void *args_p);
+
+void ota_mcast_init_receiver(const ip_addr_t *group, uint16_t port)
+{
+    mcast_args_t *args = malloc(sizeof(mcast_args_t));
+    if(!args) {
+        printf("OTA MCAST: Out of memory\r\n");
+        return;
+    }
+    args->join = group != NULL;
+    if(group)
+        ip_addr_copy(args->group, *group);
+    args->port = port;
+    xTaskCreate(mcast_task, (signed char *)"mcastOTATask", 512, args, 2, NULL);
+}
+
+static inline uint32_t xorshift32(uint32_t x)
+{
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+int ota_mcast_symbol_blocks(uint32_t session, uint32_t symbol, uint32_t n_blocks, uint16_t *blocks)
+{
+    if(symbol < n_blocks) {
+        blocks[0] = symbol;
+        return 1;
+    }
+
+    uint32_t x = session ^ (symbol * 0x9e3779b9);
+    if(x == 0)
+        x = 1;
+    x = xorshift32(x);
+
+    /* 1/16 of the symbols are single blocks again, the rest follow the
+       ideal soliton distribution: P(d) = 1/(d(d-1)) */
+    uint32_t degree;
+    if(x % 16 == 0) {
+        degree = 1;
+    } else {
+        uint32_t u = (x >> 16) + 1;
+        degree = (65536 + u - 1) / u;
+    }
+    if(degree > OTA_MCAST_MAX_DEGREE)
+        degree = OTA_MCAST_MAX_DEGREE;
+    if(degree > n_blocks)
+        degree = n_blocks;
+
+    int n = 0;
+    while(n < degree) {
+        x = xorshift32(x);
+        uint16_t b = x % n_blocks;
+        int i;
+        for(i = 0; i < n && blocks[i] != b; i++)
+            ;
+        if(i == n)
+            blocks[n++] = b;
+    }
+    return n;
+}
+
+static void mcast_rx_free(mcast_rx_t *rx)
+{
+    free(rx->have);
+    free(rx->erased);
+    free(rx->block);
+    free(rx->tmp);
+    memset(rx, 0, sizeof(mcast_rx_t));
+}
+
+static bool mcast_rx_start(mcast_rx_t *rx, uint32_t start, uint32_t session, uint32_t image_len, uint16_t block_size)
+{
+    mcast_rx_free(rx);
+    rx->session = session;
+    rx->image_len = image_len;
+    rx->block_size = block_size;
+    rx->n_blocks = (image_len + block_size - 1) / block_size;
+    rx->start = start;
+    rx->have = calloc((rx->n_blocks + 7) / 8, 1);
+    rx->erased = calloc((image_len / SECTOR_SIZE + 8) / 8, 1);
+    rx->block = malloc(block_size);
+    rx->tmp = malloc(block_size);
+    if(!rx->have || !rx->erased || !rx->block || !rx->tmp) {
+        printf("OTA MCAST: Out of memory\r\n");
+        mcast_rx_free(rx);
+        return false;
+    }
+    printf("OTA MCAST: receiving session %08x, %u bytes in %u blocks\r\n",
+           session, image_len, rx->n_blocks);
+    return true;
+}
+
+/* Write the decoded block in rx->block to flash. Blocks divide sectors
+   evenly, so each one lies inside a single sector. */
+static void mcast_rx_write(mcast_rx_t *rx, uint16_t b)
+{
+    uint32_t offs = (uint32_t)b * rx->block_size;
+    uint32_t sector = offs / SECTOR_SIZE;
+    if(!BIT_TEST(rx->erased, sector)) {
+        sdk_spi_flash_erase_sector((rx->start + offs) / SECTOR_SIZE);
+        BIT_SET(rx->erased, sector);
+    }
+    sdk_spi_flash_write(rx->start + offs, rx->block, rx->block_size);
+    BIT_SET(rx->have, b);
+    rx->n_have++;
+
+    if(rx->n_have * 10 / rx->n_blocks != (rx->n_have - 1) * 10 / rx->n_blocks)
+        printf("OTA MCAST: %u%%\r\n", rx->n_have * 100 / rx->n_blocks);
+}
+
+/* Decode the symbol whose data is in rx->block, if it's missing exactly
+   one block */
+static void mcast_rx_symbol(mcast_rx_t *rx, uint32_t symbol)
+{
+    uint16_t blocks[OTA_MCAST_MAX_DEGREE];
+    int n = ota_mcast_symbol_blocks(rx->session, symbol, rx->n_blocks, blocks);
+    int missing = -1;
+
+    for(int i = 0; i < n; i++) {
+        if(BIT_TEST(rx->have, blocks[i]))
+            continue;
+        if(missing >= 0)
+            return;
+        missing = blocks[i];
+    }
+    if(missing < 0)
+        return;
+
+    uint32_t words = rx->block_size / 4;
+    for(int i = 0; i < n; i++) {
+        if(blocks[i] == missing)
+            continue;
+        sdk_spi_flash_read(rx->start + (uint32_t)blocks[i] * rx->block_size, rx->tmp, rx->block_size);
+        for(uint32_t w = 0; w < words; w++)
+            rx->block[w] ^= rx->tmp[w];
+    }
+    mcast_rx_write(rx, missing);
+}
+
+static void mcast_task(void *args_p)
+{
+    mcast_args_t *args = args_p;
+    struct netconn *nc = netconn_new(NETCONN_UDP);
+    if(!nc) {
+        printf("OTA MCAST: Failed to allocate socket.\r\n");
+        vTaskDelete(NULL);
+        return;
+    }
+    netconn_bind(nc, IP_ADDR_ANY, args->port);
+    if(args->join) {
+#if LWIP_IGMP
+        err_t err = netconn_join_leave_group(nc, &args->group, IP_ADDR_ANY, NETCONN_JOIN);
+        if(err != ERR_OK)
+            printf("OTA MCAST: Failed to join group, err=%d\r\n", err);
+#else
+        printf("OTA MCAST: Multicast needs LWIP_IGMP, only broadcasts will be received\r\n");
+#endif
+    }
+    free(args);
+
+    rboot_config_t conf = rboot_get_config();
+    int slot = (conf.current_rom + 1) % conf.count;
+    if(slot == conf.current_rom) {
+        printf("OTA MCAST: Only one OTA slot!\r\n");
+        netconn_delete(nc);
+        vTaskDelete(NULL);
+        return;
+    }
+
+    mcast_rx_t rx;
+    memset(&rx, 0, sizeof(rx));
+
+    while(1) {
+        struct netbuf *netbuf;
+        if(netconn_recv(nc, &netbuf) != ERR_OK)
+            continue;
+
+        uint32_t header[OTA_MCAST_HEADER_LEN / 4];
+        uint16_t len = netbuf_len(netbuf);
+        if(len < OTA_MCAST_HEADER_LEN) {
+            netbuf_delete(netbuf);
+            continue;
+        }
+        netbuf_copy(netbuf, header, OTA_MCAST_HEADER_LEN);
+        uint32_t magic = ntohl(header[0]);
+        uint32_t session = ntohl(header[1]);
+        uint32_t image_len = ntohl(header[2]);
+        uint16_t block_size = ntohl(header[3]) >> 16;
+        uint32_t symbol = ntohl(header[4]);
+
+        if(magic != OTA_MCAST_MAGIC || len != OTA_MCAST_HEADER_LEN + block_size
+           || block_size == 0 || block_size % 4 || SECTOR_SIZE % block_size
+           || block_size > OTA_MCAST_MAX_BLOCK || image_len == 0
+           || image_len > OTA_MCAST_MAX_IMAGE_SIZE
+           || (image_len + block_size - 1) / block_size > UINT16_MAX) {
+            netbuf_delete(netbuf);
+            continue;
+        }
+
+        if(!rx.have || session != rx.session || image_len != rx.image_len || block_size != rx.block_size) {
+            /* A new image (or the first packet), start over */
+            if(!mcast_rx_start(&rx, conf.roms[slot], session, image_len, block_size)) {
+                netbuf_delete(netbuf);
+                continue;
+            }
+        }
+
+        netbuf_copy_partial(netbuf, rx.block, block_size, OTA_MCAST_HEADER_LEN);
+        netbuf_delete(netbuf);
+        mcast_rx_symbol(&rx, symbol);
+
+        if(rx.n_have < rx.n_blocks)
+            continue;
+
+        const char *err = "Unknown validation error";
+        if(!rboot_verify_image(rx.start, rx.image_len, &err)) {
+            /* Start over, a later session may bring a good image */
+            printf("OTA MCAST: image failed verification: %s\r\n", err);
+            mcast_rx_free(&rx);
+            continue;
+        }
+        printf("OTA MCAST: image valid. Changing slot to %d\r\n", slot);
+        vPortEnterCritical();
+        if(!rboot_set_current_rom(slot)) {
+            printf("OTA MCAST failed to set new rboot slot\r\n");
+        }
+        sdk_system_restart();
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef _OTA_MCAST_H
+#define _OTA_MCAST_H
+/* Multicast OTA receiver
+ *
+ * Updates a whole fleet from one transmission: a sender multicasts (or
+ * broadcasts) the image as a stream of fountain coded blocks, and every
+ * device listening picks up whatever blocks it hears into its inactive
+ * rboot slot. Nothing is sent back, so devices can join late or miss
+ * packets, they just keep listening until they have the whole image.
+ * It's then checked with rboot_verify_image(), the slot is switched and
+ * the device reboots.
+ *
+ * The sender is ota_mcast_send.py (in this directory):
+ * python ota_mcast_send.py firmware/myprogram.bin 239.255.82.66
+ *
+ * Packet format, all integers big endian:
+ *
+ *   u32 magic "RBMC"
+ *   u32 session      identifies the image, a new session restarts reception
+ *   u32 image_len
+ *   u16 block_size   a multiple of 4 dividing SECTOR_SIZE
+ *   u16 reserved
+ *   u32 symbol       symbol number
+ *   block_size bytes of data
+ *
+ * The image is cut into K blocks (the last one padded with 0xff).
+ * Symbols 0..K-1 are the blocks themselves, and each later symbol is the
+ * XOR of a pseudo-random set of blocks picked from the session and
+ * symbol numbers, with a degree (set size) distributed roughly as the
+ * ideal soliton 1/(d(d-1)), capped at OTA_MCAST_MAX_DEGREE. A sender
+ * sends the K blocks first and then as many combined symbols as it
+ * likes.
+ *
+ * Each block received is written straight to flash, and marked in a
+ * bitmap. A combined symbol is decoded when all but one of its blocks
+ * are already there: the others are read back from flash and XORed out,
+ * which leaves the missing block. Symbols with more than one block
+ * missing are dropped, as keeping them would take more RAM than the
+ * device has. That costs some efficiency over a full fountain decoder.
+ * In simulation a device losing 5% of the packets needs about 2x the
+ * image size in symbols, and one losing 20% about 3x. The sender should
+ * allow for its worst placed devices.
+ *
+ * Multicast needs LWIP_IGMP=1 in the lwIP options (build with
+ * EXTRA_CFLAGS=-DLWIP_IGMP=1). Without it pass a NULL group and send to
+ * the subnet broadcast address.
+ *
+ * IMPORTANT: like TFTP, this isn't secure. Anyone on the network can
+ * send an image, only use it on trusted networks.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdint.h>
+#include "lwip/ip_addr.h"
+
+#define OTA_MCAST_MAGIC 0x52424d43 /* "RBMC" */
+#define OTA_MCAST_HEADER_LEN 20
+
+#define OTA_MCAST_PORT 6969
+
+/* Largest block accepted, 1024 keeps a packet inside one Ethernet frame */
+#ifndef OTA_MCAST_MAX_BLOCK
+#define OTA_MCAST_MAX_BLOCK 1024
+#endif
+
+#ifndef OTA_MCAST_MAX_IMAGE_SIZE
+#define OTA_MCAST_MAX_IMAGE_SIZE 0x100000
+#endif
+
+/* Most blocks combined into one symbol. Decoding one reads all but one
+   of them back from flash. Has to match the sender. */
+#define OTA_MCAST_MAX_DEGREE 32
+
+/* Start a FreeRTOS task listening on 'port' for an image, joining the
+   multicast group 'group' (unless NULL, to receive broadcasts). Once a
+   valid image is received it switches rboot to it and restarts. */
+void ota_mcast_init_receiver(const ip_addr_t *group, uint16_t port);
+
+/* The blocks XORed into 'symbol' of a 'n_blocks' block image, as the
+   sender picks them. Fills in 'blocks' (OTA_MCAST_MAX_DEGREE entries)
+   and returns how many. */
+int ota_mcast_symbol_blocks(uint32_t session, uint32_t symbol, uint32_t n_blocks, uint16_t *blocks);
+
+#endif
@@ -9,6 +9,8 @@
 #include <FreeRTOS.h>
 #include <string.h>
 #include <strings.h>
+#include <stdlib.h>
+#include <stdio.h>
 
 #include "lwip/err.h"
 #include "lwip/api.h"
@@ -23,8 +25,12 @@
 
 #include "ota-tftp.h"
 #include "rboot-ota.h"
+#include "ota-decompress.h"
+#include "ota-delta.h"
 
 #define TFTP_FIRMWARE_FILE "firmware.bin"
+#define TFTP_COMPRESSED_FILE "firmware.bin.hs" /* heatshrink compressed */
+#define TFTP_DELTA_FILE "firmware.delta" /* patch against the running image */
 #define TFTP_OCTET_MODE "octet" /* non-case-sensitive */
 
 #define TFTP_OP_WRQ 2
@@ -40,15 +46,44 @@
 
 #define MAX_IMAGE_SIZE 0x100000 /*1MB images max at the moment */
 
+#define TFTP_DEFAULT_BLKSIZE 512
+
+/* Wait this long for each data packet, and retry the last ACK (or OACK)
+   this many times before giving up */
+#define TFTP_RECV_TIMEOUT_MS 1000
+#define TFTP_RECV_RETRIES 10
+
+/* Verifying a signature takes more stack */
+#if RBOOT_OTA_ECDSA
+#define TFTP_TASK_STACK 1024
+#else
+#define TFTP_TASK_STACK 512
+#endif
+
+/* Negotiated transfer options (RFC 2347) */
+typedef struct {
+    uint16_t blksize;    /* RFC 2348, data bytes per block */
+    uint16_t windowsize; /* RFC 7440, blocks sent per ACK */
+    bool oack;           /* client sent options, so we answer with OACK */
+    uint8_t format;      /* TFTP_FORMAT_x, from the filename */
+} tftp_options_t;
+
+#define TFTP_FORMAT_RAW 0
+#define TFTP_FORMAT_COMPRESSED 1
+#define TFTP_FORMAT_DELTA 2
+
 static void tftp_task(void *port_p);
 static char *tftp_get_field(int field, struct netbuf *netbuf);
-static err_t tftp_receive_data(struct netconn *nc, size_t write_offs, size_t limit_offs, size_t *received_len);
+static void tftp_parse_options(struct netbuf *netbuf, tftp_options_t *opts);
+static err_t tftp_receive_data(struct netconn *nc, size_t write_offs, size_t limit_offs, size_t current_offs,
+                               size_t *received_len, const tftp_options_t *opts);
 static err_t tftp_send_ack(struct netconn *nc, int block);
+static err_t tftp_send_oack(struct netconn *nc, const tftp_options_t *opts);
 static void tftp_send_error(struct netconn *nc, int err_code, const char *err_msg);
 
 void ota_tftp_init_server(int listen_port)
 {
-    xTaskCreate(tftp_task, (signed char *)"tftpOTATask", 512, (void *)listen_port, 2, NULL);
+    xTaskCreate(tftp_task, (signed char *)"tftpOTATask", TFTP_TASK_STACK, (void *)listen_port, OTA_TFTP_PRIORITY, NULL);
 }
 
 static void tftp_task(void *listen_port)
@@ -89,8 +124,15 @@ static void tftp_task(void *listen_port)
 
         /* check filename */
         char *filename = tftp_get_field(0, netbuf);
-        if(!filename || strcmp(filename, TFTP_FIRMWARE_FILE)) {
-            tftp_send_error(nc, TFTP_ERR_FILENOTFOUND, "File must be firmware.bin");
+        uint8_t format;
+        if(filename && !strcmp(filename, TFTP_FIRMWARE_FILE))
+            format = TFTP_FORMAT_RAW;
+        else if(filename && !strcmp(filename, TFTP_COMPRESSED_FILE))
+            format = TFTP_FORMAT_COMPRESSED;
+        else if(filename && !strcmp(filename, TFTP_DELTA_FILE))
+            format = TFTP_FORMAT_DELTA;
+        else {
+            tftp_send_error(nc, TFTP_ERR_FILENOTFOUND, "File must be firmware.bin, firmware.bin.hs or firmware.delta");
             free(filename);
             netbuf_delete(netbuf);
             continue;
@@ -107,6 +149,10 @@ static void tftp_task(void *listen_port)
         }
         free(mode);
 
+        tftp_options_t opts;
+        tftp_parse_options(netbuf, &opts);
+        opts.format = format;
+
         /* establish a connection back to the sender from this netbuf */
         netconn_connect(nc, netbuf_fromaddr(netbuf), netbuf_fromport(netbuf));
         netbuf_delete(netbuf);
@@ -122,8 +168,8 @@ static void tftp_task(void *listen_port)
             continue;
         }
 
-        /* ACK the WRQ */
-        int ack_err = tftp_send_ack(nc, 0);
+        /* ACK the WRQ, or acknowledge its options */
+        int ack_err = opts.oack ? tftp_send_oack(nc, &opts) : tftp_send_ack(nc, 0);
         if(ack_err != 0) {
             printf("OTA TFTP initial ACK failed\r\n");
             netconn_disconnect(nc);
@@ -132,7 +178,8 @@ static void tftp_task(void *listen_port)
 
         /* Finished WRQ phase, start TFTP data transfer */
         size_t received_len;
-        int recv_err = tftp_receive_data(nc, conf.roms[slot], conf.roms[slot]+MAX_IMAGE_SIZE, &received_len);
+        int recv_err = tftp_receive_data(nc, conf.roms[slot], conf.roms[slot]+MAX_IMAGE_SIZE,
+                                         conf.roms[conf.current_rom], &received_len, &opts);
 
         netconn_disconnect(nc);
         printf("OTA TFTP receive data result %d bytes %d\r\n", recv_err, received_len);
@@ -181,124 +228,251 @@ static char *tftp_get_field(int field, struct netbuf *netbuf)
     return result;
 }
 
-static err_t tftp_receive_data(struct netconn *nc, size_t write_offs, size_t limit_offs, size_t *received_len)
+/* Parse the RFC 2347 options following the mode in a WRQ. Options we
+   don't know are ignored, as the RFC requires. */
+static void tftp_parse_options(struct netbuf *netbuf, tftp_options_t *opts)
+{
+    opts->blksize = TFTP_DEFAULT_BLKSIZE;
+    opts->windowsize = 1;
+    opts->oack = false;
+
+    for(int field = 2; ; field += 2) {
+        char *name = tftp_get_field(field, netbuf);
+        char *value = name ? tftp_get_field(field + 1, netbuf) : NULL;
+        if(!value) {
+            free(name);
+            return;
+        }
+
+        long v = strtol(value, NULL, 10);
+        if(!strcasecmp(name, "blksize") && v >= 8) {
+            /* Keep blocks whole words, for flash writes */
+            opts->blksize = (v > TFTP_MAX_BLKSIZE ? TFTP_MAX_BLKSIZE : v) & ~3;
+            opts->oack = true;
+        }
+        else if(!strcasecmp(name, "windowsize") && v >= 1) {
+            opts->windowsize = v > TFTP_MAX_WINDOWSIZE ? TFTP_MAX_WINDOWSIZE : v;
+            opts->oack = true;
+        }
+        free(name);
+        free(value);
+    }
+}
+
+/* Copy a data block out of the netbuf straight into the image writer's
+   sector buffer, in two parts if it straddles a sector boundary */
+static bool tftp_write_block(struct netbuf *netbuf, uint16_t len, rboot_write_status *image)
+{
+    uint16_t offs = 4; /* skip the TFTP header */
+    while(len) {
+        uint32_t space;
+        uint8_t *dest = rboot_write_space(image, &space);
+        if(space > len)
+            space = len;
+        netbuf_copy_partial(netbuf, dest, space, offs);
+        if(!rboot_write_commit(image, space))
+            return false;
+        offs += space;
+        len -= space;
+    }
+    return true;
+}
+
+/* Feed a compressed or delta data block to the decompressor or patcher,
+   a pbuf at a time */
+static bool tftp_decode_block(struct netbuf *netbuf, uint8_t format, ota_decompress_t *decomp,
+                              ota_delta_t *delta, const char **error)
+{
+    uint16_t skip = 4; /* skip the TFTP header */
+    netbuf_first(netbuf);
+    do {
+        void *data;
+        uint16_t len;
+        netbuf_data(netbuf, &data, &len);
+        if(len <= skip) {
+            skip -= len;
+            continue;
+        }
+        bool ok = (format == TFTP_FORMAT_DELTA)
+            ? ota_delta_write(delta, (uint8_t *)data + skip, len - skip, error)
+            : ota_decompress_write(decomp, (uint8_t *)data + skip, len - skip);
+        if(!ok)
+            return false;
+        skip = 0;
+    } while(netbuf_next(netbuf) >= 0);
+    return true;
+}
+
+/* Receive the file after the WRQ has been acknowledged.
+
+   With a window size above 1 (RFC 7440) the client sends a whole window
+   of blocks before waiting for an ACK, so we only ACK the last block of
+   each window (or the final, short, block.) If a block is lost, the
+   next one arrives out of order: we ACK the last block we did get, once,
+   and the client restarts the window from there.
+*/
+static err_t tftp_receive_data(struct netconn *nc, size_t write_offs, size_t limit_offs, size_t current_offs,
+                               size_t *received_len, const tftp_options_t *opts)
 {
     *received_len = 0;
-    const int DATA_PACKET_SZ = 512 + 4; /*( packet size plus header */
+    const int data_packet_sz = opts->blksize + 4; /* packet size plus header */
     uint32_t start_offs = write_offs;
-    int block = 1;
+    uint16_t block = 1;      /* next block we expect */
+    uint16_t window_pos = 0; /* blocks received since our last ACK */
+    bool nacked = false;     /* already sent an ACK for the current loss */
+    int retries = 0;
+
+    rboot_write_status image;
+    ota_decompress_t decomp = { .window = NULL };
+    ota_delta_t delta = { .op = 0 };
+    if(!rboot_write_init(&image, write_offs, limit_offs - write_offs)) {
+        tftp_send_error(nc, TFTP_ERR_FULL, "Out of memory");
+        return ERR_MEM;
+    }
+    rboot_write_throttle(&image, OTA_TFTP_RATE_LIMIT, OTA_TFTP_IDLE_ERASE);
+    if(opts->format == TFTP_FORMAT_DELTA)
+        ota_delta_init(&delta, &image, current_offs, MAX_IMAGE_SIZE);
+    if(opts->format == TFTP_FORMAT_COMPRESSED && !ota_decompress_init(&decomp, &image)) {
+        rboot_write_end(&image);
+        tftp_send_error(nc, TFTP_ERR_FULL, "Out of memory");
+        return ERR_MEM;
+    }
 
     struct netbuf *netbuf;
+    err_t result;
 
+    netconn_set_recvtimeout(nc, TFTP_RECV_TIMEOUT_MS);
     while(1)
     {
-        netconn_set_recvtimeout(nc, 10000);
         err_t err = netconn_recv(nc, &netbuf);
         if(err == ERR_TIMEOUT) {
-            tftp_send_error(nc, TFTP_ERR_ILLEGAL, "Timeout");
-            return ERR_TIMEOUT;
+            if(++retries > TFTP_RECV_RETRIES) {
+                tftp_send_error(nc, TFTP_ERR_ILLEGAL, "Timeout");
+                result = ERR_TIMEOUT;
+                break;
+            }
+            /* Our last ACK (or the OACK) may have been lost */
+            if(block == 1 && opts->oack)
+                tftp_send_oack(nc, opts);
+            else
+                tftp_send_ack(nc, block-1);
+            window_pos = 0;
+            continue;
         }
         else if(err != ERR_OK) {
             tftp_send_error(nc, TFTP_ERR_ILLEGAL, "Failed to receive packet");
-            return err;
+            result = err;
+            break;
+        }
+
+        int len = netbuf_len(netbuf);
+        if(len < 4) {
+            netbuf_delete(netbuf);
+            continue;
         }
 
         uint16_t opcode = netbuf_read_u16_n(netbuf, 0);
         if(opcode != TFTP_OP_DATA) {
             tftp_send_error(nc, TFTP_ERR_ILLEGAL, "Unknown opcode");
             netbuf_delete(netbuf);
-            return ERR_VAL;
+            result = ERR_VAL;
+            break;
         }
 
         uint16_t client_block = netbuf_read_u16_n(netbuf, 2);
         if(client_block != block) {
             netbuf_delete(netbuf);
-            if(client_block == block-1) {
-                /* duplicate block, means our ack got lost */
+            if(client_block == (uint16_t)(block-1)) {
+                /* duplicate of our last ACKed block, means the ACK got lost */
                 tftp_send_ack(nc, block-1);
-                continue;
+                window_pos = 0;
             }
-            else {
-                tftp_send_error(nc, TFTP_ERR_ILLEGAL, "Block# out of order");
-                return ERR_VAL;
+            else if((int16_t)(client_block - block) > 0 && !nacked) {
+                /* a block went missing, restart the window after the last good one */
+                tftp_send_ack(nc, block-1);
+                window_pos = 0;
+                nacked = true;
             }
+            /* otherwise a stale duplicate from a retransmitted window */
+            continue;
         }
-
-        if(write_offs % SECTOR_SIZE == 0) {
-            sdk_spi_flash_erase_sector(write_offs / SECTOR_SIZE);
-        }
-
-        /* One UDP packet can be more than one netbuf segment, so iterate all the
-           segments in the netbuf and write them to flash
-        */
-        int offset = 0;
-        int len = netbuf_len(netbuf);
-
-        if(write_offs + len >= limit_offs) {
-            tftp_send_error(nc, TFTP_ERR_FULL, "Image too large");
-            return ERR_VAL;
+        retries = 0;
+        nacked = false;
+
+        uint16_t data_len = len - 4;
+        const char *write_err = "Image too large";
+        bool written = (opts->format == TFTP_FORMAT_RAW) ? tftp_write_block(netbuf, data_len, &image)
+            : tftp_decode_block(netbuf, opts->format, &decomp, &delta, &write_err);
+        if(len > data_packet_sz || !written) {
+            netbuf_delete(netbuf);
+            tftp_send_error(nc, TFTP_ERR_FULL, write_err);
+            result = ERR_VAL;
+            break;
         }
-
-        bool first_chunk = true;
-        do
-        {
-            uint16_t chunk_len;
-            uint32_t *chunk;
-            netbuf_data(netbuf, (void **)&chunk, &chunk_len);
-            if(first_chunk) {
-                chunk++; /* skip the 4 byte TFTP header */
-                chunk_len -= 4; /* assuming this netbuf chunk is at least 4 bytes! */
-                first_chunk = false;
-            }
-            if(chunk_len && ((uint32_t)chunk % 4)) {
-                /* sdk_spi_flash_write requires a word aligned
-                   buffer, so if the UDP payload is unaligned
-                   (common) then we copy the first word to the stack
-                   and write that to flash, then move the rest of the
-                   buffer internally to sit on an aligned offset.
-
-                   Assuming chunk_len is always a multiple of 4 bytes.
-                */
-                uint32_t first_word;
-                memcpy(&first_word, chunk, 4);
-                sdk_spi_flash_write(write_offs+offset, &first_word, 4);
-                memmove(LWIP_MEM_ALIGN(chunk),&chunk[1],chunk_len-4);
-                chunk = LWIP_MEM_ALIGN(chunk);
-                offset += 4;
-                chunk_len -= 4;
-            }
-            sdk_spi_flash_write(write_offs+offset, chunk, chunk_len);
-            offset += chunk_len;
-        } while(netbuf_next(netbuf) >= 0);
-
         netbuf_delete(netbuf);
 
-        *received_len += len - 4;
+        *received_len += data_len;
+        bool last = len < data_packet_sz;
+
+        if(last) {
+            /* Flush the final partial sector before verifying. The image
+               length is what was written, which for a compressed image
+               is more than was received. */
+            uint32_t image_len = rboot_write_len(&image);
+            rboot_write_end(&image);
 
-        if(len < DATA_PACKET_SZ) {
             /* This was the last block, but verify the image before we ACK
                it so the client gets an indication if things were successful.
             */
             const char *err = "Unknown validation error";
-            if(!rboot_verify_image(start_offs, *received_len, &err)) {
+            if(opts->format == TFTP_FORMAT_DELTA && !ota_delta_end(&delta, &err)) {
+                tftp_send_error(nc, TFTP_ERR_ILLEGAL, err);
+                result = ERR_VAL;
+                break;
+            }
+#if RBOOT_OTA_ECDSA
+            /* The image was hashed as it was written, this is just the
+               signature check */
+            if(!rboot_write_verify_signature(&image, image_len, &err)) {
+                tftp_send_error(nc, TFTP_ERR_ILLEGAL, err);
+                result = ERR_VAL;
+                break;
+            }
+            image_len -= RBOOT_OTA_SIG_LEN;
+#endif
+            if(!rboot_verify_image(start_offs, image_len, &err)) {
                 tftp_send_error(nc, TFTP_ERR_ILLEGAL, err);
-                return ERR_VAL;
+                result = ERR_VAL;
+                break;
             }
         }
 
-        err_t ack_err = tftp_send_ack(nc, block);
-        if(ack_err != ERR_OK) {
-            printf("OTA TFTP failed to send ACK.\r\n");
-            return ack_err;
+        if(last || ++window_pos == opts->windowsize) {
+            err_t ack_err = tftp_send_ack(nc, block);
+            if(ack_err != ERR_OK) {
+                printf("OTA TFTP failed to send ACK.\r\n");
+                result = ack_err;
+                break;
+            }
+            window_pos = 0;
+            /* The client won't send more until this ACK reaches it */
+            if(!last)
+                rboot_write_idle(&image);
         }
 
-        if(len < DATA_PACKET_SZ) {
-            return ERR_OK;
+        if(last) {
+            result = ERR_OK;
+            break;
         }
 
         block++;
-        write_offs += 512;
     }
+
+    if(image.buffer)
+        rboot_write_end(&image);
+    if(decomp.window)
+        ota_decompress_end(&decomp);
+    return result;
 }
 
 static err_t tftp_send_ack(struct netconn *nc, int block)
@@ -313,6 +487,26 @@ static err_t tftp_send_ack(struct netconn *nc, int block)
     return ack_err;
 }
 
+static err_t tftp_send_oack(struct netconn *nc, const tftp_options_t *opts)
+{
+    char oack[64];
+    int len = 2;
+
+    oack[0] = 0;
+    oack[1] = TFTP_OP_OACK;
+    len += sprintf(oack + len, "blksize") + 1;
+    len += sprintf(oack + len, "%u", opts->blksize) + 1;
+    len += sprintf(oack + len, "windowsize") + 1;
+    len += sprintf(oack + len, "%u", opts->windowsize) + 1;
+
+    struct netbuf *resp = netbuf_new();
+    void *resp_buf = netbuf_alloc(resp, len);
+    memcpy(resp_buf, oack, len);
+    err_t err = netconn_send(nc, resp);
+    netbuf_delete(resp);
+    return err;
+}
+
 static void tftp_send_error(struct netconn *nc, int err_code, const char *err_msg)
 {
     printf("OTA TFTP Error: %s\r\n", err_msg);
@@ -17,6 +17,25 @@
  * TFTP protocol implemented as per RFC1350:
  * https://tools.ietf.org/html/rfc1350
  *
+ * The blksize (RFC2348) and windowsize (RFC7440) options are supported,
+ * so clients that offer them can send large blocks and several blocks per
+ * ACK, which makes the transfer many times faster. For example with curl:
+ * curl -T firmware/myprogram.bin --tftp-blksize 1428 tftp://ESP_IP/firmware.bin
+ *
+ * Images can also be sent heatshrink compressed (see ota-decompress.h),
+ * with filename "firmware.bin.hs", and are decompressed into the slot as
+ * they arrive. This roughly halves the transfer time:
+ * heatshrink -e -w 10 -l 5 firmware/myprogram.bin myprogram.bin.hs
+ * tftp -m octet ESP_IP -c put myprogram.bin.hs firmware.bin.hs
+ *
+ * Or as a delta against the image in the running slot (see ota-delta.h),
+ * with filename "firmware.delta", which is usually only a few KB:
+ * python mkdelta.py old/myprogram.bin firmware/myprogram.bin myprogram.delta
+ * tftp -m octet ESP_IP -c put myprogram.delta firmware.delta
+ *
+ * Built with RBOOT_OTA_ECDSA (see rboot-ota.h), only signed images are
+ * accepted, sent the same ways but made from the output of ota_sign.py.
+ *
  * IMPORTANT: TFTP is not a secure protocol.
  * Only allow TFTP OTA updates on trusted networks.
  *
@@ -32,4 +51,40 @@ void ota_tftp_init_server(int listen_port);
 
 #define TFTP_PORT 69
 
+/* Largest block size accepted. 1428 keeps a whole DATA packet inside one
+   Ethernet frame even with VPN or PPPoE headers on the path. */
+#ifndef TFTP_MAX_BLKSIZE
+#define TFTP_MAX_BLKSIZE 1428
+/* Priority of the TFTP server task. To keep an update from getting in
+   the way of time critical tasks, run it below them (say at
+   tskIDLE_PRIORITY + 1) and set the two options below. */
+#ifndef OTA_TFTP_PRIORITY
+#define OTA_TFTP_PRIORITY 2
+#endif
+
+/* Limit the transfer to this many bytes per second, 0 for no limit. The
+   server sleeps between flash sectors while it's ahead, holding back its
+   ACKs. The client then times out and resends, so don't set this far
+   below a sector per client timeout (4KB/s for the usual 1s). */
+#ifndef OTA_TFTP_RATE_LIMIT
+#define OTA_TFTP_RATE_LIMIT 0
+#endif
+
+/* Erase each flash sector right after ACKing a block, while the client
+   is waiting for the ACK and nothing else is due from the network,
+   instead of as soon as the previous sector is written. (See
+   rboot_write_throttle() in rboot-ota.h.) */
+#ifndef OTA_TFTP_IDLE_ERASE
+#define OTA_TFTP_IDLE_ERASE 0
+#endif
+
+#endif
+
+/* Largest window (blocks between ACKs) accepted. A window has to fit in
+   the UDP receive mailbox (DEFAULT_UDP_RECVMBOX_SIZE) while the OTA task
+   is busy erasing a flash sector, or blocks are dropped. */
+#ifndef TFTP_MAX_WINDOWSIZE
+#define TFTP_MAX_WINDOWSIZE 4
+#endif
+
 #endif
@@ -0,0 +1,107 @@
+#!/usr/bin/env python
+#
+# Multicast an image to every device running the ota-mcast receiver
+# (see ota-mcast.h for the packet format and coding)
+#
+# Usage: python ota_mcast_send.py [options] image.bin group_or_broadcast_address
+#
+# Sends the image's blocks once, then fountain coded symbols until
+# --overhead times the image has gone out. Devices missing more packets
+# need more: allow about 2x for 5% loss and 3x for 20%.
+#
+# Part of esp-open-rtos
+# Copyright (C) 2015 Superhouse Automation Pty Ltd
+# BSD Licensed as described in the file LICENSE
+import argparse
+import binascii
+import os
+import socket
+import struct
+import sys
+import time
+
+MAGIC = 0x52424d43  # "RBMC"
+MAX_DEGREE = 32     # OTA_MCAST_MAX_DEGREE
+SECTOR_SIZE = 0x1000
+
+def xorshift32(x):
+    x ^= (x << 13) & 0xffffffff
+    x ^= x >> 17
+    x ^= (x << 5) & 0xffffffff
+    return x
+
+# as ota_mcast_symbol_blocks()
+def symbol_blocks(session, symbol, n_blocks):
+    if symbol < n_blocks:
+        return [symbol]
+    x = (session ^ (symbol * 0x9e3779b9)) & 0xffffffff
+    if x == 0:
+        x = 1
+    x = xorshift32(x)
+    if x % 16 == 0:
+        degree = 1
+    else:
+        u = (x >> 16) + 1
+        degree = (65536 + u - 1) // u
+    degree = min(degree, MAX_DEGREE, n_blocks)
+    blocks = []
+    while len(blocks) < degree:
+        x = xorshift32(x)
+        b = x % n_blocks
+        if b not in blocks:
+            blocks.append(b)
+    return blocks
+
+def xor_blocks(blocks, indices):
+    # XOR as big integers, much faster than byte by byte in Python
+    size = len(blocks[0])
+    acc = 0
+    for i in indices:
+        acc ^= int(binascii.hexlify(blocks[i]), 16)
+    return binascii.unhexlify("%0*x" % (size * 2, acc))
+
+def main():
+    parser = argparse.ArgumentParser(description="Multicast an OTA image to ota-mcast receivers")
+    parser.add_argument("image")
+    parser.add_argument("address", help="multicast group (e.g. 239.255.82.66) or broadcast address")
+    parser.add_argument("--port", type=int, default=6969)
+    parser.add_argument("--block-size", type=int, default=1024)
+    parser.add_argument("--overhead", type=float, default=3.0,
+                        help="symbols sent, as a multiple of the image's blocks")
+    parser.add_argument("--rate", type=float, default=200, help="packets per second")
+    parser.add_argument("--ttl", type=int, default=1)
+    args = parser.parse_args()
+
+    if args.block_size % 4 or SECTOR_SIZE % args.block_size:
+        sys.exit("Block size must be a multiple of 4 dividing %d" % SECTOR_SIZE)
+
+    image = open(args.image, "rb").read()
+    n_blocks = (len(image) + args.block_size - 1) // args.block_size
+    padded = image + b"\xff" * (n_blocks * args.block_size - len(image))
+    blocks = [padded[i * args.block_size:(i + 1) * args.block_size] for i in range(n_blocks)]
+    session = struct.unpack(">I", os.urandom(4))[0]
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_BROADCAST, 1)
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, args.ttl)
+
+    total = int(n_blocks * args.overhead)
+    print("%s: %d bytes, %d blocks, sending %d symbols as session %08x"
+          % (args.image, len(image), n_blocks, total, session))
+    interval = 1.0 / args.rate
+    next_send = time.time()
+    for symbol in range(total):
+        header = struct.pack(">IIIHHI", MAGIC, session, len(image), args.block_size, 0, symbol)
+        sock.sendto(header + xor_blocks(blocks, symbol_blocks(session, symbol, n_blocks)),
+                    (args.address, args.port))
+        next_send += interval
+        delay = next_send - time.time()
+        if delay > 0:
+            time.sleep(delay)
+        if symbol % 256 == 0:
+            sys.stdout.write("\r%d/%d" % (symbol, total))
+            sys.stdout.flush()
+    print("\r%d/%d done" % (total, total))
+
+if __name__ == "__main__":
+    main()
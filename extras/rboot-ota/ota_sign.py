@@ -0,0 +1,68 @@
+#!/usr/bin/env python
+#
+# Sign an OTA image for RBOOT_OTA_ECDSA (see rboot-ota.h), with openssl
+#
+# Usage: python ota_sign.py key.pem image.bin out.signed
+#        python ota_sign.py --pubkey key.pem
+#
+# key.pem is a P-256 private key, made with
+# openssl ecparam -name prime256v1 -genkey -noout -out key.pem
+#
+# The signed image is image.bin followed by r and s of an ECDSA signature
+# over its SHA-256, 32 bytes each, big endian. --pubkey prints the public
+# key as a C array for rboot_set_signing_key().
+#
+# Part of esp-open-rtos
+# Copyright (C) 2015 Superhouse Automation Pty Ltd
+# BSD Licensed as described in the file LICENSE
+import binascii
+import subprocess
+import sys
+
+def der_length(der, i):
+    n = bytearray(der)[i]
+    if n < 0x80:
+        return n, i + 1
+    count = n & 0x7f
+    return int(binascii.hexlify(der[i + 1:i + 1 + count]), 16), i + 1 + count
+
+def der_integer(der, i):
+    if bytearray(der)[i] != 0x02:
+        raise ValueError("Expected an INTEGER in the signature")
+    n, i = der_length(der, i + 1)
+    value = der[i:i + n].lstrip(b"\x00")
+    if len(value) > 32:
+        raise ValueError("Signature integer too long for P-256")
+    return b"\x00" * (32 - len(value)) + value, i + n
+
+def sign(key, image):
+    der = subprocess.check_output(["openssl", "dgst", "-sha256", "-binary", "-sign", key, image])
+    if bytearray(der)[0] != 0x30:
+        raise ValueError("Expected a SEQUENCE from openssl")
+    _, i = der_length(der, 1)
+    r, i = der_integer(der, i)
+    s, i = der_integer(der, i)
+    return r + s
+
+def public_key(key):
+    der = subprocess.check_output(["openssl", "ec", "-in", key, "-pubout", "-outform", "DER"])
+    # SubjectPublicKeyInfo ends with the uncompressed point
+    point = der[-65:]
+    if bytearray(point)[0] != 0x04:
+        raise ValueError("Not an uncompressed P-256 key")
+    return point
+
+if __name__ == "__main__":
+    if len(sys.argv) == 3 and sys.argv[1] == "--pubkey":
+        point = bytearray(public_key(sys.argv[2]))
+        print("static const uint8_t ota_signing_key[65] = {")
+        for i in range(0, 65, 8):
+            print("    " + " ".join("0x%02x," % b for b in point[i:i + 8]))
+        print("};")
+    elif len(sys.argv) == 4:
+        image = open(sys.argv[2], "rb").read()
+        signature = sign(sys.argv[1], sys.argv[2])
+        open(sys.argv[3], "wb").write(image + signature)
+        print("%s: %d bytes signed" % (sys.argv[3], len(image)))
+    else:
+        sys.exit("Usage: %s key.pem image.bin out.signed\n       %s --pubkey key.pem" % (sys.argv[0], sys.argv[0]))
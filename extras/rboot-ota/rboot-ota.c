@@ -12,6 +12,14 @@
 
 #include "rboot-ota.h"
 
+#if RBOOT_OTA_SHA256
+#include <mbedtls/sha256.h>
+#endif
+
+#if RBOOT_OTA_ECDSA
+#include <mbedtls/ecdsa.h>
+#endif
+
 #define ROM_MAGIC_OLD 0xe9
 #define ROM_MAGIC_NEW 0xea
 #define CHECKSUM_INIT 0xef
@@ -34,6 +42,30 @@ typedef struct __attribute__((packed)) {
     uint32_t length;
 } section_header_t;
 
+// size of the flash reads used when verifying an image
+#define VERIFY_CHUNK_SIZE 1024
+
+// XOR 'len' bytes of flash at the (word aligned) offset 'addr' into checksum,
+// reading VERIFY_CHUNK_SIZE bytes at a time into 'chunk'
+static uint8_t checksum_flash(uint32_t addr, uint32_t len, uint32_t *chunk, uint8_t checksum) {
+	uint32_t sum = 0;
+	while (len > 0) {
+		uint32_t n = len < VERIFY_CHUNK_SIZE ? len : VERIFY_CHUNK_SIZE;
+		sdk_spi_flash_read(addr, chunk, (n + 3) & ~3);
+		for (uint32_t i = 0; i < n / 4; i++) {
+			sum ^= chunk[i];
+		}
+		// trailing bytes of the final, partial, word
+		const uint8_t *tail = (const uint8_t*)&chunk[n / 4];
+		for (uint32_t i = 0; i < n % 4; i++) {
+			checksum ^= tail[i];
+		}
+		addr += n;
+		len -= n;
+	}
+	return checksum ^ (sum ^ (sum >> 8) ^ (sum >> 16) ^ (sum >> 24));
+}
+
 
 // get the rboot config
 rboot_config_t rboot_get_config() {
@@ -96,16 +128,195 @@ bool rboot_set_current_rom(uint8_t rom) {
 	return rboot_set_config(&conf);
 }
 
+bool rboot_write_init(rboot_write_status *status, uint32_t start_addr, uint32_t max_len) {
+	status->start_addr = start_addr;
+	status->addr = start_addr;
+	status->limit_addr = start_addr + max_len;
+	status->fill = 0;
+	status->idle_erase = false;
+	status->rate = 0;
+	status->buffer = (uint32_t*)malloc(SECTOR_SIZE);
+	if (!status->buffer) {
+		printf("rboot_write_init: Failed to allocate sector buffer\r\n");
+		return false;
+	}
+	sdk_spi_flash_erase_sector(start_addr / SECTOR_SIZE);
+	status->erase_pending = false;
+#if RBOOT_OTA_ECDSA
+	mbedtls_sha256_init(&status->sha);
+	mbedtls_sha256_starts(&status->sha, 0);
+	status->hold_len = 0;
+#endif
+	return true;
+}
+
+#if RBOOT_OTA_ECDSA
+static const uint8_t *signing_key;
+
+void rboot_set_signing_key(const uint8_t key[65]) {
+	signing_key = key;
+}
+
+// hash the data written, except for whatever turns out to be the last
+// RBOOT_OTA_SIG_LEN bytes, which are held back as the signature
+static void rboot_write_hash(rboot_write_status *status, const uint8_t *data, uint32_t len) {
+	if (len >= RBOOT_OTA_SIG_LEN) {
+		mbedtls_sha256_update(&status->sha, status->hold, status->hold_len);
+		mbedtls_sha256_update(&status->sha, data, len - RBOOT_OTA_SIG_LEN);
+		memcpy(status->hold, data + len - RBOOT_OTA_SIG_LEN, RBOOT_OTA_SIG_LEN);
+		status->hold_len = RBOOT_OTA_SIG_LEN;
+		return;
+	}
+	uint32_t keep = RBOOT_OTA_SIG_LEN - len;
+	if (status->hold_len > keep) {
+		uint32_t drop = status->hold_len - keep;
+		mbedtls_sha256_update(&status->sha, status->hold, drop);
+		memmove(status->hold, status->hold + drop, keep);
+		status->hold_len = keep;
+	}
+	memcpy(status->hold + status->hold_len, data, len);
+	status->hold_len += len;
+}
+
+bool rboot_write_verify_signature(rboot_write_status *status, uint32_t len, const char **error_message) {
+	char *error = NULL;
+	uint8_t digest[32];
+	mbedtls_ecdsa_context ecdsa;
+	mbedtls_mpi r, s;
+
+	mbedtls_sha256_finish(&status->sha, digest);
+	mbedtls_sha256_free(&status->sha);
+	mbedtls_ecdsa_init(&ecdsa);
+	mbedtls_mpi_init(&r);
+	mbedtls_mpi_init(&s);
+
+	if (!signing_key) {
+		error = "No signing key set";
+	} else if (len < RBOOT_OTA_SIG_LEN || status->hold_len != RBOOT_OTA_SIG_LEN) {
+		error = "Image not signed";
+	} else if (mbedtls_ecp_group_load(&ecdsa.grp, MBEDTLS_ECP_DP_SECP256R1) != 0
+			|| mbedtls_ecp_point_read_binary(&ecdsa.grp, &ecdsa.Q, signing_key, 65) != 0
+			|| mbedtls_mpi_read_binary(&r, status->hold, 32) != 0
+			|| mbedtls_mpi_read_binary(&s, status->hold + 32, 32) != 0) {
+		error = "Out of memory or bad signing key";
+	} else if (mbedtls_ecdsa_verify(&ecdsa.grp, digest, sizeof(digest), &ecdsa.Q, &r, &s) != 0) {
+		error = "Bad signature";
+	}
+
+	mbedtls_mpi_free(&r);
+	mbedtls_mpi_free(&s);
+	mbedtls_ecdsa_free(&ecdsa);
+	if (error) {
+		if (error_message) *error_message = error;
+		printf("%s: %s\r\n", __func__, error);
+		return false;
+	}
+	return true;
+}
+#endif
+
+void rboot_write_throttle(rboot_write_status *status, uint32_t bytes_per_sec, bool idle_erase) {
+	status->rate = bytes_per_sec;
+	status->idle_erase = idle_erase;
+	status->start_tick = xTaskGetTickCount();
+}
+
+bool rboot_write_idle(rboot_write_status *status) {
+	if (!status->erase_pending) return false;
+	sdk_spi_flash_erase_sector(status->addr / SECTOR_SIZE);
+	status->erase_pending = false;
+	return true;
+}
+
+// sleep for as long as the bytes written so far are ahead of the rate limit
+static void rboot_write_pace(rboot_write_status *status) {
+	uint32_t due = (uint64_t)(status->addr - status->start_addr) * configTICK_RATE_HZ / status->rate;
+	uint32_t elapsed = xTaskGetTickCount() - status->start_tick;
+	if (elapsed < due) {
+		vTaskDelay(due - elapsed);
+	} else {
+		taskYIELD();
+	}
+}
+
+// write out the buffer (padded to whole words if it's the final, partial,
+// sector) then erase the next sector ahead of its data, or leave that
+// for rboot_write_idle
+static void rboot_write_sector(rboot_write_status *status) {
+	uint32_t len = (status->fill + 3) & ~3;
+	memset((uint8_t*)status->buffer + status->fill, 0xff, len - status->fill);
+#if RBOOT_OTA_ECDSA
+	rboot_write_hash(status, (const uint8_t*)status->buffer, status->fill);
+#endif
+	rboot_write_idle(status);
+	sdk_spi_flash_write(status->addr, status->buffer, len);
+
+	status->addr += SECTOR_SIZE;
+	status->fill = 0;
+	if (status->addr < status->limit_addr) {
+		status->erase_pending = true;
+		if (!status->idle_erase) {
+			rboot_write_idle(status);
+		}
+	}
+	if (status->rate) {
+		rboot_write_pace(status);
+	}
+}
+
+uint8_t *rboot_write_space(rboot_write_status *status, uint32_t *space) {
+	*space = SECTOR_SIZE - status->fill;
+	return (uint8_t*)status->buffer + status->fill;
+}
+
+bool rboot_write_commit(rboot_write_status *status, uint32_t len) {
+	if (status->addr + status->fill + len > status->limit_addr) return false;
+	status->fill += len;
+	if (status->fill == SECTOR_SIZE) {
+		rboot_write_sector(status);
+	}
+	return true;
+}
+
+bool rboot_write_flash(rboot_write_status *status, const void *data, uint32_t len) {
+	const uint8_t *src = (const uint8_t*)data;
+	while (len) {
+		uint32_t space;
+		uint8_t *dest = rboot_write_space(status, &space);
+		if (space > len) space = len;
+		memcpy(dest, src, space);
+		if (!rboot_write_commit(status, space)) return false;
+		src += space;
+		len -= space;
+	}
+	return true;
+}
+
+void rboot_write_end(rboot_write_status *status) {
+	if (status->fill) {
+		rboot_write_sector(status);
+	}
+	free(status->buffer);
+	status->buffer = NULL;
+}
+
 // Check that a valid-looking rboot image is found at this offset on the flash, and
 // takes up 'expected_length' bytes.
 bool rboot_verify_image(uint32_t offset, uint32_t expected_length, const char **error_message)
 {
     char *error = NULL;
+    uint32_t *chunk = NULL;
     if(offset % 4) {
         error = "Unaligned flash offset";
         goto fail;
     }
 
+    chunk = malloc(VERIFY_CHUNK_SIZE);
+    if(!chunk) {
+        error = "Out of memory";
+        goto fail;
+    }
+
     uint32_t end_offset = offset + expected_length;
     image_header_t image_header;
     sdk_spi_flash_read(offset, (uint32_t *)&image_header, sizeof(image_header_t));
@@ -136,13 +347,9 @@ bool rboot_verify_image(uint32_t offset, uint32_t expected_length, const char **
         }
 
         if(!is_new_header) {
-            /* Add individual data of the section to the checksum. */
-            char chunk[16];
-            for(int i = 0; i < header.length; i++) {
-                if(i % sizeof(chunk) == 0)
-                    sdk_spi_flash_read(offset+i, (uint32_t *)chunk, sizeof(chunk));
-                checksum ^= chunk[i % sizeof(chunk)];
-            }
+            /* Add the data of the section to the checksum. (The irom0
+               section ahead of the second header isn't covered by it.) */
+            checksum = checksum_flash(offset, header.length, chunk, checksum);
         }
 
         offset += header.length;
@@ -177,9 +384,10 @@ bool rboot_verify_image(uint32_t offset, uint32_t expected_length, const char **
     /* pad the image length to a 16 byte boundary */
     offset = (offset+15) & ~15;
 
-    uint8_t read_checksum;
-    sdk_spi_flash_read(offset-1, (uint32_t *)&read_checksum, 1); /* not sure if this will work */
-    if(read_checksum != checksum) {
+    /* the checksum is the last byte of the final (aligned) word */
+    uint32_t last_word;
+    sdk_spi_flash_read(offset-4, &last_word, sizeof(last_word));
+    if((last_word >> 24) != checksum) {
         error = "Invalid checksum";
         goto fail;
     }
@@ -190,11 +398,59 @@ bool rboot_verify_image(uint32_t offset, uint32_t expected_length, const char **
     }
 
     RBOOT_DEBUG("rboot_verify_image: verified expected 0x%08lx bytes.\r\n", expected_length);
+    free(chunk);
+    return true;
+
+ fail:
+    free(chunk);
+    if(error_message)
+        *error_message = error;
+    printf("%s: %s\r\n", __func__, error);
+    return false;
+}
+
+#if RBOOT_OTA_SHA256
+// Check the SHA-256 digest of 'length' bytes of flash at 'offset'.
+bool rboot_verify_digest(uint32_t offset, uint32_t length, const uint8_t expected[32], const char **error_message)
+{
+    char *error = NULL;
+    uint8_t digest[32];
+    uint32_t *chunk = malloc(VERIFY_CHUNK_SIZE);
+    if(!chunk) {
+        error = "Out of memory";
+        goto fail;
+    }
+    if(offset % 4) {
+        error = "Unaligned flash offset";
+        goto fail;
+    }
+
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts(&ctx, 0);
+    while(length > 0) {
+        uint32_t n = length < VERIFY_CHUNK_SIZE ? length : VERIFY_CHUNK_SIZE;
+        sdk_spi_flash_read(offset, chunk, (n + 3) & ~3);
+        mbedtls_sha256_update(&ctx, (const unsigned char *)chunk, n);
+        offset += n;
+        length -= n;
+    }
+    mbedtls_sha256_finish(&ctx, digest);
+    mbedtls_sha256_free(&ctx);
+    free(chunk);
+    chunk = NULL;
+
+    if(memcmp(digest, expected, sizeof(digest))) {
+        error = "SHA-256 digest mismatch";
+        goto fail;
+    }
     return true;
 
  fail:
+    free(chunk);
     if(error_message)
         *error_message = error;
     printf("%s: %s\r\n", __func__, error);
     return false;
 }
+#endif
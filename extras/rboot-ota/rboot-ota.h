@@ -52,4 +52,105 @@ uint8_t rboot_get_current_rom();
 bool rboot_set_current_rom(uint8_t rom);
 bool rboot_verify_image(uint32_t offset, uint32_t expected_length, const char **error_message);
 
+/* Set RBOOT_OTA_SHA256 to 1 (and add extras/mbedtls to EXTRA_COMPONENTS)
+ * to also check a SHA-256 digest of the image before switching to it.
+ */
+#ifndef RBOOT_OTA_SHA256
+#define RBOOT_OTA_SHA256 0
+#endif
+
+#if RBOOT_OTA_SHA256
+bool rboot_verify_digest(uint32_t offset, uint32_t length, const uint8_t expected[32], const char **error_message);
+#endif
+
+/* Set RBOOT_OTA_ECDSA to 1 (and add extras/mbedtls to EXTRA_COMPONENTS)
+ * to only accept images signed with an ECDSA P-256 key.
+ *
+ * A signed image is the image followed by a signature over its SHA-256:
+ * r and s, 32 bytes each, big endian. ota_sign.py (in this directory)
+ * makes one with an openssl key:
+ * openssl ecparam -name prime256v1 -genkey -noout -out ota_key.pem
+ * python ota_sign.py ota_key.pem firmware/myprogram.bin myprogram.signed
+ * and prints the public key to pass to rboot_set_signing_key() with:
+ * python ota_sign.py --pubkey ota_key.pem
+ *
+ * The image writer below hashes the image as it's written, so once the
+ * last sector is out only the signature check is left, there's no
+ * second pass over the flash. A signed image can still be compressed or
+ * made into a delta (of the signed file) for ota-tftp.
+ */
+#ifndef RBOOT_OTA_ECDSA
+#define RBOOT_OTA_ECDSA 0
+#endif
+
+#define RBOOT_OTA_SIG_LEN 64
+
+#if RBOOT_OTA_ECDSA
+#include <mbedtls/sha256.h>
+
+/* The public key images must be signed with, as an uncompressed P-256
+   point (0x04, X, Y). Only the pointer is kept. */
+void rboot_set_signing_key(const uint8_t key[65]);
+#endif
+
+/* Buffered image writer
+ *
+ * Collects image data in a word aligned sector buffer and writes it to
+ * flash one whole sector at a time. Each sector is erased as soon as the
+ * previous one has been written, so the erase overlaps with receiving
+ * the data that will go into it.
+ *
+ * For updates running in the background of time critical tasks, the
+ * writer can be throttled with rboot_write_throttle(). A flash erase
+ * stalls the whole CPU for tens of ms, so with idle_erase the erase is
+ * held back until the caller knows it will be waiting anyway (calling
+ * rboot_write_idle(), say after acknowledging a block) or, failing that,
+ * until the sector is written. A rate limit sleeps the writing task
+ * after each sector for as long as it's ahead of bytes_per_sec, which
+ * is also the point where other tasks get to run.
+ */
+typedef struct {
+	uint32_t start_addr;  // flash offset the image starts at
+	uint32_t addr;        // flash offset of the buffered sector
+	uint32_t limit_addr;  // first flash offset past the space for the image
+	uint32_t *buffer;     // SECTOR_SIZE bytes
+	uint32_t fill;        // bytes in buffer
+	bool erase_pending;   // the sector at addr isn't erased yet
+	bool idle_erase;      // see rboot_write_throttle
+	uint32_t rate;        // bytes per second, 0 for no limit
+	uint32_t start_tick;  // when the rate limit was set
+#if RBOOT_OTA_ECDSA
+	mbedtls_sha256_context sha;       // of everything written but 'hold'
+	uint8_t hold[RBOOT_OTA_SIG_LEN];  // the last bytes written, the signature at the end
+	uint8_t hold_len;
+#endif
+} rboot_write_status;
+
+// erase the first sector and allocate the buffer, false if out of memory
+bool rboot_write_init(rboot_write_status *status, uint32_t start_addr, uint32_t max_len);
+// free space in the buffer, for filling in place before rboot_write_commit
+uint8_t *rboot_write_space(rboot_write_status *status, uint32_t *space);
+// account for 'len' bytes placed at rboot_write_space, false if past max_len
+bool rboot_write_commit(rboot_write_status *status, uint32_t len);
+// copy data into the image, false if past max_len
+bool rboot_write_flash(rboot_write_status *status, const void *data, uint32_t len);
+// limit the average write rate to bytes_per_sec (0 for no limit), and
+// with idle_erase, defer each erase until rboot_write_idle or the write.
+// Call straight after rboot_write_init, the rate is counted from here.
+void rboot_write_throttle(rboot_write_status *status, uint32_t bytes_per_sec, bool idle_erase);
+// do a deferred erase now, true if there was one
+bool rboot_write_idle(rboot_write_status *status);
+// write out any partial sector (padded to a word) and free the buffer
+void rboot_write_end(rboot_write_status *status);
+// bytes written to the image so far
+static inline uint32_t rboot_write_len(const rboot_write_status *status) {
+	return status->addr - status->start_addr + status->fill;
+}
+#if RBOOT_OTA_ECDSA
+// after rboot_write_end, check the signature at the end of the 'len' bytes
+// written, false if it's missing or wrong. The image itself is the
+// first len - RBOOT_OTA_SIG_LEN bytes.
+bool rboot_write_verify_signature(rboot_write_status *status, uint32_t len, const char **error_message);
+#endif
+
 #endif
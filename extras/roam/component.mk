@@ -0,0 +1,9 @@
+# Component makefile for extras/roam
+
+# expected anyone using roam includes it as 'roam/roam.h'
+INC_DIRS += $(roam_ROOT)..
+
+# args for passing into compile rule generation
+roam_SRC_DIR =  $(roam_ROOT)
+
+$(eval $(call component_compile_rules,roam))
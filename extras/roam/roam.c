@@ -0,0 +1,388 @@
+/* Background roaming between the APs of a network, see roam.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "roam.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+
+#include <lwip/stats.h>
+
+#include "espressif/esp_common.h"
+
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t channel;        /* 0 for an unused slot */
+    int8_t rssi;
+    portTickType seen;
+} candidate_t;
+
+static struct sdk_station_config config;
+static xTaskHandle roam_task_handle;
+static volatile bool running;
+static xSemaphoreHandle scan_done;
+
+/* Candidates and status are updated by the scan callback and the task,
+   and read by anyone, in critical sections */
+static candidate_t candidates[ROAM_CANDIDATES];
+static roam_status_t status;
+
+/* The scan in progress */
+static uint8_t scan_channel;
+static bool scan_is_current;
+
+static uint32_t ms_since(portTickType tick)
+{
+    return (xTaskGetTickCount() - tick) * portTICK_RATE_MS;
+}
+
+/* Frames in or out and failures so far, from lwIP's stats */
+static uint32_t link_packets(void)
+{
+#if LWIP_STATS && LINK_STATS
+    return lwip_stats.link.xmit + lwip_stats.link.recv;
+#else
+    return 0;
+#endif
+}
+
+static uint32_t link_failures(void)
+{
+    uint32_t n = 0;
+#if LWIP_STATS && LINK_STATS
+    n += lwip_stats.link.err;
+#endif
+#if LWIP_STATS && TCP_STATS
+    n += lwip_stats.tcp.rexmit;
+#endif
+    return n;
+}
+
+static void note_candidate(const struct sdk_bss_info *bss)
+{
+    int slot = -1;
+
+    for (int i = 0; i < ROAM_CANDIDATES; i++) {
+        if (candidates[i].channel && !memcmp(candidates[i].bssid, bss->bssid, 6)) {
+            slot = i;
+            break;
+        }
+        /* otherwise an unused slot, or the one seen longest ago */
+        if (slot < 0 || !candidates[i].channel
+            || (candidates[slot].channel && candidates[i].seen - candidates[slot].seen > 0x80000000))
+            slot = i;
+    }
+    memcpy(candidates[slot].bssid, bss->bssid, 6);
+    candidates[slot].channel = bss->channel;
+    candidates[slot].rssi = bss->rssi;
+    candidates[slot].seen = xTaskGetTickCount();
+}
+
+static void scan_cb(void *arg, sdk_scan_status_t scan_status)
+{
+    const struct sdk_bss_info *bss, *strongest = NULL;
+
+    if (scan_status == SCAN_OK) {
+        taskENTER_CRITICAL();
+        for (bss = arg; bss; bss = STAILQ_NEXT(bss, next)) {
+            if (memcmp(bss->ssid, config.ssid, sizeof(bss->ssid)))
+                continue;
+            note_candidate(bss);
+            if (status.known && !memcmp(bss->bssid, status.bssid, 6))
+                status.rssi = bss->rssi;
+            if (bss->channel == scan_channel && (!strongest || bss->rssi > strongest->rssi))
+                strongest = bss;
+        }
+        /* Not pinned yet: on its channel, the strongest BSSID of the
+           network is taken to be the one the SDK picked */
+        if (scan_is_current && !status.known && strongest) {
+            memcpy(status.bssid, strongest->bssid, 6);
+            status.channel = strongest->channel;
+            status.rssi = strongest->rssi;
+            status.known = true;
+        }
+        taskEXIT_CRITICAL();
+    }
+    xSemaphoreGive(scan_done);
+}
+
+/* Scan one channel, or all of them for 0 */
+static bool scan(uint8_t channel)
+{
+    struct sdk_scan_config cfg = {
+        .ssid = config.ssid,
+        .channel = channel,
+    };
+
+    scan_channel = channel;
+    scan_is_current = channel && channel == sdk_wifi_get_channel();
+    xSemaphoreTake(scan_done, 0);
+    if (!sdk_wifi_station_scan(&cfg, scan_cb))
+        return false;
+    xSemaphoreTake(scan_done, portMAX_DELAY);
+    if (channel)
+        status.scans++;
+    else
+        status.sweeps++;
+    return true;
+}
+
+/* The best candidate to roam to, at least ROAM_HYSTERESIS_DB better than
+   the current AP */
+static bool pick(candidate_t *best)
+{
+    bool found = false;
+
+    taskENTER_CRITICAL();
+    for (int i = 0; i < ROAM_CANDIDATES; i++) {
+        const candidate_t *c = &candidates[i];
+        if (!c->channel || ms_since(c->seen) > ROAM_CANDIDATE_AGE_MS
+            || (status.known && !memcmp(c->bssid, status.bssid, 6))
+            || c->rssi < status.rssi + ROAM_HYSTERESIS_DB
+            || (found && c->rssi <= best->rssi))
+            continue;
+        *best = *c;
+        found = true;
+    }
+    taskEXIT_CRITICAL();
+    return found;
+}
+
+static bool wait_got_ip(uint32_t timeout_ms)
+{
+    portTickType start = xTaskGetTickCount();
+
+    for (;;) {
+        switch (sdk_wifi_station_get_connect_status()) {
+        case STATION_GOT_IP:
+            return true;
+        case STATION_WRONG_PASSWORD:
+        case STATION_NO_AP_FOUND:
+        case STATION_CONNECT_FAIL:
+            return false;
+        default:
+            break;
+        }
+        if (ms_since(start) >= timeout_ms)
+            return false;
+        vTaskDelay(10 / portTICK_RATE_MS);
+    }
+}
+
+/* Directed connect to one BSSID on its channel */
+static bool associate(const uint8_t bssid[6], uint8_t channel)
+{
+    sdk_wifi_station_disconnect();
+    config.bssid_set = 1;
+    memcpy(config.bssid, bssid, sizeof(config.bssid));
+    sdk_wifi_station_set_config(&config);
+    sdk_wifi_set_channel(channel);
+    sdk_wifi_station_connect();
+    return wait_got_ip(ROAM_CONNECT_TIMEOUT_MS);
+}
+
+/* Unpinned, any AP of the network */
+static void connect_any(void)
+{
+    sdk_wifi_station_disconnect();
+    config.bssid_set = 0;
+    sdk_wifi_station_set_config(&config);
+    sdk_wifi_station_dhcpc_start();
+    sdk_wifi_station_connect();
+    taskENTER_CRITICAL();
+    status.known = false;
+    taskEXIT_CRITICAL();
+}
+
+static void set_current(const uint8_t bssid[6], uint8_t channel, int8_t rssi)
+{
+    taskENTER_CRITICAL();
+    memcpy(status.bssid, bssid, 6);
+    status.channel = channel;
+    status.rssi = rssi;
+    status.known = true;
+    taskEXIT_CRITICAL();
+}
+
+static void transition(const candidate_t *to)
+{
+    struct ip_info info;
+    uint8_t old_bssid[6];
+    uint8_t old_channel = status.channel;
+    int8_t old_rssi = status.rssi;
+    bool had_old = status.known;
+
+    if (!sdk_wifi_get_ip_info(STATION_IF, &info))
+        return;
+    memcpy(old_bssid, status.bssid, 6);
+    printf("roam: %02x:%02x:%02x:%02x:%02x:%02x on %d (%d dBm) -> %02x:%02x:%02x:%02x:%02x:%02x on %d (%d dBm)\n",
+           old_bssid[0], old_bssid[1], old_bssid[2], old_bssid[3], old_bssid[4], old_bssid[5],
+           old_channel, old_rssi,
+           to->bssid[0], to->bssid[1], to->bssid[2], to->bssid[3], to->bssid[4], to->bssid[5],
+           to->channel, to->rssi);
+
+    /* Keep the address through the reassociation */
+    sdk_wifi_station_dhcpc_stop();
+    sdk_wifi_set_ip_info(STATION_IF, &info);
+
+    if (associate(to->bssid, to->channel)) {
+        set_current(to->bssid, to->channel, to->rssi);
+        status.roams++;
+    } else {
+        status.failed_roams++;
+        if (had_old && associate(old_bssid, old_channel)) {
+            set_current(old_bssid, old_channel, old_rssi);
+        } else {
+            connect_any();
+            return;
+        }
+    }
+    sdk_wifi_station_dhcpc_start();
+}
+
+static void roam_task(void *pvParameters)
+{
+    uint32_t last_packets = link_packets();
+    uint32_t last_failures = link_failures();
+    portTickType last_scan = 0, last_sweep = 0, last_roam = 0, lost_since = 0;
+    bool scanned = false, swept = false, roamed = false, lost = false;
+    uint8_t other_channel = 0;
+
+    while (running) {
+        bool kicked = ulTaskNotifyTake(pdTRUE, ROAM_CHECK_MS / portTICK_RATE_MS) != 0;
+        if (!running)
+            break;
+
+        uint32_t packets = link_packets(), failures = link_failures();
+        uint32_t traffic = packets - last_packets;
+        uint32_t fails = failures - last_failures;
+        last_packets = packets;
+        last_failures = failures;
+        status.tx_failures = fails;
+
+        if (sdk_wifi_station_get_connect_status() != STATION_GOT_IP) {
+            if (!lost) {
+                lost = true;
+                lost_since = xTaskGetTickCount();
+            } else if (config.bssid_set && ms_since(lost_since) >= ROAM_LOST_MS) {
+                printf("roam: lost the AP, connecting to any\n");
+                connect_any();
+            }
+            continue;
+        }
+        lost = false;
+
+        /* Background scans: the current channel, then another in turn */
+        bool idle = traffic < ROAM_IDLE_PACKETS;
+        if (kicked || !status.known || (idle && (!scanned || ms_since(last_scan) >= ROAM_SCAN_MS))) {
+            uint8_t channel = sdk_wifi_get_channel();
+            scan(channel);
+            if (++other_channel == channel)
+                other_channel++;
+            if (other_channel > ROAM_MAX_CHANNEL)
+                other_channel = channel == 1 ? 2 : 1;
+            if (idle)
+                scan(other_channel);
+            last_scan = xTaskGetTickCount();
+            scanned = true;
+        }
+
+        bool weak = status.known && status.rssi < ROAM_RSSI_THRESHOLD;
+        if (!weak && fails < ROAM_TX_FAIL_THRESHOLD)
+            continue;
+        if (roamed && ms_since(last_roam) < ROAM_HOLDOFF_MS)
+            continue;
+
+        candidate_t best;
+        bool found = pick(&best);
+        if (!found && (!swept || ms_since(last_sweep) >= ROAM_SWEEP_MS)) {
+            scan(0);
+            last_sweep = xTaskGetTickCount();
+            swept = true;
+            found = pick(&best);
+        }
+        if (!found)
+            continue;
+        transition(&best);
+        last_roam = xTaskGetTickCount();
+        roamed = true;
+    }
+    roam_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+bool roam_start(void)
+{
+    if (running)
+        return true;
+    if (!scan_done) {
+        vSemaphoreCreateBinary(scan_done);
+        if (!scan_done)
+            return false;
+    }
+    sdk_wifi_station_get_config(&config);
+    memset(candidates, 0, sizeof(candidates));
+    memset(&status, 0, sizeof(status));
+    if (config.bssid_set)
+        set_current(config.bssid, sdk_wifi_get_channel(), 0);
+
+    running = true;
+    if (xTaskCreate(roam_task, (signed char *)"roam", 384, NULL, 2, &roam_task_handle) != pdPASS) {
+        running = false;
+        return false;
+    }
+    return true;
+}
+
+void roam_stop(void)
+{
+    running = false;
+    if (roam_task_handle)
+        xTaskNotifyGive(roam_task_handle);
+}
+
+void roam_kick(void)
+{
+    if (roam_task_handle)
+        xTaskNotifyGive(roam_task_handle);
+}
+
+void roam_get_status(roam_status_t *s)
+{
+    taskENTER_CRITICAL();
+    *s = status;
+    taskEXIT_CRITICAL();
+}
+
+int roam_get_candidates(roam_candidate_t *out, int max)
+{
+    int n = 0;
+
+    taskENTER_CRITICAL();
+    for (int i = 0; i < ROAM_CANDIDATES; i++) {
+        const candidate_t *c = &candidates[i];
+        if (!c->channel)
+            continue;
+        /* insertion sort, strongest first */
+        int j = n < max ? n++ : max;
+        for (; j > 0 && out[j - 1].rssi < c->rssi; j--) {
+            if (j < max)
+                out[j] = out[j - 1];
+        }
+        if (j < max) {
+            memcpy(out[j].bssid, c->bssid, 6);
+            out[j].channel = c->channel;
+            out[j].rssi = c->rssi;
+            out[j].age_ms = ms_since(c->seen);
+        }
+    }
+    taskEXIT_CRITICAL();
+    return n;
+}
@@ -0,0 +1,145 @@
+/* Background roaming between the APs of a network
+ *
+ * The SDK stays with the AP it associated with until the link is lost
+ * altogether, however far away it is and however many better APs of
+ * the same network are closer. The roaming manager watches the link
+ * and moves the station to a better AP (BSSID) while it still works.
+ *
+ * Every ROAM_CHECK_MS it looks at the link's traffic and failures
+ * (lwIP's link errors and TCP retransmissions, from the stats). When
+ * the link is idle (fewer than ROAM_IDLE_PACKETS frames since the last
+ * check) and a background scan is due, it scans the current channel,
+ * which measures the current AP's RSSI, and then one other channel in
+ * turn. Each scan of a single channel is around 100 ms off the air.
+ * The network's BSSIDs it finds are kept as candidates, with their
+ * channel, RSSI and when they were seen.
+ *
+ * A roam is triggered when the current AP's RSSI falls below
+ * ROAM_RSSI_THRESHOLD, or ROAM_TX_FAIL_THRESHOLD failures happen
+ * between two checks. The target is the strongest candidate seen in
+ * the last ROAM_CANDIDATE_AGE_MS that's at least ROAM_HYSTERESIS_DB
+ * stronger than the current AP; if there's none, an all channel scan
+ * (at most every ROAM_SWEEP_MS) looks for one. Roams are at least
+ * ROAM_HOLDOFF_MS apart, so a station between two APs doesn't flap.
+ *
+ * The transition is a directed connect (BSSID and channel known, no
+ * scan) that keeps the station's address: the DHCP client is stopped
+ * and the address set statically for the reassociation, and restarted
+ * once it's done, so open TCP connections survive the roam. If the
+ * new AP doesn't take the station within ROAM_CONNECT_TIMEOUT_MS it
+ * goes back to the old one. (The SDK has no 802.11r fast transition,
+ * so the reassociation is a full one, usually 100-300 ms.)
+ *
+ * The manager pins the station to the BSSID it picks. If the link is
+ * lost for ROAM_LOST_MS anyway it unpins it and lets the SDK connect
+ * normally, to any AP of the network.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _ROAM_H
+#define _ROAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifndef ROAM_CHECK_MS
+#define ROAM_CHECK_MS 5000
+#endif
+
+/* Background scans, when idle, at most this often */
+#ifndef ROAM_SCAN_MS
+#define ROAM_SCAN_MS 30000
+#endif
+
+#ifndef ROAM_IDLE_PACKETS
+#define ROAM_IDLE_PACKETS 20
+#endif
+
+#ifndef ROAM_RSSI_THRESHOLD
+#define ROAM_RSSI_THRESHOLD -72
+#endif
+
+#ifndef ROAM_TX_FAIL_THRESHOLD
+#define ROAM_TX_FAIL_THRESHOLD 10
+#endif
+
+#ifndef ROAM_HYSTERESIS_DB
+#define ROAM_HYSTERESIS_DB 8
+#endif
+
+#ifndef ROAM_CANDIDATE_AGE_MS
+#define ROAM_CANDIDATE_AGE_MS 120000
+#endif
+
+#ifndef ROAM_SWEEP_MS
+#define ROAM_SWEEP_MS 60000
+#endif
+
+#ifndef ROAM_HOLDOFF_MS
+#define ROAM_HOLDOFF_MS 20000
+#endif
+
+#ifndef ROAM_CONNECT_TIMEOUT_MS
+#define ROAM_CONNECT_TIMEOUT_MS 2000
+#endif
+
+#ifndef ROAM_LOST_MS
+#define ROAM_LOST_MS 10000
+#endif
+
+/* BSSIDs kept as candidates */
+#ifndef ROAM_CANDIDATES
+#define ROAM_CANDIDATES 8
+#endif
+
+/* Highest channel scanned in the background */
+#ifndef ROAM_MAX_CHANNEL
+#define ROAM_MAX_CHANNEL 13
+#endif
+
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t channel;
+    int8_t rssi;                /* dBm, when last seen */
+    uint32_t age_ms;            /* since last seen */
+} roam_candidate_t;
+
+typedef struct {
+    bool known;                 /* the current AP's BSSID is known */
+    uint8_t bssid[6];
+    uint8_t channel;
+    int8_t rssi;                /* at the last scan of its channel */
+    uint32_t roams;             /* transitions made */
+    uint32_t failed_roams;      /* transitions that went back */
+    uint32_t scans;             /* single channel scans */
+    uint32_t sweeps;            /* all channel scans */
+    uint32_t tx_failures;       /* in the last check interval */
+} roam_status_t;
+
+/* Start managing the station's connection, for the network in its
+   current station config. Call once the station is configured. Returns
+   false if the task couldn't be created. */
+bool roam_start(void);
+
+/* Stop roaming (the current AP stays pinned) */
+void roam_stop(void);
+
+/* Ask for a roam check and background scan now, whatever the traffic */
+void roam_kick(void);
+
+void roam_get_status(roam_status_t *status);
+
+/* Copy up to 'max' candidates, strongest first. Returns how many. */
+int roam_get_candidates(roam_candidate_t *candidates, int max);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _ROAM_H */
@@ -0,0 +1,25 @@
+# Component makefile for extras/romfs
+
+# expected anyone using romfs includes it as 'romfs/romfs.h'
+INC_DIRS += $(romfs_ROOT)..
+
+# args for passing into compile rule generation
+romfs_SRC_DIR =  $(romfs_ROOT)
+
+# ROMFS_DIR, if set by the program, is packed into an image linked into
+# IROM as romfs_image. ROMFS_GZIP=1 stores text files gzip compressed.
+ifdef ROMFS_DIR
+ROMFS_IMAGE = $(BUILD_DIR)romfs.bin
+romfs_EXTRA_SRC_FILES = $(romfs_ROOT)image/romfs_image.S
+romfs_CPPFLAGS = $(CPPFLAGS) -DROMFS_IMAGE='"$(ROMFS_IMAGE)"'
+endif
+
+$(eval $(call component_compile_rules,romfs))
+
+ifdef ROMFS_DIR
+$(ROMFS_IMAGE): $(shell find $(ROMFS_DIR) -type f) $(romfs_ROOT)mkromfs.py | $(BUILD_DIR)
+	$(vecho) "ROMFS $@"
+	$(Q) $(PYTHON) $(romfs_ROOT)mkromfs.py $(if $(filter 1,$(ROMFS_GZIP)),--gzip) $(ROMFS_DIR) $@
+
+$(filter %romfs_image.o,$(romfs_OBJ_FILES)): $(ROMFS_IMAGE)
+endif
@@ -0,0 +1,104 @@
+#!/usr/bin/env python
+#
+# Pack a directory tree into a romfs image (see romfs.c for the layout)
+#
+# Usage: python mkromfs.py [--gzip] <directory> romfs.bin
+#
+# Paths in the image are relative to <directory>, with '/' separators.
+# Each file gets a hash of its contents, for HTTP ETags. With --gzip,
+# text files (html, css, js, ...) are stored gzip compressed whenever
+# that makes them smaller, flagged ROMFS_GZIP, for a web server to send
+# as they are with "Content-Encoding: gzip".
+#
+# Also run by extras/romfs/component.mk for programs that set ROMFS_DIR.
+#
+# Part of esp-open-rtos
+# BSD Licensed as described in the file LICENSE
+import gzip
+import hashlib
+import io
+import os
+import struct
+import sys
+
+MAGIC = 0x32534652  # "RFS2"
+HEADER = 12
+ENTRY = 20
+
+ROMFS_GZIP = 1
+
+# Extensions worth compressing, others (images, already compressed) aren't
+GZIP_EXTS = ('html', 'htm', 'css', 'js', 'json', 'txt', 'svg', 'xml', 'csv', 'ico', 'map')
+
+def align4(n):
+    return (n + 3) & ~3
+
+def compress(data):
+    # mtime=0 and no file name keep the image reproducible
+    buf = io.BytesIO()
+    with gzip.GzipFile(filename='', mode='wb', fileobj=buf, compresslevel=9, mtime=0) as f:
+        f.write(data)
+    return buf.getvalue()
+
+def etag(data):
+    # 32 bits of sha1 is plenty to tell versions of one path apart.
+    # 0 means no ETag to the server, so never use it.
+    return struct.unpack('>I', hashlib.sha1(data).digest()[:4])[0] or 1
+
+def collect(root, use_gzip):
+    files = []
+    for dirpath, dirnames, filenames in os.walk(root):
+        dirnames.sort()
+        for name in filenames:
+            full = os.path.join(dirpath, name)
+            path = os.path.relpath(full, root).replace(os.sep, '/')
+            with open(full, 'rb') as f:
+                data = f.read()
+            flags = 0
+            tag = etag(data)
+            if use_gzip and name.rsplit('.', 1)[-1].lower() in GZIP_EXTS:
+                packed = compress(data)
+                if len(packed) < len(data):
+                    data = packed
+                    flags |= ROMFS_GZIP
+            files.append((path.encode('utf-8'), data, flags, tag))
+    # romfs_find() does a binary search with byte-wise strcmp ordering
+    files.sort(key=lambda f: f[0])
+    return files
+
+def pack(files):
+    names_offs = HEADER + ENTRY * len(files)
+    names = b''
+    name_offsets = []
+    for path, data, flags, tag in files:
+        name_offsets.append(names_offs + len(names))
+        names += path + b'\0'
+
+    data_offs = align4(names_offs + len(names))
+    entries = b''
+    blobs = b''
+    for (path, data, flags, tag), name_offs in zip(files, name_offsets):
+        entries += struct.pack('<IIIII', name_offs, data_offs + len(blobs), len(data), flags, tag)
+        blobs += data + b'\xff' * (align4(len(data)) - len(data))
+
+    body = entries + names
+    body += b'\xff' * (data_offs - HEADER - len(body))
+    size = data_offs + len(blobs)
+    return struct.pack('<III', MAGIC, len(files), size) + body + blobs
+
+def main():
+    args = sys.argv[1:]
+    use_gzip = '--gzip' in args
+    if use_gzip:
+        args.remove('--gzip')
+    if len(args) != 2:
+        sys.exit("Usage: %s [--gzip] <directory> romfs.bin" % sys.argv[0])
+    files = collect(args[0], use_gzip)
+    image = pack(files)
+    with open(args[1], 'wb') as f:
+        f.write(image)
+    compressed = sum(1 for f in files if f[2] & ROMFS_GZIP)
+    print("%d files (%d compressed), %d bytes" % (len(files), compressed, len(image)))
+
+if __name__ == '__main__':
+    main()
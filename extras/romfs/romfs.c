@@ -0,0 +1,256 @@
+/* Read-only filesystem image in flash, see romfs.h
+ *
+ * Image layout, all words little endian and offsets from the image start:
+ *
+ *   uint32_t magic;        "RFS2"
+ *   uint32_t count;        number of files
+ *   uint32_t size;         total image size
+ *   struct {
+ *       uint32_t name;     offset of the NUL terminated path
+ *       uint32_t data;     offset of the contents, word aligned
+ *       uint32_t size;
+ *       uint32_t flags;    ROMFS_GZIP
+ *       uint32_t etag;     hash of the uncompressed contents
+ *   } entries[count];      sorted by path
+ *   paths, then file contents
+ *
+ * "RFS1" images, from before the flags and etag words, are read too.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "romfs.h"
+
+#include <esp/flashmap.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/reent.h>
+#include <sys/stat.h>
+#include <sys/errno.h>
+
+#define ROMFS_MAGIC_V1 0x31534652 /* "RFS1" */
+#define ROMFS_MAGIC 0x32534652 /* "RFS2" */
+
+typedef struct {
+    uint32_t name;
+    uint32_t data;
+    uint32_t size;
+    uint32_t flags;     /* not in RFS1 */
+    uint32_t etag;
+} romfs_entry_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t count;
+    uint32_t size;
+    uint32_t entries[];
+} romfs_header_t;
+
+typedef struct {
+    romfs_file_t file;
+    uint32_t pos;
+    bool used;
+} romfs_open_t;
+
+static const volatile romfs_header_t *image;
+static uint32_t entry_words;    /* per directory entry, by version */
+static romfs_open_t open_files[ROMFS_MAX_OPEN];
+
+static bool mount(const volatile romfs_header_t *header)
+{
+    if (header->magic == ROMFS_MAGIC)
+        entry_words = sizeof(romfs_entry_t) / 4;
+    else if (header->magic == ROMFS_MAGIC_V1)
+        entry_words = 3;
+    else
+        return false;
+    image = header;
+    return true;
+}
+
+bool romfs_mount(const void *ptr)
+{
+    if ((uint32_t)ptr & 3)
+        return false;
+    return mount(ptr);
+}
+
+bool romfs_mount_flash(uint32_t flash_addr)
+{
+    const volatile romfs_header_t *header = (const volatile romfs_header_t *)flashmap_ptr(flash_addr, sizeof(romfs_header_t));
+
+    if (!header || !flashmap_ptr(flash_addr, header->size))
+        return false;
+    return mount(header);
+}
+
+static const volatile romfs_entry_t *entry(uint32_t i)
+{
+    return (const volatile romfs_entry_t *)&image->entries[i * entry_words];
+}
+
+/* strcmp() of a RAM string against a path in the image */
+static int path_cmp(const char *path, uint32_t name_offs)
+{
+    const uint8_t *name = (const uint8_t *)image + name_offs;
+
+    for (;; path++, name++) {
+        uint8_t c = flashmap_read8(name);
+        if ((uint8_t)*path != c)
+            return (uint8_t)*path - c;
+        if (!c)
+            return 0;
+    }
+}
+
+bool romfs_find(const char *path, romfs_file_t *file)
+{
+    if (!image)
+        return false;
+    while (*path == '/')
+        path++;
+
+    /* binary search of the sorted directory */
+    uint32_t lo = 0, hi = image->count;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        const volatile romfs_entry_t *e = entry(mid);
+        int cmp = path_cmp(path, e->name);
+        if (!cmp) {
+            file->data = (const uint8_t *)image + e->data;
+            file->size = e->size;
+            if (entry_words == 3) {
+                file->flags = 0;
+                file->etag = 0;
+            } else {
+                file->flags = e->flags;
+                file->etag = e->etag;
+            }
+            return true;
+        }
+        if (cmp < 0)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return false;
+}
+
+size_t romfs_read(const romfs_file_t *file, uint32_t offset, void *buf, size_t len)
+{
+    if (offset >= file->size)
+        return 0;
+    if (len > file->size - offset)
+        len = file->size - offset;
+    flashmap_memcpy(buf, (const uint8_t *)file->data + offset, len);
+    return len;
+}
+
+/* newlib syscalls, replacing the ENOSYS stubs in core/newlib_syscalls.c */
+
+static romfs_open_t *get_open(struct _reent *r, int fd)
+{
+    int i = fd - ROMFS_FD_BASE;
+
+    if (i < 0 || i >= ROMFS_MAX_OPEN || !open_files[i].used) {
+        r->_errno = EBADF;
+        return NULL;
+    }
+    return &open_files[i];
+}
+
+int _open_r(struct _reent *r, const char *pathname, int flags, int mode)
+{
+    romfs_file_t file;
+
+    if ((flags & O_ACCMODE) != O_RDONLY) {
+        r->_errno = EROFS;
+        return -1;
+    }
+    if (!romfs_find(pathname, &file)) {
+        r->_errno = ENOENT;
+        return -1;
+    }
+
+    portSCHEDULER_LOCK();
+    for (int i = 0; i < ROMFS_MAX_OPEN; i++) {
+        if (!open_files[i].used) {
+            open_files[i].used = true;
+            portSCHEDULER_UNLOCK();
+            open_files[i].file = file;
+            open_files[i].pos = 0;
+            return ROMFS_FD_BASE + i;
+        }
+    }
+    portSCHEDULER_UNLOCK();
+    r->_errno = ENFILE;
+    return -1;
+}
+
+long _read_file_r(struct _reent *r, int fd, char *ptr, int len)
+{
+    romfs_open_t *f = get_open(r, fd);
+
+    if (!f)
+        return -1;
+    size_t n = romfs_read(&f->file, f->pos, ptr, len);
+    f->pos += n;
+    return n;
+}
+
+off_t _lseek_r(struct _reent *r, int fd, off_t offset, int whence)
+{
+    romfs_open_t *f = get_open(r, fd);
+    off_t pos;
+
+    if (!f)
+        return -1;
+    switch (whence) {
+    case SEEK_SET:
+        pos = offset;
+        break;
+    case SEEK_CUR:
+        pos = f->pos + offset;
+        break;
+    case SEEK_END:
+        pos = f->file.size + offset;
+        break;
+    default:
+        pos = -1;
+    }
+    if (pos < 0) {
+        r->_errno = EINVAL;
+        return -1;
+    }
+    f->pos = pos;
+    return pos;
+}
+
+int _fstat_r(struct _reent *r, int fd, struct stat *st)
+{
+    romfs_open_t *f = get_open(r, fd);
+
+    if (!f) {
+        /* stdio descriptors, as the core stub */
+        r->_errno = ENOSYS;
+        return -1;
+    }
+    memset(st, 0, sizeof(*st));
+    st->st_mode = S_IFREG | 0444;
+    st->st_size = f->file.size;
+    return 0;
+}
+
+int _close_r(struct _reent *r, int fd)
+{
+    romfs_open_t *f = get_open(r, fd);
+
+    if (!f)
+        return -1;
+    f->used = false;
+    return 0;
+}
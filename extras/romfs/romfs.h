@@ -0,0 +1,83 @@
+/* Read-only filesystem image in flash, for web assets and the like
+ *
+ * The image is a packed, immutable set of files with a sorted
+ * directory, built on the host with mkromfs.py:
+ *
+ *     extras/romfs/mkromfs.py [--gzip] <directory> romfs.bin
+ *
+ * It's read in place through the flash cache window (esp/flashmap.h),
+ * so file data never needs copying into DRAM first. It can either be
+ * linked into the firmware's IROM, or written anywhere in the mapped
+ * megabyte of flash with esptool.py.
+ *
+ * To link one in, set ROMFS_DIR to the directory to pack in the
+ * program's Makefile, before including common.mk. The image is rebuilt
+ * whenever a file in it changes, and mounted with
+ * romfs_mount(romfs_image), see examples/romfs_files. ROMFS_GZIP=1
+ * passes --gzip, for web assets: text files are stored compressed
+ * (flagged ROMFS_GZIP) where that makes them smaller. Every file also
+ * has a hash of its contents, which makes an HTTP ETag, see
+ * examples/httpd_dashboard.
+ *
+ * Once mounted, files can be opened with fopen()/open() (read only),
+ * or looked up with romfs_find() to get a pointer straight to their
+ * contents: the fast path for sending a whole file. Data in the cache
+ * window only supports aligned 32-bit loads; use the flashmap_*
+ * accessors, or romfs_read(), for anything else.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _ROMFS_H
+#define _ROMFS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/* Number of files that can be open through newlib at once */
+#ifndef ROMFS_MAX_OPEN
+#define ROMFS_MAX_OPEN 4
+#endif
+
+/* First file descriptor used, after stdin/stdout/stderr */
+#define ROMFS_FD_BASE 3
+
+/* File flags */
+#define ROMFS_GZIP 1    /* contents are gzip compressed (mkromfs.py --gzip) */
+
+typedef struct {
+    const void *data;   /* word aligned, in the cache window */
+    uint32_t size;      /* as stored, i.e. compressed if ROMFS_GZIP */
+    uint32_t flags;
+    uint32_t etag;      /* hash of the uncompressed contents, 0 if the image has none */
+} romfs_file_t;
+
+/* The image built from ROMFS_DIR, if the program sets it */
+extern const uint32_t romfs_image[];
+
+/* Mount an image that's already addressable (e.g. linked into IROM).
+   Returns false if it doesn't look like a romfs image. */
+bool romfs_mount(const void *image);
+
+/* Mount an image stored at a flash address in the mapped megabyte */
+bool romfs_mount_flash(uint32_t flash_addr);
+
+/* Look up a file by path (a leading '/' is optional).
+   Returns false if not found. Files read with open() give their
+   contents as stored, so compressed if flagged ROMFS_GZIP. */
+bool romfs_find(const char *path, romfs_file_t *file);
+
+/* Copy 'len' bytes at 'offset' of a file into 'buf', returns the
+   number of bytes copied (less than 'len' at the end of the file) */
+size_t romfs_read(const romfs_file_t *file, uint32_t offset, void *buf, size_t len);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _ROMFS_H */
@@ -0,0 +1,9 @@
+# Component makefile for extras/samplebatch
+
+# expected anyone using samplebatch includes it as 'samplebatch/samplebatch.h'
+INC_DIRS += $(samplebatch_ROOT)..
+
+# args for passing into compile rule generation
+samplebatch_SRC_DIR =  $(samplebatch_ROOT)
+
+$(eval $(call component_compile_rules,samplebatch))
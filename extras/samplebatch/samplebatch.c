@@ -0,0 +1,129 @@
+/* Sensor sample batching, see samplebatch.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "samplebatch.h"
+
+#include <string.h>
+#include <crc.h>
+
+#include "esp/rtcmem_regs.h"
+
+#define VERSION 1
+#define RTC_MAGIC 0x31425353  /* "SSB1" */
+
+/* RTC image: magic, CRC32 of the rest, then the batch up to the end of
+   its data */
+#define RTC_HEADER_WORDS 2
+#define USED_LEN(sb) (offsetof(samplebatch_t, data) + (sb)->len)
+
+void samplebatch_init(samplebatch_t *sb, uint16_t max_count, uint16_t max_len, uint32_t max_age)
+{
+    memset(sb, 0, offsetof(samplebatch_t, data));
+    sb->max_count = max_count;
+    sb->max_len = max_len;
+    sb->max_age = max_age;
+    sb->len = SAMPLEBATCH_HEADER_LEN;
+}
+
+void samplebatch_clear(samplebatch_t *sb)
+{
+    samplebatch_init(sb, sb->max_count, sb->max_len, sb->max_age);
+}
+
+static void put_varint(samplebatch_t *sb, uint64_t v)
+{
+    while (v >= 0x80) {
+        sb->data[sb->len++] = 0x80 | (v & 0x7f);
+        v >>= 7;
+    }
+    sb->data[sb->len++] = v;
+}
+
+bool samplebatch_add(samplebatch_t *sb, uint8_t channel, uint32_t time, int32_t value)
+{
+    if (channel >= SAMPLEBATCH_CHANNELS || sb->len + SAMPLEBATCH_MAX_SAMPLE_LEN > SAMPLEBATCH_SIZE)
+        return false;
+    if (sb->count == UINT16_MAX || (sb->count && time < sb->last_time))
+        return false;
+    if (!sb->count)
+        sb->first_time = sb->last_time = time;
+
+    int64_t delta = (int64_t)value - sb->last[channel];
+    put_varint(sb, ((uint64_t)(time - sb->last_time) << 3) | channel);
+    put_varint(sb, delta < 0 ? ((uint64_t)(-delta) << 1) - 1 : (uint64_t)delta << 1);
+    sb->last[channel] = value;
+    sb->last_time = time;
+    sb->count++;
+    return true;
+}
+
+bool samplebatch_due(const samplebatch_t *sb, uint32_t now)
+{
+    if (!sb->count)
+        return false;
+    return (sb->max_count && sb->count >= sb->max_count)
+        || (sb->max_len && sb->len >= sb->max_len)
+        || (sb->max_age && now - sb->first_time >= sb->max_age)
+        || sb->len + SAMPLEBATCH_MAX_SAMPLE_LEN > SAMPLEBATCH_SIZE
+        || sb->count == UINT16_MAX;
+}
+
+size_t samplebatch_packet(samplebatch_t *sb, const void **data)
+{
+    uint8_t *p = sb->data;
+
+    p[0] = VERSION;
+    p[1] = sb->first_time >> 24;
+    p[2] = sb->first_time >> 16;
+    p[3] = sb->first_time >> 8;
+    p[4] = sb->first_time;
+    p[5] = sb->count >> 8;
+    p[6] = sb->count;
+    *data = p;
+    return sb->count ? sb->len : 0;
+}
+
+/* RTC memory only supports word accesses */
+
+bool samplebatch_save_rtc(const samplebatch_t *sb, unsigned word_offset)
+{
+    size_t words = (USED_LEN(sb) + 3) / 4;
+    const uint32_t *w = (const uint32_t *)sb;
+
+    if (word_offset + RTC_HEADER_WORDS + words > sizeof(RTCMEM_USER) / sizeof(uint32_t))
+        return false;
+    /* samplebatch_t is word aligned, and the bytes past 'len' are
+       included as they are, the CRC covers them too */
+    RTCMEM_USER[word_offset] = RTC_MAGIC;
+    RTCMEM_USER[word_offset + 1] = crc32_ieee(0, sb, words * 4);
+    for (int i = 0; i < words; i++)
+        RTCMEM_USER[word_offset + RTC_HEADER_WORDS + i] = w[i];
+    return true;
+}
+
+bool samplebatch_load_rtc(samplebatch_t *sb, unsigned word_offset)
+{
+    samplebatch_t tmp;
+    uint32_t *w = (uint32_t *)&tmp;
+    size_t max = sizeof(RTCMEM_USER) / sizeof(uint32_t);
+    size_t head = offsetof(samplebatch_t, data) / 4;
+
+    if (word_offset + RTC_HEADER_WORDS + head > max || RTCMEM_USER[word_offset] != RTC_MAGIC)
+        return false;
+    for (int i = 0; i < head; i++)
+        w[i] = RTCMEM_USER[word_offset + RTC_HEADER_WORDS + i];
+    if (tmp.len < SAMPLEBATCH_HEADER_LEN || tmp.len > SAMPLEBATCH_SIZE)
+        return false;
+    size_t words = (USED_LEN(&tmp) + 3) / 4;
+    if (word_offset + RTC_HEADER_WORDS + words > max)
+        return false;
+    for (int i = head; i < words; i++)
+        w[i] = RTCMEM_USER[word_offset + RTC_HEADER_WORDS + i];
+    if (crc32_ieee(0, &tmp, words * 4) != RTCMEM_USER[word_offset + 1])
+        return false;
+    memcpy(sb, &tmp, words * 4);
+    return true;
+}
@@ -0,0 +1,115 @@
+/* Sensor sample batching, delta and varint coded
+ *
+ * A node sending each reading as it's taken wakes the radio (and, after
+ * deep sleep, connects) once per sample, for a packet of a few bytes.
+ * A samplebatch_t instead collects samples, coded on the way in, until
+ * a flush policy says the batch is due, and sends them all as one
+ * packet. It's a fixed size buffer, and can be kept in RTC memory
+ * across deep sleep so only the wake that sends needs the radio.
+ *
+ *   samplebatch_init(&batch, 30, 0, 600);     // every 30 samples or 10 min
+ *   ...
+ *   samplebatch_add(&batch, 0, now, temperature_tenths);
+ *   if (samplebatch_due(&batch, now)) {
+ *       len = samplebatch_packet(&batch, &data);
+ *       // send data, len
+ *       samplebatch_clear(&batch);
+ *   }
+ *
+ * A sample is a channel (0 to SAMPLEBATCH_CHANNELS - 1), a time and a
+ * 32 bit integer value (fixed point, for readings with a fraction). Time
+ * is in whatever units the application likes (seconds since boot, say,
+ * or an SNTP time), it just mustn't go backwards within a batch.
+ *
+ * Packet format:
+ *
+ *   u8 version (1)
+ *   u32 time of the first sample, big endian
+ *   u16 number of samples, big endian
+ *   for each sample:
+ *     varint  (time since the previous sample << 3) | channel
+ *     varint  zigzag(value - previous value on the same channel)
+ *
+ * Varints are 7 bits a byte, least significant first, with the top bit
+ * set on all but the last byte (as protocol buffers). The previous value
+ * of a channel's first sample is 0, and zigzag maps 0, -1, 1, -2 ... to
+ * 0, 1, 2, 3 ... A reading every minute that barely changes takes two
+ * bytes. samplebatch_decode.py (in this directory) decodes packets, or
+ * listens for them.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _SAMPLEBATCH_H
+#define _SAMPLEBATCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/* Bytes of packet, header included */
+#ifndef SAMPLEBATCH_SIZE
+#define SAMPLEBATCH_SIZE 256
+#endif
+
+#define SAMPLEBATCH_CHANNELS 8
+
+#define SAMPLEBATCH_HEADER_LEN 7
+
+/* Most bytes a sample can take */
+#define SAMPLEBATCH_MAX_SAMPLE_LEN 10
+
+typedef struct {
+    /* flush policy, 0 for no limit */
+    uint16_t max_count;
+    uint16_t max_len;
+    uint32_t max_age;
+    /* state */
+    uint16_t count;
+    uint16_t len;
+    uint32_t first_time;
+    uint32_t last_time;
+    int32_t last[SAMPLEBATCH_CHANNELS];
+    uint8_t data[SAMPLEBATCH_SIZE];
+} samplebatch_t;
+
+/* Words of RTCMEM_USER samplebatch_save_rtc() takes */
+#define SAMPLEBATCH_RTC_WORDS ((sizeof(samplebatch_t) + 3) / 4 + 2)
+
+/* An empty batch, due once it has 'max_count' samples, is 'max_len'
+   bytes long, or its first sample is 'max_age' old. It's always due
+   when another sample mightn't fit. */
+void samplebatch_init(samplebatch_t *sb, uint16_t max_count, uint16_t max_len, uint32_t max_age);
+
+/* Add a sample. Returns false if it doesn't fit (the batch should have
+   been sent), the channel is out of range, or 'time' is before the
+   last sample's. */
+bool samplebatch_add(samplebatch_t *sb, uint8_t channel, uint32_t time, int32_t value);
+
+/* True if the flush policy says to send the batch, at time 'now' */
+bool samplebatch_due(const samplebatch_t *sb, uint32_t now);
+
+/* The packet, with its header filled in. Returns its length, 0 if
+   there are no samples. */
+size_t samplebatch_packet(samplebatch_t *sb, const void **data);
+
+/* Empty the batch once it's sent, keeping the flush policy */
+void samplebatch_clear(samplebatch_t *sb);
+
+/* Keep the batch in RTCMEM_USER starting 'word_offset' words in, taking
+   SAMPLEBATCH_RTC_WORDS words. It survives deep sleep and resets, but
+   not power loss; load returns false (and leaves the batch alone) if
+   there's no valid batch there. */
+bool samplebatch_save_rtc(const samplebatch_t *sb, unsigned word_offset);
+bool samplebatch_load_rtc(samplebatch_t *sb, unsigned word_offset);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _SAMPLEBATCH_H */
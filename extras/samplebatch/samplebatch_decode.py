@@ -0,0 +1,81 @@
+#!/usr/bin/env python
+#
+# Decode samplebatch packets (see samplebatch.h)
+#
+# Usage: python samplebatch_decode.py --listen 8005
+#        python samplebatch_decode.py packet.bin ...
+#
+# Prints a line per sample: time, channel and value.
+#
+# Part of esp-open-rtos
+# Copyright (C) 2015 Superhouse Automation Pty Ltd
+# BSD Licensed as described in the file LICENSE
+import argparse
+import socket
+import struct
+import sys
+
+CHANNELS = 8
+
+def varint(data, i):
+    value = shift = 0
+    while True:
+        if i >= len(data):
+            raise ValueError("Packet ends inside a varint")
+        b = data[i]
+        i += 1
+        value |= (b & 0x7f) << shift
+        shift += 7
+        if not b & 0x80:
+            return value, i
+
+def decode(packet):
+    data = bytearray(packet)
+    if len(data) < 7 or data[0] != 1:
+        raise ValueError("Not a version 1 samplebatch packet")
+    time, count = struct.unpack(">IH", bytes(data[1:7]))
+    last = [0] * CHANNELS
+    i = 7
+    samples = []
+    for _ in range(count):
+        head, i = varint(data, i)
+        zigzag, i = varint(data, i)
+        time += head >> 3
+        channel = head & 7
+        last[channel] += (zigzag >> 1) ^ -(zigzag & 1)
+        samples.append((time, channel, last[channel]))
+    if i != len(data):
+        raise ValueError("%d bytes left after %d samples" % (len(data) - i, count))
+    return samples
+
+def show(packet, source):
+    try:
+        samples = decode(packet)
+    except ValueError as e:
+        print("%s: %s" % (source, e))
+        return
+    print("%s: %d samples in %d bytes" % (source, len(samples), len(packet)))
+    for time, channel, value in samples:
+        print("%10d %d %d" % (time, channel, value))
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode samplebatch packets")
+    parser.add_argument("--listen", type=int, metavar="PORT", help="receive packets on this UDP port")
+    parser.add_argument("files", nargs="*")
+    args = parser.parse_args()
+
+    if args.listen:
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        sock.bind(("", args.listen))
+        while True:
+            packet, addr = sock.recvfrom(2048)
+            show(packet, addr[0])
+            sys.stdout.flush()
+    for name in args.files:
+        show(open(name, "rb").read(), name)
+    if not args.listen and not args.files:
+        parser.print_usage()
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,9 @@
+# Component makefile for extras/sdio_slave
+
+# expected anyone using sdio_slave includes it as 'sdio_slave/sdio_slave.h'
+INC_DIRS += $(sdio_slave_ROOT)..
+
+# args for passing into compile rule generation
+sdio_slave_SRC_DIR =  $(sdio_slave_ROOT)
+
+$(eval $(call component_compile_rules,sdio_slave))
@@ -0,0 +1,317 @@
+/* SDIO slave link to a host on the SLC, see sdio_slave.h
+ *
+ * The SLC's names are from its side: its TX link takes what the host
+ * writes into RAM, its RX link sends RAM to the host. Here rx and tx
+ * are from ours, so rx is the TX link and tx the RX link.
+ *
+ * Receive descriptors rx_desc[] each own the pbuf rx_pbufs[] at the
+ * same index, with the pbuf's payload as the DMA buffer. The SLC fills
+ * them in ring order, disowning each as it's written, and the task
+ * takes them in the same order from rx_next: the pbuf goes to the
+ * handler and a fresh one is armed in its place. If there's no pbuf
+ * to be had the slot stays empty (rx_pbufs[] NULL) and the task tries
+ * again shortly; the SLC stops at it and is restarted once it's armed.
+ *
+ * Send buffers tx_buf[] are queued from tx_first, tx_count of them,
+ * each with its descriptor owned by the SLC. A sender takes the slot
+ * after the last, copies the frame in and only then counts it queued,
+ * so the interrupt, which retires frames from tx_first as the host
+ * reads them (by the SLC's EOF descriptor address, as extras/i2s_dma
+ * does), never sees one half written.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "sdio_slave.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include <esp/slc.h>
+#include <esp/interrupts.h>
+#include <common_macros.h>
+
+/* Not in slc_regs.h: the host interrupt line, raised by INTVEC_TO_HOST
+   bit 0 */
+#define SLC_HOST_INT_TO_HOST_BIT0 BIT(0)
+
+/* Retry for pbufs to rearm receive buffers with */
+#define RX_RETRY_MS 20
+
+static struct SLCDescriptor rx_desc[SDIO_SLAVE_RX_BUFS];
+static struct pbuf *rx_pbufs[SDIO_SLAVE_RX_BUFS];
+static size_t rx_next;
+static bool rx_skip;            /* dropping the rest of a frame too long */
+static bool rx_started;
+
+static struct SLCDescriptor tx_desc[SDIO_SLAVE_TX_BUFS];
+static uint8_t *tx_buf;
+static uint16_t tx_len[SDIO_SLAVE_TX_BUFS];
+static volatile size_t tx_first, tx_count;
+static bool tx_started;
+static xSemaphoreHandle tx_lock;
+
+static sdio_slave_handler_t handler;
+static xTaskHandle task;
+static sdio_slave_stats_t stats;
+
+static inline uint32_t set_link_addr(uint32_t link, const struct SLCDescriptor *desc)
+{
+    return SET_FIELD(link, SLC_RX_LINK_DESCRIPTOR_ADDR, (uint32_t)desc & SLC_RX_LINK_DESCRIPTOR_ADDR_M);
+}
+
+/* Tell the host about the frame at tx_first, if there is one. In the
+   interrupt, or with it masked. */
+static void IRAM host_status(void)
+{
+    uint32_t len = tx_count ? tx_len[tx_first] : 0;
+
+    SLC.HOST_CONF_W2 = len;
+    if (len) {
+        SLC.INTVEC_TO_HOST = VAL2FIELD_M(SLC_INTVEC_TO_HOST_INTVEC, 1);
+        SLC.INTVEC_TO_HOST = 0;
+    }
+}
+
+/* The host has read up to and including 'eof_desc' */
+static void IRAM tx_finished(uint32_t eof_desc)
+{
+    size_t index = (eof_desc - (uint32_t)tx_desc) / sizeof(struct SLCDescriptor);
+
+    if (index >= SDIO_SLAVE_TX_BUFS || !tx_count)
+        return;
+    size_t n = (index + SDIO_SLAVE_TX_BUFS - tx_first) % SDIO_SLAVE_TX_BUFS + 1;
+    if (n > tx_count)
+        return;     /* reported already */
+    tx_first = (index + 1) % SDIO_SLAVE_TX_BUFS;
+    tx_count -= n;
+    stats.tx_frames += n;
+    host_status();
+}
+
+static void IRAM sdio_slave_isr(void)
+{
+    uint32_t status = SLC.INT_STATUS;
+    SLC.INT_CLEAR = status;
+
+    if (status & SLC_INT_STATUS_RX_EOF)
+        tx_finished(SLC.RX_EOF_DESCRIPTOR_ADDR);
+
+    if (status & (SLC_INT_STATUS_TX_EOF | SLC_INT_STATUS_TX_DSCR_EMPTY | SLC_INT_STATUS_TX_DSCR_ERROR)) {
+        portBASE_TYPE woken = pdFALSE;
+        vTaskNotifyGiveFromISR(task, &woken);
+        if (woken)
+            portYIELD();
+    }
+}
+
+/* A receive buffer the SLC has written, 'flags' from its descriptor */
+static void rx_buffer(struct pbuf *p, uint32_t flags)
+{
+    uint32_t len = FIELD2VAL(SLC_DESCRIPTOR_FLAGS_DATA_LENGTH, flags);
+
+    if (!(flags & SLC_DESCRIPTOR_FLAGS_EOF)) {
+        /* A frame longer than a buffer, drop it all */
+        if (!rx_skip)
+            stats.rx_errors++;
+        rx_skip = true;
+        pbuf_free(p);
+        return;
+    }
+    if (rx_skip) {
+        rx_skip = false;
+        pbuf_free(p);
+        return;
+    }
+
+    const uint8_t *h = p->payload;
+    uint32_t payload = h[2] | (h[3] << 8);
+    if (len < SDIO_SLAVE_HEADER_LEN || payload > len - SDIO_SLAVE_HEADER_LEN) {
+        stats.rx_errors++;
+        pbuf_free(p);
+        return;
+    }
+    uint8_t cmd = h[0], seq = h[1];
+    pbuf_realloc(p, SDIO_SLAVE_HEADER_LEN + payload);
+    pbuf_header(p, -SDIO_SLAVE_HEADER_LEN);
+    stats.rx_frames++;
+    handler(cmd, seq, p);
+}
+
+/* Take the buffers written, and arm fresh ones in their place. Returns
+   false if a slot is still waiting for a pbuf. */
+static bool rx_service(void)
+{
+    uint32_t armed = 0;
+    bool starved = false;
+
+    for (;;) {
+        volatile struct SLCDescriptor *d = &rx_desc[rx_next];
+        if (rx_pbufs[rx_next]) {
+            uint32_t flags = d->flags;
+            if (flags & SLC_DESCRIPTOR_FLAGS_OWNER)
+                break;      /* not written yet */
+            struct pbuf *p = rx_pbufs[rx_next];
+            rx_pbufs[rx_next] = NULL;
+            rx_buffer(p, flags);
+        }
+
+        struct pbuf *p = pbuf_alloc(PBUF_RAW, SDIO_SLAVE_BUF_SIZE, PBUF_RAM);
+        if (!p) {
+            stats.rx_nomem++;
+            starved = true;
+            break;
+        }
+        rx_pbufs[rx_next] = p;
+        d->buf_ptr = (uint32_t)p->payload;
+        d->flags = SLC_DESCRIPTOR_FLAGS(SDIO_SLAVE_BUF_SIZE, 0, 0, 0, 1);
+        rx_next = (rx_next + 1) % SDIO_SLAVE_RX_BUFS;
+        armed++;
+    }
+
+    if (armed) {
+        /* A write credit for the host each, then go on if stopped */
+        SLC.TOKEN1 = VAL2FIELD_M(SLC_TOKEN1_LOCAL_DATA, armed) | SLC_TOKEN1_LOCAL_INC_MORE;
+        if (rx_started)
+            SLC.TX_LINK |= SLC_TX_LINK_RESTART;
+    }
+    return !starved;
+}
+
+static void sdio_slave_task(void *pvParameters)
+{
+    bool ok = true;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, ok ? portMAX_DELAY : RX_RETRY_MS / portTICK_RATE_MS);
+        ok = rx_service();
+    }
+}
+
+bool sdio_slave_init(sdio_slave_handler_t h, unsigned priority)
+{
+    handler = h;
+    if (!tx_buf && !(tx_buf = malloc(SDIO_SLAVE_TX_BUFS * SDIO_SLAVE_BUF_SIZE)))
+        return false;
+    if (!tx_lock && !(tx_lock = xSemaphoreCreateMutex()))
+        return false;
+
+    _xt_isr_mask(BIT(INUM_SLC));
+
+    SLC.CONF0 |= SLC_CONF0_RX_LINK_RESET | SLC_CONF0_TX_LINK_RESET;
+    SLC.CONF0 &= ~(SLC_CONF0_RX_LINK_RESET | SLC_CONF0_TX_LINK_RESET);
+    SLC.CONF0 = SET_FIELD(SLC.CONF0, SLC_CONF0_MODE, 0);
+
+    /* SDIO framing: a transfer ends (EOF) at the host's end address */
+    SLC.RX_DESCRIPTOR_CONF &= ~(SLC_RX_DESCRIPTOR_CONF_INFOR_NO_REPLACE | SLC_RX_DESCRIPTOR_CONF_TOKEN_NO_REPLACE);
+    SLC.RX_DESCRIPTOR_CONF |= SLC_RX_DESCRIPTOR_CONF_RX_EOF_MODE | SLC_RX_DESCRIPTOR_CONF_RX_FILL_MODE;
+
+    SLC.HOST_INT_CLEAR = 0xffffffff;
+    SLC.HOST_INT_ENABLE |= SLC_HOST_INT_TO_HOST_BIT0;
+    SLC.TOKEN1 = VAL2FIELD_M(SLC_TOKEN1_LOCAL_DATA, 0) | SLC_TOKEN1_LOCAL_WRITE;
+
+    /* Send buffers, not owned until a frame is queued */
+    tx_first = tx_count = 0;
+    tx_started = false;
+    for (size_t i = 0; i < SDIO_SLAVE_TX_BUFS; i++) {
+        tx_desc[i].flags = 0;
+        tx_desc[i].buf_ptr = (uint32_t)(tx_buf + i * SDIO_SLAVE_BUF_SIZE);
+        tx_desc[i].next_link_ptr = (uint32_t)&tx_desc[(i + 1) % SDIO_SLAVE_TX_BUFS];
+    }
+    host_status();
+
+    /* Receive buffers, all armed before the host gets any credit */
+    for (size_t i = 0; i < SDIO_SLAVE_RX_BUFS; i++) {
+        if (rx_pbufs[i]) {
+            pbuf_free(rx_pbufs[i]);
+            rx_pbufs[i] = NULL;
+        }
+        rx_desc[i].flags = 0;
+        rx_desc[i].next_link_ptr = (uint32_t)&rx_desc[(i + 1) % SDIO_SLAVE_RX_BUFS];
+    }
+    rx_next = 0;
+    rx_skip = rx_started = false;
+    SLC.TX_LINK = set_link_addr(SLC.TX_LINK, &rx_desc[0]);
+    bool armed = rx_service();
+    SLC.TX_LINK |= SLC_TX_LINK_START;
+    rx_started = true;
+
+    if (!task && xTaskCreate(sdio_slave_task, (signed char *)"sdioslave", 256, NULL, priority, &task) != pdPASS)
+        return false;
+    if (!armed)
+        xTaskNotifyGive(task);
+
+    SLC.INT_CLEAR = 0xffffffff;
+    SLC.INT_ENABLE = SLC_INT_ENABLE_RX_EOF | SLC_INT_ENABLE_TX_EOF |
+                     SLC_INT_ENABLE_TX_DSCR_EMPTY | SLC_INT_ENABLE_TX_DSCR_ERROR;
+    _xt_isr_attach(INUM_SLC, sdio_slave_isr);
+    _xt_isr_unmask(BIT(INUM_SLC));
+    return true;
+}
+
+/* Queue a frame of 'len' payload bytes from 'p', or 'data' if it's NULL */
+static bool send(uint8_t cmd, uint8_t seq, struct pbuf *p, const void *data, size_t len)
+{
+    if (len > SDIO_SLAVE_MAX_FRAME)
+        return false;
+
+    xSemaphoreTake(tx_lock, portMAX_DELAY);
+    if (tx_count == SDIO_SLAVE_TX_BUFS) {
+        stats.tx_full++;
+        xSemaphoreGive(tx_lock);
+        return false;
+    }
+
+    /* Only the interrupt changes tx_first and tx_count, and it keeps
+       their sum, so the slot after the last stays ours */
+    taskENTER_CRITICAL();
+    size_t slot = (tx_first + tx_count) % SDIO_SLAVE_TX_BUFS;
+    taskEXIT_CRITICAL();
+
+    uint8_t *buf = tx_buf + slot * SDIO_SLAVE_BUF_SIZE;
+    buf[0] = cmd;
+    buf[1] = seq;
+    buf[2] = len;
+    buf[3] = len >> 8;
+    if (p)
+        pbuf_copy_partial(p, buf + SDIO_SLAVE_HEADER_LEN, len, 0);
+    else
+        memcpy(buf + SDIO_SLAVE_HEADER_LEN, data, len);
+    len += SDIO_SLAVE_HEADER_LEN;
+    tx_len[slot] = len;
+    tx_desc[slot].flags = SLC_DESCRIPTOR_FLAGS((len + 3) & ~3, len, 0, 1, 1);
+
+    taskENTER_CRITICAL();
+    tx_count++;
+    if (!tx_started) {
+        tx_started = true;
+        SLC.RX_LINK = set_link_addr(SLC.RX_LINK, &tx_desc[slot]);
+        SLC.RX_LINK |= SLC_RX_LINK_START;
+    } else {
+        SLC.RX_LINK |= SLC_RX_LINK_RESTART;
+    }
+    if (tx_count == 1)
+        host_status();
+    taskEXIT_CRITICAL();
+
+    xSemaphoreGive(tx_lock);
+    return true;
+}
+
+bool sdio_slave_send(uint8_t cmd, uint8_t seq, struct pbuf *p)
+{
+    return send(cmd, seq, p, NULL, p->tot_len);
+}
+
+bool sdio_slave_send_data(uint8_t cmd, uint8_t seq, const void *data, size_t len)
+{
+    return send(cmd, seq, NULL, data, len);
+}
+
+void sdio_slave_stats(sdio_slave_stats_t *out)
+{
+    *out = stats;
+}
@@ -0,0 +1,103 @@
+/* SDIO slave link to a host, on the SLC DMA engine
+ *
+ * For an ESP8266 working as a network interface for a Linux (or other)
+ * host: the host is SDIO master and exchanges frames with the ESP8266
+ * through the SLC, which moves them between the SDIO function's FIFO
+ * and RAM by DMA. Nothing is clocked through registers a chunk at a
+ * time as over UART or SPI slave (extras/spi_slave), so the link runs
+ * as fast as the host drives the 4 bit bus.
+ *
+ * Frames use the same header as extras/spi_slave, so host code can
+ * share it: command, sequence number, then the payload length, little
+ * endian 16 bit, followed by the payload. With one 802.3 frame (or
+ * anything else lwIP holds in a pbuf) as the payload, a frame is a
+ * pbuf on the wire, see examples/sdio_wifi_nic.
+ *
+ * Host -> ESP8266: the SLC's TX link is a ring of SDIO_SLAVE_RX_BUFS
+ * descriptors, each pointing at the payload of a pbuf of
+ * SDIO_SLAVE_BUF_SIZE bytes. Each host write of one whole frame, ending
+ * at the function's EOF address, fills one and the handler gets that
+ * pbuf, trimmed to the payload, with no copy. TOKEN1 counts the
+ * buffers given to the SLC (it's raised with LOCAL_INC_MORE as each is
+ * armed): the host may write a frame for each count it hasn't used.
+ *
+ * ESP8266 -> host: sdio_slave_send() copies the frame into one of
+ * SDIO_SLAVE_TX_BUFS buffers on the RX link and interrupts the host
+ * (INTVEC_TO_HOST bit 0). HOST_CONF_W2 holds the length of the frame
+ * waiting to be read, header included, or 0 when there's none; it
+ * moves on to the next as each is read.
+ *
+ * The SDIO slave pins are the SD_* pins, GPIO6-11, which an SPI flash
+ * is usually on: this needs a board wired for it (see Espressif's SDIO
+ * slave documents). The SLC is also the I2S DMA engine, so this can't
+ * be used with extras/i2s_dma or ws2812_i2s.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _SDIO_SLAVE_H
+#define _SDIO_SLAVE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <lwip/pbuf.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/* Receive buffers (pbufs) given to the SLC */
+#ifndef SDIO_SLAVE_RX_BUFS
+#define SDIO_SLAVE_RX_BUFS 4
+#endif
+
+/* Frames queued to send at once */
+#ifndef SDIO_SLAVE_TX_BUFS
+#define SDIO_SLAVE_TX_BUFS 4
+#endif
+
+/* Of each buffer, header included: a whole 802.3 frame by default. A
+   multiple of 4, at most 4092. */
+#ifndef SDIO_SLAVE_BUF_SIZE
+#define SDIO_SLAVE_BUF_SIZE 1536
+#endif
+
+#define SDIO_SLAVE_HEADER_LEN 4
+
+/* Longest payload each way */
+#define SDIO_SLAVE_MAX_FRAME (SDIO_SLAVE_BUF_SIZE - SDIO_SLAVE_HEADER_LEN)
+
+/* Called in the driver's task for each frame received. The handler
+   owns 'p' (a single pbuf) and must pbuf_free() it. */
+typedef void (*sdio_slave_handler_t)(uint8_t cmd, uint8_t seq, struct pbuf *p);
+
+typedef struct {
+    uint32_t rx_frames;
+    uint32_t tx_frames;
+    uint32_t rx_errors;         /* frames too long for a buffer, or bad headers */
+    uint32_t rx_nomem;          /* buffers not rearmed yet for lack of pbufs */
+    uint32_t tx_full;           /* sends refused with every buffer queued */
+} sdio_slave_stats_t;
+
+/* Take over the SLC for SDIO and start the driver's task at
+   'priority'. Returns false if out of memory. */
+bool sdio_slave_init(sdio_slave_handler_t handler, unsigned priority);
+
+/* Copy 'p' (a chain, up to SDIO_SLAVE_MAX_FRAME bytes) into a buffer
+   to send as one frame. Returns false if they're all queued, or it's
+   too long. Any task, not interrupts; quick enough for a WLAN receive
+   hook. */
+bool sdio_slave_send(uint8_t cmd, uint8_t seq, struct pbuf *p);
+
+/* Send 'len' bytes at 'data' as a frame */
+bool sdio_slave_send_data(uint8_t cmd, uint8_t seq, const void *data, size_t len);
+
+void sdio_slave_stats(sdio_slave_stats_t *stats);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _SDIO_SLAVE_H */
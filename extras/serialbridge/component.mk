@@ -0,0 +1,9 @@
+# Component makefile for extras/serialbridge
+
+# expected anyone using serialbridge includes it as 'serialbridge/serialbridge.h'
+INC_DIRS += $(serialbridge_ROOT)..
+
+# args for passing into compile rule generation
+serialbridge_SRC_DIR =  $(serialbridge_ROOT)
+
+$(eval $(call component_compile_rules,serialbridge))
@@ -0,0 +1,145 @@
+/* Transparent UART to TCP bridge, see serialbridge.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "serialbridge.h"
+
+#include <string.h>
+
+#include <esp/uart.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+
+#include <lwip/api.h>
+#include <lwip/tcp.h>
+#include <lwip/tcpip.h>
+
+/* RX FIFO levels (of 128 bytes): the interrupt empties it at
+   RX_THRESHOLD, so RTS (at RTS_THRESHOLD) only goes once the ring is
+   full and the interrupt has backed off. An interrupt every 64 bytes is
+   about 1400 a second at 921600 baud, against 2900 for the default
+   32; the RX timeout still catches the end of a burst. */
+#define RX_THRESHOLD 64
+#define RTS_THRESHOLD 110
+
+static serialbridge_config_t cfg;
+static serialbridge_stats_t stats;
+
+/* The client connection, held while the serial side writes to it so
+   the TCP side doesn't delete it underneath */
+static xSemaphoreHandle conn_lock;
+static struct netconn *client;
+
+static void nodelay_cb(void *arg)
+{
+    tcp_nagle_disable(((struct netconn *)arg)->pcb.tcp);
+}
+
+/* Serial to TCP */
+static void serial_task(void *pvParameters)
+{
+    uint16_t coalesce = cfg.coalesce ? cfg.coalesce : TCP_MSS;
+    portTickType latency = cfg.latency_ms / portTICK_RATE_MS;
+    const uint8_t *data;
+    size_t len;
+
+    while (1) {
+        if (!uart_rx_peek(cfg.uart, &data, portMAX_DELAY))
+            continue;
+
+        /* Let a segment's worth gather, or the latency run out */
+        portTickType start = xTaskGetTickCount();
+        while (uart_rx_available(cfg.uart) < coalesce && xTaskGetTickCount() - start < latency)
+            vTaskDelay(1);
+        size_t waiting = uart_rx_available(cfg.uart);
+
+        xSemaphoreTake(conn_lock, portMAX_DELAY);
+        while (waiting && (len = uart_rx_peek(cfg.uart, &data, 0))) {
+            if (len > waiting)
+                len = waiting;
+            if (client) {
+                /* More to come straight after this piece, when the
+                   data waiting wraps around the end of the ring */
+                uint8_t flags = NETCONN_COPY | (len < waiting ? NETCONN_MORE : 0);
+                if (netconn_write(client, data, len, flags) == ERR_OK) {
+                    stats.serial_to_tcp += len;
+                    stats.tcp_writes++;
+                }
+            } else {
+                stats.discarded += len;
+            }
+            uart_rx_consume(cfg.uart, len);
+            waiting -= len;
+        }
+        stats.rx_overflows = uart_rx_overflows(cfg.uart);
+        xSemaphoreGive(conn_lock);
+    }
+}
+
+/* TCP to serial */
+static void tcp_task(void *pvParameters)
+{
+    struct netconn *listener = netconn_new(NETCONN_TCP);
+    netconn_bind(listener, IP_ADDR_ANY, cfg.port);
+    netconn_listen(listener);
+
+    while (1) {
+        struct netconn *conn;
+        if (netconn_accept(listener, &conn) != ERR_OK)
+            continue;
+        if (cfg.nodelay)
+            tcpip_callback(nodelay_cb, conn);
+        stats.connections++;
+
+        xSemaphoreTake(conn_lock, portMAX_DELAY);
+        client = conn;
+        xSemaphoreGive(conn_lock);
+
+        struct netbuf *nb;
+        while (netconn_recv(conn, &nb) == ERR_OK) {
+            void *data;
+            u16_t len;
+            do {
+                netbuf_data(nb, &data, &len);
+                uart_write(cfg.uart, data, len);
+                stats.tcp_to_serial += len;
+            } while (netbuf_next(nb) >= 0);
+            netbuf_delete(nb);
+        }
+
+        xSemaphoreTake(conn_lock, portMAX_DELAY);
+        client = NULL;
+        xSemaphoreGive(conn_lock);
+        netconn_close(conn);
+        netconn_delete(conn);
+    }
+}
+
+bool serialbridge_start(const serialbridge_config_t *config)
+{
+    cfg = *config;
+    memset(&stats, 0, sizeof(stats));
+
+    conn_lock = xSemaphoreCreateMutex();
+    if (!conn_lock)
+        return false;
+    if (cfg.baud)
+        uart_set_baud(cfg.uart, cfg.baud);
+    if (!uart_tx_buffered(cfg.uart) && !uart_tx_buffer_enable(cfg.uart, cfg.tx_ring, UART_TX_BLOCK))
+        return false;
+    if (!uart_rx_buffer_enable(cfg.uart, cfg.rx_ring))
+        return false;
+    uart_set_rx_thresholds(cfg.uart, RX_THRESHOLD, UART_DEFAULT_RX_TIMEOUT);
+    uart_set_flow_control(cfg.uart, cfg.rts, cfg.cts, RTS_THRESHOLD);
+
+    return xTaskCreate(serial_task, (signed char *)"bridge_rx", 384, NULL, cfg.priority, NULL) == pdPASS
+        && xTaskCreate(tcp_task, (signed char *)"bridge_tx", 384, NULL, cfg.priority, NULL) == pdPASS;
+}
+
+void serialbridge_get_stats(serialbridge_stats_t *s)
+{
+    *s = stats;
+}
@@ -0,0 +1,81 @@
+/* Transparent UART to TCP bridge
+ *
+ * Tunnels a serial line (an RS-485 bus, say) over TCP: a server on a
+ * port takes one client at a time, and bytes go both ways unchanged.
+ *
+ * Serial to TCP, data is sent straight from the UART's RX ring: the
+ * receive interrupt puts it there, and the bridge hands it to
+ * netconn_write() where it is (uart_rx_peek()), so the only copy is
+ * into the TCP segment. Writes are coalesced: after the first byte
+ * arrives the bridge waits, up to 'latency_ms', for 'coalesce' bytes
+ * (one segment by default) and sends everything waiting at once. At
+ * 921600 baud (about 92 KB/s) that's a full segment every 16ms.
+ *
+ * TCP to serial, each received segment's payload is copied straight
+ * into the UART's TX ring.
+ *
+ * Flow control: when TCP can't keep up the RX ring fills, the interrupt
+ * stops emptying the hardware FIFO, and with 'rts' set RTS tells the
+ * serial side to stop. In the other direction a full TX ring stops the
+ * bridge receiving, which closes the TCP window. With 'cts' set the UART
+ * only sends while CTS is asserted. Without RTS, size the RX ring for
+ * the longest time the network might stall: rx_ring / (baud / 10)
+ * seconds of data, and data past that is lost (uart_rx_overflows()).
+ *
+ * The bridge turns on (and owns) the UART's buffered RX and TX. On
+ * UART0 that means printf output goes down the serial line too.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _SERIALBRIDGE_H
+#define _SERIALBRIDGE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    int uart;
+    uint32_t baud;          /* 0 leaves the baud rate alone */
+    uint16_t port;          /* TCP port to listen on */
+    uint16_t rx_ring;       /* RX ring size, bytes (a power of two) */
+    uint16_t tx_ring;       /* TX ring size, bytes (a power of two) */
+    uint16_t coalesce;      /* bytes to gather before a write, 0 for TCP_MSS */
+    uint16_t latency_ms;    /* longest wait for them after the first byte */
+    bool nodelay;           /* disable Nagle on the connection */
+    bool rts, cts;          /* hardware flow control, see uart_set_flow_control() */
+    uint8_t priority;       /* of the bridge's two tasks */
+} serialbridge_config_t;
+
+#define SERIALBRIDGE_DEFAULT_CONFIG { \
+        .uart = 0, .baud = 115200, .port = 23, \
+        .rx_ring = 2048, .tx_ring = 1024, \
+        .coalesce = 0, .latency_ms = 5, .nodelay = true, \
+        .rts = false, .cts = false, .priority = 3, \
+    }
+
+typedef struct {
+    uint32_t connections;
+    uint32_t serial_to_tcp;     /* bytes */
+    uint32_t tcp_to_serial;     /* bytes */
+    uint32_t tcp_writes;        /* netconn writes serial_to_tcp took */
+    uint32_t discarded;         /* serial bytes received with no client */
+    uint32_t rx_overflows;      /* UART FIFO overflows, as uart_rx_overflows() */
+} serialbridge_stats_t;
+
+/* Set up the UART and start the bridge's tasks. Returns false if the
+   UART's rings or the tasks couldn't be created. */
+bool serialbridge_start(const serialbridge_config_t *config);
+
+void serialbridge_get_stats(serialbridge_stats_t *stats);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _SERIALBRIDGE_H */
@@ -0,0 +1,9 @@
+# Component makefile for extras/sntp
+
+# expected anyone using sntp includes it as 'sntp/sntp.h'
+INC_DIRS += $(sntp_ROOT)..
+
+# args for passing into compile rule generation
+sntp_SRC_DIR =  $(sntp_ROOT)
+
+$(eval $(call component_compile_rules,sntp))
@@ -0,0 +1,324 @@
+/* SNTP client, see sntp.h
+ *
+ * Based on RFC 4330 http://www.ietf.org/rfc/rfc4330.txt
+ *
+ * All state is only touched from tcpip_thread, apart from the stats
+ * which are copied out under a critical section.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "sntp.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <lwip/udp.h>
+#include <lwip/dns.h>
+#include <lwip/tcpip.h>
+#include <lwip/timers.h>
+#include <lwip/sys.h>
+#include <timeofday.h>
+
+#define NTP_PORT 123
+#define NTP_MODE_CLIENT 3
+#define NTP_MODE_SERVER 4
+#define NTP_VERSION 4
+#define NTP_LI_UNSYNC 3
+
+/* Seconds from 1900 (NTP era 0) to 1970 */
+#define NTP_UNIX_OFFSET 2208988800LL
+
+struct ntp_msg {
+    uint8_t li_vn_mode;
+    uint8_t stratum;
+    uint8_t poll;
+    int8_t precision;
+    uint32_t root_delay;
+    uint32_t root_dispersion;
+    uint32_t ref_id;
+    uint32_t ref_ts[2];
+    uint32_t orig_ts[2];
+    uint32_t recv_ts[2];
+    uint32_t xmit_ts[2];
+};
+
+static struct {
+    bool running;
+    uintptr_t generation;  /* tells stale resolver callbacks apart */
+    char name[SNTP_MAX_NAME];
+    struct udp_pcb *pcb;
+    ip_addr_t server;
+
+    /* the burst in progress */
+    uint8_t sample;
+    bool waiting;
+    int64_t t1;
+    bool have_best;
+    int64_t best_offset;
+    int64_t best_delay;
+    uint8_t best_stratum;
+
+    bool synced;
+    bool have_freq;
+    uint64_t last_update_up;
+    uint32_t poll_s;
+} state;
+
+static sntp_stats_t stats;
+
+static void send_request(void *arg);
+
+static void stats_update(void)
+{
+    taskENTER_CRITICAL();
+    ip_addr_copy(stats.server, state.server);
+    stats.synced = state.synced;
+    stats.stratum = state.best_stratum;
+    stats.offset_us = state.best_offset;
+    stats.delay_us = state.best_delay;
+    stats.freq_ppb = timeofday_get_freq();
+    stats.poll_s = state.poll_s;
+    taskEXIT_CRITICAL();
+}
+
+static int64_t ntp_to_us(const uint32_t ts[2])
+{
+    uint32_t sec = ntohl(ts[0]);
+    int64_t unix_s = (int64_t)sec - NTP_UNIX_OFFSET;
+    if (sec < 0x80000000)
+        unix_s += 1LL << 32;  /* era 1, from 2036 */
+    return unix_s * 1000000 + (int64_t)(((uint64_t)ntohl(ts[1]) * 1000000) >> 32);
+}
+
+static void poll_cb(void *arg);
+
+static void schedule_poll(void)
+{
+    sys_timeout(state.poll_s * 1000, poll_cb, NULL);
+}
+
+/* Use the best sample of the burst */
+static void discipline(void)
+{
+    int64_t offset = state.best_offset;
+    uint64_t up = sys_uptime_us();
+
+    if (!timeofday_is_set() || (SNTP_STEP_US && llabs(offset) > SNTP_STEP_US)) {
+        timeofday_set_us(timeofday_us() + offset);
+        stats.steps++;
+        state.poll_s = SNTP_POLL_MIN;
+    } else if (!state.synced) {
+        /* Set before we started, by an earlier run or otherwise, so no
+           interval to measure the rate over yet */
+        timeofday_adjust(offset);
+    } else {
+        /* Slew still pending accounts for that much of the offset, the
+           rest built up since the last update from the rate being off */
+        int64_t error = offset - timeofday_adjust_remaining();
+        int64_t interval = up - state.last_update_up;
+        int64_t ppb = error * 1000000000 / interval;
+        if (state.have_freq)
+            ppb /= 4;
+        timeofday_set_freq(timeofday_get_freq() + ppb);
+        state.have_freq = true;
+        timeofday_adjust(offset);
+
+        if (llabs(error) < SNTP_HOLD_US) {
+            if (state.poll_s < SNTP_POLL_MAX)
+                state.poll_s *= 2;
+        } else if (llabs(error) > 4 * SNTP_HOLD_US && state.poll_s > SNTP_POLL_MIN) {
+            state.poll_s /= 2;
+        }
+    }
+    state.synced = true;
+    state.last_update_up = up;
+}
+
+static void burst_done(void)
+{
+    if (state.have_best) {
+        discipline();
+    } else {
+        stats.polls_failed++;
+        state.poll_s = SNTP_POLL_MIN;
+    }
+    stats_update();
+    schedule_poll();
+}
+
+static void next_sample(void)
+{
+    state.waiting = false;
+    if (++state.sample < SNTP_BURST)
+        sys_timeout(SNTP_BURST_GAP_MS, send_request, NULL);
+    else
+        burst_done();
+}
+
+static void reply_timeout(void *arg)
+{
+    next_sample();
+}
+
+static void send_request(void *arg)
+{
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, sizeof(struct ntp_msg), PBUF_RAM);
+    if (!p) {
+        next_sample();
+        return;
+    }
+    struct ntp_msg *msg = p->payload;
+    memset(msg, 0, sizeof(*msg));
+    msg->li_vn_mode = (NTP_VERSION << 3) | NTP_MODE_CLIENT;
+
+    /* The server echoes the transmit timestamp back as the originate
+       one, it needn't be in NTP format, so it's just our own T1 */
+    state.t1 = timeofday_us();
+    memcpy(msg->xmit_ts, &state.t1, sizeof(msg->xmit_ts));
+
+    state.waiting = true;
+    stats.requests++;
+    if (udp_sendto(state.pcb, p, &state.server, NTP_PORT) != ERR_OK) {
+        pbuf_free(p);
+        next_sample();
+        return;
+    }
+    pbuf_free(p);
+    sys_timeout(SNTP_TIMEOUT_MS, reply_timeout, NULL);
+}
+
+static void sntp_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *addr, u16_t port)
+{
+    int64_t t4 = timeofday_us();
+    struct ntp_msg msg;
+
+    if (!state.waiting || port != NTP_PORT || !ip_addr_cmp(addr, &state.server)
+        || pbuf_copy_partial(p, &msg, sizeof(msg), 0) != sizeof(msg)) {
+        pbuf_free(p);
+        return;
+    }
+    pbuf_free(p);
+
+    /* Only the reply to the request outstanding, from a synchronised
+       server (stratum 0 is a kiss-o'-death) */
+    if ((msg.li_vn_mode & 7) != NTP_MODE_SERVER || (msg.li_vn_mode >> 6) == NTP_LI_UNSYNC
+        || msg.stratum == 0 || msg.stratum > 15
+        || memcmp(msg.orig_ts, &state.t1, sizeof(msg.orig_ts))
+        || (!msg.xmit_ts[0] && !msg.xmit_ts[1])) {
+        stats.rejected++;
+        return;
+    }
+    stats.replies++;
+    sys_untimeout(reply_timeout, NULL);
+
+    int64_t t2 = ntp_to_us(msg.recv_ts);
+    int64_t t3 = ntp_to_us(msg.xmit_ts);
+    int64_t delay = (t4 - state.t1) - (t3 - t2);
+    if (delay < 0)
+        delay = 0;
+    if (!state.have_best || delay < state.best_delay) {
+        state.have_best = true;
+        state.best_offset = ((t2 - state.t1) + (t3 - t4)) / 2;
+        state.best_delay = delay;
+        state.best_stratum = msg.stratum;
+    }
+    next_sample();
+}
+
+static void resolved(const char *name, ip_addr_t *addr, void *arg)
+{
+    if (!state.running || (uintptr_t)arg != state.generation)
+        return;
+    if (!addr) {
+        stats.polls_failed++;
+        state.poll_s = SNTP_POLL_MIN;
+        stats_update();
+        schedule_poll();
+        return;
+    }
+    ip_addr_copy(state.server, *addr);
+    state.sample = 0;
+    state.have_best = false;
+    send_request(NULL);
+}
+
+static void poll_cb(void *arg)
+{
+    ip_addr_t addr;
+    void *gen = (void *)state.generation;
+
+    err_t err = dns_gethostbyname(state.name, &addr, resolved, gen);
+    if (err == ERR_OK)
+        resolved(state.name, &addr, gen);
+    else if (err != ERR_INPROGRESS)
+        resolved(state.name, NULL, gen);
+}
+
+static void sntp_start_cb(void *arg)
+{
+    state.pcb = udp_new();
+    if (!state.pcb || udp_bind(state.pcb, IP_ADDR_ANY, 0) != ERR_OK) {
+        printf("SNTP Error: Failed to bind UDP port.\r\n");
+        if (state.pcb)
+            udp_remove(state.pcb);
+        state.pcb = NULL;
+        return;
+    }
+    udp_recv(state.pcb, sntp_recv, NULL);
+    state.running = true;
+    state.synced = false;
+    state.have_freq = false;
+    state.poll_s = SNTP_POLL_MIN;
+    poll_cb(NULL);
+}
+
+static void sntp_stop_cb(void *arg)
+{
+    if (state.running) {
+        sys_untimeout(poll_cb, NULL);
+        sys_untimeout(send_request, NULL);
+        sys_untimeout(reply_timeout, NULL);
+        udp_remove(state.pcb);
+        state.pcb = NULL;
+        state.running = false;
+        state.waiting = false;
+        state.generation++;
+    }
+    if (arg)
+        sys_sem_signal((sys_sem_t *)arg);
+}
+
+void sntp_start(const char *server)
+{
+    sntp_stop();
+
+    /* tcpip_thread is done with the name until the callback below */
+    strncpy(state.name, server, sizeof(state.name) - 1);
+    state.name[sizeof(state.name) - 1] = 0;
+    tcpip_callback(sntp_start_cb, NULL);
+}
+
+void sntp_stop(void)
+{
+    sys_sem_t done;
+
+    if (sys_sem_new(&done, 0) != ERR_OK) {
+        tcpip_callback(sntp_stop_cb, NULL);
+        return;
+    }
+    if (tcpip_callback(sntp_stop_cb, &done) == ERR_OK)
+        sys_sem_wait(&done);
+    sys_sem_free(&done);
+}
+
+void sntp_get_stats(sntp_stats_t *out)
+{
+    taskENTER_CRITICAL();
+    *out = stats;
+    taskEXIT_CRITICAL();
+}
@@ -0,0 +1,102 @@
+/* SNTP client disciplining the time of day (see timeofday.h)
+ *
+ * Polls one NTP server (RFC 4330 client mode) and keeps the clock on
+ * it without ever stepping once it's set:
+ *
+ * - Each poll is a burst of SNTP_BURST requests, and only the sample
+ *   with the shortest round trip is used, as its offset is the least
+ *   skewed by queueing on the way.
+ * - The first poll that gets an answer sets the clock, unless it was
+ *   already set (by an earlier sntp_start(), say). After that the
+ *   offset is slewed away with timeofday_adjust(), and whatever offset
+ *   builds up between polls beyond the slew still pending is put down
+ *   to the crystal's frequency error and fed into timeofday_set_freq().
+ * - The poll interval doubles from SNTP_POLL_MIN up to SNTP_POLL_MAX
+ *   while the clock holds within SNTP_HOLD_US, and halves when it
+ *   doesn't.
+ *
+ * It runs in tcpip_thread, on the raw UDP API and lwIP's resolver, so
+ * needs no task of its own.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _SNTP_H
+#define _SNTP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <lwip/ip_addr.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/* Requests per poll, and the gap between them */
+#ifndef SNTP_BURST
+#define SNTP_BURST 4
+#endif
+#ifndef SNTP_BURST_GAP_MS
+#define SNTP_BURST_GAP_MS 2000
+#endif
+
+/* How long to wait for each reply */
+#ifndef SNTP_TIMEOUT_MS
+#define SNTP_TIMEOUT_MS 1000
+#endif
+
+/* Poll interval limits, seconds */
+#ifndef SNTP_POLL_MIN
+#define SNTP_POLL_MIN 32
+#endif
+#ifndef SNTP_POLL_MAX
+#define SNTP_POLL_MAX 1024
+#endif
+
+/* Error between polls below which the interval grows */
+#ifndef SNTP_HOLD_US
+#define SNTP_HOLD_US 2000
+#endif
+
+/* Once synced, step the clock rather than slew when the offset is
+   beyond this (0: never step, a 1s offset then takes ~34 minutes) */
+#ifndef SNTP_STEP_US
+#define SNTP_STEP_US 0
+#endif
+
+#define SNTP_MAX_NAME 64
+
+typedef struct {
+    uint32_t requests;
+    uint32_t replies;
+    uint32_t rejected;     /* malformed, unexpected or unsynchronised */
+    uint32_t polls_failed; /* no usable reply in the whole burst */
+    uint32_t steps;
+    bool synced;
+    ip_addr_t server;
+    uint8_t stratum;
+    int64_t offset_us;     /* offset of the last poll's best sample */
+    uint32_t delay_us;     /* and its round trip */
+    int32_t freq_ppb;      /* frequency correction in use */
+    uint32_t poll_s;       /* current poll interval */
+} sntp_stats_t;
+
+/* Start (or restart) polling 'server', a host name or dotted quad. The
+   first poll goes out as soon as the name resolves, so start it once
+   the station has an address. Can be called from user_init().
+*/
+void sntp_start(const char *server);
+
+/* Stop polling. Waits for tcpip_thread, so mustn't be called from it.
+   The clock goes on with the last frequency correction. */
+void sntp_stop(void);
+
+/* Copy out the counters and the state of the discipline */
+void sntp_get_stats(sntp_stats_t *stats);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _SNTP_H */
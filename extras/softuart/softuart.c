@@ -0,0 +1,377 @@
+/* Software UARTs, see softuart.h
+ *
+ * TX positions are kept in FRC2 ticks << 8, so the fraction of a tick
+ * each bit leaves over is carried to the next edge rather than lost.
+ * RX works in CCOUNT cycles, which is what gpio_capture timestamps.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <string.h>
+#include <stdlib.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <queue.h>
+
+#include <esp/gpio.h>
+#include <esp/hrtimer.h>
+#include <esp/clocks.h>
+#include <esp/interrupts.h>
+#include <esp/perf.h>
+#include <common_macros.h>
+
+#include "gpio_capture/gpio_capture.h"
+#include "softuart.h"
+
+#define CAPTURE_RING 64
+#define EVENT_BATCH 16
+
+typedef struct {
+    bool open;
+    int8_t rx_gpio;
+    int8_t tx_gpio;
+    uint32_t baud;
+
+    /* TX ring, written by softuart_write (head), drained by the timer */
+    uint8_t *tx_buf;
+    volatile uint32_t tx_head;
+    volatile uint32_t tx_tail;
+    volatile xTaskHandle tx_waiter;
+    volatile bool tx_active;
+    hrtimer_t tx_timer;
+    uint32_t tx_bit;            /* FRC2 ticks a bit, << 8 */
+    uint32_t tx_carry;          /* fraction of a tick left over, << 8 */
+    uint16_t tx_frame;          /* bits still to send, LSB first */
+    uint8_t tx_bits;
+
+    /* RX, decoded in rx_task */
+    xQueueHandle rx_queue;
+    hrtimer_t rx_timer;
+    uint32_t rx_bit;            /* CCOUNT cycles a bit */
+    uint32_t rx_start;          /* start bit's falling edge */
+    int8_t rx_index;            /* bit being sampled, -1 when idle */
+    uint8_t rx_level;           /* line level since the last edge */
+    uint8_t rx_byte;
+
+    softuart_stats_t stats;
+} port_t;
+
+static port_t ports[SOFTUART_MAX_PORTS];
+static xTaskHandle rx_task_handle;
+static cpu_freq_notifier_t freq_notifier;
+
+/* TX */
+
+static void IRAM tx_edge(hrtimer_t *timer, void *arg)
+{
+    port_t *p = arg;
+    portBASE_TYPE woken = pdFALSE;
+
+    if (!p->tx_bits) {
+        if (p->tx_head == p->tx_tail) {
+            /* The last stop bit is done */
+            p->tx_active = false;
+            if (p->tx_waiter) {
+                vTaskNotifyGiveFromISR(p->tx_waiter, &woken);
+                p->tx_waiter = NULL;
+            }
+            if (woken)
+                portYIELD();
+            return;
+        }
+        /* Start bit 0, 8 data bits, stop bit 1 */
+        p->tx_frame = (p->tx_buf[p->tx_tail++ & (SOFTUART_TX_BUF_SIZE - 1)] << 1) | 0x200;
+        p->tx_bits = 10;
+        if (p->tx_waiter) {
+            vTaskNotifyGiveFromISR(p->tx_waiter, &woken);
+            p->tx_waiter = NULL;
+        }
+    }
+
+    uint32_t level = p->tx_frame & 1;
+    if (level)
+        GPIO.OUT_SET = BIT(p->tx_gpio);
+    else
+        GPIO.OUT_CLEAR = BIT(p->tx_gpio);
+
+    /* The next edge is after the run of bits at this level */
+    uint32_t run = p->tx_carry;
+    do {
+        p->tx_frame >>= 1;
+        p->tx_bits--;
+        run += p->tx_bit;
+    } while (p->tx_bits && (p->tx_frame & 1) == level);
+    p->tx_carry = run & 0xff;
+    hrtimer_start_from_expiry(timer, run >> 8);
+
+    if (woken)
+        portYIELD();
+}
+
+size_t softuart_write(int port, const void *data, size_t len)
+{
+    port_t *p = &ports[port];
+    const uint8_t *bytes = data;
+    size_t done = 0;
+
+    if (!p->open || p->tx_gpio < 0)
+        return 0;
+
+    while (done < len) {
+        uint32_t old_level = _xt_disable_interrupts();
+        uint32_t space = SOFTUART_TX_BUF_SIZE - (p->tx_head - p->tx_tail);
+        if (!space) {
+            p->tx_waiter = xTaskGetCurrentTaskHandle();
+            _xt_restore_interrupts(old_level);
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        uint32_t head = p->tx_head;
+        while (space-- && done < len)
+            p->tx_buf[head++ & (SOFTUART_TX_BUF_SIZE - 1)] = bytes[done++];
+        p->tx_head = head;
+        if (!p->tx_active) {
+            p->tx_active = true;
+            p->tx_carry = 0;
+            hrtimer_start(&p->tx_timer, 0, 0);
+        }
+        _xt_restore_interrupts(old_level);
+    }
+    return done;
+}
+
+void softuart_flush(int port)
+{
+    port_t *p = &ports[port];
+
+    while (1) {
+        uint32_t old_level = _xt_disable_interrupts();
+        if (!p->tx_active) {
+            _xt_restore_interrupts(old_level);
+            return;
+        }
+        p->tx_waiter = xTaskGetCurrentTaskHandle();
+        _xt_restore_interrupts(old_level);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+/* RX */
+
+static void IRAM rx_stop_due(hrtimer_t *timer, void *arg)
+{
+    portBASE_TYPE woken = pdFALSE;
+
+    /* Makes gpio_capture_read() return, with or without events */
+    vTaskNotifyGiveFromISR(rx_task_handle, &woken);
+    if (woken)
+        portYIELD();
+}
+
+/* The line has been at rx_level from the last edge until 't': take the
+   samples that fall in that time */
+static void rx_advance(port_t *p, uint32_t t)
+{
+    while (p->rx_index >= 0) {
+        uint32_t sample = p->rx_start + p->rx_bit / 2 + p->rx_index * p->rx_bit;
+        if ((int32_t)(t - sample) <= 0)
+            return;
+        if (p->rx_index == 0) {
+            if (p->rx_level) {
+                /* A glitch, not a start bit */
+                p->rx_index = -1;
+                return;
+            }
+        } else if (p->rx_index <= 8) {
+            p->rx_byte |= p->rx_level << (p->rx_index - 1);
+        } else {
+            if (!p->rx_level)
+                p->stats.framing_errors++;
+            else if (xQueueSendToBack(p->rx_queue, &p->rx_byte, 0) != pdTRUE)
+                p->stats.rx_overflows++;
+            p->rx_index = -1;
+            hrtimer_stop(&p->rx_timer);
+            return;
+        }
+        p->rx_index++;
+    }
+}
+
+/* Wake the task when the stop bit's sample is behind it, with half a
+   bit to spare (see rx_task) */
+static void rx_arm_stop(port_t *p, uint32_t now)
+{
+    int32_t cycles = p->rx_start + 10 * p->rx_bit - now;
+    uint32_t mhz = cpu_clk_freq() / 1000000;
+
+    hrtimer_start(&p->rx_timer, cycles > 0 ? cycles / mhz + 1 : 0, 0);
+}
+
+static void rx_edge(port_t *p, uint32_t t, uint8_t level)
+{
+    /* Two edges in one interrupt's time, nothing to go on */
+    if (level == p->rx_level)
+        return;
+    rx_advance(p, t);
+    p->rx_level = level;
+    if (p->rx_index < 0 && !level) {
+        p->rx_index = 0;
+        p->rx_start = t;
+        p->rx_byte = 0;
+        rx_arm_stop(p, perf_ccount());
+    }
+}
+
+static void rx_task(void *pvParameters)
+{
+    gpio_capture_event_t events[EVENT_BATCH];
+
+    while (1) {
+        size_t n = gpio_capture_read(events, EVENT_BATCH, 1, portMAX_DELAY);
+
+        for (size_t i = 0; i < n; i++) {
+            for (int j = 0; j < SOFTUART_MAX_PORTS; j++) {
+                port_t *p = &ports[j];
+                if (p->open && p->rx_gpio == events[i].gpio_num) {
+                    rx_edge(p, events[i].ccount, events[i].level);
+                    break;
+                }
+            }
+        }
+        /* No edges since: the line is still where the last one left it,
+           up to now less whatever an edge's interrupt could still be
+           taking to get its event into the ring */
+        uint32_t now = perf_ccount();
+        if (gpio_capture_available())
+            continue;
+        for (int j = 0; j < SOFTUART_MAX_PORTS; j++) {
+            port_t *p = &ports[j];
+            if (!p->open || p->rx_index < 0)
+                continue;
+            rx_advance(p, now - p->rx_bit / 2);
+            if (p->rx_index >= 0 && !hrtimer_active(&p->rx_timer))
+                rx_arm_stop(p, now);
+        }
+    }
+}
+
+size_t softuart_read(int port, void *data, size_t len, uint32_t timeout_ticks)
+{
+    port_t *p = &ports[port];
+    uint8_t *bytes = data;
+    size_t n = 0;
+
+    if (!p->open || !p->rx_queue || !len)
+        return 0;
+    if (xQueueReceive(p->rx_queue, &bytes[0], timeout_ticks) != pdTRUE)
+        return 0;
+    for (n = 1; n < len; n++) {
+        if (xQueueReceive(p->rx_queue, &bytes[n], 0) != pdTRUE)
+            break;
+    }
+    return n;
+}
+
+size_t softuart_available(int port)
+{
+    port_t *p = &ports[port];
+
+    if (!p->open || !p->rx_queue)
+        return 0;
+    return uxQueueMessagesWaiting(p->rx_queue);
+}
+
+void softuart_get_stats(int port, softuart_stats_t *stats)
+{
+    *stats = ports[port].stats;
+}
+
+/* Setup */
+
+static void update_timing(uint32_t freq_hz, void *arg)
+{
+    for (int i = 0; i < SOFTUART_MAX_PORTS; i++) {
+        if (ports[i].open)
+            ports[i].rx_bit = freq_hz / ports[i].baud;
+    }
+}
+
+static bool rx_start(void)
+{
+    if (rx_task_handle)
+        return true;
+    if (!gpio_capture_init(CAPTURE_RING))
+        return false;
+    if (xTaskCreate(rx_task, (signed char *)"softuart_rx", 256, NULL,
+                    SOFTUART_RX_PRIORITY, &rx_task_handle) != pdPASS)
+        return false;
+    freq_notifier.changed = update_timing;
+    cpu_freq_register(&freq_notifier);
+    return true;
+}
+
+bool softuart_open(int port, uint32_t baud, int8_t rx_gpio, int8_t tx_gpio)
+{
+    if (port < 0 || port >= SOFTUART_MAX_PORTS || ports[port].open || !baud)
+        return false;
+
+    port_t *p = &ports[port];
+
+    memset(p, 0, sizeof(*p));
+    p->rx_gpio = rx_gpio;
+    p->tx_gpio = tx_gpio;
+    p->baud = baud;
+    p->rx_index = -1;
+
+    if (tx_gpio >= 0) {
+        p->tx_buf = malloc(SOFTUART_TX_BUF_SIZE);
+        if (!p->tx_buf)
+            return false;
+        p->tx_bit = ((uint64_t)hrtimer_us_to_ticks(1000000) << 8) / baud;
+        hrtimer_init(&p->tx_timer, tx_edge, p);
+        gpio_enable(tx_gpio, GPIO_OUTPUT);
+        gpio_write(tx_gpio, 1);
+    }
+
+    if (rx_gpio >= 0) {
+        p->rx_queue = xQueueCreate(SOFTUART_RX_BUF_SIZE, 1);
+        if (!p->rx_queue || !rx_start()) {
+            if (p->rx_queue)
+                vQueueDelete(p->rx_queue);
+            free(p->tx_buf);
+            return false;
+        }
+        p->rx_bit = cpu_clk_freq() / baud;
+        hrtimer_init(&p->rx_timer, rx_stop_due, p);
+        gpio_enable(rx_gpio, GPIO_INPUT);
+        gpio_set_pullup(rx_gpio, true, false);
+        p->rx_level = gpio_read(rx_gpio);
+    }
+
+    p->open = true;
+    if (rx_gpio >= 0)
+        gpio_capture_enable(rx_gpio, GPIO_INTTYPE_EDGE_ANY);
+    return true;
+}
+
+void softuart_close(int port)
+{
+    port_t *p = &ports[port];
+
+    if (!p->open)
+        return;
+    if (p->rx_gpio >= 0) {
+        gpio_capture_disable(p->rx_gpio);
+        hrtimer_stop(&p->rx_timer);
+    }
+    if (p->tx_gpio >= 0)
+        hrtimer_stop(&p->tx_timer);
+    p->open = false;
+    if (p->rx_queue)
+        vQueueDelete(p->rx_queue);
+    free(p->tx_buf);
+    p->rx_queue = NULL;
+    p->tx_buf = NULL;
+}
@@ -0,0 +1,96 @@
+/* Software UARTs on any GPIOs, timed by hrtimer and gpio_capture
+ *
+ * The ESP8266 has one full UART and UART1's TX. These are more, 8N1,
+ * with no bit delays spent spinning: Wi-Fi and other tasks run while a
+ * byte goes out or comes in.
+ *
+ * TX is an hrtimer that fires at each level change of the line (not
+ * at every bit: a run of equal bits is one interval), set from the
+ * previous expiry with hrtimer_start_from_expiry() so the edges are
+ * placed to the FRC2 tick (0.2us) rather than drifting with interrupt
+ * latency. Bytes written are queued in a ring the timer drains.
+ *
+ * RX takes the CCOUNT timestamps gpio_capture records for every edge
+ * on the pin and decodes them in a task, sampling each bit at its
+ * middle from the start bit's edge. A byte that ends in 1 bits has no
+ * edge after its last one, so an hrtimer wakes the task when its stop
+ * bit is due. Interrupt latency delays every edge about equally, so it
+ * doesn't shift the samples.
+ *
+ * The cost is one interrupt per line level change each way (a few us
+ * at 80MHz), at most one a bit: TX is good to 115200 baud, RX, where
+ * an edge's interrupt must be done before the next one, to 38400 with
+ * Wi-Fi busy (57600 otherwise). Several ports at once share the budget.
+ *
+ * RX takes over gpio_capture (it reads every event in its ring), so an
+ * application using soft RX can't read gpio_capture itself. The CPU
+ * clock may be changed with cpu_set_freq(), except while a byte is
+ * arriving, which would be lost.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _SOFTUART_H
+#define _SOFTUART_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifndef SOFTUART_MAX_PORTS
+#define SOFTUART_MAX_PORTS 2
+#endif
+
+/* Ring sizes, bytes (TX a power of two) */
+#ifndef SOFTUART_TX_BUF_SIZE
+#define SOFTUART_TX_BUF_SIZE 64
+#endif
+#ifndef SOFTUART_RX_BUF_SIZE
+#define SOFTUART_RX_BUF_SIZE 64
+#endif
+
+/* Of the RX decoding task, which needs to keep up with the edges */
+#ifndef SOFTUART_RX_PRIORITY
+#define SOFTUART_RX_PRIORITY 6
+#endif
+
+/* Open port 'port' (0 to SOFTUART_MAX_PORTS - 1) at 'baud', receiving
+   on 'rx_gpio' and sending on 'tx_gpio' (-1 for either one not used).
+   Returns false if out of memory or the port is open. */
+bool softuart_open(int port, uint32_t baud, int8_t rx_gpio, int8_t tx_gpio);
+
+/* Stop the port, dropping anything not yet sent or read. Nothing else
+   may be using it (or sending to it) at the time. */
+void softuart_close(int port);
+
+/* Queue 'len' bytes to send, waiting for room in the TX ring. Returns
+   the number queued, which is 0 if the port has no TX pin. */
+size_t softuart_write(int port, const void *data, size_t len);
+
+/* Wait until everything queued has been sent */
+void softuart_flush(int port);
+
+/* Read up to 'len' bytes, waiting up to 'timeout_ticks' RTOS ticks for
+   the first one. Returns the number read, 0 on timeout. */
+size_t softuart_read(int port, void *data, size_t len, uint32_t timeout_ticks);
+
+/* Number of received bytes waiting to be read */
+size_t softuart_available(int port);
+
+typedef struct {
+    uint32_t framing_errors;    /* stop bit was 0, byte dropped */
+    uint32_t rx_overflows;      /* RX ring full, byte dropped */
+} softuart_stats_t;
+
+void softuart_get_stats(int port, softuart_stats_t *stats);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _SOFTUART_H */
@@ -0,0 +1,9 @@
+# Component makefile for extras/spi_display
+
+# expected anyone using spi_display includes it as 'spi_display/spi_display.h'
+INC_DIRS += $(spi_display_ROOT)..
+
+# args for passing into compile rule generation
+spi_display_SRC_DIR =  $(spi_display_ROOT)
+
+$(eval $(call component_compile_rules,spi_display))
@@ -0,0 +1,234 @@
+/* SPI LCD refresh by dirty rectangles, see spi_display.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "spi_display.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <esp/spi.h>
+#include <esp/gpio.h>
+#include <common_macros.h>
+
+#define BUS 1
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+static display_config_t cfg;
+static uint16_t *tile[2];
+static spi_async_transfer_t xfer[2];
+static volatile bool busy[2];
+static volatile xTaskHandle flusher;
+
+static display_rect_t dirty[DISPLAY_MAX_DIRTY];
+static size_t dirty_count;
+
+static void IRAM strip_done(spi_async_transfer_t *t, void *arg)
+{
+    busy[(uintptr_t)arg] = false;
+
+    portBASE_TYPE woken = pdFALSE;
+    vTaskNotifyGiveFromISR(flusher, &woken);
+    if (woken)
+        portYIELD();
+}
+
+static void wait_strip(int b)
+{
+    while (busy[b])
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+}
+
+void display_command(uint8_t cmd, const uint8_t *params, size_t len)
+{
+    const spi_transaction_t c = {
+        .command = cmd,
+        .command_bits = 8,
+    };
+    gpio_write(cfg.dc_gpio, 0);
+    spi_transaction(BUS, &c);
+    gpio_write(cfg.dc_gpio, 1);
+    if (len) {
+        const spi_transaction_t p = {
+            .out_data = params,
+            .out_len = len,
+        };
+        spi_transaction(BUS, &p);
+    }
+}
+
+/* A CASET or RASET, the start and end going out in one 32 bit address
+   phase */
+static void set_range(uint8_t cmd, uint16_t start, uint16_t end)
+{
+    const spi_transaction_t c = {
+        .command = cmd,
+        .command_bits = 8,
+    };
+    const spi_transaction_t range = {
+        .address = ((uint32_t)start << 16) | end,
+        .address_bits = 32,
+    };
+    gpio_write(cfg.dc_gpio, 0);
+    spi_transaction(BUS, &c);
+    gpio_write(cfg.dc_gpio, 1);
+    spi_transaction(BUS, &range);
+}
+
+static void set_window(const display_rect_t *r)
+{
+    set_range(DISPLAY_CMD_CASET, r->x, r->x + r->w - 1);
+    set_range(DISPLAY_CMD_RASET, r->y, r->y + r->h - 1);
+    display_command(DISPLAY_CMD_RAMWR, NULL, 0);
+}
+
+static inline uint32_t area(const display_rect_t *r)
+{
+    return (uint32_t)r->w * r->h;
+}
+
+static display_rect_t unite(const display_rect_t *a, const display_rect_t *b)
+{
+    uint16_t x0 = MIN(a->x, b->x), y0 = MIN(a->y, b->y);
+    uint16_t x1 = MAX(a->x + a->w, b->x + b->w), y1 = MAX(a->y + a->h, b->y + b->h);
+    return (display_rect_t){ x0, y0, x1 - x0, y1 - y0 };
+}
+
+/* With the list locked */
+static void add_dirty(display_rect_t r)
+{
+    /* Fold in everything it can take for free, which may let it take
+       more */
+    for (size_t i = 0; i < dirty_count; ) {
+        display_rect_t u = unite(&dirty[i], &r);
+        if (area(&u) <= area(&dirty[i]) + area(&r)) {
+            r = u;
+            dirty[i] = dirty[--dirty_count];
+            i = 0;
+        } else {
+            i++;
+        }
+    }
+    if (dirty_count < DISPLAY_MAX_DIRTY) {
+        dirty[dirty_count++] = r;
+        return;
+    }
+
+    size_t best = 0;
+    uint32_t best_growth = UINT32_MAX;
+    for (size_t i = 0; i < dirty_count; i++) {
+        display_rect_t u = unite(&dirty[i], &r);
+        uint32_t growth = area(&u) - area(&dirty[i]);
+        if (growth < best_growth) {
+            best_growth = growth;
+            best = i;
+        }
+    }
+    dirty[best] = unite(&dirty[best], &r);
+}
+
+void display_invalidate(uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+    if (x >= cfg.width || y >= cfg.height || !w || !h)
+        return;
+    if (w > cfg.width - x)
+        w = cfg.width - x;
+    if (h > cfg.height - y)
+        h = cfg.height - y;
+
+    taskENTER_CRITICAL();
+    add_dirty((display_rect_t){ x, y, w, h });
+    taskEXIT_CRITICAL();
+}
+
+void display_invalidate_all(void)
+{
+    taskENTER_CRITICAL();
+    dirty[0] = (display_rect_t){ 0, 0, cfg.width, cfg.height };
+    dirty_count = 1;
+    taskEXIT_CRITICAL();
+}
+
+size_t display_flush(void)
+{
+    display_rect_t list[DISPLAY_MAX_DIRTY];
+    size_t n, sent = 0;
+    int b = 0;
+
+    taskENTER_CRITICAL();
+    n = dirty_count;
+    memcpy(list, dirty, n * sizeof(display_rect_t));
+    dirty_count = 0;
+    taskEXIT_CRITICAL();
+
+    flusher = xTaskGetCurrentTaskHandle();
+    for (size_t i = 0; i < n; i++) {
+        const display_rect_t *r = &list[i];
+        uint16_t rows = DISPLAY_TILE_PIXELS / r->w;
+
+        set_window(r);
+        for (uint16_t y = r->y; y < r->y + r->h; y += rows) {
+            display_rect_t strip = { r->x, y, r->w, MIN(rows, r->y + r->h - y) };
+
+            /* Render into the half that isn't going out */
+            wait_strip(b);
+            cfg.render(&strip, tile[b], cfg.arg);
+            xfer[b] = (spi_async_transfer_t){
+                .out_data = tile[b],
+                .len = area(&strip),
+                .word_size = SPI_16BIT,
+                .callback = strip_done,
+                .arg = (void *)(uintptr_t)b,
+            };
+            busy[b] = true;
+            spi_async_submit(BUS, &xfer[b]);
+            sent += area(&strip);
+            b ^= 1;
+        }
+        /* Both sent before D/C goes low for the next window */
+        wait_strip(0);
+        wait_strip(1);
+    }
+    return sent;
+}
+
+bool display_init(const display_config_t *config)
+{
+    if (config->width > DISPLAY_TILE_PIXELS || !config->width || !config->height)
+        return false;
+    if (!tile[0]) {
+        tile[0] = malloc(2 * DISPLAY_TILE_PIXELS * sizeof(uint16_t));
+        if (!tile[0])
+            return false;
+        tile[1] = tile[0] + DISPLAY_TILE_PIXELS;
+    }
+    cfg = *config;
+
+    /* Big endian so each 16 bit pixel goes out high byte first */
+    spi_init(BUS, SPI_MODE0, cfg.freq_divider, true, SPI_BIG_ENDIAN, false);
+    gpio_enable(cfg.dc_gpio, GPIO_OUTPUT);
+    gpio_write(cfg.dc_gpio, 1);
+    if (cfg.reset_gpio >= 0) {
+        gpio_enable(cfg.reset_gpio, GPIO_OUTPUT);
+        gpio_write(cfg.reset_gpio, 0);
+        vTaskDelay(10 / portTICK_RATE_MS);
+        gpio_write(cfg.reset_gpio, 1);
+    }
+
+    const uint8_t colmod = 0x55;        /* 16 bits per pixel */
+    display_command(DISPLAY_CMD_SWRESET, NULL, 0);
+    vTaskDelay(150 / portTICK_RATE_MS);
+    display_command(DISPLAY_CMD_SLPOUT, NULL, 0);
+    vTaskDelay(150 / portTICK_RATE_MS);
+    display_command(DISPLAY_CMD_COLMOD, &colmod, 1);
+    display_command(DISPLAY_CMD_MADCTL, &cfg.madctl, 1);
+    display_command(DISPLAY_CMD_DISPON, NULL, 0);
+
+    display_invalidate_all();
+    return true;
+}
@@ -0,0 +1,110 @@
+/* SPI LCD refresh by dirty rectangles
+ *
+ * For the ILI9341, ST7789 and similar MIPI DCS controllers on HSPI with
+ * a D/C pin, RGB565. There's no framebuffer: the application says which
+ * areas have changed with display_invalidate(), and display_flush()
+ * sends just those, asking the render callback for the pixels a strip
+ * at a time into a small tile buffer:
+ *
+ *     static void render(const display_rect_t *r, uint16_t *px, void *arg)
+ *     {
+ *         for (int y = r->y; y < r->y + r->h; y++)
+ *             for (int x = r->x; x < r->x + r->w; x++)
+ *                 *px++ = pixel_at(x, y);
+ *     }
+ *     ...
+ *     display_invalidate(10, 10, 60, 16);    // a label changed
+ *     display_flush();
+ *
+ * The tile buffer is two halves, so the next strip renders while the
+ * last one goes out through the asynchronous SPI queue
+ * (spi_async_submit()) rather than the CPU busy-waiting on it. Each
+ * area's window is set with the command/address phase transactions,
+ * the coordinates going out in the address phase. Overlapping or
+ * touching areas are merged when that doesn't cost extra pixels, and
+ * when the list is full the new area joins whichever one grows least.
+ *
+ * A full 320x240 refresh is 150 KB on the wire: a clock and a few
+ * digits changing might be a few hundred pixels.
+ *
+ * Pins: HSPI (MOSI GPIO13, SCLK GPIO14, CS GPIO15) plus D/C and
+ * optionally reset on any GPIOs. Only one display, and nothing else
+ * should use the asynchronous queue while a flush is running.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _SPI_DISPLAY_H
+#define _SPI_DISPLAY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/* Pixels in each half of the tile buffer, at least the display width */
+#ifndef DISPLAY_TILE_PIXELS
+#define DISPLAY_TILE_PIXELS 1024
+#endif
+
+/* Separate dirty areas kept before they're merged */
+#ifndef DISPLAY_MAX_DIRTY
+#define DISPLAY_MAX_DIRTY 8
+#endif
+
+/* DCS commands used here, for display_command() too */
+#define DISPLAY_CMD_SWRESET 0x01
+#define DISPLAY_CMD_SLPOUT  0x11
+#define DISPLAY_CMD_DISPON  0x29
+#define DISPLAY_CMD_CASET   0x2a
+#define DISPLAY_CMD_RASET   0x2b
+#define DISPLAY_CMD_RAMWR   0x2c
+#define DISPLAY_CMD_MADCTL  0x36
+#define DISPLAY_CMD_COLMOD  0x3a
+
+typedef struct {
+    uint16_t x, y, w, h;
+} display_rect_t;
+
+/* Fill 'pixels' with the r->w by r->h pixels of 'r', row by row. Called
+   from display_flush(). */
+typedef void (*display_render_t)(const display_rect_t *r, uint16_t *pixels, void *arg);
+
+typedef struct {
+    uint16_t width, height;     /* as the controller is set up by 'madctl' */
+    uint8_t madctl;             /* rotation and RGB/BGR for MADCTL */
+    uint8_t dc_gpio;
+    int8_t reset_gpio;          /* -1 if none */
+    uint32_t freq_divider;      /* SPI_FREQ_DIV_... */
+    display_render_t render;
+    void *arg;
+} display_config_t;
+
+/* Set up HSPI and the controller (reset, wake, 16 bit colour, MADCTL,
+   display on) and mark the whole screen dirty. Returns false if the
+   width is more than a tile or out of memory. Blocks for about 300
+   ms. */
+bool display_init(const display_config_t *config);
+
+/* Mark an area to be sent by the next flush, clipped to the screen.
+   Any task. */
+void display_invalidate(uint16_t x, uint16_t y, uint16_t w, uint16_t h);
+
+void display_invalidate_all(void);
+
+/* Send all dirty areas. Returns the number of pixels sent. One task at
+   a time. */
+size_t display_flush(void);
+
+/* Send a DCS command and up to 64 bytes of parameters */
+void display_command(uint8_t cmd, const uint8_t *params, size_t len);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _SPI_DISPLAY_H */
@@ -0,0 +1,9 @@
+# Component makefile for extras/spi_slave
+
+# expected anyone using spi_slave includes it as 'spi_slave/spi_slave.h'
+INC_DIRS += $(spi_slave_ROOT)..
+
+# args for passing into compile rule generation
+spi_slave_SRC_DIR =  $(spi_slave_ROOT)
+
+$(eval $(call component_compile_rules,spi_slave))
@@ -0,0 +1,353 @@
+/* HSPI slave link to a host MCU, see spi_slave.h
+ *
+ * The interrupt does the per-chunk work, so a chunk can be exchanged
+ * every few microseconds without waking a task: on a buffer read it
+ * loads the next outgoing chunk, on a buffer write it copies the chunk
+ * into the receive ring. The task reassembles frames and frees pbufs
+ * the interrupt has finished with.
+ *
+ * Outgoing frames are txq[n % SPI_SLAVE_TX_QUEUE]: senders add at
+ * tx_head, the interrupt works through them from tx_cur and the task
+ * frees them up to tx_cur from tx_freed. Received chunks are
+ * rx_ring[n % SPI_SLAVE_RX_CHUNKS], added at rx_head by the interrupt
+ * and taken from rx_tail by the task.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "spi_slave.h"
+
+#include <string.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <esp/spi_regs.h>
+#include <esp/dport_regs.h>
+#include <esp/iomux.h>
+#include <esp/gpio.h>
+#include <esp/interrupts.h>
+#include <common_macros.h>
+
+#define HSPI 1
+#define HEADER_LEN 4
+#define CHUNK_DATA (SPI_SLAVE_CHUNK - 1)
+
+#define SLAVE0_INTS (SPI_SLAVE0_WR_BUF_DONE_EN | SPI_SLAVE0_RD_BUF_DONE_EN)
+#define SLAVE0_DONE (SPI_SLAVE0_TRANS_DONE | SPI_SLAVE0_WR_STA_DONE | SPI_SLAVE0_RD_STA_DONE | \
+                     SPI_SLAVE0_WR_BUF_DONE | SPI_SLAVE0_RD_BUF_DONE)
+
+typedef struct {
+    struct pbuf *p;
+    uint8_t cmd, seq;
+} tx_frame_t;
+
+static tx_frame_t txq[SPI_SLAVE_TX_QUEUE];
+static volatile uint32_t tx_head, tx_cur, tx_freed;
+static struct pbuf *tx_seg;     /* where the frame at tx_cur has got to */
+static size_t tx_off, tx_left;
+static bool tx_started, tx_loaded;
+
+static uint32_t rx_ring[SPI_SLAVE_RX_CHUNKS][SPI_SLAVE_CHUNK / 4];
+static volatile uint32_t rx_head, rx_tail;
+
+static uint8_t tx_count, rx_count;
+static int8_t ready_pin = -1;
+static spi_slave_handler_t handler;
+static xTaskHandle task;
+static spi_slave_stats_t stats;
+
+static void IRAM update_status(void)
+{
+    uint32_t status = VAL2FIELD_M(SPI_SLAVE_STATUS_TX_COUNT, tx_count) |
+                      VAL2FIELD_M(SPI_SLAVE_STATUS_RX_COUNT, rx_count);
+    if (tx_loaded)
+        status |= SPI_SLAVE_STATUS_TX_READY;
+    if (rx_head - rx_tail < SPI_SLAVE_RX_CHUNKS)
+        status |= SPI_SLAVE_STATUS_RX_READY;
+    SPI(HSPI).RSTATUS = status;
+    if (ready_pin >= 0)
+        gpio_write(ready_pin, tx_loaded);
+}
+
+/* Copy up to 'n' bytes of the current frame to 'dst', returning how
+   many */
+static size_t IRAM take_bytes(uint8_t *dst, size_t n)
+{
+    size_t got = 0;
+
+    if (n > tx_left)
+        n = tx_left;
+    while (got < n && tx_seg) {
+        size_t k = tx_seg->len - tx_off;
+        if (k > n - got)
+            k = n - got;
+        memcpy(dst + got, (uint8_t *)tx_seg->payload + tx_off, k);
+        got += k;
+        tx_off += k;
+        if (tx_off == tx_seg->len) {
+            tx_seg = tx_seg->next;
+            tx_off = 0;
+        }
+    }
+    tx_left -= got;
+    return got;
+}
+
+/* Put the next outgoing chunk in the read buffer, if there is one. In
+   the interrupt, or with it masked. Returns true if a frame finished
+   loading, so there's a pbuf to free. */
+static bool IRAM load_chunk(void)
+{
+    uint32_t words[SPI_SLAVE_CHUNK / 4];
+    uint8_t *c = (uint8_t *)words;
+    bool finished = false;
+
+    if (tx_cur == tx_head) {
+        tx_loaded = false;
+        update_status();
+        return false;
+    }
+
+    tx_frame_t *f = &txq[tx_cur % SPI_SLAVE_TX_QUEUE];
+    size_t n = 0;
+    memset(words, 0, sizeof(words));
+    if (!tx_started) {
+        tx_started = true;
+        tx_seg = f->p;
+        tx_off = 0;
+        tx_left = f->p->tot_len;
+        c[1] = f->cmd;
+        c[2] = f->seq;
+        c[3] = tx_left;
+        c[4] = tx_left >> 8;
+        n = HEADER_LEN;
+    }
+    bool first = n != 0;
+    n += take_bytes(c + 1 + n, CHUNK_DATA - n);
+    c[0] = n | (first ? SPI_SLAVE_CHUNK_FIRST : 0);
+    if (!tx_left) {
+        tx_started = false;
+        tx_cur++;
+        stats.tx_frames++;
+        finished = true;
+    }
+
+    /* The read buffer is W8..W15 (MISO_HIGHPART) */
+    volatile uint32_t *w = &SPI(HSPI).W8;
+    for (int i = 0; i < SPI_SLAVE_CHUNK / 4; i++)
+        w[i] = words[i];
+    tx_count++;
+    tx_loaded = true;
+    update_status();
+    return finished;
+}
+
+static void IRAM spi_slave_isr(void)
+{
+    if (!(DPORT.SPI_INT_STATUS & DPORT_SPI_INT_STATUS_SPI1))
+        return;
+
+    uint32_t slave0 = SPI(HSPI).SLAVE0;
+    bool wake = false;
+
+    /* Acknowledge: interrupts off, reset the slave state machine,
+       clear the done bits, interrupts back on */
+    SPI(HSPI).SLAVE0 &= ~SLAVE0_INTS;
+    SPI(HSPI).SLAVE0 |= SPI_SLAVE0_SYNC_RESET;
+    SPI(HSPI).SLAVE0 &= ~SLAVE0_DONE;
+    SPI(HSPI).SLAVE0 |= SLAVE0_INTS;
+
+    if (slave0 & SPI_SLAVE0_WR_BUF_DONE) {
+        if (rx_head - rx_tail < SPI_SLAVE_RX_CHUNKS) {
+            uint32_t *dst = rx_ring[rx_head % SPI_SLAVE_RX_CHUNKS];
+            volatile uint32_t *w = &SPI(HSPI).W0;
+            for (int i = 0; i < SPI_SLAVE_CHUNK / 4; i++)
+                dst[i] = w[i];
+            rx_head++;
+            rx_count++;
+            wake = true;
+        } else {
+            stats.rx_overruns++;
+        }
+        update_status();
+    }
+    if (slave0 & SPI_SLAVE0_RD_BUF_DONE) {
+        if (load_chunk())
+            wake = true;
+    }
+
+    if (wake) {
+        portBASE_TYPE woken = pdFALSE;
+        vTaskNotifyGiveFromISR(task, &woken);
+        if (woken)
+            portYIELD();
+    }
+}
+
+/* Reassembly, in the task */
+static struct pbuf *rx_p;
+static size_t rx_off;
+static uint8_t rx_cmd, rx_seq;
+static bool rx_skip;            /* dropping the rest of a frame */
+
+static void rx_chunk(const uint8_t *c)
+{
+    size_t n = c[0] & ~SPI_SLAVE_CHUNK_FIRST;
+    const uint8_t *data = c + 1;
+
+    if (n > CHUNK_DATA) {
+        stats.rx_errors++;
+        return;
+    }
+    if (c[0] & SPI_SLAVE_CHUNK_FIRST) {
+        if (rx_p) {
+            /* The last one was cut short */
+            pbuf_free(rx_p);
+            rx_p = NULL;
+            stats.rx_errors++;
+        }
+        rx_skip = false;
+        if (n < HEADER_LEN) {
+            stats.rx_errors++;
+            return;
+        }
+        rx_cmd = data[0];
+        rx_seq = data[1];
+        size_t len = data[2] | (data[3] << 8);
+        data += HEADER_LEN;
+        n -= HEADER_LEN;
+        rx_p = len <= SPI_SLAVE_MAX_FRAME ? pbuf_alloc(PBUF_RAW, len, PBUF_RAM) : NULL;
+        if (!rx_p) {
+            stats.rx_errors++;
+            rx_skip = true;
+            return;
+        }
+        rx_off = 0;
+    } else if (!rx_p) {
+        if (!rx_skip)
+            stats.rx_errors++;
+        return;
+    }
+
+    if (n > rx_p->len - rx_off) {
+        pbuf_free(rx_p);
+        rx_p = NULL;
+        stats.rx_errors++;
+        return;
+    }
+    memcpy((uint8_t *)rx_p->payload + rx_off, data, n);
+    rx_off += n;
+    if (rx_off == rx_p->len) {
+        struct pbuf *p = rx_p;
+        rx_p = NULL;
+        stats.rx_frames++;
+        handler(rx_cmd, rx_seq, p);
+    }
+}
+
+static void spi_slave_task(void *pvParameters)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        while (tx_freed != tx_cur) {
+            pbuf_free(txq[tx_freed % SPI_SLAVE_TX_QUEUE].p);
+            tx_freed++;
+        }
+
+        while (rx_tail != rx_head) {
+            rx_chunk((const uint8_t *)rx_ring[rx_tail % SPI_SLAVE_RX_CHUNKS]);
+            taskENTER_CRITICAL();
+            rx_tail++;
+            update_status();
+            taskEXIT_CRITICAL();
+        }
+    }
+}
+
+bool spi_slave_init(spi_mode_t mode, spi_slave_handler_t h, unsigned priority, int8_t ready_gpio)
+{
+    handler = h;
+    ready_pin = ready_gpio;
+    if (!task && xTaskCreate(spi_slave_task, (signed char *)"spislave", 256, NULL, priority, &task) != pdPASS)
+        return false;
+
+    iomux_set_function(gpio_to_iomux(12), IOMUX_GPIO12_FUNC_SPI1_Q_MISO);
+    iomux_set_function(gpio_to_iomux(13), IOMUX_GPIO13_FUNC_SPI1_D_MOSI);
+    iomux_set_function(gpio_to_iomux(14), IOMUX_GPIO14_FUNC_SPI1_CLK);
+    iomux_set_function(gpio_to_iomux(15), IOMUX_GPIO15_FUNC_SPI1_CS0);
+    if (ready_pin >= 0)
+        gpio_enable(ready_pin, GPIO_OUTPUT);
+
+    _xt_isr_mask(BIT(INUM_SPI));
+
+    /* Slave with the fixed commands, 8 bit command and address, 32 bit
+       status, 32 byte buffers: written into W0..W7, read from W8..W15 */
+    SPI(HSPI).CLOCK = 0;
+    SPI(HSPI).CTRL0 = 0;
+    SPI(HSPI).USER0 = SPI_USER0_MISO_HIGHPART;
+    SPI(HSPI).USER1 = 0;
+    SPI(HSPI).USER2 = VAL2FIELD_M(SPI_USER2_COMMAND_BITLEN, 7);
+    SPI(HSPI).SLAVE0 = SPI_SLAVE0_MODE | SPI_SLAVE0_WR_RD_BUF_EN | SPI_SLAVE0_WR_RD_STA_EN;
+    SPI(HSPI).SLAVE1 = VAL2FIELD_M(SPI_SLAVE1_STATUS_BITLEN, 31) |
+                       VAL2FIELD_M(SPI_SLAVE1_BUF_BITLEN, SPI_SLAVE_CHUNK * 8 - 1) |
+                       VAL2FIELD_M(SPI_SLAVE1_RD_ADDR_BITLEN, 7) |
+                       VAL2FIELD_M(SPI_SLAVE1_WR_ADDR_BITLEN, 7);
+    SPI(HSPI).SLAVE2 = 0;
+    spi_set_mode(HSPI, mode);
+    spi_set_msb(HSPI, true);
+    spi_set_endianness(HSPI, SPI_LITTLE_ENDIAN);
+
+    tx_loaded = tx_started = false;
+    update_status();
+    SPI(HSPI).SLAVE0 &= ~SLAVE0_DONE;
+    SPI(HSPI).SLAVE0 |= SLAVE0_INTS;
+
+    _xt_isr_attach(INUM_SPI, spi_slave_isr);
+    _xt_isr_unmask(BIT(INUM_SPI));
+    return true;
+}
+
+bool spi_slave_send(uint8_t cmd, uint8_t seq, struct pbuf *p)
+{
+    bool queued = false, finished = false;
+
+    pbuf_ref(p);
+    taskENTER_CRITICAL();
+    if (tx_head - tx_freed < SPI_SLAVE_TX_QUEUE) {
+        tx_frame_t *f = &txq[tx_head % SPI_SLAVE_TX_QUEUE];
+        f->p = p;
+        f->cmd = cmd;
+        f->seq = seq;
+        tx_head++;
+        queued = true;
+        /* Idle, so there's no read to come that would load it */
+        if (!tx_loaded)
+            finished = load_chunk();
+    }
+    taskEXIT_CRITICAL();
+
+    if (!queued)
+        pbuf_free(p);
+    else if (finished)
+        xTaskNotifyGive(task);
+    return queued;
+}
+
+bool spi_slave_send_data(uint8_t cmd, uint8_t seq, const void *data, size_t len)
+{
+    if (len > 0xffff)
+        return false;
+    struct pbuf *p = pbuf_alloc(PBUF_RAW, len, PBUF_RAM);
+    if (!p)
+        return false;
+    memcpy(p->payload, data, len);
+    bool queued = spi_slave_send(cmd, seq, p);
+    pbuf_free(p);
+    return queued;
+}
+
+void spi_slave_stats(spi_slave_stats_t *out)
+{
+    *out = stats;
+}
@@ -0,0 +1,113 @@
+/* HSPI slave link to a host MCU
+ *
+ * For an ESP8266 working as a network co-processor: the host is SPI
+ * master and exchanges frames with the ESP8266 over HSPI, using the
+ * slave controller's 32 byte buffers and status register, without a
+ * UART in the way.
+ *
+ * The host uses the controller's four fixed commands, each an 8 bit
+ * command followed by an 8 bit address (ignored, send 0):
+ *
+ *     0x01 write status  (not used by this driver)
+ *     0x02 write buffer, then 32 bytes host -> ESP8266
+ *     0x03 read buffer, then 32 bytes ESP8266 -> host
+ *     0x04 read status, then 32 bits ESP8266 -> host
+ *
+ * Bytes go least significant first out of each 32 bit buffer word, so
+ * byte 0 of a transfer is the first on the wire. Each 32 byte chunk's
+ * byte 0 is SPI_SLAVE_CHUNK_FIRST on a frame's first chunk plus the
+ * number of bytes after it that mean anything (up to 31). A frame's
+ * first chunk then starts with a 4 byte header: command, sequence
+ * number and the payload length, little endian 16 bit.
+ *
+ * The status word says what the host may do next. It writes a chunk
+ * when RX_READY is set and RX_COUNT has moved on from its last write
+ * (so the driver has taken that one), and reads one when TX_READY is
+ * set and TX_COUNT has moved on from its last read. Optionally a GPIO
+ * goes high while a chunk is waiting, for a host interrupt.
+ *
+ * Received frames are reassembled into a pbuf and passed to the handler
+ * in the driver's task. Frames are sent from pbufs: spi_slave_send()
+ * takes a reference and the interrupt copies each chunk from the pbuf's
+ * payload straight into the slave buffer, so a packet lwIP received can
+ * be forwarded to the host without another copy. Responses to commands
+ * are frames like any other; by convention they echo the command's
+ * sequence number.
+ *
+ * Pins are fixed: MISO GPIO12, MOSI GPIO13, SCLK GPIO14, CS GPIO15
+ * (which must be pulled low at boot, as for any HSPI use).
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _SPI_SLAVE_H
+#define _SPI_SLAVE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <esp/spi.h>
+#include <lwip/pbuf.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/* Frames queued to send at once */
+#ifndef SPI_SLAVE_TX_QUEUE
+#define SPI_SLAVE_TX_QUEUE 8
+#endif
+
+/* Received chunks buffered for the task, 32 bytes each */
+#ifndef SPI_SLAVE_RX_CHUNKS
+#define SPI_SLAVE_RX_CHUNKS 16
+#endif
+
+/* Longest frame payload accepted from the host */
+#ifndef SPI_SLAVE_MAX_FRAME
+#define SPI_SLAVE_MAX_FRAME 2048
+#endif
+
+#define SPI_SLAVE_CHUNK 32
+#define SPI_SLAVE_CHUNK_FIRST 0x80
+
+/* The status word */
+#define SPI_SLAVE_STATUS_TX_READY   BIT(0)
+#define SPI_SLAVE_STATUS_RX_READY   BIT(1)
+#define SPI_SLAVE_STATUS_TX_COUNT_M 0x000000ff
+#define SPI_SLAVE_STATUS_TX_COUNT_S 8
+#define SPI_SLAVE_STATUS_RX_COUNT_M 0x000000ff
+#define SPI_SLAVE_STATUS_RX_COUNT_S 16
+
+/* Called in the driver's task for each frame received. The handler
+   owns 'p' (a single pbuf) and must pbuf_free() it. */
+typedef void (*spi_slave_handler_t)(uint8_t cmd, uint8_t seq, struct pbuf *p);
+
+typedef struct {
+    uint32_t rx_frames;
+    uint32_t tx_frames;
+    uint32_t rx_errors;         /* bad chunks, or frames too long or out of memory */
+    uint32_t rx_overruns;       /* chunks written while RX_READY was clear */
+} spi_slave_stats_t;
+
+/* Take over HSPI as a slave in 'mode' and start the driver's task at
+   'priority'. 'ready_gpio' is the host interrupt pin, or -1 for none.
+   Returns false if out of memory. */
+bool spi_slave_init(spi_mode_t mode, spi_slave_handler_t handler, unsigned priority, int8_t ready_gpio);
+
+/* Queue 'p' (a chain, up to 65535 bytes) to send as one frame. Takes a
+   reference, so the caller still frees its own. Returns false if the
+   queue is full. Any task. */
+bool spi_slave_send(uint8_t cmd, uint8_t seq, struct pbuf *p);
+
+/* Copy 'len' bytes into a new pbuf and send that */
+bool spi_slave_send_data(uint8_t cmd, uint8_t seq, const void *data, size_t len);
+
+void spi_slave_stats(spi_slave_stats_t *stats);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _SPI_SLAVE_H */
@@ -0,0 +1,9 @@
+# Component makefile for extras/udpbatch
+
+# expected anyone using udpbatch includes it as 'udpbatch/udpbatch.h'
+INC_DIRS += $(udpbatch_ROOT)..
+
+# args for passing into compile rule generation
+udpbatch_SRC_DIR =  $(udpbatch_ROOT)
+
+$(eval $(call component_compile_rules,udpbatch))
@@ -0,0 +1,81 @@
+/* Send many UDP datagrams in one call into the stack, see udpbatch.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "udpbatch.h"
+
+#include <string.h>
+
+#include <lwip/api_msg.h>
+#include <lwip/tcpip.h>
+#include <lwip/udp.h>
+
+/* An api_msg as netconn calls post, with the batch after it. Going
+   through TCPIP_APIMSG() means the caller waits on the netconn's own
+   semaphore, and with LWIP_TCPIP_CORE_LOCKING the batch runs in the
+   calling task. */
+struct batch_msg {
+    struct api_msg api;
+    const udp_batch_entry_t *entries;
+    size_t n;
+    size_t sent;
+};
+
+static void do_batch(struct api_msg_msg *m)
+{
+    struct batch_msg *b = (struct batch_msg *)((char *)m - offsetof(struct api_msg, msg));
+
+    if (NETCONNTYPE_GROUP(m->conn->type) != NETCONN_UDP || !m->conn->pcb.udp) {
+        m->err = ERR_CONN;
+        TCPIP_APIMSG_ACK(m);
+        return;
+    }
+
+    struct udp_pcb *pcb = m->conn->pcb.udp;
+    m->err = ERR_OK;
+    for (size_t i = 0; i < b->n; i++) {
+        const udp_batch_entry_t *e = &b->entries[i];
+        err_t err;
+
+        /* Room for the UDP, IP and link headers in front, so
+           udp_sendto() doesn't chain a header pbuf and the MAC gets
+           one contiguous buffer */
+        struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, e->len, PBUF_RAM);
+        if (p) {
+            MEMCPY(p->payload, e->data, e->len);
+            err = e->addr ? udp_sendto(pcb, p, e->addr, e->port) : udp_send(pcb, p);
+            pbuf_free(p);
+        } else {
+            err = ERR_MEM;
+        }
+
+        if (err == ERR_OK)
+            b->sent++;
+        else if (m->err == ERR_OK)
+            m->err = err;
+    }
+    TCPIP_APIMSG_ACK(m);
+}
+
+err_t udp_send_batch(struct netconn *conn, const udp_batch_entry_t *entries, size_t n,
+                     size_t *sent)
+{
+    struct batch_msg b;
+    err_t err = ERR_OK;
+
+    b.sent = 0;
+    if (!conn) {
+        err = ERR_ARG;
+    } else if (n) {
+        b.api.function = do_batch;
+        b.api.msg.conn = conn;
+        b.entries = entries;
+        b.n = n;
+        err = TCPIP_APIMSG(&b.api);
+    }
+    if (sent)
+        *sent = b.sent;
+    return err;
+}
@@ -0,0 +1,52 @@
+/* Send many UDP datagrams in one call into the stack
+ *
+ * Sending to a list of collectors (or a list of readings to one) with
+ * netconn_send() costs a netbuf, a pbuf and a message to tcpip_thread
+ * (two context switches) per datagram. udp_send_batch() sends a whole
+ * array of them in one tcpip_thread call, each payload copied once into
+ * a pbuf that leaves room for the headers, so it goes to the MAC as a
+ * single buffer without another copy.
+ *
+ *     udp_batch_entry_t batch[] = {
+ *         { &collector1, 8005, msg, len },
+ *         { &collector2, 8005, msg, len },
+ *     };
+ *     udp_send_batch(conn, batch, 2, NULL);
+ *
+ * (The same payload still needs a pbuf per datagram: the MAC keeps a
+ * reference to each frame until it's on air.)
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _UDPBATCH_H
+#define _UDPBATCH_H
+
+#include <stddef.h>
+#include <lwip/api.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    ip_addr_t *addr;        /* NULL for the netconn's connected peer */
+    u16_t port;             /* ignored when addr is NULL */
+    const void *data;       /* may be in flash */
+    u16_t len;
+} udp_batch_entry_t;
+
+/* Send the n datagrams in 'entries' from the UDP netconn 'conn', in
+   order, in a single call into tcpip_thread. All are tried even if
+   some fail. Returns ERR_OK if all were sent, or the first error; if
+   'sent' isn't NULL it's set to how many were. Buffers only need to
+   stay valid until this returns. */
+err_t udp_send_batch(struct netconn *conn, const udp_batch_entry_t *entries, size_t n,
+                     size_t *sent);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _UDPBATCH_H */
@@ -0,0 +1,9 @@
+# Component makefile for extras/udpring
+
+# expected anyone using udpring includes it as 'udpring/udpring.h'
+INC_DIRS += $(udpring_ROOT)..
+
+# args for passing into compile rule generation
+udpring_SRC_DIR =  $(udpring_ROOT)
+
+$(eval $(call component_compile_rules,udpring))
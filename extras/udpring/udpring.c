@@ -0,0 +1,185 @@
+/* UDP receive into a ring of pbufs, see udpring.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "udpring.h"
+
+#include <string.h>
+
+#include <lwip/udp.h>
+#include <lwip/tcpip.h>
+#include <lwip/sys.h>
+
+#if (UDPRING_SIZE & (UDPRING_SIZE - 1)) != 0
+#error "UDPRING_SIZE must be a power of two"
+#endif
+
+/* udpring_open() and close() arguments, run in tcpip_thread */
+struct ring_call {
+    udpring_t *r;
+    ip_addr_t *local;
+    u16_t port;
+    err_t err;
+    sys_sem_t done;
+};
+
+static void recv_cb(void *arg, struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *addr, u16_t port)
+{
+    udpring_t *r = arg;
+
+    if (r->filter && !r->filter(r->filter_arg, p, addr, port)) {
+        r->stats.filtered++;
+        pbuf_free(p);
+        return;
+    }
+
+    uint32_t h = r->head;
+    uint32_t queued = h - r->tail;
+    if (queued >= UDPRING_SIZE) {
+        r->stats.dropped++;
+        pbuf_free(p);
+        return;
+    }
+
+    udpring_packet_t *pkt = &r->ring[h & (UDPRING_SIZE - 1)];
+    pkt->p = p;
+    ip_addr_set(&pkt->addr, addr);
+    pkt->port = port;
+
+    /* The slot must be filled before the consumer can see it */
+    __asm__ volatile ("" ::: "memory");
+    r->head = h + 1;
+    r->stats.received++;
+    if (queued + 1 > r->stats.high_water)
+        r->stats.high_water = queued + 1;
+
+    xTaskHandle task = r->waiter;
+    if (task) {
+        r->waiter = NULL;
+        xTaskNotifyGive(task);
+    }
+}
+
+static void open_cb(void *arg)
+{
+    struct ring_call *call = arg;
+    udpring_t *r = call->r;
+
+    r->pcb = udp_new();
+    if (!r->pcb) {
+        call->err = ERR_MEM;
+    } else {
+        call->err = udp_bind(r->pcb, call->local, call->port);
+        if (call->err == ERR_OK) {
+            udp_recv(r->pcb, recv_cb, r);
+        } else {
+            udp_remove(r->pcb);
+            r->pcb = NULL;
+        }
+    }
+    sys_sem_signal(&call->done);
+}
+
+static void close_cb(void *arg)
+{
+    struct ring_call *call = arg;
+
+    call->err = ERR_OK;
+    if (call->r->pcb) {
+        udp_remove(call->r->pcb);
+        call->r->pcb = NULL;
+    }
+    sys_sem_signal(&call->done);
+}
+
+static err_t call_tcpip(tcpip_callback_fn fn, struct ring_call *call)
+{
+    if (sys_sem_new(&call->done, 0) != ERR_OK)
+        return ERR_MEM;
+    /* 'fn' sets call->err, possibly before tcpip_callback() returns */
+    err_t err = tcpip_callback(fn, call);
+    if (err == ERR_OK) {
+        sys_sem_wait(&call->done);
+        err = call->err;
+    }
+    sys_sem_free(&call->done);
+    return err;
+}
+
+err_t udpring_open(udpring_t *r, ip_addr_t *local, u16_t port,
+                   udpring_filter_t filter, void *filter_arg)
+{
+    memset(r, 0, sizeof(*r));
+    r->filter = filter;
+    r->filter_arg = filter_arg;
+
+    struct ring_call call = { .r = r, .local = local, .port = port };
+    return call_tcpip(open_cb, &call);
+}
+
+void udpring_close(udpring_t *r)
+{
+    struct ring_call call = { .r = r };
+
+    if (call_tcpip(close_cb, &call) != ERR_OK)
+        return;  /* still receiving, the ring can't be emptied */
+    udpring_release(r, r->head - r->tail);
+}
+
+size_t udpring_peek(udpring_t *r, udpring_packet_t **pkts)
+{
+    uint32_t t = r->tail;
+    uint32_t queued = r->head - t;
+    uint32_t index = t & (UDPRING_SIZE - 1);
+
+    __asm__ volatile ("" ::: "memory");
+    if (queued > UDPRING_SIZE - index)
+        queued = UDPRING_SIZE - index;
+    *pkts = &r->ring[index];
+    return queued;
+}
+
+size_t udpring_wait(udpring_t *r, udpring_packet_t **pkts, uint32_t timeout_ms)
+{
+    size_t n = udpring_peek(r, pkts);
+
+    if (n || !timeout_ms)
+        return n;
+
+    /* Register, then check again so a datagram arriving in between
+       isn't missed */
+    ulTaskNotifyTake(pdTRUE, 0);
+    r->waiter = xTaskGetCurrentTaskHandle();
+    n = udpring_peek(r, pkts);
+    if (!n) {
+        ulTaskNotifyTake(pdTRUE, timeout_ms / portTICK_RATE_MS);
+        n = udpring_peek(r, pkts);
+    }
+    r->waiter = NULL;
+    return n;
+}
+
+void udpring_release(udpring_t *r, size_t n)
+{
+    uint32_t t = r->tail;
+
+    if (n > r->head - t)
+        n = r->head - t;
+    for (size_t i = 0; i < n; i++) {
+        udpring_packet_t *pkt = &r->ring[(t + i) & (UDPRING_SIZE - 1)];
+        pbuf_free(pkt->p);
+        pkt->p = NULL;
+    }
+    /* Done with the slots before tcpip_thread may refill them */
+    __asm__ volatile ("" ::: "memory");
+    r->tail = t + n;
+}
+
+void udpring_get_stats(udpring_t *r, udpring_stats_t *stats)
+{
+    taskENTER_CRITICAL();
+    *stats = r->stats;
+    taskEXIT_CRITICAL();
+}
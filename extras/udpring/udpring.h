@@ -0,0 +1,115 @@
+/* UDP receive into a ring of pbufs, on the lwIP raw API
+ *
+ * For receiving many small datagrams (telemetry from lots of nodes):
+ * a raw API receive callback in tcpip_thread puts each datagram's pbuf
+ * straight into a fixed ring, and a consumer task takes them out in
+ * batches, reading them in place. Compared to a netconn there's no
+ * netbuf allocated per datagram, no recvmbox (of only
+ * DEFAULT_UDP_RECVMBOX_SIZE entries) to overflow, and the consumer
+ * wakes once per batch rather than once per datagram:
+ *
+ *     static udpring_t ring;
+ *     udpring_open(&ring, IP_ADDR_ANY, 8005, NULL, NULL);
+ *     for (;;) {
+ *         udpring_packet_t *pkts;
+ *         size_t n = udpring_wait(&ring, &pkts, 1000);
+ *         for (size_t i = 0; i < n; i++)
+ *             handle(pkts[i].p, &pkts[i].addr, pkts[i].port);
+ *         udpring_release(&ring, n);
+ *     }
+ *
+ * The ring has a single producer (tcpip_thread) and a single consumer
+ * task, so neither side takes a lock. Datagrams arriving while it's
+ * full are freed and counted as dropped.
+ *
+ * The pbufs are the ones the stack received into, not copies, so a
+ * datagram in the ring holds its receive buffer until it's released.
+ * Release batches promptly, or copy out what needs keeping for longer.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _UDPRING_H
+#define _UDPRING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <lwip/err.h>
+#include <lwip/ip_addr.h>
+#include <lwip/pbuf.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/* Datagrams in each ring, a power of two */
+#ifndef UDPRING_SIZE
+#define UDPRING_SIZE 16
+#endif
+
+typedef struct {
+    struct pbuf *p;          /* the payload, possibly a chain */
+    ip_addr_t addr;          /* sender */
+    u16_t port;
+} udpring_packet_t;
+
+typedef struct {
+    uint32_t received;       /* datagrams put in the ring */
+    uint32_t dropped;        /* datagrams lost to a full ring */
+    uint32_t filtered;       /* datagrams the filter turned down */
+    uint16_t high_water;     /* most datagrams ever queued at once */
+} udpring_stats_t;
+
+/* Optional filter, called in tcpip_thread for each datagram before it's
+   queued. Return false to drop it (the pbuf is freed). Keep it short,
+   the stack waits for it. */
+typedef bool (*udpring_filter_t)(void *arg, struct pbuf *p, ip_addr_t *addr, u16_t port);
+
+typedef struct {
+    struct udp_pcb *pcb;
+    udpring_filter_t filter;
+    void *filter_arg;
+    volatile uint32_t head;  /* written by tcpip_thread */
+    volatile uint32_t tail;  /* written by the consumer */
+    xTaskHandle volatile waiter;
+    udpring_stats_t stats;
+    udpring_packet_t ring[UDPRING_SIZE];
+} udpring_t;
+
+/* Bind a UDP pcb to local:port and start queuing what it receives.
+   'filter' may be NULL. Call from a task, not tcpip_thread. Returns
+   ERR_OK, or the bind error. */
+err_t udpring_open(udpring_t *r, ip_addr_t *local, u16_t port,
+                   udpring_filter_t filter, void *filter_arg);
+
+/* Stop receiving and free anything still queued. Call from the
+   consumer task (or once it no longer touches the ring). */
+void udpring_close(udpring_t *r);
+
+/* Consumer side: point '*pkts' at the oldest datagrams in the ring and
+   return how many there are, without copying. The run is contiguous in
+   the ring, so this may return fewer than are queued when it wraps;
+   call again after releasing. Returns 0 if the ring is empty. */
+size_t udpring_peek(udpring_t *r, udpring_packet_t **pkts);
+
+/* udpring_peek(), blocking up to timeout_ms for the ring to be non
+   empty. Uses the calling task's notification (see ulTaskNotifyTake()),
+   only one task may wait on a ring at a time. */
+size_t udpring_wait(udpring_t *r, udpring_packet_t **pkts, uint32_t timeout_ms);
+
+/* Free the first n datagrams returned by peek or wait, giving their
+   slots back to the ring */
+void udpring_release(udpring_t *r, size_t n);
+
+void udpring_get_stats(udpring_t *r, udpring_stats_t *stats);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _UDPRING_H */
@@ -0,0 +1,12 @@
+# Component makefile for extras/websocket
+#
+# The server (ws_server.h) also needs extras/httpd in EXTRA_COMPONENTS,
+# a TLS client (wsclient.h) extras/mbedtls.
+
+# expected anyone using websocket includes it as 'websocket/websocket.h'
+INC_DIRS += $(websocket_ROOT)..
+
+# args for passing into compile rule generation
+websocket_SRC_DIR =  $(websocket_ROOT)
+
+$(eval $(call component_compile_rules,websocket))
@@ -0,0 +1,109 @@
+/* WebSocket (RFC 6455) framing, shared by the server and client
+ *
+ * The parser takes received data a piece at a time, wherever it lands
+ * (a pbuf payload, a TLS record buffer), unmasks payload in place and
+ * hands it on straight from there. Nothing is buffered except frame
+ * headers split across pieces and control frame payloads (at most 125
+ * bytes), so a message of any length can stream through: its data
+ * arrives as a series of pieces, the first flagged 'first' and the
+ * last 'last', whether it was sent as one frame or fragmented into
+ * several.
+ *
+ * See ws_server.h and wsclient.h for the two ends of a connection.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _WEBSOCKET_H
+#define _WEBSOCKET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#define WS_OP_CONTINUATION 0x0
+#define WS_OP_TEXT         0x1
+#define WS_OP_BINARY       0x2
+#define WS_OP_CLOSE        0x8
+#define WS_OP_PING         0x9
+#define WS_OP_PONG         0xa
+
+/* Close status codes */
+#define WS_CLOSE_NORMAL     1000
+#define WS_CLOSE_GOING_AWAY 1001
+#define WS_CLOSE_PROTOCOL   1002
+#define WS_CLOSE_TOO_BIG    1009
+
+/* Longest frame header, and the longest control frame payload */
+#define WS_HEADER_MAX  14
+#define WS_CONTROL_MAX 125
+
+/* Length of a Sec-WebSocket-Accept value, with its NUL */
+#define WS_ACCEPT_LEN 29
+
+/* Piece 'data' of a text or binary message. 'first' is set on the
+   first piece of each message, 'last' on its last one (possibly with
+   len 0). The data may be changed, it's only valid during the call.
+   Return 0 to carry on, anything else stops ws_parse() and is
+   returned from it. */
+typedef int (*ws_data_fn)(void *arg, uint8_t opcode, uint8_t *data, size_t len,
+                          bool first, bool last);
+
+/* A whole control frame (close, ping or pong), returned as above */
+typedef int (*ws_control_fn)(void *arg, uint8_t opcode, uint8_t *data, size_t len);
+
+typedef struct {
+    ws_data_fn data;
+    ws_control_fn control;
+    void *arg;
+    bool masked;            /* frames must be masked (true for a server) */
+
+    uint8_t hdr[WS_HEADER_MAX];
+    uint8_t hdr_len;        /* bytes of the header so far */
+    uint8_t opcode;         /* of the frame being received */
+    bool fin;
+    bool in_message;        /* between the first and the last frame of a message */
+    bool msg_started;       /* a piece of the message has been given */
+    uint8_t msg_opcode;
+    uint8_t mask[4];
+    uint8_t mask_pos;
+    uint32_t left;          /* payload left in the frame, once the header is in */
+    uint8_t ctrl_len;
+    uint8_t ctrl[WS_CONTROL_MAX];
+} ws_parser_t;
+
+/* Returned from ws_parse() for a malformed frame, the connection should
+   be closed with WS_CLOSE_PROTOCOL */
+#define WS_ERR_PROTOCOL (-1)
+
+void ws_parser_init(ws_parser_t *p, bool masked, ws_data_fn data, ws_control_fn control, void *arg);
+
+/* Parse the next 'len' received bytes, unmasking them in place. Returns
+   0, WS_ERR_PROTOCOL or what a callback stopped with. */
+int ws_parse(ws_parser_t *p, uint8_t *buf, size_t len);
+
+/* Write the header for a frame of 'len' bytes into 'hdr' (at least
+   WS_HEADER_MAX long), masked with 'mask' unless that's NULL. Returns
+   its length. */
+size_t ws_frame_header(uint8_t *hdr, uint8_t opcode, bool fin, size_t len, const uint8_t *mask);
+
+/* XOR 'len' bytes with the mask from position 'pos' (0-3), returns the
+   position to carry on from */
+uint8_t ws_mask(uint8_t *data, size_t len, const uint8_t mask[4], uint8_t pos);
+
+/* Compute the Sec-WebSocket-Accept value for a Sec-WebSocket-Key */
+void ws_accept_key(const char *key, size_t key_len, char accept[WS_ACCEPT_LEN]);
+
+/* Base64 of 'len' bytes into 'out' (4 * ((len + 2) / 3) + 1 long) */
+void ws_base64(const uint8_t *data, size_t len, char *out);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _WEBSOCKET_H */
@@ -0,0 +1,300 @@
+/* WebSocket framing, see websocket.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "websocket.h"
+
+#include <string.h>
+
+/* For unmasking a word at a time in buffers of bytes */
+typedef uint32_t __attribute__((may_alias)) word_t;
+
+static const char ws_guid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+void ws_parser_init(ws_parser_t *p, bool masked, ws_data_fn data, ws_control_fn control, void *arg)
+{
+    memset(p, 0, sizeof(*p));
+    p->masked = masked;
+    p->data = data;
+    p->control = control;
+    p->arg = arg;
+}
+
+/* Header length, as far as the bytes so far tell */
+static uint8_t header_need(const ws_parser_t *p)
+{
+    if (p->hdr_len < 2)
+        return 2;
+    uint8_t n = 2;
+    uint8_t len7 = p->hdr[1] & 0x7f;
+    if (len7 == 126)
+        n += 2;
+    else if (len7 == 127)
+        n += 8;
+    if (p->hdr[1] & 0x80)
+        n += 4;
+    return n;
+}
+
+/* The header is complete, check it and set up for the payload */
+static int start_frame(ws_parser_t *p)
+{
+    const uint8_t *h = p->hdr;
+
+    if (h[0] & 0x70)
+        return WS_ERR_PROTOCOL;  /* no extensions negotiated */
+    if (!(h[1] & 0x80) != !p->masked)
+        return WS_ERR_PROTOCOL;
+    p->fin = h[0] & 0x80;
+    p->opcode = h[0] & 0x0f;
+
+    uint8_t len7 = h[1] & 0x7f;
+    const uint8_t *ext = h + 2;
+    if (len7 == 126) {
+        p->left = ext[0] << 8 | ext[1];
+        ext += 2;
+    } else if (len7 == 127) {
+        if (ext[0] | ext[1] | ext[2] | ext[3])
+            return WS_ERR_PROTOCOL;
+        p->left = (uint32_t)ext[4] << 24 | ext[5] << 16 | ext[6] << 8 | ext[7];
+        ext += 8;
+    } else {
+        p->left = len7;
+    }
+    if (p->masked)
+        memcpy(p->mask, ext, 4);
+    p->mask_pos = 0;
+
+    switch (p->opcode) {
+    case WS_OP_CLOSE:
+    case WS_OP_PING:
+    case WS_OP_PONG:
+        /* May come between the frames of a message, never fragmented */
+        if (!p->fin || p->left > WS_CONTROL_MAX)
+            return WS_ERR_PROTOCOL;
+        p->ctrl_len = 0;
+        return 0;
+    case WS_OP_CONTINUATION:
+        if (!p->in_message)
+            return WS_ERR_PROTOCOL;
+        return 0;
+    case WS_OP_TEXT:
+    case WS_OP_BINARY:
+        if (p->in_message)
+            return WS_ERR_PROTOCOL;
+        p->in_message = true;
+        p->msg_started = false;
+        p->msg_opcode = p->opcode;
+        return 0;
+    default:
+        return WS_ERR_PROTOCOL;
+    }
+}
+
+int ws_parse(ws_parser_t *p, uint8_t *buf, size_t len)
+{
+    while (1) {
+        uint8_t need = header_need(p);
+        if (p->hdr_len < need) {
+            /* header_need() grows as the length byte comes in */
+            while (len && p->hdr_len < (need = header_need(p))) {
+                p->hdr[p->hdr_len++] = *buf++;
+                len--;
+            }
+            if (p->hdr_len < header_need(p))
+                return 0;
+            int r = start_frame(p);
+            if (r)
+                return r;
+        }
+
+        size_t n = len < p->left ? len : p->left;
+        if (p->masked)
+            p->mask_pos = ws_mask(buf, n, p->mask, p->mask_pos);
+        p->left -= n;
+
+        int r = 0;
+        if (p->opcode & 0x8) {
+            memcpy(p->ctrl + p->ctrl_len, buf, n);
+            p->ctrl_len += n;
+            if (!p->left)
+                r = p->control(p->arg, p->opcode, p->ctrl, p->ctrl_len);
+        } else {
+            bool last = p->fin && !p->left;
+            if (n || last) {
+                bool first = !p->msg_started;
+                p->msg_started = true;
+                if (last)
+                    p->in_message = false;
+                r = p->data(p->arg, p->msg_opcode, buf, n, first, last);
+            }
+        }
+        buf += n;
+        len -= n;
+        if (!p->left)
+            p->hdr_len = 0;
+        if (r)
+            return r;
+        if (!len)
+            return 0;
+    }
+}
+
+size_t ws_frame_header(uint8_t *hdr, uint8_t opcode, bool fin, size_t len, const uint8_t *mask)
+{
+    size_t n;
+    uint8_t m = mask ? 0x80 : 0;
+
+    hdr[0] = (fin ? 0x80 : 0) | opcode;
+    if (len < 126) {
+        hdr[1] = m | len;
+        n = 2;
+    } else if (len <= 0xffff) {
+        hdr[1] = m | 126;
+        hdr[2] = len >> 8;
+        hdr[3] = len;
+        n = 4;
+    } else {
+        uint64_t len64 = len;
+        hdr[1] = m | 127;
+        for (int i = 0; i < 8; i++)
+            hdr[2 + i] = len64 >> (56 - 8 * i);
+        n = 10;
+    }
+    if (mask) {
+        memcpy(hdr + n, mask, 4);
+        n += 4;
+    }
+    return n;
+}
+
+uint8_t ws_mask(uint8_t *data, size_t len, const uint8_t mask[4], uint8_t pos)
+{
+    while (len && ((uintptr_t)data & 3)) {
+        *data++ ^= mask[pos];
+        pos = (pos + 1) & 3;
+        len--;
+    }
+    if (len >= 4) {
+        /* The mask from 'pos' on, as the (little endian) word the next
+           four bytes load as */
+        uint32_t m = mask[pos] | mask[(pos + 1) & 3] << 8 | mask[(pos + 2) & 3] << 16
+                     | (uint32_t)mask[(pos + 3) & 3] << 24;
+        word_t *w = (word_t *)data;
+        for (; len >= 4; len -= 4)
+            *w++ ^= m;
+        data = (uint8_t *)w;
+    }
+    while (len--) {
+        *data++ ^= mask[pos];
+        pos = (pos + 1) & 3;
+    }
+    return pos;
+}
+
+/* SHA-1, only needed for the handshake, so kept here rather than
+   making the server depend on extras/mbedtls */
+#define ROL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+static void sha1_block(uint32_t h[5], const uint8_t *block)
+{
+    uint32_t w[16];
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+
+    for (int i = 0; i < 16; i++)
+        w[i] = (uint32_t)block[4 * i] << 24 | block[4 * i + 1] << 16 | block[4 * i + 2] << 8 | block[4 * i + 3];
+    for (int i = 0; i < 80; i++) {
+        if (i >= 16)
+            w[i & 15] = ROL(w[(i + 13) & 15] ^ w[(i + 8) & 15] ^ w[(i + 2) & 15] ^ w[i & 15], 1);
+        uint32_t f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5a827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ed9eba1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8f1bbcdc;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xca62c1d6;
+        }
+        uint32_t t = ROL(a, 5) + f + e + k + w[i & 15];
+        e = d;
+        d = c;
+        c = ROL(b, 30);
+        b = a;
+        a = t;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+}
+
+static void sha1(const uint8_t *data, size_t len, uint8_t digest[20])
+{
+    uint32_t h[5] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+    uint8_t block[64];
+    size_t total = len;
+
+    for (; len >= 64; data += 64, len -= 64)
+        sha1_block(h, data);
+    memcpy(block, data, len);
+    block[len++] = 0x80;
+    if (len > 56) {
+        memset(block + len, 0, 64 - len);
+        sha1_block(h, block);
+        len = 0;
+    }
+    memset(block + len, 0, 56 - len);
+    uint64_t bits = (uint64_t)total * 8;
+    for (int i = 0; i < 8; i++)
+        block[56 + i] = bits >> (56 - 8 * i);
+    sha1_block(h, block);
+
+    for (int i = 0; i < 20; i++)
+        digest[i] = h[i / 4] >> (24 - 8 * (i & 3));
+}
+
+void ws_base64(const uint8_t *data, size_t len, char *out)
+{
+    static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    for (; len >= 3; data += 3, len -= 3) {
+        *out++ = digits[data[0] >> 2];
+        *out++ = digits[(data[0] & 3) << 4 | data[1] >> 4];
+        *out++ = digits[(data[1] & 15) << 2 | data[2] >> 6];
+        *out++ = digits[data[2] & 63];
+    }
+    if (len) {
+        *out++ = digits[data[0] >> 2];
+        if (len == 1) {
+            *out++ = digits[(data[0] & 3) << 4];
+            *out++ = '=';
+        } else {
+            *out++ = digits[(data[0] & 3) << 4 | data[1] >> 4];
+            *out++ = digits[(data[1] & 15) << 2];
+        }
+        *out++ = '=';
+    }
+    *out = 0;
+}
+
+void ws_accept_key(const char *key, size_t key_len, char accept[WS_ACCEPT_LEN])
+{
+    /* Keys are 24 characters, the base64 of 16 bytes */
+    uint8_t buf[64 + sizeof(ws_guid) - 1];
+    uint8_t digest[20];
+
+    if (key_len > 64)
+        key_len = 64;
+    memcpy(buf, key, key_len);
+    memcpy(buf + key_len, ws_guid, sizeof(ws_guid) - 1);
+    sha1(buf, key_len + sizeof(ws_guid) - 1, digest);
+    ws_base64(digest, sizeof(digest), accept);
+}
@@ -0,0 +1,296 @@
+/* WebSocket server endpoints, see ws_server.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "ws_server.h"
+
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+
+#include <lwip/tcp.h>
+#include <lwip/tcpip.h>
+#include <lwip/sys.h>
+
+/* tcp_poll() interval, in units of TCP_SLOW_INTERVAL (500 ms) */
+#define POLL_INTERVAL 4
+#define POLL_MS (POLL_INTERVAL * 500)
+#define IDLE_POLLS ((WS_IDLE_TIMEOUT_S * 1000 + POLL_MS - 1) / POLL_MS)
+
+struct ws_conn {
+    struct tcp_pcb *pcb;
+    const ws_handler_t *handler;
+    void *user;
+    uint16_t idle;          /* polls without anything received */
+    bool closing;
+    ws_parser_t parser;
+};
+
+static ws_conn_t conns[WS_MAX_CONNS];
+
+/* Forget the pcb, after which only lwIP's own close goes on */
+static void conn_release(ws_conn_t *c)
+{
+    if (c->pcb) {
+        tcp_arg(c->pcb, NULL);
+        tcp_recv(c->pcb, NULL);
+        tcp_sent(c->pcb, NULL);
+        tcp_err(c->pcb, NULL);
+        tcp_poll(c->pcb, NULL, 0);
+    }
+    c->pcb = NULL;
+}
+
+/* Tell the application, once, that the connection is going */
+static void conn_closed(ws_conn_t *c)
+{
+    const ws_handler_t *h = c->handler;
+
+    c->handler = NULL;
+    if (h && h->on_close)
+        h->on_close(c);
+}
+
+static void conn_close(ws_conn_t *c)
+{
+    conn_closed(c);
+    c->closing = true;
+    tcp_recv(c->pcb, NULL);
+    if (tcp_close(c->pcb) == ERR_OK)
+        conn_release(c);
+}
+
+/* Queue header and payload, all or nothing */
+static err_t queue_frame(ws_conn_t *c, const uint8_t *hdr, size_t hdr_len, const void *data, size_t len)
+{
+    if (tcp_sndbuf(c->pcb) < hdr_len + len || tcp_sndqueuelen(c->pcb) + 2 > TCP_SND_QUEUELEN)
+        return ERR_MEM;
+    err_t err = tcp_write(c->pcb, hdr, hdr_len, TCP_WRITE_FLAG_COPY | (len ? TCP_WRITE_FLAG_MORE : 0));
+    if (err == ERR_OK && len)
+        err = tcp_write(c->pcb, data, len, TCP_WRITE_FLAG_COPY);
+    if (err == ERR_OK)
+        tcp_output(c->pcb);
+    return err;
+}
+
+err_t ws_send_frame(ws_conn_t *c, uint8_t opcode, bool fin, const void *data, size_t len)
+{
+    uint8_t hdr[WS_HEADER_MAX];
+
+    if (!c->pcb || c->closing)
+        return ERR_CLSD;
+    size_t hdr_len = ws_frame_header(hdr, opcode, fin, len, NULL);
+    return queue_frame(c, hdr, hdr_len, data, len);
+}
+
+err_t ws_send(ws_conn_t *c, uint8_t opcode, const void *data, size_t len)
+{
+    return ws_send_frame(c, opcode, true, data, len);
+}
+
+void ws_close(ws_conn_t *c, uint16_t code)
+{
+    uint8_t status[2] = { code >> 8, code };
+
+    if (!c->pcb || c->closing)
+        return;
+    ws_send_frame(c, WS_OP_CLOSE, true, status, sizeof(status));
+    conn_close(c);
+}
+
+void ws_set_user(ws_conn_t *c, void *user)
+{
+    c->user = user;
+}
+
+void *ws_get_user(ws_conn_t *c)
+{
+    return c->user;
+}
+
+static int parser_data(void *arg, uint8_t opcode, uint8_t *data, size_t len, bool first, bool last)
+{
+    ws_conn_t *c = arg;
+
+    if (c->handler && c->handler->on_data)
+        c->handler->on_data(c, opcode, data, len, first, last);
+    /* on_data may have closed it */
+    return c->closing;
+}
+
+static int parser_control(void *arg, uint8_t opcode, uint8_t *data, size_t len)
+{
+    ws_conn_t *c = arg;
+
+    switch (opcode) {
+    case WS_OP_PING:
+        /* Answered if there's room, the peer pings again otherwise */
+        ws_send_frame(c, WS_OP_PONG, true, data, len);
+        return 0;
+    case WS_OP_CLOSE:
+        /* Echo the status code, and we're done */
+        ws_send_frame(c, WS_OP_CLOSE, true, data, len >= 2 ? 2 : 0);
+        conn_close(c);
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static err_t recv_cb(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
+{
+    ws_conn_t *c = arg;
+
+    if (!p) {
+        conn_close(c);
+        return ERR_OK;
+    }
+    c->idle = 0;
+    tcp_recved(pcb, p->tot_len);
+    for (struct pbuf *q = p; q && !c->closing; q = q->next) {
+        if (ws_parse(&c->parser, q->payload, q->len) == WS_ERR_PROTOCOL)
+            ws_close(c, WS_CLOSE_PROTOCOL);
+    }
+    pbuf_free(p);
+    return ERR_OK;
+}
+
+static err_t sent_cb(void *arg, struct tcp_pcb *pcb, u16_t len)
+{
+    ws_conn_t *c = arg;
+
+    if (!c->closing && c->handler && c->handler->on_sent)
+        c->handler->on_sent(c);
+    return ERR_OK;
+}
+
+static err_t poll_cb(void *arg, struct tcp_pcb *pcb)
+{
+    ws_conn_t *c = arg;
+
+    ++c->idle;
+    if (c->closing) {
+        if (tcp_close(pcb) == ERR_OK) {
+            conn_release(c);
+        } else if (c->idle >= IDLE_POLLS) {
+            conn_release(c);
+            tcp_abort(pcb);
+            return ERR_ABRT;
+        }
+    } else if (c->idle >= 2 * IDLE_POLLS) {
+        ws_close(c, WS_CLOSE_GOING_AWAY);
+    } else if (c->idle >= IDLE_POLLS) {
+        ws_send_frame(c, WS_OP_PING, true, NULL, 0);
+    }
+    return ERR_OK;
+}
+
+static void err_cb(void *arg, err_t err)
+{
+    ws_conn_t *c = arg;
+
+    /* The pcb has already been freed */
+    c->pcb = NULL;
+    conn_closed(c);
+}
+
+bool ws_upgrade(struct tcp_pcb *pcb, const httpd_route_t *route,
+                const char *path, const char *query, const char *headers)
+{
+    size_t key_len, version_len, upgrade_len;
+    const char *key = httpd_header(headers, "Sec-WebSocket-Key", &key_len);
+    const char *version = httpd_header(headers, "Sec-WebSocket-Version", &version_len);
+    const char *upgrade = httpd_header(headers, "Upgrade", &upgrade_len);
+
+    if (!key || !version || version_len != 2 || strncmp(version, "13", 2)
+        || !upgrade || upgrade_len != 9 || strncasecmp(upgrade, "websocket", 9))
+        return false;
+
+    ws_conn_t *c = NULL;
+    for (int i = 0; i < WS_MAX_CONNS && !c; i++) {
+        if (!conns[i].pcb)
+            c = &conns[i];
+    }
+    if (!c)
+        return false;
+
+    char accept[WS_ACCEPT_LEN];
+    char response[160];
+    ws_accept_key(key, key_len, accept);
+    int n = snprintf(response, sizeof(response),
+                     "HTTP/1.1 101 Switching Protocols\r\n"
+                     "Upgrade: websocket\r\n"
+                     "Connection: Upgrade\r\n"
+                     "Sec-WebSocket-Accept: %s\r\n\r\n", accept);
+    if (n >= (int)sizeof(response) || tcp_write(pcb, response, n, TCP_WRITE_FLAG_COPY) != ERR_OK)
+        return false;
+    tcp_output(pcb);
+
+    memset(c, 0, sizeof(*c));
+    c->pcb = pcb;
+    c->handler = route->data;
+    ws_parser_init(&c->parser, true, parser_data, parser_control, c);
+    tcp_arg(pcb, c);
+    tcp_recv(pcb, recv_cb);
+    tcp_sent(pcb, sent_cb);
+    tcp_err(pcb, err_cb);
+    tcp_poll(pcb, poll_cb, POLL_INTERVAL);
+
+    if (c->handler->on_open)
+        c->handler->on_open(c, path, query);
+    return true;
+}
+
+typedef struct {
+    sys_sem_t done;
+    const ws_handler_t *handler;
+    uint8_t opcode;
+    const void *data;
+    size_t len;
+    int sent;
+} broadcast_call_t;
+
+static void broadcast_cb(void *arg)
+{
+    broadcast_call_t *call = arg;
+    uint8_t hdr[WS_HEADER_MAX];
+    size_t hdr_len = ws_frame_header(hdr, call->opcode, true, call->len, NULL);
+
+    call->sent = 0;
+    for (int i = 0; i < WS_MAX_CONNS; i++) {
+        ws_conn_t *c = &conns[i];
+        if (!c->pcb || c->closing || !c->handler || (call->handler && c->handler != call->handler))
+            continue;
+        if (queue_frame(c, hdr, hdr_len, call->data, call->len) == ERR_OK)
+            call->sent++;
+    }
+    sys_sem_signal(&call->done);
+}
+
+int ws_broadcast(const ws_handler_t *handler, uint8_t opcode, const void *data, size_t len)
+{
+    broadcast_call_t call = {
+        .handler = handler,
+        .opcode = opcode,
+        .data = data,
+        .len = len,
+    };
+
+    if (sys_sem_new(&call.done, 0) != ERR_OK)
+        return 0;
+    if (tcpip_callback(broadcast_cb, &call) == ERR_OK)
+        sys_sem_wait(&call.done);
+    sys_sem_free(&call.done);
+    return call.sent;
+}
+
+int ws_connections(void)
+{
+    int n = 0;
+
+    for (int i = 0; i < WS_MAX_CONNS; i++)
+        n += conns[i].pcb != NULL && !conns[i].closing;
+    return n;
+}
@@ -0,0 +1,108 @@
+/* WebSocket server endpoints on extras/httpd
+ *
+ * An endpoint is an httpd route whose upgrade requests are taken over
+ * as WebSocket connections:
+ *
+ *   static const ws_handler_t live = { .on_open = live_open, .on_data = live_data };
+ *   static const httpd_route_t routes[] = {
+ *       { "/", "text/html", NULL, index_html, sizeof(index_html) - 1, NULL },
+ *       { .path = "/live", .upgrade = ws_upgrade, .data = &live },
+ *   };
+ *
+ * Like httpd, connections live in tcpip_thread as raw API callbacks.
+ * Each takes a slot of about 190 bytes from a pool of WS_MAX_CONNS,
+ * separate from httpd's (an upgraded connection hands its httpd slot
+ * back). Received frames are unmasked in place in their pbufs and
+ * streamed to on_data a piece at a time (see websocket.h), so messages
+ * of any length get through without a reassembly buffer. Pings are
+ * answered, and a close is echoed and the connection closed.
+ *
+ * ws_broadcast() sends one message to every connection of an endpoint,
+ * building the frame header once: the feed for a live dashboard
+ * formatted once and queued to all its viewers.
+ *
+ * The client must wait for the 101 response before sending frames (as
+ * RFC 6455 says), anything it sends earlier is dropped. No extensions
+ * or subprotocols are negotiated.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _WS_SERVER_H
+#define _WS_SERVER_H
+
+#include "websocket.h"
+#include "httpd/httpd.h"
+
+#include <lwip/err.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifndef WS_MAX_CONNS
+#define WS_MAX_CONNS 8
+#endif
+
+/* Connections with nothing received for this long are pinged, and
+   closed after twice as long */
+#ifndef WS_IDLE_TIMEOUT_S
+#define WS_IDLE_TIMEOUT_S 30
+#endif
+
+typedef struct ws_conn ws_conn_t;
+
+/* Callbacks of an endpoint, all run in tcpip_thread, so must be quick
+   and not block. Any can be NULL. */
+typedef struct {
+    /* A connection has been accepted, for 'path' and 'query' of its
+       request (only valid during the call) */
+    void (*on_open)(ws_conn_t *conn, const char *path, const char *query);
+    /* A piece of a message, as ws_data_fn in websocket.h, 'data'
+       pointing into the received pbuf */
+    void (*on_data)(ws_conn_t *conn, uint8_t opcode, uint8_t *data, size_t len,
+                    bool first, bool last);
+    /* Data sent earlier has been acknowledged, there may be room for
+       more (for streaming a long message a frame at a time) */
+    void (*on_sent)(ws_conn_t *conn);
+    /* The connection is going, don't use 'conn' after this */
+    void (*on_close)(ws_conn_t *conn);
+} ws_handler_t;
+
+/* The httpd_route_t.upgrade of an endpoint, with the route's .data
+   pointing at its ws_handler_t */
+bool ws_upgrade(struct tcp_pcb *pcb, const httpd_route_t *route,
+                const char *path, const char *query, const char *headers);
+
+/* Per connection pointer for the application, NULL to begin with */
+void ws_set_user(ws_conn_t *conn, void *user);
+void *ws_get_user(ws_conn_t *conn);
+
+/* In tcpip_thread (the callbacks): queue a frame. For a fragmented
+   message send the first frame with its opcode and 'fin' false, then
+   WS_OP_CONTINUATION frames, the last with 'fin' true. Returns ERR_MEM
+   without queueing anything when the send buffer hasn't room for the
+   whole frame, try again from on_sent. */
+err_t ws_send_frame(ws_conn_t *conn, uint8_t opcode, bool fin, const void *data, size_t len);
+
+/* In tcpip_thread: send a whole message as one frame */
+err_t ws_send(ws_conn_t *conn, uint8_t opcode, const void *data, size_t len);
+
+/* In tcpip_thread: send a close frame with 'code' and close */
+void ws_close(ws_conn_t *conn, uint16_t code);
+
+/* From a task (not tcpip_thread): send a message to every connection
+   of the endpoint 'handler' (NULL for all), waiting until it's queued.
+   Connections without room for it in their send buffer miss it.
+   Returns how many it was queued to. */
+int ws_broadcast(const ws_handler_t *handler, uint8_t opcode, const void *data, size_t len);
+
+/* Connections currently open */
+int ws_connections(void);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _WS_SERVER_H */
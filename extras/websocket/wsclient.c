@@ -0,0 +1,446 @@
+/* WebSocket client, see wsclient.h
+ *
+ * The handshake response is read into rx. Frames the server sent
+ * straight after it are parsed from there (and, on a plain connection,
+ * from the rest of the netbuf it came in) by the next wsclient_recv().
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "wsclient.h"
+
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+
+#include <lwip/api.h>
+#include <lwip/tcp.h>
+#include <lwip/tcpip.h>
+#include <esp/hwrand.h>
+
+#if WSCLIENT_MBEDTLS
+#include "mbedtls/net.h"
+#endif
+
+/* How long wsclient_close() waits for the server to answer */
+#define CLOSE_TIMEOUT 2000
+
+void wsclient_init(wsclient_t *c)
+{
+    memset(c, 0, sizeof(*c));
+#if WSCLIENT_MBEDTLS
+    mbedtls_ssl_init(&c->ssl);
+    mbedtls_netconn_init(&c->net);
+#endif
+}
+
+static void disconnect(wsclient_t *c)
+{
+    if (c->pending) {
+        netbuf_delete(c->pending);
+        c->pending = NULL;
+    }
+#if WSCLIENT_MBEDTLS
+    if (c->tls_conf) {
+        if (c->connected)
+            mbedtls_ssl_close_notify(&c->ssl);
+        mbedtls_netconn_free(&c->net);
+        c->conn = NULL;
+    }
+#endif
+    if (c->conn) {
+        netconn_close(c->conn);
+        netconn_delete(c->conn);
+        c->conn = NULL;
+    }
+    c->connected = false;
+    c->rx_pos = c->rx_len = 0;
+}
+
+static wsclient_err_t transport_write(wsclient_t *c, const void *buf, size_t len)
+{
+#if WSCLIENT_MBEDTLS
+    if (c->tls_conf) {
+        while (len) {
+            int r = mbedtls_ssl_write(&c->ssl, buf, len);
+            if (r == MBEDTLS_ERR_SSL_WANT_READ || r == MBEDTLS_ERR_SSL_WANT_WRITE)
+                continue;
+            if (r <= 0)
+                return WSCLIENT_ERR_IO;
+            buf = (const uint8_t *)buf + r;
+            len -= r;
+        }
+        return WSCLIENT_OK;
+    }
+#endif
+    return netconn_write(c->conn, buf, len, NETCONN_COPY) == ERR_OK ? WSCLIENT_OK : WSCLIENT_ERR_IO;
+}
+
+wsclient_err_t wsclient_send_frame(wsclient_t *c, uint8_t opcode, bool fin, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    uint8_t mask[4];
+    uint8_t pos = 0;
+
+    if (!c->connected || c->close_sent)
+        return WSCLIENT_ERR_CLOSED;
+    hwrand_fill(mask, sizeof(mask));
+    size_t n = ws_frame_header(c->tx, opcode, fin, len, mask);
+
+    /* Mask into tx a piece at a time, the header going with the first */
+    do {
+        size_t chunk = sizeof(c->tx) - n;
+        if (chunk > len)
+            chunk = len;
+        memcpy(c->tx + n, p, chunk);
+        pos = ws_mask(c->tx + n, chunk, mask, pos);
+        wsclient_err_t err = transport_write(c, c->tx, n + chunk);
+        if (err != WSCLIENT_OK) {
+            disconnect(c);
+            return err;
+        }
+        p += chunk;
+        len -= chunk;
+        n = 0;
+    } while (len);
+    if (opcode == WS_OP_CLOSE)
+        c->close_sent = true;
+    return WSCLIENT_OK;
+}
+
+wsclient_err_t wsclient_send(wsclient_t *c, uint8_t opcode, const void *data, size_t len)
+{
+    return wsclient_send_frame(c, opcode, true, data, len);
+}
+
+static int parser_data(void *arg, uint8_t opcode, uint8_t *data, size_t len, bool first, bool last)
+{
+    wsclient_t *c = arg;
+
+    if (c->data && c->data(c->data_arg, opcode, data, len, first, last))
+        return WSCLIENT_ERR_ABORTED;
+    return 0;
+}
+
+static int parser_control(void *arg, uint8_t opcode, uint8_t *data, size_t len)
+{
+    wsclient_t *c = arg;
+
+    switch (opcode) {
+    case WS_OP_PING:
+        return wsclient_send_frame(c, WS_OP_PONG, true, data, len);
+    case WS_OP_CLOSE:
+        c->close_code = len >= 2 ? data[0] << 8 | data[1] : WS_CLOSE_NORMAL;
+        if (!c->close_sent)
+            wsclient_send_frame(c, WS_OP_CLOSE, true, data, len >= 2 ? 2 : 0);
+        return WSCLIENT_ERR_CLOSED;
+    default:
+        return 0;
+    }
+}
+
+static int parse(wsclient_t *c, uint8_t *buf, size_t len)
+{
+    int r = ws_parse(&c->parser, buf, len);
+    return r == WS_ERR_PROTOCOL ? WSCLIENT_ERR_PROTOCOL : r;
+}
+
+/* Parse a received pbuf chain from 'offset' on, in place */
+static int parse_pbufs(wsclient_t *c, struct pbuf *p, u16_t offset)
+{
+    int r = 0;
+
+    for (; p && !r; p = p->next) {
+        if (offset >= p->len) {
+            offset -= p->len;
+            continue;
+        }
+        r = parse(c, (uint8_t *)p->payload + offset, p->len - offset);
+        offset = 0;
+    }
+    return r;
+}
+
+static wsclient_err_t map_netconn_err(err_t err)
+{
+    if (err == ERR_TIMEOUT)
+        return WSCLIENT_ERR_TIMEOUT;
+    if (err == ERR_CLSD)
+        return WSCLIENT_ERR_CLOSED;
+    return WSCLIENT_ERR_IO;
+}
+
+#if WSCLIENT_MBEDTLS
+/* Returns bytes read, or an error */
+static int tls_read(wsclient_t *c, uint8_t *buf, size_t len)
+{
+    int r;
+    do {
+        r = mbedtls_ssl_read(&c->ssl, buf, len);
+    } while (r == MBEDTLS_ERR_SSL_WANT_READ || r == MBEDTLS_ERR_SSL_WANT_WRITE);
+    if (r == MBEDTLS_ERR_SSL_TIMEOUT)
+        return WSCLIENT_ERR_TIMEOUT;
+    if (r == 0 || r == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY)
+        return WSCLIENT_ERR_CLOSED;
+    return r < 0 ? WSCLIENT_ERR_IO : r;
+}
+
+static int tls_send(void *ctx, const unsigned char *buf, size_t len)
+{
+    wsclient_t *c = ctx;
+    return mbedtls_netconn_send(&c->net, buf, len);
+}
+
+/* The timeout of the wsclient call in progress, not the config's */
+static int tls_recv_timeout(void *ctx, unsigned char *buf, size_t len, uint32_t timeout)
+{
+    wsclient_t *c = ctx;
+    return mbedtls_netconn_recv_timeout(&c->net, buf, len, c->timeout);
+}
+#endif
+
+wsclient_err_t wsclient_recv(wsclient_t *c, ws_data_fn data, void *arg, uint32_t timeout)
+{
+    int r;
+
+    if (!c->connected)
+        return WSCLIENT_ERR_CLOSED;
+    c->data = data;
+    c->data_arg = arg;
+    c->timeout = timeout;
+
+    if (c->rx_pos < c->rx_len || c->pending) {
+        /* Came with the handshake response. (Taken off the client
+           first, a callback failing to send disconnects it.) */
+        struct netbuf *pending = c->pending;
+        c->pending = NULL;
+        r = parse(c, c->rx + c->rx_pos, c->rx_len - c->rx_pos);
+        c->rx_pos = c->rx_len = 0;
+        if (pending) {
+            if (!r)
+                r = parse_pbufs(c, pending->p, c->pending_offs);
+            netbuf_delete(pending);
+        }
+    }
+#if WSCLIENT_MBEDTLS
+    else if (c->tls_conf) {
+        r = tls_read(c, c->rx, sizeof(c->rx));
+        if (r > 0)
+            r = parse(c, c->rx, r);
+    }
+#endif
+    else {
+        struct netbuf *buf;
+        netconn_set_recvtimeout(c->conn, timeout);
+        err_t err = netconn_recv(c->conn, &buf);
+        if (err == ERR_OK) {
+            r = parse_pbufs(c, buf->p, 0);
+            netbuf_delete(buf);
+        } else {
+            r = map_netconn_err(err);
+        }
+    }
+    c->data = NULL;
+
+    if (r == WSCLIENT_ERR_PROTOCOL && c->connected) {
+        uint8_t status[2] = { WS_CLOSE_PROTOCOL >> 8, WS_CLOSE_PROTOCOL & 0xff };
+        wsclient_send_frame(c, WS_OP_CLOSE, true, status, sizeof(status));
+    }
+    if (r != WSCLIENT_OK && r != WSCLIENT_ERR_TIMEOUT)
+        disconnect(c);
+    return r;
+}
+
+/* Header 'name' in the response headers 'h', or NULL */
+static const char *find_header(const char *h, const char *name)
+{
+    size_t name_len = strlen(name);
+
+    for (; h && *h; h = strstr(h, "\r\n"), h = h ? h + 2 : NULL) {
+        if (strncasecmp(h, name, name_len) || h[name_len] != ':')
+            continue;
+        const char *v = h + name_len + 1;
+        while (*v == ' ')
+            v++;
+        return v;
+    }
+    return NULL;
+}
+
+/* Read the response header into rx, keeping what follows it */
+static wsclient_err_t read_response(wsclient_t *c)
+{
+    size_t len = 0;
+    char *rx = (char *)c->rx;
+    char *end = NULL;
+
+    c->timeout = WSCLIENT_HANDSHAKE_TIMEOUT;
+    while (!end) {
+        size_t room = sizeof(c->rx) - 1 - len;
+        if (!room)
+            return WSCLIENT_ERR_HANDSHAKE;
+        int n;
+#if WSCLIENT_MBEDTLS
+        if (c->tls_conf) {
+            n = tls_read(c, c->rx + len, room);
+            if (n < 0)
+                return n;
+        } else
+#endif
+        {
+            struct netbuf *buf;
+            netconn_set_recvtimeout(c->conn, WSCLIENT_HANDSHAKE_TIMEOUT);
+            err_t err = netconn_recv(c->conn, &buf);
+            if (err != ERR_OK)
+                return map_netconn_err(err);
+            n = netbuf_copy_partial(buf, c->rx + len, room, 0);
+            if (n < netbuf_len(buf)) {
+                c->pending = buf;
+                c->pending_offs = n;
+            } else {
+                netbuf_delete(buf);
+            }
+        }
+        len += n;
+        rx[len] = 0;
+        end = strstr(rx, "\r\n\r\n");
+        if (!end && c->pending)
+            return WSCLIENT_ERR_HANDSHAKE;  /* header doesn't fit */
+    }
+    end[2] = 0;
+    c->rx_pos = end + 4 - rx;
+    c->rx_len = len;
+    return WSCLIENT_OK;
+}
+
+static void nodelay_cb(void *arg)
+{
+    tcp_nagle_disable(((struct netconn *)arg)->pcb.tcp);
+}
+
+static wsclient_err_t handshake(wsclient_t *c, const char *host, uint16_t port,
+                                const char *path, const char *headers)
+{
+    uint8_t nonce[16];
+    char key[25];
+    char accept[WS_ACCEPT_LEN];
+
+    /* Frames go out as they're sent, not after the last one's ACK */
+    tcpip_callback(nodelay_cb, c->conn);
+
+    hwrand_fill(nonce, sizeof(nonce));
+    ws_base64(nonce, sizeof(nonce), key);
+    ws_accept_key(key, strlen(key), accept);
+    int n = snprintf((char *)c->tx, sizeof(c->tx),
+                     "GET %s HTTP/1.1\r\n"
+                     "Host: %s:%u\r\n"
+                     "Upgrade: websocket\r\n"
+                     "Connection: Upgrade\r\n"
+                     "Sec-WebSocket-Key: %s\r\n"
+                     "Sec-WebSocket-Version: 13\r\n"
+                     "%s\r\n",
+                     path, host, port, key, headers ? headers : "");
+    if (n < 0 || n >= (int)sizeof(c->tx))
+        return WSCLIENT_ERR_HANDSHAKE;
+    wsclient_err_t err = transport_write(c, c->tx, n);
+    if (err == WSCLIENT_OK)
+        err = read_response(c);
+    if (err != WSCLIENT_OK)
+        return err;
+
+    const char *rx = (const char *)c->rx;
+    const char *headers_in = strstr(rx, "\r\n") + 2;
+    const char *v = find_header(headers_in, "Sec-WebSocket-Accept");
+    if (strncmp(rx, "HTTP/1.1 101", 12) || !v || strncmp(v, accept, WS_ACCEPT_LEN - 1)
+        || v[WS_ACCEPT_LEN - 1] != '\r')
+        return WSCLIENT_ERR_HANDSHAKE;
+
+    ws_parser_init(&c->parser, false, parser_data, parser_control, c);
+    c->connected = true;
+    c->close_sent = false;
+    c->close_code = 0;
+    return WSCLIENT_OK;
+}
+
+wsclient_err_t wsclient_connect(wsclient_t *c, const char *host, uint16_t port,
+                                const char *path, const char *headers)
+{
+    ip_addr_t addr;
+
+    wsclient_free(c);
+    if (netconn_gethostbyname(host, &addr) != ERR_OK)
+        return WSCLIENT_ERR_CONNECT;
+    c->conn = netconn_new(NETCONN_TCP);
+    if (!c->conn)
+        return WSCLIENT_ERR_CONNECT;
+    if (netconn_connect(c->conn, &addr, port) != ERR_OK) {
+        disconnect(c);
+        return WSCLIENT_ERR_CONNECT;
+    }
+    wsclient_err_t err = handshake(c, host, port, path, headers);
+    if (err != WSCLIENT_OK)
+        disconnect(c);
+    return err;
+}
+
+#if WSCLIENT_MBEDTLS
+wsclient_err_t wsclient_connect_tls(wsclient_t *c, const char *host, uint16_t port,
+                                    const char *path, const char *headers,
+                                    const mbedtls_ssl_config *conf)
+{
+    char port_str[6];
+
+    wsclient_free(c);
+    c->tls_conf = conf;
+    if (mbedtls_ssl_setup(&c->ssl, conf) != 0 || mbedtls_ssl_set_hostname(&c->ssl, host) != 0)
+        return WSCLIENT_ERR_TLS;
+    c->ssl_ready = true;
+
+    sprintf(port_str, "%u", port);
+    if (mbedtls_netconn_connect(&c->net, host, port_str) != 0)
+        return WSCLIENT_ERR_CONNECT;
+    c->conn = c->net.conn;
+    mbedtls_ssl_set_bio(&c->ssl, c, tls_send, NULL, tls_recv_timeout);
+
+    c->timeout = WSCLIENT_HANDSHAKE_TIMEOUT;
+    int r;
+    while ((r = mbedtls_ssl_handshake(&c->ssl)) != 0) {
+        if (r != MBEDTLS_ERR_SSL_WANT_READ && r != MBEDTLS_ERR_SSL_WANT_WRITE) {
+            disconnect(c);
+            return WSCLIENT_ERR_TLS;
+        }
+    }
+    wsclient_err_t err = handshake(c, host, port, path, headers);
+    if (err != WSCLIENT_OK)
+        disconnect(c);
+    return err;
+}
+#endif
+
+void wsclient_close(wsclient_t *c, uint16_t code)
+{
+    uint8_t status[2] = { code >> 8, code };
+
+    if (!c->connected)
+        return;
+    if (wsclient_send_frame(c, WS_OP_CLOSE, true, status, sizeof(status)) == WSCLIENT_OK) {
+        /* Until the server's close, discarding data still on its way */
+        while (wsclient_recv(c, NULL, NULL, CLOSE_TIMEOUT) == WSCLIENT_OK)
+            ;
+    }
+    disconnect(c);
+}
+
+void wsclient_free(wsclient_t *c)
+{
+    disconnect(c);
+#if WSCLIENT_MBEDTLS
+    if (c->ssl_ready) {
+        mbedtls_ssl_free(&c->ssl);
+        mbedtls_ssl_init(&c->ssl);
+        c->ssl_ready = false;
+    }
+    c->tls_conf = NULL;
+#endif
+}
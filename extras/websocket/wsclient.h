@@ -0,0 +1,144 @@
+/* WebSocket client over netconn, and optionally mbedTLS
+ *
+ * A blocking client, for use from one task:
+ *
+ *   wsclient_t ws;
+ *   wsclient_init(&ws);
+ *   if (wsclient_connect(&ws, "dashboard.local", 80, "/feed", NULL) == WSCLIENT_OK) {
+ *       wsclient_send(&ws, WS_OP_TEXT, json, json_len);
+ *       while (wsclient_recv(&ws, on_data, NULL, 1000) >= WSCLIENT_ERR_TIMEOUT)
+ *           ...
+ *   }
+ *   wsclient_free(&ws);
+ *
+ * Received messages stream to a callback a piece at a time, as
+ * ws_data_fn in websocket.h does. On a plain connection the pieces
+ * point straight into the received pbufs, with nothing copied; over
+ * TLS they point into the client's rx buffer mbedTLS decrypts into.
+ * Outgoing frames are masked (as a client must) into the tx buffer a
+ * piece at a time, so a message needn't fit in it. Pings are answered
+ * within wsclient_recv().
+ *
+ * Build with EXTRA_CFLAGS=-DWSCLIENT_MBEDTLS=1 (and extras/mbedtls in
+ * EXTRA_COMPONENTS) for wsclient_connect_tls().
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _WSCLIENT_H
+#define _WSCLIENT_H
+
+#include "websocket.h"
+
+#ifndef WSCLIENT_MBEDTLS
+#define WSCLIENT_MBEDTLS 0
+#endif
+
+#if WSCLIENT_MBEDTLS
+#include "mbedtls/ssl.h"
+#include "net_netconn.h"
+#endif
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/* Receive buffer, the longest handshake response, and what TLS
+   records are decrypted into */
+#ifndef WSCLIENT_RX_BUF
+#define WSCLIENT_RX_BUF 512
+#endif
+
+/* Transmit buffer, the longest handshake request, and the largest
+   piece of an outgoing frame masked at once */
+#ifndef WSCLIENT_TX_BUF
+#define WSCLIENT_TX_BUF 512
+#endif
+
+/* How long the handshake may take, ms */
+#ifndef WSCLIENT_HANDSHAKE_TIMEOUT
+#define WSCLIENT_HANDSHAKE_TIMEOUT 10000
+#endif
+
+typedef enum {
+    WSCLIENT_OK = 0,
+    WSCLIENT_ERR_TIMEOUT = -1,   /* nothing received in time, still connected */
+    WSCLIENT_ERR_CONNECT = -2,   /* DNS lookup or connection failed */
+    WSCLIENT_ERR_IO = -3,        /* send or receive failed */
+    WSCLIENT_ERR_HANDSHAKE = -4, /* the server refused the upgrade */
+    WSCLIENT_ERR_PROTOCOL = -5,  /* malformed frame received */
+    WSCLIENT_ERR_CLOSED = -6,    /* closed by the server (or by us) */
+    WSCLIENT_ERR_ABORTED = -7,   /* the data callback stopped */
+    WSCLIENT_ERR_TLS = -8,       /* TLS setup or handshake failed */
+} wsclient_err_t;
+
+struct netconn;
+struct netbuf;
+
+typedef struct {
+    struct netconn *conn;   /* plain connection */
+    bool connected;
+    bool close_sent;
+    uint16_t close_code;    /* the server's, once it has closed */
+    uint32_t timeout;       /* receive timeout in effect, ms */
+    ws_data_fn data;        /* for the wsclient_recv() in progress */
+    void *data_arg;
+    ws_parser_t parser;
+    uint16_t rx_pos;        /* frames received with the handshake response */
+    uint16_t rx_len;
+    struct netbuf *pending; /* and the rest of its netbuf, if that didn't fit */
+    uint16_t pending_offs;
+#if WSCLIENT_MBEDTLS
+    const mbedtls_ssl_config *tls_conf; /* NULL for plain connections */
+    bool ssl_ready;
+    mbedtls_ssl_context ssl;
+    mbedtls_netconn_context net;
+#endif
+    uint8_t rx[WSCLIENT_RX_BUF];
+    uint8_t tx[WSCLIENT_TX_BUF];
+} wsclient_t;
+
+void wsclient_init(wsclient_t *c);
+
+/* Connect to ws://host:port/path, i.e. path (with any query) is what
+   goes in the request line. 'headers' are extra request header lines
+   each ending in "\r\n" (Origin, cookies, ...), or NULL. */
+wsclient_err_t wsclient_connect(wsclient_t *c, const char *host, uint16_t port,
+                                const char *path, const char *headers);
+
+#if WSCLIENT_MBEDTLS
+/* As wsclient_connect(), for wss:// with 'conf' (which must stay
+   valid) set up by the caller: certificate verification and RNG. The
+   host name is used for SNI and verification. */
+wsclient_err_t wsclient_connect_tls(wsclient_t *c, const char *host, uint16_t port,
+                                    const char *path, const char *headers,
+                                    const mbedtls_ssl_config *conf);
+#endif
+
+/* Send a frame, as ws_send_frame() in ws_server.h, blocking until it's
+   all written */
+wsclient_err_t wsclient_send_frame(wsclient_t *c, uint8_t opcode, bool fin,
+                                   const void *data, size_t len);
+
+/* Send a whole message as one frame */
+wsclient_err_t wsclient_send(wsclient_t *c, uint8_t opcode, const void *data, size_t len);
+
+/* Wait up to 'timeout' ms (0 waits for ever) for data, and pass all of
+   it that has arrived to 'data'. Returns WSCLIENT_OK, or
+   WSCLIENT_ERR_TIMEOUT if nothing came, or an error after which the
+   connection is closed. */
+wsclient_err_t wsclient_recv(wsclient_t *c, ws_data_fn data, void *arg, uint32_t timeout);
+
+/* Send a close frame with 'code', wait (briefly) for the server's
+   answer, and close the connection */
+void wsclient_close(wsclient_t *c, uint16_t code);
+
+/* Close the connection, if open, and free everything the client holds */
+void wsclient_free(wsclient_t *c);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _WSCLIENT_H */
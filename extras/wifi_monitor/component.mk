@@ -0,0 +1,9 @@
+# Component makefile for extras/wifi_monitor
+
+# expected anyone using wifi_monitor includes it as 'wifi_monitor/wifi_monitor.h'
+INC_DIRS += $(wifi_monitor_ROOT)..
+
+# args for passing into compile rule generation
+wifi_monitor_SRC_DIR =  $(wifi_monitor_ROOT)
+
+$(eval $(call component_compile_rules,wifi_monitor))
@@ -0,0 +1,263 @@
+/* Wi-Fi monitor mode capture, see wifi_monitor.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "wifi_monitor.h"
+
+#include <string.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <timers.h>
+
+#include "espressif/esp_common.h"
+
+#if (WIFI_MONITOR_RING_FRAMES & (WIFI_MONITOR_RING_FRAMES - 1)) != 0
+#error "WIFI_MONITOR_RING_FRAMES must be a power of two"
+#endif
+
+#if WIFI_MONITOR_SNAPLEN > 112
+#error "WIFI_MONITOR_SNAPLEN is at most 112, the SDK gives no more"
+#endif
+
+#define MAX_HOP_CHANNELS 14
+
+/* What the SDK passes to the promiscuous callback: just the rx_ctrl
+   for frames it doesn't copy (len 12), rx_ctrl and the first 112
+   bytes for management frames (len 128), or rx_ctrl, the first 36
+   bytes and the lengths of the (possibly aggregated) frames otherwise. */
+struct rx_ctrl {
+    signed rssi:8;
+    unsigned rate:4;
+    unsigned is_group:1;
+    unsigned :1;
+    unsigned sig_mode:2;
+    unsigned legacy_length:12;
+    unsigned damatch0:1;
+    unsigned damatch1:1;
+    unsigned bssidmatch0:1;
+    unsigned bssidmatch1:1;
+    unsigned mcs:7;
+    unsigned cwb:1;
+    unsigned ht_length:16;
+    unsigned smoothing:1;
+    unsigned not_sounding:1;
+    unsigned :1;
+    unsigned aggregation:1;
+    unsigned stbc:2;
+    unsigned fec_coding:1;
+    unsigned sgi:1;
+    unsigned rxend_state:8;
+    unsigned ampdu_cnt:8;
+    unsigned channel:4;
+    unsigned :12;
+};
+
+struct len_seq {
+    uint16_t length;
+    uint16_t seq;
+    uint8_t address3[6];
+};
+
+struct sniffer_data {
+    struct rx_ctrl rx_ctrl;
+    uint8_t buf[36];
+    uint16_t cnt;
+    struct len_seq lenseq[1];
+};
+
+struct sniffer_mgmt {
+    struct rx_ctrl rx_ctrl;
+    uint8_t buf[112];
+    uint16_t cnt;
+    uint16_t len;
+};
+
+static wifi_monitor_frame_t ring[WIFI_MONITOR_RING_FRAMES];
+static volatile uint32_t head;      /* written by the producer only */
+static volatile uint32_t tail;      /* written by the consumer only */
+static wifi_monitor_stats_t stats;
+static wifi_monitor_filter_t filter;
+static volatile xTaskHandle waiter;
+
+static xTimerHandle hop_timer;
+static uint8_t hop_channels[MAX_HOP_CHANNELS];
+static uint8_t hop_count;
+static uint8_t hop_next;
+
+static void rx_callback(uint8_t *buf, uint16_t len)
+{
+    const struct rx_ctrl *ctrl = (const struct rx_ctrl *)buf;
+    uint32_t h = head;
+
+    if (len < sizeof(struct rx_ctrl))
+        return;
+    if (h - tail == WIFI_MONITOR_RING_FRAMES) {
+        stats.dropped++;
+        return;
+    }
+
+    wifi_monitor_frame_t *f = &ring[h & (WIFI_MONITOR_RING_FRAMES - 1)];
+    f->timestamp_us = sdk_system_get_time();
+    f->rssi = ctrl->rssi;
+    f->channel = ctrl->channel;
+    f->flags = ctrl->is_group ? WIFI_MONITOR_GROUP : 0;
+    if (ctrl->sig_mode) {
+        f->flags |= WIFI_MONITOR_HT;
+        f->rate = ctrl->mcs;
+        f->length = ctrl->ht_length;
+    } else {
+        f->rate = ctrl->rate;
+        f->length = ctrl->legacy_length;
+    }
+
+    const uint8_t *data = NULL;
+    size_t available = 0;
+    if (len == sizeof(struct sniffer_mgmt)) {
+        const struct sniffer_mgmt *m = (const struct sniffer_mgmt *)buf;
+        data = m->buf;
+        available = m->len < sizeof(m->buf) ? m->len : sizeof(m->buf);
+        f->length = m->len;
+    } else if (len >= sizeof(struct sniffer_data)) {
+        const struct sniffer_data *d = (const struct sniffer_data *)buf;
+        data = d->buf;
+        available = sizeof(d->buf);
+        if (d->cnt)
+            f->length = d->lenseq[0].length;
+    }
+
+    if (available > WIFI_MONITOR_SNAPLEN)
+        available = WIFI_MONITOR_SNAPLEN;
+    if (!data)
+        f->flags |= WIFI_MONITOR_NO_DATA;
+    else
+        memcpy(f->data, data, available);
+    f->captured = available;
+
+    if (filter && !filter(f))
+        return;
+
+    /* The copy above must land before the consumer can see it */
+    __asm__ volatile ("" ::: "memory");
+    head = h + 1;
+    stats.received++;
+
+    xTaskHandle task = waiter;
+    if (task) {
+        waiter = NULL;
+        xTaskNotifyGive(task);
+    }
+}
+
+static void hop_timer_cb(xTimerHandle timer)
+{
+    if (!hop_count)
+        return;
+    sdk_wifi_set_channel(hop_channels[hop_next]);
+    if (++hop_next == hop_count)
+        hop_next = 0;
+}
+
+bool wifi_monitor_start(wifi_monitor_filter_t frame_filter, uint8_t channel)
+{
+    wifi_monitor_stop();
+
+    filter = frame_filter;
+    memset(&stats, 0, sizeof(stats));
+    tail = head;
+
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_station_disconnect();
+    if (channel && !sdk_wifi_set_channel(channel))
+        return false;
+
+    sdk_wifi_set_promiscuous_rx_cb(rx_callback);
+    sdk_wifi_promiscuous_enable(1);
+    return true;
+}
+
+void wifi_monitor_stop(void)
+{
+    wifi_monitor_hop(NULL, 0, 0);
+    sdk_wifi_promiscuous_enable(0);
+}
+
+bool wifi_monitor_hop(const uint8_t *channels, size_t n, uint32_t dwell_ms)
+{
+    if (hop_timer)
+        xTimerStop(hop_timer, portMAX_DELAY);
+    hop_count = 0;
+    if (!n)
+        return true;
+
+    if (n > MAX_HOP_CHANNELS)
+        n = MAX_HOP_CHANNELS;
+    memcpy(hop_channels, channels, n);
+    hop_count = n;
+    hop_next = 0;
+
+    portTickType period = dwell_ms / portTICK_RATE_MS;
+    if (!period)
+        period = 1;
+    if (!hop_timer) {
+        hop_timer = xTimerCreate((signed char *)"wifi_hop", period, pdTRUE, NULL, hop_timer_cb);
+        if (!hop_timer)
+            return false;
+    } else {
+        xTimerChangePeriod(hop_timer, period, portMAX_DELAY);
+    }
+    hop_timer_cb(hop_timer);
+    return xTimerStart(hop_timer, portMAX_DELAY) == pdPASS;
+}
+
+size_t wifi_monitor_peek(const wifi_monitor_frame_t **frames)
+{
+    uint32_t t = tail;
+    uint32_t queued = head - t;
+    uint32_t index = t & (WIFI_MONITOR_RING_FRAMES - 1);
+
+    __asm__ volatile ("" ::: "memory");
+    if (queued > WIFI_MONITOR_RING_FRAMES - index)
+        queued = WIFI_MONITOR_RING_FRAMES - index;
+    *frames = &ring[index];
+    return queued;
+}
+
+size_t wifi_monitor_wait(const wifi_monitor_frame_t **frames, uint32_t timeout_ms)
+{
+    size_t n = wifi_monitor_peek(frames);
+
+    if (n || !timeout_ms)
+        return n;
+
+    /* Register, then check again so a frame arriving in between isn't
+       missed */
+    ulTaskNotifyTake(pdTRUE, 0);
+    waiter = xTaskGetCurrentTaskHandle();
+    n = wifi_monitor_peek(frames);
+    if (!n) {
+        ulTaskNotifyTake(pdTRUE, timeout_ms / portTICK_RATE_MS);
+        n = wifi_monitor_peek(frames);
+    }
+    waiter = NULL;
+    return n;
+}
+
+void wifi_monitor_release(size_t n)
+{
+    uint32_t t = tail;
+
+    if (n > head - t)
+        n = head - t;
+    __asm__ volatile ("" ::: "memory");
+    tail = t + n;
+}
+
+void wifi_monitor_get_stats(wifi_monitor_stats_t *result)
+{
+    taskENTER_CRITICAL();
+    *result = stats;
+    taskEXIT_CRITICAL();
+}
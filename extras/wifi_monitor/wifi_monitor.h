@@ -0,0 +1,120 @@
+/* Wi-Fi monitor mode capture, into a preallocated ring of frames
+ *
+ * Puts the radio in promiscuous mode and copies the metadata (RSSI,
+ * rate, channel, length, timestamp) and the first bytes of every frame
+ * the SDK reports into a fixed ring. A consumer task takes them out in
+ * batches, reading the ring in place:
+ *
+ *     wifi_monitor_start(NULL, 0);
+ *     for (;;) {
+ *         const wifi_monitor_frame_t *frames;
+ *         size_t n = wifi_monitor_wait(&frames, 1000);
+ *         for (size_t i = 0; i < n; i++)
+ *             count(&frames[i]);
+ *         wifi_monitor_release(n);
+ *     }
+ *
+ * The SDK gives the first 112 bytes of management frames (which is what
+ * presence detection needs, probe requests carry the MAC and SSID), the
+ * first 36 bytes of data frames and only the metadata of other frames.
+ *
+ * The ring has a single producer (the SDK's receive callback) and a
+ * single consumer, so no locks are taken on either side. Frames
+ * arriving while it's full are counted as dropped.
+ *
+ * Channel hopping runs from a FreeRTOS software timer, so it needs no
+ * task of its own.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _WIFI_MONITOR_H
+#define _WIFI_MONITOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/* Frames in the ring, a power of two */
+#ifndef WIFI_MONITOR_RING_FRAMES
+#define WIFI_MONITOR_RING_FRAMES 64
+#endif
+
+/* Bytes kept from the start of each frame, at most 112 */
+#ifndef WIFI_MONITOR_SNAPLEN
+#define WIFI_MONITOR_SNAPLEN 64
+#endif
+
+/* wifi_monitor_frame_t.flags */
+#define WIFI_MONITOR_HT       0x01  /* 802.11n (HT) rate, 'rate' is the MCS */
+#define WIFI_MONITOR_GROUP    0x02  /* group (multicast/broadcast) addressed */
+#define WIFI_MONITOR_NO_DATA  0x04  /* metadata only, the SDK gave no bytes */
+
+typedef struct {
+    uint32_t timestamp_us;   /* sdk_system_get_time() on receipt */
+    int8_t rssi;             /* dBm */
+    uint8_t channel;
+    uint8_t rate;            /* legacy rate index, or the MCS for HT */
+    uint8_t flags;
+    uint16_t length;         /* length of the frame on air */
+    uint8_t captured;        /* bytes in 'data' */
+    uint8_t _reserved;
+    uint8_t data[WIFI_MONITOR_SNAPLEN];  /* from the 802.11 header on */
+} wifi_monitor_frame_t;
+
+typedef struct {
+    uint32_t received;       /* frames put in the ring */
+    uint32_t dropped;        /* frames lost to a full ring */
+} wifi_monitor_stats_t;
+
+/* Optional filter, called from the SDK's receive callback with the
+   frame as it will be stored (before it's committed to the ring).
+   Return false to drop it. Keep it short. */
+typedef bool (*wifi_monitor_filter_t)(const wifi_monitor_frame_t *frame);
+
+/* Start capturing on the current channel, or on 'channel' if it's not
+   0. Station and soft AP are disconnected while capturing, as the SDK
+   requires for promiscuous mode.
+
+   Returns false if the channel can't be set.
+*/
+bool wifi_monitor_start(wifi_monitor_filter_t filter, uint8_t channel);
+
+/* Stop capturing and channel hopping. Frames still in the ring can be
+   consumed. */
+void wifi_monitor_stop(void);
+
+/* Hop over 'channels' in turn, 'dwell_ms' on each. n = 0 stops hopping
+   and stays on the current channel. The list is copied. Uses a
+   FreeRTOS software timer, so hops run in the timer service task.
+
+   Returns false if the timer can't be created.
+*/
+bool wifi_monitor_hop(const uint8_t *channels, size_t n, uint32_t dwell_ms);
+
+/* Consumer side: point '*frames' at the oldest frames in the ring and
+   return how many there are, without copying. The run is contiguous in
+   the ring, so this may return fewer than are queued when it wraps;
+   call again after releasing. Returns 0 if the ring is empty. */
+size_t wifi_monitor_peek(const wifi_monitor_frame_t **frames);
+
+/* wifi_monitor_peek(), blocking up to timeout_ms for the ring to be
+   non empty. Uses the calling task's notification (see
+   ulTaskNotifyTake()), only one task may wait at a time. */
+size_t wifi_monitor_wait(const wifi_monitor_frame_t **frames, uint32_t timeout_ms);
+
+/* Give back the first n frames returned by peek or wait to the ring. */
+void wifi_monitor_release(size_t n);
+
+void wifi_monitor_get_stats(wifi_monitor_stats_t *stats);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _WIFI_MONITOR_H */
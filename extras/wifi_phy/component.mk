@@ -0,0 +1,9 @@
+# Component makefile for extras/wifi_phy
+
+# expected anyone using wifi_phy includes it as 'wifi_phy/wifi_phy.h'
+INC_DIRS += $(wifi_phy_ROOT)..
+
+# args for passing into compile rule generation
+wifi_phy_SRC_DIR =  $(wifi_phy_ROOT)
+
+$(eval $(call component_compile_rules,wifi_phy))
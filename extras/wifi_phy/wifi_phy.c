@@ -0,0 +1,208 @@
+/* Wi-Fi TX power, PHY mode and delivery statistics, see wifi_phy.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "wifi_phy.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include <FreeRTOS.h>
+#include <timers.h>
+
+#include <lwip/stats.h>
+
+#include "espressif/esp_common.h"
+#include "espressif/spi_flash.h"
+
+/* The PHY init data, as core/app_main.c reads it at boot */
+#define PHY_INFO_SIZE 128
+#define PHY_INFO_VERSION 5
+#define PHY_TARGET_POWER 34     /* target_power_qdb_0..5 */
+#define PHY_TARGET_POWERS 6
+
+static xTimerHandle timer;
+static wifi_phy_adapt_config_t adapt;
+static uint8_t bad_run, good_run;
+static uint8_t last_fail_percent;
+static uint32_t mode_changes;
+static uint32_t last_frames, last_failures;
+
+static uint32_t phy_info_addr(void)
+{
+    return sdk_flashchip.chip_size - sdk_flashchip.sector_size * 4;
+}
+
+bool wifi_phy_set_max_tx_power(uint8_t qdbm)
+{
+    uint32_t addr = phy_info_addr();
+    uint32_t *sector = malloc(sdk_flashchip.sector_size);
+    bool changed = false, ok = false;
+
+    if (!sector)
+        return false;
+    if (sdk_spi_flash_read(addr, sector, sdk_flashchip.sector_size) != SPI_FLASH_RESULT_OK)
+        goto out;
+    uint8_t *phy_info = (uint8_t *)sector;
+    if (phy_info[0] != PHY_INFO_VERSION) {
+        /* Nothing to cap: the SDK is running on its built in defaults */
+        printf("wifi_phy: no PHY init data in flash at 0x%08x\n", addr);
+        goto out;
+    }
+    if (qdbm > WIFI_PHY_MAX_TX_POWER)
+        qdbm = WIFI_PHY_MAX_TX_POWER;
+
+    /* The table goes down from the lowest rate's power to the highest's;
+       capping each keeps that order */
+    for (int i = 0; i < PHY_TARGET_POWERS; i++) {
+        if (phy_info[PHY_TARGET_POWER + i] > qdbm) {
+            phy_info[PHY_TARGET_POWER + i] = qdbm;
+            changed = true;
+        }
+    }
+    ok = true;
+    if (changed) {
+        ok = sdk_spi_flash_erase_sector(addr / sdk_flashchip.sector_size) == SPI_FLASH_RESULT_OK &&
+            sdk_spi_flash_write(addr, sector, sdk_flashchip.sector_size) == SPI_FLASH_RESULT_OK;
+    }
+out:
+    free(sector);
+    return ok;
+}
+
+uint8_t wifi_phy_get_max_tx_power(void)
+{
+    uint32_t words[PHY_INFO_SIZE / 4];
+    uint8_t *phy_info = (uint8_t *)words;
+
+    if (sdk_spi_flash_read(phy_info_addr(), words, PHY_INFO_SIZE) != SPI_FLASH_RESULT_OK ||
+            phy_info[0] != PHY_INFO_VERSION)
+        return WIFI_PHY_MAX_TX_POWER;
+    uint8_t max = 0;
+    for (int i = 0; i < PHY_TARGET_POWERS; i++) {
+        if (phy_info[PHY_TARGET_POWER + i] > max)
+            max = phy_info[PHY_TARGET_POWER + i];
+    }
+    return max;
+}
+
+bool wifi_phy_set_mode(enum sdk_phy_mode mode, bool reconnect)
+{
+    if (sdk_wifi_get_phy_mode() == mode)
+        return true;
+    if (!sdk_wifi_set_phy_mode(mode))
+        return false;
+    if (reconnect && sdk_wifi_station_get_connect_status() == STATION_GOT_IP) {
+        sdk_wifi_station_disconnect();
+        sdk_wifi_station_connect();
+    }
+    return true;
+}
+
+/* Frames sent and failures so far, from lwIP's stats */
+static uint32_t frames_sent(void)
+{
+#if LWIP_STATS && LINK_STATS
+    return lwip_stats.link.xmit;
+#else
+    return 0;
+#endif
+}
+
+static uint32_t failures(void)
+{
+    uint32_t n = 0;
+#if LWIP_STATS && LINK_STATS
+    n += lwip_stats.link.err;
+#endif
+#if LWIP_STATS && TCP_STATS
+    n += lwip_stats.tcp.rexmit;
+#endif
+    return n;
+}
+
+void wifi_phy_get_stats(wifi_phy_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+#if LWIP_STATS && LINK_STATS
+    stats->frames = lwip_stats.link.xmit;
+    stats->errors = lwip_stats.link.err;
+    stats->drops = lwip_stats.link.drop;
+#endif
+#if LWIP_STATS && TCP_STATS
+    stats->tcp_segments = lwip_stats.tcp.xmit;
+    stats->tcp_retransmits = lwip_stats.tcp.rexmit;
+#endif
+    stats->fail_percent = last_fail_percent;
+    stats->mode_changes = mode_changes;
+}
+
+static void step_mode(int step)
+{
+    int mode = (int)sdk_wifi_get_phy_mode() + step;
+
+    if (mode < PHY_MODE_11B || mode > adapt.max_mode)
+        return;
+    /* A reassociation costs a second or so of traffic, which is what the
+       run lengths in the config are there to keep rare */
+    if (wifi_phy_set_mode(mode, true)) {
+        mode_changes++;
+        printf("wifi_phy: %s to 802.11%c\n", step < 0 ? "down" : "up", " bgn"[mode]);
+    }
+}
+
+static void adapt_tick(xTimerHandle t)
+{
+    uint32_t frames = frames_sent(), fails = failures();
+    uint32_t d_frames = frames - last_frames, d_fails = fails - last_failures;
+
+    last_frames = frames;
+    last_failures = fails;
+    if (sdk_wifi_station_get_connect_status() != STATION_GOT_IP || d_frames < adapt.min_frames)
+        return;
+
+    uint32_t percent = d_fails * 100 / d_frames;
+    last_fail_percent = percent > 100 ? 100 : percent;
+    if (percent >= adapt.down_percent) {
+        good_run = 0;
+        if (++bad_run >= adapt.down_after) {
+            bad_run = 0;
+            step_mode(-1);
+        }
+    } else if (percent < adapt.up_percent) {
+        bad_run = 0;
+        if (++good_run >= adapt.up_after) {
+            good_run = 0;
+            step_mode(1);
+        }
+    } else {
+        bad_run = good_run = 0;
+    }
+}
+
+bool wifi_phy_adapt_start(const wifi_phy_adapt_config_t *config)
+{
+    portTickType period = config->interval_ms / portTICK_RATE_MS;
+
+    adapt = *config;
+    bad_run = good_run = 0;
+    last_frames = frames_sent();
+    last_failures = failures();
+    if (!timer) {
+        timer = xTimerCreate((signed char *)"wifi_phy", period, pdTRUE, NULL, adapt_tick);
+        if (!timer)
+            return false;
+    } else {
+        xTimerChangePeriod(timer, period, 0);
+    }
+    return xTimerStart(timer, 0) == pdPASS;
+}
+
+void wifi_phy_adapt_stop(void)
+{
+    if (timer)
+        xTimerStop(timer, 0);
+}
@@ -0,0 +1,101 @@
+/* Wi-Fi TX power, PHY mode and delivery statistics
+ *
+ * What this SDK lets an application control of the radio's rate and
+ * power, in one place, with an adaptive policy on top:
+ *
+ * TX power. The SDK has no runtime TX power call (later SDKs added
+ * system_phy_set_max_tpw()). The power is set by the target power
+ * table of the PHY init data, esp_init_data_default.bin in the fourth
+ * last flash sector, which is read once at boot. wifi_phy_set_max_tx_power()
+ * caps that table in flash, so it takes effect from the next restart.
+ * The values are in 0.25 dBm steps, up to 82 (20.5 dBm). Dropping a
+ * short link from 20.5 to 10 dBm saves a good part of the transmit
+ * current.
+ *
+ * Rate. The SDK's rate control picks the rate within the PHY mode, and
+ * can't be fixed to one rate here (later SDKs added
+ * wifi_set_user_fixed_rate()). The mode is the control there is:
+ * 802.11n (up to MCS7), g (up to 54 Mbit/s) or b (up to 11 Mbit/s,
+ * the most robust at range). A mode change applies at association,
+ * so wifi_phy_set_mode() can reassociate straight away.
+ *
+ * Statistics. The SDK doesn't report per-frame retries, so delivery is
+ * measured from lwIP's stats (LWIP_STATS, on by default): frames sent,
+ * frames the MAC refused, and TCP retransmissions, which are what
+ * retries on the air turn into once the MAC gives up.
+ *
+ * Adaptive policy. wifi_phy_adapt_start() looks at the failure rate
+ * every interval. After 'down_after' bad intervals in a row it steps
+ * the PHY mode down (n, g, b), and after 'up_after' good ones back up.
+ * Intervals with less than 'min_frames' sent don't count either way.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _WIFI_PHY_H
+#define _WIFI_PHY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "espressif/esp_wifi.h"
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#define WIFI_PHY_MAX_TX_POWER 82      /* 20.5 dBm, in 0.25 dBm */
+
+/* Cap the TX power at 'qdbm' quarter dBm, from the next restart. Writes
+   the PHY init data sector only if it changes. Returns false if the
+   flash couldn't be read or written. */
+bool wifi_phy_set_max_tx_power(uint8_t qdbm);
+
+/* The highest TX power in the PHY init data in flash, or the SDK's
+   default if there's none there */
+uint8_t wifi_phy_get_max_tx_power(void);
+
+/* Set the PHY mode, and reassociate so it takes effect now if
+   'reconnect' (and the station is connected) */
+bool wifi_phy_set_mode(enum sdk_phy_mode mode, bool reconnect);
+
+typedef struct {
+    uint32_t frames;            /* sent by the interface */
+    uint32_t errors;            /* refused by the MAC */
+    uint32_t drops;             /* dropped before the MAC (no memory) */
+    uint32_t tcp_segments;      /* TCP segments sent */
+    uint32_t tcp_retransmits;
+    uint8_t fail_percent;       /* in the last adapt interval */
+    uint32_t mode_changes;      /* made by the adaptive policy */
+} wifi_phy_stats_t;
+
+void wifi_phy_get_stats(wifi_phy_stats_t *stats);
+
+typedef struct {
+    uint32_t interval_ms;
+    uint16_t min_frames;        /* sent in an interval for it to count */
+    uint8_t down_percent;       /* failures per frame sent, to step down */
+    uint8_t up_percent;         /* below which an interval is good */
+    uint8_t down_after;         /* bad intervals in a row */
+    uint8_t up_after;           /* good intervals in a row */
+    enum sdk_phy_mode max_mode; /* highest mode to step up to */
+} wifi_phy_adapt_config_t;
+
+#define WIFI_PHY_ADAPT_DEFAULT_CONFIG { \
+        .interval_ms = 10000, .min_frames = 50, \
+        .down_percent = 10, .up_percent = 2, \
+        .down_after = 3, .up_after = 30, \
+        .max_mode = PHY_MODE_11N, \
+    }
+
+/* Start (or reconfigure) the adaptive policy, run from a FreeRTOS
+   software timer. Returns false if the timer couldn't be created. */
+bool wifi_phy_adapt_start(const wifi_phy_adapt_config_t *config);
+void wifi_phy_adapt_stop(void);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _WIFI_PHY_H */
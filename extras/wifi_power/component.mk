@@ -0,0 +1,9 @@
+# Component makefile for extras/wifi_power
+
+# expected anyone using wifi_power includes it as 'wifi_power/wifi_power.h'
+INC_DIRS += $(wifi_power_ROOT)..
+
+# args for passing into compile rule generation
+wifi_power_SRC_DIR =  $(wifi_power_ROOT)
+
+$(eval $(call component_compile_rules,wifi_power))
@@ -0,0 +1,45 @@
+/* Wi-Fi power save profiles, see wifi_power.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "wifi_power.h"
+
+#include <FreeRTOS.h>
+
+#include "espressif/esp_common.h"
+#include "esp/clocks.h"
+
+static wifi_power_profile_t current = WIFI_POWER_BALANCED;
+
+void wifi_power_set_profile(wifi_power_profile_t profile)
+{
+    switch (profile) {
+    case WIFI_POWER_MAX_PERFORMANCE:
+        sdk_wifi_set_sleep_type(WIFI_SLEEP_NONE);
+        cpu_set_freq(160);
+        break;
+    case WIFI_POWER_BALANCED:
+        cpu_set_freq(80);
+        sdk_wifi_set_sleep_type(WIFI_SLEEP_MODEM);
+        break;
+    case WIFI_POWER_MIN_POWER:
+        cpu_set_freq(80);
+        sdk_wifi_set_sleep_type(WIFI_SLEEP_LIGHT);
+        break;
+    default:
+        return;
+    }
+    current = profile;
+}
+
+wifi_power_profile_t wifi_power_get_profile(void)
+{
+    return current;
+}
+
+bool wifi_power_idle_sleeps(void)
+{
+    return configUSE_TICKLESS_IDLE != 0;
+}
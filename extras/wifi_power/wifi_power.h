@@ -0,0 +1,68 @@
+/* Wi-Fi power save profiles
+ *
+ * Picks the SDK's station sleep type together with the CPU clock, as
+ * one of three tradeoffs between latency, throughput and current:
+ *
+ * WIFI_POWER_MAX_PERFORMANCE
+ *     No modem sleep, CPU at 160 MHz. The radio receives all the time,
+ *     so incoming packets are seen with no added latency and TCP
+ *     throughput is highest. Highest current, around 70 mA average
+ *     while associated and idle (Espressif datasheet figure, with
+ *     peaks well above that while transmitting).
+ *
+ * WIFI_POWER_BALANCED
+ *     Modem sleep, CPU at 80 MHz. The radio is turned off between DTIM
+ *     beacons the AP sends for traffic buffered for us, so incoming
+ *     packets wait for the next DTIM: on a typical AP (100 ms beacons,
+ *     DTIM 1 to 3) that adds up to 100-300 ms of latency to the first
+ *     packet of an exchange. Outgoing packets wake the radio straight
+ *     away. Around 15 mA (datasheet), the SDK's default.
+ *
+ * WIFI_POWER_MIN_POWER
+ *     Light sleep, CPU at 80 MHz. Like modem sleep, and the CPU clock
+ *     is also gated while nothing is running, which needs FreeRTOS to
+ *     actually stop when idle: build with configUSE_TICKLESS_IDLE=1
+ *     (see FreeRTOSConfig.h), otherwise this saves no more than
+ *     BALANCED. Lowest current, around 1 mA between DTIMs (datasheet),
+ *     with the same DTIM latency and some more wake up jitter.
+ *
+ * The current figures are Espressif's datasheet values: actual ones
+ * depend on the AP's DTIM period and the traffic, measure them on the
+ * board in question. This SDK has no listen interval setting (later
+ * SDKs added wifi_set_listen_interval()), so how often the station
+ * wakes is set by the AP's DTIM period.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _WIFI_POWER_H
+#define _WIFI_POWER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    WIFI_POWER_MAX_PERFORMANCE = 0,
+    WIFI_POWER_BALANCED,
+    WIFI_POWER_MIN_POWER,
+} wifi_power_profile_t;
+
+/* Select a profile. Can be changed at any time, while connected too. */
+void wifi_power_set_profile(wifi_power_profile_t profile);
+
+/* The profile last set, WIFI_POWER_BALANCED (the SDK default) if none */
+wifi_power_profile_t wifi_power_get_profile(void);
+
+/* True if the CPU really stops when idle, see WIFI_POWER_MIN_POWER */
+bool wifi_power_idle_sleeps(void);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _WIFI_POWER_H */
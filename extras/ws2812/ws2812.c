@@ -37,6 +37,69 @@ void ws2812_set_many(uint8_t gpio_num, uint32_t *rgbs, size_t count)
 }
 
 
+/** Send one byte of each strip, zeros[] holds the "0" lines of each bit */
+static inline void ws2812_byte_parallel(uint32_t all, const uint32_t *zeros,
+                                        uint32_t t0h, uint32_t t1h, uint32_t period)
+{
+    for (uint8_t i = 0; i < 8; i++) {
+        uint32_t start = ws2812_ccount();
+        gpio_set_mask(all);
+        while (ws2812_ccount() - start < t0h) {}
+        gpio_clear_mask(zeros[i]);
+        while (ws2812_ccount() - start < t1h) {}
+        gpio_clear_mask(all);
+        while (ws2812_ccount() - start < period) {}
+    }
+}
+
+
+/** Set many RGBs on several strips at once */
+void ws2812_set_parallel(const uint8_t *gpio_nums, uint32_t *const *rgbs, size_t strips, size_t count)
+{
+    uint32_t masks[WS2812_MAX_PARALLEL];
+    uint32_t all = 0;
+
+    if (strips > WS2812_MAX_PARALLEL) {
+        strips = WS2812_MAX_PARALLEL;
+    }
+    for (size_t s = 0; s < strips; s++) {
+        masks[s] = BIT(gpio_nums[s]);
+        all |= masks[s];
+    }
+
+    const uint32_t x2 = (DPORT.CPU_CLOCK & DPORT_CPU_CLOCK_X2) ? 1 : 0;
+    const uint32_t t0h = WS2812_NS_TO_CYCLES(WS2812_T0H_NS) << x2;
+    const uint32_t t1h = WS2812_NS_TO_CYCLES(WS2812_T1H_NS) << x2;
+    const uint32_t period = WS2812_NS_TO_CYCLES(WS2812_BIT_NS) << x2;
+
+    // G, R, B byte order
+    static const uint8_t shifts[3] = { 8, 16, 0 };
+
+    ws2812_seq_start();
+
+    for (size_t i = 0; i < count; i++) {
+        for (uint8_t c = 0; c < 3; c++) {
+            // Transpose this byte of every strip into per-bit pin masks.
+            // Done in the low time after the previous bit, which is
+            // allowed to stretch (well below the reset time).
+            uint32_t zeros[8] = { 0 };
+            for (size_t s = 0; s < strips; s++) {
+                uint8_t byte = rgbs[s][i] >> shifts[c];
+                for (uint8_t b = 0; b < 8; b++) {
+                    if (!(byte & 0x80)) {
+                        zeros[b] |= masks[s];
+                    }
+                    byte <<= 1;
+                }
+            }
+            ws2812_byte_parallel(all, zeros, t0h, t1h, period);
+        }
+    }
+
+    ws2812_seq_end();
+}
+
+
 /** Set one RGB to black (when used as indicator) */
 void ws2812_off(uint8_t gpio_num)
 {
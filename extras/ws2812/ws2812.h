@@ -33,7 +33,11 @@
 #include <stddef.h> // size_t
 
 #include "espressif/esp_common.h" // sdk_os_delay_us
+#include "FreeRTOS.h"
+#include "task.h"
 #include "esp/gpio.h"
+#include "esp/clocks.h"
+#include "esp/dport_regs.h"
 
 /**
  * @brief Struct for easy manipulation of RGB colors.
@@ -87,6 +91,31 @@ void ws2812_set(uint8_t gpio_num, uint32_t rgb);
 void ws2812_set_many(uint8_t gpio_num, uint32_t *rgbs, size_t count);
 
 
+/** Maximum number of strips for ws2812_set_parallel() */
+#ifndef WS2812_MAX_PARALLEL
+#define WS2812_MAX_PARALLEL 8
+#endif
+
+
+/**
+ * @brief Set colors of several strips at once, and display them.
+ *
+ * All strips are clocked together, each bit slot raising every data
+ * line with one gpio_set_mask() write and dropping them in two
+ * gpio_clear_mask() writes (the "0" lines first, then the "1" lines).
+ * Refreshing N strips takes as long as refreshing one.
+ *
+ * Only GPIO0-15 can be used. Strips shorter than count should be
+ * padded by the caller.
+ *
+ * @param gpio_nums : data line GPIO number of each strip
+ * @param rgbs      : for each strip, an array of count 0x00RRGGBB colors
+ * @param strips    : number of strips (at most WS2812_MAX_PARALLEL)
+ * @param count     : number of pixels per strip
+ */
+void ws2812_set_parallel(const uint8_t *gpio_nums, uint32_t *const *rgbs, size_t strips, size_t count);
+
+
 /**
  * @brief Turn a single WS2812B off
  *
@@ -114,30 +143,48 @@ void ws2812_off(uint8_t gpio_num);
 
 
 
-// Ugly way to get short delays. Works for 80 MHz.
+// Bit timings in ns. The defaults suit the WS2812B, and are within
+// the tolerances of the older WS2812 too.
+
+#ifndef WS2812_T0H_NS
+#define WS2812_T0H_NS 400
+#endif
 
-// 400 ns
-#ifndef WS2812_SHORT_DELAY
-#define WS2812_SHORT_DELAY() for (volatile uint32_t __j = 1; __j > 0; __j--)
+#ifndef WS2812_T1H_NS
+#define WS2812_T1H_NS 800
 #endif
 
-// 800 ns
-#ifndef WS2812_LONG_DELAY
-#define WS2812_LONG_DELAY()  for (volatile uint32_t __j = 3; __j > 0; __j--)
+// Whole bit period, T0H + T0L or T1H + T1L
+#ifndef WS2812_BIT_NS
+#define WS2812_BIT_NS 1250
 #endif
 
+// Timings in CPU cycles at 80 MHz, doubled at runtime at 160 MHz
+#define WS2812_NS_TO_CYCLES(ns) (((ns) * (CPU_CLK_FREQ / 1000000) + 500) / 1000)
+
+
+/** Read the CPU cycle counter */
+static inline
+uint32_t ws2812_ccount(void)
+{
+    uint32_t ccount;
+    __asm__ volatile ("rsr %0, ccount" : "=a" (ccount));
+    return ccount;
+}
+
 
 /**
  * @brief Send a byte on the data line.
  *
  * The WS2812B is a form of PWM:
- * - each bit takes roughly 1 µs (but can be longer)
+ * - each bit takes roughly 1.25 µs (but can be longer)
  * - the duration of the ON part determines the value
  * - 800 ns -> "1"
  * - 400 ns -> "0"
  *
- * The timing must be very precise, you may need to adjust
- * it according for particular RGB model.
+ * Timing is done with the CPU cycle counter, following the current
+ * CPU frequency (80 or 160 MHz). The pin is driven through
+ * gpio_set_mask()/gpio_clear_mask(), so GPIO16 can't be used.
  *
  * @param gpio_num : data line GPIO number
  * @param byte : byte to send
@@ -145,20 +192,21 @@ void ws2812_off(uint8_t gpio_num);
 static inline
 void ws2812_byte(uint8_t gpio_num, uint8_t byte)
 {
-    for (register volatile uint8_t i = 0; i < 8; i++) {
-        gpio_write(gpio_num, 1);
+    const uint32_t mask = BIT(gpio_num);
+    const uint32_t x2 = (DPORT.CPU_CLOCK & DPORT_CPU_CLOCK_X2) ? 1 : 0;
+    const uint32_t t0h = WS2812_NS_TO_CYCLES(WS2812_T0H_NS) << x2;
+    const uint32_t t1h = WS2812_NS_TO_CYCLES(WS2812_T1H_NS) << x2;
+    const uint32_t period = WS2812_NS_TO_CYCLES(WS2812_BIT_NS) << x2;
 
+    for (uint8_t i = 0; i < 8; i++) {
         // duty cycle determines the bit value
+        uint32_t high = (byte & 0x80) ? t1h : t0h;
 
-        if (byte & 0x80) {
-            WS2812_LONG_DELAY();
-            gpio_write(gpio_num, 0);
-            WS2812_SHORT_DELAY();
-        } else {
-            WS2812_SHORT_DELAY();
-            gpio_write(gpio_num, 0);
-            WS2812_LONG_DELAY();
-        }
+        uint32_t start = ws2812_ccount();
+        gpio_set_mask(mask);
+        while (ws2812_ccount() - start < high) {}
+        gpio_clear_mask(mask);
+        while (ws2812_ccount() - start < period) {}
 
         byte <<= 1; // shift to next bit
     }
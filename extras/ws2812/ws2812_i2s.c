@@ -0,0 +1,210 @@
+/**
+ * @file   ws2812_i2s.c
+ * @brief  ESP8266 DMA driver for WS2812, using the I2S peripheral
+ *
+ * MIT License
+ */
+
+#include "espressif/esp_common.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp/i2s_regs.h"
+#include "esp/slc.h"
+#include "esp/iomux.h"
+#include "esp/interrupts.h"
+#include "sdk_internal.h"
+
+#include "ws2812_i2s.h"
+
+
+// I2S base clock is 160 MHz, 160 / (5 * 10) = 3.2 MHz bit clock,
+// 4 I2S bits per WS2812 bit gives the standard 800 kHz data rate.
+#define I2S_CLKM_DIV 5
+#define I2S_BCK_DIV  10
+
+// Each color byte encodes to one 32-bit I2S word
+#define WORDS_PER_PIXEL 3
+
+// SLC descriptors hold at most 4095 bytes, keep chunks word aligned
+#define DESC_MAX_BYTES 4092
+
+// Zeros sent after a frame to latch it. 32 words = 320 us at 3.2 MHz,
+// which also covers the longer reset time of newer WS2812B parts.
+#define RESET_WORDS 32
+
+// I2S bit patterns for each nibble of a color byte, MSB first.
+// A "1" bit is 1110 (875 ns high), a "0" bit is 1000 (312 ns high).
+static const uint16_t nibble_bits[16] = {
+    0x8888, 0x888e, 0x88e8, 0x88ee, 0x8e88, 0x8e8e, 0x8ee8, 0x8eee,
+    0xe888, 0xe88e, 0xe8e8, 0xe8ee, 0xee88, 0xee8e, 0xeee8, 0xeeee,
+};
+
+static uint32_t *dma_buf;
+static size_t max_pixels;
+static struct SLCDescriptor *data_desc;
+static struct SLCDescriptor reset_desc;
+static struct SLCDescriptor idle_desc;
+static uint32_t zeros[RESET_WORDS];
+
+static volatile bool busy;
+static volatile xTaskHandle waiter;
+
+
+static inline uint32_t encode_byte(uint8_t byte)
+{
+    return ((uint32_t)nibble_bits[byte >> 4] << 16) | nibble_bits[byte & 0x0f];
+}
+
+
+static void IRAM slc_isr(void)
+{
+    uint32_t status = SLC.INT_STATUS;
+    SLC.INT_CLEAR = 0xffffffff;
+
+    // The DMA's "RX" side feeds the I2S transmitter
+    if (status & SLC_INT_STATUS_RX_EOF) {
+        portBASE_TYPE woken = pdFALSE;
+        busy = false;
+        if (waiter) {
+            vTaskNotifyGiveFromISR(waiter, &woken);
+        }
+        if (woken) {
+            portYIELD();
+        }
+    }
+}
+
+
+static void slc_init(void)
+{
+    SLC.CONF0 |= SLC_CONF0_RX_LINK_RESET | SLC_CONF0_TX_LINK_RESET;
+    SLC.CONF0 &= ~(SLC_CONF0_RX_LINK_RESET | SLC_CONF0_TX_LINK_RESET);
+    SLC.INT_CLEAR = 0xffffffff;
+
+    SLC.CONF0 = SET_FIELD(SLC.CONF0, SLC_CONF0_MODE, 1);
+    SLC.RX_DESCRIPTOR_CONF |= SLC_RX_DESCRIPTOR_CONF_INFOR_NO_REPLACE | SLC_RX_DESCRIPTOR_CONF_TOKEN_NO_REPLACE;
+    SLC.RX_DESCRIPTOR_CONF &= ~(SLC_RX_DESCRIPTOR_CONF_RX_FILL_ENABLE | SLC_RX_DESCRIPTOR_CONF_RX_EOF_MODE | SLC_RX_DESCRIPTOR_CONF_RX_FILL_MODE);
+
+    // TX (peripheral to memory) side is unused, but needs a valid descriptor
+    SLC.TX_LINK = SET_FIELD(SLC.TX_LINK, SLC_TX_LINK_DESCRIPTOR_ADDR, (uint32_t)&idle_desc & SLC_TX_LINK_DESCRIPTOR_ADDR_M);
+
+    _xt_isr_attach(INUM_SLC, slc_isr);
+    SLC.INT_ENABLE = SLC_INT_ENABLE_RX_EOF;
+    _xt_isr_unmask(BIT(INUM_SLC));
+}
+
+
+static void i2s_init(void)
+{
+    IOMUX_GPIO3 = IOMUX_SET_FUNC(IOMUX_GPIO3, IOMUX_GPIO3_FUNC_I2SO_DATA);
+
+    // Enable the I2S clock output from the BBPLL
+    sdk_rom_i2c_writeReg_Mask(0x67, 4, 4, 7, 7, 1);
+
+    I2S.CONF |= I2S_CONF_RESET_MASK;
+    I2S.CONF &= ~I2S_CONF_RESET_MASK;
+
+    // 16 bits per channel, data from DMA
+    I2S.FIFO_CONF &= ~(FIELD_MASK(I2S_FIFO_CONF_RX_FIFO_MOD) | FIELD_MASK(I2S_FIFO_CONF_TX_FIFO_MOD));
+    I2S.FIFO_CONF |= I2S_FIFO_CONF_DESCRIPTOR_ENABLE;
+
+    // Dual channel, so both 16-bit halves of each word go out in turn
+    I2S.CONF_CHANNELS &= ~(FIELD_MASK(I2S_CONF_CHANNELS_TX_CHANNEL_MOD) | FIELD_MASK(I2S_CONF_CHANNELS_RX_CHANNEL_MOD));
+
+    uint32_t conf = I2S.CONF;
+    conf &= ~(I2S_CONF_TX_SLAVE_MOD | FIELD_MASK(I2S_CONF_BITS_MOD) | FIELD_MASK(I2S_CONF_BCK_DIV) | FIELD_MASK(I2S_CONF_CLKM_DIV));
+    conf |= I2S_CONF_RIGHT_FIRST | I2S_CONF_MSB_RIGHT | I2S_CONF_RX_SLAVE_MOD | I2S_CONF_RX_MSB_SHIFT | I2S_CONF_TX_MSB_SHIFT;
+    conf |= VAL2FIELD_M(I2S_CONF_BCK_DIV, I2S_BCK_DIV) | VAL2FIELD_M(I2S_CONF_CLKM_DIV, I2S_CLKM_DIV);
+    I2S.CONF = conf;
+
+    I2S.CONF |= I2S_CONF_TX_START;
+}
+
+
+bool ws2812_i2s_init(size_t pixel_count)
+{
+    size_t bytes = pixel_count * WORDS_PER_PIXEL * sizeof(uint32_t);
+    size_t desc_count = (bytes + DESC_MAX_BYTES - 1) / DESC_MAX_BYTES;
+
+    dma_buf = malloc(bytes);
+    data_desc = malloc(desc_count * sizeof(struct SLCDescriptor));
+    if (!dma_buf || !data_desc) {
+        free(dma_buf);
+        free(data_desc);
+        return false;
+    }
+    max_pixels = pixel_count;
+
+    // Latch period, raises the EOF interrupt when done
+    reset_desc.flags = SLC_DESCRIPTOR_FLAGS(sizeof(zeros), sizeof(zeros), 0, 1, 1);
+    reset_desc.buf_ptr = (uint32_t)zeros;
+    reset_desc.next_link_ptr = (uint32_t)&idle_desc;
+
+    // Keeps the line low between frames
+    idle_desc.flags = SLC_DESCRIPTOR_FLAGS(sizeof(zeros), sizeof(zeros), 0, 0, 1);
+    idle_desc.buf_ptr = (uint32_t)zeros;
+    idle_desc.next_link_ptr = (uint32_t)&idle_desc;
+
+    slc_init();
+    i2s_init();
+    return true;
+}
+
+
+void ws2812_i2s_update(const uint32_t *rgbs, size_t count)
+{
+    if (count > max_pixels) {
+        count = max_pixels;
+    }
+
+    ws2812_i2s_wait();
+
+    uint32_t *out = dma_buf;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t rgb = rgbs[i];
+        *out++ = encode_byte(rgb >> 8);  // G
+        *out++ = encode_byte(rgb >> 16); // R
+        *out++ = encode_byte(rgb);       // B
+    }
+
+    // Chain the data descriptors, followed by the latch period
+    size_t bytes = count * WORDS_PER_PIXEL * sizeof(uint32_t);
+    struct SLCDescriptor *first = &reset_desc;
+    struct SLCDescriptor *desc = data_desc;
+    for (size_t offs = 0; offs < bytes; offs += DESC_MAX_BYTES, desc++) {
+        size_t len = bytes - offs;
+        if (len > DESC_MAX_BYTES) {
+            len = DESC_MAX_BYTES;
+        }
+        desc->flags = SLC_DESCRIPTOR_FLAGS(len, len, 0, 0, 1);
+        desc->buf_ptr = (uint32_t)dma_buf + offs;
+        desc->next_link_ptr = (offs + len < bytes) ? (uint32_t)(desc + 1) : (uint32_t)&reset_desc;
+        first = data_desc;
+    }
+
+    busy = true;
+
+    SLC.RX_LINK |= SLC_RX_LINK_STOP;
+    SLC.RX_LINK = SET_FIELD(SLC.RX_LINK & ~SLC_RX_LINK_STOP, SLC_RX_LINK_DESCRIPTOR_ADDR,
+                            (uint32_t)first & SLC_RX_LINK_DESCRIPTOR_ADDR_M);
+    SLC.RX_LINK |= SLC_RX_LINK_START;
+}
+
+
+bool ws2812_i2s_busy(void)
+{
+    return busy;
+}
+
+
+void ws2812_i2s_wait(void)
+{
+    waiter = xTaskGetCurrentTaskHandle();
+    while (busy) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+    waiter = NULL;
+}
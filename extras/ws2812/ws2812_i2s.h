@@ -0,0 +1,65 @@
+/**
+ * @file   ws2812_i2s.h
+ * @brief  ESP8266 DMA driver for WS2812, using the I2S peripheral
+ *
+ * Pixels are encoded into an I2S bit stream (4 I2S bits per WS2812
+ * bit, at 3.2 MHz) which the SLC DMA engine streams out of the I2S
+ * data pin. Once a frame has been handed over, the CPU is free and
+ * the output timing is unaffected by interrupts, Wi-Fi included.
+ *
+ * @note
+ * The I2S data output is fixed to GPIO3 (the UART0 RX pin), so this
+ * can't be used together with serial input.
+ *
+ * Each pixel needs 12 bytes of DMA buffer.
+ *
+ * MIT License
+ */
+
+#ifndef WS2812_I2S_H
+#define WS2812_I2S_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h> // size_t
+
+
+/**
+ * @brief Set up I2S, DMA and GPIO3 for a strip of up to pixel_count LEDs.
+ *
+ * Allocates the DMA buffer.
+ *
+ * @param pixel_count : maximum number of pixels per frame
+ * @return false if the buffer couldn't be allocated
+ */
+bool ws2812_i2s_init(size_t pixel_count);
+
+
+/**
+ * @brief Encode and start sending a frame of pixels.
+ *
+ * Waits for any previous frame to finish, encodes the colors into the
+ * DMA buffer and starts the transfer. Returns as soon as the transfer
+ * has been started, so the caller can render the next frame meanwhile.
+ *
+ * @param rgbs  : array of RGB colors in the 0x00RRGGBB format
+ * @param count : number of elements in the array (at most pixel_count)
+ */
+void ws2812_i2s_update(const uint32_t *rgbs, size_t count);
+
+
+/**
+ * @brief Check if a frame is still being sent.
+ */
+bool ws2812_i2s_busy(void);
+
+
+/**
+ * @brief Wait until the current frame (and latch period) has been sent.
+ *
+ * Waits on the calling task's notification (ulTaskNotifyTake).
+ */
+void ws2812_i2s_wait(void);
+
+
+#endif /* WS2812_I2S_H */
@@ -0,0 +1,105 @@
+/**
+ * @file   ws2812_strip.c
+ * @brief  Double buffered WS2812 strip, with gamma and brightness
+ *
+ * MIT License
+ */
+
+#include "espressif/esp_common.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include <stdlib.h>
+#include <string.h>
+
+#include "ws2812.h"
+#include "ws2812_strip.h"
+
+
+const uint8_t ws2812_gamma[256] = {
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   1,   1,   1,   1,
+      1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   2,   2,   2,   2,   2,   2,
+      2,   3,   3,   3,   3,   3,   3,   3,   4,   4,   4,   4,   4,   5,   5,   5,
+      5,   6,   6,   6,   6,   7,   7,   7,   7,   8,   8,   8,   9,   9,   9,  10,
+     10,  10,  11,  11,  11,  12,  12,  13,  13,  13,  14,  14,  15,  15,  16,  16,
+     17,  17,  18,  18,  19,  19,  20,  20,  21,  21,  22,  22,  23,  24,  24,  25,
+     25,  26,  27,  27,  28,  29,  29,  30,  31,  32,  32,  33,  34,  35,  35,  36,
+     37,  38,  39,  39,  40,  41,  42,  43,  44,  45,  46,  47,  48,  49,  50,  50,
+     51,  52,  54,  55,  56,  57,  58,  59,  60,  61,  62,  63,  64,  66,  67,  68,
+     69,  70,  72,  73,  74,  75,  77,  78,  79,  81,  82,  83,  85,  86,  87,  89,
+     90,  92,  93,  95,  96,  98,  99, 101, 102, 104, 105, 107, 109, 110, 112, 114,
+    115, 117, 119, 120, 122, 124, 126, 127, 129, 131, 133, 135, 137, 138, 140, 142,
+    144, 146, 148, 150, 152, 154, 156, 158, 160, 162, 164, 167, 169, 171, 173, 175,
+    177, 180, 182, 184, 186, 189, 191, 193, 196, 198, 200, 203, 205, 208, 210, 213,
+    215, 218, 220, 223, 225, 228, 231, 233, 236, 239, 241, 244, 247, 249, 252, 255,
+};
+
+
+bool ws2812_strip_init(ws2812_strip_t *strip, uint8_t gpio_num, size_t count)
+{
+    strip->front = calloc(count, sizeof(uint32_t));
+    strip->back = calloc(count, sizeof(uint32_t));
+    if (!strip->front || !strip->back) {
+        free(strip->front);
+        free(strip->back);
+        strip->front = strip->back = NULL;
+        return false;
+    }
+
+    strip->gpio_num = gpio_num;
+    strip->count = count;
+    ws2812_strip_set_brightness(strip, 255);
+    return true;
+}
+
+
+void ws2812_strip_free(ws2812_strip_t *strip)
+{
+    free(strip->front);
+    free(strip->back);
+    strip->front = strip->back = NULL;
+    strip->count = 0;
+}
+
+
+void ws2812_strip_set_brightness(ws2812_strip_t *strip, uint8_t brightness)
+{
+    strip->brightness = brightness;
+    for (int i = 0; i < 256; i++) {
+        strip->lut[i] = (ws2812_gamma[i] * (brightness + 1)) >> 8;
+    }
+}
+
+
+void ws2812_strip_swap(ws2812_strip_t *strip)
+{
+    uint32_t *tmp = strip->front;
+    strip->front = strip->back;
+    strip->back = tmp;
+}
+
+
+void ws2812_strip_show(ws2812_strip_t *strip)
+{
+    const uint8_t *lut = strip->lut;
+    const uint32_t *pixel = strip->front;
+    uint8_t gpio_num = strip->gpio_num;
+
+    ws2812_seq_start();
+
+    for (size_t i = 0; i < strip->count; i++) {
+        uint32_t rgb = *pixel++;
+        ws2812_byte(gpio_num, lut[(rgb >> 8) & 0xFF]);  // G
+        ws2812_byte(gpio_num, lut[(rgb >> 16) & 0xFF]); // R
+        ws2812_byte(gpio_num, lut[rgb & 0xFF]);         // B
+    }
+
+    ws2812_seq_end();
+}
+
+
+void ws2812_strip_commit(ws2812_strip_t *strip)
+{
+    ws2812_strip_swap(strip);
+    ws2812_strip_show(strip);
+}
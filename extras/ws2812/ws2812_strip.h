@@ -0,0 +1,109 @@
+/**
+ * @file   ws2812_strip.h
+ * @brief  Double buffered WS2812 strip, with gamma and brightness
+ *
+ * The application renders into the back buffer (ws2812_strip_pixels())
+ * while the front buffer holds the last committed frame.
+ * ws2812_strip_swap() exchanges the two, ws2812_strip_show() sends the
+ * front buffer, and ws2812_strip_commit() does both.
+ *
+ * Gamma correction and global brightness come from a single 256-entry
+ * lookup table per strip, applied to each byte as it is sent, so the
+ * rendering code only deals in linear full-scale colors.
+ *
+ * @note
+ * The GPIO must be configured for output before showing a frame.
+ *
+ * MIT License
+ */
+
+#ifndef WS2812_STRIP_H
+#define WS2812_STRIP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h> // size_t
+
+
+/** Gamma correction (2.8) table, used as the base of the strip LUT */
+extern const uint8_t ws2812_gamma[256];
+
+
+/** A strip of pixels on one GPIO */
+typedef struct {
+    uint8_t gpio_num;
+    uint8_t brightness;
+    size_t count;
+
+    /** Last committed frame, 0x00RRGGBB */
+    uint32_t *front;
+
+    /** Frame being rendered, 0x00RRGGBB */
+    uint32_t *back;
+
+    /** Gamma + brightness lookup, applied while sending */
+    uint8_t lut[256];
+} ws2812_strip_t;
+
+
+/**
+ * @brief Allocate the buffers for a strip.
+ *
+ * Both buffers start out black, at full brightness.
+ *
+ * @param strip    : strip to set up
+ * @param gpio_num : data line GPIO number
+ * @param count    : number of pixels
+ * @return false if the buffers couldn't be allocated
+ */
+bool ws2812_strip_init(ws2812_strip_t *strip, uint8_t gpio_num, size_t count);
+
+
+/**
+ * @brief Free the buffers of a strip.
+ */
+void ws2812_strip_free(ws2812_strip_t *strip);
+
+
+/**
+ * @brief Get the back buffer, to render the next frame into.
+ */
+static inline
+uint32_t *ws2812_strip_pixels(ws2812_strip_t *strip)
+{
+    return strip->back;
+}
+
+
+/**
+ * @brief Set the global brightness (0-255), rebuilds the lookup table.
+ *
+ * Takes effect on the next ws2812_strip_show().
+ */
+void ws2812_strip_set_brightness(ws2812_strip_t *strip, uint8_t brightness);
+
+
+/**
+ * @brief Exchange the front and back buffers.
+ *
+ * The back buffer then holds the frame before last, which is handy
+ * for effects that build on the previous frame.
+ */
+void ws2812_strip_swap(ws2812_strip_t *strip);
+
+
+/**
+ * @brief Send the front buffer to the strip.
+ *
+ * Interrupts are disabled while sending, as with ws2812_set_many().
+ */
+void ws2812_strip_show(ws2812_strip_t *strip);
+
+
+/**
+ * @brief Swap the buffers, and show the newly rendered frame.
+ */
+void ws2812_strip_commit(ws2812_strip_t *strip);
+
+
+#endif /* WS2812_STRIP_H */
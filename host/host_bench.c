@@ -0,0 +1,480 @@
+/* Host benchmark runner for the portable components
+ *
+ * Usage: bench [file...]
+ *
+ * Replays each file through the code 'make host-bench' builds for the
+ * host (see common.mk), checking every result against a plain reference
+ * implementation, and times it. A file is read as:
+ *
+ * - a pcap capture (tcpdump -w, Ethernet or raw IP link type): every
+ *   packet's IP datagram is checksummed with esp_chksum() and
+ *   esp_chksum_copy(), and CRC'd with each crc.h function,
+ * - an ESP8266 firmware image (starting with the 0xe9 or 0xea magic, as
+ *   the 0x00000.bin a program builds): loaded into the emulated flash and
+ *   checked with rboot_verify_image(),
+ * - anything else: checksummed and CRC'd as a stream of 1500 byte
+ *   packets.
+ *
+ * fmt.h's formatting is always compared against the host's snprintf()
+ * and timed, and the JSON parser is run over documents nested to
+ * JSON_PARSER_MAX_DEPTH and one deeper. With no files, a generated set of packets is used.
+ *
+ * Results are printed as CSV lines, as esp/bench.h prints them on the
+ * device but in nanoseconds per call:
+ *
+ *     BENCH,<name>,<samples>,<iterations>,<min>,<median>,<max>
+ *
+ * Everything else is prefixed with '#'. Any check that fails is
+ * reported, and makes the exit status 1.
+ *
+ * Host timings only show relative changes in the algorithms; the
+ * on-device benchmarks in examples/tests give the cycle counts.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <crc.h>
+#include <fmt.h>
+#include <esp_chksum.h>
+#include <rboot-ota.h>
+#include <json/json_parser.h>
+
+#include "host_stubs.h"
+
+#define SAMPLES 15
+#define WARMUP 2
+#define MAX_PACKETS 4096
+
+typedef struct {
+    const uint8_t *data;
+    uint16_t len;
+} packet_t;
+
+static packet_t packets[MAX_PACKETS];
+static int packet_count;
+static size_t packet_bytes;
+static uint8_t copy_buf[65536];
+static int failures;
+
+#define FAIL(...) do { printf("# FAIL: " __VA_ARGS__); printf("\n"); failures++; } while (0)
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Time 'iterations' calls of 'fn' per sample, as bench_measure() does */
+static void measure(const char *name, void (*fn)(void *arg), void *arg, unsigned iterations)
+{
+    uint64_t ns[SAMPLES];
+
+    for (int i = 0; i < WARMUP; i++)
+        fn(arg);
+    for (int s = 0; s < SAMPLES; s++) {
+        uint64_t start = now_ns();
+        for (unsigned i = 0; i < iterations; i++)
+            fn(arg);
+        ns[s] = (now_ns() - start) / iterations;
+    }
+    qsort(ns, SAMPLES, sizeof(ns[0]), cmp_u64);
+    printf("BENCH,%s,%d,%u,%llu,%llu,%llu\n", name, SAMPLES, iterations,
+           (unsigned long long)ns[0], (unsigned long long)ns[SAMPLES / 2],
+           (unsigned long long)ns[SAMPLES - 1]);
+}
+
+/* Enough calls per sample for about a millisecond of work */
+static unsigned iterations_for(size_t bytes)
+{
+    return bytes >= 1000000 ? 1 : 1000000 / (bytes + 1) + 1;
+}
+
+/* Reference implementations */
+
+static uint32_t ref_crc(uint32_t crc, const uint8_t *p, size_t len, uint32_t poly)
+{
+    while (len--) {
+        crc ^= *p++;
+        for (int i = 0; i < 8; i++)
+            crc = (crc >> 1) ^ (poly & -(crc & 1));
+    }
+    return crc;
+}
+
+/* lwip_standard_chksum(), LWIP_CHKSUM_ALGORITHM 1, with the halfwords
+   little endian as on the lx106 */
+static uint16_t ref_chksum(const uint8_t *p, size_t len)
+{
+    uint32_t acc = 0;
+    size_t i;
+
+    for (i = 0; i + 1 < len; i += 2)
+        acc += p[i] | (p[i + 1] << 8);
+    if (i < len)
+        acc += p[i];
+    while (acc >> 16)
+        acc = (acc & 0xffff) + (acc >> 16);
+    return acc;
+}
+
+/* Packet replays */
+
+static void run_chksum(void *arg)
+{
+    volatile uint16_t sum;
+    for (int i = 0; i < packet_count; i++)
+        sum = esp_chksum(packets[i].data, packets[i].len);
+    (void)sum;
+}
+
+static void run_chksum_copy(void *arg)
+{
+    volatile uint16_t sum;
+    for (int i = 0; i < packet_count; i++)
+        sum = esp_chksum_copy(copy_buf + ((uintptr_t)packets[i].data & 3),
+                              packets[i].data, packets[i].len);
+    (void)sum;
+}
+
+static void run_crc8(void *arg)
+{
+    volatile uint8_t crc;
+    for (int i = 0; i < packet_count; i++)
+        crc = crc8_maxim(0, packets[i].data, packets[i].len);
+    (void)crc;
+}
+
+static void run_crc16(void *arg)
+{
+    volatile uint16_t crc;
+    for (int i = 0; i < packet_count; i++)
+        crc = crc16_ibm(0, packets[i].data, packets[i].len);
+    (void)crc;
+}
+
+static void run_crc32(void *arg)
+{
+    volatile uint32_t crc;
+    for (int i = 0; i < packet_count; i++)
+        crc = crc32_ieee(0, packets[i].data, packets[i].len);
+    (void)crc;
+}
+
+static void check_packets(const char *label)
+{
+    for (int i = 0; i < packet_count; i++) {
+        const uint8_t *p = packets[i].data;
+        uint16_t len = packets[i].len;
+        uint16_t expected = ref_chksum(p, len);
+        uint8_t *d = copy_buf + ((uintptr_t)p & 3);
+
+        if (esp_chksum(p, len) != expected)
+            FAIL("%s packet %d: esp_chksum 0x%04x, expected 0x%04x", label, i,
+                 esp_chksum(p, len), expected);
+        if (esp_chksum_copy(d, p, len) != expected || memcmp(d, p, len))
+            FAIL("%s packet %d: esp_chksum_copy wrong", label, i);
+        if (crc8_maxim(0, p, len) != ref_crc(0, p, len, 0x8c))
+            FAIL("%s packet %d: crc8_maxim wrong", label, i);
+        if (crc16_ibm(0, p, len) != ref_crc(0, p, len, 0xa001))
+            FAIL("%s packet %d: crc16_ibm wrong", label, i);
+        if (crc32_ieee(0, p, len) != (uint32_t)~ref_crc(~0u, p, len, 0xedb88320))
+            FAIL("%s packet %d: crc32_ieee wrong", label, i);
+    }
+}
+
+static void bench_packets(const char *label)
+{
+    static const struct {
+        const char *name;
+        void (*fn)(void *arg);
+    } runs[] = {
+        { "esp_chksum", run_chksum },
+        { "esp_chksum_copy", run_chksum_copy },
+        { "crc8_maxim", run_crc8 },
+        { "crc16_ibm", run_crc16 },
+        { "crc32_ieee", run_crc32 },
+    };
+    char name[256];
+
+    printf("# %s: %d packets, %zu bytes\n", label, packet_count, packet_bytes);
+    check_packets(label);
+    for (int i = 0; i < sizeof(runs) / sizeof(runs[0]); i++) {
+        snprintf(name, sizeof(name), "%s/%s", label, runs[i].name);
+        measure(name, runs[i].fn, NULL, iterations_for(packet_bytes));
+    }
+}
+
+static void add_packet(const uint8_t *data, size_t len)
+{
+    if (packet_count == MAX_PACKETS || !len || len > sizeof(copy_buf) - 3)
+        return;
+    packets[packet_count].data = data;
+    packets[packet_count].len = len;
+    packet_count++;
+    packet_bytes += len;
+}
+
+static uint32_t get32(const uint8_t *p, bool swap)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return swap ? __builtin_bswap32(v) : v;
+}
+
+/* Classic pcap. Returns false if it isn't one. */
+static bool read_pcap(const uint8_t *file, size_t size)
+{
+    if (size < 24)
+        return false;
+    uint32_t magic = get32(file, false);
+    bool swap = (magic == 0xd4c3b2a1 || magic == 0x4d3cb2a1);
+    if (!swap && magic != 0xa1b2c3d4 && magic != 0xa1b23c4d)
+        return false;
+
+    uint32_t linktype = get32(file + 20, swap);
+    size_t link_header;
+    if (linktype == 1)          /* Ethernet */
+        link_header = 14;
+    else if (linktype == 101)   /* raw IP */
+        link_header = 0;
+    else {
+        printf("# unsupported pcap link type %u\n", linktype);
+        return true;
+    }
+
+    for (size_t off = 24; off + 16 <= size;) {
+        uint32_t caplen = get32(file + off + 8, swap);
+        off += 16;
+        if (caplen > size - off)
+            break;
+        if (caplen > link_header)
+            add_packet(file + off + link_header, caplen - link_header);
+        off += caplen;
+    }
+    return true;
+}
+
+/* Firmware images */
+
+static uint32_t image_len;
+
+static void run_verify(void *arg)
+{
+    rboot_verify_image(0, image_len, NULL);
+}
+
+static void bench_image(const char *label, const uint8_t *file, size_t size)
+{
+    char name[256];
+    const char *error = NULL;
+
+    if (host_flash_load(0, file, size)) {
+        FAIL("%s: %zu bytes doesn't fit in the emulated flash", label, size);
+        return;
+    }
+    image_len = size;
+    printf("# %s: firmware image, %zu bytes\n", label, size);
+    if (!rboot_verify_image(0, size, &error)) {
+        FAIL("%s: rboot_verify_image: %s", label, error);
+        return;
+    }
+    snprintf(name, sizeof(name), "%s/rboot_verify_image", label);
+    measure(name, run_verify, NULL, iterations_for(size));
+}
+
+/* Formatting, against the host's snprintf() */
+
+#define FMT_CASES(X)                                                           \
+    X("%d clients, up %u s", -42, 12345u)                                      \
+    X("%08x|%-8X|%#o", 0xdeadbeefu, 0xcafeu, 0755u)                            \
+    X("%5.3s|%-6s|%c", "abcdef", "xy", 'z')                                    \
+    X("%+lld %llu", -1234567890123ll, 18446744073709551615ull)                 \
+    X("%*d|%-*d|%.*d", 6, 7, 6, 7, 4, 7)                                       \
+    X("%hhu %hd %zu", 300, 70000, (size_t)99)
+
+static void run_fmt(void *arg)
+{
+    char buf[128];
+#define FMT_RUN(...) fmt_snprintf(buf, sizeof(buf), __VA_ARGS__);
+    FMT_CASES(FMT_RUN)
+}
+
+static void check_fmt(void)
+{
+    char got[128], expected[128];
+    int n, e;
+#define FMT_CHECK(...)                                                         \
+    n = fmt_snprintf(got, sizeof(got), __VA_ARGS__);                           \
+    e = snprintf(expected, sizeof(expected), __VA_ARGS__);                     \
+    if (n != e || strcmp(got, expected))                                       \
+        FAIL("fmt_snprintf(%s): \"%s\", expected \"%s\"", #__VA_ARGS__, got, expected);
+    FMT_CASES(FMT_CHECK)
+}
+
+/* JSON nesting: 'depth' levels of containers, objects at odd levels
+   (so the deepest, level 31 at JSON_PARSER_MAX_DEPTH, is an object)
+   around a number */
+
+static char json_doc[JSON_PARSER_MAX_DEPTH * 8 + 8];
+
+static size_t json_nested(int depth)
+{
+    size_t n = 0;
+
+    for (int i = 0; i < depth; i++)
+        n += sprintf(json_doc + n, i & 1 ? "{\"k\":" : "[");
+    n += sprintf(json_doc + n, "1");
+    for (int i = depth - 1; i >= 0; i--)
+        n += sprintf(json_doc + n, i & 1 ? "}" : "]");
+    return n;
+}
+
+typedef struct {
+    int objects, arrays;    /* ends seen */
+    int value_depth;
+} json_count_t;
+
+static bool count_json(json_parser_t *jp, json_event_t event, const char *value, size_t len)
+{
+    json_count_t *count = jp->arg;
+
+    if (event == JSON_OBJECT_END)
+        count->objects++;
+    else if (event == JSON_ARRAY_END)
+        count->arrays++;
+    else if (event == JSON_NUMBER)
+        count->value_depth = jp->depth;
+    return true;
+}
+
+static void run_json(void *arg)
+{
+    json_parser_t jp;
+    json_count_t count;
+
+    json_parser_init(&jp, count_json, &count);
+    json_parser_feed(&jp, json_doc, *(size_t *)arg);
+    json_parser_finish(&jp);
+}
+
+static void check_json(void)
+{
+    json_parser_t jp;
+    json_count_t count = { 0 };
+    size_t len = json_nested(JSON_PARSER_MAX_DEPTH);
+    int err;
+
+    json_parser_init(&jp, count_json, &count);
+    err = json_parser_feed(&jp, json_doc, len);
+    if (err == JSON_PARSER_OK)
+        err = json_parser_finish(&jp);
+    if (err != JSON_PARSER_OK || !json_parser_done(&jp))
+        FAIL("json_parser: depth %d: error %d at %u", JSON_PARSER_MAX_DEPTH, err, (unsigned)jp.offset);
+    else if (count.objects != JSON_PARSER_MAX_DEPTH / 2 || count.arrays != JSON_PARSER_MAX_DEPTH / 2
+             || count.value_depth != JSON_PARSER_MAX_DEPTH)
+        FAIL("json_parser: depth %d: %d objects, %d arrays, value at depth %d",
+             JSON_PARSER_MAX_DEPTH, count.objects, count.arrays, count.value_depth);
+    else
+        measure("json_parser_nested", run_json, &len, iterations_for(len));
+
+    len = json_nested(JSON_PARSER_MAX_DEPTH + 1);
+    json_parser_init(&jp, count_json, &count);
+    err = json_parser_feed(&jp, json_doc, len);
+    if (err != JSON_PARSER_ERR_DEPTH)
+        FAIL("json_parser: depth %d: error %d, expected %d", JSON_PARSER_MAX_DEPTH + 1, err,
+             JSON_PARSER_ERR_DEPTH);
+}
+
+/* Packets with the structure of a busy link's: mostly full size or
+   small, at every alignment */
+static void generate_packets(void)
+{
+    static uint8_t data[MAX_PACKETS / 4 * 1600];
+    static const uint16_t sizes[] = { 40, 52, 64, 328, 576, 1500 };
+    uint32_t seed = 1;
+    size_t off = 0;
+
+    for (size_t i = 0; i < sizeof(data); i++) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = seed >> 16;
+    }
+    for (int i = 0; off + 1504 <= sizeof(data); i++) {
+        uint16_t len = sizes[i % 6];
+        add_packet(data + off + (i & 3), len);
+        off += (len + 7) & ~3;
+    }
+}
+
+static uint8_t *read_file(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    uint8_t *data = NULL;
+    long len;
+
+    if (!f)
+        return NULL;
+    if (fseek(f, 0, SEEK_END) == 0 && (len = ftell(f)) >= 0) {
+        rewind(f);
+        data = malloc(len + 1);
+        if (data && fread(data, 1, len, f) != (size_t)len) {
+            free(data);
+            data = NULL;
+        }
+        *size = len;
+    }
+    fclose(f);
+    return data;
+}
+
+int main(int argc, char **argv)
+{
+    printf("# host bench, %d samples, ns per call\n", SAMPLES);
+    printf("# BENCH,name,samples,iterations,min,median,max\n");
+
+    check_fmt();
+    measure("fmt_snprintf", run_fmt, NULL, 10000);
+    check_json();
+
+    if (argc < 2) {
+        generate_packets();
+        bench_packets("generated");
+    }
+    for (int i = 1; i < argc; i++) {
+        size_t size;
+        uint8_t *file = read_file(argv[i], &size);
+        if (!file) {
+            FAIL("can't read %s", argv[i]);
+            continue;
+        }
+        packet_count = 0;
+        packet_bytes = 0;
+        if (read_pcap(file, size)) {
+            bench_packets(argv[i]);
+        } else if (size && (file[0] == 0xe9 || file[0] == 0xea)) {
+            bench_image(argv[i], file, size);
+        } else {
+            for (size_t off = 0; off < size; off += 1500)
+                add_packet(file + off, size - off < 1500 ? size - off : 1500);
+            bench_packets(argv[i]);
+        }
+        free(file);
+    }
+
+    printf("# %d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,90 @@
+/* SDK stand-ins for the host build
+ *
+ * The sdk_spi_flash_* functions read and write an erased-to-0xff buffer
+ * in memory, so code like rboot_verify_image() can be run against
+ * firmware images loaded with host_flash_load(). Like the real ones
+ * they fail for unaligned addresses and sizes, and writes can only
+ * clear bits.
+ *
+ * There's no scheduler, so time is a tick counter that only moves when
+ * vTaskDelay() is called; rate limited code like rboot_write_throttle()
+ * then runs flat out while still seeing the delays it asked for.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <espressif/spi_flash.h>
+#include <esp/uart.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "host_stubs.h"
+
+static uint8_t _flash[HOST_FLASH_SIZE];
+static TickType_t _ticks;
+
+static int _in_range(uint32_t addr, uint32_t size)
+{
+    return !(addr & 3) && !(size & 3) && addr <= HOST_FLASH_SIZE
+        && size <= HOST_FLASH_SIZE - addr;
+}
+
+int host_flash_load(uint32_t offset, const void *data, size_t len)
+{
+    memset(_flash, 0xff, sizeof(_flash));
+    if (offset > HOST_FLASH_SIZE || len > HOST_FLASH_SIZE - offset)
+        return -1;
+    memcpy(_flash + offset, data, len);
+    return 0;
+}
+
+uint8_t *host_flash(void)
+{
+    return _flash;
+}
+
+sdk_SpiFlashOpResult sdk_spi_flash_read(uint32_t src_addr, void *des, uint32_t size)
+{
+    if (!_in_range(src_addr, size))
+        return SPI_FLASH_RESULT_ERR;
+    memcpy(des, _flash + src_addr, size);
+    return SPI_FLASH_RESULT_OK;
+}
+
+sdk_SpiFlashOpResult sdk_spi_flash_write(uint32_t des_addr, const void *src, uint32_t size)
+{
+    const uint8_t *s = src;
+
+    if (!_in_range(des_addr, size))
+        return SPI_FLASH_RESULT_ERR;
+    for (uint32_t i = 0; i < size; i++)
+        _flash[des_addr + i] &= s[i];
+    return SPI_FLASH_RESULT_OK;
+}
+
+sdk_SpiFlashOpResult sdk_spi_flash_erase_sector(uint16_t sec)
+{
+    if (!_in_range(sec * SPI_FLASH_SEC_SIZE, SPI_FLASH_SEC_SIZE))
+        return SPI_FLASH_RESULT_ERR;
+    memset(_flash + sec * SPI_FLASH_SEC_SIZE, 0xff, SPI_FLASH_SEC_SIZE);
+    return SPI_FLASH_RESULT_OK;
+}
+
+size_t uart_write(int uart_num, const void *data, size_t len)
+{
+    return fwrite(data, 1, len, stdout);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return _ticks;
+}
+
+void vTaskDelay(const TickType_t xTicksToDelay)
+{
+    _ticks += xTicksToDelay;
+}
@@ -0,0 +1,23 @@
+/* SDK stand-ins for the host build, see host/host_stubs.c
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _HOST_STUBS_H
+#define _HOST_STUBS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Size of the emulated flash, the largest ESP8266 modules' 4MB */
+#define HOST_FLASH_SIZE (4 * 1024 * 1024)
+
+/* Erase the emulated flash, then copy 'len' bytes to it at 'offset'.
+   Returns 0, or -1 if they don't fit. */
+int host_flash_load(uint32_t offset, const void *data, size_t len);
+
+/* The emulated flash contents */
+uint8_t *host_flash(void);
+
+#endif
@@ -0,0 +1,21 @@
+/* Host build stand-in for FreeRTOS's FreeRTOS.h. There's no scheduler on the
+ * host, so critical sections and yields do nothing, and the tick count is
+ * simulated (see host/host_stubs.c).
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef INC_FREERTOS_H
+#define INC_FREERTOS_H
+
+#include <stdint.h>
+
+#define configTICK_RATE_HZ 100
+
+typedef uint32_t TickType_t;
+
+#define vPortEnterCritical() do {} while (0)
+#define vPortExitCritical() do {} while (0)
+
+#endif
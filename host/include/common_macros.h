@@ -0,0 +1,23 @@
+/* Host build stand-in for core/include/common_macros.h
+ *
+ * The placement attributes mean nothing off the ESP8266, so they're
+ * empty here, which keeps the portable sources building unchanged.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _COMMON_MACROS_H
+#define _COMMON_MACROS_H
+
+#define UNUSED __attribute__((unused))
+
+#ifndef BIT
+#define BIT(X) (1<<(X))
+#endif
+
+#define IROM const
+#define IRAM
+#define IRAM_DATA const
+
+#endif
@@ -0,0 +1,15 @@
+/* Host build stand-in for core/include/esp/uart.h: every UART writes
+ * to stdout.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _ESP_UART_H
+#define _ESP_UART_H
+
+#include <stddef.h>
+
+size_t uart_write(int uart_num, const void *data, size_t len);
+
+#endif
@@ -0,0 +1,37 @@
+/* Host build stand-in for lwIP's netbuf.h: a netbuf is a pbuf chain and
+ * a pointer to the current segment of it.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef __LWIP_NETBUF_H__
+#define __LWIP_NETBUF_H__
+
+#include "lwip/pbuf.h"
+
+struct netbuf {
+    struct pbuf *p, *ptr;
+};
+
+static inline void netbuf_first(struct netbuf *buf)
+{
+    buf->ptr = buf->p;
+}
+
+static inline s8_t netbuf_next(struct netbuf *buf)
+{
+    if (!buf->ptr->next)
+        return -1;
+    buf->ptr = buf->ptr->next;
+    return buf->ptr->next ? 0 : 1;
+}
+
+static inline s8_t netbuf_data(struct netbuf *buf, void **dataptr, u16_t *len)
+{
+    *dataptr = buf->ptr->payload;
+    *len = buf->ptr->len;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,16 @@
+/* Host build stand-in for lwIP's opt.h, for the esp-open-rtos lwIP
+ * port sources that only need its memory macros.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef __LWIP_OPT_H__
+#define __LWIP_OPT_H__
+
+#include <string.h>
+
+#define MEMCPY(dst,src,len) memcpy(dst,src,len)
+#define SMEMCPY(dst,src,len) memcpy(dst,src,len)
+
+#endif
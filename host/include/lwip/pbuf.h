@@ -0,0 +1,24 @@
+/* Host build stand-in for lwIP's pbuf.h, with just the fields that
+ * code walking a pbuf chain reads.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef __LWIP_PBUF_H__
+#define __LWIP_PBUF_H__
+
+#include <stdint.h>
+
+typedef uint8_t u8_t;
+typedef int8_t s8_t;
+typedef uint16_t u16_t;
+
+struct pbuf {
+    struct pbuf *next;
+    void *payload;
+    u16_t tot_len;
+    u16_t len;
+};
+
+#endif
@@ -0,0 +1,19 @@
+/* Host build stand-in for FreeRTOS's task.h. There's no scheduler on the
+ * host, so yields do nothing and delays just advance the simulated
+ * tick count.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef TASK_H
+#define TASK_H
+
+#include "FreeRTOS.h"
+
+#define taskYIELD() do {} while (0)
+
+TickType_t xTaskGetTickCount(void);
+void vTaskDelay(const TickType_t xTicksToDelay);
+
+#endif
@@ -72,6 +72,11 @@ enum {
 
 uint8_t sdk_wifi_station_get_connect_status(void);
 
+/* The DHCP client runs by default. Stop it before setting a static
+   address with sdk_wifi_set_ip_info(STATION_IF, ...) */
+bool sdk_wifi_station_dhcpc_start(void);
+bool sdk_wifi_station_dhcpc_stop(void);
+
 #ifdef	__cplusplus
 }
 #endif
@@ -23,6 +23,17 @@ typedef struct _os_timer_t {
     void               *timer_arg;
 } sdk_os_timer_t;
 
+/* Set the function a timer calls, disarming it if it was armed. Must be
+   called before sdk_os_timer_arm(). */
+void sdk_os_timer_setfn(sdk_os_timer_t *ptimer, sdk_os_timer_func_t *pfunction, void *parg);
+
+/* Arm (or re-arm) a timer to call its function after 'msec' ms, and
+   every 'msec' ms after that if repeat_flag is set. Calls are from the
+   FreeRTOS timer task. */
+void sdk_os_timer_arm(sdk_os_timer_t *ptimer, uint32_t msec, bool repeat_flag);
+
+void sdk_os_timer_disarm(sdk_os_timer_t *ptimer);
+
 #ifdef	__cplusplus
 }
 #endif
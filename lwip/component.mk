@@ -10,6 +10,16 @@ lwip_SRC_DIR = $(lwip_ROOT) $(LWIP_DIR)api $(LWIP_DIR)core $(LWIP_DIR)core/ipv4
 # LWIP 1.4.1 generates a single warning so we need to disable -Werror when building it
 lwip_CFLAGS = $(CFLAGS) -Wno-address
 
+# Per packet paths stay at -O2 whatever the FLAVOR, see OPT_OVERRIDES in
+# common.mk. The checksum loop itself is esp_chksum.c, unrolled by hand.
+lwip_OPT_esp_chksum.c ?= -O2
+lwip_OPT_inet_chksum.c ?= -O2
+lwip_OPT_pbuf.c ?= -O2
+lwip_OPT_tcp_in.c ?= -O2
+lwip_OPT_tcp_out.c ?= -O2
+lwip_OPT_ip.c ?= -O2
+lwip_OPT_udp.c ?= -O2
+
 $(eval $(call component_compile_rules,lwip))
 
 # Helpful error if git submodule not initialised
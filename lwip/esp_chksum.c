@@ -0,0 +1,133 @@
+/* Internet checksum for lwIP, tuned for the lx106, see esp_chksum.h
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <common_macros.h>
+
+#include "lwip/opt.h"
+#include "esp/flashmap.h"
+#include "esp_chksum.h"
+
+#define FOLD(sum) (((sum) >> 16) + ((sum) & 0xffff))
+#define SWAP(sum) ((((sum) & 0xff) << 8) | (((sum) >> 8) & 0xff))
+
+/* Sum of the halfwords in 'words' aligned words at 's', copied to 'd'
+   as well unless it's NULL.
+
+   Only the word itself and its high halfword are added up: the sum of
+   the low halfwords is then the difference (modulo 2^32, exactly, as
+   it can't reach 2^32 for fewer than 65537 words) and no carries need
+   to be caught on the way. */
+static inline __attribute__((always_inline))
+uint32_t sum_words(uint32_t *d, const uint32_t *s, size_t words)
+{
+    uint32_t total = 0, high = 0;
+
+    for (; words >= 4; words -= 4) {
+        uint32_t w0 = s[0], w1 = s[1], w2 = s[2], w3 = s[3];
+        if (d) {
+            d[0] = w0;
+            d[1] = w1;
+            d[2] = w2;
+            d[3] = w3;
+            d += 4;
+        }
+        total += w0 + w1 + w2 + w3;
+        high += (w0 >> 16) + (w1 >> 16) + (w2 >> 16) + (w3 >> 16);
+        s += 4;
+    }
+    for (; words; words--) {
+        uint32_t w = *s++;
+        if (d)
+            *d++ = w;
+        total += w;
+        high += w >> 16;
+    }
+    return FOLD(total - (high << 16)) + FOLD(high);
+}
+
+/* Byte and halfword loads for the ends, with aligned word loads if 's'
+   is in the flash cache window (where narrower loads would each take a
+   LoadStoreError exception) */
+#define LOAD8(s, flash) ((flash) ? flashmap_read8(s) : *(const uint8_t *)(s))
+#define LOAD16(s, flash) ((flash) ? flashmap_read16(s) : *(const uint16_t *)(s))
+
+/* The checksum of 'len' bytes at 's', copying them to 'd' as well
+   unless it's NULL. 'd' must have the same word alignment as 's'. */
+static inline __attribute__((always_inline))
+uint16_t chksum(uint8_t *d, const uint8_t *s, size_t len, bool flash)
+{
+    uint32_t sum = 0;
+    int odd = (uintptr_t)s & 1;
+
+    /* Starting at an odd address, the bytes are summed paired the other
+       way round from the first one on, and swapped back at the end */
+    if (odd && len) {
+        uint8_t b = LOAD8(s, flash);
+        if (d)
+            *d++ = b;
+        sum = b << 8;
+        s++;
+        len--;
+    }
+    if (((uintptr_t)s & 2) && len >= 2) {
+        uint16_t h = LOAD16(s, flash);
+        if (d) {
+            *(uint16_t *)d = h;
+            d += 2;
+        }
+        sum += h;
+        s += 2;
+        len -= 2;
+    }
+
+    sum += sum_words((uint32_t *)d, (const uint32_t *)s, len / 4);
+    s += len & ~3;
+    if (d)
+        d += len & ~3;
+
+    if (len & 2) {
+        uint16_t h = LOAD16(s, flash);
+        if (d) {
+            *(uint16_t *)d = h;
+            d += 2;
+        }
+        sum += h;
+        s += 2;
+    }
+    if (len & 1) {
+        uint8_t b = LOAD8(s, flash);
+        if (d)
+            *d = b;
+        sum += b;
+    }
+
+    sum = FOLD(sum);
+    sum = FOLD(sum);
+    return odd ? SWAP(sum) : sum;
+}
+
+#define IN_FLASHMAP(p) ((uintptr_t)(p) - FLASHMAP_BASE < FLASHMAP_SIZE)
+
+uint16_t IRAM esp_chksum(const void *data, uint16_t len)
+{
+    if (IN_FLASHMAP(data))
+        return chksum(NULL, data, len, true);
+    return chksum(NULL, data, len, false);
+}
+
+uint16_t IRAM esp_chksum_copy(void *dst, const void *src, uint16_t len)
+{
+    if (((uintptr_t)dst ^ (uintptr_t)src) & 3) {
+        MEMCPY(dst, src, len);
+        return esp_chksum(dst, len);
+    }
+    if (IN_FLASHMAP(src))
+        return chksum(dst, src, len, true);
+    return chksum(dst, src, len, false);
+}
@@ -37,6 +37,8 @@
  * Original Author: Simon Goldschmidt
  * Modified by Angus Gratton based on work by @kadamski/Espressif via esp-lwip project.
  */
+#include <string.h>
+
 #include "lwip/opt.h"
 
 #include "lwip/def.h"
@@ -45,17 +47,144 @@
 #include <lwip/stats.h>
 #include <lwip/snmp.h>
 #include "netif/etharp.h"
+#include "lwip/ip.h"
+#include "ethernetif_filter.h"
+#include "ethernetif_timestamp.h"
+#include "ethernetif_poll.h"
+#include "lwip/tcpip.h"
+#include "esp/hrtimer.h"
 
 /* declared in libnet80211.a */
 int8_t sdk_ieee80211_output_pbuf(struct netif *ifp, struct pbuf* pb);
 
+/* The MAC takes one contiguous buffer in DRAM per frame, and keeps its
+   own reference to the pbuf until the frame has gone out.
+
+   A single pbuf in DRAM (of any type, including PBUF_REF payloads) is
+   handed over as-is. TCP segments always arrive like this as
+   LWIP_NETIF_TX_SINGLE_PBUF is set, so bulk TCP data isn't copied
+   again here. Anything chained (UDP with a separate payload pbuf,
+   fragments, ...) is flattened with a single copy, sending the links
+   one by one would put each on air as a separate, broken, frame. So is
+   a pbuf whose payload the MAC's DMA can't read: anything in the flash
+   cache window or IRAM.
+
+   Sending constant data from flash: the MAC can't read it where it is,
+   so it's copied to DRAM exactly once, with word loads (MEMCPY in
+   lwipopts.h), straight into the outgoing frame:
+
+   - TCP: netconn_write(conn, data, len, NETCONN_NOCOPY), or tcp_write()
+     without TCP_WRITE_FLAG_COPY. With LWIP_NETIF_TX_SINGLE_PBUF tcp_write
+     copies into the segment anyway, checksumming it in the same pass
+     (esp_chksum_copy), and flash data stays valid for retransmissions.
+   - UDP: netbuf_ref(buf, data, len) then netconn_send(), or a PBUF_ROM
+     pbuf with udp_send(). The checksum is computed from flash, and the
+     header and payload are joined by the copy here.
+
+   Either way no intermediate copy of the data is needed in DRAM.
+*/
+#define DMA_CAN_READ(ptr) ((uint32_t)(ptr) < 0x40000000)
+
+typedef struct {
+  const struct pbuf *first;
+  const struct pbuf *last;
+  uint64_t us;
+} timestamp_t;
+
+static bool timestamping;
+static timestamp_t rx_times[ETHERNETIF_TIMESTAMP_SLOTS];
+static timestamp_t tx_times[ETHERNETIF_TIMESTAMP_SLOTS];
+static u8_t rx_next, tx_next;
+
+void ethernetif_timestamping(bool enable)
+{
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  SYS_ARCH_PROTECT(lev);
+  memset(rx_times, 0, sizeof(rx_times));
+  memset(tx_times, 0, sizeof(tx_times));
+  timestamping = enable;
+  SYS_ARCH_UNPROTECT(lev);
+}
+
+static void timestamp(timestamp_t *ring, u8_t *next, const struct pbuf *p)
+{
+  const struct pbuf *last = p;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  while (last->next != NULL) {
+    last = last->next;
+  }
+  /* Taken first, so the time doesn't include waiting for the lock */
+  uint64_t us = hrtimer_now_us64();
+
+  SYS_ARCH_PROTECT(lev);
+  timestamp_t *t = &ring[*next];
+  *next = (*next + 1) % ETHERNETIF_TIMESTAMP_SLOTS;
+  t->first = p;
+  t->last = last;
+  t->us = us;
+  SYS_ARCH_UNPROTECT(lev);
+}
+
+/* Newest first: a pbuf that's been freed and allocated again since is
+   found as the frame it's in now */
+static bool find_timestamp(const timestamp_t *ring, u8_t next, const struct pbuf *p, uint64_t *us)
+{
+  bool found = false;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  SYS_ARCH_PROTECT(lev);
+  for (int i = 1; i <= ETHERNETIF_TIMESTAMP_SLOTS; i++) {
+    const timestamp_t *t = &ring[(next + ETHERNETIF_TIMESTAMP_SLOTS - i) % ETHERNETIF_TIMESTAMP_SLOTS];
+    if (p != NULL && (t->first == p || t->last == p)) {
+      *us = t->us;
+      found = true;
+      break;
+    }
+  }
+  SYS_ARCH_UNPROTECT(lev);
+  return found;
+}
+
+bool ethernetif_rx_timestamp(const struct pbuf *p, uint64_t *us)
+{
+  return find_timestamp(rx_times, rx_next, p, us);
+}
+
+bool ethernetif_tx_timestamp(const struct pbuf *p, uint64_t *us)
+{
+  return find_timestamp(tx_times, tx_next, p, us);
+}
+
 static err_t
 low_level_output(struct netif *netif, struct pbuf *p)
 {
-  struct pbuf *q;
+  struct pbuf *q = p;
+  int8_t err;
+
+  if (p->next != NULL || !DMA_CAN_READ(p->payload)) {
+      q = pbuf_alloc(PBUF_RAW, p->tot_len, PBUF_RAM);
+      if (q == NULL) {
+          LINK_STATS_INC(link.memerr);
+          LINK_STATS_INC(link.drop);
+          return ERR_MEM;
+      }
+      pbuf_copy(q, p);
+  }
+
+  if (timestamping) {
+    timestamp(tx_times, &tx_next, p);
+  }
+  err = sdk_ieee80211_output_pbuf(netif, q);
 
-  for(q = p; q != NULL; q = q->next) {
-      sdk_ieee80211_output_pbuf(netif, q);
+  if (q != p) {
+      pbuf_free(q);
+  }
+
+  if (err != 0) {
+      LINK_STATS_INC(link.err);
+      return ERR_IF;
   }
 
   LINK_STATS_INC(link.xmit);
@@ -91,32 +220,221 @@ err_t ethernetif_init(struct netif *netif)
   /* hwaddr seems to be set elsewhere, or (more likely) is set on tx by MAC layer */
   netif->mtu = 1500;
   netif->flags = NETIF_FLAG_ETHARP | NETIF_FLAG_LINK_UP;
+#if LWIP_IGMP
+  netif->flags |= NETIF_FLAG_IGMP;
+#endif
 
   return ERR_OK;
 }
 
+static ethernetif_filter_rule_t filter_rules[ETHERNETIF_FILTER_MAX_RULES];
+static u32_t filter_hits[ETHERNETIF_FILTER_MAX_RULES];
+static int filter_count;
+static u32_t filter_dropped;
+static ethernetif_filter_hook_t filter_hook;
+
+int ethernetif_filter_add(const ethernetif_filter_rule_t *rule)
+{
+  int index = -1;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  SYS_ARCH_PROTECT(lev);
+  if (filter_count < ETHERNETIF_FILTER_MAX_RULES) {
+    index = filter_count;
+    filter_rules[index] = *rule;
+    filter_hits[index] = 0;
+    filter_count++;
+  }
+  SYS_ARCH_UNPROTECT(lev);
+  return index;
+}
+
+void ethernetif_filter_clear(void)
+{
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  SYS_ARCH_PROTECT(lev);
+  filter_count = 0;
+  SYS_ARCH_UNPROTECT(lev);
+}
+
+u32_t ethernetif_filter_hits(int index)
+{
+  if (index < 0 || index >= ETHERNETIF_FILTER_MAX_RULES) {
+    return 0;
+  }
+  return filter_hits[index];
+}
+
+u32_t ethernetif_filter_dropped(void)
+{
+  return filter_dropped;
+}
+
+void ethernetif_filter_set_hook(ethernetif_filter_hook_t hook)
+{
+  filter_hook = hook;
+}
+
+/* Return non-zero if the frame should go on to the stack */
+static int filter_accept(struct netif *netif, struct pbuf *p)
+{
+  struct eth_hdr *ethhdr = p->payload;
+  u16_t type = htons(ethhdr->type);
+  u8_t mac_class = ETHERNETIF_FILTER_MAC_ANY;
+  struct ip_hdr *iphdr = NULL;
+  u16_t dst_port = 0;
+
+  if (filter_count == 0 && filter_hook == NULL) {
+    return 1;
+  }
+
+  if (ethhdr->dest.addr[0] & 1) {
+    mac_class = (ethhdr->dest.addr[0] & ethhdr->dest.addr[1] & ethhdr->dest.addr[2] &
+                 ethhdr->dest.addr[3] & ethhdr->dest.addr[4] & ethhdr->dest.addr[5]) == 0xff
+      ? ETHERNETIF_FILTER_MAC_BROADCAST : ETHERNETIF_FILTER_MAC_MULTICAST;
+  }
+
+  /* IPv4 and transport headers, if they are all in the first pbuf */
+  if (type == ETHTYPE_IP && p->len >= SIZEOF_ETH_HDR + IP_HLEN) {
+    iphdr = (struct ip_hdr *)((u8_t *)p->payload + SIZEOF_ETH_HDR);
+    u16_t hlen = IPH_HL(iphdr) * 4;
+    u8_t proto = IPH_PROTO(iphdr);
+    if ((IPH_OFFSET(iphdr) & PP_HTONS(IP_OFFMASK)) == 0 &&
+        (proto == IP_PROTO_UDP || proto == IP_PROTO_TCP) &&
+        p->len >= SIZEOF_ETH_HDR + hlen + 4) {
+      /* UDP and TCP both have the destination port at offset 2 */
+      u8_t *ports = (u8_t *)iphdr + hlen;
+      dst_port = (ports[2] << 8) | ports[3];
+    }
+  }
+
+  for (int i = 0; i < filter_count; i++) {
+    const ethernetif_filter_rule_t *rule = &filter_rules[i];
+
+    if (rule->dst_mac && rule->dst_mac != mac_class)
+      continue;
+    if (rule->ethertype && rule->ethertype != type)
+      continue;
+    if ((rule->ip_proto || rule->dst_port || !ip_addr_isany(&rule->dst_ip)) && iphdr == NULL)
+      continue;
+    if (rule->ip_proto && rule->ip_proto != IPH_PROTO(iphdr))
+      continue;
+    if (rule->dst_port && rule->dst_port != dst_port)
+      continue;
+    if (!ip_addr_isany(&rule->dst_ip) && !ip_addr_cmp(&rule->dst_ip, &iphdr->dest))
+      continue;
+
+    filter_hits[i]++;
+    return rule->action == ETHERNETIF_FILTER_ACCEPT;
+  }
+
+  if (filter_hook != NULL) {
+    return filter_hook(netif, p);
+  }
+  return 1;
+}
+
+#if LWIP_POLLED_INPUT
+/* Filled by ethernetif_input() in the driver's task, emptied by the
+   polling task: one producer and one consumer, so no lock */
+static struct {
+  struct pbuf *p;
+  struct netif *netif;
+} poll_queue[ETHERNETIF_POLL_QUEUE_SIZE];
+static volatile u32_t poll_head, poll_tail;
+static xTaskHandle volatile poll_task;
+
+void ethernetif_poll_set_task(xTaskHandle task)
+{
+  poll_task = task;
+}
+
+int ethernetif_poll_pending(void)
+{
+  return poll_head - poll_tail;
+}
+
+static err_t poll_enqueue(struct pbuf *p, struct netif *netif)
+{
+  u32_t head = poll_head;
+
+  if (head - poll_tail >= ETHERNETIF_POLL_QUEUE_SIZE) {
+    return ERR_MEM;
+  }
+  poll_queue[head % ETHERNETIF_POLL_QUEUE_SIZE].p = p;
+  poll_queue[head % ETHERNETIF_POLL_QUEUE_SIZE].netif = netif;
+  poll_head = head + 1;
+
+  xTaskHandle task = poll_task;
+  if (task != NULL) {
+    xTaskNotifyGive(task);
+  }
+  return ERR_OK;
+}
+
+int ethernetif_poll(int max)
+{
+  int n = 0;
+
+  if (poll_head == poll_tail) {
+    return 0;
+  }
+  LOCK_TCPIP_CORE();
+  while (poll_tail != poll_head && (max == 0 || n < max)) {
+    u32_t tail = poll_tail;
+    struct pbuf *p = poll_queue[tail % ETHERNETIF_POLL_QUEUE_SIZE].p;
+    struct netif *netif = poll_queue[tail % ETHERNETIF_POLL_QUEUE_SIZE].netif;
+    poll_tail = tail + 1;
+    /* What tcpip_thread would have done with it */
+    ethernet_input(p, netif);
+    n++;
+  }
+  UNLOCK_TCPIP_CORE();
+  return n;
+}
+#endif /* LWIP_POLLED_INPUT */
+
 /* called from ieee80211_deliver_data with new IP frames */
 void ethernetif_input(struct netif *netif, struct pbuf *p)
 {
     struct eth_hdr *ethhdr = p->payload;
   /* examine packet payloads ethernet header */
 
+    if (timestamping) {
+	timestamp(rx_times, &rx_next, p);
+    }
+    LINK_STATS_INC(link.recv);
+
+    /* drop unwanted frames before they take up a tcpip_thread mailbox slot */
+    if (!filter_accept(netif, p)) {
+	filter_dropped++;
+	LINK_STATS_INC(link.drop);
+	pbuf_free(p);
+	return;
+    }
 
     switch(htons(ethhdr->type)) {
 	/* IP or ARP packet? */
     case ETHTYPE_IP:
     case ETHTYPE_ARP:
 //  case ETHTYPE_IPV6:
-	/* full packet send to tcpip_thread to process */
+	/* full packet send to tcpip_thread (or the polling task) to process */
+#if LWIP_POLLED_INPUT
+	if (poll_enqueue(p, netif)!=ERR_OK)
+#else
 	if (netif->input(p, netif)!=ERR_OK)
+#endif
 	{
 	    LWIP_DEBUGF(NETIF_DEBUG, ("ethernetif_input: IP input error\n"));
+	    LINK_STATS_INC(link.drop);
 	    pbuf_free(p);
 	    p = NULL;
 	}
 	break;
 
     default:
+	LINK_STATS_INC(link.proterr);
 	pbuf_free(p);
 	p = NULL;
 	break;
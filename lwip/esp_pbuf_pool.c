@@ -0,0 +1,95 @@
+/* Recycled pbuf headers for the Wi-Fi receive path, see esp_pbuf_pool.h
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "lwip/opt.h"
+#include "lwip/pbuf.h"
+#include "lwip/sys.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "esp_pbuf_pool.h"
+
+#if LWIP_PBUF_HDR_POOL
+
+#define HDR_SIZE LWIP_MEM_ALIGN_SIZE(sizeof(struct pbuf))
+
+typedef union block {
+    union block *next;
+    uint8_t data[HDR_SIZE];
+} block_t;
+
+static block_t pool[LWIP_PBUF_HDR_POOL];
+static block_t *free_list;
+static bool initialised;
+static esp_pbuf_pool_stats_t stats = { .size = LWIP_PBUF_HDR_POOL };
+
+#define IN_POOL(p) ((uint8_t *)(p) >= (uint8_t *)pool && (uint8_t *)(p) < (uint8_t *)(pool + LWIP_PBUF_HDR_POOL))
+
+/* Runs for frames the driver delivers, and frees from tcpip_thread and
+   application tasks, so the list is only touched under SYS_ARCH_PROTECT */
+void *esp_mem_malloc(size_t size)
+{
+    block_t *b = NULL;
+    SYS_ARCH_DECL_PROTECT(lev);
+
+    if (size != HDR_SIZE)
+        return malloc(size);
+
+    SYS_ARCH_PROTECT(lev);
+    if (!initialised) {
+        for (int i = 0; i < LWIP_PBUF_HDR_POOL; i++) {
+            pool[i].next = free_list;
+            free_list = &pool[i];
+        }
+        initialised = true;
+    }
+    b = free_list;
+    if (b) {
+        free_list = b->next;
+        if (++stats.used > stats.max_used)
+            stats.max_used = stats.used;
+    } else {
+        stats.fallbacks++;
+    }
+    SYS_ARCH_UNPROTECT(lev);
+
+    return b ? b : malloc(size);
+}
+
+void esp_mem_free(void *mem)
+{
+    SYS_ARCH_DECL_PROTECT(lev);
+
+    if (!IN_POOL(mem)) {
+        free(mem);
+        return;
+    }
+    block_t *b = mem;
+    SYS_ARCH_PROTECT(lev);
+    b->next = free_list;
+    free_list = b;
+    stats.used--;
+    SYS_ARCH_UNPROTECT(lev);
+}
+
+void esp_pbuf_pool_get_stats(esp_pbuf_pool_stats_t *out)
+{
+    SYS_ARCH_DECL_PROTECT(lev);
+
+    SYS_ARCH_PROTECT(lev);
+    *out = stats;
+    SYS_ARCH_UNPROTECT(lev);
+}
+
+#else
+
+void esp_pbuf_pool_get_stats(esp_pbuf_pool_stats_t *out)
+{
+    memset(out, 0, sizeof(*out));
+}
+
+#endif /* LWIP_PBUF_HDR_POOL */
@@ -34,7 +34,19 @@
 #ifndef __PERF_H__
 #define __PERF_H__
 
+#include "esp/perf.h"
+
+#if PERF_ENABLE
+/* Record the cycles between PERF_START and PERF_STOP(name) as an
+   esp/perf.h site named 'name' */
+#define PERF_START    uint32_t _perf_start = perf_ccount()
+#define PERF_STOP(x)  do {                                  \
+        static perf_site_t _perf_site = { .name = (x) };    \
+        perf_record(&_perf_site, perf_ccount() - _perf_start); \
+    } while (0)
+#else
 #define PERF_START    /* null definition */
 #define PERF_STOP(x)  /* null definition */
+#endif
 
 #endif /* __PERF_H__ */
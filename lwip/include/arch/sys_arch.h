@@ -36,16 +36,17 @@
 #include "task.h"
 #include "queue.h"
 #include "semphr.h"
+#include "esp/interrupts.h"
 
 /* MBOX primitives */
 
-#define SYS_MBOX_NULL					( ( xQueueHandle ) NULL )
+#define SYS_MBOX_NULL					( ( struct sys_mbox * ) NULL )
 #define SYS_SEM_NULL					( ( xSemaphoreHandle ) NULL )
 #define SYS_DEFAULT_THREAD_STACK_DEPTH	configMINIMAL_STACK_SIZE
 
 typedef xSemaphoreHandle sys_sem_t;
 typedef xSemaphoreHandle sys_mutex_t;
-typedef xQueueHandle sys_mbox_t;
+typedef struct sys_mbox *sys_mbox_t;
 typedef xTaskHandle sys_thread_t;
 
 #define sys_mbox_valid( x ) ( ( ( *x ) == NULL) ? pdFALSE : pdTRUE )
@@ -53,6 +54,21 @@ typedef xTaskHandle sys_thread_t;
 #define sys_sem_valid( x ) ( ( ( *x ) == NULL) ? pdFALSE : pdTRUE )
 #define sys_sem_set_invalid( x ) ( ( *x ) = NULL )
 
+/* Lightweight protection, see sys_arch_protect() in sys_arch.c */
+#define SYS_ARCH_DECL_PROTECT( lev )	sys_prot_t lev
+#define SYS_ARCH_PROTECT( lev )			lev = ( sys_prot_t ) _xt_disable_interrupts()
+#define SYS_ARCH_UNPROTECT( lev )		_xt_restore_interrupts( ( uint32_t ) ( lev ) )
+
+/* Monotonic clocks. sys_now() (milliseconds, used by the lwIP timers)
+   and sys_now_us() are both derived from the 64-bit microsecond uptime,
+   which can also be used for timestamps and tracing. All three are
+   safe to call from interrupts. */
+uint64_t sys_uptime_us(void);
+u32_t sys_now_us(void);
+
+/* Most messages any mailbox has held at once, and that mailbox's size */
+u16_t sys_mbox_high_water(u16_t *size);
+
 
 #endif /* __ARCH_SYS_ARCH_H__ */
 
@@ -0,0 +1,50 @@
+/* Internet checksum for lwIP, tuned for the lx106
+ *
+ * lwipopts.h points LWIP_CHKSUM and LWIP_CHKSUM_COPY here, so every
+ * IP, ICMP, UDP and TCP checksum lwIP computes or checks goes through
+ * these instead of the generic C versions in core/inet_chksum.c.
+ *
+ * Both run from IRAM, so checksumming a packet doesn't evict the code
+ * that handles it from the flash cache. The data is read a word at a
+ * time, 16 bytes per loop iteration, with the carries out of the low
+ * halfwords recovered at the end instead of tested for each word (the
+ * lx106 has no carry flag). Data at an odd or halfword aligned address
+ * is handled with at most one byte and one halfword load at each end,
+ * which for data in the flash cache window are word loads (see
+ * esp/flashmap.h), so constants can be checksummed where they are.
+ *
+ * esp_chksum_copy() is memcpy() and esp_chksum() in one pass over the
+ * data, for the pbuf copy paths: with LWIP_CHECKSUM_ON_COPY (on by
+ * default, see lwipopts.h) tcp_write() and pbuf_fill_chksum() use it,
+ * and tcp_output() doesn't have to read the payload again to checksum
+ * it. That includes copies out of the flash cache window, so
+ * tcp_write() of an IROM or romfs constant reads the flash once. Copies
+ * between buffers with different word alignment fall back to MEMCPY
+ * then a checksum of the destination.
+ *
+ * Part of esp-open-rtos
+ * Copyright (C) 2015 Superhouse Automation Pty Ltd
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _ESP_CHKSUM_H
+#define _ESP_CHKSUM_H
+
+#include <stdint.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/* The ones' complement sum of 'len' bytes at 'data', as 16 bit words in
+   memory byte order, not complemented (lwip_standard_chksum()'s result). */
+uint16_t esp_chksum(const void *data, uint16_t len);
+
+/* Copy 'len' bytes from 'src' to 'dst' (which mustn't overlap) and
+   return esp_chksum() of them. */
+uint16_t esp_chksum_copy(void *dst, const void *src, uint16_t len);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _ESP_CHKSUM_H */
@@ -0,0 +1,40 @@
+/* Recycled pbuf headers for the Wi-Fi receive path
+ *
+ * The Wi-Fi driver hands each received frame to lwIP as a PBUF_REF
+ * pbuf around its own buffer, and gets the buffer back
+ * (system_pp_recycle_rx_pkt) when the pbuf is freed, so the frame data
+ * itself is already recycled by the driver. What isn't is the pbuf
+ * header: without LWIP_STATIC_POOLS it's a malloc() per frame and a
+ * free() after it's been processed, hundreds of times a second under
+ * load.
+ *
+ * With LWIP_PBUF_HDR_POOL set (the number of headers, 16 by default)
+ * lwIP's allocations of exactly a pbuf header's size come from a fixed
+ * free list instead, and go back on it when freed. Anything else, and
+ * any header asked for with the list empty, goes to malloc() as before.
+ * With LWIP_STATIC_POOLS the headers already come from lwIP's own
+ * MEMP_PBUF pool and this isn't used.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _ESP_PBUF_POOL_H
+#define _ESP_PBUF_POOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* mem_malloc() and mem_free() for lwIP, see lwipopts.h */
+void *esp_mem_malloc(size_t size);
+void esp_mem_free(void *mem);
+
+typedef struct {
+    uint16_t size;       /* headers in the pool */
+    uint16_t used;       /* taken right now */
+    uint16_t max_used;
+    uint32_t fallbacks;  /* headers from malloc() as the pool was empty */
+} esp_pbuf_pool_stats_t;
+
+void esp_pbuf_pool_get_stats(esp_pbuf_pool_stats_t *stats);
+
+#endif /* _ESP_PBUF_POOL_H */
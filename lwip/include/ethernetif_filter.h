@@ -0,0 +1,65 @@
+/* Early receive filter for the ESP WLAN interface
+ *
+ * ethernetif_input() runs these rules on every received frame before
+ * it is queued to tcpip_thread, so unwanted traffic (broadcast storms,
+ * chatty multicast groups, unused UDP ports, ...) is freed straight
+ * away instead of filling the TCPIP_MBOX_SIZE mailbox.
+ *
+ * Rules are tried in order, the first that matches decides. Frames no
+ * rule matches are accepted, then passed to the optional filter hook.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _ETHERNETIF_FILTER_H
+#define _ETHERNETIF_FILTER_H
+
+#include "lwip/opt.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/ip_addr.h"
+
+#ifndef ETHERNETIF_FILTER_MAX_RULES
+#define ETHERNETIF_FILTER_MAX_RULES 8
+#endif
+
+/* Destination MAC address classes, for the rule's dst_mac field */
+#define ETHERNETIF_FILTER_MAC_ANY       0
+#define ETHERNETIF_FILTER_MAC_BROADCAST 1 /* ff:ff:ff:ff:ff:ff */
+#define ETHERNETIF_FILTER_MAC_MULTICAST 2 /* group bit set, not broadcast */
+
+typedef enum {
+    ETHERNETIF_FILTER_ACCEPT,
+    ETHERNETIF_FILTER_DROP,
+} ethernetif_filter_action_t;
+
+/* Fields left 0 match anything */
+typedef struct {
+    u8_t dst_mac;        /* ETHERNETIF_FILTER_MAC_* */
+    u16_t ethertype;     /* ETHTYPE_IP, ETHTYPE_ARP, ... */
+    u8_t ip_proto;       /* IP_PROTO_UDP, IP_PROTO_TCP, ... (IPv4 only) */
+    u16_t dst_port;      /* UDP/TCP destination port */
+    ip_addr_t dst_ip;    /* IPv4 destination, e.g. a multicast group */
+    ethernetif_filter_action_t action;
+} ethernetif_filter_rule_t;
+
+/* Called for frames that no rule matched, return 0 to drop the frame.
+   Runs in the WLAN receive path, so must be quick. */
+typedef int (*ethernetif_filter_hook_t)(struct netif *netif, struct pbuf *p);
+
+/* Append a rule. Returns its index, or -1 if the table is full. */
+int ethernetif_filter_add(const ethernetif_filter_rule_t *rule);
+
+/* Remove all rules */
+void ethernetif_filter_clear(void);
+
+/* Frames matched by rule 'index' so far */
+u32_t ethernetif_filter_hits(int index);
+
+/* Frames dropped by the filter (rules and hook) so far */
+u32_t ethernetif_filter_dropped(void);
+
+/* Set (or with NULL, remove) the hook for frames no rule matched */
+void ethernetif_filter_set_hook(ethernetif_filter_hook_t hook);
+
+#endif /* _ETHERNETIF_FILTER_H */
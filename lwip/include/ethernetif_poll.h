@@ -0,0 +1,62 @@
+/* Polled receive for the ESP WLAN interface
+ *
+ * Normally ethernetif_input() posts each received frame to
+ * tcpip_thread's mailbox, and the frame is processed (and any raw API
+ * callback for it run) there, after a context switch. Built with
+ * LWIP_POLLED_INPUT=1 (which needs LWIP_TCPIP_CORE_LOCKING=1) frames
+ * are put on a small queue instead, and an application task takes them
+ * off and runs them through the stack itself, in its own loop, holding
+ * the core lock:
+ *
+ *   ethernetif_poll_set_task(xTaskGetCurrentTaskHandle());
+ *   while (1) {
+ *       ulTaskNotifyTake(pdTRUE, CONTROL_PERIOD);  // frames or timeout
+ *       ethernetif_poll(0);                        // udp_recv callbacks run here
+ *       control_step();
+ *   }
+ *
+ * A single control loop with networking then sees a frame with no
+ * mailbox post or switch to tcpip_thread in between, and decides
+ * itself when the network work is done relative to its own.
+ *
+ * lwIP's timers (TCP retransmission, ARP, DHCP) and netconn/socket
+ * calls still go through tcpip_thread: the SDK's libraries and the
+ * sequential API need it, so a full NO_SYS build isn't possible here.
+ * With core locking they don't run at the same time as the polling
+ * task's stack calls. Raw API calls the task makes outside
+ * ethernetif_poll() must hold the lock too (LOCK_TCPIP_CORE()).
+ *
+ * Frames beyond the queue's ETHERNETIF_POLL_QUEUE_SIZE are dropped
+ * (and counted in link.drop), so the loop must poll often enough.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _ETHERNETIF_POLL_H
+#define _ETHERNETIF_POLL_H
+
+#include "lwip/opt.h"
+
+#if LWIP_POLLED_INPUT
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+/* Frames waiting for ethernetif_poll(), a power of 2 */
+#ifndef ETHERNETIF_POLL_QUEUE_SIZE
+#define ETHERNETIF_POLL_QUEUE_SIZE 16
+#endif
+
+/* Notify 'task' (xTaskNotifyGive) when a frame is queued, NULL for none */
+void ethernetif_poll_set_task(xTaskHandle task);
+
+/* Process up to 'max' queued frames (0 for all of them), holding the
+   core lock. Returns the number processed. */
+int ethernetif_poll(int max);
+
+/* Frames waiting */
+int ethernetif_poll_pending(void);
+
+#endif /* LWIP_POLLED_INPUT */
+
+#endif /* _ETHERNETIF_POLL_H */
@@ -0,0 +1,54 @@
+/* Receive and transmit timestamps for the ESP WLAN interface
+ *
+ * With timestamping on, ethernetif_input() notes the time each frame
+ * arrives from the driver, and low_level_output() the time each frame
+ * is handed to it, before any tcpip_thread scheduling adds its
+ * milliseconds of jitter. The application looks the time up later by
+ * the pbuf: the one a raw API recv callback gets (or a netbuf's p) for
+ * a received frame, the one it passed to udp_send() for a sent one.
+ *
+ *   static void recv_cb(void *arg, struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *addr, u16_t port)
+ *   {
+ *       uint64_t rx_us;
+ *       if (ethernetif_rx_timestamp(p, &rx_us))
+ *           ...
+ *   }
+ *
+ * lwIP 1.4.1's pbufs have no room of their own for this, so the times
+ * are kept in small rings beside them, by pbuf: a frame's time can be
+ * looked up until ETHERNETIF_TIMESTAMP_SLOTS more frames have gone the
+ * same way. A sent frame is found by its first or its last pbuf, so a
+ * UDP payload that got a header pbuf in front of it is found too. A
+ * frame that waited for ARP went out as a copy, and isn't. Nor is the
+ * data of a socket recv(), as it has no pbuf.
+ *
+ * Times are hrtimer_now_us64() microseconds (esp/hrtimer.h, which the
+ * first timestamp starts). A transmit time is when the driver took the
+ * frame, not when it went on air, which can be later by the time the
+ * channel was busy.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _ETHERNETIF_TIMESTAMP_H
+#define _ETHERNETIF_TIMESTAMP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "lwip/opt.h"
+#include "lwip/pbuf.h"
+
+#ifndef ETHERNETIF_TIMESTAMP_SLOTS
+#define ETHERNETIF_TIMESTAMP_SLOTS 16
+#endif
+
+/* Turn timestamping on or off, for both directions. Off by default. */
+void ethernetif_timestamping(bool enable);
+
+/* The time the frame 'p' was received or sent in. Returns false if it
+   wasn't timestamped, or its slot has been used again since. */
+bool ethernetif_rx_timestamp(const struct pbuf *p, uint64_t *us);
+bool ethernetif_tx_timestamp(const struct pbuf *p, uint64_t *us);
+
+#endif /* _ETHERNETIF_TIMESTAMP_H */
@@ -0,0 +1,91 @@
+/* Static memp pool sizes for LWIP_STATIC_POOLS builds
+ *
+ * With LWIP_STATIC_POOLS=1, lwipopts.h turns off MEMP_MEM_MALLOC and
+ * includes this file, so every memp object (pbuf headers, TCP segments,
+ * netconns, PCBs, tcpip messages...) comes from a fixed-size pool in
+ * .bss with its own free list. Allocation is a list pop instead of a
+ * heap search, doesn't fragment the heap, and the worst case memory
+ * used by the stack is known at link time. Running out of a pool makes
+ * that one allocation fail, see the lwIP stats (MEMP_STATS) to size it.
+ *
+ * Any of these can be overridden with EXTRA_CFLAGS, e.g.
+ * EXTRA_CFLAGS="-DLWIP_STATIC_POOLS=1 -DMEMP_NUM_NETCONN=10"
+ *
+ * pbuf payloads for PBUF_RAM (all transmitted data) are still allocated
+ * with malloc, as MEM_LIBC_MALLOC stays enabled.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _LWIP_POOL_SIZES_H
+#define _LWIP_POOL_SIZES_H
+
+/* pbuf headers for PBUF_REF/PBUF_ROM. The Wi-Fi driver hands every
+   received frame to lwIP as a PBUF_REF, so this caps the frames queued
+   between the driver and the application. */
+#ifndef MEMP_NUM_PBUF
+#define MEMP_NUM_PBUF                   (LWIP_THROUGHPUT_PROFILE ? 24 : 16)
+#endif
+
+/* Full-size pbufs for PBUF_POOL allocations. lwIP requires the pool to
+   be able to hold a full TCP receive window. */
+#ifndef PBUF_POOL_SIZE
+#define PBUF_POOL_SIZE                  (TCP_WND / TCP_MSS + 1)
+#endif
+
+#ifndef MEMP_NUM_RAW_PCB
+#define MEMP_NUM_RAW_PCB                2
+#endif
+
+#ifndef MEMP_NUM_UDP_PCB
+#define MEMP_NUM_UDP_PCB                4
+#endif
+
+#ifndef MEMP_NUM_TCP_PCB
+#define MEMP_NUM_TCP_PCB                5
+#endif
+
+#ifndef MEMP_NUM_TCP_PCB_LISTEN
+#define MEMP_NUM_TCP_PCB_LISTEN         4
+#endif
+
+/* Enough for one connection's full send queue plus its out-of-order
+   queue (shared between all connections) */
+#ifndef MEMP_NUM_TCP_SEG
+#if TCP_QUEUE_OOSEQ
+#define MEMP_NUM_TCP_SEG                (TCP_SND_QUEUELEN + TCP_OOSEQ_MAX_PBUFS)
+#else
+#define MEMP_NUM_TCP_SEG                TCP_SND_QUEUELEN
+#endif
+#endif
+
+#ifndef MEMP_NUM_REASSDATA
+#define MEMP_NUM_REASSDATA              2
+#endif
+
+#ifndef MEMP_NUM_FRAG_PBUF
+#define MEMP_NUM_FRAG_PBUF              4
+#endif
+
+#ifndef MEMP_NUM_ARP_QUEUE
+#define MEMP_NUM_ARP_QUEUE              8
+#endif
+
+#ifndef MEMP_NUM_NETBUF
+#define MEMP_NUM_NETBUF                 4
+#endif
+
+#ifndef MEMP_NUM_NETCONN
+#define MEMP_NUM_NETCONN                6
+#endif
+
+#ifndef MEMP_NUM_TCPIP_MSG_API
+#define MEMP_NUM_TCPIP_MSG_API          8
+#endif
+
+/* A message per received frame waiting in the tcpip mailbox */
+#ifndef MEMP_NUM_TCPIP_MSG_INPKT
+#define MEMP_NUM_TCPIP_MSG_INPKT        TCPIP_MBOX_SIZE
+#endif
+
+#endif /* _LWIP_POOL_SIZES_H */
@@ -39,6 +39,17 @@
 #define ESP_TIMEWAIT_THRESHOLD              10000
 #define LWIP_TIMEVAL_PRIVATE                0
 
+/**
+ * LWIP_THROUGHPUT_PROFILE==1: Trade RAM for TCP receive throughput on
+ * lossy links. Enables out-of-order queueing (with a per-connection cap)
+ * and IP reassembly, and grows the TCP window and mailboxes to match.
+ * Costs up to about TCP_WND extra heap per active connection.
+ * Build with EXTRA_CFLAGS=-DLWIP_THROUGHPUT_PROFILE=1 to enable.
+ */
+#ifndef LWIP_THROUGHPUT_PROFILE
+#define LWIP_THROUGHPUT_PROFILE             0
+#endif
+
 /*
    -----------------------------------------------
    ---------- Platform specific locking ----------
@@ -54,8 +65,16 @@
 /**
  * MEMCPY: override this if you have a faster implementation at hand than the
  * one included in your C library
+ *
+ * Sources in the flash cache window (IROM constants, romfs images) are
+ * copied with aligned word loads, so tcp_write() of data straight from
+ * flash doesn't take a LoadStoreError exception for every byte. See
+ * low_level_output() in esp_interface.c for sending constant data from
+ * flash with a single copy.
  */
-#define MEMCPY(dst,src,len)             memcpy(dst,src,len)
+#include "esp/flashmap.h"
+#define MEMCPY(dst,src,len)             ((uint32_t)(src) - FLASHMAP_BASE < FLASHMAP_SIZE ? \
+                                         flashmap_memcpy(dst,src,len) : (void)memcpy(dst,src,len))
 
 /**
  * SMEMCPY: override this with care! Some compilers (e.g. gcc) can inline a
@@ -75,12 +94,49 @@
  */
 #define MEM_LIBC_MALLOC        1
 
+/**
+ * LWIP_STATIC_POOLS==1: Allocate memp objects (pbuf headers, TCP segments,
+ * netconns...) from fixed-size static pools, sized in lwip_pool_sizes.h,
+ * instead of malloc. Faster, doesn't fragment the heap under connection
+ * churn and makes the stack's worst case memory use fixed.
+ * Build with EXTRA_CFLAGS=-DLWIP_STATIC_POOLS=1 to enable.
+ */
+#ifndef LWIP_STATIC_POOLS
+#define LWIP_STATIC_POOLS               0
+#endif
+
 /**
 * MEMP_MEM_MALLOC==1: Use mem_malloc/mem_free instead of the lwip pool allocator.
 * Especially useful with MEM_LIBC_MALLOC but handle with care regarding execution
 * speed and usage from interrupts!
 */
+#if LWIP_STATIC_POOLS
+#define MEMP_MEM_MALLOC                 0
+#include "lwip_pool_sizes.h"
+#else
 #define MEMP_MEM_MALLOC                 1
+#endif
+
+/**
+ * LWIP_PBUF_HDR_POOL: Number of pbuf headers kept on a free list for
+ * the Wi-Fi receive path, so a received frame doesn't cost a malloc()
+ * and a free() (see esp_pbuf_pool.h). Only used with MEMP_MEM_MALLOC,
+ * set to 0 to allocate every header with malloc().
+ */
+#if MEMP_MEM_MALLOC
+#ifndef LWIP_PBUF_HDR_POOL
+#define LWIP_PBUF_HDR_POOL              16
+#endif
+#else
+#undef LWIP_PBUF_HDR_POOL
+#define LWIP_PBUF_HDR_POOL              0
+#endif
+
+#if LWIP_PBUF_HDR_POOL
+#include "esp_pbuf_pool.h"
+#define mem_malloc                      esp_mem_malloc
+#define mem_free                        esp_mem_free
+#endif
 
 /**
  * MEM_ALIGNMENT: should be set to the alignment of the CPU
@@ -109,17 +165,37 @@
  */
 #define ARP_QUEUEING                    1
 
+/**
+ * ETHARP_SUPPORT_STATIC_ENTRIES==1: enable code to support static ARP table
+ * entries (using etharp_add_static_entry/etharp_remove_static_entry).
+ * extras/fastconnect uses one for the gateway after a deep sleep wake.
+ */
+#define ETHARP_SUPPORT_STATIC_ENTRIES   1
+
 /*
    --------------------------------
    ---------- IP options ----------
    --------------------------------
 */
+/**
+ * IP_FORWARD==1: Forward IP packets across network interfaces, as
+ * extras/napt needs to route between the softAP and the station.
+ * Build with EXTRA_CFLAGS=-DIP_FORWARD=1 to enable.
+ */
+#ifndef IP_FORWARD
+#define IP_FORWARD                      0
+#endif
+
 /**
  * IP_REASSEMBLY==1: Reassemble incoming fragmented IP packets. Note that
  * this option does not affect outgoing packet sizes, which can be controlled
  * via IP_FRAG.
  */
+#if LWIP_THROUGHPUT_PROFILE
+#define IP_REASSEMBLY                   1
+#else
 #define IP_REASSEMBLY                   0
+#endif
 
 /**
  * IP_FRAG==1: Fragment outgoing IP packets if their size exceeds MTU. Note
@@ -182,6 +258,15 @@
    ---------- IGMP options ----------
    ----------------------------------
 */
+/**
+ * LWIP_IGMP==1: Turn on IGMP module, to join multicast groups (as
+ * extras/rboot-ota/ota-mcast.h does). Build with EXTRA_CFLAGS=-DLWIP_IGMP=1
+ * to enable.
+ */
+#ifndef LWIP_IGMP
+#define LWIP_IGMP                       0
+#endif
+
 /*
    ----------------------------------
    ---------- DNS options -----------
@@ -193,9 +278,31 @@
  */
 #define LWIP_DNS                        1
 
-#define DNS_TABLE_SIZE 1
+/**
+ * DNS_TABLE_SIZE: Number of names lwIP's resolver keeps, each until its
+ * answer's TTL runs out, so reconnecting to a few hosts in turn doesn't
+ * resolve them again every time. Around 150 bytes each.
+ */
+#ifndef DNS_TABLE_SIZE
+#define DNS_TABLE_SIZE 4
+#endif
 #define DNS_MAX_NAME_LENGTH 128
 
+/**
+ * LWIP_DNSCACHE==1: Have lwIP's resolver (and so netconn_gethostbyname()
+ * and getaddrinfo()) answer from extras/dnscache first.
+ * Build with EXTRA_CFLAGS=-DLWIP_DNSCACHE=1 to enable.
+ */
+#ifndef LWIP_DNSCACHE
+#define LWIP_DNSCACHE                   0
+#endif
+
+#if LWIP_DNSCACHE
+#include <stdint.h>
+uint32_t dnscache_lookup(const char *name);
+#define DNS_LOOKUP_LOCAL_EXTERN(name) dnscache_lookup(name)
+#endif
+
 /*
    ---------------------------------
    ---------- UDP options ----------
@@ -210,7 +317,32 @@
  * TCP_QUEUE_OOSEQ==1: TCP will queue segments that arrive out of order.
  * Define to 0 if your device is low on memory.
  */
+#if LWIP_THROUGHPUT_PROFILE
+#define TCP_QUEUE_OOSEQ                 1
+#else
 #define TCP_QUEUE_OOSEQ                 0
+#endif
+
+#if LWIP_THROUGHPUT_PROFILE
+/**
+ * TCP_WND: The size of a TCP window. With out-of-order queueing, a
+ * bigger window keeps the sender busy while a lost segment is resent.
+ */
+#define TCP_WND                         (6 * TCP_MSS)
+
+/**
+ * TCP_SND_BUF: TCP sender buffer space (bytes).
+ */
+#define TCP_SND_BUF                     (4 * TCP_MSS)
+
+/**
+ * TCP_OOSEQ_MAX_BYTES / TCP_OOSEQ_MAX_PBUFS: Per-connection cap on the
+ * out-of-order queue, so a burst of loss can't exhaust the heap. Each
+ * queued segment holds one full-size receive pbuf.
+ */
+#define TCP_OOSEQ_MAX_BYTES             (4 * TCP_MSS)
+#define TCP_OOSEQ_MAX_PBUFS             4
+#endif
 
 /*
  *     LWIP_EVENT_API==1: The user defines lwip_tcp_event() to receive all
@@ -250,6 +382,11 @@
  * be needed without this flag! Use this only if you need to!
  *
  * @todo: TCP and IP-frag do not work with this, yet:
+ *
+ * The ESP MAC can't do scatter-gather, so this stays on: TCP then builds
+ * each segment (headers included) in one pbuf, which goes to the MAC
+ * without another copy. low_level_output() in esp_interface.c flattens
+ * any other chained pbufs itself.
  */
 #define LWIP_NETIF_TX_SINGLE_PBUF             1
 
@@ -289,7 +426,46 @@
  * The queue size value itself is platform-dependent, but is passed to
  * sys_mbox_new() when tcpip_init is called.
  */
+#if LWIP_THROUGHPUT_PROFILE
+/* Room for a window of segments (plus ACKs) on their way to tcpip_thread */
+#define TCPIP_MBOX_SIZE                 24
+#else
 #define TCPIP_MBOX_SIZE                 16
+#endif
+
+/**
+ * LWIP_TCPIP_CORE_LOCKING==1: netconn (and so sockets) calls from
+ * application tasks run the stack code in the calling task, holding
+ * the core lock, instead of each being posted to tcpip_thread's mailbox
+ * and waited for: two context switches and a mailbox message fewer per
+ * call. Received packets and timers are still handled in tcpip_thread.
+ * See sys_arch.c for how the port handles the lock.
+ *
+ * Tasks making netconn calls then need stack for the stack code too,
+ * ~1KB more for TCP. lwIP 1.4.1 calls this mode experimental.
+ *
+ * Build with EXTRA_CFLAGS=-DLWIP_TCPIP_CORE_LOCKING=1 to enable.
+ */
+#ifndef LWIP_TCPIP_CORE_LOCKING
+#define LWIP_TCPIP_CORE_LOCKING         0
+#endif
+
+/**
+ * LWIP_POLLED_INPUT==1: Received frames are queued for an application
+ * task to process with ethernetif_poll(), in its own loop, instead of
+ * going through tcpip_thread's mailbox. See ethernetif_poll.h. Needs
+ * LWIP_TCPIP_CORE_LOCKING.
+ *
+ * Build with EXTRA_CFLAGS="-DLWIP_TCPIP_CORE_LOCKING=1 -DLWIP_POLLED_INPUT=1"
+ * to enable.
+ */
+#ifndef LWIP_POLLED_INPUT
+#define LWIP_POLLED_INPUT               0
+#endif
+
+#if LWIP_POLLED_INPUT && !LWIP_TCPIP_CORE_LOCKING
+#error "LWIP_POLLED_INPUT needs LWIP_TCPIP_CORE_LOCKING"
+#endif
 
 /**
  * DEFAULT_UDP_RECVMBOX_SIZE: The mailbox size for the incoming packets on a
@@ -303,7 +479,11 @@
  * NETCONN_TCP. The queue size value itself is platform-dependent, but is passed
  * to sys_mbox_new() when the recvmbox is created.
  */
+#if LWIP_THROUGHPUT_PROFILE
+#define DEFAULT_TCP_RECVMBOX_SIZE       (TCP_WND / TCP_MSS + 2)
+#else
 #define DEFAULT_TCP_RECVMBOX_SIZE       6
+#endif
 
 /**
  * DEFAULT_ACCEPTMBOX_SIZE: The mailbox size for the incoming connections.
@@ -369,6 +549,24 @@
    ---------- Checksum options ----------
    --------------------------------------
 */
+/**
+ * LWIP_CHKSUM: the routine summing packet data for inet_chksum() and the
+ * pseudo header checksums. esp_chksum() runs from IRAM and reads words,
+ * see esp_chksum.h.
+ */
+#include "esp_chksum.h"
+#define LWIP_CHKSUM(dataptr,len)        esp_chksum(dataptr,len)
+
+/**
+ * LWIP_CHECKSUM_ON_COPY==1: Calculate checksum when copying data from
+ * application buffers to pbufs, so tcp_write() data isn't read twice.
+ * Costs a few bytes per TCP segment.
+ * Build with EXTRA_CFLAGS=-DLWIP_CHECKSUM_ON_COPY=0 to disable.
+ */
+#ifndef LWIP_CHECKSUM_ON_COPY
+#define LWIP_CHECKSUM_ON_COPY           1
+#endif
+#define LWIP_CHKSUM_COPY(dst,src,len)   esp_chksum_copy(dst,src,len)
 
 /*
    ---------------------------------------
@@ -0,0 +1,32 @@
+/* Network counters in the esp/counters.h registry, and its UDP endpoint
+ *
+ * Registers lwIP's link and TCP counters, the receive filter's drops
+ * and the free heap as COUNTER_DEFINE_FN counters (read only when
+ * dumped), so they're listed with every other counter on the device.
+ * They're linked in with netcounters_udp_start(). lwIP's own counters
+ * are 16 bits wide, and wrap.
+ *
+ * netcounters_udp_start() answers each datagram to 'port' with the
+ * whole registry in counters_format()'s text, so a fleet can be scraped
+ * with e.g. "echo | nc -u -w1 <address> <port>". Sending "delta" gets
+ * the changes since the previous "delta" instead. The answer is one
+ * datagram, cut short at NETCOUNTERS_UDP_MAX bytes.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _NETCOUNTERS_H
+#define _NETCOUNTERS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef NETCOUNTERS_UDP_MAX
+#define NETCOUNTERS_UDP_MAX 1400
+#endif
+
+/* Runs in tcpip_thread, no task of its own. Returns false if the
+   socket couldn't be set up. */
+bool netcounters_udp_start(uint16_t port);
+
+#endif /* _NETCOUNTERS_H */
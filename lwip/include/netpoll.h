@@ -0,0 +1,101 @@
+/* Readiness polling for many netconns, without a scan per wakeup
+ *
+ * lwip_select() looks at every socket it's given, and registers and
+ * unregisters itself on each one, every call. netpoll instead keeps a
+ * ready list that the netconn event callback pushes onto as each event
+ * comes (from tcpip_thread, or from netconn_recv() in the task), and
+ * one task waits for it, like epoll:
+ *
+ *   netpoll_t *poll = netpoll_create();
+ *   struct netconn *listener = netpoll_netconn_new(NETCONN_TCP);
+ *   netconn_bind(listener, IP_ADDR_ANY, 80);
+ *   netconn_listen(listener);
+ *   netpoll_add(poll, listener, NETPOLL_IN, NULL);
+ *   while (1) {
+ *       netpoll_event_t ev[8];
+ *       int n = netpoll_wait(poll, ev, 8, 1000);
+ *       for (int i = 0; i < n; i++) {
+ *           if (ev[i].conn == listener) {
+ *               struct netconn *c;
+ *               if (netconn_accept(listener, &c) == ERR_OK)
+ *                   netpoll_add(poll, c, NETPOLL_IN, client_state(c));
+ *           } else {
+ *               ... netconn_recv(ev[i].conn, ...), which won't block
+ *           }
+ *       }
+ *   }
+ *
+ * A wait costs the number of ready connections, not the number added.
+ *
+ * It works on netconns created with netpoll_netconn_new() (the
+ * callback is set at creation), and the connections accepted on them,
+ * which get the same callback. BSD sockets keep lwip_select(): their
+ * netconns have the sockets layer's own callback, which lwIP doesn't
+ * let anything else share. netpoll keeps its index in the netconn's
+ * 'socket' field, which the sockets layer only uses on its own
+ * netconns.
+ *
+ * Readiness is level triggered: a connection is reported by every
+ * netpoll_wait() until what it's ready for has been done. NETPOLL_IN
+ * is data (or a closed connection, which netconn_recv() reports) to
+ * receive, or a connection to accept on a listener; NETPOLL_OUT, room
+ * in the send buffer; NETPOLL_ERR, an error, reported whether asked
+ * for or not.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _NETPOLL_H
+#define _NETPOLL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "lwip/opt.h"
+#include "lwip/api.h"
+
+/* Connections added, across all polls */
+#ifndef NETPOLL_MAX_CONNS
+#define NETPOLL_MAX_CONNS 16
+#endif
+
+#define NETPOLL_IN  0x01
+#define NETPOLL_OUT 0x02
+#define NETPOLL_ERR 0x04
+
+typedef struct netpoll netpoll_t;
+
+typedef struct {
+    struct netconn *conn;
+    void *arg;          /* as given to netpoll_add() */
+    uint8_t events;     /* NETPOLL_ bits */
+} netpoll_event_t;
+
+void netpoll_netconn_callback(struct netconn *conn, enum netconn_evt evt, u16_t len);
+
+#define netpoll_netconn_new(type) netconn_new_with_callback(type, netpoll_netconn_callback)
+
+/* NULL if out of memory */
+netpoll_t *netpoll_create(void);
+
+/* Every connection must have been removed */
+void netpoll_destroy(netpoll_t *poll);
+
+/* Report 'events' on 'conn' to netpoll_wait(poll), with 'arg'. Returns
+   false if there are NETPOLL_MAX_CONNS connections added already, or
+   'conn' wasn't created with the netpoll callback, or was added. */
+bool netpoll_add(netpoll_t *poll, struct netconn *conn, uint8_t events, void *arg);
+
+/* Change the events 'conn' is reported for */
+bool netpoll_modify(struct netconn *conn, uint8_t events);
+
+/* Call before netconn_delete() */
+void netpoll_remove(struct netconn *conn);
+
+/* Wait up to 'timeout_ms' (0 for ever) for a connection to be ready,
+   and return up to 'max' of them (in the order they became ready) in
+   'events'. Returns the number, 0 on timeout. One task at a time waits
+   on a poll. */
+int netpoll_wait(netpoll_t *poll, netpoll_event_t *events, int max, uint32_t timeout_ms);
+
+#endif /* _NETPOLL_H */
@@ -0,0 +1,62 @@
+/* Network statistics snapshot and export
+ *
+ * Collects the lwIP link/IP/TCP/UDP counters, memory and mailbox usage
+ * and the receive filter's drop count into one structure, so drops in
+ * throughput can be matched up with pool or mailbox exhaustion.
+ *
+ * The lwIP counters need LWIP_STATS (on by default). They are 16 bits
+ * wide and wrap, so compare snapshots taken close together.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _NETSTATS_H
+#define _NETSTATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct {
+    uint32_t xmit;
+    uint32_t recv;
+    uint32_t drop;
+    uint32_t err;    /* checksum, length, routing, protocol and option errors */
+    uint32_t memerr; /* out of memory */
+} netstats_proto_t;
+
+typedef struct {
+    netstats_proto_t link;
+    netstats_proto_t ip;
+    netstats_proto_t tcp;
+    netstats_proto_t udp;
+    uint32_t tcp_rexmit;       /* retransmitted TCP segments */
+    uint32_t filter_dropped;   /* frames dropped by ethernetif_filter rules */
+    uint32_t memp_err;         /* failed memp allocations (LWIP_STATIC_POOLS) */
+    uint32_t heap_free;        /* bytes free in the malloc heap */
+    uint16_t mbox_high_water;  /* fullest any mailbox has been... */
+    uint16_t mbox_high_size;   /* ...and that mailbox's size */
+    uint32_t mbox_full;        /* posts that failed on a full mailbox */
+    uint16_t pbuf_hdr_max_used; /* most recycled pbuf headers in use at once... */
+    uint16_t pbuf_hdr_size;    /* ...of the pool's size (LWIP_PBUF_HDR_POOL) */
+    uint32_t pbuf_hdr_fallbacks; /* headers from malloc() as the pool was empty */
+} netstats_t;
+
+/* Take a snapshot of the current counters */
+void netstats_get(netstats_t *stats);
+
+/* Format a snapshot as text, one "name value..." group per line.
+   Returns the length written (excluding the terminator), truncated to
+   fit len like snprintf. */
+int netstats_format(const netstats_t *stats, char *buf, size_t len);
+
+/* Print the current counters to stdout */
+void netstats_dump(void);
+
+/* Answer every UDP datagram received on 'port' with the formatted
+   counters, e.g. "echo | nc -u -w1 <address> <port>". Runs in
+   tcpip_thread, no task of its own. Returns false if the socket
+   couldn't be set up. */
+bool netstats_udp_start(uint16_t port);
+
+#endif /* _NETSTATS_H */
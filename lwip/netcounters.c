@@ -0,0 +1,108 @@
+/* Network counters in the esp/counters.h registry, see netcounters.h
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <string.h>
+
+#include "lwip/opt.h"
+#include "lwip/stats.h"
+#include "lwip/udp.h"
+#include "lwip/tcpip.h"
+#include "lwip/sys.h"
+
+#include "FreeRTOS.h"
+#include "esp/counters.h"
+#include "ethernetif_filter.h"
+#include "netcounters.h"
+
+#if LWIP_STATS && LINK_STATS
+static uint32_t link_xmit(void) { return lwip_stats.link.xmit; }
+static uint32_t link_recv(void) { return lwip_stats.link.recv; }
+static uint32_t link_drop(void) { return lwip_stats.link.drop; }
+static uint32_t link_err(void) { return lwip_stats.link.err; }
+
+COUNTER_DEFINE_FN(net_link_xmit, "net.link.xmit", COUNTER_TYPE_COUNTER, link_xmit);
+COUNTER_DEFINE_FN(net_link_recv, "net.link.recv", COUNTER_TYPE_COUNTER, link_recv);
+COUNTER_DEFINE_FN(net_link_drop, "net.link.drop", COUNTER_TYPE_COUNTER, link_drop);
+COUNTER_DEFINE_FN(net_link_err, "net.link.err", COUNTER_TYPE_COUNTER, link_err);
+#endif
+
+#if LWIP_STATS && TCP_STATS
+static uint32_t tcp_xmit(void) { return lwip_stats.tcp.xmit; }
+static uint32_t tcp_recv(void) { return lwip_stats.tcp.recv; }
+static uint32_t tcp_rexmit(void) { return lwip_stats.tcp.rexmit; }
+
+COUNTER_DEFINE_FN(net_tcp_xmit, "net.tcp.xmit", COUNTER_TYPE_COUNTER, tcp_xmit);
+COUNTER_DEFINE_FN(net_tcp_recv, "net.tcp.recv", COUNTER_TYPE_COUNTER, tcp_recv);
+COUNTER_DEFINE_FN(net_tcp_rexmit, "net.tcp.rexmit", COUNTER_TYPE_COUNTER, tcp_rexmit);
+#endif
+
+static uint32_t heap_free(void) { return xPortGetFreeHeapSize(); }
+
+COUNTER_DEFINE_FN(net_filter_dropped, "net.filter.dropped", COUNTER_TYPE_COUNTER, ethernetif_filter_dropped);
+COUNTER_DEFINE_FN(mem_heap_free, "mem.heap_free", COUNTER_TYPE_GAUGE, heap_free);
+
+/* Only touched in tcpip_thread */
+static counters_snapshot_t last_delta;
+static bool have_delta;
+
+static void udp_query(void *arg, struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *addr, u16_t port)
+{
+    bool delta = p->len >= 5 && !memcmp(p->payload, "delta", 5);
+    const counters_snapshot_t *since = delta && have_delta ? &last_delta : NULL;
+
+    pbuf_free(p);
+
+    int len = counters_format(NULL, 0, since);
+    if (len > NETCOUNTERS_UDP_MAX)
+        len = NETCOUNTERS_UDP_MAX;
+    struct pbuf *reply = pbuf_alloc(PBUF_TRANSPORT, len + 1, PBUF_RAM);
+    if (reply == NULL)
+        return;
+    counters_format(reply->payload, len + 1, since);
+    pbuf_realloc(reply, len);
+    udp_sendto(pcb, reply, addr, port);
+    pbuf_free(reply);
+
+    if (delta) {
+        counters_snapshot(&last_delta);
+        have_delta = true;
+    }
+}
+
+struct udp_start_msg {
+    u16_t port;
+    bool ok;
+    sys_sem_t done;
+};
+
+static void udp_start(void *arg)
+{
+    struct udp_start_msg *msg = arg;
+    struct udp_pcb *pcb = udp_new();
+
+    msg->ok = false;
+    if (pcb != NULL) {
+        if (udp_bind(pcb, IP_ADDR_ANY, msg->port) == ERR_OK) {
+            udp_recv(pcb, udp_query, NULL);
+            msg->ok = true;
+        } else {
+            udp_remove(pcb);
+        }
+    }
+    sys_sem_signal(&msg->done);
+}
+
+bool netcounters_udp_start(uint16_t port)
+{
+    struct udp_start_msg msg = { .port = port };
+
+    if (sys_sem_new(&msg.done, 0) != ERR_OK)
+        return false;
+    if (tcpip_callback(udp_start, &msg) == ERR_OK) {
+        sys_sem_wait(&msg.done);
+    }
+    sys_sem_free(&msg.done);
+    return msg.ok;
+}
@@ -0,0 +1,294 @@
+/* Readiness polling for netconns, see netpoll.h
+ *
+ * The event counting follows lwIP's own sockets.c: rcvevent counts
+ * RCVPLUS less RCVMINUS, so it's the receive mailbox's count, and events
+ * on an accepted netconn before it's added are counted down from -1 in
+ * its 'socket' field, as sockets.c does for lwip_accept().
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <string.h>
+#include <stdlib.h>
+
+#include "lwip/opt.h"
+#include "lwip/api.h"
+#include "lwip/sys.h"
+
+#include "netpoll.h"
+
+#if !LWIP_SOCKET
+#error "netpoll keeps its index in netconn->socket, which needs LWIP_SOCKET"
+#endif
+
+#if NETPOLL_MAX_CONNS > 127
+#error "NETPOLL_MAX_CONNS must fit the int8_t indexes"
+#endif
+
+#define NONE -1
+
+typedef struct {
+    struct netconn *conn;   /* NULL if free */
+    netpoll_t *poll;
+    void *arg;
+    int16_t rcvevent;
+    bool sendevent;
+    bool errevent;
+    bool queued;
+    uint8_t interest;
+    int8_t next;            /* on the ready list, or the free list */
+} entry_t;
+
+struct netpoll {
+    sys_sem_t ready;
+    int8_t head, tail;      /* ready list */
+};
+
+static entry_t entries[NETPOLL_MAX_CONNS];
+static int8_t free_head = NONE;
+static bool initialised;
+
+/* All of the following with SYS_ARCH_PROTECT held */
+
+static uint8_t ready_events(const entry_t *e)
+{
+    uint8_t events = 0;
+
+    if (e->rcvevent > 0)
+        events |= NETPOLL_IN;
+    if (e->sendevent)
+        events |= NETPOLL_OUT;
+    events &= e->interest;
+    if (e->errevent)
+        events |= NETPOLL_ERR;
+    return events;
+}
+
+/* Put 'e' on its poll's ready list if it's ready and not on it.
+   Returns true if the list was empty, and the waiter needs waking. */
+static bool enqueue(entry_t *e)
+{
+    netpoll_t *poll = e->poll;
+    int8_t i = e - entries;
+
+    if (e->queued || !ready_events(e))
+        return false;
+    e->queued = true;
+    e->next = NONE;
+    if (poll->tail == NONE) {
+        poll->head = poll->tail = i;
+        return true;
+    }
+    entries[poll->tail].next = i;
+    poll->tail = i;
+    return false;
+}
+
+static void unlink_ready(entry_t *e)
+{
+    netpoll_t *poll = e->poll;
+    int8_t i = e - entries, prev = NONE;
+
+    if (!e->queued)
+        return;
+    for (int8_t j = poll->head; j != NONE; prev = j, j = entries[j].next) {
+        if (j != i)
+            continue;
+        if (prev == NONE)
+            poll->head = e->next;
+        else
+            entries[prev].next = e->next;
+        if (poll->tail == i)
+            poll->tail = prev;
+        break;
+    }
+    e->queued = false;
+}
+
+void netpoll_netconn_callback(struct netconn *conn, enum netconn_evt evt, u16_t len)
+{
+    SYS_ARCH_DECL_PROTECT(lev);
+    netpoll_t *wake = NULL;
+
+    SYS_ARCH_PROTECT(lev);
+    int s = conn->socket;
+    if (s < 0 || s >= NETPOLL_MAX_CONNS || entries[s].conn != conn) {
+        /* Not added yet (accepted, and netpoll_add() still to come) */
+        if (s < 0 && evt == NETCONN_EVT_RCVPLUS)
+            conn->socket--;
+        SYS_ARCH_UNPROTECT(lev);
+        return;
+    }
+
+    entry_t *e = &entries[s];
+    switch (evt) {
+    case NETCONN_EVT_RCVPLUS:
+        e->rcvevent++;
+        break;
+    case NETCONN_EVT_RCVMINUS:
+        e->rcvevent--;
+        break;
+    case NETCONN_EVT_SENDPLUS:
+        e->sendevent = true;
+        break;
+    case NETCONN_EVT_SENDMINUS:
+        e->sendevent = false;
+        break;
+    case NETCONN_EVT_ERROR:
+        e->errevent = true;
+        break;
+    }
+    if (enqueue(e))
+        wake = e->poll;
+    SYS_ARCH_UNPROTECT(lev);
+
+    if (wake)
+        sys_sem_signal(&wake->ready);
+}
+
+netpoll_t *netpoll_create(void)
+{
+    netpoll_t *poll = malloc(sizeof(netpoll_t));
+
+    if (!poll)
+        return NULL;
+    if (sys_sem_new(&poll->ready, 0) != ERR_OK) {
+        free(poll);
+        return NULL;
+    }
+    poll->head = poll->tail = NONE;
+    return poll;
+}
+
+void netpoll_destroy(netpoll_t *poll)
+{
+    sys_sem_free(&poll->ready);
+    free(poll);
+}
+
+bool netpoll_add(netpoll_t *poll, struct netconn *conn, uint8_t events, void *arg)
+{
+    SYS_ARCH_DECL_PROTECT(lev);
+    bool wake;
+
+    if (conn->callback != netpoll_netconn_callback)
+        return false;
+
+    SYS_ARCH_PROTECT(lev);
+    if (!initialised) {
+        for (int i = NETPOLL_MAX_CONNS - 1; i >= 0; i--) {
+            entries[i].next = free_head;
+            free_head = i;
+        }
+        initialised = true;
+    }
+    int s = conn->socket;
+    if (free_head == NONE || (s >= 0 && s < NETPOLL_MAX_CONNS && entries[s].conn == conn)) {
+        SYS_ARCH_UNPROTECT(lev);
+        return false;
+    }
+    entry_t *e = &entries[free_head];
+    free_head = e->next;
+
+    e->conn = conn;
+    e->poll = poll;
+    e->arg = arg;
+    e->interest = events;
+    /* What came before it was added: -1 is none */
+    e->rcvevent = s < 0 ? -1 - s : 0;
+    e->sendevent = true;
+    e->errevent = false;
+    e->queued = false;
+    conn->socket = e - entries;
+    wake = enqueue(e);
+    SYS_ARCH_UNPROTECT(lev);
+
+    if (wake)
+        sys_sem_signal(&poll->ready);
+    return true;
+}
+
+static entry_t *find(struct netconn *conn)
+{
+    int s = conn->socket;
+
+    if (s < 0 || s >= NETPOLL_MAX_CONNS || entries[s].conn != conn)
+        return NULL;
+    return &entries[s];
+}
+
+bool netpoll_modify(struct netconn *conn, uint8_t events)
+{
+    SYS_ARCH_DECL_PROTECT(lev);
+    bool wake = false;
+
+    SYS_ARCH_PROTECT(lev);
+    entry_t *e = find(conn);
+    if (e) {
+        e->interest = events;
+        if (!ready_events(e))
+            unlink_ready(e);
+        else
+            wake = enqueue(e);
+    }
+    netpoll_t *poll = e ? e->poll : NULL;
+    SYS_ARCH_UNPROTECT(lev);
+
+    if (wake)
+        sys_sem_signal(&poll->ready);
+    return e != NULL;
+}
+
+void netpoll_remove(struct netconn *conn)
+{
+    SYS_ARCH_DECL_PROTECT(lev);
+
+    SYS_ARCH_PROTECT(lev);
+    entry_t *e = find(conn);
+    if (e) {
+        unlink_ready(e);
+        e->conn = NULL;
+        e->next = free_head;
+        free_head = e - entries;
+        conn->socket = -1;
+    }
+    SYS_ARCH_UNPROTECT(lev);
+}
+
+int netpoll_wait(netpoll_t *poll, netpoll_event_t *events, int max, uint32_t timeout_ms)
+{
+    SYS_ARCH_DECL_PROTECT(lev);
+
+    while (1) {
+        int n = 0;
+
+        SYS_ARCH_PROTECT(lev);
+        /* Take what's ready, then put back what still is, at the end */
+        int8_t head = poll->head;
+        poll->head = poll->tail = NONE;
+        while (head != NONE) {
+            entry_t *e = &entries[head];
+            head = e->next;
+            e->queued = false;
+            if (n == max) {
+                enqueue(e);
+                continue;
+            }
+            uint8_t ready = ready_events(e);
+            if (!ready)
+                continue;
+            events[n].conn = e->conn;
+            events[n].arg = e->arg;
+            events[n].events = ready;
+            n++;
+        }
+        for (int i = 0; i < n; i++)
+            enqueue(find(events[i].conn));
+        SYS_ARCH_UNPROTECT(lev);
+
+        if (n)
+            return n;
+        if (sys_arch_sem_wait(&poll->ready, timeout_ms) == SYS_ARCH_TIMEOUT)
+            return 0;
+    }
+}
@@ -0,0 +1,167 @@
+/* Network statistics snapshot and export, see netstats.h
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "lwip/opt.h"
+#include "lwip/stats.h"
+#include "lwip/memp.h"
+#include "lwip/udp.h"
+#include "lwip/tcpip.h"
+#include "lwip/sys.h"
+
+#include "FreeRTOS.h"
+#include "ethernetif_filter.h"
+#include "esp_pbuf_pool.h"
+#include "netstats.h"
+
+#if LWIP_STATS
+static void copy_proto(netstats_proto_t *dst, const struct stats_proto *src)
+{
+    dst->xmit = src->xmit;
+    dst->recv = src->recv;
+    dst->drop = src->drop;
+    dst->err = src->chkerr + src->lenerr + src->rterr + src->proterr + src->opterr + src->err;
+    dst->memerr = src->memerr;
+}
+#endif
+
+void netstats_get(netstats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+
+#if LINK_STATS
+    copy_proto(&stats->link, &lwip_stats.link);
+#endif
+#if IP_STATS
+    copy_proto(&stats->ip, &lwip_stats.ip);
+#endif
+#if TCP_STATS
+    copy_proto(&stats->tcp, &lwip_stats.tcp);
+#endif
+#if UDP_STATS
+    copy_proto(&stats->udp, &lwip_stats.udp);
+#endif
+#if MEMP_STATS
+    for (int i = 0; i < MEMP_MAX; i++) {
+        stats->memp_err += lwip_stats.memp[i].err;
+    }
+#endif
+#if SYS_STATS
+    stats->mbox_full = lwip_stats.sys.mbox.err;
+#endif
+
+    stats->filter_dropped = ethernetif_filter_dropped();
+    stats->heap_free = xPortGetFreeHeapSize();
+    stats->mbox_high_water = sys_mbox_high_water(&stats->mbox_high_size);
+
+    esp_pbuf_pool_stats_t pool;
+    esp_pbuf_pool_get_stats(&pool);
+    stats->pbuf_hdr_max_used = pool.max_used;
+    stats->pbuf_hdr_size = pool.size;
+    stats->pbuf_hdr_fallbacks = pool.fallbacks;
+}
+
+static int format_proto(char *buf, size_t len, const char *name, const netstats_proto_t *p)
+{
+    return snprintf(buf, len, "%s xmit %u recv %u drop %u err %u memerr %u\n", name,
+                    p->xmit, p->recv, p->drop, p->err, p->memerr);
+}
+
+int netstats_format(const netstats_t *stats, char *buf, size_t len)
+{
+    int total = 0;
+    int r;
+
+/* Keep going once truncated, so the result is the length needed */
+#define APPEND(call) do {                                       \
+        size_t off = (size_t)total < len ? (size_t)total : len; \
+        r = call;                                               \
+        if (r > 0)                                              \
+            total += r;                                         \
+    } while (0)
+#define REST (buf + off), (len - off)
+
+    if (len)
+        buf[0] = 0;
+    APPEND(format_proto(REST, "link", &stats->link));
+    APPEND(format_proto(REST, "ip", &stats->ip));
+    APPEND(format_proto(REST, "tcp", &stats->tcp));
+    APPEND(format_proto(REST, "udp", &stats->udp));
+    APPEND(snprintf(REST, "filter drop %u\n", stats->filter_dropped));
+    APPEND(snprintf(REST, "mem heap_free %u memp_err %u\n", stats->heap_free, stats->memp_err));
+    APPEND(snprintf(REST, "mbox high %u/%u full %u\n", stats->mbox_high_water,
+                    stats->mbox_high_size, stats->mbox_full));
+    APPEND(snprintf(REST, "pbufhdr high %u/%u fallback %u\n", stats->pbuf_hdr_max_used,
+                    stats->pbuf_hdr_size, stats->pbuf_hdr_fallbacks));
+
+#undef REST
+#undef APPEND
+    return total;
+}
+
+void netstats_dump(void)
+{
+    netstats_t stats;
+    char buf[352];
+
+    netstats_get(&stats);
+    netstats_format(&stats, buf, sizeof(buf));
+    printf("%s", buf);
+}
+
+static void udp_query(void *arg, struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *addr, u16_t port)
+{
+    netstats_t stats;
+
+    pbuf_free(p);
+    netstats_get(&stats);
+
+    int len = netstats_format(&stats, NULL, 0);
+    struct pbuf *reply = pbuf_alloc(PBUF_TRANSPORT, len + 1, PBUF_RAM);
+    if (reply == NULL)
+        return;
+    netstats_format(&stats, reply->payload, len + 1);
+    pbuf_realloc(reply, len);
+    udp_sendto(pcb, reply, addr, port);
+    pbuf_free(reply);
+}
+
+struct udp_start_msg {
+    u16_t port;
+    bool ok;
+    sys_sem_t done;
+};
+
+static void udp_start(void *arg)
+{
+    struct udp_start_msg *msg = arg;
+    struct udp_pcb *pcb = udp_new();
+
+    msg->ok = false;
+    if (pcb != NULL) {
+        if (udp_bind(pcb, IP_ADDR_ANY, msg->port) == ERR_OK) {
+            udp_recv(pcb, udp_query, NULL);
+            msg->ok = true;
+        } else {
+            udp_remove(pcb);
+        }
+    }
+    sys_sem_signal(&msg->done);
+}
+
+bool netstats_udp_start(uint16_t port)
+{
+    struct udp_start_msg msg = { .port = port };
+
+    if (sys_sem_new(&msg.done, 0) != ERR_OK)
+        return false;
+    if (tcpip_callback(udp_start, &msg) == ERR_OK) {
+        sys_sem_wait(&msg.done);
+    }
+    sys_sem_free(&msg.done);
+    return msg.ok;
+}
@@ -48,12 +48,244 @@
 #include "lwip/sys.h"
 #include "lwip/mem.h"
 #include "lwip/stats.h"
+#include "lwip/tcpip.h"
+
+#include <string.h>
+
+#include "esp/wdev_regs.h"
+#include "esp/interrupts.h"
 
 /* Very crude mechanism used to determine if the critical section handling
 functions are being called from an interrupt context or not.  This relies on
 the interrupt handler setting this variable manually. */
 portBASE_TYPE xInsideISR = pdFALSE;
 
+#if LWIP_TCPIP_CORE_LOCKING
+/*---------------------------------------------------------------------------*
+ * Core lock
+ *---------------------------------------------------------------------------*
+ * With LWIP_TCPIP_CORE_LOCKING, application tasks run netconn calls
+ * themselves holding lock_tcpip_core, a FreeRTOS mutex, so a low
+ * priority task in the stack inherits tcpip_thread's priority while
+ * tcpip_thread waits for it.
+ *
+ * lwIP 1.4.1's tcpip_thread releases the lock before it waits for its
+ * next message, but that wait (sys_timeouts_mbox_fetch) also walks and
+ * updates the timeout list, which application calls now change too
+ * (tcp_timer_needed() when a connection opens, for one). So here
+ * tcpip_thread keeps the lock across its mailbox fetch, releasing it
+ * only while actually blocked. As it then takes the lock again itself,
+ * the core lock nests for its owner.
+ *
+ * A timeout an application call starts is only seen once tcpip_thread
+ * next wakes, at most the 500ms of DHCP's fine timer later.
+ *---------------------------------------------------------------------------*/
+static xTaskHandle xTcpipTask;
+static xTaskHandle volatile xCoreOwner;
+static u16_t usCoreDepth;
+static portBASE_TYPE xFetchHoldsCore;
+
+static void prvCoreLock( void )
+{
+xTaskHandle xSelf = xTaskGetCurrentTaskHandle();
+
+	if( xCoreOwner == xSelf )
+	{
+		usCoreDepth++;
+		return;
+	}
+	while( xSemaphoreTake( lock_tcpip_core, portMAX_DELAY ) != pdPASS );
+	xCoreOwner = xSelf;
+	usCoreDepth = 1;
+}
+
+static void prvCoreUnlock( void )
+{
+	if( --usCoreDepth == 0 )
+	{
+		xCoreOwner = NULL;
+		xSemaphoreGive( lock_tcpip_core );
+	}
+}
+
+/* Called by sys_arch_mbox_fetch when it's about to block, and when it
+   returns */
+static inline void prvFetchBlocking( void )
+{
+	if( xFetchHoldsCore && xTaskGetCurrentTaskHandle() == xTcpipTask )
+	{
+		xFetchHoldsCore = pdFALSE;
+		prvCoreUnlock();
+	}
+}
+
+static inline void prvFetchReturning( void )
+{
+	if( !xFetchHoldsCore && xTcpipTask != NULL && xTaskGetCurrentTaskHandle() == xTcpipTask )
+	{
+		prvCoreLock();
+		xFetchHoldsCore = pdTRUE;
+	}
+}
+#else
+static inline void prvFetchBlocking( void ) { }
+static inline void prvFetchReturning( void ) { }
+#endif /* LWIP_TCPIP_CORE_LOCKING */
+
+/*---------------------------------------------------------------------------*
+ * Mailboxes
+ *---------------------------------------------------------------------------*
+ * A mailbox is a ring of message pointers. The ring indices are only
+ * touched with interrupts disabled for a few instructions, so posting or
+ * fetching when the mailbox isn't full/empty never enters the FreeRTOS
+ * queue code. The LX106 has no compare-and-swap, and on a single core
+ * masking interrupts is the cheapest correct lock; it also makes the
+ * ring safe for any number of producers and consumers (the tcpip mailbox
+ * has several producers), so there's no need for a queue fallback.
+ *
+ * Semaphores are only used to block: a task that finds the ring full or
+ * empty counts itself as a waiter and takes the matching binary
+ * semaphore, which the other side only gives when there are waiters. A
+ * woken waiter passes the wakeup on if it leaves work for other waiters,
+ * as several gives to a binary semaphore collapse into one.
+ *---------------------------------------------------------------------------*/
+struct sys_mbox
+{
+	void * volatile *ppvMessages;
+	u16_t usSize;
+	volatile u16_t usFirst;
+	volatile u16_t usCount;
+	volatile u8_t ucRxWaiters;
+	volatile u8_t ucTxWaiters;
+	xSemaphoreHandle xRxSemaphore;
+	xSemaphoreHandle xTxSemaphore;
+};
+
+/* Fullest any mailbox has been, and that mailbox's size, for netstats */
+static u16_t usMboxHighWater;
+static u16_t usMboxHighWaterSize;
+
+static void prvMboxWake( xSemaphoreHandle xSemaphore )
+{
+portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+
+	if( xInsideISR != pdFALSE )
+	{
+		xSemaphoreGiveFromISR( xSemaphore, &xHigherPriorityTaskWoken );
+	}
+	else
+	{
+		xSemaphoreGive( xSemaphore );
+	}
+}
+
+/* Add a message if there is room. Returns pdFALSE if the mailbox is full. */
+static portBASE_TYPE prvMboxPut( struct sys_mbox *pxMbox, void *pvMessage )
+{
+uint32_t ulLevel = _xt_disable_interrupts();
+portBASE_TYPE xWake;
+
+	if( pxMbox->usCount == pxMbox->usSize )
+	{
+		_xt_restore_interrupts( ulLevel );
+		return pdFALSE;
+	}
+	pxMbox->ppvMessages[ ( pxMbox->usFirst + pxMbox->usCount ) % pxMbox->usSize ] = pvMessage;
+	pxMbox->usCount++;
+	if( pxMbox->usCount > usMboxHighWater ||
+	    ( pxMbox->usCount == usMboxHighWater && pxMbox->usSize < usMboxHighWaterSize ) )
+	{
+		usMboxHighWater = pxMbox->usCount;
+		usMboxHighWaterSize = pxMbox->usSize;
+	}
+	xWake = ( pxMbox->ucRxWaiters != 0 );
+	_xt_restore_interrupts( ulLevel );
+
+	if( xWake != pdFALSE )
+	{
+		prvMboxWake( pxMbox->xRxSemaphore );
+	}
+	return pdTRUE;
+}
+
+/* Take the oldest message if there is one. Returns pdFALSE if empty. */
+static portBASE_TYPE prvMboxGet( struct sys_mbox *pxMbox, void **ppvMessage )
+{
+uint32_t ulLevel = _xt_disable_interrupts();
+portBASE_TYPE xWake;
+
+	if( pxMbox->usCount == 0 )
+	{
+		_xt_restore_interrupts( ulLevel );
+		return pdFALSE;
+	}
+	*ppvMessage = pxMbox->ppvMessages[ pxMbox->usFirst ];
+	pxMbox->usFirst = ( pxMbox->usFirst + 1 ) % pxMbox->usSize;
+	pxMbox->usCount--;
+	xWake = ( pxMbox->ucTxWaiters != 0 );
+	_xt_restore_interrupts( ulLevel );
+
+	if( xWake != pdFALSE )
+	{
+		prvMboxWake( pxMbox->xTxSemaphore );
+	}
+	return pdTRUE;
+}
+
+/* Block on xSemaphore for up to xTicks, as one of *pucWaiters, unless
+   xReady says the wait is no longer needed. Returns pdFALSE on timeout. */
+static portBASE_TYPE prvMboxWait( struct sys_mbox *pxMbox, xSemaphoreHandle xSemaphore, volatile u8_t *pucWaiters, portBASE_TYPE xForRx, portTickType xTicks )
+{
+uint32_t ulLevel = _xt_disable_interrupts();
+portBASE_TYPE xResult = pdTRUE;
+
+	/* Recheck with interrupts off, the other side may just have run */
+	if( xForRx ? ( pxMbox->usCount == 0 ) : ( pxMbox->usCount == pxMbox->usSize ) )
+	{
+		( *pucWaiters )++;
+		_xt_restore_interrupts( ulLevel );
+		xResult = xSemaphoreTake( xSemaphore, xTicks );
+		ulLevel = _xt_disable_interrupts();
+		( *pucWaiters )--;
+	}
+	_xt_restore_interrupts( ulLevel );
+	return xResult;
+}
+
+/* After a woken waiter's own operation: pass the wakeup on if there's
+   still something for the remaining waiters */
+static void prvMboxChain( struct sys_mbox *pxMbox, portBASE_TYPE xForRx )
+{
+uint32_t ulLevel = _xt_disable_interrupts();
+portBASE_TYPE xRx = ( pxMbox->ucRxWaiters != 0 ) && ( pxMbox->usCount != 0 );
+portBASE_TYPE xTx = ( pxMbox->ucTxWaiters != 0 ) && ( pxMbox->usCount != pxMbox->usSize );
+
+	_xt_restore_interrupts( ulLevel );
+
+	if( xForRx ? xRx : xTx )
+	{
+		prvMboxWake( xForRx ? pxMbox->xRxSemaphore : pxMbox->xTxSemaphore );
+	}
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  sys_mbox_high_water
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Returns the most messages any mailbox has held at once
+ * Outputs:
+ *      u16_t *size             -- Size of that mailbox
+ *---------------------------------------------------------------------------*/
+u16_t sys_mbox_high_water( u16_t *pusSize )
+{
+uint32_t ulLevel = _xt_disable_interrupts();
+u16_t usReturn = usMboxHighWater;
+
+	*pusSize = usMboxHighWaterSize;
+	_xt_restore_interrupts( ulLevel );
+	return usReturn;
+}
+
 /*---------------------------------------------------------------------------*
  * Routine:  sys_mbox_new
  *---------------------------------------------------------------------------*
@@ -66,17 +298,52 @@ portBASE_TYPE xInsideISR = pdFALSE;
  *---------------------------------------------------------------------------*/
 err_t sys_mbox_new( sys_mbox_t *pxMailBox, int iSize )
 {
-err_t xReturn = ERR_MEM;
+struct sys_mbox *pxMbox;
 
-	*pxMailBox = xQueueCreate( iSize, sizeof( void * ) );
+	*pxMailBox = NULL;
+	if( iSize <= 0 )
+	{
+		iSize = 1;
+	}
 
-	if( *pxMailBox != NULL )
+	pxMbox = ( struct sys_mbox * ) pvPortMalloc( sizeof( struct sys_mbox ) + iSize * sizeof( void * ) );
+	if( pxMbox == NULL )
 	{
-		xReturn = ERR_OK;
-		SYS_STATS_INC_USED( mbox );
+		SYS_STATS_INC( mbox.err );
+		return ERR_MEM;
 	}
 
-	return xReturn;
+	pxMbox->ppvMessages = ( void * volatile * ) ( pxMbox + 1 );
+	pxMbox->usSize = iSize;
+	pxMbox->usFirst = 0;
+	pxMbox->usCount = 0;
+	pxMbox->ucRxWaiters = 0;
+	pxMbox->ucTxWaiters = 0;
+	vSemaphoreCreateBinary( pxMbox->xRxSemaphore );
+	vSemaphoreCreateBinary( pxMbox->xTxSemaphore );
+
+	if( pxMbox->xRxSemaphore == NULL || pxMbox->xTxSemaphore == NULL )
+	{
+		if( pxMbox->xRxSemaphore != NULL )
+		{
+			vQueueDelete( pxMbox->xRxSemaphore );
+		}
+		if( pxMbox->xTxSemaphore != NULL )
+		{
+			vQueueDelete( pxMbox->xTxSemaphore );
+		}
+		vPortFree( pxMbox );
+		SYS_STATS_INC( mbox.err );
+		return ERR_MEM;
+	}
+
+	/* Binary semaphores are created given */
+	xSemaphoreTake( pxMbox->xRxSemaphore, 0 );
+	xSemaphoreTake( pxMbox->xTxSemaphore, 0 );
+
+	*pxMailBox = pxMbox;
+	SYS_STATS_INC_USED( mbox );
+	return ERR_OK;
 }
 
 
@@ -94,9 +361,10 @@ err_t xReturn = ERR_MEM;
  *---------------------------------------------------------------------------*/
 void sys_mbox_free( sys_mbox_t *pxMailBox )
 {
+struct sys_mbox *pxMbox = *pxMailBox;
 unsigned long ulMessagesWaiting;
 
-	ulMessagesWaiting = uxQueueMessagesWaiting( *pxMailBox );
+	ulMessagesWaiting = pxMbox->usCount;
 	configASSERT( ( ulMessagesWaiting == 0 ) );
 
 	#if SYS_STATS
@@ -110,7 +378,9 @@ unsigned long ulMessagesWaiting;
 	}
 	#endif /* SYS_STATS */
 
-	vQueueDelete( *pxMailBox );
+	vQueueDelete( pxMbox->xRxSemaphore );
+	vQueueDelete( pxMbox->xTxSemaphore );
+	vPortFree( pxMbox );
 }
 
 /*---------------------------------------------------------------------------*
@@ -124,7 +394,20 @@ unsigned long ulMessagesWaiting;
  *---------------------------------------------------------------------------*/
 void sys_mbox_post( sys_mbox_t *pxMailBox, void *pxMessageToPost )
 {
-	while( xQueueSendToBack( *pxMailBox, &pxMessageToPost, portMAX_DELAY ) != pdTRUE );
+struct sys_mbox *pxMbox = *pxMailBox;
+
+	if( prvMboxPut( pxMbox, pxMessageToPost ) != pdFALSE )
+	{
+		return;
+	}
+
+	configASSERT( xInsideISR == ( portBASE_TYPE ) 0 );
+	do
+	{
+		prvMboxWait( pxMbox, pxMbox->xTxSemaphore, &pxMbox->ucTxWaiters, pdFALSE, portMAX_DELAY );
+	} while( prvMboxPut( pxMbox, pxMessageToPost ) == pdFALSE );
+
+	prvMboxChain( pxMbox, pdFALSE );
 }
 
 /*---------------------------------------------------------------------------*
@@ -142,30 +425,14 @@ void sys_mbox_post( sys_mbox_t *pxMailBox, void *pxMessageToPost )
  *---------------------------------------------------------------------------*/
 err_t sys_mbox_trypost( sys_mbox_t *pxMailBox, void *pxMessageToPost )
 {
-err_t xReturn;
-portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
-
-	if( xInsideISR != pdFALSE )
-	{
-		xReturn = xQueueSendFromISR( *pxMailBox, &pxMessageToPost, &xHigherPriorityTaskWoken );
-	}
-	else
+	if( prvMboxPut( *pxMailBox, pxMessageToPost ) != pdFALSE )
 	{
-		xReturn = xQueueSend( *pxMailBox, &pxMessageToPost, ( portTickType ) 0 );
+		return ERR_OK;
 	}
 
-	if( xReturn == pdPASS )
-	{
-		xReturn = ERR_OK;
-	}
-	else
-	{
-		/* The queue was already full. */
-		xReturn = ERR_MEM;
-		SYS_STATS_INC( mbox.err );
-	}
-
-	return xReturn;
+	/* The mailbox was already full. */
+	SYS_STATS_INC( mbox.err );
+	return ERR_MEM;
 }
 
 /*---------------------------------------------------------------------------*
@@ -195,50 +462,57 @@ portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
  *---------------------------------------------------------------------------*/
 u32_t sys_arch_mbox_fetch( sys_mbox_t *pxMailBox, void **ppvBuffer, u32_t ulTimeOut )
 {
+struct sys_mbox *pxMbox = *pxMailBox;
 void *pvDummy;
-portTickType xStartTime, xEndTime, xElapsed;
-unsigned long ulReturn;
-
-	xStartTime = xTaskGetTickCount();
+portTickType xStartTime, xElapsed, xTimeOutTicks;
 
 	if( NULL == ppvBuffer )
 	{
 		ppvBuffer = &pvDummy;
 	}
 
-	if( ulTimeOut != 0UL )
+	/* Fast path, no waiting or time keeping */
+	if( prvMboxGet( pxMbox, ppvBuffer ) != pdFALSE )
 	{
-		configASSERT( xInsideISR == ( portBASE_TYPE ) 0 );
+		prvFetchReturning();
+		return 0;
+	}
 
-		if( pdTRUE == xQueueReceive( *pxMailBox, &( *ppvBuffer ), ulTimeOut/ portTICK_RATE_MS ) )
-		{
-			xEndTime = xTaskGetTickCount();
-			xElapsed = ( xEndTime - xStartTime ) * portTICK_RATE_MS;
+	configASSERT( xInsideISR == ( portBASE_TYPE ) 0 );
+	prvFetchBlocking();
 
-			ulReturn = xElapsed;
-		}
-		else
+	xStartTime = xTaskGetTickCount();
+	xTimeOutTicks = ( ulTimeOut != 0UL ) ? ulTimeOut / portTICK_RATE_MS : portMAX_DELAY;
+
+	for( ;; )
+	{
+		xElapsed = xTaskGetTickCount() - xStartTime;
+		if( xTimeOutTicks != portMAX_DELAY && xElapsed >= xTimeOutTicks )
 		{
 			/* Timed out. */
 			*ppvBuffer = NULL;
-			ulReturn = SYS_ARCH_TIMEOUT;
+			prvFetchReturning();
+			return SYS_ARCH_TIMEOUT;
 		}
-	}
-	else
-	{
-		while( pdTRUE != xQueueReceive( *pxMailBox, &( *ppvBuffer ), portMAX_DELAY ) );
-		xEndTime = xTaskGetTickCount();
-		xElapsed = ( xEndTime - xStartTime ) * portTICK_RATE_MS;
 
-		if( xElapsed == 0UL )
+		prvMboxWait( pxMbox, pxMbox->xRxSemaphore, &pxMbox->ucRxWaiters, pdTRUE,
+		             ( xTimeOutTicks == portMAX_DELAY ) ? portMAX_DELAY : xTimeOutTicks - xElapsed );
+
+		if( prvMboxGet( pxMbox, ppvBuffer ) != pdFALSE )
 		{
-			xElapsed = 1UL;
+			break;
 		}
-
-		ulReturn = xElapsed;
 	}
 
-	return ulReturn;
+	prvMboxChain( pxMbox, pdTRUE );
+	prvFetchReturning();
+
+	xElapsed = ( xTaskGetTickCount() - xStartTime ) * portTICK_RATE_MS;
+	if( xElapsed == 0UL )
+	{
+		xElapsed = 1UL;
+	}
+	return xElapsed;
 }
 
 /*---------------------------------------------------------------------------*
@@ -258,34 +532,17 @@ unsigned long ulReturn;
 u32_t sys_arch_mbox_tryfetch( sys_mbox_t *pxMailBox, void **ppvBuffer )
 {
 void *pvDummy;
-unsigned long ulReturn;
-long lResult;
-portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
 
 	if( ppvBuffer== NULL )
 	{
 		ppvBuffer = &pvDummy;
 	}
 
-	if( xInsideISR != pdFALSE )
-	{
-		lResult = xQueueReceiveFromISR( *pxMailBox, &( *ppvBuffer ), &xHigherPriorityTaskWoken );
-	}
-	else
-	{
-		lResult = xQueueReceive( *pxMailBox, &( *ppvBuffer ), 0UL );
-	}
-
-	if( lResult == pdPASS )
-	{
-		ulReturn = ERR_OK;
-	}
-	else
+	if( prvMboxGet( *pxMailBox, ppvBuffer ) != pdFALSE )
 	{
-		ulReturn = SYS_MBOX_EMPTY;
+		return ERR_OK;
 	}
-
-	return ulReturn;
+	return SYS_MBOX_EMPTY;
 }
 
 /*---------------------------------------------------------------------------*
@@ -411,6 +668,13 @@ err_t xReturn = ERR_MEM;
  * @param mutex the mutex to lock */
 void sys_mutex_lock( sys_mutex_t *pxMutex )
 {
+#if LWIP_TCPIP_CORE_LOCKING
+	if( pxMutex == &lock_tcpip_core )
+	{
+		prvCoreLock();
+		return;
+	}
+#endif
 	while( xSemaphoreTake( *pxMutex, portMAX_DELAY ) != pdPASS );
 }
 
@@ -418,6 +682,13 @@ void sys_mutex_lock( sys_mutex_t *pxMutex )
  * @param mutex the mutex to unlock */
 void sys_mutex_unlock(sys_mutex_t *pxMutex )
 {
+#if LWIP_TCPIP_CORE_LOCKING
+	if( pxMutex == &lock_tcpip_core )
+	{
+		prvCoreUnlock();
+		return;
+	}
+#endif
 	xSemaphoreGive( *pxMutex );
 }
 
@@ -477,9 +748,51 @@ void sys_init(void)
 {
 }
 
+/*---------------------------------------------------------------------------*
+ * Routine:  sys_uptime_us
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Microseconds since boot, from the free-running 1MHz WDEV counter
+ *      (the one behind sdk_system_get_time), extended to 64 bits. The
+ *      counter wraps every ~71 minutes so the extension needs a call at
+ *      least that often, which the lwIP timers always provide.
+ *
+ *      Unlike the tick count this keeps running accurately through
+ *      tickless idle and doesn't depend on the CPU clock. Safe to call
+ *      from interrupt context.
+ * Outputs:
+ *      uint64_t                -- Uptime in microseconds
+ *---------------------------------------------------------------------------*/
+static u32_t ulUptimeLast;
+static u32_t ulUptimeHigh;
+
+uint64_t IRAM sys_uptime_us(void)
+{
+uint32_t ulLevel = _xt_disable_interrupts();
+u32_t ulNow = WDEV.SYS_TIME;
+uint64_t ullReturn;
+
+	if( ulNow < ulUptimeLast )
+	{
+		ulUptimeHigh++;
+	}
+	ulUptimeLast = ulNow;
+	ullReturn = ( ( uint64_t ) ulUptimeHigh << 32 ) | ulNow;
+	_xt_restore_interrupts( ulLevel );
+
+	return ullReturn;
+}
+
+/* Microsecond clock, wraps every ~71 minutes */
+u32_t sys_now_us(void)
+{
+	return ( u32_t ) sys_uptime_us();
+}
+
+/* Millisecond clock for the lwIP timers */
 u32_t sys_now(void)
 {
-	return xTaskGetTickCount();
+	return ( u32_t ) ( sys_uptime_us() / 1000 );
 }
 
 /*---------------------------------------------------------------------------*
@@ -511,6 +824,12 @@ sys_thread_t xReturn;
 	if( xResult == pdPASS )
 	{
 		xReturn = xCreatedTask;
+#if LWIP_TCPIP_CORE_LOCKING
+		if( strcmp( pcName, TCPIP_THREAD_NAME ) == 0 )
+		{
+			xTcpipTask = xCreatedTask;
+		}
+#endif
 	}
 	else
 	{
@@ -536,16 +855,18 @@ sys_thread_t xReturn;
  *
  *      sys_arch_protect() is only required if your port is supporting an
  *      operating system.
+ *
+ *      lwIP's protected sections are a handful of instructions (pbuf
+ *      reference counts, memp lists), so rather than a full
+ *      taskENTER_CRITICAL() this just masks interrupts and returns the
+ *      previous PS, which nests naturally and works the same in ISRs.
+ *      The SYS_ARCH_PROTECT macros in arch/sys_arch.h inline it.
  * Outputs:
- *      sys_prot_t              -- Previous protection level (not used here)
+ *      sys_prot_t              -- Previous processor status (PS)
  *---------------------------------------------------------------------------*/
 sys_prot_t sys_arch_protect( void )
 {
-	if( xInsideISR == pdFALSE )
-	{
-		taskENTER_CRITICAL();
-	}
-	return ( sys_prot_t ) 1;
+	return ( sys_prot_t ) _xt_disable_interrupts();
 }
 
 /*---------------------------------------------------------------------------*
@@ -557,15 +878,11 @@ sys_prot_t sys_arch_protect( void )
  *      sys_arch_protect() for more information. This function is only
  *      required if your port is supporting an operating system.
  * Inputs:
- *      sys_prot_t              -- Previous protection level (not used here)
+ *      sys_prot_t              -- Processor status from sys_arch_protect()
  *---------------------------------------------------------------------------*/
 void sys_arch_unprotect( sys_prot_t xValue )
 {
-	(void) xValue;
-	if( xInsideISR == pdFALSE )
-	{
-		taskEXIT_CRITICAL();
-	}
+	_xt_restore_interrupts( ( uint32_t ) xValue );
 }
 
 /*
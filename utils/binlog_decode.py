@@ -0,0 +1,115 @@
+#!/usr/bin/env python
+#
+# Format the output of extras/binlog's BINLOG_OUTPUT_HOST
+#
+# Usage: python binlog_decode.py [--level N] program.elf [log]
+#
+# Reads BINLOG and BINLOG_DROPPED lines from the log (or stdin), passing
+# anything else through, and prints each record as the device's
+# BINLOG_OUTPUT_TEXT would have: uptime, level letter and message. The
+# format strings, and the strings %s arguments point at, are read from
+# the ELF file of the program that logged them, which must be the same
+# build.
+#
+# Part of esp-open-rtos
+# BSD Licensed as described in the file LICENSE
+import argparse
+import re
+import struct
+import sys
+
+LEVELS = '?EWIDV'
+
+CONV = re.compile(r'%([-+ #0]*)(\d+|\*)?(\.\d*|\.\*)?(hh|h|ll|l|z|j|t)?([diouxXcsp%])')
+
+class Elf(object):
+    """The allocated sections of a 32 bit little endian ELF file"""
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            data = f.read()
+        if data[:4] != b'\x7fELF' or data[4:5] != b'\x01':
+            raise ValueError('%s is not a 32 bit ELF file' % path)
+        shoff, = struct.unpack_from('<I', data, 0x20)
+        shentsize, shnum = struct.unpack_from('<HH', data, 0x2e)
+        self.sections = []
+        for i in range(shnum):
+            (name, type_, flags, addr, offset, size,
+             link, info, align, entsize) = struct.unpack_from('<10I', data, shoff + i * shentsize)
+            # SHF_ALLOC, and not SHT_NOBITS (.bss has no contents)
+            if flags & 2 and type_ != 8 and addr:
+                self.sections.append((addr, data[offset:offset + size]))
+
+    def string(self, addr):
+        for base, contents in self.sections:
+            if base <= addr < base + len(contents):
+                end = contents.find(b'\0', addr - base)
+                if end < 0:
+                    end = len(contents)
+                return contents[addr - base:end].decode('latin-1')
+        return None
+
+def signed(value, bits):
+    value &= (1 << bits) - 1
+    return value - (1 << bits) if value & (1 << (bits - 1)) else value
+
+def format_message(elf, fmt, args):
+    args = list(args)
+
+    def take():
+        return args.pop(0) if args else 0
+
+    def conv(m):
+        flags, width, precision, length, kind = m.groups()
+        if kind == '%':
+            return '%'
+        if width == '*':
+            width = str(signed(take(), 32))
+        if precision == '.*':
+            precision = '.' + str(max(signed(take(), 32), 0))
+        spec = '%' + flags + (width or '') + (precision or '')
+        value = take()
+        bits = {'hh': 8, 'h': 16}.get(length, 32)
+        if kind in 'di':
+            return (spec + 'd') % signed(value, bits)
+        if kind in 'ouxX':
+            return (spec + kind) % (value & ((1 << bits) - 1))
+        if kind == 'c':
+            return (spec + 'c') % chr(value & 0xff)
+        if kind == 'p':
+            return (spec + 's') % ('0x%x' % value)
+        s = elf.string(value)
+        return (spec + 's') % (s if s is not None else '<%08x>' % value)
+
+    return CONV.sub(conv, fmt)
+
+def main():
+    parser = argparse.ArgumentParser(description='Format binlog records')
+    parser.add_argument('elf', help='the program\'s ELF file')
+    parser.add_argument('log', nargs='?', help='log file (default stdin)')
+    parser.add_argument('--level', type=int, default=5,
+                        help='only show records up to this level (1 error .. 5 verbose)')
+    args = parser.parse_args()
+
+    elf = Elf(args.elf)
+    f = open(args.log) if args.log else sys.stdin
+    for line in f:
+        fields = line.strip().split(',')
+        if fields[0] == 'BINLOG_DROPPED' and len(fields) == 2:
+            print('binlog: %s records dropped' % fields[1])
+            continue
+        if fields[0] != 'BINLOG' or len(fields) < 3:
+            sys.stdout.write(line)
+            continue
+        site = elf.string(int(fields[2], 16))
+        if not site:
+            print('%s ? <unknown site %s>' % (fields[1], fields[2]))
+            continue
+        level = ord(site[0]) - ord('0')
+        if level > args.level:
+            continue
+        sec, us = fields[1].split('.')
+        message = format_message(elf, site[1:], [int(a, 16) for a in fields[3:]])
+        print('%6s.%s %s %s' % (sec, us, LEVELS[level] if 0 < level < len(LEVELS) else '?', message))
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,86 @@
+#!/usr/bin/env python
+#
+# Generate extras/mbedtls/p256_comb_table.h, the fixed-base comb table
+# for NIST P-256 used with MBEDTLS_P256_COMB=1
+#
+# Usage: python gen_p256_comb.py > extras/mbedtls/p256_comb_table.h
+#
+# mbedtls' ecp_mul_comb() multiplies the base point G with a window of
+# w = 5 bits and d = ceil(256 / w) = 52 comb teeth, from a table of
+# 2^(w-1) = 16 affine points built by ecp_precompute_comb():
+#
+#     T[i] = G + sum of 2^(d * (j + 1)) * G for each bit j set in i
+#
+# This computes the same points, normalised as mbedtls leaves them (affine
+# X and Y, Z = 1), and prints their coordinates as little endian 32-bit
+# limbs, mbedtls_mpi's layout on the lx106.
+#
+# Part of esp-open-rtos
+# BSD Licensed as described in the file LICENSE
+import sys
+
+P = 0xffffffff00000001000000000000000000000000ffffffffffffffffffffffff
+A = P - 3
+GX = 0x6b17d1f2e12c4247f8bce6e563a440f277037d812deb33a0f4a13945d898c296
+GY = 0x4fe342e2fe1a7f9b8ee7eb4a7c0f9e162bce33576b315ececbb6406837bf51f5
+B = 0x5ac635d8aa3a93e7b3ebbd55769886bc651d06b0cc53b0f63bce3c3e27d2604b
+
+W = 5
+D = (256 + W - 1) // W
+LIMBS = 8
+
+def add(p1, p2):
+    if p1 is None:
+        return p2
+    if p2 is None:
+        return p1
+    (x1, y1), (x2, y2) = p1, p2
+    if x1 == x2:
+        if (y1 + y2) % P == 0:
+            return None
+        l = (3 * x1 * x1 + A) * pow(2 * y1, P - 2, P) % P
+    else:
+        l = (y2 - y1) * pow(x2 - x1, P - 2, P) % P
+    x3 = (l * l - x1 - x2) % P
+    return (x3, (l * (x1 - x3) - y1) % P)
+
+def double_n(p, n):
+    for _ in range(n):
+        p = add(p, p)
+    return p
+
+def on_curve(p):
+    x, y = p
+    return (y * y - (x * x * x + A * x + B)) % P == 0
+
+def limbs(v):
+    return ', '.join('0x%08x' % ((v >> (32 * i)) & 0xffffffff) for i in range(LIMBS))
+
+def main():
+    g = (GX, GY)
+    teeth = [double_n(g, D * (j + 1)) for j in range(W - 1)]
+    table = []
+    for i in range(1 << (W - 1)):
+        t = g
+        for j in range(W - 1):
+            if i & (1 << j):
+                t = add(t, teeth[j])
+        assert on_curve(t)
+        table.append(t)
+
+    out = sys.stdout
+    out.write('/* Generated by utils/gen_p256_comb.py, do not edit.\n'
+              ' *\n'
+              ' * P-256 fixed-base comb table, w = %d, d = %d: X and Y of each\n'
+              ' * point as %d little endian limbs (Z is 1)\n'
+              ' */\n' % (W, D, LIMBS))
+    out.write('#define P256_COMB_W %d\n' % W)
+    out.write('#define P256_COMB_POINTS %d\n' % len(table))
+    out.write('#define P256_COMB_LIMBS %d\n\n' % LIMBS)
+    out.write('static const uint32_t IROM p256_comb_table[P256_COMB_POINTS][2][P256_COMB_LIMBS] = {\n')
+    for x, y in table:
+        out.write('    { { %s },\n      { %s } },\n' % (limbs(x), limbs(y)))
+    out.write('};\n')
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,99 @@
+#!/usr/bin/env python
+#
+# Generate a linker script fragment placing hot functions in IRAM
+#
+# Usage: python iram_hot.py --objdump <objdump> --budget <bytes> --out iram_hot.ld \
+#            [--hot <hot list>] <archive.a>...
+#
+# The hot list has one function per line, optionally preceded by a
+# weight (sample count from a profiler, call count from a trace):
+#
+#     # comment
+#     1520 tcp_receive
+#     830  ip_input
+#     memcpy_fast
+#
+# Lines without a weight count as weight 1. utils/prof_symbolize.py
+# writes this format from an esp/profiler.h run.
+#
+# Function sizes are read from the compiled component archives with
+# objdump, and functions are picked in order of weight per byte until
+# the budget is spent. Only functions compiled into their own sections
+# (the default, SPLIT_SECTIONS=1) and not already in IRAM can be moved.
+# Functions not found are listed as skipped.
+#
+# Part of esp-open-rtos
+# BSD Licensed as described in the file LICENSE
+import argparse
+import subprocess
+import sys
+
+def read_hot(path):
+    hot = {}
+    for line in open(path):
+        line = line.split('#', 1)[0].split()
+        if not line:
+            continue
+        if len(line) == 1:
+            weight, name = 1, line[0]
+        else:
+            weight, name = int(line[0], 0), line[-1]
+        hot[name] = hot.get(name, 0) + weight
+    return hot
+
+def read_sizes(objdump, archives):
+    """Sizes of the functions in the archives that are in their own
+    .text.<name> section. Functions defined in more than one object
+    (static functions) are summed, since the section pattern matches all
+    of them."""
+    sizes = {}
+    if not archives:
+        return sizes
+    out = subprocess.check_output([objdump, '-t'] + archives,
+                                  universal_newlines=True)
+    for line in out.splitlines():
+        fields = line.split()
+        if len(fields) < 5 or 'F' not in fields[1:-3]:
+            continue
+        section, size, name = fields[-3:]
+        if section != '.text.' + name:
+            continue
+        sizes[name] = sizes.get(name, 0) + int(size, 16)
+    return sizes
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--objdump', default='xtensa-lx106-elf-objdump')
+    parser.add_argument('--budget', type=int, required=True)
+    parser.add_argument('--hot')
+    parser.add_argument('--out', required=True)
+    parser.add_argument('archives', nargs='*')
+    args = parser.parse_args()
+
+    lines = ['/* Generated by utils/iram_hot.py, do not edit */']
+    if args.hot:
+        hot = read_hot(args.hot)
+        sizes = read_sizes(args.objdump, args.archives)
+        found = [n for n in hot if sizes.get(n)]
+        found.sort(key=lambda n: (-float(hot[n]) / sizes[n], n))
+
+        used = 0
+        for name in found:
+            if used + sizes[name] > args.budget:
+                continue
+            used += sizes[name]
+            lines.append('*(.literal.%s .text.%s) /* %d bytes, weight %d */'
+                         % (name, name, sizes[name], hot[name]))
+
+        missing = sorted(n for n in hot if not sizes.get(n))
+        if missing:
+            sys.stderr.write('iram_hot: not found (or already in IRAM): %s\n'
+                             % ' '.join(missing))
+        sys.stderr.write('iram_hot: %d of %d functions, %d of %d bytes\n'
+                         % (len(lines) - 1, len(hot), used, args.budget))
+
+    with open(args.out, 'w') as f:
+        f.write('\n'.join(lines) + '\n')
+
+if __name__ == '__main__':
+    main()
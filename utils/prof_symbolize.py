@@ -0,0 +1,65 @@
+#!/usr/bin/env python
+#
+# Turn the output of esp/profiler.h's profiler_dump() into a flat
+# per-function profile
+#
+# Usage: python prof_symbolize.py [--addr2line <addr2line>] <program.out> [log]
+#
+# Reads "PROF,<pc>,<count>" lines from the log (or stdin), ignoring
+# anything else, looks the PCs up with addr2line and prints one line per
+# function, most samples first:
+#
+#     1520 tcp_receive  # 18.2% tcp_in.c:1102
+#
+# This is the hot list format utils/iram_hot.py takes (IRAM_HOT_FUNCS).
+#
+# Part of esp-open-rtos
+# BSD Licensed as described in the file LICENSE
+import argparse
+import os
+import subprocess
+import sys
+
+def read_samples(f):
+    samples = {}
+    for line in f:
+        fields = line.strip().split(',')
+        if len(fields) != 3 or fields[0] != 'PROF':
+            continue
+        pc = int(fields[1], 16)
+        samples[pc] = samples.get(pc, 0) + int(fields[2])
+    return samples
+
+def symbolize(addr2line, elf, pcs):
+    """(function, file:line) for each PC, from addr2line -f"""
+    if not pcs:
+        return []
+    out = subprocess.check_output([addr2line, '-f', '-e', elf]
+                                  + ['0x%08x' % pc for pc in pcs],
+                                  universal_newlines=True).splitlines()
+    return [(out[2 * i], out[2 * i + 1]) for i in range(len(pcs))]
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--addr2line', default='xtensa-lx106-elf-addr2line')
+    parser.add_argument('elf')
+    parser.add_argument('log', nargs='?')
+    args = parser.parse_args()
+
+    samples = read_samples(open(args.log) if args.log else sys.stdin)
+    pcs = sorted(samples)
+    funcs = {}
+    where = {}
+    for pc, (func, loc) in zip(pcs, symbolize(args.addr2line, args.elf, pcs)):
+        if func == '??':
+            func = '0x%08x' % pc
+        funcs[func] = funcs.get(func, 0) + samples[pc]
+        where.setdefault(func, os.path.basename(loc))
+
+    total = sum(funcs.values()) or 1
+    for func in sorted(funcs, key=lambda f: (-funcs[f], f)):
+        print('%d %s  # %.1f%% %s' % (funcs[func], func,
+                                      100.0 * funcs[func] / total, where[func]))
+
+if __name__ == '__main__':
+    main()
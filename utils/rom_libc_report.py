@@ -0,0 +1,134 @@
+#!/usr/bin/env python
+#
+# Report what ROM_LIBC=1 saves in a program
+#
+# Usage: python rom_libc_report.py [--rom-ld ld/rom_libc.ld] build/<program>.map
+#
+# Give it the link map of a build without ROM_LIBC. For each symbol that
+# ld/rom_libc.ld routes to the mask ROM, it finds the libc or libgcc
+# member the linker pulled in for it and adds up that member's sections
+# by where they were placed:
+#
+#     symbol         member                     iram   irom  other
+#     __udivdi3      _udivdi3.o                  876      0      0
+#     strlen         lib_a-strlen.o                0     91      0
+#     ...
+#     total                                     1304    610      0
+#
+# IROM bytes saved are also bytes that no longer compete for the 32 KB
+# flash cache. With the map of a ROM_LIBC=1 build it lists the symbols
+# already resolved to the ROM.
+#
+# Part of esp-open-rtos
+# BSD Licensed as described in the file LICENSE
+import argparse
+import os
+import re
+import sys
+
+ASSIGN = re.compile(r'^\s*([A-Za-z_][A-Za-z0-9_]*)\s*=\s*(0x[0-9a-fA-F]+)\s*;')
+MEMBER = re.compile(r'^(\S+\.a\(([^)]+)\))(?:\s+\S.*\((\S+)\))?\s*$')
+REFERENCE = re.compile(r'^\s+\S.*\((\S+)\)\s*$')
+INPUT = re.compile(r'^\s*(\S+)?\s+(0x[0-9a-f]+)\s+(0x[0-9a-f]+)\s+(\S+\.a\([^)]+\))\s*$')
+SECTION = re.compile(r'^\s(\.\S+)\s*$')
+
+def read_routed(path):
+    routed = {}
+    for line in open(path):
+        m = ASSIGN.match(line)
+        if m:
+            routed[m.group(1)] = int(m.group(2), 16)
+    return routed
+
+def region(addr):
+    if 0x40100000 <= addr < 0x40200000:
+        return 'iram'
+    if 0x40200000 <= addr < 0x40300000:
+        return 'irom'
+    return 'other'
+
+def read_map(path):
+    """The archive member pulled in for each symbol, the bytes of each
+    member by region, and the symbols assigned absolute ROM addresses"""
+    members = {}
+    sizes = {}
+    rom = set()
+    lines = open(path).read().splitlines()
+    in_members = True
+    pending = None
+    section = None
+    for line in lines:
+        if line.startswith('Linker script and memory map'):
+            in_members = False
+            continue
+        if in_members:
+            m = MEMBER.match(line)
+            if m:
+                pending = m.group(1)
+                if m.group(3):
+                    members.setdefault(m.group(3), pending)
+                    pending = None
+                continue
+            m = REFERENCE.match(line)
+            if m and pending:
+                members.setdefault(m.group(1), pending)
+                pending = None
+            continue
+
+        m = SECTION.match(line)
+        if m:
+            section = m.group(1)
+            continue
+        m = INPUT.match(line)
+        if m:
+            addr, size = int(m.group(2), 16), int(m.group(3), 16)
+            if size and (m.group(1) or section):
+                by_region = sizes.setdefault(m.group(4), {})
+                r = region(addr)
+                by_region[r] = by_region.get(r, 0) + size
+            section = None
+            continue
+        fields = line.split()
+        if len(fields) >= 4 and fields[0].startswith('0x') and fields[2] == '=':
+            rom.add(fields[1])
+        section = None
+    return members, sizes, rom
+
+def main():
+    root = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--rom-ld', default=os.path.join(root, 'ld', 'rom_libc.ld'))
+    parser.add_argument('map')
+    args = parser.parse_args()
+
+    routed = read_routed(args.rom_ld)
+    members, sizes, rom = read_map(args.map)
+
+    already = sorted(s for s in routed if s in rom and s not in members)
+    if already:
+        print('# already from ROM: %s' % ' '.join(already))
+
+    print('%-14s %-24s %6s %6s %6s' % ('symbol', 'member', 'iram', 'irom', 'other'))
+    total = {'iram': 0, 'irom': 0, 'other': 0}
+    counted = set()
+    for sym in sorted(routed):
+        member = members.get(sym)
+        if not member:
+            continue
+        by_region = sizes.get(member, {})
+        if member in counted:
+            by_region = {}
+        counted.add(member)
+        for r in total:
+            total[r] += by_region.get(r, 0)
+        name = re.sub(r'^.*\(([^)]+)\)$', r'\1', member)
+        print('%-14s %-24s %6d %6d %6d' % (sym, name, by_region.get('iram', 0),
+                                           by_region.get('irom', 0),
+                                           by_region.get('other', 0)))
+    print('%-14s %-24s %6d %6d %6d' % ('total', '', total['iram'], total['irom'],
+                                       total['other']))
+    if not counted and not already:
+        sys.stderr.write('rom_libc_report: none of the routed symbols are in %s\n' % args.map)
+
+if __name__ == '__main__':
+    main()
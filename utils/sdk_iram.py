@@ -0,0 +1,303 @@
+#!/usr/bin/env python
+#
+# Move SDK library code that never needs to be in IRAM to IROM
+#
+# Usage: python sdk_iram.py --objdump <objdump> [--objcopy <objcopy> --ar <ar>]
+#            [--iram-ld iram_hot.ld] [--report <file>] <lib>_stage2.a...
+#            --components <component.a>...
+#
+# ld/common.ld links the .text of every SDK object into IRAM, as the
+# blobs expect: Espressif put there what runs from interrupts or with
+# the flash cache disabled. But each object has a single .text, so
+# anything else that happens to share an object with such code (init
+# functions, code only called from flash) is in IRAM too, and so is
+# every object whose .text is only ever called from flash code.
+#
+# This reads the relocations of the processed SDK libraries and of the
+# program's component archives, and builds the call graph between code
+# sections. On the lx106, a call compiled with -mlongcalls is a literal
+# load marked R_XTENSA_ASM_EXPAND, so calls can be told apart from
+# taking a function's address. An SDK object's .text stays in IRAM if:
+#
+#   - its address is taken anywhere (a literal loaded other than for a
+#     call, or a pointer in data: an interrupt handler, a callback, a
+#     jump table), or
+#   - it uses the flash cache or SPI flash ROM routines, or
+#   - it is called from code that is in IRAM: our .iram1 sections, the
+#     vectors, functions placed by IRAM_HOT_FUNCS, or SDK code that
+#     stays for any of these reasons.
+#
+# Everything else is only ever called from flash code, so the flash
+# cache is necessarily on whenever it runs. Given --objcopy and --ar,
+# each <lib>_stage2.a is written out as <lib>.a with the .text and
+# .literal of those objects renamed .irom0.sdk.*, which common.ld links
+# into IROM. The report lists what was moved, and why the rest stayed:
+#
+#     library       object                  bytes  placement
+#     libmain.a     user_interface.o          412  iram: uses Cache_Read_Disable
+#     ...
+#     libphy.a      phy_sleep.o               259  irom
+#     libpp.a       lmac.o                   6268  iram: called from pp.o .text
+#     ...
+#     moved 586 of 20858 bytes
+#
+# Unused code doesn't need this: with SPLIT_SECTIONS=1 the linker
+# already drops every SDK .text nothing refers to.
+#
+# Part of esp-open-rtos
+# BSD Licensed as described in the file LICENSE
+import argparse
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+
+MEMBER = re.compile(r'^(\S+):\s+file format ')
+HEADER = re.compile(r'^\s*\d+\s+(\S+)\s+([0-9a-f]+)\s')
+SYMBOL = re.compile(r'^([0-9a-f]{8}) (.{7}) (\S+)\t([0-9a-f]+) (\S+)$')
+RELOCS = re.compile(r'^RELOCATION RECORDS FOR \[(\S+)\]:$')
+RELOC = re.compile(r'^([0-9a-f]{8}) (\S+)\s+(\S+?)(?:([+-])0x([0-9a-f]+))?$')
+HOT = re.compile(r'\.text\.([^\s)]+)')
+
+# Using any of these means running with the flash cache disabled
+CACHE_OFF = re.compile(r'^(sdk_)?(rom_)?(Cache_Read_|SPI|spi_flash_|Wait_SPI_Idle$|'
+                       r'Enable_QMode$|Disable_QMode$)')
+
+SDK_IRAM = ('.text', '.literal')
+SDK_IROM = '.irom0.sdk'
+
+def is_component_iram(section, hot):
+    if section.startswith(('.iram1.', '.vecbase.', '.entry.')):
+        return True
+    name = section.split('.', 2)[-1]
+    return section.startswith(('.text.', '.literal.')) and name in hot
+
+class Object(object):
+    def __init__(self, archive, name, sdk):
+        self.archive = archive
+        self.name = name
+        self.sdk = sdk
+        self.code = {}      # code section -> size
+        self.alloc = set()  # every allocated section
+        self.symbols = {}   # definitions -> (section, value, local, weak)
+        self.relocs = {}    # section -> [(offset, type, target, addend)]
+
+def read_objects(objdump, archive, sdk):
+    out = subprocess.check_output([objdump, '-h', '-t', '-r', archive],
+                                  universal_newlines=True)
+    objects = []
+    obj = None
+    flags_of = None
+    relocs = None
+    for line in out.splitlines():
+        m = MEMBER.match(line)
+        if m:
+            obj = Object(archive, m.group(1), sdk)
+            objects.append(obj)
+            relocs = None
+            continue
+        if obj is None:
+            continue
+        m = RELOCS.match(line)
+        if m:
+            relocs = obj.relocs.setdefault(m.group(1), [])
+            continue
+        if relocs is not None:
+            m = RELOC.match(line)
+            if m:
+                addend = int(m.group(5) or '0', 16) * (-1 if m.group(4) == '-' else 1)
+                relocs.append((int(m.group(1), 16), m.group(2), m.group(3), addend))
+            continue
+        m = SYMBOL.match(line)
+        if m:
+            flags, section, name = m.group(2), m.group(3), m.group(5)
+            if section not in ('*UND*', '*COM*', '*ABS*') and 'd' not in flags:
+                obj.symbols[name] = (section, int(m.group(1), 16), flags[0] == 'l',
+                                     flags[1] == 'w')
+            continue
+        m = HEADER.match(line)
+        if m:
+            flags_of = (m.group(1), int(m.group(2), 16))
+            continue
+        if flags_of and line.startswith(' ') and 'ALLOC' in line:
+            obj.alloc.add(flags_of[0])
+            if 'CODE' in line:
+                obj.code[flags_of[0]] = flags_of[1]
+        flags_of = None
+    return objects
+
+def resolve_globals(objects):
+    """The definition each global symbol links to: a strong one if there
+    is one (the SDK's are all weak), otherwise the first"""
+    defs = {}
+    for obj in objects:
+        for name, (section, value, local, weak) in obj.symbols.items():
+            if local:
+                continue
+            if name not in defs or (defs[name][3] and not weak):
+                defs[name] = (obj, section, value, weak)
+    return defs
+
+def analyse(objects, hot):
+    defs = resolve_globals(objects)
+    iram = set()       # (object, section) always in IRAM
+    pinned = {}        # SDK (object, section) -> why it stays in IRAM
+    calls = {}         # (object, section) -> set of called (object, section)
+
+    def target_of(obj, name):
+        if name in obj.alloc:
+            return (obj, name)
+        sym = obj.symbols.get(name)
+        if sym and sym[2]:
+            return (obj, sym[0])
+        d = defs.get(name)
+        if d:
+            return (d[0], d[1])
+        return None
+
+    def candidate(node):
+        return node and node[0].sdk and node[1] in SDK_IRAM
+
+    for obj in objects:
+        for section in obj.code:
+            if not obj.sdk and is_component_iram(section, hot):
+                iram.add((obj, section))
+
+        # Literal loads, and whether each is for a call: l32r's reloc
+        # points at the literal, an ASM_EXPAND at the same place says it
+        # feeds a callx
+        literals = set()
+        for section, relocs in obj.relocs.items():
+            literals.update((section, offset) for (offset, kind, n, a) in relocs
+                            if kind == 'R_XTENSA_32')
+        loads = {}
+        for section, relocs in obj.relocs.items():
+            expands = set(offset for (offset, kind, n, a) in relocs
+                          if kind == 'R_XTENSA_ASM_EXPAND')
+            for (offset, kind, name, addend) in relocs:
+                if kind == 'R_XTENSA_SLOT0_OP' and (name, addend) in literals:
+                    loads.setdefault((name, addend), []).append(offset in expands)
+
+        for section, relocs in obj.relocs.items():
+            if section not in obj.alloc:
+                continue
+            node = (obj, section)
+            for (offset, kind, name, addend) in relocs:
+                if CACHE_OFF.match(name) and candidate(node):
+                    pinned.setdefault(node, 'uses %s' % name)
+                target = target_of(obj, name)
+                if not target:
+                    continue
+                if kind == 'R_XTENSA_ASM_EXPAND':
+                    calls.setdefault(node, set()).add(target)
+                elif kind == 'R_XTENSA_SLOT0_OP':
+                    if target != node and (name, addend) not in literals:
+                        calls.setdefault(node, set()).add(target)
+                elif kind == 'R_XTENSA_32' and all(loads.get((section, offset), [False])):
+                    pass  # only ever loaded to call it, recorded above
+                elif candidate(target):
+                    pinned.setdefault(target, 'address taken (%s %s)'
+                                      % (obj.name, section))
+
+    # Whatever IRAM code calls stays in IRAM, transitively
+    todo = list(iram) + list(pinned)
+    seen = set(todo)
+    while todo:
+        node = todo.pop()
+        for target in calls.get(node, ()):
+            if target in seen or not (candidate(target) or target in iram):
+                continue
+            seen.add(target)
+            todo.append(target)
+            if candidate(target):
+                pinned.setdefault(target, 'called from %s %s' % (node[0].name, node[1]))
+
+    # .text and .literal of one object move together or not at all
+    result = {}
+    for obj in objects:
+        if not obj.sdk:
+            continue
+        size = sum(obj.code.get(s, 0) for s in SDK_IRAM)
+        if not size:
+            continue
+        why = [pinned[(obj, s)] for s in SDK_IRAM if (obj, s) in pinned]
+        result[obj] = (size, why[0] if why else None)
+    return result
+
+def rewrite(objcopy, ar, archive, out, moved):
+    tmp = tempfile.mkdtemp()
+    try:
+        work = os.path.join(tmp, os.path.basename(out))
+        shutil.copyfile(archive, work)
+        for name in moved:
+            member = os.path.join(tmp, name)
+            with open(member, 'wb') as f:
+                f.write(subprocess.check_output([ar, 'p', archive, name]))
+            subprocess.check_call([objcopy] + sum((['--rename-section', '%s=%s%s' % (s, SDK_IROM, s)]
+                                                   for s in SDK_IRAM), []) + [member])
+            subprocess.check_call([ar, 'r', work, member])
+        shutil.move(work, out)
+    finally:
+        shutil.rmtree(tmp)
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--objdump', default='xtensa-lx106-elf-objdump')
+    parser.add_argument('--objcopy')
+    parser.add_argument('--ar')
+    parser.add_argument('--iram-ld')
+    parser.add_argument('--report')
+    parser.add_argument('sdk', nargs='+')
+    parser.add_argument('--components', nargs='*', default=[])
+    args = parser.parse_args()
+
+    hot = set()
+    if args.iram_ld and os.path.exists(args.iram_ld):
+        hot = set(HOT.findall(open(args.iram_ld).read()))
+
+    objects = []
+    for archive in args.sdk:
+        objects += read_objects(args.objdump, archive, True)
+    for archive in args.components:
+        objects += read_objects(args.objdump, archive, False)
+    result = analyse(objects, hot)
+
+    lines = ['%-13s %-22s %6s  %s' % ('library', 'object', 'bytes', 'placement')]
+    moved_bytes = total = 0
+    for obj in sorted(result, key=lambda o: (o.archive, o.name)):
+        size, why = result[obj]
+        total += size
+        if not why:
+            moved_bytes += size
+        lib = os.path.basename(obj.archive).replace('_stage2', '')
+        lines.append('%-13s %-22s %6d  %s' % (lib, obj.name, size,
+                                             'iram: ' + why if why else 'irom'))
+    lines.append('moved %d of %d bytes' % (moved_bytes, total))
+
+    if args.report:
+        with open(args.report, 'w') as f:
+            f.write('\n'.join(lines) + '\n')
+    else:
+        print('\n'.join(lines))
+    sys.stderr.write('sdk_iram: %d of %d bytes of SDK code moved to IROM\n'
+                     % (moved_bytes, total))
+
+    # The libraries are written after the report, so make sees them as
+    # up to date with it. Without the libraries there's no report.
+    if args.objcopy and args.ar:
+        try:
+            for archive in args.sdk:
+                out = re.sub(r'_stage2\.a$', '.a', archive)
+                if out == archive:
+                    sys.exit('sdk_iram: %s is not a <lib>_stage2.a archive' % archive)
+                moved = [o.name for o in result if o.archive == archive and not result[o][1]]
+                rewrite(args.objcopy, args.ar, archive, out, moved)
+        except:
+            if args.report:
+                os.remove(args.report)
+            raise
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,157 @@
+#!/usr/bin/env python
+#
+# Break a program's memory use down by component and section
+#
+# Usage: python size_report.py [--nm <nm> --elf <program.out>] <program.map> <component.a>...
+#
+# 'make size-report' runs this. It reads the input sections from the
+# link map and adds them up by the archive they came from (a component
+# named on the command line, an SDK library, libc...) and where they
+# were placed:
+#
+#     component           iram    irom    data  rodata     bss   total
+#     lwip                1204   58960      88    2311    5368   67931
+#     libnet80211         6497   41292     388    1604   18294   68075
+#     ...
+#
+# iram and irom are code (and constants placed with it), data, rodata
+# and bss are DRAM. With LTO, the components' code is linked from merged
+# objects that don't say where it came from: given the ELF file, the
+# symbols in those are assigned to components by name (the archives'
+# objects are fat, so still list their symbols), and what can't be
+# assigned is shown as "lto".
+#
+# Part of esp-open-rtos
+# BSD Licensed as described in the file LICENSE
+import argparse
+import bisect
+import os
+import re
+import subprocess
+
+INPUT = re.compile(r'^\s*(\S+)?\s+(0x[0-9a-f]+)\s+(0x[0-9a-f]+)\s+(\S+)\s*$')
+SECTION = re.compile(r'^\s(\.\S+|COMMON)\s*$')
+ARCHIVE = re.compile(r'^(.*\.a)\((.*)\)$')
+COLUMNS = ['iram', 'irom', 'data', 'rodata', 'bss']
+
+def column(addr, section):
+    if 0x40100000 <= addr < 0x40200000:
+        return 'iram'
+    if 0x40200000 <= addr < 0x40400000:
+        return 'irom'
+    if 0x3ffe8000 <= addr < 0x40000000:
+        if section.startswith('.bss') or section == 'COMMON':
+            return 'bss'
+        if section.startswith('.rodata'):
+            return 'rodata'
+        return 'data'
+    return None
+
+def owner(path, components):
+    m = ARCHIVE.match(path)
+    if m:
+        archive = os.path.realpath(m.group(1))
+        name = os.path.basename(m.group(1))[:-2]
+        return components.get(archive, name)
+    if 'ltrans' in path:
+        return 'lto'
+    return os.path.basename(path)
+
+def read_map(path, components):
+    """(owner, column, addr, size) of every allocated input section"""
+    sections = []
+    section = None
+    in_map = False
+    for line in open(path):
+        line = line.rstrip('\n')
+        if line.startswith('Linker script and memory map'):
+            in_map = True
+            continue
+        if not in_map:
+            continue
+        m = SECTION.match(line)
+        if m:
+            section = m.group(1)
+            continue
+        m = INPUT.match(line)
+        if m and (m.group(1) or section) and not line.lstrip().startswith('*'):
+            name = m.group(1) or section
+            addr, size = int(m.group(2), 16), int(m.group(3), 16)
+            col = column(addr, name)
+            if size and col and name != '*fill*':
+                sections.append((owner(m.group(4), components), col, addr, size))
+        section = None
+    return sections
+
+def base_name(symbol):
+    return symbol.split('.', 1)[0]
+
+def symbol_owners(nm, archives, components):
+    owners = {}
+    with open(os.devnull, 'w') as null:
+        out = subprocess.check_output([nm, '--defined-only', '-A'] + archives,
+                                      universal_newlines=True, stderr=null)
+    for line in out.splitlines():
+        fields = line.split()
+        if len(fields) < 3 or fields[-2] in 'UuwWvV':
+            continue
+        archive = os.path.realpath(line.split(':', 1)[0])
+        owners.setdefault(base_name(fields[-1]), components.get(archive))
+    return owners
+
+def assign_lto(sections, nm, elf, archives, components):
+    """Move the bytes of named symbols in LTO sections to their owners"""
+    lto = sorted((addr, addr + size, col) for (who, col, addr, size) in sections
+                 if who == 'lto')
+    if not lto:
+        return sections
+    starts = [s for (s, e, c) in lto]
+    owners = symbol_owners(nm, archives, components)
+    moved = []
+    out = subprocess.check_output([nm, '-S', '--defined-only', elf],
+                                  universal_newlines=True)
+    for line in out.splitlines():
+        fields = line.split()
+        if len(fields) != 4:
+            continue
+        addr, size = int(fields[0], 16), int(fields[1], 16)
+        who = owners.get(base_name(fields[3]))
+        i = bisect.bisect_right(starts, addr) - 1
+        if not who or i < 0 or addr + size > lto[i][1]:
+            continue
+        col = lto[i][2]
+        moved.append((who, col, addr, size))
+        moved.append(('lto', col, addr, -size))
+    return sections + moved
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--nm', default='xtensa-lx106-elf-nm')
+    parser.add_argument('--elf')
+    parser.add_argument('map')
+    parser.add_argument('archives', nargs='*')
+    args = parser.parse_args()
+
+    components = dict((os.path.realpath(a), os.path.basename(a)[:-2])
+                      for a in args.archives)
+    sections = read_map(args.map, components)
+    if args.elf and args.archives:
+        sections = assign_lto(sections, args.nm, args.elf, args.archives, components)
+
+    table = {}
+    for (who, col, addr, size) in sections:
+        row = table.setdefault(who, dict((c, 0) for c in COLUMNS))
+        row[col] += size
+    totals = dict((c, sum(row[c] for row in table.values())) for c in COLUMNS)
+
+    fmt = '%-18s' + ' %7s' * (len(COLUMNS) + 1)
+    print(fmt % tuple(['component'] + COLUMNS + ['total']))
+    for who in sorted(table, key=lambda w: -sum(table[w].values())):
+        row = table[who]
+        if not any(row.values()):
+            continue
+        print(fmt % tuple([who] + [row[c] for c in COLUMNS] + [sum(row.values())]))
+    print(fmt % tuple(['total'] + [totals[c] for c in COLUMNS] + [sum(totals.values())]))
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,164 @@
+#!/usr/bin/env python
+#
+# Decode the output of esp/trace.h's trace_dump()
+#
+# Usage: python trace_decode.py [--json out.json] [--no-timeline] [log]
+#
+# Reads TASK and TRACE lines from the log (or stdin), ignoring anything
+# else, and prints a timeline of the events with the time since the
+# start of the trace and since the previous event, followed by the CPU
+# time of each task and interrupt. Task time includes the interrupts
+# that ran while it was switched in.
+#
+# With --json, also writes the trace in the Trace Event Format that
+# chrome://tracing and Perfetto (ui.perfetto.dev) display, one row per
+# task and per interrupt, with queue events as instant markers.
+#
+# Part of esp-open-rtos
+# BSD Licensed as described in the file LICENSE
+import argparse
+import json
+import re
+import sys
+
+EVENTS = {
+    1: 'switch', 2: 'create', 3: 'delete',
+    4: 'send', 5: 'send_isr', 6: 'recv', 7: 'recv_isr',
+    8: 'block_send', 9: 'block_recv',
+    10: 'isr_enter', 11: 'isr_exit', 12: 'mark',
+}
+
+# From esp/interrupts.h
+INUMS = {1: 'SLC', 2: 'SPI', 4: 'GPIO', 5: 'UART', 6: 'TICK', 7: 'SOFT',
+         8: 'WDT', 9: 'FRC1', 10: 'FRC2'}
+
+def read_log(f):
+    mhz = 80
+    tasks = {}
+    records = []
+    for line in f:
+        line = line.strip()
+        m = re.match(r'# trace .* (\d+) MHz', line)
+        if m:
+            mhz = int(m.group(1))
+            continue
+        fields = line.split(',', 2)
+        if fields[0] == 'TASK' and len(fields) == 3:
+            tasks[int(fields[1], 16)] = fields[2]
+        elif fields[0] == 'TRACE' and len(fields) == 3:
+            event, obj = fields[2].split(',')
+            records.append((int(fields[1], 16), int(event), int(obj, 16)))
+    return mhz, tasks, records
+
+def unwrap(records):
+    """Cycle counts since the first record, CCOUNT wraps every 2^32"""
+    if not records:
+        return []
+    base, last, high = records[0][0], records[0][0], 0
+    out = []
+    for ccount, event, obj in records:
+        if ccount < last:
+            high += 1 << 32
+        last = ccount
+        out.append((ccount + high - base, event, obj))
+    return out
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--json')
+    parser.add_argument('--no-timeline', action='store_true')
+    parser.add_argument('log', nargs='?')
+    args = parser.parse_args()
+
+    mhz, tasks, raw = read_log(open(args.log) if args.log else sys.stdin)
+    records = unwrap(raw)
+    if not records:
+        sys.exit('trace_decode: no TRACE records found')
+
+    def task_name(obj):
+        return tasks.get(obj, 'task@%06x' % obj)
+
+    def isr_name(obj):
+        return INUMS.get(obj, 'isr%d' % obj)
+
+    def us(cycles):
+        return float(cycles) / mhz
+
+    task_time = {}
+    isr_time = {}
+    isr_count = {}
+    isr_max = {}
+    chrome = []
+    current = None
+    switched_at = 0
+    isr_start = {}
+    previous = 0
+
+    for cycles, event, obj in records:
+        name = EVENTS.get(event, 'event%d' % event)
+        context = task_name(current) if current is not None else '?'
+        if isr_start:
+            context = isr_name(list(isr_start)[-1])
+
+        if event == 1:
+            if current is not None:
+                task_time[current] = task_time.get(current, 0) + cycles - switched_at
+                chrome.append({'name': task_name(current), 'ph': 'X', 'pid': 1,
+                               'tid': task_name(current), 'ts': us(switched_at),
+                               'dur': us(cycles - switched_at)})
+            current, switched_at = obj, cycles
+            what = task_name(obj)
+        elif event == 10:
+            isr_start[obj] = cycles
+            what = isr_name(obj)
+        elif event == 11:
+            what = isr_name(obj)
+            if obj in isr_start:
+                length = cycles - isr_start.pop(obj)
+                isr_time[obj] = isr_time.get(obj, 0) + length
+                isr_count[obj] = isr_count.get(obj, 0) + 1
+                isr_max[obj] = max(isr_max.get(obj, 0), length)
+                chrome.append({'name': isr_name(obj), 'ph': 'X', 'pid': 2,
+                               'tid': isr_name(obj), 'ts': us(cycles - length),
+                               'dur': us(length)})
+        elif event in (2, 3):
+            what = task_name(obj)
+        elif event == 12:
+            what = '%d' % obj
+            chrome.append({'name': 'mark %d' % obj, 'ph': 'i', 's': 'g',
+                           'pid': 1, 'tid': context, 'ts': us(cycles)})
+        else:
+            what = 'queue@%06x' % obj
+            chrome.append({'name': '%s %s' % (name, what), 'ph': 'i', 's': 't',
+                           'pid': 1, 'tid': context, 'ts': us(cycles)})
+
+        if not args.no_timeline:
+            print('%12.1f %+10.1f  %-16s %-10s %s'
+                  % (us(cycles), us(cycles - previous), context, name, what))
+        previous = cycles
+
+    end = records[-1][0]
+    if current is not None:
+        task_time[current] = task_time.get(current, 0) + end - switched_at
+    total = end or 1
+
+    print('\n# %.1f ms traced, %d records' % (us(end) / 1000, len(records)))
+    print('# %-20s %10s %6s' % ('task', 'us', '%'))
+    for obj in sorted(task_time, key=lambda o: -task_time[o]):
+        print('  %-20s %10.1f %6.1f' % (task_name(obj), us(task_time[obj]),
+                                       100.0 * task_time[obj] / total))
+    if isr_time:
+        print('# %-20s %10s %6s %8s %10s' % ('interrupt', 'us', '%', 'count', 'max us'))
+        for obj in sorted(isr_time, key=lambda o: -isr_time[o]):
+            print('  %-20s %10.1f %6.1f %8d %10.1f'
+                  % (isr_name(obj), us(isr_time[obj]), 100.0 * isr_time[obj] / total,
+                     isr_count[obj], us(isr_max[obj])))
+
+    if args.json:
+        names = [{'name': 'process_name', 'ph': 'M', 'pid': 1, 'args': {'name': 'tasks'}},
+                 {'name': 'process_name', 'ph': 'M', 'pid': 2, 'args': {'name': 'interrupts'}}]
+        with open(args.json, 'w') as f:
+            json.dump({'traceEvents': names + chrome, 'displayTimeUnit': 'ns'}, f)
+
+if __name__ == '__main__':
+    main()